@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "CallGraphAnalysis.h"
+
+#include "DexUtil.h"
+#include "MethodOverrideGraphAnalysis.h"
+#include "PassManager.h"
+#include "Trace.h"
+
+void CallGraphAnalysisPass::bind_config() {
+  std::string kind;
+  bind("kind", "complete", kind,
+       "One of `single_callee`, `multiple_callee` or `complete`");
+  bind("big_override_threshold", UINT32_C(5),
+       m_config.big_override_threshold);
+  after_configuration([this, kind] {
+    if (kind == "single_callee") {
+      m_config.kind = Kind::SingleCallee;
+    } else if (kind == "multiple_callee") {
+      m_config.kind = Kind::MultipleCallee;
+    } else {
+      always_assert_log(kind == "complete", "Unknown call graph kind: %s",
+                        kind.c_str());
+      m_config.kind = Kind::Complete;
+    }
+  });
+}
+
+void CallGraphAnalysisPass::run_pass(DexStoresVector& stores,
+                                     ConfigFiles& /* conf */,
+                                     PassManager& mgr) {
+  auto scope = build_class_scope(stores);
+  auto method_override_graph =
+      MethodOverrideGraphAnalysisPass::get_or_build(&mgr, scope);
+  m_result = std::make_shared<const call_graph::Graph>(
+      build(m_config, *method_override_graph, scope));
+}
+
+call_graph::Graph CallGraphAnalysisPass::build(
+    const Config& config,
+    const method_override_graph::Graph& method_override_graph,
+    const Scope& scope) {
+  switch (config.kind) {
+  case Kind::SingleCallee:
+    return call_graph::single_callee_graph(method_override_graph, scope);
+  case Kind::MultipleCallee:
+    return call_graph::multiple_callee_graph(method_override_graph, scope,
+                                             config.big_override_threshold);
+  case Kind::Complete:
+    return call_graph::complete_call_graph(method_override_graph, scope);
+  }
+  not_reached();
+}
+
+std::shared_ptr<const call_graph::Graph> CallGraphAnalysisPass::get_or_build(
+    const PassManager* mgr,
+    const Config& config,
+    const method_override_graph::Graph& method_override_graph,
+    const Scope& scope) {
+  if (mgr != nullptr) {
+    auto analysis = mgr->get_preserved_analysis<CallGraphAnalysisPass>();
+    if (analysis != nullptr && analysis->get_result() != nullptr &&
+        analysis->m_config == config) {
+      TRACE(PM, 2, "Reusing the preserved call graph");
+      return analysis->get_result();
+    }
+  }
+  return std::make_shared<const call_graph::Graph>(
+      build(config, method_override_graph, scope));
+}
+
+static CallGraphAnalysisPass s_pass;
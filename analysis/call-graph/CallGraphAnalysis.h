@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <memory>
+
+#include "CallGraph.h"
+#include "DexClass.h"
+#include "MethodOverrideGraph.h"
+#include "Pass.h"
+
+/*
+ * Builds a call graph of the whole program once, so that subsequent passes
+ * asking for the same kind of call graph can share it instead of rebuilding
+ * it. The graph stays available until a pass that doesn't preserve it runs.
+ * The graph refers to invoke instructions, hence only passes that neither
+ * add nor remove any invoke, nor change the class hierarchy, may preserve it:
+ *
+ *   au.add_preserve_specific<CallGraphAnalysisPass>();
+ *
+ * Uses the preserved method override graph, if any.
+ */
+class CallGraphAnalysisPass : public Pass {
+ public:
+  enum class Kind {
+    // See call_graph::single_callee_graph.
+    SingleCallee,
+    // See call_graph::multiple_callee_graph.
+    MultipleCallee,
+    // See call_graph::complete_call_graph.
+    Complete,
+  };
+
+  struct Config {
+    Kind kind{Kind::Complete};
+    // Only used by multiple callee graphs.
+    uint32_t big_override_threshold{5};
+
+    bool operator==(const Config& other) const {
+      return kind == other.kind &&
+             (kind != Kind::MultipleCallee ||
+              big_override_threshold == other.big_override_threshold);
+    }
+  };
+
+  CallGraphAnalysisPass() : Pass("CallGraphAnalysisPass", Pass::ANALYSIS) {}
+
+  void bind_config() override;
+
+  void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
+
+  std::shared_ptr<const call_graph::Graph> get_result() const {
+    return m_result;
+  }
+
+  void destroy_analysis_result() override { m_result = nullptr; }
+
+  static call_graph::Graph build(
+      const Config& config,
+      const method_override_graph::Graph& method_override_graph,
+      const Scope& scope);
+
+  /*
+   * Returns the preserved call graph if there is one of the requested kind,
+   * and builds a new one for the given scope otherwise. The manager may be
+   * null, e.g. in tests.
+   */
+  static std::shared_ptr<const call_graph::Graph> get_or_build(
+      const PassManager* mgr,
+      const Config& config,
+      const method_override_graph::Graph& method_override_graph,
+      const Scope& scope);
+
+ private:
+  Config m_config;
+  std::shared_ptr<const call_graph::Graph> m_result;
+};
@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "MethodOverrideGraphAnalysis.h"
+
+#include "DexUtil.h"
+#include "PassManager.h"
+#include "Trace.h"
+
+void MethodOverrideGraphAnalysisPass::run_pass(DexStoresVector& stores,
+                                               ConfigFiles& /* conf */,
+                                               PassManager& /* mgr */) {
+  m_result = method_override_graph::build_graph(build_class_scope(stores));
+}
+
+std::shared_ptr<const method_override_graph::Graph>
+MethodOverrideGraphAnalysisPass::get_or_build(const PassManager* mgr,
+                                              const Scope& scope) {
+  if (mgr != nullptr) {
+    auto analysis =
+        mgr->get_preserved_analysis<MethodOverrideGraphAnalysisPass>();
+    if (analysis != nullptr && analysis->get_result() != nullptr) {
+      TRACE(PM, 2, "Reusing the preserved method override graph");
+      return analysis->get_result();
+    }
+  }
+  return method_override_graph::build_graph(scope);
+}
+
+static MethodOverrideGraphAnalysisPass s_pass;
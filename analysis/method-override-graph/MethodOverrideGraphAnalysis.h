@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <memory>
+
+#include "DexClass.h"
+#include "MethodOverrideGraph.h"
+#include "Pass.h"
+
+/*
+ * Builds the method override graph of the whole program once, so that
+ * subsequent passes can share it instead of rebuilding it. The graph stays
+ * available until a pass that doesn't preserve it runs. Passes that change
+ * neither the class hierarchy nor the set of methods should declare so:
+ *
+ *   au.add_preserve_specific<MethodOverrideGraphAnalysisPass>();
+ */
+class MethodOverrideGraphAnalysisPass : public Pass {
+ public:
+  MethodOverrideGraphAnalysisPass()
+      : Pass("MethodOverrideGraphAnalysisPass", Pass::ANALYSIS) {}
+
+  void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
+
+  std::shared_ptr<const method_override_graph::Graph> get_result() const {
+    return m_result;
+  }
+
+  void destroy_analysis_result() override { m_result = nullptr; }
+
+  /*
+   * Returns the preserved graph if there is one, and builds a new one for the
+   * given scope otherwise. The manager may be null, e.g. in tests.
+   */
+  static std::shared_ptr<const method_override_graph::Graph> get_or_build(
+      const PassManager* mgr, const Scope& scope);
+
+ private:
+  std::shared_ptr<const method_override_graph::Graph> m_result;
+};
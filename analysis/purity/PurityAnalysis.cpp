@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "PurityAnalysis.h"
+
+#include "ConfigFiles.h"
+#include "DexUtil.h"
+#include "MethodOverrideGraphAnalysis.h"
+#include "PassManager.h"
+#include "Trace.h"
+
+void PurityAnalysisPass::run_pass(DexStoresVector& stores,
+                                  ConfigFiles& conf,
+                                  PassManager& mgr) {
+  auto scope = build_class_scope(stores);
+  auto override_graph =
+      MethodOverrideGraphAnalysisPass::get_or_build(&mgr, scope);
+  auto result = std::make_shared<purity::AnalysisResult>();
+  result->pure_methods = get_default_pure_methods(scope, conf);
+  result->no_side_effects_methods_iterations = compute_no_side_effects_methods(
+      scope, override_graph.get(), result->pure_methods,
+      &result->no_side_effects_methods);
+  result->conditionally_pure_methods_iterations =
+      compute_conditionally_pure_methods(scope, override_graph.get(),
+                                         result->pure_methods,
+                                         &result->conditionally_pure_methods);
+  m_result = std::move(result);
+}
+
+std::unordered_set<DexMethodRef*> PurityAnalysisPass::get_default_pure_methods(
+    const Scope& scope, ConfigFiles& conf) {
+  auto pure_methods = /* Android framework */ get_pure_methods();
+  auto configured_pure_methods = conf.get_pure_methods();
+  pure_methods.insert(configured_pure_methods.begin(),
+                      configured_pure_methods.end());
+  auto immutable_getters = get_immutable_getters(scope);
+  pure_methods.insert(immutable_getters.begin(), immutable_getters.end());
+  return pure_methods;
+}
+
+std::shared_ptr<const purity::AnalysisResult>
+PurityAnalysisPass::get_preserved_result(const PassManager* mgr) {
+  if (mgr == nullptr) {
+    return nullptr;
+  }
+  auto analysis = mgr->get_preserved_analysis<PurityAnalysisPass>();
+  if (analysis == nullptr || analysis->get_result() == nullptr) {
+    return nullptr;
+  }
+  TRACE(PM, 2, "Reusing the preserved purity analysis results");
+  return analysis->get_result();
+}
+
+static PurityAnalysisPass s_pass;
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <memory>
+
+#include "DexClass.h"
+#include "Pass.h"
+#include "Purity.h"
+
+/*
+ * Runs the whole-program purity analyses of Purity.h once, for the default
+ * set of pure methods, so that subsequent passes can share the results
+ * instead of recomputing them. Removing instructions never gives a method new
+ * side effects or makes it read more locations, so the results remain a sound
+ * approximation across passes that only remove or forward instructions, and
+ * which should declare so:
+ *
+ *   au.add_preserve_specific<PurityAnalysisPass>();
+ */
+class PurityAnalysisPass : public Pass {
+ public:
+  PurityAnalysisPass() : Pass("PurityAnalysisPass", Pass::ANALYSIS) {}
+
+  void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
+
+  std::shared_ptr<const purity::AnalysisResult> get_result() const {
+    return m_result;
+  }
+
+  void destroy_analysis_result() override { m_result = nullptr; }
+
+  /*
+   * The pure methods the analyses start from: the known pure methods of the
+   * Android framework, the configured ones, and the immutable getters of the
+   * scope.
+   */
+  static std::unordered_set<DexMethodRef*> get_default_pure_methods(
+      const Scope& scope, ConfigFiles& conf);
+
+  /*
+   * Returns the preserved results if there are any, and null otherwise, in
+   * which case the caller computes what it needs itself. The manager may be
+   * null, e.g. in tests.
+   */
+  static std::shared_ptr<const purity::AnalysisResult> get_preserved_result(
+      const PassManager* mgr);
+
+ private:
+  std::shared_ptr<const purity::AnalysisResult> m_result;
+};
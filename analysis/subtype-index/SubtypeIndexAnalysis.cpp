@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "SubtypeIndexAnalysis.h"
+
+#include "DexUtil.h"
+#include "PassManager.h"
+#include "Trace.h"
+
+void SubtypeIndexAnalysisPass::run_pass(DexStoresVector& stores,
+                                        ConfigFiles& /* conf */,
+                                        PassManager& /* mgr */) {
+  m_result = std::make_shared<const SubtypeIndex>(build_class_scope(stores));
+}
+
+std::shared_ptr<const SubtypeIndex> SubtypeIndexAnalysisPass::get_or_build(
+    const PassManager* mgr, const Scope& scope) {
+  if (mgr != nullptr) {
+    auto analysis = mgr->get_preserved_analysis<SubtypeIndexAnalysisPass>();
+    if (analysis != nullptr && analysis->get_result() != nullptr) {
+      TRACE(PM, 2, "Reusing the preserved subtype index");
+      return analysis->get_result();
+    }
+  }
+  return std::make_shared<const SubtypeIndex>(scope);
+}
+
+static SubtypeIndexAnalysisPass s_pass;
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <memory>
+
+#include "DexClass.h"
+#include "Pass.h"
+#include "SubtypeIndex.h"
+
+/*
+ * Builds the subtype index of the whole program once, so that subsequent
+ * passes can share it instead of rebuilding it. The index stays available
+ * until a pass that doesn't preserve it runs. Passes that don't change the
+ * class hierarchy should declare so:
+ *
+ *   au.add_preserve_specific<SubtypeIndexAnalysisPass>();
+ */
+class SubtypeIndexAnalysisPass : public Pass {
+ public:
+  SubtypeIndexAnalysisPass()
+      : Pass("SubtypeIndexAnalysisPass", Pass::ANALYSIS) {}
+
+  void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
+
+  std::shared_ptr<const SubtypeIndex> get_result() const { return m_result; }
+
+  void destroy_analysis_result() override { m_result = nullptr; }
+
+  /*
+   * Returns the preserved index if there is one, and builds a new one for the
+   * given scope otherwise. The manager may be null, e.g. in tests.
+   */
+  static std::shared_ptr<const SubtypeIndex> get_or_build(
+      const PassManager* mgr, const Scope& scope);
+
+ private:
+  std::shared_ptr<const SubtypeIndex> m_result;
+};
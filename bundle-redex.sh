@@ -10,6 +10,12 @@ else
   GEN_APILEVELS_INPUT=
 fi
 
-tar czf redex.tar.gz redex-all redex.py pyredex/*.py $GEN_APILEVELS_INPUT
+if [ -f "redex-apk-packager" ] ; then
+  APK_PACKAGER_INPUT="redex-apk-packager"
+else
+  APK_PACKAGER_INPUT=
+fi
+
+tar czf redex.tar.gz redex-all $APK_PACKAGER_INPUT redex.py pyredex/*.py $GEN_APILEVELS_INPUT
 cat selfextract.sh redex.tar.gz > redex
 chmod +x redex
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+#include <stdexcept>
+#include "locator_hash.h"
+
+namespace facebook {
+
+// Each seed is tried in turn until the keys of a bucket all land in free
+// slots; with a few keys per bucket and some free slots this takes a handful
+// of tries for most buckets.
+constexpr static const uint32_t max_seed = 1 << 24;
+
+std::vector<uint8_t> LocatorHashTable::build(
+    const std::vector<std::pair<const char*, Locator>>& entries) {
+  uint32_t num_keys = entries.size();
+  uint32_t num_buckets = std::max(1U, num_keys / 4);
+  uint32_t num_slots = num_keys + num_keys / 8 + 1;
+
+  std::vector<uint64_t> hashes(num_keys);
+  std::vector<std::vector<uint32_t>> buckets(num_buckets);
+  for (uint32_t i = 0; i < num_keys; ++i) {
+    hashes[i] = hash(entries[i].first);
+    buckets[bucket_index(hashes[i], num_buckets)].push_back(i);
+  }
+
+  // Keys with the same full hash always collide, and would only fail below
+  // once all seeds are tried.
+  auto sorted_hashes = hashes;
+  std::sort(sorted_hashes.begin(), sorted_hashes.end());
+  if (std::adjacent_find(sorted_hashes.begin(), sorted_hashes.end()) !=
+      sorted_hashes.end()) {
+    throw std::runtime_error("locator hash collision");
+  }
+
+  // Place the largest buckets first, while most slots are free.
+  std::vector<uint32_t> order(num_buckets);
+  for (uint32_t b = 0; b < num_buckets; ++b) {
+    order[b] = b;
+  }
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return buckets[a].size() > buckets[b].size();
+  });
+
+  std::vector<uint32_t> seeds(num_buckets, 0);
+  std::vector<Slot> slots(num_slots, Slot{0, 0, 0, 0});
+  std::vector<uint32_t> placed;
+  for (auto b : order) {
+    const auto& keys = buckets[b];
+    if (keys.empty()) {
+      break;
+    }
+    for (uint32_t seed = 0;; ++seed) {
+      if (seed == max_seed) {
+        throw std::runtime_error("cannot build locator hash table");
+      }
+      placed.clear();
+      bool fits = true;
+      for (auto key : keys) {
+        auto index = slot_index(hashes[key], seed, num_slots);
+        if (slots[index].dexnr != 0 ||
+            std::find(placed.begin(), placed.end(), index) != placed.end()) {
+          fits = false;
+          break;
+        }
+        placed.push_back(index);
+      }
+      if (!fits) {
+        continue;
+      }
+      for (size_t k = 0; k < keys.size(); ++k) {
+        const auto& locator = entries[keys[k]].second;
+        if (locator.dexnr == 0) {
+          throw std::runtime_error("cannot store special locators");
+        }
+        slots[placed[k]] = Slot{hashes[keys[k]], locator.clsnr,
+                                (uint16_t)locator.strnr,
+                                (uint16_t)locator.dexnr};
+      }
+      seeds[b] = seed;
+      break;
+    }
+  }
+
+  seeds.resize((num_buckets + 1) & ~1U, 0);
+  uint32_t header[4] = {magic, num_buckets, num_slots, 0};
+  std::vector<uint8_t> data(sizeof(header) + seeds.size() * sizeof(uint32_t) +
+                            slots.size() * sizeof(Slot));
+  uint8_t* pos = data.data();
+  memcpy(pos, header, sizeof(header));
+  pos += sizeof(header);
+  memcpy(pos, seeds.data(), seeds.size() * sizeof(uint32_t));
+  pos += seeds.size() * sizeof(uint32_t);
+  memcpy(pos, slots.data(), slots.size() * sizeof(Slot));
+  return data;
+}
+
+} // namespace facebook
@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <utility>
+#include <vector>
+
+#include "locator.h"
+
+namespace facebook {
+
+//
+// A perfect hash table from class descriptors to locators, so that a class
+// loader can find the dex of a class with one probe, instead of reading the
+// locator string in front of the descriptor in each candidate dex.
+//
+// Each key hashes to a bucket, and each bucket has a seed that moves all its
+// keys to distinct slots ("hash and displace"). Slots keep the full hash of
+// their key, so that descriptors that are not in the table are rejected too,
+// barring a 64-bit hash collision. The locator is a hint either way.
+//
+// Layout, in host byte order, which the table must be read back with:
+//
+//   uint32_t magic, num_buckets, num_slots, reserved
+//   uint32_t seeds[num_buckets], padded to a multiple of two
+//   Slot slots[num_slots]
+//
+// The lookup side is header-only and allocation-free, for the on-device
+// class loaders. Only the builder needs locator_hash.cpp.
+//
+class LocatorHashTable {
+ public:
+  constexpr static const uint32_t magic = 0x3154484c; // "LHT1"
+
+  struct Slot {
+    uint64_t hash;
+    uint32_t clsnr;
+    uint16_t strnr;
+    uint16_t dexnr; // 0 == empty slot
+  };
+
+  // Serializes a table for the given descriptors. Throws if two descriptors
+  // have the same hash.
+  static std::vector<uint8_t> build(
+      const std::vector<std::pair<const char*, Locator>>& entries);
+
+  // Returns false if the data does not hold a table. The data must be 8-byte
+  // aligned, and outlive the table.
+  inline bool init(const void* data, size_t size) noexcept;
+
+  // Returns the (0, 0, 0) locator, which means the system class loader, for
+  // descriptors that are not in the table.
+  inline Locator find(const char* descriptor) const noexcept;
+
+  static inline uint64_t hash(const char* descriptor) noexcept;
+
+  static inline uint32_t slot_index(uint64_t hash,
+                                    uint32_t seed,
+                                    uint32_t num_slots) noexcept {
+    uint32_t h = (uint32_t)hash ^ (seed * 0x9e3779b9U);
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35U;
+    h ^= h >> 16;
+    return h % num_slots;
+  }
+
+  static inline uint32_t bucket_index(uint64_t hash,
+                                      uint32_t num_buckets) noexcept {
+    return (uint32_t)(hash >> 32) % num_buckets;
+  }
+
+ private:
+  uint32_t m_num_buckets = 0;
+  uint32_t m_num_slots = 0;
+  const uint32_t* m_seeds = nullptr;
+  const Slot* m_slots = nullptr;
+};
+
+uint64_t LocatorHashTable::hash(const char* descriptor) noexcept {
+  // FNV-1a, finished with the MurmurHash3 mixer so that both halves depend
+  // on every byte.
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (const uint8_t* p = (const uint8_t*)descriptor; *p != 0; ++p) {
+    h = (h ^ *p) * 0x100000001b3ULL;
+  }
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+bool LocatorHashTable::init(const void* data, size_t size) noexcept {
+  uint32_t header[4];
+  if (size < sizeof(header) || ((uintptr_t)data & 7) != 0) {
+    return false;
+  }
+  memcpy(header, data, sizeof(header));
+  uint64_t num_seeds = (header[1] + 1) & ~1ULL;
+  if (header[0] != magic || header[1] == 0 || header[2] == 0 ||
+      size != sizeof(header) + num_seeds * sizeof(uint32_t) +
+                  (uint64_t)header[2] * sizeof(Slot)) {
+    return false;
+  }
+  m_num_buckets = header[1];
+  m_num_slots = header[2];
+  m_seeds = (const uint32_t*)data + 4;
+  m_slots = (const Slot*)(m_seeds + num_seeds);
+  return true;
+}
+
+Locator LocatorHashTable::find(const char* descriptor) const noexcept {
+  if (m_num_slots == 0) {
+    return Locator(0, 0, 0);
+  }
+  uint64_t h = hash(descriptor);
+  uint32_t seed = m_seeds[bucket_index(h, m_num_buckets)];
+  const Slot& slot = m_slots[slot_index(h, seed, m_num_slots)];
+  if (slot.dexnr == 0 || slot.hash != h) {
+    return Locator(0, 0, 0);
+  }
+  return Locator(slot.strnr, slot.dexnr, slot.clsnr);
+}
+
+} // namespace facebook
@@ -6,10 +6,12 @@
  */
 
 #include <iostream>
+#include <fstream>
 #include <vector>
 #include <cstdlib>
 
 #include <locator.h>
+#include <locator_hash.h>
 
 using namespace std;
 using namespace facebook;
@@ -18,12 +20,14 @@ void print_usage() {
   cout << "Usage:" << endl;
   cout << "  locatortool d" << endl;
   cout << "  locatortool e [-h|--hex] <class_num> <dex_num> <store_num>" << endl;
+  cout << "  locatortool l <locator-hash.bin> <descriptor>..." << endl;
   cout << endl;
   cout << endl;
   cout << "  Commands:" << endl;
   cout << "    d              Decode a (raw, not hex) locator string from stdin." << endl;
   cout << "    e              Encode a value" << endl;
   cout << "      -h | --hex   Print a hexdump of the locator instead of the raw string" << endl;
+  cout << "    l              Look up descriptors in a locator hash table" << endl;
   cout << endl;
 }
 
@@ -73,6 +77,28 @@ int main(int argc, char* argv[]) {
         }
         break;
       }
+      case 'l': {
+        if (args.size() < 4) {
+          throw 0;
+        }
+        ifstream in(args[2], ios::binary | ios::ate);
+        size_t size = in.tellg();
+        // The table needs 8-byte alignment.
+        vector<uint64_t> data((size + 7) / 8);
+        in.seekg(0);
+        in.read((char*)data.data(), size);
+        LocatorHashTable table;
+        if (!in || !table.init(data.data(), size)) {
+          cerr << "Not a locator hash table: " << args[2] << endl;
+          return 1;
+        }
+        for (size_t i = 3; i < args.size(); i++) {
+          Locator locator = table.find(args[i].c_str());
+          cout << args[i] << ": class " << locator.clsnr << ", dex "
+               << locator.dexnr << ", store " << locator.strnr << endl;
+        }
+        break;
+      }
       default: {
         throw 0;
         break;
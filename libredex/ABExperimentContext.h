@@ -25,6 +25,10 @@ class ABExperimentContext {
   static std::unique_ptr<ABExperimentContext> create(
       const std::string& exp_name);
 
+  /**
+   * Registers a method whose code is about to change. This takes no copy of
+   * the method's code, so it is cheap, and the method doesn't need a CFG.
+   */
   virtual void try_register_method(DexMethod* m) = 0;
 
   virtual bool use_control() = 0;
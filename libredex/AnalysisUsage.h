@@ -52,6 +52,18 @@ class AnalysisUsage {
     m_preserve_specific.emplace(get_analysis_id_by_pass<AnalysisPassType>());
   }
 
+  // Declares that this current pass handles methods whose editable CFG has
+  // already been built, and leaves editable CFGs built instead of linearizing
+  // them. Only takes effect when the PassManager keeps CFGs across passes
+  // (`persistent_editable_cfgs`). Such a pass must not iterate over the
+  // linear IRList of a method without going through its CFG (see
+  // `editable_cfg_adapter` and `cfg::ScopedCFG`).
+  void set_requires_linear_ir(bool requires_linear_ir) {
+    m_requires_linear_ir = requires_linear_ir;
+  }
+
+  bool requires_linear_ir() const { return m_requires_linear_ir; }
+
   // Returns a set of passes used by (thus should precede) this current pass.
   const std::unordered_set<AnalysisID>& get_required_passes() {
     return m_required_passes;
@@ -69,6 +81,7 @@ class AnalysisUsage {
 
  private:
   bool m_preserve_all = false;
+  bool m_requires_linear_ir = true;
   std::unordered_set<AnalysisID> m_required_passes;
   std::unordered_set<AnalysisID> m_preserve_specific;
 };
@@ -867,48 +867,29 @@ std::unordered_set<std::string> ResourcesArscFile::get_files_by_rid(
   return ret;
 }
 
-void ResourcesArscFile::walk_references_for_resource(
-    uint32_t resID,
-    std::unordered_set<uint32_t>* nodes_visited,
-    std::unordered_set<std::string>* potential_file_paths) {
-  if (nodes_visited->find(resID) != nodes_visited->end()) {
-    return;
-  }
-  nodes_visited->emplace(resID);
-
-  ssize_t pkg_index = res_table.getResourcePackageIndex(resID);
-
-  android::Vector<android::Res_value> initial_values;
-  res_table.getAllValuesForResource(resID, initial_values);
-
-  std::stack<android::Res_value> nodes_to_explore;
-  for (size_t index = 0; index < initial_values.size(); ++index) {
-    nodes_to_explore.push(initial_values[index]);
-  }
-
-  while (!nodes_to_explore.empty()) {
-    android::Res_value r = nodes_to_explore.top();
-    nodes_to_explore.pop();
+void ResourcesArscFile::collect_direct_references(
+    uint32_t res_id,
+    std::vector<uint32_t>* ref_ids,
+    std::vector<std::string>* potential_file_paths) {
+  ssize_t pkg_index = res_table.getResourcePackageIndex(res_id);
+
+  android::Vector<android::Res_value> values;
+  res_table.getAllValuesForResource(res_id, values);
+  for (size_t index = 0; index < values.size(); ++index) {
+    const auto& r = values[index];
     if (r.dataType == android::Res_value::TYPE_STRING) {
       android::String8 str = res_table.getString8FromIndex(pkg_index, r.data);
-      potential_file_paths->insert(std::string(str.string()));
+      potential_file_paths->emplace_back(str.string());
       continue;
     }
 
-    // Skip any non-references or already visited nodes
+    // Skip any non-references
     if ((r.dataType != android::Res_value::TYPE_REFERENCE &&
          r.dataType != android::Res_value::TYPE_ATTRIBUTE) ||
-        r.data <= PACKAGE_RESID_START ||
-        nodes_visited->find(r.data) != nodes_visited->end()) {
+        r.data <= PACKAGE_RESID_START) {
       continue;
     }
-
-    nodes_visited->insert(r.data);
-    android::Vector<android::Res_value> inner_values;
-    res_table.getAllValuesForResource(r.data, inner_values);
-    for (size_t index = 0; index < inner_values.size(); ++index) {
-      nodes_to_explore.push(inner_values[index]);
-    }
+    ref_ids->push_back(r.data);
   }
 }
 
@@ -937,10 +918,11 @@ bool ResourcesArscFile::resource_value_identical(uint32_t a_id, uint32_t b_id) {
 }
 
 ResourcesArscFile::ResourcesArscFile(const std::string& path)
-    : m_f(RedexMappedFile::open(path, /* read_only= */ false)) {
+    : m_f(RedexMappedFile::open(path, /* read_only= */ false)),
+      m_table_data(RedexMappedFile::open_copy_on_write(path)) {
   m_arsc_len = m_f.size();
-  int error = res_table.add(m_f.const_data(), m_f.size(), /* cookie */ -1,
-                            /* copyData*/ true);
+  int error = res_table.add(m_table_data.const_data(), m_table_data.size(),
+                            /* cookie */ -1, /* copyData*/ false);
   always_assert_log(error == 0, "Reading arsc failed with error code: %d",
                     error);
 
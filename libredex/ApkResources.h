@@ -49,6 +49,8 @@ class ResourcesArscFile : public ResourceTableFile {
   std::vector<std::string> get_resource_strings_by_name(
       const std::string& res_name);
   void remap_ids(const std::map<uint32_t, uint32_t>& old_to_remapped_ids);
+  // Writes the table back to the file. The table must not be used afterwards,
+  // since it reads its data from the original file contents.
   size_t serialize();
 
   void collect_resid_values_and_hashes(
@@ -64,10 +66,10 @@ class ResourcesArscFile : public ResourceTableFile {
   std::unordered_set<std::string> get_files_by_rid(
       uint32_t res_id,
       ResourcePathType path_type = ResourcePathType::DevicePath) override;
-  void walk_references_for_resource(
-      uint32_t resID,
-      std::unordered_set<uint32_t>* nodes_visited,
-      std::unordered_set<std::string>* potential_file_paths) override;
+  void collect_direct_references(
+      uint32_t res_id,
+      std::vector<uint32_t>* ref_ids,
+      std::vector<std::string>* potential_file_paths) override;
 
   ~ResourcesArscFile() override;
 
@@ -75,6 +77,10 @@ class ResourcesArscFile : public ResourceTableFile {
 
  private:
   RedexMappedFile m_f;
+  // A private mapping of the same file that res_table reads from, so that
+  // the table doesn't need a copy of the whole file. Pages are only read
+  // when they are accessed, and the table's in-place edits stay in memory.
+  RedexMappedFile m_table_data;
   size_t m_arsc_len;
   std::map<uint32_t, android::Vector<android::Res_value>> tmp_id_to_values;
   bool m_file_closed = false;
@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string_view>
+#include <vector>
+
+#include "Debug.h"
+
+/*
+ * A bump allocator. Memory is handed out from large blocks and only released
+ * all at once, when the arena is destroyed. Not thread-safe.
+ */
+class BumpArena {
+ public:
+  explicit BumpArena(size_t block_size = 64 * 1024)
+      : m_block_size(block_size) {}
+
+  BumpArena(const BumpArena&) = delete;
+  BumpArena& operator=(const BumpArena&) = delete;
+
+  void* allocate(size_t size, size_t alignment) {
+    size_t aligned = (m_used + alignment - 1) & ~(alignment - 1);
+    if (m_blocks.empty() || aligned + size > m_current_size) {
+      // Oversized requests get a block of their own.
+      m_current_size = std::max(m_block_size, size + alignment);
+      m_blocks.emplace_back(new char[m_current_size]);
+      m_used = 0;
+      auto base = reinterpret_cast<uintptr_t>(m_blocks.back().get());
+      aligned = ((base + alignment - 1) & ~(alignment - 1)) - base;
+    }
+    m_used = aligned + size;
+    m_bytes_allocated += size;
+    return m_blocks.back().get() + aligned;
+  }
+
+  size_t bytes_allocated() const { return m_bytes_allocated; }
+
+ private:
+  const size_t m_block_size;
+  std::vector<std::unique_ptr<char[]>> m_blocks;
+  size_t m_current_size{0};
+  size_t m_used{0};
+  size_t m_bytes_allocated{0};
+};
+
+/*
+ * A concurrent intern table from strings to `Value` objects (e.g.
+ * `DexString`), designed to make interning millions of strings cheap:
+ *
+ * - The table is split into shards, picked by the full hash of the string,
+ *   each guarded by its own mutex.
+ * - Each shard is an open-addressing (linear probing) hash table. Slots store
+ *   the full 64-bit hash and the byte length of the key next to the value, so
+ *   a probe only dereferences the value to compare string contents when both
+ *   match.
+ * - Values are constructed in a per-shard bump arena instead of being
+ *   allocated one by one, and are destroyed together with the table.
+ *
+ * `KeyOf` must map a `const Value&` to the `std::string_view` it was interned
+ * under.
+ */
+template <typename Value, typename KeyOf, size_t n_shards = 64>
+class ArenaInternTable {
+ public:
+  ArenaInternTable() = default;
+  ArenaInternTable(const ArenaInternTable&) = delete;
+  ArenaInternTable& operator=(const ArenaInternTable&) = delete;
+
+  ~ArenaInternTable() {
+    for (auto& shard : m_shards) {
+      for (auto& slot : shard.slots) {
+        if (slot.value != nullptr) {
+          slot.value->~Value();
+        }
+      }
+    }
+  }
+
+  /*
+   * Returns the value interned under `key`, or nullptr.
+   */
+  Value* get(std::string_view key) const {
+    auto hash = hash_key(key);
+    auto& shard = shard_for(hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.find(hash, key);
+  }
+
+  /*
+   * Returns the value interned under `key`. If there is none yet, calls
+   * `make(void* memory)` to placement-construct one in the arena.
+   */
+  template <typename MakeFn>
+  Value* get_or_make(std::string_view key, const MakeFn& make) {
+    auto hash = hash_key(key);
+    auto& shard = shard_for(hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto* existing = shard.find(hash, key);
+    if (existing != nullptr) {
+      return existing;
+    }
+    auto* value =
+        make(shard.arena.allocate(sizeof(Value), alignof(Value)));
+    always_assert(KeyOf()(*value) == key);
+    shard.insert(hash, key.size(), value);
+    return value;
+  }
+
+  size_t size() const {
+    size_t total = 0;
+    for (auto& shard : m_shards) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      total += shard.num_values;
+    }
+    return total;
+  }
+
+  // Calls `fn(Value*)` for every value. Not safe to run concurrently with
+  // insertions.
+  template <typename Fn>
+  void for_each(const Fn& fn) const {
+    for (auto& shard : m_shards) {
+      for (auto& slot : shard.slots) {
+        if (slot.value != nullptr) {
+          fn(slot.value);
+        }
+      }
+    }
+  }
+
+ private:
+  struct Slot {
+    uint64_t hash{0};
+    uint32_t length{0};
+    Value* value{nullptr};
+  };
+
+  struct Shard {
+    mutable std::mutex mutex;
+    std::vector<Slot> slots;
+    size_t num_values{0};
+    BumpArena arena;
+
+    Value* find(uint64_t hash, std::string_view key) const {
+      if (slots.empty()) {
+        return nullptr;
+      }
+      size_t mask = slots.size() - 1;
+      for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        const auto& slot = slots[i];
+        if (slot.value == nullptr) {
+          return nullptr;
+        }
+        if (slot.hash == hash && slot.length == key.size() &&
+            KeyOf()(*slot.value) == key) {
+          return slot.value;
+        }
+      }
+    }
+
+    void insert(uint64_t hash, size_t length, Value* value) {
+      // Keep the load factor at or below 1/2.
+      if ((num_values + 1) * 2 > slots.size()) {
+        grow();
+      }
+      place(Slot{hash, static_cast<uint32_t>(length), value});
+      ++num_values;
+    }
+
+    void place(const Slot& slot) {
+      size_t mask = slots.size() - 1;
+      size_t i = slot.hash & mask;
+      while (slots[i].value != nullptr) {
+        i = (i + 1) & mask;
+      }
+      slots[i] = slot;
+    }
+
+    void grow() {
+      std::vector<Slot> old;
+      old.swap(slots);
+      slots.resize(std::max<size_t>(16, old.size() * 2));
+      for (const auto& slot : old) {
+        if (slot.value != nullptr) {
+          place(slot);
+        }
+      }
+    }
+  };
+
+  static uint64_t hash_key(std::string_view key) {
+    return std::hash<std::string_view>()(key);
+  }
+
+  Shard& shard_for(uint64_t hash) const {
+    // The low bits pick the slot within a shard; use the high bits here.
+    return m_shards[(hash >> 32) % n_shards];
+  }
+
+  mutable std::array<Shard, n_shards> m_shards;
+};
@@ -7,12 +7,63 @@
 
 #pragma once
 
+#include <memory>
+
 #include "ControlFlow.h"
 #include "IRInstruction.h"
 #include "MonotonicFixpointIterator.h"
 
 namespace ir_analyzer {
 
+using WeakPartialOrdering = sparta::WeakPartialOrdering<cfg::Block*>;
+
+/*
+ * The orderings walked by the forward and backward analyzers below. They only
+ * depend on the shape of the CFG, so several analyses of the same CFG can
+ * share one instead of building their own; see also `sparta::run_jointly`.
+ */
+inline std::shared_ptr<const WeakPartialOrdering> make_forward_ordering(
+    const cfg::ControlFlowGraph& cfg) {
+  return sparta::make_weak_partial_ordering<cfg::GraphInterface>(cfg);
+}
+
+inline std::shared_ptr<const WeakPartialOrdering> make_backward_ordering(
+    const cfg::ControlFlowGraph& cfg) {
+  return sparta::make_weak_partial_ordering<
+      sparta::BackwardsFixpointIterationAdaptor<cfg::GraphInterface>>(cfg);
+}
+
+namespace impl {
+
+template <bool Forward>
+struct CachedOrdering {
+  explicit CachedOrdering(const cfg::ControlFlowGraph& cfg)
+      : ordering(Forward ? make_forward_ordering(cfg)
+                         : make_backward_ordering(cfg)) {}
+
+  std::shared_ptr<const WeakPartialOrdering> ordering;
+};
+
+} // namespace impl
+
+/*
+ * Same as above, but kept on the CFG (see `ControlFlowGraph::get_analysis`)
+ * until its shape changes. This pays off for analyses that are rerun on
+ * unchanged CFGs, e.g. in each global iteration of an interprocedural
+ * analysis. As with the rest of the CFG, don't call these on one CFG from
+ * several threads at once.
+ */
+inline std::shared_ptr<const WeakPartialOrdering> get_forward_ordering(
+    const cfg::ControlFlowGraph& cfg) {
+  return cfg.get_analysis<impl::CachedOrdering</* Forward */ true>>().ordering;
+}
+
+inline std::shared_ptr<const WeakPartialOrdering> get_backward_ordering(
+    const cfg::ControlFlowGraph& cfg) {
+  return cfg.get_analysis<impl::CachedOrdering</* Forward */ false>>()
+      .ordering;
+}
+
 template <typename Domain>
 class BaseIRAnalyzer
     : public sparta::MonotonicFixpointIterator<cfg::GraphInterface, Domain> {
@@ -23,6 +74,13 @@ class BaseIRAnalyzer
       : sparta::MonotonicFixpointIterator<cfg::GraphInterface, Domain>(
             cfg, cfg.blocks().size()) {}
 
+  // `ordering` must come from `make_forward_ordering(cfg)` or
+  // `get_forward_ordering(cfg)`.
+  BaseIRAnalyzer(const cfg::ControlFlowGraph& cfg,
+                 std::shared_ptr<const WeakPartialOrdering> ordering)
+      : sparta::MonotonicFixpointIterator<cfg::GraphInterface, Domain>(
+            cfg, std::move(ordering), cfg.blocks().size()) {}
+
   void analyze_node(const NodeId& node, Domain* current_state) const override {
     for (auto& mie : ir_list::InstructionIterable(node)) {
       analyze_instruction(mie.insn, current_state);
@@ -51,6 +109,14 @@ class BaseBackwardsIRAnalyzer
             sparta::BackwardsFixpointIterationAdaptor<cfg::GraphInterface>,
             Domain>(cfg, cfg.blocks().size()) {}
 
+  // `ordering` must come from `make_backward_ordering(cfg)` or
+  // `get_backward_ordering(cfg)`.
+  BaseBackwardsIRAnalyzer(const cfg::ControlFlowGraph& cfg,
+                          std::shared_ptr<const WeakPartialOrdering> ordering)
+      : sparta::MonotonicFixpointIterator<
+            sparta::BackwardsFixpointIterationAdaptor<cfg::GraphInterface>,
+            Domain>(cfg, std::move(ordering), cfg.blocks().size()) {}
+
   void analyze_node(const NodeId& node, Domain* current_state) const override {
     for (auto it = node->rbegin(); it != node->rend(); ++it) {
       if (it->type == MFLOW_OPCODE) {
@@ -22,6 +22,7 @@
 #include <stdexcept>
 #include <string>
 
+#include <google/protobuf/arena.h>
 #include <google/protobuf/descriptor.h>
 #include <google/protobuf/io/coded_stream.h>
 #include <google/protobuf/message.h>
@@ -32,6 +33,7 @@
 #include "RedexMappedFile.h"
 #include "RedexResources.h"
 #include "Trace.h"
+#include "WorkQueue.h"
 
 namespace {
 
@@ -672,44 +674,56 @@ void change_resource_id_in_value_reference(
   }
 }
 
-void remove_or_change_resource_ids(
+// Removes and renumbers the entries of the type in place. Returns whether any
+// entry was touched.
+bool remove_or_change_resource_ids(
     const std::set<uint32_t>& ids_to_remove,
     const std::map<uint32_t, uint32_t>& old_to_new,
     uint32_t package_id,
     aapt::pb::Type* type) {
-  google::protobuf::RepeatedPtrField<aapt::pb::Entry> new_entries;
-  for (const auto& entry : type->entry()) {
+  bool changed = false;
+  auto entries = type->mutable_entry();
+  int kept = 0;
+  for (int i = 0; i < entries->size(); ++i) {
+    auto entry = entries->Mutable(i);
     uint32_t res_id =
         (PACKAGE_MASK_BIT & (package_id << PACKAGE_INDEX_BIT_SHIFT)) |
         (TYPE_MASK_BIT & ((type->type_id().id()) << TYPE_INDEX_BIT_SHIFT)) |
-        (ENTRY_MASK_BIT & (entry.entry_id().id()));
+        (ENTRY_MASK_BIT & (entry->entry_id().id()));
     if (ids_to_remove.count(res_id)) {
+      changed = true;
       continue;
     }
-    auto copy_entry = new aapt::pb::Entry(entry);
-    if (old_to_new.count(res_id)) {
-      uint32_t new_res_id = old_to_new.at(res_id);
-      uint32_t new_entry_id = ENTRY_MASK_BIT & new_res_id;
-      always_assert_log(copy_entry->has_entry_id(),
+    auto it = old_to_new.find(res_id);
+    if (it != old_to_new.end()) {
+      changed = true;
+      uint32_t new_entry_id = ENTRY_MASK_BIT & it->second;
+      always_assert_log(entry->has_entry_id(),
                         "Entry don't have id %s",
-                        copy_entry->DebugString().c_str());
-      auto entry_id = copy_entry->mutable_entry_id();
-      entry_id->set_id(new_entry_id);
-      auto config_value_size = copy_entry->config_value_size();
-      for (int i = 0; i < config_value_size; ++i) {
-        auto config_value = copy_entry->mutable_config_value(i);
+                        entry->DebugString().c_str());
+      entry->mutable_entry_id()->set_id(new_entry_id);
+      auto config_value_size = entry->config_value_size();
+      for (int j = 0; j < config_value_size; ++j) {
+        auto config_value = entry->mutable_config_value(j);
         always_assert_log(config_value->has_value(),
                           "ConfigValue don't have value %s\nEntry:\n%s",
                           config_value->DebugString().c_str(),
-                          copy_entry->DebugString().c_str());
+                          entry->DebugString().c_str());
         auto value = config_value->mutable_value();
         change_resource_id_in_value_reference(old_to_new, value);
       }
     }
-    new_entries.AddAllocated(copy_entry);
+    // Removed entries are swapped towards the end, keeping the order of the
+    // others.
+    if (kept != i) {
+      entries->SwapElements(kept, i);
+    }
+    ++kept;
+  }
+  if (kept < entries->size()) {
+    entries->DeleteSubrange(kept, entries->size() - kept);
   }
-  type->clear_entry();
-  type->mutable_entry()->Swap(&new_entries);
+  return changed;
 }
 
 void change_resource_id_in_xml_references(
@@ -879,35 +893,44 @@ std::unordered_set<uint32_t> BundleResources::get_xml_reference_attributes(
 void ResourcesPbFile::remap_res_ids_and_serialize(
     const std::vector<std::string>& resource_files,
     const std::map<uint32_t, uint32_t>& old_to_new) {
-  for (const auto& resources_pb_path : resource_files) {
-    TRACE(RES,
-          9,
-          "BundleResources changing resource data for file: %s",
-          resources_pb_path.c_str());
-    read_protobuf_file_contents(
-        resources_pb_path,
-        [&](google::protobuf::io::CodedInputStream& input,
-            size_t /* unused */) {
-          aapt::pb::ResourceTable pb_restable;
-          bool read_finish = pb_restable.ParseFromCodedStream(&input);
-          always_assert_log(read_finish,
-                            "BundleResoource failed to read %s",
-                            resources_pb_path.c_str());
-          int package_size = pb_restable.package_size();
-          for (int i = 0; i < package_size; i++) {
-            auto package = pb_restable.mutable_package(i);
-            auto current_package_id = package->package_id().id();
-            int type_size = package->type_size();
-            for (int j = 0; j < type_size; j++) {
-              auto type = package->mutable_type(j);
-              remove_or_change_resource_ids(m_ids_to_remove, old_to_new,
-                                            current_package_id, type);
-            }
-          }
-          std::ofstream out(resources_pb_path, std::ofstream::binary);
-          always_assert(pb_restable.SerializeToOstream(&out));
-        });
-  }
+  // The resources.pb of each module is independent of the others.
+  workqueue_run<std::string>(
+      [&](const std::string& resources_pb_path) {
+        TRACE(RES,
+              9,
+              "BundleResources changing resource data for file: %s",
+              resources_pb_path.c_str());
+        read_protobuf_file_contents(
+            resources_pb_path,
+            [&](google::protobuf::io::CodedInputStream& input,
+                size_t /* unused */) {
+              google::protobuf::Arena arena;
+              auto pb_restable =
+                  google::protobuf::Arena::CreateMessage<
+                      aapt::pb::ResourceTable>(&arena);
+              bool read_finish = pb_restable->ParseFromCodedStream(&input);
+              always_assert_log(read_finish,
+                                "BundleResoource failed to read %s",
+                                resources_pb_path.c_str());
+              bool changed = false;
+              int package_size = pb_restable->package_size();
+              for (int i = 0; i < package_size; i++) {
+                auto package = pb_restable->mutable_package(i);
+                auto current_package_id = package->package_id().id();
+                int type_size = package->type_size();
+                for (int j = 0; j < type_size; j++) {
+                  auto type = package->mutable_type(j);
+                  changed |= remove_or_change_resource_ids(
+                      m_ids_to_remove, old_to_new, current_package_id, type);
+                }
+              }
+              if (changed) {
+                std::ofstream out(resources_pb_path, std::ofstream::binary);
+                always_assert(pb_restable->SerializeToOstream(&out));
+              }
+            });
+      },
+      resource_files);
 }
 
 namespace {
@@ -964,69 +987,86 @@ void reset_pb_source(google::protobuf::Message* message) {
 }
 } // namespace
 
-void ResourcesPbFile::collect_resource_data_for_file(
-    const std::string& resources_pb_path) {
+namespace {
+// Parses a resources.pb file into a table allocated on the given arena.
+aapt::pb::ResourceTable* read_resource_table(
+    const std::string& resources_pb_path, google::protobuf::Arena* arena) {
   TRACE(RES,
         9,
         "BundleResources collecting resource data for file: %s",
         resources_pb_path.c_str());
+  auto pb_restable =
+      google::protobuf::Arena::CreateMessage<aapt::pb::ResourceTable>(arena);
   read_protobuf_file_contents(
       resources_pb_path,
       [&](google::protobuf::io::CodedInputStream& input, size_t /* unused */) {
-        aapt::pb::ResourceTable pb_restable;
-        bool read_finish = pb_restable.ParseFromCodedStream(&input);
+        bool read_finish = pb_restable->ParseFromCodedStream(&input);
         always_assert_log(read_finish, "BundleResoource failed to read %s",
                           resources_pb_path.c_str());
-        if (pb_restable.has_source_pool()) {
+        if (pb_restable->has_source_pool()) {
           // Source positions refer to ResStringPool entries which are file
           // paths from the perspective of the build machine. Not relevant for
           // further operations, set them to a predictable value.
           // NOTE: Not all input .aab files will have this data; release style
           // bundles should omit this data.
-          reset_pb_source(&pb_restable);
-        }
-        for (const aapt::pb::Package& pb_package : pb_restable.package()) {
-          auto current_package_id = pb_package.package_id().id();
-          TRACE(RES, 9, "Package: %s %X", pb_package.package_name().c_str(),
-                current_package_id);
-          m_package_id_to_module_name.emplace(
-              current_package_id, module_name_from_pb_path(resources_pb_path));
-          for (const aapt::pb::Type& pb_type : pb_package.type()) {
-            auto current_type_id = pb_type.type_id().id();
-            const auto& current_type_name = pb_type.name();
-            TRACE(RES, 9, "  Type: %s %X", current_type_name.c_str(),
-                  current_type_id);
-            always_assert(m_type_id_to_names.count(current_type_id) == 0 ||
-                          m_type_id_to_names.at(current_type_id) ==
-                              current_type_name);
-            m_type_id_to_names[current_type_id] = current_type_name;
-            for (const aapt::pb::Entry& pb_entry : pb_type.entry()) {
-              if (m_package_id == 0xFFFFFFFF) {
-                m_package_id = current_package_id;
-              }
-              always_assert_log(
-                  m_package_id == current_package_id,
-                  "Broken assumption for only one package for resources.");
-              std::string name_string = pb_entry.name();
-              auto current_entry_id = pb_entry.entry_id().id();
-              auto current_resource_id =
-                  (PACKAGE_MASK_BIT &
-                   (current_package_id << PACKAGE_INDEX_BIT_SHIFT)) |
-                  (TYPE_MASK_BIT & (current_type_id << TYPE_INDEX_BIT_SHIFT)) |
-                  (ENTRY_MASK_BIT & current_entry_id);
-              TRACE(RES, 9, "    Entry: %s %X %X", pb_entry.name().c_str(),
-                    current_entry_id, current_resource_id);
-              sorted_res_ids.add(current_resource_id);
-              always_assert(m_existed_res_ids.count(current_resource_id) == 0);
-              m_existed_res_ids.emplace(current_resource_id);
-              id_to_name.emplace(current_resource_id, name_string);
-              name_to_ids[name_string].push_back(current_resource_id);
-              m_res_id_to_configvalue.emplace(current_resource_id,
-                                              pb_entry.config_value());
-            }
-          }
+          reset_pb_source(pb_restable);
         }
       });
+  return pb_restable;
+}
+} // namespace
+
+void ResourcesPbFile::collect_resource_data_for_file(
+    const std::string& resources_pb_path) {
+  google::protobuf::Arena arena;
+  collect_resource_data(resources_pb_path,
+                        *read_resource_table(resources_pb_path, &arena));
+}
+
+void ResourcesPbFile::collect_resource_data(
+    const std::string& resources_pb_path,
+    const aapt::pb::ResourceTable& pb_restable) {
+  for (const aapt::pb::Package& pb_package : pb_restable.package()) {
+    auto current_package_id = pb_package.package_id().id();
+    TRACE(RES, 9, "Package: %s %X", pb_package.package_name().c_str(),
+          current_package_id);
+    m_package_id_to_module_name.emplace(
+        current_package_id, module_name_from_pb_path(resources_pb_path));
+    for (const aapt::pb::Type& pb_type : pb_package.type()) {
+      auto current_type_id = pb_type.type_id().id();
+      const auto& current_type_name = pb_type.name();
+      TRACE(RES, 9, "  Type: %s %X", current_type_name.c_str(),
+            current_type_id);
+      always_assert(m_type_id_to_names.count(current_type_id) == 0 ||
+                    m_type_id_to_names.at(current_type_id) ==
+                        current_type_name);
+      m_type_id_to_names[current_type_id] = current_type_name;
+      for (const aapt::pb::Entry& pb_entry : pb_type.entry()) {
+        if (m_package_id == 0xFFFFFFFF) {
+          m_package_id = current_package_id;
+        }
+        always_assert_log(
+            m_package_id == current_package_id,
+            "Broken assumption for only one package for resources.");
+        std::string name_string = pb_entry.name();
+        auto current_entry_id = pb_entry.entry_id().id();
+        auto current_resource_id =
+            (PACKAGE_MASK_BIT &
+             (current_package_id << PACKAGE_INDEX_BIT_SHIFT)) |
+            (TYPE_MASK_BIT & (current_type_id << TYPE_INDEX_BIT_SHIFT)) |
+            (ENTRY_MASK_BIT & current_entry_id);
+        TRACE(RES, 9, "    Entry: %s %X %X", pb_entry.name().c_str(),
+              current_entry_id, current_resource_id);
+        sorted_res_ids.add(current_resource_id);
+        always_assert(m_existed_res_ids.count(current_resource_id) == 0);
+        m_existed_res_ids.emplace(current_resource_id);
+        id_to_name.emplace(current_resource_id, name_string);
+        name_to_ids[name_string].push_back(current_resource_id);
+        m_res_id_to_configvalue.emplace(current_resource_id,
+                                        pb_entry.config_value());
+      }
+    }
+  }
 }
 
 std::unordered_set<uint32_t> ResourcesPbFile::get_types_by_name(
@@ -1083,28 +1123,18 @@ std::unordered_set<std::string> ResourcesPbFile::get_files_by_rid(
   return ret;
 }
 
-void ResourcesPbFile::walk_references_for_resource(
-    uint32_t resID,
-    std::unordered_set<uint32_t>* nodes_visited,
-    std::unordered_set<std::string>* potential_file_paths) {
-  if (nodes_visited->find(resID) != nodes_visited->end()) {
-    // Return directly if a node is visited.
+void ResourcesPbFile::collect_direct_references(
+    uint32_t res_id,
+    std::vector<uint32_t>* ref_ids,
+    std::vector<std::string>* potential_file_paths) {
+  auto values_it = m_res_id_to_configvalue.find(res_id);
+  if (values_it == m_res_id_to_configvalue.end()) {
     return;
   }
-  nodes_visited->emplace(resID);
-  auto module_name = resolve_module_name_for_resource_id(resID);
+  const auto& module_name = resolve_module_name_for_resource_id(res_id);
 
-  auto& initial_values = m_res_id_to_configvalue.at(resID);
-  std::stack<const aapt::pb::ConfigValue*> nodes_to_explore;
-  auto push_to_stack = [&nodes_to_explore](const aapt::pb::ConfigValue& cv) {
-    nodes_to_explore.push(&cv);
-  };
-  std::for_each(initial_values.begin(), initial_values.end(), push_to_stack);
-
-  while (!nodes_to_explore.empty()) {
-    const auto& r = nodes_to_explore.top();
-    const auto& value = r->value();
-    nodes_to_explore.pop();
+  for (const auto& cv : values_it->second) {
+    const auto& value = cv.value();
 
     std::vector<aapt::pb::Item> items;
     std::vector<aapt::pb::Reference> refs;
@@ -1120,41 +1150,32 @@ void ResourcesPbFile::walk_references_for_resource(
     }
 
     // For each Item, store the path of FileReference into string values.
-    for (size_t i = 0; i < items.size(); i++) {
-      const auto& item = items[i];
+    for (const auto& item : items) {
       if (item.has_file()) {
-        // NOTE: We are mapping original given resource ID to a module name,
-        // when in reality resource ID for current item from the stack could be
-        // several references away. This should work for all our expected inputs
-        // but is shaky nonetheless.
-        auto item_path = module_name + "/" + item.file().path();
-        potential_file_paths->insert(item_path);
-        continue;
+        potential_file_paths->push_back(module_name + "/" +
+                                        item.file().path());
       }
     }
 
-    // For each Reference, follow its id to traverse the resources.
-    for (size_t i = 0; i < refs.size(); i++) {
-      std::vector<uint32_t> ref_ids;
-      if (refs[i].id() != 0) {
-        ref_ids.push_back(refs[i].id());
-      } else if (!refs[i].name().empty()) {
+    // For each Reference, output its id.
+    for (const auto& ref : refs) {
+      if (ref.id() != 0) {
+        if (ref.id() > PACKAGE_RESID_START) {
+          ref_ids->push_back(ref.id());
+        }
+      } else if (!ref.name().empty()) {
         // Since id of a Reference message is optional, once ref_id =0, it is
         // possible that the resource is refered by name. If we can make sure it
         // won't happen, this branch can be removed.
-        ref_ids = get_res_ids_by_name(refs[i].name());
-      }
-
-      for (size_t n = 0; n < ref_ids.size(); n++) {
-        // Skip if the node has been visited.
-        const auto ref_id = ref_ids[n];
-        if (ref_id <= PACKAGE_RESID_START ||
-            nodes_visited->find(ref_id) != nodes_visited->end()) {
+        auto it = name_to_ids.find(ref.name());
+        if (it == name_to_ids.end()) {
           continue;
         }
-        nodes_visited->insert(ref_id);
-        const auto& inner_values = m_res_id_to_configvalue.at(ref_id);
-        std::for_each(inner_values.begin(), inner_values.end(), push_to_stack);
+        for (auto id : it->second) {
+          if (id > PACKAGE_RESID_START) {
+            ref_ids->push_back(id);
+          }
+        }
       }
     }
   }
@@ -1163,8 +1184,21 @@ void ResourcesPbFile::walk_references_for_resource(
 std::unique_ptr<ResourceTableFile> BundleResources::load_res_table() {
   const auto& res_pb_file_paths = find_resources_files();
   auto to_return = std::make_unique<ResourcesPbFile>(ResourcesPbFile());
-  for (const auto& res_pb_file_path : res_pb_file_paths) {
-    to_return->collect_resource_data_for_file(res_pb_file_path);
+  // Parse the modules in parallel, and then collect their data in order.
+  std::vector<std::unique_ptr<google::protobuf::Arena>> arenas;
+  std::vector<aapt::pb::ResourceTable*> tables(res_pb_file_paths.size());
+  std::vector<size_t> indices;
+  for (size_t i = 0; i < res_pb_file_paths.size(); ++i) {
+    arenas.push_back(std::make_unique<google::protobuf::Arena>());
+    indices.push_back(i);
+  }
+  workqueue_run<size_t>(
+      [&](size_t i) {
+        tables[i] = read_resource_table(res_pb_file_paths[i], arenas[i].get());
+      },
+      indices);
+  for (size_t i = 0; i < res_pb_file_paths.size(); ++i) {
+    to_return->collect_resource_data(res_pb_file_paths[i], *tables[i]);
   }
   return to_return;
 }
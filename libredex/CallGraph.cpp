@@ -7,6 +7,9 @@
 
 #include "CallGraph.h"
 
+#include <algorithm>
+#include <limits>
+#include <numeric>
 #include <utility>
 
 #include "ConcurrentContainers.h"
@@ -14,6 +17,7 @@
 #include "Show.h"
 #include "Trace.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 namespace mog = method_override_graph;
 
@@ -198,7 +202,7 @@ CompleteCallGraphStrategy::CompleteCallGraphStrategy(
 
 DexMethod* resolve_interface_virtual_callee(const IRInstruction* insn,
                                             const DexMethod* caller,
-                                            MethodRefCache& ref_cache,
+                                            ConcurrentMethodRefCache& ref_cache,
                                             bool use_cache) {
   DexMethod* callee = nullptr;
   if (opcode_to_search(insn) == MethodSearch::Virtual) {
@@ -479,6 +483,93 @@ void Graph::add_edge(const NodeId& caller,
   callee->m_predecessors.emplace_back(edge);
 }
 
+CompactGraph::CompactGraph(const BuildStrategy& strat)
+    : m_methods{nullptr, nullptr} {
+  auto root_and_dynamic = strat.get_roots();
+  const auto& roots = root_and_dynamic.roots;
+  m_dynamic_methods = std::move(root_and_dynamic.dynamic_methods);
+
+  // Methods are numbered in breadth-first order from the roots, and the
+  // callsites of each level are computed in parallel. callsites[i] holds the
+  // callsites of the node i + 2.
+  std::vector<CallSites> callsites;
+  std::vector<const DexMethod*> frontier;
+  auto make_node = [&](const DexMethod* m) {
+    auto pair = m_nodes.emplace(m, m_methods.size());
+    if (pair.second) {
+      m_methods.push_back(m);
+      frontier.push_back(m);
+    }
+    return pair.first->second;
+  };
+  for (const DexMethod* root : roots) {
+    make_node(root);
+  }
+  while (!frontier.empty()) {
+    auto level = std::move(frontier);
+    frontier.clear();
+    size_t first = callsites.size();
+    callsites.resize(first + level.size());
+    std::vector<size_t> indices(level.size());
+    std::iota(indices.begin(), indices.end(), 0);
+    workqueue_run<size_t>(
+        [&](size_t i) { callsites[first + i] = strat.get_callsites(level[i]); },
+        indices);
+    for (size_t i = 0; i < level.size(); ++i) {
+      for (const auto& callsite : callsites[first + i]) {
+        make_node(callsite.callee);
+      }
+    }
+  }
+
+  // Lay out the edges by caller.
+  size_t num_edges = roots.size();
+  for (const auto& method_callsites : callsites) {
+    num_edges += std::max<size_t>(method_callsites.size(), 1);
+  }
+  always_assert(num_edges <= std::numeric_limits<EdgeId>::max());
+  m_callers.reserve(num_edges);
+  m_callees.reserve(num_edges);
+  m_invoke_insns.reserve(num_edges);
+  m_callee_offsets.reserve(m_methods.size() + 1);
+  auto add_edge = [&](NodeId caller, NodeId callee, IRInstruction* insn) {
+    m_callers.push_back(caller);
+    m_callees.push_back(callee);
+    m_invoke_insns.push_back(insn);
+  };
+  m_callee_offsets.push_back(0);
+  for (const DexMethod* root : roots) {
+    add_edge(ENTRY, m_nodes.at(root), nullptr);
+  }
+  m_callee_offsets.push_back(m_callers.size());
+  // The exit node has no callees.
+  m_callee_offsets.push_back(m_callers.size());
+  for (size_t i = 0; i < callsites.size(); ++i) {
+    NodeId caller = i + 2;
+    if (callsites[i].empty()) {
+      add_edge(caller, EXIT, nullptr);
+    }
+    for (const auto& callsite : callsites[i]) {
+      add_edge(caller, m_nodes.at(callsite.callee), callsite.invoke_insn);
+    }
+    m_callee_offsets.push_back(m_callers.size());
+  }
+  callsites.clear();
+
+  // Group the edges by callee, in increasing order of edge ids.
+  m_caller_offsets.assign(m_methods.size() + 1, 0);
+  for (NodeId callee : m_callees) {
+    ++m_caller_offsets[callee + 1];
+  }
+  std::partial_sum(m_caller_offsets.begin(), m_caller_offsets.end(),
+                   m_caller_offsets.begin());
+  m_caller_edges.resize(num_edges);
+  auto next = m_caller_offsets;
+  for (EdgeId e = 0; e < num_edges; ++e) {
+    m_caller_edges[next[m_callees[e]]++] = e;
+  }
+}
+
 MethodSet resolve_callees_in_graph(const Graph& graph,
                                    const DexMethod* method,
                                    const IRInstruction* insn) {
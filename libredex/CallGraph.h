@@ -8,6 +8,10 @@
 #pragma once
 
 #include <unordered_map>
+#include <vector>
+
+#include <boost/iterator/counting_iterator.hpp>
+#include <boost/range/iterator_range.hpp>
 
 #include "DexClass.h"
 #include "IRCode.h"
@@ -70,6 +74,9 @@ struct RootAndDynamic {
  * recursively until the graph is fully mapped out. One can think of the
  * BuildStrategy as implicitly encoding the graph structure, with the Graph
  * constructor reifying it.
+ *
+ * CompactGraph calls get_callsites() concurrently, hence it must be
+ * thread-safe.
  */
 class BuildStrategy {
  public:
@@ -192,7 +199,7 @@ class SingleCalleeStrategy : public BuildStrategy {
 
   const Scope& m_scope;
   std::unordered_set<DexMethod*> m_non_virtual;
-  mutable MethodRefCache m_resolved_refs;
+  mutable ConcurrentMethodRefCache m_resolved_refs;
 };
 
 class MultipleCalleeBaseStrategy : public SingleCalleeStrategy {
@@ -257,6 +264,109 @@ class GraphInterface {
   }
 };
 
+/*
+ * An immutable call graph in compressed sparse row form. Nodes and edges are
+ * dense integer ids, and the callees and the callers of a node are contiguous
+ * ranges of edges. This makes it much smaller and faster to traverse than
+ * Graph, which allocates every node and edge separately. Like in Graph, the
+ * ghost entry node has an edge to every root, and methods without callsites
+ * have an edge to the ghost exit node.
+ *
+ * The callsites of the methods are computed in parallel.
+ */
+class CompactGraph final {
+ public:
+  using NodeId = uint32_t;
+  using EdgeId = uint32_t;
+  using Callees = boost::iterator_range<boost::counting_iterator<EdgeId>>;
+  using Callers = boost::iterator_range<const EdgeId*>;
+
+  explicit CompactGraph(const BuildStrategy&);
+
+  NodeId entry() const { return ENTRY; }
+  NodeId exit() const { return EXIT; }
+
+  size_t num_nodes() const { return m_methods.size(); }
+  size_t num_edges() const { return m_callees.size(); }
+
+  bool has_node(const DexMethod* m) const { return m_nodes.count(m) != 0; }
+
+  NodeId node(const DexMethod* m) const {
+    if (m == nullptr) {
+      return ENTRY;
+    }
+    return m_nodes.at(m);
+  }
+
+  // Returns nullptr for the ghost nodes.
+  const DexMethod* method(NodeId n) const { return m_methods[n]; }
+
+  Callees callees(NodeId n) const {
+    return boost::make_iterator_range(
+        boost::counting_iterator<EdgeId>(m_callee_offsets[n]),
+        boost::counting_iterator<EdgeId>(m_callee_offsets[n + 1]));
+  }
+
+  Callers callers(NodeId n) const {
+    return boost::make_iterator_range(
+        m_caller_edges.data() + m_caller_offsets[n],
+        m_caller_edges.data() + m_caller_offsets[n + 1]);
+  }
+
+  NodeId caller(EdgeId e) const { return m_callers[e]; }
+  NodeId callee(EdgeId e) const { return m_callees[e]; }
+  // Returns nullptr for the edges from the entry node and to the exit node.
+  IRInstruction* invoke_insn(EdgeId e) const { return m_invoke_insns[e]; }
+
+  const std::unordered_set<const DexMethod*>& get_dynamic_methods() const {
+    return m_dynamic_methods;
+  }
+
+ private:
+  static constexpr NodeId ENTRY = 0;
+  static constexpr NodeId EXIT = 1;
+
+  std::vector<const DexMethod*> m_methods;
+  std::unordered_map<const DexMethod*, NodeId> m_nodes;
+  // Edges are sorted by caller: the callees of node n are the edges in
+  // [m_callee_offsets[n], m_callee_offsets[n + 1]).
+  std::vector<EdgeId> m_callee_offsets;
+  std::vector<NodeId> m_callers;
+  std::vector<NodeId> m_callees;
+  std::vector<IRInstruction*> m_invoke_insns;
+  // The callers of node n are the edges listed in m_caller_edges between
+  // m_caller_offsets[n] and m_caller_offsets[n + 1].
+  std::vector<EdgeId> m_caller_offsets;
+  std::vector<EdgeId> m_caller_edges;
+  // See Graph::m_dynamic_methods.
+  std::unordered_set<const DexMethod*> m_dynamic_methods;
+};
+
+// The counterpart of GraphInterface for compact call graphs.
+class CompactGraphInterface {
+ public:
+  using Graph = call_graph::CompactGraph;
+  using NodeId = CompactGraph::NodeId;
+  using EdgeId = CompactGraph::EdgeId;
+
+  static NodeId entry(const Graph& graph) { return graph.entry(); }
+  static NodeId exit(const Graph& graph) { return graph.exit(); }
+  static CompactGraph::Callers predecessors(const Graph& graph,
+                                            const NodeId& m) {
+    return graph.callers(m);
+  }
+  static CompactGraph::Callees successors(const Graph& graph,
+                                          const NodeId& m) {
+    return graph.callees(m);
+  }
+  static NodeId source(const Graph& graph, const EdgeId& e) {
+    return graph.caller(e);
+  }
+  static NodeId target(const Graph& graph, const EdgeId& e) {
+    return graph.callee(e);
+  }
+};
+
 MethodSet resolve_callees_in_graph(const Graph& graph,
                                    const DexMethod* method,
                                    const IRInstruction* insn);
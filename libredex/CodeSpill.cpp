@@ -0,0 +1,644 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "CodeSpill.h"
+
+#include <algorithm>
+#include <array>
+#include <boost/filesystem.hpp>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "Debug.h"
+#include "DexDebugInstruction.h"
+#include "DexPosition.h"
+#include "IRCode.h"
+#include "IRInstruction.h"
+#include "IRList.h"
+#include "Trace.h"
+#include "Walkers.h"
+
+namespace code_spill {
+namespace impl {
+
+class MethodAccess {
+ public:
+  static std::atomic<uint32_t>& global_epoch() {
+    return DexMethod::s_code_epoch;
+  }
+
+  static uint32_t epoch(const DexMethod* method) {
+    return method->m_code_epoch.load(std::memory_order_relaxed);
+  }
+
+  static bool is_spilled(const DexMethod* method) {
+    return method->m_code_spilled.load(std::memory_order_acquire);
+  }
+
+  // Does not load spilled code.
+  static IRCode* code(const DexMethod* method) { return method->m_code.get(); }
+
+  static std::unique_ptr<IRCode> spill(DexMethod* method) {
+    method->m_code_spilled.store(true, std::memory_order_release);
+    return std::move(method->m_code);
+  }
+
+  static void restore(DexMethod* method, std::unique_ptr<IRCode> code) {
+    method->m_code = std::move(code);
+    method->m_code_spilled.store(false, std::memory_order_release);
+  }
+
+  static void forget(const DexMethod* method) {
+    method->m_code_spilled.store(false, std::memory_order_release);
+  }
+};
+
+} // namespace impl
+
+namespace {
+
+using impl::MethodAccess;
+
+/*
+ * The serialized form of a body is its list of entries, in order. Entries
+ * refer to each other by index, and to interned entities (types, strings,
+ * members, ...) and `DexOpcodeData` by address. Debug instructions and the
+ * debug item are rare and polymorphic, so they stay in memory.
+ */
+struct Record {
+  uint64_t offset{0};
+  uint64_t size{0};
+  size_t footprint{0};
+  std::unique_ptr<DexDebugItem> dbg;
+  std::vector<std::unique_ptr<DexDebugInstruction>> dbg_ops;
+};
+
+constexpr uint32_t kNoIndex = std::numeric_limits<uint32_t>::max();
+
+enum ParentKind : uint8_t { NO_PARENT, LOCAL_PARENT, FOREIGN_PARENT };
+
+class Writer {
+ public:
+  template <typename T>
+  void put(T value) {
+    static_assert(std::is_trivially_copyable<T>::value, "");
+    m_data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  void put_ptr(const void* ptr) { put(reinterpret_cast<uintptr_t>(ptr)); }
+
+  std::string& data() { return m_data; }
+
+ private:
+  std::string m_data;
+};
+
+class Reader {
+ public:
+  explicit Reader(const std::string& data)
+      : m_pos(data.data()), m_end(data.data() + data.size()) {}
+
+  template <typename T>
+  T get() {
+    static_assert(std::is_trivially_copyable<T>::value, "");
+    always_assert(m_pos + sizeof(T) <= m_end);
+    T value;
+    memcpy(&value, m_pos, sizeof(T));
+    m_pos += sizeof(T);
+    return value;
+  }
+
+  template <typename T>
+  T* get_ptr() {
+    return reinterpret_cast<T*>(get<uintptr_t>());
+  }
+
+  bool done() const { return m_pos == m_end; }
+
+ private:
+  const char* m_pos;
+  const char* m_end;
+};
+
+bool can_spill(const IRCode* code) {
+  if (code == nullptr || code->cfg_built()) {
+    return false;
+  }
+  for (const auto& mie : *code) {
+    if (mie.type == MFLOW_DEX_OPCODE) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void serialize_insn(const IRInstruction* insn, Writer* out) {
+  auto op = insn->opcode();
+  out->put<uint16_t>(op);
+  out->put<reg_t>(insn->has_dest() ? insn->dest() : 0);
+  out->put<uint32_t>(insn->srcs_size());
+  for (auto src : insn->srcs()) {
+    out->put<reg_t>(src);
+  }
+  switch (opcode::ref(op)) {
+  case opcode::Ref::None:
+    break;
+  case opcode::Ref::Literal:
+    out->put<int64_t>(insn->get_literal());
+    break;
+  case opcode::Ref::String:
+    out->put_ptr(insn->get_string());
+    break;
+  case opcode::Ref::Type:
+    out->put_ptr(insn->get_type());
+    break;
+  case opcode::Ref::Field:
+    out->put_ptr(insn->get_field());
+    break;
+  case opcode::Ref::Method:
+    out->put_ptr(insn->get_method());
+    break;
+  case opcode::Ref::CallSite:
+    out->put_ptr(insn->get_callsite());
+    break;
+  case opcode::Ref::MethodHandle:
+    out->put_ptr(insn->get_methodhandle());
+    break;
+  case opcode::Ref::Data:
+    out->put_ptr(insn->get_data());
+    break;
+  }
+}
+
+IRInstruction* deserialize_insn(Reader* in) {
+  auto op = static_cast<IROpcode>(in->get<uint16_t>());
+  auto* insn = new IRInstruction(op);
+  auto dest = in->get<reg_t>();
+  if (insn->has_dest()) {
+    insn->set_dest(dest);
+  }
+  auto num_srcs = in->get<uint32_t>();
+  insn->set_srcs_size(num_srcs);
+  for (uint32_t i = 0; i < num_srcs; ++i) {
+    insn->set_src(i, in->get<reg_t>());
+  }
+  switch (opcode::ref(op)) {
+  case opcode::Ref::None:
+    break;
+  case opcode::Ref::Literal:
+    insn->set_literal(in->get<int64_t>());
+    break;
+  case opcode::Ref::String:
+    insn->set_string(in->get_ptr<DexString>());
+    break;
+  case opcode::Ref::Type:
+    insn->set_type(in->get_ptr<DexType>());
+    break;
+  case opcode::Ref::Field:
+    insn->set_field(in->get_ptr<DexFieldRef>());
+    break;
+  case opcode::Ref::Method:
+    insn->set_method(in->get_ptr<DexMethodRef>());
+    break;
+  case opcode::Ref::CallSite:
+    insn->set_callsite(in->get_ptr<DexCallSite>());
+    break;
+  case opcode::Ref::MethodHandle:
+    insn->set_methodhandle(in->get_ptr<DexMethodHandle>());
+    break;
+  case opcode::Ref::Data:
+    insn->set_data(in->get_ptr<DexOpcodeData>());
+    break;
+  }
+  return insn;
+}
+
+/*
+ * Serializes `code`, and moves the parts that stay in memory into `record`.
+ * Returns an estimate of the memory held by the entries.
+ */
+size_t serialize(IRCode* code, Writer* out, Record* record) {
+  std::unordered_map<const MethodItemEntry*, uint32_t> indices;
+  std::unordered_map<const DexPosition*, uint32_t> position_indices;
+  for (const auto& mie : *code) {
+    auto idx = indices.size();
+    indices.emplace(&mie, idx);
+    if (mie.type == MFLOW_POSITION) {
+      position_indices.emplace(mie.pos.get(), idx);
+    }
+  }
+  auto index_of = [&](const MethodItemEntry* mie) {
+    if (mie == nullptr) {
+      return kNoIndex;
+    }
+    auto it = indices.find(mie);
+    always_assert_log(it != indices.end(), "Entry refers to another method");
+    return it->second;
+  };
+
+  size_t footprint = 0;
+  out->put<reg_t>(code->get_registers_size());
+  out->put<uint32_t>(indices.size());
+  for (auto& mie : *code) {
+    footprint += sizeof(MethodItemEntry);
+    out->put<uint8_t>(mie.type);
+    switch (mie.type) {
+    case MFLOW_TRY:
+      footprint += sizeof(TryEntry);
+      out->put<uint8_t>(mie.tentry->type);
+      out->put<uint32_t>(index_of(mie.tentry->catch_start));
+      break;
+    case MFLOW_CATCH:
+      footprint += sizeof(CatchEntry);
+      out->put_ptr(mie.centry->catch_type);
+      out->put<uint32_t>(index_of(mie.centry->next));
+      break;
+    case MFLOW_OPCODE:
+      footprint += sizeof(IRInstruction);
+      serialize_insn(mie.insn, out);
+      break;
+    case MFLOW_TARGET:
+      footprint += sizeof(BranchTarget);
+      out->put<uint8_t>(mie.target->type);
+      out->put<uint32_t>(index_of(mie.target->src));
+      out->put<int32_t>(mie.target->type == BRANCH_MULTI ? mie.target->case_key
+                                                         : 0);
+      break;
+    case MFLOW_DEBUG:
+      out->put<uint32_t>(record->dbg_ops.size());
+      record->dbg_ops.push_back(std::move(mie.dbgop));
+      break;
+    case MFLOW_POSITION: {
+      footprint += sizeof(DexPosition);
+      const auto* pos = mie.pos.get();
+      out->put_ptr(pos->method);
+      out->put_ptr(pos->file);
+      out->put<uint32_t>(pos->line);
+      if (pos->parent == nullptr) {
+        out->put<uint8_t>(NO_PARENT);
+      } else {
+        auto it = position_indices.find(pos->parent);
+        if (it != position_indices.end()) {
+          out->put<uint8_t>(LOCAL_PARENT);
+          out->put<uint32_t>(it->second);
+        } else {
+          out->put<uint8_t>(FOREIGN_PARENT);
+          out->put_ptr(pos->parent);
+        }
+      }
+      break;
+    }
+    case MFLOW_SOURCE_BLOCK: {
+      uint32_t chain_length = 0;
+      for (auto* sb = mie.src_block.get(); sb != nullptr; sb = sb->next.get()) {
+        ++chain_length;
+      }
+      out->put<uint32_t>(chain_length);
+      for (auto* sb = mie.src_block.get(); sb != nullptr; sb = sb->next.get()) {
+        footprint += sizeof(SourceBlock) + sb->vals.size() * sizeof(sb->vals[0]);
+        out->put_ptr(sb->src);
+        out->put<uint32_t>(sb->id);
+        out->put<uint32_t>(sb->vals.size());
+        for (const auto& val : sb->vals) {
+          auto none = std::numeric_limits<float>::quiet_NaN();
+          out->put<float>(val ? val->val : none);
+          out->put<float>(val ? val->appear100 : none);
+        }
+      }
+      break;
+    }
+    case MFLOW_FALLTHROUGH:
+      break;
+    case MFLOW_DEX_OPCODE:
+      not_reached_log("Cannot spill lowered code");
+    }
+  }
+  record->dbg = code->release_debug_item();
+  return footprint;
+}
+
+std::unique_ptr<IRCode> deserialize(const std::string& data, Record* record) {
+  Reader in(data);
+  auto code = std::make_unique<IRCode>();
+  code->set_registers_size(in.get<reg_t>());
+  auto num_entries = in.get<uint32_t>();
+
+  std::vector<MethodItemEntry*> entries;
+  entries.reserve(num_entries);
+  // Entries may refer to later ones, so resolve references at the end.
+  std::vector<std::pair<MethodItemEntry**, uint32_t>> fixups;
+  std::vector<std::pair<DexPosition*, uint32_t>> parent_fixups;
+  for (uint32_t i = 0; i < num_entries; ++i) {
+    auto type = static_cast<MethodItemType>(in.get<uint8_t>());
+    MethodItemEntry* mie;
+    switch (type) {
+    case MFLOW_TRY: {
+      auto try_type = static_cast<TryEntryType>(in.get<uint8_t>());
+      mie = new MethodItemEntry();
+      mie->type = MFLOW_TRY;
+      mie->tentry = new TryEntry(try_type, /* placeholder */ mie);
+      fixups.emplace_back(&mie->tentry->catch_start, in.get<uint32_t>());
+      break;
+    }
+    case MFLOW_CATCH:
+      mie = new MethodItemEntry(in.get_ptr<DexType>());
+      fixups.emplace_back(&mie->centry->next, in.get<uint32_t>());
+      break;
+    case MFLOW_OPCODE:
+      mie = new MethodItemEntry(deserialize_insn(&in));
+      break;
+    case MFLOW_TARGET: {
+      auto* target = new BranchTarget();
+      target->type = static_cast<BranchTargetType>(in.get<uint8_t>());
+      fixups.emplace_back(&target->src, in.get<uint32_t>());
+      target->case_key = in.get<int32_t>();
+      mie = new MethodItemEntry(target);
+      break;
+    }
+    case MFLOW_DEBUG:
+      mie = new MethodItemEntry(
+          std::move(record->dbg_ops.at(in.get<uint32_t>())));
+      break;
+    case MFLOW_POSITION: {
+      auto* method = in.get_ptr<DexString>();
+      auto* file = in.get_ptr<DexString>();
+      auto pos = std::make_unique<DexPosition>(method, file, in.get<uint32_t>());
+      switch (in.get<uint8_t>()) {
+      case NO_PARENT:
+        break;
+      case LOCAL_PARENT:
+        parent_fixups.emplace_back(pos.get(), in.get<uint32_t>());
+        break;
+      case FOREIGN_PARENT:
+        pos->parent = in.get_ptr<DexPosition>();
+        break;
+      default:
+        not_reached();
+      }
+      mie = new MethodItemEntry(std::move(pos));
+      break;
+    }
+    case MFLOW_SOURCE_BLOCK: {
+      auto chain_length = in.get<uint32_t>();
+      always_assert(chain_length > 0);
+      std::unique_ptr<SourceBlock> head;
+      auto* tail = &head;
+      for (uint32_t j = 0; j < chain_length; ++j) {
+        auto* src = in.get_ptr<DexMethodRef>();
+        auto id = in.get<uint32_t>();
+        std::vector<SourceBlock::Val> vals;
+        auto num_vals = in.get<uint32_t>();
+        vals.reserve(num_vals);
+        for (uint32_t k = 0; k < num_vals; ++k) {
+          auto val = in.get<float>();
+          vals.emplace_back(val, in.get<float>());
+        }
+        *tail = std::make_unique<SourceBlock>(src, id, std::move(vals));
+        tail = &(*tail)->next;
+      }
+      mie = new MethodItemEntry(std::move(head));
+      break;
+    }
+    case MFLOW_FALLTHROUGH:
+      mie = new MethodItemEntry();
+      break;
+    default:
+      not_reached_log("Corrupt spill record");
+    }
+    entries.push_back(mie);
+    code->push_back(*mie);
+  }
+  always_assert(in.done());
+
+  for (const auto& fixup : fixups) {
+    *fixup.first =
+        fixup.second == kNoIndex ? nullptr : entries.at(fixup.second);
+  }
+  for (const auto& fixup : parent_fixups) {
+    auto* parent = entries.at(fixup.second);
+    always_assert(parent->type == MFLOW_POSITION);
+    fixup.first->parent = parent->pos.get();
+  }
+  code->set_debug_item(std::move(record->dbg));
+  return code;
+}
+
+class Spiller {
+ public:
+  Spiller(uint64_t rss_budget, boost::filesystem::path path)
+      : m_rss_budget(rss_budget), m_path(std::move(path)) {
+    m_file.open(m_path.string(), std::ios::in | std::ios::out |
+                                     std::ios::binary | std::ios::trunc);
+    always_assert_log(m_file.is_open(), "Cannot open spill file %s",
+                      m_path.string().c_str());
+  }
+
+  ~Spiller() {
+    m_file.close();
+    boost::system::error_code ec;
+    boost::filesystem::remove(m_path, ec);
+  }
+
+  void maybe_spill(const DexStoresVector& stores) {
+    auto rss = get_mem_stats().vm_rss;
+    // Bodies that have been freed left room in the IR allocators, which new
+    // IR will fill before the RSS grows again.
+    auto limit = m_rss_budget + m_freed_estimate;
+    if (rss <= limit) {
+      return;
+    }
+    auto need = rss - limit;
+
+    auto now = MethodAccess::global_epoch().load();
+    std::vector<std::pair<uint32_t, DexMethod*>> candidates;
+    walk::methods(build_class_scope(stores), [&](DexMethod* method) {
+      auto epoch = MethodAccess::epoch(method);
+      if (epoch < now && !MethodAccess::is_spilled(method) &&
+          can_spill(MethodAccess::code(method))) {
+        candidates.emplace_back(epoch, method);
+      }
+    });
+    std::stable_sort(
+        candidates.begin(), candidates.end(),
+        [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    size_t freed = 0;
+    size_t spilled = 0;
+    for (const auto& candidate : candidates) {
+      if (freed >= need) {
+        break;
+      }
+      freed += spill(candidate.second);
+      ++spilled;
+    }
+    TRACE(PM, 1,
+          "Spilled %zu of %zu candidate method bodies (~%zu MB) with an RSS of "
+          "%zu MB",
+          spilled, candidates.size(), freed >> 20, size_t(rss >> 20));
+  }
+
+  void reload(DexMethod* method) {
+    std::lock_guard<std::mutex> method_lock(method_mutex(method));
+    if (!MethodAccess::is_spilled(method)) {
+      // Another thread got here first.
+      return;
+    }
+    Record record;
+    std::string data;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      auto it = m_records.find(method);
+      always_assert(it != m_records.end());
+      record = std::move(it->second);
+      m_records.erase(it);
+      data.resize(record.size);
+      m_file.seekg(record.offset);
+      m_file.read(&data[0], record.size);
+      always_assert_log(m_file.good(), "Cannot read spill file");
+      m_freed_estimate -= std::min<uint64_t>(m_freed_estimate, record.footprint);
+      ++m_stats.reloaded;
+    }
+    MethodAccess::restore(method, deserialize(data, &record));
+  }
+
+  void discard(const DexMethod* method) {
+    std::lock_guard<std::mutex> method_lock(method_mutex(method));
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_records.find(method);
+    if (it != m_records.end()) {
+      m_freed_estimate -=
+          std::min<uint64_t>(m_freed_estimate, it->second.footprint);
+      m_records.erase(it);
+    }
+    MethodAccess::forget(method);
+  }
+
+  void reload_all() {
+    std::vector<DexMethod*> methods;
+    methods.reserve(m_records.size());
+    for (const auto& pair : m_records) {
+      methods.push_back(const_cast<DexMethod*>(pair.first));
+    }
+    for (auto* method : methods) {
+      reload(method);
+    }
+  }
+
+  Stats get_stats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+  }
+
+ private:
+  // Only called between passes, so no other thread touches the IR.
+  size_t spill(DexMethod* method) {
+    auto code = MethodAccess::spill(method);
+    Record record;
+    Writer out;
+    record.footprint = serialize(code.get(), &out, &record);
+    code.reset();
+
+    const auto& data = out.data();
+    record.offset = m_file_size;
+    record.size = data.size();
+    m_file.seekp(m_file_size);
+    m_file.write(data.data(), data.size());
+    always_assert_log(m_file.good(), "Cannot write spill file");
+    m_file_size += data.size();
+
+    auto footprint = record.footprint;
+    m_freed_estimate += footprint;
+    ++m_stats.spilled;
+    m_stats.spilled_bytes += data.size();
+    m_records.emplace(method, std::move(record));
+    return footprint;
+  }
+
+  std::mutex& method_mutex(const DexMethod* method) {
+    return m_method_mutexes[std::hash<const DexMethod*>()(method) %
+                            m_method_mutexes.size()];
+  }
+
+  const uint64_t m_rss_budget;
+  const boost::filesystem::path m_path;
+  // Guards everything below.
+  std::mutex m_mutex;
+  std::fstream m_file;
+  uint64_t m_file_size{0};
+  uint64_t m_freed_estimate{0};
+  std::unordered_map<const DexMethod*, Record> m_records;
+  Stats m_stats;
+  // Serialize the loading of each method.
+  std::array<std::mutex, 64> m_method_mutexes;
+};
+
+std::unique_ptr<Spiller> s_spiller;
+
+} // namespace
+
+void enable(uint64_t rss_budget, const std::string& dir) {
+  always_assert(!s_spiller);
+  auto path = dir.empty() ? boost::filesystem::temp_directory_path()
+                          : boost::filesystem::path(dir);
+  path /= boost::filesystem::unique_path("redex-code-spill-%%%%-%%%%-%%%%");
+  s_spiller = std::make_unique<Spiller>(rss_budget, std::move(path));
+  MethodAccess::global_epoch().store(1);
+}
+
+bool enabled() { return s_spiller != nullptr; }
+
+void begin_epoch() {
+  always_assert(s_spiller);
+  MethodAccess::global_epoch().fetch_add(1);
+}
+
+void maybe_spill(const DexStoresVector& stores) {
+  always_assert(s_spiller);
+  s_spiller->maybe_spill(stores);
+}
+
+void disable() {
+  if (!s_spiller) {
+    return;
+  }
+  s_spiller->reload_all();
+  auto stats = s_spiller->get_stats();
+  TRACE(PM, 1, "Spilled %zu method bodies (%zu MB), reloaded %zu",
+        stats.spilled, stats.spilled_bytes >> 20, stats.reloaded);
+  MethodAccess::global_epoch().store(0);
+  s_spiller.reset();
+}
+
+Stats get_stats() {
+  always_assert(s_spiller);
+  return s_spiller->get_stats();
+}
+
+const IRCode* peek_code(const DexMethod* method) {
+  return MethodAccess::code(method);
+}
+
+namespace impl {
+
+void reload(DexMethod* method) {
+  always_assert(s_spiller);
+  s_spiller->reload(method);
+}
+
+void discard(const DexMethod* method) {
+  if (s_spiller) {
+    s_spiller->discard(method);
+  }
+}
+
+} // namespace impl
+
+} // namespace code_spill
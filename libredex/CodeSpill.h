@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "DexClass.h"
+#include "DexStore.h"
+
+/*
+ * Keeps the IR of an optimization run within a resident memory budget by
+ * spilling the bodies of cold methods to disk.
+ *
+ * Time is measured in epochs, one per pass. Before each pass, if the RSS of
+ * the process exceeds the budget, the `IRCode` of the methods that have been
+ * used least recently is serialized into a private, append-only spill file
+ * and freed. Any access through `DexMethod::get_code()` transparently loads
+ * the body again, with fresh IR objects. Only the process that spilled a body
+ * can load it, as the spill format refers to interned Dex entities by
+ * address.
+ *
+ * Methods with a CFG built are never spilled. The IR allocators keep freed
+ * memory for reuse rather than returning it, so spilling mostly stops the RSS
+ * from growing instead of shrinking it; the budget accounts for that.
+ */
+namespace code_spill {
+
+struct Stats {
+  size_t spilled{0};
+  size_t reloaded{0};
+  size_t spilled_bytes{0};
+};
+
+/*
+ * Turns spilling on. `dir` holds the spill file; the system temporary
+ * directory is used when it is empty.
+ */
+void enable(uint64_t rss_budget, const std::string& dir);
+
+bool enabled();
+
+/*
+ * Starts a new epoch. Every body used from now on counts as used in it.
+ */
+void begin_epoch();
+
+/*
+ * Spills bodies, least recently used first, if the process is over budget.
+ * Not thread-safe; no other thread may access the IR concurrently.
+ */
+void maybe_spill(const DexStoresVector& stores);
+
+/*
+ * Loads all spilled bodies back into memory and turns spilling off.
+ */
+void disable();
+
+Stats get_stats();
+
+/*
+ * The code of `method` if it is in memory, without loading it or counting as
+ * a use. For checks that look at all methods.
+ */
+const IRCode* peek_code(const DexMethod* method);
+
+namespace impl {
+
+// Called by `DexMethod` only.
+void reload(DexMethod* method);
+void discard(const DexMethod* method);
+
+} // namespace impl
+
+} // namespace code_spill
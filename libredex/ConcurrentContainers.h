@@ -10,13 +10,17 @@
 #include <functional>
 #include <initializer_list>
 #include <iterator>
+#include <numeric>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include <boost/thread.hpp>
 
 #include "Debug.h"
+#include "FlatHashTable.h"
+#include "WorkQueue.h"
 
 // Forward declaration.
 namespace cc_impl {
@@ -158,6 +162,54 @@ class ConcurrentContainer {
     return get_lock(slot);
   }
 
+  /*
+   * Applies `fn` to every element, running the slots in parallel on the work
+   * queue. All elements of a slot are visited by the same thread, in the
+   * order of the slot. This operation is not thread-safe.
+   */
+  template <typename Fn>
+  void parallel_for_each(const Fn& fn) {
+    run_on_slots([&](size_t slot) {
+      for (auto& elem : m_slots[slot]) {
+        fn(elem);
+      }
+    });
+  }
+
+  template <typename Fn>
+  void parallel_for_each(const Fn& fn) const {
+    run_on_slots([&](size_t slot) {
+      for (const auto& elem : m_slots[slot]) {
+        fn(elem);
+      }
+    });
+  }
+
+  /*
+   * Maps every element with `map_fn` and combines the results with
+   * `reduce_fn`, starting from `identity`, which must be the neutral element
+   * of `reduce_fn`. Each slot is reduced in parallel on the work queue, and
+   * the results of the slots are then combined in slot order. This operation
+   * is not thread-safe.
+   */
+  template <typename T, typename MapFn, typename ReduceFn>
+  T reduce(const MapFn& map_fn,
+           const ReduceFn& reduce_fn,
+           const T& identity) const {
+    std::vector<T> results(n_slots, identity);
+    run_on_slots([&](size_t slot) {
+      auto& result = results[slot];
+      for (const auto& elem : m_slots[slot]) {
+        result = reduce_fn(std::move(result), map_fn(elem));
+      }
+    });
+    T result = identity;
+    for (auto& slot_result : results) {
+      result = reduce_fn(std::move(result), std::move(slot_result));
+    }
+    return result;
+  }
+
  protected:
   // Only derived classes may be instantiated or copied.
   ConcurrentContainer() = default;
@@ -180,6 +232,30 @@ class ConcurrentContainer {
 
   boost::mutex& get_lock(size_t slot) const { return m_locks[slot]; }
 
+  // Moves all elements into a vector, slot after slot, and leaves the
+  // container empty.
+  template <typename T>
+  std::vector<T> move_elements_to_vector() {
+    std::vector<T> elems;
+    elems.reserve(size());
+    for (size_t slot = 0; slot < n_slots; ++slot) {
+      auto& container = m_slots[slot];
+      for (auto& elem : container) {
+        elems.emplace_back(std::move(elem));
+      }
+      container.clear();
+    }
+    return elems;
+  }
+
+ private:
+  template <typename Fn>
+  void run_on_slots(const Fn& fn) const {
+    std::vector<size_t> slots(n_slots);
+    std::iota(slots.begin(), slots.end(), 0);
+    workqueue_run<size_t>(fn, slots);
+  }
+
  protected:
   mutable boost::mutex m_locks[n_slots];
   Container m_slots[n_slots];
@@ -382,6 +458,17 @@ class ConcurrentMapContainer
       updater(it->first, it->second, true);
     }
   }
+
+  /*
+   * Moves all entries into a vector, without building another hash table,
+   * and leaves the map empty. The values are moved, the keys are copied.
+   * This operation is not thread-safe.
+   */
+  std::vector<std::pair<typename MapContainer::key_type, Value>>
+  move_to_vector() {
+    return this->template move_elements_to_vector<
+        std::pair<typename MapContainer::key_type, Value>>();
+  }
 };
 
 template <typename Key,
@@ -397,29 +484,40 @@ using ConcurrentMap =
                            Identity,
                            n_slots>;
 
+/*
+ * Like ConcurrentMap, but with flat open-addressing hash tables as slots,
+ * which take less memory and make lookups cheaper. Insertions may move the
+ * entries of a slot, so references obtained through `find()`, `at_unsafe()`
+ * or the iterators must not be held while the map is being modified.
+ */
 template <typename Key,
+          typename Value,
           typename Hash = std::hash<Key>,
           typename Equal = std::equal_to<Key>,
           size_t n_slots = 31>
-class ConcurrentSet final
-    : public ConcurrentContainer<std::unordered_set<Key, Hash, Equal>,
-                                 Key,
-                                 Hash,
-                                 n_slots> {
+using FlatConcurrentMap =
+    ConcurrentMapContainer<FlatHashMap<Key, Value, Hash, Equal>,
+                           Key,
+                           Value,
+                           Hash,
+                           Identity,
+                           n_slots>;
+
+// A concurrent container with set semantics.
+template <typename SetContainer,
+          typename Key,
+          typename Hash = std::hash<Key>,
+          size_t n_slots = 31>
+class ConcurrentSetContainer final
+    : public ConcurrentContainer<SetContainer, Key, Hash, n_slots> {
  public:
-  ConcurrentSet() = default;
+  ConcurrentSetContainer() = default;
 
-  ConcurrentSet(const ConcurrentSet& set)
-      : ConcurrentContainer<std::unordered_set<Key, Hash, Equal>,
-                            Key,
-                            Hash,
-                            n_slots>(set) {}
+  ConcurrentSetContainer(const ConcurrentSetContainer& set)
+      : ConcurrentContainer<SetContainer, Key, Hash, n_slots>(set) {}
 
-  ConcurrentSet(ConcurrentSet&& set) noexcept
-      : ConcurrentContainer<std::unordered_set<Key, Hash, Equal>,
-                            Key,
-                            Hash,
-                            n_slots>(std::move(set)) {}
+  ConcurrentSetContainer(ConcurrentSetContainer&& set) noexcept
+      : ConcurrentContainer<SetContainer, Key, Hash, n_slots>(std::move(set)) {}
 
   /*
    * The Boolean return value denotes whether the insertion took place.
@@ -462,8 +560,37 @@ class ConcurrentSet final
     auto& set = this->get_container(slot);
     return set.emplace(std::move(key)).second;
   }
+
+  /*
+   * Copies all elements into a vector, without building another hash table,
+   * and leaves the set empty. This operation is not thread-safe.
+   */
+  std::vector<Key> move_to_vector() {
+    return this->template move_elements_to_vector<Key>();
+  }
 };
 
+template <typename Key,
+          typename Hash = std::hash<Key>,
+          typename Equal = std::equal_to<Key>,
+          size_t n_slots = 31>
+using ConcurrentSet =
+    ConcurrentSetContainer<std::unordered_set<Key, Hash, Equal>,
+                           Key,
+                           Hash,
+                           n_slots>;
+
+/*
+ * Like ConcurrentSet, but with flat open-addressing hash tables as slots. As
+ * with FlatConcurrentMap, insertions may move the elements of a slot.
+ */
+template <typename Key,
+          typename Hash = std::hash<Key>,
+          typename Equal = std::equal_to<Key>,
+          size_t n_slots = 31>
+using FlatConcurrentSet =
+    ConcurrentSetContainer<FlatHashSet<Key, Hash, Equal>, Key, Hash, n_slots>;
+
 /**
  * A concurrent set that only accept insertions.
  *
@@ -17,8 +17,10 @@
 #include "DexInstruction.h"
 #include "DexPosition.h"
 #include "DexUtil.h"
+#include "Dominators.h"
 #include "GraphUtil.h"
 #include "IRList.h"
+#include "MonotonicFixpointIterator.h"
 #include "Show.h"
 #include "Trace.h"
 #include "Transform.h"
@@ -76,65 +78,6 @@ bool ends_with_may_throw(cfg::Block* p) {
   return false;
 }
 
-/*
- * Given an method-item-entry ordering, delete positions that are...
- * - duplicates with the previous position, even across block boundaries
- *   (they will get reconstituted when the cfg is rebuild)
- * - adjacent to an immediately following position, as the last position wins.
- * Parent positions are kept as needed.
- */
-void remove_redundant_positions(IRList* ir) {
-  // We build a set of duplicate positions.
-  std::unordered_set<DexPosition*> duplicate_positions;
-  std::unordered_map<DexPosition*, IRList::iterator> positions_to_remove;
-  DexPosition* prev = nullptr;
-  for (auto it = ir->begin(); it != ir->end(); it++) {
-    if (it->type == MFLOW_POSITION) {
-      DexPosition* curr = it->pos.get();
-      positions_to_remove.emplace(curr, it);
-      if (prev != nullptr && *curr == *prev) {
-        duplicate_positions.insert(curr);
-      }
-      prev = curr;
-    }
-  }
-
-  // Backward pass to find positions that are not adjacent to an immediately
-  // following position and must be kept (including their parents).
-  bool keep_prev = false;
-  for (auto it = ir->rbegin(); it != ir->rend(); it++) {
-    switch (it->type) {
-    case MFLOW_OPCODE:
-    case MFLOW_DEX_OPCODE:
-    case MFLOW_TARGET:
-    case MFLOW_TRY:
-    case MFLOW_CATCH:
-      keep_prev = true;
-      break;
-    case MFLOW_POSITION: {
-      DexPosition* curr = it->pos.get();
-      if (keep_prev && !duplicate_positions.count(curr)) {
-        for (auto pos = curr; pos && positions_to_remove.erase(pos);
-             pos = pos->parent) {
-        }
-        keep_prev = false;
-      }
-      break;
-    }
-    case MFLOW_SOURCE_BLOCK:
-    case MFLOW_DEBUG:
-    case MFLOW_FALLTHROUGH:
-      // ignore
-      break;
-    }
-  }
-
-  // Final pass to do the actual deletion.
-  for (auto& p : positions_to_remove) {
-    ir->erase_and_dispose(p.second);
-  }
-}
-
 // Follow the catch entry linked list starting at `first_mie` and check if the
 // throw edges (pointed to by `it`) are equivalent to the linked list. The throw
 // edges should be sorted by their indices.
@@ -988,6 +931,7 @@ std::pair<uint32_t, bool> ControlFlowGraph::remove_unreachable_blocks() {
       // Gotta do this manually for now.
       b->free();
       delete b;
+      invalidate_analyses();
       it = m_blocks.erase(it);
     } else {
       ++it;
@@ -1092,7 +1036,7 @@ void ControlFlowGraph::remove_empty_blocks() {
       }
 
       if (b == entry_block()) {
-        m_entry_block = succ;
+        set_entry_block(succ);
       }
 
       // Move positions if succ doesn't have any
@@ -1139,6 +1083,7 @@ void ControlFlowGraph::remove_empty_blocks() {
     }
     b->free();
     delete b;
+    invalidate_analyses();
     it = m_blocks.erase(it);
   }
   fix_dangling_parents(std::move(dangling));
@@ -1504,6 +1449,7 @@ cfg::InstructionIterator ControlFlowGraph::move_result_of(
 void ControlFlowGraph::deep_copy(ControlFlowGraph* new_cfg) const {
   always_assert(editable());
   new_cfg->clear();
+  new_cfg->invalidate_analyses();
   new_cfg->m_editable = true;
   new_cfg->set_registers_size(this->get_registers_size());
 
@@ -1609,8 +1555,8 @@ std::vector<Block*> ControlFlowGraph::order(
   // map
   std::vector<std::unique_ptr<BlockChain>> chains;
   // keep track of which blocks are in each chain, for quick lookup.
-  std::unordered_map<Block*, BlockChain*> block_to_chain;
-  block_to_chain.reserve(m_blocks.size());
+  std::vector<BlockChain*> block_to_chain(next_block_id(), nullptr);
+  chains.reserve(m_blocks.size());
 
   build_chains(&chains, &block_to_chain);
   auto wto = build_wto(block_to_chain);
@@ -1629,9 +1575,10 @@ std::vector<Block*> ControlFlowGraph::order(
 
 void ControlFlowGraph::build_chains(
     std::vector<std::unique_ptr<BlockChain>>* chains,
-    std::unordered_map<Block*, BlockChain*>* block_to_chain) {
+    std::vector<BlockChain*>* block_to_chain) {
+  auto& chain_of = *block_to_chain;
   auto handle_block = [&](Block* b) {
-    if (block_to_chain->count(b) != 0) {
+    if (chain_of[b->id()] != nullptr) {
       return;
     }
 
@@ -1642,7 +1589,7 @@ void ControlFlowGraph::build_chains(
     chains->push_back(std::move(unique));
 
     chain->push_back(b);
-    block_to_chain->emplace(b, chain);
+    chain_of[b->id()] = chain;
 
     auto goto_edge = get_succ_edge_of_type(b, EDGE_GOTO);
     while (goto_edge != nullptr) {
@@ -1660,20 +1607,22 @@ void ControlFlowGraph::build_chains(
         // instructions (by using fallthroughs) without adding another try
         // region. This is not required, but empirical evidence shows that it
         // generates smaller dex files.
-        const auto& pair = block_to_chain->emplace(goto_block, chain);
-        bool was_already_there = !pair.second;
-        if (was_already_there) {
+        auto*& goto_block_chain = chain_of[goto_block->id()];
+        bool was_already_there = goto_block_chain != nullptr;
+        if (!was_already_there) {
+          goto_block_chain = chain;
+        } else {
           if (goto_block->starts_with_move_result() &&
-              chain != block_to_chain->at(goto_block)) {
+              chain != goto_block_chain) {
             // We cannot allow this to be in a separate chain. The WTO (and its
             // walk) cannot enforce the correct ordering, e.g., it might put a
             // throw block in the middle.
             TRACE(CFG, 5, "Need to collapse goto chain with move result!");
-            auto* goto_chain = block_to_chain->at(goto_block);
+            auto* goto_chain = goto_block_chain;
             redex_assert(goto_chain->at(0) == goto_block);
             for (auto* gcb : *goto_chain) {
               chain->push_back(gcb);
-              (*block_to_chain)[gcb] = chain;
+              chain_of[gcb->id()] = chain;
             }
             auto it = std::find_if(
                 chains->begin(), chains->end(),
@@ -1707,9 +1656,9 @@ void ControlFlowGraph::build_chains(
 }
 
 sparta::WeakTopologicalOrdering<BlockChain*> ControlFlowGraph::build_wto(
-    const std::unordered_map<Block*, BlockChain*>& block_to_chain) {
+    const std::vector<BlockChain*>& block_to_chain) {
   return sparta::WeakTopologicalOrdering<BlockChain*>(
-      block_to_chain.at(entry_block()),
+      block_to_chain.at(entry_block()->id()),
       [&block_to_chain](BlockChain* const& chain) {
         // The chain successor function returns all the outgoing edges' target
         // chains. Where outgoing means that the edge does not go to this chain.
@@ -1732,15 +1681,16 @@ sparta::WeakTopologicalOrdering<BlockChain*> ControlFlowGraph::build_wto(
           for (Edge* e : b->succs()) {
             if (e->target() == next) {
               // The most common intra-chain edge is a GOTO to the very next
-              // block. Let's cheaply detect this case and filter it early,
-              // before we have to do an expensive map lookup.
+              // block. Let's cheaply detect this case and filter it early.
               continue;
             }
-            const auto& succ_chain = block_to_chain.at(e->target());
+            auto* succ_chain = block_to_chain[e->target()->id()];
             // Filter out any edges within this chain. We don't want to
             // erroneously create infinite loops in the chain graph that don't
-            // exist in the block graph.
-            if (succ_chain != chain) {
+            // exist in the block graph. Consecutive edges to the same chain,
+            // e.g. the cases of a switch, only need to be reported once.
+            if (succ_chain != chain &&
+                (result.empty() || result.back() != succ_chain)) {
               result.push_back(succ_chain);
             }
           }
@@ -1833,7 +1783,7 @@ IRList* ControlFlowGraph::linearize(
   for (Block* b : ordering) {
     result->splice(result->end(), b->m_entries);
   }
-  remove_redundant_positions(result);
+  result->remove_redundant_positions();
 
   return result;
 }
@@ -2022,6 +1972,7 @@ ControlFlowGraph::~ControlFlowGraph() {
 Block* ControlFlowGraph::create_block() {
   size_t id = next_block_id();
   Block* b = new Block(this, id);
+  invalidate_analyses();
   m_blocks.emplace(id, b);
   return b;
 }
@@ -2148,6 +2099,7 @@ void ControlFlowGraph::calculate_exit_block() {
     return;
   }
   always_assert(m_exit_block == nullptr);
+  invalidate_analyses();
   ExitBlocks eb;
   eb.visit(entry_block());
   if (eb.exit_blocks.size() == 1) {
@@ -2165,6 +2117,7 @@ void ControlFlowGraph::reset_exit_block() {
     return;
   }
   if (get_pred_edge_of_type(m_exit_block, EDGE_GHOST) == nullptr) {
+    invalidate_analyses();
     m_exit_block = nullptr;
     return;
   }
@@ -2175,6 +2128,38 @@ void ControlFlowGraph::reset_exit_block() {
   always_assert(m_exit_block == nullptr);
 }
 
+namespace {
+
+struct ReversePostOrder {
+  explicit ReversePostOrder(const ControlFlowGraph& cfg)
+      : blocks(graph::postorder_sort<GraphInterface>(cfg)) {
+    std::reverse(blocks.begin(), blocks.end());
+  }
+
+  std::vector<Block*> blocks;
+};
+
+} // namespace
+
+const dominators::SimpleFastDominators<GraphInterface>&
+ControlFlowGraph::get_dominators() const {
+  return get_analysis<dominators::SimpleFastDominators<GraphInterface>>();
+}
+
+const dominators::SimpleFastDominators<
+    sparta::BackwardsFixpointIterationAdaptor<GraphInterface>>&
+ControlFlowGraph::get_post_dominators() const {
+  always_assert_log(m_exit_block != nullptr,
+                    "Post-dominators need an exit block, see "
+                    "calculate_exit_block()");
+  return get_analysis<dominators::SimpleFastDominators<
+      sparta::BackwardsFixpointIterationAdaptor<GraphInterface>>>();
+}
+
+const std::vector<Block*>& ControlFlowGraph::get_reverse_post_order() const {
+  return get_analysis<ReversePostOrder>().blocks;
+}
+
 // public API edge removal functions
 void ControlFlowGraph::delete_edge(Edge* edge) {
   remove_edge(edge);
@@ -2235,6 +2220,7 @@ void ControlFlowGraph::free_all_blocks_and_edges_and_removed_insns() {
 
 void ControlFlowGraph::clear() {
   free_all_blocks_and_edges_and_removed_insns();
+  invalidate_analyses();
 
   m_blocks.clear();
   m_edges.clear();
@@ -2370,6 +2356,7 @@ void ControlFlowGraph::merge_blocks(Block* pred, Block* succ) {
   // remove the succ block
   delete_pred_edges(succ);
   delete_succ_edges(succ);
+  invalidate_analyses();
   m_blocks.erase(succ->id());
   delete succ;
 }
@@ -2397,6 +2384,7 @@ void ControlFlowGraph::move_edge(Edge* edge,
   if (new_target != nullptr) {
     edge->set_target(new_target);
   }
+  invalidate_analyses();
 
   edge->src()->m_succs.push_back(edge);
   edge->target()->m_preds.push_back(edge);
@@ -2691,6 +2679,7 @@ uint32_t ControlFlowGraph::remove_blocks(const std::vector<Block*>& blocks) {
     }
 
     auto id = block->id();
+    invalidate_analyses();
     auto num_removed = m_blocks.erase(id);
     always_assert_log(num_removed == 1,
                       "Block %zu wasn't in CFG. Attempted double delete?", id);
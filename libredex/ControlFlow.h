@@ -10,13 +10,20 @@
 #include <boost/dynamic_bitset.hpp>
 #include <boost/optional/optional.hpp>
 #include <boost/range/sub_range.hpp>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <stdexcept>
 #include <type_traits>
+#include <typeindex>
+#include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include "DexPosition.h"
 #include "IRCode.h"
+#include "ObjectPool.h"
 #include "SingletonIterable.h"
 #include "WeakTopologicalOrdering.h"
 
@@ -68,6 +75,16 @@ struct BlockAccessor;
 } // namespace impl
 } // namespace source_blocks
 
+namespace dominators {
+template <class GraphInterface>
+class SimpleFastDominators;
+} // namespace dominators
+
+namespace sparta {
+template <typename GraphInterface>
+class BackwardsFixpointIterationAdaptor;
+} // namespace sparta
+
 namespace cfg {
 
 enum EdgeType : uint8_t {
@@ -85,6 +102,7 @@ enum EdgeType : uint8_t {
 
 class Block;
 class ControlFlowGraph;
+class GraphInterface;
 class CFGInliner;
 
 namespace details {
@@ -166,6 +184,8 @@ class Edge final {
     }
   }
 
+  REDEX_POOLED_ALLOCATION(Edge)
+
   bool operator==(const Edge& that) const {
     return m_src == that.m_src && m_target == that.m_target &&
            equals_ignore_source_and_target(that);
@@ -241,6 +261,8 @@ class Block final {
       : m_id(id), m_parent(parent) {}
 
   ~Block() { m_entries.clear_and_dispose(); }
+
+  REDEX_POOLED_ALLOCATION(Block)
   // This is different from the destructor. It also frees MethodItemEntry
   // payload that is not deleted on MIE deletion.
   void free();
@@ -437,6 +459,174 @@ struct LinearizationStrategy {
       sparta::WeakTopologicalOrdering<BlockChain*> wto) = 0;
 };
 
+/*
+ * The blocks of a CFG, stored contiguously and indexed by their id.
+ *
+ * This has the subset of the interface of std::map<BlockId, Block*> that the
+ * CFG needs, and iterates in id order like it, skipping the holes that deleted
+ * blocks leave behind. Block ids are handed out densely, so the overhead of
+ * the holes is small, and iterating or looking up a block is an array access
+ * rather than a walk over tree nodes.
+ *
+ * Iterators refer to a position rather than to an element, so unlike the
+ * iterators of a vector they stay valid when blocks are added.
+ */
+class BlockMap {
+ public:
+  using key_type = BlockId;
+  using mapped_type = Block*;
+  using value_type = std::pair<const BlockId, Block*>;
+
+  template <bool is_const>
+  class Iterator {
+    using Map = std::conditional_t<is_const, const BlockMap, BlockMap>;
+
+   public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = BlockMap::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer =
+        std::conditional_t<is_const, const value_type*, value_type*>;
+    using reference =
+        std::conditional_t<is_const, const value_type&, value_type&>;
+
+    Iterator() = default;
+    Iterator(Map* map, size_t index) : m_map(map), m_index(index) {}
+    // Allows conversion of iterators to const_iterators.
+    Iterator(const Iterator<false>& other) // NOLINT
+        : m_map(other.m_map), m_index(other.m_index) {}
+
+    reference operator*() const { return m_map->m_slots[m_index]; }
+    pointer operator->() const { return &m_map->m_slots[m_index]; }
+
+    Iterator& operator++() {
+      m_index = m_map->next_index(m_index + 1);
+      return *this;
+    }
+    Iterator operator++(int) {
+      auto result = *this;
+      ++(*this);
+      return result;
+    }
+    Iterator& operator--() {
+      m_index = m_map->prev_index(m_index == END ? m_map->m_slots.size()
+                                                 : m_index);
+      return *this;
+    }
+    Iterator operator--(int) {
+      auto result = *this;
+      --(*this);
+      return result;
+    }
+
+    bool operator==(const Iterator& other) const {
+      return m_index == other.m_index;
+    }
+    bool operator!=(const Iterator& other) const { return !(*this == other); }
+
+   private:
+    Map* m_map{nullptr};
+    size_t m_index{END};
+
+    friend class BlockMap;
+    friend class Iterator<true>;
+  };
+
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  iterator begin() { return iterator(this, next_index(0)); }
+  iterator end() { return iterator(this, END); }
+  const_iterator begin() const { return const_iterator(this, next_index(0)); }
+  const_iterator end() const { return const_iterator(this, END); }
+  reverse_iterator rbegin() { return reverse_iterator(end()); }
+  reverse_iterator rend() { return reverse_iterator(begin()); }
+  const_reverse_iterator rbegin() const {
+    return const_reverse_iterator(end());
+  }
+  const_reverse_iterator rend() const {
+    return const_reverse_iterator(begin());
+  }
+
+  size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+
+  bool contains(BlockId id) const {
+    return id < m_slots.size() && m_slots[id].second != nullptr;
+  }
+  size_t count(BlockId id) const { return contains(id) ? 1 : 0; }
+
+  iterator find(BlockId id) {
+    return contains(id) ? iterator(this, id) : end();
+  }
+  const_iterator find(BlockId id) const {
+    return contains(id) ? const_iterator(this, id) : end();
+  }
+
+  Block* at(BlockId id) const {
+    if (!contains(id)) {
+      throw std::out_of_range("BlockMap::at");
+    }
+    return m_slots[id].second;
+  }
+
+  std::pair<iterator, bool> emplace(BlockId id, Block* block) {
+    if (contains(id)) {
+      return {iterator(this, id), false};
+    }
+    while (m_slots.size() <= id) {
+      m_slots.emplace_back(m_slots.size(), nullptr);
+    }
+    m_slots[id].second = block;
+    ++m_size;
+    return {iterator(this, id), true};
+  }
+
+  iterator erase(const_iterator it) {
+    m_slots[it.m_index].second = nullptr;
+    --m_size;
+    return iterator(this, next_index(it.m_index + 1));
+  }
+  size_t erase(BlockId id) {
+    if (!contains(id)) {
+      return 0;
+    }
+    erase(find(id));
+    return 1;
+  }
+
+  void clear() {
+    m_slots.clear();
+    m_size = 0;
+  }
+
+ private:
+  static constexpr size_t END = std::numeric_limits<size_t>::max();
+
+  // The first occupied slot at or after `index`, or END.
+  size_t next_index(size_t index) const {
+    for (; index < m_slots.size(); ++index) {
+      if (m_slots[index].second != nullptr) {
+        return index;
+      }
+    }
+    return END;
+  }
+
+  // The last occupied slot before `index`. There must be one.
+  size_t prev_index(size_t index) const {
+    do {
+      --index;
+    } while (m_slots[index].second == nullptr);
+    return index;
+  }
+
+  std::vector<value_type> m_slots;
+  size_t m_size{0};
+};
+
 class ControlFlowGraph {
 
  public:
@@ -490,8 +680,14 @@ class ControlFlowGraph {
 
   Block* entry_block() const { return m_entry_block; }
   Block* exit_block() const { return m_exit_block; }
-  void set_entry_block(Block* b) { m_entry_block = b; }
-  void set_exit_block(Block* b) { m_exit_block = b; }
+  void set_entry_block(Block* b) {
+    invalidate_analyses();
+    m_entry_block = b;
+  }
+  void set_exit_block(Block* b) {
+    invalidate_analyses();
+    m_exit_block = b;
+  }
   void reset_exit_block();
 
   /*
@@ -516,6 +712,48 @@ class ControlFlowGraph {
    */
   void calculate_exit_block();
 
+  /*
+   * Returns `Analysis(*this)`, computed on first request and cached on this
+   * CFG. The cached result is dropped as soon as the shape of the graph
+   * changes: when blocks or edges are added, removed or moved, or when the
+   * entry or exit block changes. That covers the other editing APIs and
+   * CFGMutation. Only use it for analyses that depend on the blocks and edges
+   * alone, and not on the instructions in the blocks. Like the rest of the
+   * CFG, this is not thread-safe.
+   */
+  template <class Analysis>
+  const Analysis& get_analysis() const {
+    auto key = std::type_index(typeid(Analysis));
+    auto it = m_analyses.find(key);
+    if (it == m_analyses.end()) {
+      // Computing the analysis may request others, so don't hold on to a
+      // reference into m_analyses while it runs.
+      auto analysis = std::make_shared<const Analysis>(*this);
+      it = m_analyses.emplace(key, std::move(analysis)).first;
+    }
+    return *static_cast<const Analysis*>(it->second.get());
+  }
+
+  void invalidate_analyses() const {
+    if (!m_analyses.empty()) {
+      m_analyses.clear();
+    }
+  }
+
+  // Cached dominator tree, see `get_analysis`.
+  const dominators::SimpleFastDominators<GraphInterface>& get_dominators()
+      const;
+
+  // Cached post-dominator tree, see `get_analysis`. Requires an exit block,
+  // see `calculate_exit_block`.
+  const dominators::SimpleFastDominators<
+      sparta::BackwardsFixpointIterationAdaptor<GraphInterface>>&
+  get_post_dominators() const;
+
+  // Cached reverse post-order of the blocks reachable from the entry block,
+  // see `get_analysis`.
+  const std::vector<Block*>& get_reverse_post_order() const;
+
   // args are arguments to an Edge constructor
   template <class... Args>
   void add_edge(Args&&... args) {
@@ -523,6 +761,7 @@ class ControlFlowGraph {
   }
 
   void add_edge(Edge* e) {
+    invalidate_analyses();
     m_edges.insert(e);
     e->src()->m_succs.emplace_back(e);
     e->target()->m_preds.emplace_back(e);
@@ -951,7 +1190,7 @@ class ControlFlowGraph {
                          std::vector<std::pair<Block*, MethodItemEntry*>>>;
   using TryEnds = std::vector<std::pair<TryEntry*, Block*>>;
   using TryCatches = std::unordered_map<CatchEntry*, Block*>;
-  using Blocks = std::map<BlockId, Block*>;
+  using Blocks = BlockMap;
   friend class InstructionIteratorImpl<false>;
   friend class InstructionIteratorImpl<true>;
   friend class CFGInliner;
@@ -984,10 +1223,12 @@ class ControlFlowGraph {
   void remove_try_catch_markers();
 
   // helper functions
+  // The chain of each block is indexed by the block's id, as the ids are
+  // dense and a lookup is then an array access.
   void build_chains(std::vector<std::unique_ptr<BlockChain>>* chains,
-                    std::unordered_map<Block*, BlockChain*>* block_to_chain);
+                    std::vector<BlockChain*>* block_to_chain);
   sparta::WeakTopologicalOrdering<BlockChain*> build_wto(
-      const std::unordered_map<Block*, BlockChain*>& block_to_chain);
+      const std::vector<BlockChain*>& block_to_chain);
   std::vector<Block*> wto_chains(
       sparta::WeakTopologicalOrdering<BlockChain*> wto);
 
@@ -1061,6 +1302,7 @@ class ControlFlowGraph {
                          Block* target,
                          EdgePredicate predicate,
                          bool cleanup = true) {
+    invalidate_analyses();
     auto& forward_edges = source->m_succs;
     EdgeSet to_remove;
     forward_edges.erase(
@@ -1094,6 +1336,7 @@ class ControlFlowGraph {
                               const ForwardIt& end,
                               EdgePredicate predicate,
                               bool cleanup = true) {
+    invalidate_analyses();
     std::unordered_set<Block*> source_blocks;
     EdgeSet to_remove;
     for (auto it = begin; it != end; it++) {
@@ -1132,6 +1375,7 @@ class ControlFlowGraph {
                               const ForwardIt& end,
                               EdgePredicate predicate,
                               bool cleanup = true) {
+    invalidate_analyses();
     std::unordered_set<Block*> target_blocks;
     std::unordered_set<Edge*> to_remove;
     for (auto it = begin; it != end; it++) {
@@ -1206,6 +1450,8 @@ class ControlFlowGraph {
   bool m_owns_insns{false};
   bool m_owns_removed_insns{true};
   std::vector<IRInstruction*> m_removed_insns;
+  mutable std::unordered_map<std::type_index, std::shared_ptr<const void>>
+      m_analyses;
 };
 
 // A static-method-only API for use with the monotonic fixpoint iterator.
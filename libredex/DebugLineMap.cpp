@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "DebugLineMap.h"
+
+#include <limits>
+
+#include "BinarySerialization.h"
+#include "Debug.h"
+
+DebugLineMapWriter::DebugLineMapWriter(const std::string& filename)
+    : m_ofs(filename.c_str(), std::ofstream::out | std::ofstream::trunc) {
+  always_assert_log(m_ofs, "Unable to write debug line map %s",
+                    filename.c_str());
+  binary_serialization::write_header(m_ofs, VERSION);
+  m_offset = 2 * sizeof(uint32_t);
+}
+
+DebugLineMapWriter::Chunk DebugLineMapWriter::encode(
+    const std::vector<Entry>& entries) {
+  Chunk chunk;
+  size_t size = 0;
+  for (const auto& entry : entries) {
+    size += sizeof(uint64_t) + entry.second->size() * 2 * sizeof(uint32_t);
+  }
+  chunk.data.reserve(size);
+  chunk.records.reserve(entries.size());
+  auto append = [&](const auto& value) {
+    chunk.data.append((const char*)&value, sizeof(value));
+  };
+  for (const auto& [method_id, debug_lines] : entries) {
+    append(method_id);
+    for (const auto& item : *debug_lines) {
+      append(item.offset);
+      append(item.line);
+    }
+    chunk.records.emplace_back(
+        method_id,
+        sizeof(uint64_t) + debug_lines->size() * 2 * sizeof(uint32_t));
+  }
+  return chunk;
+}
+
+void DebugLineMapWriter::append(const Chunk& chunk) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  always_assert(m_offset + chunk.data.size() <=
+                std::numeric_limits<uint32_t>::max());
+  m_ofs.write(chunk.data.data(), chunk.data.size());
+  for (const auto& [method_id, size] : chunk.records) {
+    always_assert_log(m_method_ids.insert(method_id).second,
+                      "Duplicate debug line map entry for method id %zx",
+                      (size_t)method_id);
+    m_index.push_back({method_id, m_offset, size});
+    m_offset += size;
+  }
+}
+
+bool DebugLineMapWriter::contains(uint64_t method_id) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_method_ids.count(method_id) != 0;
+}
+
+void DebugLineMapWriter::finish() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (const auto& entry : m_index) {
+    binary_serialization::write(m_ofs, entry.method_id);
+    binary_serialization::write(m_ofs, entry.offset);
+    binary_serialization::write(m_ofs, entry.size);
+  }
+  binary_serialization::write<uint32_t>(m_ofs, m_index.size());
+  binary_serialization::write(m_ofs, m_offset);
+  m_ofs.close();
+  always_assert_log(!m_ofs.fail(), "Unable to write debug line map");
+}
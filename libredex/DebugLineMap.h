@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "DexClass.h"
+
+/*
+ * Writes the debug line map, which maps the instruction offsets of the
+ * methods to their line numbers, when the line numbers of the dexes are
+ * replaced by offsets (e.g. with IODI).
+ *
+ * The records of each dex are encoded by its writer as soon as the method
+ * ids of the dex are known, and appended to the file in dex order, so that
+ * the whole map never has to be built in memory. The index follows the
+ * records, and a footer at the end of the file points to it.
+ *
+ * Binary file format:
+ * magic number 0xfaceb000 (4 byte)
+ * version number 2 (4 byte)
+ * a list (m elements) of records:
+ *   encoded method-id (8 byte)
+ *   a list (n elements) of:
+ *     [ memory offset (4 byte), line number (4 byte) ]
+ * a list (m elements) of:
+ *   [ encoded method-id (8 byte), record byte offset (4 byte),
+ *     record byte size (4 byte) ]
+ * number (m) of methods that have debug line info (4 byte)
+ * byte offset of the index (4 byte)
+ */
+class DebugLineMapWriter {
+ public:
+  // The encoded id of a method and its line info.
+  using Entry = std::pair<uint64_t, const std::vector<DebugLineItem>*>;
+
+  struct Chunk {
+    std::string data;
+    // The method ids of the records, along with their sizes.
+    std::vector<std::pair<uint64_t, uint32_t>> records;
+  };
+
+  static constexpr uint32_t VERSION = 2;
+
+  explicit DebugLineMapWriter(const std::string& filename);
+
+  // Encodes the records of some methods, e.g. those of one dex. This doesn't
+  // touch the writer, so the chunks of several dexes can be encoded
+  // concurrently.
+  static Chunk encode(const std::vector<Entry>& entries);
+
+  // Appends the records of the chunk to the file. The order of the records in
+  // the file is the order of the calls.
+  void append(const Chunk& chunk);
+
+  bool contains(uint64_t method_id) const;
+
+  // Writes the index and the footer, and closes the file.
+  void finish();
+
+ private:
+  struct IndexEntry {
+    uint64_t method_id;
+    uint32_t offset;
+    uint32_t size;
+  };
+
+  mutable std::mutex m_mutex;
+  std::ofstream m_ofs;
+  uint32_t m_offset{0};
+  std::vector<IndexEntry> m_index;
+  std::unordered_set<uint64_t> m_method_ids;
+};
@@ -85,9 +85,9 @@ void loosen_access_modifier(const DexClasses& classes) {
     return;
   }
 
-  walk::annotations(classes, [&dalvikinner](DexAnnotation* anno) {
+  walk::annotations(classes, [&dalvikinner](DexAnnotation*& anno) {
     if (anno->type() != dalvikinner) return;
-    auto elems = anno->anno_elems();
+    const auto& elems = DexAnnotation::unshare(anno)->anno_elems();
     for (auto elem : elems) {
       // Fix access flags on all @InnerClass annotations
       if (!strcmp("accessFlags", elem.string->c_str())) {
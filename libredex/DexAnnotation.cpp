@@ -112,6 +112,107 @@ void DexEncodedValueAnnotation::gather_methods(
   }
 }
 
+namespace {
+
+bool elements_equal(const EncodedAnnotations& a, const EncodedAnnotations& b) {
+  return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+                    [](const DexAnnotationElement& x,
+                       const DexAnnotationElement& y) {
+                      return x.string == y.string &&
+                             *x.encoded_value == *y.encoded_value;
+                    });
+}
+
+size_t hash_elements(const EncodedAnnotations& elems) {
+  size_t seed = elems.size();
+  for (auto const& elem : elems) {
+    boost::hash_combine(seed, (uintptr_t)elem.string);
+    boost::hash_combine(seed, *elem.encoded_value);
+  }
+  return seed;
+}
+
+EncodedAnnotations clone_elements(const EncodedAnnotations& elems) {
+  EncodedAnnotations copy;
+  copy.reserve(elems.size());
+  for (auto const& elem : elems) {
+    copy.emplace_back(elem.string, elem.encoded_value->clone());
+  }
+  return copy;
+}
+
+/*
+ * Frees a value that was just loaded, along with the values it holds. Nothing
+ * else may refer to them.
+ */
+void delete_loaded_value(DexEncodedValue* ev) {
+  if (ev->evtype() == DEVT_ARRAY) {
+    for (auto elem : *static_cast<DexEncodedValueArray*>(ev)->evalues()) {
+      delete_loaded_value(elem);
+    }
+  } else if (ev->evtype() == DEVT_ANNOTATION) {
+    auto annotations =
+        static_cast<DexEncodedValueAnnotation*>(ev)->annotations();
+    for (auto const& elem : *annotations) {
+      delete_loaded_value(elem.encoded_value);
+    }
+    delete annotations;
+  }
+  delete ev;
+}
+
+} // namespace
+
+DexEncodedValue* DexEncodedValueArray::clone() const {
+  auto evalues = new std::deque<DexEncodedValue*>();
+  for (auto ev : *m_evalues) {
+    evalues->push_back(ev->clone());
+  }
+  return new DexEncodedValueArray(evalues, m_static_val);
+}
+
+DexEncodedValue* DexEncodedValueAnnotation::clone() const {
+  return new DexEncodedValueAnnotation(
+      m_type, new EncodedAnnotations(clone_elements(*m_annotations)));
+}
+
+bool DexEncodedValueAnnotation::operator==(const DexEncodedValue& that) const {
+  if (m_evtype != that.evtype()) {
+    return false;
+  }
+  auto other = static_cast<const DexEncodedValueAnnotation*>(&that);
+  return m_type == other->m_type &&
+         elements_equal(*m_annotations, *other->m_annotations);
+}
+
+size_t DexEncodedValueAnnotation::hash_value() const {
+  size_t seed = boost::hash<uint8_t>()(m_evtype);
+  boost::hash_combine(seed, (uintptr_t)m_type);
+  boost::hash_combine(seed, hash_elements(*m_annotations));
+  return seed;
+}
+
+bool DexAnnotation::operator==(const DexAnnotation& that) const {
+  return m_type == that.m_type && m_viz == that.m_viz &&
+         elements_equal(m_anno_elems, that.m_anno_elems);
+}
+
+size_t DexAnnotation::hash_value() const {
+  size_t seed = boost::hash<uintptr_t>()((uintptr_t)m_type);
+  boost::hash_combine(seed, m_viz);
+  boost::hash_combine(seed, hash_elements(m_anno_elems));
+  return seed;
+}
+
+DexAnnotation* DexAnnotation::unshare(DexAnnotation*& anno) {
+  if (anno->is_interned()) {
+    auto copy = new DexAnnotation(anno->m_type, anno->m_viz);
+    copy->m_anno_elems = clone_elements(anno->m_anno_elems);
+    anno = copy;
+  }
+  return anno;
+}
+
 void DexAnnotation::gather_strings(std::vector<DexString*>& lstring) const {
   for (auto const& anno : m_anno_elems) {
     lstring.push_back(anno.string);
@@ -535,7 +636,14 @@ DexAnnotation* DexAnnotation::get_annotation(DexIdx* idx, uint32_t anno_off) {
     DexAnnotationElement dae = get_annotation_element(idx, encdata);
     anno->m_anno_elems.push_back(dae);
   }
-  return anno;
+  auto interned = g_redex->intern_annotation(anno);
+  if (interned != anno) {
+    for (auto const& elem : anno->m_anno_elems) {
+      delete_loaded_value(elem.encoded_value);
+    }
+    delete anno;
+  }
+  return interned;
 }
 
 void DexAnnotation::add_element(const char* key, DexEncodedValue* value) {
@@ -681,8 +789,8 @@ void DexAnnotationDirectory::gather_annotations(
 void DexAnnotationDirectory::vencode(
     DexOutputIdx* dodx,
     std::vector<uint32_t>& annodirout,
-    std::map<ParamAnnotations*, uint32_t>& xrefmap,
-    std::map<DexAnnotationSet*, uint32_t>& asetmap) {
+    const std::map<ParamAnnotations*, uint32_t>& xrefmap,
+    const std::map<DexAnnotationSet*, uint32_t>& asetmap) {
   uint32_t classoff = 0;
   uint32_t cntaf = 0;
   uint32_t cntam = 0;
@@ -690,7 +798,7 @@ void DexAnnotationDirectory::vencode(
   if (m_class) {
     always_assert_log(asetmap.count(m_class) != 0, "Uninitialized aset %p '%s'",
                       m_class, show(m_class).c_str());
-    classoff = asetmap[m_class];
+    classoff = asetmap.at(m_class);
   }
   if (m_field) {
     cntaf = (uint32_t)m_field->size();
@@ -716,7 +824,7 @@ void DexAnnotationDirectory::vencode(
       annodirout.push_back(dodx->fieldidx(p.first));
       always_assert_log(asetmap.count(das) != 0, "Uninitialized aset %p '%s'",
                         das, show(das).c_str());
-      annodirout.push_back(asetmap[das]);
+      annodirout.push_back(asetmap.at(das));
     }
   }
   if (m_method) {
@@ -728,7 +836,7 @@ void DexAnnotationDirectory::vencode(
       annodirout.push_back(midx);
       always_assert_log(asetmap.count(das) != 0, "Uninitialized aset %p '%s'",
                         das, show(das).c_str());
-      annodirout.push_back(asetmap[das]);
+      annodirout.push_back(asetmap.at(das));
     }
   }
   if (m_method_param) {
@@ -740,7 +848,7 @@ void DexAnnotationDirectory::vencode(
       annodirout.push_back(dodx->methodidx(p.first));
       always_assert_log(xrefmap.count(pa) != 0,
                         "Uninitialized ParamAnnotations %p", pa);
-      annodirout.push_back(xrefmap[pa]);
+      annodirout.push_back(xrefmap.at(pa));
     }
   }
 }
@@ -751,9 +859,10 @@ void DexAnnotationSet::gather_annotations(std::vector<DexAnnotation*>& list) {
   }
 }
 
-void DexAnnotationSet::vencode(DexOutputIdx* dodx,
-                               std::vector<uint32_t>& asetout,
-                               std::map<DexAnnotation*, uint32_t>& annoout) {
+void DexAnnotationSet::vencode(
+    DexOutputIdx* dodx,
+    std::vector<uint32_t>& asetout,
+    const std::map<DexAnnotation*, uint32_t>& annoout) {
   asetout.push_back((uint32_t)m_annotations.size());
   std::sort(m_annotations.begin(), m_annotations.end(),
             type_annotation_compare);
@@ -762,7 +871,7 @@ void DexAnnotationSet::vencode(DexOutputIdx* dodx,
                       "Uninitialized annotation %p '%s', bailing\n",
                       anno,
                       show(anno).c_str());
-    asetout.push_back(annoout[anno]);
+    asetout.push_back(annoout.at(anno));
   }
 }
 
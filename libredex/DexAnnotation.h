@@ -75,6 +75,8 @@ class DexEncodedValue : public Gatherable {
 
   virtual std::string show() const;
   virtual std::string show_deobfuscated() const { return show(); }
+  // Returns a deep copy, which is owned by the caller.
+  virtual DexEncodedValue* clone() const { return new DexEncodedValue(*this); }
   virtual bool operator==(const DexEncodedValue& that) const {
     return m_evtype == that.m_evtype && m_value == that.m_value;
   }
@@ -100,6 +102,9 @@ class DexEncodedValueBit : public DexEncodedValue {
       : DexEncodedValue(type, bit) {}
 
   void encode(DexOutputIdx* dodx, uint8_t*& encdata) override;
+  DexEncodedValue* clone() const override {
+    return new DexEncodedValueBit(*this);
+  }
 };
 
 class DexEncodedValueString : public DexEncodedValue {
@@ -117,6 +122,9 @@ class DexEncodedValueString : public DexEncodedValue {
   void encode(DexOutputIdx* dodx, uint8_t*& encdata) override;
 
   std::string show() const override;
+  DexEncodedValue* clone() const override {
+    return new DexEncodedValueString(*this);
+  }
   bool operator==(const DexEncodedValue& that) const override {
     if (m_evtype != that.evtype()) {
       return false;
@@ -145,6 +153,9 @@ class DexEncodedValueType : public DexEncodedValue {
   DexType* type() const { return m_type; }
   void set_type(DexType* type) { m_type = type; }
   std::string show() const override;
+  DexEncodedValue* clone() const override {
+    return new DexEncodedValueType(*this);
+  }
   bool operator==(const DexEncodedValue& that) const override {
     if (m_evtype != that.evtype()) {
       return false;
@@ -174,6 +185,9 @@ class DexEncodedValueField : public DexEncodedValue {
   void set_field(DexFieldRef* field) { m_field = field; }
   std::string show() const override;
   std::string show_deobfuscated() const override;
+  DexEncodedValue* clone() const override {
+    return new DexEncodedValueField(*this);
+  }
   bool operator==(const DexEncodedValue& that) const override {
     if (m_evtype != that.evtype()) {
       return false;
@@ -203,6 +217,9 @@ class DexEncodedValueMethod : public DexEncodedValue {
   void set_method(DexMethodRef* method) { m_method = method; }
   std::string show() const override;
   std::string show_deobfuscated() const override;
+  DexEncodedValue* clone() const override {
+    return new DexEncodedValueMethod(*this);
+  }
   bool operator==(const DexEncodedValue& that) const override {
     if (m_evtype != that.evtype()) {
       return false;
@@ -233,6 +250,9 @@ class DexEncodedValueMethodType : public DexEncodedValue {
   void set_proto(DexProto* proto) { m_proto = proto; }
   std::string show() const override;
   std::string show_deobfuscated() const override;
+  DexEncodedValue* clone() const override {
+    return new DexEncodedValueMethodType(*this);
+  }
   bool operator==(const DexEncodedValue& that) const override {
     if (m_evtype != that.evtype()) {
       return false;
@@ -268,6 +288,9 @@ class DexEncodedValueMethodHandle : public DexEncodedValue {
   }
   std::string show() const override;
   std::string show_deobfuscated() const override;
+  DexEncodedValue* clone() const override {
+    return new DexEncodedValueMethodHandle(*this);
+  }
   bool operator==(const DexEncodedValue& that) const override {
     if (m_evtype != that.evtype()) {
       return false;
@@ -313,6 +336,7 @@ class DexEncodedValueArray : public DexEncodedValue {
   void gather_methods(std::vector<DexMethodRef*>& lmethod) const override;
   void gather_strings(std::vector<DexString*>& lstring) const override;
   void encode(DexOutputIdx* dodx, uint8_t*& encdata) override;
+  DexEncodedValue* clone() const override;
 
   std::string show() const override;
   std::string show_deobfuscated() const override;
@@ -390,16 +414,39 @@ class DexEncodedValueAnnotation : public DexEncodedValue {
 
   std::string show() const override;
   std::string show_deobfuscated() const override;
+  DexEncodedValue* clone() const override;
+  bool operator==(const DexEncodedValue& that) const override;
+  size_t hash_value() const override;
 };
 
+/*
+ * Annotations loaded from dex files are interned in the RedexContext, so that
+ * the members with identical annotations share them. Interned annotations
+ * must not be changed in place: code that changes an annotation it reached
+ * through an annotation set first replaces it with a private copy, e.g.
+ *
+ *   for (auto& anno : aset->get_annotations()) {
+ *     ...
+ *     DexAnnotation::unshare(anno)->set_type(...);
+ *   }
+ */
 class DexAnnotation : public Gatherable {
   EncodedAnnotations m_anno_elems;
   DexType* m_type;
   DexAnnotationVisibility m_viz;
+  bool m_interned{false};
+
+  friend struct RedexContext;
 
  public:
   DexAnnotation(DexType* type, DexAnnotationVisibility viz)
       : m_type(type), m_viz(viz) {}
+  // Copies are not interned. Their elements share the encoded values.
+  DexAnnotation(const DexAnnotation& that)
+      : Gatherable(),
+        m_anno_elems(that.m_anno_elems),
+        m_type(that.m_type),
+        m_viz(that.m_viz) {}
 
   static DexAnnotation* get_annotation(DexIdx* idx, uint32_t anno_off);
   void gather_types(std::vector<DexType*>& ltype) const override;
@@ -417,6 +464,16 @@ class DexAnnotation : public Gatherable {
 
   void vencode(DexOutputIdx* dodx, std::vector<uint8_t>& bytes);
   void add_element(const char* key, DexEncodedValue* value);
+
+  bool is_interned() const { return m_interned; }
+  /*
+   * Replaces an interned annotation with a copy that owns its encoded values,
+   * and returns the annotation that may be changed.
+   */
+  static DexAnnotation* unshare(DexAnnotation*& anno);
+
+  bool operator==(const DexAnnotation& that) const;
+  size_t hash_value() const;
 };
 
 class DexAnnotationSet : public Gatherable {
@@ -426,7 +483,8 @@ class DexAnnotationSet : public Gatherable {
   DexAnnotationSet() = default;
   DexAnnotationSet(const DexAnnotationSet& that) {
     for (const auto& anno : that.m_annotations) {
-      m_annotations.push_back(new DexAnnotation(*anno));
+      m_annotations.push_back(anno->is_interned() ? anno
+                                                  : new DexAnnotation(*anno));
     }
   }
 
@@ -456,7 +514,8 @@ class DexAnnotationSet : public Gatherable {
     auto const& other_annos = other.m_annotations;
     for (auto const& anno : other_annos) {
       if (existing_annos_type.count(anno->type()) == 0) {
-        m_annotations.emplace_back(new DexAnnotation(*anno));
+        m_annotations.emplace_back(
+            anno->is_interned() ? anno : new DexAnnotation(*anno));
       }
     }
   }
@@ -468,7 +527,7 @@ class DexAnnotationSet : public Gatherable {
   void add_annotation(DexAnnotation* anno) { m_annotations.emplace_back(anno); }
   void vencode(DexOutputIdx* dodx,
                std::vector<uint32_t>& asetout,
-               std::map<DexAnnotation*, uint32_t>& annoout);
+               const std::map<DexAnnotation*, uint32_t>& annoout);
   void gather_annotations(std::vector<DexAnnotation*>& alist);
 };
 
@@ -538,8 +597,8 @@ class DexAnnotationDirectory {
   void gather_xrefs(std::vector<ParamAnnotations*>& xrefs);
   void vencode(DexOutputIdx* dodx,
                std::vector<uint32_t>& annodirout,
-               std::map<ParamAnnotations*, uint32_t>& xrefmap,
-               std::map<DexAnnotationSet*, uint32_t>& asetmap);
+               const std::map<ParamAnnotations*, uint32_t>& xrefmap,
+               const std::map<DexAnnotationSet*, uint32_t>& asetmap);
 
   friend std::string show(const DexAnnotationDirectory*);
 };
@@ -7,6 +7,8 @@
 
 #include "DexClass.h"
 
+#include "CodeSpill.h"
+#include "ConcurrentContainers.h"
 #include "Debug.h"
 #include "DexAccess.h"
 #include "DexDebugInstruction.h"
@@ -145,6 +147,7 @@ DexField* DexFieldRef::make_concrete(DexAccessFlags access_flags,
   auto that = static_cast<DexField*>(this);
   that->m_access = access_flags;
   that->m_concrete = true;
+  RedexContext::start_resolution_generation();
   if (is_static(access_flags)) {
     that->set_value(v);
   } else {
@@ -450,8 +453,13 @@ DexCode::DexCode(const DexCode& that)
       m_ins_size(that.m_ins_size),
       m_outs_size(that.m_outs_size),
       m_insns(std::make_unique<std::vector<DexInstruction*>>()) {
-  for (auto& insn : *that.m_insns) {
-    m_insns->emplace_back(insn->clone());
+  if (that.m_packed) {
+    m_insns.reset();
+    m_packed = std::make_unique<PackedInstructions>(*that.m_packed);
+  } else {
+    for (auto& insn : *that.m_insns) {
+      m_insns->emplace_back(insn->clone());
+    }
   }
   for (auto& try_ : that.m_tries) {
     m_tries.emplace_back(new DexTryItem(*try_));
@@ -527,6 +535,99 @@ std::unique_ptr<DexCode> DexCode::get_dex_code(DexIdx* idx, uint32_t offset) {
   return dc;
 }
 
+void DexCode::pack() {
+  always_assert(m_insns != nullptr);
+  auto packed = std::make_unique<PackedInstructions>();
+  uint32_t num_units = 0;
+  for (auto const& opc : *m_insns) {
+    num_units += opc->size();
+  }
+  packed->units.resize(num_units);
+  uint16_t* insns = packed->units.data();
+  for (auto const& opc : *m_insns) {
+    PackedRef ref;
+    // The index always follows the opcode unit.
+    ref.offset = insns - packed->units.data() + 1;
+    opc->encode_without_ref(insns);
+    if (opc->has_string()) {
+      auto str = static_cast<const DexOpcodeString*>(opc);
+      ref.kind = str->jumbo() ? PackedRef::JUMBO_STRING : PackedRef::STRING;
+      ref.string = str->get_string();
+    } else if (opc->has_type()) {
+      ref.kind = PackedRef::TYPE;
+      ref.type = static_cast<const DexOpcodeType*>(opc)->get_type();
+    } else if (opc->has_field()) {
+      ref.kind = PackedRef::FIELD;
+      ref.field = static_cast<const DexOpcodeField*>(opc)->get_field();
+    } else if (opc->has_method()) {
+      ref.kind = PackedRef::METHOD;
+      ref.method = static_cast<const DexOpcodeMethod*>(opc)->get_method();
+    } else if (opc->has_callsite()) {
+      ref.kind = PackedRef::CALLSITE;
+      ref.callsite = static_cast<const DexOpcodeCallSite*>(opc)->get_callsite();
+    } else if (opc->has_methodhandle()) {
+      ref.kind = PackedRef::METHODHANDLE;
+      ref.methodhandle =
+          static_cast<const DexOpcodeMethodHandle*>(opc)->get_methodhandle();
+    } else {
+      continue;
+    }
+    packed->refs.push_back(ref);
+  }
+  always_assert(insns == packed->units.data() + num_units);
+  packed->num_instructions = m_insns->size();
+  packed->size = size();
+  for (auto const& op : *m_insns) {
+    delete op;
+  }
+  m_insns.reset();
+  m_packed = std::move(packed);
+}
+
+void DexCode::encode_packed(DexOutputIdx* dodx, uint16_t*& insns) const {
+  auto& units = m_packed->units;
+  memcpy(insns, units.data(), units.size() * sizeof(uint16_t));
+  for (auto const& ref : m_packed->refs) {
+    uint16_t* idx = insns + ref.offset;
+    switch (ref.kind) {
+    case PackedRef::STRING: {
+      uint32_t sidx = dodx->stringidx(ref.string);
+      always_assert_log(
+          sidx == (uint16_t)sidx,
+          "Attempt to encode jumbo string in non-jumbo opcode: %s",
+          ref.string->c_str());
+      *idx = (uint16_t)sidx;
+      break;
+    }
+    case PackedRef::JUMBO_STRING: {
+      uint32_t sidx = dodx->stringidx(ref.string);
+      if (sidx == (uint16_t)sidx) {
+        opt_warn(NON_JUMBO_STRING, "%s\n", ref.string->c_str());
+      }
+      idx[0] = (uint16_t)sidx;
+      idx[1] = (uint16_t)(sidx >> 16);
+      break;
+    }
+    case PackedRef::TYPE:
+      *idx = dodx->typeidx(ref.type);
+      break;
+    case PackedRef::FIELD:
+      *idx = dodx->fieldidx(ref.field);
+      break;
+    case PackedRef::METHOD:
+      *idx = dodx->methodidx(ref.method);
+      break;
+    case PackedRef::CALLSITE:
+      *idx = dodx->callsiteidx(ref.callsite);
+      break;
+    case PackedRef::METHODHANDLE:
+      *idx = dodx->methodhandleidx(ref.methodhandle);
+      break;
+    }
+  }
+  insns += units.size();
+}
+
 int DexCode::encode(DexOutputIdx* dodx, uint32_t* output) {
   dex_code_item* code = (dex_code_item*)output;
   code->registers_size = m_registers_size;
@@ -536,8 +637,12 @@ int DexCode::encode(DexOutputIdx* dodx, uint32_t* output) {
   /* Debug info is added later */
   code->debug_info_off = 0;
   uint16_t* insns = (uint16_t*)(code + 1);
-  for (auto const& opc : get_instructions()) {
-    opc->encode(dodx, insns);
+  if (m_packed) {
+    encode_packed(dodx, insns);
+  } else {
+    for (auto const& opc : get_instructions()) {
+      opc->encode(dodx, insns);
+    }
   }
   code->insns_size = (uint32_t)(insns - ((uint16_t*)(code + 1)));
   if (m_tries.empty())
@@ -599,7 +704,23 @@ DexMethod::DexMethod(DexType* type, DexString* name, DexProto* proto)
   m_access = static_cast<DexAccessFlags>(0);
 }
 
-DexMethod::~DexMethod() = default;
+DexMethod::~DexMethod() {
+  if (m_code_spilled.load(std::memory_order_relaxed)) {
+    code_spill::impl::discard(this);
+  }
+  drop_pending_dex_code();
+}
+
+std::atomic<uint32_t> DexMethod::s_code_epoch{0};
+
+void DexMethod::note_code_use(uint32_t epoch) const {
+  if (m_code_epoch.load(std::memory_order_relaxed) != epoch) {
+    m_code_epoch.store(epoch, std::memory_order_relaxed);
+  }
+  if (m_code_spilled.load(std::memory_order_acquire)) {
+    code_spill::impl::reload(const_cast<DexMethod*>(this));
+  }
+}
 
 std::string DexMethod::get_fully_deobfuscated_name() const {
   if (get_deobfuscated_name() == show(this)) {
@@ -609,18 +730,108 @@ std::string DexMethod::get_fully_deobfuscated_name() const {
 }
 
 void DexMethod::set_code(std::unique_ptr<IRCode> code) {
+  if (m_code_spilled.load(std::memory_order_relaxed)) {
+    code_spill::impl::discard(this);
+  }
+  // The new code supersedes any that was never ballooned.
+  drop_pending_balloon();
+  drop_pending_dex_code();
   m_code = std::move(code);
 }
 
 void DexMethod::balloon() {
   redex_assert(m_code == nullptr);
+  m_balloon_pending.store(false, std::memory_order_relaxed);
   m_code = std::make_unique<IRCode>(this);
   m_dex_code.reset();
 }
 
+void DexMethod::defer_balloon() {
+  redex_assert(m_code == nullptr);
+  redex_assert(has_dex_code());
+  m_balloon_pending.store(true, std::memory_order_release);
+}
+
+namespace {
+
+// Serializes concurrent first accesses of a method; a lock per method would
+// make every DexMethod larger.
+constexpr size_t NUM_BALLOON_LOCKS = 64;
+std::mutex s_balloon_locks[NUM_BALLOON_LOCKS];
+
+} // namespace
+
+void DexMethod::drop_pending_balloon() {
+  if (m_balloon_pending.load(std::memory_order_relaxed)) {
+    m_balloon_pending.store(false, std::memory_order_relaxed);
+    m_dex_code.reset();
+  }
+}
+
+void DexMethod::balloon_pending() const {
+  auto stripe = boost::hash<const DexMethod*>()(this) % NUM_BALLOON_LOCKS;
+  std::lock_guard<std::mutex> guard(s_balloon_locks[stripe]);
+  if (!m_balloon_pending.load(std::memory_order_relaxed)) {
+    return;
+  }
+  auto* self = const_cast<DexMethod*>(this);
+  self->m_code = std::make_unique<IRCode>(self);
+  self->m_dex_code.reset();
+  m_balloon_pending.store(false, std::memory_order_release);
+}
+
+namespace {
+
+struct PendingDexCode {
+  std::shared_ptr<DexIdx> idx;
+  uint32_t code_off;
+  DexString* source_file;
+};
+
+ConcurrentMap<const DexMethod*, PendingDexCode> s_pending_dex_code;
+
+// Separate from the balloon locks, as ballooning a pending method parses its
+// code item.
+std::mutex s_dex_code_locks[NUM_BALLOON_LOCKS];
+
+} // namespace
+
+void DexMethod::defer_dex_code(std::shared_ptr<DexIdx> idx,
+                               uint32_t code_off,
+                               DexString* source_file) {
+  redex_assert(code_off != 0);
+  s_pending_dex_code.insert_or_assign(std::make_pair(
+      this, PendingDexCode{std::move(idx), code_off, source_file}));
+  m_dex_code_pending.store(true, std::memory_order_release);
+}
+
+void DexMethod::drop_pending_dex_code() {
+  if (m_dex_code_pending.load(std::memory_order_relaxed)) {
+    m_dex_code_pending.store(false, std::memory_order_relaxed);
+    s_pending_dex_code.erase(this);
+  }
+}
+
+void DexMethod::load_pending_dex_code() const {
+  auto stripe = boost::hash<const DexMethod*>()(this) % NUM_BALLOON_LOCKS;
+  std::lock_guard<std::mutex> guard(s_dex_code_locks[stripe]);
+  if (!m_dex_code_pending.load(std::memory_order_relaxed)) {
+    return;
+  }
+  auto* self = const_cast<DexMethod*>(this);
+  auto pending = s_pending_dex_code.get(this, PendingDexCode());
+  auto dc = DexCode::get_dex_code(pending.idx.get(), pending.code_off);
+  if (dc->get_debug_item()) {
+    dc->get_debug_item()->bind_positions(self, pending.source_file);
+  }
+  self->m_dex_code = std::move(dc);
+  s_pending_dex_code.erase(this);
+  m_dex_code_pending.store(false, std::memory_order_release);
+}
+
 void DexMethod::sync() {
   redex_assert(m_dex_code == nullptr);
-  m_dex_code = m_code->sync(this);
+  m_dex_code = get_code()->sync(this);
   m_code.reset();
 }
 
@@ -652,9 +863,12 @@ DexMethod* DexMethod::make_method_from(DexMethod* that,
   m->m_concrete = that->m_concrete;
   m->m_virtual = that->m_virtual;
   m->m_external = that->m_external;
-  for (auto& pair : that->m_param_anno) {
-    // note: DexAnnotation's copy ctor only does a shallow copy
-    m->m_param_anno.emplace(pair.first, new DexAnnotationSet(*pair.second));
+  if (that->m_param_anno != nullptr) {
+    m->m_param_anno = std::make_unique<ParamAnnotations>();
+    for (auto& pair : *that->m_param_anno) {
+      // note: DexAnnotation's copy ctor only does a shallow copy
+      m->m_param_anno->emplace(pair.first, new DexAnnotationSet(*pair.second));
+    }
   }
 
   return m;
@@ -752,6 +966,7 @@ void DexClass::remove_method(const DexMethod* m) {
   if (it != meths.end()) {
     erased = true;
     meths.erase(it);
+    RedexContext::start_resolution_generation();
   }
   redex_assert(erased);
 }
@@ -777,9 +992,12 @@ DexMethod* DexMethodRef::make_concrete(DexAccessFlags access,
                                        bool is_virtual) {
   auto that = static_cast<DexMethod*>(this);
   that->m_access = access;
+  that->m_balloon_pending.store(false, std::memory_order_relaxed);
+  that->drop_pending_dex_code();
   that->m_dex_code = std::move(dc);
   that->m_concrete = true;
   that->m_virtual = is_virtual;
+  RedexContext::start_resolution_generation();
   return that;
 }
 
@@ -788,9 +1006,11 @@ DexMethod* DexMethodRef::make_concrete(DexAccessFlags access,
                                        bool is_virtual) {
   auto that = static_cast<DexMethod*>(this);
   that->m_access = access;
+  that->drop_pending_balloon();
   that->m_code = std::move(dc);
   that->m_concrete = true;
   that->m_virtual = is_virtual;
+  RedexContext::start_resolution_generation();
   return that;
 }
 
@@ -801,9 +1021,14 @@ DexMethod* DexMethodRef::make_concrete(DexAccessFlags access, bool is_virtual) {
 void DexMethod::make_non_concrete() {
   m_access = static_cast<DexAccessFlags>(0);
   m_concrete = false;
+  RedexContext::start_resolution_generation();
+  if (m_code_spilled.load(std::memory_order_relaxed)) {
+    code_spill::impl::discard(this);
+  }
+  drop_pending_balloon();
   m_code.reset();
   m_virtual = false;
-  m_param_anno.clear();
+  m_param_anno.reset();
 }
 
 std::string DexMethod::get_simple_deobfuscated_name() const {
@@ -813,9 +1038,11 @@ std::string DexMethod::get_simple_deobfuscated_name() const {
 /*
  * See class_data_item in Dex spec.
  */
-void DexClass::load_class_data_item(DexIdx* idx,
-                                    uint32_t cdi_off,
-                                    DexEncodedValueArray* svalues) {
+void DexClass::load_class_data_item(
+    DexIdx* idx,
+    uint32_t cdi_off,
+    DexEncodedValueArray* svalues,
+    const std::shared_ptr<DexIdx>& lazy_code_idx) {
   if (cdi_off == 0) return;
   const uint8_t* encd = idx->get_uleb_data(cdi_off);
   uint32_t sfield_count = read_uleb128(&encd);
@@ -846,18 +1073,24 @@ void DexClass::load_class_data_item(DexIdx* idx,
   std::unordered_set<DexMethod*> method_pointer_cache;
   method_pointer_cache.reserve(dmethod_count + vmethod_count);
 
-  auto process_method = [this, &encd, &idx, &method_pointer_cache](
-                            uint32_t& ndex, bool is_virtual) {
+  auto process_method = [this, &encd, &idx, &lazy_code_idx,
+                         &method_pointer_cache](uint32_t& ndex,
+                                                bool is_virtual) {
     ndex += read_uleb128(&encd);
     auto access_flags = (DexAccessFlags)read_uleb128(&encd);
     uint32_t code_off = read_uleb128(&encd);
     // Find method in method index, returns same pointer for same method.
     DexMethod* dm = static_cast<DexMethod*>(idx->get_methodidx(ndex));
-    std::unique_ptr<DexCode> dc = DexCode::get_dex_code(idx, code_off);
-    if (dc && dc->get_debug_item()) {
-      dc->get_debug_item()->bind_positions(dm, m_source_file);
+    if (lazy_code_idx != nullptr && code_off != 0) {
+      dm->make_concrete(access_flags, std::unique_ptr<DexCode>(), is_virtual);
+      dm->defer_dex_code(lazy_code_idx, code_off, m_source_file);
+    } else {
+      std::unique_ptr<DexCode> dc = DexCode::get_dex_code(idx, code_off);
+      if (dc && dc->get_debug_item()) {
+        dc->get_debug_item()->bind_positions(dm, m_source_file);
+      }
+      dm->make_concrete(access_flags, std::move(dc), is_virtual);
     }
-    dm->make_concrete(access_flags, std::move(dc), is_virtual);
 
     const auto& pair = method_pointer_cache.insert(dm);
     bool insertion_happened = pair.second;
@@ -882,7 +1115,11 @@ void DexClass::load_class_data_item(DexIdx* idx,
   }
 }
 
-std::unique_ptr<IRCode> DexMethod::release_code() { return std::move(m_code); }
+std::unique_ptr<IRCode> DexMethod::release_code() {
+  ensure_ballooned();
+  note_code_use();
+  return std::move(m_code);
+}
 
 std::vector<DexMethod*> DexClass::get_all_methods() const {
   std::vector<DexMethod*> all_methods(m_vmethods.begin(), m_vmethods.end());
@@ -900,6 +1137,7 @@ void DexClass::add_method(DexMethod* m) {
   } else {
     insert_sorted(m_dmethods, m, compare_dexmethods);
   }
+  RedexContext::start_resolution_generation();
 }
 
 std::vector<DexField*> DexClass::get_all_fields() const {
@@ -919,6 +1157,7 @@ void DexClass::add_field(DexField* f) {
   } else {
     insert_sorted(m_ifields, f, compare_dexfields);
   }
+  RedexContext::start_resolution_generation();
 }
 
 void DexClass::remove_field(const DexField* f) {
@@ -929,6 +1168,7 @@ void DexClass::remove_field(const DexField* f) {
   if (it != fields.end()) {
     erase = true;
     fields.erase(it);
+    RedexContext::start_resolution_generation();
   }
   redex_assert(erase);
 }
@@ -1176,7 +1416,9 @@ DexAnnotationDirectory* DexClass::get_annotation_directory() {
 
 DexClass* DexClass::create(DexIdx* idx,
                            const dex_class_def* cdef,
-                           const std::string& location) {
+                           const std::string& location,
+                           const std::shared_ptr<DexIdx>& lazy_code_idx) {
+  redex_assert(lazy_code_idx == nullptr || lazy_code_idx.get() == idx);
   DexClass* cls = new DexClass(idx, cdef, location);
   if (g_redex->class_already_loaded(cls)) {
     // FIXME: This isn't deterministic. We're keeping whichever class we loaded
@@ -1188,7 +1430,8 @@ DexClass* DexClass::create(DexIdx* idx,
   cls->load_class_annotations(idx, cdef->annotations_off);
   auto deva = std::unique_ptr<DexEncodedValueArray>(
       load_static_values(idx, cdef->static_values_off));
-  cls->load_class_data_item(idx, cdef->class_data_offset, deva.get());
+  cls->load_class_data_item(idx, cdef->class_data_offset, deva.get(),
+                            lazy_code_idx);
   g_redex->publish_class(cls);
   return cls;
 }
@@ -1521,7 +1764,7 @@ template <typename C>
 void DexMethod::gather_types(C& ltype) const {
   gather_types_shallow(ltype); // Handle DexMethodRef parts.
   std::vector<DexType*> type_vec; // Simplify refactor.
-  if (m_code) m_code->gather_types(type_vec);
+  if (auto* code = get_code()) code->gather_types(type_vec);
   if (m_anno) m_anno->gather_types(type_vec);
   auto param_anno = get_param_anno();
   if (param_anno) {
@@ -1537,9 +1780,9 @@ INSTANTIATE(DexMethod::gather_types, DexType*)
 template <typename C>
 void DexMethod::gather_callsites(C& lcallsite) const {
   // We handle m_spec.cls and proto in the first-layer gather.
-  if (m_code) {
+  if (auto* code = get_code()) {
     std::vector<DexCallSite*> callsite_vec; // Simplify refactor.
-    m_code->gather_callsites(callsite_vec);
+    code->gather_callsites(callsite_vec);
     c_append_all(lcallsite, callsite_vec.begin(), callsite_vec.end());
   }
 }
@@ -1549,7 +1792,7 @@ template <typename C>
 void DexMethod::gather_methodhandles(C& lmethodhandle) const {
   // We handle m_spec.cls and proto in the first-layer gather.
   std::vector<DexMethodHandle*> mhandles_vec; // Simplify refactor.
-  if (m_code) m_code->gather_methodhandles(mhandles_vec);
+  if (auto* code = get_code()) code->gather_methodhandles(mhandles_vec);
   c_append_all(lmethodhandle, mhandles_vec.begin(), mhandles_vec.end());
 }
 INSTANTIATE(DexMethod::gather_methodhandles, DexMethodHandle*)
@@ -1557,7 +1800,8 @@ template <typename C>
 void DexMethod::gather_strings(C& lstring, bool exclude_loads) const {
   // We handle m_name and proto in the first-layer gather.
   std::vector<DexString*> strings_vec; // Simplify refactor.
-  if (m_code && !exclude_loads) m_code->gather_strings(strings_vec);
+  auto* code = exclude_loads ? nullptr : get_code();
+  if (code) code->gather_strings(strings_vec);
   if (m_anno) m_anno->gather_strings(strings_vec);
   auto param_anno = get_param_anno();
   if (param_anno) {
@@ -1572,7 +1816,7 @@ INSTANTIATE2(DexMethod::gather_strings, DexString*, bool)
 template <typename C>
 void DexMethod::gather_fields(C& lfield) const {
   std::vector<DexFieldRef*> fields_vec; // Simplify refactor.
-  if (m_code) m_code->gather_fields(fields_vec);
+  if (auto* code = get_code()) code->gather_fields(fields_vec);
   if (m_anno) m_anno->gather_fields(fields_vec);
   auto param_anno = get_param_anno();
   if (param_anno) {
@@ -1587,9 +1831,9 @@ INSTANTIATE(DexMethod::gather_fields, DexFieldRef*)
 
 template <typename C>
 void DexMethod::gather_methods(C& lmethod) const {
-  if (m_code) {
+  if (auto* code = get_code()) {
     std::vector<DexMethodRef*> method_vec; // Simplify refactor.
-    m_code->gather_methods(method_vec);
+    code->gather_methods(method_vec);
     c_append_all(lmethod, method_vec.begin(), method_vec.end());
   }
   gather_methods_from_annos(lmethod);
@@ -1642,6 +1886,9 @@ void DexMethodRef::gather_strings_shallow(C& lstring) const {
 INSTANTIATE(DexMethodRef::gather_strings_shallow, DexString*)
 
 uint32_t DexCode::size() const {
+  if (m_packed) {
+    return m_packed->size;
+  }
   uint32_t size = 0;
   for (auto const& opc : get_instructions()) {
     if (!dex_opcode::is_fopcode(opc->opcode())) {
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstdlib>
 #include <cstring>
 #include <functional>
@@ -122,6 +123,12 @@ class DexString {
   const char* c_str() const { return m_storage.c_str(); }
   const std::string& str() const { return m_storage; }
 
+  // For accessors that return a reference to a string that may not be set.
+  static const std::string& empty_str() {
+    static const std::string empty;
+    return empty;
+  }
+
   uint32_t get_entry_size() const {
     uint32_t len = uleb128_encoding_size(m_utfsize);
     len += size();
@@ -324,7 +331,8 @@ class DexField : public DexFieldRef {
   DexAccessFlags m_access;
   DexAnnotationSet* m_anno;
   DexEncodedValue* m_value; /* Static Only */
-  std::string m_deobfuscated_name;
+  // Interned, as most fields never get one and a string would take 32 bytes.
+  const DexString* m_deobfuscated_name{nullptr};
 
   // See UNIQUENESS above for the rationale for the private constructor pattern.
   DexField(DexType* container, DexString* name, DexType* type)
@@ -394,16 +402,18 @@ class DexField : public DexFieldRef {
   void set_external() {
     always_assert_log(!m_concrete, "Unexpected concrete field %s\n",
                       self_show().c_str());
-    m_deobfuscated_name = self_show();
+    set_deobfuscated_name(self_show());
     m_external = true;
   }
 
   void set_deobfuscated_name(const std::string& name) {
-    m_deobfuscated_name = name;
+    m_deobfuscated_name =
+        name.empty() ? nullptr : DexString::make_string(name);
   }
 
   const std::string& get_deobfuscated_name() const {
-    return m_deobfuscated_name;
+    return m_deobfuscated_name != nullptr ? m_deobfuscated_name->str()
+                                          : DexString::empty_str();
   }
 
   // Return just the name of the field.
@@ -703,10 +713,47 @@ class IRCode;
 class DexCode {
   friend class DexMethod;
 
+  /*
+   * The instructions once they are written, see pack(): their code units,
+   * with zeros in place of the indices of the references, which are patched
+   * in by encode().
+   */
+  struct PackedRef {
+    enum Kind : uint8_t {
+      STRING,
+      JUMBO_STRING,
+      TYPE,
+      FIELD,
+      METHOD,
+      CALLSITE,
+      METHODHANDLE,
+    };
+    // Offset of the index, in code units.
+    uint32_t offset;
+    Kind kind;
+    union {
+      DexString* string;
+      DexType* type;
+      DexFieldRef* field;
+      DexMethodRef* method;
+      DexCallSite* callsite;
+      DexMethodHandle* methodhandle;
+    };
+  };
+  struct PackedInstructions {
+    std::vector<uint16_t> units;
+    std::vector<PackedRef> refs;
+    uint32_t num_instructions;
+    uint32_t size;
+  };
+
   uint16_t m_registers_size;
   uint16_t m_ins_size;
   uint16_t m_outs_size;
   std::unique_ptr<std::vector<DexInstruction*>> m_insns;
+  std::unique_ptr<PackedInstructions> m_packed;
+
+  void encode_packed(DexOutputIdx* dodx, uint16_t*& insns) const;
   std::vector<std::unique_ptr<DexTryItem>> m_tries;
   std::unique_ptr<DexDebugItem> m_dbg;
 
@@ -777,6 +824,21 @@ class DexCode {
    */
   uint32_t size() const;
 
+  /*
+   * Replaces the instructions by their code units, which take a fraction of
+   * the memory. Packed code can still be encoded, as often as needed, but its
+   * instructions cannot be accessed anymore.
+   */
+  void pack();
+  bool is_packed() const { return m_packed != nullptr; }
+
+  /*
+   * Returns the number of instructions, including the payloads.
+   */
+  uint32_t num_instructions() const {
+    return m_packed ? m_packed->num_instructions : get_instructions().size();
+  }
+
   friend std::string show(const DexCode*);
 };
 
@@ -849,9 +911,17 @@ class DexMethodRef {
   static void erase_method(DexMethodRef* m) { return g_redex->erase_method(m); }
 };
 
+namespace code_spill {
+namespace impl {
+class MethodAccess;
+} // namespace impl
+} // namespace code_spill
+
 class DexMethod : public DexMethodRef {
   friend struct RedexContext;
+  friend class DexClass;
   friend class DexMethodRef;
+  friend class code_spill::impl::MethodAccess;
 
   /* Concrete method members */
 
@@ -862,8 +932,57 @@ class DexMethod : public DexMethodRef {
   DexAnnotationSet* m_anno;
   std::unique_ptr<DexCode> m_dex_code;
   std::unique_ptr<IRCode> m_code;
-  ParamAnnotations m_param_anno;
-  std::string m_deobfuscated_name;
+  // Few methods have parameter annotations or a deobfuscated name, so these
+  // are kept out of line rather than as a map and a string of their own.
+  std::unique_ptr<ParamAnnotations> m_param_anno;
+  const DexString* m_deobfuscated_name{nullptr};
+
+  // Bookkeeping for spilling the code to disk, see CodeSpill.h. The epoch is
+  // zero while spilling is off, so that get_code() only pays for a load.
+  static std::atomic<uint32_t> s_code_epoch;
+  mutable std::atomic<uint32_t> m_code_epoch{0};
+  mutable std::atomic<bool> m_code_spilled{false};
+
+  void note_code_use() const {
+    auto epoch = s_code_epoch.load(std::memory_order_relaxed);
+    if (epoch != 0) {
+      note_code_use(epoch);
+    }
+  }
+  void note_code_use(uint32_t epoch) const;
+
+  // Set while m_dex_code waits to be ballooned on first access, see
+  // defer_balloon().
+  mutable std::atomic<bool> m_balloon_pending{false};
+
+  void ensure_ballooned() const {
+    if (m_balloon_pending.load(std::memory_order_acquire)) {
+      balloon_pending();
+    }
+  }
+  void balloon_pending() const;
+  void drop_pending_balloon();
+
+  // Set while m_dex_code waits to be parsed from its dex on first access, see
+  // defer_dex_code().
+  mutable std::atomic<bool> m_dex_code_pending{false};
+
+  void ensure_dex_code() const {
+    if (m_dex_code_pending.load(std::memory_order_acquire)) {
+      load_pending_dex_code();
+    }
+  }
+  void load_pending_dex_code() const;
+  void drop_pending_dex_code();
+
+  /*
+   * Leaves the code item at the given offset to be parsed on first access of
+   * the DexCode. The dex, which `idx` keeps mapped, is released once all the
+   * code items that wait on it are parsed or dropped.
+   */
+  void defer_dex_code(std::shared_ptr<DexIdx> idx,
+                      uint32_t code_off,
+                      DexString* source_file);
 
   // See UNIQUENESS above for the rationale for the private constructor pattern.
   DexMethod(DexType* type, DexString* name, DexProto* proto);
@@ -975,10 +1094,29 @@ class DexMethod : public DexMethodRef {
  public:
   const DexAnnotationSet* get_anno_set() const { return m_anno; }
   DexAnnotationSet* get_anno_set() { return m_anno; }
-  const DexCode* get_dex_code() const { return m_dex_code.get(); }
-  DexCode* get_dex_code() { return m_dex_code.get(); }
-  IRCode* get_code() { return m_code.get(); }
-  const IRCode* get_code() const { return m_code.get(); }
+  const DexCode* get_dex_code() const {
+    ensure_dex_code();
+    return m_dex_code.get();
+  }
+  DexCode* get_dex_code() {
+    ensure_dex_code();
+    return m_dex_code.get();
+  }
+  // Unlike get_dex_code() != nullptr, does not parse a deferred code item.
+  bool has_dex_code() const {
+    return m_dex_code_pending.load(std::memory_order_acquire) ||
+           m_dex_code != nullptr;
+  }
+  IRCode* get_code() {
+    ensure_ballooned();
+    note_code_use();
+    return m_code.get();
+  }
+  const IRCode* get_code() const {
+    ensure_ballooned();
+    note_code_use();
+    return m_code.get();
+  }
   std::unique_ptr<IRCode> release_code();
   bool is_virtual() const { return m_virtual; }
   DexAccessFlags get_access() const {
@@ -986,20 +1124,22 @@ class DexMethod : public DexMethodRef {
     return m_access;
   }
   const ParamAnnotations* get_param_anno() const {
-    if (m_param_anno.empty()) return nullptr;
-    return &m_param_anno;
+    if (!m_param_anno || m_param_anno->empty()) return nullptr;
+    return m_param_anno.get();
   }
   ParamAnnotations* get_param_anno() {
-    if (m_param_anno.empty()) return nullptr;
-    return &m_param_anno;
+    if (!m_param_anno || m_param_anno->empty()) return nullptr;
+    return m_param_anno.get();
   }
 
   void set_deobfuscated_name(const std::string& name) {
-    m_deobfuscated_name = name;
+    m_deobfuscated_name =
+        name.empty() ? nullptr : DexString::make_string(name);
   }
 
   const std::string& get_deobfuscated_name() const {
-    return m_deobfuscated_name;
+    return m_deobfuscated_name != nullptr ? m_deobfuscated_name->str()
+                                          : DexString::empty_str();
   }
 
   // Return just the name of the method.
@@ -1024,10 +1164,11 @@ class DexMethod : public DexMethodRef {
   void set_external() {
     always_assert_log(!m_concrete, "Unexpected concrete method %s\n",
                       self_show().c_str());
-    m_deobfuscated_name = self_show();
+    set_deobfuscated_name(self_show());
     m_external = true;
   }
   void set_dex_code(std::unique_ptr<DexCode> code) {
+    drop_pending_dex_code();
     m_dex_code = std::move(code);
   }
   void set_code(std::unique_ptr<IRCode> code);
@@ -1055,12 +1196,18 @@ class DexMethod : public DexMethodRef {
         m_anno->combine_with(*other->m_anno);
       }
     }
-    for (auto& pair : other->m_param_anno) {
-      if (m_param_anno.count(pair.first) == 0 ||
-          m_param_anno[pair.first] == nullptr) {
-        m_param_anno.emplace(pair.first, new DexAnnotationSet(*pair.second));
+    if (other->m_param_anno == nullptr) {
+      return;
+    }
+    if (m_param_anno == nullptr) {
+      m_param_anno = std::make_unique<ParamAnnotations>();
+    }
+    for (auto& pair : *other->m_param_anno) {
+      auto& anno = (*m_param_anno)[pair.first];
+      if (anno == nullptr) {
+        anno = new DexAnnotationSet(*pair.second);
       } else {
-        m_param_anno[pair.first]->combine_with(*pair.second);
+        anno->combine_with(*pair.second);
       }
     }
   }
@@ -1077,11 +1224,14 @@ class DexMethod : public DexMethodRef {
   void attach_param_annotation_set(int paramno, DexAnnotationSet* aset) {
     always_assert_type_log(!m_concrete, RedexError::BAD_ANNOTATION,
                            "method %s is concrete\n", self_show().c_str());
-    always_assert_type_log(m_param_anno.count(paramno) == 0,
+    if (m_param_anno == nullptr) {
+      m_param_anno = std::make_unique<ParamAnnotations>();
+    }
+    always_assert_type_log(m_param_anno->count(paramno) == 0,
                            RedexError::BAD_ANNOTATION,
                            "param %d annotation to method %s exists\n", paramno,
                            self_show().c_str());
-    m_param_anno[paramno] = aset;
+    (*m_param_anno)[paramno] = aset;
   }
 
   template <typename C>
@@ -1111,6 +1261,13 @@ class DexMethod : public DexMethodRef {
   void balloon();
   void sync();
 
+  /*
+   * Like balloon(), but only once the code is first accessed through
+   * get_code() or release_code(), which may then happen concurrently. Until
+   * then the method keeps its DexCode.
+   */
+  void defer_balloon();
+
   // This method frees the given `DexMethod` - different from `erase_method`,
   // which removes the method from the `RedexContext`.
   //
@@ -1143,7 +1300,8 @@ class DexClass {
   void load_class_annotations(DexIdx* idx, uint32_t anno_off);
   void load_class_data_item(DexIdx* idx,
                             uint32_t cdi_off,
-                            DexEncodedValueArray* svalues);
+                            DexEncodedValueArray* svalues,
+                            const std::shared_ptr<DexIdx>& lazy_code_idx);
 
   friend struct ClassCreator;
 
@@ -1155,21 +1313,29 @@ class DexClass {
  public:
   ReferencedState rstate;
 
-  // May return nullptr on benign duplicate class
-  static DexClass* create(DexIdx* idx,
-                          const dex_class_def* cdef,
-                          const std::string& location);
+  // May return nullptr on benign duplicate class. When `lazy_code_idx` is
+  // set, it owns `idx`, and the code items of the methods are only parsed on
+  // first access, see DexMethod::defer_dex_code().
+  static DexClass* create(
+      DexIdx* idx,
+      const dex_class_def* cdef,
+      const std::string& location,
+      const std::shared_ptr<DexIdx>& lazy_code_idx = nullptr);
 
   const std::vector<DexMethod*>& get_dmethods() const { return m_dmethods; }
   std::vector<DexMethod*>& get_dmethods() {
     always_assert_log(!m_external, "Unexpected external class %s\n",
                       self_show().c_str());
+    // The caller may edit the members.
+    RedexContext::start_resolution_generation();
     return m_dmethods;
   }
   const std::vector<DexMethod*>& get_vmethods() const { return m_vmethods; }
   std::vector<DexMethod*>& get_vmethods() {
     always_assert_log(!m_external, "Unexpected external class %s\n",
                       self_show().c_str());
+    // The caller may edit the members.
+    RedexContext::start_resolution_generation();
     return m_vmethods;
   }
 
@@ -1212,11 +1378,13 @@ class DexClass {
   const std::vector<DexField*>& get_sfields() const { return m_sfields; }
   std::vector<DexField*>& get_sfields() {
     redex_assert(!m_external);
+    RedexContext::start_resolution_generation();
     return m_sfields;
   }
   const std::vector<DexField*>& get_ifields() const { return m_ifields; }
   std::vector<DexField*>& get_ifields() {
     redex_assert(!m_external);
+    RedexContext::start_resolution_generation();
     return m_ifields;
   }
 
@@ -1270,6 +1438,7 @@ class DexClass {
     always_assert_log(!m_external, "Unexpected external class %s\n",
                       self_show().c_str());
     m_super_class = super_class;
+    RedexContext::start_resolution_generation();
   }
 
   void combine_annotations_with(DexClass* other) {
@@ -1287,6 +1456,7 @@ class DexClass {
     always_assert_log(!m_external, "Unexpected external class %s\n",
                       self_show().c_str());
     m_interfaces = intfs;
+    RedexContext::start_resolution_generation();
   }
 
   void clear_annotations() {
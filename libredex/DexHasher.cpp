@@ -8,7 +8,9 @@
 #include "DexHasher.h"
 
 #include <cinttypes>
+#include <numeric>
 
+#include "ControlFlow.h"
 #include "DexAccess.h"
 #include "DexClass.h"
 #include "DexInstruction.h"
@@ -18,7 +20,7 @@
 #include "IROpcode.h"
 #include "Show.h"
 #include "Trace.h"
-#include "Walkers.h"
+#include "WorkQueue.h"
 
 namespace hashing {
 
@@ -30,23 +32,24 @@ std::string hash_to_string(size_t hash) {
 }
 
 DexHash DexScopeHasher::run() {
-  std::unordered_map<DexClass*, size_t> class_indices;
-  walk::classes(m_scope, [&](DexClass* cls) {
-    class_indices.emplace(cls, class_indices.size());
-  });
-  std::vector<size_t> class_positions_hashes(class_indices.size());
-  std::vector<size_t> class_registers_hashes(class_indices.size());
-  std::vector<size_t> class_code_hashes(class_indices.size());
-  std::vector<size_t> class_signature_hashes(class_indices.size());
-  walk::parallel::classes(m_scope, [&](DexClass* cls) {
-    DexClassHasher class_hasher(cls);
-    DexHash class_hash = class_hasher.run();
-    auto index = class_indices.at(cls);
-    class_positions_hashes.at(index) = class_hash.positions_hash;
-    class_registers_hashes.at(index) = class_hash.registers_hash;
-    class_code_hashes.at(index) = class_hash.code_hash;
-    class_signature_hashes.at(index) = class_hash.signature_hash;
-  });
+  // The scope is a vector, so the positions of the classes in it are their
+  // slots in the per-class hash vectors.
+  std::vector<size_t> class_indices(m_scope.size());
+  std::iota(class_indices.begin(), class_indices.end(), 0);
+  std::vector<size_t> class_positions_hashes(m_scope.size());
+  std::vector<size_t> class_registers_hashes(m_scope.size());
+  std::vector<size_t> class_code_hashes(m_scope.size());
+  std::vector<size_t> class_signature_hashes(m_scope.size());
+  workqueue_run<size_t>(
+      [&](size_t index) {
+        DexClassHasher class_hasher(m_scope[index]);
+        DexHash class_hash = class_hasher.run();
+        class_positions_hashes[index] = class_hash.positions_hash;
+        class_registers_hashes[index] = class_hash.registers_hash;
+        class_code_hashes[index] = class_hash.code_hash;
+        class_signature_hashes[index] = class_hash.signature_hash;
+      },
+      class_indices);
 
   return DexHash{boost::hash_value(class_positions_hashes),
                  boost::hash_value(class_registers_hashes),
@@ -59,7 +62,16 @@ void DexClassHasher::hash(const std::string& str) {
   boost::hash_combine(m_hash, str);
 }
 
-void DexClassHasher::hash(const DexString* s) { hash(s->str()); }
+// Combining the memoized hash of the string gives the same result as
+// combining the string itself.
+void DexClassHasher::hash(const DexString* s) {
+  TRACE(HASHER, 4, "[hasher] %s", s->c_str());
+  auto it = m_string_hashes.find(s);
+  if (it == m_string_hashes.end()) {
+    it = m_string_hashes.emplace(s, boost::hash_value(s->str())).first;
+  }
+  boost::hash_combine(m_hash, it->second);
+}
 
 void DexClassHasher::hash(bool value) {
   TRACE(HASHER, 4, "[hasher] %u", value);
@@ -132,6 +144,10 @@ void DexClassHasher::hash(const IRCode* c) {
   if (!c) {
     return;
   }
+  if (c->editable_cfg_built()) {
+    hash(c->cfg());
+    return;
+  }
 
   auto old_hash = m_hash;
   m_hash = 0;
@@ -360,6 +376,39 @@ void DexClassHasher::hash(const DexField* f) {
   hash(f->get_deobfuscated_name());
 }
 
+// Editable CFGs are hashed block by block, in the order of their ids. Positions
+// are not part of the hash.
+void DexClassHasher::hash(const cfg::ControlFlowGraph& cfg) {
+  auto old_hash = m_hash;
+  m_hash = 0;
+
+  hash(cfg.get_registers_size());
+  hash(cfg.entry_block()->id());
+  for (const auto* block : cfg.blocks()) {
+    hash(block->id());
+    for (const auto& mie : InstructionIterable(block)) {
+      hash(mie.insn);
+    }
+    hash((uint64_t)block->succs().size());
+    for (const auto* edge : block->succs()) {
+      hash((uint8_t)edge->type());
+      hash(edge->target()->id());
+      if (edge->case_key()) {
+        hash((uint64_t)*edge->case_key());
+      }
+      if (edge->type() == cfg::EDGE_THROW) {
+        if (edge->throw_info()->catch_type) {
+          hash(edge->throw_info()->catch_type);
+        }
+        hash(edge->throw_info()->index);
+      }
+    }
+  }
+
+  boost::hash_combine(m_code_hash, m_hash);
+  m_hash = old_hash;
+}
+
 DexHash DexClassHasher::run() {
   TRACE(HASHER, 2, "[hasher] ==== hashing class %s", SHOW(m_cls->get_type()));
 
@@ -386,4 +435,22 @@ DexHash DexClassHasher::run() {
   return DexHash{m_positions_hash, m_registers_hash, m_code_hash, m_hash};
 }
 
+DexHash DexMethodHasher::run() {
+  TRACE(HASHER, 3, "[hasher] ==== hashing method %s", SHOW(m_method));
+  DexClassHasher hasher(nullptr);
+  hasher.hash(m_method);
+  return DexHash{hasher.m_positions_hash, hasher.m_registers_hash,
+                 hasher.m_code_hash, hasher.m_hash};
+}
+
+size_t stable_instructions_hash(const IRCode* code) {
+  DexClassHasher hasher(nullptr);
+  for (const auto& mie : InstructionIterable(code)) {
+    hasher.hash(mie.insn);
+  }
+  auto result = hasher.m_hash;
+  boost::hash_combine(result, hasher.m_registers_hash);
+  return result;
+}
+
 } // namespace hashing
@@ -19,12 +19,17 @@
 #include <memory>
 #include <ostream>
 #include <string>
+#include <unordered_map>
 
 #include "Debug.h"
 #include "DexClass.h"
 #include "IRInstruction.h"
 #include "Sha1.h"
 
+namespace cfg {
+class ControlFlowGraph;
+} // namespace cfg
+
 namespace hashing {
 
 std::string hash_to_string(size_t hash);
@@ -51,6 +56,9 @@ class DexClassHasher final {
   DexHash run();
 
  private:
+  friend class DexMethodHasher;
+  friend size_t stable_instructions_hash(const IRCode* code);
+
   void hash(const std::string& str);
   void hash(int value);
   void hash(uint64_t value);
@@ -59,6 +67,7 @@ class DexClassHasher final {
   void hash(uint8_t value);
   void hash(bool value);
   void hash(const IRCode* c);
+  void hash(const cfg::ControlFlowGraph& cfg);
   void hash(const IRInstruction* insn);
   void hash(const EncodedAnnotations* a);
   void hash(const ParamAnnotations* m);
@@ -97,10 +106,34 @@ class DexClassHasher final {
     }
   }
   DexClass* m_cls;
+  // Names and types recur throughout a class, and hashing a string goes
+  // through all of its bytes.
+  std::unordered_map<const DexString*, size_t> m_string_hashes;
   size_t m_hash{0};
   size_t m_code_hash{0};
   size_t m_registers_hash{0};
   size_t m_positions_hash{0};
 };
 
+/*
+ * Hashes a single method in the same way as DexClassHasher, e.g. to tell
+ * whether it changed between two builds.
+ */
+class DexMethodHasher final {
+ public:
+  explicit DexMethodHasher(const DexMethod* method) : m_method(method) {}
+  DexHash run();
+
+ private:
+  const DexMethod* m_method;
+};
+
+/*
+ * Hashes the instructions of the code in order, including their registers,
+ * ignoring positions, debug info, source blocks and branch targets. Code that
+ * is IRCode::structural_equals hashes the same. Referenced types, fields,
+ * methods and strings are hashed by name, so the hash is stable across runs.
+ */
+size_t stable_instructions_hash(const IRCode* code);
+
 } // namespace hashing
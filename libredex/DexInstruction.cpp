@@ -766,6 +766,18 @@ void DexInstruction::encode(DexOutputIdx* /* unused */,
   encode_args(insns);
 }
 
+void DexInstruction::encode_without_ref(uint16_t*& insns) const {
+  if (m_ref_type == REF_NONE) {
+    encode(nullptr, insns);
+    return;
+  }
+  encode_opcode(insns);
+  for (int i = m_count + 1; i < size(); i++) {
+    *insns++ = 0;
+  }
+  encode_args(insns);
+}
+
 uint16_t DexInstruction::size() const { return m_count + 1; }
 
 DexInstruction* DexInstruction::make_instruction(DexIdx* idx,
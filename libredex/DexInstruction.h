@@ -87,6 +87,11 @@ class DexInstruction : public Gatherable {
   /* Creates the right subclass of DexInstruction for the given opcode */
   static DexInstruction* make_instruction(DexOpcode);
   virtual void encode(DexOutputIdx* dodx, uint16_t*& insns) const;
+  /*
+   * Like encode(), but with zeros in place of the index of the reference, so
+   * that no DexOutputIdx is needed. See DexCode::pack().
+   */
+  void encode_without_ref(uint16_t*& insns) const;
   virtual uint16_t size() const;
   virtual DexInstruction* clone() const { return new DexInstruction(*this); }
   bool operator==(const DexInstruction&) const;
@@ -20,6 +20,10 @@
 #include <stdexcept>
 #include <vector>
 
+static bool s_lazy_code_loading = false;
+
+void set_lazy_code_loading(bool lazy) { s_lazy_code_loading = lazy; }
+
 DexLoader::DexLoader(const char* location)
     : m_idx(nullptr),
       m_file(new boost::iostreams::mapped_file()),
@@ -132,6 +136,10 @@ void DexLoader::gather_input_stats(dex_stats_t* stats, const dex_header* dh) {
     stats->num_fields += clz->get_ifields().size() + clz->get_sfields().size();
     stats->num_methods +=
         clz->get_vmethods().size() + clz->get_dmethods().size();
+    if (m_lazy_code) {
+      // Counting the instructions would parse all the code items.
+      continue;
+    }
     for (auto* meth : clz->get_vmethods()) {
       DexCode* code = meth->get_dex_code();
       if (code) {
@@ -446,7 +454,8 @@ void DexLoader::gather_input_stats(dex_stats_t* stats, const dex_header* dh) {
 
 void DexLoader::load_dex_class(int num) {
   const dex_class_def* cdef = m_class_defs + num;
-  DexClass* dc = DexClass::create(m_idx.get(), cdef, m_dex_location);
+  DexClass* dc = DexClass::create(m_idx.get(), cdef, m_dex_location,
+                                  m_lazy_code ? m_idx : nullptr);
   // We may be inserting a nullptr here. Need to remove them later
   //
   // We're inserting nullptr because we can't mess up the indices of the other
@@ -463,67 +472,108 @@ const dex_header* DexLoader::get_dex_header(const char* location) {
   return reinterpret_cast<const dex_header*>(m_file->const_data());
 }
 
+const dex_header* DexLoader::open_dex(const char* location,
+                                     int support_dex_version) {
+  const dex_header* dh = get_dex_header(location);
+  validate_dex_header(dh, m_file->size(), support_dex_version);
+  // Only a header that we mapped can be kept alive for lazy code loading.
+  m_lazy_code = s_lazy_code_loading;
+  return dh;
+}
+
 DexClasses DexLoader::load_dex(const char* location,
                                dex_stats_t* stats,
                                int support_dex_version) {
-  const dex_header* dh = get_dex_header(location);
-  validate_dex_header(dh, m_file->size(), support_dex_version);
-  return load_dex(dh, stats);
+  return load_dex(open_dex(location, support_dex_version), stats);
 }
 
-DexClasses DexLoader::load_dex(const dex_header* dh, dex_stats_t* stats) {
-  if (dh->class_defs_size == 0) {
-    return DexClasses(0);
+void DexLoader::init_class_defs(const dex_header* dh, DexClasses* classes) {
+  if (m_lazy_code) {
+    m_idx = std::shared_ptr<DexIdx>(
+        new DexIdx(dh), [file = m_file](DexIdx* idx) { delete idx; });
+  } else {
+    m_idx = std::make_shared<DexIdx>(dh);
   }
-  m_idx = std::make_unique<DexIdx>(dh);
   auto off = (uint64_t)dh->class_defs_off;
   m_class_defs =
       reinterpret_cast<const dex_class_def*>((const uint8_t*)dh + off);
-  DexClasses classes(dh->class_defs_size);
-  m_classes = &classes;
-
-  {
-    auto num_threads = redex_parallel::default_num_threads();
-    std::vector<std::vector<std::exception_ptr>> exceptions_vec(num_threads);
-    std::vector<size_t> indices(dh->class_defs_size);
-    std::iota(indices.begin(), indices.end(), 0);
-    workqueue_run<size_t>(
-        [&exceptions_vec, this](sparta::SpartaWorkerState<size_t>* state,
-                                size_t num) {
-          try {
-            load_dex_class(num);
-          } catch (const std::exception& exc) {
-            TRACE(MAIN, 1, "Worker throw the exception:%s", exc.what());
-            exceptions_vec[state->worker_id()].emplace_back(
-                std::current_exception());
-          }
-        },
-        indices,
-        num_threads);
-
-    std::vector<std::exception_ptr> all_exceptions;
-    for (auto& exceptions : exceptions_vec) {
-      all_exceptions.insert(all_exceptions.end(), exceptions.begin(),
-                            exceptions.end());
-    }
-    if (!all_exceptions.empty()) {
-      // At least one of the workers raised an exception
-      aggregate_exception ae(all_exceptions);
-      throw ae;
-    }
-  }
+  classes->resize(dh->class_defs_size);
+  m_classes = classes;
+}
 
+void DexLoader::finish_load(const dex_header* dh, dex_stats_t* stats) {
   gather_input_stats(stats, dh);
 
   // Remove nulls from the classes list. They may have been introduced by benign
   // duplicate classes.
-  classes.erase(std::remove(classes.begin(), classes.end(), nullptr),
-                classes.end());
+  m_classes->erase(std::remove(m_classes->begin(), m_classes->end(), nullptr),
+                   m_classes->end());
+}
+
+namespace {
+
+// Runs `load` on all the tasks in parallel, and then rethrows the exceptions
+// of all the workers at once.
+template <typename Task, typename LoadFn>
+void run_load_tasks(const std::vector<Task>& tasks, const LoadFn& load) {
+  auto num_threads = redex_parallel::default_num_threads();
+  std::vector<std::vector<std::exception_ptr>> exceptions_vec(num_threads);
+  workqueue_run<Task>(
+      [&exceptions_vec, &load](sparta::SpartaWorkerState<Task>* state,
+                               const Task& task) {
+        try {
+          load(task);
+        } catch (const std::exception& exc) {
+          TRACE(MAIN, 1, "Worker throw the exception:%s", exc.what());
+          exceptions_vec[state->worker_id()].emplace_back(
+              std::current_exception());
+        }
+      },
+      tasks,
+      num_threads);
+
+  std::vector<std::exception_ptr> all_exceptions;
+  for (auto& exceptions : exceptions_vec) {
+    all_exceptions.insert(all_exceptions.end(), exceptions.begin(),
+                          exceptions.end());
+  }
+  if (!all_exceptions.empty()) {
+    // At least one of the workers raised an exception
+    aggregate_exception ae(all_exceptions);
+    throw ae;
+  }
+}
+
+} // namespace
 
+DexClasses DexLoader::load_dex(const dex_header* dh, dex_stats_t* stats) {
+  if (dh->class_defs_size == 0) {
+    return DexClasses(0);
+  }
+  DexClasses classes;
+  init_class_defs(dh, &classes);
+
+  std::vector<size_t> indices(dh->class_defs_size);
+  std::iota(indices.begin(), indices.end(), 0);
+  run_load_tasks(indices, [this](size_t num) { load_dex_class(num); });
+
+  finish_load(dh, stats);
   return classes;
 }
 
+static bool s_lazy_ballooning = false;
+
+void set_lazy_ballooning(bool lazy) { s_lazy_ballooning = lazy; }
+
 static void balloon_all(const Scope& scope) {
+  if (s_lazy_ballooning) {
+    walk::methods(scope, [&](DexMethod* m) {
+      if (m->has_dex_code()) {
+        m->defer_balloon();
+      }
+    });
+    return;
+  }
   walk::parallel::methods(scope, [&](DexMethod* m) {
     if (m->get_dex_code()) {
       m->balloon();
@@ -562,6 +612,67 @@ DexClasses load_classes_from_dex(const dex_header* dh,
   return classes;
 }
 
+std::vector<DexClasses> load_classes_from_dexes(
+    const std::vector<std::string>& locations,
+    std::vector<dex_stats_t>* stats,
+    bool balloon,
+    int support_dex_version) {
+  std::vector<std::unique_ptr<DexLoader>> loaders;
+  std::vector<const dex_header*> headers;
+  std::vector<DexClasses> classes(locations.size());
+  // (dex, class def) pairs.
+  std::vector<std::pair<size_t, size_t>> tasks;
+  std::vector<std::pair<size_t, size_t>> duplicates;
+  std::unordered_set<const DexType*> seen;
+  for (size_t i = 0; i < locations.size(); ++i) {
+    const char* location = locations[i].c_str();
+    TRACE(MAIN, 1, "Loading classes from dex from %s", location);
+    loaders.emplace_back(std::make_unique<DexLoader>(location));
+    auto& dl = *loaders.back();
+    const dex_header* dh = dl.open_dex(location, support_dex_version);
+    headers.push_back(dh);
+    if (dh->class_defs_size == 0) {
+      continue;
+    }
+    dl.init_class_defs(dh, &classes[i]);
+    for (size_t num = 0; num < dh->class_defs_size; ++num) {
+      auto* type = dl.m_idx->get_typeidx(dl.m_class_defs[num].typeidx);
+      if (seen.insert(type).second) {
+        tasks.emplace_back(i, num);
+      } else {
+        duplicates.emplace_back(i, num);
+      }
+    }
+  }
+
+  run_load_tasks(tasks, [&loaders](const std::pair<size_t, size_t>& task) {
+    loaders[task.first]->load_dex_class(task.second);
+  });
+  for (const auto& dup : duplicates) {
+    loaders[dup.first]->load_dex_class(dup.second);
+  }
+
+  if (stats != nullptr) {
+    stats->resize(locations.size());
+  }
+  for (size_t i = 0; i < locations.size(); ++i) {
+    if (headers[i]->class_defs_size != 0) {
+      loaders[i]->finish_load(headers[i],
+                              stats != nullptr ? &stats->at(i) : nullptr);
+    }
+  }
+  loaders.clear();
+
+  if (balloon) {
+    Scope scope;
+    for (const auto& dex : classes) {
+      scope.insert(scope.end(), dex.begin(), dex.end());
+    }
+    balloon_all(scope);
+  }
+  return classes;
+}
+
 std::string load_dex_magic_from_dex(const char* location) {
   DexLoader dl(location);
   auto dh = dl.get_dex_header(location);
@@ -16,16 +16,30 @@
 #include "DexUtil.h"
 
 class DexLoader {
-  std::unique_ptr<DexIdx> m_idx;
+  // Shared with the methods whose code items are parsed lazily, see
+  // set_lazy_code_loading(); the index then keeps the file mapped.
+  std::shared_ptr<DexIdx> m_idx;
   const dex_class_def* m_class_defs;
   DexClasses* m_classes;
-  std::unique_ptr<boost::iostreams::mapped_file> m_file;
+  std::shared_ptr<boost::iostreams::mapped_file> m_file;
+  bool m_lazy_code{false};
   std::string m_dex_location;
 
+  void init_class_defs(const dex_header* dh, DexClasses* classes);
+  void finish_load(const dex_header* dh, dex_stats_t* stats);
+
+  friend std::vector<DexClasses> load_classes_from_dexes(
+      const std::vector<std::string>& locations,
+      std::vector<dex_stats_t>* stats,
+      bool balloon,
+      int support_dex_version);
+
  public:
   explicit DexLoader(const char* location);
 
   const dex_header* get_dex_header(const char* location);
+  // Maps and validates the dex header.
+  const dex_header* open_dex(const char* location, int support_dex_version);
   DexClasses load_dex(const char* location,
                       dex_stats_t* stats,
                       int support_dex_version);
@@ -45,9 +59,38 @@ DexClasses load_classes_from_dex(const char* location,
 DexClasses load_classes_from_dex(const dex_header* dh,
                                  const char* location,
                                  bool balloon = true);
+
+/*
+ * Loads the classes of several dexes at once, with the classes of all of
+ * them in a single work queue, so that small dexes do not leave threads idle.
+ * The result, and the stats if given, are in the order of `locations`.
+ *
+ * Which copy of a duplicate class is kept does not depend on the scheduling:
+ * classes that an earlier dex (or earlier in the same dex) also defines are
+ * only loaded once all the others are, in order, which then keeps or reports
+ * them exactly as loading the dexes one after the other would.
+ */
+std::vector<DexClasses> load_classes_from_dexes(
+    const std::vector<std::string>& locations,
+    std::vector<dex_stats_t>* stats,
+    bool balloon = true,
+    int support_dex_version = 35);
 std::string load_dex_magic_from_dex(const char* location);
 void balloon_for_test(const Scope& scope);
 
+/*
+ * When set, loading with `balloon` leaves each method to be ballooned on first
+ * use, see DexMethod::defer_balloon(). Off by default.
+ */
+void set_lazy_ballooning(bool lazy);
+
+/*
+ * When set, the code items of the loaded methods are only parsed, and their
+ * dex kept mapped, until first accessed through DexMethod::get_dex_code().
+ * This speeds up tools that only look at a few methods. Off by default.
+ */
+void set_lazy_code_loading(bool lazy);
+
 static inline const uint8_t* align_ptr(const uint8_t* const ptr,
                                        const size_t alignment) {
   const size_t alignment_error = ((size_t)ptr) % alignment;
@@ -10,6 +10,7 @@
 #include <algorithm>
 #include <assert.h>
 #include <boost/filesystem.hpp>
+#include <boost/functional/hash.hpp>
 #include <exception>
 #include <fcntl.h>
 #include <fstream>
@@ -17,6 +18,7 @@
 #include <inttypes.h>
 #include <list>
 #include <memory>
+#include <numeric>
 #include <stdlib.h>
 #include <sys/stat.h>
 #include <unordered_set>
@@ -35,6 +37,7 @@
 #endif
 
 #include "Debug.h"
+#include "DebugLineMap.h"
 #include "DexCallSite.h"
 #include "DexClass.h"
 #include "DexInstruction.h"
@@ -55,6 +58,13 @@
 #include "Trace.h"
 #include "Walkers.h"
 #include "WorkQueue.h"
+#include "locator_hash.h"
+#include "mmap.h"
+
+#if !IS_WINDOWS
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 /*
  * For adler32...
@@ -94,7 +104,8 @@ class CustomSort {
   }
 };
 
-GatheredTypes::GatheredTypes(DexClasses* classes) : m_classes(classes) {
+GatheredTypes::GatheredTypes(DexClasses* classes, size_t num_threads)
+    : m_classes(classes), m_num_threads(num_threads) {
   // ensure that the string id table contains the empty string, which is used
   // for the DexPosition mapping
   m_lstring.push_back(DexString::make_string(""));
@@ -156,7 +167,8 @@ std::vector<DexMethod*> GatheredTypes::get_dexmethod_emitlist() {
 
 void GatheredTypes::sort_dexmethod_emitlist_method_ref_order(
     std::vector<DexMethod*>& lmeth) {
-  MethodSimilarityOrderer::order(lmeth);
+  MethodSimilarityOrderer::order(lmeth,
+                                 m_method_similarity_minhash_min_methods);
 }
 
 void GatheredTypes::sort_dexmethod_emitlist_default_order(
@@ -182,6 +194,78 @@ void GatheredTypes::sort_dexmethod_emitlist_profiled_order(
   std::stable_sort(lmeth.begin(), lmeth.end(), std::ref(comparator));
 }
 
+void GatheredTypes::gather_method_block_coverage() {
+  std::mutex mutex;
+  walk::parallel::code(*m_classes, [&](DexMethod* method, IRCode& code) {
+    size_t blocks = 0;
+    size_t executed = 0;
+    for (const auto& mie : code) {
+      if (mie.type != MFLOW_SOURCE_BLOCK) {
+        continue;
+      }
+      for (auto sb = mie.src_block.get(); sb != nullptr; sb = sb->next.get()) {
+        blocks++;
+        if (!sb->vals.empty()) {
+          auto val = sb->get_val(0);
+          if (val && *val > 0) {
+            executed++;
+          }
+        }
+      }
+    }
+    if (executed == 0) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    m_method_block_coverage.emplace(method, (float)executed / blocks);
+  });
+}
+
+bool GatheredTypes::is_startup_method(const DexMethod* method) const {
+  if (m_method_block_coverage.count(method)) {
+    return true;
+  }
+  if (m_method_profiles == nullptr) {
+    return false;
+  }
+  auto stat = m_method_profiles->get_method_stat(method_profiles::COLD_START,
+                                                 method);
+  return stat && stat->appear_percent > 0;
+}
+
+void GatheredTypes::sort_dexmethod_emitlist_page_order(
+    std::vector<DexMethod*>& lmeth) {
+  // Code items are only paged in when they run. Packing all the methods that
+  // run during cold start together, in the order in which they are first
+  // hit, keeps the pages touched during cold start few and contiguous.
+  // Methods with a cold start profile come first by average rank, then the
+  // methods that only have executed source blocks by decreasing coverage.
+  // All others keep their relative order.
+  const method_profiles::StatsMap* stats = nullptr;
+  if (m_method_profiles != nullptr) {
+    stats = &m_method_profiles->method_stats(method_profiles::COLD_START);
+  }
+  std::unordered_map<const DexMethod*, std::pair<int, double>> keys;
+  for (auto method : lmeth) {
+    if (stats != nullptr) {
+      auto it = stats->find(method);
+      if (it != stats->end() && it->second.appear_percent > 0) {
+        keys.emplace(method, std::make_pair(0, it->second.order_percent));
+        continue;
+      }
+    }
+    auto it = m_method_block_coverage.find(method);
+    keys.emplace(method,
+                 it == m_method_block_coverage.end()
+                     ? std::make_pair(2, 0.0)
+                     : std::make_pair(1, -(double)it->second));
+  }
+  std::stable_sort(lmeth.begin(), lmeth.end(),
+                   [&keys](const DexMethod* a, const DexMethod* b) {
+                     return keys.at(a) < keys.at(b);
+                   });
+}
+
 void GatheredTypes::sort_dexmethod_emitlist_clinit_order(
     std::vector<DexMethod*>& lmeth) {
   std::stable_sort(lmeth.begin(), lmeth.end(),
@@ -218,7 +302,7 @@ DexOutputIdx* GatheredTypes::get_dodx(const uint8_t* base) {
 }
 
 dexstring_to_idx* GatheredTypes::get_string_index(cmp_dstring cmp) {
-  std::sort(m_lstring.begin(), m_lstring.end(), cmp);
+  redex_parallel::stable_sort(m_lstring, cmp, m_num_threads);
   dexstring_to_idx* sidx = new dexstring_to_idx();
   uint32_t idx = 0;
   for (auto it = m_lstring.begin(); it != m_lstring.end(); it++) {
@@ -228,7 +312,7 @@ dexstring_to_idx* GatheredTypes::get_string_index(cmp_dstring cmp) {
 }
 
 dextype_to_idx* GatheredTypes::get_type_index(cmp_dtype cmp) {
-  std::sort(m_ltype.begin(), m_ltype.end(), cmp);
+  redex_parallel::stable_sort(m_ltype, cmp, m_num_threads);
   dextype_to_idx* sidx = new dextype_to_idx();
   uint32_t idx = 0;
   for (auto it = m_ltype.begin(); it != m_ltype.end(); it++) {
@@ -238,7 +322,7 @@ dextype_to_idx* GatheredTypes::get_type_index(cmp_dtype cmp) {
 }
 
 dexfield_to_idx* GatheredTypes::get_field_index(cmp_dfield cmp) {
-  std::sort(m_lfield.begin(), m_lfield.end(), cmp);
+  redex_parallel::stable_sort(m_lfield, cmp, m_num_threads);
   dexfield_to_idx* sidx = new dexfield_to_idx();
   uint32_t idx = 0;
   for (auto it = m_lfield.begin(); it != m_lfield.end(); it++) {
@@ -248,7 +332,7 @@ dexfield_to_idx* GatheredTypes::get_field_index(cmp_dfield cmp) {
 }
 
 dexmethod_to_idx* GatheredTypes::get_method_index(cmp_dmethod cmp) {
-  std::sort(m_lmethod.begin(), m_lmethod.end(), cmp);
+  redex_parallel::stable_sort(m_lmethod, cmp, m_num_threads);
   dexmethod_to_idx* sidx = new dexmethod_to_idx();
   uint32_t idx = 0;
   for (auto it = m_lmethod.begin(); it != m_lmethod.end(); it++) {
@@ -454,7 +538,10 @@ DexOutput::DexOutput(
     std::unordered_map<DexMethod*, uint64_t>* method_to_id,
     std::unordered_map<DexCode*, std::vector<DebugLineItem>>* code_debug_lines,
     PostLowering* post_lowering,
-    int min_sdk)
+    int min_sdk,
+    DexOutputSequencer* sequencer,
+    size_t sequence_index,
+    DebugLineMapWriter* debug_line_map)
     : m_classes(classes),
       // Required because the BytecodeDebugger setting creates huge amounts
       // of debug information (multiple dex debug entries per instruction)
@@ -462,16 +549,27 @@ DexOutput::DexOutput(
                          ? get_dex_output_size(config_files) * 2
                          : get_dex_output_size(config_files)) +
                     k_output_red_zone),
-      m_output(std::make_unique<uint8_t[]>(m_output_size)),
       m_offset(0),
       m_iodi_metadata(iodi_metadata),
       m_config_files(config_files),
-      m_min_sdk(min_sdk) {
-  // Ensure a clean slate.
-  memset(m_output.get(), 0, m_output_size);
+      m_min_sdk(min_sdk),
+      m_sequencer(sequencer),
+      m_sequence_index(sequence_index),
+      m_debug_line_map(debug_line_map) {
+  bool mmap_output;
+  config_files.get_json_config().get("mmap_dex_output", false, mmap_output);
+  if (mmap_output) {
+    map_output_file(path);
+  }
+  if (m_output_file == nullptr) {
+    m_output_buffer = std::make_unique<uint8_t[]>(m_output_size);
+    m_output = m_output_buffer.get();
+    // Ensure a clean slate.
+    memset(m_output, 0, m_output_size);
+  }
 
-  m_gtypes = new GatheredTypes(classes);
-  dodx = m_gtypes->get_dodx(m_output.get());
+  m_gtypes = new GatheredTypes(classes, num_threads());
+  dodx = m_gtypes->get_dodx(m_output);
 
   always_assert_log(
       dodx->method_to_idx().size() <= kMaxMethodRefs,
@@ -510,6 +608,72 @@ DexOutput::DexOutput(
 DexOutput::~DexOutput() {
   delete m_gtypes;
   delete dodx;
+  if (m_output_fd != -1) {
+    close(m_output_fd);
+  }
+}
+
+void DexOutput::map_output_file(const char* path) {
+#if IS_WINDOWS
+  fprintf(stderr,
+          "[mmap_dex_output] WARNING: Not supported on this platform, "
+          "falling back to a heap buffer.\n");
+#else
+  int fd = open(path, O_CREAT | O_TRUNC | O_RDWR | O_BINARY, 0660);
+  if (fd == -1) {
+    perror("Error creating mmapped dex");
+    return;
+  }
+  // The file is sized for the largest possible dex up front, and truncated
+  // to the actual size once written. Freshly extended file pages read as
+  // zeros, so there is no need to clear the mapping.
+  if (ftruncate(fd, m_output_size) != 0) {
+    perror("Error sizing mmapped dex");
+    close(fd);
+    return;
+  }
+  std::string error_msg;
+  m_output_file.reset(MappedFile::mmap_file(m_output_size,
+                                            PROT_READ | PROT_WRITE,
+                                            MAP_SHARED,
+                                            fd,
+                                            path,
+                                            &error_msg));
+  if (m_output_file == nullptr) {
+    close(fd);
+    return;
+  }
+  m_output_fd = fd;
+  m_output = m_output_file->begin();
+#endif
+}
+
+void DexOutputSequencer::run_in_order(Phase phase,
+                                      size_t index,
+                                      const std::function<void()>& fn) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_cv.wait(lock, [&]() { return m_next_index[phase] == index; });
+  lock.unlock();
+  fn();
+  lock.lock();
+  ++m_next_index[phase];
+  m_cv.notify_all();
+}
+
+size_t DexOutput::num_threads() const {
+  // When several dexes are written concurrently, they already share the
+  // threads.
+  return m_sequencer == nullptr ? redex_parallel::default_num_threads()
+                                : m_sequencer->num_threads_per_dex();
+}
+
+void DexOutput::run_in_order(DexOutputSequencer::Phase phase,
+                             const std::function<void()>& fn) {
+  if (m_sequencer == nullptr) {
+    fn();
+    return;
+  }
+  m_sequencer->run_in_order(phase, m_sequence_index, fn);
 }
 
 void DexOutput::insert_map_item(uint16_t maptype,
@@ -610,9 +774,9 @@ void DexOutput::insert_map_item(uint16_t maptype,
 void DexOutput::emit_locator(Locator locator) {
   char buf[Locator::encoded_max];
   size_t locator_length = locator.encode(buf);
-  write_uleb128(m_output.get() + m_offset, (uint32_t)locator_length);
+  write_uleb128(m_output + m_offset, (uint32_t)locator_length);
   inc_offset(uleb128_encoding_size((uint32_t)locator_length));
-  memcpy(m_output.get() + m_offset, buf, locator_length + 1);
+  memcpy(m_output + m_offset, buf, locator_length + 1);
   inc_offset(locator_length + 1);
 }
 
@@ -682,17 +846,22 @@ void DexOutput::generate_string_data(SortMode mode) {
     string_order = m_gtypes->get_dexstring_emitlist();
   }
   dex_string_id* stringids =
-      (dex_string_id*)(m_output.get() + hdr.string_ids_off);
+      (dex_string_id*)(m_output + hdr.string_ids_off);
 
   std::unordered_set<DexString*> type_names = m_gtypes->index_type_names();
   unsigned locator_size = 0;
 
   // If we're generating locator strings, we need to include them in
-  // the total count of strings in this section.
+  // the total count of strings in this section. They are looked up once, for
+  // both the count and the emission.
   size_t locators = 0;
-  for (DexString* str : string_order) {
-    if (locator_for_descriptor(type_names, str)) {
-      ++locators;
+  std::vector<std::unique_ptr<Locator>> string_locators(string_order.size());
+  if (m_locator_index != nullptr) {
+    for (size_t i = 0; i < string_order.size(); ++i) {
+      string_locators[i] = locator_for_descriptor(type_names, string_order[i]);
+      if (string_locators[i]) {
+        ++locators;
+      }
     }
   }
 
@@ -704,9 +873,10 @@ void DexOutput::generate_string_data(SortMode mode) {
   size_t nrstr = string_order.size() + locators;
   const uint32_t str_data_start = m_offset;
 
-  for (DexString* str : string_order) {
+  for (size_t i = 0; i < string_order.size(); ++i) {
+    DexString* str = string_order[i];
     // Emit lookup acceleration string if requested
-    std::unique_ptr<Locator> locator = locator_for_descriptor(type_names, str);
+    const auto& locator = string_locators[i];
     if (locator) {
       unsigned orig_offset = m_offset;
       emit_locator(*locator);
@@ -726,7 +896,7 @@ void DexOutput::generate_string_data(SortMode mode) {
     // Emit the string itself
     TRACE(CUSTOMSORT, 3, "str emit %s", SHOW(str));
     stringids[idx].offset = m_offset;
-    str->encode(m_output.get() + m_offset);
+    str->encode(m_output + m_offset);
     inc_offset(str->get_entry_size());
     m_stats.num_strings++;
   }
@@ -811,7 +981,7 @@ void DexOutput::generate_type_data() {
       get_max_type_refs(m_min_sdk),
       dodx->type_to_idx().size() - get_max_type_refs(m_min_sdk));
 
-  dex_type_id* typeids = (dex_type_id*)(m_output.get() + hdr.type_ids_off);
+  dex_type_id* typeids = (dex_type_id*)(m_output + hdr.type_ids_off);
   for (auto& p : dodx->type_to_idx()) {
     auto t = p.first;
     auto idx = p.second;
@@ -832,7 +1002,7 @@ void DexOutput::generate_typelist_data() {
     ++num_tls;
     align_output();
     m_tl_emit_offsets[tl] = m_offset;
-    int size = tl->encode(dodx, (uint32_t*)(m_output.get() + m_offset));
+    int size = tl->encode(dodx, (uint32_t*)(m_output + m_offset));
     inc_offset(size);
     m_stats.num_type_lists++;
   }
@@ -842,7 +1012,7 @@ void DexOutput::generate_typelist_data() {
 }
 
 void DexOutput::generate_proto_data() {
-  auto protoids = (dex_proto_id*)(m_output.get() + hdr.proto_ids_off);
+  auto protoids = (dex_proto_id*)(m_output + hdr.proto_ids_off);
   for (auto& it : dodx->proto_to_idx()) {
     auto proto = it.first;
     auto idx = it.second;
@@ -854,7 +1024,7 @@ void DexOutput::generate_proto_data() {
 }
 
 void DexOutput::generate_field_data() {
-  auto fieldids = (dex_field_id*)(m_output.get() + hdr.field_ids_off);
+  auto fieldids = (dex_field_id*)(m_output + hdr.field_ids_off);
   for (auto& it : dodx->field_to_idx()) {
     auto field = it.first;
     auto idx = it.second;
@@ -866,7 +1036,7 @@ void DexOutput::generate_field_data() {
 }
 
 void DexOutput::generate_method_data() {
-  auto methodids = (dex_method_id*)(m_output.get() + hdr.method_ids_off);
+  auto methodids = (dex_method_id*)(m_output + hdr.method_ids_off);
   for (auto& it : dodx->method_to_idx()) {
     auto method = it.first;
     auto idx = it.second;
@@ -878,7 +1048,7 @@ void DexOutput::generate_method_data() {
 }
 
 void DexOutput::generate_class_data() {
-  dex_class_def* cdefs = (dex_class_def*)(m_output.get() + hdr.class_defs_off);
+  dex_class_def* cdefs = (dex_class_def*)(m_output + hdr.class_defs_off);
   for (uint32_t i = 0; i < hdr.class_defs_size; i++) {
     m_stats.num_classes++;
     DexClass* clz = m_classes->at(i);
@@ -913,16 +1083,16 @@ void DexOutput::generate_class_data_items() {
   dexcode_to_offset dco;
   uint32_t cdi_start = m_offset;
   for (auto& it : m_code_item_emits) {
-    uint32_t offset = (uint32_t)(((uint8_t*)it.code_item) - m_output.get());
+    uint32_t offset = (uint32_t)(((uint8_t*)it.code_item) - m_output);
     dco[it.code] = offset;
   }
-  dex_class_def* cdefs = (dex_class_def*)(m_output.get() + hdr.class_defs_off);
+  dex_class_def* cdefs = (dex_class_def*)(m_output + hdr.class_defs_off);
   uint32_t count = 0;
   for (uint32_t i = 0; i < hdr.class_defs_size; i++) {
     DexClass* clz = m_classes->at(i);
     if (!clz->has_class_data()) continue;
     /* No alignment constraints for this data */
-    int size = clz->encode(dodx, dco, m_output.get() + m_offset);
+    int size = clz->encode(dodx, dco, m_output + m_offset);
     cdefs[i].class_data_offset = m_offset;
     inc_offset(size);
     count += 1;
@@ -946,6 +1116,33 @@ static void sync_all(const Scope& scope) {
   }
 }
 
+namespace {
+
+// An upper bound on the number of bytes that DexCode::encode writes, rounded
+// up so that consecutive items stay 4-byte aligned.
+size_t code_item_size_bound(const DexCode* code) {
+  size_t insns_units = 0;
+  for (auto const& opc : code->get_instructions()) {
+    insns_units += opc->size();
+  }
+  // Header, instructions, and the padding before the tries.
+  size_t bound = sizeof(dex_code_item) + (insns_units + 1) * sizeof(uint16_t);
+  const auto& tries = code->get_tries();
+  if (!tries.empty()) {
+    // The try items, and the handler list: a leb128 count of handlers, then
+    // at most one handler per try, each a leb128 count followed by a
+    // (type index, address) pair of leb128s per catch.
+    constexpr size_t kMaxLeb128Size = 5;
+    bound += tries.size() * sizeof(dex_tries_item) + kMaxLeb128Size;
+    for (const auto& dextry : tries) {
+      bound += kMaxLeb128Size * (1 + 2 * dextry->m_catches.size());
+    }
+  }
+  return (bound + 3) & ~3;
+}
+
+} // namespace
+
 void DexOutput::generate_code_items(const std::vector<SortMode>& mode) {
   TRACE(MAIN, 2, "generate_code_items");
   /*
@@ -953,6 +1150,11 @@ void DexOutput::generate_code_items(const std::vector<SortMode>& mode) {
    * emitlist to optimize pagecache efficiency.
    */
   uint32_t ci_start = align(m_offset);
+  bool page_order = std::find(mode.begin(), mode.end(),
+                              SortMode::METHOD_PAGE_ORDER) != mode.end();
+  if (page_order) {
+    m_gtypes->gather_method_block_coverage();
+  }
   sync_all(*m_classes);
 
   // Get all methods.
@@ -984,36 +1186,102 @@ void DexOutput::generate_code_items(const std::vector<SortMode>& mode) {
       TRACE(CUSTOMSORT, 2, "using method refs order");
       m_gtypes->sort_dexmethod_emitlist_method_ref_order(lmeth);
       break;
+    case SortMode::METHOD_PAGE_ORDER:
+      TRACE(CUSTOMSORT, 2, "using cold start page order");
+      m_gtypes->sort_dexmethod_emitlist_page_order(lmeth);
+      break;
     case SortMode::DEFAULT:
       TRACE(CUSTOMSORT, 2, "using default sorting order");
       m_gtypes->sort_dexmethod_emitlist_default_order(lmeth);
       break;
     }
   }
+  std::vector<DexMethod*> code_methods;
+  code_methods.reserve(lmeth.size());
   for (DexMethod* meth : lmeth) {
     if (meth->get_access() & (ACC_ABSTRACT | ACC_NATIVE)) {
       // There is no code item for ABSTRACT or NATIVE methods.
       continue;
     }
-    TRACE(CUSTOMSORT, 3, "method emit %s %s", SHOW(meth->get_class()),
-          SHOW(meth));
-    DexCode* code = meth->get_dex_code();
     always_assert_log(
-        meth->is_concrete() && code != nullptr,
+        meth->is_concrete() && meth->get_dex_code() != nullptr,
         "Undefined method in generate_code_items()\n\t prototype: %s\n",
         SHOW(meth));
+    code_methods.push_back(meth);
+  }
+
+  // Code items are position independent. So we first encode them into
+  // separate slices of a scratch buffer in parallel, and then lay them out
+  // serially in emit order.
+  std::vector<size_t> scratch_offsets(code_methods.size() + 1, 0);
+  for (size_t i = 0; i < code_methods.size(); ++i) {
+    scratch_offsets[i + 1] =
+        scratch_offsets[i] +
+        code_item_size_bound(code_methods[i]->get_dex_code());
+  }
+  // Encoding relies on zeroed memory for alignment padding.
+  auto scratch = std::make_unique<uint8_t[]>(scratch_offsets.back());
+  memset(scratch.get(), 0, scratch_offsets.back());
+  std::vector<int> sizes(code_methods.size());
+  auto encode = [&](size_t i) {
+    auto* code = code_methods[i]->get_dex_code();
+    sizes[i] = code->encode(
+        dodx, (uint32_t*)(scratch.get() + scratch_offsets[i]));
+    always_assert(scratch_offsets[i] + sizes[i] <= scratch_offsets[i + 1]);
+    // Nothing reads the instructions once they are encoded, so keep only
+    // their code units, which is what the rest of the output needs.
+    code->pack();
+  };
+  size_t num_threads = this->num_threads();
+  if (num_threads > 1 && code_methods.size() > 1) {
+    std::vector<size_t> indices(code_methods.size());
+    std::iota(indices.begin(), indices.end(), 0);
+    workqueue_run<size_t>(encode, indices, num_threads);
+  } else {
+    for (size_t i = 0; i < code_methods.size(); ++i) {
+      encode(i);
+    }
+  }
+
+  // Simulate the pages that cold start touches, assuming that the dex is
+  // mapped at a page boundary.
+  constexpr uint32_t kPageSize = 4096;
+  std::unordered_set<uint32_t> startup_pages;
+  uint32_t startup_bytes = 0;
+  for (size_t i = 0; i < code_methods.size(); ++i) {
+    DexMethod* meth = code_methods[i];
+    TRACE(CUSTOMSORT, 3, "method emit %s %s", SHOW(meth->get_class()),
+          SHOW(meth));
+    DexCode* code = meth->get_dex_code();
     align_output();
-    int size = code->encode(dodx, (uint32_t*)(m_output.get() + m_offset));
+    int size = sizes[i];
     check_method_instruction_size_limit(m_config_files, size, SHOW(meth));
+    // Check that the item fits before copying it in.
+    always_assert(m_offset + size < m_output_size);
+    memcpy(m_output + m_offset, scratch.get() + scratch_offsets[i], size);
     m_method_bytecode_offsets.emplace_back(meth->get_name()->c_str(), m_offset);
     m_code_item_emits.emplace_back(meth, code,
-                                   (dex_code_item*)(m_output.get() + m_offset));
+                                   (dex_code_item*)(m_output + m_offset));
     auto insns_size =
-        ((const dex_code_item*)(m_output.get() + m_offset))->insns_size;
+        ((const dex_code_item*)(m_output + m_offset))->insns_size;
+    if (page_order && m_gtypes->is_startup_method(meth)) {
+      for (uint32_t page = m_offset / kPageSize;
+           page <= (m_offset + size - 1) / kPageSize; ++page) {
+        startup_pages.insert(page);
+      }
+      startup_bytes += size;
+    }
     inc_offset(size);
-    m_stats.num_instructions += code->get_instructions().size();
+    m_stats.num_instructions += code->num_instructions();
     m_stats.instruction_bytes += insns_size * 2;
   }
+  if (page_order) {
+    m_stats.startup_code_pages = startup_pages.size();
+    TRACE(CUSTOMSORT, 1,
+          "cold start touches %zu code item pages, at best %u, for %u bytes",
+          startup_pages.size(), (startup_bytes + kPageSize - 1) / kPageSize,
+          startup_bytes);
+  }
   /// insert_map_item returns early if m_code_item_emits is empty
   insert_map_item(TYPE_CODE_ITEM, (uint32_t)m_code_item_emits.size(), ci_start,
                   m_offset - ci_start);
@@ -1024,7 +1292,7 @@ void DexOutput::generate_callsite_data() {
       hdr.class_defs_off + hdr.class_defs_size * sizeof(dex_class_def);
 
   auto callsites = m_gtypes->get_dexcallsite_emitlist();
-  dex_callsite_id* dexcallsites = (dex_callsite_id*)(m_output.get() + offset);
+  dex_callsite_id* dexcallsites = (dex_callsite_id*)(m_output + offset);
   for (uint32_t i = 0; i < callsites.size(); i++) {
     m_stats.num_callsites++;
     DexCallSite* callsite = callsites.at(i);
@@ -1038,7 +1306,7 @@ void DexOutput::generate_methodhandle_data() {
                     hdr.class_defs_size * sizeof(dex_class_def) +
                     total_callsite_size;
   dex_methodhandle_id* dexmethodhandles =
-      (dex_methodhandle_id*)(m_output.get() + offset);
+      (dex_methodhandle_id*)(m_output + offset);
   for (auto it : dodx->methodhandle_to_idx()) {
     m_stats.num_methodhandles++;
     DexMethodHandle* methodhandle = it.first;
@@ -1091,7 +1359,7 @@ void DexOutput::generate_static_values() {
     if (enc_arrays.count(*deva)) {
       m_static_values[clz] = enc_arrays.at(*deva);
     } else {
-      uint8_t* output = m_output.get() + m_offset;
+      uint8_t* output = m_output + m_offset;
       uint8_t* outputsv = output;
       /* No alignment requirements */
       deva->encode(dodx, output);
@@ -1110,7 +1378,7 @@ void DexOutput::generate_static_values() {
       if (enc_arrays.count(eva)) {
         offset = m_call_site_items[callsite] = enc_arrays.at(eva);
       } else {
-        uint8_t* output = m_output.get() + m_offset;
+        uint8_t* output = m_output + m_offset;
         uint8_t* outputsv = output;
         eva.encode(dodx, output);
         enc_arrays.emplace(std::move(eva), m_offset);
@@ -1131,24 +1399,94 @@ static bool annotation_cmp(const DexAnnotationDirectory* a,
   return (a->viz_score() < b->viz_score());
 }
 
+namespace {
+
+// The encoding of an annotation item and its hash, which are computed in
+// parallel, before the offsets are assigned in order.
+template <typename Unit>
+struct EncodedItem {
+  std::vector<Unit> units;
+  size_t hash{0};
+};
+
+template <typename Unit>
+struct EncodedItemHash {
+  size_t operator()(const EncodedItem<Unit>* item) const { return item->hash; }
+};
+
+template <typename Unit>
+struct EncodedItemEqual {
+  bool operator()(const EncodedItem<Unit>* a,
+                  const EncodedItem<Unit>* b) const {
+    return a->units == b->units;
+  }
+};
+
+template <typename Unit>
+using encoded_offsets_t = std::unordered_map<const EncodedItem<Unit>*,
+                                             uint32_t,
+                                             EncodedItemHash<Unit>,
+                                             EncodedItemEqual<Unit>>;
+
+/*
+ * Removes the repeated items of the list, keeping their first occurrences in
+ * order, and encodes the remaining ones in parallel. The encoder must only
+ * read shared state.
+ */
+template <typename Unit, typename Item, typename Encode>
+std::vector<EncodedItem<Unit>> encode_distinct(std::vector<Item*>& items,
+                                               const Encode& encode,
+                                               size_t num_threads) {
+  std::unordered_set<Item*> seen;
+  items.erase(std::remove_if(items.begin(), items.end(),
+                             [&](Item* item) {
+                               return !seen.insert(item).second;
+                             }),
+              items.end());
+  std::vector<EncodedItem<Unit>> encoded(items.size());
+  auto encode_item = [&](size_t i) {
+    auto& item = encoded[i];
+    encode(items[i], item.units);
+    item.hash = boost::hash_range(item.units.begin(), item.units.end());
+  };
+  if (num_threads > 1 && items.size() > 1) {
+    std::vector<size_t> indices(items.size());
+    std::iota(indices.begin(), indices.end(), 0);
+    workqueue_run<size_t>(encode_item, indices, num_threads);
+  } else {
+    for (size_t i = 0; i < items.size(); ++i) {
+      encode_item(i);
+    }
+  }
+  return encoded;
+}
+
+} // namespace
+
 void DexOutput::unique_annotations(annomap_t& annomap,
                                    std::vector<DexAnnotation*>& annolist) {
   int annocnt = 0;
   uint32_t mentry_offset = m_offset;
-  std::map<std::vector<uint8_t>, uint32_t> annotation_byte_offsets;
-  for (auto anno : annolist) {
-    if (annomap.count(anno)) continue;
-    std::vector<uint8_t> annotation_bytes;
-    anno->vencode(dodx, annotation_bytes);
-    if (annotation_byte_offsets.count(annotation_bytes)) {
-      annomap[anno] = annotation_byte_offsets[annotation_bytes];
+  auto encoded = encode_distinct<uint8_t>(
+      annolist,
+      [&](DexAnnotation* anno, std::vector<uint8_t>& annotation_bytes) {
+        anno->vencode(dodx, annotation_bytes);
+      },
+      num_threads());
+  encoded_offsets_t<uint8_t> annotation_byte_offsets;
+  for (size_t i = 0; i < annolist.size(); ++i) {
+    auto anno = annolist[i];
+    auto it = annotation_byte_offsets.find(&encoded[i]);
+    if (it != annotation_byte_offsets.end()) {
+      annomap[anno] = it->second;
       continue;
     }
+    const auto& annotation_bytes = encoded[i].units;
     /* Insert new annotation in tracking structs */
-    annotation_byte_offsets[annotation_bytes] = m_offset;
+    annotation_byte_offsets.emplace(&encoded[i], m_offset);
     annomap[anno] = m_offset;
     /* Not a dupe, encode... */
-    uint8_t* annoout = (uint8_t*)(m_output.get() + m_offset);
+    uint8_t* annoout = (uint8_t*)(m_output + m_offset);
     memcpy(annoout, &annotation_bytes[0], annotation_bytes.size());
     inc_offset(annotation_bytes.size());
     annocnt++;
@@ -1165,21 +1503,27 @@ void DexOutput::unique_asets(annomap_t& annomap,
                              std::vector<DexAnnotationSet*>& asetlist) {
   int asetcnt = 0;
   uint32_t mentry_offset = align(m_offset);
-  std::map<std::vector<uint32_t>, uint32_t> aset_offsets;
-  for (auto aset : asetlist) {
-    if (asetmap.count(aset)) continue;
-    std::vector<uint32_t> aset_bytes;
-    aset->vencode(dodx, aset_bytes, annomap);
-    if (aset_offsets.count(aset_bytes)) {
-      asetmap[aset] = aset_offsets[aset_bytes];
+  auto encoded = encode_distinct<uint32_t>(
+      asetlist,
+      [&](DexAnnotationSet* aset, std::vector<uint32_t>& aset_bytes) {
+        aset->vencode(dodx, aset_bytes, annomap);
+      },
+      num_threads());
+  encoded_offsets_t<uint32_t> aset_offsets;
+  for (size_t i = 0; i < asetlist.size(); ++i) {
+    auto aset = asetlist[i];
+    auto it = aset_offsets.find(&encoded[i]);
+    if (it != aset_offsets.end()) {
+      asetmap[aset] = it->second;
       continue;
     }
+    const auto& aset_bytes = encoded[i].units;
     /* Insert new aset in tracking structs */
     align_output();
-    aset_offsets[aset_bytes] = m_offset;
+    aset_offsets.emplace(&encoded[i], m_offset);
     asetmap[aset] = m_offset;
     /* Not a dupe, encode... */
-    uint8_t* asetout = (uint8_t*)(m_output.get() + m_offset);
+    uint8_t* asetout = (uint8_t*)(m_output + m_offset);
     memcpy(asetout, &aset_bytes[0], aset_bytes.size() * sizeof(uint32_t));
     inc_offset(aset_bytes.size() * sizeof(uint32_t));
     asetcnt++;
@@ -1195,27 +1539,33 @@ void DexOutput::unique_xrefs(asetmap_t& asetmap,
                              std::vector<ParamAnnotations*>& xreflist) {
   int xrefcnt = 0;
   uint32_t mentry_offset = align(m_offset);
-  std::map<std::vector<uint32_t>, uint32_t> xref_offsets;
-  for (auto xref : xreflist) {
-    if (xrefmap.count(xref)) continue;
-    std::vector<uint32_t> xref_bytes;
-    xref_bytes.push_back((unsigned int)xref->size());
-    for (auto param : *xref) {
-      DexAnnotationSet* das = param.second;
-      always_assert_log(asetmap.count(das) != 0, "Uninitialized aset %p '%s'",
-                        das, SHOW(das));
-      xref_bytes.push_back(asetmap[das]);
-    }
-    if (xref_offsets.count(xref_bytes)) {
-      xrefmap[xref] = xref_offsets[xref_bytes];
+  auto encoded = encode_distinct<uint32_t>(
+      xreflist,
+      [&](ParamAnnotations* xref, std::vector<uint32_t>& xref_bytes) {
+        xref_bytes.push_back((unsigned int)xref->size());
+        for (auto param : *xref) {
+          DexAnnotationSet* das = param.second;
+          always_assert_log(asetmap.count(das) != 0,
+                            "Uninitialized aset %p '%s'", das, SHOW(das));
+          xref_bytes.push_back(asetmap.at(das));
+        }
+      },
+      num_threads());
+  encoded_offsets_t<uint32_t> xref_offsets;
+  for (size_t i = 0; i < xreflist.size(); ++i) {
+    auto xref = xreflist[i];
+    auto it = xref_offsets.find(&encoded[i]);
+    if (it != xref_offsets.end()) {
+      xrefmap[xref] = it->second;
       continue;
     }
+    const auto& xref_bytes = encoded[i].units;
     /* Insert new xref in tracking structs */
     align_output();
-    xref_offsets[xref_bytes] = m_offset;
+    xref_offsets.emplace(&encoded[i], m_offset);
     xrefmap[xref] = m_offset;
     /* Not a dupe, encode... */
-    uint8_t* xrefout = (uint8_t*)(m_output.get() + m_offset);
+    uint8_t* xrefout = (uint8_t*)(m_output + m_offset);
     memcpy(xrefout, &xref_bytes[0], xref_bytes.size() * sizeof(uint32_t));
     inc_offset(xref_bytes.size() * sizeof(uint32_t));
     xrefcnt++;
@@ -1232,21 +1582,27 @@ void DexOutput::unique_adirs(asetmap_t& asetmap,
                              std::vector<DexAnnotationDirectory*>& adirlist) {
   int adircnt = 0;
   uint32_t mentry_offset = align(m_offset);
-  std::map<std::vector<uint32_t>, uint32_t> adir_offsets;
-  for (auto adir : adirlist) {
-    if (adirmap.count(adir)) continue;
-    std::vector<uint32_t> adir_bytes;
-    adir->vencode(dodx, adir_bytes, xrefmap, asetmap);
-    if (adir_offsets.count(adir_bytes)) {
-      adirmap[adir] = adir_offsets[adir_bytes];
+  auto encoded = encode_distinct<uint32_t>(
+      adirlist,
+      [&](DexAnnotationDirectory* adir, std::vector<uint32_t>& adir_bytes) {
+        adir->vencode(dodx, adir_bytes, xrefmap, asetmap);
+      },
+      num_threads());
+  encoded_offsets_t<uint32_t> adir_offsets;
+  for (size_t i = 0; i < adirlist.size(); ++i) {
+    auto adir = adirlist[i];
+    auto it = adir_offsets.find(&encoded[i]);
+    if (it != adir_offsets.end()) {
+      adirmap[adir] = it->second;
       continue;
     }
+    const auto& adir_bytes = encoded[i].units;
     /* Insert new adir in tracking structs */
     align_output();
-    adir_offsets[adir_bytes] = m_offset;
+    adir_offsets.emplace(&encoded[i], m_offset);
     adirmap[adir] = m_offset;
     /* Not a dupe, encode... */
-    uint8_t* adirout = (uint8_t*)(m_output.get() + m_offset);
+    uint8_t* adirout = (uint8_t*)(m_output + m_offset);
     memcpy(adirout, &adir_bytes[0], adir_bytes.size() * sizeof(uint32_t));
     inc_offset(adir_bytes.size() * sizeof(uint32_t));
     adircnt++;
@@ -1303,7 +1659,7 @@ void DexOutput::generate_annotations() {
   for (auto ad : lad) {
     int class_num = ad_to_classnum[ad];
     dex_class_def* cdefs =
-        (dex_class_def*)(m_output.get() + hdr.class_defs_off);
+        (dex_class_def*)(m_output + hdr.class_defs_off);
     cdefs[class_num].annotations_off = adirmap[ad];
     delete ad;
   }
@@ -2145,16 +2501,11 @@ uint32_t emit_instruction_offset_debug_info(
   // be encoded.
   const size_t large_bound = iodi_layers ? DexOutput::kIODILayerBound : 1;
 
-  std::unordered_set<const DexMethod*> too_large_cluster_methods;
-  {
-    for (const auto& p : iodi_metadata.get_name_clusters()) {
-      if (p.second.size() > large_bound) {
-        too_large_cluster_methods.insert(p.second.begin(), p.second.end());
-      }
-    }
-  }
-  TRACE(IODI, 1, "%zu methods in too-large clusters.",
-        too_large_cluster_methods.size());
+  // Only look up the clusters of the methods of this dex, rather than going
+  // over all clusters for each dex.
+  auto in_too_large_cluster = [&](const DexMethod* method) {
+    return iodi_metadata.get_cluster_size(method) > large_bound;
+  };
 
   std::vector<CodeItemEmit*> code_items_tmp;
   code_items_tmp.reserve(code_items.size());
@@ -2181,20 +2532,19 @@ uint32_t emit_instruction_offset_debug_info(
         code_items.size() - code_items_tmp.size());
   // Remove all unsupported items.
   std::vector<CodeItemEmit*> unsupported_code_items;
-  if (!too_large_cluster_methods.empty()) {
-    code_items_tmp.erase(
-        std::remove_if(code_items_tmp.begin(), code_items_tmp.end(),
-                       [&](CodeItemEmit* cie) {
-                         bool supported =
-                             too_large_cluster_methods.count(cie->method) == 0;
-                         if (!supported) {
-                           iodi_metadata.mark_method_huge(cie->method);
-                           unsupported_code_items.push_back(cie);
-                         }
-                         return !supported;
-                       }),
-        code_items_tmp.end());
-  }
+  code_items_tmp.erase(
+      std::remove_if(code_items_tmp.begin(), code_items_tmp.end(),
+                     [&](CodeItemEmit* cie) {
+                       bool supported = !in_too_large_cluster(cie->method);
+                       if (!supported) {
+                         iodi_metadata.mark_method_huge(cie->method);
+                         unsupported_code_items.push_back(cie);
+                       }
+                       return !supported;
+                     }),
+      code_items_tmp.end());
+  TRACE(IODI, 1, "%zu methods in too-large clusters.",
+        unsupported_code_items.size());
 
   const uint32_t initial_offset = offset;
   if (!code_items_tmp.empty()) {
@@ -2249,7 +2599,7 @@ void DexOutput::generate_debug_items() {
         m_code_item_emits,
         *m_iodi_metadata,
         m_debug_info_kind == DebugInfoKind::InstructionOffsetsLayered,
-        m_output.get(),
+        m_output,
         m_offset,
         &dbgcount,
         m_code_debug_lines));
@@ -2267,7 +2617,7 @@ void DexOutput::generate_debug_items() {
       dbgcount++;
       size_t num_params = it.method->get_proto()->get_args()->size();
       inc_offset(emit_debug_info(dodx, emit_positions, dbg, dc, dci,
-                                 m_pos_mapper, m_output.get(), m_offset,
+                                 m_pos_mapper, m_output, m_offset,
                                  num_params, m_code_debug_lines));
     }
   }
@@ -2281,7 +2631,7 @@ void DexOutput::generate_debug_items() {
 
 void DexOutput::generate_map() {
   align_output();
-  uint32_t* mapout = (uint32_t*)(m_output.get() + m_offset);
+  uint32_t* mapout = (uint32_t*)(m_output + m_offset);
   hdr.map_off = m_offset;
   insert_map_item(TYPE_MAP_LIST, 1, m_offset,
                   sizeof(uint32_t) + m_map_items.size() * sizeof(dex_map_item));
@@ -2406,18 +2756,18 @@ void DexOutput::finalize_header() {
   hdr.file_size = m_offset;
   int skip;
   skip = sizeof(hdr.magic) + sizeof(hdr.checksum) + sizeof(hdr.signature);
-  memcpy(m_output.get(), &hdr, sizeof(hdr));
+  memcpy(m_output, &hdr, sizeof(hdr));
   Sha1Context context;
   sha1_init(&context);
-  sha1_update(&context, m_output.get() + skip, hdr.file_size - skip);
+  sha1_update(&context, m_output + skip, hdr.file_size - skip);
   sha1_final(hdr.signature, &context);
-  memcpy(m_output.get(), &hdr, sizeof(hdr));
+  memcpy(m_output, &hdr, sizeof(hdr));
   uint32_t adler = (uint32_t)adler32(0L, Z_NULL, 0);
   skip = sizeof(hdr.magic) + sizeof(hdr.checksum);
-  adler = (uint32_t)adler32(adler, (const Bytef*)(m_output.get() + skip),
+  adler = (uint32_t)adler32(adler, (const Bytef*)(m_output + skip),
                             hdr.file_size - skip);
   hdr.checksum = adler;
-  memcpy(m_output.get(), &hdr, sizeof(hdr));
+  memcpy(m_output, &hdr, sizeof(hdr));
 }
 
 namespace {
@@ -2811,11 +3161,20 @@ void GatheredTypes::set_legacy_order(bool legacy_order) {
   m_legacy_order = legacy_order;
 }
 
+void GatheredTypes::set_method_similarity_minhash_min_methods(
+    size_t min_methods) {
+  m_method_similarity_minhash_min_methods = min_methods;
+}
+
 void DexOutput::prepare(SortMode string_mode,
                         const std::vector<SortMode>& code_mode,
                         ConfigFiles& conf,
                         const std::string& dex_magic) {
 
+  if (std::find(code_mode.begin(), code_mode.end(),
+                SortMode::METHOD_PAGE_ORDER) != code_mode.end()) {
+    m_gtypes->set_method_profiles(&conf.get_method_profiles());
+  }
   if (std::find(code_mode.begin(), code_mode.end(),
                 SortMode::METHOD_PROFILED_ORDER) != code_mode.end()) {
     m_gtypes->set_method_profiles(&conf.get_method_profiles());
@@ -2824,6 +3183,13 @@ void DexOutput::prepare(SortMode string_mode,
     m_gtypes->set_method_sorting_allowlisted_substrings(
         &conf.get_method_sorting_allowlisted_substrings());
   }
+  if (std::find(code_mode.begin(), code_mode.end(),
+                SortMode::METHOD_SIMILARITY) != code_mode.end()) {
+    size_t minhash_min_methods;
+    conf.get_json_config().get("method_similarity_minhash_min_methods", 0,
+                               minhash_min_methods);
+    m_gtypes->set_method_similarity_minhash_min_methods(minhash_min_methods);
+  }
 
   fix_jumbos(m_classes, dodx);
   init_header_offsets(dex_magic);
@@ -2840,26 +3206,89 @@ void DexOutput::prepare(SortMode string_mode,
   generate_callsite_data();
   generate_methodhandle_data();
   generate_annotations();
-  generate_debug_items();
+  run_in_order(DexOutputSequencer::DEBUG_ITEMS,
+               [this]() { generate_debug_items(); });
   generate_map();
   finalize_header();
-  compute_method_to_id_map(dodx, m_classes, hdr.signature, m_method_to_id);
+  // The method ids and the debug lines of this dex are looked up while it
+  // holds its turn, as the maps are shared with the other dexes. The lines
+  // themselves don't move, since the maps are node-based.
+  std::vector<DebugLineMapWriter::Entry> debug_line_entries;
+  run_in_order(DexOutputSequencer::METHOD_IDS, [&]() {
+    compute_method_to_id_map(dodx, m_classes, hdr.signature, m_method_to_id);
+    if (m_debug_line_map && m_method_to_id && m_code_debug_lines) {
+      debug_line_entries.reserve(m_code_item_emits.size());
+      for (const auto& cie : m_code_item_emits) {
+        auto id_it = m_method_to_id->find(cie.method);
+        auto lines_it = m_code_debug_lines->find(cie.code);
+        if (id_it != m_method_to_id->end() &&
+            lines_it != m_code_debug_lines->end()) {
+          debug_line_entries.emplace_back(id_it->second, &lines_it->second);
+        }
+      }
+    }
+    if (is_iodi(m_debug_info_kind) && m_iodi_metadata && m_method_to_id) {
+      // The ids of this dex are known now, so its IODI entries can be
+      // serialized while the other dexes are still being written.
+      std::vector<const DexMethod*> methods;
+      methods.reserve(m_code_item_emits.size());
+      for (const auto& cie : m_code_item_emits) {
+        methods.push_back(cie.method);
+      }
+      m_iodi_metadata->emit_entries(methods, *m_method_to_id);
+    }
+  });
+  DebugLineMapWriter::Chunk debug_line_chunk;
+  if (m_debug_line_map) {
+    debug_line_chunk = DebugLineMapWriter::encode(debug_line_entries);
+  }
+  run_in_order(DexOutputSequencer::DEBUG_LINE_MAP, [&]() {
+    if (m_debug_line_map) {
+      m_debug_line_map->append(debug_line_chunk);
+    }
+  });
 }
 
 void DexOutput::write() {
+  if (m_output_file != nullptr) {
+    write_mapped();
+    return;
+  }
   struct stat st;
   int fd = open(m_filename, O_CREAT | O_TRUNC | O_WRONLY | O_BINARY, 0660);
   if (fd == -1) {
     perror("Error writing dex");
+    // Still take our turn, so that concurrently written dexes don't wait for
+    // us forever.
+    run_in_order(DexOutputSequencer::SYMBOL_FILES, []() {});
     return;
   }
-  ::write(fd, m_output.get(), m_offset);
+  ::write(fd, m_output, m_offset);
   if (0 == fstat(fd, &st)) {
     m_stats.num_bytes = st.st_size;
   }
   close(fd);
 
-  write_symbol_files();
+  run_in_order(DexOutputSequencer::SYMBOL_FILES,
+               [this]() { write_symbol_files(); });
+}
+
+void DexOutput::write_mapped() {
+  // The data is already in the file; unmap it and drop the unused tail.
+  m_output_file.reset();
+  m_output = nullptr;
+  if (ftruncate(m_output_fd, m_offset) != 0) {
+    perror("Error truncating mmapped dex");
+  }
+  struct stat st;
+  if (0 == fstat(m_output_fd, &st)) {
+    m_stats.num_bytes = st.st_size;
+  }
+  close(m_output_fd);
+  m_output_fd = -1;
+
+  run_in_order(DexOutputSequencer::SYMBOL_FILES,
+               [this]() { write_symbol_files(); });
 }
 
 class UniqueReferences {
@@ -2879,6 +3308,10 @@ class UniqueReferences {
 UniqueReferences s_unique_references;
 
 void DexOutput::metrics() {
+  run_in_order(DexOutputSequencer::METRICS, [this]() { compute_metrics(); });
+}
+
+void DexOutput::compute_metrics() {
   if (s_unique_references.dexes++ == 1 && !m_normal_primary_dex) {
     // clear out info from first (primary) dex
     s_unique_references.strings.clear();
@@ -2939,6 +3372,8 @@ static SortMode make_sort_bytecode(const std::string& sort_bytecode) {
     return SortMode::METHOD_PROFILED_ORDER;
   } else if (sort_bytecode == "method_similarity_order") {
     return SortMode::METHOD_SIMILARITY;
+  } else if (sort_bytecode == "method_page_order") {
+    return SortMode::METHOD_PAGE_ORDER;
   } else {
     return SortMode::DEFAULT;
   }
@@ -2959,7 +3394,10 @@ dex_stats_t write_classes_to_dex(
     const std::string& dex_magic,
     PostLowering* post_lowering,
     int min_sdk,
-    bool disable_method_similarity_order) {
+    bool disable_method_similarity_order,
+    DexOutputSequencer* sequencer,
+    size_t sequence_index,
+    DebugLineMapWriter* debug_line_map) {
   const JsonWrapper& json_cfg = conf.get_json_config();
   bool force_single_dex = json_cfg.get("force_single_dex", false);
   if (force_single_dex) {
@@ -3003,7 +3441,8 @@ dex_stats_t write_classes_to_dex(
   DexOutput dout(filename.c_str(), classes, locator_index, normal_primary_dex,
                  store_number, dex_number, redex_options.debug_info_kind,
                  iodi_metadata, conf, pos_mapper, method_to_id,
-                 code_debug_lines, post_lowering, min_sdk);
+                 code_debug_lines, post_lowering, min_sdk, sequencer,
+                 sequence_index, debug_line_map);
 
   dout.prepare(string_sort_mode, code_sort_mode, conf, dex_magic);
   dout.write();
@@ -3012,43 +3451,73 @@ dex_stats_t write_classes_to_dex(
 }
 
 LocatorIndex make_locator_index(DexStoresVector& stores) {
-  LocatorIndex index;
-
+  // The dexes are scanned in parallel, and merged in order.
+  std::vector<std::pair<uint32_t, uint32_t>> dexes;
   for (uint32_t strnr = 0; strnr < stores.size(); strnr++) {
-    DexClassesVector& dexen = stores[strnr].get_dexen();
-    uint32_t dexnr = 1; // Zero is reserved for Android classes
-    for (auto dexit = dexen.begin(); dexit != dexen.end(); ++dexit, ++dexnr) {
-      const DexClasses& classes = *dexit;
-      uint32_t clsnr = 0;
-      for (auto clsit = classes.begin(); clsit != classes.end();
-           ++clsit, ++clsnr) {
-        DexString* clsname = (*clsit)->get_type()->get_name();
-        const auto cstr = clsname->c_str();
-        uint32_t global_clsnr = Locator::decodeGlobalClassIndex(cstr);
-        if (global_clsnr != Locator::invalid_global_class_index) {
-          TRACE(LOC, 3,
-                "%s (%u, %u, %u) needs no locator; global class index=%u", cstr,
-                strnr, dexnr, clsnr, global_clsnr);
-          // This prefix is followed by the global class index; this case
-          // doesn't need a locator.
-          continue;
+    // Zero is reserved for Android classes
+    for (uint32_t dexnr = 1; dexnr <= stores[strnr].get_dexen().size();
+         dexnr++) {
+      dexes.emplace_back(strnr, dexnr);
+    }
+  }
+  std::vector<std::vector<std::pair<DexString*, Locator>>> dex_locators(
+      dexes.size());
+  std::vector<size_t> indices(dexes.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  workqueue_run<size_t>(
+      [&](size_t i) {
+        auto strnr = dexes[i].first;
+        auto dexnr = dexes[i].second;
+        const DexClasses& classes = stores[strnr].get_dexen()[dexnr - 1];
+        auto& locators = dex_locators[i];
+        locators.reserve(classes.size());
+        for (uint32_t clsnr = 0; clsnr < classes.size(); clsnr++) {
+          DexString* clsname = classes[clsnr]->get_type()->get_name();
+          const auto cstr = clsname->c_str();
+          uint32_t global_clsnr = Locator::decodeGlobalClassIndex(cstr);
+          if (global_clsnr != Locator::invalid_global_class_index) {
+            TRACE(LOC, 3,
+                  "%s (%u, %u, %u) needs no locator; global class index=%u",
+                  cstr, strnr, dexnr, clsnr, global_clsnr);
+            // This prefix is followed by the global class index; this case
+            // doesn't need a locator.
+            continue;
+          }
+          locators.emplace_back(clsname, Locator::make(strnr, dexnr, clsnr));
         }
+      },
+      indices);
 
-        bool inserted = index
-                            .insert(std::make_pair(
-                                clsname, Locator::make(strnr, dexnr, clsnr)))
-                            .second;
-        // We shouldn't see the same class defined in two dexen
-        always_assert_log(inserted, "This was already inserted %s\n",
-                          (*clsit)->get_deobfuscated_name().c_str());
-        (void)inserted; // Shut up compiler when defined(NDEBUG)
-      }
+  LocatorIndex index;
+  size_t size = 0;
+  for (const auto& locators : dex_locators) {
+    size += locators.size();
+  }
+  index.reserve(size);
+  for (const auto& locators : dex_locators) {
+    for (const auto& p : locators) {
+      bool inserted = index.emplace(p.first, p.second).second;
+      // We shouldn't see the same class defined in two dexen
+      always_assert_log(inserted, "This was already inserted %s\n",
+                        type_class(DexType::get_type(p.first))
+                            ->get_deobfuscated_name()
+                            .c_str());
+      (void)inserted; // Shut up compiler when defined(NDEBUG)
     }
   }
 
   return index;
 }
 
+std::vector<uint8_t> make_locator_hash_table(const LocatorIndex& index) {
+  std::vector<std::pair<const char*, Locator>> entries;
+  entries.reserve(index.size());
+  for (const auto& p : index) {
+    entries.emplace_back(p.first->c_str(), p.second);
+  }
+  return facebook::LocatorHashTable::build(entries);
+}
+
 void DexOutput::inc_offset(uint32_t v) {
   // If this asserts hits, we already wrote out of bounds.
   always_assert(m_offset + v < m_output_size);
@@ -7,7 +7,11 @@
 
 #pragma once
 
+#include <array>
+#include <condition_variable>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 
 #include <boost/optional/optional.hpp>
@@ -22,11 +26,13 @@
 #include "ProguardMap.h"
 #include "RedexOptions.h"
 #include "Trace.h"
+#include "WorkQueue.h"
 
 #include <locator.h>
 using facebook::Locator;
 
 class DexCallSite;
+class MappedFile;
 
 using dexstring_to_idx = std::unordered_map<DexString*, uint32_t>;
 using dextype_to_idx = std::unordered_map<DexType*, uint16_t>;
@@ -38,6 +44,9 @@ using dexmethodhandle_to_idx = std::unordered_map<DexMethodHandle*, uint32_t>;
 
 using LocatorIndex = std::unordered_map<DexString*, Locator>;
 LocatorIndex make_locator_index(DexStoresVector& stores);
+// Serializes the lookup table of locator_hash.h for the index, which does
+// not depend on the order of the index.
+std::vector<uint8_t> make_locator_hash_table(const LocatorIndex& index);
 
 enum class SortMode {
   CLASS_ORDER,
@@ -45,6 +54,7 @@ enum class SortMode {
   CLINIT_FIRST,
   METHOD_PROFILED_ORDER,
   METHOD_SIMILARITY,
+  METHOD_PAGE_ORDER,
   DEFAULT
 };
 
@@ -126,8 +136,48 @@ class DexOutputIdx {
   uint32_t get_offset(uint32_t* ptr) { return get_offset((uint8_t*)ptr); }
 };
 
+class DebugLineMapWriter;
 class IODIMetadata;
 
+/*
+ * Lets several `write_classes_to_dex` calls run concurrently. The parts of
+ * DexOutput that touch state shared across dexes (the PositionMapper, IODI
+ * metadata, the debug line and method id maps, the appended symbol files and
+ * the unique-reference metrics) still run one dex at a time, ordered by each
+ * dex's sequence index, so the output is identical to that of a serial write.
+ *
+ * Dexes must be started in increasing sequence order (as a work queue does),
+ * so that the dex whose turn it is never waits for a free worker.
+ */
+class DexOutputSequencer {
+ public:
+  enum Phase : size_t {
+    DEBUG_ITEMS,
+    METHOD_IDS,
+    DEBUG_LINE_MAP,
+    SYMBOL_FILES,
+    METRICS,
+    NUM_PHASES,
+  };
+
+  // Each dex may use `num_threads_per_dex` threads for its own work, e.g.
+  // sorting and encoding.
+  explicit DexOutputSequencer(size_t num_threads_per_dex = 1)
+      : m_num_threads_per_dex(num_threads_per_dex) {}
+
+  // Waits until all dexes with a smaller index completed `phase`, then runs
+  // `fn`.
+  void run_in_order(Phase phase, size_t index, const std::function<void()>& fn);
+
+  size_t num_threads_per_dex() const { return m_num_threads_per_dex; }
+
+ private:
+  size_t m_num_threads_per_dex;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::array<size_t, NUM_PHASES> m_next_index{};
+};
+
 dex_stats_t write_classes_to_dex(
     const RedexOptions&,
     const std::string& filename,
@@ -143,7 +193,10 @@ dex_stats_t write_classes_to_dex(
     const std::string& dex_magic,
     PostLowering* post_lowering = nullptr,
     int min_sdk = 0,
-    bool disable_method_similarity_order = false);
+    bool disable_method_similarity_order = false,
+    DexOutputSequencer* sequencer = nullptr,
+    size_t sequence_index = 0,
+    DebugLineMapWriter* debug_line_map = nullptr);
 
 using cmp_dstring = bool (*)(const DexString*, const DexString*);
 using cmp_dtype = bool (*)(const DexType*, const DexType*);
@@ -221,6 +274,8 @@ class GatheredTypes {
   std::vector<DexCallSite*> m_lcallsite;
   std::vector<DexMethodHandle*> m_lmethodhandle;
   DexClasses* m_classes;
+  // Threads used to sort the lists.
+  size_t m_num_threads;
   std::unordered_map<const DexString*, unsigned int> m_cls_load_strings;
   std::unordered_map<const DexString*, unsigned int> m_cls_strings;
   std::unordered_map<const DexMethod*, unsigned int> m_methods_in_cls_order;
@@ -228,6 +283,11 @@ class GatheredTypes {
   const std::unordered_set<std::string>*
       m_method_sorting_allowlisted_substrings{nullptr};
   bool m_legacy_order{true};
+  size_t m_method_similarity_minhash_min_methods{0};
+  // The share of the source blocks of each method that ran during cold
+  // start. Source blocks don't survive the sync to DexCode, so this is
+  // gathered beforehand.
+  std::unordered_map<const DexMethod*, float> m_method_block_coverage;
 
   dexstring_to_idx* get_string_index(cmp_dstring cmp = compare_dexstrings);
   dextype_to_idx* get_type_index(cmp_dtype cmp = compare_dextypes);
@@ -246,7 +306,7 @@ class GatheredTypes {
   void build_method_map();
 
  public:
-  explicit GatheredTypes(DexClasses* classes);
+  explicit GatheredTypes(DexClasses* classes, size_t num_threads = 1);
 
   DexOutputIdx* get_dodx(const uint8_t* base);
   template <class T = decltype(compare_dexstrings)>
@@ -264,11 +324,15 @@ class GatheredTypes {
   void sort_dexmethod_emitlist_cls_order(std::vector<DexMethod*>& lmeth);
   void sort_dexmethod_emitlist_clinit_order(std::vector<DexMethod*>& lmeth);
   void sort_dexmethod_emitlist_profiled_order(std::vector<DexMethod*>& lmeth);
+  void sort_dexmethod_emitlist_page_order(std::vector<DexMethod*>& lmeth);
+  void gather_method_block_coverage();
+  bool is_startup_method(const DexMethod* method) const;
   void set_method_sorting_allowlisted_substrings(
       const std::unordered_set<std::string>* allowlisted_substrings);
   void set_method_profiles(
       const method_profiles::MethodProfiles* method_profiles);
   void set_legacy_order(bool legacy_order);
+  void set_method_similarity_minhash_min_methods(size_t min_methods);
 
   std::unordered_set<DexString*> index_type_names();
 };
@@ -276,7 +340,7 @@ class GatheredTypes {
 template <class T>
 std::vector<DexString*> GatheredTypes::get_dexstring_emitlist(T cmp) {
   std::vector<DexString*> strlist(m_lstring);
-  std::sort(strlist.begin(), strlist.end(), std::cref(cmp));
+  redex_parallel::stable_sort(strlist, cmp, m_num_threads);
   return strlist;
 }
 
@@ -314,7 +378,12 @@ class DexOutput {
   DexOutputIdx* dodx;
   GatheredTypes* m_gtypes;
   const size_t m_output_size;
-  std::unique_ptr<uint8_t[]> m_output;
+  // Points into either m_output_buffer or, with `mmap_dex_output`, straight
+  // into the mapped output file.
+  uint8_t* m_output{nullptr};
+  std::unique_ptr<uint8_t[]> m_output_buffer;
+  std::unique_ptr<MappedFile> m_output_file;
+  int m_output_fd{-1};
   uint32_t m_offset;
   const char* m_filename;
   size_t m_store_number;
@@ -341,6 +410,9 @@ class DexOutput {
   bool m_normal_primary_dex;
   const ConfigFiles& m_config_files;
   int m_min_sdk;
+  DexOutputSequencer* m_sequencer{nullptr};
+  size_t m_sequence_index{0};
+  DebugLineMapWriter* m_debug_line_map{nullptr};
 
   void insert_map_item(uint16_t maptype,
                        uint32_t size,
@@ -381,6 +453,9 @@ class DexOutput {
   void finalize_header();
   void init_header_offsets(const std::string& dex_magic);
   void write_symbol_files();
+  void compute_metrics();
+  void map_output_file(const char* path);
+  void write_mapped();
   uint32_t align(uint32_t offset) { return (offset + 3) & ~3; }
   void align_output() { m_offset = align(m_offset); }
   void emit_locator(Locator locator);
@@ -390,6 +465,11 @@ class DexOutput {
 
   void inc_offset(uint32_t v);
 
+  void run_in_order(DexOutputSequencer::Phase phase,
+                    const std::function<void()>& fn);
+  // The threads this dex may use on its own.
+  size_t num_threads() const;
+
   friend struct DexOutputTestHelper;
 
  public:
@@ -407,7 +487,14 @@ class DexOutput {
             std::unordered_map<DexCode*, std::vector<DebugLineItem>>*
                 code_debug_lines,
             PostLowering* post_lowering = nullptr,
-            int min_sdk = 0);
+            int min_sdk = 0,
+            // Coordinates with other DexOutputs that are prepared and written
+            // concurrently; see DexOutputSequencer.
+            DexOutputSequencer* sequencer = nullptr,
+            size_t sequence_index = 0,
+            // Receives the debug line map records of this dex, which need
+            // the method ids and the debug lines.
+            DebugLineMapWriter* debug_line_map = nullptr);
   ~DexOutput();
   void prepare(SortMode string_mode,
                const std::vector<SortMode>& code_mode,
@@ -5,14 +5,18 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <atomic>
+#include <boost/optional.hpp>
 #include <fstream>
 #include <iostream>
+#include <numeric>
 
 #include "DexClass.h"
 #include "DexPosition.h"
 #include "DexUtil.h"
 #include "Show.h"
 #include "Trace.h"
+#include "WorkQueue.h"
 
 DexPosition::DexPosition(uint32_t line) : line(line) {}
 
@@ -118,11 +122,36 @@ uint32_t RealPositionMapper::get_line(DexPosition* pos) {
   return m_pos_line_map.at(pos) + 1;
 }
 
-uint32_t RealPositionMapper::position_to_line(DexPosition* pos) {
+uint32_t RealPositionMapper::intern(DexPosition* pos) {
+  int64_t parent_line = -1;
+  const DexPosition* unmapped_parent = nullptr;
+  if (pos->parent != nullptr) {
+    auto it = m_pos_line_map.find(pos->parent);
+    if (it != m_pos_line_map.end() && it->second != -1) {
+      parent_line = it->second;
+    } else {
+      unmapped_parent = pos->parent;
+    }
+  }
   auto idx = m_positions.size();
-  m_positions.emplace_back(pos);
-  m_pos_line_map[pos] = idx;
-  return get_line(pos);
+  auto it = m_interned
+                .emplace(InternKey(pos->method, pos->file, pos->line,
+                                   parent_line, unmapped_parent),
+                         idx)
+                .first;
+  if (it->second == idx) {
+    m_positions.emplace_back(pos);
+  }
+  m_pos_line_map[pos] = it->second;
+  return it->second;
+}
+
+uint32_t RealPositionMapper::position_to_line(DexPosition* pos) {
+  auto it = m_pos_line_map.find(pos);
+  if (it != m_pos_line_map.end() && it->second != -1) {
+    return it->second + 1;
+  }
+  return intern(pos) + 1;
 }
 
 void RealPositionMapper::write_map() {
@@ -269,15 +298,15 @@ uint32_t RealPositionMapper::size() const { return m_positions.size(); }
 void RealPositionMapper::write_map_v2() {
   // to ensure that the line numbers in the Dex are as compact as possible,
   // we put the emitted positions at the start of the list and rest at the end
+  std::vector<DexPosition*> unmapped;
   for (auto& p : m_pos_line_map) {
-    auto pos = p.first;
-    auto& line = p.second;
-    if (line == -1) {
-      auto idx = m_positions.size();
-      m_positions.emplace_back(pos);
-      line = idx;
+    if (p.second == -1) {
+      unmapped.push_back(p.first);
     }
   }
+  for (auto pos : unmapped) {
+    intern(pos);
+  }
 
   process_pattern_switch_positions();
 
@@ -294,7 +323,6 @@ void RealPositionMapper::write_map_v2() {
    * string_length (4 bytes)
    * char[string_length]
    */
-  std::ostringstream pos_out;
   std::unordered_map<std::string, uint32_t> string_ids;
   std::vector<std::string> string_pool;
 
@@ -307,41 +335,89 @@ void RealPositionMapper::write_map_v2() {
     return it->second;
   };
 
-  size_t unregistered_parent_positions{0};
-
+  // Many positions share their method, so each method name is only split
+  // once, in parallel.
+  std::unordered_map<const DexString*, size_t> method_indices;
+  std::vector<const DexString*> methods;
   for (auto pos : m_positions) {
-    uint32_t parent_line = 0;
-    try {
-      parent_line = pos->parent == nullptr ? 0 : get_line(pos->parent);
-    } catch (std::out_of_range& e) {
-      ++unregistered_parent_positions;
-      TRACE(OPUT, 1, "Parent position %s of %s was not registered",
-            SHOW(pos->parent), SHOW(pos));
+    if (method_indices.emplace(pos->method, methods.size()).second) {
+      methods.push_back(pos->method);
+    }
+  }
+  // The external class name and the method name of each method.
+  std::vector<std::pair<std::string, std::string>> method_names(
+      methods.size());
+  std::vector<size_t> method_ids(methods.size());
+  std::iota(method_ids.begin(), method_ids.end(), 0);
+  workqueue_run<size_t>(
+      [&](size_t i) {
+        // of the form "class_name.method_name:(arg_types)return_type"
+        const auto& full_method_name = methods[i]->str();
+        // strip out the args and return type
+        auto qualified_method_name =
+            full_method_name.substr(0, full_method_name.find(':'));
+        auto dot = qualified_method_name.rfind('.');
+        method_names[i] = {java_names::internal_to_external(
+                               qualified_method_name.substr(0, dot)),
+                           qualified_method_name.substr(dot + 1)};
+      },
+      method_ids);
+
+  // The string ids are assigned in the order of the positions, so that the
+  // pool doesn't depend on the threads.
+  constexpr size_t kEntrySize = 5;
+  std::vector<uint32_t> entries(m_positions.size() * kEntrySize);
+  std::vector<boost::optional<std::pair<uint32_t, uint32_t>>>
+      class_and_method_ids(methods.size());
+  std::unordered_map<const DexString*, uint32_t> file_ids;
+  for (size_t i = 0; i < m_positions.size(); ++i) {
+    auto pos = m_positions[i];
+    auto& ids = class_and_method_ids[method_indices.at(pos->method)];
+    if (!ids) {
+      const auto& names = method_names[method_indices.at(pos->method)];
+      auto class_id = id_of_string(names.first);
+      ids = std::make_pair(class_id, id_of_string(names.second));
+    }
+    auto file_it = file_ids.find(pos->file);
+    if (file_it == file_ids.end()) {
+      file_it = file_ids.emplace(pos->file, id_of_string(pos->file->str()))
+                    .first;
     }
-    // of the form "class_name.method_name:(arg_types)return_type"
-    const auto& full_method_name = pos->method->str();
-    // strip out the args and return type
-    auto qualified_method_name =
-        full_method_name.substr(0, full_method_name.find(':'));
-    auto class_name = java_names::internal_to_external(
-        qualified_method_name.substr(0, qualified_method_name.rfind('.')));
-    auto method_name =
-        qualified_method_name.substr(qualified_method_name.rfind('.') + 1);
-    auto class_id = id_of_string(class_name);
-    auto method_id = id_of_string(method_name);
-    auto file_id = id_of_string(pos->file->str());
-    pos_out.write((const char*)&class_id, sizeof(class_id));
-    pos_out.write((const char*)&method_id, sizeof(method_id));
-    pos_out.write((const char*)&file_id, sizeof(file_id));
-    pos_out.write((const char*)&pos->line, sizeof(pos->line));
-    pos_out.write((const char*)&parent_line, sizeof(parent_line));
+    auto* entry = &entries[i * kEntrySize];
+    entry[0] = ids->first;
+    entry[1] = ids->second;
+    entry[2] = file_it->second;
   }
+  method_names.clear();
+
+  std::atomic<size_t> unregistered_parent_positions{0};
+  std::vector<size_t> position_indices(m_positions.size());
+  std::iota(position_indices.begin(), position_indices.end(), 0);
+  workqueue_run<size_t>(
+      [&](size_t i) {
+        auto pos = m_positions[i];
+        uint32_t parent_line = 0;
+        if (pos->parent != nullptr) {
+          auto it = m_pos_line_map.find(pos->parent);
+          if (it == m_pos_line_map.end()) {
+            ++unregistered_parent_positions;
+            TRACE(OPUT, 1, "Parent position %s of %s was not registered",
+                  SHOW(pos->parent), SHOW(pos));
+          } else {
+            parent_line = it->second + 1;
+          }
+        }
+        auto* entry = &entries[i * kEntrySize];
+        entry[3] = pos->line;
+        entry[4] = parent_line;
+      },
+      position_indices);
 
   if (unregistered_parent_positions > 0 && !traceEnabled(OPUT, 1)) {
     TRACE(OPUT, 0,
           "%zu parent positions had not been registered. Run with TRACE=OPUT:1 "
           "to list them.",
-          unregistered_parent_positions);
+          unregistered_parent_positions.load());
   }
 
   std::ofstream ofs(m_filename_v2.c_str(),
@@ -359,7 +435,7 @@ void RealPositionMapper::write_map_v2() {
   }
   uint32_t pos_count = m_positions.size();
   ofs.write((const char*)&pos_count, sizeof(pos_count));
-  ofs << pos_out.str();
+  ofs.write((const char*)entries.data(), entries.size() * sizeof(uint32_t));
 }
 
 PositionMapper* PositionMapper::make(const std::string& map_filename_v2) {
@@ -13,10 +13,13 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <tuple>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "ObjectPool.h"
+
 class DexClass;
 class DexMethod;
 class DexString;
@@ -32,6 +35,8 @@ struct DexPosition final {
   explicit DexPosition(uint32_t line);
   DexPosition(DexString* method, DexString* file, uint32_t line);
 
+  REDEX_POOLED_ALLOCATION(DexPosition)
+
   void bind(DexString* method_, DexString* file_);
   bool operator==(const DexPosition&) const;
 
@@ -158,7 +163,20 @@ class RealPositionMapper : public PositionMapper {
   std::unordered_map<DexPosition*, int64_t> m_pos_line_map;
   std::vector<std::unique_ptr<DexPosition>> m_owned_auxiliary_positions;
 
+  // Inlining leaves many copies of the same positions behind. Positions with
+  // the same method, file and line, whose parents map to the same line (or
+  // are the same unmapped position), share one line of the map. The key
+  // holds the parent's line, or -1 and the parent itself if it has no line
+  // yet.
+  using InternKey = std::tuple<const DexString*,
+                               const DexString*,
+                               uint32_t,
+                               int64_t,
+                               const DexPosition*>;
+  std::unordered_map<InternKey, uint32_t, boost::hash<InternKey>> m_interned;
+
   void process_pattern_switch_positions();
+  uint32_t intern(DexPosition* pos);
 
  protected:
   uint32_t get_line(DexPosition*);
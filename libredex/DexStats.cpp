@@ -7,6 +7,9 @@
 
 #include "DexStats.h"
 
+#include "DexClass.h"
+#include "RedexContext.h"
+
 dex_stats_t& operator+=(dex_stats_t& lhs, const dex_stats_t& rhs) {
   lhs.num_types += rhs.num_types;
   lhs.num_classes += rhs.num_classes;
@@ -34,6 +37,7 @@ dex_stats_t& operator+=(dex_stats_t& lhs, const dex_stats_t& rhs) {
   lhs.num_dbg_items += rhs.num_dbg_items;
   lhs.dbg_total_size += rhs.dbg_total_size;
   lhs.instruction_bytes += rhs.instruction_bytes;
+  lhs.startup_code_pages += rhs.startup_code_pages;
 
   lhs.header_item_count += rhs.header_item_count;
   lhs.header_item_bytes += rhs.header_item_bytes;
@@ -78,3 +82,42 @@ dex_stats_t& operator+=(dex_stats_t& lhs, const dex_stats_t& rhs) {
 
   return lhs;
 }
+
+member_footprint_t get_member_footprint() {
+  // A red-black tree node: three pointers and the color, then the entry.
+  constexpr uint64_t kParamAnnoNodeSize =
+      4 * sizeof(void*) + sizeof(ParamAnnotations::value_type);
+  member_footprint_t footprint;
+  footprint.method_object_size = sizeof(DexMethod);
+  footprint.field_object_size = sizeof(DexField);
+  g_redex->walk_type_class([&](const DexType*, const DexClass* cls) {
+    auto add_method = [&](const DexMethod* method) {
+      footprint.num_methods++;
+      footprint.num_external_methods += method->is_external();
+      footprint.total_bytes += sizeof(DexMethod);
+      if (auto* param_anno = method->get_param_anno()) {
+        footprint.num_param_annotated_methods++;
+        footprint.total_bytes +=
+            sizeof(ParamAnnotations) + param_anno->size() * kParamAnnoNodeSize;
+      }
+    };
+    auto add_field = [&](const DexField* field) {
+      footprint.num_fields++;
+      footprint.num_external_fields += field->is_external();
+      footprint.total_bytes += sizeof(DexField);
+    };
+    for (const auto* method : cls->get_dmethods()) {
+      add_method(method);
+    }
+    for (const auto* method : cls->get_vmethods()) {
+      add_method(method);
+    }
+    for (const auto* field : cls->get_sfields()) {
+      add_field(field);
+    }
+    for (const auto* field : cls->get_ifields()) {
+      add_field(field);
+    }
+  });
+  return footprint;
+}
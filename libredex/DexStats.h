@@ -45,6 +45,9 @@ struct dex_stats_t {
 
   int instruction_bytes = 0;
 
+  /* Estimated 4KB pages of code items touched by cold start methods. */
+  int startup_code_pages = 0;
+
   /* Stats collected from the Map List section of a Dex. */
   int header_item_count = 0;
   int header_item_bytes = 0;
@@ -108,3 +111,25 @@ struct dex_stats_t {
 };
 
 dex_stats_t& operator+=(dex_stats_t& lhs, const dex_stats_t& rhs);
+
+/*
+ * The in-memory footprint of the method and field definitions of all the
+ * classes in the RedexContext, external ones included, to keep an eye on the
+ * layout of DexMethod and DexField.
+ */
+struct member_footprint_t {
+  uint64_t method_object_size = 0;
+  uint64_t field_object_size = 0;
+
+  uint64_t num_methods = 0;
+  uint64_t num_fields = 0;
+  uint64_t num_external_methods = 0;
+  uint64_t num_external_fields = 0;
+  uint64_t num_param_annotated_methods = 0;
+
+  // The objects of all the members, plus the nodes of their parameter
+  // annotation maps.
+  uint64_t total_bytes = 0;
+};
+
+member_footprint_t get_member_footprint();
@@ -7,9 +7,11 @@
 
 #include "DexTypeEnvironment.h"
 
+#include <boost/functional/hash.hpp>
 #include <boost/optional/optional_io.hpp>
 #include <ostream>
 
+#include "ConcurrentContainers.h"
 #include "Show.h"
 
 namespace dtv_impl {
@@ -163,47 +165,136 @@ std::ostream& operator<<(std::ostream& output, const DexType* dex_type) {
   return output;
 }
 
-bool SmallSetDexTypeDomain::leq(const SmallSetDexTypeDomain& other) const {
-  if (is_bottom()) {
+bool SingletonDexTypeDomain::leq(const SingletonDexTypeDomain& other) const {
+  if (is_bottom() || other.is_top()) {
     return true;
   }
-  if (other.is_bottom()) {
+  if (other.is_bottom() || is_top()) {
     return false;
   }
-  if (other.is_top()) {
-    return true;
+  return dtv_impl::DexTypeValue(type()).leq(
+      dtv_impl::DexTypeValue(other.type()));
+}
+
+void SingletonDexTypeDomain::join_with(const SingletonDexTypeDomain& other) {
+  if (is_top() || other.is_bottom()) {
+    return;
   }
-  if (is_top()) {
+  if (other.is_top() || is_bottom()) {
+    m_word = other.m_word;
+    return;
+  }
+  apply_to_value(other, [](auto& value, const auto& other_value) {
+    return value.join_with(other_value);
+  });
+}
+
+void SingletonDexTypeDomain::widen_with(const SingletonDexTypeDomain& other) {
+  if (is_top() || other.is_bottom()) {
+    return;
+  }
+  if (other.is_top() || is_bottom()) {
+    m_word = other.m_word;
+    return;
+  }
+  apply_to_value(other, [](auto& value, const auto& other_value) {
+    return value.widen_with(other_value);
+  });
+}
+
+void SingletonDexTypeDomain::meet_with(const SingletonDexTypeDomain& other) {
+  if (is_bottom() || other.is_top()) {
+    return;
+  }
+  if (other.is_bottom() || is_top()) {
+    m_word = other.m_word;
+    return;
+  }
+  apply_to_value(other, [](auto& value, const auto& other_value) {
+    return value.meet_with(other_value);
+  });
+}
+
+namespace dtv_impl {
+
+bool SmallTypeSet::is_subset_of(const SmallTypeSet& other) const {
+  return std::includes(other.begin(), other.end(), begin(), end());
+}
+
+bool SmallTypeSet::union_with(const SmallTypeSet& other) {
+  std::array<const DexType*, 2 * MAX_SET_SIZE> merged;
+  auto merged_end = std::set_union(begin(), end(), other.begin(), other.end(),
+                                   merged.begin());
+  size_t size = merged_end - merged.begin();
+  if (size > MAX_SET_SIZE) {
     return false;
   }
-  return m_types.is_subset_of(other.m_types);
+  std::copy(merged.begin(), merged_end, m_types.begin());
+  m_size = size;
+  return true;
 }
 
-bool SmallSetDexTypeDomain::equals(const SmallSetDexTypeDomain& other) const {
+size_t SmallTypeSet::Hash::operator()(const SmallTypeSet& set) const {
+  size_t seed = set.size();
+  for (auto type : set) {
+    boost::hash_combine(seed, type);
+  }
+  return seed;
+}
+
+const SmallTypeSet* SmallTypeSet::intern(const SmallTypeSet& set) {
+  // All the sets seen so far. They are few, and never freed.
+  static auto* sets = new InsertOnlyConcurrentSet<SmallTypeSet, Hash>();
+  return sets->insert(set).first;
+}
+
+const SmallTypeSet* SmallTypeSet::singleton(const DexType* type) {
+  SmallTypeSet set;
+  set.m_types[0] = type;
+  set.m_size = 1;
+  return intern(set);
+}
+
+const SmallTypeSet* SmallTypeSet::empty() {
+  static const SmallTypeSet* empty_set = intern(SmallTypeSet());
+  return empty_set;
+}
+
+} // namespace dtv_impl
+
+const dtv_impl::SmallTypeSet* SmallSetDexTypeDomain::bottom_set() {
+  static const dtv_impl::SmallTypeSet bottom;
+  return &bottom;
+}
+
+bool SmallSetDexTypeDomain::leq(const SmallSetDexTypeDomain& other) const {
   if (is_bottom()) {
-    return other.is_bottom();
+    return true;
+  }
+  if (other.is_bottom()) {
+    return false;
+  }
+  if (other.is_top()) {
+    return true;
   }
   if (is_top()) {
-    return other.is_top();
+    return false;
   }
-  return m_types.equals(other.m_types);
+  return m_set->is_subset_of(*other.m_set);
 }
 
 void SmallSetDexTypeDomain::join_with(const SmallSetDexTypeDomain& other) {
-  if (is_top() || other.is_bottom()) {
-    return;
-  }
-  if (other.is_top()) {
-    set_to_top();
+  if (is_top() || other.is_bottom() || m_set == other.m_set) {
     return;
   }
-  if (is_bottom()) {
-    m_kind = other.m_kind;
-    m_types = other.m_types;
+  if (other.is_top() || is_bottom()) {
+    m_set = other.m_set;
     return;
   }
-  m_types.union_with(other.m_types);
-  if (m_types.size() > MAX_SET_SIZE) {
+  auto types = *m_set;
+  if (types.union_with(*other.m_set)) {
+    m_set = dtv_impl::SmallTypeSet::intern(types);
+  } else {
     set_to_top();
   }
 }
@@ -212,16 +303,11 @@ void SmallSetDexTypeDomain::widen_with(const SmallSetDexTypeDomain& other) {
   if (is_top() || other.is_bottom()) {
     return;
   }
-  if (other.is_top()) {
-    set_to_top();
-    return;
-  }
-  if (is_bottom()) {
-    m_kind = other.m_kind;
-    m_types = other.m_types;
+  if (other.is_top() || is_bottom()) {
+    m_set = other.m_set;
     return;
   }
-  if (m_types.size() + other.m_types.size() > MAX_SET_SIZE) {
+  if (m_set->size() + other.m_set->size() > MAX_SET_SIZE) {
     set_to_top();
     return;
   }
@@ -7,6 +7,9 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <ostream>
 
 #include <boost/optional.hpp>
@@ -14,6 +17,7 @@
 #include "AbstractDomain.h"
 #include "DexUtil.h"
 #include "FiniteAbstractDomain.h"
+#include "FlatAbstractEnvironment.h"
 #include "NullnessDomain.h"
 #include "PatriciaTreeMapAbstractEnvironment.h"
 #include "PatriciaTreeSet.h"
@@ -123,26 +127,61 @@ class DexTypeValue final : public sparta::AbstractValue<DexTypeValue> {
  * two distinct SingletonDexTypeDomain will produce a single DexType value that
  * is guaranteed to be compatible with the two inputs. This is the most simple
  * data structure we can use to represent a DexType domain.
+ *
+ * The domain is a single word: the DexType pointer, with null standing for
+ * none and two values that are never valid pointers for Top and Bottom. The
+ * lattice operations are those of DexTypeValue.
  */
 class SingletonDexTypeDomain final
-    : public sparta::AbstractDomainScaffolding<dtv_impl::DexTypeValue,
-                                               SingletonDexTypeDomain> {
+    : public sparta::AbstractDomain<SingletonDexTypeDomain> {
  public:
-  SingletonDexTypeDomain() { this->set_to_top(); }
+  SingletonDexTypeDomain() : m_word(TOP) {}
 
-  explicit SingletonDexTypeDomain(const DexType* cst) {
-    this->set_to_value(dtv_impl::DexTypeValue(cst));
-  }
+  explicit SingletonDexTypeDomain(const DexType* cst)
+      : m_word(reinterpret_cast<uintptr_t>(cst)) {}
 
   explicit SingletonDexTypeDomain(sparta::AbstractValueKind kind)
-      : sparta::AbstractDomainScaffolding<dtv_impl::DexTypeValue,
-                                          SingletonDexTypeDomain>(kind) {}
+      : m_word(kind == sparta::AbstractValueKind::Bottom ? BOTTOM : TOP) {
+    always_assert(kind != sparta::AbstractValueKind::Value);
+  }
+
+  sparta::AbstractValueKind kind() const {
+    return m_word == TOP      ? sparta::AbstractValueKind::Top
+           : m_word == BOTTOM ? sparta::AbstractValueKind::Bottom
+                              : sparta::AbstractValueKind::Value;
+  }
+
+  bool is_bottom() const override { return m_word == BOTTOM; }
+
+  bool is_top() const override { return m_word == TOP; }
+
+  bool is_value() const { return !is_top() && !is_bottom(); }
+
+  void set_to_bottom() override { m_word = BOTTOM; }
+
+  void set_to_top() override { m_word = TOP; }
+
+  bool leq(const SingletonDexTypeDomain& other) const override;
+
+  bool equals(const SingletonDexTypeDomain& other) const override {
+    return m_word == other.m_word;
+  }
+
+  void join_with(const SingletonDexTypeDomain& other) override;
+
+  void widen_with(const SingletonDexTypeDomain& other) override;
+
+  void meet_with(const SingletonDexTypeDomain& other) override;
+
+  void narrow_with(const SingletonDexTypeDomain& other) override {
+    meet_with(other);
+  }
 
   boost::optional<const DexType*> get_dex_type() const {
-    if (this->kind() != sparta::AbstractValueKind::Value || this->is_none()) {
+    if (!is_value() || is_none()) {
       return boost::none;
     }
-    return boost::optional<const DexType*>(this->get_value()->get_dex_type());
+    return boost::optional<const DexType*>(type());
   }
 
   static SingletonDexTypeDomain bottom() {
@@ -157,13 +196,38 @@ class SingletonDexTypeDomain final
     return SingletonDexTypeDomain(nullptr);
   }
 
-  bool is_none() const {
-    return this->kind() == sparta::AbstractValueKind::Value &&
-           this->get_value()->is_none();
-  }
+  bool is_none() const { return m_word == 0; }
 
   friend std::ostream& operator<<(std::ostream& out,
                                   const SingletonDexTypeDomain& x);
+
+ private:
+  // DexTypes are aligned, so these are never the address of one.
+  static constexpr uintptr_t TOP = 1;
+  static constexpr uintptr_t BOTTOM = 2;
+
+  const DexType* type() const {
+    return reinterpret_cast<const DexType*>(m_word);
+  }
+
+  // Applies a lattice operation of DexTypeValue to two values.
+  template <typename Operation>
+  void apply_to_value(const SingletonDexTypeDomain& other, Operation op) {
+    dtv_impl::DexTypeValue value(type());
+    switch (op(value, dtv_impl::DexTypeValue(other.type()))) {
+    case sparta::AbstractValueKind::Top:
+      set_to_top();
+      break;
+    case sparta::AbstractValueKind::Bottom:
+      set_to_bottom();
+      break;
+    case sparta::AbstractValueKind::Value:
+      m_word = reinterpret_cast<uintptr_t>(value.get_dex_type());
+      break;
+    }
+  }
+
+  uintptr_t m_word;
 };
 
 std::ostream& operator<<(std::ostream& out, const SingletonDexTypeDomain& x);
@@ -177,44 +241,86 @@ std::ostream& operator<<(std::ostream& output, const DexType* dex_type);
  */
 constexpr size_t MAX_SET_SIZE = 4;
 
+namespace dtv_impl {
+
+/*
+ * A set of at most MAX_SET_SIZE types, sorted by address. The sets are
+ * interned: SmallSetDexTypeDomain only holds a pointer to the unique copy of
+ * its set, so that equal sets are equal pointers.
+ */
+class SmallTypeSet final {
+ public:
+  using const_iterator = const DexType* const*;
+
+  const_iterator begin() const { return m_types.data(); }
+
+  const_iterator end() const { return m_types.data() + m_size; }
+
+  size_t size() const { return m_size; }
+
+  bool is_subset_of(const SmallTypeSet& other) const;
+
+  /*
+   * Returns false if the union would have more than MAX_SET_SIZE elements,
+   * and leaves the set in an unspecified state.
+   */
+  bool union_with(const SmallTypeSet& other);
+
+  bool operator==(const SmallTypeSet& other) const {
+    return m_size == other.m_size &&
+           std::equal(begin(), end(), other.begin());
+  }
+
+  struct Hash {
+    size_t operator()(const SmallTypeSet& set) const;
+  };
+
+  static const SmallTypeSet* intern(const SmallTypeSet& set);
+
+  static const SmallTypeSet* singleton(const DexType* type);
+
+  static const SmallTypeSet* empty();
+
+ private:
+  std::array<const DexType*, MAX_SET_SIZE> m_types{};
+  uint8_t m_size{0};
+};
+
+} // namespace dtv_impl
+
 class SmallSetDexTypeDomain final
     : public sparta::AbstractDomain<SmallSetDexTypeDomain> {
  public:
-  SmallSetDexTypeDomain() : m_kind(sparta::AbstractValueKind::Value) {}
+  SmallSetDexTypeDomain() : m_set(dtv_impl::SmallTypeSet::empty()) {}
 
-  explicit SmallSetDexTypeDomain(const DexType* type) {
-    m_types.insert(type);
-    m_kind = sparta::AbstractValueKind::Value;
-  }
+  explicit SmallSetDexTypeDomain(const DexType* type)
+      : m_set(dtv_impl::SmallTypeSet::singleton(type)) {}
 
-  bool is_bottom() const override {
-    return m_kind == sparta::AbstractValueKind::Bottom;
-  }
+  bool is_bottom() const override { return m_set == bottom_set(); }
 
-  bool is_top() const override {
-    return m_kind == sparta::AbstractValueKind::Top;
-  }
+  bool is_top() const override { return m_set == nullptr; }
 
-  void set_to_bottom() override {
-    m_kind = sparta::AbstractValueKind::Bottom;
-    m_types.clear();
-  }
+  void set_to_bottom() override { m_set = bottom_set(); }
 
-  void set_to_top() override {
-    m_kind = sparta::AbstractValueKind::Top;
-    m_types.clear();
-  }
+  void set_to_top() override { m_set = nullptr; }
 
-  sparta::AbstractValueKind kind() const { return m_kind; }
+  sparta::AbstractValueKind kind() const {
+    return is_top()      ? sparta::AbstractValueKind::Top
+           : is_bottom() ? sparta::AbstractValueKind::Bottom
+                         : sparta::AbstractValueKind::Value;
+  }
 
   sparta::PatriciaTreeSet<const DexType*> get_types() const {
     always_assert(!is_top());
-    return m_types;
+    return sparta::PatriciaTreeSet<const DexType*>(m_set->begin(),
+                                                   m_set->end());
   }
 
   bool leq(const SmallSetDexTypeDomain& other) const override;
 
-  bool equals(const SmallSetDexTypeDomain& other) const override;
+  bool equals(const SmallSetDexTypeDomain& other) const override {
+    return m_set == other.m_set;
+  }
 
   void join_with(const SmallSetDexTypeDomain& other) override;
 
@@ -232,8 +338,11 @@ class SmallSetDexTypeDomain final
                                   const SmallSetDexTypeDomain& x);
 
  private:
-  sparta::PatriciaTreeSet<const DexType*> m_types;
-  sparta::AbstractValueKind m_kind;
+  // An empty set, distinct from the interned empty set.
+  static const dtv_impl::SmallTypeSet* bottom_set();
+
+  // Null for Top.
+  const dtv_impl::SmallTypeSet* m_set;
 };
 
 /*
@@ -377,10 +486,11 @@ class DexTypeDomain
 
 /*
  * We model the register to DexTypeDomain mapping using an Environment. A
- * write to a register always overwrites the existing mapping.
+ * write to a register always overwrites the existing mapping. Most methods use
+ * few registers, which a flat environment keeps inline.
  */
 using RegTypeEnvironment =
-    sparta::PatriciaTreeMapAbstractEnvironment<reg_t, DexTypeDomain>;
+    sparta::FlatAbstractEnvironment<reg_t, DexTypeDomain>;
 
 /*
  * We model the field to DexTypeDomain mapping using an Environment. But we
@@ -5,28 +5,49 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#pragma once
+
+#include <algorithm>
 #include <boost/optional/optional.hpp>
+#include <numeric>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "GraphUtil.h"
 
 namespace dominators {
 
+// Graphs with at least this many reachable nodes use Semi-NCA rather than
+// the iterative algorithm, which can take quadratic time on huge graphs.
+constexpr size_t kSemiNCAThreshold = 2048;
+
 template <class GraphInterface>
 class SimpleFastDominators {
  public:
   using NodeId = typename GraphInterface::NodeId;
 
   /*
-   * Find the immediate dominator for each node in the given graph. This
-   * algorithm is described in the following paper:
+   * Find the immediate dominator for each node in the given graph. Small
+   * graphs use the algorithm described in the following paper:
    *
    *    K. D. Cooper et.al. A Simple, Fast Dominance Algorithm.
+   *
+   * Graphs with at least `semi_nca_threshold` reachable nodes use Semi-NCA,
+   * as described in:
+   *
+   *    L. Georgiadis. Linear-Time Algorithms for Dominators and Related
+   *    Problems. (Section 2.3.2)
    */
-  explicit SimpleFastDominators(const typename GraphInterface::Graph& graph) {
+  explicit SimpleFastDominators(const typename GraphInterface::Graph& graph,
+                                size_t semi_nca_threshold = kSemiNCAThreshold) {
     // Sort nodes in postorder and create a map of each node to its postorder
     // number.
     m_postordering = graph::postorder_sort<GraphInterface>(graph);
+    if (m_postordering.size() >= semi_nca_threshold) {
+      compute_semi_nca(graph);
+      return;
+    }
     for (size_t i = 0; i < m_postordering.size(); ++i) {
       m_postorder_map[m_postordering[i]] = i;
     }
@@ -82,6 +103,99 @@ class SimpleFastDominators {
   }
 
  private:
+  void compute_semi_nca(const typename GraphInterface::Graph& graph) {
+    // Number the nodes in depth-first preorder. Nodes are marked when popped,
+    // which makes the parents form a depth-first spanning tree.
+    std::vector<NodeId> nodes;
+    std::vector<size_t> parent;
+    std::unordered_map<NodeId, size_t> number;
+    nodes.reserve(m_postordering.size());
+    parent.reserve(m_postordering.size());
+    number.reserve(m_postordering.size());
+    std::vector<std::pair<NodeId, size_t>> stack{
+        {GraphInterface::entry(graph), 0}};
+    while (!stack.empty()) {
+      auto [node, node_parent] = stack.back();
+      stack.pop_back();
+      if (!number.emplace(node, nodes.size()).second) {
+        continue;
+      }
+      size_t node_number = nodes.size();
+      nodes.push_back(node);
+      parent.push_back(node_parent);
+      for (const auto& succ : GraphInterface::successors(graph, node)) {
+        const auto& target = GraphInterface::target(graph, succ);
+        if (!number.count(target)) {
+          stack.emplace_back(target, node_number);
+        }
+      }
+    }
+
+    // Compute the semidominators in reverse preorder. `ancestor` starts out
+    // as the spanning tree and is compressed by eval; nodes with numbers
+    // above `last_linked` are linked to their parents.
+    size_t n = nodes.size();
+    std::vector<size_t> semi(n);
+    std::vector<size_t> label(n);
+    std::vector<size_t> ancestor(parent);
+    std::iota(semi.begin(), semi.end(), 0);
+    std::iota(label.begin(), label.end(), 0);
+    std::vector<size_t> path;
+    auto eval = [&](size_t v, size_t last_linked) {
+      if (ancestor[v] < last_linked) {
+        return label[v];
+      }
+      do {
+        path.push_back(v);
+        v = ancestor[v];
+      } while (ancestor[v] >= last_linked);
+      // Compress the path, keeping the label with the smallest semidominator.
+      auto p = v;
+      auto p_label = label[p];
+      do {
+        v = path.back();
+        path.pop_back();
+        ancestor[v] = ancestor[p];
+        if (semi[p_label] < semi[label[v]]) {
+          label[v] = p_label;
+        } else {
+          p_label = label[v];
+        }
+        p = v;
+      } while (!path.empty());
+      return label[v];
+    };
+    for (size_t w = n - 1; w > 0; --w) {
+      semi[w] = parent[w];
+      for (const auto& pred : GraphInterface::predecessors(graph, nodes[w])) {
+        auto it = number.find(GraphInterface::source(graph, pred));
+        if (it == number.end()) {
+          // Unreachable.
+          continue;
+        }
+        semi[w] = std::min(semi[w], semi[eval(it->second, w + 1)]);
+      }
+    }
+
+    // The immediate dominator of a node is the nearest common ancestor of its
+    // parent and semidominator in the dominator tree.
+    std::vector<size_t> idom(parent);
+    for (size_t w = 1; w < n; ++w) {
+      while (idom[w] > semi[w]) {
+        idom[w] = idom[idom[w]];
+      }
+    }
+
+    // Dominators come before the nodes they dominate in preorder, so the
+    // reversed preorder works for intersect.
+    m_idoms.reserve(n);
+    m_postorder_map.reserve(n);
+    for (size_t w = 0; w < n; ++w) {
+      m_idoms.emplace(nodes[w], nodes[idom[w]]);
+      m_postorder_map.emplace(nodes[w], n - 1 - w);
+    }
+  }
+
   std::unordered_map<NodeId, NodeId> m_idoms;
   std::vector<NodeId> m_postordering;
   std::unordered_map<NodeId, size_t> m_postorder_map;
@@ -0,0 +1,516 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/*
+ * Open-addressing hash tables in the style of Swiss tables, with the subset
+ * of the std::unordered_map/std::unordered_set interface that the concurrent
+ * containers need.
+ *
+ * The elements are stored inline in a single array, next to an array of
+ * control bytes: one per element, which is either empty, deleted, or holds 7
+ * bits of the hash of the element. Lookups probe groups of 8 control bytes,
+ * which are matched against the hash bits all at once, and only compare the
+ * keys of the elements whose hash bits match. Compared to the node-based STL
+ * containers, this saves an allocation per element and most of the cache
+ * misses on lookups.
+ *
+ * Unlike the STL containers, insertions may move the elements around, which
+ * invalidates all iterators, pointers and references to elements.
+ */
+namespace flat_hash_impl {
+
+using ctrl_t = int8_t;
+
+constexpr ctrl_t kEmpty = -128;
+constexpr ctrl_t kDeleted = -2;
+
+constexpr size_t kGroupWidth = 8;
+
+constexpr uint64_t kLsbs = 0x0101010101010101ULL;
+constexpr uint64_t kMsbs = 0x8080808080808080ULL;
+
+inline bool is_full(ctrl_t c) { return c >= 0; }
+
+// The control bytes of a group, packed in a word. The masks have the top bit
+// of the bytes that match set.
+class Group {
+ public:
+  explicit Group(const ctrl_t* pos) { memcpy(&m_ctrl, pos, sizeof(m_ctrl)); }
+
+  // This may have false positives after a real match, which only cost a key
+  // comparison.
+  uint64_t match(ctrl_t h2) const {
+    auto x = m_ctrl ^ (kLsbs * (uint8_t)h2);
+    return (x - kLsbs) & ~x & kMsbs;
+  }
+
+  uint64_t match_empty() const { return m_ctrl & ~(m_ctrl << 6) & kMsbs; }
+
+  uint64_t match_empty_or_deleted() const {
+    return m_ctrl & ~(m_ctrl << 7) & kMsbs;
+  }
+
+ private:
+  uint64_t m_ctrl;
+};
+
+inline size_t lowest_index(uint64_t mask) {
+  return __builtin_ctzll(mask) / 8;
+}
+
+// The standard hashes of pointers and integers are the identity, whose low
+// bits are the ones we use the least well; spread them over the whole word.
+inline size_t mix(size_t hash) {
+  __uint128_t m = (__uint128_t)hash * 0x9E3779B97F4A7C15ULL;
+  return (size_t)(m >> 64) ^ (size_t)m;
+}
+
+template <bool Const, typename Value>
+class Iterator final {
+ public:
+  using difference_type = std::ptrdiff_t;
+  using value_type = Value;
+  using pointer = std::conditional_t<Const, const Value*, Value*>;
+  using reference = std::conditional_t<Const, const Value&, Value&>;
+  using iterator_category = std::forward_iterator_tag;
+
+  Iterator() = default;
+
+  Iterator(const ctrl_t* ctrl, pointer slots, size_t index, size_t capacity)
+      : m_ctrl(ctrl), m_slots(slots), m_index(index), m_capacity(capacity) {
+    skip_empty_slots();
+  }
+
+  template <bool C = Const, typename = std::enable_if_t<C>>
+  /* implicit */ Iterator(const Iterator<false, Value>& other)
+      : m_ctrl(other.m_ctrl),
+        m_slots(other.m_slots),
+        m_index(other.m_index),
+        m_capacity(other.m_capacity) {}
+
+  Iterator& operator++() {
+    ++m_index;
+    skip_empty_slots();
+    return *this;
+  }
+
+  Iterator operator++(int) {
+    Iterator retval = *this;
+    ++(*this);
+    return retval;
+  }
+
+  bool operator==(const Iterator& other) const {
+    return m_slots == other.m_slots && m_index == other.m_index;
+  }
+
+  bool operator!=(const Iterator& other) const { return !(*this == other); }
+
+  reference operator*() const { return m_slots[m_index]; }
+
+  pointer operator->() const { return &m_slots[m_index]; }
+
+ private:
+  void skip_empty_slots() {
+    while (m_index < m_capacity && !is_full(m_ctrl[m_index])) {
+      ++m_index;
+    }
+  }
+
+  const ctrl_t* m_ctrl{nullptr};
+  pointer m_slots{nullptr};
+  size_t m_index{0};
+  size_t m_capacity{0};
+
+  friend class Iterator<true, Value>;
+};
+
+/*
+ * The table that FlatHashMap and FlatHashSet share. `KeyOf` extracts the key
+ * of a stored value.
+ */
+template <typename Value,
+          typename Key,
+          typename KeyOf,
+          typename Hash,
+          typename Equal>
+class FlatHashTable {
+ public:
+  using key_type = Key;
+  using value_type = Value;
+  using size_type = size_t;
+  using hasher = Hash;
+  using key_equal = Equal;
+  using iterator = Iterator<false, Value>;
+  using const_iterator = Iterator<true, Value>;
+
+  FlatHashTable() = default;
+
+  FlatHashTable(const FlatHashTable& other) { copy_from(other); }
+
+  FlatHashTable(FlatHashTable&& other) noexcept { swap(other); }
+
+  FlatHashTable& operator=(const FlatHashTable& other) {
+    if (this != &other) {
+      FlatHashTable copy(other);
+      swap(copy);
+    }
+    return *this;
+  }
+
+  FlatHashTable& operator=(FlatHashTable&& other) noexcept {
+    if (this != &other) {
+      destroy();
+      swap(other);
+    }
+    return *this;
+  }
+
+  ~FlatHashTable() { destroy(); }
+
+  void swap(FlatHashTable& other) noexcept {
+    std::swap(m_ctrl, other.m_ctrl);
+    std::swap(m_slots, other.m_slots);
+    std::swap(m_capacity, other.m_capacity);
+    std::swap(m_size, other.m_size);
+    std::swap(m_growth_left, other.m_growth_left);
+  }
+
+  iterator begin() { return iterator(m_ctrl, slots(), 0, m_capacity); }
+
+  iterator end() { return iterator(m_ctrl, slots(), m_capacity, m_capacity); }
+
+  const_iterator begin() const {
+    return const_iterator(m_ctrl, slots(), 0, m_capacity);
+  }
+
+  const_iterator end() const {
+    return const_iterator(m_ctrl, slots(), m_capacity, m_capacity);
+  }
+
+  const_iterator cbegin() const { return begin(); }
+
+  const_iterator cend() const { return end(); }
+
+  size_t size() const { return m_size; }
+
+  bool empty() const { return m_size == 0; }
+
+  iterator find(const Key& key) {
+    auto i = find_index(key, mix(Hash()(key)));
+    return iterator(m_ctrl, slots(), i, m_capacity);
+  }
+
+  const_iterator find(const Key& key) const {
+    auto i = find_index(key, mix(Hash()(key)));
+    return const_iterator(m_ctrl, slots(), i, m_capacity);
+  }
+
+  size_t count(const Key& key) const {
+    return find_index(key, mix(Hash()(key))) < m_capacity ? 1 : 0;
+  }
+
+  std::pair<iterator, bool> insert(const Value& value) {
+    return emplace_with(KeyOf()(value),
+                        [&](void* p) { new (p) Value(value); });
+  }
+
+  std::pair<iterator, bool> insert(Value&& value) {
+    return emplace_with(KeyOf()(value),
+                        [&](void* p) { new (p) Value(std::move(value)); });
+  }
+
+  template <typename... Args>
+  std::pair<iterator, bool> emplace(Args&&... args) {
+    return insert(Value(std::forward<Args>(args)...));
+  }
+
+  size_t erase(const Key& key) {
+    auto i = find_index(key, mix(Hash()(key)));
+    if (i == m_capacity) {
+      return 0;
+    }
+    slots()[i].~Value();
+    m_ctrl[i] = kDeleted;
+    --m_size;
+    return 1;
+  }
+
+  void clear() {
+    for (size_t i = 0; i < m_capacity; ++i) {
+      if (is_full(m_ctrl[i])) {
+        slots()[i].~Value();
+      }
+    }
+    if (m_capacity) {
+      memset(m_ctrl, kEmpty, m_capacity);
+    }
+    m_size = 0;
+    m_growth_left = max_load(m_capacity);
+  }
+
+  void reserve(size_t count) {
+    if (count > max_load(m_capacity)) {
+      resize(capacity_for(count));
+    }
+  }
+
+ protected:
+  // Finds the element with the given key, or makes room for it and calls
+  // `construct` on the raw storage of the new element.
+  template <typename ConstructFn>
+  std::pair<iterator, bool> emplace_with(const Key& key,
+                                         const ConstructFn& construct) {
+    auto hash = mix(Hash()(key));
+    auto i = find_index(key, hash);
+    if (i < m_capacity) {
+      return {iterator(m_ctrl, slots(), i, m_capacity), false};
+    }
+    if (m_growth_left == 0) {
+      // Either grow, or just drop the deleted elements.
+      resize(capacity_for(m_size + 1));
+    }
+    i = find_first_non_full(hash);
+    construct(&storage()[i]);
+    if (m_ctrl[i] == kEmpty) {
+      --m_growth_left;
+    }
+    m_ctrl[i] = h2(hash);
+    ++m_size;
+    return {iterator(m_ctrl, slots(), i, m_capacity), true};
+  }
+
+ private:
+  using Storage = std::aligned_storage_t<sizeof(Value), alignof(Value)>;
+
+  // Up to 7/8 of the slots may be used.
+  static size_t max_load(size_t capacity) { return capacity - capacity / 8; }
+
+  static size_t capacity_for(size_t count) {
+    size_t capacity = kGroupWidth;
+    while (max_load(capacity) < count) {
+      capacity *= 2;
+    }
+    return capacity;
+  }
+
+  static ctrl_t h2(size_t hash) { return (ctrl_t)(hash & 0x7f); }
+
+  Storage* storage() const { return m_slots.get(); }
+
+  Value* slots() const { return reinterpret_cast<Value*>(m_slots.get()); }
+
+  // Groups are probed quadratically, which visits all of them as their number
+  // is a power of two.
+  template <typename Fn>
+  void probe(size_t hash, const Fn& fn) const {
+    size_t group_mask = m_capacity / kGroupWidth - 1;
+    size_t group = (hash >> 7) & group_mask;
+    for (size_t step = 1;; ++step) {
+      if (fn(group * kGroupWidth, Group(m_ctrl + group * kGroupWidth))) {
+        return;
+      }
+      group = (group + step) & group_mask;
+    }
+  }
+
+  // Returns the index of the element, or m_capacity if it is absent.
+  size_t find_index(const Key& key, size_t hash) const {
+    size_t result = m_capacity;
+    if (m_capacity == 0) {
+      return result;
+    }
+    auto tag = h2(hash);
+    probe(hash, [&](size_t base, const Group& g) {
+      for (auto mask = g.match(tag); mask; mask &= mask - 1) {
+        auto i = base + lowest_index(mask);
+        if (m_ctrl[i] == tag && Equal()(KeyOf()(slots()[i]), key)) {
+          result = i;
+          return true;
+        }
+      }
+      return g.match_empty() != 0;
+    });
+    return result;
+  }
+
+  size_t find_first_non_full(size_t hash) const {
+    size_t result = 0;
+    probe(hash, [&](size_t base, const Group& g) {
+      auto mask = g.match_empty_or_deleted();
+      if (mask) {
+        result = base + lowest_index(mask);
+        return true;
+      }
+      return false;
+    });
+    return result;
+  }
+
+  void allocate(size_t capacity) {
+    m_ctrl = new ctrl_t[capacity];
+    memset(m_ctrl, kEmpty, capacity);
+    m_slots.reset(new Storage[capacity]);
+    m_capacity = capacity;
+    m_size = 0;
+    m_growth_left = max_load(capacity);
+  }
+
+  void resize(size_t capacity) {
+    auto old_ctrl = m_ctrl;
+    auto old_slots = std::move(m_slots);
+    auto old_values = reinterpret_cast<Value*>(old_slots.get());
+    auto old_capacity = m_capacity;
+    allocate(capacity);
+    for (size_t i = 0; i < old_capacity; ++i) {
+      if (!is_full(old_ctrl[i])) {
+        continue;
+      }
+      auto& value = old_values[i];
+      auto hash = mix(Hash()(KeyOf()(value)));
+      auto j = find_first_non_full(hash);
+      new (&storage()[j]) Value(std::move(value));
+      value.~Value();
+      m_ctrl[j] = h2(hash);
+      ++m_size;
+      --m_growth_left;
+    }
+    delete[] old_ctrl;
+  }
+
+  void copy_from(const FlatHashTable& other) {
+    if (other.m_capacity == 0) {
+      return;
+    }
+    allocate(other.m_capacity);
+    for (size_t i = 0; i < m_capacity; ++i) {
+      if (is_full(other.m_ctrl[i])) {
+        new (&storage()[i]) Value(other.slots()[i]);
+      }
+    }
+    memcpy(m_ctrl, other.m_ctrl, m_capacity);
+    m_size = other.m_size;
+    m_growth_left = other.m_growth_left;
+  }
+
+  void destroy() {
+    clear();
+    delete[] m_ctrl;
+    m_ctrl = nullptr;
+    m_slots.reset();
+    m_capacity = 0;
+    m_growth_left = 0;
+  }
+
+  ctrl_t* m_ctrl{nullptr};
+  std::unique_ptr<Storage[]> m_slots;
+  // Zero, or a power of two that is at least kGroupWidth.
+  size_t m_capacity{0};
+  size_t m_size{0};
+  // The number of empty slots that may still be filled before growing.
+  size_t m_growth_left{0};
+};
+
+struct FirstOfPair {
+  template <typename Pair>
+  const typename Pair::first_type& operator()(const Pair& p) const {
+    return p.first;
+  }
+};
+
+struct IdentityOf {
+  template <typename T>
+  const T& operator()(const T& t) const {
+    return t;
+  }
+};
+
+} // namespace flat_hash_impl
+
+template <typename Key,
+          typename Value,
+          typename Hash = std::hash<Key>,
+          typename Equal = std::equal_to<Key>>
+class FlatHashMap final
+    : public flat_hash_impl::FlatHashTable<std::pair<const Key, Value>,
+                                           Key,
+                                           flat_hash_impl::FirstOfPair,
+                                           Hash,
+                                           Equal> {
+  using Base = flat_hash_impl::FlatHashTable<std::pair<const Key, Value>,
+                                             Key,
+                                             flat_hash_impl::FirstOfPair,
+                                             Hash,
+                                             Equal>;
+
+ public:
+  using mapped_type = Value;
+  using Base::emplace;
+  using Base::insert;
+
+  template <typename K, typename V>
+  std::pair<typename Base::iterator, bool> insert(std::pair<K, V>&& entry) {
+    return this->emplace_with(entry.first, [&](void* p) {
+      new (p) std::pair<const Key, Value>(std::move(entry));
+    });
+  }
+
+  template <typename K, typename V>
+  std::pair<typename Base::iterator, bool> emplace(K&& key, V&& value) {
+    return this->emplace_with(key, [&](void* p) {
+      new (p) std::pair<const Key, Value>(std::forward<K>(key),
+                                          std::forward<V>(value));
+    });
+  }
+
+  Value& operator[](const Key& key) {
+    return this
+        ->emplace_with(key,
+                       [&](void* p) {
+                         new (p) std::pair<const Key, Value>(
+                             std::piecewise_construct,
+                             std::forward_as_tuple(key),
+                             std::forward_as_tuple());
+                       })
+        .first->second;
+  }
+
+  Value& at(const Key& key) {
+    auto it = this->find(key);
+    if (it == this->end()) {
+      throw std::out_of_range("FlatHashMap::at");
+    }
+    return it->second;
+  }
+
+  const Value& at(const Key& key) const {
+    auto it = this->find(key);
+    if (it == this->end()) {
+      throw std::out_of_range("FlatHashMap::at");
+    }
+    return it->second;
+  }
+};
+
+template <typename Key,
+          typename Hash = std::hash<Key>,
+          typename Equal = std::equal_to<Key>>
+using FlatHashSet = flat_hash_impl::
+    FlatHashTable<Key, Key, flat_hash_impl::IdentityOf, Hash, Equal>;
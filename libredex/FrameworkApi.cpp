@@ -7,11 +7,189 @@
 
 #include "FrameworkApi.h"
 
+#include <atomic>
 #include <boost/algorithm/string.hpp>
 #include <fstream>
+#include <iostream>
+#include <unordered_set>
+
+#include "RedexMappedFile.h"
+#include "locator_hash.h"
 
 namespace api {
 
+namespace {
+
+/*
+ * Packed file format, in host byte order:
+ *
+ *   PackedHeader header
+ *   PackedClass classes[num_classes]
+ *   PackedMember members[num_members], the methods and then the fields of
+ *     each class
+ *   char strings[strings_size], NUL-terminated, padded to a multiple of 8
+ *   uint8_t index[index_size], a LocatorHashTable from class descriptors to
+ *     class numbers, which are stored as the clsnr of the locators
+ */
+constexpr uint32_t PACKED_MAGIC = 0x31504146; // "FAP1"
+
+struct PackedHeader {
+  uint32_t magic;
+  uint32_t num_classes;
+  uint32_t num_members;
+  uint32_t strings_size;
+  uint32_t index_size;
+  uint32_t reserved[3];
+};
+
+struct PackedClass {
+  uint32_t name;
+  uint32_t super_name;
+  uint32_t access_flags;
+  uint32_t first_member;
+  uint32_t num_methods;
+  uint32_t num_fields;
+};
+
+struct PackedMember {
+  uint32_t name;
+  uint32_t access_flags;
+};
+
+struct TextClass {
+  std::string name;
+  std::string super_name;
+  uint32_t access_flags;
+  std::vector<std::pair<std::string, uint32_t>> methods;
+  std::vector<std::pair<std::string, uint32_t>> fields;
+};
+
+// Reads the next class of the text format of load_framework_classes.
+// Returns false at the end of the file.
+bool read_text_class(std::istream& infile, TextClass& cls) {
+  uint32_t num_methods;
+  uint32_t num_fields;
+  if (!(infile >> cls.name >> cls.access_flags >> cls.super_name >>
+        num_methods >> num_fields)) {
+    return false;
+  }
+
+  cls.methods.clear();
+  while (num_methods-- > 0) {
+    std::string method_str;
+    std::string tag;
+    uint32_t m_access_flags;
+
+    infile >> tag >> method_str >> m_access_flags;
+
+    always_assert(tag == "M");
+    cls.methods.emplace_back(std::move(method_str), m_access_flags);
+  }
+
+  cls.fields.clear();
+  while (num_fields-- > 0) {
+    std::string field_str;
+    std::string tag;
+    uint32_t f_access_flags;
+
+    infile >> tag >> field_str >> f_access_flags;
+
+    always_assert(tag == "F");
+    cls.fields.emplace_back(std::move(field_str), f_access_flags);
+  }
+  return true;
+}
+
+} // namespace
+
+struct AndroidSDK::PackedFile {
+  explicit PackedFile(RedexMappedFile file) : mapped_file(std::move(file)) {}
+
+  RedexMappedFile mapped_file;
+  PackedHeader header;
+  const PackedClass* classes;
+  const PackedMember* members;
+  const char* strings;
+  facebook::LocatorHashTable index;
+  // The FrameworkAPIs of the classes that were looked up, which point into
+  // m_framework_classes. They are only set with m_packed_mutex held, but are
+  // read without it, so that looking up a class that was already loaded
+  // doesn't contend on the mutex.
+  std::unique_ptr<std::atomic<const FrameworkAPI*>[]> loaded;
+  bool all_loaded{false};
+
+  const char* get_string(uint32_t offset) const {
+    always_assert_log(offset < header.strings_size, "bad string offset %u",
+                      offset);
+    return strings + offset;
+  }
+
+  bool find(const DexType* type, uint32_t* class_index) const {
+    auto locator = index.find(type->c_str());
+    if (locator.dexnr == 0 || locator.clsnr >= header.num_classes ||
+        strcmp(get_string(classes[locator.clsnr].name), type->c_str()) != 0) {
+      return false;
+    }
+    *class_index = locator.clsnr;
+    return true;
+  }
+};
+
+AndroidSDK::AndroidSDK(boost::optional<std::string> sdk_api_file) {
+  if (sdk_api_file) {
+    m_sdk_api_file = *sdk_api_file;
+    if (is_packed_file(m_sdk_api_file)) {
+      load_packed_file();
+    } else {
+      load_framework_classes();
+    }
+  } else {
+    // For missing api file, we initialize to an empty SDK.
+    m_sdk_api_file = "";
+  }
+}
+
+AndroidSDK::~AndroidSDK() = default;
+
+const std::unordered_map<const DexType*, FrameworkAPI>&
+AndroidSDK::get_framework_classes() const {
+  if (m_packed) {
+    std::lock_guard<std::mutex> lock(m_packed_mutex);
+    if (!m_packed->all_loaded) {
+      for (uint32_t i = 0; i < m_packed->header.num_classes; ++i) {
+        load_packed_class(i);
+      }
+      m_packed->all_loaded = true;
+    }
+  }
+  return m_framework_classes;
+}
+
+bool AndroidSDK::has_type(const DexType* type) const {
+  if (!m_packed) {
+    return m_framework_classes.count(type);
+  }
+  uint32_t class_index;
+  return m_packed->find(type, &class_index);
+}
+
+const FrameworkAPI* AndroidSDK::find_class(const DexType* type) const {
+  if (!m_packed) {
+    const auto& it = m_framework_classes.find(type);
+    return it == m_framework_classes.end() ? nullptr : &it->second;
+  }
+  uint32_t class_index;
+  if (!m_packed->find(type, &class_index)) {
+    return nullptr;
+  }
+  if (auto api =
+          m_packed->loaded[class_index].load(std::memory_order_acquire)) {
+    return api;
+  }
+  std::lock_guard<std::mutex> lock(m_packed_mutex);
+  return &load_packed_class(class_index);
+}
+
 bool FrameworkAPI::has_method(const std::string& simple_deobfuscated_name,
                               DexProto* meth_proto,
                               DexAccessFlags meth_access_flags,
@@ -93,46 +271,24 @@ void AndroidSDK::load_framework_classes() {
   assert_log(infile, "Failed to open framework api file: %s\n",
              m_sdk_api_file.c_str());
 
-  std::string framework_cls_str;
-  std::string super_cls_str;
-  std::string class_name;
-  uint32_t num_methods;
-  uint32_t num_fields;
-  uint32_t access_flags;
-
-  while (infile >> framework_cls_str >> access_flags >> super_cls_str >>
-         num_methods >> num_fields) {
+  TextClass cls;
+  while (read_text_class(infile, cls)) {
     FrameworkAPI framework_api;
-    framework_api.cls = DexType::make_type(framework_cls_str.c_str());
+    framework_api.cls = DexType::make_type(cls.name.c_str());
     always_assert_log(m_framework_classes.count(framework_api.cls) == 0,
                       "Duplicated class name!");
-    framework_api.super_cls = DexType::make_type(super_cls_str.c_str());
-    framework_api.access_flags = DexAccessFlags(access_flags);
-
-    while (num_methods-- > 0) {
-      std::string method_str;
-      std::string tag;
-      uint32_t m_access_flags;
-
-      infile >> tag >> method_str >> m_access_flags;
+    framework_api.super_cls = DexType::make_type(cls.super_name.c_str());
+    framework_api.access_flags = DexAccessFlags(cls.access_flags);
 
-      always_assert(tag == "M");
-      DexMethodRef* mref = DexMethod::make_method(method_str);
+    for (const auto& method : cls.methods) {
+      DexMethodRef* mref = DexMethod::make_method(method.first);
       framework_api.mrefs_info.emplace_back(mref,
-                                            DexAccessFlags(m_access_flags));
+                                            DexAccessFlags(method.second));
     }
 
-    while (num_fields-- > 0) {
-      std::string field_str;
-      std::string tag;
-      uint32_t f_access_flags;
-
-      infile >> tag >> field_str >> f_access_flags;
-
-      always_assert(tag == "F");
-      DexFieldRef* fref = DexField::make_field(field_str);
-      framework_api.frefs_info.emplace_back(fref,
-                                            DexAccessFlags(f_access_flags));
+    for (const auto& field : cls.fields) {
+      DexFieldRef* fref = DexField::make_field(field.first);
+      framework_api.frefs_info.emplace_back(fref, DexAccessFlags(field.second));
     }
 
     auto& map_entry = m_framework_classes[framework_api.cls];
@@ -140,4 +296,162 @@ void AndroidSDK::load_framework_classes() {
   }
 }
 
+bool AndroidSDK::is_packed_file(const std::string& sdk_api_file) {
+  std::ifstream ifs(sdk_api_file, std::ios::binary);
+  uint32_t magic = 0;
+  ifs.read((char*)&magic, sizeof(magic));
+  return ifs.good() && magic == PACKED_MAGIC;
+}
+
+void AndroidSDK::load_packed_file() {
+  auto mapped_file = RedexMappedFile::open(m_sdk_api_file);
+  const char* data = mapped_file.const_data();
+  PackedHeader header;
+  always_assert_log(mapped_file.size() >= sizeof(header),
+                    "Truncated framework api file: %s\n",
+                    m_sdk_api_file.c_str());
+  memcpy(&header, data, sizeof(header));
+  const uint64_t strings_offset =
+      sizeof(header) + (uint64_t)header.num_classes * sizeof(PackedClass) +
+      (uint64_t)header.num_members * sizeof(PackedMember);
+  const uint64_t index_offset = strings_offset + header.strings_size;
+  always_assert_log(index_offset + header.index_size == mapped_file.size() &&
+                        header.strings_size > 0 &&
+                        data[index_offset - 1] == '\0',
+                    "Corrupt framework api file: %s\n",
+                    m_sdk_api_file.c_str());
+
+  m_packed = std::make_unique<PackedFile>(std::move(mapped_file));
+  m_packed->header = header;
+  m_packed->classes = (const PackedClass*)(data + sizeof(header));
+  m_packed->members =
+      (const PackedMember*)(m_packed->classes + header.num_classes);
+  m_packed->strings = data + strings_offset;
+  always_assert_log(
+      m_packed->index.init(data + index_offset, header.index_size),
+      "Corrupt framework api file index: %s\n", m_sdk_api_file.c_str());
+  m_packed->loaded =
+      std::make_unique<std::atomic<const FrameworkAPI*>[]>(header.num_classes);
+  for (uint32_t i = 0; i < header.num_classes; ++i) {
+    m_packed->loaded[i].store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+const FrameworkAPI& AndroidSDK::load_packed_class(uint32_t index) const {
+  auto& loaded = m_packed->loaded[index];
+  if (auto api = loaded.load(std::memory_order_relaxed)) {
+    return *api;
+  }
+
+  const auto& packed_cls = m_packed->classes[index];
+  always_assert_log((uint64_t)packed_cls.first_member + packed_cls.num_methods +
+                            packed_cls.num_fields <=
+                        m_packed->header.num_members,
+                    "Corrupt framework api file: %s\n",
+                    m_sdk_api_file.c_str());
+  FrameworkAPI framework_api;
+  framework_api.cls =
+      DexType::make_type(m_packed->get_string(packed_cls.name));
+  framework_api.super_cls =
+      DexType::make_type(m_packed->get_string(packed_cls.super_name));
+  framework_api.access_flags = DexAccessFlags(packed_cls.access_flags);
+
+  const auto* member = m_packed->members + packed_cls.first_member;
+  for (uint32_t i = 0; i < packed_cls.num_methods; ++i, ++member) {
+    DexMethodRef* mref =
+        DexMethod::make_method(m_packed->get_string(member->name));
+    framework_api.mrefs_info.emplace_back(
+        mref, DexAccessFlags(member->access_flags));
+  }
+  for (uint32_t i = 0; i < packed_cls.num_fields; ++i, ++member) {
+    DexFieldRef* fref =
+        DexField::make_field(m_packed->get_string(member->name));
+    framework_api.frefs_info.emplace_back(
+        fref, DexAccessFlags(member->access_flags));
+  }
+
+  auto& map_entry = m_framework_classes[framework_api.cls];
+  map_entry = std::move(framework_api);
+  loaded.store(&map_entry, std::memory_order_release);
+  return map_entry;
+}
+
+bool AndroidSDK::write_packed_file(const std::string& sdk_api_file,
+                                   const std::string& packed_file) {
+  std::ifstream infile(sdk_api_file.c_str());
+  if (!infile) {
+    std::cerr << "Failed to open framework api file: " << sdk_api_file
+              << std::endl;
+    return false;
+  }
+
+  std::vector<PackedClass> classes;
+  std::vector<PackedMember> members;
+  std::string strings;
+  std::unordered_map<std::string, uint32_t> string_offsets;
+  auto add_string = [&](const std::string& str) {
+    auto it = string_offsets.find(str);
+    if (it != string_offsets.end()) {
+      return it->second;
+    }
+    uint32_t offset = strings.size();
+    strings.append(str);
+    strings.push_back('\0');
+    string_offsets.emplace(str, offset);
+    return offset;
+  };
+  add_string("");
+
+  std::unordered_set<std::string> class_names;
+  TextClass cls;
+  while (read_text_class(infile, cls)) {
+    always_assert_log(class_names.insert(cls.name).second,
+                      "Duplicated class name!");
+    PackedClass packed_cls;
+    packed_cls.name = add_string(cls.name);
+    packed_cls.super_name = add_string(cls.super_name);
+    packed_cls.access_flags = cls.access_flags;
+    packed_cls.first_member = members.size();
+    packed_cls.num_methods = cls.methods.size();
+    packed_cls.num_fields = cls.fields.size();
+    for (const auto& method : cls.methods) {
+      members.push_back(PackedMember{add_string(method.first), method.second});
+    }
+    for (const auto& field : cls.fields) {
+      members.push_back(PackedMember{add_string(field.first), field.second});
+    }
+    classes.push_back(packed_cls);
+  }
+  strings.resize((strings.size() + 7) & ~size_t(7), '\0');
+
+  std::vector<std::pair<const char*, facebook::Locator>> entries;
+  entries.reserve(classes.size());
+  for (uint32_t i = 0; i < classes.size(); ++i) {
+    entries.emplace_back(strings.data() + classes[i].name,
+                         facebook::Locator(0, 1, i));
+  }
+  auto index = facebook::LocatorHashTable::build(entries);
+
+  PackedHeader header{PACKED_MAGIC,
+                      (uint32_t)classes.size(),
+                      (uint32_t)members.size(),
+                      (uint32_t)strings.size(),
+                      (uint32_t)index.size(),
+                      {0, 0, 0}};
+  std::ofstream out(packed_file, std::ios::binary | std::ios::trunc);
+  out.write((const char*)&header, sizeof(header));
+  out.write((const char*)classes.data(), classes.size() * sizeof(PackedClass));
+  out.write((const char*)members.data(),
+            members.size() * sizeof(PackedMember));
+  out.write(strings.data(), strings.size());
+  out.write((const char*)index.data(), index.size());
+  out.close();
+  if (!out) {
+    std::cerr << "Failed to write packed framework api file: " << packed_file
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
 } // namespace api
@@ -7,6 +7,9 @@
 
 #pragma once
 
+#include <memory>
+#include <mutex>
+
 #include "DexClass.h"
 
 namespace api {
@@ -44,58 +47,67 @@ struct FrameworkAPI {
                  bool relax_access_flags_matching = false) const;
 };
 
+/*
+ * The api file is either in the text format of load_framework_classes, or in
+ * the packed format that write_packed_file converts it to. A packed file is
+ * mapped, and its classes are only turned into FrameworkAPIs when they are
+ * first looked up, so that loading it is instant.
+ */
 class AndroidSDK {
  public:
-  explicit AndroidSDK(boost::optional<std::string> sdk_api_file) {
-    if (sdk_api_file) {
-      m_sdk_api_file = *sdk_api_file;
-      load_framework_classes();
-    } else {
-      // For missing api file, we initialize to an empty SDK.
-      m_sdk_api_file = "";
-    }
-  }
+  explicit AndroidSDK(boost::optional<std::string> sdk_api_file);
+  ~AndroidSDK();
 
+  // For packed files, this parses all the classes that were not looked up
+  // yet.
   const std::unordered_map<const DexType*, FrameworkAPI>&
-  get_framework_classes() const {
-    return m_framework_classes;
-  }
+  get_framework_classes() const;
 
   bool has_method(const DexMethod* meth) const {
-    auto type = meth->get_class();
-    const auto& it = m_framework_classes.find(type);
-    if (it == m_framework_classes.end()) {
+    const auto* api = find_class(meth->get_class());
+    if (api == nullptr) {
       return false;
     }
 
-    const auto& api = it->second;
-    return api.has_method(meth->get_simple_deobfuscated_name(),
-                          meth->get_proto(), meth->get_access(),
-                          /* relax_access_flags_matching */ true);
+    return api->has_method(meth->get_simple_deobfuscated_name(),
+                           meth->get_proto(), meth->get_access(),
+                           /* relax_access_flags_matching */ true);
   }
 
   bool has_field(const DexField* field) const {
-    auto type = field->get_class();
-    const auto& it = m_framework_classes.find(type);
-    if (it == m_framework_classes.end()) {
+    const auto* api = find_class(field->get_class());
+    if (api == nullptr) {
       return false;
     }
 
-    const auto& api = it->second;
-    return api.has_field(field->get_simple_deobfuscated_name(),
-                         field->get_access(),
-                         /* relax_access_flags_matching */ true);
+    return api->has_field(field->get_simple_deobfuscated_name(),
+                          field->get_access(),
+                          /* relax_access_flags_matching */ true);
   }
 
-  bool has_type(const DexType* type) const {
-    return m_framework_classes.count(type);
-  }
+  bool has_type(const DexType* type) const;
+
+  static bool is_packed_file(const std::string& sdk_api_file);
+
+  // Converts an api file in the text format to the packed format. Returns
+  // false, after printing why, if either file cannot be accessed.
+  static bool write_packed_file(const std::string& sdk_api_file,
+                                const std::string& packed_file);
 
  private:
+  struct PackedFile;
+
   void load_framework_classes();
+  void load_packed_file();
+  const FrameworkAPI* find_class(const DexType* type) const;
+  // Must be called with m_packed_mutex held.
+  const FrameworkAPI& load_packed_class(uint32_t index) const;
 
   std::string m_sdk_api_file;
-  std::unordered_map<const DexType*, FrameworkAPI> m_framework_classes;
+  mutable std::unordered_map<const DexType*, FrameworkAPI>
+      m_framework_classes;
+  std::unique_ptr<PackedFile> m_packed;
+  mutable std::mutex m_packed_mutex;
 };
 
 } // namespace api
@@ -7,19 +7,27 @@
 
 #pragma once
 
-#include <unordered_set>
+#include <algorithm>
+#include <array>
+#include <cstddef>
 
 #include "WellKnownTypes.h"
 
 class DexType;
 class DexFieldRef;
 
-#define STORE_TYPE(func_name, _)         \
- private:                                \
-  DexType* m_type_##func_name = nullptr; \
-                                         \
- public:                                 \
-  DexType* type_##func_name() const { return m_type_##func_name; }
+// Index of each well known type in the table of FrequentlyUsedPointers.
+enum class WellKnownType : size_t {
+#define FOR_EACH(func_name, _) func_name,
+  WELL_KNOWN_TYPES
+#undef FOR_EACH
+  kCount
+};
+
+#define STORE_TYPE(func_name, _)                     \
+  DexType* type_##func_name() const {                \
+    return m_types[(size_t)WellKnownType::func_name]; \
+  }
 
 #define STORE_FIELDREF(func_name, _)          \
  private:                                     \
@@ -30,6 +38,10 @@ class DexFieldRef;
 
 // The class is designed to cache frequently used pointers while invalidate them
 // when RedexContext lifetime is over.
+//
+// The well known types live in a single array, so that looking one up is a
+// load at a constant offset, and checking whether a type is well known scans
+// a few contiguous pointers.
 class FrequentlyUsedPointers {
  public:
   void load();
@@ -42,7 +54,12 @@ class FrequentlyUsedPointers {
   PRIMITIVE_PSEUDO_TYPE_FIELDS
 #undef FOR_EACH
 
-  std::unordered_set<const DexType*> m_well_known_types;
+  bool is_well_known_type(const DexType* type) const {
+    return std::find(m_types.begin(), m_types.end(), type) != m_types.end();
+  }
+
+ private:
+  std::array<DexType*, (size_t)WellKnownType::kCount> m_types{};
 };
 
 #undef STORE_TYPE
@@ -42,6 +42,9 @@ void InlinerConfig::bind_config() {
 void OptDecisionsConfig::bind_config() {
   bind("enable_logs", false, enable_logs,
        "Should we log Redex's optimization decisions?");
+  bind("sample_rate", 1u, sample_rate,
+       "Only log the decisions about roughly one in this many classes and "
+       "methods, to bound the overhead of logging.");
 }
 
 void IRTypeCheckerConfig::bind_config() {
@@ -50,6 +53,9 @@ void IRTypeCheckerConfig::bind_config() {
   bind("run_after_passes", {}, run_after_passes);
   bind("check_no_overwrite_this", {}, check_no_overwrite_this);
   bind("check_num_of_refs", {}, check_num_of_refs);
+  bind("run_incrementally", true, run_incrementally,
+       "Only check the methods that changed since they were last checked "
+       "after a pass, unless the class hierarchy or any signatures changed.");
 }
 
 void HasherConfig::bind_config() {
@@ -97,6 +103,9 @@ void GlobalConfig::bind_config() {
   bind("default_coldstart_classes", "", string_param);
   bind("emit_class_method_info_map", false, bool_param);
   bind("emit_locator_strings", {}, bool_param);
+  bind("emit_locator_hash_table", false, bool_param,
+       "With emit_locator_strings, also write assets/locator-hash.bin, a "
+       "perfect hash table from class names to locators");
   bind("iodi_layer_mode", "full", string_param,
        "IODI layer mode. One of \"full\", \"skip-layer-0-at-api-26\" or "
        "\"always-skip-layer-0\"");
@@ -112,7 +121,13 @@ void GlobalConfig::bind_config() {
   bind("legacy_reflection_reachability", false, bool_param);
   bind("lower_with_cfg", {}, bool_param);
   bind("method_sorting_allowlisted_substrings", {}, string_vector_param);
+  bind("mmap_dex_output", false, bool_param,
+       "Emit dexes straight into memory-mapped output files instead of "
+       "heap buffers.");
   bind("no_optimizations_annotations", {}, string_vector_param);
+  bind("parallel_dex_writing", true, bool_param,
+       "Write all dexes concurrently. The output is the same as when writing "
+       "them one at a time.");
   // TODO: Remove unused profiled_methods_file option and all build system
   // references
   bind("profiled_methods_file", "", string_param);
@@ -125,6 +140,11 @@ void GlobalConfig::bind_config() {
   bind("string_sort_mode", "", string_param);
   bind("write_cfg_each_pass", false, bool_param);
   bind("dump_cfg_classes", "", string_param);
+  bind("dump_cfg_methods", "", string_param,
+       "Dump the CFGs of these ','-separated methods, but not of the other "
+       "methods of their classes.");
+  bind("dump_cfg_compressed", false, bool_param,
+       "Write the CFG dumps gzip-compressed.");
   bind("slow_invariants_debug", false, bool_param);
   // Enabled for ease of testing, apps expected to opt-out
   bind("enable_bleeding_edge_app_bundle_support", true, bool_param);
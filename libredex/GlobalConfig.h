@@ -36,6 +36,7 @@ struct IRTypeCheckerConfig : public Configurable {
   bool check_num_of_refs;
   std::unordered_set<std::string> run_after_passes;
   bool check_no_overwrite_this;
+  bool run_incrementally;
 };
 
 struct HasherConfig : public Configurable {
@@ -91,6 +92,7 @@ struct OptDecisionsConfig : public Configurable {
   }
 
   bool enable_logs;
+  uint32_t sample_rate;
 };
 
 class GlobalConfig;
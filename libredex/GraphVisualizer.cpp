@@ -9,6 +9,9 @@
 
 #include <fstream>
 #include <iostream>
+#include <numeric>
+#include <unordered_map>
+#include <zlib.h>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/range/adaptors.hpp>
@@ -18,6 +21,7 @@
 #include "DexPosition.h"
 #include "IRCode.h"
 #include "Show.h"
+#include "WorkQueue.h"
 
 // The "Hotspot Client Compiler Visualizer" (c1visualizer) is a tool consuming
 // Hotspot C1 compiler debug info to display control flow graphs of compilation
@@ -617,7 +621,9 @@ std::vector<DexMethod*> get_all_methods(DexClass* klass) {
 // the CFG did not change.
 MethodCFGStream::MethodCFGStream(DexMethod* m) : m_method(m) {
   m_orig_name = vshow(m, false);
-  print_compilation_header(m_ss, m_orig_name, m_orig_name);
+  std::stringstream header;
+  print_compilation_header(header, m_orig_name, m_orig_name);
+  m_output = header.str();
 }
 
 void MethodCFGStream::add_pass(const std::string& pass_name,
@@ -658,13 +664,17 @@ void MethodCFGStream::add_pass(const std::string& pass_name,
     redex_assert(pos != std::string::npos);
     new_pass.replace(pos, strlen(FAKE_PASS_NAME), pass_name);
 
-    m_ss << new_pass;
+    m_output += new_pass;
   }
 }
 
-ClassCFGStream::ClassCFGStream(DexClass* klass) : m_class(klass) {
+ClassCFGStream::ClassCFGStream(DexClass* klass,
+                               std::unordered_set<const DexMethod*> methods)
+    : m_class(klass), m_filter(std::move(methods)) {
   for (auto* method : get_all_methods(klass)) {
-    m_methods.push_back(MethodState{method, MethodCFGStream(method), false});
+    if (is_tracked(method)) {
+      m_methods.push_back(MethodState{method, MethodCFGStream(method), false});
+    }
   }
 }
 
@@ -679,7 +689,9 @@ void ClassCFGStream::add_pass(const std::string& pass_name, Options o) {
     }
   }
   for (auto* method : all_methods) {
-    m_methods.push_back(MethodState{method, MethodCFGStream(method), false});
+    if (is_tracked(method)) {
+      m_methods.push_back(MethodState{method, MethodCFGStream(method), false});
+    }
   }
 
   for (auto& m : m_methods) {
@@ -691,8 +703,13 @@ void ClassCFGStream::add_pass(const std::string& pass_name, Options o) {
 }
 
 void ClassCFGStream::write(std::ostream& os) const {
+  write([&os](const std::string& output) { os << output; });
+}
+
+void ClassCFGStream::write(
+    const std::function<void(const std::string&)>& sink) const {
   for (auto& m : m_methods) {
-    os << m.stream.get_output();
+    sink(m.stream.get_output());
   }
 }
 
@@ -703,16 +720,59 @@ void Classes::add_all(const std::string& class_names) {
   std::vector<std::string> classes;
   boost::algorithm::split(classes, class_names,
                           [](char c) { return c == ';'; });
+  size_t begin = m_class_cfgs.size();
   for (const auto& c : classes) {
     if (c.empty()) {
       continue;
     }
     auto complete = c + ';';
-    if (!add(complete)) {
+    if (!add(complete, /* add_initial_pass */ false)) {
       std::cerr << "Did not find class " << complete;
       m_not_found.push_back(complete);
     }
   }
+  add_pass_from(begin, "Initial", SKIP_NO_CHANGE);
+}
+
+void Classes::add_methods(const std::string& method_names) {
+  if (method_names.empty()) {
+    return;
+  }
+  std::vector<std::string> names;
+  boost::algorithm::split(names, method_names,
+                          [](char c) { return c == ','; });
+  std::vector<DexClass*> classes;
+  std::unordered_map<DexClass*, std::unordered_set<const DexMethod*>>
+      class_methods;
+  for (auto& name : names) {
+    boost::algorithm::trim(name);
+    if (name.empty()) {
+      continue;
+    }
+    auto ref = DexMethod::get_method(name);
+    auto method = ref && ref->is_def() ? ref->as_def() : nullptr;
+    auto klass = method ? type_class(method->get_class()) : nullptr;
+    if (!klass) {
+      std::cerr << "Did not find method " << name << std::endl;
+      continue;
+    }
+    auto& methods = class_methods[klass];
+    if (methods.empty()) {
+      classes.push_back(klass);
+    }
+    methods.insert(method);
+  }
+  size_t begin = m_class_cfgs.size();
+  for (auto* klass : classes) {
+    auto it = std::find_if(
+        m_class_cfgs.begin(), m_class_cfgs.end(),
+        [klass](const ClassCFGStream& s) { return s.get_class() == klass; });
+    if (it == m_class_cfgs.end()) {
+      add(klass, /* add_initial_pass */ false,
+          std::move(class_methods.at(klass)));
+    }
+  }
+  add_pass_from(begin, "Initial", SKIP_NO_CHANGE);
 }
 
 bool Classes::add(const std::string& class_name, bool add_initial_pass) {
@@ -725,8 +785,10 @@ bool Classes::add(const std::string& class_name, bool add_initial_pass) {
   return true;
 }
 
-void Classes::add(DexClass* klass, bool add_initial_pass) {
-  m_class_cfgs.emplace_back(klass);
+void Classes::add(DexClass* klass,
+                  bool add_initial_pass,
+                  std::unordered_set<const DexMethod*> methods) {
+  m_class_cfgs.emplace_back(klass, std::move(methods));
   if (add_initial_pass) {
     m_class_cfgs.back().add_pass("Initial");
   }
@@ -749,19 +811,49 @@ void Classes::add_pass(const std::function<std::string()>& pass_name_lazy,
   if (m_class_cfgs.empty()) {
     return;
   }
-  std::string pass_name = pass_name_lazy();
-  for (auto& class_cfg : m_class_cfgs) {
-    class_cfg.add_pass(pass_name, o);
-  }
+  add_pass_from(0, pass_name_lazy(), o);
   if (m_write_after_each_pass) {
     write();
   }
 }
 
+void Classes::add_pass_from(size_t begin,
+                            const std::string& pass_name,
+                            Options o) {
+  if (begin >= m_class_cfgs.size()) {
+    return;
+  }
+  // Each class renders into its own buffers, and building a missing CFG only
+  // touches the code of that class's methods.
+  std::vector<size_t> indices(m_class_cfgs.size() - begin);
+  std::iota(indices.begin(), indices.end(), begin);
+  workqueue_run<size_t>(
+      [&](size_t i) { m_class_cfgs[i].add_pass(pass_name, o); }, indices);
+}
+
 void Classes::write() const {
   if (m_class_cfgs.empty()) {
     return;
   }
+  if (boost::algorithm::ends_with(m_file_name, ".gz")) {
+    // The dumps are large and mostly repetitive, so the fastest level already
+    // compresses them well.
+    gzFile file = gzopen(m_file_name.c_str(), "wb1");
+    always_assert_log(file != nullptr, "Could not open %s",
+                      m_file_name.c_str());
+    for (const auto& c : m_class_cfgs) {
+      c.write([&](const std::string& output) {
+        for (size_t pos = 0; pos < output.size();) {
+          unsigned len = std::min<size_t>(output.size() - pos, 1u << 30);
+          always_assert_log(gzwrite(file, output.data() + pos, len) == (int)len,
+                            "Could not write %s", m_file_name.c_str());
+          pos += len;
+        }
+      });
+    }
+    gzclose(file);
+    return;
+  }
   std::ofstream os(m_file_name);
   for (const auto& c : m_class_cfgs) {
     c.write(os);
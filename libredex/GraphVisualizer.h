@@ -10,6 +10,8 @@
 #include <functional>
 #include <iosfwd>
 #include <sstream>
+#include <string>
+#include <unordered_set>
 #include <vector>
 
 #include <boost/optional/optional.hpp>
@@ -57,18 +59,18 @@ class MethodCFGStream {
                 Options o = (Options)(SKIP_NO_CHANGE | PRINT_CODE),
                 const optional<std::string>& extra_prefix = boost::none);
 
-  std::string get_output() const { return m_ss.str(); }
+  const std::string& get_output() const { return m_output; }
 
  private:
   DexMethod* m_method;
   std::string m_orig_name;
   std::string m_last;
-  std::stringstream m_ss;
+  std::string m_output;
 };
 
 // A wrapper managing CFG streams of all methods in a class. Detects when
 // methods are added or removed (in which case a non-cfg pass will be
-// added).
+// added). If `methods` is not empty, only those methods are tracked.
 class ClassCFGStream {
  private:
   struct MethodState {
@@ -78,17 +80,28 @@ class ClassCFGStream {
   };
 
  public:
-  explicit ClassCFGStream(DexClass* klass);
+  explicit ClassCFGStream(DexClass* klass,
+                          std::unordered_set<const DexMethod*> methods = {});
 
   void add_pass(const std::string& pass_name, Options o = SKIP_NO_CHANGE);
 
   void write(std::ostream& os) const;
+  void write(const std::function<void(const std::string&)>& sink) const;
+
+  DexClass* get_class() const { return m_class; }
 
  private:
+  bool is_tracked(const DexMethod* method) const {
+    return m_filter.empty() || m_filter.count(method);
+  }
+
   DexClass* m_class;
+  std::unordered_set<const DexMethod*> m_filter;
   std::vector<MethodState> m_methods;
 };
 
+// The CFG streams of a set of classes, whose passes are rendered in parallel.
+// The output is gzip-compressed if the file name ends with ".gz".
 class Classes {
  public:
   explicit Classes(const std::string& file_name, bool write_after_arch_pass)
@@ -96,8 +109,14 @@ class Classes {
         m_write_after_each_pass(write_after_arch_pass) {}
 
   bool add(const std::string& class_name, bool add_initial_pass = true);
-  void add(DexClass* klass, bool add_initial_pass = true);
+  void add(DexClass* klass,
+           bool add_initial_pass = true,
+           std::unordered_set<const DexMethod*> methods = {});
+  // Adds the classes in a ';'-separated list of class names.
   void add_all(const std::string& class_names);
+  // Adds the methods in a ','-separated list of full method names, e.g.
+  // "LFoo;.bar:(I)V", and none of the other methods of their classes.
+  void add_methods(const std::string& method_names);
 
   void add_pass(const std::string& pass_name, Options o = SKIP_NO_CHANGE);
   void add_pass(const std::function<std::string()>& pass_name_lazy,
@@ -106,6 +125,9 @@ class Classes {
   void write() const;
 
  private:
+  // Adds a pass to the streams from index `begin` on.
+  void add_pass_from(size_t begin, const std::string& pass_name, Options o);
+
   std::vector<visualizer::ClassCFGStream> m_class_cfgs;
   std::vector<std::string> m_not_found;
   const std::string m_file_name;
@@ -8,12 +8,16 @@
 #include "IODIMetadata.h"
 
 #include <fstream>
+#include <numeric>
+#include <string_view>
 
+#include "ConcurrentContainers.h"
 #include "DexOutput.h"
 #include "DexUtil.h"
 #include "Show.h"
 #include "StlUtil.h"
 #include "Trace.h"
+#include "WorkQueue.h"
 
 namespace {
 // Returns com.foo.Bar. for the DexClass Lcom/foo/Bar;. Note the trailing
@@ -72,66 +76,85 @@ void IODIMetadata::mark_methods(DexStoresVector& scope) {
   // offsets in stack traces, then we cannot leverage proguard mappings anymore,
   // so we must disable IODI for any methods whose stack trace may be ambiguous.
   //
-  // We do this linearly for now because otherwise we need locks
-
-  std::unordered_map<std::string, DexMethod*> name_method_map;
-
-  std::unordered_map<std::string, const DexMethod*> name_map;
-  auto emplace_entry = [&](const std::string& str, DexMethod* m) {
-    {
-      const DexMethod* canonical;
-      auto it = name_map.find(str);
-      if (it == name_map.end()) {
-        canonical = m;
-        name_map.emplace(str, m);
-      } else {
-        canonical = m_canonical.at(it->second);
-      }
-      m_canonical[m] = canonical;
-      m_name_clusters[canonical].insert(m);
-    }
-
-    auto iter = name_method_map.find(str);
-    if (iter != name_method_map.end()) {
-      auto name_iter = m_method_to_name.find(iter->second);
-      if (name_iter != m_method_to_name.end()) {
-        m_method_to_name.erase(name_iter);
-      }
-      iter->second = nullptr;
-    } else {
-      name_method_map.emplace(str, m);
-      m_method_to_name.emplace(m, str);
-    }
-  };
+  // The names are computed and grouped in parallel. The first method with a
+  // name, in the order of the stores, is the canonical method of its cluster.
+  std::vector<DexClass*> classes;
+  std::vector<size_t> first_method_index;
+  std::vector<DexMethod*> methods;
   for (auto& store : scope) {
-    for (auto& classes : store.get_dexen()) {
-      for (auto& cls : classes) {
-        auto pretty_prefix = pretty_prefix_for_cls(cls);
-        // First we need to mark all entries...
+    for (auto& dex : store.get_dexen()) {
+      for (auto* cls : dex) {
+        classes.push_back(cls);
+        first_method_index.push_back(methods.size());
         for (DexMethod* m : cls->get_dmethods()) {
-          emplace_entry(pretty_prefix + m->str(), m);
+          methods.push_back(m);
         }
         for (DexMethod* m : cls->get_vmethods()) {
-          emplace_entry(pretty_prefix + m->str(), m);
+          methods.push_back(m);
         }
       }
     }
   }
 
+  struct NameGroup {
+    size_t first;
+    size_t size;
+  };
+  std::vector<std::string> names(methods.size());
+  ConcurrentMap<std::string_view, NameGroup> name_groups;
+  std::vector<size_t> class_indices(classes.size());
+  std::iota(class_indices.begin(), class_indices.end(), 0);
+  workqueue_run<size_t>(
+      [&](size_t i) {
+        auto pretty_prefix = pretty_prefix_for_cls(classes[i]);
+        auto end = i + 1 < classes.size() ? first_method_index[i + 1]
+                                          : methods.size();
+        for (auto j = first_method_index[i]; j < end; ++j) {
+          names[j] = pretty_prefix + methods[j]->str();
+          name_groups.update(names[j], [j](const std::string_view&,
+                                           NameGroup& group, bool exists) {
+            if (!exists) {
+              group = {j, 1};
+              return;
+            }
+            group.first = std::min(group.first, j);
+            ++group.size;
+          });
+        }
+      },
+      class_indices);
+
+  m_canonical.reserve(methods.size());
+  m_name_clusters.reserve(name_groups.size());
+  for (size_t j = 0; j < methods.size(); ++j) {
+    auto* m = methods[j];
+    const auto& group = name_groups.at_unsafe(names[j]);
+    const DexMethod* canonical = methods[group.first];
+    m_canonical[m] = canonical;
+    m_name_clusters[canonical].insert(m);
+    if (group.size == 1) {
+      // The group's key refers to this name, but is not looked up again.
+      m_method_to_name.emplace(m, std::move(names[j]));
+    }
+  }
+
   m_marked = true;
 }
 
 void IODIMetadata::set_iodi_layer(const DexMethod* method, size_t layer) {
-  m_iodi_method_layers.emplace(method,
-                               std::make_pair(get_iodi_name(method), layer));
+  auto name = get_iodi_name(method);
+  std::lock_guard<std::mutex> lock(m_iodi_method_layers_mutex);
+  m_iodi_method_layers.emplace(method, std::make_pair(std::move(name), layer));
 }
 
 size_t IODIMetadata::get_iodi_layer(const DexMethod* method) const {
+  std::lock_guard<std::mutex> lock(m_iodi_method_layers_mutex);
   auto it = m_iodi_method_layers.find(method);
   return it != m_iodi_method_layers.end() ? it->second.second : 0u;
 }
 
 bool IODIMetadata::has_iodi_layer(const DexMethod* method) const {
+  std::lock_guard<std::mutex> lock(m_iodi_method_layers_mutex);
   auto it = m_iodi_method_layers.find(method);
   return it != m_iodi_method_layers.end();
 }
@@ -140,6 +163,74 @@ void IODIMetadata::mark_method_huge(const DexMethod* method) {
   m_huge_methods.insert(method);
 }
 
+namespace {
+
+/*
+ * Binary file format
+ * {
+ *  magic: uint32_t = 0xfaceb001
+ *  version: uint32_t = 1
+ *  count: uint32_t
+ *  zero: uint32_t = 0
+ *  single_entries: entry_t[count]
+ * }
+ * where
+ * entry_t = {
+ *  klen: uint16_t
+ *  method_id: uint64_t
+ *  key: char[klen]
+ * }
+ */
+struct __attribute__((__packed__)) Header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t count;
+  uint32_t zero;
+};
+
+struct __attribute__((__packed__)) EntryHeader {
+  uint16_t klen;
+  uint64_t method_id;
+};
+
+void append_entry(const std::string& name,
+                  size_t layer,
+                  uint64_t method_id,
+                  std::string& out) {
+  redex_assert(layer < DexOutput::kIODILayerBound);
+
+  std::string tmp;
+  const std::string& layered_name =
+      IODIMetadata::get_layered_name(name, layer, tmp);
+
+  always_assert(layered_name.size() < UINT16_MAX);
+  EntryHeader entry_hdr;
+  entry_hdr.klen = layered_name.size();
+  entry_hdr.method_id = method_id;
+  out.append((const char*)&entry_hdr, sizeof(EntryHeader));
+  out.append(layered_name);
+}
+
+} // namespace
+
+void IODIMetadata::emit_entries(const std::vector<const DexMethod*>& methods,
+                                const MethodToIdMap& method_to_id) {
+  std::lock_guard<std::mutex> lock(m_iodi_method_layers_mutex);
+  for (auto* method : methods) {
+    auto it = m_iodi_method_layers.find(method);
+    if (it == m_iodi_method_layers.end() ||
+        !m_emitted_methods.insert(method).second) {
+      continue;
+    }
+    m_emitted_count += 1;
+    always_assert_log(m_emitted_count != 0,
+                      "Too many entries found, overflowed");
+    append_entry(it->second.first, it->second.second,
+                 method_to_id.at(const_cast<DexMethod*>(method)),
+                 m_emitted_entries);
+  }
+}
+
 void IODIMetadata::write(
     const std::string& iodi_metadata_filename,
     const std::unordered_map<DexMethod*, uint64_t>& method_to_id) {
@@ -154,28 +245,7 @@ void IODIMetadata::write(
 void IODIMetadata::write(
     std::ostream& ofs,
     const std::unordered_map<DexMethod*, uint64_t>& method_to_id) {
-  /*
-   * Binary file format
-   * {
-   *  magic: uint32_t = 0xfaceb001
-   *  version: uint32_t = 1
-   *  count: uint32_t
-   *  zero: uint32_t = 0
-   *  single_entries: entry_t[count]
-   * }
-   * where
-   * entry_t = {
-   *  klen: uint16_t
-   *  method_id: uint64_t
-   *  key: char[klen]
-   * }
-   */
-  struct __attribute__((__packed__)) Header {
-    uint32_t magic;
-    uint32_t version;
-    uint32_t count;
-    uint32_t zero;
-  } header = {
+  Header header = {
       .magic = 0xfaceb001,
       .version = 1,
       .count = 0,
@@ -183,32 +253,26 @@ void IODIMetadata::write(
   };
   ofs.write((const char*)&header, sizeof(Header));
 
-  struct __attribute__((__packed__)) EntryHeader {
-    uint16_t klen;
-    uint64_t method_id;
-  } entry_hdr;
-
-  uint32_t count = 0;
+  // The entries emitted as the dexes were written come first, then those of
+  // any methods that got a layer without being emitted.
+  ofs.write(m_emitted_entries.data(), m_emitted_entries.size());
+  uint32_t count = m_emitted_count;
   size_t max_layer{0};
   size_t layered_count{0};
 
+  std::string entry;
   for (const auto& p : m_iodi_method_layers) {
+    auto* method = p.first;
+    if (m_emitted_methods.count(method)) {
+      continue;
+    }
     count += 1;
     always_assert_log(count != 0, "Too many entries found, overflowed");
 
-    auto* method = p.first;
-    const auto& name = p.second.first;
-    auto layer = p.second.second;
-    redex_assert(layer < DexOutput::kIODILayerBound);
-
-    std::string tmp;
-    const std::string& layered_name = get_layered_name(name, layer, tmp);
-
-    always_assert(layered_name.size() < UINT16_MAX);
-    entry_hdr.klen = layered_name.size();
-    entry_hdr.method_id = method_to_id.at(const_cast<DexMethod*>(method));
-    ofs.write((const char*)&entry_hdr, sizeof(EntryHeader));
-    ofs << layered_name;
+    entry.clear();
+    append_entry(p.second.first, p.second.second,
+                 method_to_id.at(const_cast<DexMethod*>(method)), entry);
+    ofs.write(entry.data(), entry.size());
   }
   // Rewind and write the header now that we know single/dup counts
   ofs.seekp(0);
@@ -7,7 +7,11 @@
 
 #pragma once
 
+#include <mutex>
+#include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "DexClass.h"
 #include "DexStore.h"
@@ -56,6 +60,7 @@ class IODIMetadata {
 
   // This fills the internal map of stack trace name -> method. This must be
   // called after the last pass and before anything starts to get lowered.
+  // The methods are grouped by name in parallel.
   void mark_methods(DexStoresVector& scope);
 
   // This is called while lowering to dex to note that a method has been
@@ -66,8 +71,16 @@ class IODIMetadata {
     return m_huge_methods.count(m) != 0;
   }
 
-  // Write to disk, pretty usual. Does nothing if filename len is 0.
   using MethodToIdMap = std::unordered_map<DexMethod*, uint64_t>;
+
+  // Serializes the entries of those of the given methods that got an IODI
+  // layer. The dex writer calls this for the methods of each dex once their
+  // ids are known, so that write() only has to copy the entries out; they are
+  // written in the order of the calls.
+  void emit_entries(const std::vector<const DexMethod*>& methods,
+                    const MethodToIdMap& method_to_id);
+
+  // Write to disk, pretty usual. Does nothing if filename len is 0.
   void write(const std::string& iodi_metadata_filename,
              const MethodToIdMap& method_to_id);
 
@@ -94,6 +107,12 @@ class IODIMetadata {
     return m_name_clusters.at(get_canonical_method(m));
   }
 
+  // The number of methods with the same name as m, or 0 if m wasn't marked.
+  size_t get_cluster_size(const DexMethod* m) const {
+    auto it = m_canonical.find(m);
+    return it == m_canonical.end() ? 0 : m_name_clusters.at(it->second).size();
+  }
+
   void set_iodi_layer(const DexMethod* method, size_t layer);
   size_t get_iodi_layer(const DexMethod* method) const;
   bool has_iodi_layer(const DexMethod* method) const;
@@ -103,9 +122,16 @@ class IODIMetadata {
       m_name_clusters;
   std::unordered_map<const DexMethod*, const DexMethod*> m_canonical;
 
+  // Layers are set by the writer of one dex while the entries of another
+  // are emitted.
+  mutable std::mutex m_iodi_method_layers_mutex;
   std::unordered_map<const DexMethod*, std::pair<std::string, size_t>>
       m_iodi_method_layers;
 
+  std::string m_emitted_entries;
+  uint32_t m_emitted_count{0};
+  std::unordered_set<const DexMethod*> m_emitted_methods;
+
   // These exists for can_safely_use_iodi
   std::unordered_map<const DexMethod*, std::string> m_method_to_name;
   std::unordered_set<const DexMethod*> m_huge_methods;
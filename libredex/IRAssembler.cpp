@@ -9,12 +9,15 @@
 
 #include <boost/functional/hash.hpp>
 #include <boost/optional/optional.hpp>
+#include <numeric>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 
 #include "DexPosition.h"
 #include "Show.h"
+#include "WorkQueue.h"
 
 using namespace sparta;
 
@@ -913,19 +916,32 @@ std::unique_ptr<IRCode> ircode_from_s_expr(const s_expr& e) {
   return code;
 }
 
-std::unique_ptr<IRCode> ircode_from_string(const std::string& s) {
-  std::istringstream input(s);
-  s_expr_istream s_expr_input(input);
+namespace {
+
+// Returns the last S-expression of the input.
+s_expr parse_s_expr(std::string_view s) {
+  s_expr_reader reader(s);
   s_expr expr;
-  while (s_expr_input.good()) {
-    s_expr_input >> expr;
-    if (s_expr_input.eoi()) {
-      break;
-    }
-    always_assert_log(!s_expr_input.fail(), "%s\n",
-                      s_expr_input.what().c_str());
+  while (reader.read(&expr)) {
   }
-  return ircode_from_s_expr(expr);
+  always_assert_log(!reader.fail(), "%s\n", reader.what().c_str());
+  return expr;
+}
+
+} // namespace
+
+std::unique_ptr<IRCode> ircode_from_string(const std::string& s) {
+  return ircode_from_s_expr(parse_s_expr(s));
+}
+
+std::vector<std::unique_ptr<IRCode>> ircode_from_strings(
+    const std::vector<std::string>& strings) {
+  std::vector<std::unique_ptr<IRCode>> codes(strings.size());
+  std::vector<size_t> indices(strings.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  workqueue_run<size_t>(
+      [&](size_t i) { codes[i] = ircode_from_string(strings[i]); }, indices);
+  return codes;
 }
 
 #define AF(uc, lc, val) {ACC_##uc, #lc},
@@ -963,18 +979,28 @@ DexMethod* method_from_s_expr(const s_expr& e) {
 }
 
 DexMethod* method_from_string(const std::string& s) {
-  std::istringstream input(s);
-  s_expr_istream s_expr_input(input);
-  s_expr expr;
-  while (s_expr_input.good()) {
-    s_expr_input >> expr;
-    if (s_expr_input.eoi()) {
-      break;
-    }
-    always_assert_log(!s_expr_input.fail(), "%s\n",
-                      s_expr_input.what().c_str());
+  return method_from_s_expr(parse_s_expr(s));
+}
+
+std::vector<DexMethod*> methods_from_string(const std::string& s) {
+  // Splitting the input is cheap compared to building the S-expressions and
+  // the IR, which we do in parallel.
+  std::vector<std::string_view> texts;
+  s_expr_reader reader(s);
+  std::string_view text;
+  while (reader.skip(&text)) {
+    texts.push_back(text);
   }
-  return method_from_s_expr(expr);
+  always_assert_log(!reader.fail(), "%s\n", reader.what().c_str());
+  std::vector<DexMethod*> methods(texts.size());
+  std::vector<size_t> indices(texts.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  workqueue_run<size_t>(
+      [&](size_t i) {
+        methods[i] = method_from_s_expr(parse_s_expr(texts[i]));
+      },
+      indices);
+  return methods;
 }
 
 DexMethod* class_with_method(const std::string& class_name,
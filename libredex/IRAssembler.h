@@ -67,6 +67,17 @@ DexMethod* method_from_s_expr(const sparta::s_expr&);
 
 DexMethod* method_from_string(const std::string&);
 
+/*
+ * Bulk versions of the above, which parse their inputs in parallel. This makes
+ * reading the IR of a whole app practical, e.g. for round-trip tests.
+ */
+std::vector<std::unique_ptr<IRCode>> ircode_from_strings(
+    const std::vector<std::string>&);
+
+// Reads all the top-level method definitions of the input, in order. The
+// methods must have distinct names.
+std::vector<DexMethod*> methods_from_string(const std::string&);
+
 DexMethod* class_with_method(const std::string& class_name,
                              const std::string& method_instructions);
 
@@ -614,18 +614,46 @@ IRCode::IRCode(std::unique_ptr<cfg::ControlFlowGraph> cfg) {
 
 void IRCode::cleanup_debug() { m_ir_list->cleanup_debug(); }
 
+void IRCode::remove_redundant_positions() {
+  m_ir_list->remove_redundant_positions();
+}
+
+namespace {
+
+// Written by the PassManager between passes only, so no synchronization.
+bool s_persistent_editable_cfgs = false;
+
+} // namespace
+
+void IRCode::set_persistent_editable_cfgs(bool enabled) {
+  s_persistent_editable_cfgs = enabled;
+}
+
+bool IRCode::persistent_editable_cfgs() { return s_persistent_editable_cfgs; }
+
 void IRCode::build_cfg(bool editable) {
   always_assert_log(
       !editable || !m_cfg_serialized_with_custom_strategy,
       "Cannot build editable CFG after being serialized with custom strategy. "
       "Rebuilding CFG will cause problems with basic block ordering.");
-  clear_cfg();
+  if (editable && s_persistent_editable_cfgs && editable_cfg_built()) {
+    return;
+  }
+  release_cfg(nullptr);
   m_cfg = std::make_unique<cfg::ControlFlowGraph>(m_ir_list, m_registers_size,
                                                   editable);
 }
 
 void IRCode::clear_cfg(
     const std::unique_ptr<cfg::LinearizationStrategy>& custom_strategy) {
+  if (!custom_strategy && s_persistent_editable_cfgs && editable_cfg_built()) {
+    return;
+  }
+  release_cfg(custom_strategy);
+}
+
+void IRCode::release_cfg(
+    const std::unique_ptr<cfg::LinearizationStrategy>& custom_strategy) {
   if (!m_cfg) {
     return;
   }
@@ -40,6 +40,11 @@ class IRCode {
       const DexCatches& catches,
       std::vector<std::unique_ptr<DexTryItem>>* tries);
 
+  // Linearizes an editable CFG (if any) back into m_ir_list and destroys the
+  // CFG, regardless of `persistent_editable_cfgs()`.
+  void release_cfg(
+      const std::unique_ptr<cfg::LinearizationStrategy>& custom_strategy);
+
   IRList* m_ir_list;
   std::unique_ptr<cfg::ControlFlowGraph> m_cfg;
 
@@ -109,6 +114,8 @@ class IRCode {
 
   void cleanup_debug();
 
+  void remove_redundant_positions();
+
   reg_t get_registers_size() const { return m_registers_size; }
 
   void set_registers_size(reg_t sz) { m_registers_size = sz; }
@@ -168,6 +175,14 @@ class IRCode {
   bool cfg_built() const;
   bool editable_cfg_built() const;
 
+  // While enabled, `build_cfg(/* editable */ true)` keeps an editable CFG
+  // that is already built, and `clear_cfg()` without a custom strategy keeps
+  // an editable CFG instead of linearizing it. This lets consecutive passes
+  // that work on CFGs share them. Only toggled by the PassManager between
+  // passes.
+  static void set_persistent_editable_cfgs(bool enabled);
+  static bool persistent_editable_cfgs();
+
   /* Generate DexCode from IRCode */
   std::unique_ptr<DexCode> sync(const DexMethod*);
 
@@ -14,6 +14,7 @@
 
 #include "Debug.h"
 #include "IROpcode.h"
+#include "ObjectPool.h"
 
 class DexCallSite;
 class DexFieldRef;
@@ -139,6 +140,8 @@ class IRInstruction final {
   IRInstruction(const IRInstruction&);
   ~IRInstruction();
 
+  REDEX_POOLED_ALLOCATION(IRInstruction)
+
   /*
    * Ensures that wide registers only have their first register referenced
    * in the srcs list. This only affects invoke-* instructions.
@@ -386,11 +389,11 @@ class IRInstruction final {
  private:
   std::string show_opcode() const; // To avoid "Show.h" in the header.
 
-  // 2 is chosen because it's the maximum number of registers (32 bits each) we
-  // can fit in the size of a pointer (on a 64bit system).
-  // In practice, most IRInstructions have 2 or fewer source registers, so we
-  // can avoid a vector allocation most of the time.
-  static constexpr uint8_t MAX_NUM_INLINE_SRCS = 2;
+  // 6 is chosen because it covers every non-range invoke (at most 5
+  // registers) and most range invokes and filled-new-arrays, while the inline
+  // array still takes no more space than the rest of the instruction. Only
+  // the few instructions with more sources allocate a vector.
+  static constexpr uint8_t MAX_NUM_INLINE_SRCS = 6;
 
   // The fields of IRInstruction are carefully selected and ordered to avoid
   // empty packing bytes and minimize total size. This is optimized for 8 byte
@@ -426,7 +429,7 @@ class IRInstruction final {
     // Be careful to new and delete it correctly!
     std::vector<reg_t>* m_srcs;
   };
-  // 24 bytes total
+  // 40 bytes total
 };
 
 /*
@@ -430,6 +430,58 @@ void IRList::cleanup_debug() {
   cleanup_debug(valid_regs);
 }
 
+void IRList::remove_redundant_positions() {
+  // We build a set of duplicate positions.
+  std::unordered_set<DexPosition*> duplicate_positions;
+  std::unordered_map<DexPosition*, IRList::iterator> positions_to_remove;
+  DexPosition* prev = nullptr;
+  for (auto it = m_list.begin(); it != m_list.end(); it++) {
+    if (it->type == MFLOW_POSITION) {
+      DexPosition* curr = it->pos.get();
+      positions_to_remove.emplace(curr, it);
+      if (prev != nullptr && *curr == *prev) {
+        duplicate_positions.insert(curr);
+      }
+      prev = curr;
+    }
+  }
+
+  // Backward pass to find positions that are not adjacent to an immediately
+  // following position and must be kept (including their parents).
+  bool keep_prev = false;
+  for (auto it = m_list.rbegin(); it != m_list.rend(); it++) {
+    switch (it->type) {
+    case MFLOW_OPCODE:
+    case MFLOW_DEX_OPCODE:
+    case MFLOW_TARGET:
+    case MFLOW_TRY:
+    case MFLOW_CATCH:
+      keep_prev = true;
+      break;
+    case MFLOW_POSITION: {
+      DexPosition* curr = it->pos.get();
+      if (keep_prev && !duplicate_positions.count(curr)) {
+        for (auto pos = curr; pos && positions_to_remove.erase(pos);
+             pos = pos->parent) {
+        }
+        keep_prev = false;
+      }
+      break;
+    }
+    case MFLOW_SOURCE_BLOCK:
+    case MFLOW_DEBUG:
+    case MFLOW_FALLTHROUGH:
+      // ignore
+      break;
+    }
+  }
+
+  // Final pass to do the actual deletion.
+  for (auto& p : positions_to_remove) {
+    erase_and_dispose(p.second);
+  }
+}
+
 void IRList::replace_opcode(IRInstruction* to_delete,
                             const std::vector<IRInstruction*>& replacements) {
   auto it = m_list.begin();
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <boost/intrusive/list.hpp>
 #include <boost/optional.hpp>
 #include <boost/range/sub_range.hpp>
@@ -23,6 +24,7 @@
 #include <vector>
 
 #include "Debug.h"
+#include "ObjectPool.h"
 
 class DexCallSite;
 class DexDebugInstruction;
@@ -166,7 +168,44 @@ struct SourceBlock {
    private:
     ValPair m_val;
   };
-  std::vector<Val> vals;
+
+  // The values of all interactions. Copies of a source block, e.g. the ones
+  // that inlining makes, share them until one of the copies changes a value.
+  class Vals {
+   public:
+    Vals() = default;
+    explicit Vals(std::vector<Val> v)
+        : m_vals(v.empty() ? nullptr
+                           : std::make_shared<std::vector<Val>>(std::move(v))) {
+    }
+
+    size_t size() const { return m_vals == nullptr ? 0 : m_vals->size(); }
+    bool empty() const { return size() == 0; }
+
+    const Val& operator[](size_t i) const { return (*m_vals)[i]; }
+    const Val* begin() const {
+      return m_vals == nullptr ? nullptr : m_vals->data();
+    }
+    const Val* end() const { return begin() + size(); }
+
+    // Unshares the values first if other copies still see them.
+    void set(size_t i, const Val& val) {
+      if (m_vals.use_count() > 1) {
+        m_vals = std::make_shared<std::vector<Val>>(*m_vals);
+      }
+      (*m_vals)[i] = val;
+    }
+
+    bool operator==(const Vals& other) const {
+      return m_vals == other.m_vals ||
+             (size() == other.size() &&
+              std::equal(begin(), end(), other.begin()));
+    }
+
+   private:
+    std::shared_ptr<std::vector<Val>> m_vals;
+  };
+  Vals vals;
 
   SourceBlock() = default;
   SourceBlock(DexMethodRef* src, size_t id) : src(src), id(id) {}
@@ -178,6 +217,8 @@ struct SourceBlock {
         id(other.id),
         vals(other.vals) {}
 
+  REDEX_POOLED_ALLOCATION(SourceBlock)
+
   boost::optional<float> get_val(size_t i) const {
     return vals[i] ? boost::optional<float>(vals[i]->val) : boost::none;
   }
@@ -299,6 +340,8 @@ struct MethodItemEntry {
   MethodItemEntry() : type(MFLOW_FALLTHROUGH) {}
   ~MethodItemEntry();
 
+  REDEX_POOLED_ALLOCATION(MethodItemEntry)
+
   /*
    * This should only ever be used by the instruction lowering step. Do NOT use
    * it in passes!
@@ -395,6 +438,16 @@ class IRList {
    */
   void cleanup_debug(std::unordered_set<reg_t>& valid_regs);
 
+  /*
+   * Deletes, and frees, the positions that are...
+   * - duplicates with the previous position, even across block boundaries
+   *   (they will get reconstituted when the cfg is rebuilt)
+   * - adjacent to an immediately following position, as the last position
+   *   wins.
+   * Parent positions are kept as needed.
+   */
+  void remove_redundant_positions();
+
   /* Passes memory ownership of "from" to callee.  It will delete it. */
   void replace_opcode(IRInstruction* from, IRInstruction* to);
 
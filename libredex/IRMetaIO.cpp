@@ -7,17 +7,21 @@
 
 #include "IRMetaIO.h"
 
+#include <boost/filesystem.hpp>
 #include <fstream>
 #include <iostream>
+#include <numeric>
 
+#include "RedexMappedFile.h"
 #include "Show.h"
 #include "StringBuilder.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 namespace {
 constexpr const char* IRMETA_FILE_NAME = "/irmeta.bin";
 
-constexpr const char* IRMETA_MAGIC_NUMBER = "rdx.\n\x14\x12\x00";
+constexpr const char* IRMETA_MAGIC_NUMBER = "rdx.\n\x14\x13\x00";
 
 PACKED(struct ir_meta_header_t {
   char magic[8];
@@ -25,6 +29,18 @@ PACKED(struct ir_meta_header_t {
   uint32_t file_size;
   uint32_t classes_size;
   uint32_t rstate_size; // size of IRMetaIO::bit_rstate_t.
+  uint32_t toc_offset;
+  uint32_t toc_size; // number of ir_meta_toc_entry_t.
+});
+
+/**
+ * The class data is a sequence of independent per-class records, and the
+ * table of contents at the end of the file points at each of them, so that
+ * they can be decoded in parallel straight from a mapping of the file.
+ */
+PACKED(struct ir_meta_toc_entry_t {
+  uint32_t offset;
+  uint32_t size;
 });
 
 void serialize_str(const std::string& str, std::ofstream& ostrm) {
@@ -119,7 +135,9 @@ enum BlockType : char { ClassBlock, FieldBlock, MethodBlock, EndOfBlock };
  *    ...
  *  ...
  */
-void serialize_class_data(const Scope& classes, std::ofstream& ostrm) {
+void serialize_class_data(const Scope& classes,
+                          std::ofstream& ostrm,
+                          std::vector<ir_meta_toc_entry_t>* toc) {
   walk::classes(classes, [&](const DexClass* cls) {
     // Fields
     std::vector<const DexField*> fields;
@@ -147,12 +165,14 @@ void serialize_class_data(const Scope& classes, std::ofstream& ostrm) {
     }
 
     // Classes
-    if (!fields.empty() || !methods.empty() ||
-        !ir_meta_io::IRMetaIO::is_default_meta(cls)) {
-      ostrm.put(BlockType::ClassBlock);
-      serialize_str(cls->c_str(), ostrm);
-      serialize_name_and_rstate(cls, ostrm);
+    if (fields.empty() && methods.empty() &&
+        ir_meta_io::IRMetaIO::is_default_meta(cls)) {
+      return;
     }
+    uint32_t offset = ostrm.tellp();
+    ostrm.put(BlockType::ClassBlock);
+    serialize_str(cls->c_str(), ostrm);
+    serialize_name_and_rstate(cls, ostrm);
 
     for (const DexField* field : fields) {
       ostrm.put(BlockType::FieldBlock);
@@ -167,17 +187,20 @@ void serialize_class_data(const Scope& classes, std::ofstream& ostrm) {
       serialize_str(b.str(), ostrm);
       serialize_name_and_rstate(method, ostrm);
     }
+    toc->push_back({offset, (uint32_t)ostrm.tellp() - offset});
   });
 }
 
-void deserialize_class_data(std::ifstream& istrm, uint32_t data_size) {
-  auto data = std::make_unique<char[]>(data_size);
-  istrm.read((char*)data.get(), data_size);
-  char* ptr = data.get();
+/**
+ * Deserialize the record of one class, which starts with its ClassBlock.
+ */
+void deserialize_class_data(const char* data, uint32_t data_size) {
+  const char* ptr = data;
   DexClass* cls = nullptr;
-  while (ptr - data.get() < data_size) {
+  while (ptr - data < data_size) {
     BlockType btype = (BlockType)*ptr++;
     always_assert(btype >= 0 && btype < BlockType::EndOfBlock);
+    always_assert(cls != nullptr || btype == BlockType::ClassBlock);
     int utfsize = read_uleb128((const uint8_t**)&ptr);
     switch (btype) {
     case BlockType::ClassBlock: {
@@ -185,19 +208,19 @@ void deserialize_class_data(std::ifstream& istrm, uint32_t data_size) {
       cls = type_class(type);
       always_assert(cls != nullptr);
       ptr += utfsize + 1;
-      deserialize_name_and_rstate((const char**)&ptr, cls);
+      deserialize_name_and_rstate(&ptr, cls);
       break;
     }
     case BlockType::FieldBlock: {
       DexField* field = find_field(cls, std::string(ptr, utfsize));
       ptr += utfsize + 1;
-      deserialize_name_and_rstate((const char**)&ptr, field);
+      deserialize_name_and_rstate(&ptr, field);
       break;
     }
     case BlockType::MethodBlock: {
       DexMethod* method = find_method(cls, std::string(ptr, utfsize));
       ptr += utfsize + 1;
-      deserialize_name_and_rstate((const char**)&ptr, method);
+      deserialize_name_and_rstate(&ptr, method);
       break;
     }
     default: {
@@ -220,13 +243,20 @@ void dump(const Scope& classes, const std::string& output_dir) {
   meta_header.file_size = 0;
   meta_header.classes_size = 0;
   meta_header.rstate_size = sizeof(IRMetaIO::bit_rstate_t);
+  meta_header.toc_offset = 0;
+  meta_header.toc_size = 0;
   ostrm.write((char*)&meta_header, sizeof(meta_header));
 
-  serialize_class_data(classes, ostrm);
+  std::vector<ir_meta_toc_entry_t> toc;
+  serialize_class_data(classes, ostrm, &toc);
   meta_header.classes_size = (uint32_t)ostrm.tellp() - sizeof(meta_header);
 
   // TODO(fengliu): Serialize pass related data
 
+  meta_header.toc_offset = ostrm.tellp();
+  meta_header.toc_size = toc.size();
+  ostrm.write((char*)toc.data(), toc.size() * sizeof(ir_meta_toc_entry_t));
+
   meta_header.file_size = ostrm.tellp();
   ostrm.seekp(0);
   ostrm.write((char*)&meta_header, sizeof(meta_header));
@@ -234,14 +264,18 @@ void dump(const Scope& classes, const std::string& output_dir) {
 
 bool load(const std::string& input_dir) {
   std::string input_file = input_dir + IRMETA_FILE_NAME;
-  std::ifstream istrm(input_file, std::ios::binary | std::ios::in);
-  if (!istrm.is_open()) {
+  if (!boost::filesystem::is_regular_file(input_file)) {
     std::cerr << "Can not open " << input_file << std::endl;
     return false;
   }
-
   ir_meta_header_t meta_header;
-  istrm.read((char*)&meta_header, sizeof(meta_header));
+  if (boost::filesystem::file_size(input_file) < sizeof(meta_header)) {
+    std::cerr << "May be not valid meta file\n";
+    return false;
+  }
+  auto mapped_file = RedexMappedFile::open(input_file);
+  const char* data = mapped_file.const_data();
+  memcpy(&meta_header, data, sizeof(meta_header));
   if (strcmp(meta_header.magic, IRMETA_MAGIC_NUMBER) != 0) {
     std::cerr << "May be not valid meta file\n";
     return false;
@@ -250,9 +284,28 @@ bool load(const std::string& input_dir) {
     std::cerr << "Could not load the outdated IR meta data\n";
     return false;
   }
-  // file size
+  if (meta_header.file_size != mapped_file.size() ||
+      meta_header.toc_offset + (uint64_t)meta_header.toc_size *
+                                   sizeof(ir_meta_toc_entry_t) !=
+          meta_header.file_size) {
+    std::cerr << "Truncated IR meta file\n";
+    return false;
+  }
 
-  deserialize_class_data(istrm, meta_header.classes_size);
+  // The records of different classes touch disjoint objects.
+  const auto* toc =
+      (const ir_meta_toc_entry_t*)(data + meta_header.toc_offset);
+  std::vector<size_t> indices(meta_header.toc_size);
+  std::iota(indices.begin(), indices.end(), 0);
+  workqueue_run<size_t>(
+      [&](size_t i) {
+        ir_meta_toc_entry_t entry;
+        memcpy(&entry, toc + i, sizeof(entry));
+        always_assert(entry.offset + (uint64_t)entry.size <=
+                      meta_header.toc_offset);
+        deserialize_class_data(data + entry.offset, entry.size);
+      },
+      indices);
 
   return true;
 }
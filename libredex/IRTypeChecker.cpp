@@ -94,10 +94,9 @@ bool check_cast_helper(const DexType* from, const DexType* to) {
   // Assume the type hierarchies of the well known external types are stable
   // across Android versions. When their class definitions present, perform the
   // regular type inheritance check.
-  if ((from_cls->is_external() &&
-       !g_redex->pointers_cache().m_well_known_types.count(from)) ||
-      (to_cls->is_external() &&
-       !g_redex->pointers_cache().m_well_known_types.count(to))) {
+  const auto& pointers_cache = g_redex->pointers_cache();
+  if ((from_cls->is_external() && !pointers_cache.is_well_known_type(from)) ||
+      (to_cls->is_external() && !pointers_cache.is_well_known_type(to))) {
     return true;
   }
   return type::check_cast(from, to);
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "IncrementalManifest.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/functional/hash.hpp>
+#include <fstream>
+#include <json/json.h>
+#include <numeric>
+
+#include "Debug.h"
+#include "DexHasher.h"
+#include "DexUtil.h"
+#include "TypeUtil.h"
+#include "WorkQueue.h"
+
+namespace incremental {
+
+std::string config_fingerprint(const Json::Value& config,
+                               const std::vector<std::string>& pass_names) {
+  Json::Value relevant = config;
+  if (relevant.isObject()) {
+    relevant.removeMember("incremental");
+  }
+  size_t hash = boost::hash_value(relevant.toStyledString());
+  boost::hash_combine(hash, pass_names);
+  return hashing::hash_to_string(hash);
+}
+
+Manifest build_manifest(const Scope& scope, std::string config_fingerprint) {
+  std::vector<size_t> hashes(scope.size());
+  std::vector<size_t> indices(scope.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  workqueue_run<size_t>(
+      [&](size_t index) {
+        auto class_hash = hashing::DexClassHasher(scope[index]).run();
+        size_t hash = class_hash.signature_hash;
+        boost::hash_combine(hash, class_hash.code_hash);
+        boost::hash_combine(hash, class_hash.registers_hash);
+        boost::hash_combine(hash, class_hash.positions_hash);
+        hashes[index] = hash;
+      },
+      indices);
+
+  Manifest manifest;
+  manifest.config_fingerprint = std::move(config_fingerprint);
+  manifest.class_hashes.reserve(scope.size());
+  for (size_t i = 0; i < scope.size(); ++i) {
+    manifest.class_hashes.emplace(scope[i]->get_name()->str(), hashes[i]);
+  }
+  return manifest;
+}
+
+void write_manifest(const Manifest& manifest, const std::string& path) {
+  Json::Value classes(Json::objectValue);
+  for (const auto& [name, hash] : manifest.class_hashes) {
+    classes[name] = hashing::hash_to_string(hash);
+  }
+  Json::Value root(Json::objectValue);
+  root["config_fingerprint"] = manifest.config_fingerprint;
+  root["classes"] = std::move(classes);
+  std::ofstream out(path);
+  out << root.toStyledString();
+  always_assert_log(out, "Unable to write incremental manifest %s",
+                    path.c_str());
+}
+
+boost::optional<Manifest> read_manifest(const std::string& path) {
+  if (!boost::filesystem::exists(path)) {
+    return boost::none;
+  }
+  std::ifstream input(path);
+  Json::Reader reader;
+  Json::Value root;
+  bool parsing_succeeded = reader.parse(input, root);
+  always_assert_log(parsing_succeeded && root.isObject(),
+                    "Failed to parse incremental manifest: %s\n%s",
+                    path.c_str(), reader.getFormattedErrorMessages().c_str());
+
+  Manifest manifest;
+  manifest.config_fingerprint = root["config_fingerprint"].asString();
+  const auto& classes = root["classes"];
+  for (auto it = classes.begin(); it != classes.end(); ++it) {
+    manifest.class_hashes.emplace(it.key().asString(),
+                                  std::stoull(it->asString(), nullptr, 16));
+  }
+  return manifest;
+}
+
+ChangedRegion get_changed_region(const Manifest& previous,
+                                 const Manifest& current,
+                                 const Scope& scope) {
+  ChangedRegion result;
+  if (previous.config_fingerprint != current.config_fingerprint) {
+    result.changed.insert(scope.begin(), scope.end());
+    result.region = result.changed;
+    return result;
+  }
+
+  for (const auto* cls : scope) {
+    const auto& name = cls->get_name()->str();
+    auto prev_it = previous.class_hashes.find(name);
+    if (prev_it == previous.class_hashes.end() ||
+        prev_it->second != current.class_hashes.at(name)) {
+      result.changed.insert(cls);
+    }
+  }
+  for (const auto& entry : previous.class_hashes) {
+    if (!current.class_hashes.count(entry.first)) {
+      result.has_removed_classes = true;
+      break;
+    }
+  }
+  if (result.changed.empty()) {
+    return result;
+  }
+
+  // The classes each class references, through its hierarchy, its members
+  // and its code.
+  std::vector<std::vector<const DexClass*>> references(scope.size());
+  std::vector<size_t> indices(scope.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  workqueue_run<size_t>(
+      [&](size_t index) {
+        const auto* cls = scope[index];
+        std::vector<DexType*> types;
+        cls->gather_types(types);
+        sort_unique(types);
+        for (auto* type : types) {
+          auto* referenced = type_class(type::get_element_type_if_array(type));
+          if (referenced != nullptr && referenced != cls &&
+              !referenced->is_external()) {
+            references[index].push_back(referenced);
+          }
+        }
+      },
+      indices);
+
+  std::unordered_map<const DexClass*, std::vector<const DexClass*>> referrers;
+  for (size_t i = 0; i < scope.size(); ++i) {
+    for (const auto* referenced : references[i]) {
+      referrers[referenced].push_back(scope[i]);
+    }
+  }
+
+  result.region = result.changed;
+  std::vector<const DexClass*> worklist(result.changed.begin(),
+                                        result.changed.end());
+  while (!worklist.empty()) {
+    const auto* cls = worklist.back();
+    worklist.pop_back();
+    auto it = referrers.find(cls);
+    if (it == referrers.end()) {
+      continue;
+    }
+    for (const auto* referrer : it->second) {
+      if (result.region.insert(referrer).second) {
+        worklist.push_back(referrer);
+      }
+    }
+  }
+  return result;
+}
+
+} // namespace incremental
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <boost/optional.hpp>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "DexClass.h"
+
+namespace Json {
+class Value;
+} // namespace Json
+
+/*
+ * Building blocks of an incremental mode: the input of a run is summarized by
+ * a manifest of per-class hashes, computed by DexClassHasher, and by a
+ * fingerprint of the config and of the passes. The manifest is written next
+ * to the optimized output, so that the next run can tell which classes
+ * changed and which ones may be affected by those changes.
+ *
+ * Only the JSON config and the pass list are part of the fingerprint. Other
+ * inputs, e.g. the ProGuard rules or the method profiles, are not.
+ */
+namespace incremental {
+
+constexpr const char* MANIFEST_FILENAME = "redex-incremental-manifest.json";
+
+struct Manifest {
+  std::string config_fingerprint;
+  // Input hash of each class, by class name.
+  std::unordered_map<std::string, size_t> class_hashes;
+};
+
+/*
+ * Hashes the config, except for its "incremental" section which only says
+ * where the manifests are, along with the names of the passes, in order.
+ */
+std::string config_fingerprint(const Json::Value& config,
+                               const std::vector<std::string>& pass_names);
+
+Manifest build_manifest(const Scope& scope, std::string config_fingerprint);
+
+void write_manifest(const Manifest& manifest, const std::string& path);
+
+/*
+ * Returns none if the file doesn't exist. Fails if it cannot be parsed.
+ */
+boost::optional<Manifest> read_manifest(const std::string& path);
+
+struct ChangedRegion {
+  // The classes that are new or whose hash differs from the previous one.
+  std::unordered_set<const DexClass*> changed;
+  // The changed classes, along with all the classes that transitively
+  // reference one of them, i.e. whose optimized form may depend on them.
+  std::unordered_set<const DexClass*> region;
+  // Whether classes of the previous run are gone, which may affect classes
+  // that are not in the region, e.g. through their class hierarchy.
+  bool has_removed_classes{false};
+};
+
+/*
+ * Compares the manifest of the scope with the previous one. When the config
+ * fingerprints differ, every class is considered changed.
+ */
+ChangedRegion get_changed_region(const Manifest& previous,
+                                 const Manifest& current,
+                                 const Scope& scope);
+
+} // namespace incremental
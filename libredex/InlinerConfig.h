@@ -25,6 +25,8 @@ struct InlinerConfig {
   bool enforce_method_size_limit{true};
   bool multiple_callers{false};
   bool use_call_site_summaries{true};
+  // Reuse the inlined costs of unchanged callees from earlier inliner runs
+  bool share_inlined_costs{true};
   bool intermediate_shrinking{false};
   shrinker::ShrinkerConfig shrinker;
   bool shrink_other_methods{true};
@@ -424,6 +424,35 @@ void lower_simple_instruction(DexMethod*, IRCode*, IRList::iterator* it_) {
   }
 }
 
+/*
+ * Whether the code is a single run of instructions ending in its only return
+ * or throw. The CFG of such code is one block, which linearizes back to the
+ * same instructions.
+ */
+bool is_straight_line(const IRCode* code) {
+  const IRInstruction* last_insn = nullptr;
+  for (const auto& mie : *code) {
+    switch (mie.type) {
+    case MFLOW_TRY:
+    case MFLOW_CATCH:
+    case MFLOW_TARGET:
+    case MFLOW_FALLTHROUGH:
+      return false;
+    case MFLOW_OPCODE:
+      if (last_insn != nullptr && (opcode::is_a_return(last_insn->opcode()) ||
+                                   opcode::is_throw(last_insn->opcode()))) {
+        // Unreachable code, which the CFG removes.
+        return false;
+      }
+      last_insn = mie.insn;
+      break;
+    default:
+      break;
+    }
+  }
+  return true;
+}
+
 } // namespace
 
 Stats lower(DexMethod* method, bool lower_with_cfg) {
@@ -435,8 +464,24 @@ Stats lower(DexMethod* method, bool lower_with_cfg) {
   // code when there is an empty block (a block with only a goto in it). To
   // avoid this bug, we use the CFG to remove empty blocks.
   if (lower_with_cfg) {
-    code->build_cfg(/* editable */ true);
-    code->clear_cfg();
+    if (is_straight_line(code)) {
+      // There are no blocks to remove. Do what building and linearizing the
+      // CFG would do to such code: recompute the registers size, which is
+      // often off, and drop redundant positions.
+      reg_t registers_size = 0;
+      for (const auto& mie : InstructionIterable(code)) {
+        auto* insn = mie.insn;
+        if (insn->has_dest()) {
+          registers_size = std::max<reg_t>(
+              registers_size, insn->dest() + insn->dest_is_wide() + 1);
+        }
+      }
+      code->set_registers_size(registers_size);
+      code->remove_redundant_positions();
+    } else {
+      code->build_cfg(/* editable */ true);
+      code->clear_cfg();
+    }
   }
 
   // Check the load-param opcodes make sense before removing them
@@ -522,6 +567,16 @@ Stats run(DexStoresVector& stores, bool lower_with_cfg) {
   });
 }
 
+Stats run(const DexClasses& classes, bool lower_with_cfg) {
+  Stats stats;
+  walk::methods(classes, [&](DexMethod* m) {
+    if (m->get_code() != nullptr) {
+      stats += lower(m, lower_with_cfg);
+    }
+  });
+  return stats;
+}
+
 // Computes number of entries needed for a packed switch, accounting for any
 // holes that might exist
 uint64_t get_packed_switch_size(const std::vector<int32_t>& case_keys) {
@@ -11,6 +11,7 @@
 #include <cstdint>
 #include <vector>
 
+class DexClass;
 class DexMethod;
 class DexStore;
 class IRInstruction;
@@ -18,6 +19,7 @@ struct MethodItemEntry;
 
 enum DexOpcode : uint16_t;
 
+using DexClasses = std::vector<DexClass*>;
 using DexStoresVector = std::vector<DexStore>;
 
 namespace instruction_lowering {
@@ -47,6 +49,10 @@ Stats lower(DexMethod*, bool lower_with_cfg = false);
 
 Stats run(DexStoresVector&, bool lower_with_cfg = false);
 
+// Lowers the methods of the given classes on the calling thread, e.g. from
+// the job that writes out their dex.
+Stats run(const DexClasses&, bool lower_with_cfg = false);
+
 namespace impl {
 
 DexOpcode select_move_opcode(const IRInstruction* insn);
@@ -7,7 +7,12 @@
 
 #include <boost/iostreams/device/mapped_file.hpp>
 
+#include <algorithm>
 #include <cstdint>
+#include <exception>
+#include <memory>
+#include <numeric>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 #include <zlib.h>
@@ -28,6 +33,7 @@
 #include "Show.h"
 #include "Trace.h"
 #include "Util.h"
+#include "WorkQueue.h"
 
 /******************
  * Begin Class Loading code.
@@ -360,10 +366,58 @@ static DexMethod* make_dexmethod(std::vector<cp_entry>& cpool,
   return method;
 }
 
-bool parse_class(uint8_t* buffer,
-                 Scope* classes,
-                 attribute_hook_t attr_hook,
-                 const std::string& jar_location) {
+namespace {
+
+// Reads the type a class file defines. Sets `*self` to nullptr for module-info
+// classes, which are never loaded.
+bool peek_class_type(uint8_t* buffer, DexType** self) {
+  uint32_t magic = read32(buffer);
+  read16(buffer); // minor version
+  read16(buffer); // major version
+  uint16_t cp_count = read16(buffer);
+  if (magic != kClassMagic) {
+    fprintf(stderr, "Bad class magic %08x, Bailing\n", magic);
+    return false;
+  }
+  std::vector<cp_entry> cpool;
+  cpool.resize(cp_count);
+  for (int i = 1; i < cp_count; i++) {
+    if (!parse_cp_entry(buffer, cpool[i])) return false;
+    if (cpool[i].tag == CP_CONST_LONG || cpool[i].tag == CP_CONST_DOUBLE) {
+      cpool[i + 1] = cpool[i];
+      i++;
+    }
+  }
+  uint16_t aflags = read16(buffer);
+  uint16_t clazz = read16(buffer);
+  *self = is_module((DexAccessFlags)aflags)
+              ? nullptr
+              : make_dextype_from_cref(cpool, clazz);
+  return true;
+}
+
+void trace_duplicate_jar_class(const DexType* self,
+                               const std::string& jar_location,
+                               const std::string& previous_location) {
+  // Two external classes in .jar file has the same name
+  // Just issue an warning for now
+  TRACE(MAIN, 1,
+        "Warning: Found a duplicate class '%s' in two .jar files:\n "
+        "  Current: '%s'\n"
+        "  Previous: '%s'",
+        SHOW(self), jar_location.c_str(), previous_location.c_str());
+}
+
+/*
+ * Parses a class file up to, but excluding, publishing the class. This only
+ * reads the set of published classes, so class files can be parsed in
+ * parallel as long as they define distinct types and nothing is published
+ * meanwhile. Leaves `*creator` empty if the class is to be skipped.
+ */
+bool parse_class_creator(uint8_t* buffer,
+                         const attribute_hook_t& attr_hook,
+                         const std::string& jar_location,
+                         std::unique_ptr<ClassCreator>* creator) {
   uint32_t magic = read32(buffer);
   uint16_t vminor DEBUG_ONLY = read16(buffer);
   uint16_t vmajor DEBUG_ONLY = read16(buffer);
@@ -401,13 +455,7 @@ bool parse_class(uint8_t* buffer,
   if (cls) {
     // We are seeing duplicate classes when parsing jar file
     if (cls->is_external()) {
-      // Two external classes in .jar file has the same name
-      // Just issue an warning for now
-      TRACE(MAIN, 1,
-            "Warning: Found a duplicate class '%s' in two .jar files:\n "
-            "  Current: '%s'\n"
-            "  Previous: '%s'",
-            SHOW(self), jar_location.c_str(), cls->get_location().c_str());
+      trace_duplicate_jar_class(self, jar_location, cls->get_location());
     } else if (!dup_classes::is_known_dup(cls)) {
       TRACE(MAIN, 1,
             "Warning: Found a duplicate class '%s' in .dex and .jar file."
@@ -430,7 +478,8 @@ bool parse_class(uint8_t* buffer,
     return true;
   }
 
-  ClassCreator cc(self, jar_location);
+  *creator = std::make_unique<ClassCreator>(self, jar_location);
+  auto& cc = **creator;
   cc.set_external();
   if (super != 0) {
     DexType* sclazz = make_dextype_from_cref(cpool, super);
@@ -497,6 +546,10 @@ bool parse_class(uint8_t* buffer,
       invoke_attr_hook({method}, attrPtr);
     }
   }
+  return true;
+}
+
+void publish_class(ClassCreator& cc, Scope* classes) {
   DexClass* dc = cc.create();
   if (classes != nullptr) {
     classes->emplace_back(dc);
@@ -530,6 +583,21 @@ bool parse_class(uint8_t* buffer,
   }
 
 #endif
+}
+
+} // namespace
+
+bool parse_class(uint8_t* buffer,
+                 Scope* classes,
+                 attribute_hook_t attr_hook,
+                 const std::string& jar_location) {
+  std::unique_ptr<ClassCreator> creator;
+  if (!parse_class_creator(buffer, attr_hook, jar_location, &creator)) {
+    return false;
+  }
+  if (creator) {
+    publish_class(*creator, classes);
+  }
   return true;
 }
 
@@ -694,36 +762,58 @@ static bool get_jar_entries(const uint8_t* mapping,
   return true;
 }
 
-static int jar_uncompress(Bytef* dest,
-                          uLongf* destLen,
-                          const Bytef* source,
-                          uLong sourceLen) {
-  z_stream stream;
-  int err;
-
-  stream.next_in = (Bytef*)source;
-  stream.avail_in = (uInt)sourceLen;
-  stream.next_out = dest;
-  stream.avail_out = (uInt)*destLen;
-  stream.zalloc = (alloc_func)0;
-  stream.zfree = (free_func)0;
-
-  err = inflateInit2(&stream, -MAX_WBITS);
-  if (err != Z_OK) return err;
+namespace {
 
-  err = inflate(&stream, Z_FINISH);
-  if (err != Z_STREAM_END) {
-    inflateEnd(&stream);
-    return err;
+/*
+ * A raw-deflate stream that is reset rather than reallocated between entries.
+ */
+class Inflater {
+ public:
+  Inflater() {
+    m_stream.zalloc = (alloc_func)0;
+    m_stream.zfree = (free_func)0;
+    m_stream.opaque = (voidpf)0;
+    m_stream.next_in = Z_NULL;
+    m_stream.avail_in = 0;
+    m_init_rv = inflateInit2(&m_stream, -MAX_WBITS);
+  }
+  ~Inflater() {
+    if (m_init_rv == Z_OK) {
+      inflateEnd(&m_stream);
+    }
+  }
+  Inflater(const Inflater&) = delete;
+  Inflater& operator=(const Inflater&) = delete;
+
+  int uncompress(Bytef* dest,
+                 uLongf* destLen,
+                 const Bytef* source,
+                 uLong sourceLen) {
+    if (m_init_rv != Z_OK) return m_init_rv;
+    int err = inflateReset(&m_stream);
+    if (err != Z_OK) return err;
+    m_stream.next_in = (Bytef*)source;
+    m_stream.avail_in = (uInt)sourceLen;
+    m_stream.next_out = dest;
+    m_stream.avail_out = (uInt)*destLen;
+    err = inflate(&m_stream, Z_FINISH);
+    if (err != Z_STREAM_END) {
+      return err == Z_OK ? Z_BUF_ERROR : err;
+    }
+    *destLen = m_stream.total_out;
+    return Z_OK;
   }
-  *destLen = stream.total_out;
 
-  err = inflateEnd(&stream);
-  return err;
-}
+ private:
+  z_stream m_stream;
+  int m_init_rv;
+};
+
+} // namespace
 
 static bool decompress_class(jar_entry& file,
                              const uint8_t* mapping,
+                             Inflater& inflater,
                              uint8_t* outbuffer,
                              ssize_t bufsize) {
   if (file.cd_entry.comp_method != kCompMethodDeflate) {
@@ -761,7 +851,7 @@ static bool decompress_class(jar_entry& file,
   lfile += pkf.fname_len;
   lfile += pkf.extra_len;
   uLongf dlen = bufsize;
-  int zlibrv = jar_uncompress(outbuffer, &dlen, lfile, pkf.comp_size);
+  int zlibrv = inflater.uncompress(outbuffer, &dlen, lfile, pkf.comp_size);
   if (zlibrv != Z_OK) {
     fprintf(stderr, "uncompress failed with code %d, Bailing\n", zlibrv);
     return false;
@@ -773,46 +863,156 @@ static bool decompress_class(jar_entry& file,
   return true;
 }
 
+static bool is_class_entry(const jar_entry& file) {
+  static char classEndString[] = ".class";
+  static size_t classEndStringLen = strlen(classEndString);
+  if (file.cd_entry.ucomp_size == 0) return false;
+  if (file.cd_entry.fname_len < (classEndStringLen + 1)) return false;
+
+  // Skip non-class files
+  uint8_t* endcomp =
+      file.filename + (file.cd_entry.fname_len - classEndStringLen);
+  return memcmp(endcomp, classEndString, classEndStringLen) == 0;
+}
+
 static const int kStartBufferSize = 128 * 1024;
 
-static bool process_jar_entries(const char* location,
-                                std::vector<jar_entry>& files,
-                                const uint8_t* mapping,
-                                Scope* classes,
-                                const attribute_hook_t& attr_hook) {
+// Loads the classes one after another, for attribute hooks, which need not be
+// thread-safe.
+static bool process_jar_entries_serially(const char* location,
+                                         std::vector<jar_entry>& files,
+                                         const uint8_t* mapping,
+                                         Scope* classes,
+                                         const attribute_hook_t& attr_hook) {
   ssize_t bufsize = kStartBufferSize;
-  uint8_t* outbuffer = (uint8_t*)malloc(bufsize);
-  static char classEndString[] = ".class";
-  static size_t classEndStringLen = strlen(classEndString);
-  init_basic_types();
+  std::unique_ptr<uint8_t[]> outbuffer(new uint8_t[bufsize]);
+  Inflater inflater;
   for (auto& file : files) {
-    if (file.cd_entry.ucomp_size == 0) continue;
-    if (file.cd_entry.fname_len < (classEndStringLen + 1)) continue;
-
-    // Skip non-class files
-    uint8_t* endcomp =
-        file.filename + (file.cd_entry.fname_len - classEndStringLen);
-    if (memcmp(endcomp, classEndString, classEndStringLen) != 0) continue;
+    if (!is_class_entry(file)) continue;
 
     // Resize output if necessary.
     if (bufsize < file.cd_entry.ucomp_size) {
       while (bufsize < file.cd_entry.ucomp_size)
         bufsize *= 2;
-      free(outbuffer);
-      outbuffer = (uint8_t*)malloc(bufsize);
+      outbuffer.reset(new uint8_t[bufsize]);
     }
 
-    if (!decompress_class(file, mapping, outbuffer, bufsize)) {
-      free(outbuffer);
+    if (!decompress_class(file, mapping, inflater, outbuffer.get(), bufsize)) {
       return false;
     }
 
-    if (!parse_class(outbuffer, classes, attr_hook, location)) {
-      free(outbuffer);
+    if (!parse_class(outbuffer.get(), classes, attr_hook, location)) {
       return false;
     }
   }
-  free(outbuffer);
+  return true;
+}
+
+/*
+ * Loads the classes of a jar in parallel, with results identical to loading
+ * them in central directory order:
+ * 1. Inflate all class files into one buffer, sized from the central
+ *    directory, and read the type each defines.
+ * 2. Keep only the first class file for each type; later ones are duplicates.
+ * 3. Parse the remaining class files. This only reads the set of published
+ *    classes, so it is safe to do concurrently.
+ * 4. Publish the classes, and report errors, in order.
+ */
+static bool process_jar_entries(const char* location,
+                                std::vector<jar_entry>& files,
+                                const uint8_t* mapping,
+                                Scope* classes,
+                                const attribute_hook_t& attr_hook) {
+  init_basic_types();
+  if (attr_hook != nullptr) {
+    return process_jar_entries_serially(location, files, mapping, classes,
+                                        attr_hook);
+  }
+
+  std::vector<jar_entry*> class_files;
+  std::vector<size_t> offsets;
+  size_t total_size = 0;
+  for (auto& file : files) {
+    if (!is_class_entry(file)) continue;
+    class_files.push_back(&file);
+    offsets.push_back(total_size);
+    total_size += file.cd_entry.ucomp_size;
+  }
+  if (class_files.empty()) {
+    return true;
+  }
+  std::unique_ptr<uint8_t[]> outbuffer(new uint8_t[total_size]);
+  auto num_threads = std::min<size_t>(redex_parallel::default_num_threads(),
+                                      class_files.size());
+  std::vector<size_t> indices(class_files.size());
+  std::iota(indices.begin(), indices.end(), 0);
+
+  enum class Status : uint8_t { OK, SKIPPED, FAILED };
+  std::vector<Status> statuses(class_files.size(), Status::OK);
+  std::vector<DexType*> types(class_files.size());
+  {
+    std::vector<std::unique_ptr<Inflater>> inflaters(num_threads);
+    workqueue_run<size_t>(
+        [&](sparta::SpartaWorkerState<size_t>* state, size_t i) {
+          auto& inflater = inflaters[state->worker_id()];
+          if (!inflater) {
+            inflater = std::make_unique<Inflater>();
+          }
+          auto& file = *class_files[i];
+          uint8_t* buffer = outbuffer.get() + offsets[i];
+          if (!decompress_class(file, mapping, *inflater, buffer,
+                                file.cd_entry.ucomp_size) ||
+              !peek_class_type(buffer, &types[i])) {
+            statuses[i] = Status::FAILED;
+          }
+        },
+        indices, num_threads);
+  }
+
+  std::string jar_location(location);
+  std::unordered_set<const DexType*> seen_types;
+  for (size_t i = 0; i < class_files.size(); ++i) {
+    if (statuses[i] == Status::FAILED) {
+      // Like the serial loader, stop at the first broken entry.
+      statuses.resize(i + 1);
+      break;
+    }
+    if (types[i] != nullptr && !seen_types.insert(types[i]).second) {
+      trace_duplicate_jar_class(types[i], jar_location, jar_location);
+      statuses[i] = Status::SKIPPED;
+    }
+  }
+
+  std::vector<std::unique_ptr<ClassCreator>> creators(statuses.size());
+  std::vector<std::exception_ptr> exceptions(statuses.size());
+  indices.resize(statuses.size());
+  workqueue_run<size_t>(
+      [&](size_t i) {
+        if (statuses[i] != Status::OK) {
+          return;
+        }
+        try {
+          if (!parse_class_creator(outbuffer.get() + offsets[i], attr_hook,
+                                   jar_location, &creators[i])) {
+            statuses[i] = Status::FAILED;
+          }
+        } catch (...) {
+          exceptions[i] = std::current_exception();
+        }
+      },
+      indices, num_threads);
+
+  for (size_t i = 0; i < statuses.size(); ++i) {
+    if (exceptions[i]) {
+      std::rethrow_exception(exceptions[i]);
+    }
+    if (statuses[i] == Status::FAILED) {
+      return false;
+    }
+    if (creators[i]) {
+      publish_class(*creators[i], classes);
+    }
+  }
   return true;
 }
 
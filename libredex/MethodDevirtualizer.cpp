@@ -7,12 +7,15 @@
 
 #include "MethodDevirtualizer.h"
 
+#include <numeric>
+
 #include "MethodOverrideGraph.h"
 #include "Mutators.h"
 #include "Resolver.h"
 #include "Show.h"
 #include "Trace.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 namespace mog = method_override_graph;
 
@@ -53,11 +56,15 @@ void patch_call_site(DexMethod* callee,
   method_inst->set_method(callee);
 }
 
-void fix_call_sites(const std::vector<DexClass*>& scope,
-                    const std::unordered_set<DexMethod*>& target_methods,
-                    DevirtualizerMetrics& metrics,
-                    bool drop_this = false) {
-  const auto fixer = [&target_methods, drop_this](DexMethod* m) -> CallCounter {
+/*
+ * Rewrites the call sites of all the groups of methods in one walk. The
+ * groups are tried in order, as if each was rewritten by its own walk.
+ */
+void fix_call_sites(
+    const std::vector<DexClass*>& scope,
+    const std::vector<MethodDevirtualizer::StaticizedMethods>& groups,
+    DevirtualizerMetrics& metrics) {
+  const auto fixer = [&groups](DexMethod* m) -> CallCounter {
     CallCounter call_counter;
     IRCode* code = m->get_code();
     if (code == nullptr) {
@@ -70,9 +77,19 @@ void fix_call_sites(const std::vector<DexClass*>& scope,
         continue;
       }
 
-      MethodSearch type = drop_this ? MethodSearch::Any : MethodSearch::Virtual;
-      auto method = resolve_method(insn->get_method(), type);
-      if (method == nullptr || !target_methods.count(method)) {
+      DexMethod* method = nullptr;
+      bool drop_this = false;
+      for (const auto& group : groups) {
+        MethodSearch type =
+            group.drop_this ? MethodSearch::Any : MethodSearch::Virtual;
+        auto resolved = resolve_method(insn->get_method(), type);
+        if (resolved != nullptr && group.methods->count(resolved)) {
+          method = resolved;
+          drop_this = group.drop_this;
+          break;
+        }
+      }
+      if (method == nullptr) {
         continue;
       }
 
@@ -177,84 +194,95 @@ void MethodDevirtualizer::verify_and_split(
     const std::vector<DexMethod*>& candidates,
     std::unordered_set<DexMethod*>& using_this,
     std::unordered_set<DexMethod*>& not_using_this) {
-  for (const auto m : candidates) {
-    if (!m_config.ignore_keep && !can_rename(m)) {
-      TRACE(VIRT, 2, "failed to devirt method %s: keep", SHOW(m));
-      continue;
-    }
-    if (m->is_external() || is_abstract(m) || is_native(m)) {
-      TRACE(VIRT,
-            2,
-            "failed to devirt method %s: external %d, abstract %d, native %d",
-            SHOW(m),
-            m->is_external(),
-            is_abstract(m),
-            is_native(m));
-      continue;
-    }
-    if (uses_this(m)) {
-      using_this.insert(m);
-    } else {
-      not_using_this.insert(m);
+  enum Verdict : uint8_t { REJECTED, USING_THIS, NOT_USING_THIS };
+  std::vector<Verdict> verdicts(candidates.size(), REJECTED);
+  std::vector<size_t> indices(candidates.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  workqueue_run<size_t>(
+      [&](size_t i) {
+        auto m = candidates[i];
+        if (!m_config.ignore_keep && !can_rename(m)) {
+          TRACE(VIRT, 2, "failed to devirt method %s: keep", SHOW(m));
+          return;
+        }
+        if (m->is_external() || is_abstract(m) || is_native(m)) {
+          TRACE(VIRT,
+                2,
+                "failed to devirt method %s: external %d, abstract %d, "
+                "native %d",
+                SHOW(m),
+                m->is_external(),
+                is_abstract(m),
+                is_native(m));
+          return;
+        }
+        verdicts[i] = uses_this(m) ? USING_THIS : NOT_USING_THIS;
+      },
+      indices);
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    if (verdicts[i] == USING_THIS) {
+      using_this.insert(candidates[i]);
+    } else if (verdicts[i] == NOT_USING_THIS) {
+      not_using_this.insert(candidates[i]);
     }
   }
 }
 
-void MethodDevirtualizer::staticize_methods_not_using_this(
-    const std::vector<DexClass*>& scope,
-    const std::unordered_set<DexMethod*>& methods) {
-  fix_call_sites(scope, methods, m_metrics, true /* drop_this */);
-  make_methods_static(methods, false);
-  TRACE(VIRT, 1, "Staticized %lu methods not using this", methods.size());
-  m_metrics.num_methods_not_using_this += methods.size();
-}
-
-void MethodDevirtualizer::staticize_methods_using_this(
+void MethodDevirtualizer::staticize_methods(
     const std::vector<DexClass*>& scope,
-    const std::unordered_set<DexMethod*>& methods) {
-  fix_call_sites(scope, methods, m_metrics, false /* drop_this */);
-  make_methods_static(methods, true);
-  TRACE(VIRT, 1, "Staticized %lu methods using this", methods.size());
-  m_metrics.num_methods_using_this += methods.size();
+    const std::vector<StaticizedMethods>& groups) {
+  fix_call_sites(scope, groups, m_metrics);
+  for (const auto& group : groups) {
+    make_methods_static(*group.methods, !group.drop_this);
+    if (group.drop_this) {
+      TRACE(VIRT, 1, "Staticized %lu methods not using this",
+            group.methods->size());
+      m_metrics.num_methods_not_using_this += group.methods->size();
+    } else {
+      TRACE(VIRT, 1, "Staticized %lu methods using this",
+            group.methods->size());
+      m_metrics.num_methods_using_this += group.methods->size();
+    }
+  }
 }
 
 DevirtualizerMetrics MethodDevirtualizer::devirtualize_methods(
     const Scope& scope, const std::vector<DexClass*>& target_classes) {
   reset_metrics();
+  // The direct methods are gathered up front too: staticizing the virtual
+  // ones doesn't change which direct methods qualify.
   auto vmethods = get_devirtualizable_vmethods(scope, target_classes);
-  std::unordered_set<DexMethod*> using_this, not_using_this;
-  verify_and_split(vmethods, using_this, not_using_this);
+  auto dmethods = get_devirtualizable_dmethods(scope, target_classes);
+  std::unordered_set<DexMethod*> vmethods_using_this, vmethods_not_using_this;
+  verify_and_split(vmethods, vmethods_using_this, vmethods_not_using_this);
   TRACE(VIRT,
         2,
         " VIRT to devirt vmethods using this %lu, not using this %lu",
-        using_this.size(),
-        not_using_this.size());
+        vmethods_using_this.size(),
+        vmethods_not_using_this.size());
+  std::unordered_set<DexMethod*> dmethods_using_this, dmethods_not_using_this;
+  verify_and_split(dmethods, dmethods_using_this, dmethods_not_using_this);
+  TRACE(VIRT,
+        2,
+        " VIRT to devirt dmethods using this %lu, not using this %lu",
+        dmethods_using_this.size(),
+        dmethods_not_using_this.size());
 
+  // In the order in which they used to be staticized one after the other.
+  std::vector<StaticizedMethods> groups;
   if (m_config.vmethods_not_using_this) {
-    staticize_methods_not_using_this(scope, not_using_this);
+    groups.push_back({&vmethods_not_using_this, /* drop_this */ true});
   }
-
   if (m_config.vmethods_using_this) {
-    staticize_methods_using_this(scope, using_this);
+    groups.push_back({&vmethods_using_this, /* drop_this */ false});
   }
-
-  auto dmethods = get_devirtualizable_dmethods(scope, target_classes);
-  using_this.clear();
-  not_using_this.clear();
-  verify_and_split(dmethods, using_this, not_using_this);
-  TRACE(VIRT,
-        2,
-        " VIRT to devirt dmethods using this %lu, not using this %lu",
-        using_this.size(),
-        not_using_this.size());
-
   if (m_config.dmethods_not_using_this) {
-    staticize_methods_not_using_this(scope, not_using_this);
+    groups.push_back({&dmethods_not_using_this, /* drop_this */ true});
   }
-
   if (m_config.dmethods_using_this) {
-    staticize_methods_using_this(scope, using_this);
+    groups.push_back({&dmethods_using_this, /* drop_this */ false});
   }
+  staticize_methods(scope, groups);
 
   return m_metrics;
 }
@@ -45,19 +45,23 @@ class MethodDevirtualizer {
   DevirtualizerMetrics devirtualize_methods(
       const Scope& scope, const std::vector<DexClass*>& target_classes);
 
+  // Methods to staticize. Whether they drop `this` tells how their call sites
+  // are rewritten.
+  struct StaticizedMethods {
+    const std::unordered_set<DexMethod*>* methods;
+    bool drop_this;
+  };
+
  private:
   DevirtualizerConfigs m_config;
   DevirtualizerMetrics m_metrics;
 
   void reset_metrics() { m_metrics = DevirtualizerMetrics(); }
 
-  void staticize_methods_using_this(
-      const std::vector<DexClass*>& scope,
-      const std::unordered_set<DexMethod*>& methods);
-
-  void staticize_methods_not_using_this(
-      const std::vector<DexClass*>& scope,
-      const std::unordered_set<DexMethod*>& methods);
+  // Rewrites the call sites of all the groups in one walk over the scope,
+  // then makes the methods static.
+  void staticize_methods(const std::vector<DexClass*>& scope,
+                         const std::vector<StaticizedMethods>& groups);
 
   void verify_and_split(const std::vector<DexMethod*>& candidates,
                         std::unordered_set<DexMethod*>& using_this,
@@ -10,10 +10,13 @@
 #include <boost/algorithm/string.hpp>
 #include <fstream>
 #include <iostream>
+#include <numeric>
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "RedexMappedFile.h"
 #include "Show.h"
+#include "WorkQueue.h"
 
 using namespace method_profiles;
 
@@ -167,8 +170,10 @@ bool MethodProfiles::parse_main(std::string& line) {
       // the file)
       return true;
     case NAME:
-      ref = DexMethod::get_method</*kCheckFormat=*/true>(tok);
-      if (ref == nullptr) {
+      if (m_resolve) {
+        ref = DexMethod::get_method</*kCheckFormat=*/true>(tok);
+      }
+      if (ref == nullptr && m_resolve) {
         TRACE(METH_PROF, 6, "failed to resolve %s", tok);
       }
       return true;
@@ -498,3 +503,247 @@ bool dexmethods_profiled_comparator::operator()(DexMethod* a, DexMethod* b) {
 
   return m_initial_order.at(a) < m_initial_order.at(b);
 }
+
+namespace {
+
+/*
+ * The binary format, in host byte order:
+ *
+ *   BinaryHeader header
+ *   BinaryInteraction interactions[header.num_interactions]
+ *   BinaryRecord records[header.num_records]
+ *   char strings[header.strings_size]
+ *
+ * Names are offsets of NUL-terminated strings in `strings`.
+ */
+constexpr uint32_t BINARY_MAGIC = 0x3150504d; // "MPP1"
+
+struct BinaryHeader {
+  uint32_t magic;
+  uint32_t num_interactions;
+  uint32_t num_records;
+  uint32_t strings_size;
+};
+
+struct BinaryInteraction {
+  uint32_t name;
+  uint32_t has_count;
+  uint32_t count;
+  uint32_t reserved;
+};
+
+struct BinaryRecord {
+  double appear_percent;
+  double call_count;
+  double order_percent;
+  uint32_t name;
+  uint16_t interaction;
+  int16_t min_api_level;
+};
+
+static_assert(sizeof(BinaryRecord) == 32, "unexpected padding");
+
+// Formats a row the way parse_main reads it, for rows that do not resolve.
+std::string make_line(const char* name, const Stats& stats) {
+  char buf[128];
+  snprintf(buf, sizeof(buf), ",%.17g,0,%.17g,0,%.17g,%d", stats.appear_percent,
+           stats.call_count, stats.order_percent, stats.min_api_level);
+  return std::string("0,") + name + buf;
+}
+
+} // namespace
+
+bool MethodProfiles::is_binary_file(const std::string& filename) {
+  std::ifstream ifs(filename, std::ios::binary);
+  uint32_t magic = 0;
+  ifs.read((char*)&magic, sizeof(magic));
+  return ifs.good() && magic == BINARY_MAGIC;
+}
+
+bool MethodProfiles::parse_binary_file(const std::string& filename) {
+  TRACE(METH_PROF, 3, "input binary filename: %s", filename.c_str());
+  auto mapped_file = RedexMappedFile::open(filename);
+  const char* data = mapped_file.const_data();
+  BinaryHeader header;
+  if (mapped_file.size() < sizeof(header)) {
+    std::cerr << "FAILED to read the header of " << filename << std::endl;
+    return false;
+  }
+  memcpy(&header, data, sizeof(header));
+  const auto* interactions =
+      (const BinaryInteraction*)(data + sizeof(header));
+  const auto* records =
+      (const BinaryRecord*)(interactions + header.num_interactions);
+  const char* strings = (const char*)(records + header.num_records);
+  if (sizeof(header) +
+          (uint64_t)header.num_interactions * sizeof(BinaryInteraction) +
+          (uint64_t)header.num_records * sizeof(BinaryRecord) +
+          header.strings_size !=
+      mapped_file.size()) {
+    std::cerr << "FAILED to parse " << filename << ": truncated" << std::endl;
+    return false;
+  }
+  if (header.strings_size == 0 || strings[header.strings_size - 1] != '\0') {
+    std::cerr << "FAILED to parse " << filename << ": bad strings" << std::endl;
+    return false;
+  }
+  auto get_string = [&](uint32_t offset) {
+    always_assert_log(offset < header.strings_size, "bad string offset %u",
+                      offset);
+    return strings + offset;
+  };
+
+  std::vector<std::string> interaction_ids;
+  for (uint32_t i = 0; i < header.num_interactions; ++i) {
+    interaction_ids.emplace_back(get_string(interactions[i].name));
+    if (interactions[i].has_count) {
+      m_interaction_counts.emplace(interaction_ids.back(),
+                                   interactions[i].count);
+    }
+  }
+
+  // Resolving the names dominates, and only needs the global context.
+  constexpr size_t CHUNK_SIZE = 1024;
+  std::vector<DexMethodRef*> refs(header.num_records, nullptr);
+  std::vector<size_t> chunks((header.num_records + CHUNK_SIZE - 1) /
+                             CHUNK_SIZE);
+  std::iota(chunks.begin(), chunks.end(), 0);
+  workqueue_run<size_t>(
+      [&](size_t chunk) {
+        auto end = std::min<size_t>((chunk + 1) * CHUNK_SIZE,
+                                    header.num_records);
+        for (size_t i = chunk * CHUNK_SIZE; i < end; ++i) {
+          refs[i] = DexMethod::get_method</*kCheckFormat=*/true>(
+              get_string(records[i].name));
+        }
+      },
+      chunks);
+
+  for (uint32_t i = 0; i < header.num_records; ++i) {
+    const auto& record = records[i];
+    always_assert_log(record.interaction < interaction_ids.size(),
+                      "bad interaction %u", record.interaction);
+    const auto& interaction_id = interaction_ids[record.interaction];
+    Stats stats;
+    stats.appear_percent = record.appear_percent;
+    stats.call_count = record.call_count;
+    stats.order_percent = record.order_percent;
+    stats.min_api_level = record.min_api_level;
+    if (refs[i] != nullptr) {
+      m_method_stats[interaction_id].emplace(refs[i], stats);
+    } else {
+      const char* name = get_string(record.name);
+      TRACE(METH_PROF, 6, "failed to resolve %s", name);
+      m_unresolved_lines[interaction_id].push_back(make_line(name, stats));
+    }
+  }
+
+  TRACE(METH_PROF, 1,
+        "MethodProfiles successfully parsed %zu rows; %zu unresolved lines",
+        size(), unresolved_size());
+  return true;
+}
+
+bool MethodProfiles::write_binary_file(
+    const std::vector<std::string>& csv_filenames,
+    const std::string& binary_filename) {
+  MethodProfiles profiles;
+  profiles.m_resolve = false;
+  for (const std::string& csv_filename : csv_filenames) {
+    profiles.m_interaction_id = "";
+    profiles.m_mode = NONE;
+    if (!profiles.parse_stats_file(csv_filename)) {
+      return false;
+    }
+  }
+
+  std::string strings;
+  auto add_string = [&](const std::string& str) {
+    uint32_t offset = strings.size();
+    strings.append(str);
+    strings.push_back('\0');
+    return offset;
+  };
+  // Keeps the string table non-empty.
+  add_string("");
+  std::vector<BinaryInteraction> interactions;
+  std::unordered_map<std::string, uint16_t> interaction_indices;
+  auto add_interaction = [&](const std::string& interaction_id) {
+    auto it = interaction_indices.find(interaction_id);
+    if (it != interaction_indices.end()) {
+      return it->second;
+    }
+    always_assert(interactions.size() <= std::numeric_limits<uint16_t>::max());
+    BinaryInteraction interaction{add_string(interaction_id), 0, 0, 0};
+    auto count = profiles.get_interaction_count(interaction_id);
+    if (count) {
+      interaction.has_count = 1;
+      interaction.count = *count;
+    }
+    uint16_t index = interactions.size();
+    interactions.push_back(interaction);
+    interaction_indices.emplace(interaction_id, index);
+    return index;
+  };
+  // Sorted, so that the output does not depend on hashing.
+  std::map<std::string, std::vector<std::string>*> lines;
+  for (auto& pair : profiles.m_unresolved_lines) {
+    lines.emplace(pair.first, &pair.second);
+  }
+  for (const auto& pair : lines) {
+    add_interaction(pair.first);
+  }
+  std::set<std::string> counted;
+  for (const auto& pair : profiles.m_interaction_counts) {
+    counted.insert(pair.first);
+  }
+  for (const auto& interaction_id : counted) {
+    add_interaction(interaction_id);
+  }
+
+  std::vector<BinaryRecord> records;
+  for (auto& pair : lines) {
+    uint16_t interaction = add_interaction(pair.first);
+    for (auto& line : *pair.second) {
+      BinaryRecord record{0, 0, 0, 0, interaction, 0};
+      auto parse_cell = [&](char* tok, uint32_t col) -> bool {
+        switch (col) {
+        case NAME:
+          record.name = add_string(tok);
+          break;
+        case APPEAR100:
+          record.appear_percent = parse_double(tok);
+          break;
+        case AVG_CALL:
+          record.call_count = parse_double(tok);
+          break;
+        case AVG_RANK100:
+          record.order_percent = parse_double(tok);
+          break;
+        case MIN_API_LEVEL:
+          record.min_api_level = static_cast<int16_t>(parse_int(tok));
+          break;
+        default:
+          break;
+        }
+        return true;
+      };
+      parse_cells(line, parse_cell);
+      records.push_back(record);
+    }
+  }
+
+  std::ofstream ofs(binary_filename, std::ios::binary);
+  BinaryHeader header{BINARY_MAGIC, (uint32_t)interactions.size(),
+                      (uint32_t)records.size(), (uint32_t)strings.size()};
+  ofs.write((const char*)&header, sizeof(header));
+  ofs.write((const char*)interactions.data(),
+            interactions.size() * sizeof(BinaryInteraction));
+  ofs.write((const char*)records.data(), records.size() * sizeof(BinaryRecord));
+  ofs.write(strings.data(), strings.size());
+  if (!ofs.good()) {
+    std::cerr << "FAILED to write " << binary_filename << std::endl;
+    return false;
+  }
+  return true;
+}
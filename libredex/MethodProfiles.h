@@ -65,7 +65,9 @@ class MethodProfiles {
     for (const std::string& csv_filename : csv_filenames) {
       m_interaction_id = "";
       m_mode = NONE;
-      bool success = parse_stats_file(csv_filename);
+      bool success = is_binary_file(csv_filename)
+                         ? parse_binary_file(csv_filename)
+                         : parse_stats_file(csv_filename);
       always_assert_log(success,
                         "Failed to parse %s. See stderr for more details",
                         csv_filename.c_str());
@@ -128,6 +130,12 @@ class MethodProfiles {
   // Try to resolve previously unresolved lines
   void process_unresolved_lines();
 
+  // Converts csv files to the binary format, which initialize() also accepts
+  // and which loads much faster. The methods are not resolved, so this
+  // needs no dexes.
+  static bool write_binary_file(const std::vector<std::string>& csv_filenames,
+                                const std::string& binary_filename);
+
  private:
   AllInteractions m_method_stats;
   // Resolution may fail because of renaming or generated methods. Store the
@@ -144,6 +152,9 @@ class MethodProfiles {
   // The interaction id from the metadata at the top of the file
   std::string m_interaction_id;
   bool m_initialized{false};
+  // False while converting to the binary format, which keeps all rows as
+  // unresolved lines.
+  bool m_resolve{true};
 
   // Read a "simple" csv file (no quoted commas or extra spaces) and populate
   // m_method_stats
@@ -159,6 +170,10 @@ class MethodProfiles {
 
   // Parse the first line and make sure it matches our expectations
   bool parse_header(std::string& line);
+
+  static bool is_binary_file(const std::string& filename);
+  // Map a binary profile and resolve its rows in parallel
+  bool parse_binary_file(const std::string& filename);
 };
 
 // NOTE: Do not use this comparator directly in `std::sort` calls, as it is
@@ -7,12 +7,75 @@
 
 #include "MethodSimilarityOrderer.h"
 
+#include <array>
+#include <boost/functional/hash.hpp>
+#include <boost/optional.hpp>
+#include <limits>
+#include <numeric>
+#include <set>
+
 #include "DexInstruction.h"
 #include "Show.h"
 #include "Trace.h"
+#include "WorkQueue.h"
+
+namespace {
+
+// The number of hash functions of a MinHash signature, and how many of them
+// form a band. Two methods are candidates for each other when all the
+// minimums in one of their bands agree.
+constexpr size_t MIN_HASHES = 16;
+constexpr size_t BAND_ROWS = 2;
+constexpr size_t BANDS = MIN_HASHES / BAND_ROWS;
+
+// A candidate must agree with the previously chosen method on at least that
+// many minimums, i.e. have an estimated Jaccard similarity of about 0.45.
+// This is roughly where the score of the exact mode turns negative for
+// methods of similar size.
+constexpr size_t MIN_SIMILAR_HASHES = 7;
+
+// Only the first candidates of each band are scored, so that large groups of
+// similar methods don't make the ordering quadratic.
+constexpr size_t MAX_BAND_CANDIDATES = 32;
+
+using Signature = std::array<uint64_t, MIN_HASHES>;
+using BandKeys = std::array<size_t, BANDS>;
+
+// The finalizer of splitmix64; each hash function mixes in its own offset.
+uint64_t mix(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+size_t count_similar_hashes(const Signature& a, const Signature& b) {
+  size_t count = 0;
+  for (size_t i = 0; i < MIN_HASHES; ++i) {
+    count += a[i] == b[i];
+  }
+  return count;
+}
+
+} // namespace
 
 void MethodSimilarityOrderer::gather_code_hash_ids(
     const DexCode* code, std::unordered_set<CodeHashId>& code_hash_ids) {
+  std::vector<uint64_t> code_hashes;
+  gather_code_hashes(code, code_hashes);
+  for (auto code_hash : code_hashes) {
+    auto it = m_code_hash_ids.find(code_hash);
+    if (it == m_code_hash_ids.end()) {
+      it = m_code_hash_ids.emplace(code_hash, m_code_hash_ids.size()).first;
+    }
+    code_hash_ids.insert(it->second);
+  }
+}
+
+void MethodSimilarityOrderer::gather_code_hashes(
+    const DexCode* code, std::vector<uint64_t>& code_hashes) {
   auto& instructions = code->get_instructions();
 
   // First, we partition the instructions into chunks, where each chunk ends
@@ -55,11 +118,7 @@ void MethodSimilarityOrderer::gather_code_hash_ids(
         code_hash = code_hash * 17 + insn->src(j);
       }
     }
-    auto it = m_code_hash_ids.find(code_hash);
-    if (it == m_code_hash_ids.end()) {
-      it = m_code_hash_ids.emplace(code_hash, m_code_hash_ids.size()).first;
-    }
-    code_hash_ids.insert(it->second);
+    code_hashes.push_back(code_hash);
   };
 
   // We'll further partition chunks into smaller pieces, and then hash those
@@ -188,3 +247,113 @@ DexMethod* MethodSimilarityOrderer::get_next() {
   }
   return best_candidate_method;
 }
+
+void MethodSimilarityOrderer::order_by_minhash(
+    std::vector<DexMethod*>& methods) {
+  size_t size = methods.size();
+  // As in the exact mode, methods of perf sensitive classes and methods
+  // without code get no signature; they keep their place in the original
+  // order.
+  std::vector<Signature> signatures(size);
+  std::vector<BandKeys> band_keys(size);
+  std::vector<char> has_signature(size, 0);
+  std::vector<size_t> indices(size);
+  std::iota(indices.begin(), indices.end(), 0);
+  workqueue_run<size_t>(
+      [&](size_t i) {
+        auto* method = methods[i];
+        if (type_class(method->get_class())->is_perf_sensitive()) {
+          return;
+        }
+        auto* code = method->get_dex_code();
+        if (code == nullptr) {
+          return;
+        }
+        std::vector<uint64_t> code_hashes;
+        gather_code_hashes(code, code_hashes);
+        if (code_hashes.empty()) {
+          return;
+        }
+        auto& signature = signatures[i];
+        signature.fill(std::numeric_limits<uint64_t>::max());
+        for (auto code_hash : code_hashes) {
+          for (size_t k = 0; k < MIN_HASHES; ++k) {
+            signature[k] = std::min(
+                signature[k], mix(code_hash + k * 0x9e3779b97f4a7c15ULL));
+          }
+        }
+        for (size_t b = 0; b < BANDS; ++b) {
+          size_t key = b;
+          for (size_t r = 0; r < BAND_ROWS; ++r) {
+            boost::hash_combine(key, signature[b * BAND_ROWS + r]);
+          }
+          band_keys[i][b] = key;
+        }
+        has_signature[i] = 1;
+      },
+      indices);
+
+  // Members of each band bucket, in original order.
+  std::unordered_map<size_t, std::set<size_t>> buckets;
+  for (size_t i = 0; i < size; ++i) {
+    if (has_signature[i]) {
+      for (auto key : band_keys[i]) {
+        buckets[key].insert(i);
+      }
+    }
+  }
+
+  std::vector<DexMethod*> ordered;
+  ordered.reserve(size);
+  std::vector<char> taken(size, 0);
+  size_t first_remaining = 0;
+  boost::optional<size_t> last;
+  while (ordered.size() < size) {
+    while (taken[first_remaining]) {
+      ++first_remaining;
+    }
+    boost::optional<size_t> next;
+    if (last && has_signature[first_remaining]) {
+      size_t best_similar_hashes = MIN_SIMILAR_HASHES;
+      for (auto key : band_keys[*last]) {
+        auto& bucket = buckets.at(key);
+        size_t considered = 0;
+        for (auto it = bucket.begin();
+             it != bucket.end() && considered < MAX_BAND_CANDIDATES;
+             ++it, ++considered) {
+          auto candidate = *it;
+          auto similar_hashes =
+              count_similar_hashes(signatures[*last], signatures[candidate]);
+          if (similar_hashes > best_similar_hashes ||
+              (similar_hashes == best_similar_hashes &&
+               (!next || candidate < *next))) {
+            next = candidate;
+            best_similar_hashes = similar_hashes;
+          }
+        }
+      }
+      if (next) {
+        TRACE(OPUT, 3,
+              "[method-similarity-orderer]   selected %s with %zu similar "
+              "hashes",
+              SHOW(methods[*next]), best_similar_hashes);
+      }
+    }
+    if (!next) {
+      next = first_remaining;
+      TRACE(OPUT, 3, "[method-similarity-orderer] reverted to %s",
+            SHOW(methods[*next]));
+    }
+    taken[*next] = 1;
+    ordered.push_back(methods[*next]);
+    if (has_signature[*next]) {
+      for (auto key : band_keys[*next]) {
+        buckets.at(key).erase(*next);
+      }
+      last = *next;
+    } else {
+      last = boost::none;
+    }
+  }
+  methods = std::move(ordered);
+}
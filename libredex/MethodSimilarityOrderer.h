@@ -7,8 +7,10 @@
 
 #pragma once
 
+#include <map>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "DexClass.h"
 
@@ -57,6 +59,11 @@ class MethodSimilarityOrderer {
   void gather_code_hash_ids(const DexCode* code,
                             std::unordered_set<CodeHashId>& code_hash_ids);
 
+  // Gather the (stable) hashes of all instruction sequences (of a certain
+  // size) inside code, in order of appearance
+  static void gather_code_hashes(const DexCode* code,
+                                 std::vector<uint64_t>& code_hashes);
+
  public:
   explicit MethodSimilarityOrderer(const std::vector<DexMethod*>& methods) {
     for (auto* method : methods) {
@@ -66,7 +73,16 @@ class MethodSimilarityOrderer {
 
   DexMethod* get_next();
 
-  static void order(std::vector<DexMethod*>& methods) {
+  /*
+   * When there are at least minhash_min_methods methods (and that number
+   * isn't zero), they are ordered with order_by_minhash instead.
+   */
+  static void order(std::vector<DexMethod*>& methods,
+                    size_t minhash_min_methods = 0) {
+    if (minhash_min_methods > 0 && methods.size() >= minhash_min_methods) {
+      order_by_minhash(methods);
+      return;
+    }
     MethodSimilarityOrderer mso(methods);
     methods.clear();
 
@@ -75,4 +91,14 @@ class MethodSimilarityOrderer {
       methods.push_back(next_method);
     }
   }
+
+  /*
+   * An approximation of the above that scales to large dexes. The similarity
+   * of two methods is estimated from MinHash signatures of their hash id
+   * sets, which are computed in parallel, and the candidates for the next
+   * method are limited to the methods whose signatures share a band with the
+   * previously chosen method (locality-sensitive hashing), instead of all
+   * methods that share any hash id with it.
+   */
+  static void order_by_minhash(std::vector<DexMethod*>& methods);
 };
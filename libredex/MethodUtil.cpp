@@ -68,6 +68,17 @@ bool no_invoke_super(const IRCode& code) {
   return true;
 }
 
+bool has_invoke_of(const IRCode& code, const DexMethodRef* callee) {
+  always_assert(!code.editable_cfg_built());
+  for (const auto& mie : InstructionIterable(code)) {
+    auto insn = mie.insn;
+    if (opcode::is_an_invoke(insn->opcode()) && insn->get_method() == callee) {
+      return true;
+    }
+  }
+  return false;
+}
+
 DexMethod* java_lang_Object_ctor() {
   return static_cast<DexMethod*>(
       DexMethod::make_method("Ljava/lang/Object;.<init>:()V"));
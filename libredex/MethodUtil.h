@@ -50,6 +50,15 @@ bool clinit_may_have_side_effects(const DexClass* cls);
  */
 bool no_invoke_super(const IRCode& code);
 
+/**
+ * Check whether the code invokes the given method. This is a linear scan over
+ * the instructions that doesn't need a cfg, so passes that only handle
+ * methods calling some specific method, e.g. StringBuilder.toString(), can
+ * use it to skip building a cfg and running their analysis on all the other
+ * methods.
+ */
+bool has_invoke_of(const IRCode& code, const DexMethodRef* callee);
+
 /**
  * Determine if the method is a constructor.
  *
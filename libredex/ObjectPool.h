@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#include "FixedSizePool.h"
+
+/*
+ * Pooled allocation for the small objects that make up the IR
+ * (`IRInstruction`, `MethodItemEntry`, `DexPosition`, `SourceBlock`). There
+ * are tens of millions of them, and they are created and destroyed in bulk.
+ *
+ * Each thread carves objects of a given type out of large slabs, in address
+ * order, so that a method's entries and instructions, which are created one
+ * after another, end up next to each other. See sparta::FixedSizePool.
+ *
+ * A type opts in with `REDEX_POOLED_ALLOCATION(T)` in its definition. Pooling
+ * is compiled out under AddressSanitizer, so that use-after-free and leak
+ * checking keep working.
+ */
+
+namespace object_pool {
+
+template <typename T>
+inline void* allocate(size_t size) {
+  return sparta::pooled_allocate<T>(size);
+}
+
+template <typename T>
+inline void deallocate(void* ptr, size_t size) {
+  sparta::pooled_deallocate<T>(ptr, size);
+}
+
+} // namespace object_pool
+
+#define REDEX_POOLED_ALLOCATION(T)                          \
+  static void* operator new(size_t size) {                  \
+    return object_pool::allocate<T>(size);                  \
+  }                                                         \
+  static void* operator new(size_t, void* place) noexcept { \
+    return place;                                           \
+  }                                                         \
+  static void operator delete(void* ptr, size_t size) {     \
+    object_pool::deallocate<T>(ptr, size);                  \
+  }
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "OpcodeScan.h"
+
+#include "ControlFlow.h"
+#include "IRCode.h"
+
+namespace opcode_scan {
+
+namespace {
+
+// Number of opcodes inspected per step. Within a chunk there are no early
+// exits, so the inner loops vectorize; between chunks we stop as soon as
+// we've found a match.
+constexpr size_t CHUNK = 32;
+
+template <typename Iterable>
+void append_opcodes(const Iterable& iterable, std::vector<IROpcode>* out) {
+  for (const auto& mie : iterable) {
+    out->push_back(mie.insn->opcode());
+  }
+}
+
+template <typename Matches>
+bool any_of(const std::vector<IROpcode>& opcodes, const Matches& matches) {
+  const IROpcode* data = opcodes.data();
+  size_t size = opcodes.size();
+  size_t i = 0;
+  for (; i + CHUNK <= size; i += CHUNK) {
+    bool found = false;
+    for (size_t j = 0; j < CHUNK; ++j) {
+      found |= matches(data[i + j]);
+    }
+    if (found) {
+      return true;
+    }
+  }
+  for (; i < size; ++i) {
+    if (matches(data[i])) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename Matches>
+size_t count_if(const std::vector<IROpcode>& opcodes, const Matches& matches) {
+  size_t count = 0;
+  for (auto op : opcodes) {
+    count += matches(op) ? 1 : 0;
+  }
+  return count;
+}
+
+} // namespace
+
+OpcodeArray::OpcodeArray(const IRCode& code) {
+  if (code.editable_cfg_built()) {
+    append_opcodes(cfg::ConstInstructionIterable(code.cfg()), &m_opcodes);
+  } else {
+    // Non-editable CFGs leave the instructions in the IRCode.
+    append_opcodes(InstructionIterable(code), &m_opcodes);
+  }
+}
+
+OpcodeArray::OpcodeArray(const cfg::ControlFlowGraph& cfg) {
+  append_opcodes(cfg::ConstInstructionIterable(cfg), &m_opcodes);
+}
+
+OpcodeArray::OpcodeArray(const cfg::Block& block) {
+  append_opcodes(InstructionIterable(block), &m_opcodes);
+}
+
+bool OpcodeArray::contains(IROpcode op) const {
+  return any_of(m_opcodes, [op](IROpcode other) { return other == op; });
+}
+
+bool OpcodeArray::contains_any(const OpcodeSet& ops) const {
+  const uint8_t* table = ops.table();
+  return any_of(m_opcodes, [table](IROpcode op) { return table[op] != 0; });
+}
+
+size_t OpcodeArray::count(IROpcode op) const {
+  return count_if(m_opcodes, [op](IROpcode other) { return other == op; });
+}
+
+size_t OpcodeArray::count_any(const OpcodeSet& ops) const {
+  const uint8_t* table = ops.table();
+  return count_if(m_opcodes, [table](IROpcode op) { return table[op]; });
+}
+
+} // namespace opcode_scan
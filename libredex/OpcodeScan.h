@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+#include "IROpcode.h"
+
+class IRCode;
+
+namespace cfg {
+class Block;
+class ControlFlowGraph;
+} // namespace cfg
+
+namespace opcode_scan {
+
+constexpr size_t NUM_OPCODES = 0
+#define OP(...) +1
+#define IOP(...) +1
+#define OPRANGE(...)
+#include "IROpcodes.def"
+    ;
+
+/*
+ * A set of opcodes, as a byte table so that membership tests don't need any
+ * bit twiddling in the scan loops below.
+ */
+class OpcodeSet {
+ public:
+  OpcodeSet() = default;
+
+  OpcodeSet(std::initializer_list<IROpcode> ops) {
+    for (auto op : ops) {
+      insert(op);
+    }
+  }
+
+  // All opcodes satisfying `pred`, e.g. `OpcodeSet::of(opcode::is_an_invoke)`.
+  template <typename Predicate>
+  static OpcodeSet of(const Predicate& pred) {
+    OpcodeSet set;
+    for (size_t i = 0; i < NUM_OPCODES; ++i) {
+      if (pred(static_cast<IROpcode>(i))) {
+        set.insert(static_cast<IROpcode>(i));
+      }
+    }
+    return set;
+  }
+
+  OpcodeSet& insert(IROpcode op) {
+    m_members[op] = 1;
+    return *this;
+  }
+
+  bool contains(IROpcode op) const { return m_members[op] != 0; }
+
+  const uint8_t* table() const { return m_members.data(); }
+
+ private:
+  std::array<uint8_t, NUM_OPCODES> m_members{};
+};
+
+/*
+ * The opcodes of a method or block, in order, in one contiguous array.
+ *
+ * Filters that only look at opcodes otherwise chase a pointer per
+ * MethodItemEntry and another per IRInstruction. The queries here run over
+ * plain uint16_t data in branch-free chunks, which compilers vectorize. The
+ * array is a snapshot: build it once for a batch of queries, and don't keep it
+ * across changes to the code.
+ */
+class OpcodeArray {
+ public:
+  // Uses the CFG if one is built.
+  explicit OpcodeArray(const IRCode& code);
+  explicit OpcodeArray(const cfg::ControlFlowGraph& cfg);
+  explicit OpcodeArray(const cfg::Block& block);
+
+  size_t size() const { return m_opcodes.size(); }
+  bool empty() const { return m_opcodes.empty(); }
+  const std::vector<IROpcode>& opcodes() const { return m_opcodes; }
+
+  bool contains(IROpcode op) const;
+  bool contains_any(const OpcodeSet& ops) const;
+  size_t count(IROpcode op) const;
+  size_t count_any(const OpcodeSet& ops) const;
+
+ private:
+  std::vector<IROpcode> m_opcodes;
+};
+
+} // namespace opcode_scan
@@ -7,11 +7,13 @@
 
 #include "OptData.h"
 
+#include <algorithm>
 #include <cstdarg>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <fstream>
+#include <iterator>
 #include <json/value.h>
 #include <mutex>
 #include <string>
@@ -130,12 +132,12 @@ void log_nopt(NoptReason nopt, const DexClass* cls) {
 }
 
 InsnOptData::InsnOptData(const DexMethod* method, const IRInstruction* insn) {
-  m_insn_orig = SHOW(insn);
+  show_to(m_insn_orig, insn);
   m_has_line_num = get_line_num(method, insn, &m_line_num);
 }
 
 MethodOptData::MethodOptData(const DexMethod* method) : m_method(method) {
-  m_method_orig = SHOW(method);
+  show_to(m_method_orig, method);
   m_has_line_num = get_line_num(method, nullptr, &m_line_num);
 }
 
@@ -170,16 +172,114 @@ std::shared_ptr<MethodOptData> ClassOptData::get_meth_opt_data(
   return kv_pair->second;
 }
 
-std::shared_ptr<ClassOptData> OptDataMapper::get_cls_opt_data(
-    DexType* cls_type) {
-  auto cls = type_class(cls_type);
-  const auto& kv_pair = m_cls_opt_map.find(cls);
-  if (kv_pair == m_cls_opt_map.end()) {
-    auto cls_opt_data = std::make_shared<ClassOptData>(cls);
-    m_cls_opt_map.emplace(cls, cls_opt_data);
-    return cls_opt_data;
+OptDataMapper::LogBuffer& OptDataMapper::get_thread_buffer() {
+  // The mapper is a singleton and owns the buffers, so they outlive their
+  // threads.
+  thread_local LogBuffer* buffer = nullptr;
+  if (buffer == nullptr) {
+    std::lock_guard<std::mutex> guard(s_opt_log_mutex);
+    m_buffers.push_back(std::make_unique<LogBuffer>());
+    buffer = m_buffers.back().get();
+  }
+  return *buffer;
+}
+
+bool OptDataMapper::is_sampled(const DexClass* cls) const {
+  return m_sample_rate <= 1 ||
+         boost::hash<std::string>()(cls->get_name()->str()) % m_sample_rate ==
+             0;
+}
+
+bool OptDataMapper::is_sampled(const DexMethod* method) const {
+  if (m_sample_rate <= 1) {
+    return true;
+  }
+  // Overloads are sampled together.
+  size_t seed = boost::hash<std::string>()(method->get_class()->str());
+  boost::hash_combine(seed, method->get_name()->str());
+  return seed % m_sample_rate == 0;
+}
+
+void OptDataMapper::log(bool is_opt,
+                        int reason,
+                        const DexClass* cls,
+                        const DexMethod* method,
+                        const IRInstruction* insn) {
+  auto& buffer = get_thread_buffer();
+  LogRecord record{m_next_seq.fetch_add(1, std::memory_order_relaxed),
+                   reason,
+                   is_opt,
+                   cls,
+                   method,
+                   insn,
+                   nullptr,
+                   nullptr,
+                   nullptr};
+  if (buffer.described.emplace(nullptr, cls).second) {
+    record.cls_opt_data = std::make_shared<ClassOptData>(cls);
+  }
+  if (method != nullptr && buffer.described.emplace(cls, method).second) {
+    record.meth_opt_data = std::make_shared<MethodOptData>(method);
+  }
+  if (insn != nullptr && buffer.described.emplace(method, insn).second) {
+    record.insn_opt_data = std::make_shared<InsnOptData>(method, insn);
+  }
+  buffer.records.push_back(std::move(record));
+}
+
+void OptDataMapper::merge_buffers() {
+  std::vector<LogRecord> records;
+  {
+    std::lock_guard<std::mutex> guard(s_opt_log_mutex);
+    for (auto& buffer : m_buffers) {
+      std::move(buffer->records.begin(), buffer->records.end(),
+                std::back_inserter(records));
+      buffer->records.clear();
+    }
+  }
+  std::sort(records.begin(), records.end(),
+            [](const LogRecord& a, const LogRecord& b) {
+              return a.seq < b.seq;
+            });
+
+  // The first record about anything comes first in its own thread, so it
+  // carries the description.
+  auto get = [](auto& map, auto key, auto& data) {
+    auto it = map.find(key);
+    if (it == map.end()) {
+      always_assert(data != nullptr);
+      it = map.emplace(key, std::move(data)).first;
+    }
+    return it->second;
+  };
+  for (auto& record : records) {
+    auto cls_opt_data = get(m_cls_opt_map, record.cls, record.cls_opt_data);
+    if (record.method == nullptr) {
+      if (record.is_opt) {
+        cls_opt_data->m_opts.emplace_back((OptReason)record.reason);
+      } else {
+        cls_opt_data->m_nopts.emplace_back((NoptReason)record.reason);
+      }
+      continue;
+    }
+    auto meth_opt_data = get(cls_opt_data->m_meth_opt_map, record.method,
+                             record.meth_opt_data);
+    if (record.insn == nullptr) {
+      if (record.is_opt) {
+        meth_opt_data->m_opts.emplace_back((OptReason)record.reason);
+      } else {
+        meth_opt_data->m_nopts.emplace_back((NoptReason)record.reason);
+      }
+      continue;
+    }
+    auto insn_opt_data = get(meth_opt_data->m_insn_opt_map, record.insn,
+                             record.insn_opt_data);
+    if (record.is_opt) {
+      insn_opt_data->m_opts.emplace_back((OptReason)record.reason);
+    } else {
+      insn_opt_data->m_nopts.emplace_back((NoptReason)record.reason);
+    }
   }
-  return kv_pair->second;
 }
 
 void OptDataMapper::log_opt(OptReason opt,
@@ -188,13 +288,12 @@ void OptDataMapper::log_opt(OptReason opt,
   if (!m_logs_enabled) {
     return;
   }
-  std::lock_guard<std::mutex> guard(s_opt_log_mutex);
   always_assert_log(method != nullptr, "Can't log null method\n");
   always_assert_log(insn != nullptr, "Can't log null instruction\n");
-  auto cls_opt_data = get_cls_opt_data(method->get_class());
-  auto meth_opt_data = cls_opt_data->get_meth_opt_data(method);
-  auto insn_opt_data = meth_opt_data->get_insn_opt_data(insn);
-  insn_opt_data->m_opts.emplace_back(opt);
+  if (!is_sampled(method)) {
+    return;
+  }
+  log(true, opt, type_class(method->get_class()), method, insn);
 }
 
 void OptDataMapper::log_nopt(NoptReason nopt,
@@ -203,55 +302,56 @@ void OptDataMapper::log_nopt(NoptReason nopt,
   if (!m_logs_enabled) {
     return;
   }
-  std::lock_guard<std::mutex> guard(s_opt_log_mutex);
   always_assert_log(method != nullptr, "Can't log null method\n");
   always_assert_log(insn != nullptr, "Can't log null instruction\n");
-  auto cls_opt_data = get_cls_opt_data(method->get_class());
-  auto meth_opt_data = cls_opt_data->get_meth_opt_data(method);
-  auto insn_opt_data = meth_opt_data->get_insn_opt_data(insn);
-  insn_opt_data->m_nopts.emplace_back(nopt);
+  if (!is_sampled(method)) {
+    return;
+  }
+  log(false, nopt, type_class(method->get_class()), method, insn);
 }
 
 void OptDataMapper::log_opt(OptReason opt, const DexMethod* method) {
   if (!m_logs_enabled) {
     return;
   }
-  std::lock_guard<std::mutex> guard(s_opt_log_mutex);
   always_assert_log(method != nullptr, "Can't log null method\n");
-  auto cls_opt_data = get_cls_opt_data(method->get_class());
-  auto meth_opt_data = cls_opt_data->get_meth_opt_data(method);
-  meth_opt_data->m_opts.emplace_back(opt);
+  if (!is_sampled(method)) {
+    return;
+  }
+  log(true, opt, type_class(method->get_class()), method, nullptr);
 }
 
 void OptDataMapper::log_nopt(NoptReason nopt, const DexMethod* method) {
   if (!m_logs_enabled) {
     return;
   }
-  std::lock_guard<std::mutex> guard(s_opt_log_mutex);
   always_assert_log(method != nullptr, "Can't log null method\n");
-  auto cls_opt_data = get_cls_opt_data(method->get_class());
-  auto meth_opt_data = cls_opt_data->get_meth_opt_data(method);
-  meth_opt_data->m_nopts.emplace_back(nopt);
+  if (!is_sampled(method)) {
+    return;
+  }
+  log(false, nopt, type_class(method->get_class()), method, nullptr);
 }
 
 void OptDataMapper::log_opt(OptReason opt, const DexClass* cls) {
   if (!m_logs_enabled) {
     return;
   }
-  std::lock_guard<std::mutex> guard(s_opt_log_mutex);
   always_assert_log(cls != nullptr, "Can't log null class\n");
-  auto cls_opt_data = get_cls_opt_data(cls->get_type());
-  cls_opt_data->m_opts.emplace_back(opt);
+  if (!is_sampled(cls)) {
+    return;
+  }
+  log(true, opt, type_class(cls->get_type()), nullptr, nullptr);
 }
 
 void OptDataMapper::log_nopt(NoptReason nopt, const DexClass* cls) {
   if (!m_logs_enabled) {
     return;
   }
-  std::lock_guard<std::mutex> guard(s_opt_log_mutex);
   always_assert_log(cls != nullptr, "Can't log null class\n");
-  auto cls_opt_data = get_cls_opt_data(cls->get_type());
-  cls_opt_data->m_nopts.emplace_back(nopt);
+  if (!is_sampled(cls)) {
+    return;
+  }
+  log(false, nopt, type_class(cls->get_type()), nullptr, nullptr);
 }
 
 Json::Value OptDataMapper::serialize_sql() {
@@ -266,6 +366,7 @@ Json::Value OptDataMapper::serialize_sql() {
   constexpr const char* CLASSES = "classes";
   constexpr const char* OPT_MESSAGES = "opt_messages";
   constexpr const char* NOPT_MESSAGES = "nopt_messages";
+  merge_buffers();
   Json::Value top;
 
   Json::Value opt_msg_arr;
@@ -7,10 +7,15 @@
 
 #pragma once
 
+#include <atomic>
+#include <boost/functional/hash.hpp>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "DexClass.h"
 #include "IRInstruction.h"
@@ -142,9 +147,14 @@ class OptDataMapper {
   void operator=(OptDataMapper const&) = delete;
 
   /**
-   * Enable logging for the rest of this build.
+   * Enable logging for the rest of this build. With a sample rate of N > 1,
+   * only the decisions about roughly one in N classes and methods are kept,
+   * chosen by name so that all decisions about a method stay together.
    */
-  void enable_logs() { m_logs_enabled = true; };
+  void enable_logs(uint32_t sample_rate = 1) {
+    m_sample_rate = sample_rate;
+    m_logs_enabled = true;
+  };
 
   /**
    * Records the given opt and attributes it to the given class/method/insn.
@@ -173,11 +183,58 @@ class OptDataMapper {
    *    specific {level}_id.
    *  - classes/methods/instructions contain basic information: a unique id,
    *    names, and in the case of instructions, the instruction itself.
+   *
+   * No other thread may log concurrently.
    */
   Json::Value serialize_sql();
 
  private:
+  /**
+   * A logged decision. Classes, methods and instructions are described when
+   * they are logged, as the IR changes later on, but only in the first record
+   * of each thread that refers to them.
+   */
+  struct LogRecord {
+    uint64_t seq;
+    int reason;
+    bool is_opt;
+    const DexClass* cls;
+    const DexMethod* method;
+    const IRInstruction* insn;
+    std::shared_ptr<ClassOptData> cls_opt_data;
+    std::shared_ptr<MethodOptData> meth_opt_data;
+    std::shared_ptr<InsnOptData> insn_opt_data;
+  };
+
+  /**
+   * The records of one thread. Logging only appends to the buffer of the
+   * current thread, without locking; the buffers are merged into
+   * m_cls_opt_map by serialize_sql().
+   */
+  struct LogBuffer {
+    std::vector<LogRecord> records;
+    // (nullptr, class), (class, method) and (method, insn) pairs that this
+    // thread has described.
+    std::unordered_set<std::pair<const void*, const void*>,
+                       boost::hash<std::pair<const void*, const void*>>>
+        described;
+  };
+
+  LogBuffer& get_thread_buffer();
+  bool is_sampled(const DexClass* cls) const;
+  bool is_sampled(const DexMethod* method) const;
+  void log(bool is_opt,
+           int reason,
+           const DexClass* cls,
+           const DexMethod* method,
+           const IRInstruction* insn);
+  void merge_buffers();
+
   bool m_logs_enabled{false};
+  uint32_t m_sample_rate{1};
+  std::atomic<uint64_t> m_next_seq{0};
+  // Guarded by s_opt_log_mutex.
+  std::vector<std::unique_ptr<LogBuffer>> m_buffers;
   std::unordered_map<const DexClass*, std::shared_ptr<ClassOptData>>
       m_cls_opt_map;
   std::unordered_map<int /*OptReason*/, std::string> m_opt_msg_map;
@@ -188,12 +245,6 @@ class OptDataMapper {
     init_nopt_messages();
   }
 
-  /**
-   * Finds and returns a ClassOptData for the given class type. If the
-   * ClassOptData doesn't yet exist, construct it and return.
-   */
-  std::shared_ptr<ClassOptData> get_cls_opt_data(DexType* cls_type);
-
   /**
    * For the table {msg_type}_messages, append each row as an entry to arr.
    */
@@ -8,13 +8,21 @@
 #include "PassManager.h"
 #include "DexAssessments.h"
 
+#include <atomic>
+#include <boost/core/demangle.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/functional/hash.hpp>
+#include <chrono>
 #include <cinttypes>
+#include <condition_variable>
 #include <cstdio>
 #include <cstdlib>
+#include <ctime>
+#include <fstream>
 #include <limits>
 #include <list>
 #include <thread>
+#include <typeindex>
 #include <typeinfo>
 #include <unordered_set>
 
@@ -27,10 +35,13 @@
 #include "AnalysisUsage.h"
 #include "ApiLevelChecker.h"
 #include "AssetManager.h"
+#include "CodeSpill.h"
 #include "CommandProfiling.h"
+#include "ConcurrentContainers.h"
 #include "ConfigFiles.h"
 #include "Debug.h"
 #include "DexClass.h"
+#include "DexInstruction.h"
 #include "DexLoader.h"
 #include "DexOutput.h"
 #include "DexUtil.h"
@@ -38,10 +49,12 @@
 #include "GraphVisualizer.h"
 #include "IRCode.h"
 #include "IRTypeChecker.h"
+#include "IncrementalManifest.h"
 #include "InstructionLowering.h"
 #include "JemallocUtil.h"
 #include "Macros.h"
 #include "MethodProfiles.h"
+#include "MonotonicFixpointIterator.h"
 #include "Native.h"
 #include "OptData.h"
 #include "Pass.h"
@@ -55,6 +68,7 @@
 #include "SourceBlocks.h"
 #include "Timer.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 namespace {
 
@@ -78,6 +92,163 @@ std::string get_apk_dir(const Json::Value& config) {
   return apkdir;
 }
 
+/*
+ * Remembers in which state methods passed the type checker after a pass, so
+ * that the checker only runs again on the methods that later passes changed.
+ *
+ * The code of a method is fingerprinted by the addresses of the interned
+ * entities it refers to, which is only meaningful within one run. What else
+ * the checker looks at, i.e. the class hierarchy and the signatures and
+ * access flags of the members, is fingerprinted for the whole scope; when
+ * that changes, all methods are checked again.
+ */
+class VerifiedMethods {
+ public:
+  // Forgets all methods if the scope changed structurally since the last
+  // call. Not thread-safe.
+  void begin(const Scope& scope) {
+    auto fingerprint = scope_fingerprint(scope);
+    if (fingerprint != m_scope_fingerprint) {
+      m_scope_fingerprint = fingerprint;
+      m_fingerprints.clear();
+    }
+  }
+
+  bool is_verified(const DexMethod* method, size_t fingerprint) const {
+    auto verified = m_fingerprints.get(method, boost::none);
+    return verified && *verified == fingerprint;
+  }
+
+  void set_verified(const DexMethod* method, size_t fingerprint) {
+    m_fingerprints.insert_or_assign(std::make_pair(method, fingerprint));
+  }
+
+  static size_t fingerprint(const DexMethod* method) {
+    auto* code = method->get_code();
+    return code == nullptr ? 0 : code_fingerprint(*code);
+  }
+
+ private:
+  static size_t scope_fingerprint(const Scope& scope) {
+    size_t seed = 0;
+    auto hash_members = [&seed](const auto& members) {
+      boost::hash_combine(seed, members.size());
+      for (const auto* member : members) {
+        boost::hash_combine(seed, member);
+        boost::hash_combine(seed, member->get_name());
+        boost::hash_combine(seed, member->get_access());
+      }
+    };
+    for (const auto* cls : scope) {
+      boost::hash_combine(seed, cls);
+      boost::hash_combine(seed, cls->get_super_class());
+      boost::hash_combine(seed, cls->get_interfaces());
+      boost::hash_combine(seed, cls->get_access());
+      hash_members(cls->get_dmethods());
+      hash_members(cls->get_vmethods());
+      hash_members(cls->get_sfields());
+      hash_members(cls->get_ifields());
+      for (const auto* method : cls->get_all_methods()) {
+        boost::hash_combine(seed, method->get_proto());
+      }
+      for (const auto* field : cls->get_all_fields()) {
+        boost::hash_combine(seed, field->get_type());
+      }
+    }
+    return seed;
+  }
+
+  static size_t code_fingerprint(const IRCode& code) {
+    // Entries refer to each other by their index.
+    std::unordered_map<const MethodItemEntry*, size_t> indices;
+    std::unordered_map<const DexPosition*, size_t> position_indices;
+    size_t end_index = 0;
+    for (const auto& mie : code) {
+      indices.emplace(&mie, end_index);
+      if (mie.type == MFLOW_POSITION) {
+        position_indices.emplace(mie.pos.get(), end_index);
+      }
+      end_index++;
+    }
+    auto index_of = [&](const MethodItemEntry* mie) {
+      return mie == nullptr ? end_index : indices.at(mie);
+    };
+
+    size_t seed = code.get_registers_size();
+    for (const auto& mie : code) {
+      boost::hash_combine(seed, (uint8_t)mie.type);
+      switch (mie.type) {
+      case MFLOW_OPCODE: {
+        const auto* insn = mie.insn;
+        boost::hash_combine(seed, (uint16_t)insn->opcode());
+        for (auto src : insn->srcs()) {
+          boost::hash_combine(seed, src);
+        }
+        if (insn->has_dest()) {
+          boost::hash_combine(seed, insn->dest());
+        }
+        if (insn->has_literal()) {
+          boost::hash_combine(seed, insn->get_literal());
+        } else if (insn->has_string()) {
+          boost::hash_combine(seed, insn->get_string());
+        } else if (insn->has_type()) {
+          boost::hash_combine(seed, insn->get_type());
+        } else if (insn->has_field()) {
+          boost::hash_combine(seed, insn->get_field());
+          boost::hash_combine(seed, insn->get_field()->get_type());
+        } else if (insn->has_method()) {
+          boost::hash_combine(seed, insn->get_method());
+          boost::hash_combine(seed, insn->get_method()->get_proto());
+        } else if (insn->has_callsite()) {
+          boost::hash_combine(seed, insn->get_callsite());
+        } else if (insn->has_methodhandle()) {
+          boost::hash_combine(seed, insn->get_methodhandle());
+        } else if (insn->has_data()) {
+          auto* data = insn->get_data();
+          boost::hash_range(seed, data->data(),
+                            data->data() + data->data_size());
+        }
+        break;
+      }
+      case MFLOW_TRY:
+        boost::hash_combine(seed, (uint8_t)mie.tentry->type);
+        boost::hash_combine(seed, index_of(mie.tentry->catch_start));
+        break;
+      case MFLOW_CATCH:
+        boost::hash_combine(seed, mie.centry->catch_type);
+        boost::hash_combine(seed, index_of(mie.centry->next));
+        break;
+      case MFLOW_TARGET:
+        boost::hash_combine(seed, (uint8_t)mie.target->type);
+        boost::hash_combine(seed, index_of(mie.target->src));
+        if (mie.target->type == BRANCH_MULTI) {
+          boost::hash_combine(seed, mie.target->case_key);
+        }
+        break;
+      case MFLOW_DEBUG:
+        boost::hash_combine(seed, mie.dbgop->opcode());
+        break;
+      case MFLOW_POSITION: {
+        // The checker rejects missing and cyclic parents.
+        auto* parent = mie.pos->parent;
+        auto it = position_indices.find(parent);
+        boost::hash_combine(seed, parent == nullptr ? end_index
+                                  : it == position_indices.end()
+                                      ? end_index + 1
+                                      : it->second);
+        break;
+      }
+      default:
+        break;
+      }
+    }
+    return seed;
+  }
+
+  size_t m_scope_fingerprint{0};
+  ConcurrentMap<const DexMethod*, boost::optional<size_t>> m_fingerprints;
+};
+
 struct CheckerConfig {
   explicit CheckerConfig(const ConfigFiles& conf) {
     const Json::Value& type_checker_args =
@@ -93,6 +264,8 @@ struct CheckerConfig {
         type_checker_args.get("check_no_overwrite_this", false).asBool();
     check_num_of_refs =
         type_checker_args.get("check_num_of_refs", false).asBool();
+    run_incrementally =
+        type_checker_args.get("run_incrementally", true).asBool();
 
     for (auto& trigger_pass : type_checker_args["run_after_passes"]) {
       type_checker_trigger_passes.insert(trigger_pass.asString());
@@ -204,9 +377,15 @@ struct CheckerConfig {
                                                    bool verify_moves,
                                                    bool check_no_overwrite_this,
                                                    bool validate_access,
-                                                   bool exit_on_fail = true) {
+                                                   bool exit_on_fail = true,
+                                                   VerifiedMethods*
+                                                       verified_methods =
+                                                           nullptr) {
     TRACE(PM, 1, "Running IRTypeChecker...");
     Timer t("IRTypeChecker");
+    if (verified_methods != nullptr) {
+      verified_methods->begin(scope);
+    }
 
     struct Result {
       size_t errors{0};
@@ -241,14 +420,29 @@ struct CheckerConfig {
       return checker;
     };
 
+    std::atomic<size_t> unchanged_methods{0};
     auto res =
         walk::parallel::methods<Result>(scope, [&](DexMethod* dex_method) {
+          if (verified_methods != nullptr &&
+              verified_methods->is_verified(
+                  dex_method, VerifiedMethods::fingerprint(dex_method))) {
+            unchanged_methods++;
+            return Result();
+          }
           auto checker = run_checker(dex_method);
           if (!checker.fail()) {
+            if (verified_methods != nullptr) {
+              // Building the CFG may have normalized the code, so this is
+              // the state that was checked.
+              verified_methods->set_verified(
+                  dex_method, VerifiedMethods::fingerprint(dex_method));
+            }
             return Result();
           }
           return Result(dex_method);
         });
+    TRACE(PM, 2, "IRTypeChecker skipped %zu unchanged methods",
+          unchanged_methods.load());
 
     if (res.errors == 0) {
       return boost::none;
@@ -288,6 +482,8 @@ struct CheckerConfig {
   bool verify_moves;
   bool check_no_overwrite_this;
   bool check_num_of_refs;
+  bool run_incrementally;
+  VerifiedMethods verified_methods;
 };
 
 class ScopedVmHWM {
@@ -319,6 +515,202 @@ class ScopedVmHWM {
   bool m_enabled;
 };
 
+// Fills the run stats of a pass.
+class ScopedPassRunStats {
+ public:
+  explicit ScopedPassRunStats(PassManager::PassInfo* info)
+      : m_info(info),
+        m_start_wall(std::chrono::steady_clock::now()),
+        m_start_cpu(std::clock()),
+        m_start_hwm(get_mem_stats().vm_hwm),
+        m_start_workqueues(redex_parallel::get_work_queue_stats()) {}
+
+  ~ScopedPassRunStats() {
+    auto& stats = m_info->run_stats;
+    stats.wall_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - m_start_wall)
+                        .count();
+    stats.cpu_us =
+        (uint64_t)(std::clock() - m_start_cpu) * 1000000 / CLOCKS_PER_SEC;
+    auto hwm = get_mem_stats().vm_hwm;
+    stats.peak_rss_delta = hwm > m_start_hwm ? hwm - m_start_hwm : 0;
+    auto workqueues = redex_parallel::get_work_queue_stats();
+    stats.workqueue_runs = workqueues.runs - m_start_workqueues.runs;
+    stats.workqueue_wall_us = workqueues.wall_us - m_start_workqueues.wall_us;
+    stats.workqueue_capacity_us =
+        workqueues.capacity_us - m_start_workqueues.capacity_us;
+    stats.workqueue_cpu_us = workqueues.cpu_us - m_start_workqueues.cpu_us;
+  }
+
+ private:
+  PassManager::PassInfo* m_info;
+  std::chrono::steady_clock::time_point m_start_wall;
+  std::clock_t m_start_cpu;
+  uint64_t m_start_hwm;
+  redex_parallel::WorkQueueStats m_start_workqueues;
+};
+
+/*
+ * Attributes the heap memory that fixpoint iterator runs allocate and don't
+ * free to the abstract domain of the iterator. That's typically the memory
+ * held by the abstract states. Nested runs are only attributed to the
+ * innermost domain. Memory allocated by the worker threads of a parallel
+ * fixpoint iterator is missed, and memory freed by another thread than the
+ * one that allocated it skews the numbers. The attribution observes all
+ * fixpoint iterators for as long as it's alive.
+ */
+class DomainMemoryAttribution final : public sparta::FixpointRunObserver {
+ public:
+  DomainMemoryAttribution() { sparta::fixpoint_run_observer() = this; }
+
+  ~DomainMemoryAttribution() override {
+    sparta::fixpoint_run_observer() = nullptr;
+  }
+
+  void begin_run(const std::type_info& domain) override {
+    get_frames().push_back(
+        Frame{&domain, jemalloc_util::thread_net_allocated_bytes(), 0});
+  }
+
+  void end_run() override {
+    auto& frames = get_frames();
+    auto frame = frames.back();
+    frames.pop_back();
+    int64_t bytes = jemalloc_util::thread_net_allocated_bytes() - frame.start;
+    if (!frames.empty()) {
+      frames.back().nested += bytes;
+    }
+    m_bytes.update(std::type_index(*frame.domain),
+                   [&](const std::type_index&, int64_t& total, bool) {
+                     total += bytes - frame.nested;
+                   });
+  }
+
+  // Returns the net bytes attributed to each domain since the last call.
+  std::map<std::string, int64_t> consume() {
+    std::map<std::string, int64_t> bytes;
+    for (const auto& p : m_bytes) {
+      bytes[boost::core::demangle(p.first.name())] += p.second;
+    }
+    m_bytes.clear();
+    return bytes;
+  }
+
+ private:
+  struct Frame {
+    const std::type_info* domain;
+    int64_t start;
+    int64_t nested;
+  };
+
+  static std::vector<Frame>& get_frames() {
+    thread_local std::vector<Frame> frames;
+    return frames;
+  }
+
+  ConcurrentMap<std::type_index, int64_t> m_bytes;
+};
+
+/*
+ * Reports the peak of the heap allocated during a pass, how much of the heap
+ * allocated during the pass is still allocated at its end, and how many
+ * allocations the pass made. This requires running with jemalloc. The peak is
+ * sampled by a background thread, so short spikes can be missed.
+ */
+class ScopedHeapStats {
+ public:
+  ScopedHeapStats(bool enabled, DomainMemoryAttribution* attribution)
+      : m_attribution(attribution) {
+    if (!enabled) {
+      return;
+    }
+    m_before = jemalloc_util::get_heap_stats();
+    if (!m_before) {
+      return;
+    }
+    if (m_attribution != nullptr) {
+      m_attribution->consume();
+    }
+    m_allocations_before = jemalloc_util::get_allocation_stats();
+    m_peak = m_before->allocated;
+    m_sampler = std::thread([this]() {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      while (!m_done) {
+        m_done_cv.wait_for(lock, kSamplingInterval);
+        auto stats = jemalloc_util::get_heap_stats();
+        if (stats) {
+          m_peak = std::max(m_peak, stats->allocated);
+        }
+      }
+    });
+  }
+
+  ~ScopedHeapStats() { stop(); }
+
+  void trace_log(PassManager* mgr, const Pass* pass) {
+    if (!m_before) {
+      return;
+    }
+    stop();
+    auto after = jemalloc_util::get_heap_stats();
+    if (!after) {
+      return;
+    }
+    m_peak = std::max(m_peak, after->allocated);
+    int64_t retained = static_cast<int64_t>(after->allocated) -
+                       static_cast<int64_t>(m_before->allocated);
+    mgr->set_metric("mem~peak~", m_peak);
+    mgr->set_metric("mem~retained~", retained);
+    TRACE(STATS, 1, "Heap for %s peaked at %s, %s%s retained.",
+          pass->name().c_str(), pretty_bytes(m_peak).c_str(),
+          retained < 0 ? "-" : "", pretty_bytes(std::abs(retained)).c_str());
+    auto allocations_after = jemalloc_util::get_allocation_stats();
+    if (m_allocations_before && allocations_after) {
+      auto requests =
+          allocations_after->requests - m_allocations_before->requests;
+      auto requested_bytes = allocations_after->requested_bytes -
+                             m_allocations_before->requested_bytes;
+      int64_t active = static_cast<int64_t>(allocations_after->active) -
+                       static_cast<int64_t>(m_allocations_before->active);
+      mgr->set_metric("mem~allocations~", requests);
+      mgr->set_metric("mem~allocated_bytes~", requested_bytes);
+      mgr->set_metric("mem~active~", active);
+      TRACE(STATS, 1, "%s made %" PRIu64 " allocations of %s in total.",
+            pass->name().c_str(), requests,
+            pretty_bytes(requested_bytes).c_str());
+    }
+    if (m_attribution != nullptr) {
+      for (const auto& p : m_attribution->consume()) {
+        mgr->set_metric("mem~domain~" + p.first, p.second);
+      }
+    }
+  }
+
+ private:
+  static constexpr std::chrono::milliseconds kSamplingInterval{10};
+
+  void stop() {
+    if (!m_sampler.joinable()) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_done = true;
+    }
+    m_done_cv.notify_one();
+    m_sampler.join();
+  }
+
+  DomainMemoryAttribution* m_attribution;
+  boost::optional<jemalloc_util::HeapStats> m_before;
+  boost::optional<jemalloc_util::AllocationStats> m_allocations_before;
+  uint64_t m_peak{0};
+  std::thread m_sampler;
+  std::mutex m_mutex;
+  std::condition_variable m_done_cv;
+  bool m_done{false};
+};
+
 class CheckUniqueDeobfuscatedNames {
  public:
   bool m_after_each_pass{false};
@@ -389,10 +781,17 @@ class CheckUniqueDeobfuscatedNames {
 class VisualizerHelper {
  public:
   explicit VisualizerHelper(const ConfigFiles& conf)
-      : m_class_cfgs(conf.metafile(CFG_DUMP_BASE_NAME),
-                     conf.get_json_config().get("write_cfg_each_pass", false)) {
+      : m_class_cfgs(
+            conf.metafile(
+                std::string(CFG_DUMP_BASE_NAME) +
+                (conf.get_json_config().get("dump_cfg_compressed", false)
+                     ? ".gz"
+                     : "")),
+            conf.get_json_config().get("write_cfg_each_pass", false)) {
     m_class_cfgs.add_all(
         conf.get_json_config().get("dump_cfg_classes", std::string("")));
+    m_class_cfgs.add_methods(
+        conf.get_json_config().get("dump_cfg_methods", std::string("")));
   }
 
   void add_pass(const Pass* pass, size_t i) {
@@ -424,6 +823,10 @@ class AnalysisUsageHelper {
 
   void pre_pass(Pass* pass) { pass->set_analysis_usage(m_analysis_usage); }
 
+  bool requires_linear_ir() const {
+    return m_analysis_usage.requires_linear_ir();
+  }
+
   void post_pass(Pass* pass) {
     // Invalidate existing preserved analyses according to policy set by each
     // pass.
@@ -528,6 +931,56 @@ void maybe_write_env_seeds_file(const ConfigFiles& conf, const Scope& scope) {
   }
 }
 
+/*
+ * In incremental mode, writes the manifest of the input next to the output,
+ * and reports which classes changed since the run that wrote the previous
+ * manifest, along with the classes that depend on them.
+ */
+void maybe_write_incremental_manifest(const ConfigFiles& conf,
+                                      const Scope& scope,
+                                      const std::string& config_fingerprint) {
+  const auto& incremental_config = conf.get_json_config()["incremental"];
+  if (!incremental_config.isObject()) {
+    return;
+  }
+  Timer t("Incremental manifest");
+  auto manifest = incremental::build_manifest(scope, config_fingerprint);
+  incremental::write_manifest(manifest,
+                              conf.metafile(incremental::MANIFEST_FILENAME));
+
+  auto previous_path =
+      incremental_config.get("previous_manifest", "").asString();
+  if (previous_path.empty()) {
+    return;
+  }
+  auto previous = incremental::read_manifest(previous_path);
+  if (!previous) {
+    TRACE(PM, 1, "No previous incremental manifest at %s",
+          previous_path.c_str());
+    return;
+  }
+  auto changed_region =
+      incremental::get_changed_region(*previous, manifest, scope);
+  TRACE(PM, 1,
+        "[incremental] %zu of %zu classes changed, %zu in their dependency "
+        "closure%s",
+        changed_region.changed.size(), scope.size(),
+        changed_region.region.size(),
+        changed_region.has_removed_classes ? ", some classes were removed"
+                                           : "");
+
+  std::vector<std::string> names;
+  names.reserve(changed_region.region.size());
+  for (const auto* cls : changed_region.region) {
+    names.push_back(cls->get_name()->str());
+  }
+  std::sort(names.begin(), names.end());
+  std::ofstream out(conf.metafile("redex-incremental-region.txt"));
+  for (const auto& name : names) {
+    out << name << "\n";
+  }
+}
+
 void maybe_print_seeds_incoming(
     const ConfigFiles& conf,
     const Scope& scope,
@@ -567,7 +1020,8 @@ void maybe_enable_opt_data(const ConfigFiles& conf) {
   const Json::Value& opt_decisions_args =
       conf.get_json_config()["opt_decisions"];
   if (opt_decisions_args.get("enable_logs", false).asBool()) {
-    opt_metadata::OptDataMapper::get_instance().enable_logs();
+    opt_metadata::OptDataMapper::get_instance().enable_logs(
+        opt_decisions_args.get("sample_rate", 1).asUInt());
   }
 }
 
@@ -780,6 +1234,291 @@ class AfterPassSizes {
 #endif
 };
 
+/*
+ * Measures how a pass scales: before the real run of each configured pass,
+ * forks once per thread count, reruns the pass in the child with that default
+ * thread count and reports the wall time back through a pipe. The children
+ * start from the same state as the real run, so they see the same work.
+ *
+ *   "pass_scaling_benchmark": {
+ *     "passes": ["PassName", ...],
+ *     "thread_counts": [1, 8, 0]  // 0 is the hardware concurrency.
+ *   }
+ *
+ * Times, and the speedup and efficiency relative to the first thread count,
+ * are reported as metrics of the pass.
+ */
+class PassScalingBenchmark {
+ public:
+  PassScalingBenchmark(PassManager* mgr, const ConfigFiles& conf)
+      : m_mgr(mgr) {
+    const auto& json = conf.get_json_config()["pass_scaling_benchmark"];
+    if (!json.isObject()) {
+      return;
+    }
+    for (const auto& pass_name : json.get("passes", Json::arrayValue)) {
+      m_passes.insert(pass_name.asString());
+    }
+    auto thread_counts = json.get("thread_counts", Json::arrayValue);
+    if (thread_counts.empty()) {
+      m_thread_counts = {1, 8, 0};
+    }
+    for (const auto& num_threads : thread_counts) {
+      m_thread_counts.push_back(num_threads.asUInt());
+    }
+  }
+
+  void run(Pass* pass, DexStoresVector& stores, ConfigFiles& conf) {
+    if (!m_passes.count(pass->name())) {
+      return;
+    }
+#ifdef __linux__
+    std::vector<std::pair<size_t, double>> results;
+    for (auto num_threads : m_thread_counts) {
+      if (num_threads == 0) {
+        num_threads = std::max(1u, boost::thread::hardware_concurrency());
+      }
+      auto secs = run_child(pass, stores, conf, num_threads);
+      if (secs < 0) {
+        std::cerr << "Scaling benchmark of " << pass->name() << " with "
+                  << num_threads << " threads failed" << std::endl;
+        continue;
+      }
+      results.emplace_back(num_threads, secs);
+    }
+    if (results.empty()) {
+      return;
+    }
+    const auto& base = results.front();
+    for (const auto& [num_threads, secs] : results) {
+      auto prefix = "scaling~" + std::to_string(num_threads) + "~";
+      double speedup = secs > 0 ? base.second / secs : 0;
+      double efficiency = speedup * base.first / num_threads;
+      m_mgr->set_metric(prefix + "wall_ms", (int64_t)(secs * 1000));
+      m_mgr->set_metric(prefix + "speedup_pct", (int64_t)(speedup * 100));
+      m_mgr->set_metric(prefix + "efficiency_pct",
+                        (int64_t)(efficiency * 100));
+      TRACE(PM, 1,
+            "Scaling of %s: %zu threads, %.3fs, %.2fx speedup, %.0f%% "
+            "efficiency",
+            pass->name().c_str(), num_threads, secs, speedup,
+            efficiency * 100);
+    }
+#else
+    (void)stores;
+    (void)conf;
+#endif
+  }
+
+ private:
+#ifdef __linux__
+  // Returns the wall time of the pass in a child with the given number of
+  // threads, or a negative value if the child failed.
+  double run_child(Pass* pass,
+                   DexStoresVector& stores,
+                   ConfigFiles& conf,
+                   size_t num_threads) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+      std::cerr << "Pipe failed!" << strerror(errno) << std::endl;
+      return -1;
+    }
+    pid_t p = fork();
+    if (p < 0) {
+      std::cerr << "Fork failed!" << strerror(errno) << std::endl;
+      close(fds[0]);
+      close(fds[1]);
+      return -1;
+    }
+
+    if (p == 0) {
+      // Child. Keep quiet, and never return into the pass loop.
+      close(fds[0]);
+      close(STDOUT_FILENO);
+      redex_parallel::set_default_num_threads(num_threads);
+      auto start = std::chrono::steady_clock::now();
+      pass->run_pass(stores, conf, *m_mgr);
+      double secs = std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+      auto written = write(fds[1], &secs, sizeof(secs));
+      _exit(written == sizeof(secs) ? 0 : 1);
+    }
+
+    // Parent.
+    close(fds[1]);
+    double secs = -1;
+    ssize_t read_res;
+    do {
+      read_res = read(fds[0], &secs, sizeof(secs));
+    } while (read_res == -1 && errno == EINTR);
+    if (read_res != sizeof(secs)) {
+      secs = -1;
+    }
+    close(fds[0]);
+    int stat;
+    while (waitpid(p, &stat, 0) == -1 && errno == EINTR) {
+    }
+    return secs;
+  }
+#endif
+
+  PassManager* m_mgr;
+  std::unordered_set<std::string> m_passes;
+  std::vector<size_t> m_thread_counts;
+};
+
+/*
+ * Runs passes that only read the IR, such as stats printers and checkers, in
+ * forked children, which see the IR of the parent copy-on-write. The main
+ * pipeline goes on while they run. The children report the metrics of the
+ * pass back through a temp file, and the parent waits for all of them before
+ * the pass metrics are written out.
+ *
+ *   "fork_read_only_passes": ["PassName", ...],
+ *   "fork_read_only_passes_queue": 4
+ *
+ * It is up to the config to only list passes that change nothing, including
+ * the PassManager state that later passes read. Files that such a pass writes
+ * are written by the child.
+ */
+class ForkedReadOnlyPasses {
+ private:
+  struct Job {
+    PassManager::PassInfo* pass_info;
+    std::string metrics_file;
+    pid_t pid;
+    Job(PassManager::PassInfo* pass_info,
+        const std::string& metrics_file,
+        pid_t pid)
+        : pass_info(pass_info), metrics_file(metrics_file), pid(pid) {}
+  };
+  std::list<Job> m_open_jobs;
+
+  std::unordered_set<std::string> m_passes;
+  size_t m_max_jobs{4};
+
+ public:
+  explicit ForkedReadOnlyPasses(const ConfigFiles& conf) {
+    const auto& json = conf.get_json_config();
+    for (const auto& pass_name :
+         json.get("fork_read_only_passes", Json::Value(Json::arrayValue))) {
+      m_passes.insert(pass_name.asString());
+    }
+    json.get("fork_read_only_passes_queue", m_max_jobs, m_max_jobs);
+  }
+
+  // Returns true if the pass was started in a child, and so must not run
+  // here.
+  bool handle(Pass* pass,
+              PassManager::PassInfo* pass_info,
+              DexStoresVector& stores,
+              ConfigFiles& conf,
+              PassManager& mgr) {
+    // Spilled code would be reloaded from files that the parent keeps
+    // changing.
+    if (!m_passes.count(pass->name()) || code_spill::enabled()) {
+      return false;
+    }
+
+#ifdef __linux__
+    for (;;) {
+      check_open_jobs(/*no_hang=*/true);
+      if (m_open_jobs.size() < m_max_jobs) {
+        break;
+      }
+      sleep(1); // Wait a bit.
+    }
+
+    auto tmp_path = boost::filesystem::temp_directory_path();
+    tmp_path /= "redex.forked_pass.XXXXXX";
+    auto tmp_str = tmp_path.string();
+    int fd = mkstemp(&tmp_str[0]);
+    if (fd == -1) {
+      std::cerr << "Could not create temporary file!" << std::endl;
+      return false;
+    }
+    close(fd);
+
+    // Flush so that the child does not write buffered output again.
+    fflush(nullptr);
+    pid_t p = fork();
+
+    if (p < 0) {
+      std::cerr << "Fork failed!" << strerror(errno) << std::endl;
+      boost::filesystem::remove(tmp_str);
+      return false;
+    }
+
+    if (p > 0) {
+      // Parent (=this).
+      m_open_jobs.emplace_back(pass_info, tmp_str, p);
+      return true;
+    }
+
+    // Child. Never returns into the pass loop.
+    pass->run_pass(stores, conf, mgr);
+    std::ofstream out(tmp_str);
+    for (const auto& [key, value] : pass_info->metrics) {
+      out << value << " " << key << "\n";
+    }
+    out.close();
+    fflush(nullptr);
+    _exit(out ? 0 : 1);
+#else
+    (void)pass_info;
+    (void)stores;
+    (void)conf;
+    (void)mgr;
+    return false;
+#endif
+  }
+
+  void wait() {
+#ifdef __linux__
+    check_open_jobs(/*no_hang=*/false);
+#endif
+  }
+
+ private:
+#ifdef __linux__
+  void check_open_jobs(bool no_hang) {
+    for (auto it = m_open_jobs.begin(); it != m_open_jobs.end();) {
+      int stat;
+      pid_t wait_res;
+      for (;;) {
+        wait_res = waitpid(it->pid, &stat, no_hang ? WNOHANG : 0);
+        if (wait_res != -1 || errno != EINTR) {
+          break;
+        }
+      }
+      if (wait_res == 0) {
+        // Not done.
+        ++it;
+        continue;
+      }
+      if (wait_res != -1 && WIFEXITED(stat) && WEXITSTATUS(stat) == 0) {
+        read_metrics(*it);
+      } else {
+        std::cerr << "Forked pass " << it->pass_info->name
+                  << " failed: " << std::hex << stat << std::dec << std::endl;
+      }
+      boost::filesystem::remove(it->metrics_file);
+      it = m_open_jobs.erase(it);
+    }
+  }
+
+  static void read_metrics(const Job& job) {
+    std::ifstream in(job.metrics_file);
+    int64_t value;
+    std::string key;
+    while (in >> value && std::getline(in >> std::ws, key)) {
+      job.pass_info->metrics[key] = value;
+    }
+  }
+#endif
+};
+
 struct SourceBlocksStats {
   size_t total_blocks{0};
   size_t source_blocks_present{0};
@@ -1052,6 +1791,15 @@ void PassManager::init(const Json::Value& config) {
     m_pass_info[i].metrics[PASS_ORDER_KEY] = i;
     m_pass_info[i].config = JsonWrapper(config[pass->name()]);
   }
+
+  if (config.isMember("incremental")) {
+    std::vector<std::string> pass_names;
+    pass_names.reserve(m_activated_passes.size());
+    for (const auto* pass : m_activated_passes) {
+      pass_names.push_back(pass->name());
+    }
+    m_config_fingerprint = incremental::config_fingerprint(config, pass_names);
+  }
 }
 
 hashing::DexHash PassManager::run_hasher(const char* pass_name,
@@ -1103,6 +1851,7 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
   }
   auto profiler_all_info =
       ScopedCommandProfiling::maybe_info_from_env("ALL_PASSES_");
+  auto sampling_info = ScopedSamplingProfiling::maybe_info_from_env("");
 
   if (conf.force_single_dex()) {
     // Squash the dexes into one, so that the passes all see only one dex and
@@ -1122,6 +1871,7 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
   }
 
   maybe_write_env_seeds_file(conf, scope);
+  maybe_write_incremental_manifest(conf, scope, m_config_fingerprint);
   maybe_print_seeds_incoming(conf, scope, m_pg_config);
 
   maybe_enable_opt_data(conf);
@@ -1164,6 +1914,11 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
   const bool hwm_per_pass =
       conf.get_json_config().get("mem_stats_per_pass", true);
 
+  std::unique_ptr<DomainMemoryAttribution> domain_memory_attribution;
+  if (hwm_pass_stats && jemalloc_util::has_thread_stats()) {
+    domain_memory_attribution = std::make_unique<DomainMemoryAttribution>();
+  }
+
   size_t min_pass_idx_for_dex_ref_check =
       checker_conf.min_pass_idx_for_dex_ref_check(m_activated_passes);
 
@@ -1171,6 +1926,34 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
   AnalysisUsage::check_dependencies(m_activated_passes);
 
   AfterPassSizes after_pass_size(this, conf);
+  PassScalingBenchmark scaling_benchmark(this, conf);
+  ForkedReadOnlyPasses forked_passes(conf);
+  // Passes that are known not to scale can be given fewer threads.
+  const auto& pass_num_threads = conf.get_json_config()["pass_num_threads"];
+
+  // Keep editable CFGs built between consecutive passes that do not need
+  // linear IR. Debugging aids that fork or dump the code after each pass
+  // expect linear IR, so they turn this off.
+  if (m_redex_options.code_spill_rss_budget_mb > 0 &&
+      !conf.get_json_config().get("after_pass_size", false)) {
+    code_spill::enable(
+        uint64_t(m_redex_options.code_spill_rss_budget_mb) << 20,
+        conf.get_json_config().get("code_spill_dir", std::string()));
+  }
+
+  const bool persistent_cfgs =
+      conf.get_json_config().get("persistent_editable_cfgs", false) &&
+      !conf.get_json_config().get("after_pass_size", false) &&
+      !conf.get_json_config().get("write_cfg_each_pass", false);
+  auto linearize_cfgs = [&]() {
+    if (!IRCode::persistent_editable_cfgs()) {
+      return;
+    }
+    IRCode::set_persistent_editable_cfgs(false);
+    Timer t("Linearizing persistent CFGs");
+    walk::parallel::code(build_class_scope(stores),
+                         [](DexMethod*, IRCode& code) { code.clear_cfg(); });
+  };
 
   // For core loop legibility, have a lambda here.
 
@@ -1181,12 +1964,15 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
   };
 
   auto post_pass_verifiers = [&](Pass* pass, size_t i, size_t size) {
-    walk::parallel::code(build_class_scope(stores), [](DexMethod* m,
-                                                       IRCode& code) {
+    walk::parallel::methods(build_class_scope(stores), [](DexMethod* m) {
       // Ensure that pass authors deconstructed the editable CFG at the end of
       // their pass. Currently, passes assume the incoming code will be in
-      // IRCode form
-      always_assert_log(!code.editable_cfg_built(), "%s has a cfg!", SHOW(m));
+      // IRCode form, unless they opted into persistent CFGs. Spilled code
+      // has no CFG, and is not worth loading for this.
+      const auto* code = code_spill::peek_code(m);
+      always_assert_log(IRCode::persistent_editable_cfgs() || code == nullptr ||
+                            !code->editable_cfg_built(),
+                        "%s has a cfg!", SHOW(m));
     });
 
     bool run_hasher = run_hasher_after_each_pass;
@@ -1196,6 +1982,7 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
 
     if (run_hasher || run_assessor || run_type_checker ||
         check_unique_deobfuscated.m_after_each_pass) {
+      linearize_cfgs();
       scope = build_class_scope(it);
       if (run_hasher) {
         m_current_pass_info->hash = boost::optional<hashing::DexHash>(
@@ -1208,9 +1995,13 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
       if (run_type_checker) {
         // It's OK to overwrite the `this` register if we are not yet at the
         // output phase -- the register allocator can fix it up later.
-        CheckerConfig::run_verifier(scope, checker_conf.verify_moves,
-                                    /* check_no_overwrite_this */ false,
-                                    /* validate_access */ false);
+        CheckerConfig::run_verifier(
+            scope, checker_conf.verify_moves,
+            /* check_no_overwrite_this */ false,
+            /* validate_access */ false,
+            /* exit_on_fail */ true,
+            checker_conf.run_incrementally ? &checker_conf.verified_methods
+                                           : nullptr);
       }
       if (i >= min_pass_idx_for_dex_ref_check) {
         CheckerConfig::ref_validation(stores, pass->name());
@@ -1236,11 +2027,26 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
 
     TRACE(PM, 1, "Running %s...", pass->name().c_str());
     ScopedVmHWM vm_hwm{hwm_pass_stats, hwm_per_pass};
+    ScopedHeapStats heap_stats{hwm_pass_stats,
+                               domain_memory_attribution.get()};
     Timer t(pass->name() + " " + std::to_string(pass_run) + " (run)");
     m_current_pass_info = &m_pass_info[i];
+    ScopedPassRunStats run_stats{m_current_pass_info};
 
     pre_pass_verifiers(pass, i);
 
+    if (persistent_cfgs && !analysis_usage_helper.requires_linear_ir()) {
+      IRCode::set_persistent_editable_cfgs(true);
+    } else {
+      linearize_cfgs();
+    }
+
+    scaling_benchmark.run(pass, stores, conf);
+
+    redex_parallel::set_default_num_threads(
+        pass_num_threads.isObject()
+            ? pass_num_threads.get(pass->name(), 0).asUInt()
+            : 0);
     {
       auto scoped_command_prof = profiler_info_pass == pass
                                      ? ScopedCommandProfiling::maybe_from_info(
@@ -1248,11 +2054,22 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
                                      : boost::none;
       auto scoped_command_all_prof = ScopedCommandProfiling::maybe_from_info(
           profiler_all_info, &pass->name());
+      auto scoped_sampling_prof = ScopedSamplingProfiling::maybe_from_info(
+          sampling_info, i, pass->name());
+      if (code_spill::enabled()) {
+        code_spill::begin_epoch();
+        code_spill::maybe_spill(stores);
+      }
       jemalloc_util::ScopedProfiling malloc_prof(m_malloc_profile_pass == pass);
-      pass->run_pass(stores, conf, *this);
+      if (!forked_passes.handle(pass, m_current_pass_info, stores, conf,
+                                *this)) {
+        pass->run_pass(stores, conf, *this);
+      }
     }
+    redex_parallel::set_default_num_threads(0);
 
     vm_hwm.trace_log(this, pass);
+    heap_stats.trace_log(this, pass);
 
     sanitizers::lsan_do_recoverable_leak_check();
 
@@ -1273,6 +2090,14 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
   }
 
   after_pass_size.wait();
+  forked_passes.wait();
+
+  if (code_spill::enabled()) {
+    Timer t("Reloading spilled code");
+    code_spill::disable();
+  }
+
+  linearize_cfgs();
 
   // Always run the type checker before generating the optimized dex code.
   scope = build_class_scope(it);
@@ -1349,3 +2174,17 @@ PassManager::get_interdex_metrics() {
   static std::unordered_map<std::string, int64_t> empty;
   return empty;
 }
+
+void PassManager::serialize_state(Json::Value& entry_data) const {
+  auto& state = entry_data["pass_manager_state"];
+  state["interdex_has_run"] = m_interdex_has_run;
+  state["unreliable_virtual_scopes"] = m_unreliable_virtual_scopes;
+}
+
+void PassManager::deserialize_state(const Json::Value& entry_data) {
+  // Register allocation is deliberately not restored: the resumed IR is
+  // freshly loaded from dex code, just like at the start of a normal run.
+  const auto& state = entry_data["pass_manager_state"];
+  m_interdex_has_run = state["interdex_has_run"].asBool();
+  m_unreliable_virtual_scopes = state["unreliable_virtual_scopes"].asBool();
+}
@@ -59,6 +59,22 @@ class PassManager {
     std::unordered_map<std::string, int64_t> metrics;
     JsonWrapper config;
     boost::optional<hashing::DexHash> hash;
+
+    // The time and memory that running the pass took, measured for all
+    // passes.
+    struct RunStats {
+      uint64_t wall_us{0};
+      uint64_t cpu_us{0};
+      // By how much the pass raised the peak resident set size.
+      uint64_t peak_rss_delta{0};
+      // Totals over the work queue runs of the pass, see
+      // redex_parallel::WorkQueueStats.
+      uint64_t workqueue_runs{0};
+      uint64_t workqueue_wall_us{0};
+      uint64_t workqueue_capacity_us{0};
+      uint64_t workqueue_cpu_us{0};
+    };
+    RunStats run_stats;
   };
 
   void run_passes(DexStoresVector&, ConfigFiles&);
@@ -113,6 +129,11 @@ class PassManager {
 
   Pass* find_pass(const std::string& pass_name) const;
 
+  // Save and restore the pipeline state that later passes depend on, so that
+  // a run stopped with `--stop-pass` can be continued with `--resume-from`.
+  void serialize_state(Json::Value& entry_data) const;
+  void deserialize_state(const Json::Value& entry_data);
+
  private:
   void activate_pass(const std::string& name, const Json::Value& conf);
 
@@ -141,6 +162,8 @@ class PassManager {
   Pass* m_malloc_profile_pass{nullptr};
 
   boost::optional<hashing::DexHash> m_initial_hash;
+  // Only set in incremental mode.
+  std::string m_config_fingerprint;
   AccumulatingTimer m_hashers_timer;
   AccumulatingTimer m_check_unique_deobfuscateds_timer;
 };
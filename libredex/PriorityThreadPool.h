@@ -42,6 +42,11 @@ class PriorityThreadPool {
   std::map<int, std::queue<std::function<void()>>> m_pending_work_items;
   size_t m_running_work_items{0};
   std::chrono::duration<double> m_waited_time{0};
+  // Time spent running work items, summed over all threads.
+  std::chrono::duration<double> m_busy_time{0};
+  boost::optional<std::chrono::steady_clock::time_point> m_first_post;
+  // Wall time from the first posted work item until the threads were joined.
+  std::chrono::duration<double> m_active_time{0};
   bool m_shutdown{false};
 
  public:
@@ -68,6 +73,13 @@ class PriorityThreadPool {
         .count();
   }
 
+  // The fraction of the threads' time that was spent running work items,
+  // between the first posted work item and the end of join().
+  double get_utilization() {
+    auto available = m_active_time * m_pool.size();
+    return available.count() > 0 ? m_busy_time / available : 0;
+  }
+
   // The number of threads may be set at most once to a positive number
   void set_num_threads(int num_threads) {
     always_assert(m_pool.empty());
@@ -90,6 +102,9 @@ class PriorityThreadPool {
     always_assert(!m_pool.empty());
     std::unique_lock<std::mutex> lock{m_mutex};
     always_assert(!m_shutdown);
+    if (!m_first_post) {
+      m_first_post = std::chrono::steady_clock::now();
+    }
     m_pending_work_items[priority].push(f);
     m_work_condition.notify_one();
   }
@@ -125,6 +140,9 @@ class PriorityThreadPool {
     for (auto& thread : m_pool) {
       thread.join();
     }
+    if (m_first_post) {
+      m_active_time = std::chrono::steady_clock::now() - *m_first_post;
+    }
   }
 
  private:
@@ -159,16 +177,19 @@ class PriorityThreadPool {
       }
 
       // Run!
+      auto start = std::chrono::steady_clock::now();
       try {
         (*highest_priority_f)();
       } catch (std::exception& e) {
         redex_workqueue_impl::redex_queue_exception_handler(e);
         throw;
       }
+      auto end = std::chrono::steady_clock::now();
 
       // Notify when *all* work is done, i.e. nothing is running or pending.
       {
         std::unique_lock<std::mutex> lock{m_mutex};
+        m_busy_time += end - start;
         if (--m_running_work_items == 0 && m_pending_work_items.empty()) {
           m_done_condition.notify_one();
         }
@@ -9,6 +9,7 @@
 
 #include <algorithm>
 #include <boost/functional/hash.hpp>
+#include <unordered_map>
 
 #include "StlUtil.h"
 
@@ -90,4 +91,18 @@ void KeepSpecSet::erase_if(const std::function<bool(const KeepSpec&)>& pred) {
       m_ordered.end());
 }
 
+void KeepSpecSet::merge(KeepSpecSet&& other) {
+  std::unordered_map<const KeepSpec*, decltype(m_unordered_set)::node_type>
+      nodes;
+  while (!other.m_unordered_set.empty()) {
+    auto node = other.m_unordered_set.extract(other.m_unordered_set.begin());
+    const KeepSpec* spec = node.value().get();
+    nodes.emplace(spec, std::move(node));
+  }
+  for (const auto* spec : other.m_ordered) {
+    emplace(std::move(nodes.at(spec).value()));
+  }
+  other.m_ordered.clear();
+}
+
 } // namespace keep_rules
@@ -123,6 +123,10 @@ class KeepSpecSet {
 
   void erase_if(const std::function<bool(const KeepSpec&)>&);
 
+  // Move the specs of other to the end of this set, in order, dropping the
+  // ones that are already here.
+  void merge(KeepSpecSet&& other);
+
  private:
   std::vector<KeepSpec*> m_ordered;
   std::unordered_set<std::unique_ptr<KeepSpec>,
@@ -7,9 +7,12 @@
 
 #include "ProguardMap.h"
 
+#include <numeric>
+
 #include "DexPosition.h"
 #include "DexUtil.h"
 #include "IRCode.h"
+#include "ReadMaybeMapped.h"
 #include "Show.h"
 #include "Timer.h"
 #include "Trace.h"
@@ -19,10 +22,10 @@ namespace {
 
 std::string find_or_same(
     const std::string& key,
-    const std::unordered_map<std::string, std::string>& map) {
+    const std::unordered_map<std::string_view, std::string_view>& map) {
   auto it = map.find(key);
   if (it == map.end()) return key;
-  return it->second;
+  return std::string(it->second);
 }
 
 std::string convert_scalar_type(const std::string& type) {
@@ -40,21 +43,24 @@ std::string convert_scalar_type(const std::string& type) {
 std::string convert_field(const std::string& cls,
                           const std::string& type,
                           const std::string& name) {
-  std::ostringstream ss;
-  ss << cls << "." << name;
+  std::string s;
+  s.reserve(cls.size() + name.size() + type.size() + 2);
+  s.append(cls).append(".").append(name);
   if (!type.empty()) {
-    ss << ":" << type;
+    s.append(":").append(type);
   }
-  return ss.str();
+  return s;
 }
 
 std::string convert_method(const std::string& cls,
                            const std::string& rtype,
                            const std::string& methodname,
                            const std::string& args) {
-  std::ostringstream ss;
-  ss << cls << "." << methodname << ":(" << args << ")" << rtype;
-  return ss.str();
+  std::string s;
+  s.reserve(cls.size() + methodname.size() + args.size() + rtype.size() + 4);
+  s.append(cls).append(".").append(methodname).append(":(");
+  s.append(args).append(")").append(rtype);
+  return s;
 }
 
 std::string translate_type(const std::string& type, const ProguardMap& pm) {
@@ -214,19 +220,123 @@ bool is_maybe_proguard_generated_member(const std::string& s) {
 }
 } // namespace
 
+struct ProguardMap::Chunk {
+  struct Member {
+    std::string_view old_name;
+    std::string_view new_name;
+    // Empty in the full map format, which has no untyped names.
+    std::string_view new_untyped_name;
+    std::unique_ptr<ProguardLineRange> lines;
+  };
+
+  explicit Chunk(std::string_view contents) : contents(contents) {}
+
+  std::string_view contents;
+  std::unique_ptr<BumpArena> arena{std::make_unique<BumpArena>(1 << 20)};
+  // Where the class lines of the chunk start, in file order.
+  std::vector<const char*> class_lines;
+  std::vector<std::pair<std::string_view, std::string_view>> classes;
+  std::vector<Member> fields;
+  std::vector<Member> methods;
+  // Interfaces that are (most likely) coalesced by Proguard, each with the
+  // field that gave it away.
+  std::vector<std::pair<std::string, std::string>> coalesced_interfaces;
+
+  std::string curr_class;
+  std::string curr_new_class;
+
+  // Copies `s` into the arena of the chunk.
+  std::string_view store(const std::string& s) {
+    auto* data = static_cast<char*>(arena->allocate(s.size(), 1));
+    std::copy(s.begin(), s.end(), data);
+    return std::string_view(data, s.size());
+  }
+
+  void parse_classes();
+  void parse_members(const ProguardMap& pm);
+  void parse_full_map();
+
+  bool parse_field(const std::string& line, const ProguardMap& pm);
+  bool parse_method(const std::string& line, const ProguardMap& pm);
+
+  bool parse_class_full_format(const std::string& line);
+  bool parse_field_full_format(const std::string& line);
+  bool parse_method_full_format(const std::string& line);
+};
+
+namespace {
+
+// Calls `f` on each line of `contents`, without its '\n', like std::getline.
+// The line is copied into a reused, NUL-terminated buffer for the parsers.
+template <typename F>
+void for_each_line(std::string_view contents, const F& f) {
+  std::string line;
+  while (!contents.empty()) {
+    auto len = std::min(contents.find('\n'), contents.size());
+    line.assign(contents.data(), len);
+    f(contents.data(), line);
+    contents.remove_prefix(std::min(len + 1, contents.size()));
+  }
+}
+
+// Splits `contents` into chunks of whole lines, enough to keep all threads
+// busy, but not so many that tiny maps get split up.
+std::vector<std::string_view> split_lines(std::string_view contents) {
+  constexpr size_t kMinChunkSize = 1 << 20;
+  auto num_chunks = std::min(redex_parallel::default_num_threads() * 4,
+                             contents.size() / kMinChunkSize + 1);
+  auto chunk_size = std::max<size_t>(1, contents.size() / num_chunks);
+  std::vector<std::string_view> chunks;
+  while (!contents.empty()) {
+    auto eol = contents.find('\n', std::min(chunk_size, contents.size()) - 1);
+    auto len = std::min(eol, contents.size() - 1) + 1;
+    chunks.push_back(contents.substr(0, len));
+    contents.remove_prefix(len);
+  }
+  return chunks;
+}
+
+template <typename Fn>
+void parallel_for(size_t n, const Fn& fn) {
+  std::vector<size_t> indices(n);
+  std::iota(indices.begin(), indices.end(), 0);
+  workqueue_run<size_t>(fn, indices);
+}
+
+bool class_line(const std::string& line,
+                std::string& classname,
+                std::string& newname) {
+  auto p = line.c_str();
+  if (!id(p, classname)) return false;
+  if (!literal(p, " -> ")) return false;
+  if (!id(p, newname)) return false;
+  return true;
+}
+
+} // namespace
+
 ProguardMap::ProguardMap(const std::string& filename, bool use_new_rename_map) {
   if (filename.empty()) {
     return;
   }
   Timer t("Parsing proguard map");
-  std::ifstream fp(filename);
-  always_assert_log(fp, "Can't open proguard map: %s\n", filename.c_str());
+  always_assert_log(std::ifstream(filename), "Can't open proguard map: %s\n",
+                    filename.c_str());
+
+  redex::read_file_with_contents(filename, [&](const char* data, size_t size) {
+    std::string_view contents(data, size);
+    if (use_new_rename_map) {
+      parse_full_map(contents);
+    } else {
+      parse_proguard_map(contents);
+    }
+  });
+}
 
-  if (use_new_rename_map) {
-    parse_full_map(fp);
-  } else {
-    parse_proguard_map(fp);
-  }
+ProguardMap::ProguardMap(std::istream& is) {
+  std::string contents{std::istreambuf_iterator<char>(is),
+                       std::istreambuf_iterator<char>()};
+  parse_proguard_map(contents);
 }
 
 std::string ProguardMap::translate_class(const std::string& cls) const {
@@ -257,8 +367,8 @@ std::string ProguardMap::deobfuscate_method(const std::string& method) const {
 std::vector<ProguardMap::Frame> ProguardMap::deobfuscate_frame(
     DexString* method_name, uint32_t line) const {
   std::vector<Frame> frames;
-  auto ranges_it =
-      m_obfMethodLinesMap.find(pg_impl::lines_key(method_name->str()));
+  auto ranges_it = m_obfMethodLinesMap.find(
+      pg_impl::lines_key(method_name->str()));
   if (ranges_it != m_obfMethodLinesMap.end()) {
     for (const auto& range : ranges_it->second) {
       if (!range->matches(line)) {
@@ -286,56 +396,161 @@ ProguardLineRangeVector& ProguardMap::method_lines(
   return m_obfMethodLinesMap.at(pg_impl::lines_key(obfuscated_method));
 }
 
-void ProguardMap::parse_proguard_map(std::istream& fp) {
-  std::string line;
-  while (std::getline(fp, line)) {
-    parse_class(line);
-  }
-  fp.clear();
-  fp.seekg(0);
-  assert_log(!fp.fail(), "Can't use ProguardMap with non-seekable stream");
-  while (std::getline(fp, line)) {
-    if (parse_class(line)) {
-      continue;
+void ProguardMap::parse_proguard_map(std::string_view contents) {
+  // Member lines translate their types with the class map, so all classes
+  // are parsed first.
+  std::vector<Chunk> chunks;
+  for (auto chunk : split_lines(contents)) {
+    chunks.emplace_back(chunk);
+  }
+  parallel_for(chunks.size(), [&](size_t i) { chunks[i].parse_classes(); });
+  std::vector<const char*> class_lines;
+  for (const auto& chunk : chunks) {
+    class_lines.insert(class_lines.end(), chunk.class_lines.begin(),
+                       chunk.class_lines.end());
+  }
+
+  // Then the members, in chunks that start at a class line, so that each
+  // chunk knows the class of its members.
+  std::vector<Chunk> sections;
+  auto begin = contents.data();
+  for (size_t i = 1; i <= chunks.size(); ++i) {
+    auto end = contents.data() + contents.size();
+    if (i < chunks.size()) {
+      auto it = std::lower_bound(class_lines.begin(), class_lines.end(),
+                                 chunks[i].contents.data());
+      if (it != class_lines.end()) {
+        end = *it;
+      }
     }
-    if (parse_field(line)) {
-      continue;
+    if (end != begin) {
+      sections.emplace_back(std::string_view(begin, end - begin));
+      begin = end;
     }
-    if (parse_method(line)) {
-      continue;
+  }
+  for (auto& chunk : chunks) {
+    add_chunk(std::move(chunk));
+  }
+
+  parallel_for(sections.size(),
+               [&](size_t i) { sections[i].parse_members(*this); });
+  size_t num_fields = 0;
+  size_t num_methods = 0;
+  for (const auto& section : sections) {
+    num_fields += section.fields.size();
+    num_methods += section.methods.size();
+  }
+  m_fieldMap.reserve(num_fields);
+  m_obfFieldMap.reserve(num_fields);
+  m_obfUntypedFieldMap.reserve(num_fields);
+  m_methodMap.reserve(num_methods);
+  m_obfMethodMap.reserve(num_methods);
+  m_obfUntypedMethodMap.reserve(num_methods);
+  for (auto& section : sections) {
+    add_chunk(std::move(section));
+  }
+}
+
+void ProguardMap::parse_full_map(std::string_view contents) {
+  std::vector<Chunk> chunks;
+  for (auto chunk : split_lines(contents)) {
+    chunks.emplace_back(chunk);
+  }
+  parallel_for(chunks.size(), [&](size_t i) { chunks[i].parse_full_map(); });
+  for (auto& chunk : chunks) {
+    add_chunk(std::move(chunk));
+  }
+}
+
+void ProguardMap::add_chunk(Chunk&& chunk) {
+  for (const auto& [old_name, new_name] : chunk.classes) {
+    m_classMap[old_name] = new_name;
+    m_obfClassMap[new_name] = old_name;
+  }
+  for (const auto& field : chunk.fields) {
+    m_fieldMap[field.old_name] = field.new_name;
+    m_obfFieldMap[field.new_name] = field.old_name;
+    if (!field.new_untyped_name.empty()) {
+      m_obfUntypedFieldMap[field.new_untyped_name] = field.old_name;
+    }
+  }
+  for (auto& method : chunk.methods) {
+    m_methodMap[method.old_name] = method.new_name;
+    m_obfMethodMap[method.new_name] = method.old_name;
+    if (!method.new_untyped_name.empty()) {
+      m_obfUntypedMethodMap[method.new_untyped_name] = method.old_name;
+    }
+    if (method.lines) {
+      m_obfMethodLinesMap[pg_impl::lines_key(method.new_name)].push_back(
+          std::move(method.lines));
+    }
+  }
+  for (const auto& [type, field] : chunk.coalesced_interfaces) {
+    fprintf(stderr,
+            "Type '%s' is touched by Proguard in '%s'\n",
+            type.c_str(),
+            field.c_str());
+    m_pg_coalesced_interfaces.insert(type);
+  }
+  m_arenas.push_back(std::move(chunk.arena));
+}
+
+void ProguardMap::Chunk::parse_classes() {
+  std::string classname;
+  std::string newname;
+  for_each_line(contents, [&](const char* begin, const std::string& line) {
+    if (!class_line(line, classname, newname)) {
+      return;
+    }
+    class_lines.push_back(begin);
+    classes.emplace_back(store(convert_type(classname)),
+                         store(convert_type(newname)));
+  });
+}
+
+void ProguardMap::Chunk::parse_members(const ProguardMap& pm) {
+  std::string classname;
+  std::string newname;
+  for_each_line(contents, [&](const char*, const std::string& line) {
+    if (class_line(line, classname, newname)) {
+      curr_class = convert_type(classname);
+      curr_new_class = convert_type(newname);
+      return;
+    }
+    if (parse_field(line, pm)) {
+      return;
+    }
+    if (parse_method(line, pm)) {
+      return;
     }
     if (comment(line)) {
-      continue;
+      return;
     }
     not_reached_log("Bogus line encountered in proguard map: %s\n",
                     line.c_str());
-  }
+  });
 }
 
-void ProguardMap::parse_full_map(std::istream& fp) {
-  std::string line;
-  fp.seekg(0);
-  assert_log(!fp.fail(),
-             "Can't use the full rename map with non-seekable stream");
-  while (std::getline(fp, line)) {
+void ProguardMap::Chunk::parse_full_map() {
+  for_each_line(contents, [&](const char*, const std::string& line) {
     if (parse_class_full_format(line)) {
-      continue;
+      return;
     }
     if (parse_field_full_format(line)) {
-      continue;
+      return;
     }
     if (parse_method_full_format(line)) {
-      continue;
+      return;
     }
     if (comment(line)) {
-      continue;
+      return;
     }
     not_reached_log("Bogus line encountered in the full map: %s\n",
                     line.c_str());
-  }
+  });
 }
 
-bool ProguardMap::parse_class_full_format(const std::string& line) {
+bool ProguardMap::Chunk::parse_class_full_format(const std::string& line) {
   std::string old_class_name;
   std::string new_class_name;
   auto p = line.c_str();
@@ -344,14 +559,13 @@ bool ProguardMap::parse_class_full_format(const std::string& line) {
   if (!literal(p, " -> ")) return false;
   if (!id(p, new_class_name)) return false;
 
-  m_currClass = old_class_name;
-  m_currNewClass = new_class_name;
-  m_classMap[m_currClass] = m_currNewClass;
-  m_obfClassMap[m_currNewClass] = m_currClass;
+  curr_class = old_class_name;
+  curr_new_class = new_class_name;
+  classes.emplace_back(store(curr_class), store(curr_new_class));
   return true;
 }
 
-bool ProguardMap::parse_field_full_format(const std::string& line) {
+bool ProguardMap::Chunk::parse_field_full_format(const std::string& line) {
   std::string old_field_name;
   std::string new_field_name;
 
@@ -374,15 +588,12 @@ bool ProguardMap::parse_field_full_format(const std::string& line) {
     return false;
   }
 
-  auto pgnew = new_field_name;
-  auto pgold = old_field_name;
-
-  m_fieldMap[pgold] = pgnew;
-  m_obfFieldMap[pgnew] = pgold;
+  fields.push_back(
+      {store(old_field_name), store(new_field_name), {}, nullptr});
   return true;
 }
 
-bool ProguardMap::parse_method_full_format(const std::string& line) {
+bool ProguardMap::Chunk::parse_method_full_format(const std::string& line) {
   std::string old_method_name;
   std::string new_method_name;
   auto p = line.c_str();
@@ -404,28 +615,13 @@ bool ProguardMap::parse_method_full_format(const std::string& line) {
     return false;
   }
 
-  auto pgold = old_method_name;
-  auto pgnew = new_method_name;
-  m_methodMap[pgold] = pgnew;
-  m_obfMethodMap[pgnew] = pgold;
+  methods.push_back(
+      {store(old_method_name), store(new_method_name), {}, nullptr});
   return true;
 }
 
-bool ProguardMap::parse_class(const std::string& line) {
-  std::string classname;
-  std::string newname;
-  auto p = line.c_str();
-  if (!id(p, classname)) return false;
-  if (!literal(p, " -> ")) return false;
-  if (!id(p, newname)) return false;
-  m_currClass = convert_type(classname);
-  m_currNewClass = convert_type(newname);
-  m_classMap[m_currClass] = m_currNewClass;
-  m_obfClassMap[m_currNewClass] = m_currClass;
-  return true;
-}
-
-bool ProguardMap::parse_field(const std::string& line) {
+bool ProguardMap::Chunk::parse_field(const std::string& line,
+                                     const ProguardMap& pm) {
   std::string type;
   std::string fieldname;
   std::string newname;
@@ -439,28 +635,23 @@ bool ProguardMap::parse_field(const std::string& line) {
   if (!id(p, newname)) return false;
 
   auto ctype = convert_type(type);
-  auto xtype = translate_type(ctype, *this);
-  auto pgnew = convert_field(m_currNewClass, xtype, newname);
-  auto pgnew_notype = convert_field(m_currNewClass, "", newname);
-  auto pgold = convert_field(m_currClass, ctype, fieldname);
+  auto xtype = translate_type(ctype, pm);
+  auto pgnew = convert_field(curr_new_class, xtype, newname);
+  auto pgnew_notype = convert_field(curr_new_class, "", newname);
+  auto pgold = convert_field(curr_class, ctype, fieldname);
   // Record interfaces that are coalesced by Proguard.
   if (ctype[0] == 'L' && is_maybe_proguard_generated_member(fieldname)) {
-    fprintf(stderr,
-            "Type '%s' is touched by Proguard in '%s'\n",
-            ctype.c_str(),
-            pgold.c_str());
-    m_pg_coalesced_interfaces.insert(ctype);
+    coalesced_interfaces.emplace_back(ctype, pgold);
   }
-  m_fieldMap[pgold] = pgnew;
-  m_obfFieldMap[pgnew] = pgold;
-  m_obfUntypedFieldMap[pgnew_notype] = pgold;
+  fields.push_back({store(pgold), store(pgnew), store(pgnew_notype), nullptr});
   return true;
 }
 
-bool ProguardMap::parse_method(const std::string& line) {
+bool ProguardMap::Chunk::parse_method(const std::string& line,
+                                      const ProguardMap& pm) {
   std::string type;
   std::string methodname;
-  std::string classname = m_currClass;
+  std::string classname = curr_class;
   std::string old_args;
   std::string new_args;
   std::string newname;
@@ -484,7 +675,7 @@ bool ProguardMap::parse_method(const std::string& line) {
     if (literal(p, ')')) break;
     id(p, arg);
     auto old_arg = convert_type(arg);
-    auto new_arg = translate_type(old_arg, *this);
+    auto new_arg = translate_type(old_arg, pm);
     old_args += old_arg;
     new_args += new_arg;
     literal(p, ',');
@@ -499,15 +690,13 @@ bool ProguardMap::parse_method(const std::string& line) {
   if (!id(p, newname)) return false;
 
   auto old_rtype = convert_type(type);
-  auto new_rtype = translate_type(old_rtype, *this);
+  auto new_rtype = translate_type(old_rtype, pm);
   auto pgold = convert_method(classname, old_rtype, methodname, old_args);
-  auto pgnew = convert_method(m_currNewClass, new_rtype, newname, new_args);
-  auto pgnew_no_rtype = convert_method(m_currNewClass, "", newname, new_args);
-  m_methodMap[pgold] = pgnew;
-  m_obfMethodMap[pgnew] = pgold;
-  m_obfUntypedMethodMap[pgnew_no_rtype] = pgold;
+  auto pgnew = convert_method(curr_new_class, new_rtype, newname, new_args);
+  auto pgnew_no_rtype = convert_method(curr_new_class, "", newname, new_args);
   lines->original_name = pgold;
-  m_obfMethodLinesMap[pg_impl::lines_key(pgnew)].push_back(std::move(lines));
+  methods.push_back({store(pgold), store(pgnew), store(pgnew_no_rtype),
+                     std::move(lines)});
   return true;
 }
 
@@ -577,9 +766,9 @@ void apply_deobfuscated_positions(IRCode* code, const ProguardMap& pm) {
 /**
  * method_name should be a method as returned from convert_method
  */
-std::string lines_key(const std::string& method_name) {
+std::string_view lines_key(std::string_view method_name) {
   std::size_t end = method_name.rfind(':');
-  always_assert(end != std::string::npos);
+  always_assert(end != std::string_view::npos);
   return method_name.substr(0, end);
 }
 
@@ -9,10 +9,14 @@
 
 #include <cstddef>
 #include <fstream>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
+#include "ArenaInternTable.h"
 #include "DexClass.h"
 #include "ProguardLineRange.h"
 
@@ -53,7 +57,7 @@ struct ProguardMap {
   /**
    * Construct map from a given stream.
    */
-  explicit ProguardMap(std::istream& is) { parse_proguard_map(is); }
+  explicit ProguardMap(std::istream& is);
 
   /**
    * Translate un-obfuscated class name to obfuscated name.
@@ -112,43 +116,45 @@ struct ProguardMap {
   }
 
  private:
-  void parse_proguard_map(std::istream& fp);
-  void parse_full_map(std::istream& fp);
+  // The lines of a part of the map, parsed on their own; see ProguardMap.cpp.
+  struct Chunk;
 
-  bool parse_class(const std::string& line);
-  bool parse_field(const std::string& line);
-  bool parse_method(const std::string& line);
+  // Both formats are parsed in parallel over chunks of whole lines, which are
+  // then added to the maps in file order.
+  void parse_proguard_map(std::string_view contents);
+  void parse_full_map(std::string_view contents);
 
-  bool parse_class_full_format(const std::string& line);
-  bool parse_field_full_format(const std::string& line);
-  bool parse_method_full_format(const std::string& line);
+  void add_chunk(Chunk&& chunk);
 
  private:
+  // The names are stored once, in the arenas of the chunks they were parsed
+  // from, and all maps below refer to them.
+  std::vector<std::unique_ptr<BumpArena>> m_arenas;
+
   // Unobfuscated to obfuscated maps
-  std::unordered_map<std::string, std::string> m_classMap;
-  std::unordered_map<std::string, std::string> m_fieldMap;
-  std::unordered_map<std::string, std::string> m_methodMap;
+  std::unordered_map<std::string_view, std::string_view> m_classMap;
+  std::unordered_map<std::string_view, std::string_view> m_fieldMap;
+  std::unordered_map<std::string_view, std::string_view> m_methodMap;
 
   // Obfuscated to unobfuscated maps from proguard
-  std::unordered_map<std::string, std::string> m_obfClassMap;
-  std::unordered_map<std::string, std::string> m_obfFieldMap;
-  std::unordered_map<std::string, std::string> m_obfMethodMap;
+  std::unordered_map<std::string_view, std::string_view> m_obfClassMap;
+  std::unordered_map<std::string_view, std::string_view> m_obfFieldMap;
+  std::unordered_map<std::string_view, std::string_view> m_obfMethodMap;
 
   // Field map for reflection analysis when type is unknown
   // Stores Lcom/facebook/Class;.field -> original name without class name
-  std::unordered_map<std::string, std::string> m_obfUntypedFieldMap;
+  std::unordered_map<std::string_view, std::string_view> m_obfUntypedFieldMap;
 
   // Method map for reflection analysis when return type is unknown
   // Stores Lcom/facebook/Class;.method(II) -> original name without class name
-  std::unordered_map<std::string, std::string> m_obfUntypedMethodMap;
+  std::unordered_map<std::string_view, std::string_view> m_obfUntypedMethodMap;
 
-  std::unordered_map<std::string, ProguardLineRangeVector> m_obfMethodLinesMap;
+  // Keyed by the obfuscated method names without their types.
+  std::unordered_map<std::string_view, ProguardLineRangeVector>
+      m_obfMethodLinesMap;
 
   // Interfaces that are (most likely) coalesced by Proguard.
   std::unordered_set<std::string> m_pg_coalesced_interfaces;
-
-  std::string m_currClass;
-  std::string m_currNewClass;
 };
 
 /**
@@ -166,7 +172,7 @@ DexString* file_name_from_method_string(const DexString* method);
 
 void apply_deobfuscated_positions(IRCode*, const ProguardMap&);
 
-std::string lines_key(const std::string& method_name);
+std::string_view lines_key(std::string_view method_name);
 
 } // namespace pg_impl
 
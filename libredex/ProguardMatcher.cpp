@@ -42,6 +42,24 @@ std::unique_ptr<boost::regex> make_rx(const std::string& s,
   return std::make_unique<boost::regex>(rx);
 }
 
+// The literal characters which all the names matching the given wildcard
+// type start with.
+std::string literal_prefix(const std::string& wildcard_type) {
+  // An alternation makes any prefix optional.
+  if (wildcard_type.find('|') != std::string::npos) {
+    return "";
+  }
+  size_t end = 0;
+  while (end < wildcard_type.size()) {
+    const char ch = wildcard_type[end];
+    if (!isalnum(ch) && ch != '_' && ch != '/' && ch != '$' && ch != ';') {
+      break;
+    }
+    end++;
+  }
+  return wildcard_type.substr(0, end);
+}
+
 std::string get_deobfuscated_name(const DexType* type) {
   auto cls = type_class(type);
   if (cls == nullptr) {
@@ -73,7 +91,17 @@ struct ClassMatcher {
         m_cls(make_rx(ks.class_spec.className)),
         m_anno(make_rx(ks.class_spec.annotationType, false)),
         m_extends(make_rx(ks.class_spec.extendsClassName)),
-        m_extends_anno(make_rx(ks.class_spec.extendsAnnotationType, false)) {}
+        m_extends_anno(make_rx(ks.class_spec.extendsAnnotationType, false)) {
+    if (!m_class_name.empty()) {
+      auto wc = proguard_parser::convert_wildcard_type(m_class_name);
+      m_class_name_prefix = literal_prefix(wc);
+      // A package followed by ** matches all the classes under it. Class
+      // names never contain [ and always end with ;, so the regex has
+      // nothing left to check.
+      m_prefix_only = wc.size() == m_class_name_prefix.size() + 3 &&
+                      wc.compare(m_class_name_prefix.size(), 3, "**;") == 0;
+    }
+  }
 
   bool match(const DexClass* cls) {
     // Check for class name match
@@ -94,10 +122,19 @@ struct ClassMatcher {
     return match_extends(cls);
   }
 
+  // The start of the names of all the classes that can match, if any.
+  const std::string& class_name_prefix() const { return m_class_name_prefix; }
+
  private:
   bool match_name(const DexClass* cls) const {
     const auto& deob_name = cls->get_deobfuscated_name();
-    return boost::regex_match(deob_name, *m_cls);
+    // Most patterns start with a package; that rules out most classes
+    // without running the regex.
+    if (deob_name.compare(0, m_class_name_prefix.size(),
+                          m_class_name_prefix) != 0) {
+      return false;
+    }
+    return m_prefix_only || boost::regex_match(deob_name, *m_cls);
   }
 
   bool match_access(const DexClass* cls) const {
@@ -172,6 +209,8 @@ struct ClassMatcher {
   DexAccessFlags setFlags_;
   DexAccessFlags unsetFlags_;
   std::string m_class_name;
+  std::string m_class_name_prefix;
+  bool m_prefix_only{false};
   std::unique_ptr<boost::regex> m_cls;
   std::unique_ptr<boost::regex> m_anno;
   std::unique_ptr<boost::regex> m_extends;
@@ -219,6 +258,23 @@ void build_extends_or_implements_hierarchy(const Scope& scope,
   }
 }
 
+std::string field_regex(const MemberSpecification& field_spec) {
+  string_builders::StaticStringBuilder<3> ss;
+  ss << proguard_parser::form_member_regex(field_spec.name);
+  ss << "\\:";
+  ss << proguard_parser::form_type_regex(field_spec.descriptor);
+  return ss.str();
+}
+
+std::string method_regex(const MemberSpecification& method_spec) {
+  auto qualified_method_regex =
+      proguard_parser::form_member_regex(method_spec.name);
+  qualified_method_regex += "\\:";
+  qualified_method_regex +=
+      proguard_parser::form_type_regex(method_spec.descriptor);
+  return qualified_method_regex;
+}
+
 /*
  * This class contains the logic for matching against a single keep rule.
  */
@@ -229,7 +285,16 @@ class KeepRuleMatcher {
                   RegexMap& regex_map)
       : m_rule_type(rule_type),
         m_keep_rule(keep_rule),
-        m_regex_map(regex_map) {}
+        m_regex_map(regex_map) {
+    // Member regexes only depend on the rule, so compile them once rather
+    // than once per matched class.
+    for (const auto& field_spec : keep_rule.class_spec.fieldSpecifications) {
+      m_field_matchers.push_back(&register_matcher(field_regex(field_spec)));
+    }
+    for (const auto& method_spec : keep_rule.class_spec.methodSpecifications) {
+      m_method_matchers.push_back(&register_matcher(method_regex(method_spec)));
+    }
+  }
 
   ~KeepRuleMatcher() {
     TRACE(PGR, 3, "%s matched %lu classes and %lu members",
@@ -250,7 +315,8 @@ class KeepRuleMatcher {
       const DexClass* cls);
 
   bool any_field_matches(const DexClass* cls,
-                         const MemberSpecification& field_keep);
+                         const MemberSpecification& field_keep,
+                         const boost::regex& fieldname_regex);
 
   // Check that each field keep matches at least one field in :cls.
   bool all_field_keeps_match(
@@ -291,11 +357,12 @@ class KeepRuleMatcher {
   bool has_annotation(const DexMember* member,
                       const std::string& annotation) const;
 
-  boost::regex register_matcher(const std::string& regex) const {
-    if (!m_regex_map.count(regex)) {
-      m_regex_map.emplace(regex, boost::regex{regex});
+  const boost::regex& register_matcher(const std::string& regex) const {
+    auto it = m_regex_map.find(regex);
+    if (it == m_regex_map.end()) {
+      it = m_regex_map.emplace(regex, boost::regex{regex}).first;
     }
-    return m_regex_map.at(regex);
+    return it->second;
   }
 
   bool is_unused() const {
@@ -317,6 +384,10 @@ class KeepRuleMatcher {
   RuleType m_rule_type;
   const KeepSpec& m_keep_rule;
   RegexMap& m_regex_map;
+  // The compiled regexes of the field and method specifications of the rule,
+  // in the same order.
+  std::vector<const boost::regex*> m_field_matchers;
+  std::vector<const boost::regex*> m_method_matchers;
 
   std::mutex m_warn_mutex;
   std::unordered_set<std::string> m_already_warned;
@@ -329,7 +400,9 @@ class ProguardMatcher {
                   const Scope& external_classes)
       : m_pg_map(pg_map),
         m_classes(classes),
-        m_external_classes(external_classes) {
+        m_external_classes(external_classes),
+        m_classes_by_name(build_name_index(classes)),
+        m_external_classes_by_name(build_name_index(external_classes)) {
     build_extends_or_implements_hierarchy(m_classes, &m_hierarchy);
     // We need to include external classes in the hierarchy because keep rules
     // may, for instance, forbid renaming of all classes that inherit from a
@@ -351,9 +424,23 @@ class ProguardMatcher {
   }
 
  private:
+  // The positions of the classes of a scope, sorted by deobfuscated name.
+  using NameIndex = std::vector<std::pair<const std::string*, size_t>>;
+
+  static NameIndex build_name_index(const Scope& classes);
+
+  // Returns the classes whose deobfuscated name starts with the given prefix,
+  // in scope order.
+  static std::vector<DexClass*> find_classes_with_prefix(
+      const Scope& classes,
+      const NameIndex& index,
+      const std::string& prefix);
+
   const ProguardMap& m_pg_map;
   const Scope& m_classes;
   const Scope& m_external_classes;
+  const NameIndex m_classes_by_name;
+  const NameIndex m_external_classes_by_name;
   ClassHierarchy m_hierarchy;
   ConcurrentSet<const KeepSpec*> m_unused_rules;
 };
@@ -505,20 +592,12 @@ void KeepRuleMatcher::keep_fields(const Container& fields,
   }
 }
 
-std::string field_regex(const MemberSpecification& field_spec) {
-  string_builders::StaticStringBuilder<3> ss;
-  ss << proguard_parser::form_member_regex(field_spec.name);
-  ss << "\\:";
-  ss << proguard_parser::form_type_regex(field_spec.descriptor);
-  return ss.str();
-}
-
 void KeepRuleMatcher::apply_field_keeps(const DexClass* cls) {
-  for (const auto& field_spec : m_keep_rule.class_spec.fieldSpecifications) {
-    auto fieldname_regex = field_regex(field_spec);
-    const boost::regex& matcher = register_matcher(fieldname_regex);
-    keep_fields(cls->get_ifields(), field_spec, matcher);
-    keep_fields(cls->get_sfields(), field_spec, matcher);
+  const auto& field_specs = m_keep_rule.class_spec.fieldSpecifications;
+  for (size_t i = 0; i < field_specs.size(); ++i) {
+    const auto& matcher = *m_field_matchers[i];
+    keep_fields(cls->get_ifields(), field_specs[i], matcher);
+    keep_fields(cls->get_sfields(), field_specs[i], matcher);
   }
 }
 
@@ -560,22 +639,12 @@ void KeepRuleMatcher::keep_methods(
   }
 }
 
-std::string method_regex(const MemberSpecification& method_spec) {
-  auto qualified_method_regex =
-      proguard_parser::form_member_regex(method_spec.name);
-  qualified_method_regex += "\\:";
-  qualified_method_regex +=
-      proguard_parser::form_type_regex(method_spec.descriptor);
-  return qualified_method_regex;
-}
-
 void KeepRuleMatcher::apply_method_keeps(const DexClass* cls) {
-  auto methodSpecifications = m_keep_rule.class_spec.methodSpecifications;
-  for (auto& method_spec : methodSpecifications) {
-    auto qualified_method_regex = method_regex(method_spec);
-    const boost::regex& method_regex = register_matcher(qualified_method_regex);
-    keep_methods(method_spec, cls->get_vmethods(), method_regex);
-    keep_methods(method_spec, cls->get_dmethods(), method_regex);
+  const auto& method_specs = m_keep_rule.class_spec.methodSpecifications;
+  for (size_t i = 0; i < method_specs.size(); ++i) {
+    const auto& matcher = *m_method_matchers[i];
+    keep_methods(method_specs[i], cls->get_vmethods(), matcher);
+    keep_methods(method_specs[i], cls->get_dmethods(), matcher);
   }
 }
 
@@ -603,22 +672,19 @@ bool KeepRuleMatcher::any_method_matches(const DexClass* cls,
 // Check that each method keep matches at least one method in :cls.
 bool KeepRuleMatcher::all_method_keeps_match(
     const std::vector<MemberSpecification>& method_keeps, const DexClass* cls) {
-  return std::all_of(method_keeps.begin(),
-                     method_keeps.end(),
-                     [&](const MemberSpecification& method_keep) {
-                       auto qualified_method_regex = method_regex(method_keep);
-                       const boost::regex& matcher =
-                           register_matcher(qualified_method_regex);
-                       return any_method_matches(cls, method_keep, matcher);
-                     });
+  for (size_t i = 0; i < method_keeps.size(); ++i) {
+    if (!any_method_matches(cls, method_keeps[i], *m_method_matchers[i])) {
+      return false;
+    }
+  }
+  return true;
 }
 
 bool KeepRuleMatcher::any_field_matches(const DexClass* cls,
-                                        const MemberSpecification& field_keep) {
-  auto fieldtype_regex = field_regex(field_keep);
-  const boost::regex& matcher = register_matcher(fieldtype_regex);
+                                        const MemberSpecification& field_keep,
+                                        const boost::regex& fieldname_regex) {
   auto match = [&](const DexField* field) {
-    return field_level_match(field_keep, field, matcher);
+    return field_level_match(field_keep, field, fieldname_regex);
   };
   return std::any_of(cls->get_ifields().begin(), cls->get_ifields().end(),
                      match) ||
@@ -629,11 +695,12 @@ bool KeepRuleMatcher::any_field_matches(const DexClass* cls,
 // Check that each field keep matches at least one field in :cls.
 bool KeepRuleMatcher::all_field_keeps_match(
     const std::vector<MemberSpecification>& field_keeps, const DexClass* cls) {
-  return std::all_of(field_keeps.begin(),
-                     field_keeps.end(),
-                     [&](const MemberSpecification& field_keep) {
-                       return any_field_matches(cls, field_keep);
-                     });
+  for (size_t i = 0; i < field_keeps.size(); ++i) {
+    if (!any_field_matches(cls, field_keeps[i], *m_field_matchers[i])) {
+      return false;
+    }
+  }
+  return true;
 }
 
 bool KeepRuleMatcher::process_mark_conditionally(const DexClass* cls) {
@@ -774,6 +841,42 @@ DexClass* ProguardMatcher::find_single_class(
   return type_class(typ);
 }
 
+ProguardMatcher::NameIndex ProguardMatcher::build_name_index(
+    const Scope& classes) {
+  NameIndex index;
+  index.reserve(classes.size());
+  for (size_t i = 0; i < classes.size(); ++i) {
+    if (classes[i] != nullptr) {
+      index.emplace_back(&classes[i]->get_deobfuscated_name(), i);
+    }
+  }
+  std::sort(index.begin(), index.end(), [](const auto& a, const auto& b) {
+    return *a.first < *b.first;
+  });
+  return index;
+}
+
+std::vector<DexClass*> ProguardMatcher::find_classes_with_prefix(
+    const Scope& classes, const NameIndex& index, const std::string& prefix) {
+  auto it = std::lower_bound(
+      index.begin(), index.end(), prefix,
+      [](const auto& entry, const std::string& p) { return *entry.first < p; });
+  std::vector<size_t> positions;
+  for (; it != index.end() &&
+         it->first->compare(0, prefix.size(), prefix) == 0;
+       ++it) {
+    positions.push_back(it->second);
+  }
+  // Rules are applied to the classes in the same order as without the index.
+  std::sort(positions.begin(), positions.end());
+  std::vector<DexClass*> result;
+  result.reserve(positions.size());
+  for (auto i : positions) {
+    result.push_back(classes[i]);
+  }
+  return result;
+}
+
 void ProguardMatcher::process_keep(const KeepSpecSet& keep_rules,
                                    RuleType rule_type,
                                    bool process_external) {
@@ -807,13 +910,23 @@ void ProguardMatcher::process_keep(const KeepSpecSet& keep_rules,
     ClassMatcher class_match(*keep_rule);
     KeepRuleMatcher rule_matcher(rule_type, *keep_rule, regex_map);
 
-    for (const auto& cls : m_classes) {
-      process_single_keep(class_match, rule_matcher, cls);
-    }
-    if (process_external) {
-      for (const auto& cls : m_external_classes) {
+    // Only the classes under the literal prefix of the pattern can match.
+    // Every descriptor starts with L, so that alone doesn't narrow anything.
+    const auto& prefix = class_match.class_name_prefix();
+    auto process_scope = [&](const Scope& classes, const NameIndex& index) {
+      if (prefix.size() <= 1) {
+        for (const auto& cls : classes) {
+          process_single_keep(class_match, rule_matcher, cls);
+        }
+        return;
+      }
+      for (const auto& cls : find_classes_with_prefix(classes, index, prefix)) {
         process_single_keep(class_match, rule_matcher, cls);
       }
+    };
+    process_scope(m_classes, m_classes_by_name);
+    if (process_external) {
+      process_scope(m_external_classes, m_external_classes_by_name);
     }
 
     if (rule_matcher.is_unused()) {
@@ -7,6 +7,9 @@
 
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <numeric>
 #include <vector>
 
 #include "Macros.h"
@@ -15,6 +18,7 @@
 #include "ProguardParser.h"
 #include "ProguardRegex.h"
 #include "ReadMaybeMapped.h"
+#include "WorkQueue.h"
 
 namespace keep_rules {
 namespace proguard_parser {
@@ -1038,6 +1042,53 @@ void parse(const boost::string_view& config,
   }
 }
 
+template <typename T>
+void append(std::vector<T>&& from, std::vector<T>* into) {
+  into->insert(into->end(),
+               std::make_move_iterator(from.begin()),
+               std::make_move_iterator(from.end()));
+}
+
+/*
+ * Merge the configuration of a file into the configuration of the files that
+ * were parsed before it, with the same result as parsing it into the latter.
+ */
+void merge_configuration(ProguardConfiguration&& from,
+                         ProguardConfiguration* into) {
+  into->ok = from.ok;
+  append(std::move(from.includes), &into->includes);
+  if (!from.basedirectory.empty()) {
+    into->basedirectory = std::move(from.basedirectory);
+  }
+  append(std::move(from.injars), &into->injars);
+  append(std::move(from.outjars), &into->outjars);
+  append(std::move(from.libraryjars), &into->libraryjars);
+  append(std::move(from.printmapping), &into->printmapping);
+  append(std::move(from.printconfiguration), &into->printconfiguration);
+  append(std::move(from.printseeds), &into->printseeds);
+  append(std::move(from.printusage), &into->printusage);
+  append(std::move(from.keepdirectories), &into->keepdirectories);
+  // The options can only be turned away from their defaults.
+  into->shrink &= from.shrink;
+  into->optimize &= from.optimize;
+  into->allowaccessmodification |= from.allowaccessmodification;
+  into->dontobfuscate |= from.dontobfuscate;
+  into->dontusemixedcaseclassnames |= from.dontusemixedcaseclassnames;
+  into->dontpreverify |= from.dontpreverify;
+  into->verbose |= from.verbose;
+  if (!from.target_version.empty()) {
+    into->target_version = std::move(from.target_version);
+  }
+  into->keep_rules.merge(std::move(from.keep_rules));
+  into->assumenosideeffects_rules.merge(
+      std::move(from.assumenosideeffects_rules));
+  into->whyareyoukeeping_rules.merge(std::move(from.whyareyoukeeping_rules));
+  append(std::move(from.optimization_filters), &into->optimization_filters);
+  append(std::move(from.keepattributes), &into->keepattributes);
+  append(std::move(from.dontwarn), &into->dontwarn);
+  append(std::move(from.keeppackagenames), &into->keeppackagenames);
+}
+
 } // namespace
 
 void parse(std::istream& config,
@@ -1049,19 +1100,37 @@ void parse(std::istream& config,
 }
 
 void parse_file(const std::string& filename, ProguardConfiguration* pg_config) {
-  redex::read_file_with_contents(filename, [&](const char* data, size_t s) {
-    boost::string_view view(data, s);
-    parse(view, pg_config, filename);
-    // Parse the included files.
-    for (const auto& included_filename : pg_config->includes) {
-      if (pg_config->already_included.find(included_filename) !=
-          pg_config->already_included.end()) {
-        continue;
+  // Files are parsed in the order in which they are first included, i.e.
+  // breadth first. The files of each level are parsed in parallel into
+  // configurations of their own, which are then merged in order.
+  std::vector<std::string> level{filename};
+  while (!level.empty()) {
+    std::vector<std::unique_ptr<ProguardConfiguration>> configs(level.size());
+    std::vector<size_t> indices(level.size());
+    std::iota(indices.begin(), indices.end(), 0);
+    workqueue_run<size_t>(
+        [&](size_t i) {
+          configs[i] = std::make_unique<ProguardConfiguration>();
+          redex::read_file_with_contents(
+              level[i], [&](const char* data, size_t s) {
+                parse(boost::string_view(data, s), configs[i].get(), level[i]);
+              });
+        },
+        indices);
+
+    std::vector<std::string> next_level;
+    for (auto& config : configs) {
+      auto first_include = pg_config->includes.size();
+      merge_configuration(std::move(*config), pg_config);
+      for (auto i = first_include; i < pg_config->includes.size(); ++i) {
+        const auto& included_filename = pg_config->includes[i];
+        if (pg_config->already_included.emplace(included_filename).second) {
+          next_level.push_back(included_filename);
+        }
       }
-      pg_config->already_included.emplace(included_filename);
-      parse_file(included_filename, pg_config);
     }
-  });
+    level = std::move(next_level);
+  }
 }
 
 void remove_blocklisted_rules(ProguardConfiguration* pg_config) {
@@ -7,7 +7,10 @@
 
 #include "Purity.h"
 
-#include <sstream>
+#include <algorithm>
+#include <boost/functional/hash.hpp>
+#include <fstream>
+#include <limits>
 
 #include "ConfigFiles.h"
 #include "ControlFlow.h"
@@ -15,10 +18,10 @@
 #include "IRInstruction.h"
 #include "Resolver.h"
 #include "Show.h"
-#include "StlUtil.h"
+#include "SummarySerialization.h"
 #include "Trace.h"
 #include "Walkers.h"
-#include "WeakTopologicalOrdering.h"
+#include "WorkQueue.h"
 
 namespace purity {
 
@@ -34,11 +37,8 @@ void CacheConfig::parse_default(const ConfigFiles& conf) {
     auto purity = JsonWrapper(json["purity"]);
     if (purity.contains("cache")) {
       auto cache = JsonWrapper(purity["cache"]);
-      cache.get("max_entries", def.max_entries, def.max_entries);
-      cache.get("fill_entry_threshold", def.fill_entry_threshold,
-                def.fill_entry_threshold);
-      cache.get("fill_size_threshold", def.fill_size_threshold,
-                def.fill_size_threshold);
+      cache.get("summary_cache_dir", def.summary_cache_dir,
+                def.summary_cache_dir);
     }
   }
 }
@@ -437,13 +437,72 @@ bool process_base_and_overriding_methods(
   return true;
 }
 
+namespace {
+
+// The persisted result of a method; none means that its read locations are
+// unknown.
+using CachedLocations = boost::optional<CseUnorderedLocationSet>;
+
+sparta::s_expr cached_locations_to_s_expr(const CachedLocations& locations) {
+  if (!locations) {
+    return sparta::s_expr("unknown");
+  }
+  std::vector<CseLocation> ordered(locations->begin(), locations->end());
+  std::sort(ordered.begin(), ordered.end());
+  std::vector<sparta::s_expr> s_exprs;
+  for (auto location : ordered) {
+    if (location.has_field()) {
+      s_exprs.emplace_back(show(location.get_field()));
+    } else {
+      s_exprs.emplace_back(static_cast<int32_t>(location.special_location));
+    }
+  }
+  return sparta::s_expr(s_exprs);
+}
+
+boost::optional<CachedLocations> cached_locations_from_s_expr(
+    const sparta::s_expr& expr) {
+  if (expr.is_string() && expr.get_string() == "unknown") {
+    return boost::make_optional(CachedLocations());
+  }
+  if (!expr.is_list()) {
+    return boost::none;
+  }
+  CseUnorderedLocationSet locations;
+  for (size_t i = 0; i < expr.size(); ++i) {
+    const auto& location = expr[i];
+    if (location.is_int32()) {
+      auto special_location = location.get_int32();
+      if (special_location < 0 ||
+          special_location >=
+              static_cast<int32_t>(CseSpecialLocations::END)) {
+        return boost::none;
+      }
+      locations.insert(
+          CseLocation(static_cast<CseSpecialLocations>(special_location)));
+    } else if (location.is_string()) {
+      auto field_ref = DexField::get_field(location.get_string());
+      auto field = field_ref == nullptr ? nullptr : field_ref->as_def();
+      if (field == nullptr) {
+        return boost::none;
+      }
+      locations.insert(CseLocation(field));
+    } else {
+      return boost::none;
+    }
+  }
+  return boost::make_optional(CachedLocations(std::move(locations)));
+}
+
+} // namespace
+
 size_t compute_locations_closure(
     const Scope& scope,
     const method_override_graph::Graph* method_override_graph,
     std::function<boost::optional<LocationsAndDependencies>(DexMethod*)>
         init_func,
     std::unordered_map<const DexMethod*, CseUnorderedLocationSet>* result,
-    const purity::CacheConfig& cache_config) {
+    const purity::SummaryCache* summary_cache) {
   // 1. Let's initialize known method read locations and dependencies by
   //    scanning method bodies
   ConcurrentMap<const DexMethod*, LocationsAndDependencies>
@@ -458,230 +517,205 @@ size_t compute_locations_closure(
   std::unordered_map<const DexMethod*, LocationsAndDependencies> method_lads(
       concurrent_method_lads.begin(), concurrent_method_lads.end());
 
-  // 2. Compute inverse dependencies so that we know what needs to be recomputed
-  // during the fixpoint computation, and determine set of methods that are
-  // initially "impacted" in the sense that they have dependencies.
-  std::unordered_map<const DexMethod*, std::unordered_set<const DexMethod*>>
-      inverse_dependencies;
-  std::unordered_set<const DexMethod*> impacted_methods;
-  for (const auto& p : method_lads) {
-    auto method = p.first;
-    auto& lads = p.second;
-    if (!lads.dependencies.empty()) {
-      for (auto d : lads.dependencies) {
-        inverse_dependencies[d].insert(method);
+  // 1b. Methods that didn't change since a previous build, and that only
+  //     depend on methods that didn't change either, have the same result as
+  //     back then; we don't need to include them in the fixpoint computation.
+  summary_serialization::CacheKeys cache_keys;
+  if (summary_cache != nullptr) {
+    Timer t("Loading summaries");
+    std::vector<const DexMethod*> methods;
+    walk::methods(scope, [&](DexMethod* method) { methods.push_back(method); });
+    cache_keys = summary_serialization::compute_cache_keys(
+        methods,
+        [&method_lads](const DexMethod* method) {
+          std::vector<const DexMethod*> dependencies;
+          auto it = method_lads.find(method);
+          if (it != method_lads.end()) {
+            dependencies.assign(it->second.dependencies.begin(),
+                                it->second.dependencies.end());
+          }
+          return dependencies;
+        },
+        summary_cache->salt);
+    std::unordered_map<const DexMethod*, CachedLocations> cached;
+    std::ifstream input(summary_cache->path);
+    if (input) {
+      auto loaded = summary_serialization::read_cache<CachedLocations>(
+          input, cache_keys, cached_locations_from_s_expr, &cached);
+      TRACE(PURITY, 1, "Loaded %zu summaries from %s", loaded,
+            summary_cache->path.c_str());
+    }
+    for (auto& p : cached) {
+      auto it = method_lads.find(p.first);
+      if (it == method_lads.end()) {
+        continue;
+      }
+      if (!p.second) {
+        method_lads.erase(it);
+        continue;
       }
-      impacted_methods.insert(method);
+      it->second.locations = std::move(*p.second);
+      it->second.dependencies.clear();
     }
   }
 
-  // 3. Let's try to (semantically) inline locations, computing a fixed
-  //    point. Methods for which information is directly or indirectly absent
-  //    are equivalent to a general memory barrier, and are systematically
-  //    pruned.
-
-  // TODO: Instead of custom fixpoint computation using WTO, consider using the
-  // MonotonicFixpointIterator, operating on a callgraph, capture the
-  // dependencies, and have the Locations as the abstract domain.
-
-  size_t iterations = 0;
-  while (!impacted_methods.empty()) {
-    iterations++;
-    Timer t{std::string("Iteration ") + std::to_string(iterations)};
-
-    // We order the impacted methods in a deterministic way that's likely
-    // helping to reduce the number of needed iterations.
-    std::vector<const DexMethod*> ordered_impacted_methods;
-
-    {
-      constexpr bool kCacheDebug = false;
-
-      struct Cache {
-        struct CacheData {
-          size_t runs{0};
-          size_t size_if_populated{0};
-          std::vector<const DexMethod*> data;
-        };
-        std::unordered_map<const DexMethod*, CacheData> cache;
-        size_t sum_entries{0};
-        size_t pop_miss{0};
-
-        const size_t cache_max_entries;
-        const size_t cache_fill_entry_threshold;
-        const size_t cache_fill_size_threshold;
-
-        explicit Cache(const purity::CacheConfig& config)
-            : cache_max_entries(config.max_entries),
-              cache_fill_entry_threshold(config.fill_entry_threshold),
-              cache_fill_size_threshold(config.fill_size_threshold) {}
-
-        boost::optional<std::vector<const DexMethod*>> get(const DexMethod* m) {
-          auto it = cache.find(m);
-          if (it == cache.end()) {
-            return boost::none;
-          }
-          redex_assert(it->second.runs > 0);
-          if (it->second.runs < cache_fill_entry_threshold) {
-            return boost::none;
+  // 2. Group the methods into the strongly connected components of the
+  //    dependency graph. All methods of a component depend on each other, so
+  //    they end up with the same locations. Components are numbered
+  //    dependencies first, and each one is assigned a level, one more than
+  //    the highest level of the components it depends on.
+  std::vector<const DexMethod*> ordered_methods;
+  ordered_methods.reserve(method_lads.size());
+  for (const auto& p : method_lads) {
+    ordered_methods.push_back(p.first);
+  }
+  // Make the numbering deterministic.
+  std::sort(ordered_methods.begin(), ordered_methods.end(), compare_dexmethods);
+
+  constexpr size_t kUnvisited = std::numeric_limits<size_t>::max();
+  // A component that isn't in method_lads, i.e. an unknown method.
+  constexpr size_t kUnknownComponent = kUnvisited - 1;
+  struct Node {
+    size_t index{kUnvisited};
+    size_t low_link{kUnvisited};
+    size_t component{kUnvisited};
+    std::vector<const DexMethod*> successors;
+  };
+  std::unordered_map<const DexMethod*, Node> nodes;
+  nodes.reserve(method_lads.size());
+  for (auto method : ordered_methods) {
+    auto& node = nodes[method];
+    for (auto d : method_lads.at(method).dependencies) {
+      if (d != method) {
+        node.successors.push_back(d);
+      }
+    }
+    std::sort(node.successors.begin(), node.successors.end(),
+              compare_dexmethods);
+  }
+  auto component_of = [&nodes](const DexMethod* method) {
+    auto it = nodes.find(method);
+    return it == nodes.end() ? kUnknownComponent : it->second.component;
+  };
+
+  std::vector<std::vector<const DexMethod*>> components;
+  std::vector<size_t> component_levels;
+  {
+    // An iterative version of Tarjan's algorithm.
+    size_t next_index = 0;
+    std::vector<const DexMethod*> tarjan_stack;
+    std::vector<std::pair<const DexMethod*, size_t>> call_stack;
+    for (auto root : ordered_methods) {
+      if (nodes.at(root).index != kUnvisited) {
+        continue;
+      }
+      auto visit = [&](const DexMethod* method) {
+        auto& node = nodes.at(method);
+        node.index = node.low_link = next_index++;
+        tarjan_stack.push_back(method);
+        call_stack.emplace_back(method, 0);
+      };
+      visit(root);
+      while (!call_stack.empty()) {
+        auto method = call_stack.back().first;
+        auto& node = nodes.at(method);
+        auto& next_successor = call_stack.back().second;
+        if (next_successor < node.successors.size()) {
+          auto it = nodes.find(node.successors[next_successor++]);
+          if (it == nodes.end()) {
+            continue;
           }
-          ++it->second.runs;
-          if (it->second.size_if_populated > 0) {
-            // We did not have space.
-            pop_miss++;
-            return boost::none;
+          if (it->second.index == kUnvisited) {
+            visit(it->first);
+          } else if (it->second.component == kUnvisited) {
+            node.low_link = std::min(node.low_link, it->second.index);
           }
-          return it->second.data;
+          continue;
         }
-
-        void new_data(const DexMethod* m,
-                      const std::vector<const DexMethod*>& data) {
-          CacheData& cd = cache[m];
-          cd.runs++;
-          if (cd.runs < cache_fill_entry_threshold) {
-            return; // Do not cache, yet.
-          }
-          size_t size = data.size();
-          if (size >= cache_fill_size_threshold &&
-              sum_entries + size <= cache_max_entries) {
-            redex_assert(cd.size_if_populated == 0);
-            cd.data = data;
-            sum_entries += size;
-          } else {
-            redex_assert(cd.size_if_populated == 0 ||
-                         cd.size_if_populated == size);
-            cd.size_if_populated = size;
-          }
+        call_stack.pop_back();
+        if (!call_stack.empty()) {
+          auto& caller = nodes.at(call_stack.back().first);
+          caller.low_link = std::min(caller.low_link, node.low_link);
         }
-
-        void print_stats() const {
-          std::ostringstream oss;
-
-          size_t sum_not_pop{0};
-          size_t max_not_pop{0};
-          size_t max_pop{0};
-          size_t max_not_pop_runs{0};
-          size_t max_pop_runs{0};
-          size_t below_size_thresh{0};
-          size_t runs_below_size_thresh{0};
-          for (const auto& p : cache) {
-            sum_not_pop += p.second.size_if_populated;
-            max_not_pop = std::max(max_not_pop, p.second.size_if_populated);
-            if (p.second.size_if_populated > 0) {
-              max_not_pop_runs = std::max(max_not_pop_runs, p.second.runs);
-              if (p.second.size_if_populated < cache_fill_size_threshold) {
-                ++below_size_thresh;
-                runs_below_size_thresh += p.second.runs;
-              }
-            } else {
-              max_pop_runs = std::max(max_pop_runs, p.second.runs);
-              max_pop = std::max(max_pop, p.second.data.size());
+        if (node.low_link != node.index) {
+          continue;
+        }
+        // The components this one depends on are all numbered already.
+        size_t component = components.size();
+        size_t level = 0;
+        components.emplace_back();
+        const DexMethod* member;
+        do {
+          member = tarjan_stack.back();
+          tarjan_stack.pop_back();
+          nodes.at(member).component = component;
+          components.back().push_back(member);
+        } while (member != method);
+        for (auto m : components.back()) {
+          for (auto d : nodes.at(m).successors) {
+            auto c = component_of(d);
+            if (c != component && c != kUnknownComponent) {
+              level = std::max(level, component_levels.at(c) + 1);
             }
           }
-          oss << "  In=" << sum_entries << " Miss=" << pop_miss << std::endl;
-          oss << "  CACHED: Max=" << max_pop << " Runs=" << max_pop_runs
-              << std::endl;
-          oss << " NCACHED: Sum=" << sum_not_pop << " Max=" << max_not_pop
-              << " Runs=" << max_not_pop_runs << std::endl;
-          oss << " NCACHED: #short=" << below_size_thresh
-              << " Runs=" << runs_below_size_thresh;
-          TRACE(PURITY, 1, "%s", oss.str().c_str());
         }
-      };
-
-      Cache cache(cache_config);
-      sparta::WeakTopologicalOrdering<const DexMethod*> wto(
-          nullptr,
-          [&impacted_methods, &inverse_dependencies,
-           &cache](const DexMethod* const& m) {
-            auto cached = cache.get(m);
-            if (cached && !kCacheDebug) {
-              return std::move(*cached);
-            }
-
-            std::vector<const DexMethod*> successors;
-            if (m == nullptr) {
-              std::copy(impacted_methods.begin(), impacted_methods.end(),
-                        std::back_inserter(successors));
-            } else {
-              auto it = inverse_dependencies.find(m);
-              if (it != inverse_dependencies.end()) {
-                for (auto n : it->second) {
-                  if (impacted_methods.count(n)) {
-                    successors.push_back(n);
-                  }
-                }
-              }
-            }
-            // Make number of iterations deterministic
-            std::sort(successors.begin(), successors.end(), compare_dexmethods);
-
-            if (kCacheDebug && cached) {
-              redex_assert(*cached == successors);
-            }
-
-            cache.new_data(m, successors);
-            return successors;
-          });
-
-      if (traceEnabled(PURITY, 5)) {
-        cache.print_stats();
+        component_levels.push_back(level);
       }
-
-      wto.visit_depth_first([&ordered_impacted_methods](const DexMethod* m) {
-        if (m) {
-          ordered_impacted_methods.push_back(m);
-        }
-      });
-      impacted_methods.clear();
     }
+  }
 
-    std::vector<const DexMethod*> changed_methods;
-    for (const DexMethod* method : ordered_impacted_methods) {
-      auto& lads = method_lads.at(method);
-      bool unknown = false;
-      size_t lads_locations_size = lads.locations.size();
-      for (const DexMethod* d : lads.dependencies) {
-        if (d == method) {
-          continue;
-        }
-        auto it = method_lads.find(d);
-        if (it == method_lads.end()) {
-          unknown = true;
-          break;
-        }
-        const auto& other_locations = it->second.locations;
-        lads.locations.insert(other_locations.begin(), other_locations.end());
-      }
-      if (unknown || lads_locations_size < lads.locations.size()) {
-        // something changed
-        changed_methods.push_back(method);
-        if (unknown) {
-          method_lads.erase(method);
-        }
-      }
+  std::vector<std::vector<size_t>> levels;
+  for (size_t c = 0; c < components.size(); c++) {
+    auto level = component_levels[c];
+    if (levels.size() <= level) {
+      levels.resize(level + 1);
     }
+    levels[level].push_back(c);
+  }
 
-    // Given set of changed methods, determine set of dependents for which
-    // we need to re-run the analysis in another iteration.
-    for (auto changed_method : changed_methods) {
-      auto idit = inverse_dependencies.find(changed_method);
-      if (idit == inverse_dependencies.end()) {
-        continue;
-      }
-
-      // remove inverse dependency entries as appropriate
-      auto& entries = idit->second;
-      std20::erase_if(entries, [&](auto* m) { return !method_lads.count(m); });
+  // 3. Let's (semantically) inline locations, one level at a time. The
+  //    components of a level only depend on components of lower levels, so
+  //    they can be processed in parallel. Methods for which information is
+  //    directly or indirectly absent are equivalent to a general memory
+  //    barrier, and are systematically pruned.
+  std::vector<CseUnorderedLocationSet> component_locations(components.size());
+  // Not a vector<bool>, as components are updated concurrently.
+  std::vector<char> component_unknown(components.size(), false);
+  for (const auto& level : levels) {
+    workqueue_run<size_t>(
+        [&](size_t c) {
+          auto& locations = component_locations[c];
+          for (auto m : components[c]) {
+            const auto& lads = method_lads.at(m);
+            locations.insert(lads.locations.begin(), lads.locations.end());
+            for (auto d : nodes.at(m).successors) {
+              auto other = component_of(d);
+              if (other == c) {
+                continue;
+              }
+              if (other == kUnknownComponent || component_unknown[other]) {
+                component_unknown[c] = true;
+                locations.clear();
+                return;
+              }
+              const auto& other_locations = component_locations[other];
+              locations.insert(other_locations.begin(), other_locations.end());
+            }
+          }
+        },
+        level);
+  }
 
-      if (entries.empty()) {
-        // remove inverse dependency
-        inverse_dependencies.erase(changed_method);
+  for (size_t c = 0; c < components.size(); c++) {
+    for (auto m : components[c]) {
+      if (component_unknown[c]) {
+        method_lads.erase(m);
       } else {
-        // add inverse dependencies entries to impacted methods
-        impacted_methods.insert(entries.begin(), entries.end());
+        method_lads.at(m).locations = component_locations[c];
       }
     }
   }
+  size_t iterations = levels.size();
 
   // For all methods which have a known set of locations at this point,
   // persist that information
@@ -689,6 +723,19 @@ size_t compute_locations_closure(
     result->emplace(p.first, p.second.locations);
   }
 
+  if (summary_cache != nullptr) {
+    std::unordered_map<const DexMethod*, CachedLocations> summaries;
+    for (const auto& p : cache_keys) {
+      auto it = method_lads.find(p.first);
+      summaries.emplace(p.first, it == method_lads.end()
+                                     ? CachedLocations()
+                                     : CachedLocations(it->second.locations));
+    }
+    std::ofstream output(summary_cache->path);
+    summary_serialization::write_cache<CachedLocations>(
+        output, summaries, cache_keys, cached_locations_to_s_expr);
+  }
+
   return iterations;
 }
 
@@ -712,6 +759,7 @@ static size_t analyze_read_locations(
     bool ignore_methods_with_assumenosideeffects,
     bool for_conditional_purity,
     bool compute_locations,
+    const std::string& summary_cache_name,
     std::unordered_map<const DexMethod*, CseUnorderedLocationSet>* result,
     const purity::CacheConfig& cache_config) {
   std::unordered_set<const DexMethod*> pure_methods_closure;
@@ -730,6 +778,27 @@ static size_t analyze_read_locations(
     }
   }
 
+  boost::optional<purity::SummaryCache> summary_cache;
+  if (!cache_config.summary_cache_dir.empty()) {
+    // Bump the version when changing the analysis below.
+    constexpr size_t kSummaryCacheVersion = 1;
+    std::vector<std::string> pure_method_names;
+    for (auto pure_method : pure_methods_closure) {
+      pure_method_names.push_back(show(pure_method));
+    }
+    std::sort(pure_method_names.begin(), pure_method_names.end());
+    summary_cache = purity::SummaryCache();
+    summary_cache->path =
+        cache_config.summary_cache_dir + "/" + summary_cache_name + ".txt";
+    boost::hash_combine(summary_cache->salt, kSummaryCacheVersion);
+    boost::hash_range(summary_cache->salt, pure_method_names.begin(),
+                      pure_method_names.end());
+    boost::hash_combine(summary_cache->salt,
+                        ignore_methods_with_assumenosideeffects);
+    boost::hash_combine(summary_cache->salt, for_conditional_purity);
+    boost::hash_combine(summary_cache->salt, compute_locations);
+  }
+
   return compute_locations_closure(
       scope, method_override_graph,
       [&](DexMethod* method) -> boost::optional<LocationsAndDependencies> {
@@ -825,7 +894,7 @@ static size_t analyze_read_locations(
 
         return lads;
       },
-      result, cache_config);
+      result, summary_cache.get_ptr());
 }
 
 size_t compute_conditionally_pure_methods(
@@ -839,7 +908,8 @@ size_t compute_conditionally_pure_methods(
       scope, method_override_graph, pure_methods,
       /* ignore_methods_with_assumenosideeffects */ false,
       /* for_conditional_purity */ true,
-      /* compute_locations */ true, result, cache_config);
+      /* compute_locations */ true, "conditionally_pure_methods", result,
+      cache_config);
   for (auto& p : *result) {
     TRACE(CSE, 4, "[CSE] conditionally pure method %s: %s", SHOW(p.first),
           SHOW(&p.second));
@@ -860,7 +930,8 @@ size_t compute_no_side_effects_methods(
       scope, method_override_graph, pure_methods,
       /* ignore_methods_with_assumenosideeffects */ true,
       /* for_conditional_purity */ false,
-      /* compute_locations */ false, &method_locations, cache_config);
+      /* compute_locations */ false, "no_side_effects_methods",
+      &method_locations, cache_config);
   for (auto& p : method_locations) {
     TRACE(CSE, 4, "[CSE] no side effects method %s", SHOW(p.first));
     result->insert(p.first);
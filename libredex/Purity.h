@@ -125,20 +125,36 @@ enum class MethodOverrideAction {
 namespace purity {
 
 struct CacheConfig {
-  // How many *vector* entries in sum to cache overall.
-  size_t max_entries{4 * 1024 * 1024};
-
-  // Amount of iterations needed to cache.
-  size_t fill_entry_threshold{2};
-
-  // Minimum vector size to cache.
-  size_t fill_size_threshold{5};
+  // Directory in which the per-method results of the purity analyses are
+  // persisted, to be reused by the next build for unchanged methods. Empty
+  // means that nothing is persisted.
+  std::string summary_cache_dir;
 
   static CacheConfig& get_default();
   static void set_default(const CacheConfig& def) { get_default() = def; }
   static void parse_default(const ConfigFiles& conf);
 };
 
+// A file holding the per-method results of a previous run of
+// compute_locations_closure. The salt must capture everything besides the
+// code of the methods that the results depend on.
+struct SummaryCache {
+  std::string path;
+  size_t salt{0};
+};
+
+// The results of compute_no_side_effects_methods and
+// compute_conditionally_pure_methods over a whole scope, together with the
+// pure methods they were computed for.
+struct AnalysisResult {
+  std::unordered_set<DexMethodRef*> pure_methods;
+  std::unordered_set<const DexMethod*> no_side_effects_methods;
+  size_t no_side_effects_methods_iterations{0};
+  std::unordered_map<const DexMethod*, CseUnorderedLocationSet>
+      conditionally_pure_methods;
+  size_t conditionally_pure_methods_iterations{0};
+};
+
 } // namespace purity
 
 // Determine what action to take for a method while traversing a base method
@@ -165,16 +181,21 @@ bool process_base_and_overriding_methods(
 // account all overriding methods.
 // When encountering unknown method implementations, the resulting map will have
 // no entry for the relevant (base) methods.
-// The return value indicates how many iterations the fixed-point computation
-// required.
+// The methods whose dependencies are known are processed in parallel, one
+// strongly connected component of the dependency graph at a time, and
+// components only after the ones they depend on. The return value indicates
+// how many rounds of components this required, i.e. the length of the longest
+// chain of dependencies between components.
+// When a summary cache is given, the methods whose code and transitive
+// dependencies didn't change since the cache was written start out with their
+// final result, and the cache is then updated with the new results.
 size_t compute_locations_closure(
     const Scope& scope,
     const method_override_graph::Graph* method_override_graph,
     std::function<boost::optional<LocationsAndDependencies>(DexMethod*)>
         init_func,
     std::unordered_map<const DexMethod*, CseUnorderedLocationSet>* result,
-    const purity::CacheConfig& cache_config =
-        purity::CacheConfig::get_default());
+    const purity::SummaryCache* summary_cache = nullptr);
 
 // Compute all "conditionally pure" methods, i.e. methods which are pure except
 // that they may read from a set of well-known locations (not including
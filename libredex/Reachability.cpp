@@ -7,8 +7,12 @@
 
 #include "Reachability.h"
 
+#include <numeric>
+
 #include <boost/bimap/bimap.hpp>
 #include <boost/bimap/unordered_set_of.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/optional.hpp>
 #include <boost/range/adaptor/map.hpp>
 
 #include "BinarySerialization.h"
@@ -46,8 +50,9 @@ std::unique_ptr<ReachableObjects> setup_seeds_and_compute_reachable_objects(
     bool remove_no_argument_constructors) {
   Timer t("Marking");
   auto scope = build_class_scope(stores);
-  auto reachable_objects = std::make_unique<ReachableObjects>();
-  ConditionallyMarked cond_marked;
+  ObjectIds ids(scope);
+  auto reachable_objects = std::make_unique<ReachableObjects>(ids);
+  ConditionallyMarked cond_marked(ids);
   auto method_override_graph = mog::build_graph(scope);
 
   ConcurrentSet<ReachableObject, ReachableObjectHash> root_set;
@@ -60,19 +65,23 @@ std::unique_ptr<ReachableObjects> setup_seeds_and_compute_reachable_objects(
 
   size_t num_threads = redex_parallel::default_num_threads();
   auto stats_arr = std::make_unique<Stats[]>(num_threads);
-  workqueue_run<ReachableObject>(
+  auto wq = workqueue_foreach<ReachableObject>(
       [&](MarkWorkerState* worker_state, const ReachableObject& obj) {
         TransitiveClosureMarker transitive_closure_marker(
             ignore_sets, *method_override_graph, record_reachability,
             &cond_marked, reachable_objects.get(), worker_state,
             &stats_arr[worker_state->worker_id()],
             remove_no_argument_constructors);
-        transitive_closure_marker.visit(obj);
+        transitive_closure_marker.visit_transitively(obj);
         return nullptr;
       },
-      root_set,
       num_threads,
-      /*push_tasks_while_running=*/true);
+      /*push_tasks_while_running=*/true,
+      /*lock_free_queues=*/true);
+  for (const auto& obj : root_set) {
+    wq.add_item(obj);
+  }
+  wq.run_all();
 
   if (num_ignore_check_strings != nullptr) {
     for (size_t i = 0; i < num_threads; ++i) {
@@ -92,6 +101,31 @@ namespace reachability {
 
 DexMethodRef* TransitiveClosureMarker::s_class_forname = nullptr;
 
+ObjectIds::ObjectIds(const Scope& scope) {
+  auto classes = std::make_shared<ObjectIdMap<DexClass>>();
+  auto fields = std::make_shared<ObjectIdMap<DexFieldRef>>();
+  auto methods = std::make_shared<ObjectIdMap<DexMethodRef>>();
+  classes->reserve(scope.size());
+  for (const auto* cls : scope) {
+    classes->emplace(cls, classes->size());
+    for (const auto* field : cls->get_sfields()) {
+      fields->emplace(field, fields->size());
+    }
+    for (const auto* field : cls->get_ifields()) {
+      fields->emplace(field, fields->size());
+    }
+    for (const auto* method : cls->get_dmethods()) {
+      methods->emplace(method, methods->size());
+    }
+    for (const auto* method : cls->get_vmethods()) {
+      methods->emplace(method, methods->size());
+    }
+  }
+  this->classes = std::move(classes);
+  this->fields = std::move(fields);
+  this->methods = std::move(methods);
+}
+
 std::ostream& operator<<(std::ostream& os, const ReachableObject& obj) {
   switch (obj.type) {
   case ReachableObjectType::ANNO:
@@ -262,6 +296,53 @@ void TransitiveClosureMarker::visit(const ReachableObject& obj) {
   }
 }
 
+void TransitiveClosureMarker::visit_transitively(const ReachableObject& obj) {
+  visit(obj);
+  visit_frontier();
+}
+
+void TransitiveClosureMarker::revisit_transitively(const ReachableObject& obj) {
+  switch (obj.type) {
+  case ReachableObjectType::ANNO:
+    gather_and_push(obj.anno);
+    break;
+  case ReachableObjectType::FIELD: {
+    // The references of field definitions are pushed along with the field.
+    auto f = obj.field->as_def();
+    if (f) {
+      gather_and_push(f);
+    }
+    visit_field_ref(obj.field);
+    break;
+  }
+  default:
+    visit(obj);
+    break;
+  }
+  visit_frontier();
+}
+
+void TransitiveClosureMarker::visit_frontier() {
+  // Large enough to amortize the pushes to the work queue, small enough for
+  // the other workers not to starve.
+  constexpr size_t kMaxFrontierSize = 64;
+  while (!m_frontier.empty()) {
+    if (m_frontier.size() > kMaxFrontierSize) {
+      // Share the oldest objects, which tend to be the roots of the largest
+      // subgraphs, and keep going depth-first on the newest ones.
+      size_t num_kept = kMaxFrontierSize / 2;
+      auto end = m_frontier.end() - num_kept;
+      for (auto it = m_frontier.begin(); it != end; ++it) {
+        m_worker_state->push_task(*it);
+      }
+      m_frontier.erase(m_frontier.begin(), end);
+    }
+    auto next = m_frontier.back();
+    m_frontier.pop_back();
+    visit(next);
+  }
+}
+
 template <class Parent, class InputIt>
 void TransitiveClosureMarker::push(const Parent* parent,
                                    InputIt begin,
@@ -274,13 +355,17 @@ void TransitiveClosureMarker::push(const Parent* parent,
 template <class Parent>
 void TransitiveClosureMarker::push(const Parent* parent, const DexType* type) {
   type = type::get_element_type_if_array(type);
-  push(parent, type_class(type));
+  auto cls = type_class(type);
+  if (!cls) {
+    record_unresolved_type(parent, type);
+    return;
+  }
+  push(parent, cls);
 }
 
 void TransitiveClosureMarker::push(const DexMethodRef* parent,
                                    const DexType* type) {
-  type = type::get_element_type_if_array(type);
-  push(parent, type_class(type));
+  this->template push<DexMethodRef>(parent, type);
 }
 
 template <class Parent>
@@ -289,11 +374,11 @@ void TransitiveClosureMarker::push(const Parent* parent, const DexClass* cls) {
     return;
   }
   record_reachability(parent, cls);
-  if (m_reachable_objects->marked(cls)) {
+  if (!m_reachable_objects->mark(cls)) {
     return;
   }
-  m_reachable_objects->mark(cls);
-  m_worker_state->push_task(ReachableObject(cls));
+  record_derivation(parent, cls);
+  enqueue(ReachableObject(cls));
 }
 
 template <class Parent>
@@ -303,15 +388,15 @@ void TransitiveClosureMarker::push(const Parent* parent,
     return;
   }
   record_reachability(parent, field);
-  if (m_reachable_objects->marked(field)) {
+  if (!m_reachable_objects->mark(field)) {
     return;
   }
+  record_derivation(parent, field);
   auto f = field->as_def();
   if (f) {
     gather_and_push(f);
   }
-  m_reachable_objects->mark(field);
-  m_worker_state->push_task(ReachableObject(field));
+  enqueue(ReachableObject(field));
 }
 
 template <class Parent>
@@ -326,11 +411,11 @@ void TransitiveClosureMarker::push(const Parent* parent,
   }
 
   record_reachability(parent, method);
-  if (m_reachable_objects->marked(method)) {
+  if (!m_reachable_objects->mark(method)) {
     return;
   }
-  m_reachable_objects->mark(method);
-  m_worker_state->push_task(ReachableObject(method));
+  record_derivation(parent, method);
+  enqueue(ReachableObject(method));
 }
 
 void TransitiveClosureMarker::push(const DexMethodRef* parent,
@@ -418,6 +503,8 @@ void TransitiveClosureMarker::gather_and_push(DexMethod* meth) {
   push(meth, refs.fields.begin(), refs.fields.end());
   push(meth, refs.methods.begin(), refs.methods.end());
   for (auto* cond_meth : refs.cond_methods) {
+    record_reference(meth, cond_meth);
+    record_derivation(meth, cond_meth);
     push_cond(cond_meth);
   }
 }
@@ -460,7 +547,9 @@ void TransitiveClosureMarker::visit_cls(const DexClass* cls) {
       }
     }
   }
-  push(cls, type_class(cls->get_super_class()));
+  if (cls->get_super_class()) {
+    push(cls, cls->get_super_class());
+  }
   for (auto const& t : cls->get_interfaces()->get_type_list()) {
     push(cls, t);
   }
@@ -476,6 +565,7 @@ void TransitiveClosureMarker::visit_cls(const DexClass* cls) {
         continue;
       }
       record_reachability(cls, anno);
+      record_derivation(cls, anno);
       gather_and_push(anno);
     }
   }
@@ -566,6 +656,8 @@ void TransitiveClosureMarker::visit_method_ref(const DexMethodRef* method) {
     const auto& overriding_methods =
         mog::get_overriding_methods(m_method_override_graph, m);
     for (auto* overriding : overriding_methods) {
+      record_reference(m, overriding);
+      record_derivation(m, overriding);
       push_cond(overriding);
     }
   }
@@ -574,12 +666,38 @@ void TransitiveClosureMarker::visit_method_ref(const DexMethodRef* method) {
 template <class Parent, class Object>
 void TransitiveClosureMarker::record_reachability(Parent* parent,
                                                   Object* object) {
+  record_reference(parent, object);
   if (m_record_reachability) {
     redex_assert(parent != nullptr && object != nullptr);
     m_reachable_objects->record_reachability(parent, object);
   }
 }
 
+template <class Parent, class Object>
+void TransitiveClosureMarker::record_reference(Parent* parent, Object* object) {
+  if (m_references) {
+    m_references->edges.emplace_back(ReachableObject(parent),
+                                     ReachableObject(object));
+  }
+}
+
+template <class Parent, class Object>
+void TransitiveClosureMarker::record_derivation(Parent* parent,
+                                                Object* object) {
+  if (m_references) {
+    m_references->derivations.emplace_back(ReachableObject(parent),
+                                           ReachableObject(object));
+  }
+}
+
+template <class Parent>
+void TransitiveClosureMarker::record_unresolved_type(Parent* parent,
+                                                     const DexType* type) {
+  if (m_references && type) {
+    m_references->unresolved_types.emplace_back(ReachableObject(parent), type);
+  }
+}
+
 std::unique_ptr<ReachableObjects> compute_reachable_objects(
     const DexStoresVector& stores,
     const IgnoreSets& ignore_sets,
@@ -627,6 +745,569 @@ std::unique_ptr<ReachableObjects> compute_reachable_objects(
       remove_no_argument_constructors);
 }
 
+// Incremental marking helpers
+namespace {
+
+template <class T>
+size_t hash_references(T t) {
+  auto refs = generic_gather(t);
+  size_t seed = 0;
+  boost::hash_range(seed, refs.strings.begin(), refs.strings.end());
+  boost::hash_range(seed, refs.types.begin(), refs.types.end());
+  boost::hash_range(seed, refs.fields.begin(), refs.fields.end());
+  boost::hash_range(seed, refs.methods.begin(), refs.methods.end());
+  return seed;
+}
+
+size_t hash_member(const DexField* field) {
+  size_t seed = hash_references(field);
+  boost::hash_combine(seed, field);
+  boost::hash_combine(seed, field->get_name());
+  boost::hash_combine(seed, field->get_type());
+  return seed;
+}
+
+size_t hash_member(const DexMethod* method) {
+  size_t seed = hash_references(method);
+  boost::hash_combine(seed, method);
+  boost::hash_combine(seed, method->get_name());
+  boost::hash_combine(seed, method->get_proto());
+  boost::hash_combine(seed, method->is_virtual());
+  boost::hash_combine(seed, method->is_concrete());
+  return seed;
+}
+
+std::vector<const DexType*> get_parents(const DexClass* cls) {
+  std::vector<const DexType*> parents;
+  if (cls->get_super_class()) {
+    parents.push_back(cls->get_super_class());
+  }
+  for (auto* intf : cls->get_interfaces()->get_type_list()) {
+    parents.push_back(intf);
+  }
+  return parents;
+}
+
+/*
+ * Fingerprints the classes of :scope. When :reachables is given, only the
+ * marked classes and members are taken into account, i.e. what's left after
+ * the sweep.
+ */
+std::unordered_map<const DexClass*, ClassFingerprint> fingerprint_classes(
+    const Scope& scope, const ReachableObjects* reachables) {
+  auto kept = [reachables](const auto* obj) {
+    return reachables == nullptr || reachables->marked_unsafe(obj);
+  };
+  std::vector<boost::optional<ClassFingerprint>> fingerprints(scope.size());
+  std::vector<size_t> indices(scope.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  workqueue_run<size_t>(
+      [&](size_t i) {
+        const DexClass* cls = scope[i];
+        if (!kept(cls)) {
+          return;
+        }
+        // The members are combined in any order, as the marking doesn't
+        // depend on it.
+        size_t members_hash = 0;
+        auto add_members = [&](const auto& members) {
+          for (const auto* member : members) {
+            if (kept(member)) {
+              members_hash += hash_member(member);
+            }
+          }
+        };
+        add_members(cls->get_sfields());
+        add_members(cls->get_ifields());
+        add_members(cls->get_dmethods());
+        add_members(cls->get_vmethods());
+        size_t seed = members_hash;
+        boost::hash_combine(seed, cls);
+        auto parents = get_parents(cls);
+        boost::hash_range(seed, parents.begin(), parents.end());
+        auto annoset = cls->get_anno_set();
+        if (annoset) {
+          for (const auto* anno : annoset->get_annotations()) {
+            boost::hash_combine(seed, anno->type());
+            boost::hash_combine(seed, hash_references(anno));
+          }
+        }
+        fingerprints[i] =
+            ClassFingerprint{seed, cls->get_name(), std::move(parents)};
+      },
+      indices);
+  std::unordered_map<const DexClass*, ClassFingerprint> result;
+  for (size_t i = 0; i < scope.size(); ++i) {
+    if (fingerprints[i]) {
+      result.emplace(scope[i], std::move(*fingerprints[i]));
+    }
+  }
+  return result;
+}
+
+size_t hash_name(const ReachableObject& obj) {
+  size_t seed = 0;
+  if (obj.type == ReachableObjectType::FIELD) {
+    boost::hash_combine(seed, obj.field->get_class());
+    boost::hash_combine(seed, obj.field->get_name());
+    boost::hash_combine(seed, obj.field->get_type());
+    boost::hash_combine(seed, obj.field->is_def());
+  } else if (obj.type == ReachableObjectType::METHOD) {
+    boost::hash_combine(seed, obj.method->get_class());
+    boost::hash_combine(seed, obj.method->get_name());
+    boost::hash_combine(seed, obj.method->get_proto());
+    boost::hash_combine(seed, obj.method->is_def());
+  }
+  return seed;
+}
+
+/*
+ * Whether :obj was defined in the scope of the previous marking, and no longer
+ * is.
+ */
+bool vanished(const ReachableObject& obj, const ObjectIds& ids) {
+  switch (obj.type) {
+  case ReachableObjectType::CLASS:
+    return !obj.cls->is_external() && !ids.classes->count(obj.cls);
+  case ReachableObjectType::FIELD:
+    return obj.field->is_concrete() && !obj.field->is_external() &&
+           !ids.fields->count(obj.field);
+  case ReachableObjectType::METHOD:
+    return obj.method->is_concrete() && !obj.method->is_external() &&
+           !ids.methods->count(obj.method);
+  case ReachableObjectType::ANNO:
+  case ReachableObjectType::SEED:
+    return false;
+  }
+  __builtin_unreachable();
+}
+
+/*
+ * Finds the marked objects whose references may have changed since the
+ * previous marking. Returns none if the marking has to start from scratch.
+ */
+boost::optional<ReachableObjectSet> find_changed_objects(
+    const MarkingSnapshot& snapshot,
+    const std::unordered_map<const DexClass*, ClassFingerprint>&
+        fingerprints) {
+  std::unordered_set<const DexType*> changed_types;
+  // The parents of each class, before and after the changes.
+  std::unordered_map<const DexType*, std::vector<const DexType*>> parents;
+  for (const auto& pair : fingerprints) {
+    auto type = pair.first->get_type();
+    auto it = snapshot.classes.find(pair.first);
+    if (it != snapshot.classes.end() && it->second.name != pair.second.name) {
+      return boost::none;
+    }
+    if (it == snapshot.classes.end() || it->second.hash != pair.second.hash) {
+      changed_types.insert(type);
+    }
+    parents[type] = pair.second.parents;
+  }
+  for (const auto& pair : snapshot.classes) {
+    auto type = pair.first->get_type();
+    if (!fingerprints.count(pair.first)) {
+      changed_types.insert(type);
+    } else if (!changed_types.count(type)) {
+      continue;
+    }
+    auto& type_parents = parents[type];
+    type_parents.insert(type_parents.end(), pair.second.parents.begin(),
+                        pair.second.parents.end());
+  }
+
+  // The resolution of references depends on the classes above, the
+  // overriding methods on the classes below.
+  std::unordered_map<const DexType*, bool> below_changes;
+  std::function<bool(const DexType*)> is_below_change =
+      [&](const DexType* type) {
+        auto it = below_changes.find(type);
+        if (it != below_changes.end()) {
+          return it->second;
+        }
+        bool result = changed_types.count(type) != 0;
+        auto parents_it = parents.find(type);
+        if (!result && parents_it != parents.end()) {
+          for (auto* parent : parents_it->second) {
+            if (is_below_change(parent)) {
+              result = true;
+              break;
+            }
+          }
+        }
+        below_changes[type] = result;
+        return result;
+      };
+  std::unordered_set<const DexType*> above_changes;
+  std::vector<const DexType*> stack(changed_types.begin(),
+                                    changed_types.end());
+  while (!stack.empty()) {
+    auto type = stack.back();
+    stack.pop_back();
+    if (!above_changes.insert(type).second) {
+      continue;
+    }
+    auto parents_it = parents.find(type);
+    if (parents_it != parents.end()) {
+      stack.insert(stack.end(), parents_it->second.begin(),
+                   parents_it->second.end());
+    }
+  }
+
+  ReachableObjectSet changed;
+  for (const auto& obj : snapshot.marked) {
+    switch (obj.type) {
+    case ReachableObjectType::CLASS:
+      if (changed_types.count(obj.cls->get_type())) {
+        changed.insert(obj);
+        // The annotations go along with their class.
+        auto it = snapshot.references.find(obj);
+        if (it != snapshot.references.end()) {
+          for (const auto& ref : it->second) {
+            if (ref.type == ReachableObjectType::ANNO) {
+              changed.insert(ref);
+            }
+          }
+        }
+      }
+      break;
+    case ReachableObjectType::FIELD: {
+      auto it = snapshot.names.find(obj);
+      if (it == snapshot.names.end() || it->second != hash_name(obj) ||
+          is_below_change(obj.field->get_class())) {
+        changed.insert(obj);
+      }
+      break;
+    }
+    case ReachableObjectType::METHOD: {
+      auto it = snapshot.names.find(obj);
+      auto type = obj.method->get_class();
+      if (it == snapshot.names.end() || it->second != hash_name(obj) ||
+          is_below_change(type)) {
+        changed.insert(obj);
+        break;
+      }
+      auto method = obj.method->as_def();
+      if (method && (method->is_virtual() || !method->is_concrete()) &&
+          above_changes.count(type)) {
+        changed.insert(obj);
+      }
+      break;
+    }
+    case ReachableObjectType::ANNO:
+    case ReachableObjectType::SEED:
+      break;
+    }
+  }
+
+  // The references to types that now have a class.
+  for (const auto& pair : snapshot.unresolved_types) {
+    if (type_class(pair.first)) {
+      changed.insert(pair.second.begin(), pair.second.end());
+    }
+  }
+  return changed;
+}
+
+/*
+ * Finds the objects that got marked through the changed objects, the
+ * vanished objects and the former seeds in the previous marking, transitively.
+ * Their reachability has to be established again.
+ */
+ReachableObjectSet find_affected_objects(
+    const MarkingSnapshot& snapshot,
+    const ObjectIds& ids,
+    const ReachableObjectSet& changed,
+    const ConcurrentSet<ReachableObject, ReachableObjectHash>& root_set) {
+  ReachableObjectSet affected;
+  std::vector<ReachableObject> stack;
+  auto affect = [&](const ReachableObject& obj) {
+    if (affected.insert(obj).second) {
+      stack.push_back(obj);
+    }
+  };
+  auto affect_references = [&](const ReachableObject& obj) {
+    auto it = snapshot.derivations.find(obj);
+    if (it != snapshot.derivations.end()) {
+      for (const auto& ref : it->second) {
+        affect(ref);
+      }
+    }
+  };
+  for (const auto& obj : changed) {
+    affect_references(obj);
+  }
+  for (const auto& obj : snapshot.marked) {
+    if (vanished(obj, ids)) {
+      affect(obj);
+    }
+  }
+  for (const auto& obj : snapshot.roots) {
+    if (!root_set.count_unsafe(obj)) {
+      affect(obj);
+    }
+  }
+  while (!stack.empty()) {
+    auto obj = stack.back();
+    stack.pop_back();
+    affect_references(obj);
+  }
+  return affected;
+}
+
+void mark(const ReachableObject& obj, ReachableObjects* reachable_objects) {
+  switch (obj.type) {
+  case ReachableObjectType::CLASS:
+    reachable_objects->mark(obj.cls);
+    break;
+  case ReachableObjectType::FIELD:
+    reachable_objects->mark(obj.field);
+    break;
+  case ReachableObjectType::METHOD:
+    reachable_objects->mark(obj.method);
+    break;
+  case ReachableObjectType::ANNO:
+  case ReachableObjectType::SEED:
+    break;
+  }
+}
+
+/*
+ * Replaces the references of the objects that were visited again, and of the
+ * objects that are no longer marked.
+ */
+void update_references(const ReachableObjectSet& changed,
+                       const ReachableObjectSet& affected,
+                       const RecordedReferences* recorded,
+                       size_t num_threads,
+                       MarkingSnapshot* snapshot) {
+  auto still_valid = [&](const ReachableObject& obj) {
+    return snapshot->incremental && !changed.count(obj) &&
+           !affected.count(obj);
+  };
+  ReferenceGraph references;
+  ReferenceGraph derivations;
+  std::unordered_map<const DexType*, std::vector<ReachableObject>>
+      unresolved_types;
+  for (auto& pair : snapshot->references) {
+    if (still_valid(pair.first)) {
+      references.emplace(pair.first, std::move(pair.second));
+    }
+  }
+  for (auto& pair : snapshot->derivations) {
+    if (still_valid(pair.first)) {
+      derivations.emplace(pair.first, std::move(pair.second));
+    }
+  }
+  for (const auto& pair : snapshot->unresolved_types) {
+    for (const auto& obj : pair.second) {
+      if (still_valid(obj)) {
+        unresolved_types[pair.first].push_back(obj);
+      }
+    }
+  }
+  for (size_t i = 0; i < num_threads; ++i) {
+    for (const auto& edge : recorded[i].edges) {
+      references[edge.first].push_back(edge.second);
+    }
+    for (const auto& edge : recorded[i].derivations) {
+      derivations[edge.first].push_back(edge.second);
+    }
+    for (const auto& pair : recorded[i].unresolved_types) {
+      unresolved_types[pair.second].push_back(pair.first);
+    }
+  }
+  // The objects that were visited again recorded the same references twice.
+  auto compare = [](const ReachableObject& lhs, const ReachableObject& rhs) {
+    if (lhs.type != rhs.type) {
+      return lhs.type < rhs.type;
+    }
+    return std::less<const void*>()(lhs.anno, rhs.anno);
+  };
+  auto dedup = [&compare](std::vector<ReachableObject>* objs) {
+    std::sort(objs->begin(), objs->end(), compare);
+    objs->erase(std::unique(objs->begin(), objs->end()), objs->end());
+  };
+  for (auto& pair : references) {
+    dedup(&pair.second);
+  }
+  for (auto& pair : derivations) {
+    dedup(&pair.second);
+  }
+  for (auto& pair : unresolved_types) {
+    dedup(&pair.second);
+  }
+  snapshot->references = std::move(references);
+  snapshot->derivations = std::move(derivations);
+  snapshot->unresolved_types = std::move(unresolved_types);
+}
+
+} // namespace
+
+std::unique_ptr<ReachableObjects> compute_reachable_objects_incrementally(
+    const DexStoresVector& stores,
+    const IgnoreSets& ignore_sets,
+    int* num_ignore_check_strings,
+    MarkingSnapshot* snapshot,
+    bool remove_no_argument_constructors) {
+  Timer t("Incremental marking");
+  auto scope = build_class_scope(stores);
+  ObjectIds ids(scope);
+  auto reachable_objects = std::make_unique<ReachableObjects>(ids);
+  ConditionallyMarked cond_marked(ids);
+  auto method_override_graph = mog::build_graph(scope);
+
+  ConcurrentSet<ReachableObject, ReachableObjectHash> root_set;
+  RootSetMarker root_set_marker(*method_override_graph,
+                                /* record_reachability */ false,
+                                &cond_marked,
+                                reachable_objects.get(),
+                                &root_set);
+  root_set_marker.mark(scope);
+
+  // The objects to visit, or to visit again if they were already marked.
+  std::vector<ReachableObject> revisits(root_set.begin(), root_set.end());
+  ReachableObjectSet changed;
+  ReachableObjectSet affected;
+  snapshot->incremental = false;
+  if (snapshot->valid) {
+    auto changed_objects =
+        find_changed_objects(*snapshot, fingerprint_classes(scope, nullptr));
+    if (changed_objects) {
+      changed = std::move(*changed_objects);
+      affected = find_affected_objects(*snapshot, ids, changed, root_set);
+      // Past this point, starting from scratch is cheaper.
+      snapshot->incremental = affected.size() <= snapshot->marked.size() / 2;
+    }
+  }
+  TRACE(REACH, 1, "Marking %s: %zu changed, %zu affected objects",
+        snapshot->incremental ? "incrementally" : "from scratch",
+        changed.size(), affected.size());
+
+  if (snapshot->incremental) {
+    for (const auto& obj : snapshot->marked) {
+      if (!affected.count(obj)) {
+        mark(obj, reachable_objects.get());
+      }
+    }
+    // The classes of the new conditionally marked seeds have to push them.
+    walk::classes(scope, [&](const DexClass* cls) {
+      auto is_new_seed = [&](const auto* member, const auto& cond_set,
+                             const auto& old_cond_set) {
+        return cond_set.count_unsafe(member) && !old_cond_set.count(member);
+      };
+      bool has_new_seed = false;
+      for (const auto* f : cls->get_sfields()) {
+        has_new_seed |=
+            is_new_seed(f, cond_marked.fields, snapshot->cond_fields);
+      }
+      for (const auto* f : cls->get_ifields()) {
+        has_new_seed |=
+            is_new_seed(f, cond_marked.fields, snapshot->cond_fields);
+      }
+      for (const auto* m : cls->get_dmethods()) {
+        has_new_seed |=
+            is_new_seed(m, cond_marked.methods, snapshot->cond_methods);
+      }
+      for (const auto* m : cls->get_vmethods()) {
+        has_new_seed |=
+            is_new_seed(m, cond_marked.methods, snapshot->cond_methods);
+      }
+      if (has_new_seed) {
+        revisits.emplace_back(cls);
+      }
+    });
+    // The affected conditionally marked objects get conditionally marked
+    // again, if still applicable.
+    for (const auto* field : snapshot->cond_fields) {
+      if (ids.fields->count(field) && !affected.count(ReachableObject(field))) {
+        cond_marked.fields.insert(field);
+      }
+    }
+    for (const auto* method : snapshot->cond_methods) {
+      if (ids.methods->count(method) &&
+          !affected.count(ReachableObject(method))) {
+        cond_marked.methods.insert(method);
+      }
+    }
+    for (const auto& obj : changed) {
+      if (obj.type != ReachableObjectType::ANNO && !affected.count(obj)) {
+        revisits.push_back(obj);
+      }
+    }
+    // The objects that made an affected object reachable.
+    for (const auto& pair : snapshot->references) {
+      if (affected.count(pair.first)) {
+        continue;
+      }
+      for (const auto& ref : pair.second) {
+        if (affected.count(ref)) {
+          revisits.push_back(pair.first);
+          break;
+        }
+      }
+    }
+  }
+
+  size_t num_threads = redex_parallel::default_num_threads();
+  auto stats_arr = std::make_unique<Stats[]>(num_threads);
+  auto recorded = std::make_unique<RecordedReferences[]>(num_threads);
+  auto wq = workqueue_foreach<ReachableObject>(
+      [&](MarkWorkerState* worker_state, const ReachableObject& obj) {
+        TransitiveClosureMarker transitive_closure_marker(
+            ignore_sets, *method_override_graph,
+            /* record_reachability */ false, &cond_marked,
+            reachable_objects.get(), worker_state,
+            &stats_arr[worker_state->worker_id()],
+            remove_no_argument_constructors);
+        transitive_closure_marker.record_references(
+            &recorded[worker_state->worker_id()]);
+        if (snapshot->incremental) {
+          // We can't tell the revisited objects apart from the newly marked
+          // ones here, but visiting a newly marked one again is harmless.
+          transitive_closure_marker.revisit_transitively(obj);
+        } else {
+          transitive_closure_marker.visit_transitively(obj);
+        }
+        return nullptr;
+      },
+      num_threads,
+      /*push_tasks_while_running=*/true,
+      /*lock_free_queues=*/true);
+  for (const auto& obj : revisits) {
+    wq.add_item(obj);
+  }
+  wq.run_all();
+
+  if (num_ignore_check_strings != nullptr) {
+    for (size_t i = 0; i < num_threads; ++i) {
+      *num_ignore_check_strings += stats_arr[i].num_ignore_check_strings;
+    }
+  }
+
+  update_references(changed, affected, recorded.get(), num_threads, snapshot);
+  snapshot->marked.clear();
+  snapshot->names.clear();
+  reachable_objects->for_each_marked([&](const ReachableObject& obj) {
+    snapshot->marked.push_back(obj);
+    if (obj.type != ReachableObjectType::CLASS) {
+      snapshot->names.emplace(obj, hash_name(obj));
+    }
+  });
+  snapshot->roots = ReachableObjectSet(root_set.begin(), root_set.end());
+  snapshot->cond_fields.clear();
+  cond_marked.fields.for_each(
+      [&](const DexField* field) { snapshot->cond_fields.insert(field); });
+  snapshot->cond_methods.clear();
+  cond_marked.methods.for_each(
+      [&](const DexMethod* method) { snapshot->cond_methods.insert(method); });
+  snapshot->classes = fingerprint_classes(scope, reachable_objects.get());
+  snapshot->num_changed = changed.size();
+  snapshot->num_affected = affected.size();
+  snapshot->valid = true;
+  return reachable_objects;
+}
+
 void ReachableObjects::record_reachability(const DexMethodRef* member,
                                            const DexClass* cls) {
   // Each class member trivially retains its containing class; let's filter out
@@ -7,6 +7,9 @@
 
 #pragma once
 
+#include <atomic>
+#include <limits>
+#include <memory>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -90,15 +93,140 @@ using ReachableObjectSet =
 using ReachableObjectGraph =
     ConcurrentMap<ReachableObject, ReachableObjectSet, ReachableObjectHash>;
 
+template <class Object>
+using ObjectIdMap = std::unordered_map<const Object*, uint32_t>;
+
+/*
+ * Dense ids for the classes, fields and methods defined in a scope. They are
+ * computed once per marking, and are then shared by all the marked sets.
+ */
+struct ObjectIds {
+  ObjectIds() = default;
+  explicit ObjectIds(const Scope& scope);
+
+  std::shared_ptr<const ObjectIdMap<DexClass>> classes;
+  std::shared_ptr<const ObjectIdMap<DexFieldRef>> fields;
+  std::shared_ptr<const ObjectIdMap<DexMethodRef>> methods;
+};
+
+/*
+ * A thread-safe set of marked objects. Objects that have an id are marked by
+ * setting a bit of an atomic bitset, which doesn't contend with the other
+ * threads like the insertions into a ConcurrentSet. The other objects, e.g.
+ * external classes or unresolved references, go to a ConcurrentSet.
+ */
+template <class Object, class IdObject = Object>
+class MarkedSet {
+ public:
+  MarkedSet() = default;
+
+  explicit MarkedSet(std::shared_ptr<const ObjectIdMap<IdObject>> ids)
+      : m_ids(std::move(ids)) {
+    if (m_ids) {
+      m_num_words = (m_ids->size() + kWordBits - 1) / kWordBits;
+      // Value-initialization zeroes the bits.
+      m_bits.reset(new std::atomic<uint64_t>[m_num_words]());
+    }
+  }
+
+  /*
+   * The Boolean return value denotes whether the insertion took place.
+   */
+  bool insert(const Object* obj) {
+    auto id = get_id(obj);
+    if (id == kNoId) {
+      return m_others.insert(obj);
+    }
+    auto mask = uint64_t(1) << (id % kWordBits);
+    return (m_bits[id / kWordBits].fetch_or(mask) & mask) == 0;
+  }
+
+  bool count(const Object* obj) const {
+    auto id = get_id(obj);
+    if (id == kNoId) {
+      return m_others.count(obj) != 0;
+    }
+    return (m_bits[id / kWordBits].load() >> (id % kWordBits)) & 1;
+  }
+
+  /*
+   * Only safe when no other thread inserts into the set.
+   */
+  bool count_unsafe(const Object* obj) const {
+    auto id = get_id(obj);
+    if (id == kNoId) {
+      return m_others.count_unsafe(obj) != 0;
+    }
+    return (m_bits[id / kWordBits].load(std::memory_order_relaxed) >>
+            (id % kWordBits)) &
+           1;
+  }
+
+  /*
+   * Calls :f on each marked object. Only safe when no other thread inserts
+   * into the set.
+   */
+  template <class Fn>
+  void for_each(const Fn& f) const {
+    if (m_ids) {
+      for (const auto& pair : *m_ids) {
+        auto id = pair.second;
+        if ((m_bits[id / kWordBits].load(std::memory_order_relaxed) >>
+             (id % kWordBits)) &
+            1) {
+          f(static_cast<const Object*>(pair.first));
+        }
+      }
+    }
+    for (const auto* obj : m_others) {
+      f(obj);
+    }
+  }
+
+  size_t size() const {
+    size_t size = m_others.size();
+    for (size_t i = 0; i < m_num_words; ++i) {
+      size += __builtin_popcountll(m_bits[i].load(std::memory_order_relaxed));
+    }
+    return size;
+  }
+
+ private:
+  static constexpr size_t kWordBits = 64;
+  static constexpr uint32_t kNoId = std::numeric_limits<uint32_t>::max();
+
+  uint32_t get_id(const Object* obj) const {
+    if (!m_ids) {
+      return kNoId;
+    }
+    auto it = m_ids->find(obj);
+    return it == m_ids->end() ? kNoId : it->second;
+  }
+
+  std::shared_ptr<const ObjectIdMap<IdObject>> m_ids;
+  std::unique_ptr<std::atomic<uint64_t>[]> m_bits;
+  size_t m_num_words{0};
+  ConcurrentSet<const Object*> m_others;
+};
+
 class ReachableObjects {
  public:
+  ReachableObjects() = default;
+
+  explicit ReachableObjects(const ObjectIds& ids)
+      : m_marked_classes(ids.classes),
+        m_marked_fields(ids.fields),
+        m_marked_methods(ids.methods) {}
+
   const ReachableObjectGraph& retainers_of() const { return m_retainers_of; }
 
-  void mark(const DexClass* cls) { m_marked_classes.insert(cls); }
+  bool mark(const DexClass* cls) { return m_marked_classes.insert(cls); }
 
-  void mark(const DexMethodRef* method) { m_marked_methods.insert(method); }
+  bool mark(const DexMethodRef* method) {
+    return m_marked_methods.insert(method);
+  }
 
-  void mark(const DexFieldRef* field) { m_marked_fields.insert(field); }
+  bool mark(const DexFieldRef* field) { return m_marked_fields.insert(field); }
 
   bool marked(const DexClass* cls) const { return m_marked_classes.count(cls); }
 
@@ -128,6 +256,19 @@ class ReachableObjects {
 
   size_t num_marked_methods() const { return m_marked_methods.size(); }
 
+  /*
+   * Calls :f on each marked object. Only safe once the marking is done.
+   */
+  template <class Fn>
+  void for_each_marked(const Fn& f) const {
+    m_marked_classes.for_each(
+        [&](const DexClass* cls) { f(ReachableObject(cls)); });
+    m_marked_fields.for_each(
+        [&](const DexFieldRef* field) { f(ReachableObject(field)); });
+    m_marked_methods.for_each(
+        [&](const DexMethodRef* method) { f(ReachableObject(method)); });
+  }
+
  private:
   template <class Seed>
   void record_is_seed(Seed* seed);
@@ -142,9 +283,9 @@ class ReachableObjects {
 
   void record_reachability(const DexMethodRef* member, const DexClass* cls);
 
-  ConcurrentSet<const DexClass*> m_marked_classes;
-  ConcurrentSet<const DexFieldRef*> m_marked_fields;
-  ConcurrentSet<const DexMethodRef*> m_marked_methods;
+  MarkedSet<DexClass> m_marked_classes;
+  MarkedSet<DexFieldRef> m_marked_fields;
+  MarkedSet<DexMethodRef> m_marked_methods;
   ReachableObjectGraph m_retainers_of;
 
   friend class RootSetMarker;
@@ -152,8 +293,13 @@ class ReachableObjects {
 };
 
 struct ConditionallyMarked {
-  ConcurrentSet<const DexField*> fields;
-  ConcurrentSet<const DexMethod*> methods;
+  ConditionallyMarked() = default;
+
+  explicit ConditionallyMarked(const ObjectIds& ids)
+      : fields(ids.fields), methods(ids.methods) {}
+
+  MarkedSet<DexField, DexFieldRef> fields;
+  MarkedSet<DexMethod, DexMethodRef> methods;
 };
 
 struct References {
@@ -174,6 +320,61 @@ struct alignas(CACHE_LINE_SIZE) Stats {
 
 using MarkWorkerState = sparta::SpartaWorkerState<ReachableObject>;
 
+/*
+ * The references followed by a marking, from each visited object to the
+ * objects that it made reachable. Unlike the retainers of ReachableObjects,
+ * which are meant for diagnostics, they are complete.
+ */
+using ReferenceGraph = std::unordered_map<ReachableObject,
+                                          std::vector<ReachableObject>,
+                                          ReachableObjectHash>;
+
+/*
+ * The references recorded by a single worker, so that recording doesn't
+ * contend with the other workers.
+ */
+struct alignas(CACHE_LINE_SIZE) RecordedReferences {
+  std::vector<std::pair<ReachableObject, ReachableObject>> edges;
+  // The references through which objects got marked, or conditionally marked.
+  std::vector<std::pair<ReachableObject, ReachableObject>> derivations;
+  // The types that were referenced while they didn't have a class.
+  std::vector<std::pair<ReachableObject, const DexType*>> unresolved_types;
+};
+
+struct ClassFingerprint {
+  // Covers everything that the marking reads from the class and its members.
+  size_t hash;
+  const DexString* name;
+  std::vector<const DexType*> parents;
+};
+
+/*
+ * What a marking leaves behind so that the next one can be incremental, see
+ * compute_reachable_objects_incrementally.
+ */
+struct MarkingSnapshot {
+  bool valid{false};
+  ReferenceGraph references;
+  // Each marked object is reachable from the seeds through the references by
+  // which it got marked, along with the ones that conditionally marked it.
+  ReferenceGraph derivations;
+  std::unordered_map<const DexType*, std::vector<ReachableObject>>
+      unresolved_types;
+  std::vector<ReachableObject> marked;
+  ReachableObjectSet roots;
+  std::unordered_set<const DexField*> cond_fields;
+  std::unordered_set<const DexMethod*> cond_methods;
+  // The fingerprints of the marked classes, as the sweep leaves them.
+  std::unordered_map<const DexClass*, ClassFingerprint> classes;
+  // The fingerprints of the names of the marked methods and fields.
+  std::unordered_map<ReachableObject, size_t, ReachableObjectHash> names;
+
+  // Statistics of the last marking.
+  bool incremental{false};
+  size_t num_changed{0};
+  size_t num_affected{0};
+};
+
 /*
  * These helper classes compute reachable objects by a DFS+marking algorithm.
  *
@@ -273,6 +474,27 @@ class TransitiveClosureMarker {
 
   virtual ~TransitiveClosureMarker() = default;
 
+  /*
+   * Visits :obj, and then the objects that it makes reachable. Newly marked
+   * objects go to a local frontier, which is only flushed in batches to the
+   * task queue of the current worker when it grows large, so that the other
+   * workers can steal them.
+   */
+  void visit_transitively(const ReachableObject& obj);
+
+  /*
+   * Like visit_transitively, but :obj may already be marked, e.g. because it
+   * changed since the last marking and has to be visited again.
+   */
+  void revisit_transitively(const ReachableObject& obj);
+
+  /*
+   * Records all the references followed by this marker into :references.
+   */
+  void record_references(RecordedReferences* references) {
+    m_references = references;
+  }
+
   /*
    * Marks :obj and pushes its immediately reachable neighbors onto the local
    * task queue of the current worker.
@@ -313,6 +535,8 @@ class TransitiveClosureMarker {
 
   void push_cond(const DexMethod* method);
 
+  void enqueue(const ReachableObject& obj) { m_frontier.push_back(obj); }
+
   bool has_class_forname(DexMethod* meth);
 
   void gather_and_push(DexMethod* meth);
@@ -327,6 +551,17 @@ class TransitiveClosureMarker {
   template <class Parent, class Object>
   void record_reachability(Parent* parent, Object* object);
 
+  template <class Parent, class Object>
+  void record_reference(Parent* parent, Object* object);
+
+  template <class Parent, class Object>
+  void record_derivation(Parent* parent, Object* object);
+
+  template <class Parent>
+  void record_unresolved_type(Parent* parent, const DexType* type);
+
+  void visit_frontier();
+
   /*
    * Resolve the method reference more conservatively without the context of the
    * call, such as call instruction, target type and the caller method.
@@ -342,6 +577,8 @@ class TransitiveClosureMarker {
   MarkWorkerState* m_worker_state;
   Stats* m_stats;
   bool m_remove_no_argument_constructors;
+  std::vector<ReachableObject> m_frontier;
+  RecordedReferences* m_references{nullptr};
 
   static DexMethodRef* s_class_forname;
 };
@@ -373,6 +610,32 @@ std::unique_ptr<ReachableObjects> compute_reachable_objects(
         out_method_override_graph = nullptr,
     bool remove_no_argument_constructors = false);
 
+/*
+ * Like compute_reachable_objects above, but records the marking into
+ * :snapshot, and uses the snapshot of the previous marking to only re-explore
+ * the objects whose reachability may have changed since then:
+ *
+ * - The objects whose references may have changed are found by comparing
+ *   fingerprints of the classes, so that no pass has to report its changes.
+ *   This also covers the references that depend on the class hierarchy, like
+ *   the resolution of method references or the overriding methods.
+ * - The objects that got marked through a changed object, a vanished object
+ *   or a former seed are unmarked, transitively. All the other objects are
+ *   still reachable the way they were, and stay marked.
+ * - The marking resumes from the changed objects, from the marked objects
+ *   that referenced an unmarked one, and from the seeds.
+ *
+ * The marking starts from scratch when too many objects are affected, and
+ * when classes got renamed, as strings may then name other classes. The
+ * snapshot expects the unmarked objects to be swept before the next marking.
+ */
+std::unique_ptr<ReachableObjects> compute_reachable_objects_incrementally(
+    const DexStoresVector& stores,
+    const IgnoreSets& ignore_sets,
+    int* num_ignore_check_strings,
+    MarkingSnapshot* snapshot,
+    bool remove_no_argument_constructors = false);
+
 /*
  * Compute all reachable methods from the set of reachable objects.
  */
@@ -7,6 +7,7 @@
 
 #include "RedexContext.h"
 
+#include <cstdlib>
 #include <exception>
 #include <iostream>
 #include <mutex>
@@ -24,11 +25,25 @@
 
 RedexContext* g_redex;
 
+std::atomic<size_t> RedexContext::s_resolution_generation{0};
+
 RedexContext::RedexContext(bool allow_class_duplicates)
-    : m_allow_class_duplicates(allow_class_duplicates) {}
+    : m_allow_class_duplicates(allow_class_duplicates) {
+  if (getenv("REDEX_ARENA_STRING_TABLE") != nullptr) {
+    s_arena_string_map =
+        std::make_unique<ArenaInternTable<DexString, DexStringKey>>();
+  }
+}
+
+std::string_view RedexContext::DexStringKey::operator()(
+    const DexString& s) const {
+  return s.str();
+}
 
 RedexContext::~RedexContext() {
-  // Delete DexStrings.
+  start_resolution_generation();
+  // Delete DexStrings. Arena-allocated ones are destroyed with their table.
+  s_arena_string_map.reset();
   for (auto& segment : s_string_map) {
     for (auto const& p : segment) {
       delete p.second;
@@ -69,10 +84,14 @@ RedexContext::~RedexContext() {
     delete p.second;
   }
 
-  for (const Task& t : m_destruction_tasks) {
-    t();
+  // Delete interned DexAnnotations. Their encoded values may be shared with
+  // copies, so they are left alone.
+  for (auto const& p : s_annotation_map) {
+    delete p.second;
   }
 
+  run_destruction_tasks();
+
   delete m_position_pattern_switch_manager;
 }
 
@@ -102,6 +121,11 @@ static StoredValue* try_insert(Key key,
 
 DexString* RedexContext::make_string(const char* nstr, uint32_t utfsize) {
   always_assert(nstr != nullptr);
+  if (s_arena_string_map) {
+    return s_arena_string_map->get_or_make(nstr, [&](void* memory) {
+      return new (memory) DexString(nstr, utfsize);
+    });
+  }
   auto p = std::make_pair(nstr, utfsize);
   auto& segment = s_string_map.at(p);
 
@@ -122,6 +146,9 @@ DexString* RedexContext::get_string(const char* nstr, uint32_t utfsize) {
   if (nstr == nullptr) {
     return nullptr;
   }
+  if (s_arena_string_map) {
+    return s_arena_string_map->get(nstr);
+  }
   auto p = std::make_pair(nstr, utfsize);
   auto& segment = s_string_map.at(p);
   return segment.get(p, nullptr);
@@ -190,12 +217,14 @@ DexFieldRef* RedexContext::get_field(const DexType* container,
 
 void RedexContext::erase_field(DexFieldRef* field) {
   s_field_map.erase(field->m_spec);
+  start_resolution_generation();
 }
 
 void RedexContext::mutate_field(DexFieldRef* field,
                                 const DexFieldSpec& ref,
                                 bool rename_on_collision) {
   std::lock_guard<std::mutex> lock(s_field_lock);
+  start_resolution_generation();
   DexFieldSpec& r = field->m_spec;
   s_field_map.erase(r);
   r.cls = ref.cls != nullptr ? ref.cls : field->m_spec.cls;
@@ -231,6 +260,30 @@ DexTypeList* RedexContext::get_type_list(std::deque<DexType*>&& p) {
   return s_typelist_map.get(p, nullptr);
 }
 
+size_t RedexContext::AnnotationPtrHash::operator()(
+    const DexAnnotation* anno) const {
+  return anno->hash_value();
+}
+
+bool RedexContext::AnnotationPtrEqual::operator()(
+    const DexAnnotation* a, const DexAnnotation* b) const {
+  return *a == *b;
+}
+
+DexAnnotation* RedexContext::intern_annotation(DexAnnotation* anno) {
+  auto rv = s_annotation_map.get(anno, nullptr);
+  if (rv != nullptr) {
+    return rv;
+  }
+  // Other threads may get the annotation as soon as it is inserted.
+  anno->m_interned = true;
+  if (s_annotation_map.emplace(anno, anno)) {
+    return anno;
+  }
+  anno->m_interned = false;
+  return s_annotation_map.at(anno);
+}
+
 DexProto* RedexContext::make_proto(const DexType* rtype,
                                    const DexTypeList* args,
                                    const DexString* shorty) {
@@ -287,6 +340,7 @@ DexMethodRef* RedexContext::get_method(const DexType* type,
 
 void RedexContext::erase_method(DexMethodRef* method) {
   s_method_map.erase(method->m_spec);
+  start_resolution_generation();
 }
 
 // TODO: Need a better interface.
@@ -294,6 +348,7 @@ void RedexContext::mutate_method(DexMethodRef* method,
                                  const DexMethodSpec& new_spec,
                                  bool rename_on_collision) {
   std::lock_guard<std::mutex> lock(s_method_lock);
+  start_resolution_generation();
   DexMethodSpec old_spec = method->m_spec;
   s_method_map.erase(method->m_spec);
 
@@ -423,6 +478,7 @@ void RedexContext::publish_class(DexClass* cls) {
   const auto& pair = m_type_to_class.emplace(type, cls);
   bool insertion_took_place = pair.second;
   always_assert(insertion_took_place);
+  start_resolution_generation();
   if (cls->is_external()) {
     m_external_classes.emplace_back(cls);
   }
@@ -498,6 +554,17 @@ void RedexContext::add_destruction_task(const Task& t) {
   m_destruction_tasks.push_back(t);
 }
 
+void RedexContext::run_destruction_tasks() {
+  std::vector<Task> tasks;
+  {
+    std::unique_lock<std::mutex> lock{m_destruction_tasks_lock};
+    tasks.swap(m_destruction_tasks);
+  }
+  for (const Task& t : tasks) {
+    t();
+  }
+}
+
 void RedexContext::set_sb_interaction_index(
     const std::unordered_map<std::string, size_t>& input) {
   m_sb_interaction_indices = input;
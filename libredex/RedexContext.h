@@ -8,6 +8,7 @@
 #pragma once
 
 #include <array>
+#include <atomic>
 #include <boost/functional/hash.hpp>
 #include <cstring>
 #include <deque>
@@ -15,17 +16,21 @@
 #include <limits>
 #include <list>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <sstream>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
+#include "ArenaInternTable.h"
 #include "ConcurrentContainers.h"
 #include "Debug.h"
 #include "DexMemberRefs.h"
 #include "FrequentlyUsedPointersCache.h"
 #include "KeepReason.h"
 
+class DexAnnotation;
 class DexCallSite;
 class DexDebugInstruction;
 class DexString;
@@ -105,6 +110,13 @@ struct RedexContext {
   DexMethodHandle* make_methodhandle();
   DexMethodHandle* get_methodhandle();
 
+  /**
+   * Returns the interned annotation with the same contents as `anno`, and
+   * interns `anno` if there is none. When another annotation is returned, the
+   * caller keeps the ownership of `anno`.
+   */
+  DexAnnotation* intern_annotation(DexAnnotation* anno);
+
   void erase_method(DexMethodRef*);
   void mutate_method(DexMethodRef* method,
                      const DexMethodSpec& new_spec,
@@ -150,21 +162,40 @@ struct RedexContext {
     return g_redex->s_keep_reasons.at(to_insert.get());
   }
 
+  /*
+   * Edits that may change what method and field references resolve to, i.e.
+   * edits of the class hierarchy, of the members of classes and of the
+   * references themselves, start a new resolution generation. Resolutions
+   * cached in an earlier generation are stale; see Resolver.h. Generations
+   * are counted across contexts, as the same addresses are reused by the
+   * entities of a later context.
+   */
+  static size_t resolution_generation() { return s_resolution_generation; }
+  static void start_resolution_generation() { ++s_resolution_generation; }
+
   // Add a lambda to be called when RedexContext is destructed. This is
   // especially useful for resetting caches/singletons in tests.
   using Task = std::function<void(void)>;
   void add_destruction_task(const Task& t);
 
+  // Run (and forget) the destruction tasks added so far. The destructor does
+  // this too; call it directly when the context is deliberately leaked at
+  // exit, so that the tasks still run without freeing every entity.
+  void run_destruction_tasks();
+
   static constexpr bool kDebugPointersCacheLoad = false;
   void load_pointers_cache() {
     m_pointers_cache.load();
-    m_pointers_cache_loaded = true;
+    m_pointers_cache_loaded.store(true, std::memory_order_release);
   }
+  // The cache doesn't change once loaded, so only loading it takes the lock.
   const FrequentlyUsedPointers& pointers_cache() {
-    std::lock_guard<std::mutex> lock(s_field_lock);
-    if (!m_pointers_cache_loaded) {
-      redex_assert(!kDebugPointersCacheLoad);
-      load_pointers_cache();
+    if (!m_pointers_cache_loaded.load(std::memory_order_acquire)) {
+      std::lock_guard<std::mutex> lock(s_field_lock);
+      if (!m_pointers_cache_loaded.load(std::memory_order_relaxed)) {
+        redex_assert(!kDebugPointersCacheLoad);
+        load_pointers_cache();
+      }
     }
     return m_pointers_cache;
   }
@@ -287,6 +318,15 @@ struct RedexContext {
   // DexString
   LargeStringMap<31, 127> s_string_map;
 
+  // Alternative DexString table, selected by setting the environment variable
+  // REDEX_ARENA_STRING_TABLE when the context is created. DexString objects
+  // are then allocated in the table's arenas rather than individually on the
+  // heap, and lookups hash the full string once instead of walking trees.
+  struct DexStringKey {
+    std::string_view operator()(const DexString& s) const;
+  };
+  std::unique_ptr<ArenaInternTable<DexString, DexStringKey>> s_arena_string_map;
+
   // DexType
   ConcurrentMap<const DexString*, DexType*> s_type_map;
 
@@ -308,6 +348,19 @@ struct RedexContext {
   ConcurrentMap<DexMethodSpec, DexMethodRef*> s_method_map;
   std::mutex s_method_lock;
 
+  // DexAnnotation
+  struct AnnotationPtrHash {
+    size_t operator()(const DexAnnotation* anno) const;
+  };
+  struct AnnotationPtrEqual {
+    bool operator()(const DexAnnotation* a, const DexAnnotation* b) const;
+  };
+  ConcurrentMap<const DexAnnotation*,
+                DexAnnotation*,
+                AnnotationPtrHash,
+                AnnotationPtrEqual>
+      s_annotation_map;
+
   // DexPositionSwitch and DexPositionPattern
   PositionPatternSwitchManager* m_position_pattern_switch_manager{nullptr};
 
@@ -333,7 +386,9 @@ struct RedexContext {
   bool m_record_keep_reasons{false};
   bool m_allow_class_duplicates;
 
-  bool m_pointers_cache_loaded{false};
+  static std::atomic<size_t> s_resolution_generation;
+
+  std::atomic<bool> m_pointers_cache_loaded{false};
   FrequentlyUsedPointers m_pointers_cache;
 
   // Field values map specified by Proguard assume value
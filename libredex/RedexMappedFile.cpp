@@ -48,6 +48,18 @@ RedexMappedFile RedexMappedFile::open(std::string path, bool read_only) {
   return RedexMappedFile(std::move(map), std::move(path), read_only);
 }
 
+RedexMappedFile RedexMappedFile::open_copy_on_write(std::string path) {
+  auto map = std::make_unique<boost::iostreams::mapped_file>();
+  boost::iostreams::mapped_file_params params(path);
+  params.flags = boost::iostreams::mapped_file::priv;
+  map->open(params);
+  if (!map->is_open()) {
+    throw std::runtime_error(std::string("Could not map ") + path);
+  }
+
+  return RedexMappedFile(std::move(map), std::move(path), false);
+}
+
 const char* RedexMappedFile::const_data() const { return file->const_data(); }
 char* RedexMappedFile::data() const {
   redex_assert(!read_only);
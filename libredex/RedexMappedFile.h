@@ -34,6 +34,10 @@ struct RedexMappedFile {
 
   static RedexMappedFile open(std::string path, bool read_only = true);
 
+  // Maps the file privately: pages are read from the file on first access,
+  // and writes to them stay in memory.
+  static RedexMappedFile open_copy_on_write(std::string path);
+
   const char* const_data() const;
   char* data() const;
   size_t size() const;
@@ -20,6 +20,9 @@ void RedexOptions::serialize(Json::Value& entry_data) const {
   options["min_sdk"] = min_sdk;
   options["debug_info_kind"] = debug_info_kind_to_string(debug_info_kind);
   options["redacted"] = redacted;
+  options["code_spill_rss_budget_mb"] = code_spill_rss_budget_mb;
+  options["lazy_balloon"] = lazy_balloon;
+  options["fast_teardown"] = fast_teardown;
 }
 
 void RedexOptions::deserialize(const Json::Value& entry_data) {
@@ -32,6 +35,9 @@ void RedexOptions::deserialize(const Json::Value& entry_data) {
   debug_info_kind =
       parse_debug_info_kind(options_data["debug_info_kind"].asString());
   redacted = options_data["redacted"].asBool();
+  code_spill_rss_budget_mb = options_data["code_spill_rss_budget_mb"].asUInt();
+  lazy_balloon = options_data["lazy_balloon"].asBool();
+  fast_teardown = options_data["fast_teardown"].asBool();
 }
 
 Architecture parse_architecture(const std::string& s) {
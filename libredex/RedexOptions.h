@@ -53,6 +53,14 @@ class RedexOptions {
   int32_t min_sdk{0};
   Architecture arch{Architecture::UNKNOWN};
   DebugInfoKind debug_info_kind{DebugInfoKind::NoCustomSymbolication};
+  // When non-zero, the bodies of cold methods are spilled to disk between
+  // passes while the RSS exceeds this many megabytes. See CodeSpill.h.
+  uint32_t code_spill_rss_budget_mb{0};
+  // Balloon method bodies on first access rather than at load time.
+  bool lazy_balloon{false};
+  // At exit, skip freeing the global RedexContext and leave the memory to the
+  // OS. Destruction tasks still run.
+  bool fast_teardown{false};
 
   /*
    * Overwriting the `this` register breaks the verifier before Android M and
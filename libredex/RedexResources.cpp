@@ -9,15 +9,20 @@
 
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/operations.hpp>
+#include <algorithm>
+#include <array>
 #include <map>
-#include <mutex>
+#include <memory>
+#include <numeric>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
 #include "ApkResources.h"
 #include "BundleResources.h"
+#include "ConcurrentContainers.h"
 #include "Debug.h"
 #include "DetectBundle.h"
 #include "DexUtil.h"
@@ -46,6 +51,50 @@ constexpr decltype(redex_parallel::default_num_threads()) kReadNativeThreads =
 using path_t = boost::filesystem::path;
 using dir_iterator = boost::filesystem::directory_iterator;
 using rdir_iterator = boost::filesystem::recursive_directory_iterator;
+
+/*
+ * Reachability is recomputed from the same layouts and native libraries more
+ * than once in a run, e.g. by LayoutReachabilityPass, while resource readers
+ * are created anew each time. What was found in each file is kept for the
+ * whole run, and found again only if the contents of the file change.
+ */
+struct FileFingerprint {
+  size_t size{0};
+  size_t hash{0};
+
+  FileFingerprint() = default;
+  FileFingerprint(const char* data, size_t size)
+      : size(size), hash(std::hash<std::string_view>()({data, size})) {}
+
+  bool operator==(const FileFingerprint& other) const {
+    return size == other.size && hash == other.hash;
+  }
+};
+
+struct LayoutScan {
+  FileFingerprint fingerprint;
+  std::unordered_set<std::string> attributes_to_read;
+  std::unordered_set<std::string> classes;
+  std::unordered_multimap<std::string, std::string> attributes;
+};
+
+struct NativeLibScan {
+  FileFingerprint fingerprint;
+  std::unordered_set<std::string> classes;
+};
+
+ConcurrentMap<std::string, std::shared_ptr<const LayoutScan>>&
+layout_scan_cache() {
+  static ConcurrentMap<std::string, std::shared_ptr<const LayoutScan>> cache;
+  return cache;
+}
+
+ConcurrentMap<std::string, std::shared_ptr<const NativeLibScan>>&
+native_lib_scan_cache() {
+  static ConcurrentMap<std::string, std::shared_ptr<const NativeLibScan>>
+      cache;
+  return cache;
+}
 } // namespace
 
 std::unique_ptr<AndroidResources> create_resource_reader(
@@ -75,37 +124,51 @@ namespace {
  */
 std::unordered_set<std::string> extract_classes_from_native_lib(
     const char* data, size_t size) {
+  // Byte classes, so that the scan does a single lookup per byte.
+  enum : uint8_t { kOther = 0, kNameChar = 1, kNameStart = 2 };
+  static const auto char_classes = [] {
+    std::array<uint8_t, 256> table{};
+    for (int c = 0; c < 256; ++c) {
+      if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+          (c >= '0' && c <= '9') || c == '/' || c == '_' || c == '$') {
+        table[c] = kNameChar;
+      }
+      // All classnames start with a package, which starts with a lowercase
+      // letter. Some of them are preceded by an 'L' and followed by a ';' in
+      // native libraries while others are not.
+      if ((c >= 'a' && c <= 'z') || c == 'L') {
+        table[c] |= kNameStart;
+      }
+    }
+    return table;
+  }();
+  auto char_class = [](char c) {
+    return char_classes[static_cast<unsigned char>(c)];
+  };
+
   std::unordered_set<std::string> classes;
-  char buffer[MAX_CLASSNAME_LENGTH + 2]; // +2 for the trailing ";\0"
   const char* inptr = data;
   const char* end = inptr + size;
 
   while (inptr < end) {
-    char* outptr = buffer;
-    size_t length = 0;
-    // All classnames start with a package, which starts with a lowercase
-    // letter. Some of them are preceded by an 'L' and followed by a ';' in
-    // native libraries while others are not.
-    if ((*inptr >= 'a' && *inptr <= 'z') || *inptr == 'L') {
-
-      if (*inptr != 'L') {
-        *outptr++ = 'L';
-        length++;
-      }
-
-      while (inptr < end &&
-             ((*inptr >= 'a' && *inptr <= 'z') ||
-              (*inptr >= 'A' && *inptr <= 'Z') ||
-              (*inptr >= '0' && *inptr <= '9') || *inptr == '/' ||
-              *inptr == '_' || *inptr == '$') &&
+    if (char_class(*inptr) & kNameStart) {
+      const char* start = inptr;
+      bool add_prefix = *inptr != 'L';
+      size_t length = add_prefix ? 1 : 0;
+      while (inptr < end && (char_class(*inptr) & kNameChar) &&
              length < MAX_CLASSNAME_LENGTH) {
-        *outptr++ = *inptr++;
+        inptr++;
         length++;
       }
       if (length >= MIN_CLASSNAME_LENGTH) {
-        *outptr++ = ';';
-        *outptr = '\0';
-        classes.insert(std::string(buffer));
+        std::string name;
+        name.reserve(length + 1);
+        if (add_prefix) {
+          name.push_back('L');
+        }
+        name.append(start, inptr);
+        name.push_back(';');
+        classes.insert(std::move(name));
       }
     }
     inptr++;
@@ -213,7 +276,15 @@ void AndroidResources::collect_layout_classes_and_attributes(
     std::unordered_set<std::string>* out_classes,
     std::unordered_multimap<std::string, std::string>* out_attributes) {
   auto collect_fn = [&](const std::vector<std::string>& prefixes) {
-    std::mutex out_mutex;
+    // Each worker collects into its own sets, which are merged at the end,
+    // so that the workers never wait on each other.
+    auto num_threads =
+        std::min(redex_parallel::default_num_threads(), kReadXMLThreads);
+    struct WorkerResults {
+      std::unordered_set<std::string> classes;
+      std::unordered_multimap<std::string, std::string> attributes;
+    };
+    std::vector<WorkerResults> results(num_threads);
     workqueue_run<std::string>(
         [&](sparta::SpartaWorkerState<std::string>* worker_state,
             const std::string& input) {
@@ -233,24 +304,38 @@ void AndroidResources::collect_layout_classes_and_attributes(
             return;
           }
 
-          std::unordered_set<std::string> local_out_classes;
-          std::unordered_multimap<std::string, std::string>
-              local_out_attributes;
-          collect_layout_classes_and_attributes_for_file(
-              input, attributes_to_read, &local_out_classes,
-              &local_out_attributes);
-          if (!local_out_classes.empty() || !local_out_attributes.empty()) {
-            std::unique_lock<std::mutex> lock(out_mutex);
-            // C++17: use merge to avoid copies.
-            out_classes->insert(local_out_classes.begin(),
-                                local_out_classes.end());
-            out_attributes->insert(local_out_attributes.begin(),
-                                   local_out_attributes.end());
+          auto& local = results[worker_state->worker_id()];
+          FileFingerprint fingerprint;
+          redex::read_file_with_contents(
+              input, [&](const char* data, size_t size) {
+                fingerprint = FileFingerprint(data, size);
+              });
+          auto& cache = layout_scan_cache();
+          auto cached = cache.get(input, nullptr);
+          if (cached == nullptr || !(cached->fingerprint == fingerprint) ||
+              cached->attributes_to_read != attributes_to_read) {
+            auto scan = std::make_shared<LayoutScan>();
+            scan->fingerprint = fingerprint;
+            scan->attributes_to_read = attributes_to_read;
+            collect_layout_classes_and_attributes_for_file(
+                input, attributes_to_read, &scan->classes, &scan->attributes);
+            cached = scan;
+            cache.insert_or_assign(std::make_pair(input, cached));
+          } else {
+            TRACE(RES, 9, "Reusing the classes and attributes of %s",
+                  input.c_str());
           }
+          local.classes.insert(cached->classes.begin(), cached->classes.end());
+          local.attributes.insert(cached->attributes.begin(),
+                                  cached->attributes.end());
         },
         std::vector<std::string>{""},
-        std::min(redex_parallel::default_num_threads(), kReadXMLThreads),
+        num_threads,
         /*push_tasks_while_running=*/true);
+    for (auto& local : results) {
+      out_classes->merge(local.classes);
+      out_attributes->merge(local.attributes);
+    }
   };
 
   collect_fn({
@@ -286,6 +371,10 @@ void AndroidResources::collect_layout_classes_and_attributes(
 
 void AndroidResources::rename_classes_in_layouts(
     const std::map<std::string, std::string>& rename_map) {
+  auto num_threads =
+      std::min(redex_parallel::default_num_threads(), kReadXMLThreads);
+  // Per-worker counts of renamed class names and of failed files.
+  std::vector<std::pair<size_t, size_t>> counts(num_threads);
   workqueue_run<std::string>(
       [&](sparta::SpartaWorkerState<std::string>* worker_state,
           const std::string& input) {
@@ -307,10 +396,21 @@ void AndroidResources::rename_classes_in_layouts(
         bool result = rename_classes_in_layout(input, rename_map, &num_renamed);
         TRACE(RES, 3, "%sRenamed %zu class names in file %s",
               (result ? "" : "FAILED: "), num_renamed, input.c_str());
+        auto& local = counts[worker_state->worker_id()];
+        local.first += num_renamed;
+        local.second += result ? 0 : 1;
       },
       std::vector<std::string>{""},
-      std::min(redex_parallel::default_num_threads(), kReadXMLThreads),
+      num_threads,
       /*push_tasks_while_running=*/true);
+  size_t total_renamed = 0;
+  size_t total_failed = 0;
+  for (const auto& local : counts) {
+    total_renamed += local.first;
+    total_failed += local.second;
+  }
+  TRACE(RES, 2, "Renamed %zu class names in layouts, %zu files failed",
+        total_renamed, total_failed);
 }
 
 std::set<std::string> multimap_values_to_set(
@@ -355,8 +455,10 @@ void find_native_library_files(const std::string& lib_root, Fn handler) {
  * Return all potential java class names located in native libraries.
  */
 std::unordered_set<std::string> AndroidResources::get_native_classes() {
-  std::mutex out_mutex;
-  std::unordered_set<std::string> all_classes;
+  auto num_threads =
+      std::min(redex_parallel::default_num_threads(), kReadNativeThreads);
+  // Each worker collects into its own set, merged at the end.
+  std::vector<std::unordered_set<std::string>> worker_classes(num_threads);
   workqueue_run<std::string>(
       [&](sparta::SpartaWorkerState<std::string>* worker_state,
           const std::string& input) {
@@ -376,19 +478,186 @@ std::unordered_set<std::string> AndroidResources::get_native_classes() {
         redex::read_file_with_contents(
             input,
             [&](const char* data, size_t size) {
-              std::unordered_set<std::string> classes_from_native =
-                  extract_classes_from_native_lib(data, size);
-              if (!classes_from_native.empty()) {
-                std::unique_lock<std::mutex> lock(out_mutex);
-                // C++17: use merge to avoid copies.
-                all_classes.insert(classes_from_native.begin(),
-                                   classes_from_native.end());
+              FileFingerprint fingerprint(data, size);
+              auto& cache = native_lib_scan_cache();
+              auto cached = cache.get(input, nullptr);
+              if (cached == nullptr || !(cached->fingerprint == fingerprint)) {
+                auto scan = std::make_shared<NativeLibScan>();
+                scan->fingerprint = fingerprint;
+                scan->classes = extract_classes_from_native_lib(data, size);
+                cached = scan;
+                cache.insert_or_assign(std::make_pair(input, cached));
               }
+              auto& classes = worker_classes[worker_state->worker_id()];
+              classes.insert(cached->classes.begin(), cached->classes.end());
             },
             64 * 1024);
       },
       std::vector<std::string>{""},
-      std::min(redex_parallel::default_num_threads(), kReadNativeThreads),
+      num_threads,
       /*push_tasks_while_running=*/true);
+
+  std::unordered_set<std::string> all_classes;
+  for (auto& classes : worker_classes) {
+    if (all_classes.empty()) {
+      all_classes = std::move(classes);
+    } else {
+      all_classes.merge(classes);
+    }
+  }
   return all_classes;
 }
+
+void ResourceTableFile::walk_references_for_resource(
+    uint32_t resID,
+    std::unordered_set<uint32_t>* nodes_visited,
+    std::unordered_set<std::string>* potential_file_paths) {
+  if (!nodes_visited->emplace(resID).second) {
+    return;
+  }
+  std::vector<uint32_t> nodes_to_explore{resID};
+  std::vector<uint32_t> ref_ids;
+  std::vector<std::string> file_paths;
+  while (!nodes_to_explore.empty()) {
+    auto id = nodes_to_explore.back();
+    nodes_to_explore.pop_back();
+    ref_ids.clear();
+    file_paths.clear();
+    collect_direct_references(id, &ref_ids, &file_paths);
+    potential_file_paths->insert(file_paths.begin(), file_paths.end());
+    for (auto ref_id : ref_ids) {
+      if (nodes_visited->emplace(ref_id).second) {
+        nodes_to_explore.push_back(ref_id);
+      }
+    }
+  }
+}
+
+ResourceReferenceGraph::ResourceReferenceGraph(
+    ResourceTableFile* table, const XmlReferences& xml_references) {
+  const auto& sorted_res_ids = table->sorted_res_ids;
+  m_res_ids.reserve(sorted_res_ids.size());
+  for (size_t i = 0; i < sorted_res_ids.size(); ++i) {
+    m_node_ids.emplace(sorted_res_ids[i], m_res_ids.size());
+    m_res_ids.push_back(sorted_res_ids[i]);
+  }
+  const uint32_t num_res_ids = m_res_ids.size();
+
+  std::vector<std::vector<uint32_t>> successors(num_res_ids);
+  auto add_res_ids = [this](const auto& ids, std::vector<uint32_t>* succ) {
+    for (auto id : ids) {
+      auto it = m_node_ids.find(id);
+      if (it != m_node_ids.end()) {
+        succ->push_back(it->second);
+      }
+    }
+  };
+  auto sort_unique = [](std::vector<uint32_t>* succ) {
+    std::sort(succ->begin(), succ->end());
+    succ->erase(std::unique(succ->begin(), succ->end()), succ->end());
+  };
+
+  std::unordered_map<std::string, uint32_t> file_nodes;
+  std::vector<uint32_t> ref_ids;
+  std::vector<std::string> file_paths;
+  for (uint32_t i = 0; i < num_res_ids; ++i) {
+    ref_ids.clear();
+    file_paths.clear();
+    table->collect_direct_references(m_res_ids[i], &ref_ids, &file_paths);
+    auto& succ = successors[i];
+    add_res_ids(ref_ids, &succ);
+    for (auto& path : file_paths) {
+      auto emplaced =
+          file_nodes.emplace(path, num_res_ids + m_file_paths.size());
+      if (emplaced.second) {
+        m_file_paths.push_back(std::move(path));
+      }
+      succ.push_back(emplaced.first->second);
+    }
+    sort_unique(&succ);
+  }
+
+  successors.resize(num_res_ids + m_file_paths.size());
+  if (xml_references) {
+    // Reading the files dominates, and each one fills its own node.
+    std::vector<uint32_t> files(m_file_paths.size());
+    std::iota(files.begin(), files.end(), 0);
+    workqueue_run<uint32_t>(
+        [&](uint32_t file) {
+          auto& succ = successors[num_res_ids + file];
+          add_res_ids(xml_references(m_file_paths[file]), &succ);
+          sort_unique(&succ);
+        },
+        files);
+  }
+
+  m_offsets.reserve(successors.size() + 1);
+  m_offsets.push_back(0);
+  for (const auto& succ : successors) {
+    m_edges.insert(m_edges.end(), succ.begin(), succ.end());
+    m_offsets.push_back(m_edges.size());
+  }
+  TRACE(RES, 2, "Resource reference graph: %zu ids, %zu files, %zu edges",
+        m_res_ids.size(), m_file_paths.size(), m_edges.size());
+}
+
+ResourceReferenceGraph::Bits ResourceReferenceGraph::reachable(
+    const std::vector<uint32_t>& roots) const {
+  Bits bits((m_offsets.size() - 1 + 63) / 64, 0);
+  std::vector<uint32_t> stack;
+  auto visit = [&](uint32_t node) {
+    if (!test(bits, node)) {
+      bits[node / 64] |= uint64_t(1) << (node % 64);
+      stack.push_back(node);
+    }
+  };
+  for (auto root : roots) {
+    auto it = m_node_ids.find(root);
+    if (it != m_node_ids.end()) {
+      visit(it->second);
+    }
+  }
+  while (!stack.empty()) {
+    auto node = stack.back();
+    stack.pop_back();
+    for (auto e = m_offsets[node]; e < m_offsets[node + 1]; ++e) {
+      visit(m_edges[e]);
+    }
+  }
+  return bits;
+}
+
+void ResourceReferenceGraph::walk_references(
+    const std::vector<uint32_t>& roots,
+    std::unordered_set<uint32_t>* nodes_visited,
+    std::unordered_set<std::string>* potential_file_paths) const {
+  nodes_visited->insert(roots.begin(), roots.end());
+  auto bits = reachable(roots);
+  auto ids = get_res_ids(bits);
+  nodes_visited->insert(ids.begin(), ids.end());
+  auto paths = get_file_paths(bits);
+  potential_file_paths->insert(paths.begin(), paths.end());
+}
+
+std::vector<uint32_t> ResourceReferenceGraph::get_res_ids(
+    const Bits& bits) const {
+  std::vector<uint32_t> result;
+  for (uint32_t i = 0; i < m_res_ids.size(); ++i) {
+    if (test(bits, i)) {
+      result.push_back(m_res_ids[i]);
+    }
+  }
+  return result;
+}
+
+std::vector<std::string> ResourceReferenceGraph::get_file_paths(
+    const Bits& bits) const {
+  std::vector<std::string> result;
+  const uint32_t num_res_ids = m_res_ids.size();
+  for (uint32_t i = 0; i < m_file_paths.size(); ++i) {
+    if (test(bits, num_res_ids + i)) {
+      result.push_back(m_file_paths[i]);
+    }
+  }
+  return result;
+}
@@ -12,6 +12,7 @@
 #include <boost/filesystem/operations.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/optional.hpp>
+#include <functional>
 #include <map>
 #include <memory>
 #include <set>
@@ -114,13 +115,21 @@ class ResourceTableFile {
       uint32_t res_id,
       ResourcePathType path_type = ResourcePathType::DevicePath) = 0;
 
+  // Outputs the resources that the given resource refers to, for all
+  // configurations, as well as strings that may be resource file paths. Only
+  // follows a single level of references.
+  virtual void collect_direct_references(
+      uint32_t res_id,
+      std::vector<uint32_t>* ref_ids,
+      std::vector<std::string>* potential_file_paths) = 0;
+
   // Follows the reference links for a resource for all configurations. Outputs
   // all the nodes visited, as well as strings that may be additional resource
-  // file paths.
-  virtual void walk_references_for_resource(
+  // file paths. Use a ResourceReferenceGraph when walking from many roots.
+  void walk_references_for_resource(
       uint32_t resID,
       std::unordered_set<uint32_t>* nodes_visited,
-      std::unordered_set<std::string>* potential_file_paths) = 0;
+      std::unordered_set<std::string>* potential_file_paths);
 
   // Return the resource ids based on the given resource name.
   std::vector<uint32_t> get_res_ids_by_name(const std::string& name) const {
@@ -138,6 +147,67 @@ class ResourceTableFile {
   ResourceTableFile() {}
 };
 
+/*
+ * The references between the resources of a table, built once so that the
+ * resources reachable from a set of roots can be queried without walking the
+ * resource values again.
+ *
+ * Nodes are the ids of the table's sorted_res_ids, followed by the potential
+ * file paths that their values mention. Edges are stored in compressed sparse
+ * row form: the successors of node i are m_edges[m_offsets[i]] up to
+ * m_edges[m_offsets[i + 1]]. When XML references are given, a file node has
+ * an edge to each resource id that the attributes of the file refer to.
+ */
+class ResourceReferenceGraph {
+ public:
+  // One bit per node, in node order.
+  using Bits = std::vector<uint64_t>;
+
+  // Given a potential file path as produced by the table, return the resource
+  // ids referred to by the file's XML attributes.
+  using XmlReferences =
+      std::function<std::unordered_set<uint32_t>(const std::string&)>;
+
+  explicit ResourceReferenceGraph(ResourceTableFile* table,
+                                  const XmlReferences& xml_references = {});
+
+  // Return the nodes reachable from the given resource ids, including the
+  // roots themselves. Unknown ids are ignored.
+  Bits reachable(const std::vector<uint32_t>& roots) const;
+
+  // Same outputs as ResourceTableFile::walk_references_for_resource, for all
+  // the given roots at once.
+  void walk_references(const std::vector<uint32_t>& roots,
+                       std::unordered_set<uint32_t>* nodes_visited,
+                       std::unordered_set<std::string>* potential_file_paths)
+      const;
+
+  bool is_reachable(const Bits& bits, uint32_t res_id) const {
+    auto it = m_node_ids.find(res_id);
+    return it != m_node_ids.end() && test(bits, it->second);
+  }
+
+  // The resource ids and file paths of the set bits.
+  std::vector<uint32_t> get_res_ids(const Bits& bits) const;
+  std::vector<std::string> get_file_paths(const Bits& bits) const;
+
+  size_t num_res_ids() const { return m_res_ids.size(); }
+  size_t num_file_paths() const { return m_file_paths.size(); }
+  size_t num_edges() const { return m_edges.size(); }
+
+ private:
+  static bool test(const Bits& bits, uint32_t node) {
+    return (bits[node / 64] >> (node % 64)) & 1;
+  }
+
+  std::vector<uint32_t> m_res_ids;
+  std::vector<std::string> m_file_paths;
+  // Resource ids to their node number.
+  std::unordered_map<uint32_t, uint32_t> m_node_ids;
+  std::vector<uint32_t> m_offsets;
+  std::vector<uint32_t> m_edges;
+};
+
 class AndroidResources {
  public:
   virtual boost::optional<int32_t> get_min_sdk() = 0;
@@ -10,6 +10,67 @@
 
 namespace {
 
+struct FieldRefCacheKey {
+  const DexFieldRef* field;
+  FieldSearch search;
+
+  bool operator==(const FieldRefCacheKey& other) const {
+    return field == other.field && search == other.search;
+  }
+};
+
+struct FieldRefCacheKeyHash {
+  std::size_t operator()(const FieldRefCacheKey& key) const {
+    std::size_t seed = 0;
+    boost::hash_combine(seed, key.field);
+    boost::hash_combine(
+        seed, static_cast<std::underlying_type_t<FieldSearch>>(key.search));
+    return seed;
+  }
+};
+
+/*
+ * Maps references to what they resolved to, unresolvable ones included, in
+ * the generation of the resolution.
+ */
+template <typename Key, typename Def, typename Hash>
+class GlobalResolutionCache {
+ public:
+  template <typename ResolveFn>
+  Def* get(const Key& key, const ResolveFn& resolve) {
+    // Read the generation first, so that edits made while resolving leave
+    // a stale entry.
+    auto generation = RedexContext::resolution_generation();
+    auto cached = m_map.get(key, std::make_pair(generation + 1, nullptr));
+    if (cached.first == generation) {
+      return cached.second;
+    }
+    Def* def = resolve();
+    m_map.insert_or_assign(
+        std::make_pair(key, std::make_pair(generation, def)));
+    return def;
+  }
+
+ private:
+  ConcurrentMap<Key, std::pair<size_t, Def*>, Hash> m_map;
+};
+
+GlobalResolutionCache<MethodRefCacheKey, DexMethod, MethodRefCacheKeyHash>&
+method_ref_cache() {
+  static GlobalResolutionCache<MethodRefCacheKey, DexMethod,
+                               MethodRefCacheKeyHash>
+      cache;
+  return cache;
+}
+
+GlobalResolutionCache<FieldRefCacheKey, DexField, FieldRefCacheKeyHash>&
+field_ref_cache() {
+  static GlobalResolutionCache<FieldRefCacheKey, DexField,
+                               FieldRefCacheKeyHash>
+      cache;
+  return cache;
+}
+
 inline bool match(const DexString* name,
                   const DexProto* proto,
                   const DexMethod* cls_meth) {
@@ -119,6 +180,25 @@ DexMethod* resolve_method_ref(const DexClass* cls,
   return nullptr;
 }
 
+DexMethod* resolve_method_ref(DexMethodRef* method, MethodSearch search) {
+  always_assert(search != MethodSearch::Super);
+  return method_ref_cache().get(
+      MethodRefCacheKey{method, search}, [method, search]() -> DexMethod* {
+        auto cls = type_class(method->get_class());
+        if (cls == nullptr) return nullptr;
+        return resolve_method_ref(cls, method->get_name(), method->get_proto(),
+                                  search);
+      });
+}
+
+DexField* resolve_field_ref(const DexFieldRef* field, FieldSearch search) {
+  return field_ref_cache().get(
+      FieldRefCacheKey{field, search}, [field, search]() {
+        return resolve_field(field->get_class(), field->get_name(),
+                             field->get_type(), search);
+      });
+}
+
 DexField* resolve_field(const DexType* owner,
                         const DexString* name,
                         const DexType* type,
@@ -179,6 +179,21 @@ DexMethod* resolve_method_ref(const DexClass* cls,
                               const DexProto* proto,
                               MethodSearch search);
 
+/**
+ * Resolves a method reference that is not a definition, in the class of the
+ * reference and up. The resolutions are cached process-wide, until the next
+ * edit that may change them starts a new resolution generation, see
+ * RedexContext::start_resolution_generation().
+ *
+ * The non-const member accessors of DexClass start a new generation, as
+ * callers may edit the members through them. Hence a reference to the
+ * members of a class must not be held across a resolution while the members
+ * are edited through it.
+ *
+ * This method is thread-safe. The search must not be MethodSearch::Super.
+ */
+DexMethod* resolve_method_ref(DexMethodRef* method, MethodSearch search);
+
 /**
  * Resolve a method to its definition. When searching for a definition of a
  * virtual callsite, we return one of the possible callees.
@@ -214,10 +229,7 @@ inline DexMethod* resolve_method(DexMethodRef* method,
   if (m) {
     return m;
   }
-  auto cls = type_class(method->get_class());
-  if (cls == nullptr) return nullptr;
-  return resolve_method_ref(cls, method->get_name(), method->get_proto(),
-                            search);
+  return resolve_method_ref(method, search);
 }
 
 /**
@@ -315,6 +327,13 @@ DexField* resolve_field(const DexType*,
                         const DexType*,
                         FieldSearch = FieldSearch::Any);
 
+/**
+ * Resolves a field reference that is not a definition, with the same
+ * process-wide cache as resolve_method_ref(DexMethodRef*, MethodSearch).
+ * This method is thread-safe.
+ */
+DexField* resolve_field_ref(const DexFieldRef* field, FieldSearch search);
+
 /**
  * Given a field, search its class hierarchy for the definition.
  * If the field is a definition already the field is returned otherwise a
@@ -325,6 +344,5 @@ inline DexField* resolve_field(const DexFieldRef* field,
   if (field->is_def()) {
     return const_cast<DexField*>(static_cast<const DexField*>(field));
   }
-  return resolve_field(field->get_class(), field->get_name(), field->get_type(),
-                       search);
+  return resolve_field_ref(field, search);
 }
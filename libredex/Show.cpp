@@ -7,6 +7,7 @@
 
 #include "Show.h"
 
+#include <charconv>
 #include <iomanip>
 
 #include <boost/version.hpp>
@@ -125,7 +126,69 @@ std::string show(DexAnnotationVisibility vis) {
   }
 }
 
+} // namespace
+
+void show_to(std::string& out, const DexString* str) {
+  if (str != nullptr) {
+    out += str->str();
+  }
+}
+
+void show_to(std::string& out, const DexType* t) {
+  if (t != nullptr) {
+    out += t->get_name()->str();
+  }
+}
+
+void show_to(std::string& out, const DexFieldRef* ref) {
+  if (ref == nullptr) {
+    return;
+  }
+  show_to(out, ref->get_class());
+  out += '.';
+  show_to(out, ref->get_name());
+  out += ':';
+  show_to(out, ref->get_type());
+}
+
+void show_to(std::string& out, const DexTypeList* l) {
+  if (l == nullptr) {
+    return;
+  }
+  for (auto type : l->get_type_list()) {
+    show_to(out, type);
+  }
+}
+
+void show_to(std::string& out, const DexProto* p) {
+  if (p == nullptr) {
+    return;
+  }
+  out += '(';
+  show_to(out, p->get_args());
+  out += ')';
+  show_to(out, p->get_rtype());
+}
+
+void show_to(std::string& out, const DexMethodRef* ref) {
+  if (ref == nullptr) {
+    return;
+  }
+  show_to(out, ref->get_class());
+  out += '.';
+  show_to(out, ref->get_name());
+  out += ':';
+  show_to(out, ref->get_proto());
+}
+
+namespace {
+
 std::string show_type(const DexType* t, bool deobfuscated) {
+  if (!deobfuscated) {
+    std::string out;
+    show_to(out, t);
+    return out;
+  }
   return self_recursive_fn(
       [&](auto self, const DexType* t) -> std::string {
         if (t == nullptr) {
@@ -156,6 +219,11 @@ std::string show_field(const DexFieldRef* ref, bool deobfuscated) {
   if (ref == nullptr) {
     return "";
   }
+  if (!deobfuscated) {
+    std::string out;
+    show_to(out, ref);
+    return out;
+  }
 
   if (deobfuscated && ref->is_def()) {
     auto name = ref->as_def()->get_deobfuscated_name();
@@ -173,6 +241,11 @@ std::string show_type_list(const DexTypeList* l, bool deobfuscated) {
   if (l == nullptr) {
     return "";
   }
+  if (!deobfuscated) {
+    std::string out;
+    show_to(out, l);
+    return out;
+  }
 
   const auto& type_list = l->get_type_list();
   string_builders::DynamicStringBuilder b(type_list.size());
@@ -186,6 +259,11 @@ std::string show_proto(const DexProto* p, bool deobfuscated) {
   if (p == nullptr) {
     return "";
   }
+  if (!deobfuscated) {
+    std::string out;
+    show_to(out, p);
+    return out;
+  }
   string_builders::StaticStringBuilder<4> b;
   b << "(" << show_type_list(p->get_args(), deobfuscated) << ")"
     << show_type(p->get_rtype(), deobfuscated);
@@ -196,6 +274,11 @@ std::string show_method(const DexMethodRef* ref, bool deobfuscated) {
   if (ref == nullptr) {
     return "";
   }
+  if (!deobfuscated) {
+    std::string out;
+    show_to(out, ref);
+    return out;
+  }
 
   if (deobfuscated && ref->is_def()) {
     auto name = ref->as_def()->get_deobfuscated_name();
@@ -898,6 +981,11 @@ std::string show_opcode(const DexInstruction* insn, bool deobfuscated = false) {
 
 std::string show_insn(const IRInstruction* insn, bool deobfuscated) {
   if (!insn) return "";
+  if (!deobfuscated) {
+    std::string out;
+    show_to(out, insn);
+    return out;
+  }
   std::ostringstream ss;
   ss << show(insn->opcode()) << " ";
   bool first = true;
@@ -1183,7 +1271,9 @@ std::string show(const DexAnnotationDirectory* p) {
   return ss.str();
 }
 
-std::string show(IROpcode opcode) {
+namespace {
+
+const char* opcode_name(IROpcode opcode) {
   switch (opcode) {
 #define OP(op, ...) \
   case OPCODE_##op: \
@@ -1197,6 +1287,84 @@ std::string show(IROpcode opcode) {
   not_reached_log("Unknown opcode 0x%x", opcode);
 }
 
+template <typename Integer>
+void append_number(std::string& out, Integer value) {
+  char buf[24];
+  auto res = std::to_chars(buf, buf + sizeof(buf), value);
+  out.append(buf, res.ptr);
+}
+
+void append_register(std::string& out, reg_t reg) {
+  out += 'v';
+  append_number(out, reg);
+}
+
+// Same escaping as boost::io::quoted with its default delimiter and escape
+// characters.
+void append_quoted(std::string& out, const DexString* str) {
+  out += '"';
+  if (str != nullptr) {
+    for (auto c : str->str()) {
+      if (c == '"' || c == '\\') {
+        out += '\\';
+      }
+      out += c;
+    }
+  }
+  out += '"';
+}
+
+} // namespace
+
+std::string show(IROpcode opcode) { return opcode_name(opcode); }
+
+void show_to(std::string& out, const IRInstruction* insn) {
+  if (!insn) return;
+  out += opcode_name(insn->opcode());
+  out += ' ';
+  bool first = true;
+  if (insn->has_dest()) {
+    append_register(out, insn->dest());
+    first = false;
+  }
+  for (unsigned i = 0; i < insn->srcs_size(); ++i) {
+    if (!first) out += ", ";
+    append_register(out, insn->src(i));
+    first = false;
+  }
+  if (opcode::ref(insn->opcode()) != opcode::Ref::None && !first) {
+    out += ", ";
+  }
+  switch (opcode::ref(insn->opcode())) {
+  case opcode::Ref::None:
+    break;
+  case opcode::Ref::String:
+    append_quoted(out, insn->get_string());
+    break;
+  case opcode::Ref::Type:
+    show_to(out, insn->get_type());
+    break;
+  case opcode::Ref::Field:
+    show_to(out, insn->get_field());
+    break;
+  case opcode::Ref::Method:
+    show_to(out, insn->get_method());
+    break;
+  case opcode::Ref::Literal:
+    append_number(out, insn->get_literal());
+    break;
+  case opcode::Ref::Data:
+    out += "<data>"; // TODO: print something more informative
+    break;
+  case opcode::Ref::CallSite:
+    out += show(insn->get_callsite());
+    break;
+  case opcode::Ref::MethodHandle:
+    out += show(insn->get_methodhandle());
+    break;
+  }
+}
+
 std::string show(DexOpcode opcode) {
   switch (opcode) {
 #define OP(op, ...)  \
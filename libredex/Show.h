@@ -137,6 +137,21 @@ std::string show_deobfuscated(const DexProto*);
 std::string show_deobfuscated(const DexCallSite*);
 std::string show_deobfuscated(const DexMethodHandle*);
 
+/*
+ * Appending variants of show, for hot paths like hashing and building map
+ * keys. They produce the same text as the corresponding show(), but append it
+ * to a caller-owned buffer without creating temporary strings, so a buffer
+ * that is cleared and reused between calls stops allocating once it is big
+ * enough.
+ */
+void show_to(std::string& out, const DexString*);
+void show_to(std::string& out, const DexType*);
+void show_to(std::string& out, const DexFieldRef*);
+void show_to(std::string& out, const DexTypeList*);
+void show_to(std::string& out, const DexProto*);
+void show_to(std::string& out, const DexMethodRef*);
+void show_to(std::string& out, const IRInstruction*);
+
 // SHOW(x) is syntax sugar for show(x).c_str()
 #define SHOW(...) show(__VA_ARGS__).c_str()
 
@@ -7,6 +7,7 @@
 
 #include "SourceBlocks.h"
 
+#include <algorithm>
 #include <limits>
 #include <optional>
 #include <sstream>
@@ -370,7 +371,7 @@ struct InsertHelper {
       for (auto* b : cfg.blocks()) {
         auto vec = gather_source_blocks(b);
         for (auto* sb : vec) {
-          const_cast<SourceBlock*>(sb)->vals[i] = val;
+          const_cast<SourceBlock*>(sb)->vals.set(i, val);
         }
       }
     }
@@ -397,4 +398,42 @@ InsertResult insert_source_blocks(DexMethod* method,
   return {helper.id, helper.oss.str(), !had_failures};
 }
 
+bool ColdChainsLastStrategy::is_cold(const BlockChain& chain) {
+  bool seen_source_block = false;
+  for (const auto* b : chain) {
+    bool all_zero = true;
+    foreach_source_block(b, [&](const SourceBlock* sb) {
+      seen_source_block = true;
+      if (sb->vals.empty()) {
+        all_zero = false;
+        return;
+      }
+      sb->foreach_val([&](const auto& val) {
+        all_zero = all_zero && val && val->val == 0.0f;
+      });
+    });
+    if (!all_zero) {
+      return false;
+    }
+  }
+  return seen_source_block;
+}
+
+std::vector<Block*> ColdChainsLastStrategy::order(
+    ControlFlowGraph& cfg, sparta::WeakTopologicalOrdering<BlockChain*> wto) {
+  std::vector<BlockChain*> chains;
+  wto.visit_depth_first([&chains](BlockChain* c) { chains.push_back(c); });
+  // The entry chain comes first in the WTO, and must stay there.
+  std::stable_partition(
+      chains.begin() + (chains.empty() ? 0 : 1), chains.end(),
+      [](const BlockChain* c) { return !is_cold(*c); });
+
+  std::vector<Block*> result;
+  result.reserve(cfg.num_blocks());
+  for (auto* c : chains) {
+    result.insert(result.end(), c->begin(), c->end());
+  }
+  return result;
+}
+
 } // namespace source_blocks
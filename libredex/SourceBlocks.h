@@ -235,4 +235,22 @@ inline const SourceBlock* get_first_source_block(const cfg::Block* b) {
   return nullptr;
 }
 
+/*
+ * Lays out the block chains of a CFG like the default linearization, except
+ * that the cold chains are moved to the end, keeping their relative order.
+ * The hot chains then end up next to each other, so that more of the hot
+ * gotos become fallthroughs, and cold code doesn't interrupt hot code.
+ *
+ * A chain is cold when it has source blocks, and they all have values for
+ * all interactions that are zero. Chains without profile data stay where
+ * they are, as does the entry chain.
+ */
+struct ColdChainsLastStrategy : public LinearizationStrategy {
+  std::vector<Block*> order(
+      ControlFlowGraph& cfg,
+      sparta::WeakTopologicalOrdering<BlockChain*> wto) override;
+
+  static bool is_cold(const BlockChain& chain);
+};
+
 } // namespace source_blocks
@@ -53,6 +53,7 @@ template <typename Summary>
 class MethodSummaryRegistry : public sparta::AbstractRegistry {
  private:
   ConcurrentMap<const DexMethod*, Summary> m_map;
+  ConcurrentSet<const DexMethod*> m_updated;
   bool m_has_update = false;
 
  public:
@@ -71,6 +72,7 @@ class MethodSummaryRegistry : public sparta::AbstractRegistry {
       entry_exists = exists;
       value = updater(value);
     });
+    m_updated.insert(method);
     m_has_update = true; // benign race conditions as long as materialize_update
                          // is not called during update.
     return entry_exists;
@@ -86,11 +88,18 @@ class MethodSummaryRegistry : public sparta::AbstractRegistry {
                  });
 
     if (changed) {
+      m_updated.insert(method);
       m_has_update = true; // benign race conditions as long as
                            // materialize_update is not called during update.
     }
   }
 
+  // Returns true if the summary of `method` was updated since the last call.
+  // Used by InterproceduralAnalyzer::run_dependency_driven.
+  bool consume_update(const DexMethod* method) {
+    return m_updated.erase(method) != 0;
+  }
+
   // Not thread-safe
   const ConcurrentMap<const DexMethod*, Summary>& get_map() const {
     return m_map;
@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "SubtypeIndex.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "DexUtil.h"
+#include "RedexContext.h"
+#include "TypeUtil.h"
+
+namespace {
+
+using Interfaces = std::vector<const DexType*>;
+
+/*
+ * Memoizes the super interfaces of each interface, transitively. The walk
+ * stops at interfaces without a DexClass, as type::check_cast() does.
+ */
+class SuperInterfaces {
+ public:
+  const Interfaces& get(const DexType* intf) {
+    auto it = m_supers.find(intf);
+    if (it != m_supers.end()) return it->second;
+    Interfaces supers;
+    const auto cls = type_class(intf);
+    if (cls != nullptr) {
+      for (const auto& super : cls->get_interfaces()->get_type_list()) {
+        supers.push_back(super);
+        const auto& super_supers = get(super);
+        supers.insert(supers.end(), super_supers.begin(), super_supers.end());
+      }
+      std::sort(supers.begin(), supers.end());
+      supers.erase(std::unique(supers.begin(), supers.end()), supers.end());
+    }
+    return m_supers.emplace(intf, std::move(supers)).first->second;
+  }
+
+ private:
+  std::unordered_map<const DexType*, Interfaces> m_supers;
+};
+
+} // namespace
+
+SubtypeIndex::SubtypeIndex(const Scope& scope)
+    : SubtypeIndex(scope, build_type_hierarchy(scope)) {}
+
+SubtypeIndex::SubtypeIndex(const Scope& scope,
+                           const ClassHierarchy& hierarchy) {
+  number_classes(hierarchy);
+  number_interfaces(scope);
+}
+
+void SubtypeIndex::number_classes(const ClassHierarchy& hierarchy) {
+  // Same roots as TypeSystem's parent chains.
+  std::vector<const DexType*> roots;
+  for (const auto& children_it : hierarchy) {
+    if (type_class(children_it.first) == nullptr) {
+      roots.push_back(children_it.first);
+    }
+  }
+  std::sort(roots.begin(), roots.end(), compare_dextypes);
+  roots.push_back(type::java_lang_Object());
+
+  static const TypeSet no_children;
+  auto children_of = [&hierarchy](const DexType* type) -> const TypeSet& {
+    auto it = hierarchy.find(type);
+    return it == hierarchy.end() ? no_children : it->second;
+  };
+
+  std::vector<std::pair<const DexType*, TypeSet::const_iterator>> stack;
+  for (const auto& root : roots) {
+    if (m_nodes.count(root)) continue;
+    auto visit = [&](const DexType* type) {
+      m_nodes[type].pre = m_preorder.size();
+      m_preorder.push_back(type);
+      stack.emplace_back(type, children_of(type).begin());
+    };
+    visit(root);
+    while (!stack.empty()) {
+      auto& top = stack.back();
+      if (top.second != children_of(top.first).end()) {
+        visit(*top.second++);
+        continue;
+      }
+      m_nodes[top.first].last = m_preorder.size() - 1;
+      stack.pop_back();
+    }
+  }
+}
+
+void SubtypeIndex::number_interfaces(const Scope& scope) {
+  std::vector<const DexClass*> intf_classes;
+  for (const auto& cls : scope) {
+    if (is_interface(cls)) intf_classes.push_back(cls);
+  }
+  g_redex->walk_type_class([&](const DexType*, const DexClass* cls) {
+    if (cls->is_external() && is_interface(cls)) intf_classes.push_back(cls);
+  });
+
+  // Weigh each interface by the number of classes implementing it.
+  SuperInterfaces super_interfaces;
+  std::unordered_map<const DexType*, size_t> weights;
+  auto add_weight = [&](const DexType* intf, size_t weight) {
+    weights[intf] += weight;
+    for (const auto& super : super_interfaces.get(intf)) {
+      weights[super] += weight;
+    }
+  };
+  for (const auto& type : m_preorder) {
+    const auto cls = type_class(type);
+    if (cls == nullptr) continue;
+    const auto& node = m_nodes.at(type);
+    for (const auto& intf : cls->get_interfaces()->get_type_list()) {
+      add_weight(intf, node.last - node.pre + 1);
+    }
+  }
+  for (const auto& cls : intf_classes) {
+    add_weight(cls->get_type(), 0);
+  }
+
+  std::vector<std::pair<const DexType*, size_t>> ordered(weights.begin(),
+                                                         weights.end());
+  std::sort(ordered.begin(), ordered.end(), [](const auto& a, const auto& b) {
+    return a.second != b.second ? a.second > b.second
+                                : compare_dextypes(a.first, b.first);
+  });
+  for (const auto& intf_it : ordered) {
+    m_interface_ids.emplace(intf_it.first, m_interface_ids.size());
+  }
+
+  auto set_bit = [this](std::vector<uint64_t>& bits, const DexType* intf) {
+    auto id = m_interface_ids.at(intf);
+    if (bits.size() <= id / 64) bits.resize(id / 64 + 1, 0);
+    bits[id / 64] |= uint64_t(1) << (id % 64);
+  };
+
+  m_interface_sets.emplace_back();
+  // Super classes come first in pre-order, so their sets are ready when
+  // their subclasses inherit them.
+  for (const auto& type : m_preorder) {
+    const auto cls = type_class(type);
+    if (cls == nullptr) continue;
+    auto& node = m_nodes.at(type);
+    const auto super = cls->get_super_class();
+    auto super_node = super == nullptr ? m_nodes.end() : m_nodes.find(super);
+    node.interfaces =
+        super_node == m_nodes.end() ? 0 : super_node->second.interfaces;
+    const auto& intfs = cls->get_interfaces()->get_type_list();
+    if (intfs.empty()) continue;
+    auto bits = m_interface_sets[node.interfaces];
+    for (const auto& intf : intfs) {
+      set_bit(bits, intf);
+      for (const auto& super_intf : super_interfaces.get(intf)) {
+        set_bit(bits, super_intf);
+      }
+    }
+    node.interfaces = m_interface_sets.size();
+    m_interface_sets.push_back(std::move(bits));
+  }
+  for (const auto& cls : intf_classes) {
+    auto& node = m_nodes[cls->get_type()];
+    if (node.pre != kNotAClass) continue;
+    const auto& supers = super_interfaces.get(cls->get_type());
+    if (supers.empty()) continue;
+    std::vector<uint64_t> bits;
+    for (const auto& super_intf : supers) {
+      set_bit(bits, super_intf);
+    }
+    node.interfaces = m_interface_sets.size();
+    m_interface_sets.push_back(std::move(bits));
+  }
+}
+
+bool SubtypeIndex::check_cast(const DexType* type,
+                              const DexType* base_type) const {
+  if (type == base_type) return true;
+  if (type != nullptr && type::is_array(type)) {
+    if (base_type != nullptr && type::is_array(base_type)) {
+      auto element_type = type::get_array_element_type(type);
+      auto element_base_type = type::get_array_element_type(base_type);
+      if (!type::is_primitive(element_type) &&
+          !type::is_primitive(element_base_type) &&
+          check_cast(element_type, element_base_type)) {
+        return true;
+      }
+    }
+    return base_type == type::java_lang_Object();
+  }
+  auto node = m_nodes.find(type);
+  if (node == m_nodes.end()) {
+    return type::check_cast(type, base_type);
+  }
+  if (node->second.pre == kNotAClass) {
+    // Interfaces have a super class too, normally java.lang.Object.
+    return implements(type, base_type) ||
+           check_cast(type_class(type)->get_super_class(), base_type);
+  }
+  const auto* base = get_class_node(base_type);
+  if (base != nullptr && base->pre <= node->second.pre &&
+      node->second.pre <= base->last) {
+    return true;
+  }
+  return implements(type, base_type);
+}
+
+void SubtypeIndex::get_all_children(const DexType* type,
+                                    TypeSet& children) const {
+  const auto* node = get_class_node(type);
+  if (node == nullptr) return;
+  for (auto i = node->pre + 1; i <= node->last; ++i) {
+    children.insert(m_preorder[i]);
+  }
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include "ClassHierarchy.h"
+#include "DexClass.h"
+
+/**
+ * SubtypeIndex
+ * Answers subtyping queries in constant time, instead of walking the parent
+ * chains and the interface lists of the classes involved.
+ *
+ * The class tree is numbered by a depth-first traversal, so that the
+ * subclasses of a class are exactly the classes whose pre-order number falls
+ * between the class' own number and the number of its last descendant. The
+ * interfaces implemented by a class, transitively, are a bit vector. Classes
+ * that don't declare interfaces share the bit vector of their super class,
+ * and interfaces are numbered by decreasing number of implementors so that
+ * the vectors of most classes are only a word or two long.
+ *
+ * The index is a snapshot of the hierarchy: it must be rebuilt when classes
+ * are added, removed or reparented.
+ */
+class SubtypeIndex {
+ public:
+  /**
+   * Indexes the classes of the scope along with the external classes, i.e.
+   * the same types as build_type_hierarchy().
+   */
+  explicit SubtypeIndex(const Scope& scope);
+
+  /**
+   * Same as above, reusing a hierarchy that was built for the scope.
+   */
+  SubtypeIndex(const Scope& scope, const ClassHierarchy& hierarchy);
+
+  /**
+   * Return true if child is a subclass of or equal to parent.
+   * Both types must be classes (not interfaces), as in
+   * TypeSystem::is_subtype().
+   */
+  bool is_subclass(const DexType* parent, const DexType* child) const {
+    const auto* p = get_class_node(parent);
+    const auto* c = get_class_node(child);
+    return p != nullptr && c != nullptr && p->pre <= c->pre &&
+           c->pre <= p->last;
+  }
+
+  /**
+   * Return true if the given class or interface implements or extends the
+   * given interface, directly or not. Interfaces don't implement themselves.
+   */
+  bool implements(const DexType* type, const DexType* intf) const {
+    auto node = m_nodes.find(type);
+    if (node == m_nodes.end()) return false;
+    auto id = m_interface_ids.find(intf);
+    if (id == m_interface_ids.end()) return false;
+    const auto& bits = m_interface_sets[node->second.interfaces];
+    size_t word = id->second / 64;
+    return word < bits.size() && (bits[word] >> (id->second % 64)) & 1;
+  }
+
+  /**
+   * Same result as type::check_cast(type, base_type).
+   */
+  bool check_cast(const DexType* type, const DexType* base_type) const;
+
+  /**
+   * Add all the subclasses of the given class to children. The class itself
+   * is not included.
+   */
+  void get_all_children(const DexType* type, TypeSet& children) const;
+
+  /**
+   * Return true if the given type is a class or an interface of the index.
+   */
+  bool contains(const DexType* type) const { return m_nodes.count(type); }
+
+  size_t num_classes() const { return m_preorder.size(); }
+
+  size_t num_interfaces() const { return m_interface_ids.size(); }
+
+ private:
+  static constexpr uint32_t kNotAClass = std::numeric_limits<uint32_t>::max();
+
+  struct Node {
+    // The pre-order numbers of the class and of its last descendant, or
+    // kNotAClass for interfaces.
+    uint32_t pre{kNotAClass};
+    uint32_t last{kNotAClass};
+    // The position of the implemented interfaces in m_interface_sets.
+    uint32_t interfaces{0};
+  };
+
+  const Node* get_class_node(const DexType* type) const {
+    auto it = m_nodes.find(type);
+    return it == m_nodes.end() || it->second.pre == kNotAClass ? nullptr
+                                                               : &it->second;
+  }
+
+  void number_classes(const ClassHierarchy& hierarchy);
+  void number_interfaces(const Scope& scope);
+
+  std::unordered_map<const DexType*, Node> m_nodes;
+  std::vector<const DexType*> m_preorder;
+  std::unordered_map<const DexType*, uint32_t> m_interface_ids;
+  // Trimmed bit vectors. The first one is empty.
+  std::vector<std::vector<uint64_t>> m_interface_sets;
+};
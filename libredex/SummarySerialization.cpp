@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "SummarySerialization.h"
+
+#include <algorithm>
+#include <boost/functional/hash.hpp>
+#include <limits>
+
+namespace summary_serialization {
+
+namespace {
+
+struct NodeInfo {
+  size_t index;
+  size_t lowlink;
+  bool on_stack;
+  std::vector<const DexMethod*> successors;
+};
+
+} // namespace
+
+CacheKeys compute_cache_keys(
+    const std::vector<const DexMethod*>& methods,
+    const std::function<std::vector<const DexMethod*>(const DexMethod*)>&
+        get_dependencies,
+    size_t salt) {
+  // Methods within a strongly connected component depend on each other,
+  // hence they all share the key of their component. We compute the
+  // components with an iterative version of Tarjan's algorithm, which
+  // discovers components in reverse topological order, i.e. the key of a
+  // component is computed after the keys of all the components it depends on.
+  std::unordered_map<const DexMethod*, NodeInfo> infos;
+  std::unordered_map<const DexMethod*, size_t> method_hashes;
+  std::unordered_map<const DexMethod*, size_t> scc_keys;
+  std::vector<const DexMethod*> stack;
+  size_t next_index = 0;
+
+  auto visit = [&](const DexMethod* method) -> NodeInfo& {
+    auto& info = infos[method];
+    info.index = info.lowlink = next_index++;
+    info.on_stack = true;
+    info.successors = get_dependencies(method);
+    stack.push_back(method);
+    return info;
+  };
+
+  auto pop_component = [&](const DexMethod* root) {
+    std::vector<const DexMethod*> members;
+    const DexMethod* member;
+    do {
+      member = stack.back();
+      stack.pop_back();
+      infos.at(member).on_stack = false;
+      members.push_back(member);
+    } while (member != root);
+
+    std::vector<size_t> member_hashes;
+    std::vector<size_t> successor_keys;
+    for (auto m : members) {
+      auto dex_hash = hashing::DexMethodHasher(m).run();
+      size_t hash = dex_hash.signature_hash;
+      boost::hash_combine(hash, dex_hash.code_hash);
+      method_hashes.emplace(m, hash);
+      member_hashes.push_back(hash);
+      for (auto succ : infos.at(m).successors) {
+        auto it = scc_keys.find(succ);
+        if (it != scc_keys.end()) {
+          successor_keys.push_back(it->second);
+        }
+      }
+    }
+    std::sort(member_hashes.begin(), member_hashes.end());
+    std::sort(successor_keys.begin(), successor_keys.end());
+    successor_keys.erase(
+        std::unique(successor_keys.begin(), successor_keys.end()),
+        successor_keys.end());
+    size_t key = salt;
+    boost::hash_combine(key, member_hashes.size());
+    boost::hash_range(key, member_hashes.begin(), member_hashes.end());
+    boost::hash_range(key, successor_keys.begin(), successor_keys.end());
+    for (auto m : members) {
+      scc_keys.emplace(m, key);
+    }
+  };
+
+  for (auto start : methods) {
+    if (infos.count(start)) {
+      continue;
+    }
+    // Each frame is a method along with the position of the next successor
+    // to explore.
+    std::vector<std::pair<const DexMethod*, size_t>> frames;
+    visit(start);
+    frames.emplace_back(start, 0);
+    while (!frames.empty()) {
+      auto& frame = frames.back();
+      auto method = frame.first;
+      auto& info = infos.at(method);
+      if (frame.second < info.successors.size()) {
+        auto succ = info.successors[frame.second++];
+        auto it = infos.find(succ);
+        if (it == infos.end()) {
+          visit(succ);
+          frames.emplace_back(succ, 0);
+        } else if (it->second.on_stack) {
+          info.lowlink = std::min(info.lowlink, it->second.index);
+        }
+        continue;
+      }
+      frames.pop_back();
+      if (!frames.empty()) {
+        auto& parent_info = infos.at(frames.back().first);
+        parent_info.lowlink = std::min(parent_info.lowlink, info.lowlink);
+      }
+      if (info.lowlink == info.index) {
+        pop_component(method);
+      }
+    }
+  }
+
+  CacheKeys keys;
+  for (auto method : methods) {
+    size_t key = scc_keys.at(method);
+    boost::hash_combine(key, method_hashes.at(method));
+    keys.emplace(method, key);
+  }
+  return keys;
+}
+
+} // namespace summary_serialization
@@ -7,10 +7,16 @@
 
 #pragma once
 
+#include <boost/optional.hpp>
+#include <functional>
 #include <istream>
+#include <map>
 #include <ostream>
+#include <unordered_map>
+#include <vector>
 
 #include "DexClass.h"
+#include "DexHasher.h"
 #include "S_Expression.h"
 #include "Show.h"
 #include "Trace.h"
@@ -18,7 +24,8 @@
 /*
  * This module serves to (de)serialize maps of DexMethods to summary objects
  * of any type, which is useful for the analysis of methods external to the
- * APK.
+ * APK, and to persist the summaries of the methods of the APK between two
+ * builds.
  */
 
 namespace summary_serialization {
@@ -81,4 +88,85 @@ size_t read(std::istream& input,
   return load_count;
 }
 
+/*
+ * A summary of a method computed in a previous build can be reused as long as
+ * the method and all the methods it transitively depends on are unchanged.
+ * Cache keys capture exactly that: the key of a method combines the hashes
+ * (see DexMethodHasher) of all the methods it can reach through
+ * `get_dependencies`. The salt accounts for anything else the summaries
+ * depend on, like the configuration of the analysis.
+ */
+using CacheKeys = std::unordered_map<const DexMethod*, size_t>;
+
+CacheKeys compute_cache_keys(
+    const std::vector<const DexMethod*>& methods,
+    const std::function<std::vector<const DexMethod*>(const DexMethod*)>&
+        get_dependencies,
+    size_t salt = 0);
+
+// Writes the summaries of the methods that have a key, in a deterministic
+// order.
+template <typename V>
+void write_cache(
+    std::ostream& output,
+    const std::unordered_map<const DexMethod*, V>& summaries,
+    const CacheKeys& keys,
+    const std::function<sparta::s_expr(const V&)>& to_s_expr) {
+  std::map<const DexMethodRef*, const V*, dexmethods_comparator> ordered;
+  for (const auto& pair : summaries) {
+    if (keys.count(pair.first)) {
+      ordered.emplace(pair.first, &pair.second);
+    }
+  }
+  for (const auto& pair : ordered) {
+    auto key = keys.at(static_cast<const DexMethod*>(pair.first));
+    output << sparta::s_expr({sparta::s_expr(show(pair.first)),
+                              sparta::s_expr(hashing::hash_to_string(key)),
+                              to_s_expr(*pair.second)})
+           << std::endl;
+  }
+}
+
+// Reads back the summaries of the methods whose key didn't change since they
+// were written. Summaries that `from_s_expr` can't rebuild, e.g. because they
+// refer to a field that no longer exists, are skipped. Returns the number of
+// summaries loaded.
+template <typename V>
+size_t read_cache(
+    std::istream& input,
+    const CacheKeys& keys,
+    const std::function<boost::optional<V>(const sparta::s_expr&)>&
+        from_s_expr,
+    std::unordered_map<const DexMethod*, V>* summaries) {
+  sparta::s_expr_istream s_expr_input(input);
+  size_t load_count{0};
+  while (s_expr_input.good()) {
+    sparta::s_expr expr;
+    s_expr_input >> expr;
+    if (s_expr_input.eoi()) {
+      break;
+    }
+    if (s_expr_input.fail() || !expr.is_list() || expr.size() != 3 ||
+        !expr[0].is_string() || !expr[1].is_string()) {
+      // A stale or corrupted cache only costs us the recomputation.
+      TRACE(LIB, 1, "Ignoring malformed summary cache entry");
+      break;
+    }
+    auto method_ref = DexMethod::get_method(expr[0].get_string());
+    auto method = method_ref == nullptr ? nullptr : method_ref->as_def();
+    auto it = method == nullptr ? keys.end() : keys.find(method);
+    if (it == keys.end() ||
+        hashing::hash_to_string(it->second) != expr[1].get_string()) {
+      continue;
+    }
+    auto summary = from_s_expr(expr[2]);
+    if (!summary) {
+      continue;
+    }
+    summaries->emplace(method, std::move(*summary));
+    ++load_count;
+  }
+  return load_count;
+}
+
 } // namespace summary_serialization
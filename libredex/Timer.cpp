@@ -7,9 +7,95 @@
 
 #include "Timer.h"
 
+#include <cstdio>
+#include <ostream>
+
 #include "Trace.h"
 
-unsigned Timer::s_indent = 0;
+std::atomic<bool> TraceEvents::s_enabled{false};
+std::mutex TraceEvents::s_lock;
+std::vector<TraceEvents::Span> TraceEvents::s_spans;
+TraceEvents::clock::time_point TraceEvents::s_origin;
+
+void TraceEvents::enable() {
+  std::lock_guard<std::mutex> guard(s_lock);
+  if (!s_enabled) {
+    s_origin = clock::now();
+    s_enabled = true;
+  }
+}
+
+void TraceEvents::add_span(std::string name,
+                           uint32_t thread,
+                           clock::time_point start,
+                           clock::time_point end,
+                           args_t args) {
+  if (!is_enabled()) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(s_lock);
+  s_spans.push_back(
+      Span{std::move(name), thread, start, end, std::move(args)});
+}
+
+uint32_t TraceEvents::thread_index() {
+  static std::atomic<uint32_t> s_next_index{0};
+  thread_local uint32_t index = s_next_index++;
+  return index;
+}
+
+namespace {
+
+void write_json_string(std::ostream& out, const std::string& str) {
+  out << '"';
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", c);
+      out << buf;
+    } else {
+      out << c;
+    }
+  }
+  out << '"';
+}
+
+} // namespace
+
+void TraceEvents::write(std::ostream& out) {
+  std::lock_guard<std::mutex> guard(s_lock);
+  auto micros = [](clock::duration d) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+  };
+  out << "{\"traceEvents\":[";
+  bool first = true;
+  for (const auto& span : s_spans) {
+    out << (first ? "\n" : ",\n");
+    first = false;
+    out << "{\"name\":";
+    write_json_string(out, span.name);
+    out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << span.thread
+        << ",\"ts\":" << micros(span.start - s_origin)
+        << ",\"dur\":" << micros(span.end - span.start);
+    if (!span.args.empty()) {
+      out << ",\"args\":{";
+      for (size_t i = 0; i < span.args.size(); ++i) {
+        if (i > 0) {
+          out << ",";
+        }
+        write_json_string(out, span.args[i].first);
+        out << ":" << span.args[i].second;
+      }
+      out << "}";
+    }
+    out << "}";
+  }
+  out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+std::atomic<unsigned> Timer::s_indent{0};
 std::mutex Timer::s_lock;
 Timer::times_t Timer::s_times;
 
@@ -24,6 +110,9 @@ Timer::~Timer() {
   auto duration_s = std::chrono::duration<double>(end - m_start).count();
   TRACE(TIME, 1, "%*s%s completed in %.1lf seconds", 4 * s_indent, "",
         m_msg.c_str(), duration_s);
+  if (TraceEvents::is_enabled()) {
+    TraceEvents::add_span(m_msg, m_start, end);
+  }
 
   Timer::add_timer(std::move(m_msg), duration_s);
 }
@@ -9,11 +9,62 @@
 
 #include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <iosfwd>
 #include <mutex>
 #include <string>
 #include <utility>
 #include <vector>
 
+/*
+ * Records the spans of Timers, and of other scopes that report them, along
+ * with their thread and start time, to export them as a timeline in the
+ * Chrome trace event format, which Perfetto reads too. Nesting follows from
+ * the times of the spans of each thread. Recording is off unless enabled.
+ */
+class TraceEvents {
+ public:
+  using clock = std::chrono::high_resolution_clock;
+  using args_t = std::vector<std::pair<std::string, uint64_t>>;
+
+  static void enable();
+  static bool is_enabled() {
+    return s_enabled.load(std::memory_order_relaxed);
+  }
+
+  // Record a span of the current thread, if enabled.
+  static void add_span(std::string name,
+                       clock::time_point start,
+                       clock::time_point end,
+                       args_t args = {}) {
+    add_span(std::move(name), thread_index(), start, end, std::move(args));
+  }
+  static void add_span(std::string name,
+                       uint32_t thread,
+                       clock::time_point start,
+                       clock::time_point end,
+                       args_t args = {});
+
+  // Small thread numbers, in the order in which threads first ask for one.
+  static uint32_t thread_index();
+
+  static void write(std::ostream& out);
+
+ private:
+  struct Span {
+    std::string name;
+    uint32_t thread;
+    clock::time_point start;
+    clock::time_point end;
+    args_t args;
+  };
+
+  static std::atomic<bool> s_enabled;
+  static std::mutex s_lock;
+  static std::vector<Span> s_spans;
+  static clock::time_point s_origin;
+};
+
 struct Timer {
   explicit Timer(const std::string& msg);
   ~Timer();
@@ -27,7 +78,7 @@ struct Timer {
  private:
   static std::mutex s_lock;
   static times_t s_times;
-  static unsigned s_indent;
+  static std::atomic<unsigned> s_indent;
   std::string m_msg;
   std::chrono::high_resolution_clock::time_point m_start;
 };
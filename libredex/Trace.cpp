@@ -8,6 +8,7 @@
 #include "Trace.h"
 
 #include <array>
+#include <atomic>
 #include <cstdarg>
 #include <cstdio>
 #include <cstdlib>
@@ -17,6 +18,7 @@
 #include <mutex>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 
 #include "Debug.h"
@@ -31,11 +33,24 @@ struct TraceContextAccess {
 
 namespace {
 
+// Cleared when the tracer is destroyed, after which buffers of threads that
+// are still running can no longer be flushed.
+std::atomic<bool> s_tracer_alive{false};
+
+// The output of one thread that has not been written yet.
+struct ThreadBuffer {
+  std::string data;
+  ~ThreadBuffer();
+};
+
 struct Tracer {
 
   bool m_show_timestamps{false};
   bool m_show_tracemodule{false};
+  bool m_show_tracecontext{false};
   const char* m_method_filter;
+  // Zero to write every line as it is traced.
+  size_t m_buffer_size{0};
   std::unordered_map<int /*TraceModule*/, std::string> m_module_id_name_map;
 
   Tracer() {
@@ -43,7 +58,10 @@ struct Tracer {
     const char* envfile = getenv("TRACEFILE");
     const char* show_timestamps = getenv("SHOW_TIMESTAMPS");
     const char* show_tracemodule = getenv("SHOW_TRACEMODULE");
+    const char* show_tracecontext = getenv("SHOW_TRACECONTEXT");
+    const char* buffer_size = getenv("TRACE_BUFFER_SIZE");
     m_method_filter = getenv("TRACE_METHOD_FILTER");
+    s_tracer_alive = true;
     if (!traceenv) {
       init_trace_file(nullptr);
       return;
@@ -58,9 +76,14 @@ struct Tracer {
     std::cerr << "SHOW_TRACEMODULE="
               << (show_tracemodule == nullptr ? "" : show_tracemodule)
               << std::endl;
+    std::cerr << "SHOW_TRACECONTEXT="
+              << (show_tracecontext == nullptr ? "" : show_tracecontext)
+              << std::endl;
     std::cerr << "TRACE_METHOD_FILTER="
               << (m_method_filter == nullptr ? "" : m_method_filter)
               << std::endl;
+    std::cerr << "TRACE_BUFFER_SIZE="
+              << (buffer_size == nullptr ? "" : buffer_size) << std::endl;
 
     init_trace_modules(traceenv);
     init_trace_file(envfile);
@@ -71,6 +94,12 @@ struct Tracer {
     if (show_tracemodule) {
       m_show_tracemodule = true;
     }
+    if (show_tracecontext) {
+      m_show_tracecontext = true;
+    }
+    if (buffer_size) {
+      m_buffer_size = strtoul(buffer_size, nullptr, 10);
+    }
 
 #define TM(x) m_module_id_name_map[static_cast<int>(x)] = #x;
     TMS
@@ -78,6 +107,14 @@ struct Tracer {
   }
 
   ~Tracer() {
+    {
+      std::lock_guard<std::mutex> guard(m_trace_mutex);
+      s_tracer_alive = false;
+      for (auto* buffer : m_buffers) {
+        write(buffer->data);
+      }
+      m_buffers.clear();
+    }
     if (m_file != nullptr && m_file != stderr) {
       fclose(m_file);
     }
@@ -114,7 +151,11 @@ struct Tracer {
              va_list ap) {
     // Assume that `trace` is never called without `traceEnabled`, so we
     // do not need to check anything (including context) here.
-    std::lock_guard<std::mutex> guard(m_trace_mutex);
+    //
+    // Lines are formatted outside of the lock. Unless buffering is on, they
+    // are written right away, so that nothing is lost when the process
+    // crashes.
+    auto& buffer = thread_buffer();
     if (m_show_timestamps) {
       auto t = std::time(nullptr);
       struct tm local_tm;
@@ -125,22 +166,86 @@ struct Tracer {
 #endif
       std::array<char, 40> buf;
       std::strftime(buf.data(), sizeof(buf), "%c", &local_tm);
-      fprintf(m_file, "[%s]", buf.data());
+      buffer.data.append("[").append(buf.data()).append("]");
       if (!m_show_tracemodule) {
-        fprintf(m_file, " ");
+        buffer.data.append(" ");
       }
     }
     if (m_show_tracemodule) {
-      fprintf(m_file, "[%s:%d] ", m_module_id_name_map[module].c_str(), level);
+      buffer.data.append("[")
+          .append(m_module_id_name_map.at(module))
+          .append(":")
+          .append(std::to_string(level))
+          .append("] ");
+    }
+#if !IS_WINDOWS
+    if (m_show_tracecontext) {
+      const TraceContext* context = TraceContextAccess::get_s_context();
+      if (context != nullptr) {
+        buffer.data.append("[")
+            .append(context->get_string_value())
+            .append("] ");
+      }
     }
-    vfprintf(m_file, fmt, ap);
+#endif
+    append_vformat(buffer.data, fmt, ap);
     if (!suppress_newline) {
-      fprintf(m_file, "\n");
+      buffer.data.append("\n");
+    }
+    if (buffer.data.size() >= m_buffer_size) {
+      std::lock_guard<std::mutex> guard(m_trace_mutex);
+      write(buffer.data);
     }
-    fflush(m_file);
+  }
+
+  void release(ThreadBuffer* buffer) {
+    std::lock_guard<std::mutex> guard(m_trace_mutex);
+    write(buffer->data);
+    m_buffers.erase(buffer);
   }
 
  private:
+  ThreadBuffer& thread_buffer() {
+    thread_local ThreadBuffer buffer;
+    thread_local bool registered = false;
+    if (!registered) {
+      registered = true;
+      buffer.data.reserve(m_buffer_size);
+      std::lock_guard<std::mutex> guard(m_trace_mutex);
+      m_buffers.insert(&buffer);
+    }
+    return buffer;
+  }
+
+  static void append_vformat(std::string& out, const char* fmt, va_list ap) {
+    std::array<char, 256> small;
+    va_list ap_copy;
+    va_copy(ap_copy, ap);
+    int size = vsnprintf(small.data(), small.size(), fmt, ap_copy);
+    va_end(ap_copy);
+    if (size < 0) {
+      return;
+    }
+    if (static_cast<size_t>(size) < small.size()) {
+      out.append(small.data(), size);
+      return;
+    }
+    auto offset = out.size();
+    out.resize(offset + size + 1);
+    vsnprintf(&out[offset], size + 1, fmt, ap);
+    out.resize(offset + size);
+  }
+
+  // Requires m_trace_mutex.
+  void write(std::string& data) {
+    if (data.empty()) {
+      return;
+    }
+    fwrite(data.data(), 1, data.size(), m_file);
+    fflush(m_file);
+    data.clear();
+  }
+
   void init_trace_modules(const char* traceenv) {
     std::unordered_map<std::string, int> module_id_map{{
 #define TM(x) {std::string(#x), x},
@@ -202,9 +307,19 @@ struct Tracer {
   std::array<long, N_TRACE_MODULES> m_traces;
 
   std::mutex m_trace_mutex;
+  // The buffers of the threads that have traced something, so that what they
+  // hold at exit gets written.
+  std::unordered_set<ThreadBuffer*> m_buffers;
 };
 
 static Tracer tracer;
+
+ThreadBuffer::~ThreadBuffer() {
+  if (s_tracer_alive) {
+    tracer.release(this);
+  }
+}
+
 } // namespace
 
 #ifndef NDEBUG
@@ -236,5 +351,15 @@ const std::string& TraceContext::get_string_value() const {
   return *string_value;
 }
 
+const DexMethodRef* TraceContext::current_method() {
+  for (auto context = s_context; context != nullptr;
+       context = context->last_context) {
+    if (context->method != nullptr) {
+      return context->method;
+    }
+  }
+  return nullptr;
+}
+
 thread_local const TraceContext* TraceContext::s_context = nullptr;
 #endif
@@ -222,6 +222,10 @@ class TraceContext {
 
 #if !IS_WINDOWS
   const std::string& get_string_value() const;
+
+  // The method of the innermost context of this thread that has one, or
+  // nullptr. Only reads pointers, so that it can be used in signal handlers.
+  static const DexMethodRef* current_method();
 #endif
 
  private:
@@ -194,6 +194,13 @@ class TypeInference final
         m_cfg(cfg),
         m_skip_check_cast_to_intf(skip_check_cast_to_intf) {}
 
+  TypeInference(const cfg::ControlFlowGraph& cfg,
+                std::shared_ptr<const ir_analyzer::WeakPartialOrdering> ordering,
+                bool skip_check_cast_to_intf = false)
+      : ir_analyzer::BaseIRAnalyzer<TypeEnvironment>(cfg, std::move(ordering)),
+        m_cfg(cfg),
+        m_skip_check_cast_to_intf(skip_check_cast_to_intf) {}
+
   void run(const DexMethod* dex_method);
 
   void run(bool is_static, DexType* declaring_type, DexTypeList* args);
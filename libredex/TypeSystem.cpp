@@ -71,7 +71,9 @@ void load_interface_children(const Scope& scope, ClassHierarchy& children) {
 const TypeSet TypeSystem::empty_set = TypeSet();
 const TypeVector TypeSystem::empty_vec = TypeVector();
 
-TypeSystem::TypeSystem(const Scope& scope) : m_class_scopes(scope) {
+TypeSystem::TypeSystem(const Scope& scope)
+    : m_class_scopes(scope),
+      m_subtypes(scope, m_class_scopes.get_class_hierarchy()) {
   load_interface_children(scope, m_intf_children);
   make_instanceof_interfaces_table();
 }
@@ -9,6 +9,7 @@
 
 #include "ClassHierarchy.h"
 #include "DexClass.h"
+#include "SubtypeIndex.h"
 #include "VirtualScope.h"
 
 #include <unordered_map>
@@ -35,6 +36,7 @@ class TypeSystem {
   static const TypeVector empty_vec;
 
   ClassScopes m_class_scopes;
+  SubtypeIndex m_subtypes;
   ClassHierarchy m_intf_children;
   InstanceOfTable m_instanceof_table;
   TypeToTypeSet m_interfaces;
@@ -58,8 +60,7 @@ class TypeSystem {
    * The type must be a class (not an interface).
    */
   void get_all_children(const DexType* type, TypeSet& children) const {
-    return ::get_all_children(
-        m_class_scopes.get_class_hierarchy(), type, children);
+    m_subtypes.get_all_children(type, children);
   }
 
   /**
@@ -106,16 +107,7 @@ class TypeSystem {
    * The type must be a class (not an interface).
    */
   bool is_subtype(const DexType* parent, const DexType* child) const {
-    const auto& parent_it = m_instanceof_table.find(parent);
-    const auto& child_it = m_instanceof_table.find(child);
-    if (parent_it == m_instanceof_table.end() ||
-        child_it == m_instanceof_table.end()) {
-      return false;
-    }
-    const auto& p_chain = parent_it->second;
-    const auto& c_chain = child_it->second;
-    if (p_chain.size() > c_chain.size()) return false;
-    return c_chain.at(p_chain.size() - 1) == parent;
+    return m_subtypes.is_subclass(parent, child);
   }
 
   /**
@@ -183,6 +175,11 @@ class TypeSystem {
    */
   const ClassScopes& get_class_scopes() const { return m_class_scopes; }
 
+  /**
+   * Return the constant time subtyping index of the scope.
+   */
+  const SubtypeIndex& get_subtype_index() const { return m_subtypes; }
+
   /**
    * Given a DexMethod return the scope the method is in.
    */
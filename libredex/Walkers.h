@@ -140,7 +140,8 @@ class walk {
 
   // Call `walker` on every annotation on the classes (and its fields, methods,
   // and method parameters) defined in `classes`
-  //   WalkerFn should accept a `DexAnnotation*`.
+  //   WalkerFn should accept a `DexAnnotation*`, or a `DexAnnotation*&` to
+  //   replace the annotation, e.g. with DexAnnotation::unshare.
   template <class Classes, typename WalkerFn>
   static void annotations(const Classes& classes, const WalkerFn& walker) {
     for (auto& cls : classes) {
@@ -463,7 +464,8 @@ class walk {
       std::vector<CacheAligned<Accumulator>> acc_vec(num_threads, init);
 
       workqueue_run<DexClass*>(
-          [&](sparta::SpartaWorkerState<DexClass*>* state, DexClass* cls) {
+          [&](sparta::SpartaWorkerState<DexClass*>* state,
+              const DexClass* cls) {
             Accumulator& acc = acc_vec[state->worker_id()];
             for (auto dmethod : cls->get_dmethods()) {
               TraceContext context(dmethod);
@@ -553,6 +555,48 @@ class walk {
       walk::parallel::code(classes, all_methods, walker, num_threads);
     }
 
+    // Like `code()`, but the unit of parallelization is a chunk of methods
+    // rather than a class.
+    //
+    // Methods are seeded by estimated cost (`IRCode::sum_opcode_sizes`),
+    // largest first, so that a few huge methods don't become the tail latency
+    // of the walk. Runs of small methods are batched into chunks of roughly
+    // equal cost, to amortize the per-task overhead.
+    //   FilterFn should accept a `DexMethod*` and return a bool.
+    //   WalkerFn should accept `(DexMethod*, IRCode&)`.
+    template <class Classes, typename FilterFn, typename WalkerFn>
+    static void code_by_size(
+        const Classes& classes,
+        const FilterFn& filter,
+        const WalkerFn& walker,
+        size_t num_threads = redex_parallel::default_num_threads()) {
+      std::vector<SizedMethod> methods;
+      walk::code(classes, filter, [&methods](DexMethod* m, IRCode& code) {
+        methods.push_back({m, code.sum_opcode_sizes() + 1});
+      });
+      auto chunks = make_size_chunks(methods, num_threads);
+      workqueue_run<std::pair<size_t, size_t>>(
+          [&methods, &walker](const std::pair<size_t, size_t>& chunk) {
+            for (size_t i = chunk.first; i < chunk.second; ++i) {
+              auto* m = methods[i].method;
+              TraceContext context(m);
+              walker(m, *m->get_code());
+            }
+          },
+          chunks,
+          num_threads);
+    }
+
+    // Same as `code_by_size()` but with a filter function that accepts all
+    // methods
+    template <class Classes, typename WalkerFn>
+    static void code_by_size(
+        const Classes& classes,
+        const WalkerFn& walker,
+        size_t num_threads = redex_parallel::default_num_threads()) {
+      walk::parallel::code_by_size(classes, all_methods, walker, num_threads);
+    }
+
     // Call `walker` on all opcodes (of methods approved by `filter`) in
     // `classes` in parallel.
     //   FilterFn should accept a `DexMethod*` and return a bool.
@@ -581,7 +625,8 @@ class walk {
     }
 
     // Call `walker` on all annotations in `classes` in parallel.
-    //   WalkerFn should accept a `DexAnnotation*`.
+    //   WalkerFn should accept a `DexAnnotation*`, or a `DexAnnotation*&` to
+    //   replace the annotation, e.g. with DexAnnotation::unshare.
     template <class Classes, typename WalkerFn>
     static void annotations(
         const Classes& classes,
@@ -637,6 +682,47 @@ class walk {
           num_threads);
     }
 
+    struct SizedMethod {
+      DexMethod* method;
+      size_t cost;
+    };
+
+    // Sorts `methods` by descending cost and partitions them into
+    // consecutive [begin, end) index ranges. Every method whose cost reaches
+    // the target chunk cost gets a chunk of its own; cheaper methods are
+    // grouped until their combined cost reaches it.
+    static std::vector<std::pair<size_t, size_t>> make_size_chunks(
+        std::vector<SizedMethod>& methods, size_t num_threads) {
+      // Enough chunks per thread that work stealing can even out imprecise
+      // cost estimates.
+      constexpr size_t kChunksPerThread = 16;
+      std::stable_sort(methods.begin(), methods.end(),
+                       [](const SizedMethod& a, const SizedMethod& b) {
+                         return a.cost > b.cost;
+                       });
+      size_t total_cost = 0;
+      for (const auto& sm : methods) {
+        total_cost += sm.cost;
+      }
+      size_t target_cost = std::max<size_t>(
+          1, total_cost / (std::max<size_t>(1, num_threads) * kChunksPerThread));
+      std::vector<std::pair<size_t, size_t>> chunks;
+      size_t begin = 0;
+      size_t chunk_cost = 0;
+      for (size_t i = 0; i < methods.size(); ++i) {
+        chunk_cost += methods[i].cost;
+        if (chunk_cost >= target_cost) {
+          chunks.emplace_back(begin, i + 1);
+          begin = i + 1;
+          chunk_cost = 0;
+        }
+      }
+      if (begin < methods.size()) {
+        chunks.emplace_back(begin, methods.size());
+      }
+      return chunks;
+    }
+
     // Call `walker` on all given virtual scopes in parallel.
     //   WalkerFn should `const VirtualScope*`.
     template <class VirtualScopes, typename WalkerFn>
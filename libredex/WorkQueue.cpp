@@ -7,14 +7,245 @@
 
 #include "WorkQueue.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <mutex>
 
 #include "Debug.h"
+#include "JemallocUtil.h"
+#include "Macros.h"
+
+#if !IS_WINDOWS
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+struct RunStatsState {
+  std::mutex mutex;
+  size_t depth{0};
+  std::chrono::steady_clock::time_point start_wall;
+  std::clock_t start_cpu{0};
+  unsigned int num_threads{0};
+  redex_parallel::WorkQueueStats totals;
+};
+
+RunStatsState& run_stats_state() {
+  static RunStatsState state;
+  return state;
+}
+
+#if defined(__linux__)
+// Where the threads of the default pool run on a machine with several NUMA
+// nodes.
+struct NumaPlacement {
+  // The node of each thread, as an index into node_cpus.
+  std::vector<unsigned int> thread_nodes;
+  std::vector<std::vector<unsigned int>> node_cpus;
+};
+
+// Parses a sysfs CPU list, e.g. "0-23,48-71".
+std::vector<unsigned int> parse_cpu_list(const std::string& list) {
+  std::vector<unsigned int> cpus;
+  size_t pos = 0;
+  while (pos < list.size()) {
+    auto end = list.find(',', pos);
+    if (end == std::string::npos) {
+      end = list.size();
+    }
+    auto range = list.substr(pos, end - pos);
+    pos = end + 1;
+    if (range.empty()) {
+      continue;
+    }
+    auto dash = range.find('-');
+    unsigned int first = std::stoul(range.substr(0, dash));
+    unsigned int last =
+        dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+    for (auto cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+/*
+ * Spreads the threads over the NUMA nodes in proportion to the CPUs the
+ * process may use on each of them, keeping consecutive threads on the same
+ * node. Returns none when those CPUs are all on one node, or when placement
+ * is disabled through REDEX_NO_NUMA_PLACEMENT.
+ */
+boost::optional<NumaPlacement> get_numa_placement(size_t num_threads) {
+  if (getenv("REDEX_NO_NUMA_PLACEMENT") != nullptr) {
+    return boost::none;
+  }
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    return boost::none;
+  }
+  std::map<unsigned int, std::vector<unsigned int>> cpus_by_node;
+  for (unsigned int node = 0;; ++node) {
+    std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) +
+                     "/cpulist");
+    if (!in) {
+      break;
+    }
+    std::string list;
+    std::getline(in, list);
+    for (auto cpu : parse_cpu_list(list)) {
+      if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+        cpus_by_node[node].push_back(cpu);
+      }
+    }
+  }
+  if (cpus_by_node.size() <= 1) {
+    return boost::none;
+  }
+
+  NumaPlacement placement;
+  std::vector<unsigned int> cpu_nodes;
+  for (auto& [node, cpus] : cpus_by_node) {
+    cpu_nodes.insert(cpu_nodes.end(), cpus.size(), placement.node_cpus.size());
+    placement.node_cpus.push_back(std::move(cpus));
+  }
+  placement.thread_nodes.reserve(num_threads);
+  for (size_t i = 0; i < num_threads; ++i) {
+    placement.thread_nodes.push_back(
+        cpu_nodes[i * cpu_nodes.size() / num_threads]);
+  }
+  return placement;
+}
+
+// Restricts the calling thread to the CPUs of its node, and makes it allocate
+// from an arena of that node, so that the data it creates stays local.
+void place_thread(const std::vector<unsigned int>& cpus, unsigned int node) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (auto cpu : cpus) {
+    CPU_SET(cpu, &set);
+  }
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  jemalloc_util::use_node_arena(node);
+}
+#endif
+
+sparta::ThreadPool* make_thread_pool(size_t num_threads) {
+#if defined(__linux__)
+  if (auto placement = get_numa_placement(num_threads)) {
+    auto thread_nodes = placement->thread_nodes;
+    return new sparta::ThreadPool(
+        num_threads, std::move(thread_nodes),
+        [placement = std::move(*placement)](size_t idx) {
+          auto node = placement.thread_nodes[idx];
+          place_thread(placement.node_cpus[node], node);
+        });
+  }
+#endif
+  return new sparta::ThreadPool(num_threads);
+}
+
+} // namespace
 
 namespace redex_workqueue_impl {
 
+ScopedRunStats::ScopedRunStats(unsigned int num_threads) {
+  auto& state = run_stats_state();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  if (state.depth++ == 0) {
+    state.start_wall = std::chrono::steady_clock::now();
+    state.start_cpu = std::clock();
+    state.num_threads = num_threads;
+  }
+}
+
+ScopedRunStats::~ScopedRunStats() {
+  auto& state = run_stats_state();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  if (--state.depth == 0) {
+    uint64_t wall_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                           std::chrono::steady_clock::now() - state.start_wall)
+                           .count();
+    auto& totals = state.totals;
+    totals.runs++;
+    totals.wall_us += wall_us;
+    totals.capacity_us += wall_us * state.num_threads;
+    totals.cpu_us +=
+        (uint64_t)(std::clock() - state.start_cpu) * 1000000 / CLOCKS_PER_SEC;
+  }
+}
+
 void redex_queue_exception_handler(std::exception& e) {
   print_stack_trace(std::cerr, e);
 }
 
+void WorkerTimes::record(TraceEvents::clock::time_point start,
+                         TraceEvents::clock::time_point end) const {
+  auto micros = [](TraceEvents::clock::duration d) -> uint64_t {
+    return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+  };
+  size_t items = 0;
+  for (const auto& worker : workers) {
+    items += worker.items;
+    if (worker.items == 0) {
+      continue;
+    }
+    auto busy = std::min(worker.busy, end - start);
+    TraceEvents::add_span("workqueue worker",
+                          worker.thread,
+                          start,
+                          end,
+                          {{"items", worker.items},
+                           {"busy_us", micros(busy)},
+                           {"idle_us", micros(end - start - busy)}});
+  }
+  TraceEvents::add_span("workqueue_run", start, end,
+                        {{"items", items}, {"threads", workers.size()}});
+}
+
 } // namespace redex_workqueue_impl
+
+namespace redex_parallel {
+
+namespace detail {
+std::atomic<size_t> s_num_threads_override{0};
+} // namespace detail
+
+WorkQueueStats get_work_queue_stats() {
+  auto& state = run_stats_state();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  return state.totals;
+}
+
+sparta::ThreadPool* default_thread_pool() {
+  // Intentionally leaked: worker threads must never observe a destroyed pool
+  // during static destruction at exit.
+  static std::mutex mutex;
+  static sparta::ThreadPool* pool = nullptr;
+  std::lock_guard<std::mutex> lock(mutex);
+#if !IS_WINDOWS
+  // A forked child (see the redex-all daemon mode) inherits the pool object
+  // but none of its threads, so it needs a pool of its own.
+  static pid_t pool_pid = 0;
+  if (pool != nullptr && pool_pid != getpid()) {
+    pool = nullptr;
+  }
+  pool_pid = getpid();
+#endif
+  if (pool == nullptr) {
+    pool = make_thread_pool(default_num_threads());
+  }
+  return pool;
+}
+
+} // namespace redex_parallel
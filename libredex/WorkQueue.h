@@ -7,52 +7,185 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <boost/thread/thread.hpp>
 #include <exception>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <vector>
 
 #include "SpartaWorkQueue.h"
+#include "Timer.h"
 
 namespace redex_workqueue_impl {
 
 void redex_queue_exception_handler(std::exception& e);
 
+// The busy time of each worker of a work queue run, kept when trace events
+// are enabled. Each worker only touches its own slot.
+struct WorkerTimes {
+  struct Worker {
+    uint32_t thread{0};
+    size_t items{0};
+    TraceEvents::clock::duration busy{0};
+  };
+
+  explicit WorkerTimes(size_t num_threads) : workers(num_threads) {}
+
+  void add(size_t worker_id,
+           TraceEvents::clock::time_point start,
+           TraceEvents::clock::time_point end) {
+    auto& worker = workers[worker_id];
+    if (worker.items++ == 0) {
+      worker.thread = TraceEvents::thread_index();
+    }
+    worker.busy += end - start;
+  }
+
+  // Record a span for the run, and one per worker with its busy and idle
+  // time.
+  void record(TraceEvents::clock::time_point start,
+              TraceEvents::clock::time_point end) const;
+
+  std::vector<Worker> workers;
+};
+
 // Helper classes so the type of Executor can be inferred
 template <typename Input, typename Fn>
 struct NoStateWorkQueueHelper {
   Fn fn;
-  void operator()(sparta::SpartaWorkerState<Input>*, Input a) {
+  WorkerTimes* times{nullptr};
+  void operator()(sparta::SpartaWorkerState<Input>* state, Input a) {
+    auto start = times ? TraceEvents::clock::now()
+                       : TraceEvents::clock::time_point();
     try {
       fn(a);
     } catch (std::exception& e) {
       redex_queue_exception_handler(e);
       throw;
     }
+    if (times) {
+      times->add(state->worker_id(), start, TraceEvents::clock::now());
+    }
   }
 };
 
 template <typename Input, typename Fn>
 struct WithStateWorkQueueHelper {
   Fn fn;
+  WorkerTimes* times{nullptr};
   void operator()(sparta::SpartaWorkerState<Input>* state, Input a) {
+    auto start = times ? TraceEvents::clock::now()
+                       : TraceEvents::clock::time_point();
     try {
       fn(state, a);
     } catch (std::exception& e) {
       redex_queue_exception_handler(e);
       throw;
     }
+    if (times) {
+      times->add(state->worker_id(), start, TraceEvents::clock::now());
+    }
   }
 };
 
 } // namespace redex_workqueue_impl
 
 namespace redex_parallel {
+namespace detail {
+extern std::atomic<size_t> s_num_threads_override;
+} // namespace detail
+
 inline size_t default_num_threads() {
+  auto num_threads =
+      detail::s_num_threads_override.load(std::memory_order_relaxed);
+  if (num_threads != 0) {
+    return num_threads;
+  }
   // We prefer boost over std. Use hardware over physical concurrency
   // to take advantage of SMT.
   return std::max(1u, boost::thread::hardware_concurrency());
 }
+
+/**
+ * Overrides the result of `default_num_threads()`, e.g. for passes that don't
+ * scale. Zero goes back to the hardware concurrency. The default thread pool
+ * keeps the size it was created with, so raising the count above it only
+ * takes effect in a forked child.
+ */
+inline void set_default_num_threads(size_t num_threads) {
+  detail::s_num_threads_override.store(num_threads, std::memory_order_relaxed);
+}
+
+// Totals over the work queue runs so far. Runs started while another one is
+// running only count as part of the outer one.
+struct WorkQueueStats {
+  uint64_t runs{0};
+  uint64_t wall_us{0};
+  // The wall time of each run times its number of threads.
+  uint64_t capacity_us{0};
+  // The process CPU time while runs were going on.
+  uint64_t cpu_us{0};
+};
+WorkQueueStats get_work_queue_stats();
+
+/**
+ * The process-wide pool of worker threads, sized by `default_num_threads()`,
+ * that all work queues created through `workqueue_foreach`/`workqueue_run`
+ * reuse instead of spawning fresh threads on every `run_all()`.
+ *
+ * On machines with several NUMA nodes, each thread of the pool stays on the
+ * CPUs of one node and allocates from a jemalloc arena of that node, and work
+ * queues steal from the threads of the same node first. Setting
+ * REDEX_NO_NUMA_PLACEMENT leaves the threads unplaced.
+ */
+sparta::ThreadPool* default_thread_pool();
 } // namespace redex_parallel
 
+namespace redex_workqueue_impl {
+
+// Adds the run to redex_parallel::get_work_queue_stats().
+class ScopedRunStats {
+ public:
+  explicit ScopedRunStats(unsigned int num_threads);
+  ~ScopedRunStats();
+
+  ScopedRunStats(const ScopedRunStats&) = delete;
+  ScopedRunStats& operator=(const ScopedRunStats&) = delete;
+};
+
+template <class Input, typename Helper, typename Items>
+void run_items(Helper helper,
+               Items& items,
+               unsigned int num_threads,
+               bool push_tasks_while_running) {
+  std::unique_ptr<WorkerTimes> times;
+  if (TraceEvents::is_enabled()) {
+    times = std::make_unique<WorkerTimes>(num_threads);
+    helper.times = times.get();
+  }
+  auto wq = sparta::SpartaWorkQueue<Input, Helper>(
+      std::move(helper),
+      num_threads,
+      push_tasks_while_running,
+      redex_parallel::default_thread_pool());
+  for (auto& item : items) {
+    wq.add_item(item);
+  }
+  auto start = TraceEvents::clock::now();
+  {
+    ScopedRunStats run_stats(num_threads);
+    wq.run_all();
+  }
+  if (times) {
+    times->record(start, TraceEvents::clock::now());
+  }
+}
+
+} // namespace redex_workqueue_impl
+
 // These functions are the most convenient way to create a SpartaWorkQueue
 template <class Input,
           typename Fn,
@@ -62,13 +195,16 @@ sparta::SpartaWorkQueue<Input,
 workqueue_foreach(
     const Fn& fn,
     unsigned int num_threads = redex_parallel::default_num_threads(),
-    bool push_tasks_while_running = false) {
+    bool push_tasks_while_running = false,
+    bool lock_free_queues = false) {
   return sparta::SpartaWorkQueue<
       Input,
       redex_workqueue_impl::NoStateWorkQueueHelper<Input, Fn>>(
       redex_workqueue_impl::NoStateWorkQueueHelper<Input, Fn>{fn},
       num_threads,
-      push_tasks_while_running);
+      push_tasks_while_running,
+      redex_parallel::default_thread_pool(),
+      lock_free_queues);
 }
 template <class Input,
           typename Fn,
@@ -79,13 +215,16 @@ sparta::SpartaWorkQueue<
 workqueue_foreach(
     const Fn& fn,
     unsigned int num_threads = redex_parallel::default_num_threads(),
-    bool push_tasks_while_running = false) {
+    bool push_tasks_while_running = false,
+    bool lock_free_queues = false) {
   return sparta::SpartaWorkQueue<
       Input,
       redex_workqueue_impl::WithStateWorkQueueHelper<Input, Fn>>(
       redex_workqueue_impl::WithStateWorkQueueHelper<Input, Fn>{fn},
       num_threads,
-      push_tasks_while_running);
+      push_tasks_while_running,
+      redex_parallel::default_thread_pool(),
+      lock_free_queues);
 }
 
 template <class Input,
@@ -97,16 +236,9 @@ void workqueue_run(
     Items& items,
     unsigned int num_threads = redex_parallel::default_num_threads(),
     bool push_tasks_while_running = false) {
-  auto wq = sparta::SpartaWorkQueue<
-      Input,
-      redex_workqueue_impl::NoStateWorkQueueHelper<Input, Fn>>(
-      redex_workqueue_impl::NoStateWorkQueueHelper<Input, Fn>{fn},
-      num_threads,
-      push_tasks_while_running);
-  for (auto& item : items) {
-    wq.add_item(item);
-  }
-  wq.run_all();
+  redex_workqueue_impl::run_items<Input>(
+      redex_workqueue_impl::NoStateWorkQueueHelper<Input, Fn>{fn}, items,
+      num_threads, push_tasks_while_running);
 }
 template <class Input,
           typename Fn,
@@ -117,16 +249,9 @@ void workqueue_run(
     const Items& items,
     unsigned int num_threads = redex_parallel::default_num_threads(),
     bool push_tasks_while_running = false) {
-  auto wq = sparta::SpartaWorkQueue<
-      Input,
-      redex_workqueue_impl::NoStateWorkQueueHelper<Input, Fn>>(
-      redex_workqueue_impl::NoStateWorkQueueHelper<Input, Fn>{fn},
-      num_threads,
-      push_tasks_while_running);
-  for (auto& item : items) {
-    wq.add_item(item);
-  }
-  wq.run_all();
+  redex_workqueue_impl::run_items<Input>(
+      redex_workqueue_impl::NoStateWorkQueueHelper<Input, Fn>{fn}, items,
+      num_threads, push_tasks_while_running);
 }
 template <class Input,
           typename Fn,
@@ -137,16 +262,9 @@ void workqueue_run(
     Items& items,
     unsigned int num_threads = redex_parallel::default_num_threads(),
     bool push_tasks_while_running = false) {
-  auto wq = sparta::SpartaWorkQueue<
-      Input,
-      redex_workqueue_impl::WithStateWorkQueueHelper<Input, Fn>>(
-      redex_workqueue_impl::WithStateWorkQueueHelper<Input, Fn>{fn},
-      num_threads,
-      push_tasks_while_running);
-  for (auto& item : items) {
-    wq.add_item(item);
-  }
-  wq.run_all();
+  redex_workqueue_impl::run_items<Input>(
+      redex_workqueue_impl::WithStateWorkQueueHelper<Input, Fn>{fn}, items,
+      num_threads, push_tasks_while_running);
 }
 template <class Input,
           typename Fn,
@@ -157,14 +275,66 @@ void workqueue_run(
     const Items& items,
     unsigned int num_threads = redex_parallel::default_num_threads(),
     bool push_tasks_while_running = false) {
-  auto wq = sparta::SpartaWorkQueue<
-      Input,
-      redex_workqueue_impl::WithStateWorkQueueHelper<Input, Fn>>(
-      redex_workqueue_impl::WithStateWorkQueueHelper<Input, Fn>{fn},
-      num_threads,
-      push_tasks_while_running);
-  for (auto& item : items) {
-    wq.add_item(item);
+  redex_workqueue_impl::run_items<Input>(
+      redex_workqueue_impl::WithStateWorkQueueHelper<Input, Fn>{fn}, items,
+      num_threads, push_tasks_while_running);
+}
+
+namespace redex_parallel {
+
+/**
+ * Sorts the vector like std::stable_sort, so the result does not depend on
+ * the number of threads: slices are sorted in parallel, and adjacent slices
+ * are then merged in parallel rounds. Input that is already sorted is left
+ * as is after a linear check.
+ */
+template <typename T, typename Cmp>
+void stable_sort(std::vector<T>& vec,
+                 const Cmp& cmp,
+                 size_t num_threads = default_num_threads()) {
+  // Comparators may be costly to copy, e.g. with custom orders.
+  auto cmp_ref = std::cref(cmp);
+  if (std::is_sorted(vec.begin(), vec.end(), cmp_ref)) {
+    return;
+  }
+  // Below this, a slice isn't worth handing to another thread.
+  constexpr size_t kMinSliceSize = 4096;
+  size_t num_slices = std::min(num_threads, vec.size() / kMinSliceSize);
+  if (num_slices <= 1) {
+    std::stable_sort(vec.begin(), vec.end(), cmp_ref);
+    return;
+  }
+  std::vector<size_t> bounds(num_slices + 1);
+  for (size_t i = 0; i <= num_slices; ++i) {
+    bounds[i] = vec.size() * i / num_slices;
+  }
+  std::vector<size_t> indices(num_slices);
+  std::iota(indices.begin(), indices.end(), 0);
+  workqueue_run<size_t>(
+      [&](size_t i) {
+        std::stable_sort(vec.begin() + bounds[i], vec.begin() + bounds[i + 1],
+                         cmp_ref);
+      },
+      indices, num_threads);
+  while (bounds.size() > 2) {
+    indices.resize((bounds.size() - 1) / 2);
+    workqueue_run<size_t>(
+        [&](size_t pair) {
+          auto begin = vec.begin();
+          std::inplace_merge(begin + bounds[2 * pair],
+                             begin + bounds[2 * pair + 1],
+                             begin + bounds[2 * pair + 2], cmp_ref);
+        },
+        indices, num_threads);
+    std::vector<size_t> merged_bounds;
+    for (size_t i = 0; i < bounds.size(); i += 2) {
+      merged_bounds.push_back(bounds[i]);
+    }
+    if (merged_bounds.back() != bounds.back()) {
+      merged_bounds.push_back(bounds.back());
+    }
+    bounds = std::move(merged_bounds);
   }
-  wq.run_all();
 }
+
+} // namespace redex_parallel
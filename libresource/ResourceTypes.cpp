@@ -539,9 +539,7 @@ void ResStringPool::serialize(Vector<char>& cVec)
   // See method serializeWithAdditionalStrings for caveats on adding new strings
   if (mAppendedStrings.size() == 0) {
     size_t dataSize = mHeader->header.size;
-    for (size_t i = 0; i < dataSize; ++i) {
-        cVec.push_back(*((unsigned char*)(mHeader) + i));
-    }
+    cVec.appendArray(reinterpret_cast<const char*>(mHeader), dataSize);
   } else {
     serializeWithAdditionalStrings(cVec);
   }
@@ -3094,16 +3092,43 @@ struct ResTable::Type
     Vector<const ResTable_type*>    configs;
     SortedVector<int>               deletedEntries;
 
+    // True if the given config has a value for at least one entry.
+    bool hasEntries(const ResTable_type* type) const
+    {
+        const uint32_t* const offsets = reinterpret_cast<const uint32_t*>(
+                reinterpret_cast<const uint8_t*>(type) + type->header.headerSize);
+        for (size_t i = 0; i < entryCount; ++i) {
+            if (dtohl(offsets[i]) != ResTable_type::NO_ENTRY) {
+                return true;
+            }
+        }
+        return false;
+    }
+
     void serialize(Vector<char>& cVec)
     {
+        if (deletedEntries.size() == 0) {
+            // Values may have been remapped in place, but no offsets moved, so
+            // the chunks can be copied as they are.
+            cVec.appendArray(reinterpret_cast<const char*>(typeSpec),
+                             dtohl(typeSpec->header.size));
+            for (size_t k = 0; k < configs.size(); k++) {
+                const ResTable_type* type = configs[k];
+                // Same as below, dead columns are dropped.
+                if (hasEntries(type)) {
+                    cVec.appendArray(reinterpret_cast<const char*>(type),
+                                     dtohl(type->header.size));
+                }
+            }
+            return;
+        }
+
         size_t initSize = cVec.size();
 
         // Serialize ResourceTableTypeSpec
         // First, we perform opaque serialization of the header
         uint32_t tHeaderSize = typeSpec->header.headerSize;
-        for (size_t i = 0; i < tHeaderSize; ++i) {
-            cVec.push_back(*((unsigned char*)(typeSpec) + i));
-        }
+        cVec.appendArray(reinterpret_cast<const char*>(typeSpec), tHeaderSize);
 
         // Fixup count of rows in header
         uint32_t newRowCount = entryCount - deletedEntries.size();
@@ -3138,9 +3163,7 @@ struct ResTable::Type
 
             // Opaque serialization of header
             uint32_t headSize = type->header.headerSize;
-            for (size_t i = 0; i < headSize; ++i) {
-                cVec.push_back(*((unsigned char*)(type) + i));
-            }
+            cVec.appendArray(reinterpret_cast<const char*>(type), headSize);
 
             // Fixup entry count and offset to start of entries
             size_t skippedHeaderFields =
@@ -3216,9 +3239,8 @@ struct ResTable::Type
                                 reinterpret_cast<const uint8_t*>(type) + offset + type->entriesStart);
 
                         // Opaque serialization of entry
-                        for (size_t j = 0; j < entrySize; ++j) {
-                            entryData.push_back(*((unsigned char*)(entry) + j));
-                        }
+                        entryData.appendArray(
+                            reinterpret_cast<const char*>(entry), entrySize);
 
                         // Fix offset for serialization
                         offset -= sumOfDeletedSizes;
@@ -3235,15 +3257,11 @@ struct ResTable::Type
             }
 
             // Copy serialized data for the entries we kept
-            for (size_t i = 0; i < entryData.size(); ++i) {
-                cVec.push_back(entryData[i]);
-            }
+            cVec.appendVector(entryData);
 
             if (entryData.size() == 0) {
               // We wrote an entirely dead column- let's erase it.
-              for (size_t d = cVec.size() - 1; d >= initSize; --d) {
-                  cVec.removeAt(d);
-              }
+              cVec.removeItemsAt(initSize, cVec.size() - initSize);
             } else {
                 rewriteSize(cVec, initSize);
             }
@@ -4008,9 +4026,8 @@ status_t ResTable::serialize(Vector<char>& cVec, size_t resTableIndex)
     size_t initSize = cVec.size();
 
     // 1. Write header
-    for (size_t i = 0; i < tableHeader->header.headerSize; ++i) {
-        cVec.push_back(*((unsigned char*)(tableHeader) + i));
-    }
+    cVec.appendArray(reinterpret_cast<const char*>(tableHeader),
+                     tableHeader->header.headerSize);
 
     // 2. Write global strings (ResStringPool)
     header->values.serialize(cVec);
@@ -7,6 +7,7 @@
 
 #include "AccessMarking.h"
 
+#include <atomic>
 #include <unordered_map>
 
 #include "ClassHierarchy.h"
@@ -14,6 +15,7 @@
 #include "FieldOpTracker.h"
 #include "IRCode.h"
 #include "MethodOverrideGraph.h"
+#include "MethodOverrideGraphAnalysis.h"
 #include "Mutators.h"
 #include "PassManager.h"
 #include "ReachableClasses.h"
@@ -22,6 +24,7 @@
 #include "StlUtil.h"
 #include "Trace.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 namespace mog = method_override_graph;
 
@@ -29,10 +32,11 @@ namespace {
 
 size_t mark_classes_final(const Scope& scope) {
   ClassHierarchy ch = build_type_hierarchy(scope);
-  size_t n_classes_finalized = 0;
-  for (auto const& cls : scope) {
+  std::atomic<size_t> n_classes_finalized{0};
+  // Finality of a class only depends on the hierarchy, which doesn't change.
+  walk::parallel::classes(scope, [&](DexClass* cls) {
     if (!can_rename(cls) || is_abstract(cls) || is_final(cls)) {
-      continue;
+      return;
     }
     auto const& children = get_children(ch, cls->get_type());
     if (children.empty()) {
@@ -40,14 +44,14 @@ size_t mark_classes_final(const Scope& scope) {
       set_final(cls);
       ++n_classes_finalized;
     }
-  }
+  });
   return n_classes_finalized;
 }
 
 size_t mark_methods_final(const Scope& scope,
                           const mog::Graph& override_graph) {
-  size_t n_methods_finalized = 0;
-  for (auto const& cls : scope) {
+  std::atomic<size_t> n_methods_finalized{0};
+  walk::parallel::classes(scope, [&](DexClass* cls) {
     for (auto const& method : cls->get_vmethods()) {
       if (!can_rename(method) || is_abstract(method) || is_final(method)) {
         continue;
@@ -58,7 +62,7 @@ size_t mark_methods_final(const Scope& scope,
         ++n_methods_finalized;
       }
     }
-  }
+  });
   return n_methods_finalized;
 }
 
@@ -68,36 +72,45 @@ size_t mark_fields_final(const Scope& scope,
   field_op_tracker::FieldStatsMap field_stats =
       field_op_tracker::analyze(scope);
 
-  size_t n_fields_finalized = 0;
+  using FieldStatsEntry = const field_op_tracker::FieldStatsMap::value_type*;
+  std::vector<FieldStatsEntry> entries;
+  entries.reserve(field_stats.size());
   for (auto& pair : field_stats) {
-    auto* field = pair.first;
-    auto& stats = pair.second;
-    if (stats.init_writes == stats.writes && can_rename(field) &&
-        !is_final(field) && !is_volatile(field) && !field->is_external()) {
-      if (!consider_unwritten_fields && stats.writes == 0) {
-        continue;
-      }
-      if (!consider_written_fields && stats.writes > 0) {
-        continue;
-      }
-      // Note: There is one more thing that javac enforces around final fields:
-      // That there's at most one write to the field along any constrol-flow
-      // path. We skip the complexities of checking that here, as the JVM spec
-      // doesn't call this out as a requirement.
-      //
-      // Except for the following special case for sanity:
-      if (is_static(field) && !field->get_static_value()->is_zero() &&
-          stats.writes > 0) {
-        // Let's not make fields final if they have both a static value and are
-        // written to in the static initializer. I cannot see where the JVM spec
-        // would forbid making it final in this case, but we'll be conservative
-        // to be safe and sane.
-        continue;
-      }
-      set_final(field);
-      ++n_fields_finalized;
-    }
+    entries.push_back(&pair);
   }
+  std::atomic<size_t> n_fields_finalized{0};
+  workqueue_run<FieldStatsEntry>(
+      [&](FieldStatsEntry pair) {
+        auto* field = pair->first;
+        auto& stats = pair->second;
+        if (stats.init_writes != stats.writes || !can_rename(field) ||
+            is_final(field) || is_volatile(field) || field->is_external()) {
+          return;
+        }
+        if (!consider_unwritten_fields && stats.writes == 0) {
+          return;
+        }
+        if (!consider_written_fields && stats.writes > 0) {
+          return;
+        }
+        // Note: There is one more thing that javac enforces around final
+        // fields: That there's at most one write to the field along any
+        // constrol-flow path. We skip the complexities of checking that here,
+        // as the JVM spec doesn't call this out as a requirement.
+        //
+        // Except for the following special case for sanity:
+        if (is_static(field) && !field->get_static_value()->is_zero() &&
+            stats.writes > 0) {
+          // Let's not make fields final if they have both a static value and
+          // are written to in the static initializer. I cannot see where the
+          // JVM spec would forbid making it final in this case, but we'll be
+          // conservative to be safe and sane.
+          return;
+        }
+        set_final(field);
+        ++n_fields_finalized;
+      },
+      entries);
   return n_fields_finalized;
 }
 
@@ -175,14 +188,29 @@ void mark_methods_private(const std::unordered_set<DexMethod*>& privates) {
   std::sort(
       ordered_privates.begin(), ordered_privates.end(), compare_dexmethods);
 
+  // Each class only changes its own method lists, so the classes are handled
+  // in parallel, each in the order above.
+  std::unordered_map<DexClass*, std::vector<DexMethod*>> privates_by_class;
+  std::vector<DexClass*> classes;
   for (auto method : ordered_privates) {
-    TRACE(ACCESS, 2, "Privatized method: %s", SHOW(method));
     auto cls = type_class(method->get_class());
-    cls->remove_method(method);
-    method->set_virtual(false);
-    set_private(method);
-    cls->add_method(method);
+    auto& methods = privates_by_class[cls];
+    if (methods.empty()) {
+      classes.push_back(cls);
+    }
+    methods.push_back(method);
   }
+  workqueue_run<DexClass*>(
+      [&](DexClass* cls) {
+        for (auto method : privates_by_class.at(cls)) {
+          TRACE(ACCESS, 2, "Privatized method: %s", SHOW(method));
+          cls->remove_method(method);
+          method->set_virtual(false);
+          set_private(method);
+          cls->add_method(method);
+        }
+      },
+      classes);
 }
 } // namespace
 
@@ -190,7 +218,10 @@ void AccessMarkingPass::run_pass(DexStoresVector& stores,
                                  ConfigFiles& /* conf */,
                                  PassManager& pm) {
   auto scope = build_class_scope(stores);
-  auto override_graph = mog::build_graph(scope);
+  std::shared_ptr<const mog::Graph> override_graph;
+  if (m_finalize_methods || m_privatize_methods) {
+    override_graph = MethodOverrideGraphAnalysisPass::get_or_build(&pm, scope);
+  }
   if (m_finalize_classes) {
     auto n_classes_final = mark_classes_final(scope);
     pm.incr_metric("finalized_classes", n_classes_final);
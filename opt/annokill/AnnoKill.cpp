@@ -31,6 +31,18 @@ constexpr const char* METRIC_FIELD_ASETS_CLEARED = "num_field_cleared";
 constexpr const char* METRIC_FIELD_ASETS_TOTAL = "num_field_total";
 constexpr const char* METRIC_SIGNATURES_KILLED = "num_signatures_killed";
 
+namespace {
+
+// Interned annotations may be shared with other members, and are owned by the
+// RedexContext.
+void delete_annotation(DexAnnotation* da) {
+  if (!da->is_interned()) {
+    delete da;
+  }
+}
+
+} // namespace
+
 AnnoKill::AnnoKill(
     Scope& scope,
     bool only_force_kill,
@@ -409,7 +421,7 @@ void AnnoKill::cleanup_aset(
             SHOW(anno_type),
             SHOW(da));
       m_stats.annotations_killed++;
-      delete da;
+      delete_annotation(da);
       return true;
     }
 
@@ -421,21 +433,21 @@ void AnnoKill::cleanup_aset(
             SHOW(anno_type),
             SHOW(da));
       m_stats.annotations_killed++;
-      delete da;
+      delete_annotation(da);
       return true;
     }
 
     if (!m_only_force_kill && !da->system_visible()) {
       TRACE(ANNO, 3, "Killing annotation instance %s", SHOW(da));
       m_stats.annotations_killed++;
-      delete da;
+      delete_annotation(da);
       return true;
     }
 
     if (anno_type == DexType::get_type("Ldalvik/annotation/Signature;")) {
       if (should_kill_bad_signature(da)) {
         m_stats.signatures_killed++;
-        delete da;
+        delete_annotation(da);
         return true;
       }
     }
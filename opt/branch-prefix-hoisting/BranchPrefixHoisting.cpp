@@ -14,7 +14,6 @@
 #include "ControlFlow.h"
 #include "DexClass.h"
 #include "DexUtil.h"
-#include "GraphUtil.h"
 #include "IRCode.h"
 #include "IRInstruction.h"
 #include "IRList.h"
@@ -604,10 +603,12 @@ size_t BranchPrefixHoistingPass::process_cfg(
   bool performed_transformation = false;
   do {
     performed_transformation = false;
-    const std::vector<cfg::Block*>& blocks =
-        graph::postorder_sort<cfg::GraphInterface>(cfg);
+    // The order is cached on the cfg, and only recomputed when hoisting
+    // changed the shape of the graph. Copy it, as hoisting may invalidate it.
+    const std::vector<cfg::Block*> blocks = cfg.get_reverse_post_order();
     // iterate from the back, may get to the optimal state quicker
-    for (auto block : blocks) {
+    for (auto it = blocks.rbegin(); it != blocks.rend(); ++it) {
+      auto block = *it;
       // when we are processing hoist for one block, other blocks may be changed
       size_t n_insn_hoisted =
           process_hoisting_for_block(block, cfg, type_inference, constant_uses);
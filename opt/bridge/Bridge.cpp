@@ -18,6 +18,7 @@
 #include <boost/functional/hash.hpp>
 
 #include "ClassHierarchy.h"
+#include "ConcurrentContainers.h"
 #include "Debug.h"
 #include "DexClass.h"
 #include "DexLoader.h"
@@ -173,11 +174,12 @@ class BridgeRemover {
       m_potential_bridgee_refs;
 
   void find_bridges() {
-    walk::methods(*m_scope, [&](DexMethod* m) {
+    ConcurrentMap<DexMethod*, DexMethod*> bridges_to_bridgees;
+    walk::parallel::methods(*m_scope, [&](DexMethod* m) {
       if (has_bridgelike_access(m)) {
         auto bridgee = find_bridgee(m);
         if (!bridgee) return;
-        m_bridges_to_bridgees.emplace(m, bridgee);
+        bridges_to_bridgees.emplace(m, bridgee);
         TRACE(BRIDGE,
               5,
               "Bridge:%p:%s\nBridgee:%p:%s",
@@ -187,6 +189,8 @@ class BridgeRemover {
               SHOW(bridgee));
       }
     });
+    m_bridges_to_bridgees.insert(bridges_to_bridgees.begin(),
+                                 bridges_to_bridgees.end());
   }
 
   void search_hierarchy_for_matches(DexMethod* bridge, DexMethod* bridgee) {
@@ -257,7 +261,10 @@ class BridgeRemover {
     }
   }
 
-  void exclude_referenced_bridgee(DexMethod* code_method, IRCode& code) {
+  void exclude_referenced_bridgee(
+      DexMethod* code_method,
+      IRCode& code,
+      ConcurrentSet<DexMethod*>& referenced_bridges) {
     for (auto& mie : InstructionIterable(&code)) {
       auto inst = mie.insn;
       if (!opcode::is_an_invoke(inst->opcode())) continue;
@@ -276,12 +283,15 @@ class BridgeRemover {
               SHOW(method->get_proto()),
               SHOW(code_method),
               SHOW(referenced_bridge));
-        m_bridges_to_bridgees.erase(referenced_bridge);
+        referenced_bridges.insert(referenced_bridge);
       }
     }
   }
 
   void exclude_referenced_bridgees() {
+    if (m_bridges_to_bridgees.empty()) {
+      return;
+    }
     std::vector<DexMethodRef*> refs;
 
     auto visit_methods = [&refs](DexMethod* m) {
@@ -330,12 +340,16 @@ class BridgeRemover {
       m_bridges_to_bridgees.erase(kill);
     }
 
-    walk::code(
-        *m_scope,
-        [](DexMethod*) { return true; },
-        [&](DexMethod* m, IRCode& code) {
-          exclude_referenced_bridgee(m, code);
-        });
+    if (m_bridges_to_bridgees.empty()) {
+      return;
+    }
+    ConcurrentSet<DexMethod*> referenced_bridges;
+    walk::parallel::code(*m_scope, [&](DexMethod* m, IRCode& code) {
+      exclude_referenced_bridgee(m, code, referenced_bridges);
+    });
+    for (auto bridge : referenced_bridges) {
+      m_bridges_to_bridgees.erase(bridge);
+    }
   }
 
   void inline_bridges() {
@@ -186,12 +186,7 @@ class RemoveClasses {
     // Run shrinking opts to optimize the changed methods.
     Timer t("shrink_methods");
 
-    auto post_process = [&](DexMethod* method) {
-      m_transform.get_shrinker().shrink_method(method);
-    };
-
-    // Walkers are over classes, so need to do this "manually."
-    workqueue_run<DexMethod*>(post_process, methods);
+    m_transform.get_shrinker().shrink_all(methods);
   }
 
   void collect_excluded_types() {
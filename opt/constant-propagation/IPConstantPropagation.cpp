@@ -7,12 +7,16 @@
 
 #include "IPConstantPropagation.h"
 
+#include <cinttypes>
+
+#include "CallGraphAnalysis.h"
 #include "ConfigFiles.h"
 #include "ConstantEnvironment.h"
 #include "ConstantPropagationAnalysis.h"
 #include "ConstructorParams.h"
 #include "IPConstantPropagationAnalysis.h"
 #include "MethodOverrideGraph.h"
+#include "MethodOverrideGraphAnalysis.h"
 #include "PassManager.h"
 #include "ScopedMetrics.h"
 #include "Timer.h"
@@ -37,11 +41,17 @@ using CombinedAnalyzer =
 
 class AnalyzerGenerator {
   const ImmutableAttributeAnalyzerState* m_immut_analyzer_state;
+  uint32_t m_widening_delay;
+  // Null unless fixpoint stats are collected.
+  PassImpl::FixpointStats* m_fixpoint_stats;
 
  public:
-  explicit AnalyzerGenerator(
-      const ImmutableAttributeAnalyzerState* immut_analyzer_state)
-      : m_immut_analyzer_state(immut_analyzer_state) {
+  AnalyzerGenerator(const ImmutableAttributeAnalyzerState* immut_analyzer_state,
+                    uint32_t widening_delay,
+                    PassImpl::FixpointStats* fixpoint_stats)
+      : m_immut_analyzer_state(immut_analyzer_state),
+        m_widening_delay(widening_delay),
+        m_fixpoint_stats(fixpoint_stats) {
     // Initialize the singletons that `operator()` needs ahead of time to
     // avoid a data race.
     static_cast<void>(EnumFieldAnalyzerState::get());
@@ -71,16 +81,33 @@ class AnalyzerGenerator {
     }
     TRACE(ICONSTP, 5, "%s", SHOW(code.cfg()));
 
+    // The method is analyzed again in every global iteration, so keep its
+    // ordering on the CFG.
     auto intra_cp = std::make_unique<intraprocedural::FixpointIterator>(
         code.cfg(),
+        ir_analyzer::get_forward_ordering(code.cfg()),
         CombinedAnalyzer(class_under_init,
                          const_cast<ImmutableAttributeAnalyzerState*>(
                              m_immut_analyzer_state),
                          &wps, EnumFieldAnalyzerState::get(),
                          BoxedBooleanAnalyzerState::get(), nullptr, nullptr,
                          nullptr));
+    intra_cp->set_widening_delay(m_widening_delay);
+    if (m_fixpoint_stats != nullptr) {
+      intra_cp->enable_stats();
+    }
     intra_cp->run(env);
 
+    if (m_fixpoint_stats != nullptr) {
+      auto stats = intra_cp->get_stats();
+      TRACE(ICONSTP, 3,
+            "Fixpoint of %s: %" PRIu64 " node visits, %" PRIu64
+            " joins, %" PRIu64 " widenings, %" PRIu64 "us in nodes",
+            SHOW(method), stats.node_visits, stats.joins, stats.widenings,
+            stats.analyze_node_ns / 1000);
+      std::lock_guard<std::mutex> lock(m_fixpoint_stats->mutex);
+      m_fixpoint_stats->total += stats;
+    }
     return intra_cp;
   }
 };
@@ -101,21 +128,39 @@ class AnalyzerGenerator {
 std::unique_ptr<FixpointIterator> PassImpl::analyze(
     const Scope& scope,
     const ImmutableAttributeAnalyzerState* immut_analyzer_state) {
-  auto method_override_graph = mog::build_graph(scope);
-  call_graph::Graph cg =
-      m_config.use_multiple_callee_callgraph
-          ? call_graph::multiple_callee_graph(*method_override_graph, scope,
-                                              m_config.big_override_threshold)
-          : call_graph::single_callee_graph(*method_override_graph, scope);
+  auto method_override_graph =
+      MethodOverrideGraphAnalysisPass::get_or_build(m_pass_manager, scope);
+  CallGraphAnalysisPass::Config cg_config;
+  cg_config.kind = m_config.use_multiple_callee_callgraph
+                       ? CallGraphAnalysisPass::Kind::MultipleCallee
+                       : CallGraphAnalysisPass::Kind::SingleCallee;
+  cg_config.big_override_threshold = m_config.big_override_threshold;
+  auto cg_ptr = CallGraphAnalysisPass::get_or_build(
+      m_pass_manager, cg_config, *method_override_graph, scope);
+  const auto& cg = *cg_ptr;
   auto cg_stats = get_num_nodes_edges(cg);
   m_stats.callgraph_nodes = cg_stats.num_nodes;
   m_stats.callgraph_edges = cg_stats.num_edges;
   m_stats.callgraph_callsites = cg_stats.num_callsites;
   auto fp_iter = std::make_unique<FixpointIterator>(
-      cg, AnalyzerGenerator(immut_analyzer_state));
+      cg,
+      AnalyzerGenerator(
+          immut_analyzer_state, m_config.intraprocedural_widening_delay,
+          m_config.collect_fixpoint_stats ? &m_fixpoint_stats : nullptr));
+  // Methods whose arguments and WholeProgramState reads didn't change
+  // since the previous round aren't analyzed again; record how many were.
+  m_stats.changed_methods_per_round.clear();
+  size_t computed_summaries = 0;
+  auto record_round = [&]() {
+    auto computed = fp_iter->get_summary_stats().computed;
+    m_stats.changed_methods_per_round.push_back(computed -
+                                                computed_summaries);
+    computed_summaries = computed;
+  };
   // Run the bootstrap. All field value and method return values are
   // represented by Top.
   fp_iter->run({{CURRENT_PARTITION_LABEL, ArgumentDomain()}});
+  record_round();
   auto non_true_virtuals =
       mog::get_non_true_virtuals(*method_override_graph, scope);
   for (size_t i = 0; i < m_config.max_heap_analysis_iterations; ++i) {
@@ -135,8 +180,10 @@ std::unique_ptr<FixpointIterator> PassImpl::analyze(
     // the stack and registers.
     fp_iter->set_whole_program_state(std::move(wps));
     fp_iter->run({{CURRENT_PARTITION_LABEL, ArgumentDomain()}});
+    record_round();
   }
   compute_analysis_stats(fp_iter->get_whole_program_state());
+  m_stats.reused_summaries = fp_iter->get_summary_stats().reused;
 
   return fp_iter;
 }
@@ -241,7 +288,9 @@ void PassImpl::run_pass(DexStoresVector& stores,
         RuntimeAssertTransform::Config(config.get_proguard_map());
   }
 
+  m_pass_manager = &mgr;
   run(stores);
+  m_pass_manager = nullptr;
 
   ScopedMetrics sm(mgr);
   m_transform_stats.log_metrics(sm, /* with_scope= */ false);
@@ -251,6 +300,22 @@ void PassImpl::run_pass(DexStoresVector& stores,
   mgr.incr_metric("callgraph_edges", m_stats.callgraph_edges);
   mgr.incr_metric("callgraph_nodes", m_stats.callgraph_nodes);
   mgr.incr_metric("callgraph_callsites", m_stats.callgraph_callsites);
+  for (size_t i = 0; i < m_stats.changed_methods_per_round.size(); ++i) {
+    mgr.incr_metric("changed_methods_round_" + std::to_string(i),
+                    m_stats.changed_methods_per_round[i]);
+  }
+  mgr.incr_metric("reused_method_summaries", m_stats.reused_summaries);
+  if (m_config.collect_fixpoint_stats) {
+    const auto& fixpoint = m_fixpoint_stats.total;
+    mgr.incr_metric("fixpoint_node_visits", fixpoint.node_visits);
+    mgr.incr_metric("fixpoint_edge_visits", fixpoint.edge_visits);
+    mgr.incr_metric("fixpoint_joins", fixpoint.joins);
+    mgr.incr_metric("fixpoint_widenings", fixpoint.widenings);
+    mgr.incr_metric("fixpoint_analyze_node_ms",
+                    fixpoint.analyze_node_ns / 1000000);
+    mgr.incr_metric("fixpoint_analyze_edge_ms",
+                    fixpoint.analyze_edge_ns / 1000000);
+  }
 }
 
 static PassImpl s_pass;
@@ -7,7 +7,9 @@
 
 #pragma once
 
+#include <mutex>
 #include <utility>
+#include <vector>
 
 #include "ConstantPropagationRuntimeAssert.h"
 #include "ConstantPropagationTransform.h"
@@ -30,11 +32,23 @@ class PassImpl : public Pass {
     uint64_t max_heap_analysis_iterations{0};
     uint32_t big_override_threshold{5};
     std::unordered_set<const DexType*> field_blocklist;
+    // See MonotonicFixpointIteratorBase::set_widening_delay.
+    uint32_t intraprocedural_widening_delay{1};
+    // Report the work done by the intraprocedural fixpoint iterations as
+    // metrics. This measures each call to the transfer functions.
+    bool collect_fixpoint_stats{false};
 
     Transform::Config transform;
     RuntimeAssertTransform::Config runtime_assert;
   };
 
+  // Totals over all intraprocedural analyses, when
+  // `Config::collect_fixpoint_stats` is set.
+  struct FixpointStats {
+    std::mutex mutex;
+    sparta::FixpointIteratorStats total;
+  };
+
   explicit PassImpl(Config config)
       : Pass("InterproceduralConstantPropagationPass"),
         m_config(std::move(config)) {}
@@ -60,6 +74,17 @@ class PassImpl : public Pass {
          {},
          m_config.field_blocklist,
          "List of types whose fields that this optimization will omit.");
+    bind("intraprocedural_widening_delay",
+         UINT32_C(1),
+         m_config.intraprocedural_widening_delay,
+         "Number of iterations of a loop in which the intraprocedural "
+         "analysis joins before it widens. Higher values cost time and may "
+         "gain precision.");
+    bind("collect_fixpoint_stats",
+         false,
+         m_config.collect_fixpoint_stats,
+         "Report node visits, joins, widenings and the time spent in the "
+         "transfer functions of the intraprocedural analyses as metrics.");
   }
 
   void run_pass(DexStoresVector& stores,
@@ -93,9 +118,17 @@ class PassImpl : public Pass {
     size_t callgraph_nodes{0};
     size_t callgraph_edges{0};
     size_t callgraph_callsites{0};
+    // The number of methods analyzed in the bootstrap and in each refinement
+    // of the WholeProgramState. The other methods had the same arguments and
+    // read the same values as in the round before.
+    std::vector<size_t> changed_methods_per_round;
+    size_t reused_summaries{0};
   } m_stats;
   Transform::Stats m_transform_stats;
+  FixpointStats m_fixpoint_stats;
   Config m_config;
+  // Only set while running as a pass, to reuse the preserved analyses.
+  const PassManager* m_pass_manager{nullptr};
 };
 
 } // namespace interprocedural
@@ -7,8 +7,11 @@
 
 #pragma once
 
+#include "AnalysisUsage.h"
 #include "CopyPropagation.h"
+#include "MethodOverrideGraphAnalysis.h"
 #include "Pass.h"
+#include "SubtypeIndexAnalysis.h"
 
 class CopyPropagationPass : public Pass {
  public:
@@ -16,6 +19,15 @@ class CopyPropagationPass : public Pass {
 
   void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
 
+  void set_analysis_usage(AnalysisUsage& au) const override {
+    Pass::set_analysis_usage(au);
+    // Works on CFGs only, through cfg::ScopedCFG.
+    au.set_requires_linear_ir(false);
+    // Only rewrites method bodies; leaves methods and classes alone.
+    au.add_preserve_specific<MethodOverrideGraphAnalysisPass>();
+    au.add_preserve_specific<SubtypeIndexAnalysisPass>();
+  }
+
   void bind_config() override {
     // This option can only be safely enabled in verify-none. `run_pass` will
     // override this value to false if we aren't in verify-none. Here's why:
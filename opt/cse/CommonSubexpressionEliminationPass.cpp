@@ -13,6 +13,7 @@
 #include "DexUtil.h"
 #include "LocalDce.h"
 #include "Purity.h"
+#include "PurityAnalysis.h"
 #include "Show.h"
 #include "Walkers.h"
 
@@ -56,16 +57,14 @@ void CommonSubexpressionEliminationPass::run_pass(DexStoresVector& stores,
     code.build_cfg(/* editable */ true);
   });
 
-  auto pure_methods = /* Android framework */ get_pure_methods();
-  auto configured_pure_methods = conf.get_pure_methods();
-  pure_methods.insert(configured_pure_methods.begin(),
-                      configured_pure_methods.end());
-  auto immutable_getters = get_immutable_getters(scope);
-  pure_methods.insert(immutable_getters.begin(), immutable_getters.end());
+  auto preserved = PurityAnalysisPass::get_preserved_result(&mgr);
+  auto pure_methods =
+      preserved ? preserved->pure_methods
+                : PurityAnalysisPass::get_default_pure_methods(scope, conf);
 
   auto shared_state =
       SharedState(pure_methods, conf.get_finalish_field_names());
-  shared_state.init_scope(scope);
+  shared_state.init_scope(scope, preserved.get());
 
   // The following default 'features' of copy propagation would only
   // interfere with what CSE is trying to do.
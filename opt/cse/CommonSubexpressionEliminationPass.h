@@ -7,8 +7,10 @@
 
 #pragma once
 
+#include "AnalysisUsage.h"
 #include "Pass.h"
 #include "PassManager.h"
+#include "PurityAnalysis.h"
 
 class CommonSubexpressionEliminationPass : public Pass {
  public:
@@ -16,6 +18,16 @@ class CommonSubexpressionEliminationPass : public Pass {
       : Pass("CommonSubexpressionEliminationPass") {}
 
   void bind_config() override;
+
+  void set_analysis_usage(AnalysisUsage& au) const override {
+    Pass::set_analysis_usage(au);
+    // Only replaces reads by moves, which makes methods more pure, unless
+    // it inserts assertions that may throw.
+    if (!m_runtime_assertions) {
+      au.add_preserve_specific<PurityAnalysisPass>();
+    }
+  }
+
   void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
 
  private:
@@ -258,33 +258,77 @@ DedupStrings::get_occurrences(
     const std::unordered_map<const DexMethod*, size_t>& methods_to_dex,
     const std::unordered_set<const DexMethod*>& perf_sensitive_methods,
     std::unordered_set<const DexString*> non_load_strings[]) {
-  // For each string, figure out how many times it's loaded per dex
-  ConcurrentMap<DexString*, std::unordered_map<size_t, size_t>> occurrences;
-  ConcurrentMap<DexString*, std::unordered_set<size_t>> perf_sensitive_strings;
-  walk::parallel::code(
-      scope, [&occurrences, &perf_sensitive_strings, &methods_to_dex,
-              &perf_sensitive_methods](DexMethod* method, IRCode& code) {
-        const auto dexnr = methods_to_dex.at(method);
-        const auto perf_sensitive = perf_sensitive_methods.count(method) != 0;
-        for (auto& mie : InstructionIterable(code)) {
-          const auto insn = mie.insn;
-          if (insn->opcode() == OPCODE_CONST_STRING) {
-            const auto str = insn->get_string();
-            if (perf_sensitive) {
-              perf_sensitive_strings.update(
-                  str,
-                  [dexnr](const DexString*,
-                          std::unordered_set<size_t>& s,
-                          bool /* exists */) { s.emplace(dexnr); });
-            } else {
-              occurrences.update(str,
-                                 [dexnr](const DexString*,
-                                         std::unordered_map<size_t, size_t>& m,
-                                         bool /* exists */) { ++m[dexnr]; });
+  // For each string, figure out how many times it's loaded per dex. Each
+  // worker counts the loads of the methods it visits on its own, and the
+  // counts of all workers are merged at the end, which keeps the workers from
+  // contending on the strings that are loaded all over the place.
+  struct WorkerLoads {
+    std::unordered_map<DexString*, std::unordered_map<size_t, size_t>>
+        occurrences;
+    std::unordered_map<DexString*, std::unordered_set<size_t>>
+        perf_sensitive_strings;
+  };
+  const auto num_threads = redex_parallel::default_num_threads();
+  std::vector<WorkerLoads> worker_loads(num_threads);
+  workqueue_run<DexClass*>(
+      [&](sparta::SpartaWorkerState<DexClass*>* state, DexClass* cls) {
+        auto& loads = worker_loads[state->worker_id()];
+        auto count_loads = [&](DexMethod* method) {
+          auto code = method->get_code();
+          if (code == nullptr) {
+            return;
+          }
+          const auto dexnr = methods_to_dex.at(method);
+          const auto perf_sensitive = perf_sensitive_methods.count(method) != 0;
+          for (auto& mie : InstructionIterable(*code)) {
+            const auto insn = mie.insn;
+            if (insn->opcode() == OPCODE_CONST_STRING) {
+              const auto str = insn->get_string();
+              if (perf_sensitive) {
+                loads.perf_sensitive_strings[str].emplace(dexnr);
+              } else {
+                ++loads.occurrences[str][dexnr];
+              }
             }
           }
+        };
+        for (auto method : cls->get_dmethods()) {
+          count_loads(method);
         }
-      });
+        for (auto method : cls->get_vmethods()) {
+          count_loads(method);
+        }
+      },
+      scope, num_threads);
+
+  ConcurrentMap<DexString*, std::unordered_map<size_t, size_t>> occurrences;
+  ConcurrentMap<DexString*, std::unordered_set<size_t>> perf_sensitive_strings;
+  std::vector<size_t> worker_ids(num_threads);
+  std::iota(worker_ids.begin(), worker_ids.end(), 0);
+  workqueue_run<size_t>(
+      [&](size_t worker_id) {
+        auto& loads = worker_loads[worker_id];
+        for (auto& p : loads.occurrences) {
+          occurrences.update(p.first,
+                             [&p](const DexString*,
+                                  std::unordered_map<size_t, size_t>& m,
+                                  bool /* exists */) {
+                               for (auto& q : p.second) {
+                                 m[q.first] += q.second;
+                               }
+                             });
+        }
+        for (auto& p : loads.perf_sensitive_strings) {
+          perf_sensitive_strings.update(
+              p.first,
+              [&p](const DexString*,
+                   std::unordered_set<size_t>& dexes,
+                   bool /* exists */) {
+                dexes.insert(p.second.begin(), p.second.end());
+              });
+        }
+      },
+      worker_ids);
 
   // Also, add all the strings that occurred in perf-sensitive methods
   // to the non_load_strings datastructure, as we won't attempt to dedup them.
@@ -332,51 +376,62 @@ DedupStrings::get_strings_to_dedup(
     ordered_strings.push_back(p.first);
   }
   std::sort(ordered_strings.begin(), ordered_strings.end(), compare_dexstrings);
-  for (DexString* s : ordered_strings) {
+  const auto get_size_reduction = [non_load_strings](DexString* str,
+                                                     size_t entry_size,
+                                                     size_t dexnr,
+                                                     size_t loads) -> size_t {
+    const auto has_non_load_string = non_load_strings[dexnr].count(str) != 0;
+    if (has_non_load_string) {
+      // If there's a non-load string, there's nothing to gain
+      return 0;
+    }
+
+    size_t code_size_increase = loads * (6 /* invoke */ + 2 /* move-result */);
+    if (4 + entry_size < code_size_increase) {
+      // If the string itself is taking up less space than the code size
+      // increase we would incur when referencing the string via a
+      // referenced load method, then there's nothing to gain
+      return 0;
+    }
+
+    return 4 + entry_size - code_size_increase;
+  };
+
+  // Which dex should host a string, and which other dexes should get their
+  // const-string instructions rewritten.
+  struct HostInfo {
+    size_t dexnr;
+    size_t size_reduction;
+  };
+  struct DedupPlan {
+    boost::optional<HostInfo> host_info;
+    size_t total_size_reduction{0};
+    size_t duplicate_string_loads{0};
+    std::unordered_set<size_t> dexes_to_dedup;
+    size_t duplicate_non_load_strings{0};
+    size_t out_of_factory_methods{0};
+  };
+  const auto make_plan = [&](DexString* s, bool limit_reached) {
     // We are going to look at the situation of a particular string here
     const auto& m = occurrences.at_unsafe(s);
     always_assert(m.size() > 1);
     const auto entry_size = s->get_entry_size();
-    const auto get_size_reduction = [entry_size, non_load_strings](
-                                        DexString* str, size_t dexnr,
-                                        size_t loads) -> size_t {
-      const auto has_non_load_string = non_load_strings[dexnr].count(str) != 0;
-      if (has_non_load_string) {
-        // If there's a non-load string, there's nothing to gain
-        return 0;
-      }
-
-      size_t code_size_increase =
-          loads * (6 /* invoke */ + 2 /* move-result */);
-      if (4 + entry_size < code_size_increase) {
-        // If the string itself is taking up less space than the code size
-        // increase we would incur when referencing the string via a
-        // referenced load method, then there's nothing to gain
-        return 0;
-      }
-
-      return 4 + entry_size - code_size_increase;
-    };
+    DedupPlan plan;
 
     // First, we identify which dex could and should host the string in
     // its string factory method
-    struct HostInfo {
-      size_t dexnr;
-      size_t size_reduction;
-    };
-    boost::optional<HostInfo> host_info;
+    auto& host_info = plan.host_info;
     for (size_t dexnr = 0; dexnr < dexen.size(); ++dexnr) {
       // There's a configurable limit of how many factory methods / hosts we
       // can have in total
-      if (hosting_dexnrs.count(dexnr) == 0 &&
-          hosting_dexnrs.size() == m_max_factory_methods) {
+      if (limit_reached && hosting_dexnrs.count(dexnr) == 0) {
         // We could try a bit harder to determine the optimal set of hosts,
         // but the best fix in this case is probably to raise the limit
         TRACE(DS, 4,
               "[dedup strings] non perf sensitive string: {%s} dex #%zu cannot "
               "be used as dedup strings max factory methods limit reached",
               SHOW(s), dexnr);
-        ++m_stats.excluded_out_of_factory_methods_strings;
+        ++plan.out_of_factory_methods;
         continue;
       }
 
@@ -386,7 +441,8 @@ DedupStrings::get_strings_to_dedup(
       // Figure out what the size reduction would be if this dex would *not*
       // be hosting string s, also considering whether we'd keep around a copy
       // of the string in this dex anyway
-      const auto size_reduction = get_size_reduction(s, dexnr, loads);
+      const auto size_reduction =
+          get_size_reduction(s, entry_size, dexnr, loads);
       if (!host_info || size_reduction < host_info->size_reduction) {
         TRACE(DS, 4,
               "[dedup strings] non perf sensitive string: {%s} dex #%zu can "
@@ -404,17 +460,12 @@ DedupStrings::get_strings_to_dedup(
     // We have a zero max_cost if and only if we didn't find any suitable
     // hosting_dexnr
     if (!host_info) {
-      TRACE(DS, 3, "[dedup strings] non perf sensitive string: {%s} - no host",
-            SHOW(s));
-      continue;
+      return plan;
     }
     size_t hosting_dexnr = host_info->dexnr;
 
     // Second, we figure out which other dexes should get their const-string
     // instructions rewritten
-    size_t total_size_reduction = 0;
-    size_t duplicate_string_loads = 0;
-    std::unordered_set<size_t> dexes_to_dedup;
     for (const auto& q : m) {
       const auto dexnr = q.first;
       const auto loads = q.second;
@@ -422,7 +473,8 @@ DedupStrings::get_strings_to_dedup(
         continue;
       }
 
-      const auto size_reduction = get_size_reduction(s, dexnr, loads);
+      const auto size_reduction =
+          get_size_reduction(s, entry_size, dexnr, loads);
 
       if (non_load_strings[dexnr].count(s) != 0) {
         always_assert(size_reduction == 0);
@@ -430,18 +482,54 @@ DedupStrings::get_strings_to_dedup(
               "[dedup strings] non perf sensitive string: {%s}*%zu is a "
               "non-load string in non-hosting dex #%zu",
               SHOW(s), loads, dexnr);
-        ++m_stats.excluded_duplicate_non_load_strings;
+        ++plan.duplicate_non_load_strings;
         // No point in rewriting const-string instructions for this string
         // in this dex as string will be referenced from this dex anyway
         continue;
       }
 
       if (size_reduction > 0) {
-        duplicate_string_loads += loads;
-        total_size_reduction += size_reduction;
-        dexes_to_dedup.emplace(dexnr);
+        plan.duplicate_string_loads += loads;
+        plan.total_size_reduction += size_reduction;
+        plan.dexes_to_dedup.emplace(dexnr);
       }
     }
+    return plan;
+  };
+
+  // The plans are independent of each other until the limit of factory
+  // methods is reached, after which only the dexes that already host strings
+  // can host more. So they are all made in parallel as if there was no limit,
+  // and only those for the strings after the limit is reached are made again.
+  std::vector<DedupPlan> plans(ordered_strings.size());
+  std::vector<size_t> string_indices(ordered_strings.size());
+  std::iota(string_indices.begin(), string_indices.end(), 0);
+  workqueue_run<size_t>(
+      [&](size_t i) {
+        plans[i] = make_plan(ordered_strings[i], /* limit_reached */ false);
+      },
+      string_indices);
+
+  for (size_t i = 0; i < ordered_strings.size(); ++i) {
+    DexString* s = ordered_strings[i];
+    const auto entry_size = s->get_entry_size();
+    if (hosting_dexnrs.size() == m_max_factory_methods) {
+      plans[i] = make_plan(s, /* limit_reached */ true);
+    }
+    auto& plan = plans[i];
+    m_stats.excluded_out_of_factory_methods_strings +=
+        plan.out_of_factory_methods;
+    if (!plan.host_info) {
+      TRACE(DS, 3, "[dedup strings] non perf sensitive string: {%s} - no host",
+            SHOW(s));
+      continue;
+    }
+    size_t hosting_dexnr = plan.host_info->dexnr;
+    m_stats.excluded_duplicate_non_load_strings +=
+        plan.duplicate_non_load_strings;
+    const auto total_size_reduction = plan.total_size_reduction;
+    const auto duplicate_string_loads = plan.duplicate_string_loads;
+    auto& dexes_to_dedup = plan.dexes_to_dedup;
 
     const auto hosting_code_size_increase =
         (4 /* switch-target-offset */ + 4 /* const-string */ + 2 /* return */);
@@ -7,6 +7,8 @@
 
 #include "DedupBlocksPass.h"
 
+#include "CrossMethodBlockSuffixes.h"
+#include "DexStore.h"
 #include "PassManager.h"
 #include "Show.h"
 #include "Trace.h"
@@ -18,6 +20,8 @@ const char* METRIC_INSNS_REMOVED = "insns_removed";
 const char* METRIC_BLOCKS_SPLIT = "blocks_split";
 const char* METRIC_POSITIONS_INSERTED = "positions_inserted";
 const char* METRIC_ELIGIBLE_BLOCKS = "eligible_blocks";
+const char* METRIC_CROSS_METHOD_SUFFIX_GROUPS = "cross_method_suffix_groups";
+const char* METRIC_CROSS_METHOD_SUFFIX_INSNS = "cross_method_suffix_insns";
 } // namespace
 
 void DedupBlocksPass::run_pass(DexStoresVector& stores,
@@ -25,7 +29,7 @@ void DedupBlocksPass::run_pass(DexStoresVector& stores,
                                PassManager& mgr) {
   const auto& scope = build_class_scope(stores);
 
-  const auto stats = walk::parallel::methods<dedup_blocks_impl::Stats>(
+  auto stats = walk::parallel::methods<dedup_blocks_impl::Stats>(
       scope,
       [&](DexMethod* method) {
         const auto code = method->get_code();
@@ -49,6 +53,26 @@ void DedupBlocksPass::run_pass(DexStoresVector& stores,
       },
       m_config.debug ? 1 : redex_parallel::default_num_threads());
 
+  if (m_config.cross_method_suffixes) {
+    // One dex at a time, so that the hash table only holds one dex' worth of
+    // suffixes.
+    for (auto& store : stores) {
+      for (auto& dex : store.get_dexen()) {
+        auto groups =
+            dedup_blocks_impl::find_cross_method_duplicate_suffixes(m_config,
+                                                                    dex);
+        stats.cross_method_suffix_groups += groups.size();
+        for (const auto& group : groups) {
+          stats.cross_method_suffix_insns += group.get_savings();
+          TRACE(DEDUP_BLOCKS, 3,
+                "[dedup blocks] %zu suffixes of %u instructions, e.g. in %s",
+                group.suffixes.size(), group.length,
+                SHOW(group.suffixes.front().method));
+        }
+      }
+    }
+  }
+
   report_stats(mgr, stats);
 }
 
@@ -64,6 +88,10 @@ void DedupBlocksPass::report_stats(PassManager& mgr,
   mgr.incr_metric(METRIC_INSNS_REMOVED, insns_removed);
   mgr.incr_metric(METRIC_BLOCKS_SPLIT, split);
   mgr.incr_metric(METRIC_POSITIONS_INSERTED, positions_inserted);
+  mgr.incr_metric(METRIC_CROSS_METHOD_SUFFIX_GROUPS,
+                  stats.cross_method_suffix_groups);
+  mgr.incr_metric(METRIC_CROSS_METHOD_SUFFIX_INSNS,
+                  stats.cross_method_suffix_insns);
   TRACE(DEDUP_BLOCKS, 2, "%d eligible_blocks", eligible_blocks);
 
   for (const auto& entry : stats.dup_sizes) {
@@ -24,6 +24,11 @@ class DedupBlocksPass : public Pass {
     bind("split_postfix", true, m_config.split_postfix);
     bind("debug", false, m_config.debug);
     bind("dedup_throws", false, m_config.dedup_throws);
+    bind("cross_method_suffixes", false, m_config.cross_method_suffixes,
+         "Also look for block suffixes that are duplicated across the methods "
+         "of each dex, and report them.");
+    bind("cross_method_min_insns", 3u, m_config.cross_method_min_insns);
+    bind("cross_method_max_insns", 32u, m_config.cross_method_max_insns);
   }
 
  private:
@@ -17,10 +17,12 @@
 #include "SourceBlocks.h"
 #include "TypeSystem.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 #include <boost/algorithm/string/join.hpp>
 #include <fstream>
 #include <map>
+#include <numeric>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -576,30 +578,51 @@ void insert_block_coverage_computations(const std::vector<BlockInfo>& blocks,
   }
 }
 
+// The blocks of a method to instrument. They fix the number of bit vectors of
+// the method, and so the offset of the next method, before any method is
+// instrumented.
+struct BlocksToInstrument {
+  std::vector<BlockInfo> blocks;
+  size_t num_to_instrument;
+  bool too_many_blocks;
+  size_t num_vectors;
+};
+
+// Step 1 of instrument_basic_blocks, which leaves the CFG built for it.
+BlocksToInstrument plan_basic_blocks(IRCode& code,
+                                     const size_t max_num_blocks,
+                                     const InstrumentPass::Options& options) {
+  code.build_cfg(/*editable*/ true);
+
+  // Get sorted basic blocks to instrument with their information.
+  //
+  // The blocks are sorted in RPO. We don't instrument entry blocks. If too many
+  // blocks, it falls back to empty blocks, which is method tracing.
+  BlocksToInstrument plan;
+  std::tie(plan.blocks, plan.num_to_instrument, plan.too_many_blocks) =
+      get_blocks_to_instrument(code.cfg(), max_num_blocks, options);
+  plan.num_vectors =
+      std::ceil(plan.num_to_instrument / double(BIT_VECTOR_SIZE));
+  return plan;
+}
+
 MethodInfo instrument_basic_blocks(IRCode& code,
                                    DexMethod* method,
                                    DexMethod* onMethodBegin,
                                    const OnMethodExitMap& onMethodExit_map,
                                    const size_t max_vector_arity,
                                    const size_t method_offset,
-                                   const size_t max_num_blocks,
-                                   const InstrumentPass::Options& options) {
+                                   const BlocksToInstrument& plan) {
   using namespace cfg;
 
-  code.build_cfg(/*editable*/ true);
   ControlFlowGraph& cfg = code.cfg();
 
   const std::string& before_cfg = show(cfg);
 
-  // Step 1: Get sorted basic blocks to instrument with their information.
-  //
-  // The blocks are sorted in RPO. We don't instrument entry blocks. If too many
-  // blocks, it falls back to empty blocks, which is method tracing.
-  std::vector<BlockInfo> blocks;
-  size_t num_to_instrument;
-  bool too_many_blocks;
-  std::tie(blocks, num_to_instrument, too_many_blocks) =
-      get_blocks_to_instrument(cfg, max_num_blocks, options);
+  // Step 1: Done by plan_basic_blocks.
+  const auto& blocks = plan.blocks;
+  const size_t num_to_instrument = plan.num_to_instrument;
+  const bool too_many_blocks = plan.too_many_blocks;
 
   if (DEBUG_CFG) {
     TRACE(INSTRUMENT, 9, "BEFORE: %s, %s", show_deobfuscated(method).c_str(),
@@ -611,8 +634,7 @@ MethodInfo instrument_basic_blocks(IRCode& code,
   //         allocation code in its method entry point.
   //
   const size_t origin_num_non_entry_blocks = cfg.blocks().size() - 1;
-  const size_t num_vectors =
-      std::ceil(num_to_instrument / double(BIT_VECTOR_SIZE));
+  const size_t num_vectors = plan.num_vectors;
   std::vector<reg_t> reg_vectors;
   reg_t reg_method_offset;
   std::tie(reg_vectors, reg_method_offset) =
@@ -1087,6 +1109,7 @@ void BlockInstrumentHelper::do_basic_block_tracing(
     scope = build_class_scope(stores);
   }
 
+  std::vector<std::pair<DexMethod*, IRCode*>> to_instrument;
   walk::code(scope, [&](DexMethod* method, IRCode& code) {
     all_methods++;
     if (method == analysis_cls->get_clinit() || method == onMethodBegin) {
@@ -1124,21 +1147,46 @@ void BlockInstrumentHelper::do_basic_block_tracing(
       return;
     }
 
-    instrumented_methods.emplace_back(instrument_basic_blocks(
-        code, method, onMethodBegin, onMethodExit_map, max_vector_arity,
-        method_offset, max_num_blocks, options));
+    to_instrument.emplace_back(method, &code);
+  });
+
+  // The offsets only depend on the number of bit vectors of each method, so
+  // plan all methods first, lay them out in walk order, and then instrument
+  // them all in parallel.
+  std::vector<size_t> indices(to_instrument.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  std::vector<BlocksToInstrument> plans(to_instrument.size());
+  workqueue_run<size_t>(
+      [&](size_t i) {
+        plans[i] = plan_basic_blocks(*to_instrument[i].second,
+                                     max_num_blocks, options);
+      },
+      indices);
+
+  std::vector<size_t> method_offsets(to_instrument.size());
+  for (size_t i = 0; i < to_instrument.size(); ++i) {
+    method_offsets[i] = method_offset;
+    // Update method offset for next method. 2 shorts are for method stats.
+    method_offset += 2 + plans[i].num_vectors;
+  }
 
-    const auto& method_info = instrumented_methods.back();
+  instrumented_methods.resize(to_instrument.size());
+  workqueue_run<size_t>(
+      [&](size_t i) {
+        instrumented_methods[i] = instrument_basic_blocks(
+            *to_instrument[i].second, to_instrument[i].first, onMethodBegin,
+            onMethodExit_map, max_vector_arity, method_offsets[i], plans[i]);
+      },
+      indices);
+
+  for (const auto& method_info : instrumented_methods) {
     if (method_info.too_many_blocks) {
       TRACE(INSTRUMENT, 7, "Too many blocks: %s",
-            SHOW(show_deobfuscated(method)));
+            SHOW(show_deobfuscated(method_info.method)));
     } else {
       block_instrumented++;
     }
-
-    // Update method offset for next method. 2 shorts are for method stats.
-    method_offset += 2 + method_info.num_vectors;
-  });
+  }
 
   // Patch static fields.
   const auto field_name = array_fields.at(1)->get_name()->str();
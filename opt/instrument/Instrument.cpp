@@ -111,22 +111,8 @@ bool match_class_name(std::string cls_name,
   return false;
 }
 
-void instrument_onMethodBegin(DexMethod* method,
-                              int index,
-                              DexMethod* method_onMethodBegin) {
-  IRCode* code = method->get_code();
-  assert(code != nullptr);
-
-  IRInstruction* const_inst = new IRInstruction(OPCODE_CONST);
-  const_inst->set_literal(index);
-  const auto reg_dest = code->allocate_temp();
-  const_inst->set_dest(reg_dest);
-
-  IRInstruction* invoke_inst = new IRInstruction(OPCODE_INVOKE_STATIC);
-  invoke_inst->set_method(method_onMethodBegin);
-  invoke_inst->set_srcs_size(1);
-  invoke_inst->set_src(0, reg_dest);
-
+// Returns where the instrumentation goes: the entry point of the method.
+IRList::iterator get_entry_insert_point(IRCode* code) {
   // TODO(minjang): Consider using get_param_instructions.
   // Try to find a right insertion point: the entry point of the method.
   // We skip any fall throughs and IOPCODE_LOAD_PARRM*.
@@ -154,10 +140,10 @@ void instrument_onMethodBegin(DexMethod* method,
   } else {
     // Otherwise, insert_point can be used directly.
   }
+  return insert_point;
+}
 
-  code->insert_before(code->insert_before(insert_point, invoke_inst),
-                      const_inst);
-
+void trace_insert_point(IRCode* code, IRList::iterator insert_point) {
   if (instr_debug) {
     for (auto it = code->begin(); it != code->end(); ++it) {
       if (it == insert_point) {
@@ -179,6 +165,85 @@ void instrument_onMethodBegin(DexMethod* method,
   }
 }
 
+void instrument_onMethodBegin(DexMethod* method,
+                              int index,
+                              DexMethod* method_onMethodBegin) {
+  IRCode* code = method->get_code();
+  assert(code != nullptr);
+
+  IRInstruction* const_inst = new IRInstruction(OPCODE_CONST);
+  const_inst->set_literal(index);
+  const auto reg_dest = code->allocate_temp();
+  const_inst->set_dest(reg_dest);
+
+  IRInstruction* invoke_inst = new IRInstruction(OPCODE_INVOKE_STATIC);
+  invoke_inst->set_method(method_onMethodBegin);
+  invoke_inst->set_srcs_size(1);
+  invoke_inst->set_src(0, reg_dest);
+
+  auto insert_point = get_entry_insert_point(code);
+  code->insert_before(code->insert_before(insert_point, invoke_inst),
+                      const_inst);
+  trace_insert_point(code, insert_point);
+}
+
+// Increments the call count of the method in its stats array in place,
+// without calling the analysis method. The count saturates at
+// Short.MAX_VALUE without a branch:
+//
+//   sget-object vA, sMethodStatsN
+//   const vI, index
+//   aget-short vC, vA, vI
+//   add-int/lit8 vC, vC, 1
+//   shr-int/lit8 vT, vC, 15   ; 1 only if the count overflowed
+//   sub-int vC, vC, vT
+//   aput-short vC, vA, vI
+void instrument_inline_counter(DexMethod* method,
+                               int index,
+                               DexFieldRef* array_field) {
+  IRCode* code = method->get_code();
+  assert(code != nullptr);
+
+  const auto reg_array = code->allocate_temp();
+  const auto reg_index = code->allocate_temp();
+  const auto reg_count = code->allocate_temp();
+  const auto reg_tmp = code->allocate_temp();
+
+  const std::vector<IRInstruction*> insts = {
+      (new IRInstruction(OPCODE_SGET_OBJECT))->set_field(array_field),
+      (new IRInstruction(IOPCODE_MOVE_RESULT_PSEUDO_OBJECT))
+          ->set_dest(reg_array),
+      (new IRInstruction(OPCODE_CONST))
+          ->set_literal(index)
+          ->set_dest(reg_index),
+      (new IRInstruction(OPCODE_AGET_SHORT))
+          ->set_src(0, reg_array)
+          ->set_src(1, reg_index),
+      (new IRInstruction(IOPCODE_MOVE_RESULT_PSEUDO))->set_dest(reg_count),
+      (new IRInstruction(OPCODE_ADD_INT_LIT8))
+          ->set_literal(1)
+          ->set_src(0, reg_count)
+          ->set_dest(reg_count),
+      (new IRInstruction(OPCODE_SHR_INT_LIT8))
+          ->set_literal(15)
+          ->set_src(0, reg_count)
+          ->set_dest(reg_tmp),
+      (new IRInstruction(OPCODE_SUB_INT))
+          ->set_src(0, reg_count)
+          ->set_src(1, reg_tmp)
+          ->set_dest(reg_count),
+      (new IRInstruction(OPCODE_APUT_SHORT))
+          ->set_src(0, reg_count)
+          ->set_src(1, reg_array)
+          ->set_src(2, reg_index)};
+
+  auto insert_point = get_entry_insert_point(code);
+  for (auto* insn : insts) {
+    code->insert_before(insert_point, insn);
+  }
+  trace_insert_point(code, insert_point);
+}
+
 void do_simple_method_tracing(DexClass* analysis_cls,
                               DexStoresVector& stores,
                               ConfigFiles& cfg,
@@ -349,9 +414,14 @@ void do_simple_method_tracing(DexClass* analysis_cls,
   for (size_t i = 0; i < kTotalSize; ++i) {
     TRACE(INSTRUMENT, 6, "Sharded %zu => [%zu][%zu] %s", i, (i % NUM_SHARDS),
           (i / NUM_SHARDS), SHOW(to_instrument[i]));
-    instrument_onMethodBegin(to_instrument[i],
-                             (i / NUM_SHARDS) * options.num_stats_per_method,
-                             analysis_method_map.at((i % NUM_SHARDS) + 1));
+    const int index = (i / NUM_SHARDS) * options.num_stats_per_method;
+    if (options.inline_method_counters) {
+      instrument_inline_counter(to_instrument[i], index,
+                                array_fields.at((i % NUM_SHARDS) + 1));
+    } else {
+      instrument_onMethodBegin(to_instrument[i], index,
+                               analysis_method_map.at((i % NUM_SHARDS) + 1));
+    }
   }
 
   TRACE(INSTRUMENT,
@@ -380,9 +450,12 @@ void do_simple_method_tracing(DexClass* analysis_cls,
   field =
       analysis_cls->find_field_from_simple_deobfuscated_name("sProfileType");
   always_assert(field != nullptr);
+  // Inline counters only count calls; they don't record the call order.
   InstrumentPass::patch_static_field(
       analysis_cls, field->get_name()->str(),
-      static_cast<int>(ProfileTypeFlags::SimpleMethodTracing));
+      static_cast<int>(options.inline_method_counters
+                           ? ProfileTypeFlags::MethodCallCount
+                           : ProfileTypeFlags::SimpleMethodTracing));
 
   ofs.close();
   TRACE(INSTRUMENT, 2, "Index file was written to: %s", SHOW(file_name));
@@ -574,6 +647,10 @@ void InstrumentPass::bind_config() {
        m_options.instrument_blocks_without_source_block);
   bind("instrument_only_root_store", false,
        m_options.instrument_only_root_store);
+  bind("inline_method_counters", false, m_options.inline_method_counters,
+       "For simple method tracing, increment the call counts in the stats "
+       "arrays inline instead of calling the analysis method. Call orders "
+       "are not recorded.");
 
   size_t max_analysis_methods;
   if (m_options.instrumentation_strategy == SIMPLE_METHOD_TRACING) {
@@ -76,6 +76,7 @@ class InstrumentPass : public Pass {
     bool instrument_catches;
     bool instrument_blocks_without_source_block;
     bool instrument_only_root_store;
+    bool inline_method_counters;
   };
 
  private:
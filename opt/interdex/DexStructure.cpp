@@ -82,16 +82,19 @@ unsigned estimate_linear_alloc(const DexClass* clazz) {
 }
 
 /**
- * Removes the elements of b from a. Runs in O(size(a)), so it works best if
- * size(a) << size(b).
+ * Counts the elements of a that are not in b, without materializing them.
+ * Runs in O(size(a)), so it works best if size(a) << size(b). The count stops
+ * early once it reaches the given limit, as the caller only needs to know
+ * whether the class fits.
  */
 template <typename T>
-std::unordered_set<T> set_difference(const std::unordered_set<T>& a,
-                                     const std::unordered_set<T>& b) {
-  std::unordered_set<T> result;
+size_t count_missing(const std::unordered_set<T>& a,
+                     const std::unordered_set<T>& b,
+                     size_t limit) {
+  size_t result = 0;
   for (auto& v : a) {
-    if (!b.count(v)) {
-      result.emplace(v);
+    if (!b.count(v) && ++result >= limit) {
+      break;
     }
   }
   return result;
@@ -193,31 +196,39 @@ bool DexStructure::add_class_if_fits(const MethodRefs& clazz_mrefs,
     return false;
   }
 
-  auto extra_mrefs = set_difference(clazz_mrefs, m_mrefs);
-  auto extra_frefs = set_difference(clazz_frefs, m_frefs);
-  auto extra_trefs = set_difference(clazz_trefs, m_trefs);
+  // The room left under each limit; a class fits if it brings in fewer new
+  // refs than that.
+  auto room = [](size_t size, size_t limit) {
+    return size < limit ? limit - size : 0;
+  };
 
-  if (m_mrefs.size() + extra_mrefs.size() >= method_refs_limit) {
+  auto mrefs_room = room(m_mrefs.size(), method_refs_limit);
+  auto extra_mrefs = count_missing(clazz_mrefs, m_mrefs, mrefs_room);
+  if (extra_mrefs >= mrefs_room) {
     TRACE(IDEX, 6,
           "[warning]: Class won't fit current dex since it will go "
           "over the method refs limit: %zu >= %zu: %s",
-          m_mrefs.size() + extra_mrefs.size(), method_refs_limit, SHOW(clazz));
+          m_mrefs.size() + extra_mrefs, method_refs_limit, SHOW(clazz));
     return false;
   }
 
-  if (m_frefs.size() + extra_frefs.size() >= field_refs_limit) {
+  auto frefs_room = room(m_frefs.size(), field_refs_limit);
+  auto extra_frefs = count_missing(clazz_frefs, m_frefs, frefs_room);
+  if (extra_frefs >= frefs_room) {
     TRACE(IDEX, 6,
           "[warning]: Class won't fit current dex since it will go "
           "over the field refs limit: %zu >= %zu: %s",
-          m_frefs.size() + extra_frefs.size(), field_refs_limit, SHOW(clazz));
+          m_frefs.size() + extra_frefs, field_refs_limit, SHOW(clazz));
     return false;
   }
 
-  if (m_trefs.size() + extra_trefs.size() >= type_refs_limit) {
+  auto trefs_room = room(m_trefs.size(), type_refs_limit);
+  auto extra_trefs = count_missing(clazz_trefs, m_trefs, trefs_room);
+  if (extra_trefs >= trefs_room) {
     TRACE(IDEX, 6,
           "[warning]: Class won't fit current dex since it will go "
           "over the type refs limit: %zu >= %zu: %s",
-          m_trefs.size() + extra_trefs.size(), type_refs_limit, SHOW(clazz));
+          m_trefs.size() + extra_trefs, type_refs_limit, SHOW(clazz));
     return false;
   }
 
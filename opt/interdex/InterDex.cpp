@@ -644,6 +644,42 @@ void InterDex::load_interdex_types() {
   }
 }
 
+size_t InterDex::sort_coldstart_classes_by_load_cost(
+    const std::unordered_map<const DexType*, uint64_t>& load_costs) {
+  auto get_cost = [&load_costs](const DexType* type) -> uint64_t {
+    auto it = load_costs.find(type);
+    return it == load_costs.end() ? 0 : it->second;
+  };
+  auto by_decreasing_cost = [&get_cost](const DexType* a, const DexType* b) {
+    return get_cost(a) > get_cost(b);
+  };
+
+  auto coldstart_end = m_interdex_types.end();
+  if (!m_end_markers.empty()) {
+    coldstart_end = std::find(m_interdex_types.begin(), m_interdex_types.end(),
+                              m_end_markers.back());
+  }
+  size_t costed_classes = 0;
+  auto run_begin = m_interdex_types.begin();
+  for (auto it = m_interdex_types.begin();; ++it) {
+    // Markers don't have a class.
+    if (it == coldstart_end || type_class(*it) == nullptr) {
+      std::stable_sort(run_begin, it, by_decreasing_cost);
+      if (it == coldstart_end) {
+        break;
+      }
+      run_begin = std::next(it);
+      continue;
+    }
+    if (load_costs.count(*it)) {
+      ++costed_classes;
+    }
+  }
+  TRACE(IDEX, 2, "[interdex order]: Sorted %zu cold start classes by cost",
+        costed_classes);
+  return costed_classes;
+}
+
 void InterDex::update_interdexorder(const DexClasses& dex,
                                     std::vector<DexType*>* interdex_types) {
   std::vector<DexType*> primary_dex;
@@ -737,6 +773,7 @@ void InterDex::init_cross_dex_ref_minimizer_and_relocate_methods() {
   }
 
   // Initialize ref frequency counts
+  m_cross_dex_ref_minimizer.prefetch_refs(classes_to_insert);
   for (DexClass* cls : classes_to_insert) {
     m_cross_dex_ref_minimizer.sample(cls);
   }
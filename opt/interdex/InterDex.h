@@ -116,6 +116,16 @@ class InterDex {
     return m_interdex_types;
   }
 
+  /**
+   * Within each run of classes of the cold start part of the interdex order
+   * (i.e. between any two markers, up to the cold start end marker), moves
+   * the classes with the highest load cost first. Classes without a cost
+   * keep their relative order after the others. Returns the number of cold
+   * start classes with a cost.
+   */
+  size_t sort_coldstart_classes_by_load_cost(
+      const std::unordered_map<const DexType*, uint64_t>& load_costs);
+
   size_t get_current_classes_when_emitting_remaining() const {
     return m_current_classes_when_emitting_remaining;
   }
@@ -7,6 +7,10 @@
 
 #include "InterDexPass.h"
 
+#include <fstream>
+#include <numeric>
+#include <sstream>
+
 #include "ConfigFiles.h"
 #include "DexClass.h"
 #include "DexUtil.h"
@@ -33,6 +37,39 @@ void treat_generated_stores(DexStoresVector& stores,
   });
 }
 
+/**
+ * Reads per-class load costs, one `<class descriptor> <cost>` pair per line,
+ * e.g. as derived from heap dumps (tools/hprof) or oat statistics
+ * (tools/oatmeal). Empty lines and lines starting with `#` are skipped, and
+ * so are classes that don't exist.
+ */
+std::unordered_map<const DexType*, uint64_t> load_class_load_costs(
+    const std::string& path) {
+  std::ifstream input(path);
+  always_assert_log(input.is_open(), "Cannot open class load costs file %s",
+                    path.c_str());
+  std::unordered_map<const DexType*, uint64_t> load_costs;
+  std::string line;
+  size_t line_number = 0;
+  while (std::getline(input, line)) {
+    ++line_number;
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::istringstream fields(line);
+    std::string descriptor;
+    uint64_t cost;
+    always_assert_log(fields >> descriptor >> cost,
+                      "Malformed class load cost at %s:%zu: %s",
+                      path.c_str(), line_number, line.c_str());
+    auto type = DexType::get_type(descriptor);
+    if (type != nullptr) {
+      load_costs[type] += cost;
+    }
+  }
+  return load_costs;
+}
+
 } // namespace
 
 namespace interdex {
@@ -109,6 +146,10 @@ void InterDexPass::bind_config() {
        m_method_for_canary_clinit_reference,
        "If set, canary classes will have a clinit generated which call the "
        "specified method, if it exists");
+  bind("class_load_costs", "", m_class_load_costs_path,
+       "Path to a file of measured class load costs, one `<class descriptor> "
+       "<cost>` pair per line. If set, the cold start classes of each dex are "
+       "laid out by decreasing cost, keeping the costliest ones together.");
 
   trait(Traits::Pass::unique, true);
 }
@@ -142,6 +183,12 @@ void InterDexPass::run_pass(
         "Either no betamap was provided, or an empty list was passed in. FIX!");
   }
 
+  if (!m_class_load_costs_path.empty()) {
+    mgr.set_metric(METRIC_COLDSTART_CLASSES_WITH_LOAD_COST,
+                   interdex.sort_coldstart_classes_by_load_cost(
+                       load_class_load_costs(m_class_load_costs_path)));
+  }
+
   interdex.run();
   treat_generated_stores(stores, &interdex);
   dexen = interdex.take_outdex();
@@ -193,12 +240,13 @@ void InterDexPass::run_pass(
                  interdex.get_current_classes_when_emitting_remaining());
 }
 
-void InterDexPass::run_pass_on_nonroot_store(const Scope& original_scope,
-                                             const XStoreRefs& xstore_refs,
-                                             DexClassesVector& dexen,
-                                             ConfigFiles& conf,
-                                             PassManager& mgr,
-                                             const ReserveRefsInfo& refs_info) {
+size_t InterDexPass::run_pass_on_nonroot_store(
+    const Scope& original_scope,
+    const XStoreRefs& xstore_refs,
+    DexClassesVector& dexen,
+    ConfigFiles& conf,
+    PassManager& mgr,
+    const ReserveRefsInfo& refs_info) {
   // Setup default configs for non-root store
   // For now, no plugins configured for non-root stores to run.
   std::vector<std::unique_ptr<InterDexPassPlugin>> plugins;
@@ -223,6 +271,7 @@ void InterDexPass::run_pass_on_nonroot_store(const Scope& original_scope,
   interdex.run_on_nonroot_store();
 
   dexen = interdex.take_outdex();
+  return dexen.size();
 }
 
 void InterDexPass::run_pass(DexStoresVector& stores,
@@ -252,22 +301,43 @@ void InterDexPass::run_pass(DexStoresVector& stores,
     refs_info.mrefs += plugin->reserve_mrefs();
   }
 
-  std::vector<DexStore*> parallel_stores;
+  auto num_classes = [](const DexStore& store) {
+    size_t count = 0;
+    for (const auto& dex : store.get_dexen()) {
+      count += dex.size();
+    }
+    return count;
+  };
+  std::vector<std::pair<size_t, DexStore*>> sized_stores;
   for (auto& store : stores) {
     if (store.is_root_store()) {
       run_pass(original_scope, xstore_refs, stores, store.get_dexen(), plugins,
                conf, mgr, refs_info);
     } else if (!store.is_generated()) {
-      parallel_stores.push_back(&store);
+      sized_stores.emplace_back(num_classes(store), &store);
     }
   }
 
-  workqueue_run<DexStore*>(
-      [&](DexStore* store) {
-        run_pass_on_nonroot_store(original_scope, xstore_refs,
-                                  store->get_dexen(), conf, mgr, refs_info);
+  // Non-root stores are packed independently. Start with the largest ones so
+  // that a big store doesn't end up running alone at the end.
+  std::stable_sort(
+      sized_stores.begin(), sized_stores.end(),
+      [](const auto& a, const auto& b) { return a.first > b.first; });
+  // Workers only write to their own slot. Results are merged afterwards.
+  std::vector<size_t> store_dexes(sized_stores.size(), 0);
+  std::vector<size_t> indices(sized_stores.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  workqueue_run<size_t>(
+      [&](size_t i) {
+        store_dexes[i] = run_pass_on_nonroot_store(
+            original_scope, xstore_refs, sized_stores[i].second->get_dexen(),
+            conf, mgr, refs_info);
       },
-      parallel_stores);
+      indices);
+  mgr.incr_metric(METRIC_NONROOT_STORES, sized_stores.size());
+  mgr.incr_metric(METRIC_NONROOT_STORE_DEXES,
+                  std::accumulate(store_dexes.begin(), store_dexes.end(),
+                                  size_t(0)));
 
   ++m_run;
   // For the last invocation, record that final interdex has been done.
@@ -44,6 +44,11 @@ constexpr const char* METRIC_RELOCATED_VIRTUAL_METHODS =
 constexpr const char* METRIC_CURRENT_CLASSES_WHEN_EMITTING_REMAINING =
     "num_current_classes_when_emitting_remaining";
 
+constexpr const char* METRIC_COLDSTART_CLASSES_WITH_LOAD_COST =
+    "num_coldstart_classes_with_load_cost";
+
+constexpr const char* METRIC_NONROOT_STORES = "num_nonroot_stores";
+constexpr const char* METRIC_NONROOT_STORE_DEXES = "num_nonroot_store_dexes";
 constexpr const char* METRIC_RESERVED_FREFS = "reserved_frefs";
 constexpr const char* METRIC_RESERVED_TREFS = "reserved_trefs";
 constexpr const char* METRIC_RESERVED_MREFS = "reserved_mrefs";
@@ -96,6 +101,7 @@ class InterDexPass : public Pass {
   bool m_expect_order_list;
   bool m_sort_remaining_classes;
   std::string m_method_for_canary_clinit_reference;
+  std::string m_class_load_costs_path;
 
   size_t m_run{0}; // Which iteration of `run_pass`.
   size_t m_eval{0}; // How many `eval_pass` iterations.
@@ -109,12 +115,14 @@ class InterDexPass : public Pass {
                         PassManager&,
                         const ReserveRefsInfo&);
 
-  void run_pass_on_nonroot_store(const Scope&,
-                                 const XStoreRefs&,
-                                 DexClassesVector&,
-                                 ConfigFiles&,
-                                 PassManager&,
-                                 const ReserveRefsInfo&);
+  // Returns the number of dexes of the store. Runs concurrently for
+  // different stores, so it must not touch shared state.
+  size_t run_pass_on_nonroot_store(const Scope&,
+                                   const XStoreRefs&,
+                                   DexClassesVector&,
+                                   ConfigFiles&,
+                                   PassManager&,
+                                   const ReserveRefsInfo&);
 };
 
 } // namespace interdex
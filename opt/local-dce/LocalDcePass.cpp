@@ -22,9 +22,12 @@
 #include "IRCode.h"
 #include "IRInstruction.h"
 #include "MethodOverrideGraph.h"
+#include "MethodOverrideGraphAnalysis.h"
 #include "PassManager.h"
 #include "Purity.h"
+#include "PurityAnalysis.h"
 #include "Resolver.h"
+#include "SideEffectSummaryAnalysis.h"
 #include "StlUtil.h"
 #include "Trace.h"
 #include "Transform.h"
@@ -45,6 +48,8 @@ constexpr const char* METRIC_COMPUTED_NO_SIDE_EFFECTS_METHODS =
     "num_computed_no_side_effects_methods";
 constexpr const char* METRIC_COMPUTED_NO_SIDE_EFFECTS_METHODS_ITERATIONS =
     "num_computed_no_side_effects_methods_iterations";
+constexpr const char* METRIC_SUMMARIZED_NO_SIDE_EFFECTS_METHODS =
+    "num_summarized_no_side_effects_methods";
 
 } // namespace
 
@@ -52,24 +57,42 @@ void LocalDcePass::run_pass(DexStoresVector& stores,
                             ConfigFiles& conf,
                             PassManager& mgr) {
   auto scope = build_class_scope(stores);
-  auto pure_methods = get_pure_methods();
-  auto configured_pure_methods = conf.get_pure_methods();
-  pure_methods.insert(configured_pure_methods.begin(),
-                      configured_pure_methods.end());
-  auto immutable_getters = get_immutable_getters(scope);
-  pure_methods.insert(immutable_getters.begin(), immutable_getters.end());
-  std::unique_ptr<const method_override_graph::Graph> override_graph;
+  auto preserved = PurityAnalysisPass::get_preserved_result(&mgr);
+  auto pure_methods =
+      preserved ? preserved->pure_methods
+                : PurityAnalysisPass::get_default_pure_methods(scope, conf);
+  std::shared_ptr<const method_override_graph::Graph> override_graph;
   std::unordered_set<const DexMethod*> computed_no_side_effects_methods;
   size_t computed_no_side_effects_methods_iterations = 0;
+  size_t summarized_no_side_effects_methods = 0;
   if (!mgr.unreliable_virtual_scopes()) {
-    override_graph = method_override_graph::build_graph(scope);
-    computed_no_side_effects_methods_iterations =
-        compute_no_side_effects_methods(scope, override_graph.get(),
-                                        pure_methods,
-                                        &computed_no_side_effects_methods);
+    override_graph = MethodOverrideGraphAnalysisPass::get_or_build(&mgr, scope);
+    if (preserved) {
+      computed_no_side_effects_methods = preserved->no_side_effects_methods;
+      computed_no_side_effects_methods_iterations =
+          preserved->no_side_effects_methods_iterations;
+    } else {
+      computed_no_side_effects_methods_iterations =
+          compute_no_side_effects_methods(scope, override_graph.get(),
+                                          pure_methods,
+                                          &computed_no_side_effects_methods);
+    }
     for (auto m : computed_no_side_effects_methods) {
       pure_methods.insert(const_cast<DexMethod*>(m));
     }
+    // The side effect summaries also know about methods that only write to
+    // objects they allocate themselves.
+    auto summaries = SideEffectSummaryAnalysisPass::get_preserved_result(&mgr);
+    if (summaries != nullptr) {
+      auto summarized_methods =
+          SideEffectSummaryAnalysisPass::get_no_side_effects_methods(
+              *summaries, *override_graph);
+      for (auto m : summarized_methods) {
+        if (pure_methods.insert(const_cast<DexMethod*>(m)).second) {
+          summarized_no_side_effects_methods++;
+        }
+      }
+    }
   }
 
   bool may_allocate_registers = !mgr.regalloc_has_run();
@@ -105,6 +128,8 @@ void LocalDcePass::run_pass(DexStoresVector& stores,
                   computed_no_side_effects_methods.size());
   mgr.incr_metric(METRIC_COMPUTED_NO_SIDE_EFFECTS_METHODS_ITERATIONS,
                   computed_no_side_effects_methods_iterations);
+  mgr.incr_metric(METRIC_SUMMARIZED_NO_SIDE_EFFECTS_METHODS,
+                  summarized_no_side_effects_methods);
 
   TRACE(DCE, 1,
         "instructions removed -- npe: %zu, dead: %zu, unreachable: %zu; "
@@ -7,12 +7,29 @@
 
 #pragma once
 
+#include "AnalysisUsage.h"
 #include "LocalDce.h"
+#include "MethodOverrideGraphAnalysis.h"
 #include "Pass.h"
+#include "PurityAnalysis.h"
+#include "SideEffectSummaryAnalysis.h"
+#include "SubtypeIndexAnalysis.h"
 
 class LocalDcePass : public Pass {
  public:
   LocalDcePass() : Pass("LocalDcePass") {}
 
   void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
+
+  void set_analysis_usage(AnalysisUsage& au) const override {
+    Pass::set_analysis_usage(au);
+    // Works on CFGs only, through cfg::ScopedCFG.
+    au.set_requires_linear_ir(false);
+    // Only rewrites method bodies; leaves methods and classes alone.
+    au.add_preserve_specific<MethodOverrideGraphAnalysisPass>();
+    au.add_preserve_specific<SubtypeIndexAnalysisPass>();
+    // Removing dead instructions only makes methods more pure.
+    au.add_preserve_specific<PurityAnalysisPass>();
+    au.add_preserve_specific<SideEffectSummaryAnalysisPass>();
+  }
 };
@@ -8,6 +8,7 @@
 #include <list>
 
 #include "ClassHierarchy.h"
+#include "ConcurrentContainers.h"
 #include "DexClass.h"
 #include "DexUtil.h"
 #include "IRCode.h"
@@ -79,26 +80,30 @@ template <typename DexMember,
           typename K>
 DexMember* find_renamable_ref(
     DexMemberRef* ref,
-    std::unordered_map<DexMemberRef*, DexMember*>& ref_def_cache,
+    ConcurrentMap<DexMemberRef*, DexMember*>& ref_def_cache,
     DexElemManager<DexMember*, DexMemberRef*, DexMemberSpec, K>& name_mapping) {
   TRACE(OBFUSCATE, 4, "Found a ref opcode");
   DexMember* def = nullptr;
-  auto member_itr = ref_def_cache.find(ref);
-  if (member_itr != ref_def_cache.end()) {
-    def = member_itr->second;
-  } else {
-    def = name_mapping.def_of_ref(ref);
-  }
-  ref_def_cache[ref] = def;
+  ref_def_cache.update(
+      ref, [&](DexMemberRef*, DexMember*& cached_def, bool exists) {
+        if (!exists) {
+          cached_def = name_mapping.def_of_ref(ref);
+        }
+        def = cached_def;
+      });
   return def;
 }
 
 void update_refs(Scope& scope,
                  DexFieldManager& field_name_mapping,
                  DexMethodManager& method_name_mapping) {
-  std::unordered_map<DexFieldRef*, DexField*> f_ref_def_cache;
-  std::unordered_map<DexMethodRef*, DexMethod*> m_ref_def_cache;
-  walk::opcodes(scope, [&](DexMethod*, IRInstruction* instr) {
+  // The names are all picked at this point, and the name managers are only
+  // looked up, so the refs are updated in parallel.
+  field_name_mapping.update_links();
+  method_name_mapping.update_links();
+  ConcurrentMap<DexFieldRef*, DexField*> f_ref_def_cache;
+  ConcurrentMap<DexMethodRef*, DexMethod*> m_ref_def_cache;
+  walk::parallel::opcodes(scope, [&](DexMethod*, IRInstruction* instr) {
     auto op = instr->opcode();
     if (instr->has_field()) {
       DexFieldRef* field_ref = instr->get_field();
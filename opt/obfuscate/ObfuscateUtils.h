@@ -139,11 +139,14 @@ class MethodNameWrapper : public DexMethodWrapper {
   bool renamable = true;
 
   // Updates our links union-find style so that finding the end of the chain
-  // is cheap
+  // is cheap. Links that are already up to date are not written to.
   inline void update_link() {
     if (next != nullptr) {
       next->update_link();
-      next = find_end_link();
+      auto end = find_end_link();
+      if (next != end) {
+        next = end;
+      }
     }
   }
 
@@ -526,9 +529,8 @@ class DexElemManager {
   // void lock_elements() { mark_all_unrenamable = true; }
   // void unlock_elements() { mark_all_unrenamable = false; }
 
-  inline bool contains_elem(DexType* cls, K sig, DexString* name) {
-    return elements.count(cls) > 0 && elements[cls].count(sig) > 0 &&
-           elements[cls][sig].count(name) > 0;
+  inline bool contains_elem(DexType* cls, K sig, DexString* name) const {
+    return find_wrapper(cls, sig, name) != nullptr;
   }
 
   inline bool contains_elem(R elem) {
@@ -555,6 +557,19 @@ class DexElemManager {
                                : emplace(elem);
   }
 
+  // Brings the links between wrappers up to date, after which looking up
+  // wrappers, e.g. with def_of_ref, doesn't write to them and can happen in
+  // parallel.
+  void update_links() {
+    for (auto& class_itr : elements) {
+      for (auto& type_itr : class_itr.second) {
+        for (auto& name_wrap : type_itr.second) {
+          name_wrap.second->name_has_changed();
+        }
+      }
+    }
+  }
+
   // Commits all the renamings in elements to the dex by modifying the
   // underlying DexFields. Does in-place modification. Returns the number
   // of elements renamed
@@ -595,14 +610,24 @@ class DexElemManager {
   }
 
  private:
+  // Lookups don't insert into elements, so that refs can be resolved to their
+  // defs in parallel once all the names are picked.
+  DexNameWrapper<T>* find_wrapper(DexType* cls, K sig, DexString* name) const {
+    auto cls_it = elements.find(cls);
+    if (cls_it == elements.end()) return nullptr;
+    auto sig_it = cls_it->second.find(sig);
+    if (sig_it == cls_it->second.end()) return nullptr;
+    auto name_it = sig_it->second.find(name);
+    if (name_it == sig_it->second.end()) return nullptr;
+    return name_it->second.get();
+  }
+
   // Returns the def for that class and ref if it exists, nullptr otherwise
   T find_def(R ref, DexType* cls) {
     if (cls == nullptr) return nullptr;
-    if (contains_elem(cls, sig_getter_fn(ref), ref->get_name())) {
-      DexNameWrapper<T>* wrap =
-          elements[cls][sig_getter_fn(ref)][ref->get_name()].get();
-      if (wrap->is_modified()) return wrap->get();
-    }
+    DexNameWrapper<T>* wrap =
+        find_wrapper(cls, sig_getter_fn(ref), ref->get_name());
+    if (wrap != nullptr && wrap->is_modified()) return wrap->get();
     return nullptr;
   }
 
@@ -6,6 +6,7 @@
  */
 
 #include "VirtualRenamer.h"
+#include "ConcurrentContainers.h"
 #include "DexAccess.h"
 #include "DexClass.h"
 #include "DexUtil.h"
@@ -111,13 +112,15 @@ using RefsMap =
 // const std::string prefix = __Redex__";
 const std::string prefix;
 
-DexString* get_name(int seed) {
+// Only the names that are picked are made into DexStrings, the candidates that
+// collide are not interned.
+std::string get_name(int seed) {
   std::string name;
   obfuscate_utils::compute_identifier(seed, &name);
   if (!prefix.empty()) {
     name = prefix + name;
   }
-  return DexString::make_string(name);
+  return name;
 }
 
 struct VirtualRenamer {
@@ -151,6 +154,11 @@ struct VirtualRenamer {
   std::unordered_map<const DexType*, std::string>* external_name_cache;
   const std::unordered_map<const DexClass*, int>& next_dmethod_seeds;
   mutable std::unordered_map<const VirtualScope*, int> next_virtualscope_seeds;
+  // The root of a virtual scope and all its children, in which the names of
+  // the scope must not collide. Each candidate name is checked against them,
+  // so they are computed once per root.
+  mutable std::unordered_map<const DexType*, std::vector<const DexType*>>
+      hierarchies;
 
  private:
   const std::string& get_prefix(const DexType* type) const {
@@ -185,7 +193,8 @@ struct VirtualRenamer {
   DexString* get_unescaped_name(const std::vector<const VirtualScope*>& scopes,
                                 int& seed) const;
   DexString* get_unescaped_name(const VirtualScope* scope, int& seed) const;
-  bool usable_name(DexString* name, const VirtualScope* scope) const;
+  const std::vector<const DexType*>& get_hierarchy(const DexType* root) const;
+  bool usable_name(const std::string& name, const VirtualScope* scope) const;
 };
 
 /**
@@ -255,24 +264,37 @@ int VirtualRenamer::rename_scope(const VirtualScope* scope, DexString* name) {
   return renamed;
 }
 
+const std::vector<const DexType*>& VirtualRenamer::get_hierarchy(
+    const DexType* root) const {
+  auto it = hierarchies.find(root);
+  if (it != hierarchies.end()) {
+    return it->second;
+  }
+  auto hier = get_all_children(class_scopes.get_class_hierarchy(), root);
+  hier.insert(root);
+  return hierarchies
+      .emplace(root, std::vector<const DexType*>(hier.begin(), hier.end()))
+      .first->second;
+}
+
 /**
  * A name is usable if it does not collide with an existing
  * one in the def and ref space.
  */
-bool VirtualRenamer::usable_name(DexString* name,
+bool VirtualRenamer::usable_name(const std::string& name,
                                  const VirtualScope* scope) const {
-  const auto root = scope->type;
   const auto proto = scope->methods[0].first->get_proto();
-  auto hier = get_all_children(class_scopes.get_class_hierarchy(), root);
-  hier.insert(root);
+  // No method can have a name that was never made into a DexString.
+  auto dex_name = DexString::get_string(name);
   bool has_ste = stack_trace_elements != nullptr;
-  for (const auto& type : hier) {
-    if (DexMethod::get_method(const_cast<DexType*>(type), name, proto) !=
-        nullptr) {
+  for (const auto& type : get_hierarchy(scope->type)) {
+    if (dex_name != nullptr &&
+        DexMethod::get_method(const_cast<DexType*>(type), dex_name, proto) !=
+            nullptr) {
       return false;
     }
     if (has_ste) {
-      auto ste = get_prefix(type) + name->str();
+      auto ste = get_prefix(type) + name;
       if (stack_trace_elements->find(ste) != stack_trace_elements->end()) {
         return false;
       }
@@ -293,7 +315,7 @@ DexString* VirtualRenamer::get_unescaped_name(const VirtualScope* scope,
   while (!usable_name(name, scope)) {
     name = get_name(seed++);
   }
-  return name;
+  return DexString::make_string(name);
 }
 
 /*
@@ -312,7 +334,7 @@ DexString* VirtualRenamer::get_unescaped_name(
     for (const auto& scope : scopes) {
       if (!usable_name(name, scope)) goto next_name;
     }
-    return name;
+    return DexString::make_string(name);
   next_name:;
   }
 }
@@ -464,7 +486,8 @@ int VirtualRenamer::rename_virtual_scopes(const DexType* type, int& seed) {
  * Collect all method refs to concrete methods (definitions).
  */
 void collect_refs(Scope& scope, RefsMap& def_refs) {
-  walk::opcodes(
+  ConcurrentMap<DexMethod*, RefsMap::mapped_type> concurrent_def_refs;
+  walk::parallel::opcodes(
       scope, [](DexMethod*) { return true; },
       [&](DexMethod*, IRInstruction* insn) {
         if (!insn->has_method()) return;
@@ -491,8 +514,14 @@ void collect_refs(Scope& scope, RefsMap& def_refs) {
         redex_assert(type_class(top->get_class()) != nullptr);
         if (type_class(top->get_class())->is_external()) return;
         // it's a top definition on an internal class, save it
-        def_refs[top].insert(callee);
+        concurrent_def_refs.update(
+            top, [callee](DexMethod*, RefsMap::mapped_type& refs, bool) {
+              refs.insert(callee);
+            });
       });
+  for (auto& pair : concurrent_def_refs) {
+    def_refs.emplace(pair.first, std::move(pair.second));
+  }
 }
 
 } // namespace
@@ -7,15 +7,12 @@
 
 #include "ObjectSensitiveDcePass.h"
 
-#include <fstream>
 #include <functional>
 
-#include "ConcurrentContainers.h"
 #include "DexUtil.h"
-#include "HierarchyUtil.h"
 #include "LocalPointersAnalysis.h"
 #include "PassManager.h"
-#include "SummarySerialization.h"
+#include "Show.h"
 #include "Transform.h"
 #include "Walkers.h"
 
@@ -38,62 +35,9 @@
  * to run.
  */
 
-namespace hier = hierarchy_util;
 namespace ptrs = local_pointers;
 namespace uv = used_vars;
 
-class CallGraphStrategy final : public call_graph::BuildStrategy {
- public:
-  explicit CallGraphStrategy(const Scope& scope)
-      : m_scope(scope),
-        m_non_overridden_virtuals(hier::find_non_overridden_virtuals(scope)) {}
-
-  call_graph::CallSites get_callsites(const DexMethod* method) const override {
-    call_graph::CallSites callsites;
-    auto* code = const_cast<IRCode*>(method->get_code());
-    if (code == nullptr) {
-      return callsites;
-    }
-    for (auto& mie : InstructionIterable(code)) {
-      auto insn = mie.insn;
-      if (opcode::is_an_invoke(insn->opcode())) {
-        auto callee = resolve_method(insn->get_method(), opcode_to_search(insn),
-                                     m_resolved_refs, method);
-        if (callee == nullptr || may_be_overridden(callee)) {
-          continue;
-        }
-        callsites.emplace_back(callee, insn);
-      }
-    }
-    return callsites;
-  }
-
-  // XXX(jezng): We make every single method a root in order that all methods
-  // are seen as reachable. Unreachable methods will not have `get_callsites`
-  // run on them and will not have their outgoing edges added to the call graph,
-  // which means that the dead code removal will not optimize them fully. I'm
-  // not sure why these "unreachable" methods are not ultimately removed by RMU,
-  // but as it stands, properly optimizing them is a size win for us.
-  call_graph::RootAndDynamic get_roots() const override {
-    call_graph::RootAndDynamic root_and_dynamic;
-    auto& roots = root_and_dynamic.roots;
-
-    walk::code(m_scope, [&](DexMethod* method, IRCode& code) {
-      roots.emplace_back(method);
-    });
-    return root_and_dynamic;
-  }
-
- private:
-  bool may_be_overridden(DexMethod* method) const {
-    return method->is_virtual() && m_non_overridden_virtuals.count(method) == 0;
-  }
-
-  const Scope& m_scope;
-  std::unordered_set<const DexMethod*> m_non_overridden_virtuals;
-  mutable MethodRefCache m_resolved_refs;
-};
-
 static side_effects::InvokeToSummaryMap build_summary_map(
     const side_effects::SummaryMap& effect_summaries,
     const call_graph::Graph& call_graph,
@@ -123,25 +67,15 @@ void ObjectSensitiveDcePass::run_pass(DexStoresVector& stores,
     code.cfg().calculate_exit_block();
   });
 
-  auto call_graph = call_graph::Graph(CallGraphStrategy(scope));
-
-  ptrs::SummaryMap escape_summaries;
-  if (m_external_escape_summaries_file) {
-    std::ifstream file_input(*m_external_escape_summaries_file);
-    summary_serialization::read(file_input, &escape_summaries);
-  }
-  ptrs::SummaryCMap escape_summaries_cmap(escape_summaries.begin(),
-                                          escape_summaries.end());
-  auto ptrs_fp_iter_map =
-      ptrs::analyze_scope(scope, call_graph, &escape_summaries_cmap);
+  auto call_graph = SideEffectSummaryAnalysisPass::build_call_graph(scope);
 
-  side_effects::SummaryMap effect_summaries;
-  if (m_external_side_effect_summaries_file) {
-    std::ifstream file_input(*m_external_side_effect_summaries_file);
-    summary_serialization::read(file_input, &effect_summaries);
+  auto summaries = SideEffectSummaryAnalysisPass::get_preserved_result(&mgr);
+  if (summaries == nullptr) {
+    summaries =
+        SideEffectSummaryAnalysisPass::analyze(m_config, scope, call_graph);
   }
-  side_effects::analyze_scope(scope, call_graph, *ptrs_fp_iter_map,
-                              &effect_summaries);
+  const auto& escape_summaries_cmap = summaries->escape_summaries;
+  const auto& effect_summaries = summaries->effect_summaries;
 
   auto removed =
       walk::parallel::methods<size_t>(scope, [&](DexMethod* method) -> size_t {
@@ -153,8 +87,10 @@ void ObjectSensitiveDcePass::run_pass(DexStoresVector& stores,
           return 0;
         }
 
+        auto ptrs_fp_iter =
+            ptrs::analyze_method(method, call_graph, escape_summaries_cmap);
         uv::FixpointIterator used_vars_fp_iter(
-            *ptrs_fp_iter_map->find(method)->second,
+            *ptrs_fp_iter,
             build_summary_map(effect_summaries, call_graph, method),
             code->cfg());
         used_vars_fp_iter.run(uv::UsedVarsSet());
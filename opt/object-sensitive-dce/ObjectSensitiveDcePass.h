@@ -9,10 +9,12 @@
 
 #include <boost/optional.hpp>
 
+#include "AnalysisUsage.h"
 #include "CallGraph.h"
 #include "LocalPointersAnalysis.h"
 #include "Pass.h"
 #include "SideEffectSummary.h"
+#include "SideEffectSummaryAnalysis.h"
 #include "Trace.h"
 #include "UsedVarsAnalysis.h"
 
@@ -22,23 +24,34 @@ class ObjectSensitiveDcePass final : public Pass {
 
   void bind_config() override {
     bind("side_effect_summaries", {boost::none},
-         m_external_side_effect_summaries_file, "TODO: Document me!",
+         m_config.external_side_effect_summaries_file, "TODO: Document me!",
          Configurable::bindflags::optionals::skip_empty_string);
-    bind("escape_summaries", {boost::none}, m_external_escape_summaries_file,
-         "TODO: Document me!",
+    bind("escape_summaries", {boost::none},
+         m_config.external_escape_summaries_file, "TODO: Document me!",
          Configurable::bindflags::optionals::skip_empty_string);
-
-    if (!m_external_escape_summaries_file ||
-        !m_external_side_effect_summaries_file) {
+    bind("escape_analysis_memory_budget",
+         m_config.escape_analysis_memory_budget,
+         m_config.escape_analysis_memory_budget,
+         "Upper bound on the estimated size of the pointer analyses running "
+         "at the same time, in register bindings.");
+
+    if (!m_config.external_escape_summaries_file ||
+        !m_config.external_side_effect_summaries_file) {
       TRACE(OSDCE, 1,
             "WARNING: External summary file missing; OSDCE will make "
             "conservative assumptions about system & third-party code.");
     }
   }
 
+  void set_analysis_usage(AnalysisUsage& au) const override {
+    Pass::set_analysis_usage(au);
+    // Removing dead instructions keeps the summaries sound. The preserved
+    // summaries are used instead of the ones of this pass's config.
+    au.add_preserve_specific<SideEffectSummaryAnalysisPass>();
+  }
+
   void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
 
  private:
-  boost::optional<std::string> m_external_side_effect_summaries_file;
-  boost::optional<std::string> m_external_escape_summaries_file;
+  SideEffectSummaryAnalysisPass::Config m_config;
 };
@@ -20,9 +20,6 @@ namespace ptrs = local_pointers;
 
 namespace side_effects {
 
-using PointersFixpointIteratorMap =
-    ConcurrentMap<const DexMethodRef*, ptrs::FixpointIterator*>;
-
 using SummaryConcurrentMap = ConcurrentMap<const DexMethodRef*, Summary>;
 
 SummaryBuilder::SummaryBuilder(
@@ -218,37 +215,32 @@ void SummaryBuilder::classify_heap_write(const ptrs::Environment& env,
 }
 
 /*
- * Analyze :method and insert its summary into :summary_cmap. Recursively
- * analyze the callees if necessary. This method is thread-safe.
+ * Summarize :method given the current pointer analysis of its body, assuming
+ * that the summaries of its callees are already in :summary_cmap. This method
+ * is thread-safe.
  */
-void analyze_method_recursive(const DexMethod* method,
-                              const call_graph::Graph& call_graph,
-                              const ptrs::FixpointIteratorMap& ptrs_fp_iter_map,
-                              PatriciaTreeSet<const DexMethodRef*> visiting,
-                              SummaryConcurrentMap* summary_cmap) {
-  if (!method || summary_cmap->count(method) != 0 ||
-      visiting.contains(method) || method->get_code() == nullptr) {
+void analyze_method(const DexMethod* method,
+                    const call_graph::Graph& call_graph,
+                    const ptrs::FixpointIterator& ptrs_fp_iter,
+                    SummaryConcurrentMap* summary_cmap) {
+  if (summary_cmap->count(method) != 0) {
     return;
   }
-  visiting.insert(method);
 
   InvokeToSummaryMap invoke_to_summary_cmap;
   if (call_graph.has_node(method)) {
     const auto& callee_edges = call_graph.node(method)->callees();
     for (const auto& edge : callee_edges) {
       auto* callee = edge->callee()->method();
-      analyze_method_recursive(callee, call_graph, ptrs_fp_iter_map, visiting,
-                               summary_cmap);
-      if (summary_cmap->count(callee) != 0) {
-        invoke_to_summary_cmap.emplace(edge->invoke_insn(),
-                                       summary_cmap->at(callee));
+      auto it = summary_cmap->find(callee);
+      if (it != summary_cmap->end()) {
+        invoke_to_summary_cmap.emplace(edge->invoke_insn(), it->second);
       }
     }
   }
 
-  const auto* ptrs_fp_iter = ptrs_fp_iter_map.find(method)->second;
   auto summary =
-      SummaryBuilder(invoke_to_summary_cmap, *ptrs_fp_iter, method->get_code())
+      SummaryBuilder(invoke_to_summary_cmap, ptrs_fp_iter, method->get_code())
           .build();
   if (method->rstate.no_optimizations()) {
     summary.effects |= EFF_NO_OPTIMIZE;
@@ -275,12 +267,11 @@ Summary analyze_code(const InvokeToSummaryMap& invoke_to_summary_cmap,
   return SummaryBuilder(invoke_to_summary_cmap, ptrs_fp_iter, code).build();
 }
 
-void analyze_scope(
-    const Scope& scope,
-    const call_graph::Graph& call_graph,
-    const ConcurrentMap<const DexMethodRef*, ptrs::FixpointIterator*>&
-        ptrs_fp_iter_map,
-    SummaryMap* effect_summaries) {
+void analyze_scope(const Scope& scope,
+                   const call_graph::Graph& call_graph,
+                   ptrs::SummaryCMap* escape_summaries,
+                   SummaryMap* effect_summaries,
+                   size_t memory_budget) {
   // This method is special: the bytecode verifier requires that this method
   // be called before a newly-allocated object gets used in any way. We can
   // model this by treating the method as modifying its `this` parameter --
@@ -293,11 +284,15 @@ void analyze_scope(
     summary_cmap.insert(pair);
   }
 
-  walk::parallel::code(scope, [&](const DexMethod* method, IRCode& code) {
-    PatriciaTreeSet<const DexMethodRef*> visiting;
-    analyze_method_recursive(method, call_graph, ptrs_fp_iter_map, visiting,
-                             &summary_cmap);
-  });
+  // The pointer analysis visits callees before their callers, and publishes
+  // the escape summary of a method only after this consumer has seen it, so
+  // the effect summaries of the callees are ready too.
+  ptrs::analyze_scope_summaries(
+      scope, call_graph, escape_summaries,
+      [&](const DexMethod* method, const ptrs::FixpointIterator& fp_iter) {
+        analyze_method(method, call_graph, fp_iter, &summary_cmap);
+      },
+      memory_budget);
 
   for (auto& pair : summary_cmap) {
     effect_summaries->insert(pair);
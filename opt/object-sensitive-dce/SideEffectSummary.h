@@ -124,12 +124,15 @@ Summary analyze_code(const InvokeToSummaryMap& invoke_to_summary_cmap,
                      const IRCode* code);
 
 /*
- * Get the effect summary for all methods in scope.
+ * Get the effect summary for all methods in scope. The escape summaries are
+ * computed along the way, with local_pointers::analyze_scope_summaries(), and
+ * the pointer analysis of each method is dropped once its effect summary has
+ * been built.
  */
 void analyze_scope(const Scope& scope,
                    const call_graph::Graph&,
-                   const ConcurrentMap<const DexMethodRef*,
-                                       local_pointers::FixpointIterator*>&,
-                   SummaryMap* effect_summaries);
+                   local_pointers::SummaryCMap* escape_summaries,
+                   SummaryMap* effect_summaries,
+                   size_t memory_budget = 1u << 24);
 
 } // namespace side_effects
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "SideEffectSummaryAnalysis.h"
+
+#include <fstream>
+
+#include "ConcurrentContainers.h"
+#include "DexUtil.h"
+#include "HierarchyUtil.h"
+#include "MethodOverrideGraph.h"
+#include "PassManager.h"
+#include "Resolver.h"
+#include "SummarySerialization.h"
+#include "Trace.h"
+#include "Walkers.h"
+
+namespace hier = hierarchy_util;
+namespace mog = method_override_graph;
+namespace ptrs = local_pointers;
+
+namespace {
+
+class CallGraphStrategy final : public call_graph::BuildStrategy {
+ public:
+  explicit CallGraphStrategy(const Scope& scope)
+      : m_scope(scope),
+        m_non_overridden_virtuals(hier::find_non_overridden_virtuals(scope)) {}
+
+  call_graph::CallSites get_callsites(const DexMethod* method) const override {
+    call_graph::CallSites callsites;
+    auto* code = const_cast<IRCode*>(method->get_code());
+    if (code == nullptr) {
+      return callsites;
+    }
+    for (auto& mie : InstructionIterable(code)) {
+      auto insn = mie.insn;
+      if (opcode::is_an_invoke(insn->opcode())) {
+        auto callee = resolve_method(insn->get_method(), opcode_to_search(insn),
+                                     m_resolved_refs, method);
+        if (callee == nullptr || may_be_overridden(callee)) {
+          continue;
+        }
+        callsites.emplace_back(callee, insn);
+      }
+    }
+    return callsites;
+  }
+
+  // XXX(jezng): We make every single method a root in order that all methods
+  // are seen as reachable. Unreachable methods will not have `get_callsites`
+  // run on them and will not have their outgoing edges added to the call graph,
+  // which means that the dead code removal will not optimize them fully. I'm
+  // not sure why these "unreachable" methods are not ultimately removed by RMU,
+  // but as it stands, properly optimizing them is a size win for us.
+  call_graph::RootAndDynamic get_roots() const override {
+    call_graph::RootAndDynamic root_and_dynamic;
+    auto& roots = root_and_dynamic.roots;
+
+    walk::code(m_scope, [&](DexMethod* method, IRCode& code) {
+      roots.emplace_back(method);
+    });
+    return root_and_dynamic;
+  }
+
+ private:
+  bool may_be_overridden(DexMethod* method) const {
+    return method->is_virtual() && m_non_overridden_virtuals.count(method) == 0;
+  }
+
+  const Scope& m_scope;
+  std::unordered_set<const DexMethod*> m_non_overridden_virtuals;
+  mutable ConcurrentMethodRefCache m_resolved_refs;
+};
+
+} // namespace
+
+void SideEffectSummaryAnalysisPass::bind_config() {
+  bind("side_effect_summaries", {boost::none},
+       m_config.external_side_effect_summaries_file,
+       "Summaries of external methods, as read by ObjectSensitiveDcePass.",
+       Configurable::bindflags::optionals::skip_empty_string);
+  bind("escape_summaries", {boost::none},
+       m_config.external_escape_summaries_file,
+       "Escape summaries of external methods, as read by "
+       "ObjectSensitiveDcePass.",
+       Configurable::bindflags::optionals::skip_empty_string);
+  bind("escape_analysis_memory_budget", m_config.escape_analysis_memory_budget,
+       m_config.escape_analysis_memory_budget,
+       "Upper bound on the estimated size of the pointer analyses running "
+       "at the same time, in register bindings.");
+}
+
+void SideEffectSummaryAnalysisPass::run_pass(DexStoresVector& stores,
+                                             ConfigFiles& /* conf */,
+                                             PassManager& /* mgr */) {
+  auto scope = build_class_scope(stores);
+  walk::parallel::code(scope, [&](const DexMethod*, IRCode& code) {
+    code.build_cfg(/* editable */ false);
+    code.cfg().calculate_exit_block();
+  });
+  auto call_graph = build_call_graph(scope);
+  m_result = analyze(m_config, scope, call_graph);
+  walk::parallel::code(
+      scope, [&](const DexMethod*, IRCode& code) { code.clear_cfg(); });
+}
+
+call_graph::Graph SideEffectSummaryAnalysisPass::build_call_graph(
+    const Scope& scope) {
+  return call_graph::Graph(CallGraphStrategy(scope));
+}
+
+std::shared_ptr<const SideEffectSummaryAnalysisPass::Result>
+SideEffectSummaryAnalysisPass::analyze(const Config& config,
+                                       const Scope& scope,
+                                       const call_graph::Graph& call_graph) {
+  auto result = std::make_shared<Result>();
+  if (config.external_escape_summaries_file) {
+    ptrs::SummaryMap escape_summaries;
+    std::ifstream file_input(*config.external_escape_summaries_file);
+    summary_serialization::read(file_input, &escape_summaries);
+    for (auto& pair : escape_summaries) {
+      result->escape_summaries.insert(pair);
+    }
+  }
+  if (config.external_side_effect_summaries_file) {
+    std::ifstream file_input(*config.external_side_effect_summaries_file);
+    summary_serialization::read(file_input, &result->effect_summaries);
+  }
+  // Only the summaries are kept; the pointer analysis of each method is
+  // redone by the clients as they transform methods.
+  side_effects::analyze_scope(scope, call_graph, &result->escape_summaries,
+                              &result->effect_summaries,
+                              config.escape_analysis_memory_budget);
+  return result;
+}
+
+std::shared_ptr<const SideEffectSummaryAnalysisPass::Result>
+SideEffectSummaryAnalysisPass::get_preserved_result(const PassManager* mgr) {
+  if (mgr == nullptr) {
+    return nullptr;
+  }
+  auto analysis = mgr->get_preserved_analysis<SideEffectSummaryAnalysisPass>();
+  if (analysis == nullptr || analysis->get_result() == nullptr) {
+    return nullptr;
+  }
+  TRACE(PM, 2, "Reusing the preserved side effect summaries");
+  return analysis->get_result();
+}
+
+std::unordered_set<const DexMethod*>
+SideEffectSummaryAnalysisPass::get_no_side_effects_methods(
+    const Result& result, const mog::Graph& override_graph) {
+  std::unordered_set<const DexMethod*> methods;
+  for (const auto& [ref, summary] : result.effect_summaries) {
+    auto method = ref->as_def();
+    if (method == nullptr || method->get_code() == nullptr ||
+        summary.effects != side_effects::EFF_NONE ||
+        !summary.modified_params.empty()) {
+      continue;
+    }
+    if (method->is_virtual() && mog::is_true_virtual(override_graph, method)) {
+      continue;
+    }
+    methods.insert(method);
+  }
+  return methods;
+}
+
+static SideEffectSummaryAnalysisPass s_pass;
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <boost/optional.hpp>
+#include <memory>
+
+#include "CallGraph.h"
+#include "DexClass.h"
+#include "LocalPointersAnalysis.h"
+#include "MethodOverrideGraph.h"
+#include "Pass.h"
+#include "SideEffectSummary.h"
+
+/*
+ * Computes the escape and side-effect summaries of all methods once, so that
+ * ObjectSensitiveDcePass and LocalDcePass can share them instead of
+ * recomputing them or falling back to the more conservative purity analysis.
+ * Removing instructions never gives a method new side effects or makes its
+ * parameters escape, so the summaries remain a sound approximation across
+ * passes that only remove instructions, and which should declare so:
+ *
+ *   au.add_preserve_specific<SideEffectSummaryAnalysisPass>();
+ */
+class SideEffectSummaryAnalysisPass : public Pass {
+ public:
+  struct Result {
+    local_pointers::SummaryCMap escape_summaries;
+    side_effects::SummaryMap effect_summaries;
+  };
+
+  struct Config {
+    boost::optional<std::string> external_side_effect_summaries_file;
+    boost::optional<std::string> external_escape_summaries_file;
+    size_t escape_analysis_memory_budget{1u << 24};
+  };
+
+  SideEffectSummaryAnalysisPass()
+      : Pass("SideEffectSummaryAnalysisPass", Pass::ANALYSIS) {}
+
+  void bind_config() override;
+
+  void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
+
+  std::shared_ptr<const Result> get_result() const { return m_result; }
+
+  void destroy_analysis_result() override { m_result = nullptr; }
+
+  /*
+   * The call graph the summaries are computed over. Every method is a root,
+   * and only invokes of methods that cannot be overridden have edges.
+   */
+  static call_graph::Graph build_call_graph(const Scope& scope);
+
+  /*
+   * Computes the summaries of the scope, starting from the external ones of
+   * the config. The code of the scope must have non-editable CFGs with exit
+   * blocks.
+   */
+  static std::shared_ptr<const Result> analyze(
+      const Config& config,
+      const Scope& scope,
+      const call_graph::Graph& call_graph);
+
+  /*
+   * Returns the preserved summaries if there are any, and null otherwise. The
+   * manager may be null, e.g. in tests.
+   */
+  static std::shared_ptr<const Result> get_preserved_result(
+      const PassManager* mgr);
+
+  /*
+   * The methods of the scope whose summaries show no side effects at all,
+   * and which are not true virtuals, so that their invocations can be
+   * removed when their results are unused.
+   */
+  static std::unordered_set<const DexMethod*> get_no_side_effects_methods(
+      const Result& result,
+      const method_override_graph::Graph& override_graph);
+
+ private:
+  Config m_config;
+  std::shared_ptr<const Result> m_result;
+};
@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include <boost/optional.hpp>
+
 #include "ConcurrentContainers.h"
 #include "MethodOverrideGraph.h"
 
@@ -48,6 +50,14 @@ struct Config {
   std::unordered_set<DexType*> breaking_reference_equality_allowlist;
   SummaryMap param_summary_map;
   ConcurrentSet<DexType*> candidate_enums;
+  /**
+   * The methods whose code reject_unsafe_enums analyzed or skipped for
+   * referencing candidate enums. All the code that references the remaining
+   * candidates is among them, so the transformation does not need to look for
+   * it again. Not set when the candidates are not checked that way.
+   */
+  boost::optional<std::unordered_set<const DexMethod*>>
+      methods_referencing_candidates;
 
   explicit Config(uint32_t max_size) : max_enum_size(max_size) {}
 
@@ -1100,6 +1100,12 @@ class EnumTransformer final {
     walk::parallel::code(
         scope,
         [&](DexMethod* method) {
+          // Skip the code that the upcast analysis found no candidates in.
+          const auto& analyzed = m_enum_util->m_config
+                                     .methods_referencing_candidates;
+          if (analyzed && !analyzed->count(method)) {
+            return false;
+          }
           if (m_enum_attributes_map.count(method->get_class()) &&
               is_generated_enum_method(method)) {
             return false;
@@ -677,6 +677,7 @@ void reject_unsafe_enums(const std::vector<DexClass*>& classes,
                          Config* config) {
   auto candidate_enums = &config->candidate_enums;
   ConcurrentSet<DexType*> rejected_enums;
+  ConcurrentSet<const DexMethod*> methods_referencing_candidates;
 
   walk::parallel::fields(
       classes, [candidate_enums, &rejected_enums](DexField* field) {
@@ -704,6 +705,9 @@ void reject_unsafe_enums(const std::vector<DexClass*>& classes,
         !rejected_enums.count(method->get_class()) &&
         (method::is_init(method) || is_enum_values(method) ||
          is_enum_valueof(method))) {
+      if (method->get_code() != nullptr) {
+        methods_referencing_candidates.insert(method);
+      }
       return;
     }
 
@@ -726,6 +730,7 @@ void reject_unsafe_enums(const std::vector<DexClass*>& classes,
     if (!need_analyze(method, *candidate_enums, rejected_enums)) {
       return;
     }
+    methods_referencing_candidates.insert(method);
 
     EnumTypeEnvironment env = EnumFixpointIterator::gen_env(method);
 
@@ -744,6 +749,10 @@ void reject_unsafe_enums(const std::vector<DexClass*>& classes,
   }
 
   reject_enums_for_colliding_constructors(classes, candidate_enums);
+  config->methods_referencing_candidates =
+      std::unordered_set<const DexMethod*>(
+          methods_referencing_candidates.begin(),
+          methods_referencing_candidates.end());
 }
 
 bool is_enum_valueof(const DexMethodRef* method) {
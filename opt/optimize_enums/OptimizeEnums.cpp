@@ -615,15 +615,21 @@ class OptimizeEnums {
   }
 
   EnumFieldToOrdinal collect_enum_field_ordinals() {
-    EnumFieldToOrdinal enum_field_to_ordinal;
-
-    for (const auto& cls : m_scope) {
-      if (is_enum(cls)) {
-        collect_enum_field_ordinals(cls, enum_field_to_ordinal);
+    // Each enum's <clinit> is analyzed on its own.
+    ConcurrentMap<DexField*, size_t> concurrent_enum_field_to_ordinal;
+    walk::parallel::classes(m_scope, [&](DexClass* cls) {
+      if (!is_enum(cls)) {
+        return;
       }
-    }
+      EnumFieldToOrdinal cls_enum_field_to_ordinal;
+      collect_enum_field_ordinals(cls, cls_enum_field_to_ordinal);
+      for (auto& pair : cls_enum_field_to_ordinal) {
+        concurrent_enum_field_to_ordinal.insert(pair);
+      }
+    });
 
-    return enum_field_to_ordinal;
+    return EnumFieldToOrdinal(concurrent_enum_field_to_ordinal.begin(),
+                              concurrent_enum_field_to_ordinal.end());
   }
 
   /**
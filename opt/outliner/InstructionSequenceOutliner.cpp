@@ -12,20 +12,15 @@
  *
  * At its core is a rather naive approach: check if any subsequence of
  * instructions in a block occurs sufficiently often. The average complexity is
- * held down by filtering out instruction sequences where adjacent sequences of
- * abstracted instructions ("cores") of fixed lengths never occur twice anywhere
- * in the scope (seems good enough, even without a suffix tree).
+ * held down by a suffix array over the abstracted instructions ("cores") of
+ * each dex: it tells for every instruction how long the longest sequence of
+ * cores starting there that occurs again elsewhere is, and exploration stops
+ * as soon as a candidate grows beyond that.
  *
  * When reaching a conditional branch or switch instruction, different control-
  * paths are explored as well, as long as they eventually all arrive at a common
  * block. Thus, outline candidates are in fact instruction sequence trees.
  *
- * At its core is a rather naive approach: check if any subsequence of
- * instructions in a block occurs sufficiently often. The average complexity is
- * held down by filtering out instruction sequences where adjacent sequences of
- * abstracted instructions ("cores") of fixed lengths never occur twice anywhere
- * in the scope (seems good enough, even without a suffix tree).
- *
  * We gather existing method/type references in a dex and make sure that we
  * don't go beyond the limits when adding methods/types, effectively filling up
  * the available ref space created by IntraDexInline (minus other reservations).
@@ -68,6 +63,7 @@
 #include <list>
 #include <map>
 #include <memory>
+#include <numeric>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -105,8 +101,10 @@
 #include "Resolver.h"
 #include "Show.h"
 #include "StlUtil.h"
+#include "SuffixArray.h"
 #include "Trace.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 using namespace outliner;
 
@@ -133,8 +131,8 @@ const size_t COST_INVOKE_WITHOUT_RESULT = 3;
 // Maximum number of arguments in outlined methods to avoid /range instructions
 const size_t MAX_ARGS = 5;
 
-// Minimum number of instructions to be outlined in a sequence, used in
-// definition of cores
+// Minimum number of instructions to be outlined in a sequence; shorter
+// sequences are explored without checking whether they recur
 const size_t MIN_INSNS_SIZE = 3;
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -175,17 +173,24 @@ static StableHash stable_hash_value(const std::string& s) {
   }
   return stable_hash;
 }
+template <typename T>
+static StableHash stable_hash_value_of_show(const T* t) {
+  thread_local std::string buffer;
+  buffer.clear();
+  show_to(buffer, t);
+  return stable_hash_value(buffer);
+}
 static StableHash stable_hash_value(const CandidateInstructionCore& cic) {
   StableHash stable_hash{cic.opcode};
   switch (opcode::ref(cic.opcode)) {
   case opcode::Ref::Method:
-    return stable_hash * 41 + stable_hash_value(show(cic.method));
+    return stable_hash * 41 + stable_hash_value_of_show(cic.method);
   case opcode::Ref::Field:
-    return stable_hash * 43 + stable_hash_value(show(cic.field));
+    return stable_hash * 43 + stable_hash_value_of_show(cic.field);
   case opcode::Ref::String:
-    return stable_hash * 47 + stable_hash_value(show(cic.string));
+    return stable_hash * 47 + stable_hash_value_of_show(cic.string);
   case opcode::Ref::Type:
-    return stable_hash * 53 + stable_hash_value(show(cic.type));
+    return stable_hash * 53 + stable_hash_value_of_show(cic.type);
   case opcode::Ref::Data:
     return stable_hash * 59 + cic.data->size();
   case opcode::Ref::Literal:
@@ -307,10 +312,10 @@ static size_t hash_value(const Candidate& c) {
 static StableHash stable_hash_value(const Candidate& c) {
   StableHash stable_hash{c.arg_types.size()};
   for (auto t : c.arg_types) {
-    stable_hash = stable_hash * 71 + stable_hash_value(show(t));
+    stable_hash = stable_hash * 71 + stable_hash_value_of_show(t);
   }
   if (c.res_type) {
-    stable_hash = stable_hash * 73 + stable_hash_value(show(c.res_type));
+    stable_hash = stable_hash * 73 + stable_hash_value_of_show(c.res_type);
   }
   stable_hash = stable_hash * 79 + stable_hash_value(c.root);
   return stable_hash;
@@ -347,41 +352,11 @@ static CandidateInstructionCore to_core(IRInstruction* insn) {
   return core;
 }
 
-using CandidateInstructionCores =
-    std::array<CandidateInstructionCore, MIN_INSNS_SIZE>;
-using CandidateInstructionCoresHasher = boost::hash<CandidateInstructionCores>;
-using CandidateInstructionCoresSet =
-    std::unordered_set<CandidateInstructionCores,
-                       CandidateInstructionCoresHasher>;
-
-// The cores builder efficiently keeps track of the last MIN_INSNS_SIZE many
-// instructions.
-class CandidateInstructionCoresBuilder {
- public:
-  void push_back(IRInstruction* insn) {
-    m_buffer[m_start] = to_core(insn);
-    m_start = (m_start + 1) % MIN_INSNS_SIZE;
-    m_size = m_size < MIN_INSNS_SIZE ? m_size + 1 : MIN_INSNS_SIZE;
-  }
-
-  void clear() { m_size = 0; }
-
-  bool has_value() const { return m_size == MIN_INSNS_SIZE; }
-
-  CandidateInstructionCores get_value() {
-    always_assert(m_size == MIN_INSNS_SIZE);
-    CandidateInstructionCores res;
-    for (size_t i = 0; i < MIN_INSNS_SIZE; i++) {
-      res[i] = m_buffer.at((m_start + i) % MIN_INSNS_SIZE);
-    }
-    return res;
-  }
-
- private:
-  std::array<CandidateInstructionCore, MIN_INSNS_SIZE> m_buffer;
-  size_t m_start{0};
-  size_t m_size{0};
-};
+// For each instruction that starts a sequence of at least MIN_INSNS_SIZE
+// outlinable instructions whose cores occur again elsewhere in the dex, the
+// length of the longest such sequence. Only sequences within a big block
+// count.
+using RepeatLengths = std::unordered_map<const IRInstruction*, uint32_t>;
 
 ////////////////////////////////////////////////////////////////////////////////
 // Normalization of partial candidate sequence to candidate sequence
@@ -805,14 +780,21 @@ static bool explore_candidates_from(
         reaching_initialized_init_first_param,
     const Config& config,
     const RefChecker& ref_checker,
-    const CandidateInstructionCoresSet& recurring_cores,
+    const RepeatLengths& repeat_lengths,
     PartialCandidate* pc,
     PartialCandidateNode* pcn,
     big_blocks::InstructionIterator it,
     const big_blocks::InstructionIterator& end,
     const ExploredCallback* explored_callback = nullptr) {
   boost::optional<IROpcode> prev_opcode;
-  CandidateInstructionCoresBuilder cores_builder;
+  size_t linear_size{0};
+  size_t repeat_length{0};
+  if (it != end) {
+    auto repeat_length_it = repeat_lengths.find(it->insn);
+    if (repeat_length_it != repeat_lengths.end()) {
+      repeat_length = repeat_length_it->second;
+    }
+  }
   auto first_block = it.block();
   auto& cfg = first_block->cfg();
   for (; it != end; prev_opcode = it->insn->opcode(), it++) {
@@ -825,9 +807,8 @@ static bool explore_candidates_from(
                           insn)) {
       return false;
     }
-    cores_builder.push_back(insn);
-    if (cores_builder.has_value() &&
-        !recurring_cores.count(cores_builder.get_value())) {
+    // No other sequence in the dex has the same cores as this one.
+    if (++linear_size >= MIN_INSNS_SIZE && linear_size > repeat_length) {
       return false;
     }
     if (!append_to_partial_candidate(reaching_initialized_new_instances, insn,
@@ -867,7 +848,7 @@ static bool explore_candidates_from(
           auto succ_ii = big_blocks::InstructionIterable(*succ_big_block);
           if (!explore_candidates_from(reaching_initialized_new_instances,
                                        reaching_initialized_init_first_param,
-                                       config, ref_checker, recurring_cores, pc,
+                                       config, ref_checker, repeat_lengths, pc,
                                        succ_pcn.get(), succ_ii.begin(),
                                        succ_ii.end())) {
             return false;
@@ -922,6 +903,7 @@ static bool explore_candidates_from(
   FOR_EACH(loop)                               \
   FOR_EACH(block_warm_loop_exceeds_thresholds) \
   FOR_EACH(block_warm_loop_no_source_blocks)   \
+  FOR_EACH(block_exceeds_thresholds)           \
   FOR_EACH(block_hot)                          \
   FOR_EACH(block_hot_exceeds_thresholds)       \
   FOR_EACH(block_hot_no_source_blocks)
@@ -942,7 +924,7 @@ static MethodCandidates find_method_candidates(
     const CanOutlineBlockDecider& block_decider,
     DexMethod* method,
     cfg::ControlFlowGraph& cfg,
-    const CandidateInstructionCoresSet& recurring_cores,
+    const RepeatLengths& repeat_lengths,
     FindCandidatesStats* stats) {
   MethodCandidates candidates;
   Lazy<LivenessFixpointIterator> liveness_fp_iter([&cfg] {
@@ -1111,6 +1093,9 @@ static MethodCandidates find_method_candidates(
             // We could bail out on this way earlier, but doing it last gives us
             // better statistics on what the damage really is
             switch (result) {
+            case CanOutlineBlockDecider::Result::BlockExceedsThresholds:
+              lstats.block_exceeds_thresholds++;
+              return;
             case CanOutlineBlockDecider::Result::WarmLoop:
               lstats.loop++;
               return;
@@ -1169,7 +1154,7 @@ static MethodCandidates find_method_candidates(
       PartialCandidate pc;
       explore_candidates_from(reaching_initialized_new_instances,
                               reaching_initialized_init_first_param, config,
-                              ref_checker, recurring_cores, &pc, &pc.root, it,
+                              ref_checker, repeat_lengths, &pc, &pc.root, it,
                               end, &explored_callback);
     }
   }
@@ -1182,7 +1167,7 @@ static MethodCandidates find_method_candidates(
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-// get_recurring_cores
+// get_repeat_lengths
 ////////////////////////////////////////////////////////////////////////////////
 
 static bool can_outline_from_method(DexMethod* method) {
@@ -1193,28 +1178,36 @@ static bool can_outline_from_method(DexMethod* method) {
   return true;
 }
 
-// Gather set of recurring small (MIN_INSNS_SIZE) adjacent instruction
-// sequences that are outlinable. Note that all longer recurring outlinable
-// instruction sequences must be comprised of shorter recurring ones.
-static void get_recurring_cores(
+// Maximal runs of outlinable instructions within a big block.
+using OutlinableSegments = std::vector<std::vector<IRInstruction*>>;
+
+// Find out, for each outlinable instruction, how long the recurring
+// sequences starting there are. The cores of all segments of outlinable
+// instructions in the dex are encoded as one string of integers, each segment
+// followed by a unique separator, so that a common prefix of two suffixes
+// never spans segments. The encoding happens in parallel, per method.
+static void get_repeat_lengths(
     const Config& config,
     PassManager& mgr,
     const Scope& scope,
     const std::unordered_set<DexMethod*>& sufficiently_warm_methods,
     const std::unordered_set<DexMethod*>& sufficiently_hot_methods,
     const RefChecker& ref_checker,
-    CandidateInstructionCoresSet* recurring_cores,
+    RepeatLengths* repeat_lengths,
     ConcurrentMap<DexMethod*, CanOutlineBlockDecider>* block_deciders) {
-  ConcurrentMap<CandidateInstructionCores, size_t,
-                CandidateInstructionCoresHasher>
-      concurrent_cores;
-  walk::parallel::code(
-      scope, [&config, &ref_checker, &sufficiently_warm_methods,
-              &sufficiently_hot_methods, &concurrent_cores,
-              block_deciders](DexMethod* method, IRCode& code) {
-        if (!can_outline_from_method(method)) {
-          return;
-        }
+  std::vector<DexMethod*> methods;
+  walk::code(scope, [&methods](DexMethod* method, IRCode&) {
+    if (can_outline_from_method(method)) {
+      methods.push_back(method);
+    }
+  });
+  std::vector<OutlinableSegments> segments(methods.size());
+  std::vector<size_t> indices(methods.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  workqueue_run<size_t>(
+      [&](size_t i) {
+        auto method = methods[i];
+        auto& code = *method->get_code();
         code.build_cfg(/* editable */ true);
         code.cfg().calculate_exit_block();
         CanOutlineBlockDecider block_decider(
@@ -1228,45 +1221,75 @@ static void get_recurring_cores(
               reaching_initializeds::get_reaching_initializeds(
                   cfg, reaching_initializeds::Mode::FirstLoadParam);
         }
+        // The last segment is the open one; it's dropped if too short to
+        // start any candidate.
+        auto& method_segments = segments[i];
+        method_segments.emplace_back();
+        auto close_segment = [&method_segments]() {
+          if (method_segments.back().size() < MIN_INSNS_SIZE) {
+            method_segments.back().clear();
+          } else {
+            method_segments.emplace_back();
+          }
+        };
         for (auto& big_block : big_blocks::get_big_blocks(cfg)) {
           if (block_decider.can_outline_from_big_block(big_block) !=
               CanOutlineBlockDecider::Result::CanOutline) {
             continue;
           }
-          CandidateInstructionCoresBuilder cores_builder;
           for (auto& mie : big_blocks::InstructionIterable(big_block)) {
             auto insn = mie.insn;
-            if (!can_outline_insn(
-                    ref_checker, reaching_initialized_init_first_param, insn)) {
-              cores_builder.clear();
-              continue;
-            }
-            cores_builder.push_back(insn);
-            if (cores_builder.has_value()) {
-              concurrent_cores.update(cores_builder.get_value(),
-                                      [](const CandidateInstructionCores&,
-                                         size_t& occurrences,
-                                         bool /* exists */) { occurrences++; });
+            if (can_outline_insn(ref_checker,
+                                 reaching_initialized_init_first_param, insn)) {
+              method_segments.back().push_back(insn);
+            } else {
+              close_segment();
             }
           }
+          close_segment();
         }
+        method_segments.pop_back();
         block_deciders->emplace(method, std::move(block_decider));
-      });
-  size_t singleton_cores{0};
-  for (auto& p : concurrent_cores) {
-    always_assert(p.second > 0);
-    if (p.second > 1) {
-      recurring_cores->insert(p.first);
-    } else {
-      singleton_cores++;
+      },
+      indices);
+
+  std::unordered_map<CandidateInstructionCore, uint32_t,
+                     CandidateInstructionCoreHasher>
+      core_ids;
+  uint32_t next_id{0};
+  std::vector<uint32_t> encoded;
+  std::vector<IRInstruction*> insns;
+  for (auto& method_segments : segments) {
+    for (auto& segment : method_segments) {
+      for (auto insn : segment) {
+        auto id = core_ids.emplace(to_core(insn), next_id);
+        if (id.second) {
+          next_id++;
+        }
+        encoded.push_back(id.first->second);
+        insns.push_back(insn);
+      }
+      encoded.push_back(next_id++);
+      insns.push_back(nullptr);
+    }
+  }
+  segments.clear();
+  size_t distinct_cores = core_ids.size();
+  core_ids.clear();
+
+  auto lengths = outliner_impl::get_repeat_lengths(encoded);
+  for (size_t i = 0; i < lengths.size(); i++) {
+    if (lengths[i] >= MIN_INSNS_SIZE) {
+      repeat_lengths->emplace(insns[i], lengths[i]);
     }
   }
-  mgr.incr_metric("num_singleton_cores", singleton_cores);
-  mgr.incr_metric("num_recurring_cores", recurring_cores->size());
+  mgr.incr_metric("num_distinct_cores", distinct_cores);
+  mgr.incr_metric("num_encoded_insns", encoded.size());
+  mgr.incr_metric("num_recurring_insns", repeat_lengths->size());
   TRACE(ISO, 2,
-        "[invoke sequence outliner] %zu singleton cores, %zu recurring "
-        "cores",
-        singleton_cores, recurring_cores->size());
+        "[invoke sequence outliner] %zu distinct cores, %zu of %zu "
+        "instructions start recurring sequences",
+        distinct_cores, repeat_lengths->size(), encoded.size());
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1475,7 +1498,7 @@ static void get_beneficial_candidates(
     PassManager& mgr,
     const Scope& scope,
     const RefChecker& ref_checker,
-    const CandidateInstructionCoresSet& recurring_cores,
+    const RepeatLengths& repeat_lengths,
     const ConcurrentMap<DexMethod*, CanOutlineBlockDecider>& block_deciders,
     const ReusableOutlinedMethods* outlined_methods,
     std::vector<CandidateWithInfo>* candidates_with_infos,
@@ -1484,7 +1507,7 @@ static void get_beneficial_candidates(
   ConcurrentMap<Candidate, CandidateInfo, CandidateHasher>
       concurrent_candidates;
   FindCandidatesStats stats;
-  walk::parallel::code(scope, [&config, &ref_checker, &recurring_cores,
+  walk::parallel::code(scope, [&config, &ref_checker, &repeat_lengths,
                                &concurrent_candidates, &block_deciders,
                                &stats](DexMethod* method, IRCode& code) {
     if (!can_outline_from_method(method)) {
@@ -1492,7 +1515,7 @@ static void get_beneficial_candidates(
     }
     for (auto& p : find_method_candidates(
              config, ref_checker, block_deciders.at_unsafe(method), method,
-             code.cfg(), recurring_cores, &stats)) {
+             code.cfg(), repeat_lengths, &stats)) {
       std::vector<CandidateMethodLocation>& cmls = p.second;
       concurrent_candidates.update(p.first,
                                    [method, &cmls](const Candidate&,
@@ -2955,6 +2978,11 @@ void InstructionSequenceOutliner::bind_config() {
        pg.block_profiles_hits,
        pg.block_profiles_hits,
        "No code is outlined out of hot blocks in hot methods");
+  bind("block_profiles_hot_hits",
+       pg.block_profiles_hot_hits,
+       pg.block_profiles_hot_hits,
+       "No code is outlined out of blocks hit more often than this, in any "
+       "method; negative values disable the check");
   bind("reuse_outlined_methods_across_dexes",
        m_config.reuse_outlined_methods_across_dexes,
        m_config.reuse_outlined_methods_across_dexes,
@@ -3076,16 +3104,16 @@ void InstructionSequenceOutliner::run_pass(DexStoresVector& stores,
       }
       last_store_idx = store_idx;
       RefChecker ref_checker{&xstores, store_idx, min_sdk_api};
-      CandidateInstructionCoresSet recurring_cores;
+      RepeatLengths repeat_lengths;
       ConcurrentMap<DexMethod*, CanOutlineBlockDecider> block_deciders;
-      get_recurring_cores(m_config, mgr, dex, sufficiently_warm_methods,
-                          sufficiently_hot_methods, ref_checker,
-                          &recurring_cores, &block_deciders);
+      get_repeat_lengths(m_config, mgr, dex, sufficiently_warm_methods,
+                         sufficiently_hot_methods, ref_checker,
+                         &repeat_lengths, &block_deciders);
       std::vector<CandidateWithInfo> candidates_with_infos;
       std::unordered_map<DexMethod*, std::unordered_set<CandidateId>>
           candidate_ids_by_methods;
       get_beneficial_candidates(
-          m_config, mgr, dex, ref_checker, recurring_cores, block_deciders,
+          m_config, mgr, dex, ref_checker, repeat_lengths, block_deciders,
           &outlined_methods, &candidates_with_infos, &candidate_ids_by_methods);
 
       // TODO: Merge candidates that are equivalent except that one returns
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "SuffixArray.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace outliner_impl {
+
+SuffixArray build_suffix_array(const std::vector<uint32_t>& s) {
+  const uint32_t n = s.size();
+  SuffixArray res;
+  auto& sa = res.suffixes;
+  sa.resize(n);
+  std::iota(sa.begin(), sa.end(), 0);
+  std::sort(sa.begin(), sa.end(),
+            [&s](uint32_t a, uint32_t b) { return s[a] < s[b]; });
+
+  // Ranks are dense, and sorting by (rank[i], rank[i + k]) orders the
+  // suffixes by their first 2k elements.
+  std::vector<uint32_t> rank(n);
+  std::vector<uint32_t> next_rank(n);
+  std::vector<uint32_t> by_second(n);
+  std::vector<uint32_t> counts;
+  for (uint32_t i = 1; i < n; i++) {
+    rank[sa[i]] = rank[sa[i - 1]] + (s[sa[i - 1]] != s[sa[i]]);
+  }
+  for (uint32_t k = 1; n > 0 && rank[sa[n - 1]] < n - 1; k *= 2) {
+    // Suffixes without a second half come first, then the others in the
+    // order of their second half.
+    uint32_t j = 0;
+    for (uint32_t i = n - std::min(k, n); i < n; i++) {
+      by_second[j++] = i;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+      if (sa[i] >= k) {
+        by_second[j++] = sa[i] - k;
+      }
+    }
+    // Stable counting sort by first half.
+    counts.assign(rank[sa[n - 1]] + 2, 0);
+    for (uint32_t i = 0; i < n; i++) {
+      counts[rank[i] + 1]++;
+    }
+    std::partial_sum(counts.begin(), counts.end(), counts.begin());
+    for (auto i : by_second) {
+      sa[counts[rank[i]]++] = i;
+    }
+    auto key = [&](uint32_t i) {
+      return std::make_pair(rank[i], i + k < n ? rank[i + k] + 1 : 0);
+    };
+    next_rank[sa[0]] = 0;
+    for (uint32_t i = 1; i < n; i++) {
+      next_rank[sa[i]] =
+          next_rank[sa[i - 1]] + (key(sa[i - 1]) != key(sa[i]));
+    }
+    rank.swap(next_rank);
+  }
+
+  auto& lcp = res.lcp;
+  lcp.assign(n, 0);
+  uint32_t h = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    if (rank[i] == 0) {
+      h = 0;
+      continue;
+    }
+    auto j = sa[rank[i] - 1];
+    while (i + h < n && j + h < n && s[i + h] == s[j + h]) {
+      h++;
+    }
+    lcp[rank[i]] = h;
+    if (h > 0) {
+      h--;
+    }
+  }
+  return res;
+}
+
+std::vector<uint32_t> get_repeat_lengths(const std::vector<uint32_t>& s) {
+  auto sa = build_suffix_array(s);
+  std::vector<uint32_t> res(s.size());
+  for (size_t i = 0; i < sa.suffixes.size(); i++) {
+    auto next = i + 1 < sa.lcp.size() ? sa.lcp[i + 1] : 0;
+    res[sa.suffixes[i]] = std::max(sa.lcp[i], next);
+  }
+  return res;
+}
+
+} // namespace outliner_impl
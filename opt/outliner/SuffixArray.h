@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace outliner_impl {
+
+struct SuffixArray {
+  // The starting positions of all suffixes, in lexicographic order.
+  std::vector<uint32_t> suffixes;
+  // lcp[i] is the length of the longest common prefix of the suffixes at
+  // suffixes[i - 1] and suffixes[i]; lcp[0] is zero.
+  std::vector<uint32_t> lcp;
+};
+
+/*
+ * Build the suffix array of a string of integers by prefix doubling with
+ * radix sorts, and its LCP array with Kasai et al.'s algorithm.
+ */
+SuffixArray build_suffix_array(const std::vector<uint32_t>& s);
+
+/*
+ * For each position of the string, the length of the longest prefix of the
+ * suffix starting there which also starts at some other position.
+ */
+std::vector<uint32_t> get_repeat_lengths(const std::vector<uint32_t>& s);
+
+} // namespace outliner_impl
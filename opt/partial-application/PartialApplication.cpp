@@ -94,6 +94,7 @@
 #include "PassManager.h"
 #include "ReachableClasses.h"
 #include "RefChecker.h"
+#include "Show.h"
 #include "Shrinker.h"
 #include "SourceBlocks.h"
 #include "StlUtil.h"
@@ -834,12 +835,15 @@ void select_invokes_and_callers(
 
   std::sort(callees.begin(), callees.end(), compare_dexmethods);
   std::unordered_map<uint64_t, uint32_t> stable_hash_indices;
+  std::string callee_name;
   for (auto callee : callees) {
     auto& callee_selected_invokes = selected_invokes_by_callees.at(callee);
     if (callee_selected_invokes.empty()) {
       continue;
     }
-    auto callee_stable_hash = get_stable_hash(show(callee));
+    callee_name.clear();
+    show_to(callee_name, callee);
+    auto callee_stable_hash = get_stable_hash(callee_name);
     std::map<const DexTypeList*, std::vector<const CallSiteSummary*>,
              dextypelists_comparator>
         ordered_pa_args_csses;
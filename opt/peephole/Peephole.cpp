@@ -8,6 +8,7 @@
 #include "Peephole.h"
 
 #include <algorithm>
+#include <bitset>
 #include <cinttypes>
 #include <cmath>
 #include <iostream>
@@ -1685,11 +1686,40 @@ bool contains(const std::vector<T>& vec, const T& value) {
   return std::find(vec.begin(), vec.end(), value) != vec.end();
 }
 
+// IROpcode values are dense, and IOPCODE_MOVE_RESULT_PSEUDO_WIDE is the last.
+constexpr size_t kNumOpcodes = IOPCODE_MOVE_RESULT_PSEUDO_WIDE + 1;
+using OpcodeSet = std::bitset<kNumOpcodes>;
+
+// The opcodes that each instruction of the pattern's match can have.
+std::vector<OpcodeSet> compile_match_opcodes(const Pattern& pattern) {
+  std::vector<OpcodeSet> match_opcodes;
+  for (const auto& dex_pattern : pattern.match) {
+    OpcodeSet opcodes;
+    for (auto opcode : dex_pattern.opcodes) {
+      always_assert(opcode < kNumOpcodes);
+      opcodes.set(opcode);
+    }
+    match_opcodes.push_back(opcodes);
+  }
+  return match_opcodes;
+}
+
+// A pattern can only match in code that has an instruction for each of the
+// instructions of its match.
+bool may_match(const std::vector<OpcodeSet>& match_opcodes,
+               const OpcodeSet& opcodes) {
+  return std::all_of(
+      match_opcodes.begin(), match_opcodes.end(),
+      [&](const OpcodeSet& match) { return (match & opcodes).any(); });
+}
+
 // Each thread will have its own instance of PeepholeOptimizer, so align it in
 // order to avoid false sharing.
 class alignas(CACHE_LINE_SIZE) PeepholeOptimizer {
  private:
   std::vector<Matcher> m_matchers;
+  // Parallel to m_matchers.
+  std::vector<std::vector<OpcodeSet>> m_match_opcodes;
   std::vector<size_t> m_stats;
   PassManager& m_mgr;
   int m_stats_removed = 0;
@@ -1715,6 +1745,7 @@ class alignas(CACHE_LINE_SIZE) PeepholeOptimizer {
       for (const Pattern& pattern : pattern_list) {
         if (!contains(disabled_peepholes, pattern.name)) {
           m_matchers.emplace_back(pattern);
+          m_match_opcodes.push_back(compile_match_opcodes(pattern));
         } else {
           TRACE(PEEPHOLE,
                 2,
@@ -1729,20 +1760,49 @@ class alignas(CACHE_LINE_SIZE) PeepholeOptimizer {
   PeepholeOptimizer(const PeepholeOptimizer&) = delete;
   PeepholeOptimizer& operator=(const PeepholeOptimizer&) = delete;
 
+  // The blocks of the cfg, in order, with the opcodes each of them has.
+  static std::vector<std::pair<cfg::Block*, OpcodeSet>> collect_opcodes(
+      const cfg::ControlFlowGraph& cfg, OpcodeSet* all_opcodes) {
+    std::vector<std::pair<cfg::Block*, OpcodeSet>> blocks;
+    all_opcodes->reset();
+    for (auto* block : cfg.blocks()) {
+      OpcodeSet opcodes;
+      for (auto& mie : InstructionIterable(block)) {
+        opcodes.set(mie.insn->opcode());
+      }
+      *all_opcodes |= opcodes;
+      blocks.emplace_back(block, opcodes);
+    }
+    return blocks;
+  }
+
   void peephole(DexMethod* method) {
     auto code = method->get_code();
     code->build_cfg(/* editable */ true);
     auto& cfg = code->cfg();
 
+    // Most patterns cannot match in most blocks: skip those that lack an
+    // opcode of the pattern, without running the matcher over them.
+    OpcodeSet method_opcodes;
+    auto blocks = collect_opcodes(cfg, &method_opcodes);
+
     // do optimizations one at a time
     // so they can match on the same pattern without interfering
     for (size_t i = 0; i < m_matchers.size(); ++i) {
       auto& matcher = m_matchers[i];
+      const auto& match_opcodes = m_match_opcodes[i];
+      if (!may_match(match_opcodes, method_opcodes)) {
+        continue;
+      }
 
-      const auto& blocks = cfg.blocks();
       cfg::CFGMutation mutator(cfg);
+      bool matched = false;
 
-      for (const auto& block : blocks) {
+      for (const auto& block_and_opcodes : blocks) {
+        auto* block = block_and_opcodes.first;
+        if (!may_match(match_opcodes, block_and_opcodes.second)) {
+          continue;
+        }
         // Currently, all patterns do not span over multiple basic blocks. So
         // reset all matching states on visiting every basic block.
         matcher.reset();
@@ -1756,6 +1816,7 @@ class alignas(CACHE_LINE_SIZE) PeepholeOptimizer {
             continue;
           }
           m_stats.at(i)++;
+          matched = true;
           TRACE(PEEPHOLE, 7, "PATTERN %s MATCHED!",
                 matcher.pattern.name.c_str());
 
@@ -1794,6 +1855,10 @@ class alignas(CACHE_LINE_SIZE) PeepholeOptimizer {
 
       // Apply the mutator.
       mutator.flush();
+      if (matched) {
+        // The replacements may have changed the opcodes, and split blocks.
+        blocks = collect_opcodes(cfg, &method_opcodes);
+      }
     }
 
     code->clear_cfg();
@@ -348,6 +348,183 @@ class Analyzer final : public BaseIRAnalyzer<TrackedDomainEnvironment> {
       m_escaped_arrays;
 };
 
+/*
+ * Returns the blocks of the cfg in order if they form a single chain, without
+ * any branches or throw edges.
+ */
+boost::optional<std::vector<cfg::Block*>> get_straight_line_blocks(
+    const cfg::ControlFlowGraph& cfg) {
+  std::vector<cfg::Block*> blocks;
+  for (auto* b = cfg.entry_block(); b != nullptr; b = b->goes_to_only_edge()) {
+    if (b->succs().size() > 1 || b->preds().size() > (blocks.empty() ? 0 : 1)) {
+      return boost::none;
+    }
+    blocks.push_back(b);
+  }
+  if (blocks.size() != cfg.num_blocks()) {
+    return boost::none;
+  }
+  return blocks;
+}
+
+/*
+ * On straight-line code, the Analyzer never joins anything, and so it amounts
+ * to a single pass over the instructions. This does that pass directly, with
+ * the same transfer functions but without the abstract domains: registers
+ * hold plain values, and each array keeps its aput instructions in a vector.
+ * In straight-line code, each new-array instruction creates at most one array,
+ * and each aput instruction executes at most once.
+ */
+class StraightLineAnalyzer final {
+ public:
+  StraightLineAnalyzer(const cfg::ControlFlowGraph& cfg,
+                       const std::vector<cfg::Block*>& blocks)
+      : m_registers(cfg.get_registers_size(), Value{TrackedValueKind::Other}) {
+    for (auto* b : blocks) {
+      for (auto& mie : InstructionIterable(b)) {
+        analyze_instruction(mie.insn);
+      }
+    }
+  }
+
+  std::unordered_map<const IRInstruction*, std::vector<const IRInstruction*>>
+  get_array_literals() {
+    std::unordered_map<const IRInstruction*, std::vector<const IRInstruction*>>
+        result;
+    for (auto& array : m_arrays) {
+      if (array.escaped == Escaped::AsLiteral) {
+        result.emplace(array.new_array_insn, std::move(array.aput_insns));
+      }
+    }
+    return result;
+  }
+
+ private:
+  struct Value {
+    TrackedValueKind kind;
+    union {
+      int32_t literal; // for kind == Literal
+      uint32_t array; // for kind == NewArray, the index into m_arrays
+    };
+  };
+
+  enum class Escaped { No, AsLiteral, AsNonLiteral };
+
+  struct Array {
+    const IRInstruction* new_array_insn;
+    uint32_t length;
+    std::vector<const IRInstruction*> aput_insns;
+    Escaped escaped{Escaped::No};
+
+    bool is_literal() const { return aput_insns.size() == length; }
+  };
+
+  Value& get(reg_t reg) {
+    return reg == RESULT_REGISTER ? m_result : m_registers.at(reg);
+  }
+
+  void set(reg_t reg, bool wide, Value value) {
+    get(reg) = value;
+    if (wide) {
+      get(reg + 1) = Value{TrackedValueKind::Other};
+    }
+  }
+
+  void escape(reg_t reg) {
+    const auto& value = get(reg);
+    if (value.kind != TrackedValueKind::NewArray) {
+      return;
+    }
+    auto& array = m_arrays[value.array];
+    if (!array.is_literal()) {
+      array.escaped = Escaped::AsNonLiteral;
+    } else if (array.escaped == Escaped::No) {
+      array.escaped = Escaped::AsLiteral;
+    }
+  }
+
+  void default_case(const IRInstruction* insn) {
+    for (size_t i = 0; i < insn->srcs_size(); i++) {
+      escape(insn->src(i));
+    }
+    if (insn->has_dest()) {
+      set(insn->dest(), insn->dest_is_wide(), Value{TrackedValueKind::Other});
+    } else if (insn->has_move_result_any()) {
+      m_result = Value{TrackedValueKind::Other};
+    }
+  }
+
+  void analyze_instruction(const IRInstruction* insn) {
+    switch (insn->opcode()) {
+    case OPCODE_CONST: {
+      Value value{TrackedValueKind::Literal};
+      value.literal = (int32_t)insn->get_literal();
+      set(insn->dest(), false /* is_wide */, value);
+      break;
+    }
+
+    case OPCODE_NEW_ARRAY: {
+      const auto& length = get(insn->src(0));
+      if (length.kind == TrackedValueKind::Literal) {
+        always_assert(length.literal >= 0);
+        Value value{TrackedValueKind::NewArray};
+        value.array = m_arrays.size();
+        m_arrays.push_back(Array{insn, (uint32_t)length.literal, {}});
+        m_result = value;
+        break;
+      }
+      default_case(insn);
+      break;
+    }
+
+    case IOPCODE_MOVE_RESULT_PSEUDO_OBJECT:
+      set(insn->dest(), false /* is_wide */, m_result);
+      break;
+
+    case OPCODE_APUT:
+    case OPCODE_APUT_BYTE:
+    case OPCODE_APUT_CHAR:
+    case OPCODE_APUT_WIDE:
+    case OPCODE_APUT_SHORT:
+    case OPCODE_APUT_OBJECT:
+    case OPCODE_APUT_BOOLEAN: {
+      escape(insn->src(0));
+      const auto& array_value = get(insn->src(1));
+      const auto& index = get(insn->src(2));
+      if (array_value.kind == TrackedValueKind::NewArray &&
+          index.kind == TrackedValueKind::Literal) {
+        auto& array = m_arrays[array_value.array];
+        if (!array.is_literal() &&
+            (int64_t)index.literal == (int64_t)array.aput_insns.size()) {
+          array.aput_insns.push_back(insn);
+          break;
+        }
+      }
+      default_case(insn);
+      break;
+    }
+
+    case OPCODE_MOVE: {
+      const auto value = get(insn->src(0));
+      if (value.kind == TrackedValueKind::Literal) {
+        set(insn->dest(), false /* is_wide */, value);
+        break;
+      }
+      default_case(insn);
+      break;
+    }
+
+    default:
+      default_case(insn);
+      break;
+    }
+  }
+
+  std::vector<Value> m_registers;
+  Value m_result{TrackedValueKind::Other};
+  std::vector<Array> m_arrays;
+};
+
 } // namespace
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -373,8 +550,18 @@ ReduceArrayLiterals::ReduceArrayLiterals(cfg::ControlFlowGraph& cfg,
     return;
   }
 
-  Analyzer analyzer(cfg);
-  auto array_literals = analyzer.get_array_literals();
+  // Huge array initializers in generated code are typically straight-line,
+  // which a single pass handles without the fixpoint iteration.
+  std::unordered_map<const IRInstruction*, std::vector<const IRInstruction*>>
+      array_literals;
+  auto straight_line_blocks = get_straight_line_blocks(cfg);
+  if (straight_line_blocks) {
+    StraightLineAnalyzer analyzer(cfg, *straight_line_blocks);
+    array_literals = analyzer.get_array_literals();
+  } else {
+    Analyzer analyzer(cfg);
+    array_literals = analyzer.get_array_literals();
+  }
   // sort array literals by order of occurrence for determinism
   for (IRInstruction* new_array_insn : new_array_insns) {
     auto it = array_literals.find(new_array_insn);
@@ -35,6 +35,7 @@
 #include "Liveness.h"
 #include "PassManager.h"
 #include "Show.h"
+#include "SourceBlocks.h"
 #include "Trace.h"
 #include "Walkers.h"
 
@@ -478,7 +479,9 @@ void ReduceGotosPass::process_code_ifs(cfg::ControlFlowGraph& cfg,
   } while (rerun);
 }
 
-ReduceGotosPass::Stats ReduceGotosPass::process_code(IRCode* code) {
+ReduceGotosPass::Stats ReduceGotosPass::process_code(
+    IRCode* code,
+    const std::unique_ptr<cfg::LinearizationStrategy>& strategy) {
   Stats stats;
 
   code->build_cfg(/* editable = true*/);
@@ -486,7 +489,7 @@ ReduceGotosPass::Stats ReduceGotosPass::process_code(IRCode* code) {
   auto& cfg = code->cfg();
   process_code_switches(cfg, stats);
   process_code_ifs(cfg, stats);
-  code->clear_cfg();
+  code->clear_cfg(strategy);
 
   return stats;
 }
@@ -496,13 +499,18 @@ void ReduceGotosPass::run_pass(DexStoresVector& stores,
                                PassManager& mgr) {
   auto scope = build_class_scope(stores);
 
-  Stats stats = walk::parallel::methods<Stats>(scope, [](DexMethod* method) {
+  bool move_cold_blocks_last = m_move_cold_blocks_last;
+  Stats stats = walk::parallel::methods<Stats>(scope, [&](DexMethod* method) {
     const auto code = method->get_code();
     if (!code) {
       return Stats{};
     }
 
-    Stats stats = ReduceGotosPass::process_code(code);
+    std::unique_ptr<cfg::LinearizationStrategy> strategy;
+    if (move_cold_blocks_last) {
+      strategy = std::make_unique<source_blocks::ColdChainsLastStrategy>();
+    }
+    Stats stats = ReduceGotosPass::process_code(code, strategy);
     if (stats.replaced_gotos_with_returns ||
         stats.inverted_conditional_branches) {
       TRACE(RG, 3,
@@ -7,10 +7,13 @@
 
 #pragma once
 
+#include <memory>
+
 #include "Pass.h"
 
 namespace cfg {
 class ControlFlowGraph;
+struct LinearizationStrategy;
 } // namespace cfg
 
 class ReduceGotosPass : public Pass {
@@ -34,12 +37,22 @@ class ReduceGotosPass : public Pass {
 
   ReduceGotosPass() : Pass("ReduceGotosPass") {}
 
+  void bind_config() override {
+    bind("move_cold_blocks_last", false, m_move_cold_blocks_last,
+         "Lay out the blocks whose source blocks were never hit in the "
+         "profiles at the end of their methods.");
+  }
+
   void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
 
-  static Stats process_code(IRCode*);
+  static Stats process_code(
+      IRCode*,
+      const std::unique_ptr<cfg::LinearizationStrategy>& strategy = nullptr);
   static void process_code_switches(cfg::ControlFlowGraph&, Stats&);
   static void process_code_ifs(cfg::ControlFlowGraph&, Stats&);
 
  private:
   static void shift_registers(cfg::ControlFlowGraph* cfg, uint32_t* reg);
+
+  bool m_move_cold_blocks_last{false};
 };
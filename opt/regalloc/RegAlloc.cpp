@@ -7,24 +7,98 @@
 
 #include "RegAlloc.h"
 
+#include <algorithm>
+#include <atomic>
+
+#include "ConfigFiles.h"
 #include "Debug.h"
 #include "DexUtil.h"
 #include "GraphColoring.h"
+#include "LinearScan.h"
+#include "MethodProfiles.h"
 #include "PassManager.h"
 #include "RegisterAllocation.h"
 #include "Trace.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 namespace regalloc {
 
 using Stats = graph_coloring::Allocator::Stats;
 
+namespace {
+
+/*
+ * The linear scan allocator neither spills nor picks range encodings, and
+ * doesn't know about the frame layout. Its result is only good if every
+ * instruction can be encoded as is and the parameters end up in the last
+ * registers of the frame; this also computes the frame size.
+ */
+bool is_encodable(const DexMethod* method,
+                  IRCode* code,
+                  bool no_overwrite_this) {
+  reg_t regs_size = 0;
+  std::vector<std::pair<reg_t, uint8_t>> params;
+  for (auto it = code->begin(); it != code->end(); ++it) {
+    if (it->type != MFLOW_OPCODE) {
+      continue;
+    }
+    auto insn = it->insn;
+    if (insn->has_dest()) {
+      auto dest = insn->dest();
+      uint8_t width = insn->dest_is_wide() ? 2 : 1;
+      regs_size = std::max(regs_size, static_cast<reg_t>(dest + width));
+      if (opcode::is_a_load_param(insn->opcode())) {
+        params.emplace_back(dest, width);
+      } else if (dest >
+                 max_unsigned_value(interference::dest_bit_width(it))) {
+        return false;
+      }
+    }
+    if (needs_range_conversion(insn)) {
+      return false;
+    }
+    for (size_t i = 0; i < insn->srcs_size(); ++i) {
+      auto src = insn->src(i);
+      bool wide = insn->src_is_wide(i);
+      regs_size = std::max(regs_size, static_cast<reg_t>(src + (wide ? 2 : 1)));
+      if (src > interference::max_value_for_src(insn, i, wide)) {
+        return false;
+      }
+    }
+  }
+
+  reg_t next_param = regs_size;
+  for (auto it = params.rbegin(); it != params.rend(); ++it) {
+    if (it->first + it->second != next_param) {
+      return false;
+    }
+    next_param = it->first;
+  }
+
+  if (no_overwrite_this && !is_static(method) && !params.empty()) {
+    auto this_reg = params.front().first;
+    for (const auto& mie : InstructionIterable(code)) {
+      auto insn = mie.insn;
+      if (insn->has_dest() && !opcode::is_a_load_param(insn->opcode()) &&
+          (insn->dest() == this_reg ||
+           (insn->dest_is_wide() && insn->dest() + 1 == this_reg))) {
+        return false;
+      }
+    }
+  }
+  code->set_registers_size(regs_size);
+  return true;
+}
+
+} // namespace
+
 void RegAllocPass::eval_pass(DexStoresVector&, ConfigFiles&, PassManager&) {
   ++m_eval;
 }
 
 void RegAllocPass::run_pass(DexStoresVector& stores,
-                            ConfigFiles&,
+                            ConfigFiles& conf,
                             PassManager& mgr) {
   graph_coloring::Allocator::Config allocator_config;
   const auto& jw = mgr.get_current_pass_info()->config;
@@ -33,9 +107,77 @@ void RegAllocPass::run_pass(DexStoresVector& stores,
       mgr.get_redex_options().no_overwrite_this();
 
   auto scope = build_class_scope(stores);
-  auto stats = walk::parallel::methods<Stats>(scope, [&](DexMethod* m) {
-    return graph_coloring::allocate(allocator_config, m);
+
+  std::unordered_set<const DexMethodRef*> hot_methods;
+  const auto& method_profiles = conf.get_method_profiles();
+  bool use_profiles = m_linear_scan_cold_methods && method_profiles.has_stats();
+  if (use_profiles) {
+    for (auto& p : method_profiles.all_interactions()) {
+      for (auto& q : p.second) {
+        if (q.second.appear_percent >= m_hot_method_appear_percent) {
+          hot_methods.insert(q.first);
+        }
+      }
+    }
+  }
+  auto use_linear_scan = [&](DexMethod* m, size_t size) {
+    return (m_linear_scan_min_size > 0 && size >= m_linear_scan_min_size) ||
+           (use_profiles && hot_methods.count(m) == 0);
+  };
+  std::atomic<size_t> linear_scan_methods{0};
+  std::atomic<size_t> linear_scan_fallbacks{0};
+
+  // Allocating registers takes superlinear time in the size of a method, so
+  // we start with the biggest methods. Otherwise, a giant method that comes
+  // last keeps a single thread busy long after the others are done.
+  std::vector<std::pair<size_t, DexMethod*>> sized_methods;
+  walk::code(scope, [&](DexMethod* m, IRCode& code) {
+    sized_methods.emplace_back(code.sum_opcode_sizes(), m);
   });
+  std::sort(sized_methods.begin(), sized_methods.end(),
+            [](const auto& a, const auto& b) {
+              if (a.first != b.first) {
+                return a.first > b.first;
+              }
+              return compare_dexmethods(a.second, b.second);
+            });
+  std::vector<std::pair<DexMethod*, bool>> methods;
+  methods.reserve(sized_methods.size());
+  for (auto& p : sized_methods) {
+    methods.emplace_back(p.second, use_linear_scan(p.second, p.first));
+  }
+
+  auto num_threads = redex_parallel::default_num_threads();
+  std::vector<CacheAligned<Stats>> stats_vec(num_threads);
+  workqueue_run<std::pair<DexMethod*, bool>>(
+      [&](sparta::SpartaWorkerState<std::pair<DexMethod*, bool>>* state,
+          std::pair<DexMethod*, bool> p) {
+        auto m = p.first;
+        if (p.second) {
+          ++linear_scan_methods;
+          IRCode original(*m->get_code());
+          {
+            TraceContext context(m);
+            fastregalloc::LinearScanAllocator allocator(m);
+            allocator.allocate();
+          }
+          auto code = m->get_code();
+          code->clear_cfg();
+          if (is_encodable(m, code, allocator_config.no_overwrite_this)) {
+            return;
+          }
+          // Start over from the original code.
+          ++linear_scan_fallbacks;
+          m->set_code(std::make_unique<IRCode>(original));
+        }
+        Stats& thread_stats = stats_vec[state->worker_id()];
+        thread_stats += graph_coloring::allocate(allocator_config, m);
+      },
+      methods, num_threads);
+  Stats stats;
+  for (Stats& thread_stats : stats_vec) {
+    stats += thread_stats;
+  }
 
   TRACE(REG, 1, "Total reiteration count: %lu", stats.reiteration_count);
   TRACE(REG, 1, "Total Params spilled early: %lu", stats.params_spill_early);
@@ -52,6 +194,8 @@ void RegAllocPass::run_pass(DexStoresVector& stores,
   mgr.incr_metric("spill_count", stats.moves_inserted());
   mgr.incr_metric("coalesce_count", stats.moves_coalesced);
   mgr.incr_metric("net_moves", stats.net_moves());
+  mgr.incr_metric("linear_scan_methods", linear_scan_methods);
+  mgr.incr_metric("linear_scan_fallbacks", linear_scan_fallbacks);
 
   ++m_run;
   // For the last invocation, record that final register allocation has been
@@ -21,6 +21,16 @@ class RegAllocPass : public Pass {
   void bind_config() override {
     bool unused;
     bind("live_range_splitting", false, unused);
+    bind("linear_scan_min_size", 0, m_linear_scan_min_size,
+         "Use the fast linear scan allocator for methods whose code is at "
+         "least this many code units long. Zero disables it.");
+    bind("linear_scan_cold_methods", false, m_linear_scan_cold_methods,
+         "Use the fast linear scan allocator for methods that don't appear in "
+         "the method profiles, or whose appear percentage is below "
+         "hot_method_appear_percent. Has no effect without method profiles.");
+    bind("hot_method_appear_percent", 1.0f, m_hot_method_appear_percent,
+         "Methods that appear at least that often in an interaction of the "
+         "method profiles keep the graph coloring allocator.");
     trait(Traits::Pass::atleast, 1);
   }
 
@@ -32,6 +42,9 @@ class RegAllocPass : public Pass {
  private:
   size_t m_run{0}; // Which iteration of `run_pass`.
   size_t m_eval{0}; // How many `eval_pass` iterations.
+  uint32_t m_linear_scan_min_size;
+  bool m_linear_scan_cold_methods;
+  float m_hot_method_appear_percent;
 };
 
 } // namespace regalloc
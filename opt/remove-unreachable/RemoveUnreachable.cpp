@@ -281,10 +281,22 @@ void RemoveUnreachablePassBase::write_out_removed_symbols(
 std::unique_ptr<reachability::ReachableObjects>
 RemoveUnreachablePass::compute_reachable_objects(
     const DexStoresVector& stores,
-    PassManager& /* pm */,
+    PassManager& pm,
     int* num_ignore_check_strings,
     bool emit_graph_this_run,
     bool remove_no_argument_constructors) {
+  // The graph of retainers is only complete after a marking from scratch.
+  if (m_incremental_marking && !emit_graph_this_run) {
+    auto reachables = reachability::compute_reachable_objects_incrementally(
+        stores, m_ignore_sets, num_ignore_check_strings, &m_snapshot,
+        remove_no_argument_constructors);
+    pm.set_metric("incremental_marking", m_snapshot.incremental);
+    pm.set_metric("marking_changed_objects", m_snapshot.num_changed);
+    pm.set_metric("marking_affected_objects", m_snapshot.num_affected);
+    return reachables;
+  }
+  // The snapshot would miss the changes made by this sweep.
+  m_snapshot = reachability::MarkingSnapshot();
   return reachability::compute_reachable_objects(
       stores, m_ignore_sets, num_ignore_check_strings, emit_graph_this_run,
       false, nullptr, remove_no_argument_constructors);
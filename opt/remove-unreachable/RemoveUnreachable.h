@@ -62,10 +62,24 @@ class RemoveUnreachablePass : public RemoveUnreachablePassBase {
   RemoveUnreachablePass()
       : RemoveUnreachablePassBase("RemoveUnreachablePass") {}
 
+  void bind_config() override {
+    RemoveUnreachablePassBase::bind_config();
+    bind("incremental_marking",
+         false,
+         m_incremental_marking,
+         "Keep what the marking found between the runs of this pass, and "
+         "only re-explore the parts of the program that changed since the "
+         "previous run.");
+  }
+
   std::unique_ptr<reachability::ReachableObjects> compute_reachable_objects(
       const DexStoresVector& stores,
       PassManager& pm,
       int* num_ignore_check_strings,
       bool emit_graph_this_run,
       bool remove_no_argument_constructors) override;
+
+ private:
+  bool m_incremental_marking = false;
+  reachability::MarkingSnapshot m_snapshot;
 };
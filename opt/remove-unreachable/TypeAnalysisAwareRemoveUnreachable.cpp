@@ -234,8 +234,9 @@ std::unique_ptr<ReachableObjects> compute_reachable_objects_with_type_anaysis(
     code.cfg().calculate_exit_block();
   });
 
-  auto reachable_objects = std::make_unique<ReachableObjects>();
-  ConditionallyMarked cond_marked;
+  ObjectIds ids(scope);
+  auto reachable_objects = std::make_unique<ReachableObjects>(ids);
+  ConditionallyMarked cond_marked(ids);
   auto method_override_graph = mog::build_graph(scope);
 
   ConcurrentSet<ReachableObject, ReachableObjectHash> root_set;
@@ -248,18 +249,22 @@ std::unique_ptr<ReachableObjects> compute_reachable_objects_with_type_anaysis(
 
   size_t num_threads = redex_parallel::default_num_threads();
   auto stats_arr = std::make_unique<Stats[]>(num_threads);
-  workqueue_run<ReachableObject>(
+  auto wq = workqueue_foreach<ReachableObject>(
       [&](MarkWorkerState* worker_state, const ReachableObject& obj) {
         TypeAnaysisAwareClosureMarker transitive_closure_marker(
             ignore_sets, *method_override_graph, record_reachability,
             &cond_marked, reachable_objects.get(), worker_state,
             &stats_arr[worker_state->worker_id()], gta);
-        transitive_closure_marker.visit(obj);
+        transitive_closure_marker.visit_transitively(obj);
         return nullptr;
       },
-      root_set,
       num_threads,
-      /*push_tasks_while_running=*/true);
+      /*push_tasks_while_running=*/true,
+      /*lock_free_queues=*/true);
+  for (const auto& obj : root_set) {
+    wq.add_item(obj);
+  }
+  wq.run_all();
 
   if (num_ignore_check_strings != nullptr) {
     for (size_t i = 0; i < num_threads; ++i) {
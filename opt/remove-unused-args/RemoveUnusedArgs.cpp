@@ -7,6 +7,7 @@
 
 #include "RemoveUnusedArgs.h"
 
+#include <atomic>
 #include <deque>
 #include <mutex>
 #include <unordered_map>
@@ -18,11 +19,14 @@
 #include "IRCode.h"
 #include "Liveness.h"
 #include "Match.h"
+#include "MethodOverrideGraphAnalysis.h"
 #include "OptData.h"
 #include "OptDataDefs.h"
 #include "PassManager.h"
 #include "Show.h"
+#include "StlUtil.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 using namespace opt_metadata;
 
@@ -58,10 +62,14 @@ static LocalDce::Stats add_dce_stats(LocalDce::Stats a, LocalDce::Stats b) {
  * run() removes unused params from method signatures and param loads, then
  * updates all affected callsites accordingly.
  */
-RemoveArgs::PassStats RemoveArgs::run() {
+RemoveArgs::PassStats RemoveArgs::run(const PassManager* mgr) {
   RemoveArgs::PassStats pass_stats;
-  gather_results_used();
-  auto override_graph = mog::build_graph(m_scope);
+  if (m_callsite_index == nullptr) {
+    m_owned_callsite_index = std::make_unique<CallsiteIndex>(m_scope);
+    m_callsite_index = m_owned_callsite_index.get();
+  }
+  auto override_graph =
+      MethodOverrideGraphAnalysisPass::get_or_build(mgr, m_scope);
   compute_reordered_protos(*override_graph);
   auto method_stats = update_method_protos(*override_graph);
   pass_stats.method_params_removed_count =
@@ -76,33 +84,110 @@ RemoveArgs::PassStats RemoveArgs::run() {
   return pass_stats;
 }
 
+CallsiteIndex::CallsiteIndex(const Scope& scope) {
+  walk::parallel::methods(scope, [this](DexMethod* method) { index(method); });
+}
+
 /**
- * Inspects all invoke instructions, and whether they are followed by
- * move-result instructions, and record this information for each method.
+ * Records the invokes of the given method, and whether they are followed by
+ * move-result instructions.
  */
-void RemoveArgs::gather_results_used() {
-  walk::parallel::code(
-      m_scope, [&result_used = m_result_used](DexMethod*, IRCode& code) {
-        const auto ii = InstructionIterable(code);
-        for (auto it = ii.begin(); it != ii.end(); it++) {
-          auto insn = it->insn;
-          if (!opcode::is_an_invoke(insn->opcode())) {
-            continue;
-          }
-          const auto next = std::next(it);
-          always_assert(next != ii.end());
-          const auto peek = next->insn;
-          if (!opcode::is_a_move_result(peek->opcode())) {
-            continue;
-          }
-          auto method = insn->get_method()->as_def();
-          if (!method) {
-            // TODO: T31388603 -- Remove unused results for true virtuals.
-            continue;
-          }
-          result_used.insert(method);
+void CallsiteIndex::index(DexMethod* caller) {
+  auto code = caller->get_code();
+  if (code == nullptr) {
+    return;
+  }
+  Invokes invokes;
+  const auto ii = InstructionIterable(code);
+  for (auto it = ii.begin(); it != ii.end(); it++) {
+    auto insn = it->insn;
+    if (!opcode::is_an_invoke(insn->opcode())) {
+      continue;
+    }
+    auto callee = insn->get_method()->as_def();
+    if (callee == nullptr || callee->is_external()) {
+      // TODO: T31388603 -- Remove unused results for true virtuals.
+      invokes.unresolved_callee_protos.push_back(
+          insn->get_method()->get_proto());
+      continue;
+    }
+    const auto next = std::next(it);
+    always_assert(next != ii.end());
+    bool result_used = opcode::is_a_move_result(next->insn->opcode());
+    m_callsites.update(callee,
+                       [&](const DexMethod*, std::vector<Callsite>& callsites,
+                           bool /* exists */) {
+                         callsites.push_back({caller, insn, result_used});
+                       });
+    invokes.callees.push_back(callee);
+  }
+  sort_unique(invokes.callees);
+  m_invokes.update(caller,
+                   [&](const DexMethod*, Invokes& value, bool /* exists */) {
+                     value = std::move(invokes);
+                   });
+}
+
+const std::vector<CallsiteIndex::Callsite>* CallsiteIndex::callsites(
+    const DexMethod* callee) const {
+  auto it = m_callsites.find(callee);
+  return it == m_callsites.end() ? nullptr : &it->second;
+}
+
+bool CallsiteIndex::is_result_used(const DexMethod* callee) const {
+  auto callee_callsites = callsites(callee);
+  return callee_callsites != nullptr &&
+         std::any_of(callee_callsites->begin(), callee_callsites->end(),
+                     [](const Callsite& callsite) {
+                       return callsite.result_used;
+                     });
+}
+
+const std::vector<DexProto*>& CallsiteIndex::unresolved_callee_protos(
+    const DexMethod* caller) const {
+  static const std::vector<DexProto*> empty;
+  auto it = m_invokes.find(caller);
+  return it == m_invokes.end() ? empty : it->second.unresolved_callee_protos;
+}
+
+void CallsiteIndex::reindex(const std::vector<DexMethod*>& methods) {
+  workqueue_run<DexMethod*>(
+      [this](DexMethod* caller) {
+        Invokes old_invokes;
+        m_invokes.update(caller, [&](const DexMethod*, Invokes& value,
+                                     bool /* exists */) {
+          std::swap(old_invokes, value);
+        });
+        for (auto callee : old_invokes.callees) {
+          m_callsites.update(callee,
+                             [caller](const DexMethod*,
+                                      std::vector<Callsite>& callsites,
+                                      bool /* exists */) {
+                               std20::erase_if(callsites, [caller](auto& c) {
+                                 return c.caller == caller;
+                               });
+                             });
+          mark_changed(callee);
         }
-      });
+        mark_changed(caller);
+        index(caller);
+      },
+      methods);
+}
+
+bool CallsiteIndex::changed(const DexMethod* method) const {
+  return m_all_changed || m_changed.count(method);
+}
+
+void CallsiteIndex::mark_changed(const DexMethod* method) {
+  if (!m_all_changed) {
+    m_changed.insert(method);
+  }
+}
+
+void CallsiteIndex::clear_changed() {
+  m_all_changed = false;
+  m_changed.clear();
 }
 
 // For normalization, we put primitive types last and thus all reference types
@@ -161,8 +246,8 @@ void RemoveArgs::compute_reordered_protos(const mog::Graph& override_graph) {
   };
   walk::parallel::methods(
       m_scope,
-      [&override_graph, &record_fixed_proto,
-       &defined_protos](DexMethod* caller) {
+      [&override_graph, &record_fixed_proto, &defined_protos,
+       callsite_index = m_callsite_index](DexMethod* caller) {
         auto caller_proto = caller->get_proto();
         defined_protos.insert(caller_proto);
         if (!can_rename(caller) || is_native(caller)) {
@@ -190,23 +275,13 @@ void RemoveArgs::compute_reordered_protos(const mog::Graph& override_graph) {
           }
         }
 
-        IRCode* code = caller->get_code();
-        if (code == nullptr) {
-          return;
-        }
-        for (const auto& mie : InstructionIterable(code)) {
-          if (mie.insn->has_method()) {
-            auto callee = mie.insn->get_method();
-            auto callee_proto = callee->get_proto();
-            // We don't resolve here, but just check if the provided callee is
-            // already resolved. If not, we are going to be conservative. (Note
-            // that this matches what update_callsite does below.) We are also
-            // going to record any external callees as fixed.
-            DexMethod* callee_def = callee->as_def();
-            if (callee_def == nullptr || callee_def->is_external()) {
-              record_fixed_proto(callee_proto, 1);
-            }
-          }
+        // We don't resolve here, but just check if the provided callee is
+        // already resolved. If not, we are going to be conservative. (Note
+        // that this matches what update_callsite does below.) We are also
+        // going to record any external callees as fixed.
+        for (auto callee_proto :
+             callsite_index->unresolved_callee_protos(caller)) {
+          record_fixed_proto(callee_proto, 1);
         }
       });
 
@@ -422,7 +497,7 @@ bool RemoveArgs::update_method_signature(
 static void compute_dead_insns_and_remove_result(
     DexMethod* method,
     const mog::Graph& override_graph,
-    const ConcurrentSet<DexMethod*>& results_used,
+    const CallsiteIndex& callsite_index,
     std::deque<uint16_t>* live_arg_idxs,
     std::vector<IRInstruction*>* dead_insns,
     bool* remove_result) {
@@ -446,7 +521,7 @@ static void compute_dead_insns_and_remove_result(
   }
 
   auto proto = method->get_proto();
-  auto result_used = !!results_used.count_unsafe(method);
+  auto result_used = callsite_index.is_result_used(method);
   auto num_args = proto->get_args()->size();
   *remove_result = !proto->is_void() && !result_used;
 
@@ -538,9 +613,13 @@ RemoveArgs::MethodStats RemoveArgs::update_method_protos(
     if (it != m_reordered_protos.end()) {
       reordered_proto = it->second;
     } else {
-      // Only if there's no reordering, we'll look at dead args and results
+      // Only if there's no reordering, we'll look at dead args and results,
+      // and only if they may have changed since the previous iteration.
+      if (!m_callsite_index->changed(method)) {
+        return;
+      }
       compute_dead_insns_and_remove_result(method, override_graph,
-                                           m_result_used, &live_arg_idxs,
+                                           *m_callsite_index, &live_arg_idxs,
                                            &dead_insns, &remove_result);
       if (dead_insns.empty() && !remove_result) {
         return;
@@ -553,6 +632,8 @@ RemoveArgs::MethodStats RemoveArgs::update_method_protos(
                                       method->get_proto(), reordered_proto});
   });
 
+  m_callsite_index->clear_changed();
+
   // Phase 2: Deterministically update proto (including (re)name as needed)
 
   // Sort entries, so that we process all renaming operations in a
@@ -567,6 +648,7 @@ RemoveArgs::MethodStats RemoveArgs::update_method_protos(
 
   RemoveArgs::MethodStats method_stats;
   std::vector<DexClass*> classes;
+  std::vector<DexMethod*> dced_methods;
   std::unordered_map<DexClass*, std::vector<std::pair<DexMethod*, Entry>>>
       class_entries;
   for (auto& p : ordered_entries) {
@@ -574,8 +656,15 @@ RemoveArgs::MethodStats RemoveArgs::update_method_protos(
     const Entry& entry = p.second;
     if (!update_method_signature(method, entry.live_arg_idxs,
                                  entry.remove_result, entry.reordered_proto)) {
+      // Look at it again in the next iteration, as whatever got in the way
+      // may be gone by then.
+      m_callsite_index->mark_changed(method);
       continue;
     }
+    m_callsite_index->mark_changed(method);
+    if (entry.remove_result) {
+      dced_methods.push_back(method);
+    }
 
     // Remember entry for further processing, and log statistics
     DexClass* cls = type_class(method->get_class());
@@ -633,6 +722,8 @@ RemoveArgs::MethodStats RemoveArgs::update_method_protos(
       }
     }
   });
+  // Local DCE may have removed invokes.
+  m_callsite_index->reindex(dced_methods);
   return method_stats;
 }
 
@@ -673,26 +764,31 @@ size_t RemoveArgs::update_callsite(IRInstruction* instr) {
  * removed.
  */
 size_t RemoveArgs::update_callsites() {
-  // Walk through all methods to look for and edit callsites.
-  return walk::parallel::methods<size_t>(
-      m_scope, [&](DexMethod* method) -> size_t {
-        auto code = method->get_code();
-        if (code == nullptr) {
-          return 0;
+  // Only the callsites of updated methods need to be edited.
+  std::vector<DexMethod*> callees;
+  for (auto& p : m_live_arg_idxs_map) {
+    callees.push_back(p.first);
+  }
+  std::atomic<size_t> callsite_args_removed{0};
+  workqueue_run<DexMethod*>(
+      [&](DexMethod* callee) {
+        auto callsites = m_callsite_index->callsites(callee);
+        if (callsites == nullptr) {
+          return;
         }
-        size_t callsite_args_removed = 0;
-        for (const auto& mie : InstructionIterable(code)) {
-          auto insn = mie.insn;
-          if (opcode::is_an_invoke(insn->opcode())) {
-            size_t insn_args_removed = update_callsite(insn);
-            if (insn_args_removed > 0) {
-              log_opt(CALLSITE_ARGS_REMOVED, method, insn);
-              callsite_args_removed += insn_args_removed;
-            }
+        size_t args_removed = 0;
+        for (const auto& callsite : *callsites) {
+          size_t insn_args_removed = update_callsite(callsite.insn);
+          if (insn_args_removed > 0) {
+            log_opt(CALLSITE_ARGS_REMOVED, callsite.caller, callsite.insn);
+            m_callsite_index->mark_changed(callsite.caller);
+            args_removed += insn_args_removed;
           }
         }
-        return callsite_args_removed;
-      });
+        callsite_args_removed += args_removed;
+      },
+      callees);
+  return callsite_args_removed;
 }
 
 void RemoveUnusedArgsPass::run_pass(DexStoresVector& stores,
@@ -707,10 +803,14 @@ void RemoveUnusedArgsPass::run_pass(DexStoresVector& stores,
   size_t num_method_protos_reordered_count = 0;
   size_t num_iterations = 0;
   LocalDce::Stats local_dce_stats{0, 0};
+  CallsiteIndex callsite_index(scope);
   while (true) {
     num_iterations++;
-    RemoveArgs rm_args(scope, m_blocklist, m_total_iterations++);
-    auto pass_stats = rm_args.run();
+    RemoveArgs rm_args(scope, m_blocklist, m_total_iterations++,
+                       &callsite_index);
+    // Later iterations see the updated protos, which the preserved graph
+    // doesn't know about.
+    auto pass_stats = rm_args.run(num_iterations == 1 ? &mgr : nullptr);
     if (pass_stats.methods_updated_count == 0) {
       break;
     }
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <memory>
 #include <mutex>
 
 #include "ConcurrentContainers.h"
@@ -22,6 +23,58 @@ std::deque<uint16_t> compute_live_args(DexMethod* method,
                                        size_t num_args,
                                        std::vector<IRInstruction*>* dead_insns);
 
+/*
+ * The invokes of all methods in a scope, by callee. It is built once and kept
+ * up to date across the iterations of RemoveArgs, which then only recompute
+ * the methods that changed, and only rewrite the callsites of the methods
+ * whose signatures changed, instead of walking all code again.
+ */
+class CallsiteIndex {
+ public:
+  struct Callsite {
+    DexMethod* caller;
+    IRInstruction* insn;
+    // Whether the invoke is followed by a move-result.
+    bool result_used;
+  };
+
+  explicit CallsiteIndex(const Scope& scope);
+
+  // The invokes of the given method. Only invokes whose method reference is
+  // an internal definition are indexed.
+  const std::vector<Callsite>* callsites(const DexMethod* callee) const;
+
+  bool is_result_used(const DexMethod* callee) const;
+
+  // The protos of the invoked method references that are not internal
+  // definitions, once per invoke.
+  const std::vector<DexProto*>& unresolved_callee_protos(
+      const DexMethod* caller) const;
+
+  // Indexes the given methods again, after their code changed. They, and the
+  // methods they no longer invoke, are marked as changed.
+  void reindex(const std::vector<DexMethod*>& methods);
+
+  // Whether the code of the method, or how its result is used, may have
+  // changed since the last clear_changed() call. Initially, all methods have.
+  bool changed(const DexMethod* method) const;
+  void mark_changed(const DexMethod* method);
+  void clear_changed();
+
+ private:
+  struct Invokes {
+    std::vector<const DexMethod*> callees;
+    std::vector<DexProto*> unresolved_callee_protos;
+  };
+
+  void index(DexMethod* caller);
+
+  ConcurrentMap<const DexMethod*, std::vector<Callsite>> m_callsites;
+  ConcurrentMap<const DexMethod*, Invokes> m_invokes;
+  ConcurrentSet<const DexMethod*> m_changed;
+  bool m_all_changed{true};
+};
+
 class RemoveArgs {
  public:
   struct MethodStats {
@@ -40,14 +93,26 @@ class RemoveArgs {
     LocalDce::Stats local_dce_stats{0, 0};
   };
 
+  /*
+   * Without a callsite index, one is built for the scope by run().
+   */
   RemoveArgs(const Scope& scope,
              const std::vector<std::string>& blocklist,
-             size_t iteration = 0)
-      : m_scope(scope), m_blocklist(blocklist), m_iteration(iteration){};
-  RemoveArgs::PassStats run();
+             size_t iteration = 0,
+             CallsiteIndex* callsite_index = nullptr)
+      : m_scope(scope),
+        m_callsite_index(callsite_index),
+        m_blocklist(blocklist),
+        m_iteration(iteration){};
+  /*
+   * Reuses the method override graph preserved by the given manager, if any.
+   */
+  RemoveArgs::PassStats run(const PassManager* mgr = nullptr);
 
  private:
   const Scope& m_scope;
+  CallsiteIndex* m_callsite_index;
+  std::unique_ptr<CallsiteIndex> m_owned_callsite_index;
   ConcurrentMap<DexMethod*, std::deque<uint16_t>> m_live_arg_idxs_map;
   // Data structure to remember running indices to make method names unique when
   // we reorder prototypes across virtual scopes, or do other general changes to
@@ -58,7 +123,6 @@ class RemoveArgs {
     std::unordered_map<DexTypeList*, size_t> general_uniquifiers;
   };
   std::unordered_map<DexString*, NamedRenameMap> m_rename_maps;
-  ConcurrentSet<DexMethod*> m_result_used;
   std::unordered_map<DexProto*, DexProto*> m_reordered_protos;
   const std::vector<std::string>& m_blocklist;
   size_t m_iteration;
@@ -72,7 +136,6 @@ class RemoveArgs {
   MethodStats update_method_protos(const mog::Graph& override_graph);
   size_t update_callsite(IRInstruction* instr);
   size_t update_callsites();
-  void gather_results_used();
   void compute_reordered_protos(const mog::Graph& override_graph);
 };
 
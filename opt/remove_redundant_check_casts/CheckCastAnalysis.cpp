@@ -312,7 +312,7 @@ DexType* CheckCastAnalysis::weaken_to_demand(
   always_assert(!demands.count(nullptr));
   auto meets_demands = [&](DexType* t) {
     for (auto d : demands) {
-      if (!type::check_cast(t, d)) {
+      if (!check_cast(t, d)) {
         return false;
       }
     }
@@ -343,10 +343,12 @@ DexType* CheckCastAnalysis::weaken_to_demand(
 }
 
 CheckCastAnalysis::CheckCastAnalysis(const CheckCastConfig& config,
-                                     DexMethod* method)
+                                     DexMethod* method,
+                                     const SubtypeIndex* subtypes)
     : m_class_cast_exception_type(
           DexType::make_type("Ljava/lang/ClassCastException;")),
-      m_method(method) {
+      m_method(method),
+      m_subtypes(subtypes) {
   always_assert(m_class_cast_exception_type);
   if (!method || !method->get_code()) {
     return;
@@ -448,7 +450,7 @@ CheckCastAnalysis::CheckCastAnalysis(const CheckCastConfig& config,
         always_assert(
             std::find_if(demands.begin(), demands.end(), [&](DexType* demand) {
               return !weakened_types.count(demand) &&
-                     type::check_cast(demand, weakened_type);
+                     check_cast(demand, weakened_type);
             }) != demands.end());
       }
     }
@@ -523,7 +525,7 @@ bool CheckCastAnalysis::is_check_cast_redundant(IRInstruction* insn,
   }
 
   auto dex_type = env.get_dex_type(reg);
-  if (dex_type && type::check_cast(*dex_type, check_type)) {
+  if (dex_type && check_cast(*dex_type, check_type)) {
     return true;
   }
 
@@ -554,6 +556,12 @@ bool CheckCastAnalysis::can_catch_class_cast_exception(
   return false;
 }
 
+bool CheckCastAnalysis::check_cast(const DexType* type,
+                                   const DexType* base_type) const {
+  return m_subtypes ? m_subtypes->check_cast(type, base_type)
+                    : type::check_cast(type, base_type);
+}
+
 } // namespace impl
 
 } // namespace check_casts
@@ -12,6 +12,7 @@
 
 #include "CheckCastConfig.h"
 #include "ControlFlow.h"
+#include "SubtypeIndex.h"
 #include "TypeInference.h"
 
 namespace check_casts {
@@ -41,7 +42,11 @@ using CheckCastReplacements = std::vector<CheckCastReplacementItem>;
 class CheckCastAnalysis {
 
  public:
-  explicit CheckCastAnalysis(const CheckCastConfig& config, DexMethod* method);
+  // The subtype index, if given, answers the check-cast queries between types
+  // instead of walking the class hierarchy each time.
+  explicit CheckCastAnalysis(const CheckCastConfig& config,
+                             DexMethod* method,
+                             const SubtypeIndex* subtypes = nullptr);
   CheckCastReplacements collect_redundant_checks_replacement() const;
 
  private:
@@ -52,9 +57,11 @@ class CheckCastAnalysis {
   bool is_check_cast_redundant(IRInstruction* insn, DexType* check_type) const;
   type_inference::TypeInference* get_type_inference() const;
   bool can_catch_class_cast_exception(cfg::Block* block) const;
+  bool check_cast(const DexType* type, const DexType* base_type) const;
 
   DexType* m_class_cast_exception_type;
   DexMethod* m_method;
+  const SubtypeIndex* m_subtypes;
   using InstructionTypeDemands =
       std::unordered_map<IRInstruction*, std::unordered_set<DexType*>>;
   std::unique_ptr<InstructionTypeDemands> m_insn_demands;
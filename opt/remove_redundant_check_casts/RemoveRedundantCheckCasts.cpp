@@ -16,14 +16,15 @@
 namespace check_casts {
 
 impl::Stats remove_redundant_check_casts(const CheckCastConfig& config,
-                                         DexMethod* method) {
+                                         DexMethod* method,
+                                         const SubtypeIndex* subtypes) {
   if (!method || !method->get_code() || method->rstate.no_optimizations()) {
     return impl::Stats{};
   }
 
   auto* code = method->get_code();
   code->build_cfg(/* editable */ true);
-  impl::CheckCastAnalysis analysis(config, method);
+  impl::CheckCastAnalysis analysis(config, method, subtypes);
   auto casts = analysis.collect_redundant_checks_replacement();
   auto stats = impl::apply(method, casts);
 
@@ -39,10 +40,11 @@ void RemoveRedundantCheckCastsPass::run_pass(DexStoresVector& stores,
                                              ConfigFiles&,
                                              PassManager& mgr) {
   auto scope = build_class_scope(stores);
+  auto subtypes = SubtypeIndexAnalysisPass::get_or_build(&mgr, scope);
 
   auto stats =
       walk::parallel::methods<impl::Stats>(scope, [&](DexMethod* method) {
-        return remove_redundant_check_casts(m_config, method);
+        return remove_redundant_check_casts(m_config, method, subtypes.get());
       });
 
   mgr.set_metric("num_removed_casts", stats.removed_casts);
@@ -7,8 +7,10 @@
 
 #pragma once
 
+#include "AnalysisUsage.h"
 #include "CheckCastConfig.h"
 #include "Pass.h"
+#include "SubtypeIndexAnalysis.h"
 
 namespace check_casts {
 
@@ -16,6 +18,12 @@ class RemoveRedundantCheckCastsPass : public Pass {
  public:
   RemoveRedundantCheckCastsPass() : Pass("RemoveRedundantCheckCastsPass") {}
 
+  void set_analysis_usage(AnalysisUsage& au) const override {
+    Pass::set_analysis_usage(au);
+    // Only rewrites casts; leaves the class hierarchy alone.
+    au.add_preserve_specific<SubtypeIndexAnalysisPass>();
+  }
+
   void bind_config() override;
   void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
 
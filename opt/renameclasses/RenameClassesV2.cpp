@@ -27,6 +27,7 @@
 #include "TypeStringRewriter.h"
 #include "Walkers.h"
 #include "Warning.h"
+#include "WorkQueue.h"
 
 #include "Trace.h"
 #include <locator.h>
@@ -630,6 +631,15 @@ void RenameClassesPassV2::rename_classes(Scope& scope,
                                          bool rename_annotations,
                                          PassManager& mgr) {
   rewriter::TypeStringMap name_mapping;
+  // The new descriptors are picked in order, and then made into DexStrings in
+  // parallel, along with those of the array types of the renamed classes.
+  struct Renaming {
+    DexClass* clazz;
+    std::string descriptor;
+    DexString* dstring;
+    std::vector<std::pair<DexType*, DexString*>> array_types;
+  };
+  std::vector<Renaming> renamings;
   uint32_t sequence = 0;
   for (auto clazz : scope) {
     auto dtype = clazz->get_type();
@@ -675,35 +685,57 @@ void RenameClassesPassV2::rename_classes(Scope& scope,
     TRACE(RENAME, 2, "'%s' ->  %s (%u)'", oldname->c_str(),
           prefixed_descriptor.c_str(), sequence);
 
-    auto dstring = DexString::make_string(prefixed_descriptor);
+    renamings.push_back({clazz, std::move(prefixed_descriptor), nullptr, {}});
+  }
+
+  std::vector<Renaming*> renaming_ptrs;
+  renaming_ptrs.reserve(renamings.size());
+  for (auto& renaming : renamings) {
+    renaming_ptrs.push_back(&renaming);
+  }
+  workqueue_run<Renaming*>(
+      [](Renaming* renaming) {
+        auto oldname = renaming->clazz->get_name();
+        auto dstring = DexString::make_string(renaming->descriptor);
+        renaming->dstring = dstring;
+        while (1) {
+          std::string arrayop("[");
+          arrayop += oldname->c_str();
+          oldname = DexString::get_string(arrayop);
+          if (oldname == nullptr) {
+            break;
+          }
+          auto arraytype = DexType::get_type(oldname);
+          if (arraytype == nullptr) {
+            break;
+          }
+          std::string newarraytype("[");
+          newarraytype += dstring->c_str();
+          dstring = DexString::make_string(newarraytype);
+          renaming->array_types.emplace_back(arraytype, dstring);
+        }
+      },
+      renaming_ptrs);
+
+  for (auto& renaming : renamings) {
+    auto clazz = renaming.clazz;
+    auto dtype = clazz->get_type();
+    auto oldname = dtype->get_name();
+    auto dstring = renaming.dstring;
 
     always_assert_log(!DexType::get_type(dstring),
                       "Type name collision detected. %s already exists.",
-                      prefixed_descriptor.c_str());
+                      renaming.descriptor.c_str());
 
     name_mapping.add_type_name(clazz->get_name(), dstring);
     dtype->set_name(dstring);
-    std::string old_str(oldname->c_str());
     // std::string new_str(descriptor);
     // proguard_map.update_class_mapping(old_str, new_str);
     m_base_strings_size += strlen(oldname->c_str());
     m_ren_strings_size += strlen(dstring->c_str());
 
-    while (1) {
-      std::string arrayop("[");
-      arrayop += oldname->c_str();
-      oldname = DexString::get_string(arrayop);
-      if (oldname == nullptr) {
-        break;
-      }
-      auto arraytype = DexType::get_type(oldname);
-      if (arraytype == nullptr) {
-        break;
-      }
-      std::string newarraytype("[");
-      newarraytype += dstring->c_str();
-      dstring = DexString::make_string(newarraytype);
-      arraytype->set_name(dstring);
+    for (auto& pair : renaming.array_types) {
+      pair.first->set_name(pair.second);
     }
   }
 
@@ -5,6 +5,7 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <algorithm>
 #include <iostream>
 #include <memory>
 #include <string>
@@ -186,7 +187,7 @@ void AnalysisImpl::filter_do_not_strip() {
       escape_interface(intf_it.first, DO_NOT_STRIP);
     }
   }
-  walk::methods(scope, [this](DexMethod* method) {
+  walk::parallel::methods(scope, [this](DexMethod* method) {
     if (root(method)) {
       for (auto arg_type : *method->get_proto()->get_args()) {
         if (single_impls.count(arg_type)) {
@@ -198,7 +199,7 @@ void AnalysisImpl::filter_do_not_strip() {
       }
     }
   });
-  walk::fields(scope, [this](DexField* field) {
+  walk::parallel::fields(scope, [this](DexField* field) {
     if (root(field)) {
       if (single_impls.count(field->get_type())) {
         escape_interface(field->get_type(), DO_NOT_STRIP);
@@ -322,13 +323,20 @@ void AnalysisImpl::remove_escaped() {
  * Find all fields typed with the single impl interface.
  */
 void AnalysisImpl::collect_field_defs() {
-  walk::fields(scope, [&](DexField* field) {
+  walk::parallel::fields(scope, [&](DexField* field) {
     auto type = field->get_type();
     auto intf = get_and_check_single_impl(type);
     if (intf) {
-      single_impls[intf].fielddefs.push_back(field);
+      auto& si = single_impls.at(intf);
+      std::lock_guard<std::mutex> lock(si.mutex);
+      si.fielddefs.push_back(field);
     }
   });
+  // The fields were found in parallel, keep them in a stable order.
+  for (auto& intf_it : single_impls) {
+    auto& fielddefs = intf_it.second.fielddefs;
+    std::sort(fielddefs.begin(), fielddefs.end(), compare_dexfields);
+  }
 }
 
 /**
@@ -344,10 +352,12 @@ void AnalysisImpl::collect_method_defs() {
     if (native) {
       escape_interface(intf, NATIVE_METHOD);
     }
-    single_impls[intf].methoddefs.insert(method);
+    auto& si = single_impls.at(intf);
+    std::lock_guard<std::mutex> lock(si.mutex);
+    si.methoddefs.insert(method);
   };
 
-  walk::methods(scope, [&](DexMethod* method) {
+  walk::parallel::methods(scope, [&](DexMethod* method) {
     auto proto = method->get_proto();
     bool native = is_native(method);
     check_method_arg(proto->get_rtype(), method, native);
@@ -184,7 +184,7 @@ struct OptimizationImpl {
   EscapeReason can_optimize(const DexType* intf,
                             const SingleImplData& data,
                             bool rename_on_collision);
-  CheckCastSet do_optimize(const DexType* intf, const SingleImplData& data);
+  void do_optimize(const DexType* intf, const SingleImplData& data);
   EscapeReason check_field_collision(const DexType* intf,
                                      const SingleImplData& data);
   EscapeReason check_method_collision(const DexType* intf,
@@ -194,8 +194,8 @@ struct OptimizationImpl {
                                   DexMethod* method);
   void set_field_defs(const DexType* intf, const SingleImplData& data);
   void set_field_refs(const DexType* intf, const SingleImplData& data);
-  CheckCastSet fix_instructions(const DexType* intf,
-                                const SingleImplData& data);
+  void collect_check_casts(const DexType* intf, const SingleImplData& data);
+  CheckCastSet insert_check_casts();
   void set_method_defs(const DexType* intf, const SingleImplData& data);
   void set_method_refs(const DexType* intf, const SingleImplData& data);
   void rewrite_interface_methods(const DexType* intf,
@@ -215,6 +215,22 @@ struct OptimizationImpl {
   std::unordered_set<DexType*> optimized;
   const ClassHierarchy& ch;
   std::unordered_map<std::string, size_t> deobfuscated_name_counters;
+
+  // The check-casts that an optimized interface needs before some sources of
+  // an instruction.
+  struct CheckCastFix {
+    IRList::iterator insn_it;
+    IRInstruction* insn;
+    std::vector<size_t> srcs;
+  };
+  struct CheckCastFixes {
+    DexType* cls;
+    std::vector<CheckCastFix> insns;
+  };
+  // For each method, the check-casts to insert for each optimized interface,
+  // in the order the interfaces were optimized in.
+  std::unordered_map<DexMethod*, std::vector<CheckCastFixes>>
+      m_check_cast_fixes;
 };
 
 /**
@@ -302,118 +318,116 @@ void for_all_methods(const T& methods, Fn fn, bool parallel = true) {
 //     foo(i); // Java source needs cast here.
 //   }
 //
-// This method inserts check-casts for each invoke parameter and
-// field value. Expectation is that unnecessary insertions (e.g.,
-// duplicate check-casts) will be eliminated, for example, in
-// `post_process`.
-CheckCastSet OptimizationImpl::fix_instructions(const DexType* intf,
-                                                const SingleImplData& data) {
-  if (data.referencing_methods.empty()) {
-    return {};
+// This method collects check-casts for each invoke parameter and
+// field value, while the instructions still refer to the interface.
+// `insert_check_casts` then inserts them for all optimized interfaces at
+// once, in a single parallel walk over the methods. Expectation is that
+// unnecessary insertions (e.g., duplicate check-casts) will be eliminated,
+// for example, in `post_process`.
+void OptimizationImpl::collect_check_casts(const DexType* intf,
+                                           const SingleImplData& data) {
+  for (const auto& p : data.referencing_methods) {
+    CheckCastFixes fixes{data.cls, {}};
+    for (const auto& insn_it_pair : p.second) {
+      auto insn_it = insn_it_pair.second;
+      auto insn = insn_it_pair.first;
+
+      std::vector<size_t> srcs;
+      if (opcode::is_an_invoke(insn->opcode())) {
+        // We need check-casts for receiver and parameters, but not
+        // return type.
+
+        auto mref = insn->get_method();
+
+        // Receiver.
+        if (mref->get_class() == intf) {
+          srcs.push_back(0);
+        }
+
+        // Parameters.
+        const auto& arg_list = mref->get_proto()->get_args()->get_type_list();
+        size_t idx = insn->opcode() == OPCODE_INVOKE_STATIC ? 0 : 1;
+        for (const auto arg : arg_list) {
+          if (arg == intf) {
+            srcs.push_back(idx);
+          }
+          idx++;
+        }
+      } else if (opcode::is_an_iput(insn->opcode()) ||
+                 opcode::is_an_sput(insn->opcode())) {
+        // If the field type is the interface, need a check-cast.
+        auto fdef = insn->get_field();
+        if (fdef->get_type() == intf) {
+          srcs.push_back(0);
+        }
+      }
+      // Others do not need fixup.
+
+      if (!srcs.empty()) {
+        fixes.insns.push_back({insn_it, insn, std::move(srcs)});
+      }
+    }
+    if (!fixes.insns.empty()) {
+      m_check_cast_fixes[p.first].push_back(std::move(fixes));
+    }
   }
+}
+
+CheckCastSet OptimizationImpl::insert_check_casts() {
   std::vector<const DexMethod*> methods;
-  methods.reserve(data.referencing_methods.size());
-  std::transform(data.referencing_methods.begin(),
-                 data.referencing_methods.end(), std::back_inserter(methods),
-                 [](auto& p) { return p.first; });
-  // The typical number of methods is too small, it is actually significant
-  // overhead to spin up pool threads to just let them die.
-  constexpr bool PARALLEL = false;
+  methods.reserve(m_check_cast_fixes.size());
+  for (const auto& p : m_check_cast_fixes) {
+    methods.push_back(p.first);
+  }
 
   std::mutex ret_lock;
   CheckCastSet ret;
 
-  for_all_methods(
-      methods,
-      [&](const DexMethod* caller_const) {
-        auto caller = const_cast<DexMethod*>(caller_const);
-        std::vector<reg_t> temps; // Cached temps.
-        auto code = caller->get_code();
-        redex_assert(!code->editable_cfg_built());
-
-        for (const auto& insn_it_pair : data.referencing_methods.at(caller)) {
-          auto insn_it = insn_it_pair.second;
-          auto insn = insn_it_pair.first;
-
-          auto temp_it = temps.begin();
-          auto add_check_cast = [&](reg_t reg) {
-            auto check_cast = new IRInstruction(OPCODE_CHECK_CAST);
-            check_cast->set_src(0, reg);
-            check_cast->set_type(data.cls);
-            code->insert_before(insn_it, *new MethodItemEntry(check_cast));
-
-            if (PARALLEL) {
-              std::unique_lock<std::mutex> lock(ret_lock);
-              ret.insert(check_cast);
-            } else {
-              ret.insert(check_cast);
-            }
-
-            // See if we need a new temp.
-            reg_t out;
-            if (temp_it == temps.end()) {
-              reg_t new_temp = code->allocate_temp();
-              temps.push_back(new_temp);
-              temp_it = temps.end();
-              out = new_temp;
-            } else {
-              out = *temp_it;
-              temp_it++;
-            }
-
-            auto pseudo_move_result =
-                new IRInstruction(IOPCODE_MOVE_RESULT_PSEUDO_OBJECT);
-            pseudo_move_result->set_dest(out);
-            code->insert_before(insn_it,
-                                *new MethodItemEntry(pseudo_move_result));
-
-            return out;
-          };
-
-          if (opcode::is_an_invoke(insn->opcode())) {
-            // We need check-casts for receiver and parameters, but not
-            // return type.
-
-            auto mref = insn->get_method();
-
-            // Receiver.
-            if (mref->get_class() == intf) {
-              reg_t new_receiver = add_check_cast(insn->src(0));
-              insn->set_src(0, new_receiver);
-            }
-
-            // Parameters.
-            const auto& arg_list =
-                mref->get_proto()->get_args()->get_type_list();
-            size_t idx = insn->opcode() == OPCODE_INVOKE_STATIC ? 0 : 1;
-            for (const auto arg : arg_list) {
-              if (arg != intf) {
-                idx++;
-                continue;
-              }
-
-              reg_t new_param = add_check_cast(insn->src(idx));
-              insn->set_src(idx, new_param);
-              idx++;
-            }
-            continue;
+  for_all_methods(methods, [&](const DexMethod* caller_const) {
+    auto caller = const_cast<DexMethod*>(caller_const);
+    auto code = caller->get_code();
+    redex_assert(!code->editable_cfg_built());
+
+    CheckCastSet inserted;
+    // The fixes of each interface are applied in the order the interfaces
+    // were optimized in.
+    for (const auto& fixes : m_check_cast_fixes.at(caller)) {
+      std::vector<reg_t> temps; // Cached temps.
+      for (const auto& fix : fixes.insns) {
+        auto temp_it = temps.begin();
+        for (auto src : fix.srcs) {
+          auto check_cast = new IRInstruction(OPCODE_CHECK_CAST);
+          check_cast->set_src(0, fix.insn->src(src));
+          check_cast->set_type(fixes.cls);
+          code->insert_before(fix.insn_it, *new MethodItemEntry(check_cast));
+          inserted.insert(check_cast);
+
+          // See if we need a new temp.
+          reg_t out;
+          if (temp_it == temps.end()) {
+            reg_t new_temp = code->allocate_temp();
+            temps.push_back(new_temp);
+            temp_it = temps.end();
+            out = new_temp;
+          } else {
+            out = *temp_it;
+            temp_it++;
           }
 
-          if (opcode::is_an_iput(insn->opcode()) ||
-              opcode::is_an_sput(insn->opcode())) {
-            // If the field type is the interface, need a check-cast.
-            auto fdef = insn->get_field();
-            if (fdef->get_type() == intf) {
-              reg_t new_param = add_check_cast(insn->src(0));
-              insn->set_src(0, new_param);
-            }
-            continue;
-          }
+          auto pseudo_move_result =
+              new IRInstruction(IOPCODE_MOVE_RESULT_PSEUDO_OBJECT);
+          pseudo_move_result->set_dest(out);
+          code->insert_before(fix.insn_it,
+                              *new MethodItemEntry(pseudo_move_result));
 
-          // Others do not need fixup.
+          fix.insn->set_src(src, out);
         }
-      },
-      PARALLEL);
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(ret_lock);
+    ret.insert(inserted.begin(), inserted.end());
+  });
 
   return ret;
 }
@@ -530,7 +544,7 @@ void OptimizationImpl::rewrite_annotations(Scope& scope,
     if (anno_set == nullptr) continue;
     for (auto& anno : anno_set->get_annotations()) {
       if (anno->type() != enclosingMethod) continue;
-      const auto& elems = anno->anno_elems();
+      const auto& elems = DexAnnotation::unshare(anno)->anno_elems();
       for (auto& elem : elems) {
         auto value = elem.encoded_value;
         if (value->evtype() == DexEncodedValueTypes::DEVT_METHOD) {
@@ -698,9 +712,9 @@ void OptimizationImpl::rename_possible_collisions(const DexType* intf,
 /**
  * Perform the optimization.
  */
-CheckCastSet OptimizationImpl::do_optimize(const DexType* intf,
-                                           const SingleImplData& data) {
-  CheckCastSet ret = fix_instructions(intf, data);
+void OptimizationImpl::do_optimize(const DexType* intf,
+                                   const SingleImplData& data) {
+  collect_check_casts(intf, data);
   set_type_refs(intf, data);
   set_field_defs(intf, data);
   set_field_refs(intf, data);
@@ -708,7 +722,6 @@ CheckCastSet OptimizationImpl::do_optimize(const DexType* intf,
   set_method_refs(intf, data);
   rewrite_interface_methods(intf, data);
   remove_interface(intf, data);
-  return ret;
 }
 
 /**
@@ -720,7 +733,6 @@ OptimizeStats OptimizationImpl::optimize(Scope& scope,
   single_impls->get_interfaces(to_optimize);
   std::sort(to_optimize.begin(), to_optimize.end(), compare_dextypes);
   std::unordered_set<DexMethod*> for_post_processing;
-  CheckCastSet inserted_check_casts;
   for (auto intf : to_optimize) {
     auto& intf_data = single_impls->get_single_impl_data(intf);
     if (intf_data.is_escaped()) continue;
@@ -730,13 +742,13 @@ OptimizeStats OptimizationImpl::optimize(Scope& scope,
       single_impls->escape_interface(intf, escape);
       continue;
     }
-    auto check_casts = do_optimize(intf, intf_data);
-    inserted_check_casts.insert(check_casts.begin(), check_casts.end());
+    do_optimize(intf, intf_data);
     for (auto& p : intf_data.referencing_methods) {
       for_post_processing.insert(p.first);
     }
     optimized.insert(intf);
   }
+  auto inserted_check_casts = insert_check_casts();
 
   // make a new scope deleting all single impl interfaces
   Scope new_scope;
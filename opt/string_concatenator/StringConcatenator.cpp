@@ -16,6 +16,7 @@
 #include "ControlFlow.h"
 #include "DexClass.h"
 #include "IRCode.h"
+#include "MethodUtil.h"
 #include "PassManager.h"
 #include "Resolver.h"
 #include "Show.h"
@@ -387,6 +388,11 @@ void StringConcatenatorPass::run_pass(DexStoresVector& stores,
           // will have to consider StringBuilders passed in as arguments.
           return Stats{};
         }
+        if (!method::has_invoke_of(*code, config.to_string)) {
+          // Without a toString() call there is no concatenated string to
+          // resolve, so don't bother building a cfg.
+          return Stats{};
+        }
 
         code->build_cfg(/* editable */ true);
         Stats stats =
@@ -14,6 +14,7 @@
 #include "Creators.h"
 #include "DexAsm.h"
 #include "DexClass.h"
+#include "MethodUtil.h"
 #include "PassManager.h"
 #include "Show.h"
 #include "Trace.h"
@@ -197,13 +198,17 @@ void Outliner::gather_outline_candidate_typelists(
 }
 
 void Outliner::analyze(IRCode& code) {
+  // Do a quick one-pass scan to see if the method has any instructions that may
+  // be outlinable. Only build a cfg and do the more expensive fixpoint
+  // calculations if the method passes this check.
+  if (!method::has_invoke_of(code, m_stringbuilder_tostring)) {
+    return;
+  }
+
   code.build_cfg(/* editable */ false); // Not editable because of T42743620
   auto& cfg = code.cfg();
   cfg.calculate_exit_block();
 
-  // Do a quick one-pass scan to see if the method has any instructions that may
-  // be outlinable. Only do the more expensive fixpoint calculations if the
-  // method passes this check.
   auto tostring_instructions = find_tostring_instructions(cfg);
   if (tostring_instructions.empty()) {
     return;
@@ -112,11 +112,19 @@ bool StripDebugInfo::should_drop_for_synth(const DexMethod* method) const {
 }
 
 Stats StripDebugInfo::run(const Scope& scope) {
-  Stats stats;
-  walk::code(scope, [&](DexMethod* meth, IRCode& code) {
-    stats += run(code, should_drop_for_synth(meth));
+  return walk::parallel::methods<Stats>(scope, [&](DexMethod* meth) {
+    auto code = meth->get_code();
+    if (code == nullptr) {
+      return Stats();
+    }
+    auto stats = run(*code, should_drop_for_synth(meth));
+    // Free the positions that no instruction is attributed to anymore now,
+    // instead of only when the method is next linearized from a CFG.
+    if (!code->cfg_built()) {
+      code->remove_redundant_positions();
+    }
+    return stats;
   });
-  return stats;
 }
 
 Stats StripDebugInfo::run(IRCode& code, bool should_drop_synth) {
@@ -132,7 +140,9 @@ Stats StripDebugInfo::run(IRCode& code, bool should_drop_synth) {
       // any of the debug entries for :meth to be output, we still want to
       // erase those entries here so that transformations like inlining won't
       // move these entries into a method that does have a debug item.
-      it = code.erase(it);
+      // Either all positions are removed or none, so no remaining position
+      // can have one of the freed ones as parent.
+      it = code.erase_and_dispose(it);
     } else {
       switch (mie.type) {
       case MFLOW_DEBUG:
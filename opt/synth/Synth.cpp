@@ -8,6 +8,7 @@
 #include "Synth.h"
 
 #include <memory>
+#include <numeric>
 #include <signal.h>
 #include <stdio.h>
 #include <string>
@@ -35,6 +36,7 @@
 #include "Show.h"
 #include "SynthConfig.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 constexpr const char* METRIC_GETTERS_REMOVED = "getter_methods_removed_count";
 constexpr const char* METRIC_WRAPPERS_REMOVED = "wrapper_methods_removed_count";
@@ -590,6 +592,14 @@ struct MethodAnalysisResult {
   std::vector<std::tuple<IRInstruction*, DexMethod*, DexMethod*>> wrapper_calls;
   std::vector<std::tuple<IRInstruction*, DexMethod*, DexMethod*>> wrapped_calls;
   std::vector<std::pair<IRInstruction*, DexMethod*>> ctor_calls;
+  // Whether there were wrapped calls before any of them were pruned; invokes
+  // of wrappees that get promoted to static can only occur in such methods.
+  bool calls_wrapped{false};
+
+  bool empty() const {
+    return getter_calls.empty() && wrapper_calls.empty() &&
+           wrapped_calls.empty() && ctor_calls.empty();
+  }
 };
 
 std::unique_ptr<MethodAnalysisResult> analyze_method_concurrent(
@@ -658,6 +668,7 @@ std::unique_ptr<MethodAnalysisResult> analyze_method_concurrent(
       if (found_wrappee != ssms.wrapped.end()) {
         auto wrapper = found_wrappee->second.first;
         mar->wrapped_calls.emplace_back(insn, callee, wrapper);
+        mar->calls_wrapped = true;
         continue;
       }
 
@@ -874,48 +885,72 @@ void do_transform(const ClassHierarchy& ch,
   // method once, even if we mutate the class method lists such that we'd hit
   // something a second time.
   std::vector<DexMethod*> methods;
-  std::unordered_map<DexMethod*, std::unique_ptr<MethodAnalysisResult>>
-      method_analysis_results;
-  walk::code(classes, [&](DexMethod* meth, IRCode&) {
-    methods.emplace_back(meth);
-    method_analysis_results.emplace(meth,
-                                    std::unique_ptr<MethodAnalysisResult>());
-  });
+  walk::code(classes,
+             [&](DexMethod* meth, IRCode&) { methods.emplace_back(meth); });
 
   // Analyze methods in parallel (no mutation)
-  walk::parallel::code(classes, [&](DexMethod* meth, IRCode&) {
-    method_analysis_results.at(meth) = analyze_method_concurrent(meth, ssms);
-  });
+  std::vector<std::unique_ptr<MethodAnalysisResult>> method_analysis_results(
+      methods.size());
+  std::vector<size_t> indices(methods.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  workqueue_run<size_t>(
+      [&](size_t i) {
+        auto mar = analyze_method_concurrent(methods[i], ssms);
+        if (!mar->empty()) {
+          method_analysis_results[i] = std::move(mar);
+        }
+      },
+      indices);
+
+  // Only the methods that call a getter, wrapper, wrappee or constructor
+  // wrapper are transformed below.
+  std::vector<size_t> candidates;
+  for (size_t i = 0; i < methods.size(); i++) {
+    if (method_analysis_results[i]) {
+      candidates.push_back(i);
+    }
+  }
+  TRACE(SYNT, 2, "%zu of %zu methods call synthetic wrappers",
+        candidates.size(), methods.size());
 
   // Mutate method signatures (sequentially, as they are subtle dependencies)
-  for (auto const& meth : methods) {
-    auto* mar = method_analysis_results.at(meth).get();
-    replace_wrappers_sequential(ch, meth, ssms, mar);
+  for (auto i : candidates) {
+    replace_wrappers_sequential(ch, methods[i], ssms,
+                                method_analysis_results[i].get());
   }
 
   // Mutate method bodies (concurrently), and check that invokes to promoted
   // static method are correct
   std::atomic<size_t> patched_invokes{0};
-  walk::parallel::code(classes, [&](DexMethod* meth, IRCode& code) {
-    auto* mar = method_analysis_results.at(meth).get();
-    replace_wrappers_concurrent(meth, mar);
-    for (auto& mie : InstructionIterable(code)) {
-      auto* insn = mie.insn;
-      auto opcode = insn->opcode();
-      if (opcode != OPCODE_INVOKE_DIRECT) {
-        continue;
-      }
-      auto wrappee = resolve_method(insn->get_method(), MethodSearch::Direct);
-      if (wrappee == nullptr || ssms.promoted_to_static.count(wrappee) == 0) {
-        continue;
-      }
-      // change the opcode to invoke-static
-      insn->set_opcode(OPCODE_INVOKE_STATIC);
-      TRACE(SYNT, 3, "Updated invoke on promoted to static %s\n in method %s",
-            SHOW(wrappee), SHOW(meth));
-      patched_invokes++;
-    }
-  });
+  workqueue_run<size_t>(
+      [&](size_t i) {
+        auto meth = methods[i];
+        auto* mar = method_analysis_results[i].get();
+        replace_wrappers_concurrent(meth, mar);
+        if (!mar->calls_wrapped || ssms.promoted_to_static.empty()) {
+          return;
+        }
+        for (auto& mie : InstructionIterable(meth->get_code())) {
+          auto* insn = mie.insn;
+          auto opcode = insn->opcode();
+          if (opcode != OPCODE_INVOKE_DIRECT) {
+            continue;
+          }
+          auto wrappee =
+              resolve_method(insn->get_method(), MethodSearch::Direct);
+          if (wrappee == nullptr ||
+              ssms.promoted_to_static.count(wrappee) == 0) {
+            continue;
+          }
+          // change the opcode to invoke-static
+          insn->set_opcode(OPCODE_INVOKE_STATIC);
+          TRACE(SYNT, 3,
+                "Updated invoke on promoted to static %s\n in method %s",
+                SHOW(wrappee), SHOW(meth));
+          patched_invokes++;
+        }
+      },
+      candidates);
   remove_dead_methods(ssms, synthConfig, metrics);
   metrics.methods_staticized_count += ssms.promoted_to_static.size();
   metrics.patched_invokes_count += (size_t)patched_invokes;
@@ -234,10 +234,21 @@ UpCodeMotionPass::Stats UpCodeMotionPass::process_code(
     DexTypeList* args,
     IRCode* code,
     bool is_branch_hot_check) {
+  code->build_cfg(/* editable = true*/);
+  auto stats = process_cfg(is_static, declaring_type, args, code->cfg(),
+                           is_branch_hot_check);
+  code->clear_cfg();
+  return stats;
+}
+
+UpCodeMotionPass::Stats UpCodeMotionPass::process_cfg(
+    bool is_static,
+    DexType* declaring_type,
+    DexTypeList* args,
+    cfg::ControlFlowGraph& cfg,
+    bool is_branch_hot_check) {
   Stats stats;
 
-  code->build_cfg(/* editable = true*/);
-  auto& cfg = code->cfg();
   std::unique_ptr<type_inference::TypeInference> type_inference;
   std::unordered_set<cfg::Block*> blocks_to_remove_set;
   std::vector<cfg::Block*> blocks_to_remove;
@@ -365,8 +376,6 @@ UpCodeMotionPass::Stats UpCodeMotionPass::process_code(
   }
 
   cfg.remove_blocks(blocks_to_remove);
-
-  code->clear_cfg();
   return stats;
 }
 
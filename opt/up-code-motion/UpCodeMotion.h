@@ -46,6 +46,12 @@ class UpCodeMotionPass : public Pass {
                             IRCode*,
                             bool is_branch_hot_check);
 
+  static Stats process_cfg(bool is_static,
+                           DexType* declaring_type,
+                           DexTypeList* args,
+                           cfg::ControlFlowGraph&,
+                           bool is_branch_hot_check);
+
  private:
   bool m_check_if_branch_is_hot;
   static bool gather_movable_instructions(
@@ -14,6 +14,7 @@
 #include <unordered_set>
 #include <vector>
 
+#include "ConcurrentContainers.h"
 #include "ConfigFiles.h"
 #include "DexClass.h"
 #include "DexUtil.h"
@@ -27,8 +28,8 @@ namespace {
 
 const std::string CLASS_DEPENDENCY_FILENAME = "redex-class-dependencies.txt";
 
-using refs_t = std::unordered_map<const DexClass*,
-                                  std::set<DexClass*, dexclasses_comparator>>;
+using refs_t = ConcurrentMap<const DexClass*,
+                             std::set<DexClass*, dexclasses_comparator>>;
 using class_to_store_map_t = std::unordered_map<const DexClass*, DexStore*>;
 using allowed_store_map_t =
     std::unordered_map<std::string, std::set<std::string>>;
@@ -45,41 +46,46 @@ using allowed_store_map_t =
  */
 void build_refs(const Scope& scope, refs_t& class_refs) {
   // TODO: walk through annotations
-  walk::opcodes(
-      scope,
-      [](const DexMethod*) { return true; },
-      [&](const DexMethod* meth, IRInstruction* insn) {
-        if (insn->has_type()) {
-          const auto tref = type_class(insn->get_type());
-          if (tref) class_refs[tref].emplace(type_class(meth->get_class()));
-          return;
-        }
-        if (insn->has_field()) {
-          const auto tref = type_class(insn->get_field()->get_class());
-          if (tref) class_refs[tref].emplace(type_class(meth->get_class()));
-          return;
-        }
-        if (insn->has_method()) {
-          // log methods class type, for virtual methods, this may not actually
-          // exist and true verification would require that the binding refers
-          // to a class that is valid.
-          const auto mref = type_class(insn->get_method()->get_class());
-          if (mref) class_refs[mref].emplace(type_class(meth->get_class()));
-
-          // don't log return type or types of parameters for now, but this is
-          // how you might do it.
-          // const auto proto = insn->get_method()->get_proto();
-          // const auto rref = type_class(proto->get_rtype());
-          // if (rref) class_refs[rref].emplace(type_class(meth->get_class()));
-          // for (const auto arg : proto->get_args()->get_type_list()) {
-          //   const auto aref = type_class(arg);
-          //   if (aref)
-          //   class_refs[aref].emplace(type_class(meth->get_class()));
-          // }
-
-          return;
-        }
-      });
+  walk::parallel::code(scope, [&](const DexMethod* meth, IRCode& code) {
+    // Gather the targets of each method first, so that each of them is only
+    // inserted into the shared map once.
+    std::unordered_set<DexClass*> targets;
+    editable_cfg_adapter::iterate(&code, [&](const MethodItemEntry& mie) {
+      auto insn = mie.insn;
+      DexClass* tref = nullptr;
+      if (insn->has_type()) {
+        tref = type_class(insn->get_type());
+      } else if (insn->has_field()) {
+        tref = type_class(insn->get_field()->get_class());
+      } else if (insn->has_method()) {
+        // log methods class type, for virtual methods, this may not actually
+        // exist and true verification would require that the binding refers
+        // to a class that is valid.
+        tref = type_class(insn->get_method()->get_class());
+
+        // don't log return type or types of parameters for now, but this is
+        // how you might do it.
+        // const auto proto = insn->get_method()->get_proto();
+        // const auto rref = type_class(proto->get_rtype());
+        // if (rref) targets.insert(rref);
+        // for (const auto arg : proto->get_args()->get_type_list()) {
+        //   const auto aref = type_class(arg);
+        //   if (aref) targets.insert(aref);
+        // }
+      }
+      if (tref) {
+        targets.insert(tref);
+      }
+      return editable_cfg_adapter::LOOP_CONTINUE;
+    });
+    auto source = type_class(meth->get_class());
+    for (auto tref : targets) {
+      class_refs.update(tref,
+                        [source](const DexClass*, auto& sources, bool) {
+                          sources.emplace(source);
+                        });
+    }
+  });
 }
 
 DexStore& findStore(std::string& name, DexStoresVector& stores) {
@@ -112,12 +118,14 @@ std::set<std::string> getAllowedStores(DexStoresVector& stores,
 
 void verifyStore(DexStoresVector& stores,
                  DexStore& store,
-                 class_to_store_map_t map,
+                 const class_to_store_map_t& map,
                  const allowed_store_map_t& store_map,
                  FILE* fd) {
   refs_t class_refs;
   auto scope = build_class_scope(store.get_dexen());
   build_refs(scope, class_refs);
+  const std::set<std::string> allowed_stores =
+      getAllowedStores(stores, store, store_map);
   for (auto& ref : class_refs) {
     const auto target = ref.first;
     for (const auto& source : ref.second) {
@@ -128,8 +136,6 @@ void verifyStore(DexStoresVector& stores,
       } else {
         target_store_name = "external";
       }
-      std::set<std::string> allowed_stores =
-          getAllowedStores(stores, store, store_map);
       if (allowed_stores.find(target_store_name) == allowed_stores.end()) {
         TRACE(VERIFY, 5, "BAD REFERENCE from %s %s to %s %s",
               store.get_name().c_str(), show_deobfuscated(source).c_str(),
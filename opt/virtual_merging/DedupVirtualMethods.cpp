@@ -6,6 +6,7 @@
  */
 
 #include "DexUtil.h"
+#include "MethodDedup.h"
 #include "MethodOverrideGraph.h"
 #include "Show.h"
 #include "Trace.h"
@@ -42,6 +43,7 @@ bool eligible_code(const IRCode* code) {
 }
 
 void find_duplications(const method_override_graph::Graph* graph,
+                       const method_dedup::CodeHashIndex& hashes,
                        const DexMethod* root_method,
                        std::vector<DexMethod*>* result) {
   auto root_code = root_method->get_code();
@@ -54,11 +56,13 @@ void find_duplications(const method_override_graph::Graph* graph,
     if (root(child) || !child->is_def() || !can_rename(child)) {
       continue;
     }
-    auto child_code = child->get_code();
-    if (child_code && eligible_code(child_code) &&
-        root_code->structural_equals(*child_code)) {
+    // Only eligible code is indexed, and different hashes mean different
+    // code.
+    if (hashes.contains(child) &&
+        hashes.get(child) == hashes.get(root_method) &&
+        root_code->structural_equals(*child->get_code())) {
       result->push_back(const_cast<DexMethod*>(child));
-      find_duplications(graph, child, result);
+      find_duplications(graph, hashes, child, result);
     }
   }
 }
@@ -86,6 +90,15 @@ void publicize_methods(const method_override_graph::Graph* graph,
 uint32_t remove_duplicated_vmethods(const Scope& scope) {
   uint32_t ret = 0;
   auto graph = method_override_graph::build_graph(scope);
+  std::vector<DexMethod*> eligible_methods;
+  walk::classes(scope, [&](DexClass* cls) {
+    for (auto method : cls->get_vmethods()) {
+      if (method->get_code() && eligible_code(method->get_code())) {
+        eligible_methods.push_back(method);
+      }
+    }
+  });
+  method_dedup::CodeHashIndex hashes(eligible_methods);
 
   walk::classes(scope, [&](DexClass* cls) {
     for (auto method : cls->get_vmethods()) {
@@ -99,11 +112,11 @@ uint32_t remove_duplicated_vmethods(const Scope& scope) {
         // names when change the accessibility of them.
         continue;
       }
-      if (!eligible_code(method->get_code())) {
+      if (!hashes.contains(method)) {
         continue;
       }
       std::vector<DexMethod*> duplicates;
-      find_duplications(graph.get(), method, &duplicates);
+      find_duplications(graph.get(), hashes, method, &duplicates);
       if (!duplicates.empty()) {
         if (is_protected(method)) {
           publicize_methods(graph.get(), method);
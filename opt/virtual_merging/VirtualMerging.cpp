@@ -42,6 +42,8 @@
 
 #include "VirtualMerging.h"
 
+#include <numeric>
+
 #include "ABExperimentContext.h"
 #include "ConfigFiles.h"
 #include "ControlFlow.h"
@@ -56,6 +58,7 @@
 #include "StlUtil.h"
 #include "TypeSystem.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 namespace {
 
@@ -560,8 +563,12 @@ std::pair<std::vector<MethodData>, VirtualMergingStats> create_ordering(
     }
   }
 
-  // Sort out large methods already.
-  for (auto& p : ordering) {
+  // Sort out large methods already. This only looks at the methods, so the
+  // entries are filtered in parallel, each with its own stats.
+  std::vector<VirtualMergingStats> entry_stats(ordering.size());
+  auto filter = [&](size_t i) {
+    auto& p = ordering[i];
+    auto& local_stats = entry_stats[i];
     auto overridden_method = const_cast<DexMethod*>(p.first);
     for (auto& q : p.second) {
       q.second.erase(
@@ -578,7 +585,7 @@ std::pair<std::vector<MethodData>, VirtualMergingStats> create_ordering(
                         "[VM] %s is too large to be merged into %s",
                         SHOW(m),
                         SHOW(overridden_method));
-                  stats.huge_methods++;
+                  local_stats.huge_methods++;
                   return true;
                 }
 
@@ -597,7 +604,7 @@ std::pair<std::vector<MethodData>, VirtualMergingStats> create_ordering(
                         "[VM] Cannot inline %s into %s",
                         SHOW(m),
                         SHOW(overridden_method));
-                  stats.uninlinable_methods++;
+                  local_stats.uninlinable_methods++;
                   return true;
                 }
 
@@ -696,9 +703,15 @@ std::pair<std::vector<MethodData>, VirtualMergingStats> create_ordering(
               removals,
               num_methods,
               SHOW(overridden_method));
-        stats.caller_size_removed_methods += removals;
+        local_stats.caller_size_removed_methods += removals;
       }
     }
+  };
+  std::vector<size_t> indices(ordering.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  workqueue_run<size_t>(filter, indices);
+  for (const auto& local_stats : entry_stats) {
+    stats += local_stats;
   }
 
   // Remove methods that no longer have inlinees.
@@ -765,6 +778,117 @@ void check_remap(
   }
 }
 
+// Entries of the ordering that share methods, i.e. that merge into the same
+// method or into methods that are merged themselves, have to be processed
+// in order; all others are independent. Returns the indices of the entries of
+// each cluster of dependent entries.
+std::vector<std::vector<size_t>> get_clusters(
+    const std::vector<MethodData>& ordering) {
+  std::unordered_map<const DexMethod*, size_t> ids;
+  std::vector<size_t> parents;
+  auto get_id = [&](const DexMethod* m) {
+    auto it = ids.emplace(m, parents.size()).first;
+    if (it->second == parents.size()) {
+      parents.push_back(it->second);
+    }
+    return it->second;
+  };
+  auto find = [&](size_t id) {
+    while (parents[id] != id) {
+      parents[id] = parents[parents[id]];
+      id = parents[id];
+    }
+    return id;
+  };
+  for (const auto& p : ordering) {
+    auto root = find(get_id(p.first));
+    for (const auto& q : p.second) {
+      for (auto* m : q.second) {
+        parents[find(get_id(m))] = root;
+      }
+    }
+  }
+
+  std::unordered_map<size_t, size_t> cluster_indices;
+  std::vector<std::vector<size_t>> clusters;
+  for (size_t i = 0; i < ordering.size(); i++) {
+    auto root = find(ids.at(ordering[i].first));
+    auto it = cluster_indices.emplace(root, clusters.size()).first;
+    if (it->second == clusters.size()) {
+      clusters.emplace_back();
+    }
+    clusters[it->second].push_back(i);
+  }
+  return clusters;
+}
+
+// Applies the method function to all methods of the ordering, and makes the
+// overridden methods public and concrete upfront, so that merging doesn't
+// change their access flags while other clusters are merged. Returns the
+// formerly abstract methods.
+template <typename MethodFn>
+std::unordered_set<const DexMethod*> prepare_ordering(
+    std::vector<MethodData>& ordering,
+    const MethodFn& method_fn,
+    VirtualMergingStats& stats) {
+  std::unordered_set<const DexMethod*> unabstracted;
+  for (auto& p : ordering) {
+    auto overridden_method = const_cast<DexMethod*>(p.first);
+    bool has_overriding_methods = false;
+    for (auto& q : p.second) {
+      if (q.second.empty()) {
+        continue;
+      }
+      if (!has_overriding_methods) {
+        overridden_method = method_fn(overridden_method);
+        has_overriding_methods = true;
+      }
+      for (auto& m : q.second) {
+        m = method_fn(const_cast<DexMethod*>(m));
+      }
+    }
+    if (!has_overriding_methods) {
+      continue;
+    }
+    p.first = overridden_method;
+
+    // We make the method public to avoid visibility issues. We could be
+    // more conservative (i.e. taking the strongest visibility control
+    // that encompasses the original pair) but I'm not sure it's worth the
+    // effort.
+    set_public(overridden_method);
+    if (!is_abstract(overridden_method)) {
+      continue;
+    }
+    // We'll make the abstract method be not abstract, and give it a new
+    // method body with just load-param instructions as needed. Merging the
+    // first overriding method finishes it.
+    stats.unabstracted_methods++;
+    overridden_method->make_concrete(
+        (DexAccessFlags)(overridden_method->get_access() & ~ACC_ABSTRACT),
+        std::make_unique<IRCode>(),
+        true /* is_virtual */);
+    auto overridden_code = overridden_method->get_code();
+    auto load_param_insn = new IRInstruction(IOPCODE_LOAD_PARAM_OBJECT);
+    load_param_insn->set_dest(overridden_code->allocate_temp());
+    overridden_code->push_back(load_param_insn);
+    for (auto t : overridden_method->get_proto()->get_args()->get_type_list()) {
+      if (type::is_wide_type(t)) {
+        load_param_insn = new IRInstruction(IOPCODE_LOAD_PARAM_WIDE);
+        load_param_insn->set_dest(overridden_code->allocate_wide_temp());
+      } else {
+        load_param_insn =
+            new IRInstruction(type::is_object(t) ? IOPCODE_LOAD_PARAM_OBJECT
+                                                 : IOPCODE_LOAD_PARAM);
+        load_param_insn->set_dest(overridden_code->allocate_temp());
+      }
+      overridden_code->push_back(load_param_insn);
+    }
+    unabstracted.insert(overridden_method);
+  }
+  return unabstracted;
+}
+
 template <typename MethodFn>
 VirtualMergingStats apply_ordering(
     MultiMethodInliner& inliner,
@@ -774,25 +898,29 @@ VirtualMergingStats apply_ordering(
         virtual_methods_to_remove,
     std::unordered_map<DexMethod*, DexMethod*>& virtual_methods_to_remap) {
   VirtualMergingStats stats;
-  for (auto& p : ordering) {
+  auto unabstracted = prepare_ordering(ordering, method_fn, stats);
+
+  // The overriding methods merged for each entry of the ordering, with the
+  // roots of their virtual scopes.
+  std::vector<std::vector<std::pair<DexMethod*, DexMethod*>>> merged(
+      ordering.size());
+  auto merge = [&](size_t i) {
+    auto& p = ordering[i];
     auto overridden_method = const_cast<DexMethod*>(p.first);
+    // Whether the overridden method just has the load-param instructions
+    // that prepare_ordering gave it.
+    bool needs_body = unabstracted.count(overridden_method) != 0;
     for (auto& q : p.second) {
-      if (q.second.empty()) {
-        continue;
-      }
-      overridden_method = method_fn(overridden_method);
-
       auto* virtual_scope = q.first;
 
       for (auto* overriding_method_const : q.second) {
         auto overriding_method =
             const_cast<DexMethod*>(overriding_method_const);
-        overriding_method = method_fn(overriding_method);
 
         size_t estimated_callee_size =
             overriding_method->get_code()->sum_opcode_sizes();
         size_t estimated_insn_size =
-            is_abstract(overridden_method)
+            needs_body
                 ? 64 // we'll need some extra instruction; 64 is conservative
                 : overridden_method->get_code()->sum_opcode_sizes();
         std::vector<DexMethod*> make_static;
@@ -818,39 +946,14 @@ VirtualMergingStats apply_ordering(
         std::function<uint32_t()> allocate_wide_temp;
         std::function<void()> cleanup;
         IRCode* overridden_code;
-        // We make the method public to avoid visibility issues. We could be
-        // more conservative (i.e. taking the strongest visibility control
-        // that encompasses the original pair) but I'm not sure it's worth the
-        // effort.
-        set_public(overridden_method);
-        if (is_abstract(overridden_method)) {
-          // We'll make the abstract method be not abstract, and give it a new
-          // method body.
-          // It starts out with just load-param instructions as needed, and
-          // then we'll add an invoke-virtual instruction that will get
-          // inlined.
-          stats.unabstracted_methods++;
-          overridden_method->make_concrete(
-              (DexAccessFlags)(overridden_method->get_access() & ~ACC_ABSTRACT),
-              std::make_unique<IRCode>(),
-              true /* is_virtual */);
+        if (needs_body) {
+          // The formerly abstract method starts out with just load-param
+          // instructions, and then we'll add an invoke-virtual instruction
+          // that will get inlined.
+          needs_body = false;
           overridden_code = overridden_method->get_code();
-          auto load_param_insn = new IRInstruction(IOPCODE_LOAD_PARAM_OBJECT);
-          load_param_insn->set_dest(overridden_code->allocate_temp());
-          overridden_code->push_back(load_param_insn);
-          param_regs.push_back(load_param_insn->dest());
-          for (auto t : proto->get_args()->get_type_list()) {
-            if (type::is_wide_type(t)) {
-              load_param_insn = new IRInstruction(IOPCODE_LOAD_PARAM_WIDE);
-              load_param_insn->set_dest(overridden_code->allocate_wide_temp());
-            } else {
-              load_param_insn = new IRInstruction(
-                  type::is_object(t) ? IOPCODE_LOAD_PARAM_OBJECT
-                                     : IOPCODE_LOAD_PARAM);
-              load_param_insn->set_dest(overridden_code->allocate_temp());
-            }
-            overridden_code->push_back(load_param_insn);
-            param_regs.push_back(load_param_insn->dest());
+          for (const auto& mie : InstructionIterable(overridden_code)) {
+            param_regs.push_back(mie.insn->dest());
           }
           // we'll define helper functions in a way that lets them mutate the
           // new IRCode
@@ -984,7 +1087,6 @@ VirtualMergingStats apply_ordering(
             overridden_method, overriding_method, invoke_virtual_insn,
             /* needs_receiver_cast */ nullptr,
             overridden_method->get_code()->cfg().get_registers_size());
-        change_visibility(overriding_method, overridden_method->get_class());
         overriding_method->get_code()->clear_cfg();
 
         // Check if everything was inlined.
@@ -995,16 +1097,37 @@ VirtualMergingStats apply_ordering(
 
         overridden_code->clear_cfg();
 
-        virtual_methods_to_remove[type_class(overriding_method->get_class())]
-            .push_back(overriding_method);
         auto virtual_scope_root = virtual_scope->methods.front();
         always_assert(overriding_method != virtual_scope_root.first);
-        virtual_methods_to_remap.emplace(overriding_method,
-                                         virtual_scope_root.first);
-
-        stats.removed_virtual_methods++;
+        merged[i].emplace_back(overriding_method, virtual_scope_root.first);
       }
     }
+  };
+
+  // Clusters don't share any methods, so they are merged in parallel. The
+  // visibility changes are delayed until all merging is done, as the inliner
+  // looks at the access flags of the methods of other clusters.
+  auto clusters = get_clusters(ordering);
+  std::vector<size_t> indices(clusters.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  workqueue_run<size_t>(
+      [&](size_t c) {
+        for (auto i : clusters[c]) {
+          merge(i);
+        }
+      },
+      indices);
+
+  for (size_t i = 0; i < ordering.size(); i++) {
+    auto overridden_method = const_cast<DexMethod*>(ordering[i].first);
+    for (const auto& m : merged[i]) {
+      auto overriding_method = m.first;
+      change_visibility(overriding_method, overridden_method->get_class());
+      virtual_methods_to_remove[type_class(overriding_method->get_class())]
+          .push_back(overriding_method);
+      virtual_methods_to_remap.emplace(overriding_method, m.second);
+      stats.removed_virtual_methods++;
+    }
   }
   return stats;
 }
@@ -1120,22 +1243,16 @@ void VirtualMerging::merge_methods(
 
     redex_assert(ab_experiment_context != nullptr);
 
+    // Registering doesn't snapshot the code, so there is no need to build
+    // CFGs around it.
     for (auto* m_const : all_methods) {
       auto* m = const_cast<DexMethod*>(m_const);
       redex_assert(!m->get_code()->cfg_built());
-      m->get_code()->build_cfg();
       ab_experiment_context->try_register_method(m);
-      m->get_code()->clear_cfg();
-
       m->set_code(clones.at(m)->release_code());
-      m->get_code()->build_cfg();
     }
 
     ab_experiment_context->flush();
-
-    for (auto* m_const : all_methods) {
-      const_cast<DexMethod*>(m_const)->get_code()->clear_cfg();
-    }
   }
 }
 
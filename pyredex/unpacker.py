@@ -825,14 +825,25 @@ class ZipManager:
     """
     __enter__: Unzips input_apk into extracted_apk_dir
     __exit__: Zips extracted_apk_dir into output_apk
+
+    The native packager, when given, zips in parallel and copies unchanged
+    entries from input_apk as they are. ZipManager falls back to zipfile if it
+    fails.
     """
 
     per_file_compression: typing.Dict[str, int] = {}
 
-    def __init__(self, input_apk: str, extracted_apk_dir: str, output_apk: str) -> None:
+    def __init__(
+        self,
+        input_apk: str,
+        extracted_apk_dir: str,
+        output_apk: str,
+        packager: typing.Optional[str] = None,
+    ) -> None:
         self.input_apk = input_apk
         self.extracted_apk_dir = extracted_apk_dir
         self.output_apk = output_apk
+        self.packager = packager
 
     def __enter__(self) -> None:
         log("Extracting apk...")
@@ -846,6 +857,25 @@ class ZipManager:
         if isfile(self.output_apk):
             os.remove(self.output_apk)
 
+        if self.packager is not None:
+            log("Creating output apk with " + self.packager)
+            try:
+                subprocess.check_call(
+                    [
+                        self.packager,
+                        "--input-apk",
+                        self.input_apk,
+                        "--output-apk",
+                        self.output_apk,
+                        self.extracted_apk_dir,
+                    ]
+                )
+                return
+            except subprocess.CalledProcessError:
+                log("Native packaging failed, falling back to zipfile")
+                if isfile(self.output_apk):
+                    os.remove(self.output_apk)
+
         log("Creating output apk")
         with zipfile.ZipFile(self.output_apk, "w") as new_apk:
             # Need sorted output for deterministic zip file. Sorting `dirnames` will
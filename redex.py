@@ -209,6 +209,26 @@ class State(object):
         self.zip_manager = zip_manager
 
 
+def find_apk_packager(args: argparse.Namespace) -> typing.Optional[str]:
+    if not args.native_packager:
+        return None
+    candidates = [args.apk_packager]
+    if args.redex_binary is not None:
+        candidates.append(join(dirname(args.redex_binary), "redex-apk-packager"))
+    candidates.append(shutil.which("redex-apk-packager"))
+    # __file__ can be /path/fb-redex.pex/redex.pyc
+    dir_name = dirname(abspath(__file__))
+    while not isdir(dir_name):
+        dir_name = dirname(dir_name)
+    candidates.append(join(dir_name, "redex-apk-packager"))
+    for candidate in candidates:
+        if candidate is not None and isfile(candidate) and os.access(candidate, os.X_OK):
+            return candidate
+    if args.apk_packager is not None:
+        sys.exit("redex-apk-packager is not executable: " + args.apk_packager)
+    return None
+
+
 def run_redex_binary(
     state: State,
     exception_formatter: ExceptionMessageFormatter,
@@ -510,6 +530,19 @@ Given an APK, produce a better APK!
         "--redex-binary", nargs="?", default=binary, help="Path to redex binary"
     )
 
+    parser.add_argument(
+        "--apk-packager",
+        nargs="?",
+        help="Path to redex-apk-packager, which zips the output in parallel "
+        "(defaults to the one next to the redex binary, if any)",
+    )
+    argparse_yes_no_flag(
+        parser,
+        "native-packager",
+        default=True,
+        help="Zip the output apk with redex-apk-packager, when found",
+    )
+
     parser.add_argument("-c", "--config", default=config, help="Configuration file")
 
     argparse_yes_no_flag(parser, "sign", help="Sign the apk after optimizing it")
@@ -962,7 +995,12 @@ def prepare_redex(args: argparse.Namespace) -> State:
 
         directory = make_temp_dir(".redex_unaligned", False)
         unaligned_apk_path = join(directory, "redex-unaligned." + file_ext)
-        zip_manager = ZipManager(args.input_apk, extracted_apk_dir, unaligned_apk_path)
+        zip_manager = ZipManager(
+            args.input_apk,
+            extracted_apk_dir,
+            unaligned_apk_path,
+            packager=find_apk_packager(args),
+        )
         zip_manager.__enter__()
 
         if not dex_dir:
@@ -38,6 +38,91 @@ int distance(const Shape& lhs, const Shape& rhs) {
           (lhs.float_fields - rhs.float_fields));
 }
 
+constexpr int Shape::*SHAPE_FIELDS[] = {
+    &Shape::string_fields, &Shape::reference_fields, &Shape::bool_fields,
+    &Shape::int_fields,    &Shape::long_fields,      &Shape::double_fields,
+    &Shape::float_fields,
+};
+constexpr size_t NUM_SHAPE_FIELDS =
+    sizeof(SHAPE_FIELDS) / sizeof(SHAPE_FIELDS[0]);
+
+/**
+ * Whether it is cheaper to find the shapes included in a shape by enumerating
+ * all the ways of removing at most `max_distance` fields from it, than by
+ * comparing it with all the `num_shapes` shapes. There are
+ * C(max_distance + NUM_SHAPE_FIELDS, NUM_SHAPE_FIELDS) such ways.
+ */
+bool enumerate_included_shapes(size_t max_distance, size_t num_shapes) {
+  if (max_distance >= num_shapes) {
+    return false;
+  }
+  size_t ways = 1;
+  for (size_t i = 1; i <= NUM_SHAPE_FIELDS; ++i) {
+    ways = ways * (max_distance + i) / i;
+    if (ways >= num_shapes) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void enumerate_included_shapes(const MergerType::ShapeCollector& shapes,
+                               size_t field_idx,
+                               size_t budget,
+                               Shape& current,
+                               std::vector<Shape>& result) {
+  if (field_idx == NUM_SHAPE_FIELDS) {
+    if (shapes.count(current)) {
+      result.push_back(current);
+    }
+    return;
+  }
+  auto field = SHAPE_FIELDS[field_idx];
+  const int original = current.*field;
+  for (size_t removed = 0; removed <= budget && (int)removed <= original;
+       ++removed) {
+    current.*field = original - removed;
+    enumerate_included_shapes(shapes, field_idx + 1, budget - removed, current,
+                              result);
+  }
+  current.*field = original;
+}
+
+/**
+ * The shapes in `shapes` other than `shape` that `shape` includes, within
+ * `max_distance`, in the order of `shapes`.
+ *
+ * With thousands of shapes and a small distance, comparing all pairs of shapes
+ * dominates approximate shape merging. So unless the distance is so large that
+ * there are more candidates than shapes, the candidates are enumerated and
+ * looked up instead, which gives the same shapes.
+ */
+std::vector<Shape> find_included_shapes(
+    const Shape& shape,
+    size_t max_distance,
+    const MergerType::ShapeCollector& shapes) {
+  std::vector<Shape> result;
+  if (enumerate_included_shapes(max_distance, shapes.size())) {
+    Shape current = shape;
+    enumerate_included_shapes(shapes, 0, max_distance, current, result);
+    std::sort(result.begin(), result.end(), MergerType::ShapeComp());
+    // Being the biggest, the shape itself comes last.
+    always_assert(!result.empty() && result.back() == shape);
+    result.pop_back();
+    return result;
+  }
+  for (const auto& rhs : shapes) {
+    if (rhs.first == shape || !shape.includes(rhs.first)) {
+      continue;
+    }
+    if ((size_t)distance(shape, rhs.first) > max_distance) {
+      continue;
+    }
+    result.push_back(rhs.first);
+  }
+  return result;
+}
+
 /**
  * Merge two shapes
  **/
@@ -78,28 +163,20 @@ void build_DAG(MergerType::ShapeCollector& shapes,
                std::unordered_map<Shape, size_t>& mergeable_count) {
   TRACE(CLMG, 5, "[approx] Building Shape DAG");
   for (const auto& lhs : shapes) {
-    for (const auto& rhs : shapes) {
-      if (lhs.first == rhs.first) {
-        continue;
-      }
-      if (lhs.first.includes(rhs.first)) {
-        size_t dist = distance(lhs.first, rhs.first);
-        if (dist > max_distance) {
-          continue;
-        }
-        TRACE(CLMG, 9, "         - Edge: %s -> %s, dist = %zu",
-              rhs.first.to_string().c_str(), lhs.first.to_string().c_str(),
-              dist);
-        // if lhs shape includes rhs, add lhs to rhs's succ_map
-        succ_map[rhs.first].insert(lhs.first);
-        // and add rhs to lhs's pred_map
-        pred_map[lhs.first].insert(rhs.first);
-        // initialize mergeable counts
-        if (mergeable_count.find(lhs.first) == mergeable_count.end()) {
-          mergeable_count[lhs.first] = lhs.second.types.size();
-        }
-        mergeable_count[lhs.first] += rhs.second.types.size();
+    for (const auto& rhs : find_included_shapes(lhs.first, max_distance,
+                                                shapes)) {
+      TRACE(CLMG, 9, "         - Edge: %s -> %s, dist = %d",
+            rhs.to_string().c_str(), lhs.first.to_string().c_str(),
+            distance(lhs.first, rhs));
+      // if lhs shape includes rhs, add lhs to rhs's succ_map
+      succ_map[rhs].insert(lhs.first);
+      // and add rhs to lhs's pred_map
+      pred_map[lhs.first].insert(rhs);
+      // initialize mergeable counts
+      if (mergeable_count.find(lhs.first) == mergeable_count.end()) {
+        mergeable_count[lhs.first] = lhs.second.types.size();
       }
+      mergeable_count[lhs.first] += shapes.at(rhs).types.size();
     }
   }
 }
@@ -283,31 +360,23 @@ void simple_greedy_approximation(const JsonWrapper& specs,
             });
 
   TRACE(CLMG, 3, "[approx] Finding approximation:");
-  // From the beginining of the list, try all pairs of shapes.
-  while (!shapes_list.empty()) {
-    Shape s0 = shapes_list.front();
-    shapes_list.erase(shapes_list.begin());
-
-    auto it = shapes_list.begin();
-    while (it != shapes_list.end()) {
-      if (s0.includes(*it)) {
-        size_t dist = distance(s0, *it);
-        if (dist > max_distance) {
-          ++it;
-          continue;
-        }
-
-        always_assert(shapes.find(*it) != shapes.end());
-        TRACE(CLMG, 9, "          - distance between %s and %s = %zu",
-              s0.to_string().c_str(), it->to_string().c_str(), dist);
-        stats.shapes_merged++;
-        stats.mergeables += shapes[*it].types.size();
-        stats.fields_added += shapes[*it].types.size() * dist;
-        merge_shapes(*it, s0, shapes);
-        it = shapes_list.erase(it);
-      } else {
-        ++it;
-      }
+  // From the beginining of the list, merge into each shape that was not merged
+  // yet all the remaining shapes it includes. A shape can only include shapes
+  // with fewer fields, so those are exactly the included shapes that are still
+  // in `shapes`.
+  for (const auto& s0 : shapes_list) {
+    if (!shapes.count(s0)) {
+      continue;
+    }
+    for (const auto& included :
+         find_included_shapes(s0, max_distance, shapes)) {
+      size_t dist = distance(s0, included);
+      TRACE(CLMG, 9, "          - distance between %s and %s = %zu",
+            s0.to_string().c_str(), included.to_string().c_str(), dist);
+      stats.shapes_merged++;
+      stats.mergeables += shapes[included].types.size();
+      stats.fields_added += shapes[included].types.size() * dist;
+      merge_shapes(included, s0, shapes);
     }
   }
 }
@@ -7,6 +7,7 @@
 
 #include "MergeabilityCheck.h"
 
+#include "ConcurrentContainers.h"
 #include "LiveRange.h"
 #include "Model.h"
 #include "ReachableClasses.h"
@@ -16,17 +17,21 @@
 #include "Show.h"
 #include "Trace.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 using namespace class_merging;
 
 MergeabilityChecker::MergeabilityChecker(const Scope& scope,
                                          const ModelSpec& spec,
                                          const RefChecker& ref_checker,
-                                         const TypeSet& generated)
+                                         const TypeSet& generated,
+                                         const std::vector<DexMethod*>&
+                                             referencing_methods)
     : m_scope(scope),
       m_spec(spec),
       m_ref_checker(ref_checker),
       m_generated(generated),
+      m_referencing_methods(referencing_methods),
       m_const_class_safe_types(spec.const_class_safe_types) {}
 
 void MergeabilityChecker::exclude_cannot_delete(TypeSet& non_mergeables) {
@@ -176,11 +181,15 @@ TypeSet MergeabilityChecker::exclude_unsupported_bytecode_refs_for(
 
 void MergeabilityChecker::exclude_unsupported_bytecode(
     TypeSet& non_mergeables) {
-  TypeSet non_mergeables_opcode =
-      walk::parallel::methods<TypeSet, MergeContainers<TypeSet>>(
-          m_scope, [this](DexMethod* meth) {
-            return exclude_unsupported_bytecode_refs_for(meth);
-          });
+  // Only the code that references a merging target can exclude one.
+  ConcurrentSet<const DexType*> non_mergeables_opcode;
+  workqueue_run<DexMethod*>(
+      [&](DexMethod* meth) {
+        for (auto type : exclude_unsupported_bytecode_refs_for(meth)) {
+          non_mergeables_opcode.insert(type);
+        }
+      },
+      m_referencing_methods);
 
   non_mergeables.insert(non_mergeables_opcode.begin(),
                         non_mergeables_opcode.end());
@@ -215,18 +224,26 @@ void MergeabilityChecker::exclude_static_fields(TypeSet& non_mergeables) {
 
 void MergeabilityChecker::exclude_unsafe_sdk_and_store_refs(
     TypeSet& non_mergeables) {
+  // Checking a class walks all the refs of its code, and the RefChecker
+  // caches are concurrent.
+  std::vector<const DexType*> to_check;
   for (auto type : m_spec.merging_targets) {
-    if (non_mergeables.count(type)) {
-      continue;
-    }
-    auto cls = type_class(type);
-    if (!m_ref_checker.check_class(cls)) {
-      non_mergeables.insert(type);
-    }
-    if (!m_spec.include_primary_dex && m_ref_checker.is_in_primary_dex(type)) {
-      non_mergeables.insert(type);
+    if (!non_mergeables.count(type)) {
+      to_check.push_back(type);
     }
   }
+  ConcurrentSet<const DexType*> unsafe;
+  workqueue_run<const DexType*>(
+      [&](const DexType* type) {
+        auto cls = type_class(type);
+        if (!m_ref_checker.check_class(cls) ||
+            (!m_spec.include_primary_dex &&
+             m_ref_checker.is_in_primary_dex(type))) {
+          unsafe.insert(type);
+        }
+      },
+      to_check);
+  non_mergeables.insert(unsafe.begin(), unsafe.end());
 }
 
 TypeSet MergeabilityChecker::get_non_mergeables() {
@@ -22,7 +22,8 @@ class MergeabilityChecker {
   MergeabilityChecker(const Scope& scope,
                       const ModelSpec& spec,
                       const RefChecker& ref_checker,
-                      const TypeSet& generated);
+                      const TypeSet& generated,
+                      const std::vector<DexMethod*>& referencing_methods);
   /**
    * Try to identify types referenced by operations that Class Merging does not
    * support. Such operations include reflections, instanceof checks on
@@ -39,6 +40,8 @@ class MergeabilityChecker {
   const ModelSpec& m_spec;
   const RefChecker& m_ref_checker;
   const TypeSet& m_generated;
+  // The methods whose code references any of the merging targets.
+  const std::vector<DexMethod*>& m_referencing_methods;
   const std::unordered_set<DexType*>& m_const_class_safe_types;
 
   void exclude_cannot_delete(TypeSet& non_mergeables);
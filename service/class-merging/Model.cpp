@@ -16,7 +16,9 @@
 #include "RefChecker.h"
 #include "Resolver.h"
 #include "Show.h"
+#include "TypeReference.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 using namespace class_merging;
 
@@ -195,7 +197,10 @@ void Model::init(const Scope& scope,
                        generated);
   TRACE(CLMG, 4, "Generated types %ld", generated.size());
   exclude_types(spec.exclude_types);
-  MergeabilityChecker checker(scope, spec, m_ref_checker, generated);
+  m_methods_referencing_targets = type_reference::get_methods_referencing(
+      scope, m_spec.merging_targets);
+  MergeabilityChecker checker(scope, spec, m_ref_checker, generated,
+                              m_methods_referencing_targets);
   m_non_mergeables = checker.get_non_mergeables();
   TRACE(CLMG, 3, "Non mergeables %ld", m_non_mergeables.size());
   m_metric.non_mergeables = m_non_mergeables.size();
@@ -453,6 +458,10 @@ void Model::shape_model() {
               return compare_dextypes(first->type, second->type);
             });
 
+  // Group all merging targets according to interdex grouping. This walks the
+  // whole scope, and is the same for all mergers.
+  auto all_interdex_groups = group_by_interdex_set();
+
   for (auto merger : mergers) {
     TRACE(CLMG, 6, "Build shapes from %s", SHOW(merger->type));
     MergerType::ShapeCollector shapes;
@@ -464,7 +473,7 @@ void Model::shape_model() {
       break_by_interface(*merger, shape_it.first, shape_it.second);
     }
 
-    flatten_shapes(*merger, shapes);
+    flatten_shapes(*merger, shapes, all_interdex_groups);
   }
 
   // Update excluded metrics
@@ -611,10 +620,11 @@ DexType* check_current_instance(const ConstTypeHashSet& types,
 }
 
 ConcurrentMap<DexType*, TypeHashSet> get_type_usages(
-    const ConstTypeHashSet& types, const Scope& scope) {
+    const ConstTypeHashSet& types,
+    const std::vector<DexMethod*>& referencing_methods) {
   ConcurrentMap<DexType*, TypeHashSet> res;
 
-  walk::parallel::opcodes(scope, [&](DexMethod* method, IRInstruction* insn) {
+  auto visit = [&](DexMethod* method, IRInstruction* insn) {
     auto cls = method->get_class();
     const auto& updater =
         [&cls](DexType* /* key */, std::unordered_set<DexType*>& set,
@@ -643,7 +653,18 @@ ConcurrentMap<DexType*, TypeHashSet> get_type_usages(
         }
       }
     }
-  });
+  };
+  workqueue_run<DexMethod*>(
+      [&](DexMethod* method) {
+        auto code = method->get_code();
+        if (code == nullptr) {
+          return;
+        }
+        for (const auto& mie : InstructionIterable(code)) {
+          visit(method, mie.insn);
+        }
+      },
+      referencing_methods);
 
   return res;
 }
@@ -704,11 +725,12 @@ TypeSet Model::get_types_in_current_interdex_group(
 }
 
 /**
- * Split the types into groups according to the interdex grouping information.
- * Note that types may be dropped if they are not allowed be merged.
+ * Split the merging targets into groups according to the interdex grouping
+ * information. Note that types may be dropped if they are not allowed be
+ * merged.
  */
-std::vector<ConstTypeHashSet> Model::group_by_interdex_set(
-    const ConstTypeHashSet& types) {
+std::vector<ConstTypeHashSet> Model::group_by_interdex_set() {
+  const auto& types = m_spec.merging_targets;
   size_t num_group = 1;
   if (is_merge_per_interdex_set_enabled() && s_num_interdex_groups > 1) {
     num_group = s_num_interdex_groups;
@@ -718,7 +740,8 @@ std::vector<ConstTypeHashSet> Model::group_by_interdex_set(
     new_groups[0].insert(types.begin(), types.end());
     return new_groups;
   }
-  const auto& type_to_usages = get_type_usages(types, m_scope);
+  const auto& type_to_usages =
+      get_type_usages(types, m_methods_referencing_targets);
   for (const auto& pair : type_to_usages) {
     auto index = get_interdex_group(pair.second, s_cls_to_interdex_group,
                                     s_num_interdex_groups);
@@ -741,12 +764,12 @@ std::vector<ConstTypeHashSet> Model::group_by_interdex_set(
   return new_groups;
 }
 
-void Model::flatten_shapes(const MergerType& merger,
-                           MergerType::ShapeCollector& shapes) {
+void Model::flatten_shapes(
+    const MergerType& merger,
+    MergerType::ShapeCollector& shapes,
+    const std::vector<ConstTypeHashSet>& all_interdex_groups) {
   size_t num_trimmed_types = trim_groups(shapes, m_spec.min_count);
   m_metric.dropped += num_trimmed_types;
-  // Group all merging targets according to interdex grouping.
-  auto all_interdex_groups = group_by_interdex_set(m_spec.merging_targets);
   // sort shapes by mergeables count
   std::vector<const MergerType::Shape*> keys;
   for (auto& shape_it : shapes) {
@@ -329,6 +329,8 @@ class Model {
   // The set of non mergeables types. Those are types that are not
   // erasable for whatever reason
   TypeSet m_non_mergeables;
+  // The methods whose code references any of the merging targets.
+  std::vector<DexMethod*> m_methods_referencing_targets;
 
   const TypeSystem& m_type_system;
   const RefChecker& m_ref_checker;
@@ -400,13 +402,13 @@ class Model {
                           const MergerType::Shape& shape,
                           MergerType::ShapeHierarchy& hier);
   void flatten_shapes(const MergerType& merger,
-                      MergerType::ShapeCollector& shapes);
+                      MergerType::ShapeCollector& shapes,
+                      const std::vector<ConstTypeHashSet>& all_interdex_groups);
   TypeGroupByDex group_per_dex(bool per_dex_grouping, const TypeSet& types);
   TypeSet get_types_in_current_interdex_group(
       const TypeSet& types, const ConstTypeHashSet& interdex_group_types);
 
-  std::vector<ConstTypeHashSet> group_by_interdex_set(
-      const ConstTypeHashSet& types);
+  std::vector<ConstTypeHashSet> group_by_interdex_set();
   void map_fields(MergerType& merger,
                   const std::vector<const DexType*>& classes);
 
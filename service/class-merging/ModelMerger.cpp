@@ -19,6 +19,7 @@
 #include "TypeStringRewriter.h"
 #include "TypeTagUtils.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 #include <fstream>
 #include <sstream>
@@ -94,8 +95,25 @@ MergerToField get_type_tag_fields(const std::vector<const MergerType*>& mergers,
   return merger_to_type_tag_field;
 }
 
+/**
+ * Run fn over the code of the methods that reference a mergeable, which is
+ * all the code that the updates below can change.
+ */
+template <typename Fn>
+void walk_code(const std::vector<DexMethod*>& referencing_methods,
+               const Fn& fn) {
+  workqueue_run<DexMethod*>(
+      [&fn](DexMethod* method) {
+        auto code = method->get_code();
+        if (code != nullptr) {
+          fn(method, *code);
+        }
+      },
+      referencing_methods);
+}
+
 void update_code_type_refs(
-    const Scope& scope,
+    const std::vector<DexMethod*>& referencing_methods,
     const std::unordered_map<const DexType*, DexType*>& mergeable_to_merger) {
   TRACE(
       CLMG, 8, "  Updating NEW_INSTANCE, NEW_ARRAY, CHECK_CAST & CONST_CLASS");
@@ -176,11 +194,11 @@ void update_code_type_refs(
     }
   };
 
-  walk::parallel::code(scope, patcher);
+  walk_code(referencing_methods, patcher);
 }
 
 void update_refs_to_mergeable_fields(
-    const Scope& scope,
+    const std::vector<DexMethod*>& referencing_methods,
     const std::vector<const MergerType*>& mergers,
     const std::unordered_map<const DexType*, DexType*>& mergeable_to_merger,
     MergerFields& merger_fields) {
@@ -190,7 +208,7 @@ void update_refs_to_mergeable_fields(
         merger_fields.at(merger->type), merger->field_map, fields_lookup);
   }
   TRACE(CLMG, 8, "  Updating field refs");
-  walk::parallel::code(scope, [&](DexMethod* meth, IRCode& code) {
+  walk_code(referencing_methods, [&](DexMethod* meth, IRCode& code) {
     auto ii = InstructionIterable(code);
     for (auto it = ii.begin(); it != ii.end(); ++it) {
       auto insn = it->insn;
@@ -271,12 +289,12 @@ DexMethod* create_instanceof_method(const DexType* merger_type,
 }
 
 void update_instance_of(
-    const Scope& scope,
+    const std::vector<DexMethod*>& referencing_methods,
     const std::unordered_map<const DexType*, DexType*>& mergeable_to_merger,
     const std::unordered_map<const DexType*, DexMethod*>&
         merger_to_instance_of_meth,
     const TypeTags& type_tags) {
-  walk::parallel::code(scope, [&](DexMethod* caller, IRCode& code) {
+  walk_code(referencing_methods, [&](DexMethod* caller, IRCode& code) {
     auto ii = InstructionIterable(code);
     for (auto it = ii.begin(); it != ii.end(); ++it) {
       auto insn = it->insn;
@@ -318,9 +336,9 @@ void update_instance_of(
 }
 
 void update_instance_of_no_type_tag(
-    const Scope& scope,
+    const std::vector<DexMethod*>& referencing_methods,
     const std::unordered_map<const DexType*, DexType*>& mergeable_to_merger) {
-  walk::parallel::code(scope, [&](DexMethod* caller, IRCode& code) {
+  walk_code(referencing_methods, [&](DexMethod* caller, IRCode& code) {
     auto ii = InstructionIterable(code);
     for (auto it = ii.begin(); it != ii.end(); ++it) {
       auto insn = it->insn;
@@ -342,6 +360,7 @@ void update_instance_of_no_type_tag(
 
 void update_refs_to_mergeable_types(
     const Scope& scope,
+    const std::vector<DexMethod*>& referencing_methods,
     const ClassHierarchy& parent_to_children,
     const std::vector<const MergerType*>& mergers,
     const std::unordered_map<const DexType*, DexType*>& mergeable_to_merger,
@@ -350,18 +369,20 @@ void update_refs_to_mergeable_types(
     std::unordered_map<DexMethod*, std::string>& method_debug_map,
     bool has_type_tags) {
   // Update simple type referencing instructions to instantiate merger type.
-  update_code_type_refs(scope, mergeable_to_merger);
+  update_code_type_refs(referencing_methods, mergeable_to_merger);
   type_reference::update_method_signature_type_references(
       scope,
       mergeable_to_merger,
       parent_to_children,
       boost::optional<std::unordered_map<DexMethod*, std::string>&>(
-          method_debug_map));
-  type_reference::update_field_type_references(scope, mergeable_to_merger);
+          method_debug_map),
+      &referencing_methods);
+  type_reference::update_field_type_references(scope, mergeable_to_merger,
+                                               &referencing_methods);
   // Fix INSTANCE_OF
   if (!has_type_tags) {
     always_assert(type_tag_fields.empty());
-    update_instance_of_no_type_tag(scope, mergeable_to_merger);
+    update_instance_of_no_type_tag(referencing_methods, mergeable_to_merger);
     return;
   }
   std::unordered_map<const DexType*, DexMethod*> merger_to_instance_of_meth;
@@ -372,8 +393,8 @@ void update_refs_to_mergeable_types(
     merger_to_instance_of_meth[type] = instance_of_meth;
     type_class(type)->add_method(instance_of_meth);
   }
-  update_instance_of(
-      scope, mergeable_to_merger, merger_to_instance_of_meth, type_tags);
+  update_instance_of(referencing_methods, mergeable_to_merger,
+                     merger_to_instance_of_meth, type_tags);
 }
 
 std::string merger_info(const MergerType& merger) {
@@ -593,7 +614,16 @@ std::vector<DexClass*> ModelMerger::merge_model(Scope& scope,
   std::unordered_map<DexMethod*, std::string> method_debug_map;
   auto parent_to_children =
       model.get_type_system().get_class_scopes().get_parent_to_children();
+  // One walk over all the code finds the methods that the updates of the
+  // references to the mergeables below need to visit.
+  UnorderedTypeSet mergeables;
+  for (const auto& pair : mergeable_to_merger) {
+    mergeables.insert(pair.first);
+  }
+  auto referencing_methods =
+      type_reference::get_methods_referencing(scope, mergeables);
   update_refs_to_mergeable_types(scope,
+                                 referencing_methods,
                                  parent_to_children,
                                  to_materialize,
                                  mergeable_to_merger,
@@ -602,8 +632,8 @@ std::vector<DexClass*> ModelMerger::merge_model(Scope& scope,
                                  method_debug_map,
                                  model_spec.has_type_tag());
   trim_method_debug_map(mergeable_to_merger, method_debug_map);
-  update_refs_to_mergeable_fields(
-      scope, to_materialize, mergeable_to_merger, m_merger_fields);
+  update_refs_to_mergeable_fields(referencing_methods, to_materialize,
+                                  mergeable_to_merger, m_merger_fields);
 
   // Merge methods
   ModelMethodMerger mm(scope,
@@ -14,6 +14,7 @@
 #include "ConstantArrayDomain.h"
 #include "ControlFlow.h"
 #include "DisjointUnionAbstractDomain.h"
+#include "FlatAbstractEnvironment.h"
 #include "HashedAbstractPartition.h"
 #include "HashedSetAbstractDomain.h"
 #include "ObjectDomain.h"
@@ -74,8 +75,9 @@ using ConstantValue =
 using FieldEnvironment =
     sparta::PatriciaTreeMapAbstractEnvironment<const DexField*, ConstantValue>;
 
+// Most methods use few registers, which a flat environment keeps inline.
 using ConstantRegisterEnvironment =
-    sparta::PatriciaTreeMapAbstractEnvironment<reg_t, ConstantValue>;
+    sparta::FlatAbstractEnvironment<reg_t, ConstantValue>;
 
 /*****************************************************************************
  * Heap values.
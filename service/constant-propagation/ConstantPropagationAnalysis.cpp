@@ -1156,6 +1156,16 @@ FixpointIterator::FixpointIterator(
       m_kotlin_null_check_assertions(get_kotlin_null_assertions()),
       m_imprecise_switches(imprecise_switches) {}
 
+FixpointIterator::FixpointIterator(
+    const cfg::ControlFlowGraph& cfg,
+    std::shared_ptr<const WPO> ordering,
+    InstructionAnalyzer<ConstantEnvironment> insn_analyzer,
+    bool imprecise_switches)
+    : MonotonicFixpointIterator(cfg, std::move(ordering)),
+      m_insn_analyzer(std::move(insn_analyzer)),
+      m_kotlin_null_check_assertions(get_kotlin_null_assertions()),
+      m_imprecise_switches(imprecise_switches) {}
+
 void FixpointIterator::analyze_instruction(const IRInstruction* insn,
                                            ConstantEnvironment* env,
                                            bool is_last) const {
@@ -10,6 +10,7 @@
 #include <unordered_set>
 #include <utility>
 
+#include "BaseIRAnalyzer.h"
 #include "ConstantEnvironment.h"
 #include "IRCode.h"
 #include "InstructionAnalyzer.h"
@@ -39,6 +40,13 @@ class FixpointIterator final
                    InstructionAnalyzer<ConstantEnvironment> insn_analyzer,
                    bool imprecise_switches = false);
 
+  // `ordering` must come from `ir_analyzer::make_forward_ordering(cfg)` or
+  // `ir_analyzer::get_forward_ordering(cfg)`.
+  FixpointIterator(const cfg::ControlFlowGraph& cfg,
+                   std::shared_ptr<const WPO> ordering,
+                   InstructionAnalyzer<ConstantEnvironment> insn_analyzer,
+                   bool imprecise_switches = false);
+
   ConstantEnvironment analyze_edge(
       const EdgeId&,
       const ConstantEnvironment& exit_state_at_source) const override;
@@ -64,33 +64,12 @@ void analyze_clinits(const Scope& scope,
                               FieldType::STATIC, field_partition);
       continue;
     }
-    IRCode* code = clinit->get_code();
-    auto& cfg = code->cfg();
-    auto intra_cp = fp_iter.get_intraprocedural_analysis(clinit);
-    auto env = intra_cp->get_exit_state_at(cfg.exit_block());
-    set_fields_in_partition(cls, env.get_field_environment(), FieldType::STATIC,
+    auto summary = fp_iter.get_local_analysis_summary(clinit);
+    set_fields_in_partition(cls, summary->clinit_field_env, FieldType::STATIC,
                             field_partition);
   }
 }
 
-bool analyze_gets_helper(const WholeProgramState* whole_program_state,
-                         const IRInstruction* insn,
-                         ConstantEnvironment* env) {
-  if (whole_program_state == nullptr) {
-    return false;
-  }
-  auto field = resolve_field(insn->get_field());
-  if (field == nullptr) {
-    return false;
-  }
-  auto value = whole_program_state->get_field_value(field);
-  if (value.is_top()) {
-    return false;
-  }
-  env->set(RESULT_REGISTER, value);
-  return true;
-}
-
 bool not_eligible_ifield(DexField* field) {
   return is_static(field) || field->is_external() || !can_delete(field) ||
          is_volatile(field);
@@ -174,20 +153,26 @@ void WholeProgramState::collect(
     if (code == nullptr) {
       return;
     }
-    auto& cfg = code->cfg();
-    auto intra_cp = fp_iter.get_intraprocedural_analysis(method);
-    for (cfg::Block* b : cfg.blocks()) {
-      auto env = intra_cp->get_entry_state_at(b);
-      auto last_insn = b->get_last_insn();
-      for (auto& mie : InstructionIterable(b)) {
-        auto* insn = mie.insn;
-        intra_cp->analyze_instruction(insn, &env, insn == last_insn->insn);
-        collect_field_values(insn, env,
-                             method::is_clinit(method) ? method->get_class()
-                                                       : nullptr,
-                             &fields_value_tmp);
-        collect_return_values(insn, env, method, &methods_value_tmp);
-      }
+    auto summary = fp_iter.get_local_analysis_summary(method);
+    for (const auto& pair : summary->written_values) {
+      collect_field_values(pair.first, pair.second,
+                           method::is_clinit(method) ? method->get_class()
+                                                     : nullptr,
+                           &fields_value_tmp);
+    }
+    // If there are no reachable return opcodes in the method, then it never
+    // returns. Its return value will be represented by Bottom in our
+    // analysis. A return-void is recorded as Top, to tell that the code
+    // following any invoke of the method is reachable.
+    if (!summary->return_values.empty()) {
+      methods_value_tmp.update(method,
+                               [&summary](const DexMethod*,
+                                          std::vector<ConstantValue>& s,
+                                          bool /* exists */) {
+                                 s.insert(s.end(),
+                                          summary->return_values.begin(),
+                                          summary->return_values.end());
+                               });
     }
   });
   for (const auto& pair : fields_value_tmp) {
@@ -217,7 +202,7 @@ void WholeProgramState::collect(
  */
 void WholeProgramState::collect_field_values(
     const IRInstruction* insn,
-    const ConstantEnvironment& env,
+    const ConstantValue& value,
     const DexType* clinit_cls,
     ConcurrentMap<const DexField*, std::vector<ConstantValue>>*
         fields_value_tmp) {
@@ -231,7 +216,6 @@ void WholeProgramState::collect_field_values(
         field->get_class() == clinit_cls) {
       return;
     }
-    auto value = env.get(insn->src(0));
     fields_value_tmp->update(
         field,
         [value](const DexField*,
@@ -240,42 +224,6 @@ void WholeProgramState::collect_field_values(
   }
 }
 
-/*
- * For each method, do a join over all the values that can be returned by it.
- *
- * If there are no reachable return opcodes in the method, then it never
- * returns. Its return value will be represented by Bottom in our analysis.
- */
-void WholeProgramState::collect_return_values(
-    const IRInstruction* insn,
-    const ConstantEnvironment& env,
-    const DexMethod* method,
-    ConcurrentMap<const DexMethod*, std::vector<ConstantValue>>*
-        methods_value_tmp) {
-  auto op = insn->opcode();
-  if (!opcode::is_a_return(op)) {
-    return;
-  }
-  if (op == OPCODE_RETURN_VOID) {
-    // We must set the binding to Top here to record the fact that this method
-    // does indeed return -- even though `void` is not actually a return value,
-    // this tells us that the code following any invoke of this method is
-    // reachable.
-    methods_value_tmp->update(
-        method,
-        [](const DexMethod*, std::vector<ConstantValue>& s, bool /* exists */) {
-          s.emplace_back(ConstantValue::top());
-        });
-    return;
-  }
-  auto value = env.get(insn->src(0));
-  methods_value_tmp->update(
-      method,
-      [value](const DexMethod*,
-              std::vector<ConstantValue>& s,
-              bool /* exists */) { s.emplace_back(value); });
-}
-
 void WholeProgramState::collect_static_finals(const DexClass* cls,
                                               FieldEnvironment field_env) {
   for (auto* field : cls->get_sfields()) {
@@ -315,56 +263,48 @@ void WholeProgramState::collect_instance_finals(
                           &m_field_partition);
 }
 
-bool WholeProgramAwareAnalyzer::analyze_sget(
-    const WholeProgramState* whole_program_state,
-    const IRInstruction* insn,
-    ConstantEnvironment* env) {
-  return analyze_gets_helper(whole_program_state, insn, env);
-}
-
-bool WholeProgramAwareAnalyzer::analyze_iget(
-    const WholeProgramState* whole_program_state,
-    const IRInstruction* insn,
-    ConstantEnvironment* env) {
-  return analyze_gets_helper(whole_program_state, insn, env);
-}
-
-bool WholeProgramAwareAnalyzer::analyze_invoke(
-    const WholeProgramState* whole_program_state,
-    const IRInstruction* insn,
-    ConstantEnvironment* env) {
-  if (whole_program_state == nullptr) {
-    return false;
+ConstantValue WholeProgramState::get_read_value(
+    const IRInstruction* insn) const {
+  auto op = insn->opcode();
+  if (opcode::is_an_sget(op) || opcode::is_an_iget(op)) {
+    auto field = resolve_field(insn->get_field());
+    if (field == nullptr) {
+      return ConstantValue::top();
+    }
+    return get_field_value(field);
   }
-  if (whole_program_state->has_call_graph()) {
+  always_assert(opcode::is_an_invoke(op));
+  if (has_call_graph()) {
     auto method = resolve_method(insn->get_method(), opcode_to_search(insn));
     if (method == nullptr && opcode_to_search(insn) == MethodSearch::Virtual) {
       method =
           resolve_method(insn->get_method(), MethodSearch::InterfaceVirtual);
     }
-    if (method == nullptr) {
-      return false;
-    }
-    if (whole_program_state->method_is_dynamic(method)) {
-      return false;
-    }
-    auto value = whole_program_state->get_return_value_from_cg(insn);
-    if (value.is_top()) {
-      return false;
+    if (method == nullptr || method_is_dynamic(method)) {
+      return ConstantValue::top();
     }
-    env->set(RESULT_REGISTER, value);
-    return true;
+    return get_return_value_from_cg(insn);
   }
-  auto op = insn->opcode();
   if (op != OPCODE_INVOKE_DIRECT && op != OPCODE_INVOKE_STATIC &&
       op != OPCODE_INVOKE_VIRTUAL) {
-    return false;
+    return ConstantValue::top();
   }
   auto method = resolve_method(insn->get_method(), opcode_to_search(insn));
   if (method == nullptr) {
+    return ConstantValue::top();
+  }
+  return get_return_value(method);
+}
+
+namespace {
+
+bool analyze_read(const WholeProgramState* whole_program_state,
+                  const IRInstruction* insn,
+                  ConstantEnvironment* env) {
+  if (whole_program_state == nullptr) {
     return false;
   }
-  auto value = whole_program_state->get_return_value(method);
+  auto value = whole_program_state->get_read_value(insn);
   if (value.is_top()) {
     return false;
   }
@@ -372,4 +312,27 @@ bool WholeProgramAwareAnalyzer::analyze_invoke(
   return true;
 }
 
+} // namespace
+
+bool WholeProgramAwareAnalyzer::analyze_sget(
+    const WholeProgramState* whole_program_state,
+    const IRInstruction* insn,
+    ConstantEnvironment* env) {
+  return analyze_read(whole_program_state, insn, env);
+}
+
+bool WholeProgramAwareAnalyzer::analyze_iget(
+    const WholeProgramState* whole_program_state,
+    const IRInstruction* insn,
+    ConstantEnvironment* env) {
+  return analyze_read(whole_program_state, insn, env);
+}
+
+bool WholeProgramAwareAnalyzer::analyze_invoke(
+    const WholeProgramState* whole_program_state,
+    const IRInstruction* insn,
+    ConstantEnvironment* env) {
+  return analyze_read(whole_program_state, insn, env);
+}
+
 } // namespace constant_propagation
@@ -141,24 +141,23 @@ class WholeProgramState {
     return call_graph::method_is_dynamic(m_call_graph.get(), method);
   }
 
+  /*
+   * Returns the value that the given sget, iget or invoke instruction reads
+   * from this state into the result register, or Top if there is none.
+   */
+  ConstantValue get_read_value(const IRInstruction* insn) const;
+
  private:
   void collect(const Scope& scope,
                const interprocedural::FixpointIterator& fp_iter);
 
   void collect_field_values(
       const IRInstruction* insn,
-      const ConstantEnvironment& env,
+      const ConstantValue& value,
       const DexType* clinit_cls,
       ConcurrentMap<const DexField*, std::vector<ConstantValue>>*
           fields_value_tmp);
 
-  void collect_return_values(
-      const IRInstruction* insn,
-      const ConstantEnvironment& env,
-      const DexMethod* method,
-      ConcurrentMap<const DexMethod*, std::vector<ConstantValue>>*
-          methods_value_tmp);
-
   boost::optional<call_graph::Graph> m_call_graph;
 
   // Unknown fields and methods will be treated as containing / returning Top.
@@ -35,6 +35,18 @@ ConstantEnvironment env_with_params(bool is_static,
   return env;
 }
 
+bool LocalAnalysisInputs::equals(const LocalAnalysisInputs& other) const {
+  if (values.size() != other.values.size() || !args.equals(other.args)) {
+    return false;
+  }
+  for (size_t i = 0; i < values.size(); ++i) {
+    if (!values[i].equals(other.values[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
 void FixpointIterator::analyze_node(call_graph::NodeId const& node,
                                     Domain* current_state) const {
   const DexMethod* method = node->method();
@@ -51,32 +63,19 @@ void FixpointIterator::analyze_node(call_graph::NodeId const& node,
     // never run.
     return;
   }
-  auto& cfg = code->cfg();
-  auto intra_cp = get_intraprocedural_analysis(method);
+  auto summary = get_local_analysis_summary(method);
   const auto outgoing_edges =
       call_graph::GraphInterface::successors(m_call_graph, node);
-  std::unordered_set<IRInstruction*> outgoing_insns;
+  std::unordered_set<const IRInstruction*> outgoing_insns;
   for (const auto& edge : outgoing_edges) {
     if (edge->callee() == m_call_graph.exit()) {
       continue; // ghost edge to the ghost exit node
     }
     outgoing_insns.emplace(edge->invoke_insn());
   }
-  for (auto* block : cfg.blocks()) {
-    auto state = intra_cp->get_entry_state_at(block);
-    auto last_insn = block->get_last_insn();
-    for (auto& mie : InstructionIterable(block)) {
-      auto* insn = mie.insn;
-      if (insn->has_method()) {
-        if (outgoing_insns.count(insn)) {
-          ArgumentDomain out_args;
-          for (size_t i = 0; i < insn->srcs_size(); ++i) {
-            out_args.set(i, state.get(insn->src(i)));
-          }
-          current_state->set(insn, out_args);
-        }
-      }
-      intra_cp->analyze_instruction(insn, &state, insn == last_insn->insn);
+  for (const auto& pair : summary->invoke_args) {
+    if (outgoing_insns.count(pair.first)) {
+      current_state->set(pair.first, pair.second);
     }
   }
 }
@@ -95,17 +94,93 @@ Domain FixpointIterator::analyze_edge(
   return entry_state_at_dest;
 }
 
-std::unique_ptr<intraprocedural::FixpointIterator>
-FixpointIterator::get_intraprocedural_analysis(const DexMethod* method) const {
+ArgumentDomain FixpointIterator::get_entry_args(
+    const DexMethod* method) const {
   auto args = Domain::bottom();
 
   if (m_call_graph.has_node(method)) {
     args = this->get_entry_state_at(m_call_graph.node(method));
   }
+  return args.get(CURRENT_PARTITION_LABEL);
+}
 
+std::unique_ptr<intraprocedural::FixpointIterator>
+FixpointIterator::get_intraprocedural_analysis(const DexMethod* method) const {
   return m_proc_analysis_factory(method,
                                  this->get_whole_program_state(),
-                                 args.get(CURRENT_PARTITION_LABEL));
+                                 get_entry_args(method));
+}
+
+LocalAnalysisInputs FixpointIterator::get_local_analysis_inputs(
+    const DexMethod* method, const LocalAnalysisSummary* previous) const {
+  LocalAnalysisInputs inputs;
+  inputs.args = get_entry_args(method);
+  if (previous != nullptr) {
+    inputs.reads = previous->inputs.reads;
+  } else {
+    auto reads = std::make_shared<std::vector<const IRInstruction*>>();
+    for (auto& mie : cfg::ConstInstructionIterable(method->get_code()->cfg())) {
+      auto op = mie.insn->opcode();
+      if (opcode::is_an_sget(op) || opcode::is_an_iget(op) ||
+          opcode::is_an_invoke(op)) {
+        reads->push_back(mie.insn);
+      }
+    }
+    inputs.reads = std::move(reads);
+  }
+  const auto& wps = this->get_whole_program_state();
+  inputs.values.reserve(inputs.reads->size());
+  for (const auto* insn : *inputs.reads) {
+    inputs.values.push_back(wps.get_read_value(insn));
+  }
+  return inputs;
+}
+
+std::shared_ptr<const LocalAnalysisSummary>
+FixpointIterator::get_local_analysis_summary(const DexMethod* method) const {
+  auto previous = m_summaries.get(method, nullptr);
+  auto inputs = get_local_analysis_inputs(method, previous.get());
+  if (previous != nullptr && previous->inputs.equals(inputs)) {
+    ++m_summaries_reused;
+    return previous;
+  }
+  ++m_summaries_computed;
+
+  auto summary = std::make_shared<LocalAnalysisSummary>();
+  summary->inputs = std::move(inputs);
+  auto& cfg = method->get_code()->cfg();
+  auto intra_cp = m_proc_analysis_factory(
+      method, this->get_whole_program_state(), summary->inputs.args);
+  for (auto* block : cfg.blocks()) {
+    auto state = intra_cp->get_entry_state_at(block);
+    auto last_insn = block->get_last_insn();
+    for (auto& mie : InstructionIterable(block)) {
+      auto* insn = mie.insn;
+      if (insn->has_method()) {
+        ArgumentDomain out_args;
+        for (size_t i = 0; i < insn->srcs_size(); ++i) {
+          out_args.set(i, state.get(insn->src(i)));
+        }
+        summary->invoke_args.emplace_back(insn, std::move(out_args));
+      }
+      intra_cp->analyze_instruction(insn, &state, insn == last_insn->insn);
+      auto op = insn->opcode();
+      if (opcode::is_an_sput(op) || opcode::is_an_iput(op)) {
+        summary->written_values.emplace_back(insn, state.get(insn->src(0)));
+      } else if (op == OPCODE_RETURN_VOID) {
+        summary->return_values.push_back(ConstantValue::top());
+      } else if (opcode::is_a_return(op)) {
+        summary->return_values.push_back(state.get(insn->src(0)));
+      }
+    }
+  }
+  if (method::is_clinit(method)) {
+    summary->clinit_field_env =
+        intra_cp->get_exit_state_at(cfg.exit_block()).get_field_environment();
+  }
+  std::shared_ptr<const LocalAnalysisSummary> result = std::move(summary);
+  m_summaries.insert_or_assign(std::make_pair(method, result));
+  return result;
 }
 
 } // namespace interprocedural
@@ -7,7 +7,10 @@
 
 #pragma once
 
+#include <atomic>
+
 #include "CallGraph.h"
+#include "ConcurrentContainers.h"
 #include "ConstantEnvironment.h"
 #include "ConstantPropagationAnalysis.h"
 #include "ConstantPropagationWholeProgramState.h"
@@ -58,6 +61,38 @@ using ProcedureAnalysisFactory =
     std::function<std::unique_ptr<intraprocedural::FixpointIterator>(
         const DexMethod*, const WholeProgramState&, ArgumentDomain)>;
 
+/*
+ * Everything the intraprocedural analysis of a method reads from outside the
+ * method: its arguments, and the values its field reads and invokes look up in
+ * the WholeProgramState. The same inputs always yield the same analysis.
+ */
+struct LocalAnalysisInputs {
+  ArgumentDomain args;
+  // The instructions that read from the WholeProgramState, and the values
+  // they read.
+  std::shared_ptr<const std::vector<const IRInstruction*>> reads;
+  std::vector<ConstantValue> values;
+
+  bool equals(const LocalAnalysisInputs& other) const;
+};
+
+/*
+ * The results of the intraprocedural analysis of a method that the
+ * interprocedural analysis consumes, along with the inputs they were computed
+ * from.
+ */
+struct LocalAnalysisSummary {
+  LocalAnalysisInputs inputs;
+  // The arguments passed at each invoke instruction.
+  std::vector<std::pair<const IRInstruction*, ArgumentDomain>> invoke_args;
+  // The values written by each sput and iput instruction.
+  std::vector<std::pair<const IRInstruction*, ConstantValue>> written_values;
+  // The values returned by each return instruction, Top for return-void.
+  std::vector<ConstantValue> return_values;
+  // The field values at the exit of a <clinit>.
+  FieldEnvironment clinit_field_env;
+};
+
 /*
  * Performs interprocedural constant propagation of stack / register values.
  *
@@ -87,6 +122,28 @@ class FixpointIterator : public sparta::ParallelMonotonicFixpointIterator<
   std::unique_ptr<intraprocedural::FixpointIterator>
   get_intraprocedural_analysis(const DexMethod*) const;
 
+  /*
+   * Return the summary of the intraprocedural analysis of the given method
+   * under the current arguments and WholeProgramState. The analysis only runs
+   * again when one of its inputs changed since the last summary of the
+   * method.
+   */
+  std::shared_ptr<const LocalAnalysisSummary> get_local_analysis_summary(
+      const DexMethod*) const;
+
+  /*
+   * How many summaries were computed and reused. Computed summaries are the
+   * methods whose inputs changed.
+   */
+  struct SummaryStats {
+    size_t computed{0};
+    size_t reused{0};
+  };
+
+  SummaryStats get_summary_stats() const {
+    return {m_summaries_computed, m_summaries_reused};
+  }
+
   const WholeProgramState& get_whole_program_state() const { return *m_wps; }
 
   void set_whole_program_state(std::unique_ptr<WholeProgramState> wps) {
@@ -99,6 +156,17 @@ class FixpointIterator : public sparta::ParallelMonotonicFixpointIterator<
   std::unique_ptr<const WholeProgramState> m_wps;
   ProcedureAnalysisFactory m_proc_analysis_factory;
   call_graph::Graph m_call_graph;
+  // Survives across global iterations, as the WholeProgramState changes.
+  mutable ConcurrentMap<const DexMethod*,
+                        std::shared_ptr<const LocalAnalysisSummary>>
+      m_summaries;
+  mutable std::atomic<size_t> m_summaries_computed{0};
+  mutable std::atomic<size_t> m_summaries_reused{0};
+
+  ArgumentDomain get_entry_args(const DexMethod* method) const;
+
+  LocalAnalysisInputs get_local_analysis_inputs(
+      const DexMethod* method, const LocalAnalysisSummary* previous) const;
 };
 
 } // namespace interprocedural
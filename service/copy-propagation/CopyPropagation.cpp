@@ -485,11 +485,15 @@ Stats CopyPropagation::run(const Scope& scope) {
 }
 
 Stats CopyPropagation::run(IRCode* code, DexMethod* method) {
-  Stats stats;
   cfg::ScopedCFG cfg(code);
+  return run(*cfg, method);
+}
+
+Stats CopyPropagation::run(cfg::ControlFlowGraph& cfg, DexMethod* method) {
+  Stats stats;
 
   if (m_config.canonicalize_locks && !m_config.regalloc_has_run) {
-    auto res = locks::run(*cfg);
+    auto res = locks::run(cfg);
     stats.lock_fixups = res.fixups;
     stats.non_singleton_lock_rdefs = res.non_singleton_rdefs ? 1 : 0;
   }
@@ -500,7 +504,7 @@ Stats CopyPropagation::run(IRCode* code, DexMethod* method) {
   // the registers.
   std::unordered_set<const IRInstruction*> range_set;
   if (m_config.regalloc_has_run) {
-    for (auto& mie : InstructionIterable(*cfg)) {
+    for (auto& mie : InstructionIterable(cfg)) {
       auto* insn = mie.insn;
       if (opcode::has_range_form(insn->opcode())) {
         insn->denormalize_registers();
@@ -513,11 +517,11 @@ Stats CopyPropagation::run(IRCode* code, DexMethod* method) {
   }
 
   AliasFixpointIterator fixpoint(
-      *cfg, method, m_config, range_set, stats, m_config.regalloc_has_run);
+      cfg, method, m_config, range_set, stats, m_config.regalloc_has_run);
   fixpoint.run(AliasDomain());
 
-  cfg::CFGMutation mutation{*cfg};
-  for (auto block : cfg->blocks()) {
+  cfg::CFGMutation mutation{cfg};
+  for (auto block : cfg.blocks()) {
     AliasDomain domain = fixpoint.get_entry_state_at(block);
     domain.update(
         [&fixpoint, block, &mutation, &stats](AliasedRegisters& aliases) {
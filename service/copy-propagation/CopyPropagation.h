@@ -49,6 +49,8 @@ class CopyPropagation final {
 
   Stats run(IRCode*, DexMethod* = nullptr);
 
+  Stats run(cfg::ControlFlowGraph&, DexMethod* = nullptr);
+
  private:
   const Config& m_config;
 };
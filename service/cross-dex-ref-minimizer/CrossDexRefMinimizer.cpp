@@ -5,6 +5,7 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <algorithm>
 #include <cinttypes>
 #include <cmath>
 #include <numeric>
@@ -13,6 +14,7 @@
 #include "DexUtil.h"
 #include "Show.h"
 #include "Trace.h"
+#include "WorkQueue.h"
 
 namespace cross_dex_ref_minimizer {
 
@@ -70,61 +72,96 @@ uint64_t CrossDexRefMinimizer::ClassInfo::get_priority() const {
   return (primary_priority << 24) | secondary_priority;
 }
 
-void CrossDexRefMinimizer::reprioritize(
-    const std::unordered_map<DexClass*, CrossDexRefMinimizer::ClassInfoDelta>&
-        affected_classes) {
+void CrossDexRefMinimizer::push(DexClass* cls, uint64_t priority) {
+  m_prioritized_classes.emplace_back(priority, cls);
+  std::push_heap(m_prioritized_classes.begin(), m_prioritized_classes.end());
+}
+
+void CrossDexRefMinimizer::mark_stale(DexClass* cls,
+                                      CrossDexRefMinimizer::ClassInfo& info) {
+  if (!info.stale) {
+    info.stale = true;
+    m_stale_classes.push_back(cls);
+  }
+}
+
+void CrossDexRefMinimizer::reprioritize() {
   TRACE(IDEX, 4, "[dex ordering] Reprioritizing %zu classes",
-        affected_classes.size());
-  for (auto p : affected_classes) {
-    ++m_stats.reprioritizations;
-    DexClass* affected_class = p.first;
-    CrossDexRefMinimizer::ClassInfoDelta& delta = p.second;
-    CrossDexRefMinimizer::ClassInfo& affected_class_info =
-        m_class_infos.at(affected_class);
-    affected_class_info.applied_refs_weight += delta.applied_refs_weight;
-    for (size_t i = 0; i < INFREQUENT_REFS_COUNT; ++i) {
-      affected_class_info.infrequent_refs_weight[i] +=
-          delta.infrequent_refs_weight[i];
+        m_stale_classes.size());
+  for (DexClass* stale_class : m_stale_classes) {
+    // The class might have been erased, or erased and inserted again, since
+    // it was marked.
+    auto it = m_class_infos.find(stale_class);
+    if (it == m_class_infos.end() || !it->second.stale) {
+      continue;
     }
+    ++m_stats.reprioritizations;
+    CrossDexRefMinimizer::ClassInfo& class_info = it->second;
+    class_info.stale = false;
+    class_info.priority = class_info.get_priority();
+    push(stale_class, class_info.priority);
+    TRACE(IDEX, 5,
+          "[dex ordering] Reprioritized class {%s} with priority %016" PRIu64
+          "; index %u; %" PRIu64
+          " applied refs weight, %s infrequent refs weights, %zu total refs",
+          SHOW(stale_class), class_info.priority, class_info.index,
+          class_info.applied_refs_weight,
+          format_infrequent_refs_array(class_info.infrequent_refs_weight)
+              .c_str(),
+          class_info.refs.size());
+  }
+  m_stale_classes.clear();
 
-    const auto priority = affected_class_info.get_priority();
-    m_prioritized_classes.update_priority(affected_class, priority);
-    TRACE(
-        IDEX, 5,
-        "[dex ordering] Reprioritized class {%s} with priority %016" PRIu64
-        "; index %u; %" PRIu64 " (delta %" PRId64
-        ") applied refs weight, %s (delta %s) infrequent refs weights, %zu "
-        "total refs",
-        SHOW(affected_class), priority, affected_class_info.index,
-        affected_class_info.applied_refs_weight, delta.applied_refs_weight,
-        format_infrequent_refs_array(affected_class_info.infrequent_refs_weight)
-            .c_str(),
-        format_infrequent_refs_array(delta.infrequent_refs_weight).c_str(),
-        affected_class_info.refs.size());
+  // Drop the outdated entries once they make up most of the heap.
+  if (m_prioritized_classes.size() > 2 * m_class_infos.size() + 1024) {
+    m_prioritized_classes.clear();
+    for (const auto& p : m_class_infos) {
+      m_prioritized_classes.emplace_back(p.second.priority, p.first);
+    }
+    std::make_heap(m_prioritized_classes.begin(), m_prioritized_classes.end());
   }
 }
 
-void CrossDexRefMinimizer::gather_refs(DexClass* cls,
-                                       std::vector<DexMethodRef*>& method_refs,
-                                       std::vector<DexFieldRef*>& field_refs,
-                                       std::vector<DexType*>& types,
-                                       std::vector<DexString*>& strings) {
-  cls->gather_methods(method_refs);
-  cls->gather_fields(field_refs);
-  cls->gather_types(types);
-  cls->gather_strings(strings);
+void CrossDexRefMinimizer::gather_refs(DexClass* cls, ClassRefs& refs) {
+  cls->gather_methods(refs.method_refs);
+  cls->gather_fields(refs.field_refs);
+  cls->gather_types(refs.types);
+  cls->gather_strings(refs.strings);
 
   // remove duplicates to speed up actual sorting
-  sort_unique(method_refs);
-  sort_unique(field_refs);
-  sort_unique(types);
-  sort_unique(strings);
+  sort_unique(refs.method_refs);
+  sort_unique(refs.field_refs);
+  sort_unique(refs.types);
+  sort_unique(refs.strings);
 
   // sort deterministically
-  std::sort(method_refs.begin(), method_refs.end(), compare_dexmethods);
-  std::sort(field_refs.begin(), field_refs.end(), compare_dexfields);
-  std::sort(types.begin(), types.end(), compare_dextypes);
-  std::sort(strings.begin(), strings.end(), compare_dexstrings);
+  std::sort(refs.method_refs.begin(), refs.method_refs.end(),
+            compare_dexmethods);
+  std::sort(refs.field_refs.begin(), refs.field_refs.end(), compare_dexfields);
+  std::sort(refs.types.begin(), refs.types.end(), compare_dextypes);
+  std::sort(refs.strings.begin(), refs.strings.end(), compare_dexstrings);
+}
+
+const CrossDexRefMinimizer::ClassRefs& CrossDexRefMinimizer::get_refs(
+    DexClass* cls, ClassRefs& storage) const {
+  auto it = m_prefetched_refs.find(cls);
+  if (it != m_prefetched_refs.end()) {
+    return it->second;
+  }
+  gather_refs(cls, storage);
+  return storage;
+}
+
+void CrossDexRefMinimizer::prefetch_refs(
+    const std::vector<DexClass*>& classes) {
+  std::vector<ClassRefs> refs(classes.size());
+  std::vector<size_t> indices(classes.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  workqueue_run<size_t>(
+      [&](size_t i) { gather_refs(classes[i], refs[i]); }, indices);
+  for (size_t i = 0; i < classes.size(); ++i) {
+    m_prefetched_refs[classes[i]] = std::move(refs[i]);
+  }
 }
 
 void CrossDexRefMinimizer::ignore(DexClass* cls) {
@@ -135,11 +172,8 @@ void CrossDexRefMinimizer::ignore(DexClass* cls) {
 }
 
 void CrossDexRefMinimizer::sample(DexClass* cls) {
-  std::vector<DexMethodRef*> method_refs;
-  std::vector<DexFieldRef*> field_refs;
-  std::vector<DexType*> types;
-  std::vector<DexString*> strings;
-  gather_refs(cls, method_refs, field_refs, types, strings);
+  ClassRefs storage;
+  const auto& class_refs = get_refs(cls, storage);
   auto increment = [&ref_counts = m_ref_counts,
                     &max_ref_count = m_max_ref_count](void* ref) {
     size_t& count = ref_counts[ref];
@@ -147,16 +181,16 @@ void CrossDexRefMinimizer::sample(DexClass* cls) {
       max_ref_count = count;
     }
   };
-  for (auto ref : method_refs) {
+  for (auto ref : class_refs.method_refs) {
     increment(ref);
   }
-  for (auto ref : field_refs) {
+  for (auto ref : class_refs.field_refs) {
     increment(ref);
   }
-  for (auto ref : types) {
+  for (auto ref : class_refs.types) {
     increment(ref);
   }
-  for (auto ref : strings) {
+  for (auto ref : class_refs.strings) {
     increment(ref);
   }
 }
@@ -173,11 +207,12 @@ void CrossDexRefMinimizer::insert(DexClass* cls) {
   // entries.
   // We don't bother with protos and type_lists, as they are directly related
   // to method refs (I tried, didn't help).
-  std::vector<DexMethodRef*> method_refs;
-  std::vector<DexFieldRef*> field_refs;
-  std::vector<DexType*> types;
-  std::vector<DexString*> strings;
-  gather_refs(cls, method_refs, field_refs, types, strings);
+  ClassRefs storage;
+  const auto& class_refs = get_refs(cls, storage);
+  const auto& method_refs = class_refs.method_refs;
+  const auto& field_refs = class_refs.field_refs;
+  const auto& types = class_refs.types;
+  const auto& strings = class_refs.strings;
 
   auto& refs = class_info.refs;
   refs.reserve(method_refs.size() + field_refs.size() + types.size() +
@@ -223,60 +258,64 @@ void CrossDexRefMinimizer::insert(DexClass* cls) {
   for (auto fref : field_refs) {
     add_weight(fref, m_config.field_ref_weight, m_config.field_seed_weight);
   }
+  m_prefetched_refs.erase(cls);
 
-  std::unordered_map<DexClass*, CrossDexRefMinimizer::ClassInfoDelta>
-      affected_classes;
   for (const std::pair<void*, uint32_t>& p : refs) {
     void* ref = p.first;
     uint32_t weight = p.second;
     auto& classes = m_ref_classes[ref];
     size_t frequency = classes.size();
-    // We record the need to undo (subtract weight of) a previously claimed
-    // infrequent ref. The actual undoing happens later in
+    // We undo (subtract weight of) a previously claimed infrequent ref. The
+    // priorities of the affected classes get recomputed later in
     // reprioritize.
     if (frequency > 0 && frequency <= INFREQUENT_REFS_COUNT) {
       for (DexClass* affected_class : classes) {
         always_assert(affected_class != cls);
-        affected_classes[affected_class]
-            .infrequent_refs_weight[frequency - 1] -= weight;
+        auto& affected_class_info = m_class_infos.at(affected_class);
+        affected_class_info.infrequent_refs_weight[frequency - 1] -= weight;
+        mark_stale(affected_class, affected_class_info);
       }
     }
     ++frequency;
     // We are recording a new infrequent unapplied ref, if any.
-    // This happens immediately for the to be inserted class cls,
-    // so that it can be used right away by the upcoming
-    // class_info.get_priority() call, while all other change requests happen
-    // later in reprioritize.
     if (frequency <= INFREQUENT_REFS_COUNT) {
       for (DexClass* affected_class : classes) {
-        affected_classes[affected_class]
-            .infrequent_refs_weight[frequency - 1] += weight;
+        auto& affected_class_info = m_class_infos.at(affected_class);
+        affected_class_info.infrequent_refs_weight[frequency - 1] += weight;
+        mark_stale(affected_class, affected_class_info);
       }
       class_info.infrequent_refs_weight[frequency - 1] += weight;
     }
 
-    // There's an implicit invariant that class_info and the keys of
-    // affected_classes are disjoint, so we are not going to reprioritize
-    // the class that we are adding here.
+    // The class that we are adding here is not in classes yet, so it never
+    // gets marked as stale.
     classes.emplace(cls);
   }
   const auto priority = class_info.get_priority();
-  m_prioritized_classes.insert(cls, priority);
+  class_info.priority = priority;
+  push(cls, priority);
   TRACE(IDEX, 4,
         "[dex ordering] Inserting class {%s} with priority %016" PRIu64
         "; index %u; %s infrequent refs weights, %zu total refs",
         SHOW(cls), priority, class_info.index,
         format_infrequent_refs_array(class_info.infrequent_refs_weight).c_str(),
         refs.size());
-  reprioritize(affected_classes);
 }
 
-bool CrossDexRefMinimizer::empty() const {
-  return m_prioritized_classes.empty();
-}
+bool CrossDexRefMinimizer::empty() const { return m_class_infos.empty(); }
 
-DexClass* CrossDexRefMinimizer::front() const {
-  return m_prioritized_classes.front();
+DexClass* CrossDexRefMinimizer::front() {
+  always_assert(!m_class_infos.empty());
+  reprioritize();
+  while (true) {
+    const auto& top = m_prioritized_classes.front();
+    auto it = m_class_infos.find(top.second);
+    if (it != m_class_infos.end() && it->second.priority == top.first) {
+      return top.second;
+    }
+    std::pop_heap(m_prioritized_classes.begin(), m_prioritized_classes.end());
+    m_prioritized_classes.pop_back();
+  }
 }
 
 DexClass* CrossDexRefMinimizer::worst(bool generated) {
@@ -335,7 +374,6 @@ DexClass* CrossDexRefMinimizer::worst() {
 }
 
 size_t CrossDexRefMinimizer::erase(DexClass* cls, bool emitted, bool reset) {
-  m_prioritized_classes.erase(cls);
   auto class_info_it = m_class_infos.find(cls);
   always_assert(class_info_it != m_class_infos.end());
   const CrossDexRefMinimizer::ClassInfo& class_info = class_info_it->second;
@@ -350,16 +388,20 @@ size_t CrossDexRefMinimizer::erase(DexClass* cls, bool emitted, bool reset) {
         class_info.refs.size(), emitted);
 
   // Updating m_applied_refs and m_ref_classes,
-  // and gathering information on how this affects other classes
+  // and the weights of the affected classes
 
   if (reset) {
     TRACE(IDEX, 3, "[dex ordering] Reset");
     ++m_stats.resets;
     m_applied_refs.clear();
+    // All remaining entries are outdated.
+    m_prioritized_classes.clear();
+    for (auto& p : m_class_infos) {
+      p.second.applied_refs_weight = 0;
+      mark_stale(p.first, p.second);
+    }
   }
 
-  std::unordered_map<DexClass*, CrossDexRefMinimizer::ClassInfoDelta>
-      affected_classes;
   const auto& refs = class_info.refs;
   size_t old_applied_refs = m_applied_refs.size();
   for (const std::pair<void*, uint32_t>& p : refs) {
@@ -372,15 +414,17 @@ size_t CrossDexRefMinimizer::erase(DexClass* cls, bool emitted, bool reset) {
     always_assert(erased);
     if (frequency <= INFREQUENT_REFS_COUNT) {
       for (DexClass* affected_class : classes) {
-        affected_classes[affected_class]
-            .infrequent_refs_weight[frequency - 1] -= weight;
+        auto& affected_class_info = m_class_infos.at(affected_class);
+        affected_class_info.infrequent_refs_weight[frequency - 1] -= weight;
+        mark_stale(affected_class, affected_class_info);
       }
     }
     --frequency;
     if (frequency > 0 && frequency <= INFREQUENT_REFS_COUNT) {
       for (DexClass* affected_class : classes) {
-        affected_classes[affected_class]
-            .infrequent_refs_weight[frequency - 1] += weight;
+        auto& affected_class_info = m_class_infos.at(affected_class);
+        affected_class_info.infrequent_refs_weight[frequency - 1] += weight;
+        mark_stale(affected_class, affected_class_info);
       }
     }
 
@@ -392,32 +436,22 @@ size_t CrossDexRefMinimizer::erase(DexClass* cls, bool emitted, bool reset) {
     }
     m_applied_refs.emplace(ref);
     for (DexClass* affected_class : classes) {
-      affected_classes[affected_class].applied_refs_weight += weight;
+      auto& affected_class_info = m_class_infos.at(affected_class);
+      affected_class_info.applied_refs_weight += weight;
+      mark_stale(affected_class, affected_class_info);
     }
   }
 
-  // Updating m_class_infos and m_prioritized_classes
-
+  // Its entries in m_prioritized_classes become outdated, and get dropped
+  // lazily.
   m_class_infos.erase(class_info_it);
   always_assert(m_class_infos.count(cls) == 0);
 
-  if (reset) {
-    m_prioritized_classes.clear();
-    for (auto it = m_class_infos.begin(); it != m_class_infos.end(); ++it) {
-      DexClass* reset_class = it->first;
-      CrossDexRefMinimizer::ClassInfo& reset_class_info = it->second;
-      reset_class_info.applied_refs_weight = 0;
-      const auto priority = reset_class_info.get_priority();
-      m_prioritized_classes.insert(reset_class, priority);
-      always_assert(reset_class_info.applied_refs_weight == 0);
-    }
-  }
   if (emitted) {
     TRACE(IDEX, 4, "[dex ordering] %zu + %zu = %zu applied refs",
           old_applied_refs, m_applied_refs.size() - old_applied_refs,
           m_applied_refs.size());
   }
-  reprioritize(affected_classes);
   return m_applied_refs.size() - old_applied_refs;
 }
 
@@ -12,7 +12,6 @@
 #include <vector>
 
 #include "DexClass.h"
-#include "MutablePriorityQueue.h"
 
 namespace cross_dex_ref_minimizer {
 
@@ -26,7 +25,10 @@ namespace cross_dex_ref_minimizer {
 // minimization, but also causes it to use more memory and run slower.
 constexpr uint64_t INFREQUENT_REFS_COUNT = 6;
 
-using PrioritizedDexClasses = MutablePriorityQueue<DexClass*, uint64_t>;
+// A max-heap of (priority, class) entries. Updating the priority of a class
+// pushes a new entry, and entries that no longer match the current priority
+// of their class are only discarded when they reach the top.
+using PrioritizedDexClasses = std::vector<std::pair<uint64_t, DexClass*>>;
 struct CrossDexRefMinimizerStats {
   uint64_t classes{0};
   uint64_t resets{0};
@@ -59,6 +61,12 @@ struct CrossDexRefMinimizerConfig {
 // - If there is a tie, use the original ordering as a tie breaker
 // TODO: Try some other variations.
 //
+// Priorities are not updated eagerly. Inserting and erasing classes only
+// updates the weights of the affected classes and marks them as stale; their
+// priorities are recomputed, once, when the class with the highest priority
+// is requested next. This yields the same order as updating priorities
+// immediately, as every priority is unique.
+//
 // (All this isn't entirely accurate, as it doesn't account for the dynamic
 // behavior of plugins.)
 //
@@ -78,6 +86,7 @@ struct CrossDexRefMinimizerConfig {
 // be the end of the world if an overflow ever happens.
 class CrossDexRefMinimizer {
   PrioritizedDexClasses m_prioritized_classes;
+  std::vector<DexClass*> m_stale_classes;
   std::unordered_set<void*> m_applied_refs;
   struct ClassInfo {
     uint32_t index;
@@ -88,6 +97,10 @@ class CrossDexRefMinimizer {
     uint64_t refs_weight;
     uint64_t applied_refs_weight;
     uint64_t seed_weight{0};
+    // The priority of the most recent entry of this class in
+    // m_prioritized_classes, valid unless the class is stale.
+    uint64_t priority{0};
+    bool stale{false};
     explicit ClassInfo(uint32_t i)
         : index(i),
           infrequent_refs_weight(),
@@ -102,27 +115,36 @@ class CrossDexRefMinimizer {
   CrossDexRefMinimizerStats m_stats;
   const CrossDexRefMinimizerConfig m_config;
 
-  struct ClassInfoDelta {
-    std::array<int32_t, INFREQUENT_REFS_COUNT> infrequent_refs_weight{};
-    int64_t applied_refs_weight{0};
-  };
-
-  void reprioritize(
-      const std::unordered_map<DexClass*, ClassInfoDelta>& affected_classes);
+  void push(DexClass* cls, uint64_t priority);
+  void mark_stale(DexClass* cls, ClassInfo& class_info);
+  void reprioritize();
   DexClass* worst(bool generated);
 
   std::unordered_map<void*, size_t> m_ref_counts;
   size_t m_max_ref_count{0};
 
-  void gather_refs(DexClass* cls,
-                   std::vector<DexMethodRef*>& method_refs,
-                   std::vector<DexFieldRef*>& field_refs,
-                   std::vector<DexType*>& types,
-                   std::vector<DexString*>& strings);
+  // The refs of a class, deduplicated and sorted deterministically.
+  struct ClassRefs {
+    std::vector<DexMethodRef*> method_refs;
+    std::vector<DexFieldRef*> field_refs;
+    std::vector<DexType*> types;
+    std::vector<DexString*> strings;
+  };
+  // Refs gathered ahead of time, dropped once the class is inserted.
+  std::unordered_map<DexClass*, ClassRefs> m_prefetched_refs;
+
+  static void gather_refs(DexClass* cls, ClassRefs& refs);
+  // Returns the prefetched refs of the class, or else gathers them into the
+  // given storage.
+  const ClassRefs& get_refs(DexClass* cls, ClassRefs& storage) const;
 
  public:
   explicit CrossDexRefMinimizer(const CrossDexRefMinimizerConfig& config)
       : m_config(config) {}
+  // Gather the refs of the given classes in parallel, so that sampling and
+  // inserting them doesn't have to. The classes must not change until they
+  // are inserted.
+  void prefetch_refs(const std::vector<DexClass*>& classes);
   // Gather frequency counts; must be called for relevant classes before
   // inserting them
   void sample(DexClass* cls);
@@ -130,7 +152,7 @@ class CrossDexRefMinimizer {
   void ignore(DexClass* cls);
   void insert(DexClass* cls);
   bool empty() const;
-  DexClass* front() const;
+  DexClass* front();
   // "Worst" in the sense of having highest seed weight.
   DexClass* worst();
   // "Erasing" a class applies its refs, updating
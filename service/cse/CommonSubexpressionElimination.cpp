@@ -51,6 +51,9 @@
 
 #include "CommonSubexpressionElimination.h"
 
+#include <algorithm>
+#include <boost/container/small_vector.hpp>
+#include <limits>
 #include <utility>
 
 #include "BaseIRAnalyzer.h"
@@ -100,7 +103,9 @@ const IROpcode IOPCODE_POSITIONAL = IROpcode(0xFFFE);
 
 struct IRValue {
   IROpcode opcode;
-  std::vector<value_id_t> srcs;
+  // Most values have few sources; keep them inline to avoid an allocation
+  // every time an instruction is (re-)analyzed.
+  boost::container::small_vector<value_id_t, 4> srcs;
   union {
     // Zero-initialize this union with the uint64_t member instead of a
     // pointer-type member so that it works properly even on 32-bit machines
@@ -135,6 +140,105 @@ bool operator==(const IRValue& a, const IRValue& b) {
   return a.opcode == b.opcode && a.srcs == b.srcs && a.literal == b.literal;
 }
 
+/*
+ * Interns values. Instead of a node-based map with a vector of sources per
+ * key, the values live in one vector, their sources in a shared arena, and
+ * lookups go through an open-addressing index into the values. Interning a
+ * value costs no allocation beyond the amortized growth of these vectors.
+ */
+class ValueTable {
+ public:
+  const value_id_t* find(const IRValue& value) const {
+    if (m_index.empty()) {
+      return nullptr;
+    }
+    auto hash = IRValueHasher()(value);
+    for (size_t slot = first_slot(hash);;
+         slot = (slot + 1) & (m_index.size() - 1)) {
+      auto pos = m_index[slot];
+      if (pos == EMPTY) {
+        return nullptr;
+      }
+      const auto& entry = m_entries[pos];
+      if (entry.hash == hash && equals(entry, value)) {
+        return &entry.id;
+      }
+    }
+  }
+
+  // The value must not be interned yet.
+  void insert(const IRValue& value, value_id_t id) {
+    // Keep the index at most half full.
+    if ((m_entries.size() + 1) * 2 > m_index.size()) {
+      grow();
+    }
+    Entry entry;
+    entry.hash = IRValueHasher()(value);
+    entry.id = id;
+    entry.literal = value.literal;
+    entry.opcode = value.opcode;
+    entry.srcs_begin = m_srcs.size();
+    entry.srcs_size = value.srcs.size();
+    m_srcs.insert(m_srcs.end(), value.srcs.begin(), value.srcs.end());
+    place(entry.hash, m_entries.size());
+    m_entries.push_back(entry);
+  }
+
+  size_t size() const { return m_entries.size(); }
+
+ private:
+  static constexpr uint32_t EMPTY = std::numeric_limits<uint32_t>::max();
+
+  struct Entry {
+    size_t hash;
+    value_id_t id;
+    uint64_t literal;
+    IROpcode opcode;
+    uint32_t srcs_begin;
+    uint32_t srcs_size;
+  };
+
+  bool equals(const Entry& entry, const IRValue& value) const {
+    return entry.opcode == value.opcode && entry.literal == value.literal &&
+           entry.srcs_size == value.srcs.size() &&
+           std::equal(value.srcs.begin(), value.srcs.end(),
+                      m_srcs.begin() + entry.srcs_begin);
+  }
+
+  // IRValueHasher doesn't mix its bits much, so spread them with a
+  // multiplicative hash before taking the top bits.
+  size_t first_slot(size_t hash) const {
+    return (uint64_t(hash) * 0x9e3779b97f4a7c15ull) >> m_shift;
+  }
+
+  void place(size_t hash, uint32_t pos) {
+    auto slot = first_slot(hash);
+    while (m_index[slot] != EMPTY) {
+      slot = (slot + 1) & (m_index.size() - 1);
+    }
+    m_index[slot] = pos;
+  }
+
+  void grow() {
+    if (m_index.empty()) {
+      m_index.assign(16, EMPTY);
+      m_shift = 64 - 4;
+    } else {
+      m_index.assign(m_index.size() * 2, EMPTY);
+      --m_shift;
+    }
+    for (uint32_t pos = 0; pos < m_entries.size(); ++pos) {
+      place(m_entries[pos].hash, pos);
+    }
+  }
+
+  std::vector<Entry> m_entries;
+  std::vector<value_id_t> m_srcs;
+  // Positions in m_entries; the size is 2^(64 - m_shift).
+  std::vector<uint32_t> m_index;
+  uint32_t m_shift{64};
+};
+
 using IRInstructionsDomain =
     sparta::PatriciaTreeSetAbstractDomain<const IRInstruction*>;
 using ValueIdDomain = sparta::ConstantAbstractDomain<value_id_t>;
@@ -539,9 +643,9 @@ class Analyzer final : public BaseIRAnalyzer<CseEnvironment> {
   }
 
   boost::optional<value_id_t> get_value_id(const IRValue& value) const {
-    auto it = m_value_ids.find(value);
-    if (it != m_value_ids.end()) {
-      return boost::optional<value_id_t>(it->second);
+    auto existing_id = m_value_ids.find(value);
+    if (existing_id != nullptr) {
+      return boost::optional<value_id_t>(*existing_id);
     }
     value_id_t id = m_value_ids.size() * ValueIdFlags::BASE;
     always_assert(id / ValueIdFlags::BASE == m_value_ids.size());
@@ -563,7 +667,7 @@ class Analyzer final : public BaseIRAnalyzer<CseEnvironment> {
         id |= (src & ValueIdFlags::IS_TRACKED_LOCATION_MASK);
       }
     }
-    m_value_ids.emplace(value, id);
+    m_value_ids.insert(value, id);
     if (value.opcode == IOPCODE_POSITIONAL) {
       m_positional_insns.emplace(id, value.positional_insn);
     } else if (value.opcode == IOPCODE_PRE_STATE_SRC) {
@@ -754,7 +858,7 @@ class Analyzer final : public BaseIRAnalyzer<CseEnvironment> {
   std::unordered_map<CseLocation, value_id_t, CseLocationHasher>
       m_tracked_locations;
   SharedState* m_shared_state;
-  mutable std::unordered_map<IRValue, value_id_t, IRValueHasher> m_value_ids;
+  mutable ValueTable m_value_ids;
   mutable std::unordered_set<value_id_t> m_pre_state_value_ids;
   mutable std::unordered_map<value_id_t, const IRInstruction*>
       m_positional_insns;
@@ -985,13 +1089,20 @@ void SharedState::init_finalizable_fields(const Scope& scope) {
   m_stats.finalizable_fields = m_finalizable_fields.size();
 }
 
-void SharedState::init_scope(const Scope& scope) {
+void SharedState::init_scope(const Scope& scope,
+                             const purity::AnalysisResult* purity_result) {
   always_assert(!m_method_override_graph);
   m_method_override_graph = method_override_graph::build_graph(scope);
 
-  auto iterations = compute_conditionally_pure_methods(
-      scope, m_method_override_graph.get(), m_pure_methods,
-      &m_conditionally_pure_methods);
+  size_t iterations;
+  if (purity_result != nullptr) {
+    m_conditionally_pure_methods = purity_result->conditionally_pure_methods;
+    iterations = purity_result->conditionally_pure_methods_iterations;
+  } else {
+    iterations = compute_conditionally_pure_methods(
+        scope, m_method_override_graph.get(), m_pure_methods,
+        &m_conditionally_pure_methods);
+  }
   m_stats.conditionally_pure_methods = m_conditionally_pure_methods.size();
   m_stats.conditionally_pure_methods_iterations = iterations;
   for (const auto& p : m_conditionally_pure_methods) {
@@ -72,7 +72,10 @@ class SharedState {
   explicit SharedState(
       const std::unordered_set<DexMethodRef*>& pure_methods,
       const std::unordered_set<DexString*>& finalish_field_names);
-  void init_scope(const Scope&);
+  // When given, the conditionally pure methods are taken from the purity
+  // results, which must have been computed for the same pure methods.
+  void init_scope(const Scope&,
+                  const purity::AnalysisResult* purity_result = nullptr);
   CseUnorderedLocationSet get_relevant_written_locations(
       const IRInstruction* insn,
       DexType* exact_virtual_scope,
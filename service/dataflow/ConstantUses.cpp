@@ -71,7 +71,13 @@
 namespace constant_uses {
 
 ConstantUses::ConstantUses(const cfg::ControlFlowGraph& cfg, DexMethod* method)
-    : m_reaching_definitions(cfg),
+    : ConstantUses(cfg, method, ir_analyzer::make_forward_ordering(cfg)) {}
+
+ConstantUses::ConstantUses(
+    const cfg::ControlFlowGraph& cfg,
+    DexMethod* method,
+    std::shared_ptr<const ir_analyzer::WeakPartialOrdering> ordering)
+    : m_reaching_definitions(cfg, ordering),
       m_rtype(method ? method->get_proto()->get_rtype() : nullptr) {
   m_reaching_definitions.run(reaching_defs::Environment());
 
@@ -119,7 +125,8 @@ ConstantUses::ConstantUses(const cfg::ControlFlowGraph& cfg, DexMethod* method)
   TRACE(CU, 2, "[CU] ConstantUses(%s) need_type_inference:%u", SHOW(method),
         need_type_inference);
   if (need_type_inference && method) {
-    m_type_inference.reset(new type_inference::TypeInference(cfg));
+    m_type_inference.reset(
+        new type_inference::TypeInference(cfg, std::move(ordering)));
     m_type_inference->run(method);
   }
 }
@@ -30,6 +30,12 @@ class ConstantUses {
  public:
   ConstantUses(const cfg::ControlFlowGraph& cfg, DexMethod* method);
 
+  // Uses the given ordering of `cfg` (see `ir_analyzer::make_forward_ordering`)
+  // for the underlying analyses, e.g. one shared with other analyses.
+  ConstantUses(const cfg::ControlFlowGraph& cfg,
+               DexMethod* method,
+               std::shared_ptr<const ir_analyzer::WeakPartialOrdering> ordering);
+
   // Given a const or const-wide instruction, retrieve all instructions that
   // use it.
   const std::vector<std::pair<IRInstruction*, size_t>>& get_constant_uses(
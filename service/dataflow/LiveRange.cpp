@@ -7,8 +7,9 @@
 
 #include "LiveRange.h"
 
-#include <boost/pending/disjoint_sets.hpp>
-#include <boost/property_map/property_map.hpp>
+#include <algorithm>
+#include <limits>
+#include <vector>
 
 #include "ControlFlow.h"
 #include "IRCode.h"
@@ -20,57 +21,119 @@ namespace {
 using namespace live_range;
 
 /*
- * Type aliases for disjoint_sets
- */
-using Rank = std::unordered_map<Def, size_t>;
-using Parent = std::unordered_map<Def, Def>;
-using RankPMap = boost::associative_property_map<Rank>;
-using ParentPMap = boost::associative_property_map<Parent>;
-using DefSets = boost::disjoint_sets<RankPMap, ParentPMap>;
-
-/*
- * Allocates a unique symbolic register for every disjoint set of defs.
+ * Puts all defs with a use in common into the same set, without computing
+ * the reaching definitions of every instruction.
+ *
+ * Defs are numbered densely in instruction order. Much like when building
+ * SSA form, a use whose def is not in the same block reads a phi node at the
+ * entry of the block, which is then joined with the node that each
+ * predecessor exits with: its last def of the register, or another phi node.
+ * Phi nodes are only created on the paths from uses back to their defs, so
+ * the cost is linear in the size of the live ranges rather than in the
+ * number of blocks times the number of registers.
  */
-class SymRegMapper {
+class LiveRanges {
  public:
-  explicit SymRegMapper(bool width_aware) : m_width_aware(width_aware) {}
-
-  reg_t make(Def def) {
-    if (m_def_to_reg.find(def) == m_def_to_reg.end()) {
-      if (m_width_aware) {
-        m_def_to_reg[def] = m_next_symreg;
-        m_next_symreg += def->dest_is_wide() ? 2 : 1;
-      } else {
-        m_def_to_reg[def] = m_next_symreg++;
+  explicit LiveRanges(const cfg::ControlFlowGraph& cfg) {
+    auto blocks = cfg.blocks();
+    m_blocks.resize(blocks.size());
+    for (size_t i = 0; i < blocks.size(); ++i) {
+      m_block_indices.emplace(blocks[i]->id(), i);
+    }
+    for (size_t i = 0; i < blocks.size(); ++i) {
+      // Holds the last def of each register so far, and of the block once
+      // we are done.
+      auto& exit_nodes = m_blocks[i].exit_nodes;
+      for (const auto& mie : InstructionIterable(blocks[i])) {
+        auto insn = mie.insn;
+        for (src_index_t j = 0; j < insn->srcs_size(); ++j) {
+          auto it = exit_nodes.find(insn->src(j));
+          m_use_nodes.push_back(it != exit_nodes.end()
+                                    ? it->second
+                                    : get_phi(i, insn->src(j)));
+        }
+        if (insn->has_dest()) {
+          exit_nodes[insn->dest()] = make_node(insn);
+        }
+      }
+    }
+    while (!m_phi_worklist.empty()) {
+      auto phi = m_phi_worklist.back();
+      m_phi_worklist.pop_back();
+      for (const auto* e : blocks[phi.block]->preds()) {
+        auto pred = m_block_indices.at(e->src()->id());
+        const auto& pred_exit_nodes = m_blocks[pred].exit_nodes;
+        auto it = pred_exit_nodes.find(phi.reg);
+        unite(phi.node,
+              it != pred_exit_nodes.end() ? it->second
+                                          : get_phi(pred, phi.reg));
       }
     }
-    return m_def_to_reg.at(def);
   }
 
-  reg_t at(Def def) { return m_def_to_reg.at(def); }
+  size_t num_nodes() const { return m_parent.size(); }
 
-  reg_t regs_size() const { return m_next_symreg; }
+  // The def of a node, or nullptr for phi nodes. Defs come in instruction
+  // order.
+  Def get_def(uint32_t node) const { return m_defs[node]; }
+
+  // The nodes read by the sources of the instructions, in instruction order.
+  const std::vector<uint32_t>& use_nodes() const { return m_use_nodes; }
+
+  uint32_t find(uint32_t node) {
+    while (m_parent[node] != node) {
+      m_parent[node] = m_parent[m_parent[node]];
+      node = m_parent[node];
+    }
+    return node;
+  }
 
  private:
-  bool m_width_aware;
-  reg_t m_next_symreg{0};
-  std::unordered_map<Def, reg_t> m_def_to_reg;
-};
+  struct BlockNodes {
+    std::unordered_map<reg_t, uint32_t> exit_nodes;
+    std::unordered_map<reg_t, uint32_t> phis;
+  };
 
-/*
- * Put all defs with a use in common into the same set.
- */
-void unify_defs(const UseDefChains& chains, DefSets* def_sets) {
-  for (const auto& chain : chains) {
-    auto& defs = chain.second;
-    auto it = defs.begin();
-    Def first = *it;
-    auto end = defs.end();
-    for (++it; it != end; ++it) {
-      def_sets->union_set(first, *it);
+  struct Phi {
+    size_t block;
+    reg_t reg;
+    uint32_t node;
+  };
+
+  uint32_t make_node(Def def) {
+    uint32_t node = m_parent.size();
+    m_parent.push_back(node);
+    m_defs.push_back(def);
+    return node;
+  }
+
+  uint32_t get_phi(size_t block, reg_t reg) {
+    auto& phis = m_blocks[block].phis;
+    auto it = phis.find(reg);
+    if (it != phis.end()) {
+      return it->second;
+    }
+    auto node = make_node(nullptr);
+    phis.emplace(reg, node);
+    m_phi_worklist.push_back(Phi{block, reg, node});
+    return node;
+  }
+
+  void unite(uint32_t a, uint32_t b) {
+    a = find(a);
+    b = find(b);
+    if (a != b) {
+      m_parent[std::max(a, b)] = std::min(a, b);
     }
   }
-}
+
+  std::unordered_map<cfg::BlockId, size_t> m_block_indices;
+  std::vector<BlockNodes> m_blocks;
+  std::vector<uint32_t> m_parent;
+  std::vector<Def> m_defs;
+  std::vector<uint32_t> m_use_nodes;
+  std::vector<Phi> m_phi_worklist;
+};
 
 template <typename Iter, typename Fn>
 void replay_analysis_with_callback(const cfg::ControlFlowGraph& cfg,
@@ -153,34 +216,45 @@ DefUseChains MoveAwareChains::get_def_use_chains() const {
 
 void renumber_registers(IRCode* code, bool width_aware) {
   cfg::ScopedCFG cfg(code);
+  renumber_registers(*cfg, width_aware);
+}
 
-  auto ud_chains = Chains(*cfg).get_use_def_chains();
+void renumber_registers(cfg::ControlFlowGraph& cfg, bool width_aware) {
+  LiveRanges live_ranges(cfg);
 
-  Rank rank;
-  Parent parent;
-  DefSets def_sets((RankPMap(rank)), (ParentPMap(parent)));
-  for (const auto& mie : cfg::InstructionIterable(*cfg)) {
-    if (mie.insn->has_dest()) {
-      def_sets.make_set(mie.insn);
+  // Allocate a unique symbolic register for every set of defs, in the order
+  // of their first def.
+  constexpr reg_t kNoReg = std::numeric_limits<reg_t>::max();
+  std::vector<reg_t> sym_regs(live_ranges.num_nodes(), kNoReg);
+  reg_t next_sym_reg = 0;
+  for (uint32_t node = 0; node < live_ranges.num_nodes(); ++node) {
+    auto def = live_ranges.get_def(node);
+    if (def == nullptr) {
+      continue;
     }
-  }
-  unify_defs(ud_chains, &def_sets);
-  SymRegMapper sym_reg_mapper(width_aware);
-  for (auto& mie : cfg::InstructionIterable(*cfg)) {
-    auto insn = mie.insn;
-    if (insn->has_dest()) {
-      auto sym_reg = sym_reg_mapper.make(def_sets.find_set(insn));
-      insn->set_dest(sym_reg);
+    auto& sym_reg = sym_regs[live_ranges.find(node)];
+    if (sym_reg == kNoReg) {
+      sym_reg = next_sym_reg;
+      next_sym_reg += width_aware && def->dest_is_wide() ? 2 : 1;
     }
+    def->set_dest(sym_reg);
   }
-  for (auto& mie : cfg::InstructionIterable(*cfg)) {
-    auto insn = mie.insn;
-    for (src_index_t i = 0; i < insn->srcs_size(); ++i) {
-      auto& defs = ud_chains.at(Use{insn, i});
-      insn->set_src(i, sym_reg_mapper.at(def_sets.find_set(*defs.begin())));
+
+  const auto& use_nodes = live_ranges.use_nodes();
+  size_t use_idx = 0;
+  for (cfg::Block* block : cfg.blocks()) {
+    for (const auto& mie : InstructionIterable(block)) {
+      auto insn = mie.insn;
+      for (src_index_t i = 0; i < insn->srcs_size(); ++i) {
+        auto sym_reg = sym_regs[live_ranges.find(use_nodes[use_idx++])];
+        always_assert_log(sym_reg != kNoReg,
+                          "Found use without def when processing [0x%p]%s",
+                          &mie, SHOW(insn));
+        insn->set_src(i, sym_reg);
+      }
     }
   }
-  cfg->set_registers_size(sym_reg_mapper.regs_size());
+  cfg.set_registers_size(next_sym_reg);
 }
 
 } // namespace live_range
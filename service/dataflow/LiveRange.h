@@ -5,6 +5,8 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#pragma once
+
 #include <boost/functional/hash.hpp>
 #include <cstdint>
 #include <unordered_map>
@@ -84,4 +86,7 @@ class MoveAwareChains {
  */
 void renumber_registers(IRCode*, bool width_aware = true);
 
+// Renumbers the registers of an editable cfg.
+void renumber_registers(cfg::ControlFlowGraph&, bool width_aware = true);
+
 } // namespace live_range
@@ -8,10 +8,15 @@
 #pragma once
 
 #include "BaseIRAnalyzer.h"
+#include "BitVectorSetAbstractDomain.h"
 #include "ControlFlow.h"
-#include "PatriciaTreeSetAbstractDomain.h"
 
-using LivenessDomain = sparta::PatriciaTreeSetAbstractDomain<reg_t>;
+// Registers below this bound are stored in bit vectors; a live set that
+// contains a larger register falls back to a Patricia tree.
+constexpr size_t kLivenessMaxDenseRegisters = 1024;
+
+using LivenessDomain =
+    sparta::BitVectorSetAbstractDomain<reg_t, kLivenessMaxDenseRegisters>;
 
 class LivenessFixpointIterator final
     : public ir_analyzer::BaseBackwardsIRAnalyzer<LivenessDomain> {
@@ -19,6 +24,12 @@ class LivenessFixpointIterator final
   explicit LivenessFixpointIterator(const cfg::ControlFlowGraph& cfg)
       : ir_analyzer::BaseBackwardsIRAnalyzer<LivenessDomain>(cfg) {}
 
+  LivenessFixpointIterator(
+      const cfg::ControlFlowGraph& cfg,
+      std::shared_ptr<const ir_analyzer::WeakPartialOrdering> ordering)
+      : ir_analyzer::BaseBackwardsIRAnalyzer<LivenessDomain>(
+            cfg, std::move(ordering)) {}
+
   void analyze_instruction(IRInstruction* insn,
                            LivenessDomain* current_state) const override {
     if (insn->has_dest()) {
@@ -26,6 +26,11 @@ class FixpointIterator final : public ir_analyzer::BaseIRAnalyzer<Environment> {
   explicit FixpointIterator(const cfg::ControlFlowGraph& cfg)
       : ir_analyzer::BaseIRAnalyzer<Environment>(cfg) {}
 
+  FixpointIterator(
+      const cfg::ControlFlowGraph& cfg,
+      std::shared_ptr<const ir_analyzer::WeakPartialOrdering> ordering)
+      : ir_analyzer::BaseIRAnalyzer<Environment>(cfg, std::move(ordering)) {}
+
   void analyze_instruction(const IRInstruction* insn,
                            Environment* current_state) const override {
     if (insn->has_dest()) {
@@ -41,6 +46,11 @@ class MoveAwareFixpointIterator final
   explicit MoveAwareFixpointIterator(const cfg::ControlFlowGraph& cfg)
       : ir_analyzer::BaseIRAnalyzer<Environment>(cfg) {}
 
+  MoveAwareFixpointIterator(
+      const cfg::ControlFlowGraph& cfg,
+      std::shared_ptr<const ir_analyzer::WeakPartialOrdering> ordering)
+      : ir_analyzer::BaseIRAnalyzer<Environment>(cfg, std::move(ordering)) {}
+
   void analyze_instruction(const IRInstruction* insn,
                            Environment* current_state) const override {
     if (opcode::is_a_move(insn->opcode())) {
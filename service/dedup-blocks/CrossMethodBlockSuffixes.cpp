@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "CrossMethodBlockSuffixes.h"
+
+#include <algorithm>
+#include <boost/functional/hash.hpp>
+#include <map>
+
+#include "ConcurrentContainers.h"
+#include "DexUtil.h"
+#include "ScopedCFG.h"
+#include "Walkers.h"
+
+namespace {
+
+using namespace dedup_blocks_impl;
+
+// Opcodes, renumbered registers and operands of the instructions of a suffix,
+// starting from the end of the block.
+using Encoding = std::vector<uint64_t>;
+
+// Collisions only cost extra encodings in the second phase, so a narrow hash
+// keeps the first table small.
+using SuffixHash = uint32_t;
+
+struct SuffixOwner {
+  const DexMethod* method{nullptr};
+  bool shared{false};
+};
+
+/*
+ * Walks the instructions of the block backwards, calling the visitor with the
+ * first instruction, the length, and the hash and encoding of every suffix
+ * within the configured lengths. Registers are numbered in the order in which
+ * the backward walk first sees them, so that the numbering of a suffix
+ * extends the numbering of the shorter ones.
+ */
+template <typename Visitor>
+void visit_suffixes(const Config& config,
+                    cfg::Block* block,
+                    const Visitor& visitor) {
+  std::vector<const IRInstruction*> insns;
+  for (const auto& mie : InstructionIterable(block)) {
+    insns.push_back(mie.insn);
+  }
+  // Branch targets differ from method to method.
+  if (!insns.empty() && opcode::is_branch(insns.back()->opcode())) {
+    insns.pop_back();
+  }
+
+  Encoding encoding;
+  size_t hash = 0;
+  std::unordered_map<reg_t, uint64_t> regs;
+  auto encode = [&](uint64_t value) {
+    encoding.push_back(value);
+    boost::hash_combine(hash, value);
+  };
+  auto encode_reg = [&](reg_t reg) {
+    encode(regs.emplace(reg, regs.size()).first->second);
+  };
+  auto encode_ptr = [&](const void* ptr) {
+    encode(reinterpret_cast<uintptr_t>(ptr));
+  };
+
+  uint32_t length = 0;
+  for (auto it = insns.rbegin();
+       it != insns.rend() && length < config.cross_method_max_insns;
+       ++it) {
+    auto insn = *it;
+    auto op = insn->opcode();
+    // Payloads are owned by their instructions, so they never compare equal.
+    if (opcode::is_a_load_param(op) || insn->has_data()) {
+      break;
+    }
+    encode(op);
+    if (insn->has_dest()) {
+      encode_reg(insn->dest());
+    }
+    encode(insn->srcs_size());
+    for (auto src : insn->srcs()) {
+      encode_reg(src);
+    }
+    if (insn->has_literal()) {
+      encode(insn->get_literal());
+    } else if (insn->has_type()) {
+      encode_ptr(insn->get_type());
+    } else if (insn->has_field()) {
+      encode_ptr(insn->get_field());
+    } else if (insn->has_method()) {
+      encode_ptr(insn->get_method());
+    } else if (insn->has_string()) {
+      encode_ptr(insn->get_string());
+    }
+    ++length;
+    // A suffix cannot start with a move-result, as it belongs to the
+    // instruction before.
+    if (length >= config.cross_method_min_insns &&
+        !opcode::is_move_result_any(op)) {
+      visitor(insn, length, static_cast<SuffixHash>(hash), encoding);
+    }
+  }
+}
+
+bool suffix_less(const BlockSuffix& a, const BlockSuffix& b) {
+  if (a.method != b.method) {
+    return compare_dexmethods(a.method, b.method);
+  }
+  return a.block_id < b.block_id;
+}
+
+} // namespace
+
+namespace dedup_blocks_impl {
+
+std::vector<DuplicateBlockSuffixes> find_cross_method_duplicate_suffixes(
+    const Config& config, const DexClasses& dex) {
+  auto eligible = [&config](DexMethod* method) {
+    return config.method_blocklist.count(method) == 0;
+  };
+
+  // First, find the hashes that occur in more than one method.
+  ConcurrentMap<SuffixHash, SuffixOwner> owners;
+  walk::parallel::code(dex, eligible, [&](DexMethod* method, IRCode& code) {
+    cfg::ScopedCFG cfg(&code);
+    std::unordered_set<SuffixHash> hashes;
+    for (auto block : cfg->blocks()) {
+      visit_suffixes(config, block,
+                     [&](const IRInstruction*, uint32_t, SuffixHash hash,
+                         const Encoding&) { hashes.insert(hash); });
+    }
+    for (auto hash : hashes) {
+      owners.update(hash,
+                    [method](SuffixHash, SuffixOwner& owner, bool exists) {
+                      if (!exists) {
+                        owner.method = method;
+                      } else if (owner.method != method) {
+                        owner.shared = true;
+                      }
+                    });
+    }
+  });
+
+  // Then, group the suffixes with shared hashes by their actual encoding.
+  ConcurrentMap<Encoding, DuplicateBlockSuffixes, boost::hash<Encoding>>
+      groups;
+  walk::parallel::code(dex, eligible, [&](DexMethod* method, IRCode& code) {
+    cfg::ScopedCFG cfg(&code);
+    for (auto block : cfg->blocks()) {
+      visit_suffixes(
+          config, block,
+          [&](const IRInstruction* insn, uint32_t length, SuffixHash hash,
+              const Encoding& encoding) {
+            auto it = owners.find(hash);
+            if (it == owners.end() || !it->second.shared) {
+              return;
+            }
+            groups.update(encoding,
+                          [&](const Encoding&, DuplicateBlockSuffixes& group,
+                              bool) {
+                            group.length = length;
+                            group.suffixes.push_back(
+                                {method, block->id(), insn});
+                          });
+          });
+    }
+  });
+  owners.clear();
+
+  std::vector<DuplicateBlockSuffixes> result;
+  for (auto& p : groups) {
+    auto& group = p.second;
+    std::sort(group.suffixes.begin(), group.suffixes.end(), suffix_less);
+    if (group.suffixes.front().method == group.suffixes.back().method) {
+      // The hash was shared through a collision only.
+      continue;
+    }
+    result.push_back(std::move(group));
+  }
+  groups.clear();
+
+  // Keep only the longest group for each set of blocks.
+  using Blocks = std::vector<std::pair<const DexMethod*, cfg::BlockId>>;
+  std::map<Blocks, size_t> longest;
+  for (size_t i = 0; i < result.size(); ++i) {
+    Blocks blocks;
+    for (const auto& suffix : result[i].suffixes) {
+      blocks.emplace_back(suffix.method, suffix.block_id);
+    }
+    auto emplaced = longest.emplace(std::move(blocks), i);
+    if (!emplaced.second &&
+        result[emplaced.first->second].length < result[i].length) {
+      emplaced.first->second = i;
+    }
+  }
+  std::vector<DuplicateBlockSuffixes> longest_groups;
+  longest_groups.reserve(longest.size());
+  for (auto& p : longest) {
+    longest_groups.push_back(std::move(result[p.second]));
+  }
+
+  std::sort(longest_groups.begin(), longest_groups.end(),
+            [](const auto& a, const auto& b) {
+              if (a.get_savings() != b.get_savings()) {
+                return a.get_savings() > b.get_savings();
+              }
+              if (a.length != b.length) {
+                return a.length > b.length;
+              }
+              return suffix_less(a.suffixes.front(), b.suffixes.front());
+            });
+  return longest_groups;
+}
+
+} // namespace dedup_blocks_impl
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "ControlFlow.h"
+#include "DedupBlocks.h"
+#include "DexClass.h"
+
+namespace dedup_blocks_impl {
+
+// The instructions from first_insn to the end of the given block, not
+// counting a trailing branch. Block ids are only meaningful for the CFG that
+// was built during the search; the instructions outlive it.
+struct BlockSuffix {
+  DexMethod* method;
+  cfg::BlockId block_id;
+  const IRInstruction* first_insn;
+};
+
+// Block suffixes of the same length that are identical up to a renaming of
+// registers, found in at least two different methods.
+struct DuplicateBlockSuffixes {
+  uint32_t length;
+  std::vector<BlockSuffix> suffixes;
+
+  // The number of instructions that would be saved by keeping only one copy
+  // of the suffix.
+  size_t get_savings() const { return length * (suffixes.size() - 1); }
+};
+
+/*
+ * Finds block suffixes that recur across the methods of the given dex. This
+ * is the cross-method counterpart of the per-method dedup, meant to feed
+ * transformations such as outlining or method dedup.
+ *
+ * Suffixes between config.cross_method_min_insns and
+ * config.cross_method_max_insns instructions long are hashed in parallel into
+ * a concurrent table, and only the suffixes whose hash was seen in more than
+ * one method are then encoded in full and grouped. This bounds the memory to
+ * a small entry per distinct hash, and to the encodings of actual candidates.
+ *
+ * A group is dropped when a longer group covers exactly the same blocks.
+ * Groups are ordered by decreasing savings.
+ */
+std::vector<DuplicateBlockSuffixes> find_cross_method_duplicate_suffixes(
+    const Config& config, const DexClasses& dex);
+
+} // namespace dedup_blocks_impl
@@ -985,6 +985,8 @@ Stats& Stats::operator+=(const Stats& that) {
   insns_removed += that.insns_removed;
   blocks_split += that.blocks_split;
   positions_inserted += that.positions_inserted;
+  cross_method_suffix_groups += that.cross_method_suffix_groups;
+  cross_method_suffix_insns += that.cross_method_suffix_insns;
   for (auto& p : that.dup_sizes) {
     dup_sizes[p.first] += p.second;
   }
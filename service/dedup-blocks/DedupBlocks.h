@@ -19,6 +19,10 @@ struct Config {
   bool split_postfix = true;
   bool debug = false;
   bool dedup_throws = false;
+  // Search for block suffixes that are duplicated across methods.
+  bool cross_method_suffixes = false;
+  unsigned int cross_method_min_insns = 3;
+  unsigned int cross_method_max_insns = 32;
 };
 
 struct Stats {
@@ -27,6 +31,8 @@ struct Stats {
   int insns_removed{0};
   int blocks_split{0};
   int positions_inserted{0};
+  size_t cross_method_suffix_groups{0};
+  size_t cross_method_suffix_insns{0};
   // map from block size to number of blocks with that size
   std::unordered_map<size_t, size_t> dup_sizes;
   Stats& operator+=(const Stats& that);
@@ -7,6 +7,9 @@
 
 #include "LocalPointersAnalysis.h"
 
+#include <condition_variable>
+#include <mutex>
+
 #include "DexUtil.h"
 #include "PatriciaTreeSet.h"
 #include "Resolver.h"
@@ -381,52 +384,109 @@ void FixpointIteratorMapDeleter::operator()(FixpointIteratorMap* map) {
   wq.run_all();
 }
 
-static void analyze_method_recursive(
+namespace {
+
+/*
+ * Bounds the total estimated cost of the analyses that are in flight.
+ */
+class MemoryBudget {
+ public:
+  explicit MemoryBudget(size_t limit) : m_limit(limit) {}
+
+  void acquire(size_t cost) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock,
+              [&] { return m_in_use == 0 || m_in_use + cost <= m_limit; });
+    m_in_use += cost;
+  }
+
+  void release(size_t cost) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_in_use -= cost;
+    }
+    m_cv.notify_all();
+  }
+
+ private:
+  const size_t m_limit;
+  size_t m_in_use{0};
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+};
+
+using OwningConsumer =
+    std::function<void(const DexMethod*, std::unique_ptr<FixpointIterator>)>;
+
+InvokeToSummaryMap get_invoke_to_summary_map(
     const DexMethod* method,
     const call_graph::Graph& call_graph,
-    sparta::PatriciaTreeSet<const DexMethodRef*> visiting,
-    FixpointIteratorMap* fp_iter_map,
-    SummaryCMap* summary_map) {
+    const SummaryCMap& summary_map) {
+  InvokeToSummaryMap invoke_to_summary_map;
+  if (call_graph.has_node(method)) {
+    for (const auto& edge : call_graph.node(method)->callees()) {
+      auto* callee = edge->callee()->method();
+      auto it = summary_map.find(callee);
+      if (it != summary_map.end()) {
+        invoke_to_summary_map.emplace(edge->invoke_insn(), it->second);
+      }
+    }
+  }
+  return invoke_to_summary_map;
+}
+
+/*
+ * Analyze :method after its callees and hand its FixpointIterator over to
+ * :consume. The escape summary is published after :consume returns, so that
+ * whatever :consume derives for a method is available once its summary is.
+ * This method is thread-safe.
+ */
+void analyze_method_recursive(const DexMethod* method,
+                              const call_graph::Graph& call_graph,
+                              sparta::PatriciaTreeSet<const DexMethodRef*>
+                                  visiting,
+                              SummaryCMap* summary_map,
+                              MemoryBudget* budget,
+                              const OwningConsumer& consume) {
   if (!method || summary_map->count(method) != 0 || visiting.contains(method) ||
       method->get_code() == nullptr) {
     return;
   }
   visiting.insert(method);
 
-  std::unordered_map<const IRInstruction*, EscapeSummary> invoke_to_summary_map;
   if (call_graph.has_node(method)) {
-    const auto& callee_edges = call_graph.node(method)->callees();
-    for (const auto& edge : callee_edges) {
-      auto* callee = edge->callee()->method();
-      analyze_method_recursive(callee, call_graph, visiting, fp_iter_map,
-                               summary_map);
-      if (summary_map->count(callee) != 0) {
-        invoke_to_summary_map.emplace(edge->invoke_insn(),
-                                      summary_map->at(callee));
-      }
+    for (const auto& edge : call_graph.node(method)->callees()) {
+      analyze_method_recursive(edge->callee()->method(), call_graph, visiting,
+                               summary_map, budget, consume);
     }
   }
 
   auto* code = method->get_code();
   auto& cfg = code->cfg();
-  auto fp_iter = new FixpointIterator(cfg, std::move(invoke_to_summary_map));
+  auto cost = budget == nullptr ? 0 : estimate_analysis_cost(cfg);
+  if (budget != nullptr) {
+    budget->acquire(cost);
+  }
+  auto fp_iter = std::make_unique<FixpointIterator>(
+      cfg, get_invoke_to_summary_map(method, call_graph, *summary_map));
   fp_iter->run(Environment());
-
-  // The following updates form a critical section.
-  {
-    boost::lock_guard<boost::mutex> lock(fp_iter_map->get_lock(method));
-    fp_iter_map->update_unsafe(method,
-                               [&](auto, FixpointIterator*& v, bool exists) {
-                                 redex_assert(!(exists ^ (v != nullptr)));
-                                 delete v;
-                                 v = fp_iter;
-                               });
-    summary_map->update(method, [&](auto, EscapeSummary& v, bool) {
-      v = get_escape_summary(*fp_iter, *code);
-    });
+  auto summary = get_escape_summary(*fp_iter, *code);
+  consume(method, std::move(fp_iter));
+  if (budget != nullptr) {
+    budget->release(cost);
   }
+  summary_map->update(method, [&](auto, EscapeSummary& v, bool) {
+    v = std::move(summary);
+  });
+}
+
+void seed_summaries(SummaryCMap* summary_map) {
+  summary_map->emplace(DexMethod::get_method("Ljava/lang/Object;.<init>:()V"),
+                       EscapeSummary{});
 }
 
+} // namespace
+
 FixpointIteratorMapPtr analyze_scope(const Scope& scope,
                                      const call_graph::Graph& call_graph,
                                      SummaryCMap* summary_map_ptr) {
@@ -435,17 +495,63 @@ FixpointIteratorMapPtr analyze_scope(const Scope& scope,
   if (summary_map_ptr == nullptr) {
     summary_map_ptr = &summary_map;
   }
-  summary_map_ptr->emplace(
-      DexMethod::get_method("Ljava/lang/Object;.<init>:()V"), EscapeSummary{});
-
-  walk::parallel::code(scope, [&](const DexMethod* method, IRCode& code) {
+  seed_summaries(summary_map_ptr);
+
+  OwningConsumer keep = [&](const DexMethod* method,
+                            std::unique_ptr<FixpointIterator> fp_iter) {
+    // Two threads may race to analyze the same method; keep the last result.
+    fp_iter_map->update(method, [&](auto, FixpointIterator*& v, bool exists) {
+      redex_assert(!(exists ^ (v != nullptr)));
+      delete v;
+      v = fp_iter.release();
+    });
+  };
+  walk::parallel::code(scope, [&](const DexMethod* method, IRCode&) {
     sparta::PatriciaTreeSet<const DexMethodRef*> visiting;
-    analyze_method_recursive(method, call_graph, visiting, fp_iter_map.get(),
-                             summary_map_ptr);
+    analyze_method_recursive(method, call_graph, visiting, summary_map_ptr,
+                             /* budget */ nullptr, keep);
   });
   return fp_iter_map;
 }
 
+void analyze_scope_summaries(const Scope& scope,
+                             const call_graph::Graph& call_graph,
+                             SummaryCMap* summary_map,
+                             const FixpointIteratorConsumer& consumer,
+                             size_t memory_budget) {
+  seed_summaries(summary_map);
+
+  MemoryBudget budget(memory_budget);
+  OwningConsumer consume = [&](const DexMethod* method,
+                               std::unique_ptr<FixpointIterator> fp_iter) {
+    if (consumer) {
+      consumer(method, *fp_iter);
+    }
+  };
+  walk::parallel::code(scope, [&](const DexMethod* method, IRCode&) {
+    sparta::PatriciaTreeSet<const DexMethodRef*> visiting;
+    analyze_method_recursive(method, call_graph, visiting, summary_map,
+                             &budget, consume);
+  });
+}
+
+size_t estimate_analysis_cost(const cfg::ControlFlowGraph& cfg) {
+  // Each block has an entry and an exit state. The result register is bound
+  // too.
+  return 2 * cfg.num_blocks() * (cfg.get_registers_size() + 1);
+}
+
+std::unique_ptr<FixpointIterator> analyze_method(
+    const DexMethod* method,
+    const call_graph::Graph& call_graph,
+    const SummaryCMap& summary_map) {
+  auto fp_iter = std::make_unique<FixpointIterator>(
+      method->get_code()->cfg(),
+      get_invoke_to_summary_map(method, call_graph, summary_map));
+  fp_iter->run(Environment());
+  return fp_iter;
+}
+
 void collect_exiting_pointers(const FixpointIterator& fp_iter,
                               const IRCode& code,
                               PointerSet* returned_ptrs,
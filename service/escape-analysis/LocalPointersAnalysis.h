@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include <functional>
+#include <memory>
 #include <ostream>
 #include <utility>
 
@@ -316,6 +318,46 @@ FixpointIteratorMapPtr analyze_scope(const Scope&,
                                      const call_graph::Graph&,
                                      SummaryCMap* = nullptr);
 
+/*
+ * Called on each method analyzed by analyze_scope_summaries(), while its
+ * FixpointIterator is still alive. Calls for the callees of a method happen
+ * before the call for the method, except within call graph cycles.
+ */
+using FixpointIteratorConsumer =
+    std::function<void(const DexMethod*, const FixpointIterator&)>;
+
+/*
+ * Same traversal as analyze_scope(), but only the escape summaries are kept:
+ * the environments of a method are freed as soon as its summary has been
+ * computed and the optional consumer has seen them.
+ *
+ * The number of methods being analyzed at the same time is bounded by
+ * memory_budget rather than by the number of threads alone. The cost of a
+ * method is estimated by estimate_analysis_cost(); a method whose cost
+ * exceeds the whole budget is still analyzed, on its own.
+ */
+void analyze_scope_summaries(const Scope&,
+                             const call_graph::Graph&,
+                             SummaryCMap*,
+                             const FixpointIteratorConsumer& = nullptr,
+                             size_t memory_budget = 1u << 24);
+
+/*
+ * A proxy for the memory held by a FixpointIterator over the given CFG: the
+ * number of register bindings in its per-block entry and exit states.
+ */
+size_t estimate_analysis_cost(const cfg::ControlFlowGraph&);
+
+/*
+ * Reanalyze a single method, using the summaries computed by
+ * analyze_scope_summaries() for its callees. This is how the clients of the
+ * streaming analysis get the environments of a method back when they need
+ * them.
+ */
+std::unique_ptr<FixpointIterator> analyze_method(const DexMethod*,
+                                                 const call_graph::Graph&,
+                                                 const SummaryCMap&);
+
 /*
  * Join over all possible returned and thrown values.
  */
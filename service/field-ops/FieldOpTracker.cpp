@@ -38,14 +38,15 @@ struct Escapes {
 // Escape information for instructions define a value
 using InstructionEscapes = std::unordered_map<IRInstruction*, Escapes>;
 
+// We track the set of actively analyzed methods to find recursive cases.
+using ActiveMethods = std::unordered_set<const DexMethod*>;
+
 class WritesAnalyzer {
  private:
   const field_op_tracker::TypeLifetimes* m_type_lifetimes;
   const field_op_tracker::FieldStatsMap& m_field_stats;
   std::unordered_map<const DexMethod*, InstructionEscapes>
       m_method_insn_escapes;
-  // We track the set of actively analyzed methods to find recursive cases.
-  std::unordered_set<const DexMethod*> m_active;
 
   bool has_lifetime(const DexType* t) {
     return (!m_type_lifetimes && type::is_object(t)) ||
@@ -218,7 +219,7 @@ class WritesAnalyzer {
   }
 
   // Whether a constructor can store any values with (relevant) lifetimes
-  bool may_capture(const DexMethodRef* method) {
+  bool may_capture(const DexMethodRef* method, ActiveMethods* active) {
     always_assert(method::is_init(method));
     auto type = method->get_class();
     if (type == type::java_lang_Object()) {
@@ -234,7 +235,7 @@ class WritesAnalyzer {
     std::unordered_set<DexField*> non_vestigial_objects_written_fields;
     std::unordered_set<DexMethod*> invoked_base_ctors;
     bool other_escapes{false};
-    if (!get_writes(method->as_def(),
+    if (!get_writes(method->as_def(), active,
                     /* non_zero_written_fields */ nullptr,
                     &non_vestigial_objects_written_fields, &invoked_base_ctors,
                     &other_escapes)) {
@@ -244,8 +245,8 @@ class WritesAnalyzer {
     }
     if (other_escapes || !non_vestigial_objects_written_fields.empty() ||
         (std::find_if(invoked_base_ctors.begin(), invoked_base_ctors.end(),
-                      [this](DexMethod* invoked_base_ctor) {
-                        return may_capture(invoked_base_ctor);
+                      [this, active](DexMethod* invoked_base_ctor) {
+                        return may_capture(invoked_base_ctor, active);
                       }) != invoked_base_ctors.end())) {
       return true;
     }
@@ -255,7 +256,8 @@ class WritesAnalyzer {
   // Whether a newly created object may capture any values with (relevant)
   // lifetimes, or itself, as part of its creation
   bool may_capture(const IRInstruction* insn,
-                   const std::unordered_set<DexMethod*>& invoked_ctors) {
+                   const std::unordered_set<DexMethod*>& invoked_ctors,
+                   ActiveMethods* active) {
     switch (insn->opcode()) {
     case OPCODE_NEW_ARRAY:
       return false;
@@ -267,7 +269,7 @@ class WritesAnalyzer {
       always_assert(!invoked_ctors.empty());
       for (auto method : invoked_ctors) {
         always_assert(method->get_class() == insn->get_type());
-        if (may_capture(method)) {
+        if (may_capture(method, active)) {
           return true;
         }
       }
@@ -290,7 +292,7 @@ class WritesAnalyzer {
     });
   }
 
-  bool any_read(const std::unordered_set<DexField*>& fields) {
+  bool any_read(const std::unordered_set<DexField*>& fields) const {
     for (auto field : fields) {
       if (m_field_stats.at(field).reads != 0) {
         return true;
@@ -299,14 +301,17 @@ class WritesAnalyzer {
     return false;
   }
 
-  // Result indicates whether we ran into a recursive case.
+  // Result indicates whether we ran into a recursive case. The analyzer is
+  // only read, so that methods can be analyzed in parallel, each with its own
+  // set of active methods.
   bool get_writes(
       const DexMethod* method,
+      ActiveMethods* active,
       std::unordered_set<DexField*>* non_zero_written_fields,
       std::unordered_set<DexField*>* non_vestigial_objects_written_fields,
       std::unordered_set<DexMethod*>* invoked_base_ctors,
       bool* other_escapes) {
-    if (!m_active.insert(method).second) {
+    if (!active->insert(method).second) {
       return false;
     }
     auto& insn_escapes = m_method_insn_escapes.at(method);
@@ -327,7 +332,7 @@ class WritesAnalyzer {
           opcode::is_a_new(insn->opcode()) &&
           !(any_read(escapes.put_value_fields) || escapes.other) &&
           !(has_lifetime(insn->get_type()) &&
-            may_capture(insn, escapes.invoked_ctors));
+            may_capture(insn, escapes.invoked_ctors, active));
       for (auto field : escapes.put_value_fields) {
         always_assert(field != nullptr);
         if (non_zero_written_fields) {
@@ -346,7 +351,7 @@ class WritesAnalyzer {
         *other_escapes = true;
       }
     }
-    m_active.erase(method);
+    active->erase(method);
     return true;
   }
 };
@@ -381,32 +386,54 @@ bool TypeLifetimes::has_lifetime(const DexType* t) const {
   return true;
 }
 
+FieldWrites& FieldWrites::operator+=(const FieldWrites& that) {
+  non_zero_written_fields.insert(that.non_zero_written_fields.begin(),
+                                 that.non_zero_written_fields.end());
+  non_vestigial_objects_written_fields.insert(
+      that.non_vestigial_objects_written_fields.begin(),
+      that.non_vestigial_objects_written_fields.end());
+  return *this;
+}
+
 FieldWrites analyze_writes(const Scope& scope,
                            const FieldStatsMap& field_stats,
                            const TypeLifetimes* type_lifetimes) {
-  std::unordered_set<DexField*> non_zero_written_fields;
-  std::unordered_set<DexField*> non_vestigial_objects_written_fields;
   WritesAnalyzer analyzer(scope, field_stats, type_lifetimes);
-  walk::code(scope, [&](const DexMethod* method, const IRCode&) {
-    auto success = analyzer.get_writes(method,
-                                       &non_zero_written_fields,
-                                       &non_vestigial_objects_written_fields,
-                                       /* invoked_base_ctors */ nullptr,
-                                       /* other_escapes */ nullptr);
-    always_assert(success);
-  });
-  return FieldWrites{non_zero_written_fields,
-                     non_vestigial_objects_written_fields};
+  return walk::parallel::methods<FieldWrites>(
+      scope, [&](DexMethod* method, FieldWrites* field_writes) {
+        if (!method->get_code()) {
+          return;
+        }
+        ActiveMethods active;
+        auto success = analyzer.get_writes(
+            method, &active, &field_writes->non_zero_written_fields,
+            &field_writes->non_vestigial_objects_written_fields,
+            /* invoked_base_ctors */ nullptr,
+            /* other_escapes */ nullptr);
+        always_assert(success);
+      });
+};
+
+namespace {
+
+struct MergeFieldStats {
+  void operator()(const FieldStatsMap& addend,
+                  FieldStatsMap* accumulator) const {
+    for (auto& p : addend) {
+      (*accumulator)[p.first] += p.second;
+    }
+  }
 };
 
+} // namespace
+
 FieldStatsMap analyze(const Scope& scope) {
-  ConcurrentMap<DexField*, FieldStats> concurrent_field_stats;
-  // Gather the read/write counts from instructions.
-  walk::parallel::methods(scope, [&](DexMethod* method) {
+  // Gather the read/write counts from instructions, in one map per thread.
+  auto gather = [](DexMethod* method, FieldStatsMap* thread_field_stats) {
     if (!method->get_code()) {
       return;
     }
-    std::unordered_map<DexField*, FieldStats> field_stats;
+    auto& field_stats = *thread_field_stats;
     if (method::is_init(method)) {
       // compute init_writes by checking receiver of each iput
       cfg::ScopedCFG cfg(method->get_code());
@@ -462,14 +489,9 @@ FieldStatsMap analyze(const Scope& scope) {
           }
           return editable_cfg_adapter::LOOP_CONTINUE;
         });
-    for (auto& p : field_stats) {
-      concurrent_field_stats.update(
-          p.first, [&](DexField*, FieldStats& fs, bool) { fs += p.second; });
-    }
-  });
-
-  FieldStatsMap field_stats(concurrent_field_stats.begin(),
-                            concurrent_field_stats.end());
+  };
+  auto field_stats =
+      walk::parallel::methods<FieldStatsMap, MergeFieldStats>(scope, gather);
 
   // Gather field reads from annotations.
   walk::annotations(scope, [&](DexAnnotation* anno) {
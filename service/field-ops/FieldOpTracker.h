@@ -59,6 +59,8 @@ struct FieldWrites {
   // the object's lifetime can be observed by a weak reference, at least after
   // the storing method returns.
   std::unordered_set<DexField*> non_vestigial_objects_written_fields;
+
+  FieldWrites& operator+=(const FieldWrites& that);
 };
 
 FieldWrites analyze_writes(const Scope& scope,
@@ -6,11 +6,16 @@
  */
 
 #include "KotlinInstanceRewriter.h"
+
+#include <numeric>
+
 #include "CFGMutation.h"
+#include "EditableCfgAdapter.h"
 #include "PassManager.h"
 #include "ScopedCFG.h"
 #include "Show.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 namespace {
 DexField* has_instance_field(DexClass* cls, DexString* instance) {
@@ -62,8 +67,14 @@ KotlinInstanceRewriter::Stats KotlinInstanceRewriter::remove_escaping_instance(
     ConcurrentMap<DexFieldRef*,
                   std::set<std::pair<IRInstruction*, DexMethod*>>>&
         concurrent_instance_map) {
+  if (concurrent_instance_map.size() == 0) {
+    return Stats{};
+  }
   ConcurrentSet<DexFieldRef*> remove_list;
-  // Get all the single uses of the INSTANCE variables
+  // Get all the single uses of the INSTANCE variables. Only the instructions
+  // are looked at, so there is no need to build a cfg for each method, and
+  // the uses of each method are added to the shared map once the method has
+  // been scanned.
   KotlinInstanceRewriter::Stats total_stats =
       walk::parallel::methods<KotlinInstanceRewriter::Stats>(
           scope, [&](DexMethod* method) {
@@ -73,40 +84,43 @@ KotlinInstanceRewriter::Stats KotlinInstanceRewriter::remove_escaping_instance(
               return stats;
             }
 
-            cfg::ScopedCFG cfg(method->get_code());
-            auto iterable = cfg::InstructionIterable(*cfg);
-            for (auto it = iterable.begin(); it != iterable.end(); it++) {
-              auto insn = it->insn;
+            std::vector<std::pair<DexFieldRef*, IRInstruction*>> uses;
+            editable_cfg_adapter::iterate(code, [&](MethodItemEntry& mie) {
+              auto insn = mie.insn;
 
               if (!opcode::is_an_sget(insn->opcode()) &&
                   !opcode::is_an_sput(insn->opcode())) {
-                continue;
+                return editable_cfg_adapter::LOOP_CONTINUE;
               }
 
               auto field = insn->get_field();
               if (!concurrent_instance_map.count(field)) {
-                continue;
+                return editable_cfg_adapter::LOOP_CONTINUE;
               }
               if (remove_list.count(field)) {
-                continue;
+                return editable_cfg_adapter::LOOP_CONTINUE;
               }
               // If there is more SPUT otherthan the initial one.
               if (opcode::is_an_sput(insn->opcode())) {
                 if (method::is_clinit(method) &&
                     method->get_class() == field->get_type()) {
-                  continue;
+                  return editable_cfg_adapter::LOOP_CONTINUE;
                 }
                 // Erase if the field is written elsewhere.
                 remove_list.insert(field);
-                continue;
+                return editable_cfg_adapter::LOOP_CONTINUE;
               }
 
+              uses.emplace_back(field, insn);
+              return editable_cfg_adapter::LOOP_CONTINUE;
+            });
+            for (const auto& use : uses) {
               concurrent_instance_map.update(
-                  field,
+                  use.first,
                   [&](DexFieldRef*,
                       std::set<std::pair<IRInstruction*, DexMethod*>>& s,
                       bool /* exists */) {
-                    s.insert(std::make_pair(insn, method));
+                    s.insert(std::make_pair(use.second, method));
                   });
             }
             return stats;
@@ -140,71 +154,98 @@ KotlinInstanceRewriter::Stats KotlinInstanceRewriter::transform(
   std::sort(fields_to_rewrite.begin(), fields_to_rewrite.end(),
             compare_dexfields);
 
+  // A <clinit> that initializes one INSTANCE may also read another one, so
+  // the rewrites are grouped by method, and each method is then rewritten
+  // with a single cfg, in parallel.
+  struct MethodRewrites {
+    // INSTANCE fields whose initialization is removed.
+    std::unordered_set<DexFieldRef*> removed_sputs;
+    // INSTANCE fields whose reads become new instances, and the constructor
+    // to call.
+    std::unordered_map<DexFieldRef*, DexMethodRef*> replaced_sgets;
+  };
+  std::vector<DexMethod*> methods;
+  std::unordered_map<DexMethod*, MethodRewrites> rewrites;
+  auto get_rewrites = [&](DexMethod* meth) -> MethodRewrites& {
+    auto it = rewrites.find(meth);
+    if (it == rewrites.end()) {
+      methods.push_back(meth);
+      it = rewrites.emplace(meth, MethodRewrites()).first;
+    }
+    return it->second;
+  };
   for (auto* field : fields_to_rewrite) {
     stats.kotlin_instances_with_single_use++;
-    // Remove instance from cls
     auto* cls = type_class(field->get_class());
-    auto dmethods = cls->get_dmethods();
-    for (auto* meth : dmethods) {
-      if (method::is_clinit(meth)) {
+    auto clinit = cls->get_clinit();
+    if (clinit && clinit->get_code()) {
+      get_rewrites(clinit).removed_sputs.insert(field);
+    }
+
+    DexMethodRef* init = DexMethod::get_method(
+        cls->get_type(), DexString::make_string("<init>"),
+        DexProto::make_proto(type::_void(), DexTypeList::make_type_list({})));
+    always_assert(init);
+    // Make this constructor publcic
+    set_public(init->as_def());
+    for (auto& method_it : concurrent_instance_map.find(field)->second) {
+      get_rewrites(method_it.second).replaced_sgets.emplace(field, init);
+    }
+  }
+
+  std::vector<KotlinInstanceRewriter::Stats> method_stats(methods.size());
+  std::vector<size_t> indices(methods.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  workqueue_run<size_t>(
+      [&](size_t i) {
+        auto* meth = methods[i];
+        const auto& method_rewrites = rewrites.at(meth);
+        auto& mstats = method_stats[i];
         cfg::ScopedCFG cfg(meth->get_code());
         cfg::CFGMutation m(*cfg);
-        TRACE(KOTLIN_INSTANCE, 5, "%s <clinit> before\n%s", SHOW(cls),
-              SHOW(*cfg));
+        TRACE(KOTLIN_INSTANCE, 5, "%s before\n%s", SHOW(meth), SHOW(*cfg));
         auto iterable = cfg::InstructionIterable(*cfg);
         for (auto insn_it = iterable.begin(); insn_it != iterable.end();
              insn_it++) {
           auto insn = insn_it->insn;
-          if (!opcode::is_an_sput(insn->opcode()) ||
-              insn->get_field() != field) {
+          if (opcode::is_an_sput(insn->opcode())) {
+            if (method_rewrites.removed_sputs.count(insn->get_field())) {
+              m.remove(insn_it);
+              mstats.kotlin_instance_fields_removed++;
+            }
             continue;
           }
-
-          m.remove(insn_it);
-          stats.kotlin_instance_fields_removed++;
+          if (!opcode::is_an_sget(insn->opcode())) {
+            continue;
+          }
+          auto init_it = method_rewrites.replaced_sgets.find(insn->get_field());
+          if (init_it == method_rewrites.replaced_sgets.end()) {
+            continue;
+          }
+          auto init = init_it->second;
+          auto move_result_it = cfg->move_result_of(insn_it);
+          IRInstruction* new_isn = new IRInstruction(OPCODE_NEW_INSTANCE);
+          new_isn->set_type(init->get_class());
+          IRInstruction* mov_result =
+              new IRInstruction(IOPCODE_MOVE_RESULT_PSEUDO_OBJECT);
+          mov_result->set_dest(move_result_it->insn->dest());
+          IRInstruction* init_isn = new IRInstruction(OPCODE_INVOKE_DIRECT);
+          init_isn->set_method(init)->set_srcs_size(1)->set_src(
+              0, move_result_it->insn->dest());
+          m.replace(insn_it, {new_isn, mov_result, init_isn});
+          m.remove(move_result_it);
+          mstats.kotlin_new_inserted++;
         }
         m.flush();
-        TRACE(KOTLIN_INSTANCE, 5, "%s <clinit> after\n%s", SHOW(cls),
-              SHOW(*cfg));
-        break;
-      }
-    }
+        TRACE(KOTLIN_INSTANCE, 5, "%s after\n%s", SHOW(meth), SHOW(*cfg));
+      },
+      indices);
+  for (const auto& mstats : method_stats) {
+    stats += mstats;
+  }
 
-    // Convert INSTANCE read to new instance creation
-    for (auto& method_it : concurrent_instance_map.find(field)->second) {
-      auto* meth = method_it.second;
-      cfg::ScopedCFG cfg(meth->get_code());
-      cfg::CFGMutation m(*cfg);
-      TRACE(KOTLIN_INSTANCE, 5, "%s before\n%s", SHOW(meth), SHOW(*cfg));
-      DexMethodRef* init = DexMethod::get_method(
-          cls->get_type(), DexString::make_string("<init>"),
-          DexProto::make_proto(type::_void(), DexTypeList::make_type_list({})));
-      always_assert(init);
-      // Make this constructor publcic
-      set_public(init->as_def());
-      auto iterable = cfg::InstructionIterable(*cfg);
-      for (auto insn_it = iterable.begin(); insn_it != iterable.end();
-           insn_it++) {
-        auto insn = insn_it->insn;
-        if (!opcode::is_an_sget(insn->opcode()) || insn->get_field() != field) {
-          continue;
-        }
-        auto move_result_it = cfg->move_result_of(insn_it);
-        IRInstruction* new_isn = new IRInstruction(OPCODE_NEW_INSTANCE);
-        new_isn->set_type(cls->get_type());
-        IRInstruction* mov_result =
-            new IRInstruction(IOPCODE_MOVE_RESULT_PSEUDO_OBJECT);
-        mov_result->set_dest(move_result_it->insn->dest());
-        IRInstruction* init_isn = new IRInstruction(OPCODE_INVOKE_DIRECT);
-        init_isn->set_method(init)->set_srcs_size(1)->set_src(
-            0, move_result_it->insn->dest());
-        m.replace(insn_it, {new_isn, mov_result, init_isn});
-        m.remove(move_result_it);
-        stats.kotlin_new_inserted++;
-      }
-      m.flush();
-      TRACE(KOTLIN_INSTANCE, 5, "%s after\n%s", SHOW(meth), SHOW(*cfg));
-    }
+  for (auto* field : fields_to_rewrite) {
+    auto* cls = type_class(field->get_class());
     cls->remove_field(resolve_field(field));
   }
   return stats;
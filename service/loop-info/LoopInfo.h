@@ -125,17 +125,28 @@ class Loop {
   Loop* m_parent_loop;
 };
 
+/**
+ * The const constructor leaves the CFG untouched, so its result can be cached
+ * on the CFG and shared between queries:
+ *
+ *   const auto& loops = cfg.get_analysis<loop_impl::LoopInfo>();
+ *
+ * The non-const constructor also inserts a preheader block for each loop.
+ */
 class LoopInfo {
  public:
   using iterator = std::vector<Loop*>::iterator;
+  using const_iterator = std::vector<Loop*>::const_iterator;
   using reverse_iterator = std::vector<Loop*>::reverse_iterator;
   explicit LoopInfo(const cfg::ControlFlowGraph& cfg);
   explicit LoopInfo(cfg::ControlFlowGraph& cfg);
   ~LoopInfo();
-  Loop* get_loop_for(cfg::Block* block);
-  size_t num_loops();
+  Loop* get_loop_for(cfg::Block* block) const;
+  size_t num_loops() const;
   iterator begin();
   iterator end();
+  const_iterator begin() const;
+  const_iterator end() const;
   reverse_iterator rbegin();
   reverse_iterator rend();
 
@@ -7,20 +7,27 @@
 
 #include "MethodDedup.h"
 
+#include "DexHasher.h"
 #include "DexOpcode.h"
+#include "DexUtil.h"
 #include "IRCode.h"
 #include "MethodReference.h"
 #include "Show.h"
 #include "Trace.h"
+#include "WorkQueue.h"
 
 namespace {
 
+// Below this number of methods, hashing in parallel costs more than it saves.
+constexpr size_t MIN_METHODS_TO_HASH_IN_PARALLEL = 256;
+
 struct CodeAsKey {
   const IRCode* code;
   const bool dedup_throw_blocks;
+  const size_t hash;
 
-  CodeAsKey(const IRCode* c, bool dedup_throw_blocks)
-      : code(c), dedup_throw_blocks(dedup_throw_blocks) {}
+  CodeAsKey(const IRCode* c, bool dedup_throw_blocks, size_t hash)
+      : code(c), dedup_throw_blocks(dedup_throw_blocks), hash(hash) {}
 
   static bool non_throw_instruction_equal(const IRInstruction& left,
                                           const IRInstruction& right) {
@@ -36,25 +43,22 @@ struct CodeAsKey {
 };
 
 struct CodeHasher {
-  size_t operator()(const CodeAsKey& key) const {
-    size_t result = 0;
-    for (auto& mie : InstructionIterable(key.code)) {
-      result ^= mie.insn->hash();
-    }
-    return result;
-  }
+  size_t operator()(const CodeAsKey& key) const { return key.hash; }
 };
 
 using DuplicateMethods =
     std::unordered_map<CodeAsKey, MethodOrderedSet, CodeHasher>;
 
 std::vector<MethodOrderedSet> get_duplicate_methods_simple(
-    const MethodOrderedSet& methods, bool dedup_throw_blocks) {
+    const MethodOrderedSet& methods,
+    bool dedup_throw_blocks,
+    const method_dedup::CodeHashIndex& hashes) {
   DuplicateMethods duplicates;
   for (DexMethod* method : methods) {
     always_assert(method->get_code());
-    duplicates[CodeAsKey(method->get_code(), dedup_throw_blocks)].emplace(
-        method);
+    duplicates[CodeAsKey(method->get_code(), dedup_throw_blocks,
+                         hashes.get(method))]
+        .emplace(method);
   }
 
   std::vector<MethodOrderedSet> result;
@@ -69,6 +73,24 @@ std::vector<MethodOrderedSet> get_duplicate_methods_simple(
 
 namespace method_dedup {
 
+CodeHashIndex::CodeHashIndex(const std::vector<DexMethod*>& methods) {
+  // Create all the entries up front, so that the workers only write values.
+  for (auto method : methods) {
+    m_hashes.emplace(method, 0);
+  }
+  auto hash = [this](const DexMethod* method) {
+    m_hashes.at(method) =
+        hashing::stable_instructions_hash(method->get_code());
+  };
+  if (methods.size() < MIN_METHODS_TO_HASH_IN_PARALLEL) {
+    for (auto method : methods) {
+      hash(method);
+    }
+  } else {
+    workqueue_run<DexMethod*>(hash, methods);
+  }
+}
+
 std::vector<MethodOrderedSet> group_similar_methods(
     const std::vector<DexMethod*>& methods) {
 
@@ -102,15 +124,21 @@ std::vector<MethodOrderedSet> group_identical_methods(
     const std::vector<DexMethod*>& methods, bool dedup_throw_blocks) {
   std::vector<MethodOrderedSet> result;
   std::vector<MethodOrderedSet> same_protos = group_similar_methods(methods);
+  CodeHashIndex hashes(methods);
 
   // Find actual duplicates.
   for (const auto& same_proto : same_protos) {
     std::vector<MethodOrderedSet> duplicates =
-        get_duplicate_methods_simple(same_proto, dedup_throw_blocks);
+        get_duplicate_methods_simple(same_proto, dedup_throw_blocks, hashes);
 
     result.insert(result.end(), duplicates.begin(), duplicates.end());
   }
 
+  // The buckets above are keyed by pointers; make the order deterministic.
+  std::sort(result.begin(), result.end(),
+            [](const MethodOrderedSet& a, const MethodOrderedSet& b) {
+              return compare_dexmethods(*a.begin(), *b.begin());
+            });
   return result;
 }
 
@@ -16,6 +16,28 @@ using MethodOrderedSet = std::set<DexMethod*, dexmethods_comparator>;
 
 namespace method_dedup {
 
+/**
+ * Stable content hashes of the code of a set of methods, computed in
+ * parallel. Methods with identical code, as in group_identical_methods, have
+ * the same hash, so only methods with equal hashes need to be compared.
+ */
+class CodeHashIndex {
+ public:
+  explicit CodeHashIndex(const std::vector<DexMethod*>& methods);
+
+  /**
+   * The hash of the code of an indexed method.
+   */
+  size_t get(const DexMethod* method) const { return m_hashes.at(method); }
+
+  bool contains(const DexMethod* method) const {
+    return m_hashes.count(method);
+  }
+
+ private:
+  std::unordered_map<const DexMethod*, size_t> m_hashes;
+};
+
 /**
  * Group methods that are similar in that they share the same signature and of
  * the same size. It is useful for pre-sorting a method list before a custom
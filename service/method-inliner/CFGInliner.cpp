@@ -105,8 +105,10 @@ boost::optional<float> get_source_blocks_factor(
 void normalize_source_blocks(ControlFlowGraph& cfg, float factor, size_t idx) {
   for (auto* b : cfg.blocks()) {
     source_blocks::foreach_source_block(b, [&](auto* sb) {
-      if (sb->vals[idx]) {
-        sb->vals[idx]->val *= factor;
+      auto val = sb->vals[idx];
+      if (val) {
+        val->val *= factor;
+        sb->vals.set(idx, val);
       }
     });
   }
@@ -8,6 +8,7 @@
 #include "Inliner.h"
 
 #include <cstdint>
+#include <mutex>
 #include <utility>
 
 #include "ApiLevelChecker.h"
@@ -15,6 +16,7 @@
 #include "ConstantPropagationAnalysis.h"
 #include "ConstantPropagationWholeProgramState.h"
 #include "ConstructorAnalysis.h"
+#include "DexHasher.h"
 #include "DexInstruction.h"
 #include "EditableCfgAdapter.h"
 #include "GraphUtil.h"
@@ -29,6 +31,7 @@
 #include "OptData.h"
 #include "OutlinedMethods.h"
 #include "RecursionPruner.h"
+#include "RedexContext.h"
 #include "StlUtil.h"
 #include "Timer.h"
 #include "UnknownVirtuals.h"
@@ -79,6 +82,20 @@ void fix_static_invokes(DexMethod* m) {
 }
 } // namespace
 
+SharedInlinedCosts& SharedInlinedCosts::get() {
+  static std::mutex s_mutex;
+  static std::unique_ptr<SharedInlinedCosts> s_instance;
+  std::lock_guard<std::mutex> lock(s_mutex);
+  if (!s_instance) {
+    s_instance = std::make_unique<SharedInlinedCosts>();
+    g_redex->add_destruction_task([]() {
+      std::lock_guard<std::mutex> lock(s_mutex);
+      s_instance = nullptr;
+    });
+  }
+  return *s_instance;
+}
+
 MultiMethodInliner::MultiMethodInliner(
     const std::vector<DexClass*>& scope,
     DexStoresVector& stores,
@@ -125,6 +142,9 @@ MultiMethodInliner::MultiMethodInliner(
                  configured_pure_methods,
                  configured_finalish_field_names) {
   Timer t("MultiMethodInliner construction");
+  if (m_config.share_inlined_costs) {
+    m_shared_inlined_costs = &SharedInlinedCosts::get();
+  }
   for (const auto& callee_callers : true_virtual_callers) {
     auto callee = callee_callers.first;
     if (callee_callers.second.other_call_sites) {
@@ -263,13 +283,6 @@ void MultiMethodInliner::inline_methods(bool methods_need_deconstruct) {
   //   classes
   m_callee_insn_sizes =
       std::make_unique<ConcurrentMap<const DexMethod*, size_t>>();
-  m_callee_type_refs =
-      std::make_unique<ConcurrentMap<const DexMethod*,
-                                     std::shared_ptr<std::vector<DexType*>>>>();
-  if (m_ref_checkers) {
-    m_callee_code_refs = std::make_unique<
-        ConcurrentMap<const DexMethod*, std::shared_ptr<CodeRefs>>>();
-  }
   m_callee_caller_refs =
       std::make_unique<ConcurrentMap<const DexMethod*, CalleeCallerRefs>>();
 
@@ -337,10 +350,20 @@ void MultiMethodInliner::inline_methods(bool methods_need_deconstruct) {
     }
   }
 
+  // The scheduled methods populate their type and code refs once their code
+  // is final; give them slots in the lock-free caches.
+  m_callee_type_refs = std::make_unique<CalleeCache<std::vector<DexType*>>>(
+      methods_to_schedule.begin(), methods_to_schedule.end());
+  if (m_ref_checkers) {
+    m_callee_code_refs = std::make_unique<CalleeCache<CodeRefs>>(
+        methods_to_schedule.begin(), methods_to_schedule.end());
+  }
+
   info.critical_path_length =
       m_scheduler.run(methods_to_schedule.begin(), methods_to_schedule.end());
   delayed_change_visibilities();
   info.waited_seconds = m_scheduler.get_thread_pool().get_waited_seconds();
+  info.scheduler_utilization = m_scheduler.get_thread_pool().get_utilization();
 
   m_ab_experiment_context->flush();
   m_ab_experiment_context = nullptr;
@@ -1101,6 +1124,19 @@ bool MultiMethodInliner::should_inline_always(const DexMethod* callee) {
   return *res;
 }
 
+size_t MultiMethodInliner::get_callee_hash(const DexMethod* callee) {
+  const auto absent = std::numeric_limits<size_t>::max();
+  auto res = m_callee_hashes.get(callee, absent);
+  if (res != absent) {
+    return res;
+  }
+  auto hash = hashing::DexMethodHasher(callee).run();
+  res = hash.signature_hash;
+  boost::hash_combine(res, hash.code_hash);
+  m_callee_hashes.emplace(callee, res);
+  return res;
+}
+
 size_t MultiMethodInliner::get_callee_insn_size(const DexMethod* callee) {
   if (m_callee_insn_sizes) {
     const auto absent = std::numeric_limits<size_t>::max();
@@ -1372,9 +1408,21 @@ const InlinedCost* MultiMethodInliner::get_fully_inlined_cost(
   if (inlined_cost) {
     return inlined_cost.get();
   }
-  inlined_cost = std::make_shared<InlinedCost>(
-      get_inlined_cost(is_static(callee), callee->get_class(),
-                       callee->get_proto(), callee->get_code()));
+  SharedInlinedCosts::Key shared_key;
+  if (m_shared_inlined_costs) {
+    shared_key = {get_callee_hash(callee), ""};
+    inlined_cost = m_shared_inlined_costs->find(shared_key);
+  }
+  if (inlined_cost) {
+    info.shared_inlined_costs_reused++;
+  } else {
+    inlined_cost = std::make_shared<InlinedCost>(
+        get_inlined_cost(is_static(callee), callee->get_class(),
+                         callee->get_proto(), callee->get_code()));
+    if (m_shared_inlined_costs && !inlined_cost->reduced_cfg) {
+      m_shared_inlined_costs->insert(shared_key, inlined_cost);
+    }
+  }
   TRACE(INLINE, 4, "get_fully_inlined_cost(%s) = {%zu,%f,%f,%f,%s,%f,%d,%zu}",
         SHOW(callee), inlined_cost->full_code, inlined_cost->code,
         inlined_cost->method_refs, inlined_cost->other_refs,
@@ -1433,9 +1481,24 @@ const InlinedCost* MultiMethodInliner::get_call_site_inlined_cost(
     return inlined_cost.get();
   }
 
-  inlined_cost = std::make_shared<InlinedCost>(get_inlined_cost(
-      is_static(callee), callee->get_class(), callee->get_proto(),
-      callee->get_code(), call_site_summary));
+  SharedInlinedCosts::Key shared_key;
+  if (m_shared_inlined_costs) {
+    shared_key = {get_callee_hash(callee), call_site_summary->get_key()};
+    inlined_cost = m_shared_inlined_costs->find(shared_key);
+  }
+  if (inlined_cost) {
+    info.shared_inlined_costs_reused++;
+  } else {
+    inlined_cost = std::make_shared<InlinedCost>(get_inlined_cost(
+        is_static(callee), callee->get_class(), callee->get_proto(),
+        callee->get_code(), call_site_summary));
+    if (inlined_cost->insn_size >= fully_inlined_cost->insn_size) {
+      inlined_cost->reduced_cfg.reset();
+    }
+    if (m_shared_inlined_costs && !inlined_cost->reduced_cfg) {
+      m_shared_inlined_costs->insert(shared_key, inlined_cost);
+    }
+  }
   TRACE(INLINE, 4,
         "get_call_site_inlined_cost(%s) = {%zu,%f,%f,%f,%s,%f,%d,%zu}",
         call_site_summary->get_key().c_str(), inlined_cost->full_code,
@@ -1443,9 +1506,6 @@ const InlinedCost* MultiMethodInliner::get_call_site_inlined_cost(
         inlined_cost->no_return ? "no_return" : "return",
         inlined_cost->result_used, !!inlined_cost->reduced_cfg,
         inlined_cost->insn_size);
-  if (inlined_cost->insn_size >= fully_inlined_cost->insn_size) {
-    inlined_cost->reduced_cfg.reset();
-  }
   m_call_site_inlined_costs.update(key,
                                    [&](const CalleeCallSiteSummary&,
                                        std::shared_ptr<InlinedCost>& value,
@@ -1955,31 +2015,28 @@ bool MultiMethodInliner::check_android_os_version(IRInstruction* insn) {
   return false;
 }
 
-std::shared_ptr<CodeRefs> MultiMethodInliner::get_callee_code_refs(
+CalleeCache<CodeRefs>::Ref MultiMethodInliner::get_callee_code_refs(
     const DexMethod* callee) {
+  using Cache = CalleeCache<CodeRefs>;
+  auto compute = [callee]() { return std::make_unique<CodeRefs>(callee); };
   if (m_callee_code_refs) {
-    auto cached = m_callee_code_refs->get(callee, nullptr);
-    if (cached) {
-      return cached;
-    }
+    return Cache::Ref(&m_callee_code_refs->get(callee, compute));
   }
-
-  auto code_refs = std::make_shared<CodeRefs>(callee);
-  if (m_callee_code_refs) {
-    m_callee_code_refs->emplace(callee, code_refs);
-  }
-  return code_refs;
+  return Cache::Ref(compute());
 }
 
-std::shared_ptr<std::vector<DexType*>> MultiMethodInliner::get_callee_type_refs(
-    const DexMethod* callee) {
+CalleeCache<std::vector<DexType*>>::Ref
+MultiMethodInliner::get_callee_type_refs(const DexMethod* callee) {
+  using Cache = CalleeCache<std::vector<DexType*>>;
   if (m_callee_type_refs) {
-    auto cached = m_callee_type_refs->get(callee, nullptr);
-    if (cached) {
-      return cached;
-    }
+    return Cache::Ref(&m_callee_type_refs->get(
+        callee, [callee]() { return compute_callee_type_refs(callee); }));
   }
+  return Cache::Ref(compute_callee_type_refs(callee));
+}
 
+std::unique_ptr<std::vector<DexType*>>
+MultiMethodInliner::compute_callee_type_refs(const DexMethod* callee) {
   std::unordered_set<DexType*> type_refs_set;
   editable_cfg_adapter::iterate(
       callee->get_code(), [&](const MethodItemEntry& mie) {
@@ -2005,7 +2062,7 @@ std::shared_ptr<std::vector<DexType*>> MultiMethodInliner::get_callee_type_refs(
         return editable_cfg_adapter::LOOP_CONTINUE;
       });
 
-  auto type_refs = std::make_shared<std::vector<DexType*>>();
+  auto type_refs = std::make_unique<std::vector<DexType*>>();
   for (auto type : type_refs_set) {
     // filter out what xstores.illegal_ref(...) doesn't care about
     if (type_class_internal(type) == nullptr) {
@@ -2013,10 +2070,6 @@ std::shared_ptr<std::vector<DexType*>> MultiMethodInliner::get_callee_type_refs(
     }
     type_refs->push_back(type);
   }
-
-  if (m_callee_type_refs) {
-    m_callee_type_refs->emplace(callee, type_refs);
-  }
   return type_refs;
 }
 
@@ -2052,7 +2105,6 @@ bool MultiMethodInliner::problematic_refs(const DexMethod* caller,
                                           const DexMethod* callee) {
   always_assert(m_ref_checkers);
   auto callee_code_refs = get_callee_code_refs(callee);
-  always_assert(callee_code_refs);
   const auto& xstores = m_shrinker.get_xstores();
   size_t store_idx = xstores.get_store_idx(caller->get_class());
   auto& ref_checker = m_ref_checkers->at(store_idx);
@@ -2066,7 +2118,6 @@ bool MultiMethodInliner::problematic_refs(const DexMethod* caller,
 bool MultiMethodInliner::cross_store_reference(const DexMethod* caller,
                                                const DexMethod* callee) {
   auto callee_type_refs = get_callee_type_refs(callee);
-  always_assert(callee_type_refs);
   const auto& xstores = m_shrinker.get_xstores();
   size_t store_idx = xstores.get_store_idx(caller->get_class());
   for (auto type : *callee_type_refs) {
@@ -7,7 +7,12 @@
 
 #pragma once
 
+#include <atomic>
+#include <boost/functional/hash.hpp>
 #include <functional>
+#include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "ABExperimentContext.h"
@@ -112,6 +117,120 @@ struct InlinedCost {
   }
 };
 
+/**
+ * Inlined costs that outlive a MultiMethodInliner, so that the inliner passes
+ * don't all start from scratch. Entries are keyed by a hash of the callee's
+ * signature and code, and by the key of the call-site summary they were
+ * computed for, if any; hence later runs only reuse the entries of callees
+ * that haven't changed since. Costs that come with a reduced cfg are not
+ * shared, both to avoid keeping cfg copies alive and because such a cfg is
+ * only ever applied in the run that built it.
+ *
+ * There is one instance per RedexContext.
+ */
+class SharedInlinedCosts {
+ public:
+  using Key = std::pair<size_t, std::string>;
+
+  static SharedInlinedCosts& get();
+
+  std::shared_ptr<InlinedCost> find(const Key& key) const {
+    return m_costs.get(key, nullptr);
+  }
+
+  void insert(const Key& key, const std::shared_ptr<InlinedCost>& cost) {
+    always_assert(!cost->reduced_cfg);
+    m_costs.emplace(key, cost);
+  }
+
+  size_t size() const { return m_costs.size(); }
+
+ private:
+  ConcurrentMap<Key, std::shared_ptr<InlinedCost>, boost::hash<Key>> m_costs;
+};
+
+/**
+ * A read-mostly cache of values derived from the final code of callees. The
+ * methods given up front get slots in a flat array. Each slot is filled once,
+ * by whichever thread computes the value first, and published through an
+ * atomic pointer, so that lookups take no lock and touch no reference count.
+ * Other methods fall back to a concurrent map.
+ */
+template <typename T>
+class CalleeCache {
+ public:
+  /**
+   * A cached value, or a value computed without a cache that the handle owns.
+   */
+  class Ref {
+   public:
+    explicit Ref(const T* value) : m_value(value) {}
+    explicit Ref(std::unique_ptr<T> value)
+        : m_owned(std::move(value)), m_value(m_owned.get()) {}
+
+    const T& operator*() const { return *m_value; }
+    const T* operator->() const { return m_value; }
+
+   private:
+    std::unique_ptr<T> m_owned;
+    const T* m_value;
+  };
+
+  template <class InputIt>
+  CalleeCache(InputIt first, InputIt last) {
+    for (; first != last; ++first) {
+      m_slot_ids.emplace(*first, m_slot_ids.size());
+    }
+    m_slots.reset(new std::atomic<const T*>[m_slot_ids.size()]());
+  }
+
+  CalleeCache(const CalleeCache&) = delete;
+  CalleeCache& operator=(const CalleeCache&) = delete;
+
+  ~CalleeCache() {
+    for (size_t i = 0; i < m_slot_ids.size(); ++i) {
+      delete m_slots[i].load();
+    }
+  }
+
+  /**
+   * Returns the cached value, calling compute() for a std::unique_ptr<T> if
+   * there is none yet. Concurrent first lookups may both compute the value;
+   * only one is kept.
+   */
+  template <typename Fn>
+  const T& get(const DexMethod* method, const Fn& compute) {
+    auto it = m_slot_ids.find(method);
+    if (it == m_slot_ids.end()) {
+      const T* value;
+      m_others.update(method,
+                      [&](const DexMethod*, std::unique_ptr<T>& cached, bool) {
+                        if (!cached) {
+                          cached = compute();
+                        }
+                        value = cached.get();
+                      });
+      return *value;
+    }
+    auto& slot = m_slots[it->second];
+    const T* value = slot.load(std::memory_order_acquire);
+    if (value != nullptr) {
+      return *value;
+    }
+    auto computed = compute();
+    if (slot.compare_exchange_strong(value, computed.get(),
+                                     std::memory_order_acq_rel)) {
+      value = computed.release();
+    }
+    return *value;
+  }
+
+ private:
+  std::unordered_map<const DexMethod*, size_t> m_slot_ids;
+  std::unique_ptr<std::atomic<const T*>[]> m_slots;
+  ConcurrentMap<const DexMethod*, std::unique_ptr<T>> m_others;
+};
+
 /**
  * Helper class to inline a set of candidates.
  * Take a set of candidates and a scope and walk all instructions in scope
@@ -343,16 +462,25 @@ class MultiMethodInliner {
    */
   size_t get_callee_insn_size(const DexMethod* callee);
 
+  /**
+   * Hash of the signature and code of a callee, under which its inlined costs
+   * are shared with later inliner runs; computed once per run.
+   */
+  size_t get_callee_hash(const DexMethod* callee);
+
   /**
    * Gets the set of referenced types in a callee.
    */
-  std::shared_ptr<std::vector<DexType*>> get_callee_type_refs(
+  CalleeCache<std::vector<DexType*>>::Ref get_callee_type_refs(
       const DexMethod* callee);
 
   /**
    * Gets the set of references in a callee's code.
    */
-  std::shared_ptr<CodeRefs> get_callee_code_refs(const DexMethod* callee);
+  CalleeCache<CodeRefs>::Ref get_callee_code_refs(const DexMethod* callee);
+
+  static std::unique_ptr<std::vector<DexType*>> compute_callee_type_refs(
+      const DexMethod* callee);
 
   /**
    * Computes information about callers of a method.
@@ -513,6 +641,12 @@ class MultiMethodInliner {
                         boost::optional<const InlinedCost*>>
       m_invoke_call_site_inlined_costs;
 
+  // Inlined costs shared with other inliner runs, if enabled.
+  SharedInlinedCosts* m_shared_inlined_costs{nullptr};
+
+  // Cache for get_callee_hash function
+  ConcurrentMap<const DexMethod*, size_t> m_callee_hashes;
+
   // Priority thread pool to handle parallel processing of methods, either
   // shrinking initially / after inlining into them, or even to inline in
   // parallel. By default, parallelism is disabled num_threads = 0).
@@ -537,13 +671,10 @@ class MultiMethodInliner {
   std::unique_ptr<ConcurrentMap<const DexMethod*, size_t>> m_callee_insn_sizes;
 
   // Optional cache for get_callee_type_refs function
-  std::unique_ptr<
-      ConcurrentMap<const DexMethod*, std::shared_ptr<std::vector<DexType*>>>>
-      m_callee_type_refs;
+  std::unique_ptr<CalleeCache<std::vector<DexType*>>> m_callee_type_refs;
 
   // Optional cache for get_callee_code_refs function
-  std::unique_ptr<ConcurrentMap<const DexMethod*, std::shared_ptr<CodeRefs>>>
-      m_callee_code_refs;
+  std::unique_ptr<CalleeCache<CodeRefs>> m_callee_code_refs;
 
   // Optional cache for get_callee_caller_res function
   std::unique_ptr<ConcurrentMap<const DexMethod*, CalleeCallerRefs>>
@@ -565,6 +696,8 @@ class MultiMethodInliner {
     size_t max_call_stack_depth{0};
     size_t waited_seconds{0};
     int critical_path_length{0};
+    // Fraction of the scheduler's thread time spent running tasks.
+    double scheduler_utilization{0};
 
     // statistics that may be incremented concurrently
     std::atomic<size_t> calls_inlined{0};
@@ -594,6 +727,7 @@ class MultiMethodInliner {
     std::atomic<size_t> constant_invoke_callees_analyzed{0};
     std::atomic<size_t> constant_invoke_callees_unused_results{0};
     std::atomic<size_t> constant_invoke_callees_no_return{0};
+    std::atomic<size_t> shared_inlined_costs_reused{0};
     inliner::CallSiteSummaryStats call_site_summary_stats;
   };
   InliningInfo info;
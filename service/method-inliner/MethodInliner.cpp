@@ -655,6 +655,8 @@ void run_inliner(DexStoresVector& stores,
   TRACE(INLINE, 3, "max_call_stack_depth %ld",
         inliner.get_info().max_call_stack_depth);
   TRACE(INLINE, 3, "waited seconds %ld", inliner.get_info().waited_seconds);
+  TRACE(INLINE, 3, "scheduler utilization %.2f",
+        inliner.get_info().scheduler_utilization);
   TRACE(INLINE, 3, "blocklisted meths %ld",
         (size_t)inliner.get_info().blocklisted);
   TRACE(INLINE, 3, "virtualizing methods %ld",
@@ -733,6 +735,11 @@ void run_inliner(DexStoresVector& stores,
                   inliner.get_info().constant_invoke_callees_unused_results);
   mgr.incr_metric("critical_path_length",
                   inliner.get_info().critical_path_length);
+  mgr.incr_metric("shared_inlined_costs_reused",
+                  inliner.get_info().shared_inlined_costs_reused);
+  mgr.incr_metric(
+      "scheduler_utilization_percent",
+      static_cast<int64_t>(inliner.get_info().scheduler_utilization * 100));
   mgr.incr_metric("methods_shrunk", shrinker.get_methods_shrunk());
   mgr.incr_metric("callers", inliner.get_callers());
   if (intra_dex) {
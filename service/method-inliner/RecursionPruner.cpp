@@ -7,6 +7,9 @@
 
 #include "RecursionPruner.h"
 
+#include <algorithm>
+#include <limits>
+
 namespace inliner {
 
 RecursionPruner::RecursionPruner(
@@ -17,81 +20,123 @@ RecursionPruner::RecursionPruner(
       m_caller_callee(caller_callee),
       m_exclude_fn(exclude_fn) {}
 
+namespace {
+
+// Not visited yet. Nodes being visited have the depth max().
+constexpr size_t NOT_VISITED = std::numeric_limits<size_t>::max() - 1;
+
+} // namespace
+
 void RecursionPruner::run() {
   Timer t("compute_caller_nonrecursive_callees_by_stack_depth");
+  build_graph();
   // we want to inline bottom up, so as a first step, for all callers, we
   // recurse into all inlinable callees until we hit a leaf and we start
   // inlining from there. First, we just gather data on
   // caller/non-recursive-callees pairs for each stack depth.
-  std::unordered_map<DexMethod*, size_t> visited;
-  std::vector<DexMethod*> ordered_callers;
-  ordered_callers.reserve(m_caller_callee.size());
+  for (NodeId caller = 0; caller < m_remaining_callees.size(); ++caller) {
+    TraceContext context(m_methods[caller]);
+    auto stack_depth = recurse(caller);
+    m_max_call_stack_depth = std::max(m_max_call_stack_depth, stack_depth);
+  }
+}
+
+void RecursionPruner::build_graph() {
+  m_methods.reserve(m_caller_callee.size());
   for (auto& p : m_caller_callee) {
-    ordered_callers.push_back(const_cast<DexMethod*>(p.first));
+    m_methods.push_back(const_cast<DexMethod*>(p.first));
   }
-  std::sort(ordered_callers.begin(), ordered_callers.end(), compare_dexmethods);
-  for (const auto caller : ordered_callers) {
-    TraceContext context(caller);
-    auto stack_depth = recurse(caller, &visited);
-    m_max_call_stack_depth = std::max(m_max_call_stack_depth, stack_depth);
+  std::sort(m_methods.begin(), m_methods.end(), compare_dexmethods);
+  std::unordered_map<const DexMethod*, NodeId> ids;
+  ids.reserve(m_methods.size());
+  for (auto method : m_methods) {
+    ids.emplace(method, ids.size());
+  }
+  auto num_callers = m_methods.size();
+
+  m_callee_offsets.reserve(num_callers + 1);
+  m_callee_offsets.push_back(0);
+  m_remaining_callees.reserve(num_callers);
+  std::vector<std::pair<DexMethod*, size_t>> ordered_callees;
+  for (size_t i = 0; i < num_callers; ++i) {
+    const auto& callees = m_caller_callee.at(m_methods[i]);
+    always_assert(!callees.empty());
+    ordered_callees.assign(callees.begin(), callees.end());
+    std::sort(ordered_callees.begin(), ordered_callees.end(),
+              [](const auto& a, const auto& b) {
+                return compare_dexmethods(a.first, b.first);
+              });
+    for (auto& p : ordered_callees) {
+      auto emplaced = ids.emplace(p.first, ids.size());
+      if (emplaced.second) {
+        m_methods.push_back(p.first);
+      }
+      m_callees.push_back(emplaced.first->second);
+      m_call_sites.push_back(p.second);
+    }
+    m_callee_offsets.push_back(m_callees.size());
+    m_remaining_callees.push_back(ordered_callees.size());
   }
+  m_stack_depths.assign(num_callers, NOT_VISITED);
 }
 
-size_t RecursionPruner::recurse(
-    DexMethod* caller, std::unordered_map<DexMethod*, size_t>* visited) {
-  auto caller_it = m_caller_callee.find(caller);
-  if (caller_it == m_caller_callee.end()) {
+size_t RecursionPruner::recurse(NodeId caller) {
+  // Methods that are only callees, and callers all of whose callees have been
+  // pruned, have nothing to inline.
+  if (caller >= m_remaining_callees.size() ||
+      m_remaining_callees[caller] == 0) {
     return 0;
   }
-  auto& callees = caller_it->second;
-  always_assert(!callees.empty());
 
-  auto visited_it = visited->find(caller);
-  if (visited_it != visited->end()) {
-    return visited_it->second;
+  if (m_stack_depths[caller] != NOT_VISITED) {
+    return m_stack_depths[caller];
   }
 
   // We'll only know the exact call stack depth at the end.
-  visited->emplace(caller, std::numeric_limits<size_t>::max());
+  m_stack_depths[caller] = std::numeric_limits<size_t>::max();
 
-  std::vector<DexMethod*> ordered_callees;
-  ordered_callees.reserve(callees.size());
-  for (auto& p : callees) {
-    ordered_callees.push_back(p.first);
-  }
-  std::sort(ordered_callees.begin(), ordered_callees.end(), compare_dexmethods);
   size_t stack_depth = 0;
   // recurse into the callees in case they have something to inline on
   // their own. We want to inline bottom up so that a callee is
   // completely resolved by the time it is inlined.
-  for (auto callee : ordered_callees) {
-    size_t callee_stack_depth = recurse(callee, visited);
+  for (auto e = m_callee_offsets[caller]; e < m_callee_offsets[caller + 1];
+       ++e) {
+    auto callee = m_callees[e];
+    size_t callee_stack_depth = recurse(callee);
     if (callee_stack_depth == std::numeric_limits<size_t>::max()) {
       // we've found recursion in the current call stack
-      m_recursive_call_sites += callees.at(callee);
-      m_recursive_callees.insert(callee);
+      m_recursive_call_sites += m_call_sites[e];
+      m_recursive_callees.insert(m_methods[callee]);
     } else {
       stack_depth = std::max(stack_depth, callee_stack_depth + 1);
-      if (!m_exclude_fn(caller, callee)) {
+      if (!m_exclude_fn(m_methods[caller], m_methods[callee])) {
         continue;
       }
-      m_excluded_callees.insert(callee);
+      m_excluded_callees.insert(m_methods[callee]);
     }
 
     // If we get here, we shall prune the (caller, callee) pair.
-    callees.erase(callee);
-    if (callees.empty()) {
-      m_caller_callee.erase(caller);
-    }
-    auto& callers = m_callee_caller.at(callee);
-    callers.erase(caller);
-    if (callers.empty()) {
-      m_callee_caller.erase(callee);
-    }
+    prune(caller, callee);
   }
 
-  (*visited)[caller] = stack_depth;
+  m_stack_depths[caller] = stack_depth;
   return stack_depth;
 }
 
+void RecursionPruner::prune(NodeId caller, NodeId callee) {
+  auto caller_method = m_methods[caller];
+  auto callee_method = m_methods[callee];
+  --m_remaining_callees[caller];
+  auto& callees = m_caller_callee.at(caller_method);
+  callees.erase(callee_method);
+  if (callees.empty()) {
+    m_caller_callee.erase(caller_method);
+  }
+  auto& callers = m_callee_caller.at(callee_method);
+  callers.erase(caller_method);
+  if (callers.empty()) {
+    m_callee_caller.erase(callee_method);
+  }
+}
+
 } // namespace inliner
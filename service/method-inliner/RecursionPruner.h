@@ -11,8 +11,20 @@
 
 namespace inliner {
 
+/*
+ * Finds recursive call sites, and call sites excluded by exclude_fn, in a
+ * bottom-up traversal of the callers, and removes them from the callee-caller
+ * maps.
+ *
+ * The traversal doesn't walk the maps. It first numbers the methods densely
+ * and lays out the callees of each caller, sorted, as contiguous ranges of
+ * one array (compressed sparse row form), so that the depth-first search only
+ * indexes vectors.
+ */
 class RecursionPruner {
  private:
+  using NodeId = uint32_t;
+
   MethodToMethodOccurrences& m_callee_caller;
   MethodToMethodOccurrences& m_caller_callee;
   size_t m_recursive_call_sites{0};
@@ -21,6 +33,18 @@ class RecursionPruner {
   std::unordered_set<const DexMethod*> m_excluded_callees;
   std::function<bool(DexMethod*, DexMethod*)> m_exclude_fn;
 
+  // All callers come first, in compare_dexmethods order, then the methods
+  // that are only callees.
+  std::vector<DexMethod*> m_methods;
+  // The callees of caller n are the edges in
+  // [m_callee_offsets[n], m_callee_offsets[n + 1]).
+  std::vector<uint32_t> m_callee_offsets;
+  std::vector<NodeId> m_callees;
+  std::vector<size_t> m_call_sites;
+  // The number of callees left to each caller after pruning.
+  std::vector<uint32_t> m_remaining_callees;
+  std::vector<size_t> m_stack_depths;
+
  public:
   RecursionPruner(MethodToMethodOccurrences& callee_caller,
                   MethodToMethodOccurrences& caller_callee,
@@ -40,8 +64,11 @@ class RecursionPruner {
   }
 
  private:
-  size_t recurse(DexMethod* caller,
-                 std::unordered_map<DexMethod*, size_t>* visited);
+  void build_graph();
+
+  size_t recurse(NodeId caller);
+
+  void prune(NodeId caller, NodeId callee);
 };
 
 } // namespace inliner
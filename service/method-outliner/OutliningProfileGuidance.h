@@ -33,6 +33,9 @@ struct ProfileGuidanceConfig {
   float method_profiles_warm_call_count{1};
   PerfSensitivity perf_sensitivity{PerfSensitivity::kAlwaysHot};
   float block_profiles_hits{-1};
+  // When non-negative, blocks whose source blocks were hit more often than
+  // this are never outlined from, whatever the method profiles say.
+  float block_profiles_hot_hits{-1};
 };
 
 } // namespace outliner
@@ -112,9 +112,44 @@ CanOutlineBlockDecider::CanOutlineBlockDecider(
       m_sufficiently_warm(sufficiently_warm),
       m_sufficiently_hot(sufficiently_hot) {}
 
+boost::optional<float> CanOutlineBlockDecider::get_max_val(
+    cfg::Block* block) const {
+  // Make sure m_max_vals is initialized
+  if (!m_max_vals) {
+    m_max_vals.reset(new LazyUnorderedMap<cfg::Block*, boost::optional<float>>(
+        [](cfg::Block* block) -> boost::optional<float> {
+          auto* sb = source_blocks::get_first_source_block(block);
+          if (sb == nullptr) {
+            return boost::none;
+          }
+          boost::optional<float> max_val;
+          sb->foreach_val([&](const auto& val_pair) {
+            if (!val_pair) {
+              return;
+            }
+            if (!max_val || (val_pair && val_pair->val > *max_val)) {
+              max_val = val_pair->val;
+            }
+          });
+          return max_val;
+        }));
+  }
+  return (*m_max_vals)[block];
+}
+
 CanOutlineBlockDecider::Result
 CanOutlineBlockDecider::can_outline_from_big_block(
     const big_blocks::BigBlock& big_block) const {
+  // Block profiles can rule out hot blocks even in methods that the method
+  // profiles deem cold.
+  if (m_config.block_profiles_hot_hits >= 0) {
+    for (auto block : big_block.get_blocks()) {
+      auto val = get_max_val(block);
+      if (val && *val > m_config.block_profiles_hot_hits) {
+        return Result::BlockExceedsThresholds;
+      }
+    }
+  }
   if (!m_sufficiently_hot && !m_sufficiently_warm) {
     return Result::CanOutline;
   }
@@ -154,31 +189,11 @@ CanOutlineBlockDecider::can_outline_from_big_block(
   if (m_config.block_profiles_hits < 0) {
     return m_sufficiently_hot ? Result::Hot : Result::WarmLoop;
   }
-  // Make sure m_max_vals is initialized
-  if (!m_max_vals) {
-    m_max_vals.reset(new LazyUnorderedMap<cfg::Block*, boost::optional<float>>(
-        [](cfg::Block* block) -> boost::optional<float> {
-          auto* sb = source_blocks::get_first_source_block(block);
-          if (sb == nullptr) {
-            return boost::none;
-          }
-          boost::optional<float> max_val;
-          sb->foreach_val([&](const auto& val_pair) {
-            if (!val_pair) {
-              return;
-            }
-            if (!max_val || (val_pair && val_pair->val > *max_val)) {
-              max_val = val_pair->val;
-            }
-          });
-          return max_val;
-        }));
-  }
   // Via m_max_vals, we consider the maximum hit number for each block.
   // Across all blocks, we are gathering the *minimum* of those hit numbers.
   boost::optional<float> min_val;
   for (auto block : big_block.get_blocks()) {
-    auto val = (*m_max_vals)[block];
+    auto val = get_max_val(block);
     if (!min_val || (val && *val < *min_val)) {
       min_val = val;
       if (min_val && *min_val == 0) {
@@ -198,7 +213,7 @@ CanOutlineBlockDecider::can_outline_from_big_block(
     }
     do {
       block = m_dominators->get_idom(block);
-      auto val = (*m_max_vals)[block];
+      auto val = get_max_val(block);
       if (!min_val || (val && *val < *min_val)) {
         min_val = val;
         if (min_val && *min_val == 0) {
@@ -58,6 +58,10 @@ class CanOutlineBlockDecider {
   mutable std::unique_ptr<dominators::SimpleFastDominators<cfg::GraphInterface>>
       m_dominators;
 
+  // The maximum hit number of the first source block of the given block
+  // across all interactions, if any.
+  boost::optional<float> get_max_val(cfg::Block* block) const;
+
  public:
   CanOutlineBlockDecider(const outliner::ProfileGuidanceConfig& config,
                          bool sufficiently_warm,
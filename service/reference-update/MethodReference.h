@@ -61,6 +61,15 @@ IRInstruction* make_invoke(DexMethod* callee,
  */
 void patch_callsite(const CallSite& callsite, const NewCallee& new_callee);
 
+/**
+ * If insn calls, once resolved, one of the old callees, make it call the new
+ * callee instead. Return true if insn is updated.
+ */
+bool patch_call_ref_simple(
+    DexMethod* caller,
+    IRInstruction* insn,
+    const std::unordered_map<DexMethod*, DexMethod*>& old_to_new_callee);
+
 void update_call_refs_simple(
     const Scope& scope,
     const std::unordered_map<DexMethod*, DexMethod*>& old_to_new_callee);
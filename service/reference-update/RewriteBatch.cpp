@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "RewriteBatch.h"
+
+#include "ConcurrentContainers.h"
+#include "Debug.h"
+#include "IRCode.h"
+#include "MethodReference.h"
+#include "Show.h"
+#include "Trace.h"
+#include "TypeReference.h"
+#include "Walkers.h"
+
+namespace {
+
+/**
+ * Compose the new mapping after the existing one: existing values that are
+ * remapped follow the new mapping, and the new keys are added.
+ */
+template <typename T>
+void compose(std::unordered_map<T*, T*>& existing,
+             const std::unordered_map<T*, T*>& added) {
+  for (auto& pair : existing) {
+    auto it = added.find(pair.second);
+    if (it != added.end()) {
+      pair.second = it->second;
+    }
+  }
+  for (const auto& pair : added) {
+    auto it = existing.find(pair.first);
+    if (it == existing.end()) {
+      existing.emplace(pair.first, pair.second);
+      continue;
+    }
+    always_assert_log(it->second == pair.second,
+                      "%s is already mapped to %s\n",
+                      SHOW(pair.first),
+                      SHOW(it->second));
+  }
+}
+
+} // namespace
+
+namespace reference_update {
+
+void RewriteBatch::add_types(
+    const std::unordered_map<DexType*, DexType*>& old_to_new) {
+  compose(m_types, old_to_new);
+}
+
+void RewriteBatch::add_callees(
+    const std::unordered_map<DexMethod*, DexMethod*>& old_to_new_callee) {
+  compose(m_callees, old_to_new_callee);
+}
+
+void RewriteBatch::add_fields(
+    const std::unordered_map<DexFieldRef*, DexFieldRef*>& old_to_new) {
+  compose(m_fields, old_to_new);
+}
+
+void RewriteBatch::apply(const Scope& scope) {
+  if (empty()) {
+    return;
+  }
+  bool update_types = !m_types.empty();
+  // The refs of the code, after the callees and fields are updated, which the
+  // TypeRefUpdater would otherwise collect with a walk of its own.
+  ConcurrentSet<DexMethodRef*> method_refs;
+  ConcurrentSet<DexFieldRef*> field_refs;
+  walk::parallel::code(scope, [&](DexMethod* method, IRCode& code) {
+    for (auto& mie : InstructionIterable(code)) {
+      auto insn = mie.insn;
+      if (insn->has_method()) {
+        if (!m_callees.empty()) {
+          method_reference::patch_call_ref_simple(method, insn, m_callees);
+        }
+        if (update_types) {
+          method_refs.insert(insn->get_method());
+        }
+      } else if (insn->has_field()) {
+        auto it = m_fields.find(insn->get_field());
+        if (it != m_fields.end()) {
+          TRACE(REFU,
+                9,
+                " Updated field %s to %s",
+                SHOW(insn),
+                SHOW(it->second));
+          insn->set_field(it->second);
+        }
+        if (update_types) {
+          field_refs.insert(insn->get_field());
+        }
+      }
+    }
+  });
+  if (update_types) {
+    type_reference::TypeRefUpdater updater(m_types);
+    updater.update_methods_fields(scope, method_refs, field_refs);
+  }
+  m_types.clear();
+  m_callees.clear();
+  m_fields.clear();
+}
+
+} // namespace reference_update
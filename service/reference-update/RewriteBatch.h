@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <unordered_map>
+
+#include "DexClass.h"
+
+namespace reference_update {
+
+/**
+ * Accumulates the type, callee and field mappings of several transformations,
+ * and applies them all at once, with a single walk of all the code, instead of
+ * one walk for each type_reference::TypeRefUpdater or
+ * method_reference::update_call_refs_simple.
+ *
+ * Mappings added later apply after the ones added before: if A is mapped to B,
+ * and then B to C, A ends up mapped to C.
+ *
+ * - Types are updated in the specs of all the methods and fields in the scope
+ *   and of the refs in the code, like TypeRefUpdater does. Opcodes are not
+ *   updated.
+ * - Callees are updated at the callsites whose callee resolves to an old
+ *   callee, like update_call_refs_simple does.
+ * - Field refs are updated where the code references the old field ref
+ *   itself.
+ */
+class RewriteBatch final {
+ public:
+  void add_types(const std::unordered_map<DexType*, DexType*>& old_to_new);
+
+  void add_callees(
+      const std::unordered_map<DexMethod*, DexMethod*>& old_to_new_callee);
+
+  void add_fields(
+      const std::unordered_map<DexFieldRef*, DexFieldRef*>& old_to_new);
+
+  bool empty() const {
+    return m_types.empty() && m_callees.empty() && m_fields.empty();
+  }
+
+  /**
+   * Apply all the mappings added so far to the scope, and clear them.
+   */
+  void apply(const Scope& scope);
+
+ private:
+  std::unordered_map<DexType*, DexType*> m_types;
+  std::unordered_map<DexMethod*, DexMethod*> m_callees;
+  std::unordered_map<DexFieldRef*, DexFieldRef*> m_fields;
+};
+
+} // namespace reference_update
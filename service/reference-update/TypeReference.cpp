@@ -12,9 +12,31 @@
 #include "Show.h"
 #include "Trace.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 namespace {
 
+/**
+ * Run fn over the code of the given methods, or of the whole scope.
+ */
+template <typename Fn>
+void walk_code(const Scope& scope,
+               const std::vector<DexMethod*>* methods,
+               const Fn& fn) {
+  if (methods == nullptr) {
+    walk::parallel::code(scope, fn);
+    return;
+  }
+  workqueue_run<DexMethod*>(
+      [&fn](DexMethod* method) {
+        auto code = method->get_code();
+        if (code != nullptr) {
+          fn(method, *code);
+        }
+      },
+      *methods);
+}
+
 void fix_colliding_dmethods(
     const Scope& scope,
     const std::vector<std::pair<DexMethod*, DexProto*>>& colliding_methods) {
@@ -284,6 +306,25 @@ void update_vmethods_group_one_type_ref(const VMethodGroup& group,
 namespace type_reference {
 
 void TypeRefUpdater::update_methods_fields(const Scope& scope) {
+  ConcurrentSet<DexMethodRef*> methods;
+  ConcurrentSet<DexFieldRef*> fields;
+  walk::parallel::code(scope, [&](DexMethod* method, IRCode& code) {
+    for (auto& mie : InstructionIterable(code)) {
+      auto insn = mie.insn;
+      if (insn->has_field()) {
+        fields.insert(insn->get_field());
+      } else if (insn->has_method()) {
+        methods.insert(insn->get_method());
+      }
+    }
+  });
+  update_methods_fields(scope, methods, fields);
+}
+
+void TypeRefUpdater::update_methods_fields(
+    const Scope& scope,
+    const ConcurrentSet<DexMethodRef*>& method_refs,
+    const ConcurrentSet<DexFieldRef*>& field_refs) {
   // Change specs of all the other methods and fields if their specs contain
   // any candidate types.
   walk::parallel::methods(scope, [this](DexMethod* method) {
@@ -299,22 +340,10 @@ void TypeRefUpdater::update_methods_fields(const Scope& scope) {
     }
   });
   // Update all the method refs and field refs.
-  ConcurrentSet<DexMethodRef*> methods;
-  ConcurrentSet<DexFieldRef*> fields;
-  walk::parallel::code(scope, [&](DexMethod* method, IRCode& code) {
-    for (auto& mie : InstructionIterable(code)) {
-      auto insn = mie.insn;
-      if (insn->has_field()) {
-        fields.insert(insn->get_field());
-      } else if (insn->has_method()) {
-        methods.insert(insn->get_method());
-      }
-    }
-  });
   workqueue_run<DexFieldRef*>([this](DexFieldRef* field) { mangling(field); },
-                              fields);
+                              field_refs);
   workqueue_run<DexMethodRef*>(
-      [this](DexMethodRef* method) { mangling(method); }, methods);
+      [this](DexMethodRef* method) { mangling(method); }, method_refs);
 
   std::map<DexMethod*, DexProto*, dexmethods_comparator> inits(m_inits.begin(),
                                                                m_inits.end());
@@ -473,6 +502,45 @@ bool proto_has_reference_to(const DexProto* proto,
   return false;
 }
 
+std::vector<DexMethod*> get_methods_referencing(
+    const Scope& scope, const UnorderedTypeSet& types) {
+  auto refers = [&types](const DexType* type) {
+    return types.count(type::get_element_type_if_array(type)) > 0;
+  };
+  ConcurrentSet<DexMethod*> referencing;
+  walk::parallel::code(scope, [&](DexMethod* method, IRCode& code) {
+    for (const auto& mie : InstructionIterable(code)) {
+      auto insn = mie.insn;
+      bool found = false;
+      if (insn->has_type()) {
+        found = refers(insn->get_type());
+      } else if (insn->has_method()) {
+        auto method_ref = insn->get_method();
+        found = refers(method_ref->get_class()) ||
+                proto_has_reference_to(method_ref->get_proto(), types);
+      } else if (insn->has_field()) {
+        auto field_ref = insn->get_field();
+        found = refers(field_ref->get_class()) ||
+                refers(field_ref->get_type());
+        if (!found && !field_ref->is_def()) {
+          auto field = resolve_field(field_ref,
+                                     opcode::is_an_ifield_op(insn->opcode())
+                                         ? FieldSearch::Instance
+                                         : FieldSearch::Static);
+          found = field != nullptr && refers(field->get_class());
+        }
+      }
+      if (found) {
+        referencing.insert(method);
+        return;
+      }
+    }
+  });
+  std::vector<DexMethod*> methods(referencing.begin(), referencing.end());
+  std::sort(methods.begin(), methods.end(), compare_dexmethods);
+  return methods;
+}
+
 DexProto* get_new_proto(
     const DexProto* proto,
     const std::unordered_map<const DexType*, DexType*>& old_to_new) {
@@ -546,7 +614,8 @@ void update_method_signature_type_references(
     const std::unordered_map<const DexType*, DexType*>& old_to_new,
     const ClassHierarchy& ch,
     boost::optional<std::unordered_map<DexMethod*, std::string>&>
-        method_debug_map) {
+        method_debug_map,
+    const std::vector<DexMethod*>* referencing_methods) {
   // Virtual methods.
   // The key is the hash of signature and an old type reference. Group the
   // methods by key.
@@ -608,7 +677,7 @@ void update_method_signature_type_references(
   }
 
   // Ensure that no method references left that still refer old types.
-  walk::parallel::code(scope, [&old_types](DexMethod*, IRCode& code) {
+  walk_code(scope, referencing_methods, [&old_types](DexMethod*, IRCode& code) {
     for (auto& mie : InstructionIterable(code)) {
       auto insn = mie.insn;
       if (insn->has_method()) {
@@ -625,7 +694,8 @@ void update_method_signature_type_references(
 
 void update_field_type_references(
     const Scope& scope,
-    const std::unordered_map<const DexType*, DexType*>& old_to_new) {
+    const std::unordered_map<const DexType*, DexType*>& old_to_new,
+    const std::vector<DexMethod*>* referencing_methods) {
   TRACE(REFU, 4, " updating field refs");
   const auto update_field = [&](DexFieldRef* field) {
     const auto ref_type = field->get_type();
@@ -643,7 +713,7 @@ void update_field_type_references(
   };
   walk::parallel::fields(scope, update_field);
 
-  walk::parallel::code(scope, [&old_to_new](DexMethod*, IRCode& code) {
+  auto check_code = [&old_to_new](DexMethod*, IRCode& code) {
     for (auto& mie : InstructionIterable(code)) {
       auto insn = mie.insn;
       if (insn->has_field()) {
@@ -656,7 +726,8 @@ void update_field_type_references(
             SHOW(insn));
       }
     }
-  });
+  };
+  walk_code(scope, referencing_methods, check_code);
 }
 
 } // namespace type_reference
@@ -45,6 +45,14 @@ class TypeRefUpdater final {
 
   void update_methods_fields(const Scope& scope);
 
+  /**
+   * Same as above, but with the method refs and field refs of the code in the
+   * scope already collected by the caller, which saves a walk of all the code.
+   */
+  void update_methods_fields(const Scope& scope,
+                             const ConcurrentSet<DexMethodRef*>& method_refs,
+                             const ConcurrentSet<DexFieldRef*>& field_refs);
+
  private:
   /**
    * Try to convert "type" to a new type. Return nullptr if it's not found in
@@ -82,6 +90,16 @@ std::string get_method_signature(const DexMethod* method);
 bool proto_has_reference_to(const DexProto* proto,
                             const UnorderedTypeSet& targets);
 
+/**
+ * Find, in one parallel walk, the methods whose code references any of the
+ * types, arrays of the types included: as the type of an instruction, or in the
+ * class or proto of a method ref, or in the class, resolved class or type of a
+ * field ref. Passes that update or check the references to the types only need
+ * to visit the code of these methods, which are sorted.
+ */
+std::vector<DexMethod*> get_methods_referencing(const Scope& scope,
+                                                const UnorderedTypeSet& types);
+
 /**
  * Get a new proto by updating the type references on the proto from an old type
  * to the provided new type.
@@ -117,10 +135,17 @@ void update_method_signature_type_references(
     const std::unordered_map<const DexType*, DexType*>& old_to_new,
     const ClassHierarchy& ch,
     boost::optional<std::unordered_map<DexMethod*, std::string>&>
-        method_debug_map = boost::none);
+        method_debug_map = boost::none,
+    const std::vector<DexMethod*>* referencing_methods = nullptr);
 
+/**
+ * Both updates then check that no code refers to an old type anymore. Given
+ * the get_methods_referencing() of the old types, only the code of those
+ * methods is checked.
+ */
 void update_field_type_references(
     const Scope& scope,
-    const std::unordered_map<const DexType*, DexType*>& old_to_new);
+    const std::unordered_map<const DexType*, DexType*>& old_to_new,
+    const std::vector<DexMethod*>* referencing_methods = nullptr);
 
 } // namespace type_reference
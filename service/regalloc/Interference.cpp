@@ -89,10 +89,62 @@ void Graph::add_edge(reg_t u, reg_t v, bool can_coalesce) {
   //
   // then the final state of the edge between s0 and s1 must be
   // non-coalesceable.
+  if (m_dense_regs != 0) {
+    set_edge_bits(u, v, can_coalesce);
+    return;
+  }
   m_adj_matrix[build_edge(u, v)] =
       m_adj_matrix[build_edge(u, v)] || !can_coalesce;
 }
 
+void Graph::set_edge_bits(reg_t u, reg_t v, bool can_coalesce) {
+  if (u == v) {
+    return;
+  }
+  set_bit(m_adjacent_bits, bit_index(u, v));
+  set_bit(m_adjacent_bits, bit_index(v, u));
+  if (!can_coalesce) {
+    set_bit(m_interfering_bits, bit_index(u, v));
+    set_bit(m_interfering_bits, bit_index(v, u));
+  }
+}
+
+void Graph::materialize_adjacency() {
+  for (auto& pair : m_nodes) {
+    auto u = pair.first;
+    auto& u_node = pair.second;
+    always_assert(u_node.m_adjacent.empty());
+    // Rows don't start on word boundaries, so the first and last words are
+    // masked.
+    size_t begin = bit_index(u, 0);
+    size_t end = begin + m_dense_regs;
+    for (size_t w = begin / 64; w * 64 < end; ++w) {
+      uint64_t word = m_adjacent_bits[w];
+      if (w * 64 < begin) {
+        word &= ~uint64_t(0) << (begin % 64);
+      }
+      if ((w + 1) * 64 > end) {
+        word &= ~uint64_t(0) >> (64 - end % 64);
+      }
+      while (word != 0) {
+        auto v = static_cast<reg_t>(w * 64 + __builtin_ctzll(word) - begin);
+        word &= word - 1;
+        u_node.m_adjacent.push_back(v);
+        u_node.m_weight += edge_weight(u_node, m_nodes.at(v));
+      }
+    }
+  }
+}
+
+void Graph::use_dense_edges(reg_t regs) {
+  always_assert(m_adj_matrix.empty() && m_containment_graph.empty());
+  m_dense_regs = regs;
+  size_t words = (static_cast<size_t>(regs) * regs + 63) / 64;
+  m_adjacent_bits.assign(words, 0);
+  m_interfering_bits.assign(words, 0);
+  m_containment_bits.assign(words, 0);
+}
+
 uint32_t Node::colorable_limit() const {
   return div_ceil(max_vreg() + 1, 2 * width() - 1);
 }
@@ -276,6 +328,25 @@ Graph GraphBuilder::build(const LivenessFixpointIterator& fixpoint_iter,
   for (auto it = ii.begin(); it != ii.end(); ++it) {
     GraphBuilder::update_node_constraints(it.unwrap(), range_set, &graph);
   }
+  // Every register that an edge can connect has a node by now.
+  reg_t regs = 0;
+  for (const auto& pair : graph.nodes()) {
+    regs = std::max(regs, static_cast<reg_t>(pair.first + 1));
+  }
+  if (regs > 0 && regs <= Graph::MAX_DENSE_REGS) {
+    graph.use_dense_edges(regs);
+  }
+  // With bit matrices, the edges are only recorded as bits while walking the
+  // code. The adjacency lists and weights follow from the matrix at the end,
+  // which spares a lookup per edge and per live register.
+  bool dense = graph.m_dense_regs != 0;
+  auto add_edge = [&graph, dense](reg_t u, reg_t v, bool can_coalesce) {
+    if (dense) {
+      graph.set_edge_bits(u, v, can_coalesce);
+    } else {
+      graph.add_edge(u, v, can_coalesce);
+    }
+  };
 
   auto& cfg = code->cfg();
   for (cfg::Block* block : cfg.blocks()) {
@@ -294,7 +365,7 @@ Graph GraphBuilder::build(const LivenessFixpointIterator& fixpoint_iter,
           if (opcode::is_a_move(op) && reg == insn->src(0)) {
             continue;
           }
-          graph.add_edge(insn->dest(), reg);
+          add_edge(insn->dest(), reg, /* can_coalesce */ false);
         }
         // We add interference edges between the dest and wide src operands of
         // an instruction even if the srcs are not live-out. This avoids
@@ -308,14 +379,14 @@ Graph GraphBuilder::build(const LivenessFixpointIterator& fixpoint_iter,
         // coloring respects.
         for (size_t i = 0; i < insn->srcs_size(); ++i) {
           if (insn->src_is_wide(i)) {
-            graph.add_coalesceable_edge(insn->dest(), insn->src(i));
+            add_edge(insn->dest(), insn->src(i), /* can_coalesce */ true);
           }
         }
       }
       if (op == OPCODE_CHECK_CAST) {
         auto move_result_pseudo = std::prev(it)->insn;
         for (auto reg : live_out.elements()) {
-          graph.add_edge(move_result_pseudo->dest(), reg);
+          add_edge(move_result_pseudo->dest(), reg, /* can_coalesce */ false);
         }
       }
       // adding containment edge between liverange defined in insn and elements
@@ -335,6 +406,9 @@ Graph GraphBuilder::build(const LivenessFixpointIterator& fixpoint_iter,
       }
     }
   }
+  if (dense) {
+    graph.materialize_adjacency();
+  }
   for (auto& pair : graph.nodes()) {
     auto reg = pair.first;
     auto& node = pair.second;
@@ -365,6 +439,13 @@ std::ostream& Graph::write_dot_format(std::ostream& o) const {
   o << "}\n";
 
   o << "containment graph {\n";
+  for (reg_t u = 0; u < m_dense_regs; ++u) {
+    for (reg_t v = 0; v < m_dense_regs; ++v) {
+      if (has_containment_edge(u, v)) {
+        o << u << " -- " << v << "\n";
+      }
+    }
+  }
   for (const auto& pair : m_containment_graph) {
     reg_t reg1 = static_cast<reg_t>((pair & 0xFFFFFFFF00000000) >> 32);
     reg_t reg2 = static_cast<reg_t>(pair & 0x00000000FFFFFFFF);
@@ -191,14 +191,23 @@ class Graph {
   }
 
   bool is_adjacent(reg_t u, reg_t v) const {
+    if (m_dense_regs != 0) {
+      return test_bit(m_adjacent_bits, bit_index(u, v));
+    }
     return m_adj_matrix.find(impl::build_edge(u, v)) != m_adj_matrix.end();
   }
 
   bool is_coalesceable(reg_t u, reg_t v) const {
+    if (m_dense_regs != 0) {
+      return !test_bit(m_interfering_bits, bit_index(u, v));
+    }
     return !is_adjacent(u, v) || !m_adj_matrix.at(impl::build_edge(u, v));
   }
 
   bool has_containment_edge(reg_t u, reg_t v) const {
+    if (m_dense_regs != 0) {
+      return test_bit(m_containment_bits, bit_index(u, v));
+    }
     return m_containment_graph.find(impl::build_containment_edge(u, v)) !=
            m_containment_graph.end();
   }
@@ -233,10 +242,55 @@ class Graph {
     if (u == v) {
       return;
     }
+    if (m_dense_regs != 0) {
+      set_bit(m_containment_bits, bit_index(u, v));
+      return;
+    }
     m_containment_graph.emplace(impl::build_containment_edge(u, v));
   }
 
+  /*
+   * Graphs whose registers are all below this bound keep their edges in bit
+   * matrices rather than in hash tables.
+   */
+  static constexpr reg_t MAX_DENSE_REGS = 2048;
+
  private:
+  /*
+   * Switches the (still empty) graph to bit matrices covering the registers
+   * below `regs`. All the edges added afterwards must be between those
+   * registers.
+   */
+  void use_dense_edges(reg_t regs);
+
+  // Records an edge in the bit matrices only, leaving the adjacency lists and
+  // weights to materialize_adjacency().
+  void set_edge_bits(reg_t u, reg_t v, bool can_coalesce);
+
+  // Fills in the adjacency lists and weights of all nodes from the adjacency
+  // matrix, in increasing register order.
+  void materialize_adjacency();
+
+  size_t bit_index(reg_t u, reg_t v) const {
+    redex_assert(u < m_dense_regs && v < m_dense_regs);
+    return static_cast<size_t>(u) * m_dense_regs + v;
+  }
+
+  static bool test_bit(const std::vector<uint64_t>& bits, size_t i) {
+    return (bits[i / 64] >> (i % 64)) & 1;
+  }
+
+  static void set_bit(std::vector<uint64_t>& bits, size_t i) {
+    bits[i / 64] |= uint64_t(1) << (i % 64);
+  }
+
+  // The number of registers covered by the bit matrices below, or zero if
+  // the hash tables are used instead. The adjacency matrices are symmetric,
+  // the containment matrix is not.
+  reg_t m_dense_regs{0};
+  std::vector<uint64_t> m_adjacent_bits;
+  std::vector<uint64_t> m_interfering_bits;
+  std::vector<uint64_t> m_containment_bits;
   std::unordered_map<reg_t, Node> m_nodes;
   std::unordered_map<reg_pair_t, bool> m_adj_matrix;
   std::unordered_set<reg_pair_t> m_containment_graph;
@@ -7,12 +7,17 @@
 
 #include "Shrinker.h"
 
+#include <algorithm>
+
 #include "ConstructorParams.h"
 #include "LinearScan.h"
+#include "LiveRange.h"
 #include "RandomForest.h"
 #include "RegisterAllocation.h"
+#include "ScopedCFG.h"
 #include "ScopedMetrics.h"
 #include "Trace.h"
+#include "WorkQueue.h"
 
 namespace shrinker {
 
@@ -160,6 +165,31 @@ copy_propagation_impl::Stats Shrinker::copy_propagation(DexMethod* method) {
   return copy_propagation.run(method->get_code(), method);
 }
 
+Shrinker::LocalCleanupStats Shrinker::local_cleanup(DexMethod* method,
+                                                    bool renumber_registers) {
+  LocalCleanupStats stats;
+  cfg::ScopedCFG cfg(method->get_code());
+
+  if (m_config.run_copy_prop) {
+    auto timer = m_copy_prop_timer.scope();
+    copy_propagation_impl::Config config;
+    copy_propagation_impl::CopyPropagation copy_propagation(config);
+    stats.copy_prop_stats = copy_propagation.run(*cfg, method);
+  }
+
+  if (m_config.run_local_dce) {
+    auto timer = m_local_dce_timer.scope();
+    auto local_dce = LocalDce(m_pure_methods);
+    local_dce.dce(*cfg);
+    stats.local_dce_stats = local_dce.get_stats();
+  }
+
+  if (renumber_registers) {
+    live_range::renumber_registers(*cfg, /* width_aware */ true);
+  }
+  return stats;
+}
+
 void Shrinker::shrink_method(DexMethod* method) {
   auto code = method->get_code();
   bool editable_cfg_built = code->editable_cfg_built();
@@ -194,14 +224,10 @@ void Shrinker::shrink_method(DexMethod* method) {
     cse_stats = cse.get_stats();
   }
 
-  if (m_config.run_copy_prop) {
-    auto timer = m_copy_prop_timer.scope();
-    copy_prop_stats = copy_propagation(method);
-  }
-
-  if (m_config.run_local_dce) {
-    auto timer = m_local_dce_timer.scope();
-    local_dce_stats = local_dce(code);
+  if (m_config.run_copy_prop || m_config.run_local_dce) {
+    auto local_cleanup_stats = local_cleanup(method);
+    copy_prop_stats = local_cleanup_stats.copy_prop_stats;
+    local_dce_stats = local_cleanup_stats.local_dce_stats;
   }
 
   using stats_t = std::tuple<size_t, size_t, size_t, size_t>;
@@ -297,9 +323,55 @@ void Shrinker::shrink_method(DexMethod* method) {
   m_methods_reg_alloced += reg_alloc_inc;
 }
 
+void Shrinker::shrink_all(const std::vector<DexMethod*>& methods) {
+  std::vector<std::pair<size_t, DexMethod*>> sized_methods;
+  for (auto method : methods) {
+    auto code = method->get_code();
+    if (code != nullptr) {
+      sized_methods.emplace_back(code->sum_opcode_sizes(), method);
+    }
+  }
+  std::sort(sized_methods.begin(), sized_methods.end(),
+            [](const auto& a, const auto& b) {
+              if (a.first != b.first) {
+                return a.first > b.first;
+              }
+              return compare_dexmethods(a.second, b.second);
+            });
+  std::vector<DexMethod*> ordered_methods;
+  ordered_methods.reserve(sized_methods.size());
+  for (auto& p : sized_methods) {
+    ordered_methods.push_back(p.second);
+  }
+
+  workqueue_run<DexMethod*>(
+      [this](DexMethod* method) { shrink_method(method); }, ordered_methods);
+
+  TRACE(MMINL, 2,
+        "[shrinker] %zu methods shrunk; const-prop: %.2fs, cse: %.2fs, "
+        "copy-prop: %.2fs, local-dce: %.2fs, reg-alloc: %.2fs, "
+        "fast-reg-alloc: %.2fs, dedup-blocks: %.2fs",
+        ordered_methods.size(), get_const_prop_seconds(), get_cse_seconds(),
+        get_copy_prop_seconds(), get_local_dce_seconds(),
+        get_reg_alloc_seconds(), get_fast_reg_alloc_seconds(),
+        get_dedup_blocks_seconds());
+}
+
 void Shrinker::log_metrics(ScopedMetrics& sm) const {
   auto scope = sm.scope("shrinker");
   m_const_prop_stats.log_metrics(sm);
+  // Accumulated over all threads.
+  auto timers_scope = sm.scope("ms");
+  auto set_ms = [&sm](const std::string& key, double seconds) {
+    sm.set_metric(key, static_cast<int64_t>(seconds * 1000));
+  };
+  set_ms("const_prop", get_const_prop_seconds());
+  set_ms("cse", get_cse_seconds());
+  set_ms("copy_prop", get_copy_prop_seconds());
+  set_ms("local_dce", get_local_dce_seconds());
+  set_ms("reg_alloc", get_reg_alloc_seconds());
+  set_ms("fast_reg_alloc", get_fast_reg_alloc_seconds());
+  set_ms("dedup_blocks", get_dedup_blocks_seconds());
 }
 
 } // namespace shrinker
@@ -46,7 +46,28 @@ class Shrinker {
   LocalDce::Stats local_dce(IRCode* code, bool normalize_new_instances = true);
   copy_propagation_impl::Stats copy_propagation(DexMethod* method);
 
+  struct LocalCleanupStats {
+    copy_propagation_impl::Stats copy_prop_stats;
+    LocalDce::Stats local_dce_stats;
+  };
+
+  /*
+   * Runs copy propagation and local dce, as configured, and then renumbers
+   * the registers if asked to, all on the same editable cfg. The cfg is only
+   * built, and cleared again afterwards, if the method doesn't have one yet.
+   */
+  LocalCleanupStats local_cleanup(DexMethod* method,
+                                  bool renumber_registers = false);
+
   void shrink_method(DexMethod* method);
+
+  /*
+   * Shrinks all the given methods that have code, in parallel. The largest
+   * methods are scheduled first, so that they don't end up as the tail of the
+   * run on a single thread. The time spent in each shrinking step is
+   * reported by log_metrics.
+   */
+  void shrink_all(const std::vector<DexMethod*>& methods);
   const constant_propagation::Transform::Stats& get_const_prop_stats() const {
     return m_const_prop_stats;
   }
@@ -10,7 +10,6 @@
 #include <queue>
 #include <vector>
 
-#include "ConstantPropagationAnalysis.h"
 #include "ReachingDefinitions.h"
 #include "StlUtil.h"
 #include "Trace.h"
@@ -106,15 +105,25 @@ bool SwitchEquivFinder::has_src(IRInstruction* insn, reg_t reg) {
   return false;
 }
 
+std::shared_ptr<SwitchEquivFinder::FixpointIterator>
+SwitchEquivFinder::make_fixpoint_iterator(const cfg::ControlFlowGraph& cfg) {
+  auto fixpoint_iterator = std::make_shared<FixpointIterator>(
+      cfg, cp::ConstantPrimitiveAnalyzer());
+  fixpoint_iterator->run(ConstantEnvironment());
+  return fixpoint_iterator;
+}
+
 SwitchEquivFinder::SwitchEquivFinder(
     cfg::ControlFlowGraph* cfg,
     const cfg::InstructionIterator& root_branch,
     reg_t switching_reg,
-    uint32_t leaf_duplication_threshold)
+    uint32_t leaf_duplication_threshold,
+    std::shared_ptr<FixpointIterator> fixpoint_iterator)
     : m_cfg(cfg),
       m_root_branch(root_branch),
       m_switching_reg(switching_reg),
-      m_leaf_duplication_threshold(leaf_duplication_threshold) {
+      m_leaf_duplication_threshold(leaf_duplication_threshold),
+      m_fixpoint_iterator(std::move(fixpoint_iterator)) {
 
   {
     // make sure the input is well-formed
@@ -146,7 +155,7 @@ std::vector<cfg::Edge*> SwitchEquivFinder::find_leaves() {
   // Traverse the tree in an depth first order so that the extra loads are
   // tracked in the same order that they will be executed at runtime
   std::unordered_set<cfg::Block*> non_leaves;
-  std::function<bool(cfg::Block*, InstructionSet)> recurse;
+  std::function<bool(cfg::Block*, const InstructionSet&)> recurse;
   std::vector<std::pair<cfg::Edge*, cfg::Block*>> edges_to_move;
   recurse = [&](cfg::Block* b, const InstructionSet& loads) {
     // `loads` represents the state of the registers after evaluating `b`.
@@ -267,6 +276,11 @@ std::vector<cfg::Edge*> SwitchEquivFinder::find_leaves() {
   if (!success) {
     return bail();
   }
+  if (!edges_to_move.empty()) {
+    // The duplicated leaves change what reaches the rest of the cfg, so a
+    // given analysis no longer applies.
+    m_fixpoint_iterator = nullptr;
+  }
 
   if (leaves.empty()) {
     TRACE(SWITCH_EQUIV, 2, "Failure Reason: No leaves found");
@@ -341,6 +355,12 @@ void SwitchEquivFinder::normalize_extra_loads(
       }
     }
   }
+  if (extra_loads.empty()) {
+    // Only the loads of the non-leaves end up in `m_extra_loads`, so all of
+    // its lists are empty, and there is no need for ReachingDefinitions.
+    m_extra_loads.clear();
+    return;
+  }
 
   // Use ReachingDefinitions to find the loads that are used outside the if-else
   // chain blocks
@@ -389,9 +409,10 @@ void SwitchEquivFinder::normalize_extra_loads(
 void SwitchEquivFinder::find_case_keys(const std::vector<cfg::Edge*>& leaves) {
   // We use the fixpoint iterator to infer the values of registers at different
   // points in the program. Especially `m_switching_reg`.
-  cp::intraprocedural::FixpointIterator fixpoint(
-      *m_cfg, cp::ConstantPrimitiveAnalyzer());
-  fixpoint.run(ConstantEnvironment());
+  if (!m_fixpoint_iterator) {
+    m_fixpoint_iterator = make_fixpoint_iterator(*m_cfg);
+  }
+  const auto& fixpoint = *m_fixpoint_iterator;
 
   // return true on success
   // return false on failure (there was a conflicting entry already in the map)
@@ -9,8 +9,10 @@
 
 #include <boost/optional.hpp>
 #include <map>
+#include <memory>
 #include <unordered_set>
 
+#include "ConstantPropagationAnalysis.h"
 #include "ControlFlow.h"
 
 /**
@@ -24,13 +26,23 @@ class SwitchEquivFinder final {
   using KeyToCase = std::map<boost::optional<int32_t>, cfg::Block*>;
   using InstructionSet = std::map<reg_t, IRInstruction*>;
   using ExtraLoads = std::unordered_map<cfg::Block*, InstructionSet>;
+  using FixpointIterator =
+      constant_propagation::intraprocedural::FixpointIterator;
 
   static bool has_src(IRInstruction* insn, reg_t reg);
 
-  SwitchEquivFinder(cfg::ControlFlowGraph* cfg,
-                    const cfg::InstructionIterator& root_branch,
-                    reg_t switching_reg,
-                    uint32_t leaf_duplication_threshold = 0);
+  // Runs the constant propagation that finds the case keys. Passing its result
+  // to several finders on the same cfg saves rerunning it, as long as the cfg
+  // doesn't change in between. A finder that duplicates leaves ignores it.
+  static std::shared_ptr<FixpointIterator> make_fixpoint_iterator(
+      const cfg::ControlFlowGraph& cfg);
+
+  SwitchEquivFinder(
+      cfg::ControlFlowGraph* cfg,
+      const cfg::InstructionIterator& root_branch,
+      reg_t switching_reg,
+      uint32_t leaf_duplication_threshold = 0,
+      std::shared_ptr<FixpointIterator> fixpoint_iterator = nullptr);
 
   SwitchEquivFinder() = delete;
   SwitchEquivFinder(const SwitchEquivFinder&) = delete;
@@ -73,6 +85,9 @@ class SwitchEquivFinder final {
   // opcodes the SwitchEquivFinder may duplicate that block. If this flag is
   // zero, the SwitchEquivFinder will not edit the CFG.
   uint32_t m_leaf_duplication_threshold{0};
+  // The constant propagation that finds the case keys, computed on demand
+  // unless given to the constructor.
+  std::shared_ptr<FixpointIterator> m_fixpoint_iterator;
   // If a switch equivalent cannot be found starting from `m_root_branch` this
   // flag will be false, otherwise true.
   bool m_success{false};
@@ -7,6 +7,8 @@
 
 #include "GlobalTypeAnalyzer.h"
 
+#include <algorithm>
+
 #include "ConcurrentContainers.h"
 #include "Resolver.h"
 #include "Show.h"
@@ -108,12 +110,55 @@ void scan_any_init_reachables(
   }
 }
 
+/*
+ * The fields and callees whose types the local analysis of the method looks up
+ * in the WholeProgramState, resolved the same way as WholeProgramAwareAnalyzer
+ * does.
+ */
+void find_whole_program_state_reads(const cfg::ControlFlowGraph& cfg,
+                                    std::vector<const DexField*>* fields,
+                                    std::vector<const DexMethod*>* callees) {
+  for (auto& mie : cfg::ConstInstructionIterable(cfg)) {
+    auto insn = mie.insn;
+    auto op = insn->opcode();
+    if (opcode::is_an_iget(op) || opcode::is_an_sget(op)) {
+      auto field = resolve_field(insn->get_field());
+      if (field != nullptr && type::is_object(field->get_type())) {
+        fields->push_back(field);
+      }
+    } else if (opcode::is_an_invoke(op)) {
+      auto callee = resolve_method(insn->get_method(), opcode_to_search(insn));
+      if (callee != nullptr &&
+          type::is_object(callee->get_proto()->get_rtype())) {
+        callees->push_back(callee);
+      }
+    }
+  }
+  std::sort(fields->begin(), fields->end());
+  fields->erase(std::unique(fields->begin(), fields->end()), fields->end());
+  std::sort(callees->begin(), callees->end());
+  callees->erase(std::unique(callees->begin(), callees->end()),
+                 callees->end());
+}
+
 } // namespace
 
 namespace type_analyzer {
 
 namespace global {
 
+bool LocalAnalysisInputs::equals(const LocalAnalysisInputs& other) const {
+  if (types.size() != other.types.size() || !args.equals(other.args)) {
+    return false;
+  }
+  for (size_t i = 0; i < types.size(); ++i) {
+    if (!types[i].equals(other.types[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
 DexTypeEnvironment env_with_params(const IRCode* code,
                                    const ArgumentTypeEnvironment& args) {
 
@@ -137,29 +182,19 @@ void GlobalTypeAnalyzer::analyze_node(
   if (code == nullptr) {
     return;
   }
-  auto& cfg = code->cfg();
-  auto intra_ta = get_local_analysis(method);
+  auto summary = get_local_analysis_summary(method);
   const auto outgoing_edges =
       call_graph::GraphInterface::successors(m_call_graph, node);
-  std::unordered_set<IRInstruction*> outgoing_insns;
+  std::unordered_set<const IRInstruction*> outgoing_insns;
   for (const auto& edge : outgoing_edges) {
     if (edge->callee() == m_call_graph.exit()) {
       continue; // ghost edge to the ghost exit node
     }
     outgoing_insns.emplace(edge->invoke_insn());
   }
-  for (auto* block : cfg.blocks()) {
-    auto state = intra_ta->get_entry_state_at(block);
-    for (auto& mie : InstructionIterable(block)) {
-      auto* insn = mie.insn;
-      if (insn->has_method() && outgoing_insns.count(insn)) {
-        ArgumentTypeEnvironment out_args;
-        for (size_t i = 0; i < insn->srcs_size(); ++i) {
-          out_args.set(i, state.get(insn->src(i)));
-        }
-        current_partition->set(insn, out_args);
-      }
-      intra_ta->analyze_instruction(insn, &state);
+  for (const auto& pair : summary->invoke_args) {
+    if (outgoing_insns.count(pair.first)) {
+      current_partition->set(pair.first, pair.second);
     }
   }
 }
@@ -179,26 +214,86 @@ ArgumentTypePartition GlobalTypeAnalyzer::analyze_edge(
   return entry_state_at_dest;
 }
 
-std::unique_ptr<local::LocalTypeAnalyzer>
-GlobalTypeAnalyzer::get_local_analysis(const DexMethod* method) const {
+ArgumentTypeEnvironment GlobalTypeAnalyzer::get_entry_args(
+    const DexMethod* method) const {
   auto args = ArgumentTypePartition::bottom();
 
   if (m_call_graph.has_node(method)) {
     args = this->get_entry_state_at(m_call_graph.node(method));
   }
+  return args.get(CURRENT_PARTITION_LABEL);
+}
+
+std::unique_ptr<local::LocalTypeAnalyzer>
+GlobalTypeAnalyzer::get_local_analysis(const DexMethod* method) const {
   return analyze_method(method,
                         this->get_whole_program_state(),
-                        args.get(CURRENT_PARTITION_LABEL));
+                        get_entry_args(method));
 }
 
 bool GlobalTypeAnalyzer::is_reachable(const DexMethod* method) const {
-  auto args = ArgumentTypePartition::bottom();
+  return !get_entry_args(method).is_bottom();
+}
 
-  if (m_call_graph.has_node(method)) {
-    args = this->get_entry_state_at(m_call_graph.node(method));
+LocalAnalysisInputs GlobalTypeAnalyzer::get_local_analysis_inputs(
+    const DexMethod* method, const LocalAnalysisSummary* previous) const {
+  LocalAnalysisInputs inputs;
+  inputs.args = get_entry_args(method);
+  if (previous != nullptr) {
+    inputs.fields = previous->inputs.fields;
+    inputs.callees = previous->inputs.callees;
+  } else {
+    auto fields = std::make_shared<std::vector<const DexField*>>();
+    auto callees = std::make_shared<std::vector<const DexMethod*>>();
+    find_whole_program_state_reads(method->get_code()->cfg(), fields.get(),
+                                   callees.get());
+    inputs.fields = std::move(fields);
+    inputs.callees = std::move(callees);
+  }
+  const auto& wps = this->get_whole_program_state();
+  inputs.types.reserve(inputs.fields->size() + inputs.callees->size());
+  for (const auto* field : *inputs.fields) {
+    inputs.types.push_back(wps.get_field_type(field));
   }
-  auto args_domain = args.get(CURRENT_PARTITION_LABEL);
-  return !args_domain.is_bottom();
+  for (const auto* callee : *inputs.callees) {
+    inputs.types.push_back(wps.get_return_type(callee));
+  }
+  return inputs;
+}
+
+std::shared_ptr<const LocalAnalysisSummary>
+GlobalTypeAnalyzer::get_local_analysis_summary(const DexMethod* method) const {
+  auto previous = m_summaries.get(method, nullptr);
+  auto inputs = get_local_analysis_inputs(method, previous.get());
+  if (previous != nullptr && previous->inputs.equals(inputs)) {
+    ++m_summaries_reused;
+    return previous;
+  }
+  ++m_summaries_computed;
+
+  auto summary = std::make_shared<LocalAnalysisSummary>();
+  summary->inputs = std::move(inputs);
+  auto& cfg = method->get_code()->cfg();
+  auto intra_ta = analyze_method(
+      method, this->get_whole_program_state(), summary->inputs.args);
+  for (auto* block : cfg.blocks()) {
+    auto state = intra_ta->get_entry_state_at(block);
+    for (auto& mie : InstructionIterable(block)) {
+      auto* insn = mie.insn;
+      if (insn->has_method()) {
+        ArgumentTypeEnvironment out_args;
+        for (size_t i = 0; i < insn->srcs_size(); ++i) {
+          out_args.set(i, state.get(insn->src(i)));
+        }
+        summary->invoke_args.emplace_back(insn, std::move(out_args));
+      }
+      intra_ta->analyze_instruction(insn, &state);
+      summary->collected_types.collect(insn, state, method);
+    }
+  }
+  std::shared_ptr<const LocalAnalysisSummary> result = std::move(summary);
+  m_summaries.insert_or_assign(std::make_pair(method, result));
+  return result;
 }
 
 using CombinedAnalyzer =
@@ -231,8 +326,11 @@ std::unique_ptr<local::LocalTypeAnalyzer> GlobalTypeAnalyzer::analyze_method(
     ctor_type = method->get_class();
   }
   TRACE(TYPE, 5, "%s", SHOW(code.cfg()));
+  // The method is analyzed again in every global iteration, so keep its
+  // ordering on the CFG.
   auto local_ta = std::make_unique<local::LocalTypeAnalyzer>(
-      code.cfg(), CombinedAnalyzer(clinit_type, &wps, ctor_type, nullptr));
+      code.cfg(), ir_analyzer::get_forward_ordering(code.cfg()),
+      CombinedAnalyzer(clinit_type, &wps, ctor_type, nullptr));
   local_ta->run(env);
 
   return local_ta;
@@ -444,6 +542,12 @@ std::unique_ptr<GlobalTypeAnalyzer> GlobalTypeAnalysis::analyze(
         "[global] Finished in %zu global iterations (max %zu)",
         iteration_cnt,
         m_max_global_analysis_iteration);
+  auto summary_stats = gta->get_summary_stats();
+  TRACE(TYPE,
+        1,
+        "[global] Ran %zu local analyses, reused %zu unchanged ones",
+        summary_stats.computed,
+        summary_stats.reused);
   return gta;
 }
 
@@ -7,7 +7,10 @@
 
 #pragma once
 
+#include <atomic>
+
 #include "CallGraph.h"
+#include "ConcurrentContainers.h"
 #include "DexTypeEnvironment.h"
 #include "HashedAbstractPartition.h"
 #include "LocalTypeAnalyzer.h"
@@ -57,6 +60,35 @@ constexpr const IRInstruction* CURRENT_PARTITION_LABEL = nullptr;
 DexTypeEnvironment env_with_params(const IRCode* code,
                                    const ArgumentTypeEnvironment& args);
 
+/*
+ * Everything the local analysis of a method reads from outside the method: the
+ * types of its arguments, and the field types and return types it looks up in
+ * the WholeProgramState. The same inputs always yield the same local analysis.
+ */
+struct LocalAnalysisInputs {
+  ArgumentTypeEnvironment args;
+  // The fields and the callees whose types the method reads, and their types
+  // in the WholeProgramState, in that order.
+  std::shared_ptr<const std::vector<const DexField*>> fields;
+  std::shared_ptr<const std::vector<const DexMethod*>> callees;
+  std::vector<DexTypeDomain> types;
+
+  bool equals(const LocalAnalysisInputs& other) const;
+};
+
+/*
+ * The results of the local analysis of a method that the global analysis
+ * consumes, along with the inputs they were computed from.
+ */
+struct LocalAnalysisSummary {
+  LocalAnalysisInputs inputs;
+  // The arguments passed at each invoke instruction.
+  std::vector<std::pair<const IRInstruction*, ArgumentTypeEnvironment>>
+      invoke_args;
+  // The field and return types for the next WholeProgramState.
+  CollectedTypes collected_types;
+};
+
 /*
  * Performs interprocedural DexType analysis of stack / register values.
  * The intraprocedural propagation logic is delegated to the LocalTypeAnalyzer.
@@ -87,6 +119,23 @@ class GlobalTypeAnalyzer : public sparta::ParallelMonotonicFixpointIterator<
   std::unique_ptr<local::LocalTypeAnalyzer> get_local_analysis(
       const DexMethod*) const;
 
+  /*
+   * Return the summary of the local analysis of the given method under the
+   * current arguments and WholeProgramState. The local analysis only runs
+   * again when one of its inputs changed since the last summary of the method.
+   */
+  std::shared_ptr<const LocalAnalysisSummary> get_local_analysis_summary(
+      const DexMethod*) const;
+
+  struct SummaryStats {
+    size_t computed{0};
+    size_t reused{0};
+  };
+
+  SummaryStats get_summary_stats() const {
+    return {m_summaries_computed, m_summaries_reused};
+  }
+
   const WholeProgramState& get_whole_program_state() const { return *m_wps; }
 
   void set_whole_program_state(std::unique_ptr<WholeProgramState> wps) {
@@ -100,6 +149,17 @@ class GlobalTypeAnalyzer : public sparta::ParallelMonotonicFixpointIterator<
  private:
   std::unique_ptr<const WholeProgramState> m_wps;
   call_graph::Graph m_call_graph;
+  // Survives across global iterations, as the WholeProgramState changes.
+  mutable ConcurrentMap<const DexMethod*,
+                        std::shared_ptr<const LocalAnalysisSummary>>
+      m_summaries;
+  mutable std::atomic<size_t> m_summaries_computed{0};
+  mutable std::atomic<size_t> m_summaries_reused{0};
+
+  ArgumentTypeEnvironment get_entry_args(const DexMethod* method) const;
+
+  LocalAnalysisInputs get_local_analysis_inputs(
+      const DexMethod* method, const LocalAnalysisSummary* previous) const;
 
   std::unique_ptr<local::LocalTypeAnalyzer> analyze_method(
       const DexMethod* method,
@@ -27,6 +27,15 @@ class LocalTypeAnalyzer final
       : ir_analyzer::BaseIRAnalyzer<DexTypeEnvironment>(cfg),
         m_insn_analyzer(std::move(insn_analyer)) {}
 
+  // `ordering` must come from `make_forward_ordering(cfg)` or
+  // `get_forward_ordering(cfg)`.
+  LocalTypeAnalyzer(const cfg::ControlFlowGraph& cfg,
+                    std::shared_ptr<const WeakPartialOrdering> ordering,
+                    InstructionAnalyzer<DexTypeEnvironment> insn_analyer)
+      : ir_analyzer::BaseIRAnalyzer<DexTypeEnvironment>(cfg,
+                                                        std::move(ordering)),
+        m_insn_analyzer(std::move(insn_analyer)) {}
+
   void analyze_instruction(const IRInstruction* insn,
                            DexTypeEnvironment* env) const override;
 
@@ -126,6 +126,38 @@ bool analyze_gets_helper(const WholeProgramState* whole_program_state,
 
 namespace type_analyzer {
 
+void CollectedTypes::collect(const IRInstruction* insn,
+                             const DexTypeEnvironment& env,
+                             const DexMethod* method) {
+  auto op = insn->opcode();
+  if (opcode::is_an_sput(op) || opcode::is_an_iput(op)) {
+    auto field = resolve_field(insn->get_field());
+    if (!field || !type::is_object(field->get_type())) {
+      return;
+    }
+    auto type = env.get(insn->src(0));
+    if (traceEnabled(TYPE, 5)) {
+      std::ostringstream ss;
+      ss << type;
+      TRACE(TYPE, 5, "collecting field %s -> %s", SHOW(field),
+            ss.str().c_str());
+    }
+    field_types.emplace_back(field, type);
+    return;
+  }
+  if (!opcode::is_a_return(op)) {
+    return;
+  }
+  if (!returns_reference(method)) {
+    // We must record Top here to record the fact that this method does indeed
+    // return -- even though `void` is not actually a return type, this tells
+    // us that the code following any invoke of this method is reachable.
+    return_types.emplace_back(DexTypeDomain::top());
+    return;
+  }
+  return_types.emplace_back(env.get(insn->src(0)));
+}
+
 WholeProgramState::WholeProgramState(
     const Scope& scope,
     const global::GlobalTypeAnalyzer& gta,
@@ -239,16 +271,26 @@ void WholeProgramState::collect(const Scope& scope,
     if (!is_reachable(gta, method)) {
       return;
     }
-    auto& cfg = code->cfg();
-    auto lta = gta.get_local_analysis(method);
-    for (cfg::Block* b : cfg.blocks()) {
-      auto env = lta->get_entry_state_at(b);
-      for (auto& mie : InstructionIterable(b)) {
-        auto* insn = mie.insn;
-        lta->analyze_instruction(insn, &env);
-        collect_field_types(insn, env, &fields_tmp);
-        collect_return_types(insn, env, method, &methods_tmp);
-      }
+    // Methods whose inputs didn't change since the previous global iteration
+    // reuse their summary instead of being analyzed again.
+    auto summary = gta.get_local_analysis_summary(method);
+    const auto& collected = summary->collected_types;
+    for (const auto& pair : collected.field_types) {
+      fields_tmp.update(pair.first,
+                        [&pair](const DexField*,
+                                std::vector<DexTypeDomain>& s,
+                                bool /* exists */) {
+                          s.emplace_back(pair.second);
+                        });
+    }
+    if (!collected.return_types.empty()) {
+      methods_tmp.update(method,
+                         [&collected](const DexMethod*,
+                                      std::vector<DexTypeDomain>& s,
+                                      bool /* exists */) {
+                           s.insert(s.end(), collected.return_types.begin(),
+                                    collected.return_types.end());
+                         });
     }
   });
   for (const auto& pair : fields_tmp) {
@@ -267,58 +309,6 @@ void WholeProgramState::collect(const Scope& scope,
   }
 }
 
-void WholeProgramState::collect_field_types(
-    const IRInstruction* insn,
-    const DexTypeEnvironment& env,
-    ConcurrentMap<const DexField*, std::vector<DexTypeDomain>>* field_tmp) {
-  if (!opcode::is_an_sput(insn->opcode()) &&
-      !opcode::is_an_iput(insn->opcode())) {
-    return;
-  }
-  auto field = resolve_field(insn->get_field());
-  if (!field || !type::is_object(field->get_type())) {
-    return;
-  }
-  auto type = env.get(insn->src(0));
-  if (traceEnabled(TYPE, 5)) {
-    std::ostringstream ss;
-    ss << type;
-    TRACE(TYPE, 5, "collecting field %s -> %s", SHOW(field), ss.str().c_str());
-  }
-  field_tmp->update(field,
-                    [type](const DexField*,
-                           std::vector<DexTypeDomain>& s,
-                           bool /* exists */) { s.emplace_back(type); });
-}
-
-void WholeProgramState::collect_return_types(
-    const IRInstruction* insn,
-    const DexTypeEnvironment& env,
-    const DexMethod* method,
-    ConcurrentMap<const DexMethod*, std::vector<DexTypeDomain>>* method_tmp) {
-  auto op = insn->opcode();
-  if (!opcode::is_a_return(op)) {
-    return;
-  }
-  if (!returns_reference(method)) {
-    // We must set the binding to Top here to record the fact that this method
-    // does indeed return -- even though `void` is not actually a return type,
-    // this tells us that the code following any invoke of this method is
-    // reachable.
-    method_tmp->update(
-        method,
-        [](const DexMethod*, std::vector<DexTypeDomain>& s, bool /* exists */) {
-          s.emplace_back(DexTypeDomain::top());
-        });
-    return;
-  }
-  auto type = env.get(insn->src(0));
-  method_tmp->update(method,
-                     [type](const DexMethod*,
-                            std::vector<DexTypeDomain>& s,
-                            bool /* exists */) { s.emplace_back(type); });
-}
-
 bool WholeProgramState::is_reachable(const global::GlobalTypeAnalyzer& gta,
                                      const DexMethod* method) const {
   return !m_known_methods.count(method) || gta.is_reachable(method);
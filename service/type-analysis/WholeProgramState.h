@@ -32,6 +32,21 @@ using DexTypeFieldPartition =
 using DexTypeMethodPartition =
     sparta::HashedAbstractPartition<const DexMethod*, DexTypeDomain>;
 
+/*
+ * The types that a method writes to fields and returns, which make up the
+ * next WholeProgramState.
+ */
+struct CollectedTypes {
+  std::vector<std::pair<const DexField*, DexTypeDomain>> field_types;
+  // Top for methods that return void, to record the fact that they return.
+  std::vector<DexTypeDomain> return_types;
+
+  // The environment is the state right after the instruction.
+  void collect(const IRInstruction* insn,
+               const DexTypeEnvironment& env,
+               const DexMethod* method);
+};
+
 class WholeProgramState {
  public:
   // By default, the field and method partitions are initialized to Bottom.
@@ -150,17 +165,6 @@ class WholeProgramState {
 
   void collect(const Scope& scope, const global::GlobalTypeAnalyzer&);
 
-  void collect_field_types(
-      const IRInstruction* insn,
-      const DexTypeEnvironment& env,
-      ConcurrentMap<const DexField*, std::vector<DexTypeDomain>>* field_tmp);
-
-  void collect_return_types(
-      const IRInstruction* insn,
-      const DexTypeEnvironment& env,
-      const DexMethod* method,
-      ConcurrentMap<const DexMethod*, std::vector<DexTypeDomain>>* method_tmp);
-
   bool is_reachable(const global::GlobalTypeAnalyzer&, const DexMethod*) const;
 
   // To avoid "Show.h" in the header.
@@ -165,25 +165,33 @@ void rewrite_dalvik_annotation_signature(const Scope& scope,
                                          const TypeStringMap& mapping) {
   static DexType* dalviksig =
       DexType::get_type("Ldalvik/annotation/Signature;");
-  walk::parallel::annotations(scope, [&](DexAnnotation* anno) {
+  walk::parallel::annotations(scope, [&](DexAnnotation*& anno) {
     if (anno->type() != dalviksig) return;
-    auto elems = anno->anno_elems();
-    for (auto elem : elems) {
-      auto ev = elem.encoded_value;
-      if (ev->evtype() != DEVT_ARRAY) continue;
-      auto arrayev = static_cast<DexEncodedValueArray*>(ev);
-      auto const& evs = arrayev->evalues();
-      for (auto strev : *evs) {
-        if (strev->evtype() != DEVT_STRING) continue;
-        auto stringev = static_cast<DexEncodedValueString*>(strev);
-        DexString* old_str = stringev->string();
-        DexString* new_str = lookup_signature_annotation(mapping, old_str);
-        if (new_str != nullptr) {
+    // The annotation may be shared with other members, so it is only copied
+    // once it turns out to need a rewrite.
+    auto rewrite = [&](bool dry_run) {
+      for (auto const& elem : anno->anno_elems()) {
+        auto ev = elem.encoded_value;
+        if (ev->evtype() != DEVT_ARRAY) continue;
+        auto arrayev = static_cast<DexEncodedValueArray*>(ev);
+        auto const& evs = arrayev->evalues();
+        for (auto strev : *evs) {
+          if (strev->evtype() != DEVT_STRING) continue;
+          auto stringev = static_cast<DexEncodedValueString*>(strev);
+          DexString* old_str = stringev->string();
+          DexString* new_str = lookup_signature_annotation(mapping, old_str);
+          if (new_str == nullptr) continue;
+          if (dry_run) return true;
           TRACE(RENAME, 5, "Rewriting Signature from '%s' to '%s'",
                 old_str->c_str(), new_str->c_str());
           stringev->string(new_str);
         }
       }
+      return false;
+    };
+    if (rewrite(/* dry_run */ true)) {
+      DexAnnotation::unshare(anno);
+      rewrite(/* dry_run */ false);
     }
   });
 }
@@ -7,14 +7,18 @@
 
 #pragma once
 
+#include <atomic>
 #include <boost/optional.hpp>
 #include <functional>
 #include <memory>
+#include <stack>
 #include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "AbstractDomain.h"
+#include "SpartaWorkQueue.h"
 
 namespace sparta {
 
@@ -266,6 +270,63 @@ class InterproceduralAnalyzer {
     return fp;
   }
 
+  /*
+   * Like `run`, except that between two rounds of the call graph fixpoint,
+   * a change in the summary of a function immediately triggers the
+   * re-analysis of the functions that depend on it, instead of waiting for
+   * the next round. Re-analyses are scheduled on a work-stealing queue as
+   * soon as one of their dependencies changes, so a large strongly connected
+   * component of the call graph does not hold back the rest of the program.
+   * The caller contexts are the ones computed by the preceding round; the
+   * next round brings them up to date and the analysis terminates exactly
+   * like `run`.
+   *
+   * The registry must be thread-safe and provide
+   *
+   *   bool consume_update(const Function& function);
+   *
+   * which returns whether the summary of `function` has changed since the
+   * last call, and forgets about that change.
+   */
+  std::shared_ptr<CallGraphFixpointIterator> run_dependency_driven(
+      size_t num_threads = parallel::default_num_threads()) {
+    // The fixpoint iterator keeps a reference to the call graph, hence the
+    // latter must live as long as the former.
+    auto callgraph = std::make_shared<const CallGraph>(
+        Analysis::call_graph_of(m_program, &this->registry));
+    auto fp = std::make_shared<CallGraphFixpointIterator>(
+        *callgraph,
+        &this->registry,
+        [this, callgraph](
+            const Function& func, Registry* reg,
+            CallerContext* context) -> std::shared_ptr<FunctionAnalyzer> {
+          return this->run_on_function(func, reg, context, &*callgraph);
+        });
+    auto nodes = reachable_nodes(*callgraph);
+
+    for (int iteration = 0; iteration < m_max_iteration; iteration++) {
+      if (m_logger) {
+        (*m_logger)(std::string("Iteration ") + std::to_string(iteration + 1));
+      }
+      fp->run(CallGraphFixpointIterator::initial_domain());
+
+      if (!this->registry.has_update()) {
+        if (m_logger) {
+          (*m_logger)(std::string("Global fixpoint reached after ") +
+                      std::to_string(iteration + 1) + " iterations.");
+        }
+        break;
+      }
+      propagate_updates(*fp, *callgraph, nodes, num_threads);
+      // Only a round that does not change any summary proves that the global
+      // fixpoint is reached, hence the updates made while propagating don't
+      // count.
+      this->registry.materialize_update();
+    }
+
+    return fp;
+  }
+
   virtual std::shared_ptr<FunctionAnalyzer> run_on_function(
       const Function& function,
       Registry* reg,
@@ -285,7 +346,94 @@ class InterproceduralAnalyzer {
     m_logger = logger;
   }
 
+ protected:
+  using NodeId = typename CallGraphInterface::NodeId;
+
+  /*
+   * The functions that must be analyzed again when the summary of `node`
+   * changes. The orientation of the call graph depends on the analysis, hence
+   * this conservatively returns the neighbors of `node` in both directions.
+   * Analyses that know the orientation of their call graph can restrict this
+   * to the callers.
+   */
+  virtual std::vector<NodeId> dependents_of(const CallGraph& graph,
+                                            const NodeId& node) const {
+    std::vector<NodeId> dependents;
+    for (const auto& edge : CallGraphInterface::predecessors(graph, node)) {
+      dependents.push_back(CallGraphInterface::source(graph, edge));
+    }
+    for (const auto& edge : CallGraphInterface::successors(graph, node)) {
+      dependents.push_back(CallGraphInterface::target(graph, edge));
+    }
+    return dependents;
+  }
+
  private:
+  static std::vector<NodeId> reachable_nodes(const CallGraph& graph) {
+    std::vector<NodeId> nodes;
+    std::unordered_set<NodeId> visited;
+    std::stack<NodeId> stack;
+    auto entry = CallGraphInterface::entry(graph);
+    visited.emplace(entry);
+    stack.push(entry);
+    while (!stack.empty()) {
+      auto node = stack.top();
+      stack.pop();
+      nodes.push_back(node);
+      for (const auto& edge : CallGraphInterface::successors(graph, node)) {
+        auto target = CallGraphInterface::target(graph, edge);
+        if (visited.emplace(target).second) {
+          stack.push(target);
+        }
+      }
+    }
+    return nodes;
+  }
+
+  // Re-analyzes the dependents of every function whose summary has changed,
+  // until no summary changes anymore.
+  void propagate_updates(const CallGraphFixpointIterator& fp,
+                         const CallGraph& graph,
+                         const std::vector<NodeId>& nodes,
+                         size_t num_threads) {
+    // A function is pending from the moment it is pushed onto the queue
+    // until its re-analysis starts, which avoids queueing it several times.
+    std::unordered_map<NodeId, std::atomic<bool>> pending;
+    for (const auto& node : nodes) {
+      pending[node] = false;
+    }
+    auto schedule_dependents = [&](const NodeId& node, auto&& push) {
+      for (const auto& dependent : dependents_of(graph, node)) {
+        auto it = pending.find(dependent);
+        if (it != pending.end() && !it->second.exchange(true)) {
+          push(dependent);
+        }
+      }
+    };
+    auto wq = sparta::work_queue<NodeId>(
+        [&](SpartaWorkerState<NodeId>* worker_state, const NodeId& node) {
+          pending.at(node) = false;
+          const auto& function = Analysis::function_by_node_id(node);
+          CallerContext context = fp.get_entry_state_at(node);
+          this->run_on_function(function, &this->registry, &context, &graph)
+              ->summarize();
+          if (this->registry.consume_update(function)) {
+            schedule_dependents(node, [worker_state](const NodeId& dependent) {
+              worker_state->push_task(dependent);
+            });
+          }
+        },
+        num_threads,
+        /*push_tasks_while_running=*/true);
+    for (const auto& node : nodes) {
+      if (this->registry.consume_update(Analysis::function_by_node_id(node))) {
+        schedule_dependents(
+            node, [&wq](const NodeId& dependent) { wq.add_item(dependent); });
+      }
+    }
+    wq.run_all();
+  }
+
   Program m_program;
   int m_max_iteration;
   AnalysisParameters* m_parameters;
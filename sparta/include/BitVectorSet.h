@@ -0,0 +1,416 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <ostream>
+#include <type_traits>
+#include <vector>
+
+#include "PatriciaTreeSet.h"
+
+namespace sparta {
+
+/*
+ * A set of unsigned integers implemented as a dense bit vector, using the
+ * same interface as `PatriciaTreeSet`.
+ *
+ * Set operations on bit vectors are word-wise loops over contiguous memory,
+ * which compilers turn into vector instructions. This makes them much faster
+ * than their Patricia tree counterparts on small universes, like the registers
+ * of a method. The size of a bit vector grows with the largest element
+ * though, hence a set that contains an element greater than or equal to
+ * `MaxDenseSize` switches to a Patricia tree representation. A set that
+ * becomes empty, or the intersection with a dense set, is dense again.
+ */
+template <typename Element, size_t MaxDenseSize = 1024>
+class BitVectorSet final {
+  static_assert(std::is_unsigned<Element>::value,
+                "BitVectorSet only handles unsigned integers");
+
+  using Word = uint64_t;
+  using Tree = PatriciaTreeSet<Element>;
+  static constexpr size_t kWordBits = std::numeric_limits<Word>::digits;
+
+ public:
+  class iterator;
+
+  // C++ container concept member types
+  using const_iterator = iterator;
+  using value_type = Element;
+  using difference_type = std::ptrdiff_t;
+  using size_type = size_t;
+  using const_reference = Element;
+
+  BitVectorSet() = default;
+
+  explicit BitVectorSet(std::initializer_list<Element> l) {
+    for (Element x : l) {
+      insert(x);
+    }
+  }
+
+  template <typename InputIterator>
+  BitVectorSet(InputIterator first, InputIterator last) {
+    for (auto it = first; it != last; ++it) {
+      insert(*it);
+    }
+  }
+
+  bool empty() const { return m_dense ? m_words.empty() : m_tree.empty(); }
+
+  size_t size() const {
+    if (!m_dense) {
+      return m_tree.size();
+    }
+    size_t s = 0;
+    for (Word w : m_words) {
+      s += __builtin_popcountll(w);
+    }
+    return s;
+  }
+
+  size_t max_size() const { return std::numeric_limits<Element>::max(); }
+
+  iterator begin() const {
+    return m_dense ? iterator(m_words.data(), m_words.size())
+                   : iterator(m_tree.begin());
+  }
+
+  iterator end() const {
+    return m_dense ? iterator(m_words.data() + m_words.size(), 0)
+                   : iterator(m_tree.end());
+  }
+
+  bool contains(Element key) const {
+    if (!m_dense) {
+      return m_tree.contains(key);
+    }
+    size_t index = key / kWordBits;
+    return index < m_words.size() && (m_words[index] & mask(key)) != 0;
+  }
+
+  bool is_subset_of(const BitVectorSet& other) const {
+    if (m_dense && other.m_dense) {
+      if (m_words.size() > other.m_words.size()) {
+        return false;
+      }
+      Word extra = 0;
+      for (size_t i = 0; i < m_words.size(); ++i) {
+        extra |= m_words[i] & ~other.m_words[i];
+      }
+      return extra == 0;
+    }
+    if (!m_dense && !other.m_dense) {
+      return m_tree.is_subset_of(other.m_tree);
+    }
+    return std::all_of(
+        begin(), end(), [&other](Element x) { return other.contains(x); });
+  }
+
+  bool equals(const BitVectorSet& other) const {
+    if (m_dense && other.m_dense) {
+      return m_words == other.m_words;
+    }
+    if (!m_dense && !other.m_dense) {
+      return m_tree.equals(other.m_tree);
+    }
+    return size() == other.size() && is_subset_of(other);
+  }
+
+  friend bool operator==(const BitVectorSet& s1, const BitVectorSet& s2) {
+    return s1.equals(s2);
+  }
+
+  friend bool operator!=(const BitVectorSet& s1, const BitVectorSet& s2) {
+    return !s1.equals(s2);
+  }
+
+  BitVectorSet& insert(Element key) {
+    if (m_dense && key >= MaxDenseSize) {
+      to_tree();
+    }
+    if (!m_dense) {
+      m_tree.insert(key);
+      return *this;
+    }
+    size_t index = key / kWordBits;
+    if (index >= m_words.size()) {
+      m_words.resize(index + 1, 0);
+    }
+    m_words[index] |= mask(key);
+    return *this;
+  }
+
+  BitVectorSet& remove(Element key) {
+    if (!m_dense) {
+      m_tree.remove(key);
+      normalize_tree();
+      return *this;
+    }
+    size_t index = key / kWordBits;
+    if (index < m_words.size()) {
+      m_words[index] &= ~mask(key);
+      trim();
+    }
+    return *this;
+  }
+
+  BitVectorSet& filter(const std::function<bool(const Element&)>& predicate) {
+    if (!m_dense) {
+      m_tree.filter(predicate);
+      normalize_tree();
+      return *this;
+    }
+    for (Element x : *this) {
+      if (!predicate(x)) {
+        m_words[x / kWordBits] &= ~mask(x);
+      }
+    }
+    trim();
+    return *this;
+  }
+
+  BitVectorSet& union_with(const BitVectorSet& other) {
+    if (m_dense && other.m_dense) {
+      if (m_words.size() < other.m_words.size()) {
+        m_words.resize(other.m_words.size(), 0);
+      }
+      for (size_t i = 0; i < other.m_words.size(); ++i) {
+        m_words[i] |= other.m_words[i];
+      }
+      return *this;
+    }
+    if (m_dense) {
+      auto words = std::move(m_words);
+      *this = other;
+      for_each_bit(words, [this](Element x) { m_tree.insert(x); });
+      return *this;
+    }
+    if (other.m_dense) {
+      for_each_bit(other.m_words, [this](Element x) { m_tree.insert(x); });
+    } else {
+      m_tree.union_with(other.m_tree);
+    }
+    return *this;
+  }
+
+  BitVectorSet& intersection_with(const BitVectorSet& other) {
+    if (m_dense && other.m_dense) {
+      if (m_words.size() > other.m_words.size()) {
+        m_words.resize(other.m_words.size());
+      }
+      for (size_t i = 0; i < m_words.size(); ++i) {
+        m_words[i] &= other.m_words[i];
+      }
+      trim();
+      return *this;
+    }
+    if (m_dense) {
+      filter([&other](Element x) { return other.contains(x); });
+      return *this;
+    }
+    if (other.m_dense) {
+      // The intersection is bounded by the dense set, hence it's dense.
+      Tree tree = std::move(m_tree);
+      m_tree.clear();
+      m_dense = true;
+      for_each_bit(other.m_words, [this, &tree](Element x) {
+        if (tree.contains(x)) {
+          insert(x);
+        }
+      });
+      return *this;
+    }
+    m_tree.intersection_with(other.m_tree);
+    normalize_tree();
+    return *this;
+  }
+
+  BitVectorSet& difference_with(const BitVectorSet& other) {
+    if (m_dense && other.m_dense) {
+      size_t size = std::min(m_words.size(), other.m_words.size());
+      for (size_t i = 0; i < size; ++i) {
+        m_words[i] &= ~other.m_words[i];
+      }
+      trim();
+      return *this;
+    }
+    if (m_dense) {
+      filter([&other](Element x) { return !other.contains(x); });
+      return *this;
+    }
+    if (other.m_dense) {
+      for_each_bit(other.m_words, [this](Element x) { m_tree.remove(x); });
+    } else {
+      m_tree.difference_with(other.m_tree);
+    }
+    normalize_tree();
+    return *this;
+  }
+
+  BitVectorSet get_union_with(const BitVectorSet& other) const {
+    auto result = *this;
+    result.union_with(other);
+    return result;
+  }
+
+  BitVectorSet get_intersection_with(const BitVectorSet& other) const {
+    auto result = *this;
+    result.intersection_with(other);
+    return result;
+  }
+
+  BitVectorSet get_difference_with(const BitVectorSet& other) const {
+    auto result = *this;
+    result.difference_with(other);
+    return result;
+  }
+
+  void clear() {
+    m_words.clear();
+    m_tree.clear();
+    m_dense = true;
+  }
+
+  friend std::ostream& operator<<(std::ostream& o, const BitVectorSet& s) {
+    o << "{";
+    for (auto it = s.begin(), end = s.end(); it != end;) {
+      o << *it;
+      ++it;
+      if (it != end) {
+        o << ", ";
+      }
+    }
+    o << "}";
+    return o;
+  }
+
+  /*
+   * Iterates over the elements in increasing order when the set is dense, and
+   * in the order of the Patricia tree otherwise.
+   */
+  class iterator final {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Element;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Element*;
+    using reference = Element;
+
+    iterator() = default;
+
+    iterator& operator++() {
+      if (!m_dense) {
+        ++m_tree_it;
+        return *this;
+      }
+      // Clear the lowest bit set.
+      m_word &= m_word - 1;
+      skip_zero_words();
+      return *this;
+    }
+
+    iterator operator++(int) {
+      iterator retval(*this);
+      ++(*this);
+      return retval;
+    }
+
+    bool operator==(const iterator& other) const {
+      if (!m_dense) {
+        return m_tree_it == other.m_tree_it;
+      }
+      return m_current == other.m_current && m_word == other.m_word;
+    }
+
+    bool operator!=(const iterator& other) const { return !(*this == other); }
+
+    Element operator*() const {
+      if (!m_dense) {
+        return *m_tree_it;
+      }
+      return static_cast<Element>(
+          (m_current - m_first) * kWordBits + __builtin_ctzll(m_word));
+    }
+
+   private:
+    iterator(const Word* words, size_t size)
+        : m_first(words), m_current(words), m_last(words + size) {
+      if (m_current != m_last) {
+        m_word = *m_current;
+        skip_zero_words();
+      }
+    }
+
+    explicit iterator(typename Tree::iterator it)
+        : m_dense(false), m_tree_it(std::move(it)) {}
+
+    void skip_zero_words() {
+      while (m_word == 0 && m_current != m_last) {
+        if (++m_current != m_last) {
+          m_word = *m_current;
+        }
+      }
+    }
+
+    bool m_dense{true};
+    const Word* m_first{nullptr};
+    const Word* m_current{nullptr};
+    const Word* m_last{nullptr};
+    Word m_word{0};
+    // The dereference operator of Patricia tree iterators isn't const.
+    mutable typename Tree::iterator m_tree_it;
+
+    friend class BitVectorSet;
+  };
+
+ private:
+  static Word mask(Element x) { return Word(1) << (x % kWordBits); }
+
+  template <typename Visitor>
+  static void for_each_bit(const std::vector<Word>& words, Visitor visitor) {
+    for (size_t i = 0; i < words.size(); ++i) {
+      for (Word w = words[i]; w != 0; w &= w - 1) {
+        visitor(static_cast<Element>(i * kWordBits + __builtin_ctzll(w)));
+      }
+    }
+  }
+
+  // Dense sets don't have trailing zero words, so that equality is a plain
+  // comparison of the vectors.
+  void trim() {
+    while (!m_words.empty() && m_words.back() == 0) {
+      m_words.pop_back();
+    }
+  }
+
+  void to_tree() {
+    for_each_bit(m_words, [this](Element x) { m_tree.insert(x); });
+    m_words.clear();
+    m_dense = false;
+  }
+
+  void normalize_tree() {
+    if (m_tree.empty()) {
+      m_dense = true;
+    }
+  }
+
+  bool m_dense{true};
+  std::vector<Word> m_words;
+  Tree m_tree;
+};
+
+} // namespace sparta
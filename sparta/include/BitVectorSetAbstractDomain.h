@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <initializer_list>
+
+#include "BitVectorSet.h"
+#include "PowersetAbstractDomain.h"
+
+namespace sparta {
+
+namespace bvsad_impl {
+
+/*
+ * An abstract value from a powerset is implemented as a bit vector set.
+ */
+template <typename Element, size_t MaxDenseSize>
+class SetValue final
+    : public PowersetImplementation<
+          Element,
+          const BitVectorSet<Element, MaxDenseSize>&,
+          SetValue<Element, MaxDenseSize>> {
+ public:
+  using Set = BitVectorSet<Element, MaxDenseSize>;
+
+  SetValue() = default;
+
+  SetValue(const Element& e) { m_set.insert(e); }
+
+  SetValue(std::initializer_list<Element> l) : m_set(l.begin(), l.end()) {}
+
+  SetValue(const Set& set) : m_set(set) {}
+
+  const Set& elements() const override { return m_set; }
+
+  size_t size() const override { return m_set.size(); }
+
+  bool contains(const Element& e) const override { return m_set.contains(e); }
+
+  void add(const Element& e) override { m_set.insert(e); }
+
+  void remove(const Element& e) override { m_set.remove(e); }
+
+  void clear() override { m_set.clear(); }
+
+  AbstractValueKind kind() const override { return AbstractValueKind::Value; }
+
+  bool leq(const SetValue& other) const override {
+    return m_set.is_subset_of(other.m_set);
+  }
+
+  bool equals(const SetValue& other) const override {
+    return m_set.equals(other.m_set);
+  }
+
+  AbstractValueKind join_with(const SetValue& other) override {
+    m_set.union_with(other.m_set);
+    return AbstractValueKind::Value;
+  }
+
+  AbstractValueKind meet_with(const SetValue& other) override {
+    m_set.intersection_with(other.m_set);
+    return AbstractValueKind::Value;
+  }
+
+  AbstractValueKind difference_with(const SetValue& other) override {
+    m_set.difference_with(other.m_set);
+    return AbstractValueKind::Value;
+  }
+
+  friend std::ostream& operator<<(std::ostream& o, const SetValue& value) {
+    o << "[#" << value.size() << "]";
+    o << value.m_set;
+    return o;
+  }
+
+ private:
+  Set m_set;
+};
+
+} // namespace bvsad_impl
+
+/*
+ * An implementation of powerset abstract domains over small universes of
+ * unsigned integers, using bit vectors (see BitVectorSet.h). This is much
+ * faster than PatriciaTreeSetAbstractDomain for sets of registers, like in a
+ * liveness analysis. Sets that contain an element greater than or equal to
+ * `MaxDenseSize` fall back to Patricia trees.
+ */
+template <typename Element, size_t MaxDenseSize = 1024>
+class BitVectorSetAbstractDomain final
+    : public PowersetAbstractDomain<
+          Element,
+          bvsad_impl::SetValue<Element, MaxDenseSize>,
+          const BitVectorSet<Element, MaxDenseSize>&,
+          BitVectorSetAbstractDomain<Element, MaxDenseSize>> {
+ public:
+  using Value = bvsad_impl::SetValue<Element, MaxDenseSize>;
+  using Set = BitVectorSet<Element, MaxDenseSize>;
+
+  BitVectorSetAbstractDomain()
+      : PowersetAbstractDomain<Element,
+                               Value,
+                               const Set&,
+                               BitVectorSetAbstractDomain>() {}
+
+  BitVectorSetAbstractDomain(AbstractValueKind kind)
+      : PowersetAbstractDomain<Element,
+                               Value,
+                               const Set&,
+                               BitVectorSetAbstractDomain>(kind) {}
+
+  explicit BitVectorSetAbstractDomain(const Element& e) {
+    this->set_to_value(Value(e));
+  }
+
+  explicit BitVectorSetAbstractDomain(std::initializer_list<Element> l) {
+    this->set_to_value(Value(l));
+  }
+
+  explicit BitVectorSetAbstractDomain(const Set& set) {
+    this->set_to_value(Value(set));
+  }
+
+  static BitVectorSetAbstractDomain bottom() {
+    return BitVectorSetAbstractDomain(AbstractValueKind::Bottom);
+  }
+
+  static BitVectorSetAbstractDomain top() {
+    return BitVectorSetAbstractDomain(AbstractValueKind::Top);
+  }
+};
+
+} // namespace sparta
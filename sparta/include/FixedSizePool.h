@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <vector>
+
+/*
+ * A thread-caching allocator for small objects of one size, for data
+ * structures that create and destroy many of them from several threads, like
+ * the nodes of Patricia trees.
+ *
+ * Each thread carves objects out of large slabs, in address order, so that
+ * objects created one after another end up next to each other. Freed objects
+ * go onto a per-thread free list. Lists that grow large, and the lists of
+ * exiting threads, are handed to a shared depot, where other threads pick
+ * them up. Slabs are never returned to the system.
+ *
+ * Pooling is compiled out under AddressSanitizer, so that use-after-free and
+ * leak checking keep working, and when SPARTA_FIXED_SIZE_POOL_DISABLED is
+ * defined.
+ */
+
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define SPARTA_FIXED_SIZE_POOL_DISABLED 1
+#endif
+#endif
+#if defined(__SANITIZE_ADDRESS__) && !defined(SPARTA_FIXED_SIZE_POOL_DISABLED)
+#define SPARTA_FIXED_SIZE_POOL_DISABLED 1
+#endif
+
+namespace sparta {
+
+template <size_t kSize, size_t kAlign>
+class FixedSizePool {
+ public:
+  static void* allocate() {
+    if (cache_destroyed()) {
+      // Any memory will do, because slots are never returned to the system.
+      return ::operator new(kSlotSize, std::align_val_t(kAlignment));
+    }
+    auto& cache = thread_cache();
+    if (cache.free_list == nullptr) {
+      if (size_t(cache.bump_end - cache.bump) >= kSlotSize) {
+        void* p = cache.bump;
+        cache.bump += kSlotSize;
+        return p;
+      }
+      refill(cache);
+    }
+    FreeNode* node = cache.free_list;
+    cache.free_list = node->next;
+    --cache.num_free;
+    return node;
+  }
+
+  static void deallocate(void* p) {
+    auto* node = static_cast<FreeNode*>(p);
+    if (cache_destroyed()) {
+      node->next = nullptr;
+      depot().put(node, node, 1);
+      return;
+    }
+    auto& cache = thread_cache();
+    node->next = cache.free_list;
+    if (cache.free_list == nullptr) {
+      cache.free_tail = node;
+    }
+    cache.free_list = node;
+    if (++cache.num_free >= kBatchSize) {
+      depot().put(cache.free_list, cache.free_tail, cache.num_free);
+      cache.free_list = cache.free_tail = nullptr;
+      cache.num_free = 0;
+    }
+  }
+
+ private:
+  struct FreeNode {
+    FreeNode* next;
+  };
+
+  static constexpr size_t kAlignment = std::max(kAlign, alignof(FreeNode));
+  static constexpr size_t kSlotSize =
+      (std::max(kSize, sizeof(FreeNode)) + kAlignment - 1) / kAlignment *
+      kAlignment;
+  static constexpr size_t kSlabSize = std::max<size_t>(64 * 1024, kSlotSize);
+  static constexpr size_t kBatchSize = 4096;
+
+  struct Batch {
+    FreeNode* head;
+    FreeNode* tail;
+    size_t size;
+  };
+
+  struct Depot {
+    std::mutex mutex;
+    std::vector<Batch> batches;
+
+    void put(FreeNode* head, FreeNode* tail, size_t size) {
+      std::lock_guard<std::mutex> lock(mutex);
+      batches.push_back(Batch{head, tail, size});
+    }
+
+    bool take(Batch* batch) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (batches.empty()) {
+        return false;
+      }
+      *batch = batches.back();
+      batches.pop_back();
+      return true;
+    }
+  };
+
+  struct ThreadCache {
+    FreeNode* free_list{nullptr};
+    FreeNode* free_tail{nullptr};
+    size_t num_free{0};
+    char* bump{nullptr};
+    char* bump_end{nullptr};
+
+    ~ThreadCache() {
+      // Carve the unused rest of the slab into free nodes, then hand
+      // everything to the depot so other threads can reuse it.
+      while (size_t(bump_end - bump) >= kSlotSize) {
+        auto* node = reinterpret_cast<FreeNode*>(bump);
+        bump += kSlotSize;
+        node->next = free_list;
+        if (free_list == nullptr) {
+          free_tail = node;
+        }
+        free_list = node;
+        ++num_free;
+      }
+      if (free_list != nullptr) {
+        depot().put(free_list, free_tail, num_free);
+      }
+      cache_destroyed() = true;
+    }
+  };
+
+  // Objects may still be freed during the exit of a thread, after its cache
+  // is gone. A trivially destructible flag outlives the cache.
+  static bool& cache_destroyed() {
+    thread_local bool destroyed = false;
+    return destroyed;
+  }
+
+  static ThreadCache& thread_cache() {
+    thread_local ThreadCache cache;
+    return cache;
+  }
+
+  static Depot& depot() {
+    // Intentionally leaked, as thread caches may be destroyed after static
+    // destructors have run.
+    static auto* depot = new Depot();
+    return *depot;
+  }
+
+  static void refill(ThreadCache& cache) {
+    Batch batch;
+    if (depot().take(&batch)) {
+      cache.free_list = batch.head;
+      cache.free_tail = batch.tail;
+      cache.num_free = batch.size;
+      return;
+    }
+    cache.bump = static_cast<char*>(
+        ::operator new(kSlabSize, std::align_val_t(kAlignment)));
+    cache.bump_end = cache.bump + kSlabSize;
+    // Serve the first slot right away.
+    cache.free_list = reinterpret_cast<FreeNode*>(cache.bump);
+    cache.free_list->next = nullptr;
+    cache.free_tail = cache.free_list;
+    cache.num_free = 1;
+    cache.bump += kSlotSize;
+  }
+};
+
+/*
+ * For the class-specific `operator new` and `operator delete` of T. Requests
+ * for other sizes, e.g. from subclasses, go to the global allocator.
+ */
+template <typename T>
+inline void* pooled_allocate(size_t size) {
+#ifndef SPARTA_FIXED_SIZE_POOL_DISABLED
+  if (size == sizeof(T)) {
+    return FixedSizePool<sizeof(T), alignof(T)>::allocate();
+  }
+#endif
+  return ::operator new(size);
+}
+
+template <typename T>
+inline void pooled_deallocate(void* ptr, size_t size) {
+  if (ptr == nullptr) {
+    return;
+  }
+#ifndef SPARTA_FIXED_SIZE_POOL_DISABLED
+  if (size == sizeof(T)) {
+    FixedSizePool<sizeof(T), alignof(T)>::deallocate(ptr);
+    return;
+  }
+#endif
+  ::operator delete(ptr);
+}
+
+} // namespace sparta
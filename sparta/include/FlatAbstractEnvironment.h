@@ -0,0 +1,517 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <boost/container/small_vector.hpp>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <ostream>
+#include <type_traits>
+#include <utility>
+
+#include "AbstractDomain.h"
+#include "PatriciaTreeMap.h"
+
+namespace sparta {
+
+namespace fae_impl {
+
+template <typename Variable, typename Domain, size_t MaxInline>
+class MapValue;
+
+} // namespace fae_impl
+
+/*
+ * An abstract environment over small unsigned integer variables, typically
+ * registers, that keeps up to `MaxInline` bindings in a sorted array stored
+ * inline in the environment. Beyond that, the bindings move to a Patricia
+ * tree.
+ *
+ * Most methods use only a handful of registers, and for those the lattice
+ * operations are a linear merge over a few contiguous entries instead of a
+ * walk over heap-allocated tree nodes. The interface is the same as
+ * PatriciaTreeMapAbstractEnvironment's, except that bindings are read with
+ * `visit()` since they don't always live in a PatriciaTreeMap.
+ *
+ * As in PatriciaTreeMapAbstractEnvironment, bindings to Top are not stored.
+ */
+template <typename Variable, typename Domain, size_t MaxInline = 16>
+class FlatAbstractEnvironment final
+    : public AbstractDomainScaffolding<
+          fae_impl::MapValue<Variable, Domain, MaxInline>,
+          FlatAbstractEnvironment<Variable, Domain, MaxInline>> {
+ public:
+  using Value = fae_impl::MapValue<Variable, Domain, MaxInline>;
+
+  /*
+   * The default constructor produces the Top value.
+   */
+  FlatAbstractEnvironment()
+      : AbstractDomainScaffolding<Value, FlatAbstractEnvironment>() {}
+
+  FlatAbstractEnvironment(AbstractValueKind kind)
+      : AbstractDomainScaffolding<Value, FlatAbstractEnvironment>(kind) {}
+
+  FlatAbstractEnvironment(
+      std::initializer_list<std::pair<Variable, Domain>> l) {
+    for (const auto& p : l) {
+      if (p.second.is_bottom()) {
+        this->set_to_bottom();
+        return;
+      }
+      this->get_value()->insert_binding(p.first, p.second);
+    }
+    this->normalize();
+  }
+
+  size_t size() const {
+    RUNTIME_CHECK(this->kind() == AbstractValueKind::Value,
+                  invalid_abstract_value()
+                      << expected_kind(AbstractValueKind::Value)
+                      << actual_kind(this->kind()));
+    return this->get_value()->size();
+  }
+
+  /*
+   * Calls `f` on every binding. The order is unspecified.
+   */
+  void visit(
+      const std::function<void(const Variable&, const Domain&)>& f) const {
+    RUNTIME_CHECK(this->kind() == AbstractValueKind::Value,
+                  invalid_abstract_value()
+                      << expected_kind(AbstractValueKind::Value)
+                      << actual_kind(this->kind()));
+    this->get_value()->visit(f);
+  }
+
+  const Domain& get(const Variable& variable) const {
+    if (this->is_bottom()) {
+      static const Domain bottom = Domain::bottom();
+      return bottom;
+    }
+    return this->get_value()->at(variable);
+  }
+
+  FlatAbstractEnvironment& set(const Variable& variable, const Domain& value) {
+    if (this->is_bottom()) {
+      return *this;
+    }
+    if (value.is_bottom()) {
+      this->set_to_bottom();
+      return *this;
+    }
+    this->get_value()->insert_binding(variable, value);
+    this->normalize();
+    return *this;
+  }
+
+  bool map(std::function<Domain(const Domain&)> f) {
+    if (this->is_bottom()) {
+      return false;
+    }
+    bool res = this->get_value()->map(f);
+    this->normalize();
+    return res;
+  }
+
+  bool erase_all_matching(const Variable& variable_mask) {
+    if (this->is_bottom()) {
+      return false;
+    }
+    bool res = this->get_value()->erase_all_matching(variable_mask);
+    this->normalize();
+    return res;
+  }
+
+  FlatAbstractEnvironment& clear() {
+    if (this->is_bottom()) {
+      return *this;
+    }
+    this->get_value()->clear();
+    this->normalize();
+    return *this;
+  }
+
+  FlatAbstractEnvironment& update(
+      const Variable& variable,
+      std::function<Domain(const Domain&)> operation) {
+    if (this->is_bottom()) {
+      return *this;
+    }
+    return set(variable, operation(get(variable)));
+  }
+
+  static FlatAbstractEnvironment bottom() {
+    return FlatAbstractEnvironment(AbstractValueKind::Bottom);
+  }
+
+  static FlatAbstractEnvironment top() {
+    return FlatAbstractEnvironment(AbstractValueKind::Top);
+  }
+};
+
+} // namespace sparta
+
+template <typename Variable, typename Domain, size_t MaxInline>
+inline std::ostream& operator<<(
+    std::ostream& o,
+    const typename sparta::FlatAbstractEnvironment<Variable, Domain, MaxInline>&
+        e) {
+  using namespace sparta;
+  switch (e.kind()) {
+  case AbstractValueKind::Bottom: {
+    o << "_|_";
+    break;
+  }
+  case AbstractValueKind::Top: {
+    o << "T";
+    break;
+  }
+  case AbstractValueKind::Value: {
+    o << "[#" << e.size() << "]{";
+    bool first = true;
+    e.visit([&](const Variable& variable, const Domain& value) {
+      if (!first) {
+        o << ", ";
+      }
+      first = false;
+      o << variable << " -> " << value;
+    });
+    o << "}";
+    break;
+  }
+  }
+  return o;
+}
+
+namespace sparta {
+
+namespace fae_impl {
+
+class value_is_bottom {};
+
+/*
+ * The bindings of a FlatAbstractEnvironment. They are held either in the
+ * sorted inline array `m_flat` or, once there are more than `MaxInline` of
+ * them, in the Patricia tree `m_tree`; never in both. An operation between
+ * the two representations is carried out on trees. A tree that a join has
+ * shrunk back to `MaxInline` bindings or fewer is flattened again; other
+ * operations leave it as is, which avoids flip-flopping around the
+ * threshold.
+ */
+template <typename Variable, typename Domain, size_t MaxInline>
+class MapValue final
+    : public AbstractValue<MapValue<Variable, Domain, MaxInline>> {
+  static_assert(std::is_unsigned<Variable>::value,
+                "FlatAbstractEnvironment variables must be unsigned integers");
+  static_assert(MaxInline > 0, "MaxInline must be positive");
+
+ public:
+  struct ValueInterface {
+    using type = Domain;
+
+    static type default_value() { return type::top(); }
+
+    static bool is_default_value(const type& x) { return x.is_top(); }
+
+    static bool equals(const type& x, const type& y) { return x.equals(y); }
+
+    static bool leq(const type& x, const type& y) { return x.leq(y); }
+  };
+
+  using Binding = std::pair<Variable, Domain>;
+  using FlatMap = boost::container::small_vector<Binding, MaxInline>;
+  using TreeMap = PatriciaTreeMap<Variable, Domain, ValueInterface>;
+  using Operation = std::function<Domain(const Domain&, const Domain&)>;
+
+  MapValue() = default;
+
+  void clear() override {
+    m_flat.clear();
+    m_tree.clear();
+    m_is_tree = false;
+  }
+
+  AbstractValueKind kind() const override {
+    // If there are no bindings, then all variables are implicitly bound to
+    // Top, i.e., the abstract environment itself is Top.
+    bool empty = m_is_tree ? m_tree.empty() : m_flat.empty();
+    return empty ? AbstractValueKind::Top : AbstractValueKind::Value;
+  }
+
+  bool leq(const MapValue& other) const override {
+    if (m_is_tree || other.m_is_tree) {
+      return as_tree().leq(other.as_tree());
+    }
+    // A variable bound in `other` but not here is Top here, which can't be
+    // below the non-Top value it has in `other`.
+    auto it = m_flat.begin();
+    for (const auto& binding : other.m_flat) {
+      it = lower_bound(it, m_flat.end(), binding.first);
+      if (it == m_flat.end() || it->first != binding.first ||
+          !it->second.leq(binding.second)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool equals(const MapValue& other) const override {
+    if (m_is_tree || other.m_is_tree) {
+      return as_tree().equals(other.as_tree());
+    }
+    return m_flat.size() == other.m_flat.size() &&
+           std::equal(m_flat.begin(), m_flat.end(), other.m_flat.begin(),
+                      [](const Binding& x, const Binding& y) {
+                        return x.first == y.first && x.second.equals(y.second);
+                      });
+  }
+
+  AbstractValueKind join_with(const MapValue& other) override {
+    return join_like_operation(
+        other, [](const Domain& x, const Domain& y) { return x.join(y); });
+  }
+
+  AbstractValueKind widen_with(const MapValue& other) override {
+    return join_like_operation(
+        other, [](const Domain& x, const Domain& y) { return x.widening(y); });
+  }
+
+  AbstractValueKind meet_with(const MapValue& other) override {
+    return meet_like_operation(
+        other, [](const Domain& x, const Domain& y) { return x.meet(y); });
+  }
+
+  AbstractValueKind narrow_with(const MapValue& other) override {
+    return meet_like_operation(
+        other, [](const Domain& x, const Domain& y) { return x.narrowing(y); });
+  }
+
+ private:
+  template <typename Iterator>
+  static Iterator lower_bound(Iterator begin,
+                              Iterator end,
+                              const Variable& variable) {
+    return std::lower_bound(
+        begin, end, variable,
+        [](const Binding& x, const Variable& v) { return x.first < v; });
+  }
+
+  size_t size() const { return m_is_tree ? m_tree.size() : m_flat.size(); }
+
+  const Domain& at(const Variable& variable) const {
+    if (m_is_tree) {
+      return m_tree.at(variable);
+    }
+    auto it = lower_bound(m_flat.begin(), m_flat.end(), variable);
+    if (it == m_flat.end() || it->first != variable) {
+      static const Domain top = Domain::top();
+      return top;
+    }
+    return it->second;
+  }
+
+  void visit(
+      const std::function<void(const Variable&, const Domain&)>& f) const {
+    if (m_is_tree) {
+      for (const auto& binding : m_tree) {
+        f(binding.first, binding.second);
+      }
+    } else {
+      for (const auto& binding : m_flat) {
+        f(binding.first, binding.second);
+      }
+    }
+  }
+
+  void insert_binding(const Variable& variable, const Domain& value) {
+    // The Bottom value is handled by the caller and should never occur here.
+    RUNTIME_CHECK(!value.is_bottom(), internal_error());
+    if (m_is_tree) {
+      m_tree.insert_or_assign(variable, value);
+      return;
+    }
+    auto it = lower_bound(m_flat.begin(), m_flat.end(), variable);
+    bool found = it != m_flat.end() && it->first == variable;
+    if (value.is_top()) {
+      if (found) {
+        m_flat.erase(it);
+      }
+    } else if (found) {
+      it->second = value;
+    } else {
+      m_flat.emplace(it, variable, value);
+      if (m_flat.size() > MaxInline) {
+        to_tree();
+      }
+    }
+  }
+
+  bool map(std::function<Domain(const Domain&)>& f) {
+    if (m_is_tree) {
+      return m_tree.map(f);
+    }
+    bool changed = false;
+    FlatMap new_flat;
+    for (const auto& binding : m_flat) {
+      Domain value = f(binding.second);
+      if (!value.equals(binding.second)) {
+        changed = true;
+      }
+      if (!value.is_top()) {
+        new_flat.emplace_back(binding.first, std::move(value));
+      }
+    }
+    m_flat = std::move(new_flat);
+    return changed;
+  }
+
+  bool erase_all_matching(const Variable& variable_mask) {
+    if (m_is_tree) {
+      return m_tree.erase_all_matching(variable_mask);
+    }
+    auto it = std::remove_if(m_flat.begin(), m_flat.end(),
+                             [variable_mask](const Binding& binding) {
+                               return (binding.first & variable_mask) != 0;
+                             });
+    bool changed = it != m_flat.end();
+    m_flat.erase(it, m_flat.end());
+    return changed;
+  }
+
+  AbstractValueKind join_like_operation(const MapValue& other,
+                                        const Operation& operation) {
+    if (m_is_tree || other.m_is_tree) {
+      to_tree();
+      m_tree.intersection_with(operation, other.as_tree());
+      if (m_tree.size() <= MaxInline) {
+        to_flat();
+      }
+      return kind();
+    }
+    // Variables bound on one side only are Top on the other, and so in the
+    // result.
+    FlatMap result;
+    auto it = m_flat.begin();
+    auto other_it = other.m_flat.begin();
+    while (it != m_flat.end() && other_it != other.m_flat.end()) {
+      if (it->first < other_it->first) {
+        ++it;
+      } else if (other_it->first < it->first) {
+        ++other_it;
+      } else {
+        Domain value = operation(it->second, other_it->second);
+        if (!value.is_top()) {
+          result.emplace_back(it->first, std::move(value));
+        }
+        ++it;
+        ++other_it;
+      }
+    }
+    m_flat = std::move(result);
+    return kind();
+  }
+
+  AbstractValueKind meet_like_operation(const MapValue& other,
+                                        const Operation& operation) {
+    if (m_is_tree || other.m_is_tree) {
+      to_tree();
+      try {
+        m_tree.union_with(
+            [&operation](const Domain& x, const Domain& y) {
+              Domain result = operation(x, y);
+              if (result.is_bottom()) {
+                throw value_is_bottom();
+              }
+              return result;
+            },
+            other.as_tree());
+        return kind();
+      } catch (const value_is_bottom&) {
+        clear();
+        return AbstractValueKind::Bottom;
+      }
+    }
+    FlatMap result;
+    auto it = m_flat.begin();
+    auto other_it = other.m_flat.begin();
+    while (it != m_flat.end() || other_it != other.m_flat.end()) {
+      if (other_it == other.m_flat.end() ||
+          (it != m_flat.end() && it->first < other_it->first)) {
+        result.push_back(*it++);
+      } else if (it == m_flat.end() || other_it->first < it->first) {
+        result.push_back(*other_it++);
+      } else {
+        Domain value = operation(it->second, other_it->second);
+        if (value.is_bottom()) {
+          clear();
+          return AbstractValueKind::Bottom;
+        }
+        if (!value.is_top()) {
+          result.emplace_back(it->first, std::move(value));
+        }
+        ++it;
+        ++other_it;
+      }
+    }
+    m_flat = std::move(result);
+    if (m_flat.size() > MaxInline) {
+      to_tree();
+    }
+    return kind();
+  }
+
+  // The bindings as a Patricia tree, building a temporary one if they are
+  // stored inline.
+  TreeMap as_tree() const {
+    if (m_is_tree) {
+      return m_tree;
+    }
+    TreeMap tree;
+    for (const auto& binding : m_flat) {
+      tree.insert_or_assign(binding.first, binding.second);
+    }
+    return tree;
+  }
+
+  void to_tree() {
+    if (m_is_tree) {
+      return;
+    }
+    m_tree = as_tree();
+    m_flat.clear();
+    m_is_tree = true;
+  }
+
+  void to_flat() {
+    m_flat.clear();
+    for (const auto& binding : m_tree) {
+      m_flat.emplace_back(binding.first, binding.second);
+    }
+    // Patricia trees aren't ordered by key.
+    std::sort(m_flat.begin(), m_flat.end(),
+              [](const Binding& x, const Binding& y) {
+                return x.first < y.first;
+              });
+    m_tree.clear();
+    m_is_tree = false;
+  }
+
+  FlatMap m_flat;
+  TreeMap m_tree;
+  bool m_is_tree{false};
+
+  template <typename T1, typename T2, size_t N>
+  friend class sparta::FlatAbstractEnvironment;
+};
+
+} // namespace fae_impl
+
+} // namespace sparta
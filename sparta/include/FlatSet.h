@@ -24,14 +24,18 @@ namespace sparta {
  * It is similar to `boost::container::flat_set` but provides set operations
  * such as union, intersection and difference, using the same interface as
  * `PatriciaTreeSet`.
+ *
+ * Like for `boost::container::flat_set`, the vector type can be changed, e.g.
+ * to a `boost::container::small_vector` to keep small sets inline.
  */
 template <typename Element,
           typename Compare = std::less<Element>,
-          typename Equal = std::equal_to<Element>>
+          typename Equal = std::equal_to<Element>,
+          typename Container = std::vector<Element>>
 class FlatSet final {
  public:
   // C++ container concept member types
-  using iterator = typename std::vector<Element>::const_iterator;
+  using iterator = typename Container::const_iterator;
   using const_iterator = iterator;
   using value_type = Element;
   using difference_type = std::ptrdiff_t;
@@ -128,6 +132,10 @@ class FlatSet final {
   }
 
   FlatSet& union_with(const FlatSet& other) {
+    if (other.m_vector.size() * kSearchRatio >= m_vector.size()) {
+      merge_with(other);
+      return *this;
+    }
     // This is optimized for `this.size() >> other.size()`.
     auto it = m_vector.begin();
     auto other_it = other.m_vector.begin(), other_end = other.m_vector.end();
@@ -143,12 +151,21 @@ class FlatSet final {
   }
 
   FlatSet& intersection_with(const FlatSet& other) {
-    // This is optimized for `this.size() << other.size()`.
+    // Binary searches are only worth it for `this.size() << other.size()`,
+    // otherwise this is a linear merge.
+    const bool search =
+        m_vector.size() * kSearchRatio < other.m_vector.size();
     auto first = m_vector.begin(); // Where to write the next element to keep.
     auto it = m_vector.begin(), end = m_vector.end();
     auto other_it = other.m_vector.begin(), other_end = other.m_vector.end();
     while (it != end) {
-      other_it = std::lower_bound(other_it, other_end, *it, Compare());
+      if (search) {
+        other_it = std::lower_bound(other_it, other_end, *it, Compare());
+      } else {
+        while (other_it != other_end && Compare()(*other_it, *it)) {
+          ++other_it;
+        }
+      }
       if (other_it != other_end && Equal()(*it, *other_it)) {
         if (first != it) {
           *first = std::move(*it);
@@ -209,7 +226,7 @@ class FlatSet final {
 
   void clear() { m_vector.clear(); }
 
-  friend std::ostream& operator<<(std::ostream& o, const FlatSet<Element>& s) {
+  friend std::ostream& operator<<(std::ostream& o, const FlatSet& s) {
     o << "{";
     for (auto it = s.begin(), end = s.end(); it != end;) {
       o << pt_util::Dereference<Element>()(*it);
@@ -223,7 +240,53 @@ class FlatSet final {
   }
 
  private:
-  std::vector<Element> m_vector;
+  // Below this ratio of the sizes of two sets, binary searches in the bigger
+  // set cost more than a linear merge.
+  constexpr static std::size_t kSearchRatio = 8;
+
+  // Linear merge of `other` into this set, in place. It counts the elements
+  // of the union first, so that nothing is written if `other` is a subset of
+  // this set, which is the common case of joins at a fixpoint. Otherwise, it
+  // grows the vector once and merges from the back, which never overwrites
+  // an element of this set that was not merged yet.
+  void merge_with(const FlatSet& other) {
+    std::size_t num_new = 0;
+    {
+      auto it = m_vector.cbegin(), end = m_vector.cend();
+      for (const auto& e : other.m_vector) {
+        while (it != end && Compare()(*it, e)) {
+          ++it;
+        }
+        if (it == end || !Equal()(*it, e)) {
+          ++num_new;
+        } else {
+          ++it;
+        }
+      }
+    }
+    if (num_new == 0) {
+      return;
+    }
+
+    std::size_t i = m_vector.size();
+    std::size_t j = other.m_vector.size();
+    m_vector.resize(i + num_new);
+    std::size_t out = m_vector.size();
+    while (j > 0) {
+      const auto& e = other.m_vector[j - 1];
+      if (i > 0 && Compare()(e, m_vector[i - 1])) {
+        m_vector[--out] = std::move(m_vector[--i]);
+      } else {
+        if (i > 0 && Equal()(e, m_vector[i - 1])) {
+          --i;
+        }
+        m_vector[--out] = e;
+        --j;
+      }
+    }
+  }
+
+  Container m_vector;
 };
 
 } // namespace sparta
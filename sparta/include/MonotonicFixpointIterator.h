@@ -8,10 +8,19 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <memory>
+#include <queue>
+#include <tuple>
 #include <type_traits>
+#include <typeinfo>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "AbstractDomain.h"
@@ -22,8 +31,111 @@
 
 namespace sparta {
 
+/*
+ * Counters describing the work done by a fixpoint iterator, accumulated over
+ * all its runs; see `MonotonicFixpointIteratorBase::enable_stats`. Joins
+ * count both the joins of predecessor states into an entry state and the
+ * joins performed by the default extrapolation; widenings only count those of
+ * the default extrapolation.
+ */
+struct FixpointIteratorStats {
+  uint64_t node_visits{0};
+  uint64_t edge_visits{0};
+  uint64_t joins{0};
+  uint64_t widenings{0};
+  uint64_t analyze_node_ns{0};
+  uint64_t analyze_edge_ns{0};
+
+  FixpointIteratorStats& operator+=(const FixpointIteratorStats& that) {
+    node_visits += that.node_visits;
+    edge_visits += that.edge_visits;
+    joins += that.joins;
+    widenings += that.widenings;
+    analyze_node_ns += that.analyze_node_ns;
+    analyze_edge_ns += that.analyze_edge_ns;
+    return *this;
+  }
+};
+
+/*
+ * Clients can observe the runs of all monotonic fixpoint iterators, e.g., to
+ * attribute the memory allocated during a run to its abstract domain. The
+ * observer is notified on the thread that invokes `run`. Runs may be nested,
+ * like the intraprocedural analyses performed within an interprocedural one.
+ */
+class FixpointRunObserver {
+ public:
+  virtual ~FixpointRunObserver() = default;
+
+  virtual void begin_run(const std::type_info& domain) = 0;
+
+  virtual void end_run() = 0;
+};
+
+// The observer must outlive all the runs that start while it's installed.
+inline std::atomic<FixpointRunObserver*>& fixpoint_run_observer() {
+  static std::atomic<FixpointRunObserver*> observer{nullptr};
+  return observer;
+}
+
 namespace fp_impl {
 
+template <typename Domain>
+class ScopedRunObservation final {
+ public:
+  ScopedRunObservation()
+      : m_observer(fixpoint_run_observer().load(std::memory_order_acquire)) {
+    if (m_observer != nullptr) {
+      m_observer->begin_run(typeid(Domain));
+    }
+  }
+
+  ~ScopedRunObservation() {
+    if (m_observer != nullptr) {
+      m_observer->end_run();
+    }
+  }
+
+ private:
+  FixpointRunObserver* m_observer;
+};
+
+/*
+ * The parallel fixpoint iterator analyzes several nodes at once, so the
+ * counters are updated atomically.
+ */
+class AtomicFixpointIteratorStats final {
+ public:
+  void add(std::atomic<uint64_t>& counter, uint64_t n = 1) {
+    counter.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  FixpointIteratorStats snapshot() const {
+    FixpointIteratorStats stats;
+    stats.node_visits = node_visits.load(std::memory_order_relaxed);
+    stats.edge_visits = edge_visits.load(std::memory_order_relaxed);
+    stats.joins = joins.load(std::memory_order_relaxed);
+    stats.widenings = widenings.load(std::memory_order_relaxed);
+    stats.analyze_node_ns = analyze_node_ns.load(std::memory_order_relaxed);
+    stats.analyze_edge_ns = analyze_edge_ns.load(std::memory_order_relaxed);
+    return stats;
+  }
+
+  std::atomic<uint64_t> node_visits{0};
+  std::atomic<uint64_t> edge_visits{0};
+  std::atomic<uint64_t> joins{0};
+  std::atomic<uint64_t> widenings{0};
+  std::atomic<uint64_t> analyze_node_ns{0};
+  std::atomic<uint64_t> analyze_edge_ns{0};
+};
+
+inline uint64_t nanoseconds_since(
+    const std::chrono::steady_clock::time_point& start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
 /*
  * This data structure contains the current state of the fixpoint iteration,
  * which is provided to the user when an extrapolation step is executed, so as
@@ -128,20 +240,46 @@ class MonotonicFixpointIteratorBase
    * very significant impact on the precision of the final result. This method
    * gives the user a way to parameterize the application of the widening
    * operator. A default widening strategy is provided, which applies the join
-   * at the first iteration and then the widening at all subsequent iterations
-   * until the limit is reached.
+   * for the first iterations (see `set_widening_delay`) and then the widening
+   * at all subsequent iterations until the limit is reached.
    */
   virtual void extrapolate(const Context& context,
                            const NodeId& node,
                            Domain* current_state,
                            const Domain& new_state) const {
-    if (context.get_local_iterations_for(node) == 0) {
+    if (context.get_local_iterations_for(node) < m_widening_delay) {
+      count(&AtomicFixpointIteratorStats::joins);
       current_state->join_with(new_state);
     } else {
+      count(&AtomicFixpointIteratorStats::widenings);
       current_state->widen_with(new_state);
     }
   }
 
+  /*
+   * The number of iterations of a component in which the default
+   * extrapolation joins before it starts widening. The default of 1 widens
+   * from the second iteration on. Larger delays trade iterations for
+   * precision.
+   */
+  void set_widening_delay(uint32_t delay) { m_widening_delay = delay; }
+
+  /*
+   * Starts counting the work done by the iterator, including the time spent
+   * in `analyze_node` and `analyze_edge`. This isn't free, hence off by
+   * default.
+   */
+  void enable_stats() {
+    if (m_stats == nullptr) {
+      m_stats = std::make_unique<AtomicFixpointIteratorStats>();
+    }
+  }
+
+  // All zeros unless `enable_stats` was called.
+  FixpointIteratorStats get_stats() const {
+    return m_stats == nullptr ? FixpointIteratorStats() : m_stats->snapshot();
+  }
+
   /*
    * Returns the invariant computed by the fixpoint iterator at a node entry.
    */
@@ -192,8 +330,18 @@ class MonotonicFixpointIteratorBase
       entry_state->join_with(context->get_initial_value());
     }
     for (EdgeId edge : GraphInterface::predecessors(m_graph, node)) {
-      entry_state->join_with(this->analyze_edge(
-          edge, get_exit_state_at(GraphInterface::source(m_graph, edge))));
+      if (m_stats == nullptr) {
+        entry_state->join_with(this->analyze_edge(
+            edge, get_exit_state_at(GraphInterface::source(m_graph, edge))));
+        continue;
+      }
+      auto start = std::chrono::steady_clock::now();
+      Domain state = this->analyze_edge(
+          edge, get_exit_state_at(GraphInterface::source(m_graph, edge)));
+      m_stats->add(m_stats->analyze_edge_ns, nanoseconds_since(start));
+      m_stats->add(m_stats->edge_visits);
+      m_stats->add(m_stats->joins);
+      entry_state->join_with(state);
     }
   }
 
@@ -212,12 +360,28 @@ class MonotonicFixpointIteratorBase
     compute_entry_state(context, node, &entry_state);
     Domain& exit_state = m_exit_states[node];
     exit_state = entry_state;
+    if (m_stats == nullptr) {
+      this->analyze_node(node, &exit_state);
+      return;
+    }
+    auto start = std::chrono::steady_clock::now();
     this->analyze_node(node, &exit_state);
+    m_stats->add(m_stats->analyze_node_ns, nanoseconds_since(start));
+    m_stats->add(m_stats->node_visits);
+  }
+
+  void count(std::atomic<uint64_t> AtomicFixpointIteratorStats::*counter)
+      const {
+    if (m_stats != nullptr) {
+      m_stats->add((*m_stats).*counter);
+    }
   }
 
   const Graph& m_graph;
   std::unordered_map<NodeId, Domain, NodeHash> m_entry_states;
   std::unordered_map<NodeId, Domain, NodeHash> m_exit_states;
+  uint32_t m_widening_delay{1};
+  std::unique_ptr<AtomicFixpointIteratorStats> m_stats;
 };
 
 } // namespace fp_impl
@@ -268,6 +432,7 @@ class WTOMonotonicFixpointIterator
    * initial conditions.
    */
   void run(const Domain& init) {
+    fp_impl::ScopedRunObservation<Domain> observation;
     this->clear();
     Context context(init);
     for (const WtoComponent<NodeId>& component : m_wto) {
@@ -397,6 +562,7 @@ class ParallelMonotonicFixpointIterator
    * initial conditions.
    */
   void run(const Domain& init) {
+    fp_impl::ScopedRunObservation<Domain> observation;
     this->set_all_to_bottom(m_all_nodes);
     Context context(init, m_all_nodes);
     std::unique_ptr<std::atomic<uint32_t>[]> wpo_counter(
@@ -496,6 +662,122 @@ class ParallelMonotonicFixpointIterator
   std::unordered_set<NodeId> m_all_nodes;
 };
 
+namespace fp_impl {
+
+/*
+ * Sequential walk of a weak partial ordering, as in the concurrent algorithm
+ * of Kim et al. but with a single worker. `visit(node)` analyzes a node.
+ * `stabilize(head)` is called at the exit of each component; it returns
+ * whether the component has stabilized, in which case the walk moves on, and
+ * otherwise the component is analyzed again.
+ */
+template <typename NodeId,
+          typename NodeHash,
+          typename VisitFn,
+          typename StabilizeFn>
+void walk_weak_partial_ordering(
+    const WeakPartialOrdering<NodeId, NodeHash>& wpo,
+    VisitFn visit,
+    StabilizeFn stabilize) {
+  std::vector<uint32_t> wpo_counter(wpo.size(), 0);
+  std::queue<uint32_t> work_queue;
+  auto entry_idx = wpo.get_entry();
+  assert(wpo.get_num_preds(entry_idx) == 0);
+  auto schedule_successors = [&](uint32_t wpo_idx) {
+    for (auto succ_idx : wpo.get_successors(wpo_idx)) {
+      // Increase succ node's counter, push succ nodes in work queue if
+      // their counter number matches their NumSchedPreds.
+      if (++wpo_counter[succ_idx] == wpo.get_num_preds(succ_idx)) {
+        work_queue.emplace(succ_idx);
+      }
+    }
+  };
+  auto process_node = [&](uint32_t wpo_idx) {
+    assert(wpo_counter[wpo_idx] == wpo.get_num_preds(wpo_idx));
+    wpo_counter[wpo_idx] = 0;
+    // NonExit node
+    if (!wpo.is_exit(wpo_idx)) {
+      visit(wpo.get_node(wpo_idx));
+      schedule_successors(wpo_idx);
+      return;
+    }
+    // Exit node
+    // Check if component of the exit node has stabilized.
+    uint32_t head_idx = wpo.get_head_of_exit(wpo_idx);
+    if (stabilize(wpo.get_node(head_idx))) {
+      schedule_successors(wpo_idx);
+      return;
+    }
+    // Component didn't stabilize.
+    // Set component nodes v's counter to their NumOuterSchedPreds(v, wpo_idx)
+    for (auto pred_pair : wpo.get_num_outer_preds(wpo_idx)) {
+      auto component_idx = pred_pair.first;
+      assert(component_idx != entry_idx);
+      // Push component nodes in work queue if their counter number matches
+      // their NumSchedPreds.
+      if ((wpo_counter[component_idx] += pred_pair.second) ==
+          wpo.get_num_preds(component_idx)) {
+        work_queue.emplace(component_idx);
+      }
+    }
+    if (head_idx == entry_idx) {
+      // Handle special case when there is a loop on entry node. Because entry
+      // node have num_preds = 0, and for get_num_outer_preds the nodes with
+      // num_outer_preds are ignored. So we need to manually add entry node
+      // back to work queue if the component didn't stabilize.
+      work_queue.emplace(head_idx);
+    }
+  };
+  // Start from wpo entry node.
+  work_queue.emplace(entry_idx);
+  while (!work_queue.empty()) {
+    auto item = work_queue.front();
+    work_queue.pop();
+    process_node(item);
+  }
+  for (uint32_t idx = 0; idx < wpo.size(); ++idx) {
+    assert(wpo_counter[idx] == 0);
+  }
+}
+
+} // namespace fp_impl
+
+/*
+ * Builds the weak partial ordering of `graph` that MonotonicFixpointIterator
+ * walks. The ordering only depends on the shape of the graph, so analyses
+ * over the same graph can build it once and share it.
+ */
+template <typename GraphInterface,
+          typename NodeHash = std::hash<typename GraphInterface::NodeId>>
+std::shared_ptr<
+    const WeakPartialOrdering<typename GraphInterface::NodeId, NodeHash>>
+make_weak_partial_ordering(const typename GraphInterface::Graph& graph) {
+  using NodeId = typename GraphInterface::NodeId;
+  return std::make_shared<const WeakPartialOrdering<NodeId, NodeHash>>(
+      GraphInterface::entry(graph),
+      [&graph](const NodeId& x) {
+        const auto& succ_edges = GraphInterface::successors(graph, x);
+        std::vector<NodeId> succ_nodes_tmp;
+        std::transform(succ_edges.begin(),
+                       succ_edges.end(),
+                       std::back_inserter(succ_nodes_tmp),
+                       std::bind(&GraphInterface::target,
+                                 std::ref(graph),
+                                 std::placeholders::_1));
+        // Filter out duplicate succ nodes.
+        std::vector<NodeId> succ_nodes;
+        std::unordered_set<NodeId, NodeHash> succ_nodes_set;
+        for (auto node : succ_nodes_tmp) {
+          if (!succ_nodes_set.count(node)) {
+            succ_nodes_set.emplace(node);
+            succ_nodes.emplace_back(node);
+          }
+        }
+        return succ_nodes;
+      },
+      false);
+}
+
 /*
  * A sequential version of the fixpoint algorithm for Weak Partial Ordering.
  * Unlike the WTOMonotonicFixpointIterator, this does not rely on a recursive
@@ -513,34 +795,26 @@ class MonotonicFixpointIterator
   using EdgeId = typename GraphInterface::EdgeId;
   using Context =
       fp_impl::MonotonicFixpointIteratorContext<NodeId, Domain, NodeHash>;
+  using WPO = WeakPartialOrdering<NodeId, NodeHash>;
 
   MonotonicFixpointIterator(const Graph& graph, size_t cfg_size_hint = 4)
+      : MonotonicFixpointIterator(
+            graph,
+            make_weak_partial_ordering<GraphInterface, NodeHash>(graph),
+            cfg_size_hint) {}
+
+  /*
+   * Uses an ordering of `graph` built beforehand with
+   * `make_weak_partial_ordering`, e.g. one shared with other analyses of the
+   * same graph.
+   */
+  MonotonicFixpointIterator(const Graph& graph,
+                            std::shared_ptr<const WPO> wpo,
+                            size_t cfg_size_hint = 4)
       : fp_impl::MonotonicFixpointIteratorBase<GraphInterface,
                                                Domain,
                                                NodeHash>(graph, cfg_size_hint),
-        m_wpo(
-            GraphInterface::entry(graph),
-            [=, &graph](const NodeId& x) {
-              const auto& succ_edges = GraphInterface::successors(graph, x);
-              std::vector<NodeId> succ_nodes_tmp;
-              std::transform(succ_edges.begin(),
-                             succ_edges.end(),
-                             std::back_inserter(succ_nodes_tmp),
-                             std::bind(&GraphInterface::target,
-                                       std::ref(graph),
-                                       std::placeholders::_1));
-              // Filter out duplicate succ nodes.
-              std::vector<NodeId> succ_nodes;
-              std::unordered_set<NodeId, NodeHash> succ_nodes_set;
-              for (auto node : succ_nodes_tmp) {
-                if (!succ_nodes_set.count(node)) {
-                  succ_nodes_set.emplace(node);
-                  succ_nodes.emplace_back(node);
-                }
-              }
-              return succ_nodes;
-            },
-            false) {}
+        m_wpo(std::move(wpo)) {}
 
   /*
    * Executes the fixpoint iterator given an abstract value describing the
@@ -549,91 +823,107 @@ class MonotonicFixpointIterator
    * initial conditions.
    */
   void run(const Domain& init) {
+    fp_impl::ScopedRunObservation<Domain> observation;
     this->clear();
     Context context(init);
-    std::unique_ptr<std::atomic<uint32_t>[]> wpo_counter(
-        new std::atomic<uint32_t>[m_wpo.size()]);
-    std::fill_n(wpo_counter.get(), m_wpo.size(), 0);
-    std::queue<uint32_t> work_queue;
-    auto entry_idx = m_wpo.get_entry();
-    assert(m_wpo.get_num_preds(entry_idx) == 0);
-    // Prepare work queue.
-    auto process_node = [&](uint32_t wpo_idx) {
-      assert(wpo_counter[wpo_idx] == m_wpo.get_num_preds(wpo_idx));
-      wpo_counter[wpo_idx] = 0;
-      // NonExit node
-      if (!m_wpo.is_exit(wpo_idx)) {
-        this->analyze_vertex(&context, m_wpo.get_node(wpo_idx));
-        for (auto succ_idx : m_wpo.get_successors(wpo_idx)) {
-          // Increase succ node's counter, push succ nodes in work queue if
-          // their counter number matches their NumSchedPreds.
-          if (++wpo_counter[succ_idx] == m_wpo.get_num_preds(succ_idx)) {
-            work_queue.emplace(succ_idx);
-          }
-        }
-        return nullptr;
-      }
-      // Exit node
-      // Check if component of the exit node has stabilized.
-      uint32_t head_idx = m_wpo.get_head_of_exit(wpo_idx);
-      NodeId head = m_wpo.get_node(head_idx);
-      Domain* current_state = &this->m_entry_states[head];
-      Domain new_state = Domain::bottom();
-      this->compute_entry_state(&context, head, &new_state);
-      if (new_state.leq(*current_state)) {
-        // Component stabilized.
-        context.reset_local_iteration_count_for(head);
-        *current_state = std::move(new_state);
-        for (auto succ_idx : m_wpo.get_successors(wpo_idx)) {
-          // Increase succ node's counter, push succ nodes in work queue if
-          // their counter number matches their NumSchedPreds.
-          if (++wpo_counter[succ_idx] == m_wpo.get_num_preds(succ_idx)) {
-            work_queue.emplace(succ_idx);
-          }
-        }
-      } else {
-        // Component didn't stabilize.
-        this->extrapolate(context, head, current_state, new_state);
-        context.increase_iteration_count_for(head);
-        // Set component nodes v's counter to their
-        // NumOuterSchedPreds(v, wpo_idx)
-        for (auto pred_pair : m_wpo.get_num_outer_preds(wpo_idx)) {
-          auto component_idx = pred_pair.first;
-          assert(component_idx != entry_idx);
-          // Push component nodes in work queue if their counter number
-          // matches their NumSchedPreds.
-          if ((wpo_counter[component_idx] += pred_pair.second) ==
-              m_wpo.get_num_preds(component_idx)) {
-            work_queue.emplace(component_idx);
-          }
-        }
-        if (head_idx == entry_idx) {
-          // Handle special case when there is a loop on entry node.
-          // Because entry node have num_preds = 0, and for
-          // get_num_outer_preds the nodes with num_outer_preds are ignored.
-          // So we need to manually add entry node back to work queue if
-          // the component didn't stabilize.
-          work_queue.emplace(head_idx);
-        }
-      }
-      return nullptr;
-    };
-    // Start from wpo entry node.
-    work_queue.emplace(entry_idx);
-    while (!work_queue.empty()) {
-      auto item = work_queue.front();
-      work_queue.pop();
-      process_node(item);
-    }
-    for (uint32_t idx = 0; idx < m_wpo.size(); ++idx) {
-      assert(wpo_counter[idx] == 0);
+    fp_impl::walk_weak_partial_ordering(
+        *m_wpo,
+        [&](const NodeId& node) { this->analyze_vertex(&context, node); },
+        [&](const NodeId& head) { return this->stabilize(&context, head); });
+  }
+
+  const std::shared_ptr<const WPO>& get_wpo() const { return m_wpo; }
+
+  /*
+   * Checks whether the component headed by `head` has stabilized. If so, its
+   * entry state is refined; otherwise it is extrapolated for the next
+   * iteration of the component.
+   */
+  bool stabilize(Context* context, const NodeId& head) {
+    Domain* current_state = &this->m_entry_states[head];
+    Domain new_state = Domain::bottom();
+    this->compute_entry_state(context, head, &new_state);
+    if (new_state.leq(*current_state)) {
+      // Component stabilized.
+      context->reset_local_iteration_count_for(head);
+      *current_state = std::move(new_state);
+      return true;
     }
+    this->extrapolate(*context, head, current_state, new_state);
+    context->increase_iteration_count_for(head);
+    return false;
   }
 
  private:
-  WeakPartialOrdering<NodeId, NodeHash> m_wpo;
+  std::shared_ptr<const WPO> m_wpo;
 };
 
+/*
+ * Runs several MonotonicFixpointIterators over the same graph in a single
+ * walk of their shared weak partial ordering, e.g. the forward analyses of a
+ * method within one pass. Each node is analyzed by all of the iterators in
+ * turn, and a component is iterated until it has stabilized for all of them.
+ * Every iterator reaches the same fixpoint as it would with its own `run`;
+ * the walk, the ordering and the graph traversal are shared.
+ *
+ * The iterators must have been created with the same ordering (see
+ * `make_weak_partial_ordering`). Each entry of `inits` is the initial value
+ * of the corresponding iterator.
+ *
+ *   auto wpo = make_weak_partial_ordering<cfg::GraphInterface>(cfg);
+ *   reaching_defs::FixpointIterator rdefs(cfg, wpo);
+ *   SomeOtherAnalyzer other(cfg, wpo);
+ *   run_jointly(std::forward_as_tuple(rdefs, other),
+ *               std::make_tuple(reaching_defs::Environment(), other_init));
+ */
+namespace fp_impl {
+
+template <typename Iterators, typename Inits, size_t... I>
+void run_jointly(Iterators& iterators,
+                 const Inits& inits,
+                 std::index_sequence<I...>) {
+  const auto& wpo = std::get<0>(iterators).get_wpo();
+  bool shared = ((std::get<I>(iterators).get_wpo() == wpo) && ...);
+  RUNTIME_CHECK(shared,
+                invalid_argument()
+                    << error_msg("The iterators must share one ordering"));
+  (std::get<I>(iterators).clear(), ...);
+  // Contexts are neither copyable nor movable, so build them in place.
+  std::tuple<typename std::remove_reference_t<
+      std::tuple_element_t<I, Iterators>>::Context...>
+      contexts(std::get<I>(inits)...);
+  walk_weak_partial_ordering(
+      *wpo,
+      [&](const auto& node) {
+        (std::get<I>(iterators).analyze_vertex(&std::get<I>(contexts), node),
+         ...);
+      },
+      [&](const auto& head) {
+        // Every iterator has to refine or extrapolate its own state, so don't
+        // short-circuit.
+        bool stabilized = true;
+        ((stabilized &=
+          std::get<I>(iterators).stabilize(&std::get<I>(contexts), head)),
+         ...);
+        return stabilized;
+      });
+}
+
+} // namespace fp_impl
+
+template <typename... Iterators, typename... Domains>
+void run_jointly(std::tuple<Iterators&...> iterators,
+                 const std::tuple<Domains...>& inits) {
+  static_assert(sizeof...(Iterators) > 0, "Nothing to run");
+  static_assert(sizeof...(Iterators) == sizeof...(Domains),
+                "One initial value per iterator");
+  // Joint runs are observed as runs of the first domain.
+  fp_impl::ScopedRunObservation<std::tuple_element_t<0, std::tuple<Domains...>>>
+      observation;
+  fp_impl::run_jointly(
+      iterators, inits, std::index_sequence_for<Iterators...>());
+}
+
 /*
  * This combinator takes the specification of a CFG and produces an interface to
  * the reverse CFG, where the direction of edges has been flipped. The original
@@ -16,11 +16,16 @@
 #include <ostream>
 #include <stack>
 #include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
+#include <boost/functional/hash.hpp>
 #include <boost/intrusive_ptr.hpp>
 
 #include "AbstractDomain.h"
+#include "FixedSizePool.h"
 #include "PatriciaTreeUtil.h"
 
 // Forward declarations
@@ -50,6 +55,9 @@ class PatriciaTreeLeaf;
 template <typename IntegerType, typename Value>
 class PatriciaTreeIterator;
 
+template <typename IntegerType, typename Value>
+class HashConsTable;
+
 template <typename T>
 using CombiningFunction = std::function<T(const T&, const T&)>;
 
@@ -366,6 +374,22 @@ class PatriciaTreeMap final {
 
   void clear() { m_tree.reset(); }
 
+  using hash_cons_table = ptmap_impl::HashConsTable<IntegerType, Value>;
+
+  /*
+   * Replaces the nodes of this map by structurally equal nodes from :table,
+   * adding those it doesn't have yet. Maps that are hash-consed through the
+   * same table share all their equal subtrees, so that comparing or combining
+   * them takes the physical-equality shortcuts of the operations above instead
+   * of walking those subtrees. Nodes that are already in the table are
+   * recognized in constant time: hash-consing a map derived from hash-consed
+   * maps only visits the nodes that were created since.
+   */
+  PatriciaTreeMap& hash_cons(hash_cons_table& table) {
+    m_tree = table.intern(m_tree);
+    return *this;
+  }
+
  private:
   // These functions are used to handle the type conversions required when
   // manipulating maps with pointer keys. The first parameter is necessary to
@@ -503,6 +527,14 @@ class PatriciaTreeBranch final : public PatriciaTree<IntegerType, Value> {
     return m_right_tree;
   }
 
+  static void* operator new(size_t size) {
+    return pooled_allocate<PatriciaTreeBranch>(size);
+  }
+
+  static void operator delete(void* ptr, size_t size) {
+    pooled_deallocate<PatriciaTreeBranch>(ptr, size);
+  }
+
   static boost::intrusive_ptr<PatriciaTreeBranch<IntegerType, Value>> make(
       IntegerType prefix,
       IntegerType branching_bit,
@@ -533,6 +565,14 @@ class PatriciaTreeLeaf final : public PatriciaTree<IntegerType, Value> {
 
   const mapped_type& value() const { return m_pair.second; }
 
+  static void* operator new(size_t size) {
+    return pooled_allocate<PatriciaTreeLeaf>(size);
+  }
+
+  static void operator delete(void* ptr, size_t size) {
+    pooled_deallocate<PatriciaTreeLeaf>(ptr, size);
+  }
+
   static boost::intrusive_ptr<PatriciaTreeLeaf<IntegerType, Value>> make(
       IntegerType key, const mapped_type& value) {
     return new PatriciaTreeLeaf<IntegerType, Value>(key, value);
@@ -579,6 +619,97 @@ boost::intrusive_ptr<PatriciaTree<IntegerType, Value>> make_branch(
       prefix, branching_bit, left_tree, right_tree);
 }
 
+/*
+ * A table of canonical Patricia tree nodes, see PatriciaTreeMap::hash_cons().
+ *
+ * Leaves are equal when their keys are and their values are equal according
+ * to Value::equals(). Branches are equal when their prefixes and branching
+ * bits are, and their subtrees are the same canonical nodes. The table keeps
+ * all its nodes alive until it is cleared or destroyed, so it is meant to live
+ * as long as one analysis. It is not thread-safe.
+ */
+template <typename IntegerType, typename Value>
+class HashConsTable final {
+ public:
+  using Tree = PatriciaTree<IntegerType, Value>;
+  using Leaf = PatriciaTreeLeaf<IntegerType, Value>;
+  using Branch = PatriciaTreeBranch<IntegerType, Value>;
+
+  boost::intrusive_ptr<Tree> intern(const boost::intrusive_ptr<Tree>& tree) {
+    if (tree == nullptr || m_canonical.count(tree.get())) {
+      return tree;
+    }
+    if (tree->is_leaf()) {
+      const auto& leaf = boost::static_pointer_cast<Leaf>(tree);
+      auto& candidates = m_leaves[leaf->key()];
+      for (const auto& candidate : candidates) {
+        if (Value::equals(candidate->value(), leaf->value())) {
+          return candidate;
+        }
+      }
+      candidates.push_back(leaf);
+      m_canonical.insert(tree.get());
+      return tree;
+    }
+    const auto& branch = boost::static_pointer_cast<Branch>(tree);
+    auto left = intern(branch->left_tree());
+    auto right = intern(branch->right_tree());
+    BranchKey key{branch->prefix(), branch->branching_bit(), left.get(),
+                  right.get()};
+    auto it = m_branches.find(key);
+    if (it != m_branches.end()) {
+      return it->second;
+    }
+    boost::intrusive_ptr<Tree> canonical = tree;
+    if (left != branch->left_tree() || right != branch->right_tree()) {
+      canonical = Branch::make(branch->prefix(), branch->branching_bit(),
+                               std::move(left), std::move(right));
+    }
+    m_branches.emplace(key, canonical);
+    m_canonical.insert(canonical.get());
+    return canonical;
+  }
+
+  // The number of canonical nodes.
+  size_t size() const { return m_canonical.size(); }
+
+  void clear() {
+    m_canonical.clear();
+    m_branches.clear();
+    m_leaves.clear();
+  }
+
+ private:
+  struct BranchKey {
+    IntegerType prefix;
+    IntegerType branching_bit;
+    const Tree* left;
+    const Tree* right;
+
+    bool operator==(const BranchKey& other) const {
+      return prefix == other.prefix && branching_bit == other.branching_bit &&
+             left == other.left && right == other.right;
+    }
+  };
+
+  struct BranchKeyHash {
+    size_t operator()(const BranchKey& key) const {
+      size_t seed = 0;
+      boost::hash_combine(seed, key.prefix);
+      boost::hash_combine(seed, key.branching_bit);
+      boost::hash_combine(seed, key.left);
+      boost::hash_combine(seed, key.right);
+      return seed;
+    }
+  };
+
+  std::unordered_set<const Tree*> m_canonical;
+  std::unordered_map<IntegerType, std::vector<boost::intrusive_ptr<Leaf>>>
+      m_leaves;
+  std::unordered_map<BranchKey, boost::intrusive_ptr<Tree>, BranchKeyHash>
+      m_branches;
+};
+
 // Tries to find the value corresponding to :key. Returns null if the key is
 // not present in :tree.
 template <typename IntegerType, typename Value>
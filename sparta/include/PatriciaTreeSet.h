@@ -17,12 +17,15 @@
 #include <ostream>
 #include <stack>
 #include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 
 #include <boost/functional/hash.hpp>
 #include <boost/intrusive_ptr.hpp>
 
 #include "Exceptions.h"
+#include "FixedSizePool.h"
 #include "PatriciaTreeUtil.h"
 
 namespace sparta {
@@ -39,6 +42,9 @@ class PatriciaTreeLeaf;
 template <typename IntegerType>
 class PatriciaTreeIterator;
 
+template <typename IntegerType>
+class HashConsTable;
+
 template <typename IntegerType>
 inline bool contains(
     IntegerType key,
@@ -266,6 +272,18 @@ class PatriciaTreeSet final {
 
   void clear() { m_tree.reset(); }
 
+  using hash_cons_table = pt_impl::HashConsTable<IntegerType>;
+
+  /*
+   * Replaces the nodes of this set by equal nodes from :table, adding those it
+   * doesn't have yet, like PatriciaTreeMap::hash_cons(). Sets hash-consed
+   * through the same table share all their equal subtrees.
+   */
+  PatriciaTreeSet& hash_cons(hash_cons_table& table) {
+    m_tree = table.intern(m_tree);
+    return *this;
+  }
+
   friend std::ostream& operator<<(std::ostream& o,
                                   const PatriciaTreeSet<Element>& s) {
     o << "{";
@@ -396,6 +414,14 @@ class PatriciaTreeBranch final : public PatriciaTree<IntegerType> {
     return m_right_tree;
   }
 
+  static void* operator new(size_t size) {
+    return pooled_allocate<PatriciaTreeBranch>(size);
+  }
+
+  static void operator delete(void* ptr, size_t size) {
+    pooled_deallocate<PatriciaTreeBranch>(ptr, size);
+  }
+
   static boost::intrusive_ptr<PatriciaTreeBranch<IntegerType>> make(
       IntegerType prefix,
       IntegerType branching_bit,
@@ -424,6 +450,14 @@ class PatriciaTreeLeaf final : public PatriciaTree<IntegerType> {
 
   const IntegerType& key() const { return m_key; }
 
+  static void* operator new(size_t size) {
+    return pooled_allocate<PatriciaTreeLeaf>(size);
+  }
+
+  static void operator delete(void* ptr, size_t size) {
+    pooled_deallocate<PatriciaTreeLeaf>(ptr, size);
+  }
+
   static boost::intrusive_ptr<PatriciaTreeLeaf<IntegerType>> make(
       IntegerType key) {
     return new PatriciaTreeLeaf<IntegerType>(key);
@@ -467,6 +501,89 @@ boost::intrusive_ptr<PatriciaTree<IntegerType>> make_branch(
       prefix, branching_bit, left_tree, right_tree);
 }
 
+/*
+ * A table of canonical Patricia tree nodes, see PatriciaTreeSet::hash_cons().
+ * The table keeps all its nodes alive until it is cleared or destroyed. It is
+ * not thread-safe.
+ */
+template <typename IntegerType>
+class HashConsTable final {
+ public:
+  using Tree = PatriciaTree<IntegerType>;
+  using Branch = PatriciaTreeBranch<IntegerType>;
+
+  boost::intrusive_ptr<Tree> intern(const boost::intrusive_ptr<Tree>& tree) {
+    if (tree == nullptr || m_canonical.count(tree.get())) {
+      return tree;
+    }
+    if (tree->is_leaf()) {
+      const auto& leaf =
+          boost::static_pointer_cast<PatriciaTreeLeaf<IntegerType>>(tree);
+      auto& canonical = m_leaves[leaf->key()];
+      if (canonical == nullptr) {
+        canonical = tree;
+        m_canonical.insert(tree.get());
+      }
+      return canonical;
+    }
+    const auto& branch = boost::static_pointer_cast<Branch>(tree);
+    auto left = intern(branch->left_tree());
+    auto right = intern(branch->right_tree());
+    BranchKey key{branch->prefix(), branch->branching_bit(), left.get(),
+                  right.get()};
+    auto it = m_branches.find(key);
+    if (it != m_branches.end()) {
+      return it->second;
+    }
+    boost::intrusive_ptr<Tree> canonical = tree;
+    if (left != branch->left_tree() || right != branch->right_tree()) {
+      canonical = Branch::make(branch->prefix(), branch->branching_bit(),
+                               std::move(left), std::move(right));
+    }
+    m_branches.emplace(key, canonical);
+    m_canonical.insert(canonical.get());
+    return canonical;
+  }
+
+  // The number of canonical nodes.
+  size_t size() const { return m_canonical.size(); }
+
+  void clear() {
+    m_canonical.clear();
+    m_branches.clear();
+    m_leaves.clear();
+  }
+
+ private:
+  struct BranchKey {
+    IntegerType prefix;
+    IntegerType branching_bit;
+    const Tree* left;
+    const Tree* right;
+
+    bool operator==(const BranchKey& other) const {
+      return prefix == other.prefix && branching_bit == other.branching_bit &&
+             left == other.left && right == other.right;
+    }
+  };
+
+  struct BranchKeyHash {
+    size_t operator()(const BranchKey& key) const {
+      size_t seed = 0;
+      boost::hash_combine(seed, key.prefix);
+      boost::hash_combine(seed, key.branching_bit);
+      boost::hash_combine(seed, key.left);
+      boost::hash_combine(seed, key.right);
+      return seed;
+    }
+  };
+
+  std::unordered_set<const Tree*> m_canonical;
+  std::unordered_map<IntegerType, boost::intrusive_ptr<Tree>> m_leaves;
+  std::unordered_map<BranchKey, boost::intrusive_ptr<Tree>, BranchKeyHash>
+      m_branches;
+};
+
 template <typename IntegerType>
 inline bool contains(
     IntegerType key,
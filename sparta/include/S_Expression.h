@@ -9,6 +9,7 @@
 
 #include <algorithm>
 #include <cctype>
+#include <charconv>
 #include <cstdint>
 #include <functional>
 #include <initializer_list>
@@ -267,6 +268,88 @@ class s_expr_istream final {
   std::string m_what;
 };
 
+/*
+ * A faster alternative to `s_expr_istream` for inputs that are entirely in
+ * memory, like the dump of the IR of a whole app. The reader scans the input
+ * buffer in place: apart from the S-expressions it returns, parsing doesn't
+ * allocate, except for strings using escape sequences. The reader doesn't copy
+ * the input, which must outlive it.
+ *
+ * Example usage:
+ *   s_expr_reader reader("(a b) (c)");
+ *   s_expr e;
+ *   while (reader.read(&e)) {
+ *     ...
+ *   }
+ *   if (reader.fail()) {
+ *     // reader.what() contains the error message
+ *   }
+ *
+ * Top-level S-expressions can also be skipped without being built, which is
+ * much cheaper than reading them. This is useful to split a large input into
+ * its top-level S-expressions, and then parse them in parallel with one
+ * reader each.
+ */
+class s_expr_reader final {
+ public:
+  explicit s_expr_reader(std::string_view input) : m_input(input) {}
+
+  s_expr_reader(const s_expr_reader&) = delete;
+
+  s_expr_reader& operator=(const s_expr_reader&) = delete;
+
+  /*
+   * Reads the next S-expression. Returns false when reaching the end of the
+   * input or upon a parse error, which `eoi` and `fail` tell apart.
+   */
+  bool read(s_expr* expr);
+
+  /*
+   * Moves past the next S-expression without building it, and returns its
+   * text. Fails in the same way as `read`, except that the contents of
+   * literals are only checked by `read`.
+   */
+  bool skip(std::string_view* text);
+
+  bool good() const { return m_status == Status::Good; }
+
+  bool fail() const { return m_status == Status::Fail; }
+
+  bool eoi() const { return m_status == Status::EOI; }
+
+  const std::string& what() const { return m_what; }
+
+ private:
+  enum class Status { EOI, Good, Fail };
+
+  bool at_end() const { return m_position >= m_input.size(); }
+
+  char peek() const { return m_input[m_position]; }
+
+  // Returns false when reaching the end of the input.
+  bool skip_white_spaces_and_comments();
+
+  bool read_int32(int32_t* n);
+
+  bool read_string(std::string* s);
+
+  bool skip_string();
+
+  std::string_view read_symbol();
+
+  bool set_status(Status status, const std::string& what_arg);
+
+  std::string_view m_input;
+  size_t m_position{0};
+  size_t m_line_number{1};
+  Status m_status{Status::Good};
+  std::string m_what{"OK"};
+  // The elements of the lists being read, from the outermost to the
+  // innermost. The buffers are reused from one S-expression to the next.
+  std::vector<s_expr> m_elements;
+  std::vector<size_t> m_list_starts;
+};
+
 /*
  * S-expressions are primarily intended to be used as a serialization format for
  * complex data structures. When deserializing an S-expression, it would be very
@@ -857,6 +940,258 @@ inline void s_expr_istream::set_status(Status status,
   m_what = ss.str();
 }
 
+inline bool s_expr_reader::read(s_expr* expr) {
+  if (fail()) {
+    return false;
+  }
+  m_elements.clear();
+  m_list_starts.clear();
+  // Returns true iff `e` is a complete top-level S-expression.
+  auto emit = [this, expr](s_expr&& e) {
+    if (m_list_starts.empty()) {
+      *expr = std::move(e);
+      return true;
+    }
+    m_elements.push_back(std::move(e));
+    return false;
+  };
+  for (;;) {
+    if (!skip_white_spaces_and_comments()) {
+      if (!m_list_starts.empty()) {
+        return set_status(Status::Fail, "Incomplete S-expression");
+      }
+      return set_status(Status::EOI, "End of input");
+    }
+    char next_char = peek();
+    switch (next_char) {
+    case '(': {
+      ++m_position;
+      m_list_starts.push_back(m_elements.size());
+      break;
+    }
+    case ')': {
+      if (m_list_starts.empty()) {
+        return set_status(Status::Fail, "Extra ')' encountered");
+      }
+      ++m_position;
+      auto first = std::next(m_elements.begin(), m_list_starts.back());
+      m_list_starts.pop_back();
+      s_expr list(std::make_move_iterator(first),
+                  std::make_move_iterator(m_elements.end()));
+      m_elements.erase(first, m_elements.end());
+      if (emit(std::move(list))) {
+        return true;
+      }
+      break;
+    }
+    case '#': {
+      ++m_position;
+      int32_t n;
+      if (!read_int32(&n)) {
+        return set_status(Status::Fail, "Error parsing int32_t literal");
+      }
+      if (emit(s_expr(n))) {
+        return true;
+      }
+      break;
+    }
+    case '"': {
+      std::string str;
+      if (!read_string(&str)) {
+        return set_status(Status::Fail, "Error parsing string literal");
+      }
+      if (emit(s_expr(str))) {
+        return true;
+      }
+      break;
+    }
+    default: {
+      if (!s_expr_impl::is_symbol_char(next_char)) {
+        std::ostringstream out;
+        out << "Unexpected character encountered: '" << next_char << "'";
+        return set_status(Status::Fail, out.str());
+      }
+      if (emit(s_expr(std::string(read_symbol())))) {
+        return true;
+      }
+    }
+    }
+  }
+}
+
+inline bool s_expr_reader::skip(std::string_view* text) {
+  if (fail()) {
+    return false;
+  }
+  size_t depth = 0;
+  size_t start = 0;
+  for (;;) {
+    if (!skip_white_spaces_and_comments()) {
+      if (depth > 0) {
+        return set_status(Status::Fail, "Incomplete S-expression");
+      }
+      return set_status(Status::EOI, "End of input");
+    }
+    if (depth == 0) {
+      start = m_position;
+    }
+    char next_char = peek();
+    switch (next_char) {
+    case '(': {
+      ++m_position;
+      ++depth;
+      break;
+    }
+    case ')': {
+      if (depth == 0) {
+        return set_status(Status::Fail, "Extra ')' encountered");
+      }
+      ++m_position;
+      --depth;
+      break;
+    }
+    case '#': {
+      ++m_position;
+      if (!at_end() && (peek() == '-' || peek() == '+')) {
+        ++m_position;
+      }
+      if (at_end() || !std::isdigit(peek())) {
+        return set_status(Status::Fail, "Error parsing int32_t literal");
+      }
+      while (!at_end() && std::isdigit(peek())) {
+        ++m_position;
+      }
+      break;
+    }
+    case '"': {
+      if (!skip_string()) {
+        return set_status(Status::Fail, "Error parsing string literal");
+      }
+      break;
+    }
+    default: {
+      if (!s_expr_impl::is_symbol_char(next_char)) {
+        std::ostringstream out;
+        out << "Unexpected character encountered: '" << next_char << "'";
+        return set_status(Status::Fail, out.str());
+      }
+      read_symbol();
+    }
+    }
+    if (depth == 0) {
+      *text = m_input.substr(start, m_position - start);
+      return true;
+    }
+  }
+}
+
+inline bool s_expr_reader::skip_white_spaces_and_comments() {
+  while (!at_end()) {
+    char c = peek();
+    if (c == ';') {
+      auto end_of_line = m_input.find('\n', m_position);
+      m_position =
+          end_of_line == std::string_view::npos ? m_input.size() : end_of_line;
+    } else if (std::isspace(c)) {
+      if (c == '\n') {
+        ++m_line_number;
+      }
+      ++m_position;
+    } else {
+      return true;
+    }
+  }
+  return false;
+}
+
+inline bool s_expr_reader::read_int32(int32_t* n) {
+  // Like `std::istream`, we accept an explicit plus sign.
+  if (!at_end() && peek() == '+') {
+    ++m_position;
+    if (!at_end() && peek() == '-') {
+      return false;
+    }
+  }
+  const char* first = m_input.data() + m_position;
+  const char* last = m_input.data() + m_input.size();
+  auto result = std::from_chars(first, last, *n);
+  if (result.ec != std::errc()) {
+    return false;
+  }
+  m_position += result.ptr - first;
+  return true;
+}
+
+inline bool s_expr_reader::read_string(std::string* s) {
+  // This is the format written by `std::quoted`: the delimiter and the escape
+  // character are escaped with a backslash.
+  ++m_position;
+  size_t start = m_position;
+  // Fast path: no escape sequences.
+  auto end = m_input.find_first_of("\"\\", m_position);
+  if (end != std::string_view::npos && m_input[end] == '"') {
+    auto contents = m_input.substr(start, end - start);
+    m_line_number += std::count(contents.begin(), contents.end(), '\n');
+    s->assign(contents.data(), contents.size());
+    m_position = end + 1;
+    return true;
+  }
+  while (!at_end()) {
+    char c = m_input[m_position++];
+    if (c == '"') {
+      return true;
+    }
+    if (c == '\\') {
+      if (at_end()) {
+        return false;
+      }
+      c = m_input[m_position++];
+    }
+    if (c == '\n') {
+      ++m_line_number;
+    }
+    s->push_back(c);
+  }
+  return false;
+}
+
+inline bool s_expr_reader::skip_string() {
+  ++m_position;
+  while (!at_end()) {
+    char c = m_input[m_position++];
+    if (c == '"') {
+      return true;
+    }
+    if (c == '\\') {
+      if (at_end()) {
+        return false;
+      }
+      c = m_input[m_position++];
+    }
+    if (c == '\n') {
+      ++m_line_number;
+    }
+  }
+  return false;
+}
+
+inline std::string_view s_expr_reader::read_symbol() {
+  size_t start = m_position;
+  while (!at_end() && s_expr_impl::is_symbol_char(peek())) {
+    ++m_position;
+  }
+  return m_input.substr(start, m_position - start);
+}
+
+inline bool s_expr_reader::set_status(Status status,
+                                      const std::string& what_arg) {
+  m_status = status;
+  std::ostringstream ss;
+  ss << "On line " << m_line_number << ": " << what_arg;
+  m_what = ss.str();
+  return false;
+}
+
 inline s_patn::s_patn()
     : m_pattern(std::make_shared<s_expr_impl::WildcardPattern>()) {}
 
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <boost/container/small_vector.hpp>
 #include <initializer_list>
 
 #include "AbstractDomain.h"
@@ -17,12 +18,23 @@ namespace sparta {
 
 namespace sssad_impl {
 
+// Sets of up to MaxCount elements are stored inline, so that values never
+// allocate. Only the temporary results of joins that go to top can.
+template <typename Element, std::size_t MaxCount>
+using SmallFlatSet =
+    FlatSet<Element,
+            std::less<Element>,
+            std::equal_to<Element>,
+            boost::container::small_vector<Element, MaxCount>>;
+
 template <typename Element, std::size_t MaxCount>
 class SetValue final : public AbstractValue<SetValue<Element, MaxCount>> {
  public:
+  using Set = SmallFlatSet<Element, MaxCount>;
+
   SetValue() = default;
 
-  SetValue(FlatSet<Element> set) : m_set(std::move(set)) {}
+  SetValue(Set set) : m_set(std::move(set)) {}
 
   void clear() override { m_set.clear(); }
 
@@ -38,7 +50,7 @@ class SetValue final : public AbstractValue<SetValue<Element, MaxCount>> {
 
   std::size_t size() const { return m_set.size(); }
 
-  const FlatSet<Element>& elements() const { return m_set; }
+  const Set& elements() const { return m_set; }
 
   void add(const Element& e) { m_set.insert(e); }
 
@@ -78,7 +90,7 @@ class SetValue final : public AbstractValue<SetValue<Element, MaxCount>> {
   }
 
  private:
-  FlatSet<Element> m_set;
+  Set m_set;
 };
 
 } // namespace sssad_impl
@@ -96,6 +108,7 @@ class SmallSortedSetAbstractDomain final
           SmallSortedSetAbstractDomain<Element, MaxCount>> {
  public:
   using Value = sssad_impl::SetValue<Element, MaxCount>;
+  using Set = typename Value::Set;
 
   /* Return the empty set. */
   SmallSortedSetAbstractDomain() { this->set_to_value(Value()); }
@@ -106,14 +119,14 @@ class SmallSortedSetAbstractDomain final
             SmallSortedSetAbstractDomain<Element, MaxCount>>(kind) {}
 
   explicit SmallSortedSetAbstractDomain(const Element& e) {
-    this->set_to_value(Value(FlatSet<Element>{e}));
+    this->set_to_value(Value(Set{e}));
   }
 
   explicit SmallSortedSetAbstractDomain(std::initializer_list<Element> l) {
-    this->set_to_value(Value(FlatSet<Element>(l)));
+    this->set_to_value(Value(Set(l)));
   }
 
-  explicit SmallSortedSetAbstractDomain(FlatSet<Element> set) {
+  explicit SmallSortedSetAbstractDomain(Set set) {
     this->set_to_value(Value(std::move(set)));
   }
 
@@ -127,7 +140,7 @@ class SmallSortedSetAbstractDomain final
 
   bool empty() const { return this->is_value() && this->get_value()->empty(); }
 
-  const FlatSet<Element>& elements() const {
+  const Set& elements() const {
     RUNTIME_CHECK(this->kind() == AbstractValueKind::Value,
                   invalid_abstract_value()
                       << expected_kind(AbstractValueKind::Value)
@@ -14,11 +14,16 @@
 #include <cassert>
 #include <chrono>
 #include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <numeric>
 #include <queue>
 #include <random>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "Arity.h"
 
@@ -57,6 +62,27 @@ inline std::vector<unsigned int> create_permutation(unsigned int num,
   return attempts;
 }
 
+/**
+ * Like the above, but threads on the same NUMA node as the given one, as per
+ * `thread_nodes`, are visited before the others, so that work is stolen from
+ * the local node first.
+ */
+inline std::vector<unsigned int> create_permutation(
+    unsigned int num,
+    unsigned int thread_idx,
+    const std::vector<unsigned int>& thread_nodes) {
+  auto attempts = create_permutation(num, thread_idx);
+  if (thread_idx >= thread_nodes.size()) {
+    return attempts;
+  }
+  auto node = thread_nodes[thread_idx];
+  std::stable_partition(
+      attempts.begin(), attempts.end(), [&](unsigned int idx) {
+        return idx < thread_nodes.size() && thread_nodes[idx] == node;
+      });
+  return attempts;
+}
+
 class Semaphore {
  public:
   explicit Semaphore(size_t initial = 0u) : m_count(initial) {}
@@ -90,7 +116,152 @@ class Semaphore {
   size_t m_count;
 };
 
+/**
+ * A lock-free work-stealing deque (Chase & Lev, "Dynamic Circular
+ * Work-Stealing Deque", SPAA 2005; with the memory orderings of Le et al.,
+ * "Correct and Efficient Work-Stealing for Weak Memory Models", PPoPP 2013).
+ *
+ * Only the owning thread may call `push()` and `pop()`, which operate on the
+ * bottom end. Any thread may call `steal()`, which takes from the top end.
+ * Retired buffers are kept alive until the deque is destroyed, so thieves never
+ * read from freed memory.
+ */
+template <typename T, bool = std::is_trivially_copyable<T>::value>
+class ChaseLevDeque {
+ public:
+  ChaseLevDeque() {
+    m_buffers.emplace_back(std::make_unique<Buffer>(kInitialLogSize));
+    m_buffer = m_buffers.back().get();
+  }
+
+  ChaseLevDeque(const ChaseLevDeque&) = delete;
+  ChaseLevDeque& operator=(const ChaseLevDeque&) = delete;
+
+  void push(T item) {
+    int64_t b = m_bottom.load(std::memory_order_relaxed);
+    int64_t t = m_top.load(std::memory_order_acquire);
+    Buffer* buffer = m_buffer.load(std::memory_order_relaxed);
+    if (b - t > static_cast<int64_t>(buffer->capacity()) - 1) {
+      m_buffers.emplace_back(buffer->grow(b, t));
+      buffer = m_buffers.back().get();
+      m_buffer.store(buffer, std::memory_order_release);
+    }
+    buffer->put(b, item);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_bottom.store(b + 1, std::memory_order_relaxed);
+  }
+
+  boost::optional<T> pop() {
+    int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+    Buffer* buffer = m_buffer.load(std::memory_order_relaxed);
+    m_bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = m_top.load(std::memory_order_relaxed);
+    if (t > b) {
+      // Empty.
+      m_bottom.store(b + 1, std::memory_order_relaxed);
+      return boost::none;
+    }
+    T item = buffer->get(b);
+    if (t == b) {
+      // Last item; race against thieves for it.
+      bool won = m_top.compare_exchange_strong(
+          t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+      m_bottom.store(b + 1, std::memory_order_relaxed);
+      if (!won) {
+        return boost::none;
+      }
+    }
+    return item;
+  }
+
+  boost::optional<T> steal() {
+    while (true) {
+      int64_t t = m_top.load(std::memory_order_acquire);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      int64_t b = m_bottom.load(std::memory_order_acquire);
+      if (t >= b) {
+        return boost::none;
+      }
+      Buffer* buffer = m_buffer.load(std::memory_order_acquire);
+      T item = buffer->get(t);
+      if (m_top.compare_exchange_strong(t,
+                                        t + 1,
+                                        std::memory_order_seq_cst,
+                                        std::memory_order_relaxed)) {
+        return item;
+      }
+      // Lost the race against another thief or the owner; retry.
+    }
+  }
+
+  size_t size() const {
+    int64_t b = m_bottom.load(std::memory_order_relaxed);
+    int64_t t = m_top.load(std::memory_order_relaxed);
+    return b > t ? static_cast<size_t>(b - t) : 0;
+  }
+
+  bool empty() const { return size() == 0; }
+
+ private:
+  static constexpr size_t kInitialLogSize = 6;
+
+  class Buffer {
+   public:
+    explicit Buffer(size_t log_capacity)
+        : m_mask((size_t{1} << log_capacity) - 1),
+          m_log_capacity(log_capacity),
+          m_slots(new std::atomic<T>[size_t{1} << log_capacity]) {}
+
+    size_t capacity() const { return m_mask + 1; }
+
+    T get(int64_t i) const {
+      return m_slots[i & m_mask].load(std::memory_order_relaxed);
+    }
+
+    void put(int64_t i, T item) {
+      m_slots[i & m_mask].store(item, std::memory_order_relaxed);
+    }
+
+    std::unique_ptr<Buffer> grow(int64_t bottom, int64_t top) const {
+      auto bigger = std::make_unique<Buffer>(m_log_capacity + 1);
+      for (int64_t i = top; i < bottom; ++i) {
+        bigger->put(i, get(i));
+      }
+      return bigger;
+    }
+
+   private:
+    const size_t m_mask;
+    const size_t m_log_capacity;
+    std::unique_ptr<std::atomic<T>[]> m_slots;
+  };
+
+  std::atomic<int64_t> m_top{0};
+  std::atomic<int64_t> m_bottom{0};
+  std::atomic<Buffer*> m_buffer{nullptr};
+  // Owned by the pushing thread.
+  std::vector<std::unique_ptr<Buffer>> m_buffers;
+};
+
+/*
+ * Items that are not trivially copyable cannot be stored in atomics. Work
+ * queues over such items always use the mutex-guarded queues, so this
+ * placeholder is never used at runtime.
+ */
+template <typename T>
+class ChaseLevDeque<T, false> {
+ public:
+  void push(T) { assert(false); }
+  boost::optional<T> pop() { return boost::none; }
+  boost::optional<T> steal() { return boost::none; }
+  size_t size() const { return 0; }
+  bool empty() const { return true; }
+};
+
 struct StateCounters {
+  // With lock-free queues, this counts queued items rather than non-empty
+  // queues. Either way it is non-zero iff some queue may still hold work.
   std::atomic_uint num_non_empty;
   std::atomic_uint num_running;
   const unsigned int num_all;
@@ -111,14 +282,142 @@ struct StateCounters {
 
 } // namespace workqueue_impl
 
+/**
+ * A fixed set of persistent worker threads that SpartaWorkQueue::run_all() can
+ * dispatch onto, instead of spawning and joining fresh threads on every call.
+ *
+ * A pool executes at most one batch at a time. A caller that finds the pool
+ * busy (e.g. a work queue run from within the task of another work queue), or
+ * that needs more threads than the pool has, gets `false` back from
+ * `try_run()` and is expected to fall back to spawning its own threads.
+ */
+class ThreadPool {
+ public:
+  /*
+   * `thread_nodes`, when not empty, gives the NUMA node of each thread, so
+   * that work queues running on the pool steal from the same node first.
+   * `init_thread`, when set, is called on each thread before it runs any work,
+   * e.g. to pin it to the CPUs of its node.
+   */
+  explicit ThreadPool(size_t num_threads,
+                      std::vector<unsigned int> thread_nodes = {},
+                      std::function<void(size_t)> init_thread = nullptr)
+      : m_thread_nodes(std::move(thread_nodes)),
+        m_init_thread(std::move(init_thread)) {
+    boost::thread::attributes attrs;
+    attrs.set_stack_size(8 * 1024 * 1024);
+    m_threads.reserve(num_threads);
+    for (size_t i = 0; i < num_threads; ++i) {
+      m_threads.emplace_back(attrs, [this, i]() { this->worker_loop(i); });
+    }
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      m_shutdown = true;
+    }
+    m_work_cv.notify_all();
+    for (auto& thread : m_threads) {
+      thread.join();
+    }
+  }
+
+  size_t size() const { return m_threads.size(); }
+
+  const std::vector<unsigned int>& thread_nodes() const {
+    return m_thread_nodes;
+  }
+
+  /*
+   * Runs `fn(i)` for every i in [0, n) on the first n pool threads, and blocks
+   * until all of them have returned. Returns false without running anything
+   * if the pool is already executing a batch or has fewer than n threads.
+   */
+  template <typename Fn>
+  bool try_run(size_t n, Fn& fn) {
+    if (n > m_threads.size()) {
+      return false;
+    }
+    bool expected = false;
+    if (!m_busy.compare_exchange_strong(expected, true)) {
+      return false;
+    }
+    {
+      std::unique_lock<std::mutex> lock(m_mtx);
+      m_job = [&fn](size_t idx) { fn(idx); };
+      m_job_size = n;
+      m_pending = n;
+      ++m_generation;
+      m_work_cv.notify_all();
+      m_done_cv.wait(lock, [this]() { return m_pending == 0; });
+      m_job = nullptr;
+    }
+    m_busy = false;
+    return true;
+  }
+
+ private:
+  void worker_loop(size_t idx) {
+    if (m_init_thread) {
+      m_init_thread(idx);
+    }
+    size_t seen_generation = 0;
+    std::unique_lock<std::mutex> lock(m_mtx);
+    while (true) {
+      m_work_cv.wait(lock, [&]() {
+        return m_shutdown || m_generation != seen_generation;
+      });
+      if (m_shutdown) {
+        return;
+      }
+      seen_generation = m_generation;
+      if (idx >= m_job_size) {
+        continue;
+      }
+      lock.unlock();
+      // The batch cannot complete (and m_job cannot change) before we
+      // decrement m_pending below.
+      m_job(idx);
+      lock.lock();
+      if (--m_pending == 0) {
+        m_done_cv.notify_one();
+      }
+    }
+  }
+
+  std::vector<unsigned int> m_thread_nodes;
+  std::function<void(size_t)> m_init_thread;
+  std::vector<boost::thread> m_threads;
+  std::atomic<bool> m_busy{false};
+  // The following fields are guarded by m_mtx.
+  std::mutex m_mtx;
+  std::condition_variable m_work_cv;
+  std::condition_variable m_done_cv;
+  std::function<void(size_t)> m_job;
+  size_t m_job_size{0};
+  size_t m_pending{0};
+  size_t m_generation{0};
+  bool m_shutdown{false};
+};
+
 template <class Input, typename Executor>
 class SpartaWorkQueue;
 
 template <class Input>
 class SpartaWorkerState final {
  public:
-  SpartaWorkerState(size_t id, workqueue_impl::StateCounters* sc, bool can_push)
-      : m_id(id), m_state_counters(sc), m_can_push_task(can_push) {}
+  SpartaWorkerState(size_t id,
+                    workqueue_impl::StateCounters* sc,
+                    bool can_push,
+                    bool lock_free = false)
+      : m_id(id),
+        m_state_counters(sc),
+        m_can_push_task(can_push),
+        m_lock_free(lock_free) {}
 
   /*
    * Add more items to the queue of the currently-running worker. When a
@@ -127,6 +426,16 @@ class SpartaWorkerState final {
    */
   void push_task(Input task) {
     assert(m_can_push_task);
+    if (m_lock_free) {
+      // Count the item before publishing it, so that the counter is never
+      // below the number of items that can be popped.
+      ++m_state_counters->num_non_empty;
+      m_deque.push(task);
+      if (m_state_counters->num_running < m_state_counters->num_all) {
+        m_state_counters->waiter->give(1u);
+      }
+      return;
+    }
     std::lock_guard<std::mutex> guard(m_queue_mtx);
     if (m_queue.empty()) {
       ++m_state_counters->num_non_empty;
@@ -151,6 +460,17 @@ class SpartaWorkerState final {
 
  private:
   boost::optional<Input> pop_task(SpartaWorkerState<Input>* other) {
+    if (m_lock_free) {
+      // The thief counts as running while it looks for work, so that no
+      // thread concludes that all work is done while an item is in flight.
+      other->set_running(true);
+      auto task = other == this ? m_deque.pop() : m_deque.steal();
+      if (task) {
+        assert(m_state_counters->num_non_empty > 0);
+        --m_state_counters->num_non_empty;
+      }
+      return task;
+    }
     std::lock_guard<std::mutex> guard(m_queue_mtx);
     if (!m_queue.empty()) {
       other->set_running(true);
@@ -169,8 +489,23 @@ class SpartaWorkerState final {
   bool m_running{false};
   std::queue<Input> m_queue;
   std::mutex m_queue_mtx;
+  // Used instead of m_queue and m_queue_mtx in lock-free mode.
+  workqueue_impl::ChaseLevDeque<Input> m_deque;
   workqueue_impl::StateCounters* m_state_counters;
   const bool m_can_push_task{false};
+  const bool m_lock_free{false};
+
+  void enqueue(Input task) {
+    if (m_lock_free) {
+      m_deque.push(task);
+    } else {
+      m_queue.push(task);
+    }
+  }
+
+  size_t queue_size() const {
+    return m_lock_free ? m_deque.size() : m_queue.size();
+  }
 
   template <class, typename>
   friend class SpartaWorkQueue;
@@ -187,6 +522,8 @@ class SpartaWorkQueue {
   size_t m_insert_idx{0};
   workqueue_impl::StateCounters m_state_counters;
   const bool m_can_push_task{false};
+  ThreadPool* m_thread_pool{nullptr};
+  const bool m_lock_free{false};
 
   void consume(SpartaWorkerState<Input>* state, Input task) {
     m_executor(state, task);
@@ -202,7 +539,18 @@ class SpartaWorkQueue {
                   // * When this flag is false, threads can
                   //   exit as soon as there is no more work (to avoid
                   //   preempting a thread that has useful work)
-                  bool push_tasks_while_running = false);
+                  bool push_tasks_while_running = false,
+                  // When non-null, run_all() executes on the threads of this
+                  // pool whenever it is idle and large enough.
+                  ThreadPool* thread_pool = nullptr,
+                  // lock_free_queues:
+                  // * When this flag is true (and Input is trivially
+                  //   copyable), each worker owns a lock-free Chase-Lev deque:
+                  //   it pushes and pops its own items in LIFO order, while
+                  //   idle workers steal the oldest items of other workers.
+                  //   This avoids mutex contention for fine-grained tasks.
+                  // * Otherwise, workers use mutex-guarded FIFO queues.
+                  bool lock_free_queues = false);
 
   // copies are not allowed
   SpartaWorkQueue(const SpartaWorkQueue&) = delete;
@@ -215,7 +563,8 @@ class SpartaWorkQueue {
   void add_item(Input task, size_t worker_id);
 
   /**
-   * Spawn threads and evaluate function.  This method blocks.
+   * Spawn threads (or borrow them from the thread pool) and evaluate
+   * function.  This method blocks.
    */
   void run_all();
 
@@ -226,15 +575,20 @@ class SpartaWorkQueue {
 template <class Input, typename Executor>
 SpartaWorkQueue<Input, Executor>::SpartaWorkQueue(Executor executor,
                                                   unsigned int num_threads,
-                                                  bool push_tasks_while_running)
+                                                  bool push_tasks_while_running,
+                                                  ThreadPool* thread_pool,
+                                                  bool lock_free_queues)
     : m_executor(executor),
       m_num_threads(num_threads),
       m_state_counters(num_threads),
-      m_can_push_task(push_tasks_while_running) {
+      m_can_push_task(push_tasks_while_running),
+      m_thread_pool(thread_pool),
+      m_lock_free(lock_free_queues &&
+                  std::is_trivially_copyable<Input>::value) {
   assert(num_threads >= 1);
   for (unsigned int i = 0; i < m_num_threads; ++i) {
     m_states.emplace_back(std::make_unique<SpartaWorkerState<Input>>(
-        i, &m_state_counters, m_can_push_task));
+        i, &m_state_counters, m_can_push_task, m_lock_free));
   }
 }
 
@@ -242,27 +596,31 @@ template <class Input, typename Executor>
 void SpartaWorkQueue<Input, Executor>::add_item(Input task) {
   m_insert_idx = (m_insert_idx + 1) % m_num_threads;
   assert(m_insert_idx < m_states.size());
-  m_states[m_insert_idx]->m_queue.push(task);
+  m_states[m_insert_idx]->enqueue(task);
 }
 
 template <class Input, typename Executor>
 void SpartaWorkQueue<Input, Executor>::add_item(Input task, size_t worker_id) {
   assert(worker_id < m_states.size());
-  m_states[worker_id]->m_queue.push(task);
+  m_states[worker_id]->enqueue(task);
 }
 
 /*
  * Each worker thread pulls from its own queue first, and then once finished
- * looks randomly at other queues to try and steal work.
+ * looks randomly at other queues to try and steal work. On a pool whose
+ * threads are placed on NUMA nodes, the queues of the same node are looked at
+ * first. Items are dealt round-robin, so each node starts with its share.
  */
 template <class Input, typename Executor>
 void SpartaWorkQueue<Input, Executor>::run_all() {
   m_state_counters.num_non_empty = 0;
   m_state_counters.num_running = 0;
   m_state_counters.waiter->take_all();
-  auto worker = [&](SpartaWorkerState<Input>* state, size_t state_idx) {
-    auto attempts =
-        workqueue_impl::create_permutation(m_num_threads, state_idx);
+  auto worker = [&](SpartaWorkerState<Input>* state,
+                    size_t state_idx,
+                    const std::vector<unsigned int>& thread_nodes) {
+    auto attempts = workqueue_impl::create_permutation(
+        m_num_threads, state_idx, thread_nodes);
     while (true) {
       auto have_task = false;
       for (auto idx : attempts) {
@@ -299,26 +657,38 @@ void SpartaWorkQueue<Input, Executor>::run_all() {
   };
 
   for (size_t i = 0; i < m_num_threads; ++i) {
-    if (!m_states[i]->m_queue.empty()) {
+    auto size = m_states[i]->queue_size();
+    if (m_lock_free) {
+      m_state_counters.num_non_empty += size;
+    } else if (size > 0) {
       ++m_state_counters.num_non_empty;
     }
   }
 
-  std::vector<boost::thread> all_threads;
-  all_threads.reserve(m_num_threads);
-  for (size_t i = 0; i < m_num_threads; ++i) {
-    boost::thread::attributes attrs;
-    attrs.set_stack_size(8 * 1024 * 1024);
-    all_threads.emplace_back(attrs,
-                             std::bind<void>(worker, m_states[i].get(), i));
-  }
+  auto pooled_worker = [&](size_t i) {
+    worker(m_states[i].get(), i, m_thread_pool->thread_nodes());
+  };
+  if (m_thread_pool == nullptr ||
+      !m_thread_pool->try_run(m_num_threads, pooled_worker)) {
+    // Fresh threads are not placed on any node.
+    const std::vector<unsigned int> no_nodes;
+    std::vector<boost::thread> all_threads;
+    all_threads.reserve(m_num_threads);
+    for (size_t i = 0; i < m_num_threads; ++i) {
+      boost::thread::attributes attrs;
+      attrs.set_stack_size(8 * 1024 * 1024);
+      all_threads.emplace_back(attrs, [&, i]() {
+        worker(m_states[i].get(), i, no_nodes);
+      });
+    }
 
-  for (auto& thread : all_threads) {
-    thread.join();
+    for (auto& thread : all_threads) {
+      thread.join();
+    }
   }
 
   for (size_t i = 0; i < m_num_threads; ++i) {
-    assert(m_states[i]->m_queue.empty());
+    assert(m_states[i]->queue_size() == 0);
   }
 }
 
@@ -343,12 +713,15 @@ template <class Input,
 SpartaWorkQueue<Input, workqueue_impl::NoStateWorkQueueHelper<Input, Fn>>
 work_queue(const Fn& fn,
            unsigned int num_threads = parallel::default_num_threads(),
-           bool push_tasks_while_running = false) {
+           bool push_tasks_while_running = false,
+           bool lock_free_queues = false) {
   return SpartaWorkQueue<Input,
                          workqueue_impl::NoStateWorkQueueHelper<Input, Fn>>(
       workqueue_impl::NoStateWorkQueueHelper<Input, Fn>{fn},
       num_threads,
-      push_tasks_while_running);
+      push_tasks_while_running,
+      /*thread_pool=*/nullptr,
+      lock_free_queues);
 }
 template <class Input,
           typename Fn,
@@ -356,12 +729,15 @@ template <class Input,
 SpartaWorkQueue<Input, workqueue_impl::WithStateWorkQueueHelper<Input, Fn>>
 work_queue(const Fn& fn,
            unsigned int num_threads = parallel::default_num_threads(),
-           bool push_tasks_while_running = false) {
+           bool push_tasks_while_running = false,
+           bool lock_free_queues = false) {
   return SpartaWorkQueue<Input,
                          workqueue_impl::WithStateWorkQueueHelper<Input, Fn>>(
       workqueue_impl::WithStateWorkQueueHelper<Input, Fn>{fn},
       num_threads,
-      push_tasks_while_running);
+      push_tasks_while_running,
+      /*thread_pool=*/nullptr,
+      lock_free_queues);
 }
 
 } // namespace sparta
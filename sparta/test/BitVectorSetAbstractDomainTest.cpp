@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "BitVectorSetAbstractDomain.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "PatriciaTreeSetAbstractDomain.h"
+
+using namespace sparta;
+
+// A small threshold, so that the tests cross over to Patricia trees.
+using Domain = BitVectorSetAbstractDomain<uint32_t, 128>;
+
+TEST(BitVectorSetAbstractDomainTest, latticeOperations) {
+  Domain e1(1);
+  Domain e2({1, 2, 3});
+  Domain e3({2, 3, 4096});
+
+  EXPECT_THAT(e1.elements(), ::testing::ElementsAre(1));
+  EXPECT_THAT(e2.elements(), ::testing::ElementsAre(1, 2, 3));
+  EXPECT_THAT(e3.elements(), ::testing::UnorderedElementsAre(2, 3, 4096));
+
+  EXPECT_TRUE(Domain::bottom().leq(Domain::top()));
+  EXPECT_FALSE(Domain::top().leq(Domain::bottom()));
+  EXPECT_FALSE(e2.is_top());
+  EXPECT_FALSE(e2.is_bottom());
+
+  EXPECT_TRUE(e1.leq(e2));
+  EXPECT_FALSE(e1.leq(e3));
+  EXPECT_FALSE(e3.leq(e2));
+  EXPECT_TRUE(e2.equals(Domain({3, 2, 1})));
+  EXPECT_FALSE(e2.equals(e3));
+
+  EXPECT_THAT(e2.join(e3).elements(),
+              ::testing::UnorderedElementsAre(1, 2, 3, 4096));
+  EXPECT_TRUE(e1.join(e2).equals(e2));
+  EXPECT_TRUE(e2.join(Domain::bottom()).equals(e2));
+  EXPECT_TRUE(e2.join(Domain::top()).is_top());
+  EXPECT_TRUE(e1.widening(e2).equals(e2));
+
+  EXPECT_THAT(e2.meet(e3).elements(), ::testing::ElementsAre(2, 3));
+  EXPECT_THAT(e3.meet(e2).elements(), ::testing::ElementsAre(2, 3));
+  EXPECT_TRUE(e3.meet(e2).equals(Domain({2, 3})));
+  EXPECT_TRUE(e1.meet(e2).equals(e1));
+  EXPECT_TRUE(e2.meet(Domain::bottom()).is_bottom());
+  EXPECT_TRUE(e2.meet(Domain::top()).equals(e2));
+  EXPECT_TRUE(e1.meet(e3).elements().empty());
+  EXPECT_TRUE(e1.narrowing(e2).equals(e1));
+
+  EXPECT_TRUE(e2.contains(1));
+  EXPECT_FALSE(e3.contains(1));
+  EXPECT_TRUE(e3.contains(4096));
+
+  // Making sure no side effect took place.
+  EXPECT_THAT(e1.elements(), ::testing::ElementsAre(1));
+  EXPECT_THAT(e2.elements(), ::testing::ElementsAre(1, 2, 3));
+  EXPECT_THAT(e3.elements(), ::testing::UnorderedElementsAre(2, 3, 4096));
+}
+
+TEST(BitVectorSetAbstractDomainTest, destructiveOperations) {
+  Domain e1(1);
+  e1.add({64, 127});
+  EXPECT_EQ(3, e1.size());
+  EXPECT_THAT(e1.elements(), ::testing::ElementsAre(1, 64, 127));
+
+  // Crossing the threshold and coming back.
+  e1.add(128);
+  EXPECT_EQ(4, e1.size());
+  EXPECT_TRUE(e1.contains(128));
+  e1.remove({1, 64, 127, 128});
+  EXPECT_TRUE(e1.elements().empty());
+  EXPECT_TRUE(e1.equals(Domain()));
+  e1.add(5);
+  EXPECT_THAT(e1.elements(), ::testing::ElementsAre(5));
+
+  e1.difference_with(Domain({5, 1000}));
+  EXPECT_TRUE(e1.elements().empty());
+  e1 = Domain({1, 2, 1000});
+  e1.difference_with(Domain({2}));
+  EXPECT_THAT(e1.elements(), ::testing::UnorderedElementsAre(1, 1000));
+  e1.difference_with(Domain::top());
+  EXPECT_TRUE(e1.is_bottom());
+
+  std::ostringstream out;
+  out << Domain({0, 2, 70});
+  EXPECT_EQ("[#3]{0, 2, 70}", out.str());
+}
+
+/*
+ * Replays random operations on bit vector sets and on Patricia tree sets, and
+ * checks that they always agree.
+ */
+TEST(BitVectorSetAbstractDomainTest, agreesWithPatriciaTreeSets) {
+  using Tree = PatriciaTreeSetAbstractDomain<uint32_t>;
+
+  std::mt19937 generator(7);
+  std::uniform_int_distribution<uint32_t> small_dist(0, 200);
+  std::uniform_int_distribution<uint32_t> large_dist(0, 100000);
+  std::uniform_int_distribution<int> size_dist(0, 20);
+  std::uniform_int_distribution<int> op_dist(0, 4);
+
+  auto random_pair = [&]() {
+    Domain bits;
+    Tree tree;
+    // Most sets are dense, some aren't.
+    bool large = size_dist(generator) == 0;
+    for (int i = size_dist(generator); i > 0; --i) {
+      auto x = large ? large_dist(generator) : small_dist(generator);
+      bits.add(x);
+      tree.add(x);
+    }
+    return std::make_pair(bits, tree);
+  };
+  auto same = [](const Domain& bits, const Tree& tree) {
+    auto bit_elements = std::vector<uint32_t>(bits.elements().begin(),
+                                              bits.elements().end());
+    auto tree_elements = std::vector<uint32_t>(tree.elements().begin(),
+                                               tree.elements().end());
+    std::sort(bit_elements.begin(), bit_elements.end());
+    std::sort(tree_elements.begin(), tree_elements.end());
+    return bits.size() == tree.size() && bit_elements == tree_elements;
+  };
+
+  for (size_t i = 0; i < 2000; ++i) {
+    auto p1 = random_pair();
+    auto p2 = random_pair();
+    ASSERT_TRUE(same(p1.first, p1.second));
+    EXPECT_EQ(p1.first.leq(p2.first), p1.second.leq(p2.second));
+    EXPECT_EQ(p1.first.equals(p2.first), p1.second.equals(p2.second));
+    switch (op_dist(generator)) {
+    case 0:
+      p1.first.join_with(p2.first);
+      p1.second.join_with(p2.second);
+      break;
+    case 1:
+      p1.first.meet_with(p2.first);
+      p1.second.meet_with(p2.second);
+      break;
+    case 2:
+      p1.first.difference_with(p2.first);
+      p1.second.difference_with(p2.second);
+      break;
+    case 3: {
+      auto x = small_dist(generator);
+      p1.first.remove(x);
+      p1.second.remove(x);
+      break;
+    }
+    default: {
+      auto x = large_dist(generator);
+      p1.first.add(x);
+      p1.second.add(x);
+      break;
+    }
+    }
+    ASSERT_TRUE(same(p1.first, p1.second));
+    EXPECT_EQ(p1.first.leq(p2.first), p1.second.leq(p2.second));
+    EXPECT_EQ(p2.first.leq(p1.first), p2.second.leq(p1.second));
+  }
+}
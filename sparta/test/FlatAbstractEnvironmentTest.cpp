@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "FlatAbstractEnvironment.h"
+
+#include <cstdint>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <map>
+#include <random>
+#include <sstream>
+
+#include "ConstantAbstractDomain.h"
+#include "HashedSetAbstractDomain.h"
+#include "PatriciaTreeMapAbstractEnvironment.h"
+
+using namespace sparta;
+
+using Domain = HashedSetAbstractDomain<std::string>;
+// A small inline capacity, so that the tests cross over to Patricia trees.
+using Environment = FlatAbstractEnvironment<uint32_t, Domain, 4>;
+
+TEST(FlatAbstractEnvironmentTest, latticeOperations) {
+  Environment e1({{1, Domain({"a", "b"})},
+                  {2, Domain("c")},
+                  {3, Domain({"d", "e", "f"})},
+                  {4, Domain({"a", "f"})}});
+  Environment e2({{0, Domain({"c", "f"})},
+                  {2, Domain({"c", "d"})},
+                  {3, Domain({"d", "e", "g", "h"})}});
+
+  EXPECT_EQ(4, e1.size());
+  EXPECT_EQ(3, e2.size());
+
+  EXPECT_TRUE(Environment::bottom().leq(e1));
+  EXPECT_FALSE(e1.leq(Environment::bottom()));
+  EXPECT_FALSE(Environment::top().leq(e1));
+  EXPECT_TRUE(e1.leq(Environment::top()));
+  EXPECT_FALSE(e1.leq(e2));
+  EXPECT_FALSE(e2.leq(e1));
+
+  EXPECT_TRUE(e1.equals(e1));
+  EXPECT_FALSE(e1.equals(e2));
+
+  Environment join = e1.join(e2);
+  EXPECT_TRUE(e1.leq(join));
+  EXPECT_TRUE(e2.leq(join));
+  EXPECT_EQ(2, join.size());
+  EXPECT_THAT(join.get(3).elements(),
+              ::testing::UnorderedElementsAre("d", "e", "f", "g", "h"));
+  EXPECT_TRUE(join.equals(e1.widening(e2)));
+  EXPECT_TRUE(e1.join(Environment::top()).is_top());
+
+  // The meet has five bindings, which no longer fit inline.
+  Environment meet = e1.meet(e2);
+  EXPECT_TRUE(meet.leq(e1));
+  EXPECT_TRUE(meet.leq(e2));
+  EXPECT_EQ(5, meet.size());
+  EXPECT_THAT(meet.get(0).elements(),
+              ::testing::UnorderedElementsAre("c", "f"));
+  EXPECT_THAT(meet.get(2).elements(), ::testing::ElementsAre("c"));
+  EXPECT_TRUE(meet.equals(e1.narrowing(e2)));
+  EXPECT_TRUE(e1.meet(Environment::bottom()).is_bottom());
+
+  // Joining the large environment with a small one comes back inline.
+  EXPECT_TRUE(meet.join(e1).equals(e1));
+  EXPECT_TRUE(e1.join(meet).equals(e1));
+}
+
+TEST(FlatAbstractEnvironmentTest, destructiveOperations) {
+  Environment e1({{1, Domain({"a", "b"})}});
+  e1.set(2, Domain({"c", "f"})).set(4, Domain({"e", "f", "g"}));
+  EXPECT_EQ(3, e1.size());
+
+  auto add_e = [](const Domain& s) {
+    auto copy = s;
+    copy.add("e");
+    return copy;
+  };
+  e1.update(1, add_e).update(3, add_e);
+  EXPECT_EQ(3, e1.size());
+  EXPECT_THAT(e1.get(1).elements(),
+              ::testing::UnorderedElementsAre("a", "b", "e"));
+  EXPECT_TRUE(e1.get(3).is_top());
+
+  e1.set(2, Domain::top());
+  EXPECT_EQ(2, e1.size());
+  e1.set(1, Domain::top()).set(4, Domain::top());
+  EXPECT_TRUE(e1.is_top());
+
+  Environment e2;
+  for (uint32_t i = 0; i < 10; ++i) {
+    e2.set(i, Domain(std::to_string(i)));
+  }
+  EXPECT_EQ(10, e2.size());
+  EXPECT_TRUE(e2.erase_all_matching(8));
+  EXPECT_EQ(8, e2.size());
+  EXPECT_TRUE(e2.get(9).is_top());
+  EXPECT_TRUE(e2.map([](const Domain& s) {
+    auto copy = s;
+    copy.add("x");
+    return copy;
+  }));
+  EXPECT_THAT(e2.get(7).elements(),
+              ::testing::UnorderedElementsAre("7", "x"));
+
+  e2.set(3, Domain::bottom());
+  EXPECT_TRUE(e2.is_bottom());
+  e2.set(3, Domain("a"));
+  EXPECT_TRUE(e2.is_bottom());
+}
+
+/*
+ * Replays random operations on a flat environment and on a Patricia tree
+ * environment, and checks that they always agree.
+ */
+TEST(FlatAbstractEnvironmentTest, agreesWithPatriciaTreeEnvironment) {
+  using Constant = ConstantAbstractDomain<int>;
+  using Flat = FlatAbstractEnvironment<uint32_t, Constant, 4>;
+  using Tree = PatriciaTreeMapAbstractEnvironment<uint32_t, Constant>;
+
+  std::mt19937 generator(42);
+  std::uniform_int_distribution<uint32_t> variable_dist(0, 11);
+  std::uniform_int_distribution<int> value_dist(0, 3);
+  std::uniform_int_distribution<int> size_dist(0, 10);
+  std::uniform_int_distribution<int> op_dist(0, 6);
+
+  auto random_constant = [&]() {
+    int v = value_dist(generator);
+    return v == 0 ? Constant::top() : Constant(v);
+  };
+  auto random_pair = [&]() {
+    Flat flat;
+    Tree tree;
+    for (int i = size_dist(generator); i > 0; --i) {
+      auto variable = variable_dist(generator);
+      auto value = random_constant();
+      flat.set(variable, value);
+      tree.set(variable, value);
+    }
+    return std::make_pair(flat, tree);
+  };
+  auto same = [](const Flat& flat, const Tree& tree) {
+    if (flat.kind() != tree.kind()) {
+      return false;
+    }
+    if (!flat.is_value()) {
+      return true;
+    }
+    std::map<uint32_t, int> flat_bindings;
+    flat.visit([&](uint32_t variable, const Constant& value) {
+      flat_bindings.emplace(variable, *value.get_constant());
+    });
+    std::map<uint32_t, int> tree_bindings;
+    for (const auto& binding : tree.bindings()) {
+      tree_bindings.emplace(binding.first, *binding.second.get_constant());
+    }
+    return flat.size() == tree.size() && flat_bindings == tree_bindings;
+  };
+
+  for (size_t i = 0; i < 2000; ++i) {
+    auto p1 = random_pair();
+    auto p2 = random_pair();
+    ASSERT_TRUE(same(p1.first, p1.second));
+    EXPECT_EQ(p1.first.leq(p2.first), p1.second.leq(p2.second));
+    EXPECT_EQ(p1.first.equals(p2.first), p1.second.equals(p2.second));
+    switch (op_dist(generator)) {
+    case 0:
+      p1.first.join_with(p2.first);
+      p1.second.join_with(p2.second);
+      break;
+    case 1:
+      p1.first.meet_with(p2.first);
+      p1.second.meet_with(p2.second);
+      break;
+    case 2:
+      p1.first.widen_with(p2.first);
+      p1.second.widen_with(p2.second);
+      break;
+    case 3:
+      p1.first.narrow_with(p2.first);
+      p1.second.narrow_with(p2.second);
+      break;
+    case 4: {
+      auto variable = variable_dist(generator);
+      auto value = random_constant();
+      auto op = [&value](const Constant& x) { return x.join(value); };
+      p1.first.update(variable, op);
+      p1.second.update(variable, op);
+      break;
+    }
+    case 5: {
+      auto mask = 1u << (variable_dist(generator) % 4);
+      EXPECT_EQ(p1.first.erase_all_matching(mask),
+                p1.second.erase_all_matching(mask));
+      break;
+    }
+    default:
+      // Mix representations: a large environment against a small one.
+      for (uint32_t v = 0; v < 8; ++v) {
+        p1.first.set(v, Constant(1));
+        p1.second.set(v, Constant(1));
+      }
+      p1.first.join_with(p2.first);
+      p1.second.join_with(p2.second);
+      break;
+    }
+    ASSERT_TRUE(same(p1.first, p1.second));
+  }
+}
+
+TEST(FlatAbstractEnvironmentTest, prettyPrinting) {
+  Environment e({{1, Domain("a")}, {3, Domain("b")}});
+  std::ostringstream out;
+  out << e;
+  EXPECT_EQ("[#2]{1 -> [#1]{a}, 3 -> [#1]{b}}", out.str());
+  out.str("");
+  out << Environment::bottom() << " " << Environment::top();
+  EXPECT_EQ("_|_ T", out.str());
+}
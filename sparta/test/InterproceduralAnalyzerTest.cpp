@@ -14,9 +14,11 @@
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include <mutex>
 #include <stdexcept>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 
 namespace language {
 
@@ -570,7 +572,9 @@ class AnalysisRegistry : public sparta::AbstractRegistry {
  private:
   sparta::PatriciaTreeMapAbstractEnvironment<language::Function*, Summary>
       m_env;
+  std::unordered_set<language::Function*> m_updated;
   bool m_has_update = false;
+  mutable std::mutex m_mutex;
 
  public:
   bool has_update() const override { return m_has_update; }
@@ -579,11 +583,24 @@ class AnalysisRegistry : public sparta::AbstractRegistry {
 
   void update(language::Function* func,
               std::function<Summary(const Summary&)> update) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto old_summary = m_env.get(func);
     m_env.update(func, update);
-    m_has_update = true;
+    if (!m_env.get(func).equals(old_summary)) {
+      m_updated.insert(func);
+      m_has_update = true;
+    }
+  }
+
+  bool consume_update(language::Function* func) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_updated.erase(func) != 0;
   }
 
-  Summary get(language::Function* func) { return m_env.get(func); }
+  Summary get(language::Function* func) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_env.get(func);
+  }
 };
 
 struct PurityAnalysisAdaptor : public language::AnalysisAdaptorBase {
@@ -603,7 +620,7 @@ using Analysis = sparta::InterproceduralAnalyzer<PurityAnalysisAdaptor>;
 
 } // namespace purity_interprocedural
 
-void test1() {
+void test1(bool dependency_driven) {
   using namespace language;
 
   Function fun1, fun2, fun3, fun4, fun5, fun6, fun7, mainfun;
@@ -658,7 +675,21 @@ void test1() {
                                    &fun5, &fun6, &fun7, &mainfun};
   Program prog(std::move(functions), &mainfun);
   purity_interprocedural::Analysis inter(&prog, 20 /* max iteration */);
-  inter.run();
+  size_t iterations = 0;
+  inter.set_logger([&iterations](const std::string& message) {
+    if (message.find("Iteration") == 0) {
+      ++iterations;
+    }
+  });
+  if (dependency_driven) {
+    inter.run_dependency_driven();
+    // The summaries stabilized after the first round, which is confirmed by
+    // the second one.
+    EXPECT_EQ(2, iterations);
+  } else {
+    inter.run();
+    EXPECT_LT(2, iterations);
+  }
 
   ASSERT_TRUE(inter.registry.get(&fun1).is_value());
   EXPECT_TRUE(inter.registry.get(&fun1).pure());
@@ -682,4 +713,6 @@ void test1() {
   EXPECT_TRUE(inter.registry.get(&fun7).is_top());
 }
 
-TEST(AnalyzerTest, test1) { test1(); }
+TEST(AnalyzerTest, test1) { test1(/* dependency_driven */ false); }
+
+TEST(AnalyzerTest, dependencyDriven) { test1(/* dependency_driven */ true); }
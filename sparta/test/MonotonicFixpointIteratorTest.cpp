@@ -723,6 +723,10 @@ class FixpointEngine final : public FixpointIteratorBase<
  public:
   explicit FixpointEngine(const Program& program) : Base(program) {}
 
+  template <typename... Args>
+  FixpointEngine(const Program& program, Args&&... args)
+      : Base(program, std::forward<Args>(args)...) {}
+
   void analyze_node(const NodeId& bb,
                     AbstractEnvironment* current_state) const override {
     for (const auto& statement : bb->statements()) {
@@ -860,3 +864,184 @@ TYPED_TEST(MonotonicFixpointIteratorNumericalTest, program2) {
             IntegerSetAbstractDomain::top());
   EXPECT_EQ(fp.get_exit_state_at(bb3).get(&x), IntegerSetAbstractDomain::top());
 }
+
+TYPED_TEST(MonotonicFixpointIteratorNumericalTest, wideningDelay) {
+  using namespace numerical;
+
+  /*
+   * bb1: x = 1;
+   *      y = 1;
+   *      while (...) {
+   * bb2:   y = x + 0;
+   *        x = 2;
+   *      }
+   * bb3: return
+   *
+   * The loop needs two extrapolations before it stabilizes. The second one
+   * widens y to Top, unless the widening is delayed.
+   */
+  Program program;
+
+  BasicBlock* bb1 = program.create_block();
+  BasicBlock* bb2 = program.create_block();
+  BasicBlock* bb3 = program.create_block();
+
+  std::string x = "x";
+  std::string y = "y";
+
+  bb1->add(std::make_unique<Assignment>(&x, 1));
+  bb1->add(std::make_unique<Assignment>(&y, 1));
+  bb1->add_successor(bb2);
+
+  bb2->add(std::make_unique<Addition>(&y, &x, 0));
+  bb2->add(std::make_unique<Assignment>(&x, 2));
+  bb2->add_successor(bb2);
+  bb2->add_successor(bb3);
+
+  program.set_entry(bb1);
+  program.set_exit(bb3);
+
+  TypeParam widening(program);
+  widening.enable_stats();
+  widening.run(AbstractEnvironment::top());
+  auto stats = widening.get_stats();
+  EXPECT_EQ(stats.widenings, 1);
+  EXPECT_GE(stats.node_visits, 3);
+  EXPECT_GE(stats.edge_visits, stats.node_visits - 1);
+  EXPECT_GE(stats.joins, stats.edge_visits);
+
+  TypeParam delayed(program);
+  delayed.set_widening_delay(2);
+  delayed.enable_stats();
+  delayed.run(AbstractEnvironment::top());
+  EXPECT_EQ(delayed.get_stats().widenings, 0);
+  EXPECT_GT(delayed.get_stats().joins, stats.joins);
+  // The refinement of the entry state once the loop has stabilized recovers
+  // the precision lost to the widening here.
+  EXPECT_EQ(delayed.get_entry_state_at(bb2).get(&y),
+            (IntegerSetAbstractDomain{1, 2}));
+  EXPECT_EQ(widening.get_entry_state_at(bb2), delayed.get_entry_state_at(bb2));
+
+  TypeParam quiet(program);
+  quiet.run(AbstractEnvironment::top());
+  EXPECT_EQ(quiet.get_stats().node_visits, 0);
+}
+
+TEST(MonotonicFixpointIteratorJointTest, sharedOrdering) {
+  using namespace numerical;
+  using Engine = FixpointEngine<sparta::MonotonicFixpointIterator>;
+
+  /*
+   * bb1: x = 1;
+   *      while (...) {
+   * bb2:   x = x + 1;
+   *        y = y + 2;
+   *      }
+   * bb3: return
+   */
+  Program program;
+
+  BasicBlock* bb1 = program.create_block();
+  BasicBlock* bb2 = program.create_block();
+  BasicBlock* bb3 = program.create_block();
+
+  std::string x = "x";
+  std::string y = "y";
+
+  bb1->add(std::make_unique<Assignment>(&x, 1));
+  bb1->add_successor(bb2);
+
+  bb2->add(std::make_unique<Addition>(&x, &x, 1));
+  bb2->add(std::make_unique<Addition>(&y, &y, 2));
+  bb2->add_successor(bb2);
+  bb2->add_successor(bb3);
+
+  program.set_entry(bb1);
+  program.set_exit(bb3);
+
+  auto init1 = AbstractEnvironment::top();
+  auto init2 = AbstractEnvironment::top();
+  init2.set(&y, IntegerSetAbstractDomain{0});
+
+  Engine separate1(program);
+  separate1.run(init1);
+  Engine separate2(program);
+  separate2.run(init2);
+
+  auto wpo =
+      sparta::make_weak_partial_ordering<ProgramInterface,
+                                         std::hash<BasicBlock*>>(program);
+  Engine joint1(program, wpo);
+  Engine joint2(program, wpo);
+  EXPECT_EQ(joint1.get_wpo(), joint2.get_wpo());
+  sparta::run_jointly(std::forward_as_tuple(joint1, joint2),
+                      std::make_tuple(init1, init2));
+
+  for (auto* bb : {bb1, bb2, bb3}) {
+    EXPECT_EQ(joint1.get_entry_state_at(bb), separate1.get_entry_state_at(bb));
+    EXPECT_EQ(joint1.get_exit_state_at(bb), separate1.get_exit_state_at(bb));
+    EXPECT_EQ(joint2.get_entry_state_at(bb), separate2.get_entry_state_at(bb));
+    EXPECT_EQ(joint2.get_exit_state_at(bb), separate2.get_exit_state_at(bb));
+  }
+  EXPECT_EQ(joint2.get_exit_state_at(bb1).get(&y),
+            IntegerSetAbstractDomain{0});
+  EXPECT_EQ(joint2.get_exit_state_at(bb3).get(&y),
+            IntegerSetAbstractDomain::top());
+
+  // Iterators with different orderings can't be run jointly.
+  Engine other(program);
+  EXPECT_THROW(sparta::run_jointly(std::forward_as_tuple(joint1, other),
+                                   std::make_tuple(init1, init1)),
+               sparta::invalid_argument);
+}
+
+namespace {
+
+class RecordingObserver final : public sparta::FixpointRunObserver {
+ public:
+  void begin_run(const std::type_info& domain) override {
+    runs.emplace_back(&domain);
+    ++depth;
+  }
+
+  void end_run() override { --depth; }
+
+  std::vector<const std::type_info*> runs;
+  int depth{0};
+};
+
+} // namespace
+
+TEST(MonotonicFixpointIteratorJointTest, runObserver) {
+  using namespace numerical;
+  using Engine = FixpointEngine<sparta::MonotonicFixpointIterator>;
+
+  Program program;
+  BasicBlock* bb1 = program.create_block();
+  BasicBlock* bb2 = program.create_block();
+  std::string x = "x";
+  bb1->add(std::make_unique<Assignment>(&x, 1));
+  bb1->add_successor(bb2);
+  program.set_entry(bb1);
+  program.set_exit(bb2);
+
+  RecordingObserver observer;
+  sparta::fixpoint_run_observer() = &observer;
+  Engine engine(program);
+  engine.run(AbstractEnvironment::top());
+  Engine joint1(program, engine.get_wpo());
+  Engine joint2(program, engine.get_wpo());
+  sparta::run_jointly(
+      std::forward_as_tuple(joint1, joint2),
+      std::make_tuple(AbstractEnvironment::top(), AbstractEnvironment::top()));
+  sparta::fixpoint_run_observer() = nullptr;
+
+  // The joint run counts as a single run.
+  ASSERT_EQ(observer.runs.size(), 2);
+  EXPECT_EQ(*observer.runs[0], typeid(AbstractEnvironment));
+  EXPECT_EQ(*observer.runs[1], typeid(AbstractEnvironment));
+  EXPECT_EQ(observer.depth, 0);
+
+  engine.run(AbstractEnvironment::top());
+  EXPECT_EQ(observer.runs.size(), 2);
+}
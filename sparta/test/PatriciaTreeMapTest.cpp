@@ -209,3 +209,39 @@ TEST(PatriciaTreeMapTest, difference) {
                                      create_pt_map({{2, 1}, {4, 1}, {6, 1}})),
             create_pt_map({{1, 3}, {3, 3}, {5, 3}}));
 }
+
+TEST(PatriciaTreeMapTest, hashConsing) {
+  // Built independently, so no nodes are shared.
+  pt_map m1 = create_pt_map({{1, 10}, {2, 20}, {3, 30}, {100, 1000}});
+  pt_map m2 = create_pt_map({{100, 1000}, {3, 30}, {2, 20}, {1, 10}});
+  pt_map m3 = create_pt_map({{1, 10}, {2, 20}, {3, 31}, {100, 1000}});
+  EXPECT_TRUE(m1.equals(m2));
+  EXPECT_FALSE(m1.reference_equals(m2));
+
+  pt_map::hash_cons_table table;
+  m1.hash_cons(table);
+  size_t nodes = table.size();
+  m2.hash_cons(table);
+  EXPECT_TRUE(m1.reference_equals(m2));
+  EXPECT_EQ(table.size(), nodes);
+
+  // Only the path to the differing leaf is new.
+  m3.hash_cons(table);
+  EXPECT_FALSE(m1.reference_equals(m3));
+  EXPECT_GT(table.size(), nodes);
+  EXPECT_EQ(m3.at(3), 31);
+  EXPECT_EQ(m3.at(100), 1000);
+
+  // Joining hash-consed maps that agree takes the physical-equality shortcut.
+  auto joined = m1.get_union_with(
+      [](const uint32_t& x, const uint32_t&) { return x; }, m2);
+  EXPECT_TRUE(joined.reference_equals(m1));
+
+  // Hash-consing again after an update is incremental and canonical.
+  auto m4 = m1;
+  m4.insert_or_assign(3, 31);
+  nodes = table.size();
+  m4.hash_cons(table);
+  EXPECT_TRUE(m4.reference_equals(m3));
+  EXPECT_EQ(table.size(), nodes);
+}
@@ -254,3 +254,92 @@ TEST(S_ExpressionTest, patternMatching) {
   EXPECT_TRUE(y.is_nil());
   EXPECT_EQ(parse("((c d) e)"), z);
 }
+
+namespace {
+
+// Reads all the S-expressions of the input, and returns the error message if
+// any.
+std::string read_all(const std::string& str, std::vector<s_expr>* exprs) {
+  s_expr_reader reader(str);
+  s_expr expr;
+  while (reader.read(&expr)) {
+    exprs->push_back(expr);
+  }
+  return reader.fail() ? reader.what() : "";
+}
+
+std::string read_all_with_istream(const std::string& str,
+                                  std::vector<s_expr>* exprs) {
+  std::istringstream str_input(str);
+  s_expr_istream input(str_input);
+  s_expr expr;
+  for (;;) {
+    input >> expr;
+    if (input.eoi()) {
+      return "";
+    }
+    if (input.fail()) {
+      return input.what();
+    }
+    exprs->push_back(expr);
+  }
+}
+
+} // namespace
+
+TEST(S_ExpressionTest, reader) {
+  std::vector<std::string> inputs = {
+      "",
+      "  ; nothing but a comment",
+      "(cons a (cons b (cons c ())))",
+      "a #12 #-7 #+3 \"\" \"with \\\"quotes\\\" and \\\\\" () (())",
+      R"(
+        (method (public static) "LFoo;.bar:(I)V" ; a comment
+          (
+            (load-param v0)
+            (const v1 #2147483647)
+            (const-string "multi
+line")
+            (return-void)
+          )
+        )
+        (x) y
+      )",
+      "((a) b ()",
+      "(\n(a)\nb\n()\n",
+      "((a) b c))",
+      "(a b #9999999999999)",
+      "(a b #-9999999999999)",
+      "(a b \"abcdef)",
+      "123, (a b c)",
+      "(a\n b ; c\n d, e)",
+  };
+  for (const auto& input : inputs) {
+    std::vector<s_expr> exprs;
+    std::vector<s_expr> expected_exprs;
+    auto error = read_all(input, &exprs);
+    auto expected_error = read_all_with_istream(input, &expected_exprs);
+    EXPECT_EQ(error, expected_error) << input;
+    EXPECT_EQ(exprs, expected_exprs) << input;
+  }
+
+  s_expr_reader reader("(a #1 \"b\\\")\" (c)) d ; e\n(f)");
+  std::vector<std::string> texts;
+  std::string_view text;
+  while (reader.skip(&text)) {
+    texts.emplace_back(text);
+  }
+  EXPECT_TRUE(reader.eoi());
+  EXPECT_THAT(texts,
+              ::testing::ElementsAre("(a #1 \"b\\\")\" (c))", "d", "(f)"));
+
+  // Unlike s_expr_istream, the reader counts the lines of string literals.
+  std::vector<s_expr> exprs;
+  EXPECT_EQ("On line 3: Unexpected character encountered: ','",
+            read_all("(a\n\"b\nc\" d, e)", &exprs));
+
+  s_expr_reader bad_reader("(a (b)");
+  EXPECT_FALSE(bad_reader.skip(&text));
+  EXPECT_TRUE(bad_reader.fail());
+  EXPECT_EQ("On line 1: Incomplete S-expression", bad_reader.what());
+}
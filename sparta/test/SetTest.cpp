@@ -5,9 +5,11 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include "BitVectorSet.h"
 #include "FlatSet.h"
 #include "PatriciaTreeSet.h"
 
+#include <boost/container/small_vector.hpp>
 #include <cstdint>
 #include <limits>
 #include <random>
@@ -87,8 +89,15 @@ class UInt32SetTest : public ::testing::Test {
   std::uniform_int_distribution<uint32_t> m_elem_dist;
 };
 
-using UInt32Sets =
-    ::testing::Types<PatriciaTreeSet<uint32_t>, FlatSet<uint32_t>>;
+using SmallFlatSet = FlatSet<uint32_t,
+                             std::less<uint32_t>,
+                             std::equal_to<uint32_t>,
+                             boost::container::small_vector<uint32_t, 4>>;
+
+using UInt32Sets = ::testing::Types<PatriciaTreeSet<uint32_t>,
+                                    FlatSet<uint32_t>,
+                                    SmallFlatSet,
+                                    BitVectorSet<uint32_t>>;
 TYPED_TEST_CASE(UInt32SetTest, UInt32Sets);
 
 TYPED_TEST(UInt32SetTest, basicOperations) {
@@ -206,6 +215,38 @@ TYPED_TEST(UInt32SetTest, robustness) {
   }
 }
 
+TEST(FlatSetTest, overlappingSets) {
+  // Sets of small elements overlap, and their sizes vary enough to exercise
+  // both the merges and the binary searches.
+  std::mt19937 generator;
+  std::uniform_int_distribution<uint32_t> size_dist(0, 64);
+  std::uniform_int_distribution<uint32_t> elem_dist(0, 100);
+  auto generate_random_set = [&]() {
+    FlatSet<uint32_t> s;
+    size_t size = size_dist(generator);
+    for (size_t i = 0; i < size; ++i) {
+      s.insert(elem_dist(generator));
+    }
+    return s;
+  };
+  for (size_t k = 0; k < 100; ++k) {
+    auto s1 = generate_random_set();
+    auto s2 = generate_random_set();
+    auto elems1 = std::vector<uint32_t>(s1.begin(), s1.end());
+    auto elems2 = std::vector<uint32_t>(s2.begin(), s2.end());
+    EXPECT_THAT(s1.get_union_with(s2),
+                ::testing::ElementsAreArray(get_union(elems1, elems2)))
+        << "s1 = " << s1 << ", s2 = " << s2;
+    EXPECT_THAT(s1.get_intersection_with(s2),
+                ::testing::ElementsAreArray(get_intersection(elems1, elems2)))
+        << "s1 = " << s1 << ", s2 = " << s2;
+
+    auto joined = s1;
+    joined.union_with(s1.get_intersection_with(s2));
+    EXPECT_EQ(joined, s1);
+  }
+}
+
 template <typename Set>
 class StringSetTest : public ::testing::Test {
  protected:
@@ -257,8 +298,9 @@ TYPED_TEST(StringSetTest, setsOfPointers) {
 template <typename Set>
 class UInt64SetTest : public ::testing::Test {};
 
-using UInt64Sets =
-    ::testing::Types<PatriciaTreeSet<uint64_t>, FlatSet<uint64_t>>;
+using UInt64Sets = ::testing::Types<PatriciaTreeSet<uint64_t>,
+                                    FlatSet<uint64_t>,
+                                    BitVectorSet<uint64_t>>;
 TYPED_TEST_CASE(UInt64SetTest, UInt64Sets);
 
 TYPED_TEST(UInt64SetTest, setOfUnsignedInt64) {
@@ -273,3 +315,23 @@ TYPED_TEST(UInt64SetTest, setOfUnsignedInt64) {
     EXPECT_EQ(1, values.count(x));
   }
 }
+
+TEST(PatriciaTreeSetTest, hashConsing) {
+  using pt_set = PatriciaTreeSet<uint32_t>;
+  pt_set s1{1, 2, 3, 100};
+  pt_set s2{100, 3, 2, 1};
+  pt_set s3{1, 2, 3};
+  EXPECT_TRUE(s1.equals(s2));
+  EXPECT_FALSE(s1.reference_equals(s2));
+
+  pt_set::hash_cons_table table;
+  s1.hash_cons(table);
+  s2.hash_cons(table);
+  EXPECT_TRUE(s1.reference_equals(s2));
+  s3.hash_cons(table);
+  auto s4 = s1;
+  s4.remove(100);
+  s4.hash_cons(table);
+  EXPECT_TRUE(s4.reference_equals(s3));
+  EXPECT_TRUE(s1.get_union_with(s2).reference_equals(s1));
+}
@@ -11,8 +11,8 @@
 
 using namespace sparta;
 
-using Set = FlatSet<unsigned>;
 using Domain = SmallSortedSetAbstractDomain<unsigned, /* MaxCount */ 4>;
+using Set = Domain::Set;
 
 class SmallSortedSetAbstractDomainTest : public ::testing::Test {};
 
@@ -11,6 +11,7 @@
 #include <chrono>
 #include <gtest/gtest.h>
 #include <random>
+#include <set>
 
 constexpr unsigned int NUM_INTS = 1000;
 
@@ -99,3 +100,172 @@ TEST(SpartaWorkQueueTest, preciseScheduling) {
     ASSERT_EQ(1, array[idx]);
   }
 }
+
+TEST(SpartaWorkQueueTest, threadPoolReusesThreads) {
+  constexpr size_t num_threads{4};
+  sparta::ThreadPool pool(num_threads);
+  std::mutex ids_mtx;
+  std::set<boost::thread::id> ids;
+  using Executor =
+      std::function<void(sparta::SpartaWorkerState<int*>*, int*)>;
+  for (int run = 0; run < 10; ++run) {
+    std::array<int, NUM_INTS> array = {0};
+    auto wq = sparta::SpartaWorkQueue<int*, Executor>(
+        [&](sparta::SpartaWorkerState<int*>*, int* a) {
+          (*a)++;
+          std::lock_guard<std::mutex> lock(ids_mtx);
+          ids.insert(boost::this_thread::get_id());
+        },
+        num_threads,
+        /*push_tasks_while_running=*/false,
+        &pool);
+    for (int idx = 0; idx < NUM_INTS; ++idx) {
+      wq.add_item(&array[idx]);
+    }
+    wq.run_all();
+    for (int idx = 0; idx < NUM_INTS; ++idx) {
+      ASSERT_EQ(1, array[idx]);
+    }
+  }
+  // All runs were served by the same persistent threads.
+  EXPECT_LE(ids.size(), num_threads);
+}
+
+TEST(SpartaWorkQueueTest, threadPoolFallsBackWhenBusy) {
+  constexpr size_t num_threads{2};
+  sparta::ThreadPool pool(num_threads);
+  std::atomic<int> result{0};
+  using Executor =
+      std::function<void(sparta::SpartaWorkerState<int>*, int)>;
+  auto outer = sparta::SpartaWorkQueue<int, Executor>(
+      [&](sparta::SpartaWorkerState<int>*, int a) {
+        // The pool is busy running the outer queue, so the nested queue must
+        // spawn its own threads rather than deadlock.
+        auto inner = sparta::SpartaWorkQueue<int, Executor>(
+            [&](sparta::SpartaWorkerState<int>*, int b) { result += b; },
+            num_threads,
+            /*push_tasks_while_running=*/false,
+            &pool);
+        inner.add_item(a);
+        inner.add_item(a);
+        inner.run_all();
+      },
+      num_threads,
+      /*push_tasks_while_running=*/false,
+      &pool);
+  for (int i = 1; i <= 10; ++i) {
+    outer.add_item(i);
+  }
+  outer.run_all();
+  EXPECT_EQ(110, result);
+}
+
+TEST(SpartaWorkQueueTest, threadPoolInitializesThreads) {
+  constexpr size_t num_threads{4};
+  std::array<std::atomic<int>, num_threads> initialized{};
+  {
+    sparta::ThreadPool pool(num_threads, {0, 0, 1, 1},
+                            [&](size_t idx) { initialized[idx]++; });
+    std::atomic<int> result{0};
+    using Executor = std::function<void(sparta::SpartaWorkerState<int>*, int)>;
+    auto wq = sparta::SpartaWorkQueue<int, Executor>(
+        [&](sparta::SpartaWorkerState<int>*, int a) { result += a; },
+        num_threads,
+        /*push_tasks_while_running=*/false,
+        &pool);
+    for (int i = 1; i <= 10; ++i) {
+      wq.add_item(i);
+    }
+    wq.run_all();
+    EXPECT_EQ(55, result);
+  }
+  for (const auto& count : initialized) {
+    EXPECT_EQ(1, count);
+  }
+}
+
+TEST(SpartaWorkQueueTest, permutationVisitsSameNodeFirst) {
+  std::vector<unsigned int> thread_nodes{0, 1, 0, 1, 0, 1};
+  for (unsigned int idx = 0; idx < thread_nodes.size(); ++idx) {
+    auto attempts =
+        sparta::workqueue_impl::create_permutation(6, idx, thread_nodes);
+    ASSERT_EQ(6, attempts.size());
+    EXPECT_EQ(idx, attempts[0]);
+    for (size_t i = 0; i < 3; ++i) {
+      EXPECT_EQ(thread_nodes[idx], thread_nodes[attempts[i]]);
+    }
+    for (size_t i = 3; i < 6; ++i) {
+      EXPECT_NE(thread_nodes[idx], thread_nodes[attempts[i]]);
+    }
+    std::set<unsigned int> all(attempts.begin(), attempts.end());
+    EXPECT_EQ(6, all.size());
+  }
+}
+
+TEST(SpartaWorkQueueTest, lockFreeForeachTest) {
+  std::array<int, NUM_INTS> array = {0};
+
+  auto wq = sparta::work_queue<int*>([](int* a) { (*a)++; },
+                                     4,
+                                     /*push_tasks_while_running=*/false,
+                                     /*lock_free_queues=*/true);
+
+  for (int idx = 0; idx < NUM_INTS; ++idx) {
+    wq.add_item(&array[idx]);
+  }
+  wq.run_all();
+  for (int idx = 0; idx < NUM_INTS; ++idx) {
+    ASSERT_EQ(1, array[idx]);
+  }
+}
+
+TEST(SpartaWorkQueueTest, lockFreeDynamicallyAddingTasks) {
+  constexpr size_t num_threads{3};
+  std::atomic<int> result{0};
+  auto wq = sparta::work_queue<int>(
+      [&](sparta::SpartaWorkerState<int>* worker_state, int a) {
+        if (a > 0) {
+          // Fan out so that the deques grow and other workers can steal.
+          worker_state->push_task(a - 1);
+          worker_state->push_task(a - 1);
+          ++result;
+        }
+      },
+      num_threads,
+      /*push_tasks_while_running=*/true,
+      /*lock_free_queues=*/true);
+  wq.add_item(12);
+  wq.run_all();
+
+  // A complete binary tree of depth 12 has 2^12 - 1 inner nodes.
+  EXPECT_EQ((1 << 12) - 1, result);
+}
+
+TEST(SpartaWorkQueueTest, lockFreeIgnoredForNonTrivialInputs) {
+  std::atomic<size_t> total{0};
+  auto wq = sparta::work_queue<std::string>(
+      [&](std::string s) { total += s.size(); },
+      2,
+      /*push_tasks_while_running=*/false,
+      /*lock_free_queues=*/true);
+  for (int idx = 0; idx < 100; ++idx) {
+    wq.add_item("abc");
+  }
+  wq.run_all();
+  EXPECT_EQ(300, total);
+}
+
+TEST(ChaseLevDequeTest, ownerIsLifoThievesAreFifo) {
+  sparta::workqueue_impl::ChaseLevDeque<int> deque;
+  for (int i = 0; i < 200; ++i) {
+    deque.push(i);
+  }
+  EXPECT_EQ(200, deque.size());
+  EXPECT_EQ(199, *deque.pop());
+  EXPECT_EQ(0, *deque.steal());
+  EXPECT_EQ(198, deque.size());
+  while (deque.pop()) {
+  }
+  EXPECT_TRUE(deque.empty());
+  EXPECT_FALSE(deque.steal());
+}
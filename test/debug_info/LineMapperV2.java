@@ -7,9 +7,12 @@
 
 package com.facebook.redexlinemap;
 
+import java.io.ByteArrayOutputStream;
 import java.io.DataInputStream;
 import java.io.InputStream;
 import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
 import java.util.ArrayList;
 import java.util.HashMap;
 import java.util.Collections;
@@ -88,27 +91,34 @@ public class LineMapperV2 {
   }
 
   private void readDebugMap(InputStream ins) throws Exception {
-    DataInputStream ds = new DataInputStream(ins);
-    long magic = readInt(ds);
+    // The index is at the end of the map, so read it whole.
+    ByteArrayOutputStream bos = new ByteArrayOutputStream();
+    byte[] buf = new byte[1 << 16];
+    for (int n = ins.read(buf); n != -1; n = ins.read(buf)) {
+      bos.write(buf, 0, n);
+    }
+    ByteBuffer bb = ByteBuffer.wrap(bos.toByteArray()).order(ByteOrder.LITTLE_ENDIAN);
+    long magic = bb.getInt(0);
     if (magic != 0xfaceb000) {
       throw new IllegalArgumentException("Magic number mismatch: got " + Long.toHexString(magic));
     }
-    int version = readInt(ds);
-    if (version != 1) {
+    int version = bb.getInt(4);
+    if (version != 2) {
       throw new IllegalArgumentException(
           "Version mismatch: Expected 2, got " + Integer.toString(version));
     }
-    int count = readInt(ds);
+    int count = bb.getInt(bb.limit() - 8);
+    int indexOffset = bb.getInt(bb.limit() - 4);
 
     ArrayList<MethodData> methodData = new ArrayList<>();
     for (int i = 0; i != count; i++) {
-      methodData.add(new MethodData(readLong(ds), readInt(ds), readInt(ds)));
+      int entry = indexOffset + i * 16;
+      methodData.add(new MethodData(bb.getLong(entry), bb.getInt(entry + 8), bb.getInt(entry + 12)));
     }
 
     lineMappings = new HashMap<>();
-    for (int i = 0; i != count; i++) {
-      long methodId = readLong(ds);
-      MethodData md = methodData.get(i);
+    for (MethodData md : methodData) {
+      long methodId = bb.getLong(md.i1);
       if (methodId != md.id) {
         throw new IllegalArgumentException("ID mismatch: " + methodId + " vs " + md.id);
       }
@@ -120,7 +130,8 @@ public class LineMapperV2 {
       if (lineMappingCount > 0) {
         ArrayList<OffsetLine> methodLineMappings = new ArrayList<>();
         for (int j = 0; j != lineMappingCount; j++) {
-          methodLineMappings.add(new OffsetLine(readInt(ds), readInt(ds)));
+          int item = md.i1 + 8 + j * 8;
+          methodLineMappings.add(new OffsetLine(bb.getInt(item), bb.getInt(item + 4)));
         }
         lineMappings.put(methodId, methodLineMappings);
       }
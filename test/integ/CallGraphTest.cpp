@@ -9,6 +9,7 @@
 #include <gtest/gtest.h>
 
 #include "CallGraph.h"
+#include "ConstantAbstractDomain.h"
 #include "DexClass.h"
 #include "MethodOverrideGraph.h"
 #include "RedexTest.h"
@@ -155,6 +156,39 @@ struct CallGraphTest : public RedexIntegrationTest {
     }
     return ret;
   }
+
+  std::vector<const DexMethod*> get_callees(
+      const call_graph::CompactGraph& graph,
+      call_graph::CompactGraph::NodeId n) {
+    std::vector<const DexMethod*> ret;
+    for (auto e : graph.callees(n)) {
+      ret.emplace_back(graph.method(graph.callee(e)));
+    }
+    return ret;
+  }
+
+  // Checks that both graphs have the same nodes and the same edges.
+  void expect_same_graph(const call_graph::Graph& graph,
+                         const call_graph::CompactGraph& compact) {
+    EXPECT_THAT(get_callees(compact, compact.entry()),
+                ::testing::UnorderedElementsAreArray(
+                    get_callees(graph.entry())));
+    for (auto n = compact.entry(); n < compact.num_nodes(); ++n) {
+      const auto* method = compact.method(n);
+      if (method == nullptr) {
+        continue;
+      }
+      ASSERT_TRUE(graph.has_node(method));
+      EXPECT_THAT(get_callees(compact, n),
+                  ::testing::UnorderedElementsAreArray(
+                      get_callees(graph, method)));
+      for (auto e : compact.callers(n)) {
+        EXPECT_EQ(compact.callee(e), n);
+      }
+      EXPECT_EQ(compact.callers(n).size(),
+                graph.node(method)->callers().size());
+    }
+  }
 };
 
 TEST_F(CallGraphTest, test_resolve_static_callees) {
@@ -238,3 +272,45 @@ TEST_F(CallGraphTest, test_multiple_callee_graph_extended_returns_int) {
   EXPECT_THAT(extendedextended_returns_int_callees,
               ::testing::UnorderedElementsAre(extended_returns_int));
 }
+
+TEST_F(CallGraphTest, test_compact_graph) {
+  expect_same_graph(
+      *complete_graph,
+      call_graph::CompactGraph(call_graph::CompleteCallGraphStrategy(
+          *method_override_graph, scope)));
+  expect_same_graph(
+      *multiple_graph,
+      call_graph::CompactGraph(call_graph::MultipleCalleeStrategy(
+          *method_override_graph, scope, 5)));
+}
+
+TEST_F(CallGraphTest, test_compact_graph_fixpoint) {
+  using Domain = sparta::ConstantAbstractDomain<int>;
+  // Marks all the nodes reachable from the entry.
+  class Reachability final
+      : public sparta::MonotonicFixpointIterator<
+            call_graph::CompactGraphInterface,
+            Domain> {
+   public:
+    using MonotonicFixpointIterator::MonotonicFixpointIterator;
+
+    void analyze_node(const call_graph::CompactGraph::NodeId&,
+                      Domain*) const override {}
+
+    Domain analyze_edge(const call_graph::CompactGraph::EdgeId&,
+                        const Domain& exit_state) const override {
+      return exit_state;
+    }
+  };
+
+  call_graph::CompactGraph graph(
+      call_graph::CompleteCallGraphStrategy(*method_override_graph, scope));
+  Reachability fixpoint(graph);
+  fixpoint.run(Domain(1));
+  for (auto n = graph.entry(); n < graph.num_nodes(); ++n) {
+    if (n != graph.exit()) {
+      EXPECT_EQ(fixpoint.get_entry_state_at(n), Domain(1));
+    }
+  }
+  EXPECT_EQ(fixpoint.get_exit_state_at(graph.node(clinit)), Domain(1));
+}
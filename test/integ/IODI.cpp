@@ -28,7 +28,8 @@
 
 struct DexOutputTestHelper {
   static std::unique_ptr<uint8_t[]> steal_output(DexOutput& output) {
-    return std::move(output.m_output);
+    output.m_output = nullptr;
+    return std::move(output.m_output_buffer);
   }
 };
 
@@ -7,8 +7,10 @@
 
 #include <gtest/gtest.h>
 
+#include "IRAssembler.h"
 #include "Reachability.h"
 #include "RedexTest.h"
+#include "Show.h"
 
 class ReachabilityTest : public RedexIntegrationTest {};
 
@@ -248,3 +250,103 @@ TEST_F(ReachabilityTest, ReachabilitySkipMethodsTest) {
   method = find_vmethod(*classes, "LD;", "I", "bar", {});
   EXPECT_NE(method, nullptr);
 }
+
+TEST_F(ReachabilityTest, MarkedSetTest) {
+  auto scope = build_class_scope(stores);
+  reachability::ObjectIds ids(scope);
+  ASSERT_EQ(ids.classes->size(), scope.size());
+
+  reachability::MarkedSet<DexClass> marked(ids.classes);
+  for (const auto* cls : scope) {
+    EXPECT_FALSE(marked.count(cls));
+    EXPECT_TRUE(marked.insert(cls));
+    EXPECT_FALSE(marked.insert(cls));
+    EXPECT_TRUE(marked.count(cls));
+  }
+  EXPECT_EQ(marked.size(), scope.size());
+
+  // Without ids, the marked objects go to a concurrent set.
+  reachability::MarkedSet<DexClass> unindexed;
+  for (const auto* cls : scope) {
+    EXPECT_FALSE(unindexed.count_unsafe(cls));
+    EXPECT_TRUE(unindexed.insert(cls));
+    EXPECT_FALSE(unindexed.insert(cls));
+    EXPECT_TRUE(unindexed.count_unsafe(cls));
+  }
+  EXPECT_EQ(unindexed.size(), scope.size());
+}
+
+TEST_F(ReachabilityTest, IncrementalMarkingTest) {
+  const auto& dexen = stores[0].get_dexen();
+  auto pg_config = process_and_get_proguard_config(dexen, R"(
+    -keepclasseswithmembers public class RemoveUnreachableTest {
+      public void testMethod();
+    }
+    -keepclasseswithmembers class A {
+      int foo;
+      <init>();
+      int bar();
+    }
+  )");
+  EXPECT_TRUE(pg_config->ok);
+
+  reachability::IgnoreSets ig_sets;
+  reachability::MarkingSnapshot snapshot;
+  // Marks incrementally, checks that we get the same result as a marking from
+  // scratch, and sweeps.
+  auto mark_and_sweep = [&]() {
+    int num_ignore_check_strings = 0;
+    auto incremental = reachability::compute_reachable_objects_incrementally(
+        stores, ig_sets, &num_ignore_check_strings, &snapshot);
+    auto from_scratch = reachability::compute_reachable_objects(
+        stores, ig_sets, &num_ignore_check_strings);
+    for (const auto* cls : build_class_scope(stores)) {
+      EXPECT_EQ(incremental->marked(cls), from_scratch->marked(cls))
+          << show(cls);
+      auto check = [&](const auto& members) {
+        for (const auto* member : members) {
+          EXPECT_EQ(incremental->marked(member), from_scratch->marked(member))
+              << show(member);
+        }
+      };
+      check(cls->get_sfields());
+      check(cls->get_ifields());
+      check(cls->get_dmethods());
+      check(cls->get_vmethods());
+    }
+    reachability::sweep(stores, *incremental, nullptr);
+  };
+
+  mark_and_sweep();
+  EXPECT_TRUE(snapshot.valid);
+  EXPECT_FALSE(snapshot.incremental);
+  reachability::ObjectCounts after = reachability::count_objects(stores);
+  EXPECT_EQ(after.num_classes, 7);
+  EXPECT_EQ(after.num_methods, 13);
+  EXPECT_EQ(after.num_fields, 2);
+
+  // Nothing changed since the sweep.
+  mark_and_sweep();
+  EXPECT_TRUE(snapshot.incremental);
+  EXPECT_EQ(snapshot.num_changed, 0);
+  EXPECT_EQ(snapshot.num_affected, 0);
+  after = reachability::count_objects(stores);
+  EXPECT_EQ(after.num_methods, 13);
+
+  // A.bar no longer calls A.baz, which then isn't reachable anymore, and
+  // neither is the overriding D.baz.
+  auto* bar = find_vmethod(*classes, "LA;", "I", "bar", {});
+  auto* baz = find_vmethod(*classes, "LA;", "I", "baz", {});
+  ASSERT_NE(bar, nullptr);
+  ASSERT_NE(baz, nullptr);
+  bar->set_code(assembler::ircode_from_string(R"(
+    (
+      (load-param-object v1)
+      (const v0 0)
+      (return v0)
+    )
+  )"));
+  mark_and_sweep();
+  EXPECT_GT(snapshot.num_changed, 0);
+  EXPECT_EQ(find_vmethod(*classes, "LA;", "I", "baz", {}), nullptr);
+}
@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ConfigFiles.h"
+#include "ControlFlow.h"
+#include "DexClass.h"
+#include "DexLoader.h"
+#include "DexOutput.h"
+#include "DexPosition.h"
+#include "DexStore.h"
+#include "IRCode.h"
+#include "InstructionLowering.h"
+#include "PatriciaTreeMap.h"
+#include "RedexContext.h"
+#include "RedexOptions.h"
+#include "RedexTestUtils.h"
+#include "TypeSystem.h"
+#include "TypeUtil.h"
+#include "Walkers.h"
+
+//==========
+// Times the hot paths of the IR over a sample dex, single-threaded, so that
+// regressions show up as changes in the printed numbers. The dex is the first
+// argument, or $dexfile, or the checked-in test/integ/classes.dex.
+//
+// Each benchmark that can be repeated prints the best of a few rounds.
+//==========
+
+namespace {
+
+constexpr int kRounds = 5;
+
+template <typename Fn>
+double seconds(const Fn& fn) {
+  auto start = std::chrono::high_resolution_clock::now();
+  fn();
+  auto end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double>(end - start).count();
+}
+
+template <typename Fn>
+double best_seconds(const Fn& fn) {
+  double best = std::numeric_limits<double>::max();
+  for (int round = 0; round < kRounds; ++round) {
+    best = std::min(best, seconds(fn));
+  }
+  return best;
+}
+
+void report(const char* name, double secs, size_t items, const char* unit) {
+  printf("%-28s %10.3f ms %10.1f ns/%s\n", name, secs * 1e3,
+         items == 0 ? 0.0 : secs * 1e9 / items, unit);
+}
+
+void bench_cfg(const Scope& scope) {
+  size_t methods = 0;
+  walk::code(scope, [&](DexMethod*, IRCode&) { ++methods; });
+  report("build_cfg + clear_cfg", best_seconds([&] {
+           walk::code(scope, [](DexMethod*, IRCode& code) {
+             code.build_cfg(/* editable */ true);
+             code.clear_cfg();
+           });
+         }),
+         methods, "method");
+  report("build_cfg (non-editable)", best_seconds([&] {
+           walk::code(scope, [](DexMethod*, IRCode& code) {
+             code.build_cfg(/* editable */ false);
+             code.clear_cfg();
+           });
+         }),
+         methods, "method");
+}
+
+void bench_type_system(const Scope& scope) {
+  std::unique_ptr<TypeSystem> type_system;
+  auto construction_secs = best_seconds(
+      [&] { type_system = std::make_unique<TypeSystem>(scope); });
+  report("TypeSystem construction", construction_secs, scope.size(), "class");
+
+  std::vector<const DexType*> classes;
+  std::vector<const DexType*> interfaces;
+  for (const auto* cls : scope) {
+    (is_interface(cls) ? interfaces : classes).push_back(cls->get_type());
+  }
+  size_t queries = 0;
+  volatile size_t sink = 0;
+  auto query_secs = best_seconds([&] {
+    queries = 0;
+    for (const auto* type : classes) {
+      for (const auto* parent : type_system->parent_chain(type)) {
+        sink = sink + type_system->is_subtype(parent, type);
+        ++queries;
+      }
+      for (const auto* intf : interfaces) {
+        sink = sink + type_system->implements(type, intf);
+        ++queries;
+      }
+    }
+    for (const auto* intf : interfaces) {
+      sink = sink + type_system->get_implementors(intf).size();
+      ++queries;
+    }
+  });
+  report("TypeSystem queries", query_secs, queries, "query");
+}
+
+void bench_patricia_tree_map_join() {
+  using Map = sparta::PatriciaTreeMap<uint32_t, uint32_t>;
+  std::mt19937 rng(42);
+  // Pairs of maps that mostly share their keys, like the environments that
+  // meet at a join point.
+  std::vector<std::pair<Map, Map>> pairs(1000);
+  for (auto& p : pairs) {
+    for (uint32_t i = 0; i < 200; ++i) {
+      auto key = rng() % 400;
+      p.first.insert_or_assign(key, rng() % 8);
+      if (rng() % 4 != 0) {
+        p.second.insert_or_assign(key, rng() % 8);
+      }
+    }
+  }
+  volatile size_t sink = 0;
+  report("PatriciaTreeMap union_with", best_seconds([&] {
+           for (const auto& p : pairs) {
+             auto joined = p.first;
+             joined.union_with(
+                 [](const uint32_t& x, const uint32_t& y) {
+                   return std::max(x, y);
+                 },
+                 p.second);
+             sink = sink + joined.size();
+           }
+         }),
+         pairs.size(), "join");
+}
+
+void bench_string_interning(const Scope& scope) {
+  std::vector<std::string> names;
+  walk::classes(scope, [&](const DexClass* cls) {
+    names.push_back(cls->get_name()->str());
+    for (const auto* method : cls->get_all_methods()) {
+      names.push_back(method->get_name()->str());
+    }
+    for (const auto* field : cls->get_all_fields()) {
+      names.push_back(field->get_name()->str());
+    }
+  });
+  report("make_string (existing)", best_seconds([&] {
+           for (const auto& name : names) {
+             DexString::make_string(name);
+           }
+         }),
+         names.size(), "string");
+  // Each round interns new strings.
+  int round = 0;
+  report("make_string (new)", best_seconds([&] {
+           auto suffix = "$bench" + std::to_string(round++);
+           for (const auto& name : names) {
+             DexString::make_string(name + suffix);
+           }
+         }),
+         names.size(), "string");
+}
+
+void bench_output(DexStoresVector& stores, DexClasses& classes) {
+  auto tmpdir = redex::make_tmp_dir("ir_perf_test_%%%%%%%%");
+  Json::Value conf_obj = Json::nullValue;
+  ConfigFiles conf(conf_obj, tmpdir.path);
+  RedexOptions options;
+  std::unique_ptr<PositionMapper> pos_mapper(PositionMapper::make(""));
+  std::unordered_map<DexMethod*, uint64_t> method_to_id;
+  std::unordered_map<DexCode*, std::vector<DebugLineItem>> code_debug_lines;
+
+  report("instruction lowering",
+         seconds([&] { instruction_lowering::run(stores, true); }),
+         classes.size(), "class");
+  // Writing syncs the IR back to DexCode, so this only runs once.
+  report("sync + DexOutput", seconds([&] {
+           write_classes_to_dex(options,
+                                tmpdir.path + "/classes.dex",
+                                &classes,
+                                nullptr,
+                                0,
+                                0,
+                                conf,
+                                pos_mapper.get(),
+                                &method_to_id,
+                                &code_debug_lines,
+                                nullptr,
+                                "dex\n035\0");
+         }),
+         classes.size(), "class");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const char* dexfile = argc > 1 ? argv[1] : std::getenv("dexfile");
+  if (dexfile == nullptr) {
+    dexfile = "test/integ/classes.dex";
+  }
+  g_redex = new RedexContext();
+
+  DexMetadata dm;
+  dm.set_id("classes");
+  DexStore root_store(dm);
+  auto load_secs = seconds([&] {
+    root_store.add_classes(load_classes_from_dex(dexfile, /* balloon */ false));
+  });
+  DexStoresVector stores;
+  stores.emplace_back(std::move(root_store));
+  auto& classes = stores.back().get_dexen().back();
+  Scope scope(classes.begin(), classes.end());
+  report("load (without balloon)", load_secs, scope.size(), "class");
+
+  size_t methods = 0;
+  auto balloon_secs = seconds([&] {
+    walk::methods(scope, [&](DexMethod* m) {
+      if (m->get_dex_code()) {
+        m->balloon();
+        ++methods;
+      }
+    });
+  });
+  report("balloon", balloon_secs, methods, "method");
+
+  bench_cfg(scope);
+  bench_type_system(scope);
+  bench_patricia_tree_map_join();
+  bench_string_interning(scope);
+  bench_output(stores, classes);
+
+  delete g_redex;
+  g_redex = nullptr;
+}
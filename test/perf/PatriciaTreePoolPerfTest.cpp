@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "MonotonicFixpointIterator.h"
+
+#include <chrono>
+#include <functional>
+#include <gtest/gtest.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "PatriciaTreeSetAbstractDomain.h"
+
+using namespace sparta;
+
+/*
+ * The same liveness analysis as ParallelMonotonicFixpointIteratorPerftest,
+ * but over Patricia tree sets and without any artificial work per node, so
+ * that the run time is dominated by the allocation and release of tree nodes.
+ *
+ * Build once as is and once with -DSPARTA_FIXED_SIZE_POOL_DISABLED to compare
+ * the pooled node allocator against the global one.
+ */
+struct Statement {
+  Statement() = default;
+
+  Statement(std::initializer_list<uint32_t> use,
+            std::initializer_list<uint32_t> def)
+      : use(use), def(def) {}
+
+  std::vector<uint32_t> use;
+  std::vector<uint32_t> def;
+};
+
+class Program final {
+ public:
+  using Edge = std::pair<uint32_t, uint32_t>;
+  using EdgeId = std::shared_ptr<Edge>;
+
+  explicit Program(uint32_t entry) : m_entry(entry), m_exit(entry) {}
+
+  std::vector<EdgeId> successors(uint32_t node) const {
+    auto& succs = m_successors.at(node);
+    return std::vector<EdgeId>(succs.begin(), succs.end());
+  }
+
+  std::vector<EdgeId> predecessors(uint32_t node) const {
+    auto& preds = m_predecessors.at(node);
+    return std::vector<EdgeId>(preds.begin(), preds.end());
+  }
+
+  const Statement& statement_at(uint32_t node) const {
+    auto it = m_statements.find(node);
+    if (it == m_statements.end()) {
+      fail(node);
+    }
+    return it->second;
+  }
+
+  void add(uint32_t node, const Statement& stmt) {
+    m_statements[node] = stmt;
+    // Ensure that the pred/succ entries for the node are initialized
+    m_predecessors[node];
+    m_successors[node];
+  }
+
+  void add_edge(uint32_t src, uint32_t dst) {
+    auto edge = std::make_shared<Edge>(src, dst);
+    m_successors[src].insert(edge);
+    m_predecessors[dst].insert(edge);
+  }
+
+  void set_exit(uint32_t exit) { m_exit = exit; }
+
+ private:
+  // In gtest, FAIL (or any ASSERT_* statement) can only be called from within a
+  // function that returns void.
+  void fail(uint32_t node) const { FAIL() << "No statement at node " << node; }
+
+  uint32_t m_entry;
+  uint32_t m_exit;
+  std::unordered_map<uint32_t, Statement> m_statements;
+  std::unordered_map<uint32_t, std::unordered_set<EdgeId>> m_successors;
+  std::unordered_map<uint32_t, std::unordered_set<EdgeId>> m_predecessors;
+
+  friend class ProgramInterface;
+};
+
+class ProgramInterface {
+ public:
+  using Graph = Program;
+  using NodeId = uint32_t;
+  using EdgeId = Program::EdgeId;
+
+  static NodeId entry(const Graph& graph) { return graph.m_entry; }
+  static NodeId exit(const Graph& graph) { return graph.m_exit; }
+  static std::vector<EdgeId> predecessors(const Graph& graph,
+                                          const NodeId& node) {
+    return graph.predecessors(node);
+  }
+  static std::vector<EdgeId> successors(const Graph& graph,
+                                        const NodeId& node) {
+    return graph.successors(node);
+  }
+  static NodeId source(const Graph&, const EdgeId& e) { return e->first; }
+  static NodeId target(const Graph&, const EdgeId& e) { return e->second; }
+};
+
+using LivenessDomain = PatriciaTreeSetAbstractDomain<uint32_t>;
+
+class ParallelFixpointEngine final
+    : public ParallelMonotonicFixpointIterator<
+          BackwardsFixpointIterationAdaptor<ProgramInterface>,
+          LivenessDomain> {
+ public:
+  explicit ParallelFixpointEngine(const Program& program, uint32_t num_core)
+      : ParallelMonotonicFixpointIterator(program, num_core),
+        m_program(program) {}
+
+  void analyze_node(const uint32_t& node,
+                    LivenessDomain* current_state) const override {
+    const Statement& stmt = m_program.statement_at(node);
+    for (auto v : stmt.def) {
+      current_state->remove(v);
+    }
+    for (auto v : stmt.use) {
+      current_state->add(v);
+    }
+  }
+
+  LivenessDomain analyze_edge(
+      const EdgeId&,
+      const LivenessDomain& exit_state_at_source) const override {
+    return exit_state_at_source;
+  }
+
+ private:
+  const Program& m_program;
+};
+
+/*
+ *  1: a_1 = 0; ...; a_100 = 0; Switch to 2-20000
+ *     i: b_i = a_(i % 100) + a_(i % 97);
+ *  20001: return b_2 + ... + b_20000;
+ *
+ * Each branch removes its own b_i from the live set at the exit and adds two
+ * of the a's, so every branch produces a fresh large tree and the join at the
+ * switch merges all of them.
+ */
+Program build_program() {
+  constexpr uint32_t kVars = 100;
+  constexpr uint32_t kBranches = 20000;
+  Program program(1);
+  std::vector<uint32_t> defs;
+  for (uint32_t v = 0; v < kVars; ++v) {
+    defs.push_back(v);
+  }
+  Statement entry;
+  entry.def = defs;
+  program.add(1, entry);
+  Statement exit;
+  for (uint32_t i = 2; i <= kBranches; ++i) {
+    uint32_t b = kVars + i;
+    program.add(i, Statement(/* use: */ {i % kVars, i % 97}, /* def: */ {b}));
+    exit.use.push_back(b);
+  }
+  program.add(kBranches + 1, exit);
+  for (uint32_t i = 2; i <= kBranches; ++i) {
+    program.add_edge(1, i);
+    program.add_edge(i, kBranches + 1);
+  }
+  program.set_exit(kBranches + 1);
+  return program;
+}
+
+int main() {
+  Program program = build_program();
+  for (uint32_t i = 1; i <= parallel::default_num_threads(); ++i) {
+    ParallelFixpointEngine fp(program, i);
+    auto start = std::chrono::high_resolution_clock::now();
+    fp.run(LivenessDomain());
+    auto end = std::chrono::high_resolution_clock::now();
+    printf("%u threads: %lld us\n", i,
+           static_cast<long long>(
+               std::chrono::duration_cast<std::chrono::microseconds>(end -
+                                                                     start)
+                   .count()));
+  }
+}
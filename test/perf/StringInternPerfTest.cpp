@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "DexClass.h"
+#include "RedexContext.h"
+#include "WorkQueue.h"
+
+//==========
+// Compares the default DexString table (TruncatedStringHash-sharded trees)
+// against the arena-backed open-addressing one.
+//==========
+
+namespace {
+
+// Strings shaped like those in a large app: long, shared package prefixes
+// followed by class, member and literal names.
+std::vector<std::string> make_strings(size_t n) {
+  std::mt19937 rng(42);
+  std::vector<std::string> packages;
+  for (size_t i = 0; i < 200; ++i) {
+    packages.push_back("Lcom/example/app/feature" + std::to_string(i) +
+                       "/internal/");
+  }
+  std::vector<std::string> strings;
+  strings.reserve(n);
+  for (size_t i = 0; i < n; ++i) {
+    strings.push_back(packages[rng() % packages.size()] + "Class" +
+                      std::to_string(rng() % 100000) + "$Inner" +
+                      std::to_string(i) + ";");
+  }
+  return strings;
+}
+
+double intern_seconds(const std::vector<std::string>& strings, bool arena) {
+  if (arena) {
+    setenv("REDEX_ARENA_STRING_TABLE", "1", 1);
+  } else {
+    unsetenv("REDEX_ARENA_STRING_TABLE");
+  }
+  g_redex = new RedexContext();
+  auto start = std::chrono::high_resolution_clock::now();
+  // The second round only hits existing entries.
+  for (int round = 0; round < 2; ++round) {
+    workqueue_run<std::string>(
+        [](const std::string& s) { DexString::make_string(s); }, strings);
+  }
+  for (const auto& s : strings) {
+    always_assert(DexString::get_string(s) != nullptr);
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  delete g_redex;
+  g_redex = nullptr;
+  return std::chrono::duration<double>(end - start).count();
+}
+
+} // namespace
+
+int main() {
+  auto strings = make_strings(2000000);
+  double tree_secs = intern_seconds(strings, /*arena=*/false);
+  double arena_secs = intern_seconds(strings, /*arena=*/true);
+  printf("string interning: trees %fs, arena %fs (%fx)\n", tree_secs,
+         arena_secs, tree_secs / arena_secs);
+}
@@ -7,6 +7,7 @@
 
 #include "WorkQueue.h"
 
+#include <atomic>
 #include <chrono>
 #include <random>
 #include <thread>
@@ -73,9 +74,45 @@ void smallLengthTasks() {
   printf("speedup small length tasks: %f\n", speedup);
 }
 
+// Fine-grained tasks (like one method per task in walk::parallel::code), fed
+// through push_task so that workers constantly pop and steal. Compares the
+// mutex-guarded queues against the lock-free deques.
+double fineGrainedTasksSeconds(bool lock_free_queues) {
+  constexpr int kFanOut = 4;
+  constexpr int kDepth = 9;
+  std::atomic<size_t> sum{0};
+  auto wq = workqueue_foreach<int>(
+      [&](sparta::SpartaWorkerState<int>* state, int depth) {
+        sum += depth;
+        if (depth > 0) {
+          for (int i = 0; i < kFanOut; ++i) {
+            state->push_task(depth - 1);
+          }
+        }
+      },
+      redex_parallel::default_num_threads(),
+      /*push_tasks_while_running=*/true,
+      lock_free_queues);
+  for (size_t i = 0; i < redex_parallel::default_num_threads(); ++i) {
+    wq.add_item(kDepth);
+  }
+  auto start = std::chrono::high_resolution_clock::now();
+  wq.run_all();
+  auto end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double>(end - start).count();
+}
+
+void fineGrainedTasks() {
+  double mutex_secs = fineGrainedTasksSeconds(/*lock_free_queues=*/false);
+  double lock_free_secs = fineGrainedTasksSeconds(/*lock_free_queues=*/true);
+  printf("fine grained tasks: mutex queues %fs, lock-free deques %fs (%fx)\n",
+         mutex_secs, lock_free_secs, mutex_secs / lock_free_secs);
+}
+
 int main() {
   printf("Begin!\n");
   profileBusyLoop();
   variableLengthTasks();
   smallLengthTasks();
+  fineGrainedTasks();
 }
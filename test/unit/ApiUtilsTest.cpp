@@ -5,6 +5,7 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <boost/filesystem.hpp>
 #include <gtest/gtest.h>
 
 #include "ApiLevelsUtils.h"
@@ -233,3 +234,35 @@ TEST(ApiUtilsTest, testHasMethod) {
 
   EXPECT_TRUE(sdk.has_method(method));
 }
+
+TEST(ApiUtilsTest, testPackedInput) {
+  g_redex = new RedexContext();
+
+  auto packed_file = boost::filesystem::temp_directory_path() /
+                     boost::filesystem::unique_path();
+  ASSERT_TRUE(api::AndroidSDK::write_packed_file(
+      std::getenv("api_utils_easy_input_path"), packed_file.string()));
+  EXPECT_TRUE(api::AndroidSDK::is_packed_file(packed_file.string()));
+
+  api::AndroidSDK sdk(packed_file.string());
+  auto android_view = DexType::make_type("Landroid/view/View;");
+  EXPECT_TRUE(sdk.has_type(android_view));
+  EXPECT_FALSE(sdk.has_type(DexType::make_type("Landroid/view/Missing;")));
+
+  auto void_args = DexTypeList::make_type_list({});
+  auto void_empty = DexProto::make_proto(type::_void(), void_args);
+  auto method = static_cast<DexMethod*>(DexMethod::make_method(
+      android_view, DexString::make_string("clearFocus"), void_empty));
+  method->set_access(ACC_PUBLIC);
+  EXPECT_TRUE(sdk.has_method(method));
+
+  const auto& framework_cls_to_api = sdk.get_framework_classes();
+  EXPECT_EQ(framework_cls_to_api.size(), 6);
+  auto a_t = DexType::make_type("Landroid/util/ArrayMap;");
+  EXPECT_EQ(framework_cls_to_api.at(a_t).mrefs_info.size(), 2);
+  EXPECT_EQ(framework_cls_to_api.at(a_t).frefs_info.size(), 0);
+  EXPECT_EQ(framework_cls_to_api.at(android_view).mrefs_info.size(), 1);
+
+  boost::filesystem::remove(packed_file);
+  delete g_redex;
+}
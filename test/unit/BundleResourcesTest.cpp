@@ -171,6 +171,50 @@ TEST(BundleResources, TestCollectResFilesByRid) {
   });
 }
 
+TEST(BundleResources, ReferenceGraphAgreesWithWalk) {
+  setup_resources_and_run([&](const std::string& extract_dir,
+                              BundleResources* resources) {
+    auto res_table = resources->load_res_table();
+    ResourceReferenceGraph graph(
+        res_table.get(), [&](const std::string& path) {
+          return resources->get_xml_reference_attributes(extract_dir + "/" +
+                                                         path);
+        });
+    EXPECT_EQ(graph.num_res_ids(), res_table->sorted_res_ids.size());
+
+    std::vector<uint32_t> all_ids;
+    for (size_t i = 0; i < res_table->sorted_res_ids.size(); ++i) {
+      auto id = res_table->sorted_res_ids[i];
+      all_ids.push_back(id);
+      std::unordered_set<uint32_t> walked_ids;
+      std::unordered_set<std::string> walked_paths;
+      res_table->walk_references_for_resource(id, &walked_ids, &walked_paths);
+
+      auto bits = graph.reachable({id});
+      EXPECT_TRUE(graph.is_reachable(bits, id));
+      // XML files may add ids that the walk doesn't see.
+      for (auto walked_id : walked_ids) {
+        EXPECT_TRUE(graph.is_reachable(bits, walked_id));
+      }
+      auto paths = graph.get_file_paths(bits);
+      EXPECT_EQ(std::unordered_set<std::string>(paths.begin(), paths.end()),
+                walked_paths);
+    }
+
+    auto icon_ids = res_table->get_res_ids_by_name("icon");
+    EXPECT_EQ(icon_ids.size(), 1);
+    std::unordered_set<uint32_t> icon_nodes;
+    std::unordered_set<std::string> icon_paths;
+    graph.walk_references(icon_ids, &icon_nodes, &icon_paths);
+    EXPECT_EQ(icon_nodes, std::unordered_set<uint32_t>{icon_ids[0]});
+    EXPECT_EQ(icon_paths, std::unordered_set<std::string>{
+                              "base/res/drawable-mdpi-v4/icon.png"});
+
+    EXPECT_EQ(graph.get_res_ids(graph.reachable(all_ids)), all_ids);
+    EXPECT_TRUE(graph.get_res_ids(graph.reachable({0})).empty());
+  });
+}
+
 TEST(BundleResources, ReadLayout) {
   setup_resources_and_run(
       [&](const std::string& extract_dir, BundleResources* resources) {
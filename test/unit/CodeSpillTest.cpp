@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "CodeSpill.h"
+
+#include <gtest/gtest.h>
+
+#include "DexClass.h"
+#include "DexStore.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "RedexTest.h"
+
+class CodeSpillTest : public RedexTest {
+ public:
+  void TearDown() override { code_spill::disable(); }
+
+ protected:
+  static DexStoresVector make_stores(const std::vector<DexMethod*>& methods) {
+    DexStore store("classes");
+    for (auto* method : methods) {
+      store.add_classes({type_class(method->get_class())});
+    }
+    return DexStoresVector{store};
+  }
+
+  static void spill_everything(const DexStoresVector& stores) {
+    // A budget of zero is always exceeded.
+    code_spill::begin_epoch();
+    code_spill::maybe_spill(stores);
+  }
+};
+
+TEST_F(CodeSpillTest, roundtrip) {
+  auto method = assembler::class_with_method("LFoo;", R"(
+    (method (public static) "LFoo;.bar:(I)I"
+      (
+        (load-param v0)
+        (.src_block "LFoo;.bar:(I)I" 0 (0.5 1.0) ())
+        (.pos:dbg_0 "LFoo;.bar:(I)I" "Foo.java" 10)
+        (.try_start a)
+        (invoke-static (v0) "LFoo;.baz:(I)I")
+        (move-result v1)
+        (.try_end a)
+        (.pos:dbg_1 "LFoo;.baz:(I)I" "Foo.java" 20 dbg_0)
+        (const-string "hello")
+        (move-result-pseudo-object v2)
+        (switch v1 (:case0 :case1))
+        (:exit)
+        (return v1)
+        (:case0 0)
+        (const-wide v4 4294967296)
+        (goto :exit)
+        (:case1 7)
+        (add-int/lit8 v1 v1 1)
+        (goto :exit)
+        (.catch (a) "Ljava/lang/Exception;")
+        (const v1 0)
+        (return v1)
+      )
+    )
+  )");
+  std::string expected = assembler::to_string(method->get_code());
+  auto stores = make_stores({method});
+
+  code_spill::enable(/* rss_budget */ 0, "");
+  spill_everything(stores);
+  EXPECT_EQ(code_spill::peek_code(method), nullptr);
+  EXPECT_EQ(code_spill::get_stats().spilled, 1);
+
+  ASSERT_NE(method->get_code(), nullptr);
+  EXPECT_EQ(code_spill::get_stats().reloaded, 1);
+  EXPECT_EQ(assembler::to_string(method->get_code()), expected);
+  method->get_code()->sanity_check();
+
+  // Recently used bodies stay in memory.
+  code_spill::maybe_spill(stores);
+  EXPECT_NE(code_spill::peek_code(method), nullptr);
+
+  // Spill once more, and make sure all bodies are back after disabling.
+  spill_everything(stores);
+  EXPECT_EQ(code_spill::peek_code(method), nullptr);
+  code_spill::disable();
+  EXPECT_FALSE(code_spill::enabled());
+  ASSERT_NE(code_spill::peek_code(method), nullptr);
+  EXPECT_EQ(assembler::to_string(method->get_code()), expected);
+}
+
+TEST_F(CodeSpillTest, replacedCodeIsNotReloaded) {
+  auto method = assembler::class_with_method("LFoo;", R"(
+    (method (public static) "LFoo;.bar:()V"
+      (
+        (return-void)
+      )
+    )
+  )");
+  auto stores = make_stores({method});
+
+  code_spill::enable(/* rss_budget */ 0, "");
+  spill_everything(stores);
+  ASSERT_EQ(code_spill::peek_code(method), nullptr);
+
+  method->set_code(assembler::ircode_from_string(R"(
+    (
+      (const v0 0)
+      (return-void)
+    )
+  )"));
+  EXPECT_EQ(code_spill::get_stats().reloaded, 0);
+  EXPECT_EQ(assembler::to_string(method->get_code()),
+            "((const v0 0) (return-void))");
+}
+
+TEST_F(CodeSpillTest, codeWithCfgIsNotSpilled) {
+  auto method = assembler::class_with_method("LFoo;", R"(
+    (method (public static) "LFoo;.bar:()V"
+      (
+        (return-void)
+      )
+    )
+  )");
+  auto stores = make_stores({method});
+  method->get_code()->build_cfg(/* editable */ true);
+
+  code_spill::enable(/* rss_budget */ 0, "");
+  spill_everything(stores);
+  EXPECT_NE(code_spill::peek_code(method), nullptr);
+  EXPECT_EQ(code_spill::get_stats().spilled, 0);
+  method->get_code()->clear_cfg();
+}
@@ -8,6 +8,7 @@
 #include "ConcurrentContainers.h"
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <functional>
@@ -311,3 +312,175 @@ TEST_F(ConcurrentContainersTest, concurrentMapTest) {
   map.clear();
   EXPECT_EQ(0, map.size());
 }
+
+TEST_F(ConcurrentContainersTest, bulkOperationsTest) {
+  ConcurrentMap<uint32_t, uint32_t> map;
+  ConcurrentSet<uint32_t> set;
+  for (uint32_t x : m_data) {
+    map.insert({x, 1});
+    set.insert(x);
+  }
+
+  map.parallel_for_each(
+      [](std::pair<const uint32_t, uint32_t>& p) { p.second = p.first; });
+  for (uint32_t x : m_data_set) {
+    EXPECT_EQ(x, map.get(x, 0));
+  }
+
+  std::atomic<size_t> visited{0};
+  set.parallel_for_each([&](uint32_t x) {
+    EXPECT_EQ(1, m_data_set.count(x));
+    ++visited;
+  });
+  EXPECT_EQ(m_data_set.size(), visited);
+
+  uint64_t expected_sum = 0;
+  for (uint32_t x : m_data_set) {
+    expected_sum += x;
+  }
+  auto sum = map.reduce(
+      [](const std::pair<const uint32_t, uint32_t>& p) -> uint64_t {
+        return p.second;
+      },
+      [](uint64_t a, uint64_t b) { return a + b; },
+      uint64_t(0));
+  EXPECT_EQ(expected_sum, sum);
+  auto max = set.reduce([](uint32_t x) { return x; },
+                        [](uint32_t a, uint32_t b) { return std::max(a, b); },
+                        uint32_t(0));
+  EXPECT_EQ(*std::max_element(m_data.begin(), m_data.end()), max);
+
+  auto entries = map.move_to_vector();
+  EXPECT_EQ(0, map.size());
+  EXPECT_EQ(m_data_set.size(), entries.size());
+  for (const auto& p : entries) {
+    EXPECT_EQ(1, m_data_set.count(p.first));
+    EXPECT_EQ(p.first, p.second);
+  }
+
+  auto elems = set.move_to_vector();
+  EXPECT_EQ(0, set.size());
+  std::sort(elems.begin(), elems.end());
+  std::vector<uint32_t> expected(m_data_set.begin(), m_data_set.end());
+  std::sort(expected.begin(), expected.end());
+  EXPECT_EQ(expected, elems);
+}
+
+TEST_F(ConcurrentContainersTest, flatConcurrentSetTest) {
+  FlatConcurrentSet<uint32_t> set;
+
+  run_on_samples([&set](const std::vector<uint32_t>& sample) {
+    for (size_t i = 0; i < sample.size(); ++i) {
+      set.insert(sample[i]);
+      EXPECT_EQ(1, set.count(sample[i]));
+    }
+  });
+  EXPECT_EQ(m_data_set.size(), set.size());
+  auto check_initial_values = [&](const FlatConcurrentSet<uint32_t>& set) {
+    EXPECT_EQ(m_data_set.size(), std::distance(set.begin(), set.end()));
+    for (uint32_t x : m_data) {
+      EXPECT_EQ(1, set.count(x));
+      EXPECT_NE(set.end(), set.find(x));
+    }
+  };
+  check_initial_values(set);
+
+  auto copy = set;
+
+  run_on_subset_samples([&set](const std::vector<uint32_t>& sample) {
+    for (size_t i = 0; i < sample.size(); ++i) {
+      set.erase(sample[i]);
+    }
+  });
+  for (uint32_t x : m_subset_data) {
+    EXPECT_EQ(0, set.count(x));
+    EXPECT_EQ(set.end(), set.find(x));
+  }
+
+  // Insert back the erased elements, which reuses the deleted slots.
+  run_on_subset_samples([&set](const std::vector<uint32_t>& sample) {
+    for (size_t i = 0; i < sample.size(); ++i) {
+      set.insert(sample[i]);
+    }
+  });
+  check_initial_values(set);
+
+  run_on_samples([&set](const std::vector<uint32_t>& sample) {
+    for (size_t i = 0; i < sample.size(); ++i) {
+      set.erase(sample[i]);
+    }
+  });
+  EXPECT_EQ(0, set.size());
+  EXPECT_EQ(set.end(), set.begin());
+
+  check_initial_values(copy);
+  auto moved = std::move(copy);
+  check_initial_values(moved);
+}
+
+TEST_F(ConcurrentContainersTest, flatConcurrentMapTest) {
+  FlatConcurrentMap<std::string, uint32_t> map;
+
+  run_on_samples([&map](const std::vector<uint32_t>& sample) {
+    for (size_t i = 0; i < sample.size(); ++i) {
+      std::string s = std::to_string(sample[i]);
+      map.emplace(s, sample[i]);
+      EXPECT_EQ(1, map.count(s));
+    }
+  });
+  EXPECT_EQ(m_data_set.size(), map.size());
+
+  run_on_samples([&map](const std::vector<uint32_t>& sample) {
+    for (size_t i = 0; i < sample.size(); ++i) {
+      std::string s = std::to_string(sample[i]);
+      map.update(s, [](const std::string&, uint32_t& value, bool key_exists) {
+        EXPECT_TRUE(key_exists);
+        ++value;
+      });
+    }
+  });
+  std::unordered_map<uint32_t, uint32_t> occurrences;
+  for (uint32_t x : m_data) {
+    ++occurrences[x];
+  }
+  auto check_initial_values =
+      [&](const FlatConcurrentMap<std::string, uint32_t>& map) {
+        EXPECT_EQ(m_data_set.size(), map.size());
+        for (uint32_t x : m_data) {
+          std::string s = std::to_string(x);
+          auto it = map.find(s);
+          EXPECT_NE(map.end(), it);
+          EXPECT_EQ(s, it->first);
+          EXPECT_EQ(x + occurrences[x], it->second);
+          EXPECT_EQ(x + occurrences[x], map.at(s));
+        }
+      };
+  check_initial_values(map);
+
+  auto copy = map;
+
+  run_on_subset_samples([&map](const std::vector<uint32_t>& sample) {
+    for (size_t i = 0; i < sample.size(); ++i) {
+      map.erase(std::to_string(sample[i]));
+    }
+  });
+  for (uint32_t x : m_subset_data) {
+    EXPECT_EQ(0, map.get(std::to_string(x), 0));
+  }
+  for (uint32_t x : m_subset_data_set) {
+    map.insert_or_assign({std::to_string(x), x});
+  }
+  for (uint32_t x : m_subset_data) {
+    EXPECT_EQ(x, map.get(std::to_string(x), 0));
+  }
+
+  check_initial_values(copy);
+  auto moved = std::move(copy);
+  check_initial_values(moved);
+
+  map.clear();
+  EXPECT_EQ(0, map.size());
+  map.insert({{"a", 1}, {"b", 2}, {"c", 3}});
+  EXPECT_EQ(3, map.size());
+  EXPECT_EQ(2, map.at("b"));
+}
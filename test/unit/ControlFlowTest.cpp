@@ -9,10 +9,13 @@
 #include <gtest/gtest.h>
 #include <regex>
 
+#include "BaseIRAnalyzer.h"
 #include "ControlFlow.h"
 #include "DexAsm.h"
+#include "Dominators.h"
 #include "IRAssembler.h"
 #include "IRCode.h"
+#include "MonotonicFixpointIterator.h"
 #include "RedexTest.h"
 #include "ScopedCFG.h"
 #include "Show.h"
@@ -2602,3 +2605,113 @@ TEST_F(ControlFlowTest, non_editable_cfg_case_keys) {
   EXPECT_EQ(case_keys.at(0), 0);
   EXPECT_EQ(case_keys.at(1), 1);
 }
+
+TEST_F(ControlFlowTest, cachedAnalysesAreInvalidatedByEdits) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (const v0 0)
+      (if-eqz v0 :end)
+      (const v0 1)
+      (:end)
+      (return v0)
+    )
+  )");
+  code->build_cfg(/* editable */ true);
+  auto& cfg = code->cfg();
+  auto* entry = cfg.entry_block();
+  auto* branch_edge = cfg.get_succ_edge_of_type(entry, EDGE_BRANCH);
+  ASSERT_NE(branch_edge, nullptr);
+  auto* ret = branch_edge->target();
+  auto* middle = cfg.get_succ_edge_of_type(entry, EDGE_GOTO)->target();
+
+  const auto& doms = cfg.get_dominators();
+  EXPECT_EQ(&doms, &cfg.get_dominators());
+  EXPECT_EQ(doms.get_idom(ret), entry);
+  EXPECT_EQ(cfg.get_reverse_post_order().size(), 3);
+  EXPECT_EQ(cfg.get_reverse_post_order().front(), entry);
+
+  cfg.calculate_exit_block();
+  EXPECT_EQ(cfg.get_post_dominators().get_idom(entry), ret);
+
+  // Without the branch, the return is only reachable through the middle
+  // block.
+  cfg.delete_edge(branch_edge);
+  EXPECT_EQ(cfg.get_dominators().get_idom(ret), middle);
+  const auto& rpo = cfg.get_reverse_post_order();
+  EXPECT_EQ(std::vector<Block*>(rpo.begin(), rpo.end()),
+            std::vector<Block*>({entry, middle, ret}));
+
+  code->clear_cfg();
+}
+
+TEST_F(ControlFlowTest, cachedOrderingsAreInvalidatedByEdits) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (const v0 0)
+      (:loop)
+      (if-eqz v0 :loop)
+      (return v0)
+    )
+  )");
+  code->build_cfg(/* editable */ true);
+  auto& cfg = code->cfg();
+  auto forward = ir_analyzer::get_forward_ordering(cfg);
+  EXPECT_EQ(forward, ir_analyzer::get_forward_ordering(cfg));
+  EXPECT_EQ(forward->size(), cfg.num_blocks() + 1);
+
+  // Instruction edits keep the ordering.
+  cfg.entry_block()->push_back(
+      (new IRInstruction(OPCODE_CONST))->set_dest(1)->set_literal(0));
+  EXPECT_EQ(forward, ir_analyzer::get_forward_ordering(cfg));
+
+  cfg.calculate_exit_block();
+  auto new_forward = ir_analyzer::get_forward_ordering(cfg);
+  EXPECT_NE(forward, new_forward);
+  auto backward = ir_analyzer::get_backward_ordering(cfg);
+  EXPECT_EQ(backward, ir_analyzer::get_backward_ordering(cfg));
+  EXPECT_NE(backward, new_forward);
+
+  code->clear_cfg();
+}
+
+TEST_F(ControlFlowTest, blockMap) {
+  BlockMap blocks;
+  std::vector<std::unique_ptr<Block>> storage;
+  for (BlockId id : {0, 1, 2, 5}) {
+    storage.emplace_back(new Block(nullptr, id));
+    EXPECT_TRUE(blocks.emplace(id, storage.back().get()).second);
+  }
+  EXPECT_FALSE(blocks.emplace(1, storage[0].get()).second);
+  EXPECT_EQ(blocks.size(), 4);
+  EXPECT_EQ(blocks.count(3), 0);
+  EXPECT_EQ(blocks.find(4), blocks.end());
+  EXPECT_THROW(blocks.at(7), std::out_of_range);
+  EXPECT_EQ(blocks.at(5), storage[3].get());
+  EXPECT_EQ(blocks.rbegin()->first, 5);
+
+  // Iterators survive insertions.
+  auto it = blocks.find(2);
+  auto erased_next = blocks.erase(blocks.find(1));
+  EXPECT_EQ(erased_next, it);
+  storage.emplace_back(new Block(nullptr, 100));
+  blocks.emplace(100, storage.back().get());
+  EXPECT_EQ(it->second, storage[2].get());
+  EXPECT_EQ((++it)->first, 5);
+  EXPECT_EQ((--it)->first, 2);
+  EXPECT_EQ((--it)->first, 0);
+
+  std::vector<BlockId> ids;
+  for (const auto& entry : blocks) {
+    ids.push_back(entry.first);
+  }
+  EXPECT_THAT(ids, ::testing::ElementsAre(0, 2, 5, 100));
+  ids.clear();
+  for (auto rit = blocks.rbegin(); rit != blocks.rend(); ++rit) {
+    ids.push_back(rit->first);
+  }
+  EXPECT_THAT(ids, ::testing::ElementsAre(100, 5, 2, 0));
+  EXPECT_EQ(blocks.erase(1), 0);
+  EXPECT_EQ(blocks.erase(100), 1);
+  EXPECT_EQ(blocks.size(), 3);
+  EXPECT_EQ(blocks.rbegin()->first, 5);
+}
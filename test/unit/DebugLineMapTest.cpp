@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iterator>
+
+#include "DebugLineMap.h"
+
+namespace {
+
+template <class T>
+T read_at(const std::string& data, size_t offset) {
+  T value;
+  memcpy(&value, data.data() + offset, sizeof(value));
+  return value;
+}
+
+} // namespace
+
+TEST(DebugLineMapTest, recordsAndIndex) {
+  auto path = boost::filesystem::temp_directory_path() /
+              boost::filesystem::unique_path();
+  std::vector<DebugLineItem> foo_lines{{0, 10}, {4, 11}};
+  std::vector<DebugLineItem> bar_lines{{2, 20}};
+  std::vector<DebugLineItem> baz_lines;
+  {
+    DebugLineMapWriter writer(path.string());
+    // The chunks are appended in order, whichever was encoded first.
+    auto second = DebugLineMapWriter::encode({{3, &baz_lines}});
+    auto first = DebugLineMapWriter::encode({{1, &foo_lines}, {2, &bar_lines}});
+    writer.append(first);
+    writer.append(second);
+    EXPECT_TRUE(writer.contains(2));
+    EXPECT_FALSE(writer.contains(4));
+    writer.finish();
+  }
+
+  std::ifstream ifs(path.string(), std::ios::binary);
+  std::string data((std::istreambuf_iterator<char>(ifs)),
+                   std::istreambuf_iterator<char>());
+  boost::filesystem::remove(path);
+
+  ASSERT_EQ(data.size(), 8 + (8 + 16) + (8 + 8) + 8 + 3 * 16 + 8);
+  EXPECT_EQ(read_at<uint32_t>(data, 0), 0xfaceb000);
+  EXPECT_EQ(read_at<uint32_t>(data, 4), DebugLineMapWriter::VERSION);
+  auto count = read_at<uint32_t>(data, data.size() - 8);
+  auto index_offset = read_at<uint32_t>(data, data.size() - 4);
+  ASSERT_EQ(count, 3);
+  EXPECT_EQ(index_offset, 8 + (8 + 16) + (8 + 8) + 8);
+
+  std::vector<std::tuple<uint64_t, uint32_t, uint32_t>> index;
+  for (uint32_t i = 0; i < count; ++i) {
+    auto entry = index_offset + i * 16;
+    index.emplace_back(read_at<uint64_t>(data, entry),
+                       read_at<uint32_t>(data, entry + 8),
+                       read_at<uint32_t>(data, entry + 12));
+  }
+  EXPECT_EQ(index[0], std::make_tuple(1, 8, 24));
+  EXPECT_EQ(index[1], std::make_tuple(2, 32, 16));
+  EXPECT_EQ(index[2], std::make_tuple(3, 48, 8));
+
+  EXPECT_EQ(read_at<uint64_t>(data, 8), 1);
+  EXPECT_EQ(read_at<uint32_t>(data, 16), 0);
+  EXPECT_EQ(read_at<uint32_t>(data, 20), 10);
+  EXPECT_EQ(read_at<uint32_t>(data, 24), 4);
+  EXPECT_EQ(read_at<uint32_t>(data, 28), 11);
+  EXPECT_EQ(read_at<uint64_t>(data, 32), 2);
+  EXPECT_EQ(read_at<uint32_t>(data, 40), 2);
+  EXPECT_EQ(read_at<uint32_t>(data, 44), 20);
+  EXPECT_EQ(read_at<uint64_t>(data, 48), 3);
+}
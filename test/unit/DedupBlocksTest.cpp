@@ -11,6 +11,7 @@
 
 #include "ControlFlow.h"
 #include "Creators.h"
+#include "CrossMethodBlockSuffixes.h"
 #include "DedupBlocks.h"
 #include "DexAsm.h"
 #include "DexUtil.h"
@@ -1234,3 +1235,46 @@ TEST_F(DedupBlocksTest, retainPositionWhenMayThrow) {
   auto expected_code = assembler::ircode_from_string(expected_str);
   EXPECT_CODE_EQ(expected_code.get(), method->get_code());
 }
+
+TEST_F(DedupBlocksTest, crossMethodSuffixes) {
+  auto method1 = get_fresh_method("crossMethodSuffixes1");
+  method1->set_code(assembler::ircode_from_string(R"(
+    (
+      (const v0 1)
+      (add-int v0 v0 v0)
+      (mul-int v1 v0 v0)
+      (return v1)
+    )
+  )"));
+  // Same code, with other registers.
+  auto method2 = get_fresh_method("crossMethodSuffixes2");
+  method2->set_code(assembler::ircode_from_string(R"(
+    (
+      (const v2 1)
+      (add-int v2 v2 v2)
+      (mul-int v3 v2 v2)
+      (return v3)
+    )
+  )"));
+  // Only shares the last two instructions.
+  auto method3 = get_fresh_method("crossMethodSuffixes3");
+  method3->set_code(assembler::ircode_from_string(R"(
+    (
+      (const v0 2)
+      (sub-int v0 v0 v0)
+      (mul-int v1 v0 v0)
+      (return v1)
+    )
+  )"));
+
+  dedup_blocks_impl::Config config;
+  auto groups = dedup_blocks_impl::find_cross_method_duplicate_suffixes(
+      config, std::vector<DexClass*>{m_class});
+  ASSERT_EQ(groups.size(), 1);
+  EXPECT_EQ(groups[0].length, 4);
+  ASSERT_EQ(groups[0].suffixes.size(), 2);
+  EXPECT_EQ(groups[0].suffixes[0].method, method1);
+  EXPECT_EQ(groups[0].suffixes[1].method, method2);
+  EXPECT_EQ(groups[0].suffixes[0].first_insn->opcode(), OPCODE_CONST);
+  EXPECT_EQ(groups[0].get_savings(), 4);
+}
@@ -8,8 +8,11 @@
 #include "DexClass.h"
 
 #include <boost/optional.hpp>
+#include <thread>
 
 #include "IRAssembler.h"
+#include "IRCode.h"
+#include "InstructionLowering.h"
 #include "RedexTest.h"
 #include "SimpleClassHierarchy.h"
 
@@ -172,3 +175,123 @@ TEST_F(DexClassTest, testObfuscatedNames) {
   EXPECT_EQ(field->get_deobfuscated_name(), "Lbaz;.bar:I");
   EXPECT_EQ(field->get_simple_deobfuscated_name(), "bar");
 }
+
+TEST_F(DexClassTest, deferredBalloon) {
+  auto method = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.lazy:(I)I"
+      (
+        (load-param v0)
+        (add-int/lit8 v0 v0 1)
+        (return v0)
+      )
+    )
+  )");
+  auto expected = assembler::to_string(method->get_code());
+  instruction_lowering::lower(method);
+  method->sync();
+  ASSERT_NE(method->get_dex_code(), nullptr);
+
+  method->defer_balloon();
+  EXPECT_NE(method->get_dex_code(), nullptr);
+
+  // Concurrent first accesses balloon the code exactly once.
+  std::vector<const IRCode*> seen(4);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < seen.size(); ++i) {
+    threads.emplace_back([&, i] { seen[i] = method->get_code(); });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_NE(seen[0], nullptr);
+  for (auto* code : seen) {
+    EXPECT_EQ(code, seen[0]);
+  }
+  EXPECT_EQ(method->get_dex_code(), nullptr);
+  EXPECT_EQ(assembler::to_string(method->get_code()), expected);
+}
+
+TEST_F(DexClassTest, setCodeSupersedesDeferredBalloon) {
+  auto method = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.replaced:()V"
+      (
+        (return-void)
+      )
+    )
+  )");
+  instruction_lowering::lower(method);
+  method->sync();
+  method->defer_balloon();
+
+  method->set_code(assembler::ircode_from_string(R"(
+    (
+      (const v0 0)
+      (return-void)
+    )
+  )"));
+  EXPECT_EQ(method->get_dex_code(), nullptr);
+  EXPECT_EQ(assembler::to_string(method->get_code()),
+            "((const v0 0) (return-void))");
+}
+
+TEST_F(DexClassTest, paramAnnotations) {
+  auto make_method = [](const char* descriptor) {
+    return static_cast<DexMethod*>(DexMethod::make_method(descriptor));
+  };
+  auto method = make_method("LFoo;.annotated:(II)V");
+  EXPECT_EQ(method->get_param_anno(), nullptr);
+  method->attach_param_annotation_set(1, new DexAnnotationSet());
+  method->make_concrete(ACC_PUBLIC | ACC_ABSTRACT, /* is_virtual */ true);
+  ASSERT_NE(method->get_param_anno(), nullptr);
+  EXPECT_EQ(method->get_param_anno()->size(), 1);
+
+  auto copy = DexMethod::make_method_from(
+      method, DexType::make_type("LBar;"), DexString::make_string("copy"));
+  ASSERT_NE(copy->get_param_anno(), nullptr);
+  EXPECT_EQ(copy->get_param_anno()->count(1), 1);
+  EXPECT_NE(copy->get_param_anno()->at(1), method->get_param_anno()->at(1));
+
+  auto other = make_method("LFoo;.other:(II)V");
+  other->make_concrete(ACC_PUBLIC | ACC_ABSTRACT, /* is_virtual */ true);
+  EXPECT_EQ(other->get_param_anno(), nullptr);
+  other->combine_annotations_with(method);
+  ASSERT_NE(other->get_param_anno(), nullptr);
+  EXPECT_EQ(other->get_param_anno()->count(1), 1);
+
+  method->make_non_concrete();
+  EXPECT_EQ(method->get_param_anno(), nullptr);
+}
+
+TEST_F(DexClassTest, internedAnnotations) {
+  auto make_anno = [](int32_t value) {
+    auto anno = new DexAnnotation(DexType::make_type("LAnno;"), DAV_RUNTIME);
+    auto ev = DexEncodedValue::zero_for_type(type::_int());
+    ev->value(value);
+    anno->add_element("value", ev);
+    return anno;
+  };
+  auto anno = make_anno(1);
+  EXPECT_EQ(g_redex->intern_annotation(anno), anno);
+  EXPECT_TRUE(anno->is_interned());
+  auto same = make_anno(1);
+  EXPECT_EQ(g_redex->intern_annotation(same), anno);
+  EXPECT_FALSE(same->is_interned());
+  delete same;
+  auto other = make_anno(2);
+  EXPECT_EQ(g_redex->intern_annotation(other), other);
+
+  DexAnnotationSet aset;
+  aset.add_annotation(anno);
+  DexAnnotationSet copy(aset);
+  EXPECT_EQ(copy.get_annotations().at(0), anno);
+
+  auto& slot = copy.get_annotations().at(0);
+  auto unshared = DexAnnotation::unshare(slot);
+  EXPECT_NE(unshared, anno);
+  EXPECT_EQ(slot, unshared);
+  EXPECT_FALSE(unshared->is_interned());
+  EXPECT_EQ(*unshared, *anno);
+  unshared->anno_elems().at(0).encoded_value->value(3);
+  EXPECT_EQ(anno->anno_elems().at(0).encoded_value->value(), 1);
+  EXPECT_EQ(DexAnnotation::unshare(slot), unshared);
+}
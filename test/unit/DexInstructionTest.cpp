@@ -7,6 +7,7 @@
 
 #include <gtest/gtest.h>
 
+#include "DexClass.h"
 #include "DexInstruction.h"
 #include "RedexTest.h"
 
@@ -63,3 +64,23 @@ TEST_F(DexInstructionTest, test_encode_fill_array_data_payload_32) {
   EXPECT_EQ(data32[4], 4);
   EXPECT_EQ(data32[5], 5);
 }
+
+TEST_F(DexInstructionTest, test_encode_without_ref) {
+  auto method = DexMethod::make_method("LFoo;.bar:(II)V");
+  DexOpcodeMethod invoke(DOPCODE_INVOKE_STATIC, method);
+  invoke.set_srcs({1, 2});
+  DexInstruction move(DOPCODE_MOVE_16);
+  move.set_dest(300);
+  move.set_src(0, 400);
+
+  uint16_t units[8];
+  uint16_t* insns = units;
+  invoke.encode_without_ref(insns);
+  EXPECT_EQ(insns - units, invoke.size());
+  // The method index is left out, and the args follow it.
+  EXPECT_EQ(units[1], 0);
+  move.encode_without_ref(insns);
+  EXPECT_EQ(insns - units, invoke.size() + move.size());
+  EXPECT_EQ(units[invoke.size() + 1], 300);
+  EXPECT_EQ(units[invoke.size() + 2], 400);
+}
@@ -8,6 +8,10 @@
 #include "DexOutput.h"
 #include <gtest/gtest.h>
 #include <json/json.h>
+#include <mutex>
+#include <numeric>
+
+#include "WorkQueue.h"
 
 TEST(DexOutput, checkMethodInstructionSizeLimit) {
 
@@ -24,3 +28,27 @@ TEST(DexOutput, checkMethodInstructionSizeLimit) {
       DexOutput::check_method_instruction_size_limit(conf, 65537, "method"),
       RedexException);
 }
+
+TEST(DexOutput, sequencerRunsPhasesInIndexOrder) {
+  DexOutputSequencer sequencer;
+  std::mutex mutex;
+  std::vector<size_t> debug_items_order;
+  std::vector<size_t> metrics_order;
+  std::vector<size_t> indices(16);
+  std::iota(indices.begin(), indices.end(), 0);
+  workqueue_run<size_t>(
+      [&](size_t idx) {
+        sequencer.run_in_order(DexOutputSequencer::DEBUG_ITEMS, idx, [&]() {
+          std::lock_guard<std::mutex> lock(mutex);
+          debug_items_order.push_back(idx);
+        });
+        sequencer.run_in_order(DexOutputSequencer::METRICS, idx, [&]() {
+          std::lock_guard<std::mutex> lock(mutex);
+          metrics_order.push_back(idx);
+        });
+      },
+      indices,
+      /* num_threads */ 4);
+  EXPECT_EQ(indices, debug_items_order);
+  EXPECT_EQ(indices, metrics_order);
+}
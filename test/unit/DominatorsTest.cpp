@@ -8,6 +8,8 @@
 #include "Dominators.h"
 
 #include <gtest/gtest.h>
+#include <limits>
+#include <random>
 
 #include "MonotonicFixpointIterator.h"
 #include "SimpleGraph.h"
@@ -249,3 +251,56 @@ TEST(GraphUtilTest, postdominator) {
     EXPECT_EQ(post_doms.get_idom(100), 100);
   }
 }
+
+TEST(DominatorsTest, semiNCAMatchesIterative) {
+  // Random graphs, with chains to get long paths in the spanning tree, and
+  // some nodes that are unreachable.
+  std::mt19937 rng(0);
+  for (size_t iteration = 0; iteration < 50; ++iteration) {
+    const uint32_t num_nodes = 2 + rng() % 200;
+    GraphInterface::Graph graph;
+    for (uint32_t i = 1; i < num_nodes; ++i) {
+      if (rng() % 2 == 0) {
+        graph.add_edge(i - 1, i);
+      }
+    }
+    auto num_edges = rng() % (3 * num_nodes);
+    for (size_t i = 0; i < num_edges; ++i) {
+      graph.add_edge(rng() % num_nodes, rng() % num_nodes);
+    }
+
+    dominators::SimpleFastDominators<GraphInterface> iterative(
+        graph, /* semi_nca_threshold */ std::numeric_limits<size_t>::max());
+    dominators::SimpleFastDominators<GraphInterface> semi_nca(
+        graph, /* semi_nca_threshold */ 0);
+    auto reachable = graph::postorder_sort<GraphInterface>(graph);
+    for (auto node : reachable) {
+      EXPECT_EQ(iterative.get_idom(node), semi_nca.get_idom(node))
+          << "node " << node << " in iteration " << iteration;
+    }
+    for (size_t i = 0; i < 20; ++i) {
+      auto a = reachable[rng() % reachable.size()];
+      auto b = reachable[rng() % reachable.size()];
+      EXPECT_EQ(iterative.intersect(a, b), semi_nca.intersect(a, b));
+    }
+  }
+}
+
+TEST(DominatorsTest, semiNCALongChain) {
+  // A chain of diamonds, large enough to pick Semi-NCA by default.
+  GraphInterface::Graph graph;
+  const uint32_t num_diamonds = dominators::kSemiNCAThreshold;
+  for (uint32_t i = 0; i < num_diamonds; ++i) {
+    graph.add_edge(3 * i, 3 * i + 1);
+    graph.add_edge(3 * i, 3 * i + 2);
+    graph.add_edge(3 * i + 1, 3 * i + 3);
+    graph.add_edge(3 * i + 2, 3 * i + 3);
+  }
+  dominators::SimpleFastDominators<GraphInterface> doms(graph);
+  for (uint32_t i = 0; i < num_diamonds; ++i) {
+    EXPECT_EQ(doms.get_idom(3 * i + 1), 3 * i);
+    EXPECT_EQ(doms.get_idom(3 * i + 2), 3 * i);
+    EXPECT_EQ(doms.get_idom(3 * i + 3), 3 * i);
+  }
+  EXPECT_EQ(doms.intersect(4, 3 * num_diamonds), 3);
+}
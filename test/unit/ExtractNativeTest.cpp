@@ -15,3 +15,16 @@ TEST(ExtractNativeTest, empty) {
   auto overset = extract_classes_from_native_lib(over);
   EXPECT_EQ(overset.size(), 2);
 }
+
+TEST(ExtractNativeTest, descriptorsAndPackageNames) {
+  std::string lib("\x7f"
+                  "ELF\x01Lcom/facebook/Foo;\x00"
+                  "com/facebook/Bar$Baz\xff"
+                  "short/Name\x00Lshort;",
+                  63);
+  auto classes = extract_classes_from_native_lib(lib);
+  EXPECT_EQ(classes,
+            (std::unordered_set<std::string>{"Lcom/facebook/Foo;",
+                                             "Lcom/facebook/Bar$Baz;",
+                                             "Lshort/Name;"}));
+}
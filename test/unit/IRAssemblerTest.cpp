@@ -667,3 +667,34 @@ TEST_F(IRAssemblerTest, dexDebugInstruction) {
   EXPECT_EQ(dbg10->opcode(), DBG_FIRST_SPECIAL);
   EXPECT_EQ(dbg10->uvalue(), DEX_NO_INDEX);
 }
+
+TEST_F(IRAssemblerTest, bulk) {
+  std::vector<std::string> strings;
+  for (int i = 0; i < 100; ++i) {
+    strings.push_back("((const v0 " + std::to_string(i) + ") (return v0))");
+  }
+  auto codes = assembler::ircode_from_strings(strings);
+  ASSERT_EQ(codes.size(), strings.size());
+  for (size_t i = 0; i < strings.size(); ++i) {
+    EXPECT_EQ(assembler::to_string(codes[i].get()), strings[i]);
+  }
+
+  auto methods = assembler::methods_from_string(R"(
+    (method (private) "LFoo;.bulk1:()V"
+     ((return-void))
+    )
+    ; A comment between methods.
+    (method (public static) "LFoo;.bulk2:(I)I"
+     (
+      (load-param v0)
+      (return v0)
+     )
+    )
+  )");
+  ASSERT_EQ(methods.size(), 2);
+  EXPECT_EQ(show(methods[0]), "LFoo;.bulk1:()V");
+  EXPECT_EQ(methods[0]->get_access(), ACC_PRIVATE);
+  EXPECT_EQ(show(methods[1]), "LFoo;.bulk2:(I)I");
+  EXPECT_EQ(assembler::to_string(methods[1]->get_code()),
+            "((load-param v0) (return v0))");
+}
@@ -118,6 +118,49 @@ TEST_F(IRCodeTest, useless_if) {
   EXPECT_EQ(DOPCODE_CONST_4, (*it)->opcode());
 }
 
+TEST_F(IRCodeTest, straight_line_with_cfg) {
+  auto method = assembler::method_from_string(R"(
+    (method (public static) "LBaz;.bar:()V"
+      (
+        (const v0 0)
+        (const v1 1)
+        (return-void)
+      )
+    )
+  )");
+
+  auto code = method->get_code();
+  code->set_registers_size(10);
+
+  instruction_lowering::lower(method, /* lower_with_cfg */ true);
+  // As if the CFG was built.
+  EXPECT_EQ(2, code->get_registers_size());
+  auto dex_code = code->sync(method);
+
+  const auto& insns = dex_code->get_instructions();
+  EXPECT_EQ(3, insns.size());
+}
+
+TEST_F(IRCodeTest, unreachable_after_return_with_cfg) {
+  auto method = assembler::method_from_string(R"(
+    (method (public static) "LBaz;.bar:()V"
+      (
+        (const v0 0)
+        (return-void)
+        (const v1 1)
+        (return-void)
+      )
+    )
+  )");
+
+  auto code = method->get_code();
+  instruction_lowering::lower(method, /* lower_with_cfg */ true);
+  auto dex_code = code->sync(method);
+
+  const auto& insns = dex_code->get_instructions();
+  EXPECT_EQ(2, insns.size());
+}
+
 TEST_F(IRCodeTest, try_region) {
   auto method = DexMethod::make_method("Lfoo;", "tryRegionTest", "V", {})
                     ->make_concrete(ACC_PUBLIC | ACC_STATIC, false);
@@ -152,3 +195,47 @@ TEST_F(IRCodeTest, try_region) {
   EXPECT_EQ(split, second->m_start_addr);
   EXPECT_EQ(num * op->size() - split, second->m_insn_count);
 }
+
+TEST_F(IRCodeTest, persistent_editable_cfgs) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (const v0 0)
+      (if-eqz v0 :l)
+      (const v0 1)
+      (:l)
+      (return v0)
+    )
+  )");
+
+  IRCode::set_persistent_editable_cfgs(true);
+  code->build_cfg(/* editable */ true);
+  auto* cfg = &code->cfg();
+  code->clear_cfg();
+  // The editable CFG survives clear_cfg() and is reused by build_cfg().
+  ASSERT_TRUE(code->editable_cfg_built());
+  code->build_cfg(/* editable */ true);
+  EXPECT_EQ(cfg, &code->cfg());
+
+  // Asking for a non-editable CFG still linearizes the editable one first.
+  code->build_cfg(/* editable */ false);
+  EXPECT_TRUE(code->cfg_built());
+  EXPECT_FALSE(code->editable_cfg_built());
+  code->clear_cfg();
+  EXPECT_FALSE(code->cfg_built());
+
+  code->build_cfg(/* editable */ true);
+  IRCode::set_persistent_editable_cfgs(false);
+  code->clear_cfg();
+  EXPECT_FALSE(code->cfg_built());
+
+  auto expected = assembler::ircode_from_string(R"(
+    (
+      (const v0 0)
+      (if-eqz v0 :l)
+      (const v0 1)
+      (:l)
+      (return v0)
+    )
+  )");
+  EXPECT_CODE_EQ(code.get(), expected.get());
+}
@@ -391,3 +391,56 @@ TEST_F(IRInstructionTest, InvokeSourceIsWideComplex2) {
   EXPECT_FALSE(insn->invoke_src_is_wide(3));
   EXPECT_TRUE(insn->invoke_src_is_wide(4));
 }
+
+TEST_F(IRInstructionTest, ResizeSources) {
+  IRInstruction* insn = new IRInstruction(OPCODE_INVOKE_STATIC);
+  // Grow one register at a time, across the switch from inline registers to
+  // a heap-allocated vector, and shrink back.
+  for (size_t size = 1; size <= 10; ++size) {
+    insn->set_srcs_size(size);
+    insn->set_src(size - 1, size * 10);
+    ASSERT_EQ(insn->srcs_size(), size);
+    IRInstruction copy(*insn);
+    EXPECT_EQ(copy, *insn);
+    size_t i = 0;
+    for (auto reg : insn->srcs()) {
+      EXPECT_EQ(reg, ++i * 10);
+    }
+    EXPECT_EQ(i, size);
+  }
+  for (size_t size = 10; size > 0; --size) {
+    insn->set_srcs_size(size);
+    EXPECT_EQ(insn->srcs_vec().size(), size);
+    EXPECT_EQ(insn->src(size - 1), size * 10);
+  }
+  delete insn;
+}
+
+TEST_F(IRInstructionTest, ShowTo) {
+  using namespace dex_asm;
+
+  auto method = DexMethod::make_method("LFoo;.bar:(IJ)LBar;");
+  auto invoke = dasm(OPCODE_INVOKE_STATIC, method, {0_v, 1_v, 2_v});
+  std::string out = "prefix ";
+  show_to(out, invoke);
+  EXPECT_EQ(out, "prefix " + show(invoke));
+  EXPECT_EQ(show(invoke), "INVOKE_STATIC v0, v1, v2, LFoo;.bar:(IJ)LBar;");
+
+  auto literal = dasm(OPCODE_CONST_WIDE, {0_v, 42_L});
+  EXPECT_EQ(show(literal), "CONST_WIDE v0, 42");
+
+  auto str = dasm(OPCODE_CONST_STRING,
+                  DexString::make_string("a \"quoted\" \\ string"));
+  EXPECT_EQ(show(str), "CONST_STRING \"a \\\"quoted\\\" \\\\ string\"");
+
+  out.clear();
+  show_to(out, method);
+  EXPECT_EQ(out, show(method));
+  out.clear();
+  show_to(out, method->get_proto());
+  EXPECT_EQ(out, "(IJ)LBar;");
+
+  delete invoke;
+  delete literal;
+  delete str;
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <boost/filesystem.hpp>
+#include <gtest/gtest.h>
+#include <json/json.h>
+
+#include "IRAssembler.h"
+#include "IncrementalManifest.h"
+#include "RedexTest.h"
+
+namespace {
+
+class IncrementalManifestTest : public RedexTest {
+ public:
+  IncrementalManifestTest() {
+    m_a = assembler::class_with_methods(
+        "LA;", {assembler::method_from_string(R"(
+          (method (public static) "LA;.foo:()V"
+            ((return-void)))
+        )")});
+    m_b = assembler::class_with_methods(
+        "LB;", {assembler::method_from_string(R"(
+          (method (public static) "LB;.bar:()V"
+            ((invoke-static () "LA;.foo:()V")
+             (return-void)))
+        )")});
+    m_c = assembler::class_with_methods(
+        "LC;", {assembler::method_from_string(R"(
+          (method (public static) "LC;.baz:()V"
+            ((invoke-static () "LB;.bar:()V")
+             (return-void)))
+        )")});
+    m_d = assembler::class_with_methods(
+        "LD;", {assembler::method_from_string(R"(
+          (method (public static) "LD;.qux:()V"
+            ((return-void)))
+        )")});
+    m_scope = {m_a, m_b, m_c, m_d};
+  }
+
+ protected:
+  DexClass* m_a;
+  DexClass* m_b;
+  DexClass* m_c;
+  DexClass* m_d;
+  Scope m_scope;
+};
+
+} // namespace
+
+TEST_F(IncrementalManifestTest, unchanged) {
+  auto previous = incremental::build_manifest(m_scope, "config");
+  auto current = incremental::build_manifest(m_scope, "config");
+  auto region = incremental::get_changed_region(previous, current, m_scope);
+  EXPECT_TRUE(region.changed.empty());
+  EXPECT_TRUE(region.region.empty());
+  EXPECT_FALSE(region.has_removed_classes);
+}
+
+TEST_F(IncrementalManifestTest, dependencyClosure) {
+  auto previous = incremental::build_manifest(m_scope, "config");
+  auto* foo = m_a->get_dmethods().at(0);
+  foo->set_code(assembler::ircode_from_string(R"(
+    ((const v0 0)
+     (return-void))
+  )"));
+  auto current = incremental::build_manifest(m_scope, "config");
+  auto region = incremental::get_changed_region(previous, current, m_scope);
+  EXPECT_EQ(region.changed, std::unordered_set<const DexClass*>({m_a}));
+  EXPECT_EQ(region.region,
+            std::unordered_set<const DexClass*>({m_a, m_b, m_c}));
+  EXPECT_FALSE(region.has_removed_classes);
+}
+
+TEST_F(IncrementalManifestTest, configChanged) {
+  auto previous = incremental::build_manifest(m_scope, "config");
+  auto current = incremental::build_manifest(m_scope, "other config");
+  auto region = incremental::get_changed_region(previous, current, m_scope);
+  EXPECT_EQ(region.changed.size(), m_scope.size());
+  EXPECT_EQ(region.region.size(), m_scope.size());
+}
+
+TEST_F(IncrementalManifestTest, removedClass) {
+  auto previous = incremental::build_manifest(m_scope, "config");
+  Scope scope{m_a, m_b, m_c};
+  auto current = incremental::build_manifest(scope, "config");
+  auto region = incremental::get_changed_region(previous, current, scope);
+  EXPECT_TRUE(region.changed.empty());
+  EXPECT_TRUE(region.has_removed_classes);
+}
+
+TEST_F(IncrementalManifestTest, configFingerprint) {
+  Json::Value config;
+  config["redex"]["passes"].append("LocalDcePass");
+  auto fingerprint = incremental::config_fingerprint(config, {"LocalDcePass"});
+
+  // Where the manifests are doesn't matter.
+  auto with_incremental = config;
+  with_incremental["incremental"]["previous_manifest"] = "/tmp/manifest.json";
+  EXPECT_EQ(fingerprint, incremental::config_fingerprint(with_incremental,
+                                                         {"LocalDcePass"}));
+
+  auto with_option = config;
+  with_option["LocalDcePass"]["no_implementor_abstract_is_pure"] = true;
+  EXPECT_NE(fingerprint,
+            incremental::config_fingerprint(with_option, {"LocalDcePass"}));
+  EXPECT_NE(fingerprint,
+            incremental::config_fingerprint(config, {"LocalDcePass", "X"}));
+}
+
+TEST_F(IncrementalManifestTest, roundTrip) {
+  auto manifest = incremental::build_manifest(m_scope, "config");
+  auto path = boost::filesystem::temp_directory_path() /
+              boost::filesystem::unique_path();
+  EXPECT_FALSE(incremental::read_manifest(path.string()));
+
+  incremental::write_manifest(manifest, path.string());
+  auto read = incremental::read_manifest(path.string());
+  boost::filesystem::remove(path);
+  ASSERT_TRUE(read);
+  EXPECT_EQ(read->config_fingerprint, manifest.config_fingerprint);
+  EXPECT_EQ(read->class_hashes, manifest.class_hashes);
+}
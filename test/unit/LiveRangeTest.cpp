@@ -127,6 +127,40 @@ TEST_F(LiveRangeTest, WidthAwareLiveRange) {
   EXPECT_EQ(code->get_registers_size(), 5);
 }
 
+TEST_F(LiveRangeTest, LiveRangeLoop) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+     (const v1 0)
+     (const v0 1)
+     (:loop)
+     (add-int/lit8 v1 v1 1)
+     (if-eq v1 v0 :loop)
+
+     (const v1 2)
+     (return v1)
+    )
+  )");
+
+  live_range::renumber_registers(code.get(), /* width_aware */ true);
+
+  // The defs that reach the add-int through the back edge and from the entry
+  // share a register; the last def of v1 does not.
+  auto expected_code = assembler::ircode_from_string(R"(
+    (
+     (const v0 0)
+     (const v1 1)
+     (:loop)
+     (add-int/lit8 v0 v0 1)
+     (if-eq v0 v1 :loop)
+
+     (const v2 2)
+     (return v2)
+    )
+  )");
+  EXPECT_CODE_EQ(expected_code.get(), code.get());
+  EXPECT_EQ(code->get_registers_size(), 3);
+}
+
 TEST_F(LiveRangeTest, testDefUseChainSingleDefinition) {
   auto code = assembler::ircode_from_string(R"(
     (
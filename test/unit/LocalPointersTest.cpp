@@ -10,9 +10,13 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include "CallGraph.h"
+#include "Creators.h"
 #include "IRAssembler.h"
+#include "MethodOverrideGraph.h"
 #include "RedexTest.h"
 #include "Show.h"
+#include "Walkers.h"
 
 namespace ptrs = local_pointers;
 
@@ -398,3 +402,71 @@ TEST_F(LocalPointersTest, returnEscapedValue) {
     EXPECT_TRUE(exit_env.may_have_escaped(invoke_insn));
   }
 }
+
+/*
+ * Check that the streaming analysis finds the same summaries as the one that
+ * keeps every FixpointIterator around, even when its memory budget only lets
+ * one method be analyzed at a time.
+ */
+TEST_F(LocalPointersTest, streamingSummariesMatchScopeAnalysis) {
+  ClassCreator creator(DexType::make_type("LBar;"));
+  creator.set_super(type::java_lang_Object());
+  auto id = assembler::method_from_string(R"(
+    (method (public static) "LBar;.id:(LBar;)LBar;"
+     (
+      (load-param-object v0)
+      (return-object v0)
+     )
+    )
+  )");
+  auto caller = assembler::method_from_string(R"(
+    (method (public static) "LBar;.caller:(LBar;LBar;)LBar;"
+     (
+      (load-param-object v0)
+      (load-param-object v1)
+      (sput-object v1 "LBar;.f:LBar;")
+      (invoke-static (v0) "LBar;.id:(LBar;)LBar;")
+      (move-result-object v2)
+      (return-object v2)
+     )
+    )
+  )");
+  creator.add_method(id);
+  creator.add_method(caller);
+  Scope scope{creator.create()};
+  walk::code(scope, [](DexMethod*, IRCode& code) {
+    code.build_cfg(/* editable */ false);
+    code.cfg().calculate_exit_block();
+  });
+  auto cg = call_graph::single_callee_graph(
+      *method_override_graph::build_graph(scope), scope);
+
+  ptrs::SummaryCMap expected;
+  auto fp_iter_map = ptrs::analyze_scope(scope, cg, &expected);
+
+  ptrs::SummaryCMap summaries;
+  std::vector<const DexMethod*> consumed;
+  ptrs::analyze_scope_summaries(
+      scope, cg, &summaries,
+      [&](const DexMethod* method, const ptrs::FixpointIterator&) {
+        consumed.push_back(method);
+      },
+      /* memory_budget */ 1);
+  EXPECT_THAT(consumed, ElementsAre(id, caller));
+
+  EXPECT_EQ(summaries.size(), expected.size());
+  for (auto* method : {id, caller}) {
+    const auto& summary = summaries.at(method);
+    EXPECT_EQ(summary.escaping_parameters,
+              expected.at(method).escaping_parameters);
+    EXPECT_EQ(summary.returned_parameters,
+              expected.at(method).returned_parameters);
+
+    auto fp_iter = ptrs::analyze_method(method, cg, summaries);
+    auto reanalyzed = ptrs::get_escape_summary(*fp_iter, *method->get_code());
+    EXPECT_EQ(reanalyzed.escaping_parameters, summary.escaping_parameters);
+    EXPECT_EQ(reanalyzed.returned_parameters, summary.returned_parameters);
+  }
+  EXPECT_THAT(summaries.at(caller).escaping_parameters, ElementsAre(1));
+  EXPECT_EQ(summaries.at(caller).returned_parameters, ptrs::ParamSet{0});
+}
@@ -455,6 +455,51 @@ TEST_F(MethodInlineTest, test_intra_dex_inlining) {
   }
 }
 
+// A later inliner run reuses the costs of the callees that didn't change.
+TEST_F(MethodInlineTest, shared_inlined_costs) {
+  ConcurrentMethodRefCache concurrent_resolve_cache;
+  auto concurrent_resolver = [&concurrent_resolve_cache](DexMethodRef* method,
+                                                         MethodSearch search) {
+    return resolve_method(method, search, concurrent_resolve_cache);
+  };
+
+  DexStoresVector stores;
+  auto foo_cls = create_a_class("Lfoo;");
+  {
+    DexStore store("root");
+    store.add_classes({foo_cls});
+    stores.push_back(std::move(store));
+  }
+  auto foo_m1 = make_a_method(foo_cls, "foo_m1", 1);
+  make_a_method_calls_others(foo_cls, "foo_main", {foo_m1});
+  std::unordered_set<DexMethod*> candidates{foo_m1};
+  auto scope = build_class_scope(stores);
+  api::LevelChecker::init(0, scope);
+  inliner::InlinerConfig inliner_config;
+  inliner_config.populate(scope);
+
+  {
+    MultiMethodInliner inliner(scope, stores, candidates, concurrent_resolver,
+                               inliner_config);
+    inliner.inline_methods();
+    EXPECT_EQ(inliner.get_inlined().count(foo_m1), 1);
+    EXPECT_EQ(inliner.get_info().shared_inlined_costs_reused, 0);
+  }
+  auto shared_costs = SharedInlinedCosts::get().size();
+  EXPECT_GT(shared_costs, 0);
+
+  // Another caller shows up; foo_m1 itself is unchanged.
+  make_a_method_calls_others(foo_cls, "foo_main2", {foo_m1});
+  {
+    MultiMethodInliner inliner(scope, stores, candidates, concurrent_resolver,
+                               inliner_config);
+    inliner.inline_methods();
+    EXPECT_EQ(inliner.get_inlined().count(foo_m1), 1);
+    EXPECT_GT(inliner.get_info().shared_inlined_costs_reused, 0);
+  }
+  EXPECT_EQ(SharedInlinedCosts::get().size(), shared_costs);
+}
+
 // Don't inline when it would exceed (configured) size
 TEST_F(MethodInlineTest, size_limit) {
   ConcurrentMethodRefCache concurrent_resolve_cache;
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "MethodProfiles.h"
+
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <gtest/gtest.h>
+
+#include "RedexTest.h"
+
+using namespace method_profiles;
+
+class MethodProfilesTest : public RedexTest {};
+
+TEST_F(MethodProfilesTest, binaryRoundTrip) {
+  auto dir = boost::filesystem::temp_directory_path() /
+             boost::filesystem::unique_path();
+  boost::filesystem::create_directories(dir);
+  auto csv_path = (dir / "profile.csv").string();
+  auto binary_path = (dir / "profile.bin").string();
+  {
+    std::ofstream ofs(csv_path);
+    ofs << "interaction,appear#\n"
+        << "ColdStart,42\n"
+        << "index,name,appear100,appear#,avg_call,avg_order,avg_rank100,"
+           "min_api_level\n"
+        << "0,LFoo;.bar:()V,50.5,1,2.25,3,12.5,21\n"
+        << "1,LFoo;.missing:()V,1,1,1,1,1,21\n";
+  }
+  ASSERT_TRUE(MethodProfiles::write_binary_file({csv_path}, binary_path));
+
+  auto* bar = DexMethod::make_method("LFoo;.bar:()V");
+  MethodProfiles profiles;
+  profiles.initialize({binary_path});
+  EXPECT_EQ(profiles.size(), 1);
+  EXPECT_EQ(profiles.unresolved_size(), 1);
+  EXPECT_EQ(*profiles.get_interaction_count(COLD_START), 42);
+  auto stats = profiles.get_method_stat(COLD_START, bar);
+  ASSERT_TRUE(stats);
+  EXPECT_EQ(stats->appear_percent, 50.5);
+  EXPECT_EQ(stats->call_count, 2.25);
+  EXPECT_EQ(stats->order_percent, 12.5);
+  EXPECT_EQ(stats->min_api_level, 21);
+
+  // Rows that did not resolve resolve later, like csv rows.
+  auto* missing = DexMethod::make_method("LFoo;.missing:()V");
+  profiles.process_unresolved_lines();
+  EXPECT_EQ(profiles.unresolved_size(), 0);
+  EXPECT_TRUE(profiles.get_method_stat(COLD_START, missing));
+
+  boost::filesystem::remove_all(dir);
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "Debug.h"
+#include "MutablePriorityQueue.h"
+
+#include <gtest/gtest.h>
+#include <map>
+#include <random>
+
+TEST(MutablePriorityQueueTest, frontAndBack) {
+  MutablePriorityQueue<int, uint64_t> pq;
+  EXPECT_TRUE(pq.empty());
+  pq.insert(1, 10);
+  pq.insert(2, 30);
+  pq.insert(3, 20);
+  EXPECT_EQ(pq.front(), 2);
+  EXPECT_EQ(pq.back(), 1);
+
+  pq.update_priority(1, 40);
+  EXPECT_EQ(pq.front(), 1);
+  EXPECT_EQ(pq.back(), 3);
+
+  pq.erase(1);
+  EXPECT_EQ(pq.front(), 2);
+  pq.erase(2);
+  pq.erase(3);
+  EXPECT_TRUE(pq.empty());
+
+  // Nodes of erased values are reused.
+  pq.insert(2, 5);
+  EXPECT_EQ(pq.front(), 2);
+  EXPECT_EQ(pq.back(), 2);
+  pq.clear();
+  EXPECT_TRUE(pq.empty());
+}
+
+TEST(MutablePriorityQueueTest, matchesOrderedMap) {
+  std::mt19937 generator(42);
+  MutablePriorityQueue<int, uint64_t> pq;
+  std::map<uint64_t, int> expected;
+  std::unordered_map<int, uint64_t> priorities;
+  uint64_t next_priority = 0;
+  // Unique, but unordered, priorities.
+  auto fresh_priority = [&]() {
+    return (next_priority++ * 7919) % 100003;
+  };
+
+  for (size_t k = 0; k < 20000; ++k) {
+    int value = generator() % 200;
+    auto it = priorities.find(value);
+    if (it == priorities.end()) {
+      auto priority = fresh_priority();
+      pq.insert(value, priority);
+      expected.emplace(priority, value);
+      priorities.emplace(value, priority);
+    } else if (generator() % 2) {
+      pq.erase(value);
+      expected.erase(it->second);
+      priorities.erase(it);
+    } else {
+      auto priority = fresh_priority();
+      pq.update_priority(value, priority);
+      expected.erase(it->second);
+      expected.emplace(priority, value);
+      it->second = priority;
+    }
+
+    ASSERT_EQ(pq.empty(), expected.empty());
+    if (!expected.empty()) {
+      ASSERT_EQ(pq.front(), expected.rbegin()->second);
+      ASSERT_EQ(pq.back(), expected.begin()->second);
+    }
+  }
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "OpcodeScan.h"
+
+#include <gtest/gtest.h>
+
+#include "ControlFlow.h"
+#include "DexAsm.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "RedexTest.h"
+
+using namespace dex_asm;
+using namespace opcode_scan;
+
+class OpcodeScanTest : public RedexTest {};
+
+TEST_F(OpcodeScanTest, queries) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (if-eqz v0 :exit)
+      (invoke-static (v0) "LFoo;.bar:(I)V")
+      (const v1 1)
+      (invoke-virtual (v0) "LFoo;.baz:()V")
+      (:exit)
+      (return-void)
+    )
+  )");
+
+  OpcodeArray linear(*code);
+  EXPECT_EQ(linear.size(), 6);
+  EXPECT_TRUE(linear.contains(OPCODE_INVOKE_STATIC));
+  EXPECT_FALSE(linear.contains(OPCODE_MONITOR_ENTER));
+  EXPECT_EQ(linear.count(OPCODE_CONST), 1);
+
+  auto invokes = OpcodeSet::of(opcode::is_an_invoke);
+  EXPECT_TRUE(invokes.contains(OPCODE_INVOKE_INTERFACE));
+  EXPECT_FALSE(invokes.contains(OPCODE_CONST));
+  EXPECT_TRUE(linear.contains_any(invokes));
+  EXPECT_EQ(linear.count_any(invokes), 2);
+  EXPECT_FALSE(
+      linear.contains_any({OPCODE_MONITOR_ENTER, OPCODE_MONITOR_EXIT}));
+
+  code->build_cfg(/* editable */ true);
+  OpcodeArray from_cfg(*code);
+  EXPECT_EQ(from_cfg.count_any(invokes), 2);
+  size_t in_blocks = 0;
+  for (auto* block : code->cfg().blocks()) {
+    in_blocks += OpcodeArray(*block).count_any(invokes);
+  }
+  EXPECT_EQ(in_blocks, 2);
+  code->clear_cfg();
+}
+
+TEST_F(OpcodeScanTest, longCode) {
+  // Longer than a scan chunk, with the only match in the tail.
+  auto code = assembler::ircode_from_string("((const v0 0))");
+  for (size_t i = 0; i < 100; ++i) {
+    code->push_back(dasm(OPCODE_CONST, {0_v}));
+  }
+  code->push_back(dasm(OPCODE_RETURN_VOID));
+
+  OpcodeArray opcodes(*code);
+  EXPECT_EQ(opcodes.size(), 102);
+  EXPECT_EQ(opcodes.count(OPCODE_CONST), 101);
+  EXPECT_TRUE(opcodes.contains(OPCODE_RETURN_VOID));
+  EXPECT_EQ(opcodes.count(OPCODE_RETURN_VOID), 1);
+  EXPECT_FALSE(opcodes.contains(OPCODE_THROW));
+}
@@ -745,3 +745,50 @@ TEST_F(OptimizeEnumsTest, test_param_summary_generating) {
   EXPECT_EQ(summary4.returned_param, boost::none);
   EXPECT_TRUE(summary4.safe_params.empty());
 }
+
+TEST_F(OptimizeEnumsTest, shared_fixpoint_iterator) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param-object v1)
+      (sget-object "LFoo;.table:[LBar;")
+      (move-result-pseudo v0)
+      (invoke-virtual (v1) "LEnum;.ordinal:()I")
+      (move-result v1)
+      (aget v0 v1)
+      (move-result-pseudo v0)
+      (const v2 0)
+      (if-eq v2 v0 :case0)
+
+      (const v2 1)
+      (if-eq v2 v0 :case1)
+
+      (return v0)
+
+      (:case0)
+      (return v0)
+
+      (:case1)
+      (invoke-static (v2) "LFoo;.useReg:(I)V")
+      (return v1)
+    )
+)");
+
+  code->build_cfg();
+  const auto& results = find_enums(&code->cfg());
+  EXPECT_EQ(1, results.size());
+  const auto& info = results[0];
+  auto& cfg = info.branch->cfg();
+  SwitchEquivFinder finder(&cfg, *info.branch, *info.reg);
+  ASSERT_TRUE(finder.success());
+
+  auto fixpoint_iterator = SwitchEquivFinder::make_fixpoint_iterator(cfg);
+  for (size_t i = 0; i < 2; i++) {
+    SwitchEquivFinder shared_finder(&cfg, *info.branch, *info.reg,
+                                    /* leaf_duplication_threshold */ 0,
+                                    fixpoint_iterator);
+    ASSERT_TRUE(shared_finder.success());
+    EXPECT_TRUE(finder.key_to_case() == shared_finder.key_to_case());
+    EXPECT_EQ(finder.extra_loads().size(), shared_finder.extra_loads().size());
+  }
+  code->clear_cfg();
+}
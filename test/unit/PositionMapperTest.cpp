@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <gtest/gtest.h>
+
+#include "DexClass.h"
+#include "DexPosition.h"
+#include "RedexTest.h"
+
+class PositionMapperTest : public RedexTest {
+ protected:
+  std::unique_ptr<DexPosition> make_position(uint32_t line,
+                                             DexPosition* parent = nullptr) {
+    auto pos = std::make_unique<DexPosition>(
+        DexString::make_string("LFoo;.bar:()V"),
+        DexString::make_string("Foo.java"), line);
+    pos->parent = parent;
+    return pos;
+  }
+};
+
+TEST_F(PositionMapperTest, identicalPositionsShareLines) {
+  RealPositionMapper mapper("");
+
+  // Two copies of a callsite, each with an inlined callee position.
+  auto callsite1 = make_position(10);
+  auto callsite2 = make_position(10);
+  auto inlined1 = make_position(20, callsite1.get());
+  auto inlined2 = make_position(20, callsite2.get());
+  auto other = make_position(30, callsite2.get());
+  for (auto* pos : {callsite1.get(), callsite2.get(), inlined1.get(),
+                    inlined2.get(), other.get()}) {
+    mapper.register_position(pos);
+  }
+
+  auto callsite_line = mapper.position_to_line(callsite1.get());
+  EXPECT_EQ(mapper.position_to_line(callsite2.get()), callsite_line);
+  auto inlined_line = mapper.position_to_line(inlined1.get());
+  EXPECT_NE(inlined_line, callsite_line);
+  EXPECT_EQ(mapper.position_to_line(inlined2.get()), inlined_line);
+  EXPECT_NE(mapper.position_to_line(other.get()), inlined_line);
+  EXPECT_EQ(mapper.size(), 3);
+}
+
+TEST_F(PositionMapperTest, unmappedParentsAreNotMerged) {
+  auto map_path = boost::filesystem::temp_directory_path() /
+                  boost::filesystem::unique_path();
+  RealPositionMapper mapper(map_path.string());
+
+  // The callsites are registered but never mapped themselves, so their
+  // children can't be told apart by their parents' lines.
+  auto callsite1 = make_position(10);
+  auto callsite2 = make_position(11);
+  auto inlined1 = make_position(20, callsite1.get());
+  auto inlined2 = make_position(20, callsite2.get());
+  for (auto* pos :
+       {callsite1.get(), callsite2.get(), inlined1.get(), inlined2.get()}) {
+    mapper.register_position(pos);
+  }
+  EXPECT_NE(mapper.position_to_line(inlined1.get()),
+            mapper.position_to_line(inlined2.get()));
+
+  mapper.write_map();
+  EXPECT_EQ(mapper.size(), 4);
+
+  std::ifstream ifs(map_path.string(), std::ios::binary);
+  ASSERT_TRUE(ifs.good());
+  uint32_t header[3];
+  ifs.read(reinterpret_cast<char*>(header), sizeof(header));
+  EXPECT_EQ(header[0], 0xfaceb000);
+  EXPECT_EQ(header[1], 2);
+  for (uint32_t i = 0; i < header[2]; ++i) {
+    uint32_t size;
+    ifs.read(reinterpret_cast<char*>(&size), sizeof(size));
+    ifs.seekg(size, std::ios::cur);
+  }
+  uint32_t num_positions;
+  ifs.read(reinterpret_cast<char*>(&num_positions), sizeof(num_positions));
+  EXPECT_EQ(num_positions, 4);
+  ifs.close();
+  boost::filesystem::remove(map_path);
+}
@@ -89,6 +89,33 @@ TEST_F(ProguardMapTest, HandlesGeneratedComments) {
   EXPECT_EQ("LA;.a:I", pm.translate_field("Lcom/foo/bar;.do1:I"));
 }
 
+TEST_F(ProguardMapTest, ManyChunks) {
+  // Big enough to be parsed in several chunks. Every member refers to the
+  // last class, whose mapping is only known once all classes are parsed.
+  constexpr size_t kNumClasses = 50000;
+  std::ostringstream os;
+  for (size_t i = 0; i < kNumClasses; ++i) {
+    os << "com.foo.Class" << i << " -> X.C" << i << ":\n"
+       << "    com.foo.Class" << kNumClasses - 1 << " field -> a\n"
+       << "    1:2:void method(com.foo.Class" << kNumClasses - 1 << ") -> b\n";
+  }
+  std::stringstream ss(os.str());
+  ProguardMap pm(ss);
+  for (size_t i = 0; i < kNumClasses; i += 4999) {
+    auto cls = "Lcom/foo/Class" + std::to_string(i) + ";";
+    auto obf_cls = "LX/C" + std::to_string(i) + ";";
+    auto last = "LX/C" + std::to_string(kNumClasses - 1) + ";";
+    EXPECT_EQ(obf_cls, pm.translate_class(cls));
+    EXPECT_EQ(obf_cls + ".a:" + last,
+              pm.translate_field(cls + ".field:Lcom/foo/Class" +
+                                 std::to_string(kNumClasses - 1) + ";"));
+    EXPECT_EQ(cls + ".method:(Lcom/foo/Class" +
+                  std::to_string(kNumClasses - 1) + ";)V",
+              pm.deobfuscate_method(obf_cls + ".b:(" + last + ")V"));
+    EXPECT_THAT(pm.method_lines(obf_cls + ".b:(" + last + ")V"), SizeIs(1));
+  }
+}
+
 TEST_F(ProguardMapTest, LineNumbers) {
   std::stringstream ss(
       "com.foo.bar -> A:\n"
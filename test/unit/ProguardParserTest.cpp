@@ -7,11 +7,13 @@
 
 #include <gtest/gtest.h>
 
+#include <fstream>
 #include <istream>
 #include <vector>
 
 #include "ProguardConfiguration.h"
 #include "ProguardParser.h"
+#include "RedexTestUtils.h"
 
 using namespace keep_rules;
 
@@ -59,6 +61,33 @@ TEST(ProguardParserTest, include) {
   ASSERT_EQ(config.includes[2], "gamma.txt");
 }
 
+// Parse included files, breadth first.
+TEST(ProguardParserTest, include_files) {
+  auto tmp_dir = redex::make_tmp_dir("ProguardParserTest%%%%%%%%");
+  auto write = [&](const std::string& name, const std::string& contents) {
+    auto path = tmp_dir.path + "/" + name;
+    std::ofstream(path) << contents;
+    return path;
+  };
+  auto c = write("c.pro", "-keep class C\n");
+  auto b = write("b.pro", "-dontshrink\n-keep class B\n");
+  auto a = write("a.pro",
+                 "-include " + c + "\n-include " + b + "\n-keep class A\n");
+  auto root = write("root.pro",
+                    "-include " + a + "\n-include " + b + "\n-keep class R\n");
+
+  ProguardConfiguration config;
+  proguard_parser::parse_file(root, &config);
+  ASSERT_TRUE(config.ok);
+  EXPECT_EQ(config.includes, (std::vector<std::string>{a, b, c, b}));
+  EXPECT_FALSE(config.shrink);
+  std::vector<std::string> kept;
+  for (const auto& keep : config.keep_rules) {
+    kept.push_back(keep->class_spec.className);
+  }
+  EXPECT_EQ(kept, (std::vector<std::string>{"R", "A", "B", "C"}));
+}
+
 // Parse basedirectory
 TEST(ProguardParserTest, basedirectory) {
   ProguardConfiguration config;
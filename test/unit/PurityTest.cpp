@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "Purity.h"
+#include "RedexTest.h"
+#include "ScopeHelper.h"
+
+class PurityTest : public RedexTest {};
+
+/*
+ * a <-> b -> c, d -> e (unknown), g -> d, f -> f. All the methods but d and
+ * e read a field.
+ */
+TEST_F(PurityTest, locationsClosure) {
+  auto scope = create_empty_scope();
+  auto cls = create_internal_class(DexType::make_type("LFoo;"),
+                                   type::java_lang_Object(), {});
+  scope.push_back(cls);
+  auto proto =
+      DexProto::make_proto(type::_void(), DexTypeList::make_type_list({}));
+  std::unordered_map<std::string, DexMethod*> methods;
+  for (auto name : {"a", "b", "c", "d", "e", "f", "g"}) {
+    methods[name] =
+        create_empty_method(cls, name, proto, ACC_PUBLIC | ACC_STATIC);
+  }
+  auto location = [](const char* name) {
+    auto field = DexField::make_field(std::string("LFoo;.") + name + ":I")
+                     ->make_concrete(ACC_PUBLIC);
+    return CseLocation(field);
+  };
+  auto f1 = location("f1");
+  auto f2 = location("f2");
+  auto f3 = location("f3");
+
+  std::unordered_map<DexMethod*, LocationsAndDependencies> lads;
+  lads[methods["a"]] = {{f1}, {methods["b"]}};
+  lads[methods["b"]] = {{f2}, {methods["a"], methods["c"]}};
+  lads[methods["c"]] = {{f3}, {}};
+  lads[methods["d"]] = {{}, {methods["e"]}};
+  lads[methods["f"]] = {{f1}, {methods["f"]}};
+  lads[methods["g"]] = {{f2}, {methods["d"]}};
+
+  std::unordered_map<const DexMethod*, CseUnorderedLocationSet> result;
+  auto iterations = compute_locations_closure(
+      scope, /* method_override_graph */ nullptr,
+      [&](DexMethod* method) -> boost::optional<LocationsAndDependencies> {
+        auto it = lads.find(method);
+        if (it == lads.end()) {
+          return boost::none;
+        }
+        return it->second;
+      },
+      &result);
+
+  EXPECT_EQ(2, iterations);
+  EXPECT_EQ(4, result.size());
+  EXPECT_EQ((CseUnorderedLocationSet{f1, f2, f3}), result.at(methods["a"]));
+  EXPECT_EQ((CseUnorderedLocationSet{f1, f2, f3}), result.at(methods["b"]));
+  EXPECT_EQ((CseUnorderedLocationSet{f3}), result.at(methods["c"]));
+  EXPECT_EQ((CseUnorderedLocationSet{f1}), result.at(methods["f"]));
+  EXPECT_FALSE(result.count(methods["d"]));
+  EXPECT_FALSE(result.count(methods["e"]));
+  EXPECT_FALSE(result.count(methods["g"]));
+}
@@ -245,3 +245,58 @@ TEST_F(RemoveUnusedArgsTest, multipleBlocksMixedArgs) {
   EXPECT_THAT(live_arg_idxs, ::testing::ElementsAre(0, 1, 2, 3));
   EXPECT_THAT(dead_insns.size(), 0);
 }
+
+// Checks that the callsite index follows the invokes of changed methods
+TEST_F(RemoveUnusedArgsTest, callsiteIndex) {
+  auto callee = assembler::method_from_string(R"(
+    (method (public static) "LBar;.callee:(I)I"
+      (
+        (load-param v0)
+        (return v0)
+      )
+    )
+  )");
+  auto caller = assembler::method_from_string(R"(
+    (method (public static) "LBar;.caller:()V"
+      (
+        (const v0 0)
+        (invoke-static (v0) "LBar;.callee:(I)I")
+        (move-result v1)
+        (invoke-static (v0) "LUnknown;.foo:(I)V")
+        (return-void)
+      )
+    )
+  )");
+  auto cls = assembler::class_with_methods("LBar;", {callee, caller});
+  Scope scope{cls};
+
+  remove_unused_args::CallsiteIndex callsite_index(scope);
+  ASSERT_NE(callsite_index.callsites(callee), nullptr);
+  EXPECT_EQ(callsite_index.callsites(callee)->size(), 1);
+  EXPECT_EQ(callsite_index.callsites(callee)->front().caller, caller);
+  EXPECT_TRUE(callsite_index.is_result_used(callee));
+  EXPECT_THAT(callsite_index.unresolved_callee_protos(caller),
+              ::testing::ElementsAre(DexProto::make_proto(
+                  type::_void(), DexTypeList::make_type_list({type::_int()}))));
+  EXPECT_TRUE(callsite_index.changed(callee));
+
+  callsite_index.clear_changed();
+  EXPECT_FALSE(callsite_index.changed(callee));
+  EXPECT_FALSE(callsite_index.changed(caller));
+
+  IRInstruction* move_result = nullptr;
+  for (const auto& mie : InstructionIterable(caller->get_code())) {
+    if (opcode::is_a_move_result(mie.insn->opcode())) {
+      move_result = mie.insn;
+    }
+  }
+  ASSERT_NE(move_result, nullptr);
+  caller->get_code()->remove_opcode(move_result);
+  callsite_index.reindex({caller});
+
+  ASSERT_NE(callsite_index.callsites(callee), nullptr);
+  EXPECT_EQ(callsite_index.callsites(callee)->size(), 1);
+  EXPECT_FALSE(callsite_index.is_result_used(callee));
+  EXPECT_TRUE(callsite_index.changed(callee));
+  EXPECT_TRUE(callsite_index.changed(caller));
+}
@@ -408,3 +408,51 @@ TEST_F(ResolverTest, ResolveMethod) {
   EXPECT_TRUE(resolve_method(g_method, MethodSearch::InterfaceVirtual) ==
               e_method);
 }
+
+TEST_F(ResolverTest, ResolveMethodAfterEdits) {
+  create_method_scope();
+
+  auto b_method = DexMethod::get_method("B.method:()V");
+  auto c_method = DexMethod::get_method("C.method:()V");
+  auto d_method = DexMethod::get_method("D.method:()V");
+  EXPECT_TRUE(resolve_method(c_method, MethodSearch::Virtual) == b_method);
+  // Resolving again hits the cache.
+  EXPECT_TRUE(resolve_method(c_method, MethodSearch::Virtual) == b_method);
+
+  auto cls_b = type_class(b_method->get_class());
+  cls_b->remove_method(b_method->as_def());
+  EXPECT_TRUE(resolve_method(c_method, MethodSearch::Virtual) == nullptr);
+  cls_b->add_method(b_method->as_def());
+  EXPECT_TRUE(resolve_method(c_method, MethodSearch::Virtual) == b_method);
+
+  // Edits through the member accessors count as well.
+  auto& vmethods = cls_b->get_vmethods();
+  vmethods.erase(std::find(vmethods.begin(), vmethods.end(), b_method));
+  EXPECT_TRUE(resolve_method(c_method, MethodSearch::Virtual) == nullptr);
+  cls_b->add_method(b_method->as_def());
+
+  // Changing the hierarchy of the class.
+  auto cls_c = type_class(c_method->get_class());
+  cls_c->set_super_class(type::java_lang_Object());
+  EXPECT_TRUE(resolve_method(c_method, MethodSearch::Virtual) == nullptr);
+  cls_c->set_super_class(b_method->get_class());
+  EXPECT_TRUE(resolve_method(c_method, MethodSearch::Virtual) == b_method);
+  EXPECT_TRUE(resolve_method(d_method, MethodSearch::Virtual) == d_method);
+}
+
+TEST_F(ResolverTest, ResolveFieldAfterEdits) {
+  create_field_scope();
+
+  auto fdef =
+      DexField::get_field(DexType::get_type("B"), DexString::get_string("f2"),
+                          DexType::get_type("Ljava/lang/String;"));
+  auto fref = make_field_ref(DexType::get_type("C"), "f2",
+                             DexType::get_type("Ljava/lang/String;"));
+  EXPECT_TRUE(resolve_field(fref, FieldSearch::Static) == fdef);
+
+  auto cls_b = type_class(DexType::get_type("B"));
+  cls_b->remove_field(fdef->as_def());
+  EXPECT_TRUE(resolve_field(fref, FieldSearch::Static) == nullptr);
+  cls_b->add_field(fdef->as_def());
+  EXPECT_TRUE(resolve_field(fref, FieldSearch::Static) == fdef);
+}
@@ -698,3 +698,65 @@ B3: LFoo;.bar:()V@4(5:0))");
   EXPECT_EQ(coalesced.first, 1);
   EXPECT_EQ(coalesced.second, 4);
 }
+
+TEST_F(SourceBlocksTest, copies_share_vals_until_changed) {
+  auto* method = create_method();
+  SourceBlock sb(method, 0,
+                 {SourceBlock::Val(1, 1), SourceBlock::Val::none()});
+  SourceBlock copy(sb);
+  EXPECT_EQ(copy.vals.begin(), sb.vals.begin());
+  EXPECT_TRUE(copy == sb);
+
+  copy.vals.set(1, SourceBlock::Val(0.5, 1));
+  EXPECT_NE(copy.vals.begin(), sb.vals.begin());
+  EXPECT_FALSE(sb.vals[1]);
+  EXPECT_EQ(*copy.get_val(1), 0.5);
+  EXPECT_EQ(*copy.get_val(0), 1);
+  EXPECT_FALSE(copy == sb);
+}
+
+TEST_F(SourceBlocksTest, cold_chains_last) {
+  auto* method = create_method();
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (.src_block "LFoo;.bar:()V" 0 (1 1))
+      (if-eqz v0 :cold)
+      (.src_block "LFoo;.bar:()V" 1 (1 1))
+      (if-nez v0 :hot)
+      (.src_block "LFoo;.bar:()V" 2 (1 1))
+      (return-void)
+      (:cold)
+      (.src_block "LFoo;.bar:()V" 3 (0 0))
+      (const v0 2)
+      (return-void)
+      (:hot)
+      (.src_block "LFoo;.bar:()V" 4 (1 1))
+      (const v0 3)
+      (return-void)
+    )
+  )");
+  method->set_code(std::move(code));
+  auto* ir = method->get_code();
+  ir->build_cfg();
+  auto& cfg = ir->cfg();
+
+  std::unique_ptr<LinearizationStrategy> strategy =
+      std::make_unique<ColdChainsLastStrategy>();
+  auto order = cfg.order(strategy);
+  ASSERT_EQ(order.size(), cfg.num_blocks());
+  EXPECT_EQ(order.front(), cfg.entry_block());
+  auto* last = get_first_source_block(order.back());
+  ASSERT_NE(last, nullptr);
+  EXPECT_EQ(last->id, 3);
+  for (auto* b : order) {
+    auto* sb = get_first_source_block(b);
+    ASSERT_NE(sb, nullptr);
+    EXPECT_EQ(ColdChainsLastStrategy::is_cold({b}), sb->id == 3);
+  }
+
+  // Chains are only cold when all of their blocks are.
+  EXPECT_FALSE(ColdChainsLastStrategy::is_cold({order.back(), order.front()}));
+  EXPECT_FALSE(ColdChainsLastStrategy::is_cold({}));
+  ir->clear_cfg(strategy);
+}
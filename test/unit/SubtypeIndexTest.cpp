@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "ClassHierarchy.h"
+#include "DexClass.h"
+#include "RedexTest.h"
+#include "ScopeHelper.h"
+#include "Show.h"
+#include "SubtypeIndex.h"
+#include "TypeUtil.h"
+
+/**
+ * class java.lang.Object {}
+ * interface I1 {}
+ * interface I2 extends I1 {}
+ * external interface I3 {}
+ * interface I4 extends I2, I3 {}
+ * class A implements I1 {}
+ *   class B extends A {}
+ *     class C extends B implements I4 {}
+ * class D {}
+ *   class E extends D implements I3 {}
+ * external class X {}
+ *   class F extends X {}
+ * // unknown type Odd
+ *   class G extends Odd implements I2 {}
+ *     class H extends G {}
+ */
+class SubtypeIndexTest : public RedexTest {
+ public:
+  void SetUp() override {
+    auto intf_flag = ACC_PUBLIC | ACC_INTERFACE;
+    m_scope = create_empty_scope();
+    auto obj_t = type::java_lang_Object();
+
+    auto i1_t = make("LI1;");
+    auto i2_t = make("LI2;");
+    auto i3_t = make("LI3;");
+    auto i4_t = make("LI4;");
+    m_scope.push_back(create_internal_class(i1_t, obj_t, {}, intf_flag));
+    m_scope.push_back(create_internal_class(i2_t, obj_t, {i1_t}, intf_flag));
+    create_external_class(i3_t, obj_t, {}, intf_flag);
+    m_scope.push_back(
+        create_internal_class(i4_t, obj_t, {i2_t, i3_t}, intf_flag));
+
+    auto a_t = make("LA;");
+    auto b_t = make("LB;");
+    auto d_t = make("LD;");
+    auto x_t = make("LX;");
+    auto g_t = make("LG;");
+    m_scope.push_back(create_internal_class(a_t, obj_t, {i1_t}));
+    m_scope.push_back(create_internal_class(b_t, a_t, {}));
+    m_scope.push_back(create_internal_class(make("LC;"), b_t, {i4_t}));
+    m_scope.push_back(create_internal_class(d_t, obj_t, {}));
+    m_scope.push_back(create_internal_class(make("LE;"), d_t, {i3_t}));
+    create_external_class(x_t, obj_t, {});
+    m_scope.push_back(create_internal_class(make("LF;"), x_t, {}));
+    m_scope.push_back(create_internal_class(g_t, make("LOdd;"), {i2_t}));
+    m_scope.push_back(create_internal_class(make("LH;"), g_t, {}));
+
+    // Types without a class, and arrays.
+    make("LUnknown;");
+    make("[LB;");
+    make("[LA;");
+    make("[LI1;");
+    make("[[LC;");
+    make("[[LI4;");
+    make("[Ljava/lang/Object;");
+    make("[I");
+  }
+
+ protected:
+  DexType* make(const char* name) {
+    auto type = DexType::make_type(name);
+    m_types.push_back(type);
+    return type;
+  }
+
+  Scope m_scope;
+  std::vector<DexType*> m_types{type::java_lang_Object()};
+};
+
+TEST_F(SubtypeIndexTest, checkCastAgreesWithTypeUtil) {
+  SubtypeIndex index(m_scope);
+  for (auto type : m_types) {
+    for (auto base : m_types) {
+      EXPECT_EQ(type::check_cast(type, base), index.check_cast(type, base))
+          << SHOW(type) << " -> " << SHOW(base);
+    }
+  }
+}
+
+TEST_F(SubtypeIndexTest, isSubclass) {
+  SubtypeIndex index(m_scope);
+  for (auto parent : m_types) {
+    for (auto child : m_types) {
+      auto cls = type_class(child);
+      if (cls == nullptr || is_interface(cls)) {
+        EXPECT_FALSE(index.is_subclass(parent, child) && parent != child);
+        continue;
+      }
+      auto parent_cls = type_class(parent);
+      bool expected = type::is_subclass(parent, child) &&
+                      (parent_cls == nullptr || !is_interface(parent_cls));
+      EXPECT_EQ(expected, index.is_subclass(parent, child))
+          << SHOW(parent) << " <- " << SHOW(child);
+    }
+  }
+  auto odd_t = DexType::get_type("LOdd;");
+  EXPECT_TRUE(index.is_subclass(odd_t, DexType::get_type("LH;")));
+  EXPECT_FALSE(index.is_subclass(type::java_lang_Object(),
+                                 DexType::get_type("LH;")));
+  EXPECT_FALSE(
+      index.is_subclass(DexType::get_type("LI1;"), DexType::get_type("LI1;")));
+}
+
+TEST_F(SubtypeIndexTest, implements) {
+  SubtypeIndex index(m_scope);
+  auto c_t = DexType::get_type("LC;");
+  for (auto intf : {"LI1;", "LI2;", "LI3;", "LI4;"}) {
+    EXPECT_TRUE(index.implements(c_t, DexType::get_type(intf))) << intf;
+  }
+  auto b_t = DexType::get_type("LB;");
+  EXPECT_TRUE(index.implements(b_t, DexType::get_type("LI1;")));
+  EXPECT_FALSE(index.implements(b_t, DexType::get_type("LI2;")));
+  auto h_t = DexType::get_type("LH;");
+  EXPECT_TRUE(index.implements(h_t, DexType::get_type("LI1;")));
+  EXPECT_FALSE(index.implements(h_t, DexType::get_type("LI3;")));
+  auto i4_t = DexType::get_type("LI4;");
+  EXPECT_TRUE(index.implements(i4_t, DexType::get_type("LI1;")));
+  EXPECT_FALSE(index.implements(i4_t, i4_t));
+  EXPECT_EQ(4, index.num_interfaces());
+}
+
+TEST_F(SubtypeIndexTest, getAllChildren) {
+  SubtypeIndex index(m_scope);
+  auto hierarchy = build_type_hierarchy(m_scope);
+  for (auto type : m_types) {
+    TypeSet children;
+    index.get_all_children(type, children);
+    EXPECT_EQ(get_all_children(hierarchy, type), children) << SHOW(type);
+  }
+}
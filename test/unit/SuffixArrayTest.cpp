@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "SuffixArray.h"
+
+#include <algorithm>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <random>
+
+using namespace outliner_impl;
+
+TEST(SuffixArrayTest, banana) {
+  // b a n a n a
+  std::vector<uint32_t> s{1, 0, 2, 0, 2, 0};
+  auto sa = build_suffix_array(s);
+  EXPECT_THAT(sa.suffixes, ::testing::ElementsAre(5, 3, 1, 0, 4, 2));
+  EXPECT_THAT(sa.lcp, ::testing::ElementsAre(0, 1, 3, 0, 0, 2));
+  EXPECT_THAT(get_repeat_lengths(s),
+              ::testing::ElementsAre(0, 3, 2, 3, 2, 1));
+}
+
+TEST(SuffixArrayTest, empty) {
+  std::vector<uint32_t> s;
+  EXPECT_TRUE(build_suffix_array(s).suffixes.empty());
+  EXPECT_TRUE(get_repeat_lengths(s).empty());
+}
+
+TEST(SuffixArrayTest, agreesWithQuadraticComputation) {
+  std::mt19937 generator(3);
+  for (size_t round = 0; round < 500; round++) {
+    std::vector<uint32_t> s(generator() % 50);
+    auto alphabet = 1 + generator() % 4;
+    for (auto& x : s) {
+      x = generator() % alphabet;
+    }
+    auto sa = build_suffix_array(s);
+    for (size_t i = 1; i < s.size(); i++) {
+      EXPECT_TRUE(std::lexicographical_compare(
+          s.begin() + sa.suffixes[i - 1], s.end(), s.begin() + sa.suffixes[i],
+          s.end()));
+    }
+    auto lengths = get_repeat_lengths(s);
+    for (size_t p = 0; p < s.size(); p++) {
+      uint32_t expected = 0;
+      for (size_t q = 0; q < s.size(); q++) {
+        uint32_t h = 0;
+        while (q != p && p + h < s.size() && q + h < s.size() &&
+               s[p + h] == s[q + h]) {
+          h++;
+        }
+        expected = std::max(expected, h);
+      }
+      EXPECT_EQ(expected, lengths[p]) << "at " << p;
+    }
+  }
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "SummarySerialization.h"
+
+#include <gtest/gtest.h>
+#include <sstream>
+
+#include "IRAssembler.h"
+#include "RedexTest.h"
+
+using namespace summary_serialization;
+
+class SummarySerializationTest : public RedexTest {
+ protected:
+  DexMethod* make_method(const std::string& name) {
+    auto method = assembler::method_from_string("(method (public static) \"" +
+                                                name +
+                                                "\" ((return-void)))");
+    m_methods.push_back(method);
+    return method;
+  }
+
+  CacheKeys compute_keys(size_t salt = 0) {
+    return compute_cache_keys(
+        m_methods,
+        [&](const DexMethod* method) {
+          auto it = m_dependencies.find(method);
+          return it == m_dependencies.end() ? std::vector<const DexMethod*>()
+                                            : it->second;
+        },
+        salt);
+  }
+
+  std::vector<const DexMethod*> m_methods;
+  std::unordered_map<const DexMethod*, std::vector<const DexMethod*>>
+      m_dependencies;
+};
+
+TEST_F(SummarySerializationTest, keysTrackTransitiveDependencies) {
+  auto a = make_method("LFoo;.a:()V");
+  auto b = make_method("LFoo;.b:()V");
+  auto c = make_method("LFoo;.c:()V");
+  auto d = make_method("LFoo;.d:()V");
+  auto e = make_method("LFoo;.e:()V");
+  auto f = make_method("LFoo;.f:()V");
+  m_dependencies[a] = {b};
+  m_dependencies[b] = {c};
+  m_dependencies[e] = {f};
+  m_dependencies[f] = {e, c};
+
+  auto keys = compute_keys();
+  EXPECT_EQ(keys.size(), m_methods.size());
+  EXPECT_EQ(keys, compute_keys());
+  // Methods with the same code but different names get different keys.
+  EXPECT_NE(keys.at(c), keys.at(d));
+  EXPECT_NE(keys.at(e), keys.at(f));
+  EXPECT_NE(keys, compute_keys(/* salt */ 42));
+
+  c->set_code(assembler::ircode_from_string(R"(
+    (
+      (const v0 0)
+      (return-void)
+    )
+  )"));
+  auto new_keys = compute_keys();
+  for (auto method : {a, b, c, e, f}) {
+    EXPECT_NE(keys.at(method), new_keys.at(method)) << show(method);
+  }
+  EXPECT_EQ(keys.at(d), new_keys.at(d));
+
+  // A new dependency changes the keys of the dependents only.
+  m_dependencies[d] = {a};
+  auto newer_keys = compute_keys();
+  EXPECT_NE(new_keys.at(d), newer_keys.at(d));
+  for (auto method : {a, b, c, e, f}) {
+    EXPECT_EQ(new_keys.at(method), newer_keys.at(method)) << show(method);
+  }
+}
+
+TEST_F(SummarySerializationTest, onlyUnchangedSummariesAreReloaded) {
+  auto a = make_method("LFoo;.a:()V");
+  auto b = make_method("LFoo;.b:()V");
+  auto c = make_method("LFoo;.c:()V");
+  m_dependencies[a] = {b};
+
+  std::function<sparta::s_expr(const int&)> to_s_expr = [](const int& v) {
+    return sparta::s_expr(v);
+  };
+  std::function<boost::optional<int>(const sparta::s_expr&)> from_s_expr =
+      [](const sparta::s_expr& expr) -> boost::optional<int> {
+    if (!expr.is_int32()) {
+      return boost::none;
+    }
+    return expr.get_int32();
+  };
+
+  auto keys = compute_keys();
+  std::unordered_map<const DexMethod*, int> summaries{{a, 1}, {b, 2}, {c, 3}};
+  std::ostringstream output;
+  write_cache(output, summaries, keys, to_s_expr);
+
+  std::unordered_map<const DexMethod*, int> reloaded;
+  {
+    std::istringstream input(output.str());
+    EXPECT_EQ(read_cache(input, keys, from_s_expr, &reloaded), 3);
+    EXPECT_EQ(reloaded, summaries);
+  }
+
+  b->set_code(assembler::ircode_from_string(R"(
+    (
+      (const v0 0)
+      (return-void)
+    )
+  )"));
+  reloaded.clear();
+  {
+    std::istringstream input(output.str());
+    EXPECT_EQ(read_cache(input, compute_keys(), from_s_expr, &reloaded), 1);
+    EXPECT_EQ(reloaded.at(c), 3);
+  }
+}
@@ -9,6 +9,7 @@
 
 #include "IRAssembler.h"
 #include "RedexTest.h"
+#include "RewriteBatch.h"
 
 using namespace type_reference;
 
@@ -92,3 +93,69 @@ TEST_F(TypeRefUpdaterTest, init_collision) {
   )");
   EXPECT_CODE_EQ(baz->get_code(), expected_baz_code.get());
 }
+
+TEST_F(TypeRefUpdaterTest, rewrite_batch) {
+  auto foo = DexType::make_type("LFoo;");
+  auto bar = DexType::make_type("LBar;");
+  auto baz = DexType::make_type("LBaz;");
+  ClassCreator baz_cc(baz);
+  baz_cc.set_super(type::java_lang_Object());
+  auto cls_baz = baz_cc.create();
+
+  ClassCreator cc(foo);
+  cc.set_super(type::java_lang_Object());
+  std::vector<DexMethod*> callees;
+  for (const auto& name : {"a", "b", "c"}) {
+    auto callee =
+        DexMethod::make_method(std::string("LFoo;.") + name + ":()V")
+            ->make_concrete(ACC_PUBLIC | ACC_STATIC, false);
+    callee->set_code(assembler::ircode_from_string("((return-void))"));
+    cc.add_method(callee);
+    callees.push_back(callee);
+  }
+  auto take_baz = DexMethod::make_method("LFoo;.take:(LBaz;)V")
+                      ->make_concrete(ACC_PUBLIC | ACC_STATIC, false);
+  take_baz->set_code(assembler::ircode_from_string(R"(
+    (
+      (load-param-object v0)
+      (return-void)
+    )
+  )"));
+  cc.add_method(take_baz);
+  auto caller = DexMethod::make_method("LFoo;.caller:()V")
+                    ->make_concrete(ACC_PUBLIC | ACC_STATIC, false);
+  caller->set_code(assembler::ircode_from_string(R"(
+    (
+      (invoke-static () "LFoo;.a:()V")
+      (sget "LFoo;.f:I")
+      (move-result-pseudo v0)
+      (return-void)
+    )
+  )"));
+  cc.add_method(caller);
+  auto cls_foo = cc.create();
+  auto old_field = DexField::make_field("LFoo;.f:I");
+  auto new_field = DexField::make_field("LFoo;.g:I");
+
+  Scope scope{cls_baz, cls_foo};
+
+  reference_update::RewriteBatch batch;
+  batch.add_callees({{callees[0], callees[1]}});
+  batch.add_types({{baz, bar}});
+  batch.add_callees({{callees[1], callees[2]}});
+  batch.add_fields({{old_field, new_field}});
+  EXPECT_FALSE(batch.empty());
+  batch.apply(scope);
+  EXPECT_TRUE(batch.empty());
+
+  auto expected_caller_code = assembler::ircode_from_string(R"(
+    (
+      (invoke-static () "LFoo;.c:()V")
+      (sget "LFoo;.g:I")
+      (move-result-pseudo v0)
+      (return-void)
+    )
+  )");
+  EXPECT_CODE_EQ(caller->get_code(), expected_caller_code.get());
+  EXPECT_EQ(take_baz->get_proto()->get_args()->at(0), bar);
+}
@@ -11,6 +11,7 @@
 
 #include "Creators.h"
 #include "DexClass.h"
+#include "IRAssembler.h"
 #include "RedexTest.h"
 
 using namespace type_reference;
@@ -109,3 +110,43 @@ TEST_F(TypeReferenceTest, update_field_type_references) {
             type::make_array_type(
                 type::make_array_type(type::make_array_type(type::_int()))));
 }
+
+TEST_F(TypeReferenceTest, get_methods_referencing) {
+  auto make_method = [&](const char* str) {
+    auto method = assembler::method_from_string(str);
+    m_class->add_method(method);
+    return method;
+  };
+  auto const_enum_array = make_method(R"(
+    (method (public static) "Lcom/TestClass;.const_enum_array:()V"
+     (
+      (const-class "[Ljava/lang/Enum;")
+      (move-result-pseudo-object v0)
+      (return-void)
+     )
+    )
+  )");
+  auto call_with_char = make_method(R"(
+    (method (public static) "Lcom/TestClass;.call_with_char:()V"
+     (
+      (const v0 0)
+      (invoke-static (v0) "Lcom/Other;.take:(C)V")
+      (return-void)
+     )
+    )
+  )");
+  make_method(R"(
+    (method (public static) "Lcom/TestClass;.unrelated:()V"
+     (
+      (const v0 0)
+      (invoke-static (v0) "Lcom/Other;.take:(I)V")
+      (return-void)
+     )
+    )
+  )");
+
+  auto methods = get_methods_referencing(
+      m_scope, {type::java_lang_Enum(), type::_char()});
+  EXPECT_EQ(methods,
+            std::vector<DexMethod*>({call_with_char, const_enum_array}));
+}
@@ -8,8 +8,10 @@
 #include "Walkers.h"
 
 #include <gmock/gmock.h>
+#include <mutex>
 
 #include "DexUtil.h"
+#include "IRAssembler.h"
 #include "RedexTest.h"
 #include "Show.h"
 
@@ -37,3 +39,63 @@ TEST_F(WalkersTest, accumlate) {
       ::testing::UnorderedElementsAre(
           "LFoo;.bar:()V", "LFoo;.baz:()V", "LFoo;.qux:()V", "LFoo;.quux:()V"));
 }
+
+TEST_F(WalkersTest, code_by_size) {
+  ClassCreator cc(DexType::make_type("LBar;"));
+  cc.set_super(type::java_lang_Object());
+  constexpr size_t num_methods = 100;
+  for (size_t i = 0; i < num_methods; ++i) {
+    auto method =
+        DexMethod::make_method("LBar;.m" + std::to_string(i) + ":()V")
+            ->make_concrete(ACC_PUBLIC | ACC_STATIC, false);
+    std::string body = "(";
+    // Make method sizes vary widely.
+    for (size_t j = 0; j < (i % 10) * (i % 10); ++j) {
+      body += "(const v0 0)";
+    }
+    body += "(return-void))";
+    method->set_code(assembler::ircode_from_string(body));
+    cc.add_method(method);
+  }
+  Scope scope{cc.create()};
+
+  std::mutex mutex;
+  std::unordered_map<DexMethod*, size_t> visits;
+  walk::parallel::code_by_size(
+      scope,
+      [](DexMethod*) { return true; },
+      [&](DexMethod* m, IRCode&) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++visits[m];
+      },
+      /* num_threads */ 3);
+  EXPECT_EQ(num_methods, visits.size());
+  for (auto& p : visits) {
+    EXPECT_EQ(1, p.second);
+  }
+}
+
+TEST_F(WalkersTest, make_size_chunks) {
+  std::vector<walk::parallel::SizedMethod> methods;
+  // One huge method and many tiny ones.
+  methods.push_back({nullptr, 1});
+  methods.push_back({nullptr, 1000});
+  for (size_t i = 0; i < 998; ++i) {
+    methods.push_back({nullptr, 1});
+  }
+  auto chunks = walk::parallel::make_size_chunks(methods, /* num_threads */ 2);
+  // Largest first, in a chunk of its own.
+  EXPECT_EQ(1000, methods[0].cost);
+  ASSERT_FALSE(chunks.empty());
+  EXPECT_EQ(0, chunks[0].first);
+  EXPECT_EQ(1, chunks[0].second);
+  // The chunks exactly cover all methods, and tiny methods got batched.
+  size_t next = 0;
+  for (auto& chunk : chunks) {
+    EXPECT_EQ(next, chunk.first);
+    EXPECT_LT(chunk.first, chunk.second);
+    next = chunk.second;
+  }
+  EXPECT_EQ(methods.size(), next);
+  EXPECT_LT(chunks.size(), methods.size() / 10);
+}
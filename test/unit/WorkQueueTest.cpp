@@ -11,6 +11,7 @@
 #include <atomic>
 #include <chrono>
 #include <gtest/gtest.h>
+#include <numeric>
 #include <random>
 
 #include "Macros.h"
@@ -110,3 +111,46 @@ TEST(WorkQueueTest, checkDynamicallyAddingTasks) {
   // 10 + 9 + ... + 1 + 0 = 55
   EXPECT_EQ(55, result);
 }
+
+// Work queues run from within the task of another work queue cannot borrow
+// the (busy) process-wide pool and must still make progress.
+TEST(WorkQueueTest, nestedRunTest) {
+  std::vector<int> outer_items(8);
+  std::iota(outer_items.begin(), outer_items.end(), 0);
+  std::atomic<int> result{0};
+
+  workqueue_run<int>(
+      [&](int a) {
+        std::vector<int> inner_items(4, a);
+        workqueue_run<int>([&](int b) { result += b; }, inner_items);
+      },
+      outer_items);
+
+  // 4 * (0 + 1 + ... + 7) = 112
+  EXPECT_EQ(112, result);
+}
+
+TEST(WorkQueueTest, reusesDefaultThreadPool) {
+  auto* pool = redex_parallel::default_thread_pool();
+  EXPECT_EQ(pool, redex_parallel::default_thread_pool());
+  EXPECT_EQ(redex_parallel::default_num_threads(), pool->size());
+}
+
+TEST(WorkQueueTest, parallelStableSort) {
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<int> dist(0, NUM_INTS);
+  // Pairs whose second elements tell which of the equal keys came first.
+  std::vector<std::pair<int, size_t>> vec;
+  for (size_t i = 0; i < 5 * 4096 + 17; ++i) {
+    vec.emplace_back(dist(gen), i);
+  }
+  auto cmp = [](const std::pair<int, size_t>& a,
+                const std::pair<int, size_t>& b) { return a.first < b.first; };
+  auto expected = vec;
+  std::stable_sort(expected.begin(), expected.end(), cmp);
+  for (size_t num_threads : {1, 2, 3, 8}) {
+    auto sorted = vec;
+    redex_parallel::stable_sort(sorted, cmp, num_threads);
+    EXPECT_EQ(sorted, expected) << num_threads << " threads";
+  }
+}
@@ -1083,6 +1083,67 @@ TEST_F(InterproceduralConstantPropagationTest, constantFieldAfterClinit) {
   EXPECT_CODE_EQ(m->get_code(), expected_code.get());
 }
 
+TEST_F(InterproceduralConstantPropagationTest,
+       unchangedMethodsAreNotReanalyzed) {
+  auto cls_ty = DexType::make_type("LFoo;");
+  ClassCreator creator(cls_ty);
+  creator.set_super(type::java_lang_Object());
+
+  auto field_qux = DexField::make_field("LFoo;.qux:I")
+                       ->make_concrete(ACC_PUBLIC | ACC_STATIC,
+                                       new DexEncodedValueBit(DEVT_INT, 1));
+  creator.add_field(field_qux);
+
+  auto reader = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.reader:()I"
+     (
+      (sget "LFoo;.qux:I")
+      (move-result-pseudo v0)
+      (return v0)
+     )
+    )
+  )");
+  reader->rstate.set_root(); // Make this an entry point
+  creator.add_method(reader);
+
+  auto other = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.other:()I"
+     (
+      (const v0 2)
+      (return v0)
+     )
+    )
+  )");
+  other->rstate.set_root(); // Make this an entry point
+  creator.add_method(other);
+
+  Scope scope{creator.create()};
+  walk::code(scope, [](DexMethod*, IRCode& code) {
+    code.build_cfg(/* editable */ false);
+    code.cfg().calculate_exit_block();
+  });
+
+  InterproceduralConstantPropagationPass::Config config;
+  config.max_heap_analysis_iterations = 2;
+
+  auto fp_iter = InterproceduralConstantPropagationPass(config).analyze(
+      scope, &m_immut_analyzer_state);
+  auto& wps = fp_iter->get_whole_program_state();
+  EXPECT_EQ(wps.get_field_value(field_qux), SignedConstantDomain(1));
+  EXPECT_EQ(wps.get_return_value(reader), SignedConstantDomain(1));
+  EXPECT_EQ(wps.get_return_value(other), SignedConstantDomain(2));
+
+  // The summary of the method that reads nothing from the WholeProgramState
+  // is computed once; the one of the reader once per WholeProgramState.
+  auto other_summary = fp_iter->get_local_analysis_summary(other);
+  EXPECT_EQ(other_summary, fp_iter->get_local_analysis_summary(other));
+  EXPECT_EQ(other_summary->return_values,
+            std::vector<ConstantValue>{SignedConstantDomain(2)});
+  auto stats = fp_iter->get_summary_stats();
+  EXPECT_GT(stats.reused, 0);
+  EXPECT_EQ(stats.computed, 3);
+}
+
 TEST_F(InterproceduralConstantPropagationTest,
        nonConstantFieldDueToInvokeInClinit) {
   auto cls_ty = DexType::make_type("LFoo;");
@@ -760,6 +760,35 @@ TEST_F(DexTypeEnvironmentTest, SmallSetDexTypeDomainMixedHierarchyTest) {
   EXPECT_TRUE(domain_c1.is_top());
 }
 
+TEST_F(DexTypeEnvironmentTest, CompactDexTypeDomainTest) {
+  EXPECT_EQ(sizeof(SingletonDexTypeDomain), sizeof(void*));
+  EXPECT_EQ(sizeof(SmallSetDexTypeDomain), sizeof(void*));
+
+  // The same sets, built in different orders.
+  auto domain1 = SmallSetDexTypeDomain(m_type_b);
+  domain1.join_with(SmallSetDexTypeDomain(m_type_c1));
+  auto domain2 = SmallSetDexTypeDomain(m_type_c1);
+  domain2.join_with(SmallSetDexTypeDomain(m_type_b));
+  EXPECT_TRUE(domain1.equals(domain2));
+  EXPECT_TRUE(domain1.leq(domain2));
+  EXPECT_TRUE(SmallSetDexTypeDomain().leq(domain1));
+  EXPECT_FALSE(domain1.leq(SmallSetDexTypeDomain(m_type_b)));
+  EXPECT_FALSE(SmallSetDexTypeDomain().equals(SmallSetDexTypeDomain::bottom()));
+
+  auto none = SingletonDexTypeDomain::none();
+  EXPECT_TRUE(none.is_none());
+  EXPECT_FALSE(none.is_top());
+  EXPECT_FALSE(none.is_bottom());
+  EXPECT_EQ(none.get_dex_type(), boost::none);
+  none.join_with(SingletonDexTypeDomain(m_type_b));
+  EXPECT_EQ(none, SingletonDexTypeDomain(m_type_b));
+  EXPECT_EQ(*none.get_dex_type(), m_type_b);
+  none.meet_with(SingletonDexTypeDomain::top());
+  EXPECT_EQ(none, SingletonDexTypeDomain(m_type_b));
+  none.meet_with(SingletonDexTypeDomain(m_type_c1));
+  EXPECT_TRUE(none.is_bottom());
+}
+
 TEST_F(DexTypeEnvironmentTest, DexTypeDomainReduceProductTest) {
   auto domain = DexTypeDomain(type::java_lang_Object());
   domain.join_with(
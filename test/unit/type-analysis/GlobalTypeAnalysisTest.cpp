@@ -369,3 +369,63 @@ TEST_F(GlobalTypeAnalysisTest, ClinitSimpleTest) {
   auto foo_exit_env = lta->get_exit_state_at(code->cfg().exit_block());
   EXPECT_EQ(foo_exit_env.get_reg_environment().get(1), get_type_domain("LO;"));
 }
+
+TEST_F(GlobalTypeAnalysisTest, SummaryReuseTest) {
+  Scope scope;
+  prepare_scope(scope);
+
+  auto cls_a = DexType::make_type("LA;");
+  ClassCreator creator(cls_a);
+  creator.set_super(type::java_lang_Object());
+
+  auto meth_bar = assembler::method_from_string(R"(
+    (method (public static) "LA;.bar:()LO;"
+     (
+      (new-instance "LO;")
+      (move-result-pseudo-object v1)
+      (invoke-direct (v1) "LO;.<init>:()V")
+      (return-object v1)
+     )
+    )
+  )");
+  creator.add_method(meth_bar);
+
+  auto meth_foo = assembler::method_from_string(R"(
+    (method (public static) "LA;.foo:()V"
+     (
+      (invoke-static () "LA;.bar:()LO;")
+      (move-result-object v0)
+      (return-void)
+     )
+    )
+  )");
+  meth_foo->rstate.set_root();
+  creator.add_method(meth_foo);
+  scope.push_back(creator.create());
+
+  walk::code(scope, [](DexMethod*, IRCode& code) {
+    code.build_cfg(/* editable */ false);
+  });
+
+  GlobalTypeAnalysis analysis;
+  auto gta = analysis.analyze(scope);
+  auto stats = gta->get_summary_stats();
+  // The last global iteration and the collection of the last
+  // WholeProgramState find the inputs of bar unchanged.
+  EXPECT_GT(stats.reused, 0);
+
+  auto bar_summary = gta->get_local_analysis_summary(meth_bar);
+  EXPECT_EQ(gta->get_local_analysis_summary(meth_bar), bar_summary);
+  EXPECT_EQ(gta->get_summary_stats().computed, stats.computed);
+  ASSERT_EQ(bar_summary->collected_types.return_types.size(), 1);
+  EXPECT_EQ(bar_summary->collected_types.return_types[0],
+            get_type_domain("LO;"));
+
+  // foo reads the return type of bar, and passes no arguments to it.
+  auto foo_summary = gta->get_local_analysis_summary(meth_foo);
+  ASSERT_EQ(foo_summary->inputs.callees->size(), 1);
+  EXPECT_EQ(foo_summary->inputs.callees->at(0), meth_bar);
+  EXPECT_EQ(foo_summary->inputs.types[0], get_type_domain("LO;"));
+  ASSERT_EQ(foo_summary->invoke_args.size(), 1);
+  EXPECT_TRUE(foo_summary->invoke_args[0].second.is_top());
+}
@@ -0,0 +1,498 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ApkPackager.h"
+
+#include <algorithm>
+#include <atomic>
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <cstring>
+#include <ctime>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+
+namespace fs = boost::filesystem;
+
+namespace apk_packager {
+
+namespace {
+
+constexpr uint32_t kLocalHeaderSignature = 0x04034b50;
+constexpr uint32_t kCentralHeaderSignature = 0x02014b50;
+constexpr uint32_t kEndOfCentralDirSignature = 0x06054b50;
+constexpr size_t kLocalHeaderSize = 30;
+constexpr size_t kCentralHeaderSize = 46;
+constexpr size_t kEndOfCentralDirSize = 22;
+
+constexpr uint16_t kStored = 0;
+constexpr uint16_t kDeflated = 8;
+
+constexpr uint16_t kEncryptedFlag = 1 << 0;
+constexpr uint16_t kDataDescriptorFlag = 1 << 3;
+constexpr uint16_t kUtf8Flag = 1 << 11;
+
+// What Python's zipfile writes, which ZipManager used to.
+constexpr uint16_t kVersionNeeded = 20;
+constexpr uint16_t kVersionMadeBy = (3 << 8) | 20; // Unix
+
+constexpr size_t kDictionarySize = 32768;
+
+uint16_t read16(const char* p) {
+  const auto* u = reinterpret_cast<const uint8_t*>(p);
+  return u[0] | (u[1] << 8);
+}
+
+uint32_t read32(const char* p) {
+  return read16(p) | ((uint32_t)read16(p + 2) << 16);
+}
+
+void put16(std::string* out, uint16_t v) {
+  out->push_back((char)(v & 0xff));
+  out->push_back((char)(v >> 8));
+}
+
+void put32(std::string* out, uint32_t v) {
+  put16(out, v & 0xffff);
+  put16(out, v >> 16);
+}
+
+/*
+ * The central directory fields of an entry of the input archive.
+ */
+struct InputEntry {
+  uint16_t version_made_by;
+  uint16_t version_needed;
+  uint16_t flags;
+  uint16_t method;
+  uint16_t time;
+  uint16_t date;
+  uint32_t crc;
+  uint32_t compressed_size;
+  uint32_t size;
+  uint16_t internal_attr;
+  uint32_t external_attr;
+  uint32_t local_header_offset;
+};
+
+class InputArchive {
+ public:
+  explicit InputArchive(const std::string& path) : m_file(path) {
+    const char* data = m_file.data();
+    size_t size = m_file.size();
+    if (size < kEndOfCentralDirSize) {
+      throw std::runtime_error(path + " is not a zip file");
+    }
+    // The end of central directory record is followed by a comment of at
+    // most 64KiB.
+    size_t eocd = size - kEndOfCentralDirSize;
+    size_t min_eocd = eocd > 0xffff ? eocd - 0xffff : 0;
+    while (read32(data + eocd) != kEndOfCentralDirSignature) {
+      if (eocd == min_eocd) {
+        throw std::runtime_error(path + " is not a zip file");
+      }
+      --eocd;
+    }
+    uint16_t num_entries = read16(data + eocd + 10);
+    size_t pos = read32(data + eocd + 16);
+    for (uint16_t i = 0; i < num_entries; ++i) {
+      if (pos + kCentralHeaderSize > eocd ||
+          read32(data + pos) != kCentralHeaderSignature) {
+        throw std::runtime_error(path + " has a corrupt central directory");
+      }
+      const char* h = data + pos;
+      InputEntry entry;
+      entry.version_made_by = read16(h + 4);
+      entry.version_needed = read16(h + 6);
+      entry.flags = read16(h + 8);
+      entry.method = read16(h + 10);
+      entry.time = read16(h + 12);
+      entry.date = read16(h + 14);
+      entry.crc = read32(h + 16);
+      entry.compressed_size = read32(h + 20);
+      entry.size = read32(h + 24);
+      uint16_t name_size = read16(h + 28);
+      uint16_t extra_size = read16(h + 30);
+      uint16_t comment_size = read16(h + 32);
+      entry.internal_attr = read16(h + 36);
+      entry.external_attr = read32(h + 38);
+      entry.local_header_offset = read32(h + 42);
+      // As with a dict, the last entry of a name wins.
+      m_entries[std::string(h + kCentralHeaderSize, name_size)] = entry;
+      pos += kCentralHeaderSize + name_size + extra_size + comment_size;
+    }
+  }
+
+  const InputEntry* find(const std::string& name) const {
+    auto it = m_entries.find(name);
+    return it == m_entries.end() ? nullptr : &it->second;
+  }
+
+  // The compressed bytes of an entry, which follow its local header.
+  std::pair<const char*, size_t> compressed_data(
+      const InputEntry& entry) const {
+    const char* h = m_file.data() + entry.local_header_offset;
+    if (entry.local_header_offset + kLocalHeaderSize > m_file.size() ||
+        read32(h) != kLocalHeaderSignature) {
+      throw std::runtime_error("corrupt local header in input archive");
+    }
+    size_t offset = entry.local_header_offset + kLocalHeaderSize +
+                    read16(h + 26) + read16(h + 28);
+    if (offset + entry.compressed_size > m_file.size()) {
+      throw std::runtime_error("truncated entry in input archive");
+    }
+    return {m_file.data() + offset, entry.compressed_size};
+  }
+
+ private:
+  boost::iostreams::mapped_file_source m_file;
+  std::map<std::string, InputEntry> m_entries;
+};
+
+struct OutputEntry {
+  std::string name;
+  fs::path path;
+  // The input entry of the same name, if any.
+  const InputEntry* input{nullptr};
+  // Whether the compressed bytes of the input entry are copied as they are.
+  bool reuse{false};
+  uint16_t method{kDeflated};
+  uint32_t crc{0};
+  uint32_t size{0};
+  uint16_t time{0};
+  uint16_t date{0};
+  uint32_t external_attr{0};
+  std::string contents;
+  std::vector<std::string> blocks;
+};
+
+/*
+ * Lists the files the way ZipManager's os.walk does: the files of a
+ * directory in sorted order, then each of its subdirectories in sorted
+ * order. Symlinks to directories are not followed.
+ */
+void walk(const fs::path& dir,
+          const std::string& prefix,
+          std::vector<OutputEntry>* entries) {
+  std::vector<std::string> files;
+  std::vector<std::string> dirs;
+  for (const auto& it : fs::directory_iterator(dir)) {
+    auto name = it.path().filename().string();
+    if (fs::is_directory(it.symlink_status())) {
+      dirs.push_back(name);
+    } else if (fs::is_regular_file(it.status())) {
+      files.push_back(name);
+    }
+  }
+  std::sort(files.begin(), files.end());
+  std::sort(dirs.begin(), dirs.end());
+  for (const auto& name : files) {
+    OutputEntry entry;
+    entry.name = prefix + name;
+    entry.path = dir / name;
+    entries->push_back(std::move(entry));
+  }
+  for (const auto& name : dirs) {
+    walk(dir / name, prefix + name + "/", entries);
+  }
+}
+
+/*
+ * Runs fn(i) for i in [0, n) on num_threads threads, and rethrows the first
+ * exception, if any, once all of them are done.
+ */
+template <typename Fn>
+void parallel_for(size_t n, size_t num_threads, const Fn& fn) {
+  std::atomic<size_t> next{0};
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  auto worker = [&]() {
+    for (size_t i = next++; i < n; i = next++) {
+      try {
+        fn(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  for (size_t t = 1; t < std::min(num_threads, n); ++t) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void read_file(OutputEntry* entry) {
+  std::ifstream in(entry->path.string(), std::ios::binary | std::ios::ate);
+  if (!in) {
+    throw std::runtime_error("cannot open " + entry->path.string());
+  }
+  auto size = (uint64_t)in.tellg();
+  if (size > 0xffffffff) {
+    throw std::runtime_error(entry->path.string() + " needs zip64");
+  }
+  entry->contents.resize(size);
+  in.seekg(0);
+  in.read(&entry->contents[0], size);
+  if (!in) {
+    throw std::runtime_error("cannot read " + entry->path.string());
+  }
+  entry->size = size;
+  entry->crc = crc32(0, reinterpret_cast<const Bytef*>(entry->contents.data()),
+                     size);
+
+  struct stat st;
+  if (stat(entry->path.string().c_str(), &st) != 0) {
+    throw std::runtime_error("cannot stat " + entry->path.string());
+  }
+  entry->external_attr = (uint32_t)(st.st_mode & 0xffff) << 16;
+  struct tm tm;
+  localtime_r(&st.st_mtime, &tm);
+  if (tm.tm_year < 80) {
+    // DOS dates start in 1980.
+    entry->time = 0;
+    entry->date = (1 << 5) | 1;
+  } else {
+    entry->time = (tm.tm_hour << 11) | (tm.tm_min << 5) | (tm.tm_sec / 2);
+    entry->date =
+        ((tm.tm_year - 80) << 9) | ((tm.tm_mon + 1) << 5) | tm.tm_mday;
+  }
+}
+
+/*
+ * Deflates contents[begin, end) into a raw deflate stream. All blocks but the
+ * last end in a sync flush, which leaves the stream byte aligned and not
+ * final, so that the compressed blocks can simply be concatenated.
+ */
+std::string deflate_block(const std::string& contents,
+                          size_t begin,
+                          size_t end,
+                          bool last) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    throw std::runtime_error("deflateInit2 failed");
+  }
+  const auto* data = reinterpret_cast<const Bytef*>(contents.data());
+  if (begin > 0) {
+    size_t dict_begin = begin > kDictionarySize ? begin - kDictionarySize : 0;
+    deflateSetDictionary(&stream, data + dict_begin, begin - dict_begin);
+  }
+  // A sync flush needs a few bytes on top of the bound of a finished stream.
+  std::string out(deflateBound(&stream, end - begin) + 16, '\0');
+  stream.next_in = const_cast<Bytef*>(data + begin);
+  stream.avail_in = end - begin;
+  stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+  stream.avail_out = out.size();
+  int ret = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+  bool done = last ? ret == Z_STREAM_END
+                   : ret == Z_OK && stream.avail_in == 0 &&
+                         stream.avail_out > 0;
+  out.resize(stream.total_out);
+  deflateEnd(&stream);
+  if (!done) {
+    throw std::runtime_error("deflate failed");
+  }
+  return out;
+}
+
+std::string local_header(const OutputEntry& entry,
+                         uint16_t version_needed,
+                         uint16_t flags,
+                         uint32_t compressed_size) {
+  std::string header;
+  put32(&header, kLocalHeaderSignature);
+  put16(&header, version_needed);
+  put16(&header, flags);
+  put16(&header, entry.method);
+  put16(&header, entry.time);
+  put16(&header, entry.date);
+  put32(&header, entry.crc);
+  put32(&header, compressed_size);
+  put32(&header, entry.size);
+  put16(&header, entry.name.size());
+  put16(&header, 0); // extra field
+  header += entry.name;
+  return header;
+}
+
+bool is_ascii(const std::string& name) {
+  return std::all_of(name.begin(), name.end(),
+                     [](char c) { return (unsigned char)c < 0x80; });
+}
+
+} // namespace
+
+bool package(const Options& options) {
+  try {
+    InputArchive input(options.input_apk);
+
+    std::vector<OutputEntry> entries;
+    walk(options.extracted_dir, "", &entries);
+    if (entries.size() > 0xffff) {
+      std::cerr << "Too many entries without zip64" << std::endl;
+      return false;
+    }
+
+    // Read and checksum every file, which decides whether its input entry
+    // can be copied as is.
+    parallel_for(entries.size(), options.num_threads, [&](size_t i) {
+      auto& entry = entries[i];
+      read_file(&entry);
+      entry.input = input.find(entry.name);
+      if (entry.input == nullptr) {
+        return;
+      }
+      entry.method = entry.input->method == kStored ? kStored : kDeflated;
+      entry.reuse = entry.input->method == entry.method &&
+                    !(entry.input->flags & kEncryptedFlag) &&
+                    entry.input->size == entry.size &&
+                    entry.input->crc == entry.crc;
+      if (entry.reuse) {
+        entry.time = entry.input->time;
+        entry.date = entry.input->date;
+        entry.external_attr = entry.input->external_attr;
+        std::string().swap(entry.contents);
+      }
+    });
+
+    // Deflate all the blocks of all the files at once, so that one big dex
+    // does not keep a single thread busy at the end.
+    std::vector<std::pair<size_t, size_t>> jobs;
+    for (size_t i = 0; i < entries.size(); ++i) {
+      auto& entry = entries[i];
+      if (entry.reuse || entry.method != kDeflated) {
+        continue;
+      }
+      size_t num_blocks = std::max<size_t>(
+          1, (entry.size + options.block_size - 1) / options.block_size);
+      entry.blocks.resize(num_blocks);
+      for (size_t b = 0; b < num_blocks; ++b) {
+        jobs.emplace_back(i, b);
+      }
+    }
+    parallel_for(jobs.size(), options.num_threads, [&](size_t j) {
+      auto& entry = entries[jobs[j].first];
+      size_t b = jobs[j].second;
+      size_t begin = b * options.block_size;
+      size_t end = std::min<size_t>(begin + options.block_size, entry.size);
+      entry.blocks[b] = deflate_block(entry.contents, begin, end,
+                                      b + 1 == entry.blocks.size());
+    });
+
+    std::ofstream out(options.output_apk, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      std::cerr << "Unable to open '" << options.output_apk << "'"
+                << std::endl;
+      return false;
+    }
+    std::string central_dir;
+    uint64_t offset = 0;
+    for (auto& entry : entries) {
+      uint16_t version_made_by = kVersionMadeBy;
+      uint16_t version_needed = kVersionNeeded;
+      uint16_t flags = is_ascii(entry.name) ? 0 : kUtf8Flag;
+      uint16_t internal_attr = 0;
+      uint64_t compressed_size = 0;
+      if (entry.reuse) {
+        const auto& in = *entry.input;
+        version_made_by = in.version_made_by;
+        version_needed = in.version_needed;
+        // The sizes are now in the local header.
+        flags = in.flags & ~kDataDescriptorFlag;
+        internal_attr = in.internal_attr;
+        compressed_size = in.compressed_size;
+      } else if (entry.method == kStored) {
+        compressed_size = entry.size;
+      } else {
+        for (const auto& block : entry.blocks) {
+          compressed_size += block.size();
+        }
+      }
+      if (offset > 0xffffffff || compressed_size > 0xffffffff) {
+        std::cerr << "The output needs zip64" << std::endl;
+        return false;
+      }
+
+      auto header =
+          local_header(entry, version_needed, flags, compressed_size);
+      out.write(header.data(), header.size());
+      if (entry.reuse) {
+        auto data = input.compressed_data(*entry.input);
+        out.write(data.first, data.second);
+      } else if (entry.method == kStored) {
+        out.write(entry.contents.data(), entry.contents.size());
+      } else {
+        for (auto& block : entry.blocks) {
+          out.write(block.data(), block.size());
+          std::string().swap(block);
+        }
+      }
+      std::string().swap(entry.contents);
+
+      put32(&central_dir, kCentralHeaderSignature);
+      put16(&central_dir, version_made_by);
+      // From the version needed to the name size, as in the local header.
+      central_dir.append(header, 4, kLocalHeaderSize - 4 - 2);
+      put16(&central_dir, 0); // extra field
+      put16(&central_dir, 0); // comment
+      put16(&central_dir, 0); // disk number
+      put16(&central_dir, internal_attr);
+      put32(&central_dir, entry.external_attr);
+      put32(&central_dir, offset);
+      central_dir += entry.name;
+
+      offset += header.size() + compressed_size;
+    }
+
+    if (offset + central_dir.size() > 0xffffffff) {
+      std::cerr << "The output needs zip64" << std::endl;
+      return false;
+    }
+    std::string eocd;
+    put32(&eocd, kEndOfCentralDirSignature);
+    put16(&eocd, 0); // disk number
+    put16(&eocd, 0); // disk of the central directory
+    put16(&eocd, entries.size());
+    put16(&eocd, entries.size());
+    put32(&eocd, central_dir.size());
+    put32(&eocd, offset);
+    put16(&eocd, 0); // comment
+    out.write(central_dir.data(), central_dir.size());
+    out.write(eocd.data(), eocd.size());
+    out.close();
+    if (!out) {
+      std::cerr << "Unable to write '" << options.output_apk << "'"
+                << std::endl;
+      return false;
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return false;
+  }
+  return true;
+}
+
+} // namespace apk_packager
@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/*
+ * Zips an extracted APK or bundle directory back up the way pyredex's
+ * ZipManager does, but with the entries deflated in parallel:
+ *
+ *  - files are added in the same order as the sorted os.walk of ZipManager,
+ *  - each file keeps the compression method of the input entry with the same
+ *    name, and new files are deflated,
+ *  - files whose contents did not change keep the compressed bytes of the
+ *    input entry, so they are not compressed again,
+ *  - big files are split into blocks that are deflated independently, each
+ *    primed with the end of the block before it, pigz-style, and that are
+ *    concatenated into a single deflate stream.
+ *
+ * The output is a plain 32-bit zip file, which zipalign and the signers then
+ * work on as before.
+ */
+namespace apk_packager {
+
+struct Options {
+  std::string input_apk;
+  std::string extracted_dir;
+  std::string output_apk;
+  size_t num_threads{1};
+  // Files bigger than this are split into blocks of this size.
+  size_t block_size{1 << 20};
+};
+
+// Returns false, after printing why, if the output cannot be written.
+bool package(const Options& options);
+
+} // namespace apk_packager
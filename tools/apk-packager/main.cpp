@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+#include <boost/program_options.hpp>
+#include <iostream>
+#include <thread>
+
+#include "ApkPackager.h"
+
+int main(int argc, char* argv[]) {
+  namespace po = boost::program_options;
+  po::options_description desc(
+      "Zip an extracted apk or bundle directory back up\n\n"
+      "Usage: redex-apk-packager -i <input.apk> -o <output.apk> "
+      "<extracted-dir>");
+  desc.add_options()("help,h", "print this help message");
+  desc.add_options()("input-apk,i", po::value<std::string>(),
+                     "the apk the directory was extracted from");
+  desc.add_options()("output-apk,o", po::value<std::string>(),
+                     "the apk to write");
+  desc.add_options()("jobs,j", po::value<size_t>(),
+                     "number of threads (default: all cores)");
+  desc.add_options()("block-size", po::value<size_t>(),
+                     "split files bigger than this into blocks of this size, "
+                     "which are deflated in parallel (default: 1MiB)");
+  desc.add_options()("extracted-dir", po::value<std::string>(),
+                     "the extracted directory");
+  po::positional_options_description pos;
+  pos.add("extracted-dir", 1);
+
+  po::variables_map vm;
+  try {
+    po::store(po::command_line_parser(argc, argv)
+                  .options(desc)
+                  .positional(pos)
+                  .run(),
+              vm);
+    po::notify(vm);
+  } catch (const po::error& e) {
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    desc.print(std::cerr);
+    return EXIT_FAILURE;
+  }
+
+  if (vm.count("help")) {
+    desc.print(std::cout);
+    return EXIT_SUCCESS;
+  }
+  if (!vm.count("input-apk") || !vm.count("output-apk") ||
+      !vm.count("extracted-dir")) {
+    desc.print(std::cerr);
+    return EXIT_FAILURE;
+  }
+
+  apk_packager::Options options;
+  options.input_apk = vm["input-apk"].as<std::string>();
+  options.output_apk = vm["output-apk"].as<std::string>();
+  options.extracted_dir = vm["extracted-dir"].as<std::string>();
+  options.num_threads = std::max(1u, std::thread::hardware_concurrency());
+  if (vm.count("jobs")) {
+    options.num_threads = std::max<size_t>(1, vm["jobs"].as<size_t>());
+  }
+  if (vm.count("block-size")) {
+    options.block_size = std::max<size_t>(1, vm["block-size"].as<size_t>());
+  }
+
+  return apk_packager::package(options) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -14,18 +14,38 @@ int main(int argc, char* argv[]) {
   if (argc == 1 || std::string("--help") == argv[1] ||
       std::string("-h") == argv[1]) {
     // No args (or help), print usage.
-    std::cerr << "Usage: check-method-profiles PROF-FILE [PROF-FILE...]"
+    std::cerr << "Usage: check-method-profiles PROF-FILE [PROF-FILE...]\n"
+                 "       check-method-profiles --write-binary OUT-FILE "
+                 "CSV-FILE [CSV-FILE...]"
               << std::endl;
     return argc == 1 ? 1 : 0;
   }
 
+  int first_file = 1;
+  std::string binary_file;
+  if (std::string("--write-binary") == argv[1]) {
+    if (argc < 4) {
+      std::cerr << "--write-binary needs an output and input files"
+                << std::endl;
+      return 1;
+    }
+    binary_file = argv[2];
+    first_file = 3;
+  }
+
   std::vector<std::string> files;
-  for (int i = 1; i < argc; ++i) {
+  for (int i = first_file; i < argc; ++i) {
     files.push_back(argv[i]);
   }
 
   RedexContext rc;
   g_redex = &rc;
+  if (!binary_file.empty()) {
+    bool success =
+        method_profiles::MethodProfiles::write_binary_file(files, binary_file);
+    g_redex = nullptr;
+    return success ? 0 : 1;
+  }
   method_profiles::MethodProfiles m;
   m.initialize(files);
   g_redex = nullptr;
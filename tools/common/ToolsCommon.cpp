@@ -267,16 +267,17 @@ void load_classes_from_dexes_and_metadata(
     std::vector<dex_stats_t>& input_dexes_stats) {
   always_assert_log(!stores.empty(),
                     "Cannot load classes into empty DexStoresVector");
+  // Gather the dexes of all the stores first, so that they are all loaded at
+  // once.
+  std::vector<std::string> locations;
+  std::vector<size_t> location_stores;
   for (const auto& filename : dex_files) {
     if (filename.size() >= 5 &&
         filename.compare(filename.size() - 4, 4, ".dex") == 0) {
       assert_dex_magic_consistency(stores[0].get_dex_magic(),
                                    load_dex_magic_from_dex(filename.c_str()));
-      dex_stats_t dex_stats;
-      DexClasses classes = load_classes_from_dex(filename.c_str(), &dex_stats);
-      input_totals += dex_stats;
-      input_dexes_stats.push_back(dex_stats);
-      stores[0].add_classes(std::move(classes));
+      locations.push_back(filename);
+      location_stores.push_back(0);
     } else if (is_zip(filename)) {
       std::cerr << "error: Input files are expected to be DEX (with filename "
                    "ending in "
@@ -288,22 +289,24 @@ void load_classes_from_dexes_and_metadata(
     } else {
       DexMetadata store_metadata;
       store_metadata.parse(filename);
-      DexStore store(store_metadata);
+      stores.emplace_back(store_metadata);
       for (const auto& file_path : store_metadata.get_files()) {
         assert_dex_magic_consistency(
             stores[0].get_dex_magic(),
             load_dex_magic_from_dex(file_path.c_str()));
-        dex_stats_t dex_stats;
-        DexClasses classes =
-            load_classes_from_dex(file_path.c_str(), &dex_stats);
-
-        input_totals += dex_stats;
-        input_dexes_stats.push_back(dex_stats);
-        store.add_classes(std::move(classes));
+        locations.push_back(file_path);
+        location_stores.push_back(stores.size() - 1);
       }
-      stores.emplace_back(std::move(store));
     }
   }
+
+  std::vector<dex_stats_t> dexes_stats;
+  auto dexes = load_classes_from_dexes(locations, &dexes_stats);
+  for (size_t i = 0; i < locations.size(); ++i) {
+    input_totals += dexes_stats[i];
+    input_dexes_stats.push_back(dexes_stats[i]);
+    stores[location_stores[i]].add_classes(std::move(dexes[i]));
+  }
 }
 
 /**
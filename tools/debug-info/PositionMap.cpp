@@ -5,16 +5,33 @@
  * LICENSE file in the root directory of this source tree.
  */
 
-#include <boost/scope_exit.hpp>
+#include <cstring>
 #include <fcntl.h>
 #include <iostream>
 #include <memory>
 #include <string>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include "PositionMap.h"
 
+PositionMap::~PositionMap() {
+  if (m_mapping != nullptr) {
+    munmap(const_cast<uint8_t*>(m_mapping), m_mapping_size);
+  }
+}
+
+std::string_view PositionMap::string(uint32_t id) const {
+  if (id + 1 >= m_string_offsets.size()) {
+    return std::string_view();
+  }
+  // Each entry is preceded by its 4-byte size.
+  auto begin = m_string_offsets[id] + sizeof(uint32_t);
+  auto end = m_string_offsets[id + 1];
+  return std::string_view((const char*)m_mapping + begin, end - begin);
+}
+
 std::unique_ptr<PositionMap> read_map(const char* filename) {
   int fd = open(filename, O_RDONLY);
   if (fd == -1) {
@@ -26,56 +43,92 @@ std::unique_ptr<PositionMap> read_map(const char* filename) {
   if (fstat(fd, &buf)) {
     std::cerr << "Cannot fstat file (" << filename
               << ") with error: " << strerror(errno) << std::endl;
+    close(fd);
     return nullptr;
   }
-  uint8_t* mapping = (uint8_t*)mmap(
-      nullptr, buf.st_size, PROT_READ, MAP_FILE | MAP_SHARED, fd, 0);
-  uint32_t magic = *(uint32_t*)mapping;
-  mapping += sizeof(uint32_t);
+  size_t size = buf.st_size;
+  void* mapping = size == 0 ? MAP_FAILED
+                            : mmap(nullptr, size, PROT_READ,
+                                   MAP_FILE | MAP_SHARED, fd, 0);
+  close(fd);
   if (mapping == MAP_FAILED) {
     std::cerr << "mmap failed for file (" << filename
               << ") with error: " << strerror(errno) << std::endl;
     return nullptr;
   }
-  BOOST_SCOPE_EXIT_ALL(=, &buf) { munmap(mapping, buf.st_size); };
-  if (magic != 0xfaceb000) {
-    std::cerr << "Magic number mismatch\n";
+  std::unique_ptr<PositionMap> map(new PositionMap());
+  map->m_mapping = (const uint8_t*)mapping;
+  map->m_mapping_size = size;
+
+  size_t offset = 0;
+  bool truncated = false;
+  auto read_u32 = [&]() -> uint32_t {
+    if (size - offset < sizeof(uint32_t)) {
+      truncated = true;
+      return 0;
+    }
+    uint32_t value;
+    memcpy(&value, map->m_mapping + offset, sizeof(value));
+    offset += sizeof(value);
+    return value;
+  };
+  auto fail = [&](const char* msg) {
+    std::cerr << msg << " in file (" << filename << ")\n";
     return nullptr;
+  };
+
+  if (read_u32() != 0xfaceb000) {
+    return fail("Magic number mismatch");
   }
-  uint32_t version = *(uint32_t*)mapping;
-  mapping += sizeof(uint32_t);
-  if (version != 2) {
-    std::cerr << "Version mismatch\n";
-    return nullptr;
+  if (read_u32() != 2) {
+    return fail("Version mismatch");
   }
 
-  std::unique_ptr<PositionMap> map(new PositionMap());
-  std::vector<std::string> string_pool;
-  uint32_t spool_count = *(uint32_t*)mapping;
-  mapping += sizeof(uint32_t);
-  for (uint32_t i = 0; i < spool_count; ++i) {
-    uint32_t ssize = *(uint32_t*)mapping;
-    mapping += sizeof(uint32_t);
-    map->string_pool.emplace_back((const char*)mapping, ssize);
-    mapping += ssize;
+  uint32_t spool_count = read_u32();
+  map->m_string_offsets.reserve(size_t(spool_count) + 1);
+  for (uint32_t i = 0; i < spool_count && !truncated; ++i) {
+    map->m_string_offsets.push_back(offset);
+    uint32_t ssize = read_u32();
+    if (size - offset < ssize) {
+      truncated = true;
+      break;
+    }
+    offset += ssize;
+  }
+  // The end of the last entry.
+  map->m_string_offsets.push_back(offset);
+
+  uint32_t pos_count = read_u32();
+  if (truncated || (size - offset) / sizeof(PositionItem) < pos_count) {
+    return fail("Truncated line map");
   }
-  uint32_t pos_count = *(uint32_t*)mapping;
-  mapping += sizeof(uint32_t);
-  map->positions.reset(new PositionItem[pos_count]);
-  map->positions_size = pos_count;
-  memcpy(map->positions.get(), mapping, pos_count * sizeof(PositionItem));
+  map->m_positions = (const PositionItem*)(map->m_mapping + offset);
+  map->m_positions_size = pos_count;
   return map;
 }
 
 std::vector<Position> get_stack(const PositionMap& map, int64_t idx) {
   std::vector<Position> stack;
-  while (idx >= 0 && (size_t)idx < map.positions_size) {
-    auto pi = map.positions[idx];
-    stack.push_back(Position(map.string_pool[pi.class_id],
-                             map.string_pool[pi.method_id],
-                             map.string_pool[pi.file_id],
-                             pi.line));
+  // A malformed map could have cycles, but a stack is never deeper than the
+  // number of positions.
+  while (idx >= 0 && (size_t)idx < map.positions_size() &&
+         stack.size() < map.positions_size()) {
+    const auto& pi = map.position(idx);
+    stack.emplace_back(map.string(pi.class_id),
+                       map.string(pi.method_id),
+                       map.string(pi.file_id),
+                       pi.line);
     idx = (int64_t)pi.parent - 1;
   }
   return stack;
 }
+
+std::vector<std::vector<Position>> get_stacks(
+    const PositionMap& map, const std::vector<int64_t>& idxs) {
+  std::vector<std::vector<Position>> stacks;
+  stacks.reserve(idxs.size());
+  for (auto idx : idxs) {
+    stacks.push_back(get_stack(map, idx));
+  }
+  return stacks;
+}
@@ -5,8 +5,11 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#pragma once
+
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 struct __attribute__((packed)) PositionItem {
@@ -22,18 +25,47 @@ struct Position {
   std::string method;
   std::string filename;
   uint32_t line;
-  Position(const std::string& cls,
-           const std::string& method,
-           const std::string& filename,
+  Position(std::string_view cls,
+           std::string_view method,
+           std::string_view filename,
            uint32_t line)
       : cls(cls), method(method), filename(filename), line(line) {}
 };
 
-struct PositionMap {
-  std::vector<std::string> string_pool;
-  std::unique_ptr<PositionItem[]> positions;
-  size_t positions_size;
+/*
+ * A line map file, mapped read-only. The positions are used in place, and
+ * the strings are views into the mapping, found through an index of their
+ * offsets. Only the index lives on the heap, so that many maps can be kept
+ * open at little cost; the pages are shared with the page cache.
+ */
+class PositionMap {
+ public:
+  PositionMap(const PositionMap&) = delete;
+  PositionMap& operator=(const PositionMap&) = delete;
+  ~PositionMap();
+
+  size_t positions_size() const { return m_positions_size; }
+
+  const PositionItem& position(size_t idx) const { return m_positions[idx]; }
+
+  // Empty for ids past the end of the string pool.
+  std::string_view string(uint32_t id) const;
+
+ private:
+  PositionMap() = default;
+
+  const uint8_t* m_mapping{nullptr};
+  size_t m_mapping_size{0};
+  std::vector<uint32_t> m_string_offsets;
+  const PositionItem* m_positions{nullptr};
+  size_t m_positions_size{0};
+
+  friend std::unique_ptr<PositionMap> read_map(const char* filename);
 };
 
 std::unique_ptr<PositionMap> read_map(const char* filename);
 std::vector<Position> get_stack(const PositionMap& map, int64_t idx);
+// Resolves many frames at once. Negative or out of range indices give empty
+// stacks.
+std::vector<std::vector<Position>> get_stacks(const PositionMap& map,
+                                              const std::vector<int64_t>& idxs);
@@ -0,0 +1,392 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "Symbolicator.h"
+
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/regex.hpp>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace {
+
+// This needs to match the definitions in DexOutput.h!
+constexpr uint32_t IODI_LAYER_BITS = 4;
+constexpr uint32_t IODI_LAYER_SHIFT = 32 - IODI_LAYER_BITS;
+constexpr uint32_t IODI_DATA_MASK = (1u << IODI_LAYER_SHIFT) - 1;
+constexpr uint32_t IODI_LAYER_MASK = ((1u << IODI_LAYER_BITS) - 1)
+                                     << IODI_LAYER_SHIFT;
+
+const boost::regex class_regex(
+    R"/(\b[A-Za-z][0-9A-Za-z_$]*\.[0-9A-Za-z_$.]+\b)/");
+
+const boost::regex trace_regex(
+    R"/(^(.*)\s+at ([A-Za-z][0-9A-Za-z_$]*\.[0-9A-Za-z_$.]+))/"
+    R"/(\.([0-9A-Za-z_$<>]+)\(((Unknown Source)?:(\d+))?\)\s*$)/");
+
+bool read_file(const std::string& filename, std::string* contents) {
+  std::ifstream in(filename, std::ios::binary);
+  if (!in) {
+    std::cerr << "Cannot open file (" << filename << ")\n";
+    return false;
+  }
+  contents->assign(std::istreambuf_iterator<char>(in),
+                   std::istreambuf_iterator<char>());
+  return true;
+}
+
+// Reads little-endian values from an in-memory file.
+class Reader {
+ public:
+  explicit Reader(const std::string& data) : m_data(data) {}
+
+  template <typename T>
+  T read() {
+    T value{0};
+    if (m_data.size() - m_offset < sizeof(T)) {
+      m_truncated = true;
+      return value;
+    }
+    memcpy(&value, m_data.data() + m_offset, sizeof(T));
+    m_offset += sizeof(T);
+    return value;
+  }
+
+  std::string read_string(size_t size) {
+    if (m_data.size() - m_offset < size) {
+      m_truncated = true;
+      return std::string();
+    }
+    m_offset += size;
+    return m_data.substr(m_offset - size, size);
+  }
+
+  bool truncated() const { return m_truncated; }
+
+ private:
+  const std::string& m_data;
+  size_t m_offset{0};
+  bool m_truncated{false};
+};
+
+// The ProGuard-style map of the classes and methods that Redex renamed.
+bool read_class_map(const std::string& filename,
+                    std::unordered_map<std::string, ClassMapping>* class_map) {
+  std::ifstream in(filename);
+  if (!in) {
+    std::cerr << "Cannot open file (" << filename << ")\n";
+    return false;
+  }
+  ClassMapping* current_class = nullptr;
+  for (std::string line; std::getline(in, line);) {
+    auto arrow = line.find(" -> ");
+    if (arrow == std::string::npos) {
+      continue;
+    }
+    auto original = line.substr(0, arrow);
+    auto renamed = line.substr(arrow + 4);
+    boost::algorithm::trim(renamed);
+    if (line[0] != ' ') {
+      // "original -> renamed:"
+      if (!renamed.empty() && renamed.back() == ':') {
+        renamed.pop_back();
+      }
+      current_class = &(*class_map)[renamed];
+      current_class->origin_class = original;
+      continue;
+    }
+    boost::algorithm::trim(original);
+    // Only methods, i.e. "type name(args)", matter for frames.
+    if (current_class == nullptr || original.empty() ||
+        original.back() != ')') {
+      continue;
+    }
+    auto paren = original.find('(');
+    auto space = original.rfind(' ', paren);
+    auto begin = space == std::string::npos ? 0 : space + 1;
+    current_class->methods[renamed] = original.substr(begin, paren - begin);
+  }
+  return true;
+}
+
+bool read_debug_line_map(
+    const std::string& filename,
+    std::unordered_map<uint64_t, std::vector<OffsetLine>>* debug_line_map) {
+  std::string data;
+  if (!read_file(filename, &data)) {
+    return false;
+  }
+  Reader reader(data);
+  if (reader.read<uint32_t>() != 0xfaceb000) {
+    std::cerr << "Magic number mismatch in file (" << filename << ")\n";
+    return false;
+  }
+  if (reader.read<uint32_t>() != 1) {
+    std::cerr << "Version mismatch in file (" << filename << ")\n";
+    return false;
+  }
+  auto method_count = reader.read<uint32_t>();
+  std::vector<std::pair<uint64_t, uint32_t>> method_datas;
+  for (uint32_t i = 0; i < method_count && !reader.truncated(); ++i) {
+    auto method_id = reader.read<uint64_t>();
+    reader.read<uint32_t>(); // offset
+    auto size = reader.read<uint32_t>();
+    method_datas.emplace_back(method_id, size);
+  }
+  for (const auto& [method_id, size] : method_datas) {
+    if (reader.read<uint64_t>() != method_id) {
+      std::cerr << "Method id mismatch in file (" << filename << ")\n";
+      return false;
+    }
+    std::vector<OffsetLine> line_mappings;
+    for (uint32_t i = 0; i < (size - 8) / 8 && !reader.truncated(); ++i) {
+      auto offset = reader.read<uint32_t>();
+      auto line = reader.read<uint32_t>();
+      line_mappings.push_back({offset, line});
+    }
+    if (!line_mappings.empty()) {
+      (*debug_line_map)[method_id] = std::move(line_mappings);
+    }
+  }
+  if (reader.truncated()) {
+    std::cerr << "Truncated file (" << filename << ")\n";
+    return false;
+  }
+  return true;
+}
+
+bool read_iodi_metadata(
+    const std::string& filename,
+    std::unordered_map<std::string, uint64_t>* iodi_metadata) {
+  std::string data;
+  if (!read_file(filename, &data)) {
+    return false;
+  }
+  Reader reader(data);
+  if (reader.read<uint32_t>() != 0xfaceb001) {
+    std::cerr << "Magic number mismatch in file (" << filename << ")\n";
+    return false;
+  }
+  if (reader.read<uint32_t>() != 1) {
+    std::cerr << "Version mismatch in file (" << filename << ")\n";
+    return false;
+  }
+  auto count = reader.read<uint32_t>();
+  reader.read<uint32_t>(); // zero
+  for (uint32_t i = 0; i < count && !reader.truncated(); ++i) {
+    auto size = reader.read<uint16_t>();
+    auto method_id = reader.read<uint64_t>();
+    (*iodi_metadata)[reader.read_string(size)] = method_id;
+  }
+  if (reader.truncated()) {
+    std::cerr << "Truncated file (" << filename << ")\n";
+    return false;
+  }
+  return true;
+}
+
+std::string full_method(const Position& pos) {
+  return pos.cls + "." + pos.method;
+}
+
+} // namespace
+
+std::unique_ptr<SymbolMaps> SymbolMaps::from_artifact_dir(
+    const std::string& dir) {
+  namespace fs = boost::filesystem;
+  auto path = [&dir](const char* name) {
+    return (fs::path(dir) / name).string();
+  };
+
+  auto maps = std::make_unique<SymbolMaps>();
+  if (!read_class_map(path("redex-class-rename-map.txt"), &maps->class_map)) {
+    return nullptr;
+  }
+  // Only the v2 format of the line map knows the methods of the positions.
+  maps->line_map = read_map(path("redex-line-number-map-v2").c_str());
+  if (maps->line_map == nullptr) {
+    return nullptr;
+  }
+  auto iodi_metadata = path("iodi-metadata");
+  if (fs::exists(iodi_metadata)) {
+    if (!read_iodi_metadata(iodi_metadata, &maps->iodi_metadata) ||
+        !read_debug_line_map(path("redex-debug-line-map-v2"),
+                             &maps->debug_line_map)) {
+      std::cerr << "In order to symbolicate with IODI, "
+                   "redex-debug-line-map-v2 is required!\n";
+      return nullptr;
+    }
+  }
+  return maps;
+}
+
+std::string Symbolicator::deobfuscate_classes(const std::string& line) const {
+  auto replace = [this](const boost::smatch& m) {
+    auto it = m_maps.class_map.find(m.str());
+    return it == m_maps.class_map.end() ? m.str() : it->second.origin_class;
+  };
+  return boost::regex_replace(line, class_regex, replace);
+}
+
+boost::optional<uint32_t> Symbolicator::find_line_number(uint64_t method_id,
+                                                         uint32_t line) const {
+  auto it = m_maps.debug_line_map.find(method_id);
+  if (it == m_maps.debug_line_map.end()) {
+    return boost::none;
+  }
+  boost::optional<uint32_t> result;
+  for (const auto& mapping : it->second) {
+    if (mapping.offset <= line) {
+      result = mapping.line;
+    } else {
+      if (!result) {
+        // Better to give a rough line number than fail epicly
+        result = mapping.line;
+      }
+      break;
+    }
+  }
+  return result;
+}
+
+boost::optional<uint32_t> Symbolicator::map_iodi(const std::string& cls,
+                                                 const std::string& method,
+                                                 uint32_t lineno) const {
+  auto qualified_name = cls + "." + method;
+  auto layer = (lineno & IODI_LAYER_MASK) >> IODI_LAYER_SHIFT;
+  auto adjusted_lineno = lineno;
+  if (layer > 0) {
+    qualified_name += "@" + std::to_string(layer);
+    adjusted_lineno = lineno & IODI_DATA_MASK;
+  }
+  boost::optional<uint32_t> res_lineno;
+  if (lineno != adjusted_lineno) {
+    res_lineno = adjusted_lineno;
+  }
+  auto it = m_maps.iodi_metadata.find(qualified_name);
+  if (it != m_maps.iodi_metadata.end()) {
+    auto mapped = find_line_number(it->second, adjusted_lineno);
+    if (mapped) {
+      return mapped;
+    }
+  }
+  return res_lineno;
+}
+
+boost::optional<std::vector<Position>> Symbolicator::find_case_positions(
+    uint32_t start, uint32_t pattern_id) const {
+  const auto& line_map = *m_maps.line_map;
+  auto count_positions = get_stack(line_map, start);
+  if (count_positions.size() != 1 ||
+      full_method(count_positions[0]) != "redex.$Position.count") {
+    return boost::none;
+  }
+  // The cases are stored in the immediately following lines,
+  // and are ordered by pattern-id, so we can do a binary search.
+  int64_t end = int64_t(start) + count_positions[0].line;
+  int64_t begin = int64_t(start) + 1;
+  while (begin <= end) {
+    auto middle = (begin + end) / 2;
+    auto case_positions = get_stack(line_map, middle);
+    if (case_positions.empty() ||
+        full_method(case_positions[0]) != "redex.$Position.case") {
+      return boost::none;
+    }
+    if (case_positions[0].line == pattern_id) {
+      case_positions.erase(case_positions.begin());
+      return case_positions;
+    } else if (case_positions[0].line < pattern_id) {
+      begin = middle + 1;
+    } else {
+      end = middle - 1;
+    }
+  }
+  return boost::none;
+}
+
+void Symbolicator::symbolicate(const std::string& line,
+                               SymbolicatorState* state,
+                               std::string* out) const {
+  auto deobfuscated = deobfuscate_classes(line);
+  boost::smatch m;
+  if (!boost::regex_match(deobfuscated, m, trace_regex)) {
+    state->pending_switches.clear();
+    out->append(deobfuscated).push_back('\n');
+    return;
+  }
+  auto prefix = m.str(1);
+  auto cls = m.str(2);
+  auto method = m.str(3);
+
+  if (!m[6].matched) {
+    // If there's no debug info item, stack traces have no line number e.g.
+    //   at X.OPu.A04()
+    // Just deobfuscate the class/method name
+    auto it = m_maps.class_map.find(cls);
+    if (it == m_maps.class_map.end()) {
+      out->append(deobfuscated).push_back('\n');
+      return;
+    }
+    auto method_it = it->second.methods.find(method);
+    out->append(prefix)
+        .append("\tat ")
+        .append(it->second.origin_class)
+        .append(".")
+        .append(method_it == it->second.methods.end() ? method
+                                                      : method_it->second)
+        .append("()\n");
+    return;
+  }
+
+  uint32_t lineno = std::strtoul(m.str(6).c_str(), nullptr, 10);
+  if (!m_maps.iodi_metadata.empty()) {
+    auto mapped_lineno = map_iodi(cls, method, lineno);
+    if (mapped_lineno) {
+      lineno = *mapped_lineno;
+    }
+  }
+  auto positions = get_stack(*m_maps.line_map, int64_t(lineno) - 1);
+  for (size_t i = 0; i < positions.size(); ++i) {
+    const auto& pos = positions[i];
+    if (full_method(pos) == "redex.$Position.switch") {
+      state->pending_switches.push_back(pos.line);
+      continue;
+    }
+    if (full_method(pos) == "redex.$Position.pattern") {
+      auto pattern_id = pos.line;
+      if (!state->pending_switches.empty()) {
+        auto switch_line = state->pending_switches.back();
+        state->pending_switches.pop_back();
+        auto case_positions = find_case_positions(switch_line, pattern_id);
+        if (case_positions) {
+          case_positions->insert(case_positions->end(),
+                                 positions.begin() + i + 1,
+                                 positions.end());
+          positions = std::move(*case_positions);
+          i = size_t(-1);
+          continue;
+        }
+      }
+      out->append(prefix)
+          .append("\t$(unresolved switch ")
+          .append(std::to_string(pattern_id))
+          .append(")\n");
+      continue;
+    }
+    out->append(prefix)
+        .append("\tat ")
+        .append(full_method(pos))
+        .append("(")
+        .append(pos.filename)
+        .append(":")
+        .append(std::to_string(pos.line))
+        .append(")\n");
+  }
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <boost/optional.hpp>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "PositionMap.h"
+
+/*
+ * Native version of the logcat symbolicator in tools/python/symbolicator:
+ * deobfuscates class names and expands "at cls.method(:line)" frames with
+ * the line map, the IODI metadata and the debug line map of a build.
+ */
+
+struct ClassMapping {
+  std::string origin_class;
+  // Obfuscated to original method names.
+  std::unordered_map<std::string, std::string> methods;
+};
+
+struct OffsetLine {
+  uint32_t offset;
+  uint32_t line;
+};
+
+struct SymbolMaps {
+  // Keyed by the obfuscated name.
+  std::unordered_map<std::string, ClassMapping> class_map;
+  std::unique_ptr<PositionMap> line_map;
+  // Only used with IODI, keyed by method id.
+  std::unordered_map<uint64_t, std::vector<OffsetLine>> debug_line_map;
+  // Empty when the build does not use IODI.
+  std::unordered_map<std::string, uint64_t> iodi_metadata;
+
+  // Reads the symbol files of the given build artifacts directory. Returns
+  // nullptr, after printing why, if a file cannot be read.
+  static std::unique_ptr<SymbolMaps> from_artifact_dir(const std::string& dir);
+};
+
+// What a frame leaves for the frames below it in the same trace.
+struct SymbolicatorState {
+  // The line map indices of the switches whose pattern is still to be seen.
+  std::vector<uint32_t> pending_switches;
+};
+
+/*
+ * Stateless apart from the SymbolicatorState, so that one instance can serve
+ * several threads, each with its own state.
+ */
+class Symbolicator {
+ public:
+  explicit Symbolicator(const SymbolMaps& maps) : m_maps(maps) {}
+
+  // Appends the symbolicated lines, each with a newline, to out. A frame may
+  // expand to several lines, or to none. Lines that are not frames clear the
+  // state, as they end the trace.
+  void symbolicate(const std::string& line,
+                   SymbolicatorState* state,
+                   std::string* out) const;
+
+ private:
+  std::string deobfuscate_classes(const std::string& line) const;
+
+  boost::optional<uint32_t> map_iodi(const std::string& cls,
+                                     const std::string& method,
+                                     uint32_t lineno) const;
+
+  boost::optional<uint32_t> find_line_number(uint64_t method_id,
+                                             uint32_t line) const;
+
+  boost::optional<std::vector<Position>> find_case_positions(
+      uint32_t start, uint32_t pattern_id) const;
+
+  const SymbolMaps& m_maps;
+};
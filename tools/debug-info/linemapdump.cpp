@@ -15,10 +15,13 @@ int main(int argc, char** argv) {
     abort();
   }
   auto map = read_map(argv[1]);
-  for (size_t i = 0; i < map->positions_size; ++i) {
-    auto pi = map->positions[i];
-    std::cout << map->string_pool[pi.class_id] << "."
-              << map->string_pool[pi.method_id] << map->string_pool[pi.file_id]
-              << ":" << pi.line << " => " << pi.parent << std::endl;
+  if (map == nullptr) {
+    return 1;
+  }
+  for (size_t i = 0; i < map->positions_size(); ++i) {
+    const auto& pi = map->position(i);
+    std::cout << map->string(pi.class_id) << "." << map->string(pi.method_id)
+              << map->string(pi.file_id) << ":" << pi.line << " => "
+              << pi.parent << std::endl;
   }
 }
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Symbolicator.h"
+
+namespace {
+
+constexpr size_t kLinesPerChunk = 4096;
+
+// Frames need "at ", so other lines end a trace, and clear the state of the
+// symbolicator. Chunks that start at them give the same output as one pass.
+bool can_start_chunk(const std::string& line) {
+  return line.find("at ") == std::string::npos;
+}
+
+void symbolicate_chunk(const Symbolicator& symbolicator,
+                       const std::vector<std::string>& lines,
+                       size_t begin,
+                       size_t end,
+                       std::string* out) {
+  SymbolicatorState state;
+  for (size_t i = begin; i < end; ++i) {
+    symbolicator.symbolicate(lines[i], &state, out);
+  }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+  const char* artifacts = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      num_threads = std::max(1, atoi(argv[++i]));
+    } else {
+      artifacts = argv[i];
+    }
+  }
+  if (artifacts == nullptr) {
+    std::cerr << "Usage: cat traces | symbolicate-batch [-j threads] "
+                 "artifacts_dir\n";
+    abort();
+  }
+  auto maps = SymbolMaps::from_artifact_dir(artifacts);
+  if (maps == nullptr) {
+    return 1;
+  }
+  Symbolicator symbolicator(*maps);
+  std::ios::sync_with_stdio(false);
+
+  std::vector<std::string> lines;
+  std::vector<std::string> outputs(num_threads);
+  // The first line of the next round.
+  boost::optional<std::string> next_line;
+  bool eof = false;
+  while (!eof || next_line) {
+    lines.clear();
+    if (next_line) {
+      lines.push_back(std::move(*next_line));
+      next_line = boost::none;
+    }
+    // Up to one chunk per thread.
+    std::vector<size_t> chunk_begins{0};
+    for (std::string line; !eof;) {
+      if (!std::getline(std::cin, line)) {
+        eof = true;
+        break;
+      }
+      if (lines.size() >= chunk_begins.back() + kLinesPerChunk &&
+          can_start_chunk(line)) {
+        if (chunk_begins.size() == num_threads) {
+          next_line = std::move(line);
+          break;
+        }
+        chunk_begins.push_back(lines.size());
+      }
+      lines.push_back(std::move(line));
+    }
+    chunk_begins.push_back(lines.size());
+
+    std::vector<std::thread> threads;
+    for (size_t c = 0; c + 1 < chunk_begins.size(); ++c) {
+      outputs[c].clear();
+      threads.emplace_back(symbolicate_chunk, std::cref(symbolicator),
+                           std::cref(lines), chunk_begins[c],
+                           chunk_begins[c + 1], &outputs[c]);
+    }
+    for (size_t c = 0; c < threads.size(); ++c) {
+      threads[c].join();
+      std::cout << outputs[c];
+    }
+  }
+}
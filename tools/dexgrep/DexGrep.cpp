@@ -5,28 +5,169 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <atomic>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
 #include <getopt.h>
 #include <regex>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 
 #include "DexCommon.h"
 
+namespace {
+
+// "DGI1": the class names of a dex, each followed by a '\0'.
+constexpr uint32_t kIndexMagic = 0x31494744;
+
 void print_usage() {
-  fprintf(stderr, "Usage: dexgrep <classname> <dexfile 1> <dexfile 2> ...\n");
+  fprintf(stderr,
+          "Usage: dexgrep [-l] [-j threads] [-i index_dir] <classname> "
+          "<dexfile 1> <dexfile 2> ...\n");
+}
+
+// Dex files are keyed by their signature and checksum, so renamed or copied
+// files share their index.
+std::string index_path(const std::string& index_dir, const dex_header* dexh) {
+  std::string key;
+  char hex[9];
+  for (auto byte : dexh->signature) {
+    snprintf(hex, sizeof(hex), "%02x", byte);
+    key += hex;
+  }
+  snprintf(hex, sizeof(hex), "%08x", dexh->checksum);
+  return index_dir + "/" + key + "_" + hex + ".dgi";
+}
+
+// Only reads the header, to find the index without mapping the whole dex.
+bool read_header(const char* dexfile, dex_header* dexh) {
+  int fd = open(dexfile, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  bool ok = read(fd, dexh, sizeof(*dexh)) == sizeof(*dexh);
+  close(fd);
+  return ok;
+}
+
+std::vector<std::string> read_class_names(const char* dexfile) {
+  ddump_data rd;
+  open_dex_file(dexfile, &rd);
+  std::vector<std::string> names;
+  auto size = rd.dexh->class_defs_size;
+  names.reserve(size);
+  for (uint32_t j = 0; j < size; j++) {
+    dex_class_def* cls_def = rd.dex_class_defs + j;
+    names.emplace_back(dex_string_by_type_idx(&rd, cls_def->typeidx));
+  }
+  munmap(rd.dexmmap, rd.dex_size);
+  return names;
 }
 
+void write_index(const std::string& path,
+                 const std::vector<std::string>& names) {
+  // Write to a temporary file first, so that concurrent runs never see a
+  // partial index.
+  auto tmp_path = path + "." + std::to_string(getpid()) + ".tmp";
+  FILE* out = fopen(tmp_path.c_str(), "w");
+  if (out == nullptr) {
+    return;
+  }
+  uint32_t header[2] = {kIndexMagic, (uint32_t)names.size()};
+  bool ok = fwrite(header, sizeof(header), 1, out) == 1;
+  for (const auto& name : names) {
+    ok = ok && fwrite(name.c_str(), name.size() + 1, 1, out) == 1;
+  }
+  ok = fclose(out) == 0 && ok;
+  if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+    unlink(tmp_path.c_str());
+  }
+}
+
+// Returns false if there is no usable index at the path.
+bool read_index(const std::string& path, std::vector<std::string>* names) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat stat;
+  if (fstat(fd, &stat) != 0 || (size_t)stat.st_size < 2 * sizeof(uint32_t)) {
+    close(fd);
+    return false;
+  }
+  size_t size = stat.st_size;
+  void* mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return false;
+  }
+  auto data = (const char*)mapping;
+  uint32_t header[2];
+  memcpy(header, data, sizeof(header));
+  bool ok = header[0] == kIndexMagic;
+  const char* end = data + size;
+  const char* name = data + sizeof(header);
+  for (uint32_t i = 0; ok && i < header[1]; ++i) {
+    auto nul = (const char*)memchr(name, '\0', end - name);
+    if (nul == nullptr) {
+      ok = false;
+      break;
+    }
+    names->emplace_back(name, nul);
+    name = nul + 1;
+  }
+  munmap(mapping, size);
+  if (!ok) {
+    names->clear();
+  }
+  return ok;
+}
+
+std::vector<std::string> get_class_names(const char* dexfile,
+                                         const char* index_dir) {
+  std::vector<std::string> names;
+  dex_header dexh;
+  if (index_dir == nullptr || !read_header(dexfile, &dexh)) {
+    return read_class_names(dexfile);
+  }
+  auto path = index_path(index_dir, &dexh);
+  if (!read_index(path, &names)) {
+    names = read_class_names(dexfile);
+    write_index(path, names);
+  }
+  return names;
+}
+
+} // namespace
+
 int main(int argc, char* argv[]) {
   bool files_only = false;
-  char c;
+  unsigned num_threads = std::max(1u, std::thread::hardware_concurrency());
+  const char* index_dir = nullptr;
+  int c;
   static const struct option options[] = {
       {"files-without-match", no_argument, nullptr, 'l'},
+      {"jobs", required_argument, nullptr, 'j'},
+      {"index-dir", required_argument, nullptr, 'i'},
+      {nullptr, 0, nullptr, 0},
   };
-  while ((c = getopt_long(argc, argv, "hl", &options[0], nullptr)) != -1) {
+  while ((c = getopt_long(argc, argv, "hlj:i:", &options[0], nullptr)) != -1) {
     switch (c) {
     case 'l':
       files_only = true;
       break;
+    case 'j':
+      num_threads = std::max(1, atoi(optarg));
+      break;
+    case 'i':
+      index_dir = optarg;
+      break;
     case 'h':
       print_usage();
       return 0;
@@ -45,22 +186,35 @@ int main(int argc, char* argv[]) {
   const char* search_str = argv[optind];
   std::regex re(search_str);
 
-  for (int i = optind + 1; i < argc; ++i) {
-    const char* dexfile = argv[i];
-    ddump_data rd;
-    open_dex_file(dexfile, &rd);
-
-    auto size = rd.dexh->class_defs_size;
-    for (uint32_t j = 0; j < size; j++) {
-      dex_class_def* cls_def = rd.dex_class_defs + j;
-      char* name = dex_string_by_type_idx(&rd, cls_def->typeidx);
-      if (std::regex_search(name, re)) {
-        if (files_only) {
-          printf("%s\n", dexfile);
-        } else {
-          printf("%s: %s\n", dexfile, name);
+  // Each dex is searched by whichever thread gets to it first, and the
+  // results are printed in the order of the arguments.
+  std::vector<const char*> dexfiles(argv + optind + 1, argv + argc);
+  std::vector<std::string> results(dexfiles.size());
+  std::atomic<size_t> next_dex{0};
+  auto search = [&]() {
+    for (size_t i; (i = next_dex++) < dexfiles.size();) {
+      const char* dexfile = dexfiles[i];
+      for (const auto& name : get_class_names(dexfile, index_dir)) {
+        if (std::regex_search(name, re)) {
+          if (files_only) {
+            results[i].append(dexfile).append("\n");
+          } else {
+            results[i].append(dexfile).append(": ").append(name).append("\n");
+          }
         }
       }
     }
+  };
+  std::vector<std::thread> threads;
+  for (unsigned t = 1; t < std::min<size_t>(num_threads, dexfiles.size());
+       ++t) {
+    threads.emplace_back(search);
+  }
+  search();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (const auto& result : results) {
+    fputs(result.c_str(), stdout);
   }
 }
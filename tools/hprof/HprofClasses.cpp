@@ -0,0 +1,472 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "HprofClasses.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+namespace hprof {
+
+namespace {
+
+// Top-level record tags.
+constexpr uint8_t kString = 0x01;
+constexpr uint8_t kLoadClass = 0x02;
+constexpr uint8_t kHeapDump = 0x0C;
+constexpr uint8_t kHeapDumpSegment = 0x1C;
+constexpr uint8_t kHeapDumpEnd = 0x2C;
+
+// Heap dump sub-record tags, standard ones first, then Android's.
+constexpr uint8_t kRootUnknown = 0xFF;
+constexpr uint8_t kRootJniGlobal = 0x01;
+constexpr uint8_t kRootJniLocal = 0x02;
+constexpr uint8_t kRootJavaFrame = 0x03;
+constexpr uint8_t kRootNativeStack = 0x04;
+constexpr uint8_t kRootStickyClass = 0x05;
+constexpr uint8_t kRootThreadBlock = 0x06;
+constexpr uint8_t kRootMonitorUsed = 0x07;
+constexpr uint8_t kRootThreadObject = 0x08;
+constexpr uint8_t kClassDump = 0x20;
+constexpr uint8_t kInstanceDump = 0x21;
+constexpr uint8_t kObjectArrayDump = 0x22;
+constexpr uint8_t kPrimitiveArrayDump = 0x23;
+constexpr uint8_t kHeapDumpInfo = 0xFE;
+constexpr uint8_t kRootInternedString = 0x89;
+constexpr uint8_t kRootFinalizing = 0x8A;
+constexpr uint8_t kRootDebugger = 0x8B;
+constexpr uint8_t kRootReferenceCleanup = 0x8C;
+constexpr uint8_t kRootVmInternal = 0x8D;
+constexpr uint8_t kRootJniMonitor = 0x8E;
+constexpr uint8_t kUnreachable = 0x90;
+constexpr uint8_t kPrimitiveArrayNoDataDump = 0xC3;
+
+// Basic types, indexed by their tag.
+constexpr uint8_t kObject = 2;
+constexpr uint8_t kNumBasicTypes = 12;
+constexpr std::array<uint8_t, kNumBasicTypes> kBasicSizes = {
+    0, 0, 0 /* id */, 0, 1, 2, 4, 8, 1, 2, 4, 8};
+constexpr std::array<const char*, kNumBasicTypes> kArrayNames = {
+    nullptr,  nullptr,   nullptr,  nullptr,   "boolean[]", "char[]",
+    "float[]", "double[]", "byte[]", "short[]", "int[]",     "long[]"};
+
+/*
+ * Reads big-endian values off a record, throwing instead of running past its
+ * end.
+ */
+class Reader {
+ public:
+  Reader(const char* begin, const char* end, size_t id_size)
+      : m_pos(reinterpret_cast<const uint8_t*>(begin)),
+        m_end(reinterpret_cast<const uint8_t*>(end)),
+        m_id_size(id_size) {}
+
+  bool done() const { return m_pos == m_end; }
+  const char* pos() const { return reinterpret_cast<const char*>(m_pos); }
+  size_t remaining() const { return m_end - m_pos; }
+
+  uint8_t u1() {
+    check(1);
+    return *m_pos++;
+  }
+
+  uint16_t u2() {
+    check(2);
+    uint16_t v = (m_pos[0] << 8) | m_pos[1];
+    m_pos += 2;
+    return v;
+  }
+
+  uint32_t u4() {
+    check(4);
+    uint32_t v = ((uint32_t)m_pos[0] << 24) | ((uint32_t)m_pos[1] << 16) |
+                 ((uint32_t)m_pos[2] << 8) | m_pos[3];
+    m_pos += 4;
+    return v;
+  }
+
+  uint64_t id() {
+    if (m_id_size == 4) {
+      return u4();
+    }
+    uint64_t high = u4();
+    return (high << 32) | u4();
+  }
+
+  void skip(uint64_t n) {
+    check(n);
+    m_pos += n;
+  }
+
+  // The size of a value of the given basic type.
+  size_t basic_size(uint8_t type) const {
+    if (type == kObject) {
+      return m_id_size;
+    }
+    if (type >= kNumBasicTypes || kBasicSizes[type] == 0) {
+      throw std::runtime_error("unknown basic type " + std::to_string(type));
+    }
+    return kBasicSizes[type];
+  }
+
+ private:
+  void check(uint64_t n) const {
+    if (n > remaining()) {
+      throw std::runtime_error("truncated record");
+    }
+  }
+
+  const uint8_t* m_pos;
+  const uint8_t* m_end;
+  size_t m_id_size;
+};
+
+struct LoadClass {
+  uint32_t serial;
+  uint64_t name_id;
+};
+
+struct Counts {
+  uint64_t count{0};
+  uint64_t bytes{0};
+
+  void add(uint64_t n, uint64_t size) {
+    count += n;
+    bytes += size;
+  }
+};
+
+/*
+ * What a heap dump segment holds, as far as classes are concerned. Instances
+ * are only counted, as the size of their class may come from another
+ * segment.
+ */
+struct Segment {
+  std::string_view data;
+  std::vector<std::pair<uint64_t, uint32_t>> class_sizes;
+  std::unordered_map<uint64_t, uint64_t> instances;
+  std::unordered_map<uint64_t, Counts> object_arrays;
+  std::array<Counts, kNumBasicTypes> primitive_arrays;
+};
+
+void parse_class_dump(Reader& r, Segment* segment) {
+  auto class_id = r.id();
+  r.u4(); // stack serial
+  r.id(); // super class
+  r.id(); // class loader
+  r.id(); // signers
+  r.id(); // protection domain
+  r.id(); // reserved
+  r.id(); // reserved
+  auto instance_size = r.u4();
+  auto const_pool_count = r.u2();
+  for (uint16_t i = 0; i < const_pool_count; ++i) {
+    r.u2();
+    r.skip(r.basic_size(r.u1()));
+  }
+  auto static_field_count = r.u2();
+  for (uint16_t i = 0; i < static_field_count; ++i) {
+    r.id();
+    r.skip(r.basic_size(r.u1()));
+  }
+  auto instance_field_count = r.u2();
+  for (uint16_t i = 0; i < instance_field_count; ++i) {
+    r.id();
+    r.basic_size(r.u1());
+  }
+  segment->class_sizes.emplace_back(class_id, instance_size);
+}
+
+void parse_segment(size_t id_size, Segment* segment) {
+  Reader r(segment->data.data(), segment->data.data() + segment->data.size(),
+           id_size);
+  while (!r.done()) {
+    auto tag = r.u1();
+    switch (tag) {
+    case kRootUnknown:
+    case kRootStickyClass:
+    case kRootMonitorUsed:
+    case kRootInternedString:
+    case kRootFinalizing:
+    case kRootDebugger:
+    case kRootReferenceCleanup:
+    case kRootVmInternal:
+    case kUnreachable:
+      r.skip(id_size);
+      break;
+    case kRootJniGlobal:
+      r.skip(2 * id_size);
+      break;
+    case kRootJniLocal:
+    case kRootJavaFrame:
+    case kRootJniMonitor:
+    case kRootThreadObject:
+      r.skip(id_size + 8);
+      break;
+    case kRootNativeStack:
+    case kRootThreadBlock:
+      r.skip(id_size + 4);
+      break;
+    case kHeapDumpInfo:
+      r.skip(4 + id_size);
+      break;
+    case kClassDump:
+      parse_class_dump(r, segment);
+      break;
+    case kInstanceDump: {
+      r.id();
+      r.u4();
+      auto class_id = r.id();
+      r.skip(r.u4());
+      ++segment->instances[class_id];
+      break;
+    }
+    case kObjectArrayDump: {
+      r.id();
+      r.u4();
+      uint64_t length = r.u4();
+      auto class_id = r.id();
+      r.skip(length * id_size);
+      segment->object_arrays[class_id].add(1, (2 + length) * id_size);
+      break;
+    }
+    case kPrimitiveArrayDump:
+    case kPrimitiveArrayNoDataDump: {
+      r.id();
+      r.u4();
+      uint64_t length = r.u4();
+      auto type = r.u1();
+      if (type == kObject) {
+        throw std::runtime_error("primitive array of objects");
+      }
+      auto element_size = r.basic_size(type);
+      if (tag == kPrimitiveArrayDump) {
+        r.skip(length * element_size);
+      }
+      segment->primitive_arrays[type].add(1,
+                                          2 * id_size + length * element_size);
+      break;
+    }
+    default:
+      throw std::runtime_error("unrecognized heap dump tag " +
+                               std::to_string(tag));
+    }
+  }
+}
+
+/*
+ * Runs fn(i) for i in [0, n) on num_threads threads, and rethrows the first
+ * exception, if any, once all of them are done.
+ */
+template <typename Fn>
+void parallel_for(size_t n, size_t num_threads, const Fn& fn) {
+  std::atomic<size_t> next{0};
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  auto worker = [&]() {
+    for (size_t i = next++; i < n; i = next++) {
+      try {
+        fn(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  for (size_t t = 1; t < std::min(num_threads, n); ++t) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+class MissingIds {
+ public:
+  explicit MissingIds(bool allowed) : m_allowed(allowed) {}
+
+  void report(const char* what, uint64_t id) {
+    if (!m_allowed) {
+      throw std::runtime_error(std::string("no ") + what + " for id " +
+                               std::to_string(id));
+    }
+    ++m_count;
+  }
+
+  ~MissingIds() {
+    if (m_count > 0) {
+      std::cerr << "Warning: ignored " << m_count << " unresolvable ids"
+                << std::endl;
+    }
+  }
+
+ private:
+  bool m_allowed;
+  size_t m_count{0};
+};
+
+} // namespace
+
+std::vector<ClassInfo> read_classes(const Options& options) {
+  boost::iostreams::mapped_file_source file;
+  try {
+    file.open(options.hprof);
+  } catch (const std::exception&) {
+    throw std::runtime_error("cannot open the file");
+  }
+  const char* begin = file.data();
+  const char* end = begin + file.size();
+
+  // The header: a format name, the size of ids and a timestamp.
+  const char* format_end =
+      static_cast<const char*>(std::memchr(begin, 0, file.size()));
+  if (format_end == nullptr) {
+    throw std::runtime_error("not an hprof file");
+  }
+  Reader header(format_end + 1, end, 4);
+  size_t id_size = header.u4();
+  if (id_size != 4 && id_size != 8) {
+    throw std::runtime_error("unsupported id size " + std::to_string(id_size));
+  }
+  header.skip(8);
+
+  // Index the top-level records. The strings point into the mapped file.
+  std::unordered_map<uint64_t, std::string_view> strings;
+  std::unordered_map<uint64_t, LoadClass> load_classes;
+  std::vector<Segment> segments;
+  Reader records(header.pos(), end, id_size);
+  while (!records.done()) {
+    auto tag = records.u1();
+    records.u4(); // time offset
+    auto length = records.u4();
+    if (length > records.remaining()) {
+      throw std::runtime_error("truncated record");
+    }
+    Reader r(records.pos(), records.pos() + length, id_size);
+    records.skip(length);
+    if (tag == kString) {
+      auto string_id = r.id();
+      strings.emplace(string_id, std::string_view(r.pos(), r.remaining()));
+    } else if (tag == kLoadClass) {
+      auto serial = r.u4();
+      auto class_id = r.id();
+      r.u4(); // stack serial
+      load_classes[class_id] = LoadClass{serial, r.id()};
+    } else if (tag == kHeapDump || tag == kHeapDumpSegment) {
+      segments.emplace_back();
+      segments.back().data = std::string_view(r.pos(), length);
+    } else if (tag == kHeapDumpEnd) {
+      break;
+    }
+  }
+
+  parallel_for(segments.size(), options.num_threads,
+               [&](size_t i) { parse_segment(id_size, &segments[i]); });
+
+  // Name the dumped classes, and give classes of the same name, from
+  // different class loaders, one entry.
+  MissingIds missing(options.allow_missing_ids);
+  std::vector<std::pair<uint64_t, uint32_t>> class_sizes;
+  for (auto& segment : segments) {
+    class_sizes.insert(class_sizes.end(), segment.class_sizes.begin(),
+                       segment.class_sizes.end());
+  }
+  std::vector<ClassInfo> classes;
+  std::unordered_map<std::string_view, size_t> name_indices;
+  // Class object id to its entry and instance size.
+  std::unordered_map<uint64_t, std::pair<size_t, uint32_t>> class_entries;
+  for (const auto& [class_id, instance_size] : class_sizes) {
+    auto load_it = load_classes.find(class_id);
+    if (load_it == load_classes.end()) {
+      missing.report("load class record", class_id);
+      continue;
+    }
+    auto string_it = strings.find(load_it->second.name_id);
+    if (string_it == strings.end()) {
+      missing.report("string", load_it->second.name_id);
+      continue;
+    }
+    auto serial = load_it->second.serial;
+    auto [name_it, inserted] =
+        name_indices.emplace(string_it->second, classes.size());
+    if (inserted) {
+      classes.push_back(ClassInfo{std::string(string_it->second), serial});
+    }
+    auto& info = classes[name_it->second];
+    info.serial = std::min(info.serial, serial);
+    class_entries[class_id] = {name_it->second, instance_size};
+  }
+
+  auto entry_for = [&](uint64_t class_id) -> std::pair<size_t, uint32_t>* {
+    auto it = class_entries.find(class_id);
+    if (it == class_entries.end()) {
+      missing.report("class", class_id);
+      return nullptr;
+    }
+    return &it->second;
+  };
+  std::array<Counts, kNumBasicTypes> primitive_arrays;
+  for (const auto& segment : segments) {
+    for (const auto& [class_id, count] : segment.instances) {
+      if (auto* entry = entry_for(class_id)) {
+        classes[entry->first].instances += count;
+        classes[entry->first].shallow_size += count * entry->second;
+      }
+    }
+    for (const auto& [class_id, counts] : segment.object_arrays) {
+      if (auto* entry = entry_for(class_id)) {
+        classes[entry->first].instances += counts.count;
+        classes[entry->first].shallow_size += counts.bytes;
+      }
+    }
+    for (uint8_t type = 0; type < kNumBasicTypes; ++type) {
+      primitive_arrays[type].add(segment.primitive_arrays[type].count,
+                                 segment.primitive_arrays[type].bytes);
+    }
+  }
+  // Primitive arrays only name their element type. Dumps normally include
+  // the array classes, otherwise they go last.
+  for (uint8_t type = 0; type < kNumBasicTypes; ++type) {
+    if (primitive_arrays[type].count == 0) {
+      continue;
+    }
+    std::string_view name = kArrayNames[type];
+    auto [name_it, inserted] = name_indices.emplace(name, classes.size());
+    if (inserted) {
+      classes.push_back(ClassInfo{std::string(name), UINT32_MAX});
+    }
+    classes[name_it->second].instances += primitive_arrays[type].count;
+    classes[name_it->second].shallow_size += primitive_arrays[type].bytes;
+  }
+
+  std::sort(classes.begin(), classes.end(),
+            [](const ClassInfo& a, const ClassInfo& b) {
+              return a.serial != b.serial ? a.serial < b.serial
+                                          : a.name < b.name;
+            });
+  return classes;
+}
+
+} // namespace hprof
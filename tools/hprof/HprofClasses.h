@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Reads the classes of an HPROF heap dump, like dump_classes_from_hprof.py,
+ * along with how many instances of each class the heap holds.
+ *
+ * The dump is mapped rather than read. A first pass only walks the
+ * top-level records to index the strings and the load-class records and to
+ * find the heap dump segments; the segments, which is where nearly all of
+ * the bytes are, are then parsed in parallel and their counts merged.
+ */
+namespace hprof {
+
+struct Options {
+  std::string hprof;
+  size_t num_threads{1};
+  // Unresolvable ids only result in warnings, not errors, as some dumps seem
+  // to reference objects they don't define.
+  bool allow_missing_ids{false};
+};
+
+struct ClassInfo {
+  // The Java name, e.g. "java.lang.String" or "int[]".
+  std::string name;
+  // The load class serial number, which is the class load order on Dalvik
+  // and ART.
+  uint32_t serial{0};
+  uint64_t instances{0};
+  // Estimated shallow size of all the instances, in bytes, computed the way
+  // dump_classes_from_hprof.py does.
+  uint64_t shallow_size{0};
+};
+
+/*
+ * Returns the classes dumped in the heap, one per name, in load order.
+ * Classes of the same name from different class loaders share an entry.
+ * Throws std::runtime_error if the dump is malformed.
+ */
+std::vector<ClassInfo> read_classes(const Options& options);
+
+} // namespace hprof
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+#include <boost/program_options.hpp>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#include "HprofClasses.h"
+
+namespace {
+
+bool ends_with(const std::string& s, const std::string& suffix) {
+  return s.size() >= suffix.size() &&
+         s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+/*
+ * The class list as the coldstart_classes config expects it: one class per
+ * line, in load order, as "com/foo/Bar.class". Arrays are left out.
+ */
+void write_class_list(const std::vector<hprof::ClassInfo>& classes,
+                      std::ostream& out) {
+  for (const auto& cls : classes) {
+    if (ends_with(cls.name, "[]")) {
+      continue;
+    }
+    auto name = cls.name;
+    std::replace(name.begin(), name.end(), '.', '/');
+    out << name << ".class\n";
+  }
+}
+
+/*
+ * One tab-separated line per class, arrays included: the Java name, the
+ * number of instances and their estimated shallow size in bytes. The
+ * biggest classes come first.
+ */
+void write_stats(std::vector<hprof::ClassInfo> classes, std::ostream& out) {
+  std::stable_sort(classes.begin(), classes.end(),
+                   [](const hprof::ClassInfo& a, const hprof::ClassInfo& b) {
+                     return a.shallow_size > b.shallow_size;
+                   });
+  for (const auto& cls : classes) {
+    out << cls.name << '\t' << cls.instances << '\t' << cls.shallow_size
+        << '\n';
+  }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  namespace po = boost::program_options;
+  po::options_description desc(
+      "Generate the list of classes loaded in a heap dump\n\n"
+      "Usage: redex-hprof-classes --hprof <dump.hprof> [-o <classes.txt>]");
+  desc.add_options()("help,h", "print this help message");
+  desc.add_options()("hprof", po::value<std::string>(),
+                     "heap dump to generate class list from");
+  desc.add_options()("output,o", po::value<std::string>(),
+                     "where to write the class list (default: stdout)");
+  desc.add_options()("stats", po::value<std::string>(),
+                     "also write the instance count and shallow size of "
+                     "every class to this file");
+  desc.add_options()("jobs,j", po::value<size_t>(),
+                     "number of threads (default: all cores)");
+  desc.add_options()("allow-missing-ids",
+                     "unresolvable ids result in only warnings, not errors");
+
+  po::variables_map vm;
+  try {
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+  } catch (const po::error& e) {
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    desc.print(std::cerr);
+    return EXIT_FAILURE;
+  }
+
+  if (vm.count("help")) {
+    desc.print(std::cout);
+    return EXIT_SUCCESS;
+  }
+  if (!vm.count("hprof")) {
+    desc.print(std::cerr);
+    return EXIT_FAILURE;
+  }
+
+  hprof::Options options;
+  options.hprof = vm["hprof"].as<std::string>();
+  options.num_threads = std::max(1u, std::thread::hardware_concurrency());
+  if (vm.count("jobs")) {
+    options.num_threads = std::max<size_t>(1, vm["jobs"].as<size_t>());
+  }
+  options.allow_missing_ids = vm.count("allow-missing-ids") != 0;
+
+  std::vector<hprof::ClassInfo> classes;
+  try {
+    classes = hprof::read_classes(options);
+  } catch (const std::exception& e) {
+    std::cerr << "ERROR: " << options.hprof << ": " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (vm.count("output")) {
+    auto path = vm["output"].as<std::string>();
+    std::ofstream out(path);
+    write_class_list(classes, out);
+    if (!out) {
+      std::cerr << "Unable to write '" << path << "'" << std::endl;
+      return EXIT_FAILURE;
+    }
+  } else {
+    write_class_list(classes, std::cout);
+  }
+  if (vm.count("stats")) {
+    auto path = vm["stats"].as<std::string>();
+    std::ofstream out(path);
+    write_stats(classes, out);
+    if (!out) {
+      std::cerr << "Unable to write '" << path << "'" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
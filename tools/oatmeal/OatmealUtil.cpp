@@ -6,8 +6,10 @@
  */
 
 #include "OatmealUtil.h"
+#include "mmap.h"
 #include <cerrno>
 #include <cstring>
+#include <sys/mman.h>
 #include <sys/stat.h>
 
 void write_buf(FileHandle& fh, ConstBuffer buf) {
@@ -26,6 +28,25 @@ size_t get_filesize(FileHandle& fh) {
   return dex_stat.st_size;
 }
 
+std::unique_ptr<MappedFile> map_file_read_only(const std::string& filename) {
+  auto fh = FileHandle(fopen(filename.c_str(), "r"));
+  if (fh.get() == nullptr) {
+    fprintf(stderr,
+            "failed to open file %s %s\n",
+            filename.c_str(),
+            std::strerror(errno));
+    return nullptr;
+  }
+  // mmap_file prints the error itself. The mapping outlives the descriptor.
+  std::string error;
+  return std::unique_ptr<MappedFile>(MappedFile::mmap_file(get_filesize(fh),
+                                                           PROT_READ,
+                                                           MAP_PRIVATE,
+                                                           fileno(fh.get()),
+                                                           filename.c_str(),
+                                                           &error));
+}
+
 void stream_file(FileHandle& in, FileHandle& out) {
   constexpr int kBufSize = 0x80000;
   std::unique_ptr<char[]> buf(new char[kBufSize]);
@@ -11,9 +11,12 @@
 #include "DexOpcodeDefs.h"
 #include "file-utils.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdio>
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -54,6 +57,29 @@ static void foreach_pair(const T1& t1, const T2& t2, const L& fn) {
   }
 }
 
+// Like foreach_pair, but also passes the index, and runs on all cores, in
+// no particular order. fn must be safe to call from several threads.
+template <typename T1, typename T2, typename L>
+static void parallel_foreach_pair(const T1& t1, const T2& t2, const L& fn) {
+  CHECK(t1.size() == t2.size());
+  std::atomic<size_t> next{0};
+  auto work = [&]() {
+    for (size_t i; (i = next++) < t1.size();) {
+      fn(i, t1[i], t2[i]);
+    }
+  };
+  size_t num_threads = std::min<size_t>(
+      std::max(1u, std::thread::hardware_concurrency()), t1.size());
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < num_threads; i++) {
+    threads.emplace_back(work);
+  }
+  work();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
 template <uint32_t Width>
 uint32_t align(uint32_t in) {
   return (in + (Width - 1)) & -Width;
@@ -197,6 +223,12 @@ bool is_vdex_file(ConstBuffer buf);
 
 size_t get_filesize(FileHandle& fh);
 
+class MappedFile;
+
+// Maps the whole file read-only. Returns nullptr, after printing why, if the
+// file cannot be opened or mapped.
+std::unique_ptr<MappedFile> map_file_read_only(const std::string& filename);
+
 std::string read_string(const uint8_t* dstr);
 
 inline uint32_t read_uleb128(char** _ptr) {
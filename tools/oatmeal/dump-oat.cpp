@@ -29,6 +29,7 @@
 #include "dump-oat.h"
 #include "elf-writer.h"
 #include "memory-accounter.h"
+#include "mmap.h"
 #include "vdex.h"
 
 #include <algorithm>
@@ -1321,38 +1322,40 @@ OatClasses_124::OatClasses_124(const DexFileListing_079& dex_file_listing,
                                const DexFiles& dex_files,
                                ConstBuffer oat_buf,
                                ConstBuffer dex_buf) {
-  foreach_pair(dex_file_listing.dex_files(),
-               dex_files.headers(),
-               [&](const DexFileListing_079::DexFile_079& listing,
-                   const DexFileHeader& header) {
-                 auto classes_offset = listing.classes_offset;
-
-                 DexClasses dex_classes;
-                 dex_classes.dex_file = listing.location;
-
-                 DexIdBufs id_bufs(dex_buf, listing.file_offset, header);
-
-                 // classes_offset points to an array of pointers (offsets) to
-                 // ClassInfo
-                 for (unsigned int i = 0; i < header.class_defs_size; i++) {
-
-                   ClassInfo info;
-                   uint32_t info_offset;
-                   cur_ma()->memcpyAndMark(
-                       &info_offset,
-                       oat_buf.slice(classes_offset + i * sizeof(uint32_t)).ptr,
-                       sizeof(uint32_t));
-                   cur_ma()->memcpyAndMark(&info,
-                                           oat_buf.slice(info_offset).ptr,
-                                           sizeof(ClassInfo));
-
-                   // TODO: Handle compiled classes. Need to read method bitmap
-                   // size, and method bitmap.
-                   dex_classes.class_info.push_back(info);
-                   dex_classes.class_names.push_back(id_bufs.get_class_name(i));
-                 }
-                 classes_.push_back(dex_classes);
-               });
+  // The dex files are independent, so parse them in parallel.
+  classes_.resize(dex_files.headers().size());
+  parallel_foreach_pair(
+      dex_file_listing.dex_files(),
+      dex_files.headers(),
+      [&](size_t index,
+          const DexFileListing_079::DexFile_079& listing,
+          const DexFileHeader& header) {
+        auto classes_offset = listing.classes_offset;
+
+        auto& dex_classes = classes_[index];
+        dex_classes.dex_file = listing.location;
+
+        DexIdBufs id_bufs(dex_buf, listing.file_offset, header);
+
+        // classes_offset points to an array of pointers (offsets) to
+        // ClassInfo
+        for (unsigned int i = 0; i < header.class_defs_size; i++) {
+
+          ClassInfo info;
+          uint32_t info_offset;
+          cur_ma()->memcpyAndMark(
+              &info_offset,
+              oat_buf.slice(classes_offset + i * sizeof(uint32_t)).ptr,
+              sizeof(uint32_t));
+          cur_ma()->memcpyAndMark(
+              &info, oat_buf.slice(info_offset).ptr, sizeof(ClassInfo));
+
+          // TODO: Handle compiled classes. Need to read method bitmap size,
+          // and method bitmap.
+          dex_classes.class_info.push_back(info);
+          dex_classes.class_names.push_back(id_bufs.get_class_name(i));
+        }
+      });
 }
 
 class OatClasses_064 : public OatClasses {
@@ -1376,14 +1379,16 @@ class OatClasses_064 : public OatClasses {
 OatClasses_079::OatClasses_079(const DexFileListing_079& dex_file_listing,
                                const DexFiles& dex_files,
                                ConstBuffer oat_buf) {
-  foreach_pair(
+  classes_.resize(dex_files.headers().size());
+  parallel_foreach_pair(
       dex_file_listing.dex_files(),
       dex_files.headers(),
-      [&](const DexFileListing_079::DexFile_079& listing,
+      [&](size_t index,
+          const DexFileListing_079::DexFile_079& listing,
           const DexFileHeader& header) {
         auto classes_offset = listing.classes_offset;
 
-        DexClasses dex_classes;
+        auto& dex_classes = classes_[index];
         dex_classes.dex_file = listing.location;
 
         DexIdBufs id_bufs(oat_buf, listing.file_offset, header);
@@ -1409,7 +1414,6 @@ OatClasses_079::OatClasses_079(const DexFileListing_079& dex_file_listing,
           dex_classes.class_info.push_back(info);
           dex_classes.class_names.push_back(id_bufs.get_class_name(i));
         }
-        classes_.push_back(dex_classes);
       });
 }
 
@@ -2260,52 +2264,37 @@ class OatFile_124 : public OatFile {
     DexFileListingType dfl(header.dex_file_count, rest);
 
     auto dex_file_name = dexes[0].filename;
-    auto dex_file = FileHandle(fopen(dex_file_name.c_str(), "r"));
-    if (dex_file.get() == nullptr) {
-      fprintf(stderr,
-              "failed to open dex file %s %s\n",
-              dex_file_name.c_str(),
-              std::strerror(errno));
-      return nullptr;
-    }
-
-    auto dex_file_size = get_filesize(dex_file);
-
-    // We don't run dumping during install on device, so it is allowed to
-    // consume lots of memory.
-    auto dex_file_contents = std::make_unique<char[]>(dex_file_size);
-    auto dexFileBytesRead =
-        fread(dex_file_contents.get(), 1, dex_file_size, dex_file.get());
-    if (dexFileBytesRead != dex_file_size) {
-      fprintf(stderr,
-              "Failed to read dex file %s (%zd)\n",
-              std::strerror(errno),
-              dexFileBytesRead);
+    auto dex_file = map_file_read_only(dex_file_name);
+    if (dex_file == nullptr) {
       return nullptr;
     }
 
-    ConstBuffer dex_file_buf{dex_file_contents.get(), dex_file_size};
+    ConstBuffer dex_file_buf{reinterpret_cast<const char*>(dex_file->begin()),
+                             dex_file->size()};
     cur_ma()->addBuffer(dex_file_buf);
     DexFiles dex_files(dfl, dex_file_buf);
 
+    std::unique_ptr<OatFileType> oat_file;
     if (dex_files_only) {
-      return std::unique_ptr<OatFile>(new OatFileType(header,
-                                                      key_value_store,
-                                                      std::move(dfl),
-                                                      std::move(dex_files),
-                                                      oat_offset));
+      oat_file.reset(new OatFileType(header,
+                                     key_value_store,
+                                     std::move(dfl),
+                                     std::move(dex_files),
+                                     oat_offset));
+    } else {
+      LookupTables lookup_tables(dfl, dex_files, buf);
+      OatClasses_124 oat_classes(dfl, dex_files, buf, dex_file_buf);
+      oat_file.reset(new OatFileType(header,
+                                     key_value_store,
+                                     std::move(dfl),
+                                     std::move(dex_files),
+                                     std::move(lookup_tables),
+                                     std::move(oat_classes),
+                                     oat_offset));
     }
-
-    LookupTables lookup_tables(dfl, dex_files, buf);
-    OatClasses_124 oat_classes(dfl, dex_files, buf, dex_file_buf);
-
-    return std::unique_ptr<OatFile>(new OatFileType(header,
-                                                    key_value_store,
-                                                    std::move(dfl),
-                                                    std::move(dex_files),
-                                                    std::move(lookup_tables),
-                                                    std::move(oat_classes),
-                                                    oat_offset));
+    // The dex files point into the mapping.
+    oat_file->dex_file_map_ = std::move(dex_file);
+    return oat_file;
   }
 
   static std::unique_ptr<OatFile> parse(bool dex_files_only,
@@ -2394,7 +2383,7 @@ class OatFile_124 : public OatFile {
         key_value_store_(std::move(kv)),
         dex_files_(std::move(dex_files)),
         oat_offset_(oat_data_offset),
-        dex_file_listing_(&dfl) {}
+        dex_file_listing_(new DexFileListing_124(std::move(dfl))) {}
 
   OatFile_124(OatHeader h,
               KeyValueStore kv,
@@ -2409,7 +2398,7 @@ class OatFile_124 : public OatFile {
         lookup_tables_(std::move(lt)),
         oat_classes_(std::move(oat_classes)),
         oat_offset_(oat_data_offset),
-        dex_file_listing_(&dfl) {}
+        dex_file_listing_(new DexFileListing_124(std::move(dfl))) {}
 
  protected:
   OatFile_124(OatHeader h,
@@ -2442,6 +2431,8 @@ class OatFile_124 : public OatFile {
   LookupTables lookup_tables_;
   OatClasses_124 oat_classes_;
   size_t oat_offset_;
+  // The vdex file, which holds the dex files.
+  std::unique_ptr<MappedFile> dex_file_map_;
 
  private:
   std::unique_ptr<DexFileListing_124> dex_file_listing_;
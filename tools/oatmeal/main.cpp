@@ -8,6 +8,7 @@
 #include "OatmealUtil.h"
 #include "dump-oat.h"
 #include "memory-accounter.h"
+#include "mmap.h"
 #include "vdex.h"
 
 #include <getopt.h>
@@ -238,31 +239,15 @@ int dump(const Arguments& args) {
   }
 
   auto const& oat_file_name = args.oat_files[0];
-  auto oat_file = FileHandle(fopen(oat_file_name.c_str(), "r"));
-  if (oat_file.get() == nullptr) {
-    fprintf(stderr,
-            "failed to open file %s %s\n",
-            oat_file_name.c_str(),
-            std::strerror(errno));
-    return 1;
-  }
-
-  auto oat_file_size = get_filesize(oat_file);
-
-  // We don't run dumping during install on device, so it is allowed to consume
-  // lots of memory.
-  auto oat_file_contents = std::make_unique<char[]>(oat_file_size);
-  auto oatFileBytesRead =
-      fread(oat_file_contents.get(), 1, oat_file_size, oat_file.get());
-  if (oatFileBytesRead != oat_file_size) {
-    fprintf(stderr,
-            "Failed to read file %s (%zd)\n",
-            std::strerror(errno),
-            oatFileBytesRead);
+  auto oat_file = map_file_read_only(oat_file_name);
+  if (oat_file == nullptr) {
     return 1;
   }
 
-  ConstBuffer oatfile_buffer{oat_file_contents.get(), oat_file_size};
+  // Mapped rather than read, so that only the pages the dump touches are
+  // loaded.
+  ConstBuffer oatfile_buffer{reinterpret_cast<const char*>(oat_file->begin()),
+                             oat_file->size()};
   auto ma_scope = MemoryAccounter::NewScope(oatfile_buffer);
 
   CHECK(oatfile_buffer.len > 4);
@@ -8,8 +8,9 @@
 #include "memory-accounter.h"
 #include "OatmealUtil.h"
 
-#include <algorithm>
 #include <cstring>
+#include <map>
+#include <mutex>
 #include <vector>
 
 namespace {
@@ -47,34 +48,32 @@ class MemoryAccounterImpl : public MemoryAccounter {
   MOVABLE(MemoryAccounterImpl);
 
   explicit MemoryAccounterImpl(ConstBuffer buf) : buf_(buf) {
-    // mark end to avoid special case in print.
-    consumed_ranges_.emplace_back(buf_.len, buf_.len);
+    // The key at the end of the buffer only marks where the last range ends.
+    coverage_.emplace(0, 0);
+    coverage_.emplace(buf_.len, 0);
   }
 
   void print() override {
-
-    std::sort(consumed_ranges_.begin(),
-              consumed_ranges_.end(),
-              [](const Range& a, const Range& b) { return a.begin < b.begin; });
-
-    Range prev{0, 0};
     printf("Memory accounting:\n");
-    if (consumed_ranges_.empty()) {
-      printf("  no unconsumed memory found\n");
-    }
-
-    for (const auto& cur : consumed_ranges_) {
-      if (prev.end < cur.begin) {
+    bool found = false;
+    for (auto it = coverage_.begin();
+         it != coverage_.end() && it->first < buf_.len;
+         ++it) {
+      auto next = std::next(it);
+      if (it->second == 0) {
         printf("  unconsumed memory in range 0x%08x to 0x%08x\n",
-               prev.end,
-               cur.begin);
-      }
-      if (cur.begin < prev.end) {
+               it->first,
+               next->first);
+        found = true;
+      } else if (it->second > 1) {
         printf("  double consumed memory in range 0x%08x to 0x%08x\n",
-               cur.begin,
-               prev.end);
+               it->first,
+               next->first);
+        found = true;
       }
-      prev = cur;
+    }
+    if (!found) {
+      printf("  no unconsumed memory found\n");
     }
   }
 
@@ -114,14 +113,14 @@ class MemoryAccounterImpl : public MemoryAccounter {
   }
 
  private:
-  struct Range {
-    Range(size_t b, size_t e) : begin(b), end(e) {}
-    uint32_t begin;
-    uint32_t end;
-  };
+  // How many times each range was consumed, keyed by the start of the range,
+  // which lasts until the next key. Neighbouring ranges always have different
+  // counts, so the map stays as small as the report, instead of growing with
+  // every mark.
+  using Coverage = std::map<uint32_t, uint32_t>;
 
   ConstBuffer buf_;
-  std::vector<Range> consumed_ranges_;
+  Coverage coverage_;
 
   static NilMemoryAccounterImpl nil_accounter_;
   static std::vector<std::unique_ptr<MemoryAccounter>> accounter_stack_;
@@ -129,7 +128,33 @@ class MemoryAccounterImpl : public MemoryAccounter {
   void markRangeImpl(uint32_t begin, uint32_t end) {
     CHECK(begin <= end);
     CHECK(end <= buf_.len);
-    consumed_ranges_.emplace_back(begin, end);
+    if (begin == end) {
+      return;
+    }
+    auto first = split(begin);
+    auto last = split(end);
+    for (auto it = first; it != last; ++it) {
+      ++it->second;
+    }
+    if (last->first != buf_.len) {
+      merge_with_previous(last);
+    }
+    merge_with_previous(first);
+  }
+
+  // Returns the range that starts at pos, splitting the one around it.
+  Coverage::iterator split(uint32_t pos) {
+    auto it = std::prev(coverage_.upper_bound(pos));
+    if (it->first == pos) {
+      return it;
+    }
+    return coverage_.emplace_hint(std::next(it), pos, it->second);
+  }
+
+  void merge_with_previous(Coverage::iterator it) {
+    if (it != coverage_.begin() && std::prev(it)->second == it->second) {
+      coverage_.erase(it);
+    }
   }
 };
 
@@ -155,15 +180,18 @@ class MultiBufferMemoryAccounter : public MemoryAccounter {
 
  private:
   std::vector<MemoryAccounterImpl> accounters_;
+  // The dex files of an oat file are parsed in parallel. Held by pointer to
+  // keep the accounter movable.
+  std::unique_ptr<std::mutex> mutex_{new std::mutex};
 };
 
 void MultiBufferMemoryAccounter::memcpyAndMark(void* dest,
                                                const char* src,
                                                size_t count) {
+  std::lock_guard<std::mutex> lock(*mutex_);
   for (auto& a : accounters_) {
     auto ptr = a.buf_.ptr;
-    char* dst_ptr = reinterpret_cast<char*>(dest);
-    if (ptr <= dest && dest <= dst_ptr + count) {
+    if (ptr <= src && src + count <= ptr + a.buf_.len) {
       a.memcpyAndMark(dest, src, count);
       return;
     }
@@ -173,6 +201,7 @@ void MultiBufferMemoryAccounter::memcpyAndMark(void* dest,
 
 void MultiBufferMemoryAccounter::markRangeConsumed(const char* ptr,
                                                    uint32_t count) {
+  std::lock_guard<std::mutex> lock(*mutex_);
   for (auto& a : accounters_) {
     auto base_ptr = a.buf_.ptr;
     if (base_ptr <= ptr && ptr + count <= base_ptr + a.buf_.len) {
@@ -184,6 +213,7 @@ void MultiBufferMemoryAccounter::markRangeConsumed(const char* ptr,
 }
 
 void MultiBufferMemoryAccounter::markBufferConsumed(ConstBuffer subBuffer) {
+  std::lock_guard<std::mutex> lock(*mutex_);
   for (auto& a : accounters_) {
     auto base_ptr = a.buf_.ptr;
     auto base_len = a.buf_.len;
@@ -201,12 +231,14 @@ void MultiBufferMemoryAccounter::markBufferConsumed(ConstBuffer subBuffer) {
 }
 
 void MultiBufferMemoryAccounter::print() {
+  std::lock_guard<std::mutex> lock(*mutex_);
   for (auto& a : accounters_) {
     a.print();
   }
 }
 
 void MultiBufferMemoryAccounter::addBuffer(ConstBuffer buf) {
+  std::lock_guard<std::mutex> lock(*mutex_);
   // Make sure this is no-ones sub-buffer in the currently accounted set.
   for (const auto& a : accounters_) {
     auto a_end = a.buf_.ptr + a.buf_.len;
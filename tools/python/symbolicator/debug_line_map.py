@@ -26,30 +26,44 @@ class DebugLineMap(object):
             if magic != 0xFACEB000:
                 raise Exception("Magic number mismatch")
             version = struct.unpack("<L", mapping.read(4))[0]
-            if version != 1:
-                raise Exception("Version mismatch")
-            method_count = struct.unpack("<L", mapping.read(4))[0]
             method_data_struct = struct.Struct("<QLL")
+            if version == 1:
+                # The index follows the header, and the records the index.
+                method_count = struct.unpack("<L", mapping.read(4))[0]
+                index_offset = mapping.tell()
+            elif version == 2:
+                # The index follows the records, and the footer points to it.
+                method_count, index_offset = struct.unpack(
+                    "<LL", mapping[len(mapping) - 8 :]
+                )
+            else:
+                raise Exception("Version mismatch")
+            method_datas = [
+                method_data_struct.unpack_from(
+                    mapping, index_offset + i * method_data_struct.size
+                )
+                for i in range(method_count)
+            ]
             offset_line_struct = struct.Struct("<LL")
-            method_datas = []
-            for _ in range(method_count):
-                method_datas.append(method_data_struct.unpack(mapping.read(16)))
             method_id_map = {}
-            for i in range(method_count):
-                method_id = struct.unpack("<Q", mapping.read(8))[0]
-                if method_id != method_datas[i][0]:
+            for method_data_id, offset, size in method_datas:
+                method_id = struct.unpack_from("<Q", mapping, offset)[0]
+                if method_id != method_data_id:
                     raise Exception("Method id mismatch")
                 if method_id in method_id_map:
                     raise Exception(
                         "Found duplicate method id entry: " + str(method_id)
                     )
-                line_mapping_size = method_datas[i][2] - 8
-                line_mapping_count = line_mapping_size // 8
+                line_mapping_count = (size - 8) // 8
                 if line_mapping_count > 0:
                     line_mappings = []
-                    for _ in range(line_mapping_count):
+                    for j in range(line_mapping_count):
                         line_mappings.append(
-                            OffsetLine(*offset_line_struct.unpack(mapping.read(8)))
+                            OffsetLine(
+                                *offset_line_struct.unpack_from(
+                                    mapping, offset + 8 + j * 8
+                                )
+                            )
                         )
                     method_id_map[method_id] = line_mappings
             logging.info(
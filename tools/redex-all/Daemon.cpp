@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "Daemon.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "Macros.h"
+
+#if !IS_WINDOWS
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace redex_daemon {
+
+#if !IS_WINDOWS
+
+namespace {
+
+constexpr int kNumForwardedFds = 3; // stdin, stdout, stderr
+
+[[noreturn]] void fail(const char* what) {
+  std::cerr << "error: redex daemon: " << what << ": " << strerror(errno)
+            << std::endl;
+  exit(EXIT_FAILURE);
+}
+
+bool write_all(int fd, const void* data, size_t size) {
+  auto* p = static_cast<const char*>(data);
+  while (size > 0) {
+    ssize_t n = write(fd, p, size);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+bool read_all(int fd, void* data, size_t size) {
+  auto* p = static_cast<char*>(data);
+  while (size > 0) {
+    ssize_t n = read(fd, p, size);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+sockaddr_un socket_address(const std::string& socket_path) {
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(addr.sun_path)) {
+    std::cerr << "error: redex daemon: socket path too long: " << socket_path
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+  return addr;
+}
+
+struct Request {
+  std::string cwd;
+  std::vector<std::string> args;
+  int fds[kNumForwardedFds]{-1, -1, -1};
+};
+
+// The request is a 32-bit payload size, sent together with the client's
+// standard stream fds, followed by the NUL-separated working directory and
+// arguments.
+bool receive_request(int conn, Request* request) {
+  uint32_t size;
+  iovec iov{&size, sizeof(size)};
+  char control[CMSG_SPACE(sizeof(int) * kNumForwardedFds)];
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  ssize_t n;
+  do {
+    n = recvmsg(conn, &msg, 0);
+  } while (n < 0 && errno == EINTR);
+  if (n <= 0) {
+    return false;
+  }
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  if (cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET ||
+      cmsg->cmsg_type != SCM_RIGHTS ||
+      cmsg->cmsg_len != CMSG_LEN(sizeof(int) * kNumForwardedFds)) {
+    return false;
+  }
+  memcpy(request->fds, CMSG_DATA(cmsg), sizeof(request->fds));
+  if ((size_t)n < sizeof(size) &&
+      !read_all(conn, reinterpret_cast<char*>(&size) + n, sizeof(size) - n)) {
+    return false;
+  }
+
+  std::string payload(size, '\0');
+  if (!read_all(conn, &payload[0], size)) {
+    return false;
+  }
+  std::vector<std::string> parts;
+  size_t start = 0;
+  for (size_t end; (end = payload.find('\0', start)) != std::string::npos;
+       start = end + 1) {
+    parts.emplace_back(payload, start, end - start);
+  }
+  if (parts.size() < 2) {
+    return false;
+  }
+  request->cwd = std::move(parts.front());
+  request->args.assign(std::make_move_iterator(parts.begin() + 1),
+                       std::make_move_iterator(parts.end()));
+  return true;
+}
+
+void close_fds(const Request& request) {
+  for (int fd : request.fds) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+} // namespace
+
+std::vector<std::string> serve(const std::string& socket_path) {
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd < 0) {
+    fail("socket");
+  }
+  auto addr = socket_address(socket_path);
+  unlink(socket_path.c_str());
+  if (bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+    fail("bind");
+  }
+  if (listen(listen_fd, 16) != 0) {
+    fail("listen");
+  }
+  std::cerr << "redex daemon listening on " << socket_path << std::endl;
+
+  while (true) {
+    int conn = accept(listen_fd, nullptr, nullptr);
+    if (conn < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      fail("accept");
+    }
+    Request request;
+    if (!receive_request(conn, &request)) {
+      std::cerr << "warning: redex daemon: dropping malformed request"
+                << std::endl;
+      close_fds(request);
+      close(conn);
+      continue;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+      fail("fork");
+    }
+    if (pid == 0) {
+      close(listen_fd);
+      close(conn);
+      for (int i = 0; i < kNumForwardedFds; ++i) {
+        dup2(request.fds[i], i);
+      }
+      close_fds(request);
+      if (chdir(request.cwd.c_str()) != 0) {
+        fail("chdir");
+      }
+      return std::move(request.args);
+    }
+
+    close_fds(request);
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+      if (errno != EINTR) {
+        fail("waitpid");
+      }
+    }
+    int32_t exit_code = WIFEXITED(status) ? WEXITSTATUS(status)
+                                          : 128 + WTERMSIG(status);
+    write_all(conn, &exit_code, sizeof(exit_code));
+    close(conn);
+  }
+}
+
+int run_client(const std::string& socket_path,
+               const std::vector<std::string>& args) {
+  int conn = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (conn < 0) {
+    fail("socket");
+  }
+  auto addr = socket_address(socket_path);
+  if (connect(conn, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+    fail("connect");
+  }
+
+  char* cwd = getcwd(nullptr, 0);
+  if (cwd == nullptr) {
+    fail("getcwd");
+  }
+  std::string payload(cwd);
+  free(cwd);
+  payload.push_back('\0');
+  for (const auto& arg : args) {
+    payload += arg;
+    payload.push_back('\0');
+  }
+
+  uint32_t size = payload.size();
+  iovec iov{&size, sizeof(size)};
+  char control[CMSG_SPACE(sizeof(int) * kNumForwardedFds)]{};
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int) * kNumForwardedFds);
+  int fds[kNumForwardedFds] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+  if (sendmsg(conn, &msg, 0) != (ssize_t)sizeof(size) ||
+      !write_all(conn, payload.data(), payload.size())) {
+    fail("send");
+  }
+
+  int32_t exit_code;
+  if (!read_all(conn, &exit_code, sizeof(exit_code))) {
+    std::cerr << "error: redex daemon closed the connection" << std::endl;
+    exit_code = EXIT_FAILURE;
+  }
+  close(conn);
+  return exit_code;
+}
+
+void exec_self(const std::vector<std::string>& args) {
+  std::vector<char*> argv;
+  for (const auto& arg : args) {
+    argv.push_back(const_cast<char*>(arg.c_str()));
+  }
+  argv.push_back(nullptr);
+  execv("/proc/self/exe", argv.data());
+  execvp(argv[0], argv.data());
+  fail("exec");
+}
+
+#else
+
+std::vector<std::string> serve(const std::string&) {
+  std::cerr << "error: redex daemon mode is not supported on Windows"
+            << std::endl;
+  exit(EXIT_FAILURE);
+}
+
+int run_client(const std::string&, const std::vector<std::string>&) {
+  std::cerr << "error: redex daemon mode is not supported on Windows"
+            << std::endl;
+  exit(EXIT_FAILURE);
+}
+
+void exec_self(const std::vector<std::string>&) {
+  std::cerr << "error: redex daemon mode is not supported on Windows"
+            << std::endl;
+  exit(EXIT_FAILURE);
+}
+
+#endif
+
+} // namespace redex_daemon
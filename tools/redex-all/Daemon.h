@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+/*
+ * A minimal fork server for redex-all.
+ *
+ * The daemon loads the inputs that are shared between builds once, then
+ * listens on a Unix domain socket. For each build request it forks; the child
+ * inherits the preloaded state copy-on-write and runs a normal redex-all
+ * invocation with the request's arguments. The client's working directory
+ * and stdin/stdout/stderr are forwarded, and the child's exit status is sent
+ * back once it terminates. Requests are handled one at a time.
+ *
+ * Only available on POSIX systems.
+ */
+namespace redex_daemon {
+
+/*
+ * Accepts requests on `socket_path` forever. Returns only in a forked child,
+ * with the arguments of the request it should process (including argv[0]).
+ * The child's working directory and standard streams are already those of
+ * the client.
+ */
+std::vector<std::string> serve(const std::string& socket_path);
+
+/*
+ * Sends `args` (including argv[0]) to the daemon on `socket_path` and waits
+ * for the build to finish. Returns its exit status.
+ */
+int run_client(const std::string& socket_path,
+               const std::vector<std::string>& args);
+
+/*
+ * Replaces the current process with a fresh redex-all invocation. Used for
+ * requests that cannot reuse the preloaded state.
+ */
+[[noreturn]] void exec_self(const std::vector<std::string>& args);
+
+} // namespace redex_daemon
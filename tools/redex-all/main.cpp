@@ -10,8 +10,10 @@
 #include <cstring>
 #include <ctime>
 #include <fstream>
+#include <future>
 #include <iostream>
 #include <memory>
+#include <numeric>
 #include <regex>
 #include <set>
 #include <streambuf>
@@ -38,9 +40,12 @@
 #include "CommandProfiling.h"
 #include "CommentFilter.h"
 #include "ControlFlow.h" // To set DEBUG.
+#include "Daemon.h"
 #include "Debug.h"
+#include "DebugLineMap.h"
 #include "DexClass.h"
 #include "DexHasher.h"
+#include "DexIdx.h"
 #include "DexLoader.h"
 #include "DexOutput.h"
 #include "DexPosition.h"
@@ -97,6 +102,12 @@ struct Arguments {
   // command line arguments. For development usage
   Json::Value entry_data;
   boost::optional<int> stop_pass_idx;
+  // Directory of a checkpoint written with `--stop-pass`, to continue from.
+  std::string resume_from_dir;
+  // The stores to process when resuming, or all of them if empty.
+  std::vector<std::string> resume_stores;
+  // Unix socket to serve builds on, see `DaemonPreload`.
+  std::string daemon_socket;
   RedexOptions redex_options;
 };
 
@@ -295,6 +306,22 @@ Arguments parse_args(int argc, char* argv[]) {
       "arch,A",
       po::value<std::vector<std::string>>(),
       "Architecture; one of arm/arm64/thumb2/x86_64/x86/mips/mips64");
+  od.add_options()(
+      "code-spill-rss-budget-mb",
+      po::value<uint32_t>(&args.redex_options.code_spill_rss_budget_mb)
+          ->default_value(0),
+      "If non-zero, spill the bodies of cold methods to disk between passes "
+      "while the resident memory exceeds this many megabytes.\n");
+  od.add_options()(
+      "lazy-balloon",
+      po::bool_switch(&args.redex_options.lazy_balloon)->default_value(false),
+      "If specified, method bodies are converted to IR when first accessed "
+      "instead of all at load time.\n");
+  od.add_options()(
+      "fast-teardown",
+      po::bool_switch(&args.redex_options.fast_teardown)->default_value(false),
+      "If specified, the global context is not freed at exit; only its "
+      "destruction tasks are run.\n");
   od.add_options()("enable-instrument-pass",
                    po::bool_switch(&args.redex_options.instrument_pass_enabled)
                        ->default_value(false),
@@ -332,6 +359,24 @@ Arguments parse_args(int argc, char* argv[]) {
                    "Stop before pass n and output IR to file");
   od.add_options()("output-ir", po::value<std::string>(),
                    "IR output directory, used with --stop-pass");
+  od.add_options()(
+      "daemon-socket", po::value<std::string>(),
+      "Run as a daemon serving builds on this Unix socket. The ProGuard "
+      "configs and library jars given alongside are loaded once and reused by "
+      "every build that uses the same ones");
+  od.add_options()("daemon-client", po::value<std::string>(),
+                   "Run this invocation on the daemon listening on this "
+                   "Unix socket");
+  od.add_options()("resume-from", po::value<std::string>(),
+                   "Load the IR written by --stop-pass/--output-ir from this "
+                   "directory and run the remaining passes");
+  od.add_options()(
+      "resume-store", po::value<std::vector<std::string>>(),
+      "With --resume-from, only process and write the store with this name; "
+      "may be repeated. Lets the stores of one checkpoint be finished by "
+      "separate invocations, e.g. on the nodes of a distributed build. The "
+      "root store is still loaded for the others to depend on, but is only "
+      "written if it is named");
 
   po::positional_options_description pod;
   pod.add("dex-files", -1);
@@ -381,6 +426,21 @@ Arguments parse_args(int argc, char* argv[]) {
     exit(EXIT_SUCCESS);
   }
 
+  if (vm.count("daemon-socket")) {
+    // The daemon itself only needs the inputs it preloads.
+    args.daemon_socket = vm["daemon-socket"].as<std::string>();
+    if (vm.count("proguard-config")) {
+      args.proguard_config_paths =
+          vm["proguard-config"].as<std::vector<std::string>>();
+    }
+    if (vm.count("jarpath")) {
+      for (const auto& e : vm["jarpath"].as<std::vector<std::string>>()) {
+        args.jar_paths.emplace(e);
+      }
+    }
+    return args;
+  }
+
   if (vm.count("dex-files")) {
     args.dex_files = vm["dex-files"].as<std::vector<std::string>>();
   } else {
@@ -502,6 +562,12 @@ Arguments parse_args(int argc, char* argv[]) {
       std::cerr << "Invalid stop_pass value\n";
       exit(EXIT_FAILURE);
     }
+    // Remember the passes that were cut off, for `--resume-from`.
+    auto& resume_passes = args.entry_data["resume_passes"];
+    resume_passes = Json::arrayValue;
+    for (Json::ArrayIndex i = idx; i < passes_list.size(); ++i) {
+      resume_passes.append(passes_list[i]);
+    }
     if (passes_list.size() > (size_t)idx) {
       passes_list.resize(idx);
     }
@@ -514,6 +580,18 @@ Arguments parse_args(int argc, char* argv[]) {
     }
   }
 
+  if (vm.count("resume-from")) {
+    always_assert_log(args.stop_pass_idx == boost::none,
+                      "--resume-from cannot be combined with --stop-pass");
+    args.resume_from_dir = vm["resume-from"].as<std::string>();
+  }
+
+  if (vm.count("resume-store")) {
+    always_assert_log(!args.resume_from_dir.empty(),
+                      "--resume-store requires --resume-from");
+    args.resume_stores = vm["resume-store"].as<std::vector<std::string>>();
+  }
+
   std::string metafiles = args.out_dir + "/meta/";
   int status = [&metafiles]() -> int {
 #if !IS_WINDOWS
@@ -573,6 +651,7 @@ Json::Value get_stats(const dex_stats_t& stats) {
   val["dbg_total_size"] = stats.dbg_total_size;
 
   val["instruction_bytes"] = stats.instruction_bytes;
+  val["startup_code_pages"] = stats.startup_code_pages;
 
   val["header_item_count"] = stats.header_item_count;
   val["header_item_bytes"] = stats.header_item_bytes;
@@ -633,6 +712,28 @@ Json::Value get_pass_stats(const PassManager& mgr) {
   return all;
 }
 
+Json::Value get_pass_run_stats(const PassManager& mgr) {
+  auto ms = [](uint64_t us) { return (Json::UInt64)(us / 1000); };
+  Json::Value all(Json::ValueType::objectValue);
+  for (const auto& pass_info : mgr.get_pass_info()) {
+    const auto& run_stats = pass_info.run_stats;
+    Json::Value pass;
+    pass["wall_ms"] = ms(run_stats.wall_us);
+    pass["cpu_ms"] = ms(run_stats.cpu_us);
+    pass["peak_rss_delta"] = (Json::UInt64)run_stats.peak_rss_delta;
+    pass["workqueue_runs"] = (Json::UInt64)run_stats.workqueue_runs;
+    pass["workqueue_wall_ms"] = ms(run_stats.workqueue_wall_us);
+    if (run_stats.workqueue_capacity_us > 0) {
+      // The share of the threads of the runs that was spent on the CPU.
+      double utilization = (double)run_stats.workqueue_cpu_us /
+                           run_stats.workqueue_capacity_us;
+      pass["worker_utilization"] = std::round(utilization * 100) / 100.0;
+    }
+    all[pass_info.name] = pass;
+  }
+  return all;
+}
+
 Json::Value get_pass_hashes(const PassManager& mgr) {
   Json::Value all(Json::ValueType::objectValue);
   auto initial_hash = mgr.get_initial_hash();
@@ -705,6 +806,21 @@ Json::Value get_input_stats(const dex_stats_t& stats,
   return d;
 }
 
+Json::Value get_member_footprint_stats() {
+  auto footprint = get_member_footprint();
+  Json::Value d;
+  d["method_object_size"] = (Json::UInt64)footprint.method_object_size;
+  d["field_object_size"] = (Json::UInt64)footprint.field_object_size;
+  d["num_methods"] = (Json::UInt64)footprint.num_methods;
+  d["num_fields"] = (Json::UInt64)footprint.num_fields;
+  d["num_external_methods"] = (Json::UInt64)footprint.num_external_methods;
+  d["num_external_fields"] = (Json::UInt64)footprint.num_external_fields;
+  d["num_param_annotated_methods"] =
+      (Json::UInt64)footprint.num_param_annotated_methods;
+  d["total_bytes"] = (Json::UInt64)footprint.total_bytes;
+  return d;
+}
+
 Json::Value get_output_stats(
     const dex_stats_t& stats,
     const std::vector<dex_stats_t>& dexes_stats,
@@ -715,9 +831,11 @@ Json::Value get_output_stats(
   d["total_stats"] = get_stats(stats);
   d["dexes_stats"] = get_detailed_stats(dexes_stats);
   d["pass_stats"] = get_pass_stats(mgr);
+  d["pass_run_stats"] = get_pass_run_stats(mgr);
   d["pass_hashes"] = get_pass_hashes(mgr);
   d["lowering_stats"] = get_lowering_stats(instruction_lowering_stats);
   d["position_stats"] = get_position_stats(pos_mapper);
+  d["member_footprint"] = get_member_footprint_stats();
   return d;
 }
 
@@ -729,78 +847,33 @@ Json::Value get_threads_stats() {
   return d;
 }
 
-void write_debug_line_mapping(
-    const std::string& debug_line_map_filename,
+void finish_debug_line_mapping(
+    DebugLineMapWriter& debug_line_map,
     const std::unordered_map<DexMethod*, uint64_t>& method_to_id,
     const std::unordered_map<DexCode*, std::vector<DebugLineItem>>&
         code_debug_lines,
-    DexStoresVector& stores,
-    const std::vector<DexMethod*>& needs_debug_line_mapping) {
-  /*
-   * Binary file format:
-   * magic number 0xfaceb000 (4 byte)
-   * version number (4 byte)
-   * number (m) of methods that has debug line info (4 byte)
-   * a list (m elements) of:
-   *   [ encoded method-id (8 byte), method debug info byte offset (4 byte),
-   *     method debug info byte size (4 byte) ]
-   *
-   * a list (m elements) of :
-   *   encoded method-id (8 byte)
-   *   a list (n elements) of:
-   *     [ memory offset (4 byte), line number (4 byte) ]
-   */
-  size_t bit_32_size = sizeof(uint32_t);
-  size_t bit_64_size = sizeof(uint64_t);
-  uint32_t num_method = code_debug_lines.size();
-  int offset = num_method + 2;
-  // Start of debug line info information would be after all of
-  // method-id => offset info, so set the start of offset to be after that.
-  int binary_offset =
-      3 * bit_32_size + (bit_64_size + 2 * bit_32_size) * num_method;
-  std::ofstream ofs(debug_line_map_filename.c_str(),
-                    std::ofstream::out | std::ofstream::trunc);
-  uint32_t magic = 0xfaceb000; // serves as endianess check
-  ofs.write((const char*)&magic, bit_32_size);
-  uint32_t version = 1;
-  ofs.write((const char*)&version, bit_32_size);
-  ofs.write((const char*)&num_method, bit_32_size);
-  std::ostringstream line_out;
-
-  auto scope = build_class_scope(stores);
-  std::vector<DexMethod*> all_methods(std::begin(needs_debug_line_mapping),
-                                      std::end(needs_debug_line_mapping));
-  walk::methods(scope,
-                [&](DexMethod* method) { all_methods.push_back(method); });
-  std::stable_sort(all_methods.begin(), all_methods.end(), compare_dexmethods);
-
-  for (auto* method : all_methods) {
+    std::vector<DexMethod*> needs_debug_line_mapping) {
+  // The records of the dexes were appended as they were written. Only the
+  // methods that got their debug lines after that, e.g. detached ones, are
+  // left.
+  std::stable_sort(needs_debug_line_mapping.begin(),
+                   needs_debug_line_mapping.end(), compare_dexmethods);
+  std::vector<DebugLineMapWriter::Entry> entries;
+  for (auto* method : needs_debug_line_mapping) {
     auto dex_code = method->get_dex_code();
-    if (dex_code == nullptr ||
-        code_debug_lines.find(dex_code) == code_debug_lines.end()) {
+    if (dex_code == nullptr) {
       continue;
     }
-
-    uint64_t method_id = method_to_id.at(method);
-    // write method id => offset info for binary file
-    ofs.write((const char*)&method_id, bit_64_size);
-    ofs.write((const char*)&binary_offset, bit_32_size);
-
-    auto debug_lines = code_debug_lines.at(dex_code);
-    uint32_t num_line_info = debug_lines.size();
-    offset = offset + 1 + num_line_info;
-    uint32_t info_section_size = bit_64_size + num_line_info * 2 * bit_32_size;
-    ofs.write((const char*)&info_section_size, bit_32_size);
-    binary_offset = binary_offset + info_section_size;
-
-    // Generate debug line info for binary file.
-    line_out.write((const char*)&method_id, bit_64_size);
-    for (auto it = debug_lines.begin(); it != debug_lines.end(); ++it) {
-      line_out.write((const char*)&it->offset, bit_32_size);
-      line_out.write((const char*)&it->line, bit_32_size);
+    auto lines_it = code_debug_lines.find(dex_code);
+    auto id_it = method_to_id.find(method);
+    if (lines_it == code_debug_lines.end() || id_it == method_to_id.end() ||
+        debug_line_map.contains(id_it->second)) {
+      continue;
     }
+    entries.emplace_back(id_it->second, &lines_it->second);
   }
-  ofs << line_out.str();
+  debug_line_map.append(DebugLineMapWriter::encode(entries));
+  debug_line_map.finish();
 }
 
 std::string get_dex_magic(std::vector<std::string>& dex_files) {
@@ -863,18 +936,8 @@ void dump_keep_reasons(const ConfigFiles& conf,
   }
 }
 
-/**
- * Pre processing steps: load dex and configurations
- */
-void redex_frontend(ConfigFiles& conf, /* input */
-                    Arguments& args, /* inout */
-                    keep_rules::ProguardConfiguration& pg_config,
-                    DexStoresVector& stores,
-                    Json::Value& stats) {
-  Timer redex_frontend_timer("Redex_frontend");
-
-  g_redex->load_pointers_cache();
-
+void parse_proguard_configs(Arguments& args, /* inout */
+                            keep_rules::ProguardConfiguration& pg_config) {
   for (const auto& pg_config_path : args.proguard_config_paths) {
     Timer time_pg_parsing("Parsed ProGuard config file");
     keep_rules::proguard_parser::parse_file(pg_config_path, &pg_config);
@@ -883,7 +946,11 @@ void redex_frontend(ConfigFiles& conf, /* input */
 
   const auto& pg_libs = pg_config.libraryjars;
   args.jar_paths.insert(pg_libs.begin(), pg_libs.end());
+}
 
+void load_library_jars(Arguments& args, /* inout */
+                       const keep_rules::ProguardConfiguration& pg_config,
+                       Scope* external_classes) {
   std::set<std::string> library_jars;
   for (const auto& jar_path : args.jar_paths) {
     std::istringstream jar_stream(jar_path);
@@ -903,32 +970,13 @@ void redex_frontend(ConfigFiles& conf, /* input */
     }
   }
 
-  DexStore root_store("classes");
-  // Only set dex magic to root DexStore since all dex magic
-  // should be consistent within one APK.
-  root_store.set_dex_magic(get_dex_magic(args.dex_files));
-  stores.emplace_back(std::move(root_store));
-
-  const JsonWrapper& json_config = conf.get_json_config();
-  dup_classes::read_dup_class_allowlist(json_config);
-
-  run_rethrow_first_aggregate([&]() {
-    Timer t("Load classes from dexes");
-    dex_stats_t input_totals;
-    std::vector<dex_stats_t> input_dexes_stats;
-    redex::load_classes_from_dexes_and_metadata(
-        args.dex_files, stores, input_totals, input_dexes_stats);
-    stats["input_stats"] = get_input_stats(input_totals, input_dexes_stats);
-  });
-
-  Scope external_classes;
   args.entry_data["jars"] = Json::arrayValue;
   if (!library_jars.empty()) {
     Timer t("Load library jars");
 
     for (const auto& library_jar : library_jars) {
       TRACE(MAIN, 1, "LIBRARY JAR: %s", library_jar.c_str());
-      if (!load_jar_file(library_jar.c_str(), &external_classes)) {
+      if (!load_jar_file(library_jar.c_str(), external_classes)) {
         // Try again with the basedir
         std::string basedir_path = pg_config.basedirectory + "/" + library_jar;
         if (!load_jar_file(basedir_path.c_str())) {
@@ -943,6 +991,84 @@ void redex_frontend(ConfigFiles& conf, /* input */
       }
     }
   }
+}
+
+/**
+ * Inputs that a daemon loads once and shares with every build it forks.
+ */
+struct DaemonPreload {
+  // The command-line inputs the state below was computed from. Builds with
+  // other inputs cannot use it.
+  std::vector<std::string> proguard_config_paths;
+  std::set<std::string> jar_paths;
+
+  std::unique_ptr<keep_rules::ProguardConfiguration> pg_config;
+  Scope external_classes;
+  Json::Value jars_entry_data;
+  // Library jar paths after merging in the ProGuard -libraryjars.
+  std::set<std::string> all_jar_paths;
+
+  // Backing storage for the argv of the request being processed.
+  std::vector<std::string> request;
+  std::vector<char*> request_argv;
+};
+
+/**
+ * Pre processing steps: load dex and configurations
+ */
+void redex_frontend(ConfigFiles& conf, /* input */
+                    Arguments& args, /* inout */
+                    keep_rules::ProguardConfiguration& pg_config,
+                    DexStoresVector& stores,
+                    Json::Value& stats,
+                    const DaemonPreload* preloaded = nullptr) {
+  Timer redex_frontend_timer("Redex_frontend");
+
+  g_redex->load_pointers_cache();
+
+  // The ProGuard configs are parsed while the dexes are loaded. The library
+  // jars they name are loaded once both are done, as classes from the dexes
+  // take precedence over duplicates in the jars, while the dexes are
+  // deobfuscated. The rules are processed once everything is loaded.
+  std::future<void> pg_configs_parsed;
+  if (preloaded == nullptr) {
+    pg_configs_parsed = std::async(std::launch::async, [&]() {
+      parse_proguard_configs(args, pg_config);
+    });
+  } else {
+    args.jar_paths = preloaded->all_jar_paths;
+  }
+
+  DexStore root_store("classes");
+  // Only set dex magic to root DexStore since all dex magic
+  // should be consistent within one APK.
+  root_store.set_dex_magic(get_dex_magic(args.dex_files));
+  stores.emplace_back(std::move(root_store));
+
+  const JsonWrapper& json_config = conf.get_json_config();
+  dup_classes::read_dup_class_allowlist(json_config);
+
+  run_rethrow_first_aggregate([&]() {
+    Timer t("Load classes from dexes");
+    dex_stats_t input_totals;
+    std::vector<dex_stats_t> input_dexes_stats;
+    set_lazy_ballooning(args.redex_options.lazy_balloon);
+    redex::load_classes_from_dexes_and_metadata(
+        args.dex_files, stores, input_totals, input_dexes_stats);
+    stats["input_stats"] = get_input_stats(input_totals, input_dexes_stats);
+  });
+
+  Scope external_classes;
+  std::future<void> library_jars_loaded;
+  if (preloaded == nullptr) {
+    pg_configs_parsed.get();
+    library_jars_loaded = std::async(std::launch::async, [&]() {
+      load_library_jars(args, pg_config, &external_classes);
+    });
+  } else {
+    external_classes = preloaded->external_classes;
+    args.entry_data["jars"] = preloaded->jars_entry_data;
+  }
 
   {
     Timer t("Deobfuscating dex elements");
@@ -950,6 +1076,9 @@ void redex_frontend(ConfigFiles& conf, /* input */
       apply_deobfuscated_names(store.get_dexen(), conf.get_proguard_map());
     }
   }
+  if (library_jars_loaded.valid()) {
+    library_jars_loaded.get();
+  }
   DexStoreClassesIterator it(stores);
   Scope scope = build_class_scope(it);
   {
@@ -1003,6 +1132,73 @@ void redex_frontend(ConfigFiles& conf, /* input */
   }
 }
 
+/**
+ * Replaces redex_frontend when resuming: loads the dexes and IR metadata that
+ * an earlier run wrote with `--stop-pass`, and sets up the config to run the
+ * passes it did not get to.
+ */
+Json::Value redex_resume_frontend(Arguments& args, DexStoresVector& stores) {
+  Timer t("Loading checkpoint");
+  Json::Value entry_data;
+  redex::load_all_intermediate(args.resume_from_dir, stores, &entry_data);
+  if (!entry_data.isMember("resume_passes")) {
+    std::cerr << "error: " << args.resume_from_dir
+              << " was not written by --stop-pass" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (!stores.empty()) {
+    auto first_dex_path = boost::filesystem::path(args.resume_from_dir) /
+                          entry_data["dex_list"][0]["list"][0].asString();
+    stores[0].set_dex_magic(load_dex_magic_from_dex(first_dex_path.c_str()));
+  }
+
+  args.redex_options.deserialize(entry_data);
+  if (args.config.isNull()) {
+    args.config = redex::parse_config(entry_data["config"].asString());
+  }
+  if (entry_data.isMember("apk_dir") && !args.config.isMember("apk_dir")) {
+    args.config["apk_dir"] = entry_data["apk_dir"].asString();
+  }
+  args.config["redex"]["passes"] = entry_data["resume_passes"];
+
+  if (!args.resume_stores.empty()) {
+    // The other stores are left out of the scope, so the remaining passes
+    // don't touch them and they aren't written. Their classes stay loaded,
+    // so that references to them still resolve. This assumes the remaining
+    // passes don't change what a store sees of the root store, e.g. that
+    // they don't remove or rename members of the root store that the other
+    // stores use.
+    std::unordered_set<std::string> names(args.resume_stores.begin(),
+                                          args.resume_stores.end());
+    for (const auto& name : names) {
+      auto it = std::find_if(stores.begin(), stores.end(),
+                             [&](const DexStore& store) {
+                               return store.get_name() == name;
+                             });
+      if (it == stores.end()) {
+        std::cerr << "error: " << args.resume_from_dir
+                  << " has no store named " << name << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    // Passes expect the root store first, so it always stays.
+    stores.erase(std::remove_if(std::next(stores.begin()), stores.end(),
+                                [&](const DexStore& store) {
+                                  return names.count(store.get_name()) == 0;
+                                }),
+                 stores.end());
+    auto& output_stores = args.config["output_stores"];
+    output_stores = Json::arrayValue;
+    for (const auto& store : stores) {
+      if (names.count(store.get_name())) {
+        output_stores.append(store.get_name());
+      }
+    }
+  }
+  return entry_data;
+}
+
 /**
  * Post processing steps: write dex and collect stats
  */
@@ -1014,10 +1210,17 @@ void redex_backend(ConfigFiles& conf,
   const RedexOptions& redex_options = manager.get_redex_options();
   const auto& output_dir = conf.get_outdir();
 
+  bool lower_with_cfg = true;
+  conf.get_json_config().get("lower_with_cfg", true, lower_with_cfg);
+  bool parallel_dex_writing;
+  conf.get_json_config().get("parallel_dex_writing", true,
+                             parallel_dex_writing);
+  // When dexes are written in parallel, each one is lowered by the job that
+  // writes it, so that lowering overlaps with the encoding and the file
+  // writes of the other dexes. Post-lowering needs all code lowered first.
+  bool lower_per_dex = parallel_dex_writing && !redex_options.redacted;
   instruction_lowering::Stats instruction_lowering_stats;
-  {
-    bool lower_with_cfg = true;
-    conf.get_json_config().get("lower_with_cfg", true, lower_with_cfg);
+  if (!lower_per_dex) {
     Timer t("Instruction lowering");
     instruction_lowering_stats =
         instruction_lowering::run(stores, lower_with_cfg);
@@ -1031,6 +1234,16 @@ void redex_backend(ConfigFiles& conf,
     TRACE(LOC, 1,
           "Will emit class-locator strings for classloader optimization");
     locator_index = new LocatorIndex(make_locator_index(stores));
+    if (json_config.get("emit_locator_hash_table", false)) {
+      Timer t("Writing locator hash table");
+      auto table = make_locator_hash_table(*locator_index);
+      auto fd = manager.asset_manager().new_asset_file(
+          "locator-hash.bin", "/assets/", /* new_dir */ true);
+      always_assert(fwrite(table.data(), 1, table.size(), *fd) ==
+                    table.size());
+      TRACE(LOC, 1, "Wrote %zu bytes of locator hash table for %zu classes",
+            table.size(), locator_index->size());
+    }
   }
 
   auto disable_method_similarity_order =
@@ -1051,6 +1264,11 @@ void redex_backend(ConfigFiles& conf,
                                                   : line_number_map_filename));
   std::unordered_map<DexMethod*, uint64_t> method_to_id;
   std::unordered_map<DexCode*, std::vector<DebugLineItem>> code_debug_lines;
+  std::unique_ptr<DebugLineMapWriter> debug_line_map;
+  if (needs_addresses) {
+    debug_line_map =
+        std::make_unique<DebugLineMapWriter>(debug_line_map_filename);
+  }
 
   auto iodi_metadata = [&]() {
     auto val = conf.get_json_config().get("iodi_layer_mode", Json::Value());
@@ -1075,11 +1293,50 @@ void redex_backend(ConfigFiles& conf,
     Timer t("Compute initial IODI metadata");
     iodi_metadata.mark_methods(stores);
   }
-  for (size_t store_number = 0; store_number < stores.size(); ++store_number) {
-    auto& store = stores[store_number];
-    Timer t("Writing optimized dexes");
-    for (size_t i = 0; i < store.get_dexen().size(); i++) {
-      auto this_dex_stats = write_classes_to_dex(
+  {
+    Timer t(lower_per_dex ? "Lowering and writing optimized dexes"
+                          : "Writing optimized dexes");
+    // Dexes are numbered in the order a serial write would visit them; the
+    // sequencer lets the order-sensitive parts of each write run in that
+    // order, so the output doesn't depend on thread scheduling.
+    // Only the stores of `output_stores` are written, if it is set.
+    std::unordered_set<std::string> output_stores;
+    for (const auto& name : json_config.get("output_stores", Json::Value())) {
+      output_stores.insert(name.asString());
+    }
+    std::vector<std::pair<size_t, size_t>> dexes;
+    for (size_t store_number = 0; store_number < stores.size();
+         ++store_number) {
+      if (!output_stores.empty() &&
+          !output_stores.count(stores[store_number].get_name())) {
+        continue;
+      }
+      for (size_t i = 0; i < stores[store_number].get_dexen().size(); i++) {
+        dexes.emplace_back(store_number, i);
+      }
+    }
+    // Make sure lazily loaded configuration is not loaded concurrently.
+    conf.get_method_profiles();
+
+    // The dexes share the threads when they are written concurrently.
+    size_t num_threads = redex_parallel::default_num_threads();
+    size_t num_threads_per_dex = num_threads;
+    if (parallel_dex_writing && !dexes.empty()) {
+      num_threads_per_dex = std::max<size_t>(1, num_threads / dexes.size());
+    }
+    DexOutputSequencer sequencer(num_threads_per_dex);
+    std::vector<dex_stats_t> dexes_stats(dexes.size());
+    std::vector<instruction_lowering::Stats> dexes_lowering_stats(
+        dexes.size());
+    auto write_dex = [&](size_t idx) {
+      auto store_number = dexes[idx].first;
+      auto i = dexes[idx].second;
+      auto& store = stores[store_number];
+      if (lower_per_dex) {
+        dexes_lowering_stats[idx] =
+            instruction_lowering::run(store.get_dexen()[i], lower_with_cfg);
+      }
+      dexes_stats[idx] = write_classes_to_dex(
           redex_options,
           redex::get_dex_output_name(output_dir, store, i),
           &store.get_dexen()[i],
@@ -1094,8 +1351,21 @@ void redex_backend(ConfigFiles& conf,
           stores[0].get_dex_magic(),
           symbolicate_detached_methods ? post_lowering.get() : nullptr,
           manager.get_redex_options().min_sdk,
-          disable_method_similarity_order);
-
+          disable_method_similarity_order,
+          &sequencer,
+          idx,
+          debug_line_map.get());
+    };
+    std::vector<size_t> indices(dexes.size());
+    std::iota(indices.begin(), indices.end(), 0);
+    workqueue_run<size_t>(
+        write_dex, indices,
+        parallel_dex_writing ? num_threads : 1);
+
+    for (const auto& lowering_stats : dexes_lowering_stats) {
+      instruction_lowering_stats += lowering_stats;
+    }
+    for (auto& this_dex_stats : dexes_stats) {
       output_totals += this_dex_stats;
       output_dexes_stats.push_back(this_dex_stats);
       signatures.insert(*reinterpret_cast<uint32_t*>(this_dex_stats.signature));
@@ -1135,10 +1405,10 @@ void redex_backend(ConfigFiles& conf,
     Timer t("Writing stats");
     auto method_move_map =
         conf.metafile(json_config.get("method_move_map", std::string()));
-    if (needs_addresses) {
-      write_debug_line_mapping(debug_line_map_filename, method_to_id,
-                               code_debug_lines, stores,
-                               needs_debug_line_mapping);
+    if (debug_line_map) {
+      finish_debug_line_mapping(*debug_line_map, method_to_id,
+                                code_debug_lines,
+                                std::move(needs_debug_line_mapping));
     }
     if (is_iodi(dik)) {
       iodi_metadata.write(iodi_metadata_filename, method_to_id);
@@ -1217,6 +1487,105 @@ void dump_class_method_info_map(const std::string& file_path,
 
 } // namespace
 
+/**
+ * Whether any class of the given dex files is also a preloaded library class.
+ * A normal run loads dexes before library jars, so the dex class wins; with
+ * the library class already loaded that order cannot be reproduced.
+ */
+bool dexes_shadow_preloaded_classes(const std::vector<std::string>& dex_files) {
+  for (const auto& filename : dex_files) {
+    if (filename.size() < 5 ||
+        filename.compare(filename.size() - 4, 4, ".dex") != 0) {
+      // Be conservative about DexMetadata inputs.
+      return true;
+    }
+    DexLoader loader(filename.c_str());
+    const dex_header* dh = loader.get_dex_header(filename.c_str());
+    if (dh->class_defs_size == 0) {
+      continue;
+    }
+    DexIdx idx(dh);
+    auto class_defs = reinterpret_cast<const dex_class_def*>(
+        (const uint8_t*)dh + dh->class_defs_off);
+    for (uint32_t i = 0; i < dh->class_defs_size; ++i) {
+      auto cls = type_class(idx.get_typeidx(class_defs[i].typeidx));
+      if (cls != nullptr && cls->is_external()) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+/**
+ * Handles `--daemon-client` and `--daemon-socket`. Returns nullptr for a
+ * normal invocation. A client forwards its arguments to the daemon and exits
+ * with the build's status. A daemon preloads the shared inputs and serves
+ * requests, returning only in the child forked for a request, with `argc` and
+ * `argv` replaced by the request's.
+ */
+std::unique_ptr<DaemonPreload> maybe_run_daemon(int& argc, char**& argv) {
+  auto option_value = [&](const std::string& name,
+                          std::vector<std::string>* rest) {
+    boost::optional<std::string> value;
+    for (int i = 0; i < argc; ++i) {
+      std::string arg = argv[i];
+      if (arg == name && i + 1 < argc) {
+        value = argv[++i];
+      } else if (arg.rfind(name + "=", 0) == 0) {
+        value = arg.substr(name.size() + 1);
+      } else if (rest != nullptr) {
+        rest->push_back(arg);
+      }
+    }
+    return value;
+  };
+
+  std::vector<std::string> client_args;
+  if (auto socket = option_value("--daemon-client", &client_args)) {
+    exit(redex_daemon::run_client(*socket, client_args));
+  }
+  if (!option_value("--daemon-socket", nullptr)) {
+    return nullptr;
+  }
+
+  g_redex = new RedexContext();
+  Arguments args = parse_args(argc, argv);
+  auto preloaded = std::make_unique<DaemonPreload>();
+  preloaded->proguard_config_paths = args.proguard_config_paths;
+  preloaded->jar_paths = args.jar_paths;
+  {
+    Timer t("Preloading daemon inputs");
+    g_redex->load_pointers_cache();
+    preloaded->pg_config =
+        std::make_unique<keep_rules::ProguardConfiguration>();
+    parse_proguard_configs(args, *preloaded->pg_config);
+    load_library_jars(args, *preloaded->pg_config,
+                      &preloaded->external_classes);
+  }
+  preloaded->jars_entry_data = args.entry_data["jars"];
+  preloaded->all_jar_paths = args.jar_paths;
+
+  // Only returns in a forked child.
+  preloaded->request = redex_daemon::serve(args.daemon_socket);
+  for (auto& arg : preloaded->request) {
+    preloaded->request_argv.push_back(&arg[0]);
+  }
+  preloaded->request_argv.push_back(nullptr);
+  argc = (int)preloaded->request.size();
+  argv = preloaded->request_argv.data();
+
+  Arguments request_args = parse_args(argc, argv);
+  if (request_args.proguard_config_paths !=
+          preloaded->proguard_config_paths ||
+      request_args.jar_paths != preloaded->jar_paths ||
+      dexes_shadow_preloaded_classes(request_args.dex_files)) {
+    TRACE(MAIN, 1, "Cannot reuse the daemon's preloaded inputs");
+    redex_daemon::exec_self(preloaded->request);
+  }
+  return preloaded;
+}
+
 int main(int argc, char* argv[]) {
   signal(SIGABRT, debug_backtrace_handler);
   signal(SIGINT, debug_backtrace_handler);
@@ -1230,16 +1599,28 @@ int main(int argc, char* argv[]) {
   // For better stacks in abort dumps.
   set_abort_if_not_this_thread();
 
+  // In daemon mode, this only returns in a child forked for one build.
+  std::unique_ptr<DaemonPreload> preloaded = maybe_run_daemon(argc, argv);
+
   auto maybe_global_profile =
       ScopedCommandProfiling::maybe_from_env("GLOBAL_", "global");
 
+  // Write a timeline of the timers and work queue runs, in the Chrome trace
+  // event format, when requested.
+  const char* trace_events_file = getenv("REDEX_TRACE_EVENTS_FILE");
+  if (trace_events_file != nullptr) {
+    TraceEvents::enable();
+  }
+
   std::string stats_output_path;
   Json::Value stats;
   double cpu_time_s;
   {
     Timer redex_all_main_timer("redex-all main()");
 
-    g_redex = new RedexContext();
+    if (preloaded == nullptr) {
+      g_redex = new RedexContext();
+    }
 
     // Currently there are two sources that specify the library jars:
     // 1. The jar_path argument, which may specify one library jar.
@@ -1264,15 +1645,22 @@ int main(int argc, char* argv[]) {
       std::cerr << "Slow invariants enabled." << std::endl;
     }
 
-    auto pg_config = std::make_unique<keep_rules::ProguardConfiguration>();
+    auto pg_config =
+        preloaded != nullptr
+            ? std::move(preloaded->pg_config)
+            : std::make_unique<keep_rules::ProguardConfiguration>();
     DexStoresVector stores;
+    Json::Value resumed_entry_data;
+    if (!args.resume_from_dir.empty()) {
+      resumed_entry_data = redex_resume_frontend(args, stores);
+    }
     ConfigFiles conf(args.config, args.out_dir);
 
     std::string apk_dir;
     conf.get_json_config().get("apk_dir", "", apk_dir);
     auto resources = create_resource_reader(apk_dir);
     boost::optional<int32_t> maybe_sdk = resources->get_min_sdk();
-    if (maybe_sdk != boost::none) {
+    if (maybe_sdk != boost::none && args.resume_from_dir.empty()) {
       TRACE(MAIN, 2, "parsed minSdkVersion = %d", *maybe_sdk);
       args.redex_options.min_sdk = *maybe_sdk;
     }
@@ -1280,7 +1668,10 @@ int main(int argc, char* argv[]) {
     {
       auto profile_frontend =
           ScopedCommandProfiling::maybe_from_env("FRONTEND_", "frontend");
-      redex_frontend(conf, args, *pg_config, stores, stats);
+      if (args.resume_from_dir.empty()) {
+        redex_frontend(conf, args, *pg_config, stores, stats,
+                       preloaded.get());
+      }
       conf.parse_global_config();
     }
 
@@ -1290,6 +1681,9 @@ int main(int argc, char* argv[]) {
     auto const& passes = PassRegistry::get().get_passes();
     PassManager manager(passes, std::move(pg_config), args.config,
                         args.redex_options);
+    if (!args.resume_from_dir.empty()) {
+      manager.deserialize_state(resumed_entry_data);
+    }
 
     std::unordered_map<std::string, std::string> exp_states;
     conf.get_json_config().get("ab_experiments_states", {}, exp_states);
@@ -1319,6 +1713,7 @@ int main(int argc, char* argv[]) {
                                    stores);
       }
     } else {
+      manager.serialize_state(args.entry_data);
       redex::write_all_intermediate(conf, args.out_dir, args.redex_options,
                                     stores, args.entry_data);
     }
@@ -1326,7 +1721,11 @@ int main(int argc, char* argv[]) {
     stats_output_path = conf.metafile(
         args.config.get("stats_output", "redex-stats.txt").asString());
 
-    {
+    if (args.redex_options.fast_teardown) {
+      // All output has been written, so leave the entities to the OS.
+      Timer t("Running destruction tasks");
+      g_redex->run_destruction_tasks();
+    } else {
       Timer t("Freeing global memory");
       delete g_redex;
     }
@@ -1347,6 +1746,11 @@ int main(int argc, char* argv[]) {
     out << stats;
   }
 
+  if (trace_events_file != nullptr) {
+    std::ofstream out(trace_events_file);
+    TraceEvents::write(out);
+  }
+
   TRACE(MAIN, 1, "Done.");
   if (traceEnabled(MAIN, 1) || traceEnabled(STATS, 1)) {
     TRACE(STATS, 0, "Memory stats: VmPeak=%s VmHWM=%s",
@@ -15,6 +15,8 @@ $ buck run  //native/redex:redex-tool -- dex-sql-dump  \
      --jars <ANDROID_JAR> --proguard-map <RENAME_MAP> \
      --output dex.sql
 $ sqlite3 dex.db < dex.sql
+  or, with --format csv --output <DIR>, which imports much faster:
+$ sqlite3 dex.db < <DIR>/schema.sql
 $ sqlite3 dex.db "SELECT COUNT(*) FROM dex;"   # verify sane-looking value
 $ ./native/redex/tools/redex-tool/DexSqlQuery.py dex.db
 <..enter queries..>
@@ -22,7 +24,10 @@ $ ./native/redex/tools/redex-tool/DexSqlQuery.py dex.db
 */
 
 #include <boost/algorithm/string/replace.hpp>
-#include <queue>
+#include <boost/filesystem.hpp>
+#include <memory>
+#include <numeric>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
@@ -34,169 +39,71 @@ $ ./native/redex/tools/redex-tool/DexSqlQuery.py dex.db
 #include "Show.h"
 #include "Tool.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 namespace {
 
-static std::unordered_map<DexClass*, int> class_ids;
-static std::unordered_map<DexMethod*, int> method_ids;
-static std::unordered_map<DexField*, int> field_ids;
-static std::unordered_map<DexString*, int> string_ids;
-
-void dump_field_refs(FILE* fdout,
-                     const char* prefix,
-                     DexField* field,
-                     int field_id) {
-  static int next_string_ref = 0;
-  auto* static_value = field->get_static_value();
-  if (!static_value || (static_value->evtype() != DEVT_STRING)) return;
-  auto* static_string_value = static_cast<DexEncodedValueString*>(static_value);
-  auto string_id = string_ids[static_string_value->string()];
-  fprintf(fdout,
-          "INSERT INTO %sfield_string_refs VALUES (%d, %d, %d);\n",
-          prefix,
-          next_string_ref++,
-          field_id,
-          string_id);
-}
-
-void dump_method_refs(FILE* fdout,
-                      const char* prefix,
-                      DexMethod* method,
-                      int method_id) {
-  auto code = method->get_code();
-  if (!code) return;
-
-  static int next_string_ref = 0;
-  static int next_class_ref = 0;
-  static int next_field_ref = 0;
-  static int next_method_ref = 0;
-
-  for (auto& mie : InstructionIterable(code)) {
-    auto insn = mie.insn;
-    if (insn->has_string()) {
-      if (string_ids.count(insn->get_string())) {
-        auto string_id = string_ids[insn->get_string()];
-        fprintf(fdout,
-                "INSERT INTO %smethod_string_refs VALUES (%d, %d, %d, %d);\n",
-                prefix,
-                next_string_ref++,
-                method_id,
-                string_id,
-                insn->opcode());
-      }
-    }
-    if (insn->has_type()) {
-      auto cls = type_class(insn->get_type());
-      if (cls && class_ids.count(cls)) {
-        auto class_id = class_ids[cls];
-        fprintf(fdout,
-                "INSERT INTO %smethod_class_refs VALUES (%d, %d, %d, %d);\n",
-                prefix,
-                next_class_ref++,
-                method_id,
-                class_id,
-                insn->opcode());
-      }
-    }
-    if (insn->has_field()) {
-      auto field = resolve_field(insn->get_field());
-      if (field != nullptr && field_ids.count(field)) {
-        auto field_id = field_ids[field];
-        fprintf(fdout,
-                "INSERT INTO %smethod_field_refs VALUES (%d, %d, %d, %d);\n",
-                prefix,
-                next_field_ref++,
-                method_id,
-                field_id,
-                insn->opcode());
-      }
-    }
-    if (insn->has_method()) {
-      auto meth =
-          resolve_method(insn->get_method(), opcode_to_search(insn), method);
-      if (meth != nullptr && method_ids.count(meth)) {
-        auto method_ref_id = method_ids[meth];
-        fprintf(fdout,
-                "INSERT INTO %smethod_method_refs VALUES (%d, %d, %d, %d);\n",
-                prefix,
-                next_method_ref++,
-                method_id,
-                method_ref_id,
-                insn->opcode());
-      }
-    }
-  }
-}
+struct Table {
+  const char* name;
+  // Names, and whether the column holds text.
+  std::vector<std::pair<const char*, bool>> columns;
+};
 
-void dump_class(FILE* fdout,
-                const char* prefix,
-                const char* dex_id,
-                DexClass* cls,
-                int class_id) {
-  // TODO: annotations?
-  // TODO: inheritance?
-  // TODO: string usage
-  // TODO: size estimate
-  const auto& deobfuscated_name = cls->get_deobfuscated_name();
-  fprintf(fdout,
-          "INSERT INTO %sclasses VALUES (%d,'%s','%s','%s',%u);\n",
-          prefix,
-          class_id,
-          dex_id,
-          deobfuscated_name.c_str(),
-          cls->get_name()->c_str(),
-          cls->get_access());
-}
+const Table kStrings{"strings", {{"id", false}, {"text", true}}};
+const Table kClasses{"classes",
+                     {{"id", false},
+                      {"dex", true},
+                      {"name", true},
+                      {"obfuscated_name", true},
+                      {"access", false}}};
+const Table kMethods{"methods",
+                     {{"id", false},
+                      {"class_id", false},
+                      {"name", true},
+                      {"obfuscated_name", true},
+                      {"access", false},
+                      {"code_size", false}}};
+const Table kFields{"fields",
+                    {{"id", false},
+                     {"class_id", false},
+                     {"name", true},
+                     {"obfuscated_name", true},
+                     {"access", false}}};
+const Table kIsA{
+    "is_a", {{"id", false}, {"class_id", false}, {"is_a_class_id", false}}};
+const Table kFieldStringRefs{
+    "field_string_refs",
+    {{"id", false}, {"field_id", false}, {"ref_string_id", false}}};
+const Table kMethodClassRefs{"method_class_refs",
+                             {{"id", false},
+                              {"method_id", false},
+                              {"ref_class_id", false},
+                              {"opcode", false}}};
+const Table kMethodMethodRefs{"method_method_refs",
+                              {{"id", false},
+                               {"method_id", false},
+                               {"ref_method_id", false},
+                               {"opcode", false}}};
+const Table kMethodFieldRefs{"method_field_refs",
+                             {{"id", false},
+                              {"method_id", false},
+                              {"ref_field_id", false},
+                              {"opcode", false}}};
+const Table kMethodStringRefs{"method_string_refs",
+                              {{"id", false},
+                               {"method_id", false},
+                               {"ref_string_id", false},
+                               {"opcode", false}}};
 
-void dump_field(FILE* fdout,
-                const char* prefix,
-                int class_id,
-                DexField* field,
-                int field_id) {
-  // TODO: more fixup here on this crapped up name/signature
-  // TODO: break down signature
-  // TODO: annotations?
-  // TODO: string usage (encoded_value for static fields)
-  const auto& deobfuscated_name = field->get_deobfuscated_name();
-  auto field_name = strchr(deobfuscated_name.c_str(), ';');
-  fprintf(fdout,
-          "INSERT INTO %sfields VALUES(%d, %d, '%s', '%s', %u);\n",
-          prefix,
-          field_id,
-          class_id,
-          field_name,
-          field->get_name()->c_str(),
-          field->get_access());
-}
+const Table* const kAllTables[] = {
+    &kStrings,         &kClasses,          &kMethods,
+    &kFields,          &kIsA,              &kFieldStringRefs,
+    &kMethodClassRefs, &kMethodMethodRefs, &kMethodFieldRefs,
+    &kMethodStringRefs};
 
-void dump_method(FILE* fdout,
-                 const char* prefix,
-                 int class_id,
-                 DexMethod* method,
-                 int method_id) {
-  // TODO: more fixup here on this crapped up name/signature
-  // TODO: break down signature
-  // TODO: throws?
-  // TODO: annotations?
-  // TODO: string usage
-  // TODO: size estimate
-  auto deobfuscated_name = method->get_deobfuscated_name();
-  auto method_name = strchr(deobfuscated_name.c_str(), ';');
-  fprintf(fdout,
-          "INSERT INTO %smethods VALUES (%d,%d,'%s','%s',%d,%lu);\n",
-          prefix,
-          method_id,
-          class_id,
-          method_name,
-          method->get_name()->c_str(),
-          method->get_access(),
-          method->get_code() ? method->get_code()->sum_opcode_sizes() : 0);
-}
+using Row = std::vector<std::string>;
 
-void dump_sql(FILE* fdout,
-              DexStoresVector& stores,
-              ProguardMap& pg_map,
-              const char* prefix) {
+void print_schema(FILE* fdout, const char* prefix) {
   fprintf(fdout,
           R"___(
 DROP TABLE IF EXISTS %1$sfield_string_refs;
@@ -271,13 +178,333 @@ CREATE TABLE %1$smethod_string_refs (
 );
 )___",
           prefix);
+}
+
+class TableWriter {
+ public:
+  virtual ~TableWriter() {}
+  virtual void begin_transaction() {}
+  virtual void end_transaction() {}
+  virtual void add_row(const Table& table, const Row& row) = 0;
+};
+
+/*
+ * A SQL insertion script. Rows are batched into multi-row INSERTs per table,
+ * which SQLite imports many times faster than one INSERT per row.
+ */
+class SqlWriter : public TableWriter {
+ public:
+  static constexpr size_t kRowsPerInsert = 500;
+
+  SqlWriter(FILE* fdout, const std::string& prefix)
+      : m_fdout(fdout), m_prefix(prefix) {
+    print_schema(m_fdout, m_prefix.c_str());
+  }
+
+  void begin_transaction() override {
+    fprintf(m_fdout, "BEGIN TRANSACTION;\n");
+  }
+
+  void end_transaction() override {
+    for (const auto* table : kAllTables) {
+      flush(*table, &m_pending[table]);
+    }
+    fprintf(m_fdout, "END TRANSACTION;\n");
+  }
+
+  void add_row(const Table& table, const Row& row) override {
+    auto& pending = m_pending[&table];
+    pending.append(pending.empty() ? "(" : ",\n(");
+    for (size_t i = 0; i < row.size(); ++i) {
+      if (i > 0) {
+        pending.push_back(',');
+      }
+      if (table.columns[i].second) {
+        // Escape string before inserting. ' -> ''
+        std::string esc(row[i]);
+        boost::replace_all(esc, "'", "''");
+        pending.append("'").append(esc).append("'");
+      } else {
+        pending.append(row[i]);
+      }
+    }
+    pending.push_back(')');
+    if (++m_pending_rows[&table] == kRowsPerInsert) {
+      flush(table, &pending);
+    }
+  }
+
+ private:
+  void flush(const Table& table, std::string* pending) {
+    if (pending->empty()) {
+      return;
+    }
+    fprintf(m_fdout, "INSERT INTO %s%s VALUES\n%s;\n", m_prefix.c_str(),
+            table.name, pending->c_str());
+    pending->clear();
+    m_pending_rows[&table] = 0;
+  }
+
+  FILE* m_fdout;
+  std::string m_prefix;
+  std::unordered_map<const Table*, std::string> m_pending;
+  std::unordered_map<const Table*, size_t> m_pending_rows;
+};
+
+/*
+ * One CSV file per table, with a header line, plus a schema.sql that creates
+ * the tables and imports the files when fed to sqlite3.
+ */
+class CsvWriter : public TableWriter {
+ public:
+  CsvWriter(const std::string& dir, const std::string& prefix)
+      : m_dir(dir), m_prefix(prefix) {
+    boost::filesystem::create_directories(m_dir);
+    auto schema_path = path("schema.sql");
+    FILE* schema = fopen(schema_path.c_str(), "w");
+    if (!schema) {
+      fprintf(stderr, "Could not open %s for writing; terminating\n",
+              schema_path.c_str());
+      exit(EXIT_FAILURE);
+    }
+    print_schema(schema, m_prefix.c_str());
+    for (const auto* table : kAllTables) {
+      fprintf(schema, ".import --csv --skip 1 '%s' %s%s\n",
+              path(m_prefix + table->name + ".csv").c_str(), m_prefix.c_str(),
+              table->name);
+      // Tables without rows still get their file, with the header only.
+      file(*table);
+    }
+    fclose(schema);
+  }
+
+  ~CsvWriter() override {
+    for (auto& p : m_files) {
+      fclose(p.second);
+    }
+  }
+
+  void add_row(const Table& table, const Row& row) override {
+    auto* fdout = file(table);
+    for (size_t i = 0; i < row.size(); ++i) {
+      if (i > 0) {
+        fputc(',', fdout);
+      }
+      if (table.columns[i].second) {
+        std::string esc(row[i]);
+        boost::replace_all(esc, "\"", "\"\"");
+        fprintf(fdout, "\"%s\"", esc.c_str());
+      } else {
+        fputs(row[i].c_str(), fdout);
+      }
+    }
+    fputc('\n', fdout);
+  }
+
+ private:
+  std::string path(const std::string& name) const {
+    return (boost::filesystem::path(m_dir) / name).string();
+  }
+
+  FILE* file(const Table& table) {
+    auto it = m_files.find(&table);
+    if (it != m_files.end()) {
+      return it->second;
+    }
+    auto file_path = path(m_prefix + table.name + ".csv");
+    FILE* fdout = fopen(file_path.c_str(), "w");
+    if (!fdout) {
+      fprintf(stderr, "Could not open %s for writing; terminating\n",
+              file_path.c_str());
+      exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < table.columns.size(); ++i) {
+      fprintf(fdout, i > 0 ? ",%s" : "%s", table.columns[i].first);
+    }
+    fputc('\n', fdout);
+    m_files.emplace(&table, fdout);
+    return fdout;
+  }
+
+  std::string m_dir;
+  std::string m_prefix;
+  std::unordered_map<const Table*, FILE*> m_files;
+};
+
+struct ItemIds {
+  std::unordered_map<const DexClass*, int> classes;
+  std::unordered_map<const DexMethod*, int> methods;
+  std::unordered_map<const DexField*, int> fields;
+  std::unordered_map<const DexString*, int> strings;
+};
+
+// The rows that reference other items, without their id, which is only
+// assigned when they are written, in class order.
+struct RefRows {
+  std::vector<std::pair<const Table*, Row>> rows;
+
+  void add(const Table& table, Row row) {
+    rows.emplace_back(&table, std::move(row));
+  }
+};
+
+void dump_field_refs(const ItemIds& ids,
+                     const DexField* field,
+                     RefRows* refs) {
+  auto* static_value = field->get_static_value();
+  if (!static_value || (static_value->evtype() != DEVT_STRING)) return;
+  auto* static_string_value = static_cast<DexEncodedValueString*>(static_value);
+  auto it = ids.strings.find(static_string_value->string());
+  if (it == ids.strings.end()) return;
+  refs->add(kFieldStringRefs,
+            {std::to_string(ids.fields.at(field)), std::to_string(it->second)});
+}
+
+void dump_method_refs(const ItemIds& ids, DexMethod* method, RefRows* refs) {
+  auto code = method->get_code();
+  if (!code) return;
+
+  auto method_id = std::to_string(ids.methods.at(method));
+  for (auto& mie : InstructionIterable(code)) {
+    auto insn = mie.insn;
+    auto opcode = std::to_string(insn->opcode());
+    if (insn->has_string()) {
+      auto it = ids.strings.find(insn->get_string());
+      if (it != ids.strings.end()) {
+        refs->add(kMethodStringRefs,
+                  {method_id, std::to_string(it->second), opcode});
+      }
+    }
+    if (insn->has_type()) {
+      auto cls = type_class(insn->get_type());
+      auto it = ids.classes.find(cls);
+      if (cls && it != ids.classes.end()) {
+        refs->add(kMethodClassRefs,
+                  {method_id, std::to_string(it->second), opcode});
+      }
+    }
+    if (insn->has_field()) {
+      auto field = resolve_field(insn->get_field());
+      auto it = ids.fields.find(field);
+      if (field != nullptr && it != ids.fields.end()) {
+        refs->add(kMethodFieldRefs,
+                  {method_id, std::to_string(it->second), opcode});
+      }
+    }
+    if (insn->has_method()) {
+      auto meth =
+          resolve_method(insn->get_method(), opcode_to_search(insn), method);
+      auto it = ids.methods.find(meth);
+      if (meth != nullptr && it != ids.methods.end()) {
+        refs->add(kMethodMethodRefs,
+                  {method_id, std::to_string(it->second), opcode});
+      }
+    }
+  }
+}
+
+void dump_class(TableWriter& writer,
+                const char* dex_id,
+                DexClass* cls,
+                int class_id) {
+  // TODO: annotations?
+  // TODO: inheritance?
+  // TODO: string usage
+  // TODO: size estimate
+  writer.add_row(kClasses,
+                 {std::to_string(class_id), dex_id,
+                  cls->get_deobfuscated_name(), cls->get_name()->str(),
+                  std::to_string(cls->get_access())});
+}
+
+// The part of a deobfuscated member name after the class.
+std::string member_name(const std::string& deobfuscated_name) {
+  auto pos = deobfuscated_name.find(';');
+  return pos == std::string::npos ? deobfuscated_name
+                                  : deobfuscated_name.substr(pos);
+}
+
+void dump_field(TableWriter& writer,
+                int class_id,
+                DexField* field,
+                int field_id) {
+  // TODO: more fixup here on this crapped up name/signature
+  // TODO: break down signature
+  // TODO: annotations?
+  // TODO: string usage (encoded_value for static fields)
+  writer.add_row(kFields,
+                 {std::to_string(field_id), std::to_string(class_id),
+                  member_name(field->get_deobfuscated_name()),
+                  field->get_name()->str(),
+                  std::to_string(field->get_access())});
+}
+
+void dump_method(TableWriter& writer,
+                 int class_id,
+                 DexMethod* method,
+                 int method_id) {
+  // TODO: more fixup here on this crapped up name/signature
+  // TODO: break down signature
+  // TODO: throws?
+  // TODO: annotations?
+  // TODO: string usage
+  // TODO: size estimate
+  auto code_size =
+      method->get_code() ? method->get_code()->sum_opcode_sizes() : 0;
+  writer.add_row(
+      kMethods,
+      {std::to_string(method_id), std::to_string(class_id),
+       member_name(method->get_deobfuscated_name()), method->get_name()->str(),
+       std::to_string(method->get_access()), std::to_string(code_size)});
+}
+
+// Classes are processed in parallel in chunks of this many per thread, so
+// that only the rows of a chunk are buffered at a time.
+constexpr size_t kClassesPerThread = 256;
+
+/*
+ * Computes the rows of each class in parallel, a chunk of classes at a time,
+ * and writes them in class order, numbering the rows of each table as it
+ * goes. The output is the same as with a sequential walk.
+ */
+template <typename Fn>
+void dump_in_parallel(TableWriter& writer,
+                      const std::vector<DexClass*>& classes,
+                      const Fn& fn) {
+  std::unordered_map<const Table*, int> next_ids;
+  size_t chunk_size =
+      kClassesPerThread * redex_parallel::default_num_threads();
+  std::vector<RefRows> chunk_refs;
+  for (size_t begin = 0; begin < classes.size(); begin += chunk_size) {
+    auto end = std::min(classes.size(), begin + chunk_size);
+    chunk_refs.clear();
+    chunk_refs.resize(end - begin);
+    std::vector<size_t> indices(end - begin);
+    std::iota(indices.begin(), indices.end(), 0);
+    workqueue_run<size_t>(
+        [&](size_t i) { fn(classes[begin + i], &chunk_refs[i]); }, indices);
+    for (auto& refs : chunk_refs) {
+      for (auto& p : refs.rows) {
+        auto& row = p.second;
+        row.insert(row.begin(), std::to_string(next_ids[p.first]++));
+        writer.add_row(*p.first, row);
+      }
+    }
+  }
+}
+
+void dump_tables(TableWriter& writer,
+                 DexStoresVector& stores,
+                 ProguardMap& pg_map) {
   int next_class_id = 0;
   int next_method_id = 0;
   int next_field_id = 0;
   int next_string_id = 0;
+  ItemIds ids;
+  std::vector<DexClass*> classes;
 
   // Dump all dex items
-  fprintf(fdout, "BEGIN TRANSACTION;\n");
+  writer.begin_transaction();
   for (auto& store : stores) {
     auto store_name = store.get_name();
     auto& dexen = store.get_dexen();
@@ -288,96 +515,75 @@ CREATE TABLE %1$smethod_string_refs (
       auto strings = gtypes.get_cls_order_dexstring_emitlist();
       for (auto dexstr : strings) {
         int id = next_string_id++;
-        string_ids[dexstr] = id;
-        // Escape string before inserting. ' -> ''
-        std::string esc(dexstr->c_str());
-        boost::replace_all(esc, "'", "''");
-        fprintf(fdout,
-                "INSERT INTO %sstrings VALUES(%d, '%s');\n",
-                prefix,
-                id,
-                esc.c_str());
+        ids.strings[dexstr] = id;
+        writer.add_row(kStrings, {std::to_string(id), dexstr->str()});
       }
       std::string dex_id_str(store_name + "/" + std::to_string(dex_idx));
       const char* dex_id = dex_id_str.c_str();
       for (const auto& cls : dex) {
         int class_id = next_class_id++;
-        dump_class(fdout, prefix, dex_id, cls, class_id);
-        class_ids[cls] = class_id;
+        dump_class(writer, dex_id, cls, class_id);
+        ids.classes[cls] = class_id;
+        classes.push_back(cls);
         for (auto field : cls->get_ifields()) {
           int field_id = next_field_id++;
-          field_ids[field] = field_id;
-          dump_field(fdout, prefix, class_id, field, field_id);
+          ids.fields[field] = field_id;
+          dump_field(writer, class_id, field, field_id);
         }
         for (auto field : cls->get_sfields()) {
           int field_id = next_field_id++;
-          field_ids[field] = field_id;
-          dump_field(fdout, prefix, class_id, field, field_id);
+          ids.fields[field] = field_id;
+          dump_field(writer, class_id, field, field_id);
         }
         for (const auto& meth : cls->get_dmethods()) {
           int meth_id = next_method_id++;
-          method_ids[meth] = meth_id;
-          dump_method(fdout, prefix, class_id, meth, meth_id);
+          ids.methods[meth] = meth_id;
+          dump_method(writer, class_id, meth, meth_id);
         }
         for (auto& meth : cls->get_vmethods()) {
           int meth_id = next_method_id++;
-          method_ids[meth] = meth_id;
-          dump_method(fdout, prefix, class_id, meth, meth_id);
+          ids.methods[meth] = meth_id;
+          dump_method(writer, class_id, meth, meth_id);
         }
       }
     }
   }
-  fprintf(fdout, "END TRANSACTION;\n");
+  writer.end_transaction();
 
   // Dump references
-  fprintf(fdout, "BEGIN TRANSACTION;\n");
-  for (auto& store : stores) {
-    auto& dexen = store.get_dexen();
-    for (size_t dex_idx = 0; dex_idx < dexen.size(); ++dex_idx) {
-      auto& dex = dexen[dex_idx];
-      for (const auto& cls : dex) {
-        for (const auto& meth : cls->get_dmethods()) {
-          int meth_id = method_ids[meth];
-          dump_method_refs(fdout, prefix, meth, meth_id);
-        }
-        for (auto& meth : cls->get_vmethods()) {
-          int meth_id = method_ids[meth];
-          dump_method_refs(fdout, prefix, meth, meth_id);
-        }
-        for (const auto& field : cls->get_sfields()) {
-          int field_id = field_ids[field];
-          dump_field_refs(fdout, prefix, field, field_id);
-        }
-        for (const auto& field : cls->get_ifields()) {
-          int field_id = field_ids[field];
-          dump_field_refs(fdout, prefix, field, field_id);
-        }
-      }
+  writer.begin_transaction();
+  dump_in_parallel(writer, classes, [&ids](DexClass* cls, RefRows* refs) {
+    for (const auto& meth : cls->get_dmethods()) {
+      dump_method_refs(ids, meth, refs);
     }
-  }
-  fprintf(fdout, "END TRANSACTION;\n");
+    for (auto& meth : cls->get_vmethods()) {
+      dump_method_refs(ids, meth, refs);
+    }
+    for (const auto& field : cls->get_sfields()) {
+      dump_field_refs(ids, field, refs);
+    }
+    for (const auto& field : cls->get_ifields()) {
+      dump_field_refs(ids, field, refs);
+    }
+  });
+  writer.end_transaction();
 
   // Dump hierarchy
   auto scope = build_class_scope(stores);
   ClassHierarchy ch = build_type_hierarchy(scope);
-  int next_is_a_id = 0;
-  fprintf(fdout, "BEGIN TRANSACTION;\n");
-  for (auto& cls : scope) {
+  writer.begin_transaction();
+  dump_in_parallel(writer, scope, [&](DexClass* cls, RefRows* refs) {
     TypeSet results;
     get_all_children_or_implementors(ch, scope, cls, results);
     for (auto type : results) {
-      auto type_cls = type_class(type);
-      if (type_cls) {
-        fprintf(fdout,
-                "INSERT INTO %sis_a VALUES(%d, %d, %d);\n",
-                prefix,
-                next_is_a_id++,
-                class_ids[type_cls],
-                class_ids[cls]);
+      auto it = ids.classes.find(type_class(type));
+      if (it != ids.classes.end()) {
+        refs->add(kIsA, {std::to_string(it->second),
+                         std::to_string(ids.classes.at(cls))});
       }
     }
-  }
-  fprintf(fdout, "END TRANSACTION;\n");
+  });
+  writer.end_transaction();
 }
 
 class DexSqlDump : public Tool {
@@ -396,7 +602,11 @@ class DexSqlDump : public Tool {
         "path to output sql dump file (defaults to "
         "stdout)")("table-prefix,t",
                    po::value<std::string>()->value_name("pre_"),
-                   "prefix to use on all table names");
+                   "prefix to use on all table names")(
+        "format,f",
+        po::value<std::string>()->value_name("sql|csv"),
+        "sql for an insertion script (the default), or csv for a directory "
+        "of CSV files, given by --output, and an import script");
   }
 
   void run(const po::variables_map& options) override {
@@ -406,20 +616,38 @@ class DexSqlDump : public Tool {
     ProguardMap pgmap(options.count("proguard-map")
                           ? options["proguard-map"].as<std::string>()
                           : "/dev/null");
-    const std::string& filename = options["output"].as<std::string>();
-    FILE* fdout =
-        options.count("output") ? fopen(filename.c_str(), "w") : stdout;
     std::string prefix = options.count("table-prefix")
                              ? options["table-prefix"].as<std::string>()
                              : "";
+    std::string format =
+        options.count("format") ? options["format"].as<std::string>() : "sql";
+    if (format == "csv") {
+      if (!options.count("output")) {
+        fprintf(stderr, "--format csv requires an --output directory\n");
+        exit(EXIT_FAILURE);
+      }
+      CsvWriter writer(options["output"].as<std::string>(), prefix);
+      dump_tables(writer, stores, pgmap);
+      return;
+    }
+    if (format != "sql") {
+      fprintf(stderr, "Unknown format %s; terminating\n", format.c_str());
+      exit(EXIT_FAILURE);
+    }
+    std::string filename =
+        options.count("output") ? options["output"].as<std::string>() : "";
+    FILE* fdout =
+        options.count("output") ? fopen(filename.c_str(), "w") : stdout;
     if (!fdout) {
       fprintf(stderr,
               "Could not open %s for writing; terminating\n",
               filename.c_str());
       exit(EXIT_FAILURE);
     }
-    auto* pfx_cstr = prefix.c_str();
-    dump_sql(fdout, stores, pgmap, pfx_cstr);
+    {
+      SqlWriter writer(fdout, prefix);
+      dump_tables(writer, stores, pgmap);
+    }
     fclose(fdout);
   }
 };
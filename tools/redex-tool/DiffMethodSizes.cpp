@@ -9,6 +9,7 @@
 #include "DexInstruction.h"
 #include "DexUtil.h"
 #include "JarLoader.h"
+#include "MethodSizeMap.h"
 #include "ProguardConfiguration.h"
 #include "ProguardParser.h"
 #include "ReachableClasses.h"
@@ -278,6 +279,40 @@ void dump_method_move_info_from_dex_dir(const std::string& dex_dir) {
   }
 }
 
+void diff_size_maps(const std::string& path_A, const std::string& path_B) {
+  using namespace method_sizes;
+  MethodSizeMap A;
+  MethodSizeMap B;
+  if (!A.read(path_A) || !B.read(path_B)) {
+    return;
+  }
+  std::cout << "INFO: " << A.methods().size() << " and " << B.methods().size()
+            << " methods loaded" << std::endl;
+
+  auto code_size = [](const MethodSize& method) -> int64_t {
+    return method.code_size == kNoCode ? 0 : method.code_size;
+  };
+  int64_t total_code_size = 0;
+  merge(A, B, [&](const MethodSize* a, const MethodSize* b) {
+    if (a == nullptr) {
+      std::cout << "ADDED: " << B.name(*b) << " " << code_size(*b) << " "
+                << b->registers_size << "\n";
+      total_code_size += code_size(*b);
+    } else if (b == nullptr) {
+      std::cout << "REMOVED: " << A.name(*a) << " " << code_size(*a) << " "
+                << a->registers_size << "\n";
+      total_code_size -= code_size(*a);
+    } else if (code_size(*a) != code_size(*b) ||
+               a->registers_size != b->registers_size) {
+      std::cout << "DIFF: " << A.name(*a) << " "
+                << code_size(*b) - code_size(*a) << " "
+                << b->registers_size - a->registers_size << "\n";
+      total_code_size += code_size(*b) - code_size(*a);
+    }
+  });
+  std::cout << "TOTAL DIFF: code size: " << total_code_size << std::endl;
+}
+
 class DiffMethodSizes : public Tool {
  public:
   DiffMethodSizes() : Tool("diff-method-sizes", "compare method sizes") {}
@@ -291,14 +326,13 @@ class DiffMethodSizes : public Tool {
         "dexendir,d",
         po::value<std::vector<std::string>>()->multitoken(),
         "dump all method sizes in the given dexen directory; if two dexen "
-        "directories are given, compare the method sizes")("show-moves,s",
-                                                           po::value<std::vector<
-                                                               std::string>>()
-                                                               ->multitoken(),
-                                                           "show number of "
-                                                           "move code and "
-                                                           "their size for "
-                                                           "each methods");
+        "directories are given, compare the method sizes")(
+        "show-moves,s",
+        po::value<std::vector<std::string>>()->multitoken(),
+        "show number of move code and their size for each methods")(
+        "size-maps,m",
+        po::value<std::vector<std::string>>()->multitoken(),
+        "compare two binary size maps written by size-map --binary");
   }
 
   void run(const po::variables_map& options) override {
@@ -320,6 +354,14 @@ class DiffMethodSizes : public Tool {
         std::cerr << "Only one or two --dexendir can be provided" << std::endl;
         break;
       }
+    } else if (!options["size-maps"].empty()) {
+      const auto& size_maps =
+          options["size-maps"].as<std::vector<std::string>>();
+      if (size_maps.size() != 2) {
+        std::cerr << "Exactly two --size-maps must be provided" << std::endl;
+        return;
+      }
+      diff_size_maps(size_maps[0], size_maps[1]);
     } else if (!options["show-moves"].empty()) {
       const auto& dex_dirs =
           options["show-moves"].as<std::vector<std::string>>();
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "MethodSizeMap.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+
+#include "Debug.h"
+#include "DexClass.h"
+#include "DexUtil.h"
+#include "WorkQueue.h"
+
+namespace method_sizes {
+
+namespace {
+
+constexpr uint32_t kMagic = 0x315a5352; // "RSZ1"
+
+static_assert(sizeof(MethodSize) == 24, "MethodSize is written as is");
+
+} // namespace
+
+uint64_t method_id(const std::string& name) {
+  // FNV-1a, so that ids stay the same across builds of the tool.
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (unsigned char c : name) {
+    hash = (hash ^ c) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+MethodSizeMap MethodSizeMap::from_stores(const DexStoresVector& stores) {
+  auto scope = build_class_scope(stores);
+  // Each class fills the slots that a sequential walk would give it.
+  std::vector<size_t> first_method(scope.size() + 1, 0);
+  for (size_t i = 0; i < scope.size(); ++i) {
+    first_method[i + 1] = first_method[i] + scope[i]->get_dmethods().size() +
+                          scope[i]->get_vmethods().size();
+  }
+  std::vector<MethodSize> methods(first_method.back());
+  std::vector<std::string> names(first_method.back());
+  std::vector<size_t> indices(scope.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  workqueue_run<size_t>(
+      [&](size_t i) {
+        auto slot = first_method[i];
+        auto attribute = [&](const DexMethod* method) {
+          auto& size = methods[slot];
+          names[slot] = method->get_fully_deobfuscated_name();
+          size.id = method_id(names[slot]);
+          const auto* code = method->get_dex_code();
+          size.code_size = code ? code->size() : kNoCode;
+          size.registers_size = code ? code->get_registers_size() : 0;
+          size.flags = (method->is_virtual() ? kVirtual : 0) |
+                       (method->is_external() ? kExternal : 0) |
+                       (method->is_concrete() ? kConcrete : 0);
+          ++slot;
+        };
+        for (const auto* method : scope[i]->get_dmethods()) {
+          attribute(method);
+        }
+        for (const auto* method : scope[i]->get_vmethods()) {
+          attribute(method);
+        }
+      },
+      indices);
+
+  MethodSizeMap map;
+  size_t names_size = 0;
+  for (const auto& name : names) {
+    names_size += name.size() + 1;
+  }
+  map.m_names.reserve(names_size);
+  for (size_t i = 0; i < methods.size(); ++i) {
+    methods[i].name_offset = map.m_names.size();
+    map.m_names.append(names[i]).push_back('\0');
+  }
+  map.m_methods = std::move(methods);
+  return map;
+}
+
+void MethodSizeMap::sort_by_id() {
+  std::sort(m_methods.begin(),
+            m_methods.end(),
+            [](const MethodSize& a, const MethodSize& b) {
+              return a.id < b.id;
+            });
+  for (size_t i = 1; i < m_methods.size(); ++i) {
+    always_assert_log(m_methods[i - 1].id != m_methods[i].id,
+                      "Methods %s and %s have the same id",
+                      name(m_methods[i - 1]), name(m_methods[i]));
+  }
+}
+
+bool MethodSizeMap::read(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    std::cerr << "Unable to open '" << path << "'" << std::endl;
+    return false;
+  }
+  uint32_t header[3];
+  if (!in.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+      header[0] != kMagic) {
+    std::cerr << "'" << path << "' is not a method size map" << std::endl;
+    return false;
+  }
+  m_methods.resize(header[1]);
+  m_names.resize(header[2]);
+  in.read(reinterpret_cast<char*>(m_methods.data()),
+          m_methods.size() * sizeof(MethodSize));
+  in.read(&m_names[0], m_names.size());
+  if (!in) {
+    std::cerr << "'" << path << "' is truncated" << std::endl;
+    return false;
+  }
+  for (const auto& method : m_methods) {
+    if (method.name_offset >= m_names.size()) {
+      std::cerr << "'" << path << "' is corrupt" << std::endl;
+      return false;
+    }
+  }
+  if (!m_names.empty() && m_names.back() != '\0') {
+    std::cerr << "'" << path << "' is corrupt" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool MethodSizeMap::write(const std::string& path) const {
+  always_assert(std::is_sorted(
+      m_methods.begin(), m_methods.end(),
+      [](const MethodSize& a, const MethodSize& b) { return a.id < b.id; }));
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  uint32_t header[3] = {kMagic, (uint32_t)m_methods.size(),
+                        (uint32_t)m_names.size()};
+  out.write(reinterpret_cast<const char*>(header), sizeof(header));
+  out.write(reinterpret_cast<const char*>(m_methods.data()),
+            m_methods.size() * sizeof(MethodSize));
+  out.write(m_names.data(), m_names.size());
+  out.close();
+  if (!out) {
+    std::cerr << "Unable to write '" << path << "'" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+} // namespace method_sizes
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "DexStore.h"
+
+/*
+ * Compact binary form of the per-method sizes of an app, written by size-map
+ * and compared by diff-method-sizes. Methods are keyed by a stable hash of
+ * their deobfuscated name and stored sorted by it, so that two maps diff in a
+ * single merge, without building any string maps.
+ *
+ * Layout, in host byte order:
+ *
+ *   uint32_t magic, num_methods, names_size
+ *   MethodSize methods[num_methods]   (sorted by id)
+ *   char names[names_size]            (null-terminated names)
+ */
+namespace method_sizes {
+
+enum MethodFlags : uint16_t {
+  kVirtual = 1,
+  kExternal = 2,
+  kConcrete = 4,
+};
+
+// The code size of methods without code.
+constexpr uint32_t kNoCode = 0xffffffff;
+
+struct MethodSize {
+  uint64_t id;
+  uint32_t name_offset;
+  // In 16-bit code units.
+  uint32_t code_size;
+  uint16_t registers_size;
+  uint16_t flags;
+  uint32_t padding;
+};
+
+uint64_t method_id(const std::string& name);
+
+class MethodSizeMap {
+ public:
+  // Attributes the sizes of all the methods of the stores, one class per
+  // task. The methods are in the order of a sequential walk until sorted.
+  static MethodSizeMap from_stores(const DexStoresVector& stores);
+
+  // Returns false, after printing why, if the file cannot be read.
+  bool read(const std::string& path);
+
+  // The map must be sorted. Returns false, after printing why, if the file
+  // cannot be written.
+  bool write(const std::string& path) const;
+
+  void sort_by_id();
+
+  const std::vector<MethodSize>& methods() const { return m_methods; }
+
+  const char* name(const MethodSize& method) const {
+    return m_names.data() + method.name_offset;
+  }
+
+ private:
+  std::vector<MethodSize> m_methods;
+  std::string m_names;
+};
+
+/*
+ * Calls fn(a, b) for each method of either sorted map, in id order, with
+ * nullptr for the map that does not have it.
+ */
+template <typename Fn>
+void merge(const MethodSizeMap& a, const MethodSizeMap& b, const Fn& fn) {
+  auto it_a = a.methods().begin();
+  auto it_b = b.methods().begin();
+  while (it_a != a.methods().end() || it_b != b.methods().end()) {
+    if (it_b == b.methods().end() ||
+        (it_a != a.methods().end() && it_a->id < it_b->id)) {
+      fn(&*it_a++, nullptr);
+    } else if (it_a == a.methods().end() || it_b->id < it_a->id) {
+      fn(nullptr, &*it_b++);
+    } else {
+      fn(&*it_a++, &*it_b++);
+    }
+  }
+}
+
+} // namespace method_sizes
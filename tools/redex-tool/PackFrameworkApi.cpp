@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+// Workflow:
+//
+// $ redex-tool pack-framework-api \
+//      --input framework_classes_api_21.txt \
+//      --output framework_classes_api_21.bin
+//
+// Converts a framework api file to the packed format that AndroidSDK maps,
+// so that the android_sdk_api_*_file configs can point to it instead.
+
+#include <iostream>
+
+#include "FrameworkApi.h"
+#include "Tool.h"
+
+namespace {
+
+class PackFrameworkApi : public Tool {
+ public:
+  PackFrameworkApi()
+      : Tool("pack-framework-api",
+             "convert a framework api file to the packed format") {}
+
+  void add_options(po::options_description& options) const override {
+    options.add_options()(
+        "input,i",
+        po::value<std::string>()->required()->value_name(
+            "framework_classes_api_21.txt"),
+        "path to a framework api file in the text format")(
+        "output,o",
+        po::value<std::string>()->required()->value_name(
+            "framework_classes_api_21.bin"),
+        "path to the packed framework api file to write");
+  }
+
+  void run(const po::variables_map& options) override {
+    if (!api::AndroidSDK::write_packed_file(
+            options["input"].as<std::string>(),
+            options["output"].as<std::string>())) {
+      exit(EXIT_FAILURE);
+    }
+  }
+};
+
+static PackFrameworkApi s_tool;
+
+} // namespace
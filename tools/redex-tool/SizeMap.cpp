@@ -8,9 +8,8 @@
 #include <iostream>
 
 #include "DexOutput.h"
-#include "Show.h"
+#include "MethodSizeMap.h"
 #include "Tool.h"
-#include "Walkers.h"
 
 /*
  * This tool dumps method size and property information.
@@ -19,23 +18,21 @@
  * Lcom/foo/bar;.<init>:()V, 38, 0, 0, 1
  * Lcom/foo/bar;.enableSomething:(Landroid/content/Context;)V, 67, 0, 0, 1
  * ...
+ *
+ * With --binary, it writes the compact format of MethodSizeMap.h instead,
+ * which diff-method-sizes --size-maps compares.
  */
 namespace {
-void dump_sizes(std::ostream& ofs, DexStoresVector& stores) {
-  auto print = [&](DexMethod* method) {
-    ofs << method->get_fully_deobfuscated_name() << ", "
-        << (method->get_dex_code() ? method->get_dex_code()->size() : -1)
-        << ", " << method->is_virtual() << ", " << method->is_external() << ", "
-        << method->is_concrete() << std::endl;
-  };
-  walk::classes(build_class_scope(stores), [&](DexClass* cls) {
-    for (auto dmethod : cls->get_dmethods()) {
-      print(dmethod);
-    }
-    for (auto vmethod : cls->get_vmethods()) {
-      print(vmethod);
-    }
-  });
+using namespace method_sizes;
+
+void dump_sizes(std::ostream& ofs, const MethodSizeMap& sizes) {
+  for (const auto& method : sizes.methods()) {
+    // Methods without code print kNoCode, as they always have.
+    ofs << sizes.name(method) << ", " << method.code_size << ", "
+        << !!(method.flags & kVirtual) << ", "
+        << !!(method.flags & kExternal) << ", "
+        << !!(method.flags & kConcrete) << "\n";
+  }
 }
 
 class SizeMap : public Tool {
@@ -50,7 +47,10 @@ class SizeMap : public Tool {
         "path to a rename map")(
         "output,o",
         po::value<std::string>()->value_name("dex.sql"),
-        "path to output size map file (defaults to stdout)");
+        "path to output size map file (defaults to stdout)")(
+        "binary,b",
+        "write the binary format that diff-method-sizes --size-maps reads "
+        "(requires --output)");
   }
 
   void run(const po::variables_map& options) override {
@@ -68,13 +68,24 @@ class SizeMap : public Tool {
       apply_deobfuscated_names(dexen, pgmap);
     }
 
+    auto sizes = MethodSizeMap::from_stores(stores);
+    if (options.count("binary")) {
+      if (!options.count("output")) {
+        std::cerr << "--binary requires --output" << std::endl;
+        return;
+      }
+      sizes.sort_by_id();
+      sizes.write(options["output"].as<std::string>());
+      return;
+    }
+
     std::ofstream ofs;
     if (options.count("output")) {
       ofs.open(options["output"].as<std::string>(),
                std::ofstream::out | std::ofstream::trunc);
-      dump_sizes(ofs, stores);
+      dump_sizes(ofs, sizes);
     } else {
-      dump_sizes(std::cout, stores);
+      dump_sizes(std::cout, sizes);
     }
   }
 };
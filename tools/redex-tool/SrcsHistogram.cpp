@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+// Workflow:
+//
+// $ redex-tool srcs-histogram \
+//      --apkdir <APKDIR> --dexendir <DEXEN_DIR> \
+//      --jars <ANDROID_JAR>
+//
+// Prints how many source registers the instructions of the given dexes have,
+// split by kind of instruction, and how long ballooning and building CFGs
+// takes. Useful to size the inline source storage of IRInstruction.
+
+#include <array>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#include "ControlFlow.h"
+#include "DexClass.h"
+#include "IRCode.h"
+#include "IRInstruction.h"
+#include "Tool.h"
+#include "Walkers.h"
+
+namespace {
+
+constexpr size_t kMaxBucket = 16; // Last bucket counts kMaxBucket and more.
+
+enum Kind { INVOKE, INVOKE_RANGE, FILLED_NEW_ARRAY, OTHER, NUM_KINDS };
+
+const char* kind_name(Kind kind) {
+  switch (kind) {
+  case INVOKE:
+    return "invoke";
+  case INVOKE_RANGE:
+    return "invoke/range";
+  case FILLED_NEW_ARRAY:
+    return "filled-new-array";
+  case OTHER:
+    return "other";
+  case NUM_KINDS:
+    break;
+  }
+  not_reached();
+}
+
+// Range-ness is only known once instructions are lowered, so treat invokes
+// that the dex encoding could not express with 5 registers as ranges.
+Kind kind_of(const IRInstruction* insn) {
+  auto op = insn->opcode();
+  if (opcode::is_an_invoke(op)) {
+    return insn->srcs_size() > 5 ? INVOKE_RANGE : INVOKE;
+  }
+  if (opcode::is_filled_new_array(op)) {
+    return FILLED_NEW_ARRAY;
+  }
+  return OTHER;
+}
+
+using Histogram = std::array<std::array<size_t, kMaxBucket + 1>, NUM_KINDS>;
+
+template <typename Fn>
+double seconds(const Fn& fn) {
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(end - start).count();
+}
+
+void print_histogram(const Histogram& histogram) {
+  size_t total = 0;
+  for (const auto& buckets : histogram) {
+    for (auto count : buckets) {
+      total += count;
+    }
+  }
+  std::cout << "instructions: " << total << std::endl;
+  for (size_t kind = 0; kind < NUM_KINDS; ++kind) {
+    std::cout << kind_name(static_cast<Kind>(kind)) << ":" << std::endl;
+    size_t cumulative = 0;
+    for (size_t n = 0; n <= kMaxBucket; ++n) {
+      auto count = histogram[kind][n];
+      if (count == 0) {
+        continue;
+      }
+      cumulative += count;
+      std::cout << "  " << std::setw(3) << n << (n == kMaxBucket ? "+" : " ")
+                << " srcs: " << std::setw(10) << count << "  (cumulative "
+                << std::fixed << std::setprecision(3)
+                << 100.0 * cumulative / total << "% of all)" << std::endl;
+    }
+  }
+}
+
+void srcs_histogram(DexStoresVector& stores) {
+  auto scope = build_class_scope(stores);
+
+  double balloon_secs = seconds([&] {
+    walk::parallel::methods(scope, [](DexMethod* m) {
+      if (m->get_dex_code() != nullptr) {
+        m->balloon();
+      }
+    });
+  });
+
+  Histogram histogram{};
+  walk::code(scope, [&](DexMethod*, IRCode& code) {
+    for (const auto& mie : InstructionIterable(code)) {
+      auto* insn = mie.insn;
+      histogram[kind_of(insn)][std::min(insn->srcs_size(), kMaxBucket)]++;
+    }
+  });
+  print_histogram(histogram);
+
+  double cfg_secs = seconds([&] {
+    walk::parallel::code(scope, [](DexMethod*, IRCode& code) {
+      code.build_cfg(/* editable */ true);
+    });
+  });
+  double clear_cfg_secs = seconds([&] {
+    walk::parallel::code(scope,
+                         [](DexMethod*, IRCode& code) { code.clear_cfg(); });
+  });
+  std::cout << std::fixed << std::setprecision(3)
+            << "balloon: " << balloon_secs << "s, build_cfg: " << cfg_secs
+            << "s, clear_cfg: " << clear_cfg_secs << "s" << std::endl;
+}
+
+class SrcsHistogram : public Tool {
+ public:
+  SrcsHistogram()
+      : Tool("srcs-histogram",
+             "distribution of source register counts of instructions") {}
+
+  void add_options(po::options_description& options) const override {
+    add_standard_options(options);
+  }
+
+  void run(const po::variables_map& options) override {
+    auto stores = init(options["jars"].as<std::string>(),
+                       options["apkdir"].as<std::string>(),
+                       options["dexendir"].as<std::string>(),
+                       /* balloon */ false);
+    srcs_histogram(stores);
+  }
+};
+
+static SrcsHistogram s_tool;
+
+} // namespace
@@ -10,6 +10,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "Formatters.h"
 #include "PrintUtil.h"
@@ -47,7 +57,13 @@ static const char ddump_usage_string[] =
     "printing options:\n"
     "--clean: suppress indices and offsets\n"
     "--no-headers: suppress headers\n"
-    "--raw: print all bytes, even control characters\n";
+    "--raw: print all bytes, even control characters\n"
+    "\n"
+    "dumping options:\n"
+    "-j, --jobs=<n>: dump up to <n> dex files at once (default: one per "
+    "core)\n"
+    "--unordered: print each dex file as soon as it is dumped, instead of in "
+    "the order given\n";
 
 int main(int argc, char* argv[]) {
 
@@ -68,6 +84,8 @@ int main(int argc, char* argv[]) {
   bool redexdump_debug = false;
   uint32_t ddebug_offset = 0;
   int no_headers = 0;
+  int unordered = 0;
+  unsigned num_threads = std::max(1u, std::thread::hardware_concurrency());
 
   char c;
   static const struct option options[] = {
@@ -91,11 +109,13 @@ int main(int argc, char* argv[]) {
       {"raw", no_argument, (int*)&raw, 1},
       {"escape", no_argument, (int*)&escape, 1},
       {"no-headers", no_argument, &no_headers, 1},
+      {"jobs", required_argument, nullptr, 'j'},
+      {"unordered", no_argument, &unordered, 1},
       {"help", no_argument, nullptr, 'h'},
       {nullptr, 0, nullptr, 0},
   };
 
-  while ((c = getopt_long(argc, argv, "asStpfmcCxeAdDh", &options[0],
+  while ((c = getopt_long(argc, argv, "asStpfmcCxeAdDhj:", &options[0],
                           nullptr)) != -1) {
     switch (c) {
     case 'a':
@@ -146,6 +166,9 @@ int main(int argc, char* argv[]) {
     case 'D':
       sscanf(optarg, "%x", &ddebug_offset);
       break;
+    case 'j':
+      num_threads = std::max(1, atoi(optarg));
+      break;
     case 'h':
       puts(ddump_usage_string);
       return 0;
@@ -164,8 +187,9 @@ int main(int argc, char* argv[]) {
     return 1;
   }
 
-  while (optind < argc) {
-    const char* dexfile = argv[optind++];
+  // Only the requested sections of each dex are decoded, straight from its
+  // mapping.
+  auto dump_dex = [&](const char* dexfile) {
     ddump_data rd;
     open_dex_file(dexfile, &rd);
     if (!no_headers) {
@@ -217,9 +241,67 @@ int main(int argc, char* argv[]) {
     if (ddebug_offset != 0) {
       disassemble_debug(&rd, ddebug_offset);
     }
-    fprintf(stdout, "\n");
+    redump("\n");
+    munmap(rd.dexmmap, rd.dex_size);
+  };
+
+  std::vector<const char*> dexfiles(argv + optind, argv + argc);
+  num_threads = std::min<size_t>(num_threads, dexfiles.size());
+  if (num_threads == 1) {
+    for (const char* dexfile : dexfiles) {
+      dump_dex(dexfile);
+      fflush(stdout);
+    }
+    return 0;
+  }
+
+  // Each worker dumps a whole dex into its own buffer, which this thread
+  // prints, and frees, once all the dex files before it are printed.
+  std::vector<std::string> dumps(dexfiles.size());
+  std::vector<bool> done(dexfiles.size());
+  std::deque<size_t> done_order;
+  std::mutex mutex;
+  std::condition_variable dumped;
+  std::atomic<size_t> next_dex{0};
+  auto work = [&]() {
+    for (size_t i; (i = next_dex++) < dexfiles.size();) {
+      std::string dump;
+      redump_buffer = &dump;
+      dump_dex(dexfiles[i]);
+      redump_buffer = nullptr;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        dumps[i] = std::move(dump);
+        done[i] = true;
+        done_order.push_back(i);
+      }
+      dumped.notify_one();
+    }
+  };
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < num_threads; ++t) {
+    threads.emplace_back(work);
+  }
+  for (size_t printed = 0; printed < dexfiles.size(); ++printed) {
+    std::string dump;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      size_t i = printed;
+      if (unordered) {
+        dumped.wait(lock, [&] { return !done_order.empty(); });
+        i = done_order.front();
+        done_order.pop_front();
+      } else {
+        dumped.wait(lock, [&] { return done[i]; });
+      }
+      dump = std::move(dumps[i]);
+    }
+    fwrite(dump.data(), 1, dump.size(), stdout);
     fflush(stdout);
   }
+  for (auto& thread : threads) {
+    thread.join();
+  }
 
   return 0;
 }
@@ -141,7 +141,9 @@ DexStoresVector Tool::init(const std::string& system_jar_paths,
     }
   }
 
-  // Load dexen
+  // Load dexen. Most tools only look at some of the code, so leave the code
+  // items to be parsed on first use.
+  set_lazy_code_loading(true);
   DexStore root_store("dex");
   DexStoresVector stores;
 
@@ -8,18 +8,31 @@
 #include "CommandProfiling.h"
 
 #if defined(__unix__) || defined(__APPLE__)
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
 #include <signal.h>
+#include <sys/time.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #endif
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
 #include <chrono>
 #include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <map>
 #include <sstream>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include "Debug.h"
+#include "Show.h"
+#include "Trace.h"
 
 namespace {
 
@@ -171,3 +184,216 @@ ScopedCommandProfiling::maybe_from_info<>(
 template boost::optional<ScopedCommandProfiling>
 ScopedCommandProfiling::maybe_from_info<>(
     const boost::optional<ProfilerInfo>& info, const char* log_str);
+
+namespace {
+
+constexpr size_t kDefaultFrequencyHz = 200;
+
+#ifdef _POSIX_VERSION
+
+constexpr size_t kMaxSampleFrames = 64;
+// A few minutes of CPU time at the default frequency. Later samples are
+// dropped.
+constexpr size_t kMaxSamples = 1 << 16;
+
+struct Sample {
+  const DexMethodRef* method;
+  int depth;
+  void* frames[kMaxSampleFrames];
+};
+
+// Preallocated, so that the signal handler only writes to memory.
+std::vector<Sample> s_samples;
+std::atomic<size_t> s_next_sample{0};
+std::atomic<bool> s_sampling{false};
+std::atomic<int> s_in_handler{0};
+
+void on_sigprof(int) {
+  s_in_handler.fetch_add(1);
+  if (s_sampling.load()) {
+    auto saved_errno = errno;
+    auto index = s_next_sample.fetch_add(1, std::memory_order_relaxed);
+    if (index < s_samples.size()) {
+      auto& sample = s_samples[index];
+      sample.method = TraceContext::current_method();
+      sample.depth = backtrace(sample.frames, kMaxSampleFrames);
+    }
+    errno = saved_errno;
+  }
+  s_in_handler.fetch_sub(1);
+}
+
+void set_timer(size_t frequency_hz) {
+  struct itimerval timer;
+  timer.it_interval.tv_sec = 0;
+  timer.it_interval.tv_usec =
+      frequency_hz == 0 ? 0 : std::max<long>(1, 1000000 / frequency_hz);
+  timer.it_value = timer.it_interval;
+  setitimer(ITIMER_PROF, &timer, nullptr);
+}
+
+void start_sampling(size_t frequency_hz) {
+  always_assert_log(!s_sampling.load(), "Already sampling");
+  s_samples.resize(kMaxSamples);
+  s_next_sample = 0;
+  // The first call of backtrace() may allocate, which must not happen in the
+  // signal handler.
+  void* frame;
+  backtrace(&frame, 1);
+
+  // The handler stays installed, as a signal may still be pending after the
+  // timer is stopped, and the default action of SIGPROF is to terminate.
+  static bool installed = [] {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_sigprof;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    return sigaction(SIGPROF, &action, nullptr) == 0;
+  }();
+  always_assert_log(installed, "Failed to install the SIGPROF handler");
+  s_sampling = true;
+  set_timer(frequency_hz);
+}
+
+std::vector<Sample> stop_sampling() {
+  set_timer(0);
+  s_sampling = false;
+  while (s_in_handler.load() != 0) {
+    std::this_thread::yield();
+  }
+  auto size = std::min(s_next_sample.load(), s_samples.size());
+  if (size < s_next_sample.load()) {
+    std::cerr << "Sampling profiler dropped " << s_next_sample.load() - size
+              << " samples" << std::endl;
+  }
+  std::vector<Sample> samples(s_samples.begin(), s_samples.begin() + size);
+  s_samples.clear();
+  s_samples.shrink_to_fit();
+  return samples;
+}
+
+std::string frame_name(void* address) {
+  Dl_info info;
+  if (dladdr(address, &info) == 0) {
+    std::ostringstream ss;
+    ss << address;
+    return ss.str();
+  }
+  if (info.dli_sname != nullptr) {
+    int status;
+    char* demangled =
+        abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+    std::string name = status == 0 ? demangled : info.dli_sname;
+    free(demangled);
+    return name;
+  }
+  const char* object = info.dli_fname == nullptr ? "?" : info.dli_fname;
+  const char* base = strrchr(object, '/');
+  std::ostringstream ss;
+  ss << (base == nullptr ? object : base + 1) << "+0x" << std::hex
+     << (reinterpret_cast<uintptr_t>(address) -
+         reinterpret_cast<uintptr_t>(info.dli_fbase));
+  return ss.str();
+}
+
+void write_folded_stacks(const std::vector<Sample>& samples,
+                         const std::string& tag,
+                         const std::string& output_file) {
+  std::unordered_map<void*, std::string> frame_names;
+  std::unordered_map<const DexMethodRef*, std::string> method_names;
+  std::map<std::string, size_t> stacks;
+  for (const auto& sample : samples) {
+    auto method_it = method_names.find(sample.method);
+    if (method_it == method_names.end()) {
+      method_it = method_names
+                      .emplace(sample.method,
+                               sample.method == nullptr
+                                   ? "(no method)"
+                                   : show_deobfuscated(sample.method))
+                      .first;
+    }
+    std::string stack = tag + ";" + method_it->second;
+    // The innermost two frames are the signal handler and the trampoline
+    // that called it.
+    for (int i = sample.depth - 1; i >= 2; --i) {
+      auto& name = frame_names[sample.frames[i]];
+      if (name.empty()) {
+        name = frame_name(sample.frames[i]);
+      }
+      stack += ";";
+      stack += name;
+    }
+    ++stacks[stack];
+  }
+
+  std::ofstream out(output_file);
+  if (!out) {
+    std::cerr << "Unable to write " << output_file << std::endl;
+    return;
+  }
+  for (const auto& p : stacks) {
+    out << p.first << " " << p.second << "\n";
+  }
+}
+
+#endif
+
+} // namespace
+
+ScopedSamplingProfiling::ScopedSamplingProfiling(const SamplingInfo& info,
+                                                 size_t index,
+                                                 const std::string& tag)
+    : m_tag(tag) {
+#ifdef _POSIX_VERSION
+  std::ostringstream ss;
+  ss << info.output_dir << "/" << index << "." << tag << ".folded";
+  m_output_file = ss.str();
+  start_sampling(info.frequency_hz);
+  m_active = true;
+#else
+  std::cerr << "Sampling profiling is not supported on non-POSIX systems"
+            << std::endl;
+#endif
+}
+
+ScopedSamplingProfiling::ScopedSamplingProfiling(
+    ScopedSamplingProfiling&& other) noexcept
+    : m_active(other.m_active),
+      m_output_file(std::move(other.m_output_file)),
+      m_tag(std::move(other.m_tag)) {
+  other.m_active = false;
+}
+
+ScopedSamplingProfiling::~ScopedSamplingProfiling() {
+#ifdef _POSIX_VERSION
+  if (m_active) {
+    write_folded_stacks(stop_sampling(), m_tag, m_output_file);
+  }
+#endif
+}
+
+boost::optional<ScopedSamplingProfiling::SamplingInfo>
+ScopedSamplingProfiling::maybe_info_from_env(const std::string& prefix) {
+  auto dir = getenv((prefix + "SAMPLING_PROFILE_DIR").c_str());
+  if (dir == nullptr) {
+    return boost::none;
+  }
+  SamplingInfo info{dir, kDefaultFrequencyHz};
+  auto frequency = getenv((prefix + "SAMPLING_PROFILE_HZ").c_str());
+  if (frequency != nullptr) {
+    info.frequency_hz = strtoul(frequency, nullptr, 10);
+  }
+  return info;
+}
+
+boost::optional<ScopedSamplingProfiling>
+ScopedSamplingProfiling::maybe_from_info(
+    const boost::optional<SamplingInfo>& info,
+    size_t index,
+    const std::string& tag) {
+  if (!info) {
+    return boost::none;
+  }
+  return ScopedSamplingProfiling(*info, index, tag);
+}
@@ -6,6 +6,7 @@
  */
 
 #include <boost/optional.hpp>
+#include <cstddef>
 #include <string>
 
 class ScopedCommandProfiling final {
@@ -67,3 +68,57 @@ class ScopedCommandProfiling final {
   // After the profiling process has finished, run this command.
   boost::optional<std::string> m_post_cmd;
 };
+
+/*
+ * A built-in sampling profiler, for machines where no external profiler can
+ * be attached to the process.
+ *
+ * While in scope, the CPU time of all threads is sampled with SIGPROF. Each
+ * sample records the call stack and the method of the innermost TraceContext
+ * of the interrupted thread. On destruction, the samples are written as
+ * folded stacks, one line `tag;method;outermost;...;innermost count` per
+ * distinct stack, ready for flame graph tools. Frames are named after their
+ * dynamic symbol when there is one, and after their object and offset
+ * otherwise, for use with addr2line.
+ *
+ * Only one instance may be in scope at a time.
+ */
+class ScopedSamplingProfiling final {
+ public:
+  struct SamplingInfo {
+    // The directory that receives one file per profiled scope.
+    std::string output_dir;
+    size_t frequency_hz;
+  };
+
+  ScopedSamplingProfiling(const SamplingInfo& info,
+                          size_t index,
+                          const std::string& tag);
+  ScopedSamplingProfiling(const ScopedSamplingProfiling&) = delete;
+  ScopedSamplingProfiling(ScopedSamplingProfiling&&) noexcept;
+
+  ~ScopedSamplingProfiling();
+
+  ScopedSamplingProfiling& operator=(const ScopedSamplingProfiling&) = delete;
+  ScopedSamplingProfiling& operator=(ScopedSamplingProfiling&&) = delete;
+
+  /*
+   * Reads <prefix>SAMPLING_PROFILE_DIR and, optionally, the sampling
+   * frequency <prefix>SAMPLING_PROFILE_HZ.
+   */
+  static boost::optional<SamplingInfo> maybe_info_from_env(
+      const std::string& prefix);
+
+  /*
+   * Profiles into <output_dir>/<index>.<tag>.folded, if there is an info.
+   */
+  static boost::optional<ScopedSamplingProfiling> maybe_from_info(
+      const boost::optional<SamplingInfo>& info,
+      size_t index,
+      const std::string& tag);
+
+ private:
+  bool m_active{false};
+  std::string m_output_file;
+  std::string m_tag;
+};
@@ -5,10 +5,16 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include "JemallocUtil.h"
+
 #if defined(__unix__) || defined(__APPLE__)
 #include <dlfcn.h>
 #endif
 
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
 #include "Debug.h"
 
 extern "C" {
@@ -35,6 +41,69 @@ void set_profile_active(bool active) {
   always_assert_log(err == 0, "mallctl failed with: %d", err);
 }
 
+template <typename T>
+bool read_stat(const char* name, T* value) {
+  size_t size = sizeof(T);
+  return mallctl(name, value, &size, nullptr, 0) == 0;
+}
+
+template <typename T>
+bool read_stat(const std::string& name, T* value) {
+  return read_stat(name.c_str(), value);
+}
+
+// The statistics are a snapshot taken at the last epoch.
+bool refresh_stats() {
+  uint64_t epoch = 1;
+  size_t epoch_size = sizeof(epoch);
+  return mallctl("epoch", &epoch, &epoch_size, &epoch, epoch_size) == 0;
+}
+
+// The requests of a size class, falling back to its allocations for versions
+// of jemalloc that don't count requests.
+bool read_requests(const std::string& prefix, uint64_t* requests) {
+  return read_stat(prefix + ".nrequests", requests) ||
+         read_stat(prefix + ".nmalloc", requests);
+}
+
+// jemalloc 5 merges all arenas at a fixed index; jemalloc 4 uses the index
+// after the last arena.
+boost::optional<std::string> all_arenas_prefix() {
+  uint64_t value;
+  std::string prefix = "stats.arenas." + std::to_string(4096);
+  if (read_stat(prefix + ".small.nmalloc", &value)) {
+    return prefix;
+  }
+  unsigned narenas;
+  if (!read_stat("arenas.narenas", &narenas)) {
+    return boost::none;
+  }
+  prefix = "stats.arenas." + std::to_string(narenas);
+  if (read_stat(prefix + ".small.nmalloc", &value)) {
+    return prefix;
+  }
+  return boost::none;
+}
+
+struct ThreadCounters {
+  uint64_t* allocated{nullptr};
+  uint64_t* deallocated{nullptr};
+};
+
+// jemalloc maintains the counters of each thread at a fixed address, which is
+// much cheaper to read than going through mallctl every time.
+const ThreadCounters& get_thread_counters() {
+  thread_local ThreadCounters counters = []() {
+    ThreadCounters c;
+    if (mallctl == nullptr || !read_stat("thread.allocatedp", &c.allocated) ||
+        !read_stat("thread.deallocatedp", &c.deallocated)) {
+      c.allocated = c.deallocated = nullptr;
+    }
+    return c;
+  }();
+  return counters;
+}
+
 } // namespace
 
 namespace jemalloc_util {
@@ -43,4 +112,106 @@ void enable_profiling() { set_profile_active(true); }
 
 void disable_profiling() { set_profile_active(false); }
 
+boost::optional<HeapStats> get_heap_stats() {
+  if (mallctl == nullptr) {
+    return boost::none;
+  }
+  if (!refresh_stats()) {
+    return boost::none;
+  }
+  size_t allocated;
+  size_t resident;
+  size_t retained;
+  if (!read_stat("stats.allocated", &allocated) ||
+      !read_stat("stats.resident", &resident) ||
+      !read_stat("stats.retained", &retained)) {
+    return boost::none;
+  }
+  return HeapStats{allocated, resident, retained};
+}
+
+boost::optional<AllocationStats> get_allocation_stats() {
+  if (mallctl == nullptr || !refresh_stats()) {
+    return boost::none;
+  }
+  auto prefix = all_arenas_prefix();
+  size_t active;
+  if (!prefix || !read_stat("stats.active", &active)) {
+    return boost::none;
+  }
+  AllocationStats stats;
+  stats.active = active;
+
+  // Small allocations, by bin.
+  unsigned nbins;
+  if (!read_stat("arenas.nbins", &nbins)) {
+    return boost::none;
+  }
+  for (unsigned i = 0; i < nbins; ++i) {
+    auto index = std::to_string(i);
+    size_t size;
+    uint64_t requests;
+    if (!read_stat("arenas.bin." + index + ".size", &size) ||
+        !read_requests(*prefix + ".bins." + index, &requests)) {
+      return boost::none;
+    }
+    stats.requests += requests;
+    stats.requested_bytes += requests * size;
+  }
+
+  // Large allocations, by size class, when the version of jemalloc has them.
+  unsigned nlextents;
+  if (read_stat("arenas.nlextents", &nlextents)) {
+    for (unsigned i = 0; i < nlextents; ++i) {
+      auto index = std::to_string(i);
+      size_t size;
+      uint64_t requests;
+      if (!read_stat("arenas.lextent." + index + ".size", &size) ||
+          !read_requests(*prefix + ".lextents." + index, &requests)) {
+        return boost::none;
+      }
+      stats.requests += requests;
+      stats.requested_bytes += requests * size;
+    }
+  } else {
+    uint64_t requests;
+    if (read_requests(*prefix + ".large", &requests)) {
+      stats.requests += requests;
+    }
+  }
+  return stats;
+}
+
+bool has_thread_stats() { return get_thread_counters().allocated != nullptr; }
+
+int64_t thread_net_allocated_bytes() {
+  const auto& counters = get_thread_counters();
+  if (counters.allocated == nullptr) {
+    return 0;
+  }
+  return static_cast<int64_t>(*counters.allocated - *counters.deallocated);
+}
+
+bool use_node_arena(unsigned int node) {
+  if (mallctl == nullptr) {
+    return false;
+  }
+  static std::mutex mutex;
+  static std::unordered_map<unsigned int, unsigned int> node_arenas;
+  unsigned int arena;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = node_arenas.find(node);
+    if (it == node_arenas.end()) {
+      size_t size = sizeof(arena);
+      if (mallctl("arenas.create", &arena, &size, nullptr, 0) != 0) {
+        return false;
+      }
+      it = node_arenas.emplace(node, arena).first;
+    }
+    arena = it->second;
+  }
+  return mallctl("thread.arena", nullptr, nullptr, &arena, sizeof(arena)) == 0;
+}
+
 } // namespace jemalloc_util
@@ -5,6 +5,10 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#pragma once
+
+#include <boost/optional.hpp>
+#include <cstdint>
 #include <cstdio>
 
 namespace jemalloc_util {
@@ -13,6 +17,46 @@ void enable_profiling();
 
 void disable_profiling();
 
+struct HeapStats {
+  // Bytes allocated by the application.
+  uint64_t allocated{0};
+  // Bytes in physically resident pages mapped by the allocator.
+  uint64_t resident{0};
+  // Bytes in virtual memory mappings that the allocator retained rather than
+  // returned to the operating system.
+  uint64_t retained{0};
+};
+
+// Returns none when not running with jemalloc.
+boost::optional<HeapStats> get_heap_stats();
+
+struct AllocationStats {
+  // Allocation requests and their bytes, rounded up to jemalloc's size
+  // classes, since the process started. Requests served from a thread cache
+  // are only counted once the cache is flushed, so these lag a little.
+  uint64_t requests{0};
+  uint64_t requested_bytes{0};
+  // Bytes in the pages of active allocations.
+  uint64_t active{0};
+};
+
+// Sums the counters of all arenas. Returns none when not running with
+// jemalloc, or when it was built without statistics.
+boost::optional<AllocationStats> get_allocation_stats();
+
+// Whether the per-thread counters below are available.
+bool has_thread_stats();
+
+// Bytes allocated minus bytes deallocated by the calling thread since it
+// started. Always zero when not running with jemalloc.
+int64_t thread_net_allocated_bytes();
+
+// Makes the calling thread allocate from an arena shared only by the threads
+// of the given NUMA node, creating it on first use. As long as those threads
+// stay on the node, the pages of the arena are first touched, and thus
+// placed, there. Returns false when not running with jemalloc.
+bool use_node_arena(unsigned int node);
+
 class ScopedProfiling final {
  public:
   explicit ScopedProfiling(bool enable) {
@@ -8,18 +8,24 @@
 #pragma once
 
 #include <functional>
-#include <map>
 #include <unordered_map>
+#include <vector>
 
 /*
  * Collection type that maintains a set of elements with associated
  * priorities, allowing updating priorities, and enabling efficient
  * retrieval of the element with the highest priority.
  *
+ * Elements live in a pool of nodes in a vector, which two binary heaps index:
+ * one with the highest priority on top, for `front`, and one with the lowest
+ * priority on top, for `back`. Each node knows its position in both heaps, so
+ * that erasing an element or changing its priority is O(log n) and doesn't
+ * allocate. Freed nodes are reused by later insertions.
+ *
  * Limitations:
  * - The same value cannot be present twice (even with a different priority)
  * - No two values can exist in the queue with the same priority at the same
- *   time
+ *   time; this is what makes `front` and `back` deterministic
  */
 template <class Value,
           class Priority,
@@ -27,47 +33,163 @@ template <class Value,
           class PriorityCompare = std::less<Priority>>
 class MutablePriorityQueue {
  private:
-  std::map<Priority, Value, PriorityCompare> m_values;
-  std::unordered_map<Value, Priority, ValueHash> m_priorities;
+  struct Node {
+    Value value;
+    Priority priority;
+    size_t max_pos;
+    size_t min_pos;
+  };
+
+  std::vector<Node> m_nodes;
+  std::vector<size_t> m_free_nodes;
+  // Indices of nodes; the highest priority is at the root of m_max_heap, and
+  // the lowest at the root of m_min_heap.
+  std::vector<size_t> m_max_heap;
+  std::vector<size_t> m_min_heap;
+  std::unordered_map<Value, size_t, ValueHash> m_node_indices;
+  PriorityCompare m_compare;
+
+  template <bool Max>
+  std::vector<size_t>& heap() {
+    return Max ? m_max_heap : m_min_heap;
+  }
+
+  template <bool Max>
+  size_t& pos(size_t node) {
+    return Max ? m_nodes[node].max_pos : m_nodes[node].min_pos;
+  }
+
+  // Whether node a belongs above node b in the heap.
+  template <bool Max>
+  bool above(size_t a, size_t b) const {
+    const auto& pa = m_nodes[a].priority;
+    const auto& pb = m_nodes[b].priority;
+    return Max ? m_compare(pb, pa) : m_compare(pa, pb);
+  }
+
+  template <bool Max>
+  void place(size_t i, size_t node) {
+    heap<Max>()[i] = node;
+    pos<Max>(node) = i;
+  }
+
+  template <bool Max>
+  void sift_up(size_t i) {
+    auto& h = heap<Max>();
+    auto node = h[i];
+    while (i > 0) {
+      auto parent = (i - 1) / 2;
+      if (!above<Max>(node, h[parent])) {
+        break;
+      }
+      place<Max>(i, h[parent]);
+      i = parent;
+    }
+    place<Max>(i, node);
+  }
+
+  template <bool Max>
+  void sift_down(size_t i) {
+    auto& h = heap<Max>();
+    auto node = h[i];
+    while (true) {
+      auto child = 2 * i + 1;
+      if (child >= h.size()) {
+        break;
+      }
+      if (child + 1 < h.size() && above<Max>(h[child + 1], h[child])) {
+        ++child;
+      }
+      if (!above<Max>(h[child], node)) {
+        break;
+      }
+      place<Max>(i, h[child]);
+      i = child;
+    }
+    place<Max>(i, node);
+  }
+
+  template <bool Max>
+  void heap_insert(size_t node) {
+    heap<Max>().push_back(node);
+    sift_up<Max>(heap<Max>().size() - 1);
+  }
+
+  template <bool Max>
+  void heap_erase(size_t node) {
+    auto& h = heap<Max>();
+    auto i = pos<Max>(node);
+    auto last = h.back();
+    h.pop_back();
+    if (i < h.size()) {
+      place<Max>(i, last);
+      heap_update<Max>(last);
+    }
+  }
+
+  template <bool Max>
+  void heap_update(size_t node) {
+    sift_up<Max>(pos<Max>(node));
+    sift_down<Max>(pos<Max>(node));
+  }
 
  public:
   // Inserts a value with a priority; neither value or priority can already be
   // present.
   void insert(const Value& value, const Priority& priority) {
-    auto map_result = m_values.insert({priority, value});
-    always_assert(map_result.second);
-    auto priorities_result = m_priorities.insert({value, priority});
-    always_assert(priorities_result.second);
+    size_t node;
+    if (m_free_nodes.empty()) {
+      node = m_nodes.size();
+      m_nodes.push_back(Node{value, priority, 0, 0});
+    } else {
+      node = m_free_nodes.back();
+      m_free_nodes.pop_back();
+      m_nodes[node].value = value;
+      m_nodes[node].priority = priority;
+    }
+    auto indices_result = m_node_indices.emplace(value, node);
+    always_assert(indices_result.second);
+    heap_insert<true>(node);
+    heap_insert<false>(node);
   }
 
   // Erases a value that's currently in the queue.
   void erase(const Value& value) {
-    auto old_priority_it = m_priorities.find(value);
-    always_assert(old_priority_it != m_priorities.end());
-    const auto erased = m_values.erase(old_priority_it->second);
-    always_assert(erased);
-    m_priorities.erase(old_priority_it);
+    auto it = m_node_indices.find(value);
+    always_assert(it != m_node_indices.end());
+    auto node = it->second;
+    m_node_indices.erase(it);
+    heap_erase<true>(node);
+    heap_erase<false>(node);
+    m_free_nodes.push_back(node);
   }
 
   // Changes the priority of a value. The value must already be in the queue.
   // No current queue element may already have the new priority.
   void update_priority(const Value& value, const Priority& priority) {
-    erase(value);
-    insert(value, priority);
+    auto it = m_node_indices.find(value);
+    always_assert(it != m_node_indices.end());
+    auto node = it->second;
+    m_nodes[node].priority = priority;
+    heap_update<true>(node);
+    heap_update<false>(node);
   }
 
   // Removes all elements.
   void clear() {
-    m_values.clear();
-    m_priorities.clear();
+    m_nodes.clear();
+    m_free_nodes.clear();
+    m_max_heap.clear();
+    m_min_heap.clear();
+    m_node_indices.clear();
   }
 
   // Checks if queue is empty.
-  bool empty() const { return m_values.empty(); }
+  bool empty() const { return m_max_heap.empty(); }
 
   // Returns element with highest priority.
-  Value front() const { return m_values.rbegin()->second; }
+  Value front() const { return m_nodes[m_max_heap.front()].value; }
 
   // Returns element with lowest priority.
-  Value back() const { return m_values.begin()->second; }
+  Value back() const { return m_nodes[m_min_heap.front()].value; }
 };